@@ -0,0 +1,429 @@
+// ***************************************************************** -*- C++ -*-
+// benchmarks.cpp
+// Benchmarks of the read and write paths of the library, per image format.
+// Besides the time, each benchmark reports the number of allocations and,
+// where a file is read, the bytes read from and mapped of the file per
+// iteration. The startup benchmarks run the exiv2 application. The scenario
+// benchmarks run what the shell tests in test/ run, perf_runner.py compares
+// them with a baseline.
+
+#include <exiv2/exiv2.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <string>
+#include <vector>
+
+// *****************************************************************************
+// Allocation counting, replaces the global operator new of the process
+namespace {
+    std::atomic<unsigned long long> allocations(0);
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+    using namespace Exiv2;
+
+    //! Curated corpus: one representative file from test/data per format
+    struct CorpusFile {
+        const char* format_;
+        const char* name_;
+    };
+
+    const CorpusFile corpus[] = {
+        { "jpeg", "exiv2-nikon-d70.jpg" },
+        { "tiff", "Reagan.tiff" },
+        { "png",  "ReaganSmallPng.png" },
+        { "webp", "exiv2-bug1199.webp" },
+        { "psd",  "exiv2-photoshop.psd" },
+        { "jp2",  "Reagan.jp2" },
+        { "pgf",  "imagemagick.pgf" },
+        { "crw",  "exiv2-canon-powershot-s40.crw" },
+        { "exv",  "RAW_PENTAX_K100.exv" },
+    };
+
+    std::string dataPath(const char* name)
+    {
+        return std::string(EXIV2_BENCHMARK_DATA) + "/" + name;
+    }
+
+    DataBuf readFile(const std::string& path)
+    {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        const std::vector<char> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        DataBuf buf(static_cast<long>(content.size()));
+        std::copy(content.begin(), content.end(), buf.pData_);
+        return buf;
+    }
+
+    //! FileIo which counts the bytes read from and mapped of the file
+    class CountingFileIo : public FileIo {
+    public:
+        CountingFileIo(const std::string& path, unsigned long long& bytesRead, unsigned long long& bytesMapped)
+            : FileIo(path), bytesRead_(bytesRead), bytesMapped_(bytesMapped)
+        {
+        }
+
+        long read(byte* buf, long rcount) override
+        {
+            const long n = FileIo::read(buf, rcount);
+            bytesRead_ += n;
+            return n;
+        }
+
+        using FileIo::read;
+
+        const byte* readView(DataBuf& buf, long rcount) override
+        {
+            const byte* p = FileIo::readView(buf, rcount);
+            // Views which are not served from the mapping are counted by read()
+            if (p != buf.pData_)
+                bytesRead_ += rcount;
+            return p;
+        }
+
+        long readAt(long offset, byte* buf, long rcount) override
+        {
+            const long n = FileIo::readAt(offset, buf, rcount);
+            bytesRead_ += n;
+            return n;
+        }
+
+        int getb() override
+        {
+            const int c = FileIo::getb();
+            if (c != EOF)
+                ++bytesRead_;
+            return c;
+        }
+
+        byte* mmap(bool isWriteable) override
+        {
+            byte* p = FileIo::mmap(isWriteable);
+            bytesMapped_ += size();
+            return p;
+        }
+
+    private:
+        unsigned long long& bytesRead_;
+        unsigned long long& bytesMapped_;
+    };
+
+    //! Reports the counters of the benchmark loop which ends when this object is destroyed
+    class Counters {
+    public:
+        explicit Counters(benchmark::State& state)
+            : state_(state), allocations_(allocations), bytesRead_(0), bytesMapped_(0), countBytes_(false)
+        {
+        }
+
+        ~Counters()
+        {
+            const benchmark::Counter::Flags avg = benchmark::Counter::kAvgIterations;
+            state_.counters["allocs"] = benchmark::Counter(static_cast<double>(allocations - allocations_), avg);
+            if (countBytes_) {
+                state_.counters["bytes_read"] = benchmark::Counter(static_cast<double>(bytesRead_), avg);
+                state_.counters["bytes_mapped"] = benchmark::Counter(static_cast<double>(bytesMapped_), avg);
+            }
+        }
+
+        //! Open \em path with a FileIo which counts the bytes read
+        Image::UniquePtr open(const std::string& path)
+        {
+            countBytes_ = true;
+            BasicIo::UniquePtr io(new CountingFileIo(path, bytesRead_, bytesMapped_));
+            return ImageFactory::open(std::move(io));
+        }
+
+    private:
+        benchmark::State& state_;
+        const unsigned long long allocations_;
+        unsigned long long bytesRead_;
+        unsigned long long bytesMapped_;
+        bool countBytes_;
+    };
+
+    void open(benchmark::State& state, const std::string& path)
+    {
+        Counters counters(state);
+        for (auto _ : state) {
+            Image::UniquePtr image = counters.open(path);
+            benchmark::DoNotOptimize(image.get());
+        }
+    }
+
+    void readMetadata(benchmark::State& state, const std::string& path)
+    {
+        Counters counters(state);
+        for (auto _ : state) {
+            Image::UniquePtr image = counters.open(path);
+            image->readMetadata();
+            benchmark::DoNotOptimize(image->exifData().count());
+        }
+    }
+
+    // Writes to a copy of the file in memory, only writeMetadata() is timed
+    void writeMetadata(benchmark::State& state, const std::string& path)
+    {
+        const DataBuf file = readFile(path);
+        unsigned long long writeAllocations = 0;
+        for (auto _ : state) {
+            state.PauseTiming();
+            Image::UniquePtr image = ImageFactory::open(file.pData_, file.size_);
+            image->readMetadata();
+            const unsigned long long before = allocations;
+            state.ResumeTiming();
+            image->writeMetadata();
+            state.PauseTiming();
+            writeAllocations += allocations - before;
+            image.reset();
+            state.ResumeTiming();
+        }
+        state.counters["allocs"] = benchmark::Counter(static_cast<double>(writeAllocations),
+                                                      benchmark::Counter::kAvgIterations);
+    }
+
+    void previews(benchmark::State& state, const std::string& path)
+    {
+        Image::UniquePtr image = ImageFactory::open(path);
+        image->readMetadata();
+        Counters counters(state);
+        for (auto _ : state) {
+            PreviewManager loader(*image);
+            const PreviewPropertiesList list = loader.getPreviewProperties();
+            for (PreviewPropertiesList::const_iterator pos = list.begin(); pos != list.end(); ++pos) {
+                PreviewImage preview = loader.getPreviewImage(*pos);
+                benchmark::DoNotOptimize(preview.pData());
+            }
+        }
+    }
+
+    void xmpDecode(benchmark::State& state, const std::string& xmpPacket)
+    {
+        Counters counters(state);
+        for (auto _ : state) {
+            XmpData xmpData;
+            XmpParser::decode(xmpData, xmpPacket);
+            benchmark::DoNotOptimize(xmpData.count());
+        }
+    }
+
+    void xmpEncode(benchmark::State& state, const XmpData& xmpData)
+    {
+        Counters counters(state);
+        for (auto _ : state) {
+            std::string xmpPacket;
+            XmpParser::encode(xmpPacket, xmpData);
+            benchmark::DoNotOptimize(xmpPacket.data());
+        }
+    }
+
+    void copyExifToXmp(benchmark::State& state, const ExifData& exifData)
+    {
+        Counters counters(state);
+        for (auto _ : state) {
+            XmpData xmpData;
+            Exiv2::copyExifToXmp(exifData, xmpData);
+            benchmark::DoNotOptimize(xmpData.count());
+        }
+    }
+
+    // What the first use of XMP costs a program, the toolkit is initialized lazily
+    void xmpInitialize(benchmark::State& state)
+    {
+        Counters counters(state);
+        for (auto _ : state) {
+            XmpParser::terminate();
+            XmpParser::initialize();
+        }
+    }
+
+#ifdef EXIV2_BENCHMARK_APP
+    // Includes the start of the shell which runs the application
+    void appStartup(benchmark::State& state, const std::string& args)
+    {
+#ifdef _WIN32
+        const std::string command = "\"" EXIV2_BENCHMARK_APP "\" " + args + " > NUL 2>&1";
+#else
+        const std::string command = "'" EXIV2_BENCHMARK_APP "' " + args + " > /dev/null 2>&1";
+#endif
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(std::system(command.c_str()));
+        }
+    }
+#endif
+
+    // *************************************************************************
+    // Scenarios of the shell tests in test/, an iteration runs a scenario over all of its files
+
+    const char* const imagetestFiles[] = {
+        "table.jpg", "smiley1.jpg", "smiley2.jpg", "glider.exv", "iptc-noAPP13.jpg",
+        "iptc-psAPP13-noIPTC.jpg", "iptc-psAPP13-noIPTC-psAPP13-wIPTC.jpg",
+        "iptc-psAPP13s-noIPTC-psAPP13s-wIPTC.jpg", "iptc-psAPP13s-wIPTC-psAPP13s-noIPTC.jpg",
+        "iptc-psAPP13s-wIPTCs-psAPP13s-wIPTCs.jpg", "iptc-psAPP13-wIPTC1-psAPP13-wIPTC2.jpg",
+        "iptc-psAPP13-wIPTCbeg.jpg", "iptc-psAPP13-wIPTCempty.jpg", "iptc-psAPP13-wIPTCempty-psAPP13-wIPTC.jpg",
+        "iptc-psAPP13-wIPTCend.jpg", "iptc-psAPP13-wIPTCmid1-wIPTCempty-wIPTCmid2.jpg",
+        "iptc-psAPP13-wIPTCmid.jpg", "iptc-psAPP13-wIPTC-psAPP13-noIPTC.jpg",
+    };
+    //! The first files of imagetest.sh, whose metadata is also copied to each other
+    const size_t imagetestCopyFiles = 3;
+
+    const char* const previewTestFiles[] = {
+        "exiv2-bug443.jpg", "exiv2-bug444.jpg", "exiv2-bug445.jpg", "exiv2-bug447.jpg", "exiv2-bug501.jpg",
+        "exiv2-bug528.jpg", "exiv2-canon-eos-20d.jpg", "exiv2-canon-eos-300d.jpg", "exiv2-canon-eos-d30.jpg",
+        "exiv2-canon-powershot-a520.jpg", "exiv2-canon-powershot-s40.crw", "exiv2-fujifilm-finepix-s2pro.jpg",
+        "exiv2-gc.jpg", "exiv2-kodak-dc210.jpg", "exiv2-nikon-d70.jpg", "exiv2-nikon-e950.jpg",
+        "exiv2-nikon-e990.jpg", "exiv2-olympus-c8080wz.jpg", "exiv2-panasonic-dmc-fz5.jpg",
+        "exiv2-sigma-d10.jpg", "exiv2-sony-dsc-w7.jpg", "iptc-psAPP13-noIPTC-psAPP13-wIPTC.jpg",
+        "iptc-psAPP13-noIPTC.jpg", "iptc-psAPP13-wIPTC-psAPP13-noIPTC.jpg",
+        "iptc-psAPP13-wIPTC1-psAPP13-wIPTC2.jpg", "iptc-psAPP13-wIPTCbeg.jpg",
+        "iptc-psAPP13-wIPTCempty-psAPP13-wIPTC.jpg", "iptc-psAPP13-wIPTCempty.jpg",
+        "iptc-psAPP13-wIPTCend.jpg", "iptc-psAPP13-wIPTCmid.jpg",
+        "iptc-psAPP13-wIPTCmid1-wIPTCempty-wIPTCmid2.jpg", "smiley2.jpg",
+    };
+
+    const char* const writeTestFiles[] = {
+        "exiv2-canon-powershot-s40.jpg", "exiv2-kodak-dc210.jpg", "exiv2-fujifilm-finepix-s2pro.jpg",
+        "exiv2-sigma-d10.jpg", "exiv2-nikon-e990.jpg", "exiv2-nikon-d70.jpg", "exiv2-nikon-e950.jpg",
+    };
+
+    //! Return the content of the files \em names, which the write scenarios modify in memory
+    std::vector<DataBuf> readFiles(const char* const* names, size_t count)
+    {
+        std::vector<DataBuf> files;
+        for (size_t i = 0; i < count; ++i) files.push_back(readFile(dataPath(names[i])));
+        return files;
+    }
+
+    //! imagetest.sh: erase the metadata of the files and copy it between the first ones
+    void imagetestScenario(benchmark::State& state)
+    {
+        const size_t count = sizeof(imagetestFiles) / sizeof(imagetestFiles[0]);
+        const std::vector<DataBuf> files = readFiles(imagetestFiles, count);
+        Counters counters(state);
+        for (auto _ : state) {
+            for (size_t i = 0; i < count; ++i) {
+                Image::UniquePtr image = counters.open(dataPath(imagetestFiles[i]));
+                image->readMetadata();
+                Image::UniquePtr copy = ImageFactory::open(files[i].pData_, files[i].size_);
+                copy->readMetadata();
+                copy->clearMetadata();
+                copy->writeMetadata();
+            }
+            for (size_t src = 0; src < imagetestCopyFiles; ++src) {
+                Image::UniquePtr source = counters.open(dataPath(imagetestFiles[src]));
+                source->readMetadata();
+                for (size_t dst = 0; dst < imagetestCopyFiles; ++dst) {
+                    Image::UniquePtr target = ImageFactory::open(files[dst].pData_, files[dst].size_);
+                    target->readMetadata();
+                    target->setMetadata(*source);
+                    target->writeMetadata();
+                }
+            }
+        }
+    }
+
+    //! preview-test.sh: extract all previews of the files
+    void previewTestScenario(benchmark::State& state)
+    {
+        Counters counters(state);
+        for (auto _ : state) {
+            for (const char* name : previewTestFiles) {
+                Image::UniquePtr image = counters.open(dataPath(name));
+                image->readMetadata();
+                PreviewManager loader(*image);
+                const PreviewPropertiesList list = loader.getPreviewProperties();
+                for (PreviewPropertiesList::const_iterator pos = list.begin(); pos != list.end(); ++pos) {
+                    PreviewImage preview = loader.getPreviewImage(*pos);
+                    benchmark::DoNotOptimize(preview.pData());
+                }
+            }
+        }
+    }
+
+    //! write-test.sh: read the files and write their metadata back, to memory
+    void writeTestScenario(benchmark::State& state)
+    {
+        const size_t count = sizeof(writeTestFiles) / sizeof(writeTestFiles[0]);
+        const std::vector<DataBuf> files = readFiles(writeTestFiles, count);
+        Counters counters(state);
+        for (auto _ : state) {
+            for (size_t i = 0; i < count; ++i) {
+                Image::UniquePtr image = counters.open(dataPath(writeTestFiles[i]));
+                image->readMetadata();
+                Image::UniquePtr copy = ImageFactory::open(files[i].pData_, files[i].size_);
+                copy->setMetadata(*image);
+                copy->writeMetadata();
+            }
+        }
+    }
+
+    //! Register the benchmarks of all files of the corpus, skipping those which do not apply
+    void registerBenchmarks()
+    {
+        benchmark::RegisterBenchmark("scenario/imagetest", imagetestScenario)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark("scenario/preview-test", previewTestScenario)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark("scenario/write-test", writeTestScenario)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark("XmpParser::initialize", xmpInitialize);
+#ifdef EXIV2_BENCHMARK_APP
+        benchmark::RegisterBenchmark("startup/version", appStartup, std::string("-V"))
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark("startup/jpeg", appStartup, "\"" + dataPath(corpus[0].name_) + "\"")
+            ->Unit(benchmark::kMillisecond);
+#endif
+        for (const CorpusFile& file : corpus) {
+            const std::string path = dataPath(file.name_);
+            const std::string suffix = std::string("/") + file.format_;
+            Image::UniquePtr image = ImageFactory::open(path);
+            image->readMetadata();
+
+            benchmark::RegisterBenchmark(("ImageFactory::open" + suffix).c_str(), open, path);
+            benchmark::RegisterBenchmark(("readMetadata" + suffix).c_str(), readMetadata, path);
+            benchmark::RegisterBenchmark(("writeMetadata" + suffix).c_str(), writeMetadata, path);
+            if (!PreviewManager(*image).getPreviewProperties().empty()) {
+                benchmark::RegisterBenchmark(("PreviewManager" + suffix).c_str(), previews, path);
+            }
+            if (!image->xmpPacket().empty()) {
+                XmpData xmpData;
+                XmpParser::decode(xmpData, image->xmpPacket());
+                benchmark::RegisterBenchmark(("XmpParser::decode" + suffix).c_str(), xmpDecode, image->xmpPacket());
+                benchmark::RegisterBenchmark(("XmpParser::encode" + suffix).c_str(), xmpEncode, xmpData);
+            }
+            if (!image->exifData().empty()) {
+                benchmark::RegisterBenchmark(("copyExifToXmp" + suffix).c_str(), copyExifToXmp, image->exifData());
+            }
+        }
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    XmpParser::initialize();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    registerBenchmarks();
+    benchmark::RunSpecifiedBenchmarks();
+    XmpParser::terminate();
+    return 0;
+}
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Performance regression runner
+
+Runs the scenario benchmarks of exiv2_benchmarks, which execute what the
+shell tests in test/ execute, and records the time, allocations and bytes
+read of each scenario in a JSON baseline. If the baseline exists, the
+deltas of the run against it are reported instead and the baseline is
+only replaced with --update.
+
+Usage: perf_runner.py [--update] [--filter REGEX] BENCHMARK BASELINE
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+#: Measurements of a scenario which are recorded, with their unit
+METRICS = [("time", "ms"), ("allocs", ""), ("bytes_read", "B")]
+
+
+def run_benchmarks(benchmark, benchmark_filter):
+    """ Run the benchmarks and return the measurements of each by name """
+    output = subprocess.run(
+        [benchmark, "--benchmark_filter=" + benchmark_filter,
+         "--benchmark_format=json", "--benchmark_repetitions=3",
+         "--benchmark_report_aggregates_only=true"],
+        stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, check=True
+    ).stdout
+    results = {}
+    for bm in json.loads(output.decode("utf-8"))["benchmarks"]:
+        # The median of the repetitions is the least noisy
+        if bm.get("aggregate_name", "median") != "median":
+            continue
+        name = bm.get("run_name", bm["name"])
+        scale = {"ns": 1e-6, "us": 1e-3, "ms": 1.0, "s": 1e3}[bm.get("time_unit", "ns")]
+        results[name] = {
+            "time": bm["real_time"] * scale,
+            "allocs": bm.get("allocs", 0),
+            "bytes_read": bm.get("bytes_read", 0),
+        }
+    return results
+
+
+def delta(old, new):
+    """ Return the change from old to new as a percentage string """
+    if old == 0:
+        return "   n/a" if new != 0 else "  0.0%"
+    return "{:+6.1f}%".format(100.0 * (new - old) / old)
+
+
+def report(baseline, results):
+    """ Print the measurements of the run and their deltas to the baseline """
+    header = "{:<28}".format("scenario")
+    for metric, unit in METRICS:
+        header += " {:>14} {:>7}".format(metric + (" [" + unit + "]" if unit else ""), "delta")
+    print(header)
+    for name in sorted(results):
+        line = "{:<28}".format(name)
+        old = baseline.get(name)
+        for metric, _ in METRICS:
+            value = results[name][metric]
+            line += " {:>14.2f} {:>7}".format(value, delta(old[metric], value) if old else "new")
+        print(line)
+    for name in sorted(set(baseline) - set(results)):
+        print("{:<28} missing from this run".format(name))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[1],
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("benchmark", help="the exiv2_benchmarks executable")
+    parser.add_argument("baseline", help="the JSON baseline file")
+    parser.add_argument("--update", action="store_true",
+                        help="replace the baseline with the measurements of this run")
+    parser.add_argument("--filter", default="^scenario/",
+                        help="regular expression of the benchmarks to run (default: %(default)s)")
+    args = parser.parse_args()
+
+    results = run_benchmarks(args.benchmark, args.filter)
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline, "r") as f:
+            baseline = json.load(f)
+    report(baseline, results)
+
+    if args.update or not baseline:
+        with open(args.baseline, "w") as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print("Baseline written to " + args.baseline)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,266 @@
+// ***************************************************************** -*- C++ -*-
+// scaling.cpp
+// Scaling test of the metadata containers, encoders and decoders. Each case
+// generates synthetic metadata of a base size n and of 8n, times an operation
+// on both and fails if the time grows faster than linearly, which catches a
+// linear search that turns a loop over the metadata into a quadratic one.
+//
+// Usage: exiv2_scaling [case...]
+// Runs the cases whose name starts with one of the arguments, all without
+// arguments. Returns 0 if all cases scale linearly, 1 otherwise.
+
+#include <exiv2/exiv2.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace Exiv2;
+
+    //! The size grows by this factor between the two measurements of a case
+    const long growth = 8;
+    //! A case fails if its time grows by more than this factor, a linear time grows by 8, a quadratic one by 64
+    const double maxTimeGrowth = 3.0 * growth;
+
+    //! Operation of a case, on the metadata it generated for a size
+    typedef std::function<void()> Operation;
+    //! Generates the metadata of a case for a size and returns the operation to time
+    typedef std::function<Operation(long n)> Generator;
+
+    struct Case {
+        const char* name_;                      //!< Name of the case
+        long n_;                                //!< Base size, the largest one is growth * n_
+        Generator generator_;
+    };
+
+    //! Return the time of one run of \em op in seconds, the best of several runs of at least 20 ms
+    double measure(const Operation& op)
+    {
+        typedef std::chrono::steady_clock Clock;
+        double best = 0;
+        for (int trial = 0; trial < 3; ++trial) {
+            long runs = 0;
+            const Clock::time_point start = Clock::now();
+            double elapsed = 0;
+            do {
+                op();
+                ++runs;
+                elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            } while (elapsed < 0.02);
+            const double t = elapsed / runs;
+            if (trial == 0 || t < best) best = t;
+        }
+        return best;
+    }
+
+    //! Return the content of the image \em image was written to
+    DataBuf content(Image& image)
+    {
+        BasicIo& io = image.io();
+        io.open();
+        DataBuf buf(static_cast<long>(io.size()));
+        io.read(buf.pData_, buf.size_);
+        io.close();
+        return buf;
+    }
+
+    // *************************************************************************
+    // Generators
+
+    //! Exif: n entries added by key, the container has to find each key first
+    Operation exifByKey(long n)
+    {
+        return [n]() {
+            ExifData exifData;
+            for (long i = 0; i < n; ++i) {
+                exifData[ExifKey(static_cast<uint16_t>(0x4000 + i), "Image").key()] = static_cast<uint16_t>(i);
+            }
+        };
+    }
+
+    //! Exif: n entries of IFD0 are encoded into a new TIFF structure
+    Operation exifEncode(long n)
+    {
+        std::shared_ptr<ExifData> exifData(new ExifData);
+        for (long i = 0; i < n; ++i) {
+            const UShortValue value(static_cast<uint16_t>(i));
+            exifData->add(ExifKey(static_cast<uint16_t>(0x4000 + i), "Image"), &value);
+        }
+        return [exifData]() {
+            Blob blob;
+            ExifParser::encode(blob, 0, 0, littleEndian, *exifData);
+        };
+    }
+
+    //! Return n Exif entries spread over IFDs of at most 256 entries, the limit of the TIFF reader
+    ExifData spreadExifData(long n)
+    {
+        static const char* const groups[] = { "Image", "Photo", "GPSInfo", "Iop" };
+        const long groupCount = sizeof(groups) / sizeof(groups[0]);
+        ExifData exifData;
+        for (long i = 0; i < n; ++i) {
+            const UShortValue value(static_cast<uint16_t>(i));
+            exifData.add(ExifKey(static_cast<uint16_t>(0x4000 + i / groupCount), groups[i % groupCount]), &value);
+        }
+        return exifData;
+    }
+
+    //! Exif: n entries are encoded non-intrusively into the TIFF structure they were encoded into before
+    Operation exifUpdate(long n)
+    {
+        std::shared_ptr<ExifData> exifData(new ExifData(spreadExifData(n)));
+        std::shared_ptr<Blob> tiff(new Blob);
+        ExifParser::encode(*tiff, 0, 0, littleEndian, *exifData);
+        // With the pointer tags which the encoder added
+        ExifParser::decode(*exifData, &(*tiff)[0], static_cast<uint32_t>(tiff->size()));
+        return [exifData, tiff]() {
+            Blob blob;
+            if (ExifParser::encode(blob, &(*tiff)[0], static_cast<uint32_t>(tiff->size()),
+                                   littleEndian, *exifData) != wmNonIntrusive) {
+                throw Error(kerErrorMessage, "Exif not encoded non-intrusively");
+            }
+        };
+    }
+
+    //! Exif: a TIFF image with n entries is read
+    Operation exifRead(long n)
+    {
+        std::shared_ptr<Blob> tiff(new Blob);
+        ExifParser::encode(*tiff, 0, 0, littleEndian, spreadExifData(n));
+        return [tiff, n]() {
+            Image::UniquePtr image = ImageFactory::open(&(*tiff)[0], static_cast<long>(tiff->size()));
+            image->readMetadata();
+            if (image->exifData().count() < n) throw Error(kerErrorMessage, "Exif entries not read");
+        };
+    }
+
+    //! IPTC: a JPEG image with n keywords is written and read
+    Operation iptcWriteRead(long n)
+    {
+        return [n]() {
+            Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+            const IptcKey key("Iptc.Application2.Keywords");
+            for (long i = 0; i < n; ++i) {
+                StringValue value("k" + std::to_string(i));
+                image->iptcData().add(key, &value);
+            }
+            image->writeMetadata();
+            const DataBuf buf = content(*image);
+            Image::UniquePtr copy = ImageFactory::open(buf.pData_, buf.size_);
+            copy->readMetadata();
+            if (copy->iptcData().count() != n) throw Error(kerErrorMessage, "IPTC datasets not read");
+        };
+    }
+
+    //! IPTC: n lookups of absent datasets in a container of n keywords
+    Operation iptcFindKey(long n)
+    {
+        std::shared_ptr<IptcData> iptcData(new IptcData);
+        const IptcKey key("Iptc.Application2.Keywords");
+        for (long i = 0; i < n; ++i) {
+            StringValue value("k" + std::to_string(i));
+            iptcData->add(key, &value);
+        }
+        return [iptcData, n]() {
+            for (long i = 0; i < n; ++i) {
+                const IptcKey absent(static_cast<uint16_t>(100 + i % 100), IptcDataSets::envelope);
+                if (iptcData->findKey(absent) != iptcData->end()) throw Error(kerErrorMessage, "IPTC dataset found");
+            }
+        };
+    }
+
+    //! XMP: a bag of n items is encoded
+    Operation xmpEncode(long n)
+    {
+        std::shared_ptr<XmpData> xmpData(new XmpData);
+        XmpArrayValue value(xmpBag);
+        for (long i = 0; i < n; ++i) value.read("subject" + std::to_string(i));
+        xmpData->add(XmpKey("Xmp.dc.subject"), &value);
+        return [xmpData]() {
+            std::string xmpPacket;
+            if (XmpParser::encode(xmpPacket, *xmpData) != 0) throw Error(kerErrorMessage, "XMP not encoded");
+        };
+    }
+
+    //! XMP: a packet with a bag of n items is decoded
+    Operation xmpDecode(long n)
+    {
+        XmpData xmpData;
+        XmpArrayValue value(xmpBag);
+        for (long i = 0; i < n; ++i) value.read("subject" + std::to_string(i));
+        xmpData.add(XmpKey("Xmp.dc.subject"), &value);
+        std::shared_ptr<std::string> xmpPacket(new std::string);
+        XmpParser::encode(*xmpPacket, xmpData);
+        return [xmpPacket]() {
+            XmpData decoded;
+            if (XmpParser::decode(decoded, *xmpPacket) != 0) throw Error(kerErrorMessage, "XMP not decoded");
+        };
+    }
+
+    //! XMP: n different properties added by key
+    Operation xmpByKey(long n)
+    {
+        return [n]() {
+            XmpData xmpData;
+            for (long i = 0; i < n; ++i) {
+                xmpData["Xmp.xmp.Property" + std::to_string(i)] = "v";
+            }
+        };
+    }
+
+    const Case cases[] = {
+        { "exif/byKey",        1250, exifByKey },
+        { "exif/encode",       1250, exifEncode },
+        { "exif/update",        120, exifUpdate },
+        { "exif/read",          120, exifRead },
+        { "iptc/writeRead",     500, iptcWriteRead },
+        { "iptc/findKey",       500, iptcFindKey },
+        { "xmp/encode",       12500, xmpEncode },
+        { "xmp/decode",       12500, xmpDecode },
+        { "xmp/byKey",         1250, xmpByKey },
+    };
+
+    bool selected(const char* name, int argc, char* const argv[])
+    {
+        if (argc < 2) return true;
+        for (int i = 1; i < argc; ++i) {
+            if (std::strncmp(name, argv[i], std::strlen(argv[i])) == 0) return true;
+        }
+        return false;
+    }
+
+}
+
+int main(int argc, char* const argv[])
+{
+    XmpParser::initialize();
+    LogMsg::setLevel(LogMsg::error);
+
+    int failed = 0;
+    std::printf("%-16s %8s %12s %8s %12s %8s\n", "case", "n", "time", "8n", "time", "growth");
+    for (const Case& c : cases) {
+        if (!selected(c.name_, argc, argv)) continue;
+        try {
+            const double small = measure(c.generator_(c.n_));
+            const double large = measure(c.generator_(growth * c.n_));
+            const double timeGrowth = large / small;
+            const bool ok = timeGrowth <= maxTimeGrowth;
+            if (!ok) ++failed;
+            std::printf("%-16s %8ld %10.3fms %8ld %10.3fms %8.1f%s\n", c.name_, c.n_, small * 1000,
+                        growth * c.n_, large * 1000, timeGrowth, ok ? "" : "  FAILED, not linear");
+        }
+        catch (const AnyError& e) {
+            ++failed;
+            std::printf("%-16s FAILED: %s\n", c.name_, e.what());
+        }
+    }
+
+    XmpParser::terminate();
+    return failed == 0 ? 0 : 1;
+}
@@ -30,6 +30,31 @@ if ( MINGW OR UNIX OR MSYS ) # MINGW, Linux, APPLE, CYGWIN
             set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} --coverage")
         endif()
 
+        if ( EXIV2_PGO )
+            string(TOUPPER "${EXIV2_PGO}" PGO_PHASE)
+            if ( PGO_PHASE STREQUAL "GENERATE" )
+                if ( COMPILER_IS_GCC )
+                    # The application and the library count concurrently in threads
+                    set(PGO_FLAGS "-fprofile-generate=${EXIV2_PGO_PROFILE_DIR} -fprofile-update=atomic")
+                else()
+                    set(PGO_FLAGS "-fprofile-instr-generate=${EXIV2_PGO_PROFILE_DIR}/exiv2-%p.profraw")
+                endif()
+            elseif ( PGO_PHASE STREQUAL "USE" )
+                if ( COMPILER_IS_GCC )
+                    set(PGO_FLAGS "-fprofile-use=${EXIV2_PGO_PROFILE_DIR} -fprofile-correction -Wno-missing-profile")
+                else()
+                    set(PGO_FLAGS "-fprofile-instr-use=${EXIV2_PGO_PROFILE_DIR}/exiv2.profdata -Wno-profile-instr-unprofiled -Wno-profile-instr-out-of-date")
+                endif()
+            else()
+                message(FATAL_ERROR "EXIV2_PGO must be GENERATE, USE or empty, not '${EXIV2_PGO}'")
+            endif()
+            set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${PGO_FLAGS}")
+            set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} ${PGO_FLAGS}")
+            set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} ${PGO_FLAGS}")
+            set(CMAKE_SHARED_LINKER_FLAGS "${CMAKE_SHARED_LINKER_FLAGS} ${PGO_FLAGS}")
+            set(CMAKE_MODULE_LINKER_FLAGS "${CMAKE_MODULE_LINKER_FLAGS} ${PGO_FLAGS}")
+        endif()
+
         set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -Wall -Wcast-align -Wpointer-arith -Wformat-security -Wmissing-format-attribute -Woverloaded-virtual -W")
 
         if ( EXIV2_TEAM_USE_SANITIZERS )
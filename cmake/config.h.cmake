@@ -44,6 +44,12 @@
 // Define if you have the munmap function.
 #cmakedefine EXV_HAVE_MUNMAP
 
+// Define if you have the pread function.
+#cmakedefine EXV_HAVE_PREAD
+
+// Define if you have the copy_file_range function.
+#cmakedefine EXV_HAVE_COPY_FILE_RANGE
+
 /* Define if you have the <unistd.h> header file. */
 #cmakedefine EXV_HAVE_UNISTD_H
 
@@ -73,6 +79,20 @@
 // Definition to enable translation of Nikon lens names.
 #cmakedefine EXV_HAVE_LENSDATA
 
+// Definitions of the vendor makernotes which are built, see EXIV2_MAKERNOTES.
+#cmakedefine EXV_HAVE_CANON_MAKERNOTE
+#cmakedefine EXV_HAVE_CASIO_MAKERNOTE
+#cmakedefine EXV_HAVE_FUJI_MAKERNOTE
+#cmakedefine EXV_HAVE_MINOLTA_MAKERNOTE
+#cmakedefine EXV_HAVE_NIKON_MAKERNOTE
+#cmakedefine EXV_HAVE_OLYMPUS_MAKERNOTE
+#cmakedefine EXV_HAVE_PANASONIC_MAKERNOTE
+#cmakedefine EXV_HAVE_PENTAX_MAKERNOTE
+#cmakedefine EXV_HAVE_SAMSUNG_MAKERNOTE
+#cmakedefine EXV_HAVE_SIGMA_MAKERNOTE
+#cmakedefine EXV_HAVE_SONY_MAKERNOTE
+#define EXV_MAKERNOTES "@EXV_MAKERNOTES@"
+
 // Define if you have the iconv function.
 #cmakedefine EXV_HAVE_ICONV
 
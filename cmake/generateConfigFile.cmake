@@ -8,6 +8,15 @@ endif()
 set(EXV_ENABLE_WEBREADY  ${EXIV2_ENABLE_WEBREADY})
 set(EXV_HAVE_LENSDATA    ${EXIV2_ENABLE_LENSDATA})
 set(EXV_HAVE_PRINTUCS2   ${EXIV2_ENABLE_PRINTUCS2})
+foreach(vendor ${EXIV2_ALL_MAKERNOTES})
+    string(TOUPPER ${vendor} VENDOR)
+    if ("${vendor}" IN_LIST EXIV2_MAKERNOTES)
+        set(EXV_HAVE_${VENDOR}_MAKERNOTE ON)
+    else()
+        set(EXV_HAVE_${VENDOR}_MAKERNOTE OFF)
+    endif()
+endforeach()
+string(REPLACE ";" " " EXV_MAKERNOTES "${EXIV2_MAKERNOTES}")
 
 set(EXV_PACKAGE_NAME     ${PROJECT_NAME})
 set(EXV_PACKAGE_VERSION  ${PROJECT_VERSION})
@@ -25,6 +34,8 @@ set(EXV_UNICODE_PATH     ${EXIV2_ENABLE_WIN_UNICODE})
 check_function_exists( gmtime_r EXV_HAVE_GMTIME_R )
 check_function_exists( mmap     EXV_HAVE_MMAP )
 check_function_exists( munmap   EXV_HAVE_MUNMAP )
+check_function_exists( pread    EXV_HAVE_PREAD )
+check_function_exists( copy_file_range EXV_HAVE_COPY_FILE_RANGE )
 check_function_exists( strerror_r   EXV_HAVE_STRERROR_R )
 
 check_cxx_source_compiles( "
@@ -0,0 +1,115 @@
+# Profile-guided optimization build, run by the exiv2-pgo target:
+#
+#   cmake -DSOURCE_DIR=<source> -DBINARY_DIR=<build> -DGENERATOR=<generator>
+#         -DCOMPILER_ID=<GNU|Clang> -DCOMPILER_VERSION=<version>
+#         [-DCXX_COMPILER=<c++>] [-DC_COMPILER=<cc>] [-DBENCHMARKS=ON]
+#         -P pgoBuild.cmake
+#
+# Builds instrumented binaries in BINARY_DIR, trains them with the images of
+# test/data and the benchmarks, then rebuilds them in the same tree with the
+# collected profile. Both builds use the same tree, GCC finds the profile of
+# each object by its path.
+
+cmake_minimum_required( VERSION 3.6 )
+
+foreach(var SOURCE_DIR BINARY_DIR GENERATOR COMPILER_ID)
+    if (NOT ${var})
+        message(FATAL_ERROR "pgoBuild.cmake: ${var} is not set")
+    endif()
+endforeach()
+
+set(PROFILE_DIR  "${BINARY_DIR}/profile")
+set(TRAINING_DIR "${BINARY_DIR}/training")
+if (NOT BENCHMARKS)
+    set(BENCHMARKS OFF)
+endif()
+
+function(pgo_run)
+    execute_process(COMMAND ${ARGN} WORKING_DIRECTORY "${BINARY_DIR}" RESULT_VARIABLE rc)
+    if (rc)
+        message(FATAL_ERROR "pgoBuild.cmake: '${ARGN}' failed: ${rc}")
+    endif()
+endfunction()
+
+function(pgo_build phase)
+    message(STATUS "exiv2-pgo: ${phase} build in ${BINARY_DIR}")
+    set(compilers)
+    if (CXX_COMPILER)
+        list(APPEND compilers "-DCMAKE_CXX_COMPILER=${CXX_COMPILER}")
+    endif()
+    if (C_COMPILER)
+        list(APPEND compilers "-DCMAKE_C_COMPILER=${C_COMPILER}")
+    endif()
+    pgo_run("${CMAKE_COMMAND}" "${SOURCE_DIR}" -G "${GENERATOR}" ${compilers}
+            -DCMAKE_BUILD_TYPE=Release
+            -DEXIV2_PGO=${phase}
+            -DEXIV2_PGO_PROFILE_DIR=${PROFILE_DIR}
+            -DEXIV2_BUILD_EXIV2_COMMAND=ON
+            -DEXIV2_BUILD_SAMPLES=OFF
+            -DEXIV2_BUILD_UNIT_TESTS=OFF
+            -DEXIV2_BUILD_BENCHMARKS=${BENCHMARKS})
+    pgo_run("${CMAKE_COMMAND}" --build . --config Release --parallel)
+endfunction()
+
+# Run the application, the corpus contains files which it rejects
+function(pgo_train)
+    execute_process(COMMAND "${EXIV2}" ${ARGN} WORKING_DIRECTORY "${TRAINING_DIR}"
+                    OUTPUT_QUIET ERROR_QUIET TIMEOUT 60)
+endfunction()
+
+file(MAKE_DIRECTORY "${BINARY_DIR}")
+file(REMOVE_RECURSE "${PROFILE_DIR}" "${TRAINING_DIR}")
+file(MAKE_DIRECTORY "${PROFILE_DIR}" "${TRAINING_DIR}")
+
+pgo_build(GENERATE)
+
+# Training: print, modify and extract the previews of representative images,
+# i.e., without the proofs of concept of security issues
+find_program(EXIV2 exiv2 PATHS "${BINARY_DIR}/bin" NO_DEFAULT_PATH)
+if (NOT EXIV2)
+    message(FATAL_ERROR "pgoBuild.cmake: the exiv2 application was not built")
+endif()
+set(extensions jpg jpeg tif tiff dng nef cr2 crw orf rw2 pef arw mrw raf png webp psd jp2 pgf gif exv)
+set(corpus)
+foreach(ext ${extensions})
+    file(GLOB files "${SOURCE_DIR}/test/data/*.${ext}")
+    list(APPEND corpus ${files})
+endforeach()
+list(FILTER corpus EXCLUDE REGEX "[Pp][Oo][Cc]|crash|fuzz")
+list(LENGTH corpus count)
+message(STATUS "exiv2-pgo: training with ${count} files")
+foreach(file ${corpus})
+    get_filename_component(name "${file}" NAME)
+    file(COPY "${file}" DESTINATION "${TRAINING_DIR}")
+    pgo_train(-pa "${name}")
+    pgo_train(-pp "${name}")
+    pgo_train(-M "set Exif.Image.Artist exiv2-pgo" -M "set Iptc.Application2.Caption exiv2-pgo"
+              -M "set Xmp.dc.subject exiv2-pgo" "${name}")
+    pgo_train(-ep -f "${name}")
+    file(REMOVE_RECURSE "${TRAINING_DIR}")
+    file(MAKE_DIRECTORY "${TRAINING_DIR}")
+endforeach()
+
+find_program(BENCHMARK exiv2_benchmarks PATHS "${BINARY_DIR}/bin" NO_DEFAULT_PATH)
+if (BENCHMARK)
+    message(STATUS "exiv2-pgo: running the benchmarks")
+    pgo_run("${BENCHMARK}" --benchmark_min_time=0.01)
+endif()
+
+# Clang writes raw profiles which are merged for the optimized build
+if (COMPILER_ID MATCHES "Clang")
+    string(REGEX MATCH "[0-9]+" major "${COMPILER_VERSION}")
+    find_program(LLVM_PROFDATA NAMES llvm-profdata llvm-profdata-${major} xcrun)
+    if (NOT LLVM_PROFDATA)
+        message(FATAL_ERROR "pgoBuild.cmake: llvm-profdata not found")
+    endif()
+    file(GLOB profiles "${PROFILE_DIR}/*.profraw")
+    if (LLVM_PROFDATA MATCHES "xcrun$")
+        pgo_run("${LLVM_PROFDATA}" llvm-profdata merge -o "${PROFILE_DIR}/exiv2.profdata" ${profiles})
+    else()
+        pgo_run("${LLVM_PROFDATA}" merge -o "${PROFILE_DIR}/exiv2.profdata" ${profiles})
+    endif()
+endif()
+
+pgo_build(USE)
+message(STATUS "exiv2-pgo: optimized binaries are in ${BINARY_DIR}/bin and ${BINARY_DIR}/lib")
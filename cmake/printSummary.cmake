@@ -46,6 +46,7 @@ endif()
 OptionOutput( "Native language support:            " EXIV2_ENABLE_NLS                )
 OptionOutput( "Conversion of Windows XP tags:      " EXIV2_ENABLE_PRINTUCS2          )
 OptionOutput( "Nikon lens database:                " EXIV2_ENABLE_LENSDATA           )
+message( STATUS "Vendor makernotes:                  ${EXIV2_MAKERNOTES}" )
 OptionOutput( "Building webready support:          " EXIV2_ENABLE_WEBREADY           )
 if    ( EXIV2_ENABLE_WEBREADY )
     OptionOutput( "USE Libcurl for HttpIo:             " EXIV2_ENABLE_CURL           )
@@ -59,6 +60,7 @@ OptionOutput( "Building exiv2 command:             " EXIV2_BUILD_EXIV2_COMMAND
 OptionOutput( "Building samples:                   " EXIV2_BUILD_SAMPLES             )
 OptionOutput( "Building PO files:                  " EXIV2_BUILD_PO                  )
 OptionOutput( "Building unit tests:                " EXIV2_BUILD_UNIT_TESTS          )
+OptionOutput( "Building benchmarks:                " EXIV2_BUILD_BENCHMARKS          )
 OptionOutput( "Building doc:                       " EXIV2_BUILD_DOC                 )
 OptionOutput( "Building with coverage flags:       " BUILD_WITH_COVERAGE             )
 OptionOutput( "Using ccache:                       " BUILD_WITH_CCACHE               )
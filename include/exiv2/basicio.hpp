@@ -30,7 +30,10 @@
 #include "types.hpp"
 
 // + standard includes
+#include <atomic>
 #include <memory>       // for std::auto_ptr
+#include <utility>
+#include <vector>
 
 // The way to handle data from stdin or data uri path. If EXV_XPATH_MEMIO = 1,
 // it uses MemIo. Otherwises, it uses FileIo.
@@ -45,6 +48,65 @@ namespace Exiv2 {
 // *****************************************************************************
 // class definitions
 
+    /*!
+      @brief Counters of the work done through a BasicIo, see BasicIo::stats().
+
+      The DataBuf allocations and the times of the decoding and writing
+      phases are added to the stats of the BasicIo which an IoCloser holds
+      in the current thread at the time, that is, usually to the BasicIo of
+      the image which reads or writes its metadata. BasicIo::transfer()
+      moves the write counters of the source, so that the writes to a
+      temporary BasicIo count for the one which receives the data.
+     */
+    struct EXIV2API IoStats {
+        //! Default constructor, all counters are 0
+        IoStats();
+        //! Add the counters of \em rhs to this object
+        IoStats& operator+=(const IoStats& rhs);
+
+        uint64_t reads_;                //!< Number of read, readView, readAt and getb calls
+        uint64_t bytesRead_;            //!< Bytes returned by these calls
+        uint64_t writes_;               //!< Number of write and putb calls
+        uint64_t bytesWritten_;         //!< Bytes written by these calls
+        uint64_t seeks_;                //!< Number of seek calls
+        uint64_t mmaps_;                //!< Number of mmap calls
+        uint64_t remoteRequests_;       //!< Round trips to the remote machine of a RemoteIo
+        uint64_t allocations_;          //!< Number of DataBuf allocations
+        uint64_t bytesAllocated_;       //!< Bytes allocated by DataBuf
+        double   tiffDecodeTime_;       //!< Seconds spent decoding TIFF structures
+        double   xmpDecodeTime_;        //!< Seconds spent in XmpParser::decode()
+        double   writeMetadataTime_;    //!< Seconds spent in Image::writeMetadata()
+        //! Heap memory held by the metadata of the images when they are destroyed, see Image::memoryUsage()
+        MemoryUsage metadataMemory_;
+    };
+
+    /*!
+      @brief Limits of the work which the parsers may do on the data of a
+             BasicIo, see BasicIo::setParseLimits().
+
+      The limits apply to each open of the BasicIo by an IoCloser, usually
+      to each call of Image::readMetadata() or Image::writeMetadata(). A
+      parser which exceeds one of them throws an Error with the code
+      kerResourceLimitExceeded instead of going on. A limit of 0 means
+      unlimited, which is the default for all of them.
+     */
+    struct EXIV2API ParseLimits {
+        //! Default constructor, no limits
+        ParseLimits();
+        //! Return true if any of the limits is set
+        bool limited() const;
+
+        uint64_t maxIfdEntries_;        //!< Entries of a single TIFF IFD
+        uint64_t maxDepth_;             //!< Nesting depth of the TIFF IFDs
+        uint64_t maxAllocation_;        //!< Total bytes allocated by DataBuf and the XMP parser
+        uint64_t maxInflatedSize_;      //!< Size of a single zlib inflated buffer
+        uint64_t timeoutMs_;            //!< Wall-clock time in milliseconds
+    };
+
+    namespace Internal {
+        class ParseBudget;
+    }
+
     /*!
       @brief An interface for simple binary IO.
 
@@ -59,6 +121,8 @@ namespace Exiv2 {
 
         //! Seek starting positions
         enum Position { beg, cur, end };
+        //! How the IO source is about to be read, see advise()
+        enum AccessPattern { normalAccess, randomAccess, sequentialAccess };
 
         //! @name Creators
         //@{
@@ -110,6 +174,18 @@ namespace Exiv2 {
               0 if failure;
          */
         virtual long write(BasicIo& src) = 0;
+        /*!
+          @brief Write several pieces of data to the IO source in one call,
+              e.g. the marker, the header and the payload of a segment.
+              Current IO position is advanced by the number of bytes
+              written. The default implementation writes the pieces one
+              after the other and stops at the first short write.
+          @param pieces Array of (pointer, size) pairs of the data to write
+          @param count Number of pieces
+          @return Number of bytes written to IO source successfully;<BR>
+              0 if failure;
+         */
+        virtual long writev(const std::pair<const byte*, long>* pieces, size_t count);
         /*!
           @brief Write one byte to the IO source. Current IO position is
               advanced by one byte.
@@ -142,6 +218,56 @@ namespace Exiv2 {
               0 if failure;
          */
         virtual long read(byte* buf, long rcount) = 0;
+        /*!
+          @brief Read data from the IO source without copying it, if
+              possible. Reading starts at the current IO position and the
+              position is advanced by \em rcount bytes.
+
+          IO sources whose data is accessible in memory return a pointer
+          directly into that memory. Others read the data into \em buf,
+          which is reallocated as needed, and return a pointer to it. The
+          returned data is only valid until the IO source or \em buf are
+          modified, or the IO source is closed.
+          @param buf Buffer to use if the data cannot be accessed directly.
+          @param rcount Number of bytes to read.
+          @return Pointer to \em rcount bytes of data;<BR>
+              0 if fewer than \em rcount bytes are available or on failure;
+         */
+        virtual const byte* readView(DataBuf& buf, long rcount);
+        /*!
+          @brief Read data from the IO source at the absolute position
+              \em offset. The current IO position is not changed.
+
+          The default implementation saves the IO position, seeks to
+          \em offset, reads and restores the position. IO sources which
+          can read positionally override it to avoid the seeks.
+          @param offset Position in the IO source to start reading from.
+          @param buf Pointer to a block of memory into which the read data
+              is stored. The memory block must be at least \em rcount bytes
+              long.
+          @param rcount Maximum number of bytes to read. Fewer bytes may be
+              read if \em rcount bytes are not available.
+          @return Number of bytes read from IO source successfully;<BR>
+              0 if failure;
+         */
+        virtual long readAt(long offset, byte* buf, long rcount);
+        /*!
+          @brief Hint that the given byte ranges are about to be read.
+
+          IO sources with an expensive round trip per read fetch all ranges
+          together, so that the reads which follow are served from memory.
+          The default implementation does nothing.
+          @param ranges Pairs of (offset, size) in the IO source. Ranges
+              beyond the end of the IO source are ignored.
+         */
+        virtual void prefetch(const std::vector<std::pair<long, long> >& ranges);
+        /*!
+          @brief Hint how the whole IO source is about to be read: in small
+              reads at scattered offsets, e.g., the directories of a TIFF
+              image, or from start to end, e.g., when it is copied. The
+              default implementation does nothing.
+         */
+        virtual void advise(AccessPattern pattern);
         /*!
           @brief Read one byte from the IO source. Current IO position is
               advanced by one byte.
@@ -194,6 +320,10 @@ namespace Exiv2 {
                   Nonzero if failure;
          */
         virtual int munmap() =0;
+        //! Return the counters of the work done through this object, e.g., to reset them
+        IoStats& stats() { return stats_; }
+        //! Set the limits of the work which the parsers may do on each open
+        void setParseLimits(const ParseLimits& limits) { parseLimits_ = limits; }
 
         //@}
 
@@ -217,6 +347,12 @@ namespace Exiv2 {
         virtual int error() const = 0;
         //!Returns true if the IO position has reached the end, otherwise false.
         virtual bool eof() const = 0;
+        /*!
+          @brief Return true if prefetch() fetches the ranges ahead of the
+              reads. Readers only work out the ranges to prefetch if it
+              does. The default implementation returns false.
+         */
+        virtual bool prefetches() const;
         /*!
           @brief Return the path to the IO resource. Often used to form
               comprehensive error messages where only a BasicIo instance is
@@ -239,6 +375,10 @@ namespace Exiv2 {
                 are all downloaded from the remote file to memory.
          */
         virtual void populateFakeData() {}
+        //! Return the counters of the work done through this object
+        const IoStats& stats() const { return stats_; }
+        //! Return the limits of the work which the parsers may do on each open
+        const ParseLimits& parseLimits() const { return parseLimits_; }
 
         /*!
           @brief this is allocated and populated by mmap()
@@ -253,6 +393,12 @@ namespace Exiv2 {
         //! Default Constructor
         BasicIo() : bigBlock_(nullptr) {};
         //@}
+
+        // DATA
+        //! Counters of the work done, updated by the subclasses
+        IoStats stats_;
+        //! Limits of the parsers, installed by IoCloser
+        ParseLimits parseLimits_;
     }; // class BasicIo
 
     /*!
@@ -265,10 +411,15 @@ namespace Exiv2 {
     public:
         //! @name Creators
         //@{
-        //! Constructor, takes a BasicIo reference
-        explicit IoCloser(BasicIo& bio) : bio_(bio) {}
+        /*!
+          @brief Constructor, takes a BasicIo reference. Until the object is
+              destroyed, DataBuf allocations and phase times in the current
+              thread are added to the stats of \em bio, and if \em bio has
+              parse limits, the parsers of the thread are held to them.
+         */
+        explicit IoCloser(BasicIo& bio);
         //! Destructor, closes the BasicIo reference
-        virtual ~IoCloser() { close(); }
+        virtual ~IoCloser();
         //@}
 
         //! @name Manipulators
@@ -282,6 +433,11 @@ namespace Exiv2 {
         BasicIo& bio_;
 
     private:
+        //! The stats which were current in the thread before
+        IoStats* previous_;
+        //! The budget of the parse limits of \em bio, if it has any
+        std::unique_ptr<Internal::ParseBudget> budget_;
+
         // Not implemented
         //! Copy constructor
         IoCloser(const IoCloser&);
@@ -289,6 +445,35 @@ namespace Exiv2 {
         IoCloser& operator=(const IoCloser&);
     }; // class IoCloser
 
+    /*!
+      @brief Utility class that adds the stats of each BasicIo instance which
+          is destroyed in the current thread to an IoStats object, for the
+          lifetime of the collector. Meant to be used as a stack variable
+          around the processing of a file, to collect the stats of all the
+          IO sources used on the way. The collector which was active before
+          is restored on destruction.
+     */
+    class EXIV2API IoStatsCollector {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor, takes the IoStats to add to
+        explicit IoStatsCollector(IoStats& stats);
+        //! Destructor, restores the collector which was active before
+        ~IoStatsCollector();
+        //@}
+
+    private:
+        //! The stats which were collected to before
+        IoStats* previous_;
+
+        // Not implemented
+        //! Copy constructor
+        IoStatsCollector(const IoStatsCollector&);
+        //! Assignment operator
+        IoStatsCollector& operator=(const IoStatsCollector&);
+    }; // class IoStatsCollector
+
     /*!
       @brief Provides binary file IO by implementing the BasicIo
           interface.
@@ -361,12 +546,21 @@ namespace Exiv2 {
           @brief Write data that is read from another BasicIo instance to
               the file. The file position is advanced by the number
               of bytes written.
+
+          If \em src is another file, the data is copied by the kernel
+          where copy_file_range() is available. If it is a MemIo, the data
+          is written directly from its memory block.
           @param src Reference to another BasicIo instance. Reading start
               at the source's current IO position
           @return Number of bytes written to the file successfully;<BR>
                  0 if failure;
          */
         long write(BasicIo& src) override;
+        /*!
+          @brief Write several pieces of data to the file with a single
+              switch to writing, see BasicIo::writev().
+         */
+        long writev(const std::pair<const byte*, long>* pieces, size_t count) override;
         /*!
           @brief Write one byte to the file. The file position is
               advanced by one byte.
@@ -399,6 +593,31 @@ namespace Exiv2 {
                  0 if failure;
          */
         long read(byte* buf, long rcount) override;
+        /*!
+          @brief Read data from the file without copying it. On platforms
+              with mmap(), a file opened read-only is mapped into memory on
+              the first call and a pointer into the mapped area is returned.
+              Otherwise the data is read into \em buf.
+         */
+        const byte* readView(DataBuf& buf, long rcount) override;
+        /*!
+          @brief Read data from the file at position \em offset without
+              changing the file position. Uses the mapped area if the file
+              is mapped and pread() where available.
+         */
+        long readAt(long offset, byte* buf, long rcount) override;
+        /*!
+          @brief Ask the kernel to read the ranges ahead if read-ahead is
+              enabled, see setReadAhead(). All ranges are queued at once
+              and read concurrently, the call does not wait for them.
+         */
+        void prefetch(const std::vector<std::pair<long, long> >& ranges) override;
+        /*!
+          @brief Pass the access pattern to the kernel if read-ahead is
+              enabled, see setReadAhead(). Random access turns the read-ahead
+              of the kernel off, sequential access makes it more aggressive.
+         */
+        void advise(AccessPattern pattern) override;
         /*!
           @brief Read one byte from the file. The file position is
               advanced by one byte.
@@ -416,6 +635,10 @@ namespace Exiv2 {
           method returns. This method exists primarily to be used with
           the BasicIo::temporary() method.
 
+          If atomic transfers are enabled, data which is not in another file
+          is written to a new file next to the file, which is then renamed
+          over it, see setAtomicTransfer().
+
           @note If the caller doesn't have permissions to write to the file,
               an exception is raised and \em src is deleted.
 
@@ -470,9 +693,35 @@ namespace Exiv2 {
          */
         virtual void setPath(const std::wstring& wpath);
 #endif
+        /*!
+          @brief Choose how transfer() replaces the file with data which is
+              not in another file.
+
+          By default, the file is truncated and the data is copied into it.
+          With \em flag true, the data is written to a new file next to the
+          file, which gets the mode, the owner and the extended attributes of
+          the file where permitted and is then renamed over it. The file is
+          never left half written, but it gets a new inode. Symbolic links,
+          files with several hard links and files in a directory in which no
+          new file can be created are still copied into.
+         */
+        void setAtomicTransfer(bool flag);
+        /*!
+          @brief Enable or disable read-ahead of the ranges passed to
+              prefetch() and the access pattern hints of advise(). It is
+              disabled by default, as it only pays off
+              if the file is not in the page cache yet, e.g. on a cold
+              read of large raw files from fast storage. Read-ahead is
+              only available where the platform has posix_fadvise().
+         */
+        void setReadAhead(bool flag);
         //@}
         //! @name Accessors
         //@{
+        //! Return true if transfer() replaces the file by renaming a new file over it
+        bool atomicTransfer() const;
+        //! Return true if read-ahead is enabled and supported
+        bool prefetches() const override;
         /*!
           @brief Get the current file position.
           @return Offset from the start of the file if successful;<BR>
@@ -585,13 +834,19 @@ namespace Exiv2 {
           @brief Write data that is read from another BasicIo instance to
               the memory block. If needed, the size of the internal memory
               block is expanded. The IO position is advanced by the number
-              of bytes written.
+              of bytes written. If the size of \em src is known, the data
+              is read directly into the memory block.
           @param src Reference to another BasicIo instance. Reading start
               at the source's current IO position
           @return Number of bytes written to the memory block successfully;<BR>
                  0 if failure;
          */
         long write(BasicIo& src) override;
+        /*!
+          @brief Write several pieces of data to the memory block, which
+              is expanded at most once, see BasicIo::writev().
+         */
+        long writev(const std::pair<const byte*, long>* pieces, size_t count) override;
         /*!
           @brief Write one byte to the memory block. The IO position is
               advanced by one byte.
@@ -624,6 +879,16 @@ namespace Exiv2 {
                  0 if failure;
          */
         long read(byte* buf, long rcount) override;
+        /*!
+          @brief Read data from the memory block without copying it. Returns a
+              pointer into the memory block.
+         */
+        const byte* readView(DataBuf& buf, long rcount) override;
+        /*!
+          @brief Read data from the memory block at position \em offset
+              without changing the IO position.
+         */
+        long readAt(long offset, byte* buf, long rcount) override;
         /*!
           @brief Read one byte from the memory block. The IO position is
               advanced by one byte.
@@ -670,6 +935,17 @@ namespace Exiv2 {
          */
         byte* mmap(bool /*isWriteable*/ =false) override;
         int munmap() override;
+        /*!
+          @brief Allocate memory for at least \em capacity bytes of data.
+
+          Writing up to \em capacity bytes then does not need to reallocate
+          the memory block. Use this with the expected size of the data, e.g.,
+          the size of the source image when a new image is written, to avoid
+          copying the data each time the block is expanded. The size and the
+          data of the memory block and the IO position do not change.
+          @param capacity Number of bytes to allocate memory for.
+         */
+        void reserve(long capacity);
         //@}
 
         //! @name Accessors
@@ -823,6 +1099,144 @@ namespace Exiv2 {
     }; // class XPathIo
 #endif
 
+    /*!
+      @brief Token to cancel the requests of RemoteIo instances from another
+          thread, e.g., when the caller gives up on a slow server. It is
+          shared with std::shared_ptr by the thread which cancels and the
+          RemoteIo instances, see RemoteOptions.
+     */
+    class EXIV2API CancelToken {
+    public:
+        //! Constructor, not cancelled
+        CancelToken() : cancelled_(false) {}
+        //! Cancel the requests in progress and all the following ones. Thread-safe.
+        void cancel() { cancelled_.store(true); }
+        //! Return true once cancel() has been called. Thread-safe.
+        bool cancelled() const { return cancelled_.load(); }
+
+    private:
+        std::atomic<bool> cancelled_;
+    }; // class CancelToken
+
+    /*!
+      @brief Options of the requests of a RemoteIo, see
+          RemoteIo::setRemoteOptions() and ImageFactory::open().
+
+      A request which is cancelled or reaches the deadline fails with an
+      Error with the code kerRemoteRequestStopped, so do all the requests
+      which follow. HttpIo checks them while it waits for the socket, CurlIo
+      from the progress callback of libcurl, which is called at least once
+      per second, and all RemoteIo classes before each request.
+     */
+    struct EXIV2API RemoteOptions {
+        //! Default constructor, no token and no deadline
+        RemoteOptions() : timeoutMs_(0) {}
+
+        std::shared_ptr<CancelToken> cancel_;   //!< Token to cancel the requests, may be empty
+        long timeoutMs_;                        //!< Time for all the requests in milliseconds, 0 for no deadline
+    };
+
+    /*!
+      @brief Interface of a process-wide cache for the blocks of remote files.
+
+      RemoteIo consults the cache set with RemoteIo::setBlockCache() before it
+      requests a block from the server and stores every block it fetches. The
+      key identifies one revision of a remote file: it is made from the URL,
+      the file size, the block size and the ETag or Last-Modified value the
+      server reported. Files for which the server reports neither are not
+      cached. Implementations must be thread-safe.
+     */
+    class EXIV2API RemoteBlockCache {
+    public:
+        //! Virtual destructor.
+        virtual ~RemoteBlockCache() {}
+        /*!
+          @brief Look up a block.
+          @param key Identifies the remote file revision.
+          @param block Index of the block in the remote file.
+          @param data Receives the content of the block.
+          @return true if the block was found, else false.
+         */
+        virtual bool get(const std::string& key, size_t block, std::string& data) = 0;
+        /*!
+          @brief Store a block.
+          @param key Identifies the remote file revision.
+          @param block Index of the block in the remote file.
+          @param data The content of the block.
+         */
+        virtual void put(const std::string& key, size_t block, const std::string& data) = 0;
+    }; // class RemoteBlockCache
+
+    /*!
+      @brief RemoteBlockCache that keeps the blocks in memory. When the blocks
+          exceed the capacity, the least recently used blocks are dropped.
+     */
+    class EXIV2API MemoryBlockCache : public RemoteBlockCache {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor.
+          @param capacity Maximum number of bytes of block data to keep.
+         */
+        explicit MemoryBlockCache(size_t capacity = 16 * 1024 * 1024);
+        //! Destructor. Releases all cached blocks.
+        ~MemoryBlockCache() override;
+        //@}
+
+        //! @name Manipulators
+        //@{
+        bool get(const std::string& key, size_t block, std::string& data) override;
+        void put(const std::string& key, size_t block, const std::string& data) override;
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the number of bytes of block data currently cached.
+        size_t size() const;
+        //@}
+
+        // NOT IMPLEMENTED
+        MemoryBlockCache(const MemoryBlockCache& rhs) = delete;
+        MemoryBlockCache& operator=(const MemoryBlockCache& rhs) = delete;
+
+    private:
+        // Pimpl idiom
+        class Impl;
+        Impl* p_;
+    }; // class MemoryBlockCache
+
+    /*!
+      @brief RemoteBlockCache that keeps every block in a file of its own in a
+          directory, so that the blocks survive the process. The directory must
+          exist. Nothing is ever evicted, removing the files clears the cache.
+     */
+    class EXIV2API FileBlockCache : public RemoteBlockCache {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor.
+          @param directory Path of the directory the blocks are stored in.
+         */
+        explicit FileBlockCache(const std::string& directory);
+        //@}
+
+        //! @name Manipulators
+        //@{
+        bool get(const std::string& key, size_t block, std::string& data) override;
+        void put(const std::string& key, size_t block, const std::string& data) override;
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the path of the file that holds \em block of \em key.
+        std::string blockPath(const std::string& key, size_t block) const;
+        //@}
+
+    private:
+        std::string directory_;
+    }; // class FileBlockCache
 
     /*!
         @brief Provides remote binary file IO by implementing the BasicIo interface. This is an
@@ -908,6 +1322,19 @@ namespace Exiv2 {
                 0 if failure;
         */
        long read(byte* buf, long rcount) override;
+       /*!
+         @brief Read data from the memory blocks at position \em offset
+             without changing the IO position. Blocks which are not yet
+             populated are fetched from the server.
+        */
+       long readAt(long offset, byte* buf, long rcount) override;
+       /*!
+         @brief Populate the memory blocks covering \em ranges. Adjacent
+             missing blocks are coalesced into one range request and the
+             requests are sent concurrently where the protocol allows it.
+             Failures are ignored, the blocks are then fetched on demand.
+        */
+       void prefetch(const std::vector<std::pair<long, long> >& ranges) override;
        /*!
          @brief Read one byte from the memory blocks. The IO position is
              advanced by one byte.
@@ -975,6 +1402,8 @@ namespace Exiv2 {
        int error() const override;
        //!Returns true if the IO position has reached the end, otherwise false.
        bool eof() const override;
+       //!Always returns true, the reads of remote files are served from the fetched blocks
+       bool prefetches() const override;
        //!Returns the URL of the file.
        std::string path() const override;
 #ifdef EXV_UNICODE_PATH
@@ -996,6 +1425,21 @@ namespace Exiv2 {
 
        //@}
 
+        /*!
+          @brief Set the block cache shared by all RemoteIo instances. Pass 0
+              to stop caching, which is the default.
+          @param cache The cache. It is not owned and must stay alive as long
+              as it is set.
+         */
+        static void setBlockCache(RemoteBlockCache* cache);
+        //! Return the block cache, 0 if none is set.
+        static RemoteBlockCache* blockCache();
+        /*!
+          @brief Set the cancellation token and the deadline of the requests.
+              The deadline is \em options.timeoutMs_ from this call on.
+         */
+        void setRemoteOptions(const RemoteOptions& options);
+
     protected:
         //! @name Creators
         //@{
@@ -1090,6 +1534,14 @@ namespace Exiv2 {
                 for the protocol. Otherwise, it throws the Error.
          */
         long write(BasicIo& src);
+        /*!
+          @brief Fetch the block ranges of RemoteIo::prefetch() concurrently
+              with curl multi instead of one after the other. Off by default.
+
+          All CurlIo instances share the DNS cache, the TLS sessions and the
+          connections of libcurl, whether this is enabled or not.
+         */
+        static void setParallelFetch(bool enable);
     protected:
         // NOT IMPLEMENTED
         //! Copy constructor
@@ -0,0 +1,140 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    batch.hpp
+  @brief   Parallel reading of the metadata of many image files
+ */
+#ifndef BATCH_HPP_
+#define BATCH_HPP_
+
+// *****************************************************************************
+#include "exiv2lib_export.h"
+
+// included header files
+#include "error.hpp"
+#include "metadatum.hpp"
+
+// + standard includes
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+
+    class Image;
+
+// *****************************************************************************
+// class definitions
+
+    /*!
+      @brief Reads the metadata of many image files in parallel and passes
+             each image to a callback.
+
+      The thread which calls run() is the I/O stage: it takes the paths
+      from the source, opens the images, which detects their type and asks
+      the system to read the leading part of the files ahead, and queues
+      them. The worker threads are the CPU stage: each reads the metadata of
+      the images of its queue and calls the callback. A worker whose queue
+      is empty takes the newest image of another queue. At most
+      prefetch() images are opened ahead of the workers.
+
+      The XMP toolkit is initialized before the workers start. Errors are
+      reported per file in the results of run(), they do not stop the batch.
+      The log messages of a file, from opening it to the end of the
+      callback, are collected by a LogMsg::Scope and returned with its
+      result instead of being passed to the log message handler.
+     */
+    class EXIV2API BatchProcessor {
+    public:
+        //! Outcome of the processing of one file
+        struct Result {
+            std::string path_;                  //!< Path of the file
+            ErrorCode code_;                    //!< kerSuccess or the code of the error of the file
+            std::string message_;               //!< Error message, empty on success
+            LogMsg::Messages messages_;         //!< Log messages of the file, see LogMsg::Scope
+        };
+        //! List of the results, in the order of the files
+        typedef std::vector<Result> Results;
+        /*!
+          @brief Function called with each image after its metadata was read.
+                 It is called by several threads at the same time, for
+                 different images. An exception it throws is the error of
+                 the file.
+         */
+        typedef std::function<void(Image& image)> Callback;
+        //! Function which sets the path of the next file and returns true, or returns false at the end
+        typedef std::function<bool(std::string& path)> PathSource;
+
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor, for a batch with \em threads worker threads, as
+                 many as the system runs concurrently if it is 0.
+         */
+        explicit BatchProcessor(unsigned int threads =0);
+        //! Destructor
+        ~BatchProcessor();
+        BatchProcessor(const BatchProcessor& rhs) = delete;
+        BatchProcessor& operator=(const BatchProcessor& rhs) = delete;
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Set the decode filter of the images, see Image::setDecodeFilter()
+        void setDecodeFilter(const DecodeFilter& filter);
+        //! Set the number of images which may be opened ahead of the workers, 0 for the default
+        void setPrefetch(size_t count);
+        /*!
+          @brief Read the metadata of the files \em paths and call \em callback
+                 with each image.
+          @return The result of each file, in the order of \em paths
+         */
+        Results run(const std::vector<std::string>& paths, const Callback& callback);
+        /*!
+          @brief Read the metadata of the files which \em source returns and
+                 call \em callback with each image. The source is only called
+                 by the calling thread.
+          @return The result of each file, in the order of the source
+          @throw Any exception thrown by \em source, after the images opened
+                 before have been processed
+         */
+        Results run(const PathSource& source, const Callback& callback);
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the number of worker threads
+        unsigned int threads() const;
+        //! Return the number of images which may be opened ahead of the workers, twice the threads by default
+        size_t prefetch() const;
+        //@}
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> p_;
+
+    }; // class BatchProcessor
+
+}                                       // namespace Exiv2
+
+#endif                                  // #ifndef BATCH_HPP_
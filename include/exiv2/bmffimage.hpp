@@ -0,0 +1,150 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    bmffimage.hpp
+  @brief   ISO base media file format (BMFF) images: HEIF/HEIC, AVIF and
+           Canon CR3
+ */
+#ifndef BMFFIMAGE_HPP_
+#define BMFFIMAGE_HPP_
+
+// *****************************************************************************
+#include "exiv2lib_export.h"
+
+// included header files
+#include "image.hpp"
+#include "basicio.hpp"
+#include "types.hpp"
+
+// + standard includes
+#include <string>
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+
+// *****************************************************************************
+// class definitions
+
+    // Add BMFF to the supported image formats
+    namespace ImageType {
+        const int bmff = 19;        //!< BMFF image type (see class BmffImage)
+    }
+
+    /*!
+      @brief Class to access images in the ISO base media file format, i.e.,
+          HEIF/HEIC, AVIF and Canon CR3 images. The metadata is read only.
+
+      readMetadata() walks the boxes of the file by their headers and reads
+      only the payloads which hold metadata, at their positions with
+      BasicIo::readAt(), after announcing them with BasicIo::prefetch(). The
+      media data is never read, which keeps remote files cheap to read.
+
+      In HEIF and AVIF images, the Exif and XMP are items of the \c meta box,
+      located through its \c iinf and \c iloc boxes. The pixel size and the
+      ICC profile are the \c ispe and \c colr properties of the primary item.
+      In CR3 images, the TIFF structures of the \c CMT1 to \c CMT4 boxes in
+      the Canon box of \c moov hold IFD0, the Exif IFD, the Canon makernote
+      and the GPS IFD, and the XMP is in a top-level \c uuid box.
+     */
+    class EXIV2API BmffImage : public Image {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor to open a BMFF image. Since the constructor
+              can not return a result, callers should check the good() method
+              after object construction to determine success or failure.
+          @param io An auto-pointer that owns a BasicIo instance used for
+              reading and writing image metadata. \b Important: The constructor
+              takes ownership of the passed in BasicIo instance through the
+              auto-pointer. Callers should not continue to use the BasicIo
+              instance after it is passed to this method.  Use the Image::io()
+              method to get a temporary reference.
+          @param create Specifies if an existing image should be read (false)
+              or if a new file should be created (true). Creating BMFF images
+              is not supported.
+         */
+        BmffImage(BasicIo::UniquePtr io, bool create);
+        //@}
+
+        //! @name Manipulators
+        //@{
+        void printStructure(std::ostream& out, PrintStructureOption option,int depth) override;
+        void readMetadata() override;
+        /*!
+          @brief Not supported. Calling this function will throw an
+              Error(kerWritingImageFormatUnsupported).
+         */
+        void writeMetadata() override;
+        /*!
+          @brief Not supported. Calling this function will throw an
+              Error(kerInvalidSettingForImage).
+         */
+        void setExifData(const ExifData& exifData) override;
+        /*!
+          @brief Not supported. Calling this function will throw an
+              Error(kerInvalidSettingForImage).
+         */
+        void setIptcData(const IptcData& iptcData) override;
+        /*!
+          @brief Not supported. Calling this function will throw an
+              Error(kerInvalidSettingForImage).
+         */
+        void setComment(const std::string& comment) override;
+        //@}
+
+        //! @name Accessors
+        //@{
+        /*!
+          @brief Return the MIME type of the image, by the major brand of the
+              file, which is known after readMetadata().
+         */
+        std::string mimeType() const override;
+        //@}
+
+        BmffImage& operator=(const BmffImage& rhs) = delete;
+        BmffImage& operator=(const BmffImage&& rhs) = delete;
+        BmffImage(const BmffImage& rhs) = delete;
+        BmffImage(const BmffImage&& rhs) = delete;
+
+    private:
+        // DATA
+        uint32_t brand_;                        //!< Major brand of the file
+    };  // class BmffImage
+
+// *****************************************************************************
+// template, inline and free functions
+
+    // These could be static private functions on Image subclasses but then
+    // ImageFactory needs to be made a friend.
+    /*!
+      @brief Create a new BmffImage instance and return an auto-pointer to it.
+             Caller owns the returned object and the auto-pointer ensures that
+             it will be deleted.
+     */
+    EXIV2API Image::UniquePtr newBmffInstance(BasicIo::UniquePtr io, bool create);
+
+    //! Check if the file iIo is a BMFF image with a brand of HEIF, AVIF or CR3.
+    EXIV2API bool isBmffType(BasicIo& iIo, bool advance);
+
+}                                       // namespace Exiv2
+
+#endif                                  // #ifndef BMFFIMAGE_HPP_
@@ -37,6 +37,7 @@
 
 // + standard includes
 #include <string>
+#include <vector>
 
 // *****************************************************************************
 // namespace extensions
@@ -48,6 +49,72 @@ namespace Exiv2 {
     class IptcData;
     class XmpData;
 
+// *****************************************************************************
+// class definitions
+
+    /*!
+      @brief Reusable conversion between Exif or IPTC and XMP.
+
+      A %MetadataConverter is set up once, optionally for a subset of the
+      conversion rules and with a fixed IPTC charset, and can then be applied
+      to any number of metadata containers. Its methods are const and may be
+      called from several threads at the same time, as long as each thread
+      uses its own containers. The free conversion functions below behave
+      like a default-constructed %MetadataConverter.
+     */
+    class EXIV2API MetadataConverter {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor for all conversion rules.
+        MetadataConverter();
+        /*!
+          @brief Constructor for the conversion rules of the given keys only.
+
+          @param keys Exif, IPTC or XMP keys. A rule is used if its Exif or
+                 IPTC key or its XMP key is in the list.
+          @throw Error if a key is not valid.
+         */
+        explicit MetadataConverter(const std::vector<std::string>& keys);
+        //@}
+
+        //! @name Manipulators
+        //@{
+        /*!
+          @brief Set the charset of the IPTC datasets to convert to XMP.
+                 By default, the charset is detected for each %IptcData
+                 container, as copyIptcToXmp() does. \em iptcCharset must
+                 remain valid while the converter is used.
+         */
+        void setIptcCharset(const char* iptcCharset);
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Convert (copy) Exif tags to XMP properties.
+        void copyExifToXmp(const ExifData& exifData, XmpData& xmpData) const;
+        //! Convert (move) Exif tags to XMP properties, remove converted Exif tags.
+        void moveExifToXmp(ExifData& exifData, XmpData& xmpData) const;
+        //! Convert (copy) XMP properties to Exif tags.
+        void copyXmpToExif(const XmpData& xmpData, ExifData& exifData) const;
+        //! Convert (move) XMP properties to Exif tags, remove converted XMP properties.
+        void moveXmpToExif(XmpData& xmpData, ExifData& exifData) const;
+        //! Convert (copy) IPTC datasets to XMP properties.
+        void copyIptcToXmp(const IptcData& iptcData, XmpData& xmpData) const;
+        //! Convert (move) IPTC datasets to XMP properties, remove converted IPTC datasets.
+        void moveIptcToXmp(IptcData& iptcData, XmpData& xmpData) const;
+        //! Convert (copy) XMP properties to IPTC datasets.
+        void copyXmpToIptc(const XmpData& xmpData, IptcData& iptcData) const;
+        //! Convert (move) XMP properties to IPTC datasets, remove converted XMP properties.
+        void moveXmpToIptc(XmpData& xmpData, IptcData& iptcData) const;
+        //@}
+
+    private:
+        std::vector<bool> rules_;               //!< Flag for each conversion rule, empty for all rules
+        const char* iptcCharset_;               //!< Fixed IPTC charset or 0 to detect it
+
+    }; // class MetadataConverter
+
 // *****************************************************************************
 // free functions, template and inline definitions
 
@@ -143,6 +143,28 @@ namespace Exiv2 {
                   uint32_t  size,
             const CrwImage* pCrwImage
         );
+        /*!
+          @brief Encode metadata from the CRW image and write the binary CRW
+                 image to \em io. The values of the entries, including the
+                 image data, are written straight from \em pData.
+
+          @param io        IO instance to write the binary image to (target).
+          @param pData     Pointer to the binary image data buffer. Must
+                           point to data in CRW format; no checks are
+                           performed.
+          @param size      Length of the data buffer.
+          @param pCrwImage Pointer to the %Exiv2 CRW image with the metadata to
+                           encode.
+
+          @throw Error If the metadata from the CRW image cannot be encoded
+                 or the image cannot be written.
+         */
+        static void encode(
+                  BasicIo&  io,
+            const byte*     pData,
+                  uint32_t  size,
+            const CrwImage* pCrwImage
+        );
 
     }; // class CrwParser
 
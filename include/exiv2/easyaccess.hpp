@@ -30,8 +30,13 @@
 #include "exiv2lib_export.h"
 
 // included header files
+#include "batch.hpp"
 #include "exif.hpp"
 
+// + standard includes
+#include <string>
+#include <vector>
+
 namespace Exiv2 {
 
 // *****************************************************************************
@@ -83,6 +88,130 @@ namespace Exiv2 {
     //! Return the AF point
     EXIV2API ExifData::const_iterator afPoint(const ExifData& ed);
 
+    /*!
+      @brief The results of all easy access functions for one %ExifData,
+             see easyAccess(). A member is the end of the %ExifData if the
+             function finds nothing.
+     */
+    struct EXIV2API EasyAccessResult {
+        ExifData::const_iterator orientation_;       //!< Result of orientation()
+        ExifData::const_iterator isoSpeed_;          //!< Result of isoSpeed()
+        ExifData::const_iterator flashBias_;         //!< Result of flashBias()
+        ExifData::const_iterator exposureMode_;      //!< Result of exposureMode()
+        ExifData::const_iterator sceneMode_;         //!< Result of sceneMode()
+        ExifData::const_iterator macroMode_;         //!< Result of macroMode()
+        ExifData::const_iterator imageQuality_;      //!< Result of imageQuality()
+        ExifData::const_iterator whiteBalance_;      //!< Result of whiteBalance()
+        ExifData::const_iterator lensName_;          //!< Result of lensName()
+        ExifData::const_iterator saturation_;        //!< Result of saturation()
+        ExifData::const_iterator sharpness_;         //!< Result of sharpness()
+        ExifData::const_iterator contrast_;          //!< Result of contrast()
+        ExifData::const_iterator sceneCaptureType_;  //!< Result of sceneCaptureType()
+        ExifData::const_iterator meteringMode_;      //!< Result of meteringMode()
+        ExifData::const_iterator make_;              //!< Result of make()
+        ExifData::const_iterator model_;             //!< Result of model()
+        ExifData::const_iterator exposureTime_;      //!< Result of exposureTime()
+        ExifData::const_iterator fNumber_;           //!< Result of fNumber()
+        ExifData::const_iterator subjectDistance_;   //!< Result of subjectDistance()
+        ExifData::const_iterator serialNumber_;      //!< Result of serialNumber()
+        ExifData::const_iterator focalLength_;       //!< Result of focalLength()
+        ExifData::const_iterator afPoint_;           //!< Result of afPoint()
+    };
+
+    /*!
+      @brief Return the results of all easy access functions. The keys the
+             functions search are resolved once per program and all results
+             are collected in a single pass over \em ed, which is faster than
+             calling the functions one by one.
+     */
+    EXIV2API EasyAccessResult easyAccess(const ExifData& ed);
+
+    /*!
+      @brief Camera and lens identity of a Canon image, see canonInfo().
+             Numbers which are not in the image are 0, strings are empty.
+     */
+    struct EXIV2API CanonInfo {
+        //! Default constructor
+        CanonInfo();
+
+        std::string model_;                 //!< Exif.Image.Model
+        uint32_t    modelId_;               //!< Exif.Canon.ModelID
+        uint32_t    serialNumber_;          //!< Exif.Canon.SerialNumber
+        std::string internalSerialNumber_;  //!< Exif.Canon.InternalSerialNumber
+        std::string firmwareVersion_;       //!< Exif.Canon.FirmwareVersion
+        uint32_t    fileNumber_;            //!< Exif.Canon.FileNumber or Exif.CanonFi.FileNumber
+        int32_t     lensType_;              //!< Exif.CanonCs.LensType
+        std::string lensModel_;             //!< Exif.Canon.LensModel
+        uint16_t    longFocal_;             //!< Longest focal length, in focal units
+        uint16_t    shortFocal_;            //!< Shortest focal length, in focal units
+        uint16_t    focalUnits_;            //!< Focal units per mm
+    };
+
+    /*!
+      @brief Return a decode filter which accepts just the metadata that
+             canonInfo() reads. Set it on the image before readMetadata(),
+             the decoder then skips all other Exif tags and creates no
+             Exifdatum for them, e.g.
+             @code
+             image->setDecodeFilter(canonInfoFilter());
+             image->readMetadata();
+             CanonInfo info = canonInfo(image->exifData());
+             @endcode
+     */
+    EXIV2API DecodeFilter canonInfoFilter();
+    //! Return the camera and lens identity of a Canon image from its Exif data
+    EXIV2API CanonInfo canonInfo(const ExifData& ed);
+
+    /*!
+      @brief Position and time of a GPS fix, see gpsInfo(). The values are
+             decoded from the rationals of the GPS IFD. A value is only set
+             if its has-flag is true, all values are 0 otherwise.
+     */
+    struct EXIV2API GpsInfo {
+        //! Default constructor
+        GpsInfo();
+
+        bool   hasPosition_;    //!< True if latitude_ and longitude_ are set
+        double latitude_;       //!< Latitude in decimal degrees, negative in the south
+        double longitude_;      //!< Longitude in decimal degrees, negative in the west
+        bool   hasAltitude_;    //!< True if altitude_ is set
+        double altitude_;       //!< Altitude in meters, negative below sea level
+        bool   hasTimestamp_;   //!< True if timestamp_ is set
+        double timestamp_;      //!< UTC time of the fix, in seconds since 1970-01-01 00:00:00
+    };
+
+    /*!
+      @brief Return a decode filter which accepts just the metadata that
+             gpsInfo() reads. With this filter, the TIFF parser reads IFD0,
+             to find the GPS IFD, and the GPS IFD, but skips the Exif IFD,
+             the makernote and the other sub-IFDs, e.g.
+             @code
+             image->setDecodeFilter(gpsInfoFilter());
+             image->readMetadata();
+             GpsInfo info = gpsInfo(image->exifData());
+             @endcode
+     */
+    EXIV2API DecodeFilter gpsInfoFilter();
+    /*!
+      @brief Return the GPS position and time of an image from its Exif data.
+             Values which are missing, have a zero denominator or are out
+             of range are not set.
+     */
+    EXIV2API GpsInfo gpsInfo(const ExifData& ed);
+    /*!
+      @brief Read the GPS position and time of the files \em paths with
+             \em batch, which decodes them with gpsInfoFilter().
+      @param batch   Batch processor to read the files with. Its decode
+                     filter is replaced by gpsInfoFilter().
+      @param paths   Paths of the files.
+      @param results Set to the result of each file, in the order of \em paths.
+      @return The GPS information of each file, in the order of \em paths.
+              It is empty for files which could not be read.
+     */
+    EXIV2API std::vector<GpsInfo> gpsInfo(BatchProcessor& batch,
+                                          const std::vector<std::string>& paths,
+                                          BatchProcessor::Results& results);
+
 } // namespace Exiv2
 
 #endif // EASYACCESS_HPP_
@@ -37,6 +37,7 @@
 // + standard includes
 #include <exception>
 #include <string>
+#include <vector>
 
 // *****************************************************************************
 // namespace extensions
@@ -60,14 +61,15 @@ namespace Exiv2 {
              which translates to
 
              <code>
-             if (LogMsg::warn >= LogMsg::level() && LogMsg::handler())
+             if (!LogMsg::enabled(LogMsg::warn)) {} else
                  LogMsg(LogMsg::warn).os() << "Warning! Something looks fishy.\n";
              </code>
 
              The macros EXV_DEBUG, EXV_INFO, EXV_WARNING and EXV_ERROR are
              shorthands and ensure efficient use of the logging facility: If a
              log message doesn't need to be generated because of the log level
-             setting, the temp object is not even created.
+             setting, the temp object is not even created. The check is inline,
+             so a filtered message costs two loads and a compare.
 
              Caveat: The entire log message is not processed in this case. So don't
              make that call any logic that always needs to be executed.
@@ -92,6 +94,63 @@ namespace Exiv2 {
          */
         typedef void (*Handler)(int, const char*);
 
+        /*!
+          @brief Options for setHandler(Handler, const HandlerOptions&). The
+                 defaults pass each message straight to the handler.
+         */
+        struct EXIV2API HandlerOptions {
+            HandlerOptions() : maxRepeats(0), buffered(false) {}
+            /*!
+              @brief Pass at most this many consecutive identical messages of a
+                     thread to the handler, 0 for no limit. The number of
+                     suppressed repetitions is reported with the next different
+                     message or on flush().
+             */
+            unsigned int maxRepeats;
+            /*!
+              @brief Collect the messages of each thread and pass them to the
+                     handler in batches, on flush() and when the thread exits.
+                     The handler is still called from the thread which logged
+                     the messages.
+             */
+            bool buffered;
+        };
+
+        //! A log message collected by a Scope
+        struct Message {
+            Level level_;                       //!< Log level of the message
+            std::string text_;                  //!< The message
+        };
+        //! List of log messages, in the order they were logged
+        typedef std::vector<Message> Messages;
+
+        /*!
+          @brief Collects the log messages of the calling thread while it
+                 exists, instead of passing them to the handler. No lock is
+                 taken. Scopes nest, the innermost one of the thread collects.
+                 Messages are subject to the log level, not to the handler or
+                 the handler options. Threads without a scope use the handler.
+         */
+        class EXIV2API Scope {
+        public:
+            //! Constructor, makes this the scope of the calling thread
+            Scope();
+            //! Destructor, restores the previous scope of the thread
+            ~Scope();
+            Scope(const Scope& rhs) = delete;
+            Scope& operator=(const Scope& rhs) = delete;
+
+            //! Return the messages collected so far
+            const Messages& messages() const { return messages_; }
+            //! Move the messages collected so far out of the scope
+            Messages release();
+
+        private:
+            friend class LogMsg;
+            Scope* previous_;
+            Messages messages_;
+        };
+
         //! @name Creators
         //@{
         //! Constructor, takes the log message type as an argument
@@ -120,10 +179,23 @@ namespace Exiv2 {
                  the log message handler to 0 (or set the log level to \c mute).
          */
         static void setHandler(Handler handler);
+        /*!
+          @brief Set the log message handler with rate limiting or buffering
+                 \em options. Messages buffered so far by the calling thread are
+                 flushed to the previous handler first.
+         */
+        static void setHandler(Handler handler, const HandlerOptions& options);
+        /*!
+          @brief Pass the messages buffered by the calling thread and the count
+                 of suppressed repetitions to the handler.
+         */
+        static void flush();
         //! Return the current log level
-        static Level level();
+        static Level level() { return level_; }
         //! Return the current log message handler
-        static Handler handler();
+        static Handler handler() { return handler_; }
+        //! Return true if a message of type \em msgType would be passed to the handler or a Scope
+        static bool enabled(Level msgType);
         //! The default log handler. Sends the log message to standard error.
         static void defaultHandler(int level, const char* s);
 
@@ -133,6 +205,8 @@ namespace Exiv2 {
         static Level level_;
         // The log handler in use
         static Handler handler_;
+        // Rate limiting and buffering of the handler
+        static HandlerOptions options_;
         // The type of this log message
         const Level msgType_;
         // Holds the log message until it is passed to the message handler
@@ -142,13 +216,13 @@ namespace Exiv2 {
 
 // Macros for simple access
 //! Shorthand to create a temp debug log message object and return its ostringstream
-#define EXV_DEBUG   if (LogMsg::debug >= LogMsg::level() && LogMsg::handler()) LogMsg(LogMsg::debug).os()
+#define EXV_DEBUG   if (!LogMsg::enabled(LogMsg::debug)) {} else LogMsg(LogMsg::debug).os()
 //! Shorthand for a temp info log message object and return its ostringstream
-#define EXV_INFO    if (LogMsg::info  >= LogMsg::level() && LogMsg::handler()) LogMsg(LogMsg::info).os()
+#define EXV_INFO    if (!LogMsg::enabled(LogMsg::info)) {} else LogMsg(LogMsg::info).os()
 //! Shorthand for a temp warning log message object and return its ostringstream
-#define EXV_WARNING if (LogMsg::warn  >= LogMsg::level() && LogMsg::handler()) LogMsg(LogMsg::warn).os()
+#define EXV_WARNING if (!LogMsg::enabled(LogMsg::warn)) {} else LogMsg(LogMsg::warn).os()
 //! Shorthand for a temp error log message object and return its ostringstream
-#define EXV_ERROR   if (LogMsg::error >= LogMsg::level() && LogMsg::handler()) LogMsg(LogMsg::error).os()
+#define EXV_ERROR   if (!LogMsg::enabled(LogMsg::error)) {} else LogMsg(LogMsg::error).os()
 
 #ifdef _MSC_VER
 // Disable MSVC warnings "non - DLL-interface classkey 'identifier' used as base
@@ -254,11 +328,17 @@ namespace Exiv2 {
         kerCorruptedMetadata,
         kerArithmeticOverflow,
         kerMallocFailed,
+        kerResourceLimitExceeded,
+        kerRemoteRequestStopped,
+        kerFilteredMetadata,
     };
 
     /*!
       @brief Simple error class used for exceptions. An output operator is
              provided to print errors to a stream.
+
+      The message is assembled on the first call to what() or wwhat(), errors
+      which are caught and handled by their code never pay for it.
      */
     template<typename charT>
     class BasicError : public AnyError {
@@ -305,7 +385,7 @@ namespace Exiv2 {
         //! @name Manipulators
         //@{
         //! Assemble the error message from the arguments
-        EXIV2API void setMsg();
+        EXIV2API void setMsg() const;
         //@}
 
         // DATA
@@ -314,10 +394,11 @@ namespace Exiv2 {
         std::basic_string<charT> arg1_;         //!< First argument
         std::basic_string<charT> arg2_;         //!< Second argument
         std::basic_string<charT> arg3_;         //!< Third argument
-        std::string              msg_;          //!< Complete error message
+        mutable std::string      msg_;          //!< Complete error message, once assembled
 #ifdef EXV_UNICODE_PATH
-        std::wstring             wmsg_;         //!< Complete error message as a wide string
+        mutable std::wstring     wmsg_;         //!< Complete error message as a wide string
 #endif
+        mutable bool             hasMsg_;       //!< True once the message is assembled
     }; // class BasicError
 
     //! Error class used for exceptions (std::string based)
@@ -331,29 +412,27 @@ namespace Exiv2 {
 // free functions, template and inline definitions
 
     //! Return the error message for the error with code \em code.
-    const char* errMsg(int code);
+    EXIV2API const char* errMsg(int code);
 
     template<typename charT>
     BasicError<charT>::BasicError(ErrorCode code)
-        : code_(code), count_(0)
+        : code_(code), count_(0), hasMsg_(false)
     {
-        setMsg();
     }
 
     template<typename charT> template<typename A>
     BasicError<charT>::BasicError(ErrorCode code, const A& arg1)
-        : code_(code), count_(1), arg1_(toBasicString<charT>(arg1))
+        : code_(code), count_(1), arg1_(toBasicString<charT>(arg1)), hasMsg_(false)
     {
-        setMsg();
     }
 
     template<typename charT> template<typename A, typename B>
     BasicError<charT>::BasicError(ErrorCode code, const A& arg1, const B& arg2)
         : code_(code), count_(2),
           arg1_(toBasicString<charT>(arg1)),
-          arg2_(toBasicString<charT>(arg2))
+          arg2_(toBasicString<charT>(arg2)),
+          hasMsg_(false)
     {
-        setMsg();
     }
 
     template<typename charT> template<typename A, typename B, typename C>
@@ -361,9 +440,9 @@ namespace Exiv2 {
         : code_(code), count_(3),
           arg1_(toBasicString<charT>(arg1)),
           arg2_(toBasicString<charT>(arg2)),
-          arg3_(toBasicString<charT>(arg3))
+          arg3_(toBasicString<charT>(arg3)),
+          hasMsg_(false)
     {
-        setMsg();
     }
 
     template<typename charT>
@@ -380,6 +459,14 @@ namespace Exiv2 {
     template<typename charT>
     const char* BasicError<charT>::what() const noexcept
     {
+        if (!hasMsg_) {
+            try {
+                setMsg();
+            }
+            catch (...) {
+                return errMsg(code_);
+            }
+        }
         return msg_.c_str();
     }
 
@@ -387,6 +474,14 @@ namespace Exiv2 {
     template<typename charT>
     const wchar_t* BasicError<charT>::wwhat() const noexcept
     {
+        if (!hasMsg_) {
+            try {
+                setMsg();
+            }
+            catch (...) {
+                return L"";
+            }
+        }
         return wmsg_.c_str();
     }
 #endif
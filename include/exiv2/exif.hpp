@@ -36,6 +36,8 @@
 
 // + standard includes
 #include <list>
+#include <memory>
+#include <mutex>
 
 // *****************************************************************************
 // namespace extensions
@@ -48,10 +50,33 @@ namespace Exiv2 {
 // *****************************************************************************
 // class declarations
     class ExifData;
+    class IptcData;
+    class XmpData;
+    namespace Internal {
+        class DeferredMakernote;
+        class TiffParserWorker;
+    }
 
 // *****************************************************************************
 // class definitions
 
+    /*!
+      @brief Location of a decoded %Exifdatum in the Exif data it was read
+             from. Offsets are relative to the start of the TIFF header, see
+             ExifData::tiffOffset() for its position in the image file, and
+             -1 if the location is unknown.
+     */
+    struct EXIV2API ExifOrigin {
+        //! Default constructor, for metadata which were not decoded
+        ExifOrigin() : entryOffset_(-1), valueOffset_(-1), valueSize_(0) {}
+        //! Return true if the location of the value is known
+        bool valid() const { return valueOffset_ >= 0; }
+
+        int64_t  entryOffset_;                  //!< Offset of the IFD entry
+        int64_t  valueOffset_;                  //!< Offset of the value data
+        uint32_t valueSize_;                    //!< Size of the value data in bytes
+    };
+
     /*!
       @brief An Exif metadatum, consisting of an ExifKey and a Value and
              methods to manipulate these.
@@ -73,8 +98,15 @@ namespace Exiv2 {
           @throw Error if the key cannot be parsed and converted.
          */
         explicit Exifdatum(const ExifKey& key, const Value* pValue =0);
+        /*!
+          @brief Constructor which takes ownership of \em value instead of
+                 copying it. Decoders use it to hand over the values they read.
+         */
+        Exifdatum(const ExifKey& key, Value::UniquePtr value);
         //! Copy constructor
         Exifdatum(const Exifdatum& rhs);
+        //! Move constructor, takes over the key and value of \em rhs
+        Exifdatum(Exifdatum&& rhs) noexcept;
         //! Destructor
         virtual ~Exifdatum();
         //@}
@@ -83,6 +115,8 @@ namespace Exiv2 {
         //@{
         //! Assignment operator
         Exifdatum& operator=(const Exifdatum& rhs);
+        //! Move assignment operator, takes over the key and value of \em rhs
+        Exifdatum& operator=(Exifdatum&& rhs) noexcept;
         /*!
           @brief Assign \em value to the %Exifdatum. The type of the new Value
                  is set to UShortValue.
@@ -146,6 +180,8 @@ namespace Exiv2 {
                   value has no data area, else 0.
          */
         int setDataArea(const byte* buf, long len);
+        //! Set the location the value was read from. (Meant for library internal use.)
+        void setOrigin(const ExifOrigin& origin) { origin_ = origin; }
         //@}
 
         //! @name Accessors
@@ -209,15 +245,58 @@ namespace Exiv2 {
                   value is not set.
          */
         DataBuf dataArea() const;
+        /*!
+          @brief Return the location of the value in the Exif data it was
+                 decoded from. It is not updated when the value changes and
+                 is invalid for metadata which were not decoded.
+         */
+        const ExifOrigin& origin() const { return origin_; }
         //@}
 
     private:
         // DATA
         ExifKey::UniquePtr key_;                  //!< Key
         Value::UniquePtr   value_;                //!< Value
+        ExifOrigin         origin_;               //!< Location of the decoded value
 
     }; // class Exifdatum
 
+    /*!
+      @brief Opt-in, process-wide memo of the results of the tag print
+             functions which Exifdatum::write() and Exifdatum::print() call.
+
+      Printing the metadata of many images from the same camera computes
+      the same lens, model and setting strings again and again. With the
+      cache enabled, the result of a print function is kept, keyed by the
+      function, the IFD and tag, the type and bytes of the value and the
+      format flags of the stream. A print function which looks up other
+      metadata, e.g., to identify a lens, has the keys and values it found
+      recorded with its result, which is only used again if the same lookups
+      find the same values. Results of print functions which iterate over
+      the metadata and of values larger than 256 bytes are not kept.
+
+      The cache is thread-safe. When it is full, the least recently used
+      result is dropped.
+     */
+    class EXIV2API PrintCache {
+    public:
+        /*!
+          @brief Set the maximum number of results to keep. 0, the default,
+                 disables the cache and drops all results.
+         */
+        static void setCapacity(size_t capacity);
+        //! Drop all results and reset the statistics
+        static void clear();
+        //! Return the maximum number of results kept, 0 if the cache is disabled
+        static size_t capacity();
+        //! Return the number of results kept
+        static size_t size();
+        //! Return the number of prints answered from the cache since it was cleared
+        static uint64_t hits();
+        //! Return the number of prints computed while the cache was enabled since it was cleared
+        static uint64_t misses();
+    }; // class PrintCache
+
     /*!
       @brief Access to a Exif %thumbnail image. This class provides higher level
              accessors to the thumbnail image that is optionally embedded in IFD1
@@ -244,6 +323,12 @@ namespace Exiv2 {
                  data buffer and %DataBuf ensures that it will be deleted.
          */
         DataBuf copy() const;
+        /*!
+          @brief Return the thumbnail image in a shared buffer, which all
+                 consumers can share without copies. Empty if there is no
+                 thumbnail.
+         */
+        SharedBuf buffer() const;
         /*!
           @brief Write the thumbnail image to a file.
 
@@ -419,6 +504,39 @@ namespace Exiv2 {
     //! Container type to hold all metadata
     typedef std::list<Exifdatum> ExifMetadata;
 
+    /*!
+      @brief An %Exif key which is resolved once and can then be used for
+             any number of lookups in any %ExifData. Constructing a key from
+             a string parses it and looks up its tag, looking up a handle
+             just probes the index of the container, e.g.,
+             @code
+             static const ExifKeyHandle dateTimeOriginal("Exif.Photo.DateTimeOriginal");
+             ExifData::const_iterator pos = exifData.findKey(dateTimeOriginal);
+             @endcode
+     */
+    class EXIV2API ExifKeyHandle {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor to resolve a key string.
+          @throw Error if the key cannot be parsed or the tag is unknown.
+         */
+        explicit ExifKeyHandle(const std::string& key) : key_(key) {}
+        //! Constructor from a key
+        explicit ExifKeyHandle(const ExifKey& key) : key_(key) {}
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the key
+        const ExifKey& key() const { return key_; }
+        //@}
+
+    private:
+        ExifKey key_;                           //!< The resolved key
+    };
+
     /*!
       @brief A container for Exif data.  This is a top-level class of the %Exiv2
              library. The container holds Exifdatum objects.
@@ -430,16 +548,36 @@ namespace Exiv2 {
       - write Exif data to JPEG files
       - extract Exif metadata to files, insert from these files
       - extract and delete Exif thumbnail (JPEG and TIFF thumbnails)
+
+      Lookups by key (findKey(), operator[]) use an Internal::KeyIndex on
+      the IFD id and tag of each %Exifdatum. Erasing a range of metadata or
+      obtaining a mutable iterator with begin() invalidates it.
+
+      Copies of a container share the metadata until one of them is
+      modified or hands out an iterator or a reference into them, like
+      XmpData.
     */
     class EXIV2API ExifData {
+        friend class Internal::TiffParserWorker;
+        friend class ExifParser;
     public:
         //! ExifMetadata iterator type
         typedef ExifMetadata::iterator iterator;
         //! ExifMetadata const iterator type
         typedef ExifMetadata::const_iterator const_iterator;
 
+        //! @name Creators
+        //@{
+        //! Default constructor
+        ExifData();
+        //! Copy constructor
+        ExifData(const ExifData& rhs);
+        //@}
+
         //! @name Manipulators
         //@{
+        //! Assignment operator
+        ExifData& operator=(const ExifData& rhs);
         /*!
           @brief Returns a reference to the %Exifdatum that is associated with a
                  particular \em key. If %ExifData does not already contain such
@@ -449,6 +587,8 @@ namespace Exiv2 {
                  member function.
          */
         Exifdatum& operator[](const std::string& key);
+        //! Like operator[](const std::string&), for a key which is already resolved
+        Exifdatum& operator[](const ExifKeyHandle& key);
         /*!
           @brief Add an Exifdatum from the supplied key and value pair.  This
                  method copies (clones) key and value. No duplicate checks are
@@ -456,6 +596,11 @@ namespace Exiv2 {
                  the same key.
          */
         void add(const ExifKey& key, const Value* pValue);
+        /*!
+          @brief Add an Exifdatum from the supplied key and value pair, taking
+                 ownership of the value. Only the key is copied.
+         */
+        void add(const ExifKey& key, Value::UniquePtr value);
         /*!
           @brief Add a copy of the \em exifdatum to the Exif metadata.  No
                  duplicate checks are performed, i.e., it is possible to add
@@ -464,6 +609,8 @@ namespace Exiv2 {
           @throw Error if the makernote cannot be created
          */
         void add(const Exifdatum& exifdatum);
+        //! Add \em exifdatum to the Exif metadata, moving instead of copying it.
+        void add(Exifdatum&& exifdatum);
         /*!
           @brief Delete the Exifdatum at iterator position \em pos, return the
                  position of the next exifdatum. Note that iterators into
@@ -486,37 +633,175 @@ namespace Exiv2 {
         void sortByKey();
         //! Sort metadata by tag
         void sortByTag();
-        //! Begin of the metadata
-        iterator begin() { return exifMetadata_.begin(); }
+        //! Begin of the metadata, invalidates the key index
+        iterator begin();
         //! End of the metadata
-        iterator end() { return exifMetadata_.end(); }
+        iterator end();
         /*!
           @brief Find the first Exifdatum with the given \em key, return an
                  iterator to it.
          */
         iterator findKey(const ExifKey& key);
+        //! Find the first Exifdatum with the \em key of the handle
+        iterator findKey(const ExifKeyHandle& key) { return findKey(key.key()); }
+        //! Set the filter which decoders honour when they fill this container
+        void setDecodeFilter(const DecodeFilter& filter) { decodeFilter_ = filter; }
+        /*!
+          @brief Defer the decoding of makernotes. When set, decoders keep the
+                 makernote as the raw Exif.Photo.MakerNote tag and decode its
+                 metadata on the first iteration over the container, lookup of
+                 a makernote key or encoding. count() does not include
+                 makernote metadata which are not decoded yet.
+         */
+        void setLazyMakernote(bool flag) { lazyMakernote_ = flag; }
+        /*!
+          @brief Decode the sub-IFDs, the Exif and GPS IFDs, further IFDs and
+                 the makernotes of a TIFF structure concurrently. The
+                 metadata are in the same order as when decoded sequentially.
+                 Worthwhile for large images with many IFDs, e.g., DNGs.
+         */
+        void setParallelDecode(bool flag) { parallelDecode_ = flag; }
+        /*!
+          @brief Defer the decoding of the IPTC and XMP embedded in the
+                 Exif.Image.IPTCNAA, ImageResources and XMLPacket tags of a
+                 TIFF structure. When set, decoders keep only the raw tags and
+                 an image decodes the embedded metadata on the first access to
+                 Image::iptcData() or Image::xmpData(), see decodeEmbedded().
+         */
+        void setLazyEmbedded(bool flag) { lazyEmbedded_ = flag; }
+        /*!
+          @brief Decode the IPTC and XMP embedded in the raw tags of a pending
+                 decode, see setLazyEmbedded(), to \em iptcData and
+                 \em xmpData. Does nothing if there is none.
+          @param iptcData  IPTC container, replaced if IPTC is embedded
+          @param xmpData   XMP container, replaced if XMP is embedded
+          @param byteOrder Byte order of the TIFF structure the tags were decoded from
+         */
+        void decodeEmbedded(IptcData& iptcData, XmpData& xmpData, ByteOrder byteOrder);
+        //! Set the offset of the TIFF header in the image file, see tiffOffset()
+        void setTiffOffset(int64_t offset) { tiffOffset_ = offset; }
         //@}
 
         //! @name Accessors
         //@{
         //! Begin of the metadata
-        const_iterator begin() const { return exifMetadata_.begin(); }
+        const_iterator begin() const;
         //! End of the metadata
-        const_iterator end() const { return exifMetadata_.end(); }
+        const_iterator end() const;
         /*!
           @brief Find the first Exifdatum with the given \em key, return a const
                  iterator to it.
          */
         const_iterator findKey(const ExifKey& key) const;
+        //! Find the first Exifdatum with the \em key of the handle
+        const_iterator findKey(const ExifKeyHandle& key) const { return findKey(key.key()); }
         //! Return true if there is no Exif metadata
         bool empty() const { return count() == 0; }
         //! Get the number of metadata entries
-        long count() const { return static_cast<long>(exifMetadata_.size()); }
+        long count() const { return static_cast<long>(storage_->metadata_.size()); }
+        //! Return the filter which decoders honour when they fill this container
+        const DecodeFilter& decodeFilter() const { return decodeFilter_; }
+        //! Return true if makernotes are decoded on first access
+        bool lazyMakernote() const { return lazyMakernote_; }
+        //! Return true if the IFDs of a TIFF structure are decoded concurrently
+        bool parallelDecode() const { return parallelDecode_; }
+        //! Return true if the decoding of embedded IPTC and XMP is deferred
+        bool lazyEmbedded() const { return lazyEmbedded_; }
+        /*!
+          @brief Return true if the raw tags of the last decode embed IPTC or
+                 XMP which is not decoded yet. The decode keeps copies of these
+                 tags, so clear() and assignment do not lose the pending IPTC
+                 and XMP. Copies of the container do not inherit a pending
+                 decode.
+         */
+        bool embeddedPending() const { return embedded_ != nullptr; }
+        /*!
+          @brief Return the offset of the TIFF header of the decoded Exif data
+                 in the image file, or -1 if unknown. Add it to the offsets of
+                 Exifdatum::origin() to get positions in the file.
+         */
+        int64_t tiffOffset() const { return tiffOffset_; }
+        //! Return true if there is a makernote which is not decoded yet
+        bool makernotePending() const;
+        /*!
+          @brief Decode a pending makernote now and insert its metadata after
+                 the binary makernote tag. Does nothing if there is none.
+                 Threads which read the container concurrently wait for the
+                 decode instead of decoding it again.
+         */
+        void decodeMakernote() const;
+        /*!
+          @brief Return an estimate of the heap memory held by the metadata,
+                 see Image::memoryUsage(). A pending makernote is not decoded,
+                 its copy of the TIFF data is counted as a buffer.
+         */
+        MemoryUsage memoryUsage() const;
         //@}
 
     private:
+        //! Index type, maps the IFD id and tag of a key to the metadata with that key
+        typedef Internal::KeyIndex<uint32_t, iterator> Index;
+
+        /*!
+          @brief The metadata and their key index. Copies of a container
+                 share one instance until one of them is modified.
+         */
+        struct Storage {
+            //! Default constructor
+            Storage() : index_(true), shareable_(true) {}
+            //! Add the %Exifdatum at position \em pos to the index
+            void indexAdd(iterator pos);
+            //! Remove the %Exifdatum at position \em pos from the index
+            void indexErase(iterator pos);
+            //! Rebuild the index from scratch
+            void indexRebuild();
+            //! Return the index entry for \em key or 0 if there is none
+            const Index::Entry* indexFind(const ExifKey& key) const;
+
+            ExifMetadata metadata_;             //!< Exif metadata
+            Index        index_;                //!< Key index of metadata_
+            //! False once iterators into metadata_ were handed out, copies must not share it then
+            bool         shareable_;
+        };
+
+        /*!
+          @brief Return the storage of this container for a modification,
+                 after copying it if it is shared. If \em leak is true, the
+                 caller hands out mutable iterators or references into the
+                 metadata and new copies of the container do not share it.
+         */
+        Storage& mutableStorage(bool leak) const;
+        //! Return the storage of this container to hand out const iterators into it, see mutableStorage()
+        const Storage& iterableStorage() const;
+        //! Return the metadata decoded so far, without decoding a pending makernote
+        const ExifMetadata& decodedMetadata() const { return storage_->metadata_; }
+        /*!
+          @brief Find the first %Exifdatum with \em key in decodedMetadata(),
+                 without decoding a pending makernote or copying shared
+                 metadata. For lookups of the library which hand out no
+                 iterator.
+         */
+        const_iterator findDecoded(const ExifKey& key) const;
+        //! Return true if there is a tag \em tag in IFD0
+        bool hasImageTag(uint16_t tag) const;
+        //! Keep copies of the tags with embedded IPTC or XMP of a lazy decode, see embeddedPending()
+        void keepEmbedded();
+
         // DATA
-        ExifMetadata exifMetadata_;
+        // The storage is mutable since a pending makernote is decoded and
+        // shared metadata are copied on first access
+        mutable std::shared_ptr<Storage> storage_;
+        DecodeFilter decodeFilter_;             //!< Filter honoured by the decoders
+        bool         lazyMakernote_;            //!< Flag to defer makernote decoding
+        bool         parallelDecode_;           //!< Flag to decode IFDs concurrently
+        bool         lazyEmbedded_;             //!< Flag to defer decoding embedded IPTC and XMP
+        //! Copies of the tags with embedded IPTC or XMP which is not decoded yet
+        std::shared_ptr<const ExifMetadata> embedded_;
+        int64_t      tiffOffset_;               //!< Offset of the TIFF header in the image file
+        //! Makernote which is not decoded yet
+        mutable std::shared_ptr<const Internal::DeferredMakernote> makernote_;
+        //! Guards makernote_ and its decode and the copy of shared metadata by const accessors called from several threads
+        mutable std::mutex mutex_;
 
     }; // class ExifData
 
@@ -32,6 +32,8 @@
 #include "exiv2/config.h"
 #include "exiv2/datasets.hpp"
 #include "exiv2/basicio.hpp"
+#include "exiv2/batch.hpp"
+#include "exiv2/bmffimage.hpp"
 #include "exiv2/bmpimage.hpp"
 #include "exiv2/convert.hpp"
 #include "exiv2/cr2image.hpp"
@@ -47,6 +49,10 @@
 #include "exiv2/iptc.hpp"
 #include "exiv2/jp2image.hpp"
 #include "exiv2/jpgimage.hpp"
+#include "exiv2/metacache.hpp"
+#include "exiv2/metaindex.hpp"
+#include "exiv2/metadiff.hpp"
+#include "exiv2/metaview.hpp"
 #include "exiv2/metadatum.hpp"
 #include "exiv2/mrwimage.hpp"
 #include "exiv2/orfimage.hpp"
@@ -61,10 +67,12 @@
 #include "exiv2/psdimage.hpp"
 #include "exiv2/rafimage.hpp"
 #include "exiv2/rw2image.hpp"
+#include "exiv2/snapshot.hpp"
 
 #include "exiv2/tags.hpp"
 #include "exiv2/tgaimage.hpp"
 #include "exiv2/tiffimage.hpp"
+#include "exiv2/trace.hpp"
 #include "exiv2/types.hpp"
 #include "exiv2/value.hpp"
 #include "exiv2/version.hpp"
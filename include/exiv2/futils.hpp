@@ -30,6 +30,7 @@
 
 #include "exiv2lib_export.h"
 #include "config.h"
+#include "types.hpp"
 
 #include <string>
 
@@ -115,6 +116,53 @@ namespace Exiv2
       */
     EXIV2API long base64decode(const char* in, char* out, size_t out_size);
 
+    /*!
+      @brief Incremental base64 decoder. Characters outside the base64
+             alphabet, e.g., line breaks and padding, are skipped, so the
+             input may be fed in pieces of any size.
+
+      Complete groups of four characters are decoded without per character
+      branches; the decoder only falls back to one character at a time around
+      skipped characters.
+     */
+    class EXIV2API Base64Decoder {
+    public:
+        //! Constructor
+        Base64Decoder() : bits_(0), count_(0) {}
+        //! Return the most bytes decode() writes for \em size characters
+        static size_t maxDecodedSize(size_t size) { return (size + 3) / 4 * 3; }
+        /*!
+          @brief Decode \em size characters at \em in to \em out, which must
+                 have room for maxDecodedSize(\em size) bytes. Characters of
+                 an incomplete group are kept for the next call.
+          @return Number of bytes written
+         */
+        size_t decode(const char* in, size_t size, byte* out);
+        /*!
+          @brief Write the bytes of a final incomplete group to \em out, which
+                 must have room for 2 bytes, and reset the decoder.
+          @return Number of bytes written
+         */
+        size_t finish(byte* out);
+
+    private:
+        uint32_t bits_;                         //!< Bits of the current group
+        int count_;                             //!< Characters in the current group
+    };
+
+    /*!
+      @brief Decode \em size characters of base64 text at \em in directly into
+             a new buffer, skipping characters outside the base64 alphabet.
+      @return The decoded data, an empty buffer if there is none.
+     */
+    EXIV2API DataBuf base64decode(const char* in, size_t size);
+
+    /*!
+      @brief Append the UTF-8 encoding of the code point \em cp to \em s.
+             Code points beyond 0x10ffff are not checked for.
+     */
+    EXIV2API void appendUtf8(std::string& s, uint32_t cp);
+
     /*!
       @brief Return the protocol of the path.
       @param path The path of file to extract the protocol.
@@ -175,6 +223,15 @@ namespace Exiv2
      */
     EXIV2API std::string strError();
 
+    /*!
+      @brief Create a new, empty file with a unique name next to \em path and
+             return its name, which starts with \em path. No other file of
+             that name exists, even if another process creates one at the
+             same time. The caller removes the file.
+      @return The name of the new file, an empty string if it cannot be created.
+     */
+    EXIV2API std::string createTempFile(const std::string& path);
+
     //! @brief Return the path of the current process.
     EXIV2API std::string getProcessPath();
 
@@ -5,18 +5,32 @@
 
 #include "datasets.hpp"
 
+#include <functional>
 #include <string>
 
 
 namespace Exiv2 {
     /*!
      @brief execute an HTTP request
+
+     The request asks the server to keep the connection alive. Connections
+     whose response had a known length are kept open and reused by later
+     requests to the same server and port.
      @param request -  a Dictionary of headers to send to server
      @param response - a Dictionary of response headers (dictionary is filled by the response)
      @param errors   - a String with an error
      @return Server response 200 = OK, 404 = Not Found etc...
     */
     EXIV2API int http(Exiv2::Dictionary& request,Exiv2::Dictionary& response,std::string& errors);
+
+    /*!
+     @brief Like http(), but gives up when \em cancelled returns true. It is
+            called while the request waits for the connection or the server,
+            from the thread of the request, at least every 100 milliseconds.
+     @return -1 with \em errors set if the request is cancelled.
+    */
+    EXIV2API int http(Exiv2::Dictionary& request,Exiv2::Dictionary& response,std::string& errors,
+                      const std::function<bool()>& cancelled);
 }
 
 #endif
@@ -28,11 +28,16 @@
 
 // included header files
 #include "basicio.hpp"
+#include "error.hpp"
 #include "exif.hpp"
 #include "iptc.hpp"
 #include "xmp_exiv2.hpp"
 
 // + standard includes
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -40,6 +45,12 @@
 // namespace extensions
 namespace Exiv2 {
 
+// *****************************************************************************
+// class declarations
+    class ImageSnapshot;
+    class MetadataCache;
+    class MetadataDiff;
+
 // *****************************************************************************
 // class definitions
 
@@ -79,6 +90,7 @@ namespace Exiv2 {
       and save metadata.
      */
     class EXIV2API Image {
+        friend class MetadataCache;
     public:
         //! Image auto_ptr type
         typedef std::unique_ptr<Image> UniquePtr;
@@ -121,6 +133,58 @@ namespace Exiv2 {
               type).
          */
         virtual void readMetadata() =0;
+        /*!
+          @brief Like readMetadata(), but report failures with an error code
+              instead of an exception.
+
+          Data which is not of the image type, the most common failure on
+          mixed input, is detected up front without throwing. Failures deep
+          in the parsers are still thrown internally and converted here, the
+          message of such an error is never formatted.
+
+          @return kerSuccess, or the code of the error readMetadata() would
+              have thrown.
+         */
+        ErrorCode tryReadMetadata();
+        /*!
+          @brief Run readMetadata() in a thread of the library, for
+              applications which must not block, e.g., servers with an event
+              loop which read remote images. The image must not be used until
+              the returned future is ready. Its get() throws the errors of
+              readMetadata().
+
+          The parsers are not resumable: the thread of the library blocks
+          while the data is fetched, instead of the calling thread. The
+          requests of a remote image opened with ImageFactory::openAsync()
+          can be cancelled with the token of its RemoteOptions.
+         */
+        std::future<void> readMetadataAsync();
+        /*!
+          @brief Like readMetadataAsync(), but call \em handler in the thread
+              of the library when readMetadata() has finished, with the
+              exception it threw or an empty pointer. The handler must not
+              throw; an event loop would post the completion to its own
+              thread from it.
+         */
+        void readMetadataAsync(const std::function<void(std::exception_ptr)>& handler);
+        /*!
+          @brief Read only the pixel dimensions and the orientation of the
+              image, without decoding the full metadata. Before this method is
+              called, the image metadata will be cleared.
+
+          Afterwards pixelWidth() and pixelHeight() return the dimensions.
+          Formats which know a shortcut stop reading early: JPEG at the first
+          SOFn marker, TIFF after IFD0, PNG at the IHDR chunk and WebP at the
+          chunk with the canvas size. Their Exif data then holds only
+          Exif.Image.Orientation if the image has one and, for TIFF, the IFD0
+          tags the dimensions come from. The default implementation calls
+          readMetadata().
+
+          @throw Error if opening or reading of the file fails or the image
+              data is not valid (does not look like data of the specific image
+              type).
+         */
+        virtual void readBasicInfo();
         /*!
           @brief Write metadata back to the image.
 
@@ -134,6 +198,49 @@ namespace Exiv2 {
           @throw Error if the operation fails
          */
         virtual void writeMetadata() =0;
+        /*!
+          @brief Write the metadata back to the image if \em diff, the
+              differences between the metadata read from the image and the
+              buffered metadata, is not empty.
+
+          If all changes keep the size of the values, the image is updated
+          in place, see writeInPlace(), otherwise it is written like with
+          writeMetadata(). The writeInPlace() flag is left unchanged.
+
+          @throw Error if the operation fails
+         */
+        void writeChangedMetadata(const MetadataDiff& diff);
+        /*!
+          @brief Write the image with the buffered metadata to \em dst and
+              leave the image itself unchanged.
+
+          Formats which rewrite the whole image to write metadata, e.g.,
+          JPEG, PNG and WebP, stream the new image directly to \em dst.
+          Other formats write the metadata to a copy of the image in memory,
+          which is then written to \em dst.
+
+          @param dst Empty IO instance to write the new image to, open for
+              writing. Some formats seek back in it to patch sizes.
+          @throw Error if the operation fails
+         */
+        virtual void writeMetadataTo(BasicIo& dst);
+        /*!
+          @brief Write the image without its metadata to \em dst, keeping only
+              the types of metadata in \em keep, and leave the image and the
+              buffered metadata unchanged.
+
+          JPEG, PNG and WebP images are copied to \em dst in a single pass
+          which drops the metadata segments or chunks without decoding
+          anything. Other formats read the metadata of a copy of the image in
+          memory, clear it and write the copy to \em dst.
+
+          @param dst Empty IO instance to write the new image to, open for
+              writing.
+          @param keep Bitwise OR of the MetadataId of the types of metadata
+              to keep, e.g., mdIccProfile to keep the colors of the image.
+          @throw Error if the operation fails
+         */
+        virtual void stripMetadataTo(BasicIo& dst, int keep =mdNone);
         /*!
           @brief Assign new Exif data. The new Exif data is not written
               to the image until the writeMetadata() method is called.
@@ -241,6 +348,14 @@ namespace Exiv2 {
           @brief return iccProfile
          */
         virtual DataBuf* iccProfile() { return &iccProfile_; }
+        /*!
+          @brief Return the ICC profile in a shared buffer, empty if there is
+                 none. The profile is copied from iccProfile() once after it
+                 was read or set, later calls return the same buffer, which
+                 all consumers share without copies. Changes made in place
+                 through the pointer iccProfile() returns are not seen.
+         */
+        SharedBuf sharedIccProfile();
         /*!
           @brief Copy all existing metadata from source Image. The data is
               copied into internal buffers and is not written to the image
@@ -248,11 +363,38 @@ namespace Exiv2 {
           @param image Metadata source. All metadata types are copied.
          */
         virtual void setMetadata(const Image& image);
+        /*!
+          @brief Replace the metadata with that of a metadata snapshot written
+              by exportMetadata(). Only the kinds of metadata the image can
+              write are replaced. The metadata is not written to the image
+              until the writeMetadata() method is called.
+          @param pData Pointer to the snapshot
+          @param size Size of the snapshot
+          @throw Error if the data is not a metadata snapshot or is truncated.
+         */
+        void importMetadata(const byte* pData, long size);
         /*!
           @brief Erase all buffered metadata. Metadata is not removed
               from the actual image until the writeMetadata() method is called.
          */
         virtual void clearMetadata();
+        /*!
+          @brief Restrict the metadata which readMetadata() decodes to those
+              accepted by \em filter. The filter is set on the Exif, IPTC
+              and XMP containers of the image and stays in effect until it
+              is replaced; an empty filter decodes everything again.
+              While a filter is set, writeMetadata() and writeMetadataTo()
+              throw kerFilteredMetadata, since the metadata that the filter
+              skipped would be removed from the image.
+         */
+        void setDecodeFilter(const DecodeFilter& filter);
+        /*!
+          @brief Take an immutable snapshot of the metadata, the preview
+              properties and the data of the image, which many threads can
+              query at the same time. Call it after readMetadata().
+          @throw Error if the data of the image cannot be read.
+         */
+        std::shared_ptr<const ImageSnapshot> snapshot();
         /*!
           @brief Returns an ExifData instance containing currently buffered
               Exif data.
@@ -308,6 +450,72 @@ namespace Exiv2 {
           access to the raw XMP packet.
          */
         void writeXmpFromPacket(bool flag);
+        /*!
+          @brief Allow writeMetadata() to update the metadata of the image in
+              place.
+
+          If the flag is set and the re-encoded metadata fits into the
+          existing metadata segments of the image, writeMetadata() overwrites
+          only these segments instead of rewriting the complete image.
+          Otherwise, and for image formats which do not support this, the
+          image is rewritten as usual. The default is false.
+
+          TIFF images whose metadata does not fit are not rewritten either:
+          the new metadata structure is appended to the image and the header
+          is updated to refer to it, while the image data stays in place. The
+          space of the old structure is not reclaimed.
+
+          Unlike a rewrite, an update in place is not atomic: if it is
+          interrupted, the image may be left with partially written metadata.
+         */
+        void writeInPlace(bool flag);
+        /*!
+          @brief Set the number of bytes of padding to reserve when the
+              metadata is written.
+
+          The padding leaves room for later updates of the metadata in
+          place, see writeInPlace(). It is currently used for the Exif and
+          XMP segments of JPEG images and is reduced where it would exceed
+          the size limit of a segment. The default 0 uses the format default,
+          i.e., no padding for Exif and the XMP toolkit default for XMP.
+         */
+        void writePadding(uint32_t size);
+        /*!
+          @brief Compute the payload hash of the image, see payloadHash(),
+              when the metadata is read or the image is copied with
+              stripMetadataTo(). The default is false.
+
+          Reading the metadata then continues to read the image data in the
+          same pass, instead of stopping after the metadata.
+         */
+        void hashPayload(bool flag);
+        /*!
+          @brief Release the raw XMP packet once readMetadata() has decoded
+              it, to reduce the memory held by images which are kept open.
+              The default is false.
+
+          The XMP data stays available, the packet is read again from the
+          image when it is requested with xmpPacket() or when
+          writeXmpFromPacket(true) is set. The image must therefore not be
+          changed by others in the meantime. The packet is kept if the XMP
+          is written from the packet. %XmpSidecar images do not keep the
+          content of the file either, writeMetadata() then always rewrites
+          them.
+         */
+        void leanMode(bool flag);
+        /*!
+          @brief Decode the Exif and XMP metadata in threads of their own,
+              while readMetadata() goes on to locate and decode the others.
+              The default is false. Supported by JPEG and WebP images, the
+              others ignore it.
+
+          Meant to reduce the latency of reading large single images, it
+          costs a thread per family and a copy of the Exif data. The parse
+          limits of the BasicIo apply to each family on its own. Log messages
+          of the families are logged by the thread which calls
+          readMetadata(), after those of the other metadata.
+         */
+        void parallelDecode(bool flag);
         /*!
           @brief Set the byte order to encode the Exif metadata in.
 
@@ -452,6 +660,13 @@ namespace Exiv2 {
              method is called.
          */
         virtual BasicIo& io() const;
+        /*!
+          @brief Returns the counters of the work done to read and write the
+             metadata of the image: the reads, writes and seeks of its
+             BasicIo, the DataBuf allocations and the time spent decoding
+             TIFF structures and XMP packets and writing the metadata.
+         */
+        const IoStats& stats() const;
         /*!
           @brief Returns the access mode, i.e., the metadata functions, which
              this image supports for the metadata type \em metadataId.
@@ -466,8 +681,62 @@ namespace Exiv2 {
         bool supportsMetadata(MetadataId metadataId) const;
         //! Return the flag indicating the source when writing XMP metadata.
         bool writeXmpFromPacket() const;
+        //! Return the flag indicating if metadata may be written in place.
+        bool writeInPlace() const;
+        //! Return the number of bytes of padding to reserve when writing metadata.
+        uint32_t writePadding() const;
+        //! Return the flag indicating if the payload hash is computed.
+        bool hashPayload() const;
+        //! Return true if payloadHash() holds the hash of the image data.
+        bool payloadHashDefined() const;
+        //! Return the flag indicating if the raw XMP packet is released after decoding.
+        bool leanMode() const;
+        //! Return the flag indicating if the metadata families are decoded in parallel.
+        bool parallelDecode() const;
+        /*!
+          @brief Return a hash of the image data without the metadata, which
+              does not change when only the metadata of the image changes,
+              e.g., to find duplicates.
+
+          The hash is computed by readMetadata() of JPEG, PNG, WebP and TIFF
+          images and by stripMetadataTo() of JPEG, PNG and WebP images if
+          hashPayload(true) is set. It is a 64-bit FNV-1a hash, not a
+          cryptographic hash, of
+          - JPEG: the bytes after the first SOS marker, or EOI if there is none
+          - PNG: the data of the IDAT chunks
+          - WebP: the payload of the VP8, VP8L, ALPH and ANMF chunks
+          - TIFF: the strips and tiles of IFD0, IFD2, IFD3 and the SubIFDs,
+            i.e., without the thumbnail
+
+          @return The hash, 0 if payloadHashDefined() is false.
+         */
+        uint64_t payloadHash() const;
         //! Return list of native previews. This is meant to be used only by the PreviewManager.
         const NativePreviewList& nativePreviews() const;
+        /*!
+          @brief Return a snapshot of the Exif, IPTC and XMP metadata and the
+              comment in a compact binary format, to copy them to another
+              image with importMetadata().
+
+          The snapshot holds the metadata encoded as it is stored in images:
+          the Exif data as a TIFF structure, the IPTC data as IIM datasets,
+          the XMP packet and the comment, back-to-back and each preceded by
+          its size. Unlike an EXV file, it takes no JPEG segments to write
+          or to read.
+         */
+        DataBuf exportMetadata() const;
+        /*!
+          @brief Return an estimate of the heap memory held by the metadata of
+              the image, by category: the Exif, IPTC and XMP containers, see
+              ExifData::memoryUsage(), and the buffers of the raw XMP packet,
+              the ICC profile, the comment and the list of native previews.
+
+          The data which the BasicIo of the image holds, e.g., the content of
+          a MemIo, is not included. If an IoStatsCollector is active, the
+          memory usage of the image when it is destroyed is added to the
+          collected stats.
+         */
+        MemoryUsage memoryUsage() const;
         //@}
 
         //! set type support for this image format
@@ -490,10 +759,12 @@ namespace Exiv2 {
         XmpData           xmpData_;           //!< XMP data container
         DataBuf           iccProfile_;        //!< ICC buffer (binary data)
         std::string       comment_;           //!< User comment
-        std::string       xmpPacket_;         //!< XMP packet
+        mutable std::string xmpPacket_;       //!< XMP packet, restored on demand in lean mode
         int               pixelWidth_;        //!< image pixel width
         int               pixelHeight_;       //!< image pixel height
         NativePreviewList nativePreviews_;    //!< list of native previews
+        uint64_t          payloadHash_;       //!< Hash of the image data
+        bool              payloadHashDefined_;//!< Flag marking if payloadHash_ is set
 
         //! Return tag name for given tag id.
         const std::string& tagName(uint16_t tag);
@@ -501,6 +772,20 @@ namespace Exiv2 {
         //! Return tag type for given tag id.
         const char* typeName(uint16_t tag) const;
 
+        /*!
+          @brief Release the raw XMP packet in lean mode, see leanMode(). Called
+                 at the end of readMetadata().
+         */
+        void releasePackets();
+
+        /*!
+          @brief Throw kerFilteredMetadata if the metadata was read with a
+                 decode filter, see setDecodeFilter(). Writing it would remove
+                 everything the filter skipped from the image. Called at the
+                 start of writeMetadata() and writeMetadataTo().
+         */
+        void checkUnfiltered() const;
+
     public:
         Image& operator=(const Image& rhs) = delete;
         Image& operator=(const Image&& rhs) = delete;
@@ -508,11 +793,34 @@ namespace Exiv2 {
         Image(const Image&& rhs) = delete;
 
     private:
+        /*!
+          @brief printIFDStructure() with a scratch buffer for the values of
+                 the entries, which is shared by all levels of recursion.
+         */
+        void printIFDStructure(BasicIo& io, std::ostream& out, PrintStructureOption option, uint32_t start,
+                               bool bSwap, char c, int depth, DataBuf& scratch);
+        //! Read the raw XMP packet again from the image if it was released.
+        void restoreXmpPacket() const;
+        /*!
+          @brief Decode the IPTC and XMP embedded in the Exif data if their
+                 decoding was deferred, see ExifData::setLazyEmbedded().
+                 Called by the accessors and modifiers of these families.
+         */
+        void decodeEmbedded() const;
+
         // DATA
         int               imageType_;         //!< Image type
         uint16_t          supportedMetadata_; //!< Bitmap with all supported metadata types
         bool              writeXmpFromPacket_;//!< Determines the source when writing XMP
+        bool              writeInPlace_;      //!< Allow writing metadata in place
+        uint32_t          writePadding_;      //!< Padding to reserve when writing metadata
+        bool              hashPayload_;       //!< Compute the payload hash
+        bool              leanMode_;          //!< Release the raw XMP packet after decoding
+        bool              parallelDecode_;    //!< Decode the metadata families in parallel
+        mutable bool      xmpPacketReleased_; //!< Flag marking if xmpPacket_ was released
         ByteOrder         byteOrder_;         //!< Byte order
+        SharedBuf         iccShared_;         //!< Shared copy of the ICC profile, see sharedIccProfile()
+        const byte*       iccSharedFrom_;     //!< Buffer of the ICC profile iccShared_ was copied from
 
         std::map<int,std::string> tags_;      //!< Map of tags
         bool                      init_;      //!< Flag marking if map of tags needs to be initialized
@@ -575,6 +883,37 @@ namespace Exiv2 {
          */
         static Image::UniquePtr open(const std::wstring& wpath, bool useCurl = true);
 #endif
+        /*!
+          @brief Like open(const std::string&, bool), but the requests of a
+              remote file follow \em options: they can be cancelled from
+              another thread and give up at a deadline, see RemoteOptions.
+              The options are ignored for local files.
+         */
+        static Image::UniquePtr open(const std::string& path, const RemoteOptions& options, bool useCurl = true);
+        /*!
+          @brief Like open(const std::string&, bool), for a file which is
+              expected to be of type \em typeHint, e.g., from its MIME type.
+              Only the signature of that type is checked, the other types are
+              only tried if it does not match.
+         */
+        static Image::UniquePtr open(const std::string& path, int typeHint, bool useCurl = true);
+        //! Handler of openAsync(), called with the image or with the exception open() threw
+        typedef std::function<void(Image::UniquePtr image, std::exception_ptr error)> OpenHandler;
+        /*!
+          @brief Run open(const std::string&, const RemoteOptions&, bool) in a
+              thread of the library and return a future for the image. Its
+              get() throws the errors of open(). See Image::readMetadataAsync().
+         */
+        static std::future<Image::UniquePtr> openAsync(const std::string& path,
+                                                       const RemoteOptions& options = RemoteOptions(),
+                                                       bool useCurl = true);
+        /*!
+          @brief Like openAsync(const std::string&, const RemoteOptions&, bool),
+              but call \em handler in the thread of the library with the image
+              or the error. The handler must not throw.
+         */
+        static void openAsync(const std::string& path, const OpenHandler& handler,
+                              const RemoteOptions& options = RemoteOptions(), bool useCurl = true);
         /*!
           @brief Create an Image subclass of the appropriate type by reading
               the provided memory. %Image type is derived from the memory
@@ -605,6 +944,42 @@ namespace Exiv2 {
           @throw Error If opening the BasicIo fails
          */
         static Image::UniquePtr open(BasicIo::UniquePtr io);
+        /*!
+          @brief Like open(BasicIo::UniquePtr), for an image which is expected
+              to be of type \em typeHint. Only the signature of that type is
+              checked, the other types are only tried if it does not match.
+         */
+        static Image::UniquePtr open(BasicIo::UniquePtr io, int typeHint);
+        /*!
+          @brief Like open(const std::string&, bool), but report failures with
+              an error code instead of an exception. Meant for applications
+              which go through many files of which some are not images.
+          @param image Set to the opened image, unchanged on failure.
+          @return kerSuccess, kerDataSourceOpenFailed if the file cannot be
+              opened, kerFileContainsUnknownImageType if it is not an image of
+              a supported type, or the code of another error open() would
+              have thrown.
+         */
+        static ErrorCode tryOpen(Image::UniquePtr& image, const std::string& path, bool useCurl = true);
+        /*!
+          @brief Like open(const byte*, long), but report failures with an
+              error code instead of an exception, see tryOpen(Image::UniquePtr&,
+              const std::string&, bool).
+         */
+        static ErrorCode tryOpen(Image::UniquePtr& image, const byte* data, long size);
+        /*!
+          @brief Like open(BasicIo::UniquePtr), but report failures with an
+              error code instead of an exception, see tryOpen(Image::UniquePtr&,
+              const std::string&, bool). An \em io of an unknown image type is
+              reported as kerFileContainsUnknownImageType.
+         */
+        static ErrorCode tryOpen(Image::UniquePtr& image, BasicIo::UniquePtr io);
+        /*!
+          @brief Like open(BasicIo::UniquePtr, int), but report failures with
+              an error code instead of an exception, see tryOpen(Image::UniquePtr&,
+              BasicIo::UniquePtr).
+         */
+        static ErrorCode tryOpen(Image::UniquePtr& image, BasicIo::UniquePtr io, int typeHint);
         /*!
           @brief Create an Image subclass of the requested type by creating a
               new image file. If the file already exists, it will be overwritten.
@@ -34,6 +34,8 @@
 #include "metadatum.hpp"
 #include "datasets.hpp"
 
+// + standard includes
+
 // *****************************************************************************
 // namespace extensions
 namespace Exiv2 {
@@ -67,8 +69,15 @@ namespace Exiv2 {
          */
         explicit Iptcdatum(const IptcKey& key,
                            const Value* pValue =0);
+        /*!
+          @brief Constructor which takes ownership of \em value instead of
+                 copying it. Decoders use it to hand over the values they read.
+         */
+        Iptcdatum(const IptcKey& key, Value::UniquePtr value);
         //! Copy constructor
         Iptcdatum(const Iptcdatum& rhs);
+        //! Move constructor, takes over the key and value of \em rhs
+        Iptcdatum(Iptcdatum&& rhs) noexcept;
         //! Destructor
         virtual ~Iptcdatum();
         //@}
@@ -77,6 +86,8 @@ namespace Exiv2 {
         //@{
         //! Assignment operator
         Iptcdatum& operator=(const Iptcdatum& rhs);
+        //! Move assignment operator, takes over the key and value of \em rhs
+        Iptcdatum& operator=(Iptcdatum&& rhs) noexcept;
         /*!
           @brief Assign \em value to the %Iptcdatum. The type of the new Value
                  is set to UShortValue.
@@ -159,6 +170,34 @@ namespace Exiv2 {
     //! Container type to hold all metadata
     typedef std::vector<Iptcdatum> IptcMetadata;
 
+    /*!
+      @brief An IPTC key which is resolved once to its record and dataset
+             number and can then be used for any number of lookups in any
+             %IptcData, see ExifKeyHandle.
+     */
+    class EXIV2API IptcKeyHandle {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor to resolve a key string.
+          @throw Error if the key cannot be parsed.
+         */
+        explicit IptcKeyHandle(const std::string& key) : key_(key) {}
+        //! Constructor from a key
+        explicit IptcKeyHandle(const IptcKey& key) : key_(key) {}
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the key
+        const IptcKey& key() const { return key_; }
+        //@}
+
+    private:
+        IptcKey key_;                           //!< The resolved key
+    };
+
     /*!
       @brief A container for IPTC data. This is a top-level class of
              the %Exiv2 library.
@@ -169,6 +208,10 @@ namespace Exiv2 {
       - add, modify and delete metadata
       - write IPTC data to JPEG files
       - extract IPTC metadata to files, insert from these files
+
+      Lookups by key or id, including the check for non-repeatable datasets
+      in add(), use an Internal::KeyIndex on the record and dataset number.
+      Like in XmpData, erase() invalidates it.
     */
     class EXIV2API IptcData {
     public:
@@ -177,7 +220,9 @@ namespace Exiv2 {
         //! IptcMetadata const iterator type
         typedef IptcMetadata::const_iterator const_iterator;
 
-        // Use the compiler generated constructors and assignment operator
+        //! Default constructor
+        IptcData() : index_(false) {}
+        // Use the compiler generated copy constructor and assignment operator
 
         //! @name Manipulators
         //@{
@@ -190,6 +235,8 @@ namespace Exiv2 {
                  member function.
          */
         Iptcdatum& operator[](const std::string& key);
+        //! Like operator[](const std::string&), for a key which is already resolved
+        Iptcdatum& operator[](const IptcKeyHandle& key);
         /*!
           @brief Add an %Iptcdatum from the supplied key and value pair. This
                  method copies (clones) the value. A check for non-repeatable
@@ -198,6 +245,14 @@ namespace Exiv2 {
                   6 if the dataset already exists and is not repeatable
          */
         int add(const IptcKey& key, Value* value);
+        /*!
+          @brief Add an %Iptcdatum from the supplied key and value pair,
+                 taking ownership of the value. A check for non-repeatable
+                 datasets is performed.
+          @return 0 if successful;<BR>
+                  6 if the dataset already exists and is not repeatable
+         */
+        int add(const IptcKey& key, Value::UniquePtr value);
         /*!
           @brief Add a copy of the Iptcdatum to the IPTC metadata. A check
                  for non-repeatable datasets is performed.
@@ -205,6 +260,8 @@ namespace Exiv2 {
                  6 if the dataset already exists and is not repeatable;<BR>
          */
         int add(const Iptcdatum& iptcdatum);
+        //! Add \em iptcdatum to the IPTC metadata, moving instead of copying it.
+        int add(Iptcdatum&& iptcdatum);
         /*!
           @brief Delete the Iptcdatum at iterator position pos, return the
                  position of the next Iptcdatum. Note that iterators into
@@ -215,13 +272,13 @@ namespace Exiv2 {
         /*!
           @brief Delete all Iptcdatum instances resulting in an empty container.
          */
-        void clear() { iptcMetadata_.clear(); }
+        void clear() { iptcMetadata_.clear(); index_ = Index(false); }
         //! Sort metadata by key
         void sortByKey();
         //! Sort metadata by tag (aka dataset)
         void sortByTag();
-        //! Begin of the metadata
-        iterator begin() { return iptcMetadata_.begin(); }
+        //! Begin of the metadata, invalidates the index
+        iterator begin() { index_.invalidate(); return iptcMetadata_.begin(); }
         //! End of the metadata
         iterator end() { return iptcMetadata_.end(); }
         /*!
@@ -229,12 +286,16 @@ namespace Exiv2 {
                  to it.
          */
         iterator findKey(const IptcKey& key);
+        //! Find the first Iptcdatum with the \em key of the handle
+        iterator findKey(const IptcKeyHandle& key) { return findKey(key.key()); }
         /*!
           @brief Find the first Iptcdatum with the given record and dataset it,
                 return a const iterator to it.
          */
         iterator findId(uint16_t dataset,
                         uint16_t record = IptcDataSets::application2);
+        //! Set the filter which decoders honour when they fill this container
+        void setDecodeFilter(const DecodeFilter& filter) { decodeFilter_ = filter; }
         //@}
 
         //! @name Accessors
@@ -248,6 +309,8 @@ namespace Exiv2 {
                  iterator to it.
          */
         const_iterator findKey(const IptcKey& key) const;
+        //! Find the first Iptcdatum with the \em key of the handle
+        const_iterator findKey(const IptcKeyHandle& key) const { return findKey(key.key()); }
         /*!
           @brief Find the first Iptcdatum with the given record and dataset
                  number, return a const iterator to it.
@@ -270,11 +333,26 @@ namespace Exiv2 {
           @brief dump iptc formatted binary data (used by printStructure kpsRecursive)
         */
         static void printStructure(std::ostream& out, const Slice<byte*>& bytes,uint32_t depth);
+        //! Return the filter which decoders honour when they fill this container
+        const DecodeFilter& decodeFilter() const { return decodeFilter_; }
+        //! Return an estimate of the heap memory held by the metadata, see Image::memoryUsage()
+        MemoryUsage memoryUsage() const;
         //@}
 
     private:
+        //! Index type, maps the record and dataset number of an id to the positions of the metadata with that id
+        typedef Internal::KeyIndex<uint32_t, IptcMetadata::size_type> Index;
+
+        //! @name Manipulators
+        //@{
+        //! Rebuild the index from scratch
+        void indexRebuild();
+        //@}
+
         // DATA
         IptcMetadata iptcMetadata_;
+        DecodeFilter decodeFilter_;             //!< Filter honoured by the decoders
+        Index        index_;                    //!< Id index of iptcMetadata_
     }; // class IptcData
 
     /*!
@@ -73,6 +73,8 @@ namespace Exiv2
         //@{
         void readMetadata() override;
         void writeMetadata() override;
+        //! Stream the image with the buffered metadata to \em dst
+        void writeMetadataTo(BasicIo& dst) override;
 
         /*!
           @brief Print out the structure of image file.
@@ -115,6 +117,12 @@ namespace Exiv2
          @param newData DataBufRef with updated data
          */
         void encodeJp2Header(const DataBuf& oldData,DataBuf& newData);
+
+        /*!
+         @brief Decode the XMP packet in \em data, which may be preceded by
+                padding, to xmpPacket_ and xmpData_.
+         */
+        void decodeXmpPacket(const byte* data, long size);
         //@}
 
     }; // class Jp2Image
@@ -39,6 +39,11 @@
 // included header files
 #include "image.hpp"
 
+// + standard includes
+#include <iosfwd>
+#include <utility>
+#include <vector>
+
 // *****************************************************************************
 // namespace extensions
 namespace Exiv2 {
@@ -64,6 +69,16 @@ namespace Exiv2 {
         static const uint16_t iptc_;    //!< %Photoshop IPTC marker
         static const uint16_t preview_; //!< %Photoshop preview marker
 
+        //! Location of an IRB within a %Photoshop formated buffer
+        struct Irb {
+            uint16_t psTag_;            //!< %Tag number of the IRB
+            long     offset_;           //!< Offset of the IRB from the start of the buffer
+            uint32_t sizeHdr_;          //!< Size of the IRB header
+            uint32_t sizeData_;         //!< Size of the IRB data, without the pad byte
+        };
+        //! Index of the IRBs in a %Photoshop formated buffer, in buffer order
+        typedef std::vector<Irb> IrbIndex;
+
         /*!
           @brief Checks an IRB
 
@@ -123,6 +138,22 @@ namespace Exiv2 {
                                     const byte **record,
                                     uint32_t *const sizeHdr,
                                     uint32_t *const sizeData);
+        /*!
+          @brief Index all IRBs of a %Photoshop formated memory buffer in one
+              pass, for repeated lookups with findIrb().
+          @param pPsData Pointer to buffer containing entire payload of
+              %Photoshop formated data, e.g., from APP13 Jpeg segment.
+          @param sizePsData Size in bytes of pPsData.
+          @param index Output value that is set to the IRBs found in pPsData.
+              If pPsData contains invalid data, it holds the IRBs before it.
+          @return 3 if pPsData consists of valid IRBs;<BR>
+                 -2 if the pPsData buffer does not contain valid data.
+        */
+        static int indexIrbs(const byte* pPsData,
+                             long        sizePsData,
+                             IrbIndex&   index);
+        //! Return the first IRB with tag \em psTag in \em index, 0 if there is none
+        static const Irb* findIrb(const IrbIndex& index, uint16_t psTag);
         /*!
           @brief Set the new IPTC IRB, keeps existing IRBs but removes the
                  IPTC block if there is no new IPTC data to write.
@@ -143,10 +174,48 @@ namespace Exiv2 {
      */
     class EXIV2API JpegBase : public Image {
     public:
+        /*!
+          @brief Tags to set in the Exif data copied by transplantMetadata(),
+                 e.g., for a resized or rotated derivative. A value of 0
+                 leaves the tag alone.
+         */
+        struct ExifPatch {
+            //! Default constructor, patches nothing
+            ExifPatch() : orientation_(0), pixelWidth_(0), pixelHeight_(0) {}
+            uint16_t orientation_;              //!< Exif.Image.Orientation
+            uint32_t pixelWidth_;               //!< Exif.Photo.PixelXDimension
+            uint32_t pixelHeight_;              //!< Exif.Photo.PixelYDimension
+        };
+
         //! @name Manipulators
         //@{
         void readMetadata() override;
+        void readBasicInfo() override;
         void writeMetadata() override;
+        //! Stream the image with the buffered metadata to \em dst
+        void writeMetadataTo(BasicIo& dst) override;
+        //! Copy the image to \em dst without the APP1, APP13 and COM segments
+        void stripMetadataTo(BasicIo& dst, int keep =mdNone) override;
+        /*!
+          @brief Copy the metadata segments of \em source to this image byte
+                 for byte, without decoding and encoding the metadata.
+
+          The segments of the types \em metadataIds (a combination of
+          MetadataId values) replace those of this image, which is
+          rewritten. They are inserted after the JFIF segment, if any, in
+          the order of the source. The Exif data of the source, including
+          its makernote, is copied unchanged, except for the tags set in
+          \em patch. These are patched in place and only if they are present
+          in the Exif data with a single SHORT or LONG value.
+
+          The buffered metadata of this image is not changed, call
+          readMetadata() to read the new metadata.
+          @throw Error if either image cannot be read or this image cannot be
+                 written
+         */
+        void transplantMetadata(JpegBase& source,
+                                int metadataIds =mdExif|mdIptc|mdXmp|mdIccProfile,
+                                const ExifPatch& patch =ExifPatch());
 
         /*!
           @brief Print out the structure of image file.
@@ -155,6 +224,16 @@ namespace Exiv2 {
           @warning This function is not thread safe and intended for exiv2 -pS for debugging.
          */
         void printStructure(std::ostream& out, PrintStructureOption option,int depth) override;
+        void setIccProfile(DataBuf& iccProfile, bool bTestValid=true) override;
+        void clearIccProfile() override;
+        bool iccProfileDefined() override;
+        /*!
+          @brief Return the ICC profile. readMetadata() only records where the
+              chunks of the profile are, the profile is read from the image on
+              the first call.
+          @throw Error if the image cannot be opened
+         */
+        DataBuf* iccProfile() override;
         //@}
 
     protected:
@@ -274,6 +353,24 @@ namespace Exiv2 {
           @return 4 if opening or writing to the associated BasicIo fails
          */
         void doWriteMetadata(BasicIo& oIo);
+        /*!
+          @brief Try to update the metadata segments of the image in place.
+
+          This succeeds only if the image already has a segment for each
+          type of metadata to write, the re-encoded metadata fits into it
+          and no segment needs to be removed. The image data is not
+          modified otherwise.
+          @return true if the metadata was written in place;<BR>
+                  false if the image needs to be rewritten.
+          @throw Error if writing to the associated BasicIo fails
+         */
+        bool writeMetadataInPlace();
+        /*!
+          @brief Read the metadata segments of the types \em metadataIds,
+                 including their marker, to \em segments.
+          @throw Error if the image cannot be read
+         */
+        void readMetadataSegments(int metadataIds, std::vector<Blob>& segments);
         //@}
 
         //! @name Accessors
@@ -287,8 +384,26 @@ namespace Exiv2 {
                  -1 if a maker was not found before EOF
          */
         int advanceToMarker() const;
+        /*!
+          @brief Return the MetadataId of the segment with \em marker and
+                 length \em size, whose data after the length is at \em data.
+          @return the MetadataId of the segment;<BR>
+                  mdNone for an APP1 or APP13 segment of another application;<BR>
+                  -1 if the segment is not a metadata segment
+         */
+        static int metadataId(int marker, const byte* data, long size);
         //@}
 
+        //! @name Manipulators
+        //@{
+        //! Read the ICC profile from the chunks recorded by readMetadata(), if any
+        void readIccProfile();
+        //@}
+
+        // DATA
+        //! Positions and sizes of the ICC profile chunks which are not read yet
+        std::vector<std::pair<long, long> > iccChunks_;
+
     }; // class JpegBase
 
     /*!
@@ -416,6 +531,19 @@ namespace Exiv2 {
     EXIV2API Image::UniquePtr newJpegInstance(BasicIo::UniquePtr io, bool create);
     //! Check if the file iIo is a JPEG image.
     EXIV2API bool isJpegType(BasicIo& iIo, bool advance);
+    /*!
+      @brief Read the head of a JPEG stream: the SOI marker and the segments
+             which follow it, up to and including the SOS marker which starts
+             the image data, or the EOI marker. The rest of the stream is not
+             read. A JpegImage opened on the head can write it with new
+             metadata, the rest of the stream then follows as it is. Only the
+             segments are buffered, not the image data.
+      @param is The stream to read from.
+      @param head Set to the data read from the stream.
+      @return true if the head is complete, false if the stream is not a JPEG
+             stream or ends before the head does.
+     */
+    EXIV2API bool readJpegHead(std::istream& is, Blob& head);
     /*!
       @brief Create a new ExvImage instance and return an auto-pointer to it.
              Caller owns the returned object and the auto-pointer ensures that
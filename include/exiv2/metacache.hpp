@@ -0,0 +1,117 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    metacache.hpp
+  @brief   Persistent cache of the metadata of image files
+ */
+#ifndef METACACHE_HPP_
+#define METACACHE_HPP_
+
+// *****************************************************************************
+#include "exiv2lib_export.h"
+
+// included header files
+#include "types.hpp"
+
+// + standard includes
+#include <memory>
+#include <string>
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+
+    class Image;
+
+// *****************************************************************************
+// class definitions
+
+    /*!
+      @brief Persistent cache of the metadata of image files, which lets
+             applications that read the same files again and again skip
+             the parsing of files which did not change.
+
+      The cache is a file which holds a compact binary serialization of the
+      Exif, IPTC and XMP metadata, the XMP packet, the comment, the ICC
+      profile, the pixel size, the byte order and the native previews of
+      each image, keyed by the path of the image file. An entry is used only
+      if the size, the modification time and the inode of the file are those
+      recorded with it.
+
+      The cache file is mapped to memory when the cache is opened. New
+      entries are appended to it right away; when a file changed, the newer
+      entry supersedes the older one. A cache file written by another
+      version of %Exiv2 is discarded. A cache must not be used by several
+      threads at the same time.
+
+      Images read from the cache are meant for reading the metadata: call
+      Image::readMetadata() before writing the metadata of such an image.
+     */
+    class EXIV2API MetadataCache {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Open the cache file \em path, create it if it does not exist.
+          @throw Error if the cache file cannot be opened or created.
+         */
+        explicit MetadataCache(const std::string& path);
+        //! Destructor
+        ~MetadataCache();
+        MetadataCache(const MetadataCache& rhs) = delete;
+        MetadataCache& operator=(const MetadataCache& rhs) = delete;
+        //@}
+
+        //! @name Manipulators
+        //@{
+        /*!
+          @brief Fill \em image with its metadata, from the cache if it holds
+                 an up to date entry for the file of the image, otherwise
+                 with Image::readMetadata(), and then add an entry.
+
+          Images which are not files, e.g., in memory or remote, and images
+          with a decode filter are always read with Image::readMetadata().
+
+          @return true if the metadata was taken from the cache.
+          @throw Error if the metadata cannot be read or the cache file
+                 cannot be written.
+         */
+        bool readMetadata(Image& image);
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the number of entries in the cache
+        long size() const;
+        //! Return the number of images read from the cache so far
+        long hits() const;
+        //! Return the number of images read with Image::readMetadata() so far
+        long misses() const;
+        //@}
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> p_;
+
+    }; // class MetadataCache
+
+}                                       // namespace Exiv2
+
+#endif                                  // #ifndef METACACHE_HPP_
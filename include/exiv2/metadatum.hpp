@@ -37,6 +37,11 @@
 // included header files
 #include "value.hpp"
 
+// + standard includes
+#include <set>
+#include <string>
+#include <unordered_map>
+
 // *****************************************************************************
 // namespace extensions
 namespace Exiv2 {
@@ -119,6 +124,63 @@ namespace Exiv2 {
         return key.write(os);
     }
 
+    /*!
+      @brief Whitelist of the metadata that a decoder materializes.
+
+      The filter is carried by the metadata containers (ExifData,
+      IptcData, XmpData) and honoured by the Exif, IPTC and XMP parsers.
+      Metadata which are not accepted are skipped before any %Exifdatum,
+      %Iptcdatum, %Xmpdatum or Value is created for them. An empty filter
+      accepts everything, which is the default.
+
+      Metadata can be accepted by family (e.g. "Exif"), by group (e.g.
+      "Exif", "Photo") or by key (e.g. "Exif.Image.Orientation"). An XMP key
+      also accepts the fields of the structure or array it names.
+     */
+    class EXIV2API DecodeFilter {
+    public:
+        //! @name Manipulators
+        //@{
+        //! Accept all metadata of family \em familyName, e.g. "Iptc"
+        DecodeFilter& addFamily(const std::string& familyName);
+        //! Accept all metadata of group \em groupName of family \em familyName
+        DecodeFilter& addGroup(const std::string& familyName, const std::string& groupName);
+        /*!
+          @brief Accept the metadatum with key \em key. The key is given in the
+                 "Family.Group.Tag" form of Key::key().
+         */
+        DecodeFilter& addKey(const std::string& key);
+        //! Remove all entries, the filter accepts everything again
+        void clear();
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return true if the filter accepts everything
+        bool empty() const;
+        /*!
+          @brief Return true if some of the metadata of group \em groupName of
+                 family \em familyName may be accepted. Decoders use this to
+                 skip whole groups without looking at the individual tags.
+         */
+        bool acceptsGroup(const std::string& familyName, const std::string& groupName) const;
+        //! Return true if the metadatum with key \em key is accepted
+        bool accepts(const Key& key) const;
+        //! Return true if the filter accepts nothing but individual keys
+        bool hasKeysOnly() const;
+        //! Return the keys added with addKey()
+        const std::set<std::string>& keys() const;
+        //@}
+
+    private:
+        // DATA
+        std::set<std::string> families_;        //!< Accepted families
+        std::set<std::string> groups_;          //!< Accepted groups, as "Family.Group"
+        std::set<std::string> keyGroups_;       //!< Groups of the accepted keys
+        std::set<std::string> keys_;            //!< Accepted keys
+
+    }; // class DecodeFilter
+
     /*!
       @brief Abstract base class defining the interface to access information
              related to one metadata tag.
@@ -311,6 +373,98 @@ namespace Exiv2 {
      */
     EXIV2API bool cmpMetadataByKey(const Metadatum& lhs, const Metadatum& rhs);
 
+    namespace Internal {
+
+    /*!
+      @brief Index of the metadata of a container by key, shared by ExifData,
+             XmpData and IptcData.
+
+      For each key, the index holds the position of the first metadatum with
+      that key, an iterator or an offset into the container, and the number
+      of metadata with it. Containers add new metadata with add() and keep
+      the index up to date when they erase one with erase(). Anything else
+      which may move metadata or change their keys, like sorting or handing
+      out a mutable iterator, must invalidate() the index; it is then
+      rebuilt by the next non-const lookup. A lookup must still check the
+      key of the metadatum it finds, as a key may have been changed through
+      a reference returned by an earlier lookup.
+     */
+    template <typename Key, typename Pos>
+    class KeyIndex {
+    public:
+        //! Index entry: first metadatum with a given key and number of such metadata
+        struct Entry {
+            Pos  pos_;                          //!< Position of the first metadatum with the key
+            long count_;                        //!< Number of metadata with the key
+        };
+        //! Map type, from the keys to their entries
+        typedef std::unordered_map<Key, Entry> Map;
+
+        //! Constructor, an empty container starts with a valid or an invalid index
+        explicit KeyIndex(bool valid) : valid_(valid) {}
+
+        //! @name Manipulators
+        //@{
+        //! Add the metadatum at \em pos with \em key, if the index is valid
+        void add(const Key& key, Pos pos)
+        {
+            if (!valid_) return;
+            Entry entry = { pos, 0 };
+            ++map_.insert(std::make_pair(key, entry)).first->second.count_;
+        }
+        /*!
+          @brief Remove the metadatum at \em pos with \em key, before it is
+                 erased, if the index is valid. If it is the first of several
+                 metadata with the key, \em findNext(next) is called to set
+                 the position of the next one; it returns false if there is
+                 none. Positions must not change by erasing a metadatum.
+         */
+        template <typename FindNext>
+        void erase(const Key& key, Pos pos, FindNext findNext)
+        {
+            if (!valid_) return;
+            typename Map::iterator i = map_.find(key);
+            if (i == map_.end()) return;
+            if (--i->second.count_ == 0) {
+                map_.erase(i);
+            }
+            else if (i->second.pos_ == pos && !findNext(i->second.pos_)) {
+                map_.erase(i);
+            }
+        }
+        //! Mark the index as out of date
+        void invalidate() { valid_ = false; }
+        //! Rebuild the index from the metadata from \em first to \em last, \em keyOf returns the key at a position
+        template <typename KeyOf>
+        void rebuild(Pos first, Pos last, KeyOf keyOf)
+        {
+            map_.clear();
+            valid_ = true;
+            for (Pos pos = first; pos != last; ++pos) add(keyOf(pos), pos);
+        }
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return true if the index is up to date
+        bool valid() const { return valid_; }
+        //! Return the entry for \em key or 0 if there is none
+        const Entry* find(const Key& key) const
+        {
+            typename Map::const_iterator i = map_.find(key);
+            return i == map_.end() ? 0 : &i->second;
+        }
+        //! Return the map, e.g., to estimate its memory usage
+        const Map& map() const { return map_; }
+        //@}
+
+    private:
+        Map  map_;                              //!< Entries of the keys
+        bool valid_;                            //!< Flag indicating if map_ is up to date
+    }; // class KeyIndex
+
+    }                                       // namespace Internal
+
 }                                       // namespace Exiv2
 
 #endif                                  // #ifndef METADATUM_HPP_
@@ -0,0 +1,110 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    metadiff.hpp
+  @brief   Differences between two versions of the metadata of an image
+ */
+#ifndef METADIFF_HPP_
+#define METADIFF_HPP_
+
+// *****************************************************************************
+#include "exiv2lib_export.h"
+
+// included header files
+#include "types.hpp"
+
+// + standard includes
+#include <string>
+#include <vector>
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+
+    class ExifData;
+    class IptcData;
+    class XmpData;
+
+// *****************************************************************************
+// class definitions
+
+    /*!
+      @brief Differences between two versions of the Exif, IPTC and XMP
+             metadata of an image, e.g., the metadata read from the image
+             and the metadata to write to it.
+
+      Datums are matched by their key and, for repeated keys, by their
+      occurrence among the datums with that key. Exif and IPTC datums are
+      matched by their numeric group and tag, XMP datums by their key.
+      Values are compared by their type, count and contents.
+
+      Image::writeChangedMetadata() uses the differences to skip writing
+      unchanged metadata and to update the image in place if all changes
+      keep the size of the values.
+     */
+    class EXIV2API MetadataDiff {
+    public:
+        //! Types of changes
+        enum ChangeType { added, removed, modified };
+        //! Change of one datum
+        struct Change {
+            MetadataId metadataId_;             //!< mdExif, mdIptc or mdXmp
+            ChangeType type_;                   //!< Type of the change
+            std::string key_;                   //!< Key of the datum
+            bool sameSize_;                     //!< True if a modified value has the same type and size
+        };
+        //! List of changes
+        typedef std::vector<Change> Changes;
+
+        //! @name Manipulators
+        //@{
+        //! Add the differences between the Exif data \em before and \em after
+        void compare(const ExifData& before, const ExifData& after);
+        //! Add the differences between the IPTC data \em before and \em after
+        void compare(const IptcData& before, const IptcData& after);
+        //! Add the differences between the XMP data \em before and \em after
+        void compare(const XmpData& before, const XmpData& after);
+        //! Remove all changes
+        void clear() { changes_.clear(); }
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return true if there are no changes
+        bool empty() const { return changes_.empty(); }
+        /*!
+          @brief Return true if all changes modify values without changing
+                 their type and size. The encoded metadata then keeps its
+                 layout.
+         */
+        bool fixedSize() const;
+        //! Return the changes, in the order of the comparisons
+        const Changes& changes() const { return changes_; }
+        //@}
+
+    private:
+        // DATA
+        Changes changes_;                       //!< Changes found so far
+
+    }; // class MetadataDiff
+
+}                                       // namespace Exiv2
+
+#endif                                  // #ifndef METADIFF_HPP_
@@ -0,0 +1,146 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    metaindex.hpp
+  @brief   Persistent index of the values of a few metadata keys of many
+           image files
+ */
+#ifndef METAINDEX_HPP_
+#define METAINDEX_HPP_
+
+// *****************************************************************************
+#include "exiv2lib_export.h"
+
+// included header files
+#include "batch.hpp"
+
+// + standard includes
+#include <memory>
+#include <string>
+#include <vector>
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+
+// *****************************************************************************
+// class definitions
+
+    /*!
+      @brief Persistent index of the values of a few metadata keys of many
+             image files, which answers queries like "all images with this
+             lens" without reading the images again.
+
+      The index holds a row for each file, with the path and the identity
+      of the file (its size, modification time and inode), and a column for
+      each key, with the interpreted values of the key in each file, as
+      printed by <CODE>exiv2 -pa</CODE>. A key which occurs several times
+      in a file, e.g., IPTC keywords, has several values in its row.
+
+      update() reads only the files which are new or changed since they
+      were indexed, with a BatchProcessor and a DecodeFilter which decodes
+      only the keys of the index. The index is written to its file with
+      write(). In the file, the values of each column are stored together
+      and the file is mapped to memory when the index is opened, so a query
+      of one key reads only the rows and the values of that key.
+
+      An index file written by another version of %Exiv2 is discarded. An
+      index must not be used by several threads at the same time.
+     */
+    class EXIV2API MetadataIndex {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Open the index file \em path. If it does not exist or is
+                 not a valid index, the index is empty and the file is
+                 created by write().
+         */
+        explicit MetadataIndex(const std::string& path);
+        //! Destructor
+        ~MetadataIndex();
+        MetadataIndex(const MetadataIndex& rhs) = delete;
+        MetadataIndex& operator=(const MetadataIndex& rhs) = delete;
+        //@}
+
+        //! @name Manipulators
+        //@{
+        /*!
+          @brief Set the keys of the columns of the index. If they differ
+                 from the keys of the index, all rows are removed and the
+                 files are read again by the next update().
+          @throw Error if a key is not a valid Exif, IPTC or XMP key.
+         */
+        void setKeys(const std::vector<std::string>& keys);
+        /*!
+          @brief Update the index with the files which \em source returns.
+                 Files which are not in the index or which changed are read
+                 with a BatchProcessor with \em threads worker threads.
+                 Rows of files which \em source does not return are kept if
+                 their file did not change and removed otherwise. The rows
+                 are sorted by path.
+          @return The result of each file which was read
+          @throw Any exception thrown by \em source.
+         */
+        BatchProcessor::Results update(const BatchProcessor::PathSource& source, unsigned int threads =0);
+        /*!
+          @brief Write the index to its file.
+          @throw Error if the file cannot be written.
+         */
+        void write();
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the keys of the columns of the index
+        const std::vector<std::string>& keys() const;
+        //! Return the number of rows, one for each file
+        size_t size() const;
+        //! Return the path of the file of row \em row
+        const std::string& path(size_t row) const;
+        /*!
+          @brief Return the values of the key \em key in row \em row, none if
+                 the file has no such metadatum.
+          @throw Error if \em key is not a key of the index.
+         */
+        std::vector<std::string> values(size_t row, const std::string& key) const;
+        /*!
+          @brief Return the rows in which the key \em key has the value
+                 \em value, in the order of the rows.
+          @throw Error if \em key is not a key of the index.
+         */
+        std::vector<size_t> find(const std::string& key, const std::string& value) const;
+        //! Return the number of files read by the last update()
+        long read() const;
+        //! Return the number of rows which the last update() kept without reading their file
+        long unchanged() const;
+        //! Return the number of rows which the last update() removed
+        long removed() const;
+        //@}
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> p_;
+
+    }; // class MetadataIndex
+
+}                                       // namespace Exiv2
+
+#endif                                  // #ifndef METAINDEX_HPP_
@@ -0,0 +1,182 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    metaview.hpp
+  @brief   Flat, read-only view of decoded metadata, which other processes
+           can read from a mapped file or shared memory without decoding it
+ */
+#ifndef METAVIEW_HPP_
+#define METAVIEW_HPP_
+
+// *****************************************************************************
+#include "exiv2lib_export.h"
+
+// included header files
+#include "types.hpp"
+#include "value.hpp"
+
+// + standard includes
+#include <string>
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+
+    class ExifData;
+    class IptcData;
+    class XmpData;
+
+// *****************************************************************************
+// class definitions
+
+    /*!
+      @brief Read-only view of Exif, IPTC and XMP metadata in a flat binary
+             layout, which is read in place, without creating any datums.
+
+      One process decodes the metadata of an image and encodes it with
+      encode(). Other processes map the result to memory, e.g., with
+      FileIo::mmap() or from shared memory, and iterate over the entries
+      or look up keys directly in the mapped bytes.
+
+      The layout consists of a header, a table of the entries in the order
+      of the containers (Exif, then IPTC, then XMP), a table of the distinct
+      keys sorted by name, the indices of the entries of each key and a
+      blob with the names of the keys and the values. All numbers are
+      little endian and the tables hold offsets into the blob, so the
+      bytes can be read at any address. Exif and IPTC values are stored in
+      their binary format in little endian byte order, XMP text values as
+      text and the items of XMP arrays as NUL terminated strings.
+
+      The view does not own the bytes, which must outlive it, unless it is
+      created from a SharedBuf. The constructor checks the header and the
+      bounds of the tables; an entry whose offsets are out of bounds is
+      reported as corrupted when it is accessed. A view can be read by
+      many threads at the same time.
+     */
+    class EXIV2API MetadataView {
+    public:
+        //! An entry of the view, a lightweight handle to the bytes of the view
+        class EXIV2API Entry {
+        public:
+            //! Default constructor, an invalid entry
+            Entry() : view_(0), record_(0) {}
+            //! Return true if the entry refers to an entry of a view
+            bool valid() const { return record_ != 0; }
+            //! Return the family of the metadata: mdExif, mdIptc or mdXmp
+            MetadataId family() const;
+            //! Return the key, e.g., "Exif.Image.Make", as a NUL terminated string in the view
+            const char* key() const;
+            //! Return the length of the key
+            size_t keySize() const;
+            //! Return the type of the value
+            TypeId typeId() const;
+            //! Return the number of components of the value
+            long count() const;
+            //! Return the stored bytes of the value
+            const byte* data() const;
+            //! Return the number of stored bytes of the value
+            size_t size() const;
+            /*!
+              @brief Return a new value with the contents of the entry,
+                     0 if the datum had no value.
+              @throw Error if the entry is corrupted.
+             */
+            Value::UniquePtr value() const;
+            //! Return the value as a string
+            std::string toString() const;
+
+        private:
+            friend class MetadataView;
+            Entry(const MetadataView* view, const byte* record) : view_(view), record_(record) {}
+            const MetadataView* view_;          //!< View of the entry
+            const byte* record_;                //!< Record of the entry in the entry table
+        }; // class Entry
+
+        //! @name Creators
+        //@{
+        /*!
+          @brief Create a view of the \em size bytes at \em data, which must
+                 outlive the view.
+          @throw Error if the bytes are not a metadata view.
+         */
+        MetadataView(const byte* data, size_t size);
+        /*!
+          @brief Create a view of the bytes of \em buf, which the view keeps.
+          @throw Error if the bytes are not a metadata view.
+         */
+        explicit MetadataView(const SharedBuf& buf);
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the number of entries
+        size_t size() const { return entryCount_; }
+        //! Return true if the view has no entries
+        bool empty() const { return entryCount_ == 0; }
+        //! Return the number of distinct keys
+        size_t keyCount() const { return keyCount_; }
+        //! Return the \em n-th entry, in the order of the containers
+        Entry operator[](size_t n) const;
+        //! Return the number of entries with the key \em key
+        size_t count(const std::string& key) const;
+        /*!
+          @brief Return the \em n-th entry with the key \em key, an invalid
+                 entry if there is none. Looks up the key with a binary
+                 search of the key table.
+         */
+        Entry findKey(const std::string& key, size_t n = 0) const;
+        //@}
+
+        /*!
+          @brief Encode the metadata of the containers in the layout of a
+                 view and append it to \em blob. The lazy makernote of
+                 \em exifData is decoded. The data areas of Exif values are
+                 not encoded.
+         */
+        static void encode(Blob& blob,
+                           const ExifData& exifData,
+                           const IptcData& iptcData,
+                           const XmpData& xmpData);
+
+    private:
+        //! Initialize the view from the bytes of the view
+        void init();
+        //! Return the record of the key \em key, 0 if there is none
+        const byte* findRecord(const std::string& key) const;
+        //! Return the \em size bytes at \em offset of the blob, throw if they are out of bounds
+        const byte* blobData(uint32_t offset, uint64_t size) const;
+
+        // DATA
+        SharedBuf buf_;                         //!< Bytes of the view if it keeps them
+        const byte* data_;                      //!< Bytes of the view
+        size_t size_;                           //!< Number of bytes of the view
+        uint32_t entryCount_;                   //!< Number of entries
+        uint32_t keyCount_;                     //!< Number of distinct keys
+        const byte* entries_;                   //!< Entry table
+        const byte* keys_;                      //!< Key table
+        const byte* index_;                     //!< Entry indices of the keys
+        const byte* blob_;                      //!< Names of the keys and values
+        uint32_t blobSize_;                     //!< Size of the blob
+
+    }; // class MetadataView
+
+}                                       // namespace Exiv2
+
+#endif                                  // #ifndef METAVIEW_HPP_
@@ -80,6 +80,8 @@ namespace Exiv2
         //@{
         void readMetadata() override;
         void writeMetadata() override;
+        //! Stream the image with the buffered metadata to \em dst
+        void writeMetadataTo(BasicIo& dst) override;
         //@}
 
         //! @name Accessors
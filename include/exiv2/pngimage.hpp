@@ -80,7 +80,12 @@ namespace Exiv2
         //! @name Manipulators
         //@{
         void readMetadata() override;
+        void readBasicInfo() override;
         void writeMetadata() override;
+        //! Stream the image with the buffered metadata to \em dst
+        void writeMetadataTo(BasicIo& dst) override;
+        //! Copy the image to \em dst without the text, eXIf and iCCP chunks
+        void stripMetadataTo(BasicIo& dst, int keep =mdNone) override;
 
         /*!
           @brief Print out the structure of image file.
@@ -89,11 +94,31 @@ namespace Exiv2
           @warning This function is not thread safe and intended for exiv2 -pS for debugging.
          */
         void printStructure(std::ostream& out, PrintStructureOption option,int depth) override;
+        /*!
+          @brief Write the Exif metadata as an ImageMagick "Raw profile type
+              exif" text chunk, for readers which do not know the eXIf chunk.
+              The default is false, writeMetadata() then writes a binary eXIf
+              chunk, which is smaller and faster to read. Both are read.
+         */
+        void writeExifRawProfile(bool flag);
+        void setIccProfile(DataBuf& iccProfile, bool bTestValid=true) override;
+        void clearIccProfile() override;
+        bool iccProfileDefined() override;
+        /*!
+          @brief Return the ICC profile. readMetadata() only records where the
+              iCCP chunk is, the profile is inflated on the first call. Use
+              setIccProfile() to change it, writeMetadata() copies the iCCP
+              chunk of the image unchanged until then.
+          @throw Error if the image cannot be opened
+         */
+        DataBuf* iccProfile() override;
         //@}
 
         //! @name Accessors
         //@{
         std::string mimeType() const override;
+        //! Return the flag indicating if Exif metadata is written as a raw text profile.
+        bool writeExifRawProfile() const;
         //@}
 
         PngImage& operator=(const PngImage& rhs) = delete;
@@ -107,12 +132,19 @@ namespace Exiv2
                 writing all buffered metadata to the provided BasicIo.
           @throw Error on input-output errors or when the image data is not valid.
           @param oIo BasicIo instance to write to (a temporary location).
-
+          @return The position of the iCCP chunk in \em oIo if the chunk of the
+                image was copied unchanged, -1 otherwise.
          */
-        void doWriteMetadata(BasicIo& oIo);
+        long doWriteMetadata(BasicIo& oIo);
+        //! Inflate the ICC profile of the iCCP chunk recorded by readMetadata(), if it is not yet
+        void readIccProfile();
         //@}
 
         std::string profileName_;
+        //! Position and data length of the iCCP chunk of the image, position -1 if there is none
+        std::pair<long, uint32_t> iccChunk_;
+        bool iccPending_;                       //!< Flag marking if the profile of iccChunk_ is not inflated yet
+        bool writeExifRawProfile_;              //!< Write Exif as a raw text profile instead of eXIf
 
     }; // class PngImage
 
@@ -32,6 +32,11 @@
 
 #include "image.hpp"
 
+// + standard includes
+#include <map>
+#include <mutex>
+#include <utility>
+
 // *****************************************************************************
 // namespace extensions
 namespace Exiv2 {
@@ -69,6 +74,15 @@ namespace Exiv2 {
 
     /*!
       @brief Class that holds preview image properties and data buffer.
+
+      A preview image obtained with PreviewManager::getPreviewImageView() may
+      refer to its data in the source file instead of holding a copy,
+      possibly preceded by a small generated header. Each read opens the file
+      with an IO instance of its own, so such a preview image remains valid
+      after the source image is destroyed, as long as the file is not
+      modified, and copies of it may be read concurrently. The data of
+      sources which cannot be opened again, e.g., images in memory, is
+      copied when the preview image is created.
      */
     class EXIV2API PreviewImage {
         friend class PreviewManager;
@@ -96,8 +110,17 @@ namespace Exiv2 {
         DataBuf copy() const;
         /*!
           @brief Return a pointer to the image data for read-only access.
+                 If the preview image refers to the source image, the data
+                 is read into memory on the first call.
          */
         const byte* pData() const;
+        /*!
+          @brief Return the image data in a shared buffer. Copies of the
+                 preview image and all consumers of the buffer share the data
+                 without copying it. If the preview image refers to the source
+                 image, the data is read into memory on the first call.
+         */
+        SharedBuf buffer() const;
         /*!
           @brief Return the size of the preview image in bytes.
          */
@@ -113,6 +136,16 @@ namespace Exiv2 {
           @return The number of bytes written.
         */
         long writeFile(const std::string& path) const;
+        /*!
+          @brief Write the preview image data to \em io, starting at its
+                 current position. If the preview image refers to the source
+                 image, the data is copied from the source in blocks.
+
+          @param io IO instance to write to. Must be open for writing.
+          @return The number of bytes written.
+          @throw Error if the data cannot be read or written.
+        */
+        long writeTo(BasicIo& io) const;
 #ifdef EXV_UNICODE_PATH
         /*!
           @brief Like writeFile() but accepts a unicode path in an std::wstring.
@@ -155,15 +188,37 @@ namespace Exiv2 {
     private:
         //! Private constructor
         PreviewImage(const PreviewProperties& properties, DataBuf data);
+        //! Ranges of the preview image data in the source image, an offset < 0 denotes zero bytes
+        typedef std::vector<std::pair<long, uint32_t> > Ranges;
+        /*!
+          @brief Private constructor for a preview image that consists of
+                 \em head followed by the \em ranges of \em io.
+         */
+        PreviewImage(const PreviewProperties& properties, BasicIo& io, const Blob& head, const Ranges& ranges);
+        //! Read the data of a preview image which refers to the source image from \em io into \em buf
+        void readData(BasicIo& io, byte* buf) const;
+        /*!
+          @brief Replace the reference to the source image with a copy of the
+                 data, taken from the \em size bytes mapped at \em base.
+         */
+        void load(const byte* base, long size);
 
         PreviewProperties properties_;          //!< Preview image properties
-        byte* pData_;                           //!< Pointer to the preview image data
+        mutable SharedBuf data_;                //!< Preview image data, empty while it refers to the source image
         uint32_t size_;                         //!< Size of the preview image data
+        std::string path_;                      //!< Path of the source file for a preview which refers to it, else empty
+        Blob head_;                             //!< Generated data which precedes the ranges
+        Ranges ranges_;                         //!< Ranges of the preview image data in the source image
 
     }; // class PreviewImage
 
     /*!
       @brief Class for extracting preview images from image metadata.
+
+      The manager remembers where the data of each preview image requested
+      from it is located in the source image, so that TIFF previews are
+      generated only once. Create a new manager after the metadata of the
+      image has been modified.
      */
     class EXIV2API PreviewManager {
     public:
@@ -171,6 +226,8 @@ namespace Exiv2 {
         //@{
         //! Constructor.
         explicit PreviewManager(const Image& image);
+        //! Copy constructor, the copy has the views of \em rhs
+        PreviewManager(const PreviewManager& rhs);
         //@}
 
         //! @name Accessors
@@ -185,10 +242,41 @@ namespace Exiv2 {
           @brief Return the preview image for the given preview properties.
          */
         PreviewImage getPreviewImage(const PreviewProperties& properties) const;
+        /*!
+          @brief Return the preview image for the given preview properties.
+                 Preview images which are stored as is in the source file
+                 and TIFF previews built from strips of the source file
+                 refer to their data there instead of copying it, see
+                 PreviewImage.
+         */
+        PreviewImage getPreviewImageView(const PreviewProperties& properties) const;
+        /*!
+          @brief Return the smallest preview image which is at least
+                 \em minWidth x \em minHeight pixels in size. If there is no
+                 such preview image, return the largest one.
+
+          Unlike getPreviewProperties(), this reads only the dimensions of
+          the candidates and extracts the data of the selected preview only.
+          If the image has no preview images, the returned preview image is
+          empty, i.e., its size() is 0.
+         */
+        PreviewImage selectPreview(uint32_t minWidth, uint32_t minHeight) const;
+        /*!
+          @brief Return the preview images for all the given preview
+                 properties, in the same order.
+
+          The data of preview images which are stored in the source image
+          is copied from the memory mapped source image concurrently.
+         */
+        std::vector<PreviewImage> getPreviewImages(const PreviewPropertiesList& list) const;
         //@}
 
     private:
     const Image& image_;
+    //! Views of the preview images created so far, by preview id
+    mutable std::map<PreviewId, PreviewImage> views_;
+    //! Mutex for views_, the accessors may be called concurrently
+    mutable std::mutex mutex_;
 
     }; // class PreviewManager
 }                                       // namespace Exiv2
@@ -94,7 +94,6 @@ namespace Exiv2 {
 
     //! XMP property reference, implemented as a static class.
     class EXIV2API XmpProperties {
-        static const XmpNsInfo* nsInfoUnsafe(const std::string& prefix);
         static void unregisterNsUnsafe(const std::string& ns);
         static const XmpNsInfo* lookupNsRegistryUnsafe(const XmpNsInfo::Prefix& prefix);
 
@@ -205,12 +204,10 @@ namespace Exiv2 {
         static void unregisterNs(const std::string& ns);
 
         /*!
-          @brief Lock to be used while modifying properties.
-
-          @todo For a proper read-write lock, this shall be improved by a
-          \em std::shared_timed_mutex (once C++14 is allowed) or
-          \em std::shared_mutex (once C++17 is allowed). The
-          read-access locks shall be updated to \em std::shared_lock then.
+          @brief Lock to be used while modifying or iterating the namespace
+                 registry. Lookups with ns(), prefix() and nsInfo() do not
+                 take it, they use an immutable snapshot of the namespaces
+                 which is replaced whenever the registry changes.
          */
         static std::mutex mutex_;
 
@@ -0,0 +1,136 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    snapshot.hpp
+  @brief   Immutable snapshot of the metadata and data of an image
+ */
+#ifndef SNAPSHOT_HPP_
+#define SNAPSHOT_HPP_
+
+// *****************************************************************************
+#include "exiv2lib_export.h"
+
+// included header files
+#include "basicio.hpp"
+#include "exif.hpp"
+#include "iptc.hpp"
+#include "preview.hpp"
+#include "xmp_exiv2.hpp"
+
+// + standard includes
+#include <memory>
+#include <string>
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+
+    class Image;
+
+// *****************************************************************************
+// class definitions
+
+    /*!
+      @brief Immutable snapshot of the metadata of an image, its preview
+             properties and its data, which many threads can query at the
+             same time without locking.
+
+      An Image reads its data through one IO position, so queries of an
+      image must be serialized. A snapshot is taken once, usually right
+      after Image::readMetadata(), with Image::snapshot(), and is then
+      shared by the readers. It does not refer to the image, which can be
+      modified or destroyed while the snapshot is in use.
+
+      The data of the image is read from a new IO instance for the path of
+      the image, which is mapped to memory; remote images are fetched
+      completely. The data of an image in memory is copied. readAt()
+      reads from this data.
+     */
+    class EXIV2API ImageSnapshot {
+    public:
+        //! Shared pointer to a snapshot, the readers share one snapshot
+        typedef std::shared_ptr<const ImageSnapshot> SharedPtr;
+
+        //! @name Creators
+        //@{
+        /*!
+          @brief Take a snapshot of the metadata of \em image and of its data.
+          @throw Error if the data of the image cannot be read.
+         */
+        explicit ImageSnapshot(Image& image);
+        //! Destructor
+        ~ImageSnapshot();
+        ImageSnapshot(const ImageSnapshot& rhs) = delete;
+        ImageSnapshot& operator=(const ImageSnapshot& rhs) = delete;
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the Exif metadata, with the makernote decoded
+        const ExifData& exifData() const { return exifData_; }
+        //! Return the IPTC metadata
+        const IptcData& iptcData() const { return iptcData_; }
+        //! Return the XMP metadata
+        const XmpData& xmpData() const { return xmpData_; }
+        //! Return the raw XMP packet
+        const std::string& xmpPacket() const { return xmpPacket_; }
+        //! Return the JPEG comment
+        const std::string& comment() const { return comment_; }
+        //! Return the ICC profile, empty if there is none
+        const SharedBuf& iccProfile() const { return iccProfile_; }
+        //! Return the MIME type of the image
+        const std::string& mimeType() const { return mimeType_; }
+        //! Return the pixel width of the image
+        int pixelWidth() const { return pixelWidth_; }
+        //! Return the pixel height of the image
+        int pixelHeight() const { return pixelHeight_; }
+        //! Return the properties of the previews of the image
+        const PreviewPropertiesList& previewProperties() const { return previewProperties_; }
+        //! Return the size of the data of the image
+        long size() const { return size_; }
+        /*!
+          @brief Copy up to \em rcount bytes of the data of the image at
+                 \em offset to \em buf. Safe to call from many threads.
+          @return Number of bytes copied, 0 if \em offset is out of range.
+         */
+        long readAt(long offset, byte* buf, long rcount) const;
+        //@}
+
+    private:
+        // DATA
+        ExifData exifData_;             //!< Exif metadata
+        IptcData iptcData_;             //!< IPTC metadata
+        XmpData xmpData_;               //!< XMP metadata
+        std::string xmpPacket_;         //!< Raw XMP packet
+        std::string comment_;           //!< JPEG comment
+        SharedBuf iccProfile_;          //!< ICC profile, shared with the image
+        std::string mimeType_;          //!< MIME type
+        int pixelWidth_;                //!< Pixel width
+        int pixelHeight_;               //!< Pixel height
+        PreviewPropertiesList previewProperties_; //!< Properties of the previews
+        BasicIo::UniquePtr io_;         //!< IO instance whose data is mapped, 0 for a copy
+        DataBuf copy_;                  //!< Copy of the data of an image in memory
+        const byte* data_;              //!< Data of the image
+        long size_;                     //!< Size of the data
+    }; // class ImageSnapshot
+
+}                                       // namespace Exiv2
+
+#endif                                  // #ifndef SNAPSHOT_HPP_
@@ -30,6 +30,10 @@
 // included header files
 #include "image.hpp"
 
+// + standard includes
+#include <memory>
+#include <vector>
+
 // *****************************************************************************
 // namespace extensions
 namespace Exiv2 {
@@ -48,6 +52,45 @@ namespace Exiv2 {
         const int srw = 4;           //!< SRW image type (see class TiffImage)
     }
 
+    /*!
+      @brief A page of a multi-page TIFF image, i.e., one of the IFDs in the
+             chain which starts with IFD0. Pages are lightweight views of the
+             image returned by TiffImage::pages(). The metadata of a page is
+             decoded on first access and kept with the page. A page refers to
+             the IO instance of its image and must not outlive it.
+     */
+    class EXIV2API TiffPage {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor for the page \em index whose IFD is at \em offset in \em io
+        TiffPage(BasicIo& io, size_t index, uint32_t offset);
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the number of the page, starting with 0 for IFD0
+        size_t index() const { return index_; }
+        //! Return the offset of the IFD of the page in the TIFF data
+        uint32_t offset() const { return offset_; }
+        /*!
+          @brief Return the Exif metadata of the page, decoded with its
+                 sub-IFDs when it is first accessed. The tags of the IFD are
+                 in group "Image", e.g., Exif.Image.ImageWidth, for all pages.
+          @throw Error if the image cannot be read.
+         */
+        const ExifData& exifData() const;
+        //@}
+
+    private:
+        // DATA
+        BasicIo* io_;                                   //!< IO instance of the image
+        size_t index_;                                  //!< Number of the page
+        uint32_t offset_;                               //!< Offset of the IFD
+        mutable std::shared_ptr<ExifData> exifData_;    //!< Metadata, decoded on first access
+
+    }; // class TiffPage
+
     /*!
       @brief Class to access TIFF images. Exif metadata is
           supported directly, IPTC is read from the Exif data, if present.
@@ -77,6 +120,7 @@ namespace Exiv2 {
         //! @name Manipulators
         //@{
         void readMetadata() override;
+        void readBasicInfo() override;
         void writeMetadata() override;
 
         /*!
@@ -92,6 +136,15 @@ namespace Exiv2 {
               Calling this function will throw an Error(kerInvalidSettingForImage).
          */
         void setComment(const std::string& comment) override;
+        /*!
+          @brief Return the pages of the image, in the order of the chain of
+                 IFDs which starts with IFD0. Only the offsets of the IFDs
+                 are read here, the metadata of each page is decoded when it
+                 is accessed. readMetadata() and writeMetadata() discard the
+                 pages, they are read again by the next call.
+          @throw Error if the image cannot be opened or is not a TIFF image.
+         */
+        const std::vector<TiffPage>& pages();
         //@}
 
         //! @name Accessors
@@ -121,6 +174,8 @@ namespace Exiv2 {
         mutable int pixelWidth_;               //!< Width of the primary image in pixels
         // cppcheck-suppress duplInheritedMember
         mutable int pixelHeight_;              //!< Height of the primary image in pixels
+        std::vector<TiffPage> pages_;          //!< The pages, if read
+        bool pagesRead_;                       //!< Whether pages_ was read
 
     }; // class TiffImage
 
@@ -181,6 +236,12 @@ namespace Exiv2 {
           @param exifData  Exif metadata container.
           @param iptcData  IPTC metadata container.
           @param xmpData   XMP metadata container.
+          @param append    If true and \em pData, \em size is the complete
+                           image in \em io, a new TIFF structure is appended
+                           to \em io instead of rewriting the image. The image
+                           data is kept at its original offsets and only the
+                           header is overwritten to point to the new structure.
+                           The old structure remains as unused space.
 
           @return Write method used.
         */
@@ -191,7 +252,8 @@ namespace Exiv2 {
                   ByteOrder byteOrder,
             const ExifData& exifData,
             const IptcData& iptcData,
-            const XmpData&  xmpData
+            const XmpData&  xmpData,
+                  bool      append =false
         );
 
     }; // class TiffParser
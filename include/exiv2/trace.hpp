@@ -0,0 +1,94 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    trace.hpp
+  @brief   Scoped trace events of the main phases of the library
+ */
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+
+#include "exiv2lib_export.h"
+#include "config.h"
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+
+// *****************************************************************************
+// class definitions
+
+    /*!
+      @brief Reports the beginning and the end of a phase of the library to
+             an application-defined handler, to see where the time of a
+             slow file goes. Meant to be used as a stack variable: the
+             constructor reports the beginning of the phase, the destructor
+             its end.
+
+      The categories of the phases of the library are "io" (opening and
+      writing files, requests to remote machines), "tiff-decode",
+      "makernote", "xmp-parse", "convert" and "encode". The name tells
+      the phase within its category.
+
+      Without a handler, a trace costs a load of the handler, so the
+      traces are always compiled in.
+     */
+    class EXIV2API Trace {
+    public:
+        //! Kinds of trace events
+        enum Event { begin, end };
+        /*!
+          @brief Type for a trace handler function. It receives the event,
+                 the category and the name of the phase, which are only
+                 valid during the call. The handler is called from the
+                 thread which runs the phase and must be thread-safe.
+         */
+        typedef void (*Handler)(Event event, const char* category, const char* name);
+
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor, reports the beginning of the phase \em name of
+                 \em category. Both must remain valid for the lifetime of
+                 the object.
+         */
+        Trace(const char* category, const char* name);
+        //! Destructor, reports the end of the phase
+        ~Trace();
+        //@}
+
+        //! Set the trace handler, 0 to disable tracing, which is the default
+        static void setHandler(Handler handler);
+        //! Return the current trace handler
+        static Handler handler();
+
+    private:
+        // NOT IMPLEMENTED
+        Trace(const Trace&);
+        Trace& operator=(const Trace&);
+
+        // DATA
+        Handler handler_;               //!< Handler which was told of the beginning
+        const char* category_;          //!< Category of the phase
+        const char* name_;              //!< Name of the phase
+    }; // class Trace
+
+}                                       // namespace Exiv2
+
+#endif                                  // #ifndef TRACE_HPP_
@@ -40,7 +40,9 @@
 #include <vector>
 #include <limits>
 #include <algorithm>
+#include <memory>
 #include <sstream>
+#include <type_traits>
 #include <stdint.h> /// \todo change to cstdint
 
 
@@ -162,6 +164,28 @@ namespace Exiv2 {
 
     };
 
+    /*!
+      @brief Heap memory held by metadata, in bytes by category, see
+             Image::memoryUsage().
+
+      The sizes are estimates: the sizes of the objects and of their data,
+      without the overhead of the allocator. Containers which share their
+      metadata with copies report all of it.
+     */
+    struct EXIV2API MemoryUsage {
+        //! Default constructor, all sizes are 0
+        MemoryUsage();
+        //! Add the sizes of \em rhs to this object
+        MemoryUsage& operator+=(const MemoryUsage& rhs);
+        //! Return the sum of all categories
+        uint64_t total() const;
+
+        uint64_t datums_;               //!< Datum objects, their containers and key indexes
+        uint64_t keys_;                 //!< Keys of the datums
+        uint64_t values_;               //!< Values of the datums, with their data areas
+        uint64_t buffers_;              //!< Raw packets, profiles and other retained buffers
+    };
+
     /*!
       @brief Auxiliary type to enable copies and assignments, similar to
              std::auto_ptr_ref. See http://www.josuttis.com/libbook/auto_ptr.html
@@ -196,8 +220,23 @@ namespace Exiv2 {
                  modified.
          */
         DataBuf(DataBuf& rhs);
+        //! Move constructor, transfers the buffer to the newly created object
+        DataBuf(DataBuf&& rhs);
         //! Destructor, deletes the allocated buffer
         ~DataBuf();
+        /*!
+          @brief Return a buffer of \em size bytes from the buffer pool of the
+                 calling thread.
+
+          Pooled buffers are returned to the pool of the thread which frees
+          them and reused for later buffers of a similar size, which saves
+          the allocations when many small buffers are read one after the other,
+          e.g., the segments or chunks of a batch of images. Later calls to
+          alloc() on the buffer use the pool as well. Buffers larger than
+          64 kB are allocated as usual. Unlike DataBuf(long), the contents of
+          the buffer are not initialized.
+         */
+        static DataBuf pooled(long size =0);
         //@}
 
         //! @name Manipulators
@@ -208,6 +247,8 @@ namespace Exiv2 {
                  the original object is modified.
          */
         DataBuf& operator=(DataBuf& rhs);
+        //! Move assignment operator, transfers the buffer
+        DataBuf& operator=(DataBuf&& rhs);
         /*!
           @brief Allocate a data buffer of at least the given size. Note that if
                  the requested \em size is less than the current buffer size, no
@@ -249,8 +290,67 @@ namespace Exiv2 {
         byte* pData_;
         //! The current size of the buffer
         long size_;
+
+    private:
+        //! Take over the buffer of \em rhs
+        void take(DataBuf& rhs);
+
+        //! Size of the pool buffer in pData_, 0 if it is not from the pool
+        long capacity_;
+        //! Indicates if buffers are allocated from the pool
+        bool pooled_;
     }; // class DataBuf
 
+    /*!
+      @brief Immutable, reference counted byte buffer. Copies and slices of a
+             buffer share its bytes, which are released with the last of
+             them, so that a preview or profile read once can be handed to
+             many consumers without copying it. Safe to share between threads.
+     */
+    class EXIV2API SharedBuf {
+    public:
+        //! @name Creators
+        //@{
+        //! Default constructor, an empty buffer
+        SharedBuf() : pData_(0), size_(0) {}
+        //! Constructor, copies the \em size bytes at \em pData
+        SharedBuf(const byte* pData, size_t size);
+        //! Constructor, takes over the buffer of \em buf without a copy
+        explicit SharedBuf(DataBuf&& buf);
+        //! Constructor, takes over the bytes of \em blob without a copy
+        explicit SharedBuf(Blob&& blob);
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return a pointer to the bytes, 0 for an empty buffer
+        const byte* data() const { return pData_; }
+        //! Return the number of bytes
+        size_t size() const { return size_; }
+        //! Return true if the buffer has no bytes
+        bool empty() const { return size_ == 0; }
+        //! Begin of the bytes
+        const byte* begin() const { return pData_; }
+        //! End of the bytes
+        const byte* end() const { return pData_ + size_; }
+        /*!
+          @brief Return the \em size bytes at \em offset as a buffer which
+                 shares the bytes of this one.
+          @throw std::out_of_range if the bytes are not within this buffer
+         */
+        SharedBuf slice(size_t offset, size_t size) const;
+        //! Return a copy of the bytes, which the caller owns
+        DataBuf copy() const;
+        //! Return the number of buffers which share the bytes, 0 for an empty buffer
+        long useCount() const { return owner_.use_count(); }
+        //@}
+
+    private:
+        std::shared_ptr<const void> owner_;     //!< Owner of the bytes, shared by copies and slices
+        const byte* pData_;                     //!< First byte of this buffer
+        size_t size_;                           //!< Number of bytes of this buffer
+    }; // class SharedBuf
+
     /*!
      * @brief Create a new Slice from a DataBuf given the bounds.
      *
@@ -299,6 +399,14 @@ namespace Exiv2 {
     EXIV2API float getFloat(const byte* buf, ByteOrder byteOrder);
     //! Read an 8 byte double precision floating point value (IEEE 754 binary64) from the data buffer
     EXIV2API double getDouble(const byte* buf, ByteOrder byteOrder);
+    /*!
+      @brief Read \em count 2 byte unsigned short values from the data buffer
+             to \em s. Converts all values in one loop, which is faster than
+             calling getUShort() for each of them.
+     */
+    EXIV2API void getUShortArray(uint16_t* s, const byte* buf, size_t count, ByteOrder byteOrder);
+    //! Read \em count 4 byte unsigned long values from the data buffer to \em l, see getUShortArray()
+    EXIV2API void getULongArray(uint32_t* l, const byte* buf, size_t count, ByteOrder byteOrder);
 
     //! Output operator for our fake rational
     EXIV2API std::ostream& operator<<(std::ostream& os, const Rational& r);
@@ -319,6 +427,19 @@ namespace Exiv2 {
              return number of bytes written.
      */
     EXIV2API long ul2Data(byte* buf, uint32_t l, ByteOrder byteOrder);
+    /*!
+      @brief Convert an 8 byte unsigned long to data, write the data to the
+             buffer, return number of bytes written.
+     */
+    EXIV2API long ull2Data(byte* buf, uint64_t l, ByteOrder byteOrder);
+    /*!
+      @brief Convert \em count unsigned shorts to data, write the data to the
+             buffer, return number of bytes written. Converts all values in
+             one loop, which is faster than calling us2Data() for each of them.
+     */
+    EXIV2API long us2DataArray(byte* buf, const uint16_t* s, size_t count, ByteOrder byteOrder);
+    //! Convert \em count unsigned longs to data, see us2DataArray()
+    EXIV2API long ul2DataArray(byte* buf, const uint32_t* l, size_t count, ByteOrder byteOrder);
     /*!
       @brief Convert an unsigned rational to data, write the data to the buffer,
              return number of bytes written.
@@ -496,13 +617,116 @@ namespace Exiv2 {
 //! Macro to determine the size of an array
 #define EXV_COUNTOF(a) (sizeof(Exiv2::sizer(a)))
 
+    /*!
+      @brief Output stream which appends to a string of the caller.
+
+      Use it to format values into a buffer which is reused, e.g.,
+      <code>StringWriter w(buf); value.write(w.stream());</code>. The streams
+      are kept per thread and reused, which saves constructing a
+      std::ostringstream and copying its result for every conversion. Each
+      StringWriter starts with the default format state of a new stream.
+      StringWriters may be nested, but each must be destroyed on the thread
+      which created it, in reverse order of creation.
+     */
+    class EXIV2API StringWriter {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor, the stream appends to \em buf
+        explicit StringWriter(std::string& buf);
+        //! Destructor, releases the stream for reuse
+        ~StringWriter();
+        StringWriter(const StringWriter& rhs) = delete;
+        StringWriter& operator=(const StringWriter& rhs) = delete;
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Return the stream
+        std::ostream& stream() { return *os_; }
+        //@}
+
+    private:
+        // DATA
+        std::ostream* os_;  //!< Stream of the thread, appends to the buffer
+    }; // class StringWriter
+
+    /*!
+      @brief A number for output to a stream, formatted independent of the
+             locale.
+
+      <code>os << Number(x)</code> prints the same as <code>os << x</code>
+      with the classic "C" locale, whatever the locale of the stream and of
+      the process. It honours the precision, width, fill and adjustment of
+      the stream and the general and fixed notation of floating point
+      numbers. It does not change the format state of the stream, except
+      for resetting its width like any output operator. Integers are
+      converted with a digit loop and floating point numbers, as doubles,
+      with std::snprintf(), which bypasses the num_put facet and is several
+      times faster than it. For other format flags, e.g., std::hex, the
+      number is printed by the stream with the classic locale.
+     */
+    class EXIV2API Number {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor for an integer or floating point value
+        template<typename T>
+        explicit Number(T value)
+            : kind_(  std::is_floating_point<T>::value ? kFloat
+                    : std::is_signed<T>::value         ? kSigned : kUnsigned),
+              denominator_(0), size_(sizeof(T)), precision_(-1), fixed_(false)
+        {
+            static_assert(std::is_arithmetic<T>::value, "Number requires an arithmetic type");
+            if (kind_ == kFloat) value_.f_ = static_cast<double>(value);
+            else if (kind_ == kSigned) value_.s_ = static_cast<long long>(value);
+            else value_.u_ = static_cast<unsigned long long>(value);
+        }
+        //! Constructor for a rational, which is printed as numerator/denominator
+        explicit Number(const Rational& value);
+        //! Constructor for an unsigned rational, which is printed as numerator/denominator
+        explicit Number(const URational& value);
+        //@}
+
+        /*!
+          @brief Return \em value for output in the general notation with
+                 \em precision significant digits, instead of the precision
+                 of the stream.
+         */
+        static Number general(double value, int precision);
+        //! Return \em value for output in fixed point notation with \em precision decimals
+        static Number fixed(double value, int precision);
+
+        //! Output operator for numbers
+        friend EXIV2API std::ostream& operator<<(std::ostream& os, const Number& number);
+
+    private:
+        //! Kind of the value
+        enum Kind { kSigned, kUnsigned, kFloat, kRational, kURational };
+        //! Print the number with the stream, for format flags which are not supported
+        std::ostream& writeStream(std::ostream& os) const;
+
+        // DATA
+        Kind kind_;                     //!< Kind of the value
+        union {
+            long long          s_;
+            unsigned long long u_;
+            double             f_;
+        } value_;                       //!< The value, or the numerator of a rational
+        long long denominator_;         //!< Denominator of a rational
+        size_t size_;                   //!< Size of the integer type, for output in hex and octal
+        int precision_;                 //!< Precision of a float, -1 for the precision of the stream
+        bool fixed_;                    //!< True for fixed point notation
+    }; // class Number
+
     //! Utility function to convert the argument of any type to a string
     template<typename T>
     std::string toString(const T& arg)
     {
-        std::ostringstream os;
-        os << arg;
-        return os.str();
+        std::string str;
+        StringWriter writer(str);
+        writer.stream() << arg;
+        return str;
     }
 
     /*!
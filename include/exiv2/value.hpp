@@ -36,7 +36,11 @@
 #include "types.hpp"
 
 // + standard includes
+#include <algorithm>
+#include <atomic>
 #include <map>
+#include <stdexcept>
+#include <vector>
 #include <iomanip>
 #include <memory>
 #include <cstring>
@@ -175,6 +179,18 @@ namespace Exiv2 {
           @return The converted value.
          */
         virtual Rational toRational(long n =0) const =0;
+        /*!
+          @brief Convert the <EM>n</EM>-th component of the value to a double.
+                 The behaviour of this method may be undefined if there is no
+                 <EM>n</EM>-th component.
+
+          Rational values are divided in double precision, without the detour
+          through a signed Rational or a float. The default implementation
+          returns toFloat().
+
+          @return The converted value.
+         */
+        virtual double toDouble(long n =0) const;
         //! Return the size of the data area, 0 if there is none.
         virtual long sizeDataArea() const;
         /*!
@@ -234,6 +250,14 @@ namespace Exiv2 {
                   copy and the auto-pointer ensures that it will be deleted.
          */
         static UniquePtr create(TypeId typeId);
+        /*!
+          @brief A (simple) factory to create a Value of type \em typeId and
+                 read it from \em buf, of \em len bytes in \em byteOrder.
+                 The types of TIFF entries are constructed from the buffer
+                 directly, the others are read after create(TypeId). Used by
+                 the decoders.
+         */
+        static UniquePtr create(TypeId typeId, const byte* buf, long len, ByteOrder byteOrder);
 
     protected:
         /*!
@@ -241,8 +265,14 @@ namespace Exiv2 {
                  by subclasses but not directly.
          */
         Value& operator=(const Value& rhs);
+        //! Copy constructor. Protected so that it can only be used by subclasses.
+        Value(const Value& rhs);
         // DATA
-        mutable bool ok_;                //!< Indicates the status of the previous to<Type> conversion
+        /*!
+          @brief Indicates the status of the previous to<Type> conversion. Atomic,
+                 so that a value can be converted by concurrent readers.
+         */
+        mutable std::atomic<bool> ok_;
 
     private:
         //! Internal virtual copy constructor.
@@ -800,7 +830,9 @@ namespace Exiv2 {
              items must not contain qualifiers. For language alternatives use
              LangAltValue.
 
-      Uses a vector of std::string to store the value(s).
+      The items are stored back to back in a single string, with the end
+      offset of each item, rather than as one std::string each. Large
+      keyword bags then cost two allocations instead of one per keyword.
      */
     class EXIV2API XmpArrayValue : public XmpValue {
     public:
@@ -852,8 +884,12 @@ namespace Exiv2 {
     private:
         //! Internal virtual copy constructor.
         XmpArrayValue* clone_() const override;
+        //! Return the <EM>n</EM>-th item.
+        std::string item(long n) const;
 
-        std::vector<std::string> value_;        //!< Stores the string values.
+        // DATA
+        std::string items_;                     //!< All items, back to back.
+        std::vector<size_t> ends_;              //!< End offset of each item in items_.
 
     }; // class XmpArrayValue
 
@@ -887,6 +923,59 @@ namespace Exiv2 {
         }
     };
 
+    /*!
+      @brief Language qualifier to text map of a LangAltValue.
+
+      A sorted vector with the part of the std::map interface that users of
+      LangAltValue::value_ rely on. A property has a handful of languages at
+      most, which does not justify a tree node per entry. Unlike std::map,
+      adding an entry invalidates iterators and references to other entries.
+     */
+    class EXIV2API LangAltValueMap {
+    public:
+        //! @name Types
+        //@{
+        typedef std::string key_type;
+        typedef std::string mapped_type;
+        typedef std::pair<std::string, std::string> value_type;
+        typedef LangAltValueComparator key_compare;
+        typedef std::vector<value_type>::iterator iterator;
+        typedef std::vector<value_type>::const_iterator const_iterator;
+        typedef std::vector<value_type>::size_type size_type;
+        //@}
+
+        //! @name Manipulators
+        //@{
+        iterator begin() { return values_.begin(); }
+        iterator end() { return values_.end(); }
+        iterator find(const key_type& key);
+        iterator lower_bound(const key_type& key);
+        //! Return the text for \em key, adding an empty one if there is none.
+        mapped_type& operator[](const key_type& key);
+        //! Add \em value unless there is an entry for its language already.
+        std::pair<iterator, bool> insert(const value_type& value);
+        iterator erase(iterator pos) { return values_.erase(pos); }
+        size_type erase(const key_type& key);
+        void clear() { values_.clear(); }
+        //@}
+
+        //! @name Accessors
+        //@{
+        const_iterator begin() const { return values_.begin(); }
+        const_iterator end() const { return values_.end(); }
+        const_iterator find(const key_type& key) const;
+        const_iterator lower_bound(const key_type& key) const;
+        size_type count(const key_type& key) const { return find(key) != end() ? 1 : 0; }
+        size_type size() const { return values_.size(); }
+        bool empty() const { return values_.empty(); }
+        //@}
+
+    private:
+        // DATA
+        std::vector<value_type> values_;        //!< Entries sorted by language.
+
+    }; // class LangAltValueMap
+
     /*!
       @brief %Value type for XMP language alternative properties.
 
@@ -964,7 +1053,7 @@ namespace Exiv2 {
 
     public:
         //! Type used to store language alternative arrays.
-        typedef std::map<std::string, std::string,LangAltValueComparator>  ValueType;
+        typedef LangAltValueMap ValueType;
         // DATA
         /*!
           @brief Map to store the language alternative values. The language
@@ -1235,10 +1324,187 @@ namespace Exiv2 {
     template<> inline TypeId getType<float>() { return tiffFloat; }
     //! Specialization for a double
     template<> inline TypeId getType<double>() { return tiffDouble; }
+    //! Specialization for an 8 byte unsigned long
+    template<> inline TypeId getType<uint64_t>() { return unsignedLongLong; }
+    //! Specialization for an 8 byte signed long
+    template<> inline TypeId getType<int64_t>() { return signedLongLong; }
 
     // No default implementation: let the compiler/linker complain
     // template<typename T> inline TypeId getType() { return invalid; }
 
+    /*!
+      @brief Sequence container with the interface of a std::vector, which
+             keeps up to \em N elements in the object itself.
+
+      The elements are moved to a std::vector on the heap only when more
+      than \em N elements are stored. Most metadata values have a single
+      element, keeping them in a SmallVector saves an allocation for each.
+      The elements are always stored contiguously.
+     */
+    template<typename T, size_t N>
+    class SmallVector {
+    public:
+        //! @name Types
+        //@{
+        typedef T value_type;                   //!< Type of the elements
+        typedef size_t size_type;               //!< Type of sizes and indexes
+        typedef std::ptrdiff_t difference_type; //!< Type of iterator differences
+        typedef T& reference;                   //!< Reference to an element
+        typedef const T& const_reference;       //!< Reference to a const element
+        typedef T* pointer;                     //!< Pointer to an element
+        typedef const T* const_pointer;         //!< Pointer to a const element
+        typedef T* iterator;                    //!< Iterator type
+        typedef const T* const_iterator;        //!< Const iterator type
+        //@}
+
+        //! @name Creators
+        //@{
+        //! Default constructor, the container is empty
+        SmallVector() : size_(0), onHeap_(false) {}
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Return an iterator to the first element
+        iterator begin() { return data(); }
+        //! Return an iterator past the last element
+        iterator end() { return data() + size(); }
+        //! Return a pointer to the elements
+        pointer data() { return onHeap_ ? heap_.data() : inline_; }
+        //! Return element \em n, without a range check
+        reference operator[](size_type n) { return data()[n]; }
+        //! Return element \em n, throws std::out_of_range if there is none
+        reference at(size_type n) { checkRange(n); return data()[n]; }
+        //! Return the first element
+        reference front() { return data()[0]; }
+        //! Return the last element
+        reference back() { return data()[size() - 1]; }
+        //! Append \em value
+        void push_back(const T& value)
+        {
+            if (onHeap_) {
+                heap_.push_back(value);
+            }
+            else if (size_ < N) {
+                inline_[size_++] = value;
+            }
+            else {
+                moveToHeap(size_ + 1);
+                heap_.push_back(value);
+            }
+        }
+        //! Remove the last element
+        void pop_back()
+        {
+            if (onHeap_) heap_.pop_back(); else --size_;
+        }
+        //! Insert \em value before \em pos, return an iterator to the new element
+        iterator insert(const_iterator pos, const T& value)
+        {
+            const size_type idx = pos - data();
+            push_back(value);
+            std::rotate(begin() + idx, end() - 1, end());
+            return begin() + idx;
+        }
+        //! Remove the element at \em pos, return an iterator to the next element
+        iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+        //! Remove the elements in [\em first, \em last), return an iterator to the next element
+        iterator erase(const_iterator first, const_iterator last)
+        {
+            const size_type idx = first - data();
+            const size_type cnt = last - first;
+            std::copy(begin() + idx + cnt, end(), begin() + idx);
+            resize(size() - cnt);
+            return begin() + idx;
+        }
+        //! Change the number of elements to \em n, new elements are value-initialized
+        void resize(size_type n)
+        {
+            if (onHeap_) {
+                heap_.resize(n);
+            }
+            else if (n <= N) {
+                for (size_type i = size_; i < n; ++i) inline_[i] = T();
+                size_ = n;
+            }
+            else {
+                moveToHeap(n);
+                heap_.resize(n);
+            }
+        }
+        //! Allocate memory for \em n elements
+        void reserve(size_type n)
+        {
+            if (onHeap_) heap_.reserve(n); else if (n > N) moveToHeap(n);
+        }
+        //! Remove all elements
+        void clear()
+        {
+            heap_.clear();
+            size_ = 0;
+            onHeap_ = false;
+        }
+        //! Exchange the elements with those of \em rhs
+        void swap(SmallVector& rhs)
+        {
+            std::swap_ranges(inline_, inline_ + N, rhs.inline_);
+            heap_.swap(rhs.heap_);
+            std::swap(size_, rhs.size_);
+            std::swap(onHeap_, rhs.onHeap_);
+        }
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return a const iterator to the first element
+        const_iterator begin() const { return data(); }
+        //! Return a const iterator past the last element
+        const_iterator end() const { return data() + size(); }
+        //! Return a pointer to the const elements
+        const_pointer data() const { return onHeap_ ? heap_.data() : inline_; }
+        //! Return element \em n, without a range check
+        const_reference operator[](size_type n) const { return data()[n]; }
+        //! Return element \em n, throws std::out_of_range if there is none
+        const_reference at(size_type n) const { checkRange(n); return data()[n]; }
+        //! Return the first element
+        const_reference front() const { return data()[0]; }
+        //! Return the last element
+        const_reference back() const { return data()[size() - 1]; }
+        //! Return the number of elements
+        size_type size() const { return onHeap_ ? heap_.size() : size_; }
+        //! Return true if there are no elements
+        bool empty() const { return size() == 0; }
+        //! Return true if both containers hold the same elements
+        bool operator==(const SmallVector& rhs) const
+        {
+            return size() == rhs.size() && std::equal(begin(), end(), rhs.begin());
+        }
+        //! Return true if the containers hold different elements
+        bool operator!=(const SmallVector& rhs) const { return !(*this == rhs); }
+        //@}
+
+    private:
+        //! Move the elements to the heap, with room for at least \em n elements
+        void moveToHeap(size_type n)
+        {
+            heap_.reserve(std::max(n, 2 * N));
+            heap_.assign(inline_, inline_ + size_);
+            size_ = 0;
+            onHeap_ = true;
+        }
+        //! Throw std::out_of_range if there is no element \em n
+        void checkRange(size_type n) const
+        {
+            if (n >= size()) throw std::out_of_range("SmallVector index out of range");
+        }
+
+        // DATA
+        T inline_[N];          //!< Elements while there are at most N
+        std::vector<T> heap_;  //!< Elements once there were more than N
+        size_type size_;       //!< Number of elements in inline_
+        bool onHeap_;          //!< Indicates if the elements are in heap_
+    }; // class SmallVector
+
     /*!
       @brief Template for a %Value of a basic type. This is used for unsigned
              and signed short, long and rationals.
@@ -1280,7 +1546,7 @@ namespace Exiv2 {
         int read(const std::string& buf) override;
         /*!
           @brief Set the data area. This method copies (clones) the buffer
-                 pointed to by buf.
+                 pointed to by buf. Copies of the value share the data area.
          */
         int setDataArea(const byte* buf, long len) override;
         //@}
@@ -1302,6 +1568,7 @@ namespace Exiv2 {
         long toLong(long n =0) const override;
         float toFloat(long n =0) const override;
         Rational toRational(long n =0) const override;
+        double toDouble(long n =0) const override;
         //! Return the size of the data area.
         long sizeDataArea() const override;
         /*!
@@ -1311,19 +1578,19 @@ namespace Exiv2 {
         DataBuf dataArea() const override;
         //@}
 
-        //! Container for values
-        typedef std::vector<T> ValueList;
+        //! Container for values, up to 24 bytes of values are kept in the object
+        typedef SmallVector<T, (sizeof(T) < 24 ? 24 / sizeof(T) : 1)> ValueList;
         //! Iterator type defined for convenience.
-        typedef typename std::vector<T>::iterator iterator;
+        typedef typename ValueList::iterator iterator;
         //! Const iterator type defined for convenience.
-        typedef typename std::vector<T>::const_iterator const_iterator;
+        typedef typename ValueList::const_iterator const_iterator;
 
         // DATA
         /*!
           @brief The container for all values. In your application, if you know
                  what subclass of Value you're dealing with (and possibly the T)
-                 then you can access this STL container through the usual
-                 standard library functions.
+                 then you can access this container like a std::vector through
+                 the usual standard library functions.
          */
         ValueList value_;
 
@@ -1332,8 +1599,12 @@ namespace Exiv2 {
         ValueType<T>* clone_() const override;
 
         // DATA
-        //! Pointer to the buffer, 0 if none has been allocated
-        byte* pDataArea_;
+        /*!
+          @brief The buffer, 0 if none has been allocated. It is not modified
+                 once set, copies of the value share it. Thumbnails and other
+                 data areas are therefore copied only once, from the image.
+         */
+        std::shared_ptr<const byte> pDataArea_;
         //! The current size of the buffer
         long sizeDataArea_;
     }; // class ValueType
@@ -1354,6 +1625,10 @@ namespace Exiv2 {
     typedef ValueType<float> FloatValue;
     //! Double value type
     typedef ValueType<double> DoubleValue;
+    //! 8 byte unsigned long value type
+    typedef ValueType<uint64_t> ULongLongValue;
+    //! 8 byte signed long value type
+    typedef ValueType<int64_t> LongLongValue;
 
 // *****************************************************************************
 // free functions, template and inline definitions
@@ -1418,6 +1693,64 @@ namespace Exiv2 {
     {
         return getDouble(buf, byteOrder);
     }
+    // Specialization for an 8 byte unsigned long value.
+    template<>
+    inline uint64_t getValue(const byte* buf, ByteOrder byteOrder)
+    {
+        return getULongLong(buf, byteOrder);
+    }
+    // Specialization for an 8 byte signed long value.
+    template<>
+    inline int64_t getValue(const byte* buf, ByteOrder byteOrder)
+    {
+        return static_cast<int64_t>(getULongLong(buf, byteOrder));
+    }
+
+    /*!
+      @brief Read \em count values of type T from the data buffer, in which
+             each value takes \em size bytes.
+
+      We need this template function for the ValueType template classes.
+      The specializations for 2 and 4 byte integers convert all values at
+      once, the default implementation calls getValue() for each value.
+
+      @param values Pointer to the array to store the values in.
+      @param buf Pointer to the data buffer to read from.
+      @param count Number of values to read.
+      @param size Size of each value in the data buffer.
+      @param byteOrder Applicable byte order (little or big endian).
+     */
+    template<typename T>
+    inline void getValueArray(T* values, const byte* buf, long count, long size, ByteOrder byteOrder)
+    {
+        for (long i = 0; i < count; ++i) {
+            values[i] = getValue<T>(buf + i * size, byteOrder);
+        }
+    }
+    // Specialization for 2 byte unsigned short values.
+    template<>
+    inline void getValueArray(uint16_t* values, const byte* buf, long count, long /*size*/, ByteOrder byteOrder)
+    {
+        getUShortArray(values, buf, count, byteOrder);
+    }
+    // Specialization for 4 byte unsigned long values.
+    template<>
+    inline void getValueArray(uint32_t* values, const byte* buf, long count, long /*size*/, ByteOrder byteOrder)
+    {
+        getULongArray(values, buf, count, byteOrder);
+    }
+    // Specialization for 2 byte signed short values.
+    template<>
+    inline void getValueArray(int16_t* values, const byte* buf, long count, long /*size*/, ByteOrder byteOrder)
+    {
+        getUShortArray(reinterpret_cast<uint16_t*>(values), buf, count, byteOrder);
+    }
+    // Specialization for 4 byte signed long values.
+    template<>
+    inline void getValueArray(int32_t* values, const byte* buf, long count, long /*size*/, ByteOrder byteOrder)
+    {
+        getULongArray(reinterpret_cast<uint32_t*>(values), buf, count, byteOrder);
+    }
 
     /*!
       @brief Convert a value of type T to data, write the data to the data buffer.
@@ -1504,48 +1837,108 @@ namespace Exiv2 {
     {
         return d2Data(buf, t, byteOrder);
     }
+    /*!
+      @brief Specialization to write an 8 byte unsigned long to the data buffer.
+             Return the number of bytes written.
+     */
+    template<>
+    inline long toData(byte* buf, uint64_t t, ByteOrder byteOrder)
+    {
+        return ull2Data(buf, t, byteOrder);
+    }
+    /*!
+      @brief Specialization to write an 8 byte signed long to the data buffer.
+             Return the number of bytes written.
+     */
+    template<>
+    inline long toData(byte* buf, int64_t t, ByteOrder byteOrder)
+    {
+        return ull2Data(buf, static_cast<uint64_t>(t), byteOrder);
+    }
+
+    /*!
+      @brief Convert \em count values of type T to data, write the data to
+             the data buffer.
+
+      We need this template function for the ValueType template classes.
+      The specializations for 2 and 4 byte integers convert all values at
+      once, the default implementation calls toData() for each value.
+
+      @param buf Pointer to the data buffer to write to.
+      @param values Pointer to the values to be converted.
+      @param count Number of values.
+      @param byteOrder Applicable byte order (little or big endian).
+      @return The number of bytes written to the buffer.
+     */
+    template<typename T>
+    inline long toDataArray(byte* buf, const T* values, long count, ByteOrder byteOrder)
+    {
+        long offset = 0;
+        for (long i = 0; i < count; ++i) {
+            offset += toData(buf + offset, values[i], byteOrder);
+        }
+        return offset;
+    }
+    // Specialization for unsigned shorts.
+    template<>
+    inline long toDataArray(byte* buf, const uint16_t* values, long count, ByteOrder byteOrder)
+    {
+        return us2DataArray(buf, values, count, byteOrder);
+    }
+    // Specialization for unsigned longs.
+    template<>
+    inline long toDataArray(byte* buf, const uint32_t* values, long count, ByteOrder byteOrder)
+    {
+        return ul2DataArray(buf, values, count, byteOrder);
+    }
+    // Specialization for signed shorts.
+    template<>
+    inline long toDataArray(byte* buf, const int16_t* values, long count, ByteOrder byteOrder)
+    {
+        return us2DataArray(buf, reinterpret_cast<const uint16_t*>(values), count, byteOrder);
+    }
+    // Specialization for signed longs.
+    template<>
+    inline long toDataArray(byte* buf, const int32_t* values, long count, ByteOrder byteOrder)
+    {
+        return ul2DataArray(buf, reinterpret_cast<const uint32_t*>(values), count, byteOrder);
+    }
 
     template<typename T>
     ValueType<T>::ValueType()
-        : Value(getType<T>()), pDataArea_(0), sizeDataArea_(0)
+        : Value(getType<T>()), sizeDataArea_(0)
     {
     }
 
     template<typename T>
     ValueType<T>::ValueType(TypeId typeId)
-        : Value(typeId), pDataArea_(0), sizeDataArea_(0)
+        : Value(typeId), sizeDataArea_(0)
     {
     }
 
     template<typename T>
     ValueType<T>::ValueType(const byte* buf, long len, ByteOrder byteOrder, TypeId typeId)
-        : Value(typeId), pDataArea_(0), sizeDataArea_(0)
+        : Value(typeId), sizeDataArea_(0)
     {
         read(buf, len, byteOrder);
     }
 
     template<typename T>
     ValueType<T>::ValueType(const T& val, TypeId typeId)
-        : Value(typeId), pDataArea_(0), sizeDataArea_(0)
+        : Value(typeId), sizeDataArea_(0)
     {
         value_.push_back(val);
     }
 
     template<typename T>
     ValueType<T>::ValueType(const ValueType<T>& rhs)
-        : Value(rhs), value_(rhs.value_), pDataArea_(0), sizeDataArea_(0)
+        : Value(rhs), value_(rhs.value_), pDataArea_(rhs.pDataArea_), sizeDataArea_(rhs.sizeDataArea_)
     {
-        if (rhs.sizeDataArea_ > 0) {
-            pDataArea_ = new byte[rhs.sizeDataArea_];
-            std::memcpy(pDataArea_, rhs.pDataArea_, rhs.sizeDataArea_);
-            sizeDataArea_ = rhs.sizeDataArea_;
-        }
     }
 
     template<typename T>
     ValueType<T>::~ValueType()
     {
-        delete[] pDataArea_;
     }
 
     template<typename T>
@@ -1554,14 +1947,7 @@ namespace Exiv2 {
         if (this == &rhs) return *this;
         Value::operator=(rhs);
         value_ = rhs.value_;
-
-        byte* tmp = 0;
-        if (rhs.sizeDataArea_ > 0) {
-            tmp = new byte[rhs.sizeDataArea_];
-            std::memcpy(tmp, rhs.pDataArea_, rhs.sizeDataArea_);
-        }
-        delete[] pDataArea_;
-        pDataArea_ = tmp;
+        pDataArea_ = rhs.pDataArea_;
         sizeDataArea_ = rhs.sizeDataArea_;
 
         return *this;
@@ -1571,12 +1957,10 @@ namespace Exiv2 {
     int ValueType<T>::read(const byte* buf, long len, ByteOrder byteOrder)
     {
         value_.clear();
-        long ts = TypeInfo::typeSize(typeId());
-        if (ts != 0)
-            if (len % ts != 0) len = (len / ts) * ts;
-        for (long i = 0; i < len; i += ts) {
-            value_.push_back(getValue<T>(buf + i, byteOrder));
-        }
+        const long ts = TypeInfo::typeSize(typeId());
+        if (ts <= 0 || len < ts) return 0;
+        value_.resize(len / ts);
+        getValueArray(&value_[0], buf, static_cast<long>(value_.size()), ts, byteOrder);
         return 0;
     }
 
@@ -1598,12 +1982,8 @@ namespace Exiv2 {
     template<typename T>
     long ValueType<T>::copy(byte* buf, ByteOrder byteOrder) const
     {
-        long offset = 0;
-        typename ValueList::const_iterator end = value_.end();
-        for (typename ValueList::const_iterator i = value_.begin(); i != end; ++i) {
-            offset += toData(buf + offset, *i, byteOrder);
-        }
-        return offset;
+        if (value_.empty()) return 0;
+        return toDataArray(buf, &value_[0], static_cast<long>(value_.size()), byteOrder);
     }
 
     template<typename T>
@@ -1629,9 +2009,10 @@ namespace Exiv2 {
     {
         typename ValueList::const_iterator end = value_.end();
         typename ValueList::const_iterator i = value_.begin();
+        os << std::setprecision(15);
         while (i != end) {
-            os << std::setprecision(15) << *i;
-            if (++i != end) os << " ";
+            os << Number(*i);
+            if (++i != end) os.write(" ", 1);
         }
         return os;
     }
@@ -1640,7 +2021,7 @@ namespace Exiv2 {
     std::string ValueType<T>::toString(long n) const
     {
         ok_ = true;
-        return Exiv2::toString<T>(value_[n]);
+        return Exiv2::toString(Number(value_[n]));
     }
 
     // Default implementation
@@ -1693,6 +2074,29 @@ namespace Exiv2 {
     }
     // Default implementation
     template<typename T>
+    double ValueType<T>::toDouble(long n) const
+    {
+        ok_ = true;
+        return static_cast<double>(value_[n]);
+    }
+    // Specialization for rational
+    template<>
+    inline double ValueType<Rational>::toDouble(long n) const
+    {
+        ok_ = (value_[n].second != 0);
+        if (!ok_) return 0.0;
+        return static_cast<double>(value_[n].first) / value_[n].second;
+    }
+    // Specialization for unsigned rational
+    template<>
+    inline double ValueType<URational>::toDouble(long n) const
+    {
+        ok_ = (value_[n].second != 0);
+        if (!ok_) return 0.0;
+        return static_cast<double>(value_[n].first) / value_[n].second;
+    }
+    // Default implementation
+    template<typename T>
     Rational ValueType<T>::toRational(long n) const
     {
         ok_ = true;
@@ -1738,18 +2142,17 @@ namespace Exiv2 {
     template<typename T>
     DataBuf ValueType<T>::dataArea() const
     {
-        return DataBuf(pDataArea_, sizeDataArea_);
+        return DataBuf(pDataArea_.get(), sizeDataArea_);
     }
 
     template<typename T>
     int ValueType<T>::setDataArea(const byte* buf, long len)
     {
-        byte* tmp = 0;
+        std::shared_ptr<byte> tmp;
         if (len > 0) {
-            tmp = new byte[len];
-            std::memcpy(tmp, buf, len);
+            tmp.reset(new byte[len], std::default_delete<byte[]>());
+            std::memcpy(tmp.get(), buf, len);
         }
-        delete[] pDataArea_;
         pDataArea_ = tmp;
         sizeDataArea_ = len;
         return 0;
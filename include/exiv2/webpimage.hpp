@@ -70,7 +70,12 @@ namespace Exiv2 {
         //! @name Manipulators
         //@{
         void readMetadata() override;
+        void readBasicInfo() override;
         void writeMetadata() override;
+        //! Stream the image with the buffered metadata to \em dst
+        void writeMetadataTo(BasicIo& dst) override;
+        //! Copy the image to \em dst without the EXIF, XMP and ICCP chunks
+        void stripMetadataTo(BasicIo& dst, int keep =mdNone) override;
         void printStructure(std::ostream& out, PrintStructureOption option,int depth) override;
         //@}
 
@@ -98,7 +103,7 @@ namespace Exiv2 {
                              byte *header, long header_size);
         bool equalsWebPTag(Exiv2::DataBuf& buf ,const char* str);
         void debugPrintHex(byte *data, long size);
-        void decodeChunks(uint64_t filesize);
+        void decodeChunks(uint64_t filesize, bool canvasOnly = false);
         void inject_VP8X(BasicIo& iIo, bool has_xmp, bool has_exif,
                          bool has_alpha, bool has_icc, int width,
                          int height);
@@ -116,6 +121,7 @@ namespace Exiv2 {
         const static char* WEBP_CHUNK_HEADER_VP8;
         const static char* WEBP_CHUNK_HEADER_ANMF;
         const static char* WEBP_CHUNK_HEADER_ANIM;
+        const static char* WEBP_CHUNK_HEADER_ALPH;
         const static char* WEBP_CHUNK_HEADER_ICCP;
         const static char* WEBP_CHUNK_HEADER_EXIF;
         const static char* WEBP_CHUNK_HEADER_XMP;
@@ -34,6 +34,10 @@
 #include "metadatum.hpp"
 #include "properties.hpp"
 
+// + standard includes
+#include <memory>
+#include <mutex>
+
 // *****************************************************************************
 // namespace extensions
 namespace Exiv2 {
@@ -67,8 +71,15 @@ namespace Exiv2 {
          */
         explicit Xmpdatum(const XmpKey& key,
                           const Value* pValue =0);
+        /*!
+          @brief Constructor which takes ownership of \em value instead of
+                 copying it. Decoders use it to hand over the values they read.
+         */
+        Xmpdatum(const XmpKey& key, Value::UniquePtr value);
         //! Copy constructor
         Xmpdatum(const Xmpdatum& rhs);
+        //! Move constructor, takes over the key and value of \em rhs
+        Xmpdatum(Xmpdatum&& rhs) noexcept;
         //! Destructor
         virtual ~Xmpdatum();
         //@}
@@ -77,6 +88,8 @@ namespace Exiv2 {
         //@{
         //! Assignment operator
         Xmpdatum& operator=(const Xmpdatum& rhs);
+        //! Move assignment operator, takes over the key and value of \em rhs
+        Xmpdatum& operator=(Xmpdatum&& rhs) noexcept;
         /*!
           @brief Assign std::string \em value to the %Xmpdatum.
                  Calls setValue(const std::string&).
@@ -160,6 +173,39 @@ namespace Exiv2 {
     //! Container type to hold all metadata
     typedef std::vector<Xmpdatum> XmpMetadata;
 
+    /*!
+      @brief An XMP key which is resolved once and can then be used for any
+             number of lookups in any %XmpData, see ExifKeyHandle. The
+             handle keeps the key string, which the index of %XmpData is
+             built on and which an XmpKey assembles on every call of key().
+     */
+    class EXIV2API XmpKeyHandle {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor to resolve a key string.
+          @throw Error if the key cannot be parsed or the namespace prefix
+                 is unknown.
+         */
+        explicit XmpKeyHandle(const std::string& key) : key_(key), string_(key_.key()) {}
+        //! Constructor from a key
+        explicit XmpKeyHandle(const XmpKey& key) : key_(key), string_(key_.key()) {}
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the key
+        const XmpKey& key() const { return key_; }
+        //! Return the key string, same as key().key()
+        const std::string& keyString() const { return string_; }
+        //@}
+
+    private:
+        XmpKey      key_;                       //!< The resolved key
+        std::string string_;                    //!< The key as a string
+    };
+
     /*!
       @brief A container for XMP data. This is a top-level class of
              the %Exiv2 library.
@@ -169,11 +215,26 @@ namespace Exiv2 {
       - access metadata through keys and standard C++ iterators
       - add, modify and delete metadata
       - serialize XMP data to an XML block
+
+      Lookups by key (findKey(), operator[]) use an Internal::KeyIndex on
+      the keys, which is built by the first non-const lookup. As erasing an
+      %Xmpdatum moves the ones after it, erase() invalidates the index,
+      like sorting or obtaining a mutable iterator with begin().
+
+      Copies of a container share the metadata until one of them is
+      modified or hands out an iterator or a reference into them, with
+      begin(), end(), findKey() or operator[], const or not. The container
+      then copies the metadata and they are no longer shared by new copies
+      either, so its iterators never point into the metadata of a copy.
     */
     class EXIV2API XmpData {
     public:
         //! Default constructor
-        XmpData() : xmpMetadata_(), xmpPacket_(), usePacket_(0) {}
+        XmpData();
+        //! Copy constructor
+        XmpData(const XmpData& rhs);
+        //! Assignment operator
+        XmpData& operator=(const XmpData& rhs);
 
         //! XmpMetadata iterator type
         typedef XmpMetadata::iterator iterator;
@@ -191,17 +252,27 @@ namespace Exiv2 {
                  member function.
          */
         Xmpdatum& operator[](const std::string& key);
+        //! Like operator[](const std::string&), for a key which is already resolved
+        Xmpdatum& operator[](const XmpKeyHandle& key);
         /*!
           @brief Add an %Xmpdatum from the supplied key and value pair. This
                  method copies (clones) the value.
           @return 0 if successful.
          */
         int add(const XmpKey& key, const Value* value);
+        /*!
+          @brief Add an %Xmpdatum from the supplied key and value pair,
+                 taking ownership of the value.
+          @return 0 if successful.
+         */
+        int add(const XmpKey& key, Value::UniquePtr value);
         /*!
           @brief Add a copy of the Xmpdatum to the XMP metadata.
           @return 0 if successful.
          */
         int add(const Xmpdatum& xmpdatum);
+        //! Add \em xmpdatum to the XMP metadata, moving instead of copying it.
+        int add(Xmpdatum&& xmpdatum);
         /*
         @brief Delete the Xmpdatum at iterator position pos, return the
                 position of the next Xmpdatum.
@@ -221,7 +292,7 @@ namespace Exiv2 {
         void clear();
         //! Sort metadata by key
         void sortByKey();
-        //! Begin of the metadata
+        //! Begin of the metadata, invalidates the key index
         iterator begin();
         //! End of the metadata
         iterator end();
@@ -230,6 +301,10 @@ namespace Exiv2 {
                  to it.
          */
         iterator findKey(const XmpKey& key);
+        //! Find the first Xmpdatum with the \em key of the handle
+        iterator findKey(const XmpKeyHandle& key) { return find(key.keyString()); }
+        //! Set the filter which decoders honour when they fill this container
+        void setDecodeFilter(const DecodeFilter& filter) { decodeFilter_ = filter; }
         //@}
 
         //! @name Accessors
@@ -243,6 +318,8 @@ namespace Exiv2 {
                  iterator to it.
          */
         const_iterator findKey(const XmpKey& key) const;
+        //! Find the first Xmpdatum with the \em key of the handle
+        const_iterator findKey(const XmpKeyHandle& key) const { return find(key.keyString()); }
         //! Return true if there is no XMP metadata
         bool empty() const;
         //! Get the number of metadata entries
@@ -254,21 +331,68 @@ namespace Exiv2 {
         //! set usePacket_
         bool usePacket(bool b) { bool r = usePacket_; usePacket_=b ; return r; };
         //! setPacket
-        void setPacket(const std::string& xmpPacket)
+        void setPacket(std::string xmpPacket)
         {
-            xmpPacket_ = xmpPacket;
+            xmpPacket_.swap(xmpPacket);
             usePacket(false);
         }
+        //! Release the memory of the packet
+        void releasePacket() { std::string().swap(xmpPacket_); }
         // ! getPacket
         const std::string& xmpPacket() const { return xmpPacket_ ; };
+        //! Return the filter which decoders honour when they fill this container
+        const DecodeFilter& decodeFilter() const { return decodeFilter_; }
+        /*!
+          @brief Return an estimate of the heap memory held by the metadata and
+                 the packet, see Image::memoryUsage()
+         */
+        MemoryUsage memoryUsage() const;
 
         //@}
 
     private:
+        //! Index type, maps keys to the positions of the metadata with that key
+        typedef Internal::KeyIndex<std::string, XmpMetadata::size_type> Index;
+
+        /*!
+          @brief The metadata and their key index. Copies of a container
+                 share one instance until one of them is modified.
+         */
+        struct Storage {
+            //! Default constructor
+            Storage() : index_(false), shareable_(true) {}
+            //! Rebuild the index from scratch
+            void indexRebuild();
+
+            XmpMetadata metadata_;              //!< XMP metadata
+            Index       index_;                 //!< Key index of metadata_
+            //! False once iterators into metadata_ were handed out, copies must not share it then
+            bool        shareable_;
+        };
+
+        //! Find the first Xmpdatum with the key string \em key
+        iterator find(const std::string& key);
+        //! Find the first Xmpdatum with the key string \em key
+        const_iterator find(const std::string& key) const;
+
+        /*!
+          @brief Return the storage of this container for a modification,
+                 after copying it if it is shared. If \em leak is true, the
+                 caller hands out mutable iterators or references into the
+                 metadata and new copies of the container do not share it.
+         */
+        Storage& mutableStorage(bool leak) const;
+        //! Return the storage of this container to hand out const iterators into it, see mutableStorage()
+        const Storage& iterableStorage() const;
+
         // DATA
-        XmpMetadata xmpMetadata_;
+        // The storage is mutable since const accessors copy shared metadata
+        mutable std::shared_ptr<Storage> storage_;
         std::string xmpPacket_  ;
         bool        usePacket_  ;
+        DecodeFilter decodeFilter_; //!< Filter honoured by the decoders
+        //! Guards the copy of shared metadata by const accessors called from several threads
+        mutable std::mutex mutex_;
     }; // class XmpData
 
     /*!
@@ -303,6 +427,14 @@ namespace Exiv2 {
         */
         static int decode(      XmpData&     xmpData,
                           const std::string& xmpPacket);
+        /*!
+          @brief Decode XMP metadata from the XMP packet of \em size bytes at
+                 \em pData, e.g., a slice of the buffer of an image, into
+                 \em xmpData, like the function above. The XMP toolkit parses
+                 the packet where it is, the only copy made is the packet
+                 kept in \em xmpData.
+         */
+        static int decode(XmpData& xmpData, const byte* pData, long size);
         /*!
           @brief Encode (serialize) XMP metadata from \em xmpData into a
                  string xmpPacket. The XMP packet returned in the string
@@ -346,11 +478,18 @@ namespace Exiv2 {
           \em xmpLockFct and related data \em pLockData that the parser
           uses when XMP namespaces are subsequently registered.
 
-          The initialize() function itself still is not thread-safe and
-          needs to be called in a thread-safe manner (e.g., on program
-          startup), but if used with suitable additional locking
-          parameters, any subsequent registration of namespaces will be
-          thread-safe.
+          The initialize() function is thread-safe, so threads can leave
+          the initialization to the first decode() or encode(), and
+          programs which do not use XMP do not pay for it. The lock
+          function is taken from the first call only. If used with suitable
+          locking parameters, any subsequent registration of namespaces
+          will be thread-safe.
+
+          The lock is not taken by decode() and encode(). The bundled
+          XMP Toolkit keeps all parse and serialize state in the XMP
+          object and reads its namespace registry without locking, so
+          once initialized, several threads can decode and encode
+          independently.
 
           Example usage on Windows using a critical section:
 
@@ -375,7 +514,6 @@ namespace Exiv2 {
               } xmpLock;
 
               // Pass the locking mechanism to the XMP parser on initialization.
-              // Note however that this call itself is still not thread-safe.
               Exiv2::XmpParser::initialize(XmpLock::LockUnlock, &xmpLock);
 
               // Program continues here, subsequent registrations of XMP
@@ -71,6 +71,11 @@ namespace Exiv2 {
         //! @name Manipulators
         //@{
         void readMetadata() override;
+        /*!
+          @brief Write the XMP packet to the sidecar file. Nothing is written
+              if the file already holds the same packet. A file is replaced
+              with a single rename of a new file next to it.
+         */
         void writeMetadata() override;
         /*!
           @brief Not supported. XMP sidecar files do not contain a comment.
@@ -91,6 +96,7 @@ namespace Exiv2 {
 
     private:
         Exiv2::Dictionary dates_;
+        std::string filePacket_;        //!< Content of the file when it was last read or written
 
     }; // class XmpSidecar
 
@@ -21,6 +21,8 @@
 
 #include <expat.h>
 
+#include <atomic>
+#include <thread>
 #include <vector>
 #include <string>
 
@@ -87,6 +89,7 @@ public:
     bool        dst;
     bool        dryrun;
     bool        ascii;
+    bool        interpolate;
 
     Options()
     {
@@ -96,6 +99,7 @@ public:
         dst         = false;
         dryrun      = false;
         ascii       = false;
+        interpolate = false;
     }
 
     virtual ~Options() {} ;
@@ -113,6 +117,7 @@ enum                        // keyword indices
 ,   kwDST
 ,   kwDRYRUN
 ,   kwASCII
+,   kwINTERPOLATE
 ,   kwVERBOSE
 ,   kwADJUST
 ,   kwTZ
@@ -135,15 +140,21 @@ enum
 ,   typeMax       = 7
 };
 
-// forward declaration
-class Position;
+// a fix of the track (from gpx file), just the numbers
+struct Fix
+{
+    time_t time;
+    double lat ;
+    double lon ;
+    double ele ;
+};
 
 // globals
-typedef std::map<time_t,Position>           TimeDict_t;
-typedef std::map<time_t,Position>::iterator TimeDict_i;
+typedef std::vector<Fix>                    Track_t;  // sorted by time, see sortTrack()
+typedef std::vector<Fix>::iterator          Track_i;
 typedef std::vector<std::string>            strings_t;
 const char*  gDeg = nullptr ; // string "°" or "deg"
-TimeDict_t   gTimeDict   ;
+Track_t      gTrack      ;
 strings_t    gFiles;
 
 // Position (from gpx file)
@@ -175,18 +186,19 @@ public:
       , ele_(o.ele_)
       , delta_(o.delta_)
     {}
+    Position& operator=(const Position& o) = default;
 
 //  instance methods
     bool good()                 { return time_ || lon_ || lat_ || ele_ ; }
     std::string getTimeString() { if ( times_.empty() ) times_ = getExifTime(time_) ;  return times_; }
-    time_t      getTime()       { return time_ ; }
+    time_t      getTime() const { return time_ ; }
     std::string toString();
 
 //  getters/setters
-    double lat()            {return lat_   ;}
-    double lon()            {return lon_   ;}
-    double ele()            {return ele_   ;}
-    int    delta()          {return delta_ ;}
+    double lat()      const {return lat_   ;}
+    double lon()      const {return lon_   ;}
+    double ele()      const {return ele_   ;}
+    int    delta()    const {return delta_ ;}
     void   delta(int delta) {delta_=delta  ;}
 
 //  data
@@ -291,23 +303,24 @@ public:
       , ele(0.0)
       , lat(0.0)
       , lon(0.0)
+      , time(0)
       , options_(options)
-    {}
+    {
+        now.time = 0;
+        now.lat  = now.lon = now.ele = 0.0;
+    }
     virtual ~UserData() {}
 
 //  public data members
     int         indent;
     size_t      count ;
-    Position    now ;
-    Position    prev;
+    Fix         now ;
     int         nTrkpt;
     bool        bTime ;
     bool        bEle  ;
     double      ele;
     double      lat;
     double      lon;
-    std::string xmlt;
-    std::string exift;
     time_t      time;
     Options&    options_;
 // static public data memembers
@@ -343,18 +356,21 @@ static void endElement(void* userData, const char* name)
     if ( strcmp(name,"trkpt")==0 ) {
 
         me->nTrkpt--;
-        me->now = Position(me->time,me->lat,me->lon,me->ele) ;
-
-        if ( !me->prev.good() && me->options_.verbose ) {
-            printf("trkseg %s begin ",me->now.getTimeString().c_str());
+        bool bFirst = me->now.time == 0 && me->now.lat == 0.0 && me->now.lon == 0.0 && me->now.ele == 0.0;
+        me->now.time = me->time;
+        me->now.lat  = me->lat ;
+        me->now.lon  = me->lon ;
+        me->now.ele  = me->ele ;
+
+        if ( bFirst && me->options_.verbose ) {
+            printf("trkseg %s begin ",getExifTime(me->now.time).c_str());
         }
 
-        // remember our location and put it in gTimeDict
-        gTimeDict[me->time] = me->now ;
-        me->prev = me->now ;
+        // remember our location and put it in gTrack
+        gTrack.push_back(me->now) ;
     }
     if ( strcmp(name,"trkseg")==0 && me->options_.verbose ) {
-        printf("%s end\n",me->now.getTimeString().c_str());
+        printf("%s end\n",getExifTime(me->now.time).c_str());
     }
 }
 
@@ -372,9 +388,7 @@ void charHandler(void* userData,const char* s,int len)
                 buffer[len]=0;
                 char* b = buffer ;
                 while ( *b == ' ' && b < buffer+len ) b++ ;
-                me->xmlt  = b ;
-                me->time  = parseTime(me->xmlt.c_str());
-                me->exift = getExifTime(me->time);
+                me->time  = parseTime(b);
             }
             me->bTime=false;
         }
@@ -613,26 +627,27 @@ time_t readImageTime(const std::string& path,std::string* pS=nullptr)
 
     time_t       result       = 0 ;
 
-    const char* dateStrings[] =
-    { "Exif.Photo.DateTimeOriginal"
-    , "Exif.Photo.DateTimeDigitized"
-    , "Exif.Image.DateTime"
-    , nullptr
+    static const ExifKeyHandle dateStrings[] =
+    { ExifKeyHandle("Exif.Photo.DateTimeOriginal")
+    , ExifKeyHandle("Exif.Photo.DateTimeDigitized")
+    , ExifKeyHandle("Exif.Image.DateTime")
     };
-    const char* dateString = dateStrings[0] ;
-
-    do {
-        try {
-            Image::UniquePtr image = ImageFactory::open(path);
-            if ( image.get() ) {
-                image->readMetadata();
-                ExifData &exifData = image->exifData();
-            //  printf("%s => %s\n",dateString, exifData[dateString].toString().c_str());
-                result = parseTime(exifData[dateString].toString().c_str(),true);
-                if ( result && pS ) *pS = exifData[dateString].toString();
+
+    try {
+        Image::UniquePtr image = ImageFactory::open(path);
+        if ( image.get() ) {
+            image->readMetadata();
+            const ExifData& exifData = image->exifData();
+            for ( size_t i = 0 ; !result && i < EXV_COUNTOF(dateStrings) ; i++ ) {
+                ExifData::const_iterator pos = exifData.findKey(dateStrings[i]);
+                if ( pos == exifData.end() ) continue;
+                std::string dateString = pos->toString();
+            //  printf("%s => %s\n",pos->key().c_str(), dateString.c_str());
+                result = parseTime(dateString.c_str(),true);
+                if ( result && pS ) *pS = dateString;
             }
-        } catch ( ... ) {};
-    } while ( !result && ++dateString );
+        }
+    } catch ( ... ) {};
 
     return result ;
 }
@@ -671,19 +686,111 @@ int readFile(const char* path,Options /* options */)
     return nResult ;
 }
 
-Position* searchTimeDict(TimeDict_t& td, const time_t& time,long long delta)
+bool earlier(const Fix& a, const Fix& b) { return a.time < b.time; }
+
+// sort the track by time, of several positions with the same time the last one read wins
+void sortTrack(Track_t& track)
+{
+    std::stable_sort(track.begin(),track.end(),earlier);
+    Track_i out = track.begin();
+    for ( Track_i it = track.begin() ; it != track.end() ; it++ ) {
+        if ( out != track.begin() && (out-1)->time == it->time ) out--;
+        *out++ = *it;
+    }
+    track.erase(out,track.end());
+}
+
+// find the position of the track nearest to time, less than delta seconds away
+// earlier positions win a tie. With bInterpolate, the position between the
+// fixes before and after time is interpolated if both are close enough.
+bool searchTrack(const Track_t& track, time_t time, long long delta, bool bInterpolate, Position& result)
+{
+    Fix key = { time, 0.0, 0.0, 0.0 };
+    Track_t::const_iterator next = std::lower_bound(track.begin(),track.end(),key,earlier);
+    Track_t::const_iterator prev = next == track.begin() ? track.end() : next - 1;
+
+    long long dNext = next != track.end() ? (long long)(next->time - time) : delta;
+    long long dPrev = prev != track.end() ? (long long)(time - prev->time) : delta;
+    if ( dNext >= delta && dPrev >= delta ) return false;
+
+    bool bPrev = dPrev <= dNext && dNext != 0;
+    const Fix& nearest = bPrev ? *prev : *next;
+    int T = bPrev ? (int) -dPrev : (int) dNext;
+
+    if ( bInterpolate && dNext != 0 && dNext < delta && dPrev < delta ) {
+        double f = (double) dPrev / (double) (dPrev + dNext);
+        result = Position(time
+                         , prev->lat + f * (next->lat - prev->lat)
+                         , prev->lon + f * (next->lon - prev->lon)
+                         , prev->ele + f * (next->ele - prev->ele)
+                         );
+    } else {
+        result = Position(nearest.time,nearest.lat,nearest.lon,nearest.ele);
+    }
+    result.delta(T);
+    return true;
+}
+
+// run f(0) .. f(count-1) on all cores
+template <typename F>
+void parallelFor(size_t count, F f)
+{
+    size_t nThreads = std::thread::hardware_concurrency();
+    if ( nThreads > count ) nThreads = count;
+    if ( nThreads < 2 ) {
+        for ( size_t i = 0 ; i < count ; i++ ) f(i);
+        return;
+    }
+    std::atomic<size_t>      next(0);
+    std::vector<std::thread> threads;
+    for ( size_t t = 0 ; t < nThreads ; t++ ) {
+        threads.emplace_back([&]() {
+            for ( size_t i = next++ ; i < count ; i = next++ ) f(i);
+        });
+    }
+    for ( size_t t = 0 ; t < nThreads ; t++ ) threads[t].join();
+}
+
+// geotag one image, return the line to report
+std::string geotag(const std::string& path,const Options& options)
 {
-    Position* result = nullptr;
-    for ( int t = 0 ; !result && t < delta ; t++ ) {
-        for ( int x = 0 ; !result && x < 2 ; x++ ) {
-            int T = t * ((x==0)?-1:1);
-            if ( td.count(time+T) ) {
-                result = &td[time+T];
-                result->delta(T);
+    std::string line;
+    std::string stamp ;
+    try {
+        time_t t = readImageTime(path,&stamp) ;
+        Position  pos;
+        Position* pPos = searchTrack(gTrack,t,Position::deltaMax_,options.interpolate,pos) ? &pos : nullptr;
+        Exiv2::Image::UniquePtr image = Exiv2::ImageFactory::open(path);
+        if ( image.get() ) {
+            image->readMetadata();
+            Exiv2::ExifData& exifData = image->exifData();
+            char result[1024];
+            if ( pPos ) {
+                exifData["Exif.GPSInfo.GPSProcessingMethod" ] = "65 83 67 73 73 0 0 0 72 89 66 82 73 68 45 70 73 88"; // ASCII HYBRID-FIX
+                exifData["Exif.GPSInfo.GPSVersionID"        ] = "2 2 0 0";
+                exifData["Exif.GPSInfo.GPSMapDatum"         ] = "WGS-84";
+
+                exifData["Exif.GPSInfo.GPSLatitude"         ] = Position::toExifString(pPos->lat(),true,true);
+                exifData["Exif.GPSInfo.GPSLongitude"        ] = Position::toExifString(pPos->lon(),true,false);
+                exifData["Exif.GPSInfo.GPSAltitude"         ] = Position::toExifString(pPos->ele());
+
+                exifData["Exif.GPSInfo.GPSAltitudeRef"      ] = pPos->ele()<0.0?"1":"0";
+                exifData["Exif.GPSInfo.GPSLatitudeRef"      ] = pPos->lat()>0?"N":"S";
+                exifData["Exif.GPSInfo.GPSLongitudeRef"     ] = pPos->lon()>0?"E":"W";
+
+                exifData["Exif.GPSInfo.GPSDateStamp"        ] = stamp;
+                exifData["Exif.GPSInfo.GPSTimeStamp"        ] = Position::toExifTimeStamp(stamp);
+                exifData["Exif.Image.GPSTag"                ] = 4908;
+
+                snprintf(result,sizeof(result),"%s %s % 2d\n",path.c_str(),pPos->toString().c_str(),pPos->delta());
+            } else {
+                snprintf(result,sizeof(result),"%s *** not in time dict ***\n",path.c_str());
             }
+            line = result;
+            if ( !options.dryrun ) image->writeMetadata();
         }
-    }
-    return result;
+    } catch ( ... ) {};
+    return line;
 }
 
 int getFileType(std::string& path,Options& options) { return getFileType(path.c_str(),options); }
@@ -755,12 +862,6 @@ int parseTZ(const char* adjust)
     return (3600*h)+(60*m);
 }
 
-bool mySort(const std::string& a, const std::string& b)
-{
-    time_t A = readImageTime(a);
-    time_t B = readImageTime(b);
-    return (A<B);
-}
 
 int main(int argc,const char* argv[])
 {
@@ -783,6 +884,7 @@ int main(int argc,const char* argv[])
     keywords[kwVERBOSE ] = "verbose";
     keywords[kwDRYRUN  ] = "dryrun";
     keywords[kwASCII   ] = "ascii";
+    keywords[kwINTERPOLATE] = "interpolate";
     keywords[kwDST     ] = "dst";
     keywords[kwADJUST  ] = "adjust";
     keywords[kwTZ      ] = "tz";
@@ -800,6 +902,7 @@ int main(int argc,const char* argv[])
     shorts["-s"] = "-delta";
     shorts["-X"] = "-dryrun";
     shorts["-a"] = "-ascii";
+    shorts["-i"] = "-interpolate";
 
     Options options ;
     options.help    = sina(keywords[kwHELP   ],argv) || argc < 2;
@@ -808,6 +911,7 @@ int main(int argc,const char* argv[])
     options.version = sina(keywords[kwVERSION],argv);
     options.dst     = sina(keywords[kwDST    ],argv);
     options.ascii   = sina(keywords[kwASCII  ],argv);
+    options.interpolate = sina(keywords[kwINTERPOLATE],argv);
 
     for ( int i = 1 ; !result && i < argc ; i++ ) {
         const char* arg   = argv[i++];
@@ -828,6 +932,7 @@ int main(int argc,const char* argv[])
             case kwDRYRUN   : options.dryrun      = true ; break;
             case kwVERBOSE  : options.verbose     = true ; break;
             case kwASCII    : options.ascii       = true ; break;
+            case kwINTERPOLATE: options.interpolate = true ; break;
             case kwTZ       : Position::tz_       = parseTZ(value);break;
             case kwADJUST   : Position::adjust_   = ivalue;break;
             case kwDELTA    : Position::deltaMax_ = ivalue;break;
@@ -863,7 +968,18 @@ int main(int argc,const char* argv[])
     gDeg = options.ascii ? "deg" : "°";
 
     if ( !result ) {
-        sort(gFiles.begin(),gFiles.end(),mySort);
+        sortTrack(gTrack);
+
+        // read the time of each image once, to sort them
+        std::vector<time_t> times(gFiles.size());
+        parallelFor(gFiles.size(),[&](size_t p) { times[p] = readImageTime(gFiles[p]); });
+        std::vector<size_t> order(gFiles.size());
+        for ( size_t p = 0 ; p < order.size() ; p++ ) order[p] = p;
+        std::stable_sort(order.begin(),order.end(),[&](size_t a,size_t b) { return times[a] < times[b]; });
+        strings_t files(gFiles.size());
+        for ( size_t p = 0 ; p < order.size() ; p++ ) files[p] = gFiles[order[p]];
+        gFiles.swap(files);
+
         if ( options.dst ) Position::dst_ = 3600;
         if ( options.verbose ) {
             int t = Position::tz();
@@ -881,51 +997,21 @@ int main(int argc,const char* argv[])
 /*
         if ( options.verbose ) {
             printf("Time Dictionary\n");
-            for ( TimeDict_i it = gTimeDict.begin() ;  it != gTimeDict.end() ; it++ ) {
-                std::string sTime = getExifTime(it->first);
-                Position*   pPos  = &it->second;
-                std::string sPos  = Position::toExifString(pPos->lat(),false,true)
+            for ( Track_i it = gTrack.begin() ;  it != gTrack.end() ; it++ ) {
+                std::string sTime = getExifTime(it->time);
+                std::string sPos  = Position::toExifString(it->lat,false,true)
                                   + " "
-                                  + Position::toExifString(pPos->lon(),false,true)
+                                  + Position::toExifString(it->lon,false,true)
                                   ;
                 printf("%s %s\n",sTime.c_str(), sPos.c_str());
             }
         }
 */
-        for ( size_t p = 0 ; p < gFiles.size() ; p++ ) {
-            std::string path  = gFiles[p] ;
-            std::string stamp ;
-            try {
-                time_t t       = readImageTime(path,&stamp) ;
-                Position* pPos = searchTimeDict(gTimeDict,t,Position::deltaMax_);
-                Exiv2::Image::UniquePtr image = Exiv2::ImageFactory::open(path);
-                if ( image.get() ) {
-                    image->readMetadata();
-                    Exiv2::ExifData& exifData = image->exifData();
-                    if ( pPos ) {
-                        exifData["Exif.GPSInfo.GPSProcessingMethod" ] = "65 83 67 73 73 0 0 0 72 89 66 82 73 68 45 70 73 88"; // ASCII HYBRID-FIX
-                        exifData["Exif.GPSInfo.GPSVersionID"        ] = "2 2 0 0";
-                        exifData["Exif.GPSInfo.GPSMapDatum"         ] = "WGS-84";
-
-                        exifData["Exif.GPSInfo.GPSLatitude"         ] = Position::toExifString(pPos->lat(),true,true);
-                        exifData["Exif.GPSInfo.GPSLongitude"        ] = Position::toExifString(pPos->lon(),true,false);
-                        exifData["Exif.GPSInfo.GPSAltitude"         ] = Position::toExifString(pPos->ele());
-
-                        exifData["Exif.GPSInfo.GPSAltitudeRef"      ] = pPos->ele()<0.0?"1":"0";
-                        exifData["Exif.GPSInfo.GPSLatitudeRef"      ] = pPos->lat()>0?"N":"S";
-                        exifData["Exif.GPSInfo.GPSLongitudeRef"     ] = pPos->lon()>0?"E":"W";
-
-                        exifData["Exif.GPSInfo.GPSDateStamp"        ] = stamp;
-                        exifData["Exif.GPSInfo.GPSTimeStamp"        ] = Position::toExifTimeStamp(stamp);
-                        exifData["Exif.Image.GPSTag"                ] = 4908;
-
-                        printf("%s %s % 2d\n",path.c_str(),pPos->toString().c_str(),pPos->delta());
-                    } else {
-                        printf("%s *** not in time dict ***\n",path.c_str());
-                    }
-                    if ( !options.dryrun ) image->writeMetadata();
-                }
-            } catch ( ... ) {};
+        // geotag the images in parallel, report in order
+        strings_t lines(gFiles.size());
+        parallelFor(gFiles.size(),[&](size_t p) { lines[p] = geotag(gFiles[p],options); });
+        for ( size_t p = 0 ; p < lines.size() ; p++ ) {
+            fputs(lines[p].c_str(),stdout);
         }
     }
 
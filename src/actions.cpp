@@ -40,7 +40,10 @@
 #include "i18n.h"                // NLS support.
 
 // + standard includes
+#include <algorithm>
+#include <future>
 #include <string>
+#include <vector>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
@@ -101,6 +104,28 @@ namespace {
     //! Convert a tm structure to a string "YYYY:MM:DD HH:MI:SS", "" on error
     std::string tm2Str(const struct tm* tm);
 
+    /*!
+      @brief Return true if \em after has the same metadata as \em before
+             with values of the same type and size. The encoded Exif data
+             then keeps its layout and the image can be updated in place.
+     */
+    bool sameLayout(const Exiv2::ExifData& before, const Exiv2::ExifData& after);
+
+    //! Return true if all \em modifyCmds set Exif values
+    bool exifSetsOnly(const ModifyCmds& modifyCmds);
+
+    /*!
+      @brief Return true if the value of \em md is a large binary value,
+             which is not printed unless option -b is given.
+     */
+    bool isSuppressedBinary(const Exiv2::Metadatum& md);
+
+    //! Print the plain value of \em md to \em os
+    void printValue(std::ostream& os, const Exiv2::Metadatum& md);
+
+    //! Print the interpreted value of \em md to \em os
+    void printInterpreted(std::ostream& os, const Exiv2::Metadatum& md, const Exiv2::Image* pImage);
+
     /*!
       @brief Copy metadata from source to target according to Params::copyXyz
 
@@ -163,6 +188,34 @@ namespace {
 // class member definitions
 namespace Action {
 
+    namespace {
+        thread_local std::ostream* pTaskOut = 0;
+        thread_local std::ostream* pTaskErr = 0;
+    }
+
+    std::ostream& taskOut()
+    {
+        return pTaskOut ? *pTaskOut : std::cout;
+    }
+
+    std::ostream& taskErr()
+    {
+        return pTaskErr ? *pTaskErr : std::cerr;
+    }
+
+    TaskOutput::TaskOutput(std::ostream& out, std::ostream& err)
+        : out_(pTaskOut), err_(pTaskErr)
+    {
+        pTaskOut = &out;
+        pTaskErr = &err;
+    }
+
+    TaskOutput::~TaskOutput()
+    {
+        pTaskOut = out_;
+        pTaskErr = err_;
+    }
+
     Task::~Task()
     {
     }
@@ -234,7 +287,7 @@ namespace Action {
     int setModeAndPrintStructure(Exiv2::PrintStructureOption option, const std::string& path)
     {
         _setmode(_fileno(stdout),O_BINARY);
-        return printStructure(std::cout, option, path);
+        return printStructure(taskOut(), option, path);
     }
 
     int Print::run(const std::string& path)
@@ -248,8 +301,8 @@ namespace Action {
                 case Params::pmList:      rc = printList();        break;
                 case Params::pmComment:   rc = printComment();     break;
                 case Params::pmPreview:   rc = printPreviewList(); break;
-                case Params::pmStructure: rc = printStructure(std::cout,Exiv2::kpsBasic, path_)     ; break;
-                case Params::pmRecursive: rc = printStructure(std::cout,Exiv2::kpsRecursive, path_) ; break;
+                case Params::pmStructure: rc = printStructure(taskOut(),Exiv2::kpsBasic, path_)     ; break;
+                case Params::pmRecursive: rc = printStructure(taskOut(),Exiv2::kpsRecursive, path_) ; break;
                 case Params::pmXMP:
                     if (option == Exiv2::kpsNone)
                         option = Exiv2::kpsXMP;
@@ -264,12 +317,12 @@ namespace Action {
             return rc;
         }
         catch(const Exiv2::AnyError& e) {
-            std::cerr << "Exiv2 exception in print action for file "
+            taskErr() << "Exiv2 exception in print action for file "
                       << path << ":\n" << e << "\n";
             return 1;
         }
         catch(const std::overflow_error& e) {
-            std::cerr << "std::overflow_error exception in print action for file "
+            taskErr() << "std::overflow_error exception in print action for file "
                       << path << ":\n" << e.what() << "\n";
             return 1;
         }
@@ -278,7 +331,7 @@ namespace Action {
     int Print::printSummary()
     {
         if (!Exiv2::fileExists(path_, true)) {
-            std::cerr << path_ << ": "
+            taskErr() << path_ << ": "
                       << _("Failed to open the file\n");
             return -1;
         }
@@ -290,25 +343,25 @@ namespace Action {
 
         // Filename
         printLabel(_("File name"));
-        std::cout << path_ << std::endl;
+        taskOut() << path_ << std::endl;
 
         // Filesize
         struct stat buf;
         if (0 == stat(path_.c_str(), &buf)) {
             printLabel(_("File size"));
-            std::cout << buf.st_size << " " << _("Bytes") << std::endl;
+            taskOut() << buf.st_size << " " << _("Bytes") << std::endl;
         }
 
         // MIME type
         printLabel(_("MIME type"));
-        std::cout << image->mimeType() << std::endl;
+        taskOut() << image->mimeType() << std::endl;
 
         // Image size
         printLabel(_("Image size"));
-        std::cout << image->pixelWidth() << " x " << image->pixelHeight() << std::endl;
+        taskOut() << image->pixelWidth() << " x " << image->pixelHeight() << std::endl;
 
         if (exifData.empty()) {
-            std::cerr << path_ << ": "
+            taskErr() << path_ << ": "
                       << _("No Exif data found in the file\n");
             return -3;
         }
@@ -335,7 +388,7 @@ namespace Action {
                 printTag(exifData, "Exif.Photo.ShutterSpeedValue");
             }
         }
-        std::cout << std::endl;
+        taskOut() << std::endl;
 
         // Aperture
         // Get if from FNumber and, failing that, try ApertureValue
@@ -347,7 +400,7 @@ namespace Action {
                     printTag(exifData, "Exif.Photo.ApertureValue");
                 }
             }
-            std::cout << std::endl;
+            taskOut() << std::endl;
 
             // Exposure bias
             printTag(exifData, "Exif.Photo.ExposureBiasValue", _("Exposure bias"));
@@ -366,14 +419,14 @@ namespace Action {
                 md = exifData.findKey(
                     Exiv2::ExifKey("Exif.Photo.FocalLengthIn35mmFilm"));
                 if (md != exifData.end()) {
-                    std::cout << " ("<< _("35 mm equivalent") << ": "
+                    taskOut() << " ("<< _("35 mm equivalent") << ": "
                               << md->print(&exifData) << ")";
                 }
             }
             else {
                 printTag(exifData, "Exif.Canon.FocalLength");
             }
-            std::cout << std::endl;
+            taskOut() << std::endl;
         }
 
         // Subject distance
@@ -385,7 +438,7 @@ namespace Action {
                 printTag(exifData, "Exif.CanonFi.FocusDistanceLower");
                 printTag(exifData, "Exif.CanonFi.FocusDistanceUpper");
             }
-            std::cout << std::endl;
+            taskOut() << std::endl;
         }
 
         // ISO speed
@@ -429,9 +482,9 @@ namespace Action {
                 }
             }
             if (xdim != 0 && ydim != 0) {
-                std::cout << xdim << " x " << ydim;
+                taskOut() << xdim << " x " << ydim;
             }
-            std::cout << std::endl;
+            taskOut() << std::endl;
         }
 
         // White balance
@@ -442,37 +495,37 @@ namespace Action {
         Exiv2::ExifThumbC exifThumb(exifData);
         std::string thumbExt = exifThumb.extension();
         if (thumbExt.empty()) {
-            std::cout << _("None");
+            taskOut() << _("None");
         }
         else {
             Exiv2::DataBuf dataBuf = exifThumb.copy();
             if (dataBuf.size_ == 0) {
-                std::cout << _("None");
+                taskOut() << _("None");
             }
             else {
-                std::cout << exifThumb.mimeType() << ", "
+                taskOut() << exifThumb.mimeType() << ", "
                           << dataBuf.size_ << " " << _("Bytes");
             }
         }
-        std::cout << std::endl;
+        taskOut() << std::endl;
 
         // Copyright
         printTag(exifData, "Exif.Image.Copyright", _("Copyright"));
 
         // Exif Comment
         printTag(exifData, "Exif.Photo.UserComment", _("Exif comment"));
-        std::cout << std::endl;
+        taskOut() << std::endl;
 
         return 0;
     } // Print::printSummary
 
     void Print::printLabel(const std::string& label) const
     {
-        std::cout << std::setfill(' ') << std::left;
-        if (Params::instance().files_.size() > 1) {
-            std::cout << std::setw(20) << path_ << " ";
+        taskOut() << std::setfill(' ') << std::left;
+        if (Params::instance().manyFiles()) {
+            taskOut() << std::setw(20) << path_ << " ";
         }
-        std::cout << std::make_pair( label, align_)
+        taskOut() << std::make_pair( label, align_)
                   << ": ";
     }
 
@@ -487,10 +540,10 @@ namespace Action {
         Exiv2::ExifKey ek(key);
         Exiv2::ExifData::const_iterator md = exifData.findKey(ek);
         if (md != exifData.end()) {
-            md->write(std::cout, &exifData);
+            md->write(taskOut(), &exifData);
             rc = 1;
         }
-        if (!label.empty()) std::cout << std::endl;
+        if (!label.empty()) taskOut() << std::endl;
         return rc;
     } // Print::printTag
 
@@ -504,30 +557,23 @@ namespace Action {
         }
         Exiv2::ExifData::const_iterator md = easyAccessFct(exifData);
         if (md != exifData.end()) {
-            md->write(std::cout, &exifData);
+            md->write(taskOut(), &exifData);
             rc = 1;
         }
-        if (!label.empty()) std::cout << std::endl;
+        if (!label.empty()) taskOut() << std::endl;
         return rc;
     } // Print::printTag
 
     int Print::printList()
     {
         if (!Exiv2::fileExists(path_, true)) {
-            std::cerr << path_
+            taskErr() << path_
                       << ": " << _("Failed to open the file\n");
             return -1;
         }
         Exiv2::Image::UniquePtr image = Exiv2::ImageFactory::open(path_);
         assert(image.get() != 0);
         image->readMetadata();
-        // Set defaults for metadata types and data columns
-        if (Params::instance().printTags_ == Exiv2::mdNone) {
-            Params::instance().printTags_ = Exiv2::mdExif | Exiv2::mdIptc | Exiv2::mdXmp;
-        }
-        if (Params::instance().printItems_ == 0) {
-            Params::instance().printItems_ = Params::prKey | Params::prType | Params::prCount | Params::prTrans;
-        }
         return printMetadata(image.get());
     } // Print::printList
 
@@ -566,9 +612,9 @@ namespace Action {
 
         // With -v, inform about the absence of any (requested) type of metadata
         if (Params::instance().verbose_) {
-            if (noExif) std::cerr << path_ << ": " << _("No Exif data found in the file\n");
-            if (noIptc) std::cerr << path_ << ": " << _("No IPTC data found in the file\n");
-            if (noXmp)  std::cerr << path_ << ": " << _("No XMP data found in the file\n");
+            if (noExif) taskErr() << path_ << ": " << _("No Exif data found in the file\n");
+            if (noIptc) taskErr() << path_ << ": " << _("No IPTC data found in the file\n");
+            if (noXmp)  taskErr() << path_ << ": " << _("No XMP data found in the file\n");
         }
 
         // With -g or -K, return -3 if no matching tags were found
@@ -622,151 +668,221 @@ namespace Action {
             return false;
         }
 
-        bool const manyFiles = Params::instance().files_.size() > 1;
+        if (Params::instance().printItems_ & Params::prJson) {
+            printJsonMetadatum(md, pImage);
+            return true;
+        }
+
+        bool const manyFiles = Params::instance().manyFiles();
         if (manyFiles) {
-            std::cout << std::setfill(' ') << std::left << std::setw(20) << path_ << "  ";
+            taskOut() << std::setfill(' ') << std::left << std::setw(20) << path_ << "  ";
         }
 
         bool first = true;
         if (Params::instance().printItems_ & Params::prTag) {
             if (!first)
-                std::cout << " ";
+                taskOut() << " ";
             first = false;
-            std::cout << "0x" << std::setw(4) << std::setfill('0') << std::right << std::hex << md.tag();
+            taskOut() << "0x" << std::setw(4) << std::setfill('0') << std::right << std::hex << md.tag();
         }
         if (Params::instance().printItems_ & Params::prSet) {
             if (!first)
-                std::cout << " ";
+                taskOut() << " ";
             first = false;
-            std::cout << "set";
+            taskOut() << "set";
         }
         if (Params::instance().printItems_ & Params::prGroup) {
             if (!first)
-                std::cout << " ";
+                taskOut() << " ";
             first = false;
-            std::cout << std::setw(12) << std::setfill(' ') << std::left << md.groupName();
+            taskOut() << std::setw(12) << std::setfill(' ') << std::left << md.groupName();
         }
         if (Params::instance().printItems_ & Params::prKey) {
             if (!first)
-                std::cout << " ";
+                taskOut() << " ";
             first = false;
-            std::cout << std::setfill(' ') << std::left << std::setw(44) << md.key();
+            taskOut() << std::setfill(' ') << std::left << std::setw(44) << md.key();
         }
         if (Params::instance().printItems_ & Params::prName) {
             if (!first)
-                std::cout << " ";
+                taskOut() << " ";
             first = false;
-            std::cout << std::setw(27) << std::setfill(' ') << std::left << md.tagName();
+            taskOut() << std::setw(27) << std::setfill(' ') << std::left << md.tagName();
         }
         if (Params::instance().printItems_ & Params::prLabel) {
             if (!first)
-                std::cout << " ";
+                taskOut() << " ";
             first = false;
-            std::cout << std::setw(30) << std::setfill(' ') << std::left << md.tagLabel();
+            taskOut() << std::setw(30) << std::setfill(' ') << std::left << md.tagLabel();
         }
         if (Params::instance().printItems_ & Params::prType) {
             if (!first)
-                std::cout << " ";
+                taskOut() << " ";
             first = false;
-            std::cout << std::setw(9) << std::setfill(' ') << std::left;
+            taskOut() << std::setw(9) << std::setfill(' ') << std::left;
             const char* tn = md.typeName();
             if (tn) {
-                std::cout << tn;
+                taskOut() << tn;
             } else {
                 std::ostringstream os;
                 os << "0x" << std::setw(4) << std::setfill('0') << std::hex << md.typeId();
-                std::cout << os.str();
+                taskOut() << os.str();
             }
         }
         if (Params::instance().printItems_ & Params::prCount) {
             if (!first)
-                std::cout << " ";
+                taskOut() << " ";
             first = false;
-            std::cout << std::dec << std::setw(3) << std::setfill(' ') << std::right << md.count();
+            taskOut() << std::dec << std::setw(3) << std::setfill(' ') << std::right << md.count();
         }
         if (Params::instance().printItems_ & Params::prSize) {
             if (!first)
-                std::cout << " ";
+                taskOut() << " ";
             first = false;
-            std::cout << std::dec << std::setw(3) << std::setfill(' ') << std::right << md.size();
+            taskOut() << std::dec << std::setw(3) << std::setfill(' ') << std::right << md.size();
         }
         if (Params::instance().printItems_ & Params::prValue && md.size() > 0) {
             if (!first)
-                std::cout << "  ";
+                taskOut() << "  ";
             first = false;
-            if (md.size() > 128 && Params::instance().binary_ &&
-                (md.typeId() == Exiv2::undefined || md.typeId() == Exiv2::unsignedByte ||
-                 md.typeId() == Exiv2::signedByte)) {
-                std::cout << _("(Binary value suppressed)") << std::endl;
+            if (isSuppressedBinary(md)) {
+                taskOut() << _("(Binary value suppressed)") << std::endl;
                 return true;
             }
-            bool done = false;
-            if (0 == strcmp(md.key().c_str(), "Exif.Photo.UserComment")) {
-                const Exiv2::CommentValue* pcv = dynamic_cast<const Exiv2::CommentValue*>(&md.value());
-                if (pcv) {
-                    Exiv2::CommentValue::CharsetId csId = pcv->charsetId();
-                    if (csId != Exiv2::CommentValue::undefined) {
-                        std::cout << "charset=\"" << Exiv2::CommentValue::CharsetInfo::name(csId) << "\" ";
-                    }
-                    std::cout << pcv->comment(Params::instance().charset_.c_str());
-                    done = true;
-                }
-            }
-            if (!done) {
-                // #1114 - show negative values for SByte
-                if (md.typeId() != Exiv2::signedByte) {
-                    std::cout << std::dec << md.value();
-                } else {
-                    int value = md.value().toLong();
-                    std::cout << std::dec << (value < 128 ? value : value - 256);
-                }
-            }
+            printValue(taskOut(), md);
         }
         if (Params::instance().printItems_ & Params::prTrans) {
             if (!first)
-                std::cout << "  ";
+                taskOut() << "  ";
             first = false;
-            if (Params::instance().binary_ &&
-                (md.typeId() == Exiv2::undefined || md.typeId() == Exiv2::unsignedByte ||
-                 md.typeId() == Exiv2::signedByte) &&
-                md.size() > 128) {
-                std::cout << _("(Binary value suppressed)") << std::endl;
+            if (isSuppressedBinary(md)) {
+                taskOut() << _("(Binary value suppressed)") << std::endl;
                 return true;
             }
-            bool done = false;
-            if (0 == strcmp(md.key().c_str(), "Exif.Photo.UserComment")) {
-                const Exiv2::CommentValue* pcv = dynamic_cast<const Exiv2::CommentValue*>(&md.value());
-                if (pcv) {
-                    std::cout << pcv->comment(Params::instance().charset_.c_str());
-                    done = true;
-                }
-            }
-            if (!done)
-                std::cout << std::dec << md.print(&pImage->exifData());
+            printInterpreted(taskOut(), md, pImage);
         }
         if (Params::instance().printItems_ & Params::prHex) {
             if (!first)
-                std::cout << std::endl;
+                taskOut() << std::endl;
             first = false;
-            if (Params::instance().binary_ &&
-                (md.typeId() == Exiv2::undefined || md.typeId() == Exiv2::unsignedByte ||
-                 md.typeId() == Exiv2::signedByte) &&
-                md.size() > 128) {
-                std::cout << _("(Binary value suppressed)") << std::endl;
+            if (isSuppressedBinary(md)) {
+                taskOut() << _("(Binary value suppressed)") << std::endl;
                 return true;
             }
             Exiv2::DataBuf buf(md.size());
             md.copy(buf.pData_, pImage->byteOrder());
-            Exiv2::hexdump(std::cout, buf.pData_, buf.size_);
+            Exiv2::hexdump(taskOut(), buf.pData_, buf.size_);
         }
-        std::cout << std::endl;
+        taskOut() << std::endl;
         return true;
     }  // Print::printMetadatum
 
+    void Print::printJsonMetadatum(const Exiv2::Metadatum& md, const Exiv2::Image* pImage)
+    {
+        const unsigned long printItems = Params::instance().printItems_;
+        std::ostream& os = taskOut();
+        // Members are written as they are produced, each line is one object
+        const char* sep = "{";
+        if (Params::instance().manyFiles()) {
+            os << sep << "\"file\":";
+            Util::writeJsonString(os, path_);
+            sep = ",";
+        }
+        if (printItems & Params::prTag) {
+            os << sep << "\"tag\":" << std::dec << md.tag();
+            sep = ",";
+        }
+        if (printItems & Params::prGroup) {
+            os << sep << "\"group\":";
+            Util::writeJsonString(os, md.groupName());
+            sep = ",";
+        }
+        if (printItems & Params::prKey) {
+            os << sep << "\"key\":";
+            Util::writeJsonString(os, md.key());
+            sep = ",";
+        }
+        if (printItems & Params::prName) {
+            os << sep << "\"name\":";
+            Util::writeJsonString(os, md.tagName());
+            sep = ",";
+        }
+        if (printItems & Params::prLabel) {
+            os << sep << "\"label\":";
+            Util::writeJsonString(os, md.tagLabel());
+            sep = ",";
+        }
+        if (printItems & Params::prType) {
+            os << sep << "\"type\":";
+            const char* tn = md.typeName();
+            if (tn) {
+                Util::writeJsonString(os, tn);
+            } else {
+                std::ostringstream tos;
+                tos << "0x" << std::setw(4) << std::setfill('0') << std::hex << md.typeId();
+                Util::writeJsonString(os, tos.str());
+            }
+            sep = ",";
+        }
+        if (printItems & Params::prCount) {
+            os << sep << "\"count\":" << std::dec << md.count();
+            sep = ",";
+        }
+        if (printItems & Params::prSize) {
+            os << sep << "\"size\":" << std::dec << md.size();
+            sep = ",";
+        }
+        // Large binary values are null unless -b is given
+        const bool suppressed = isSuppressedBinary(md);
+        if (printItems & Params::prValue) {
+            os << sep << "\"value\":";
+            if (suppressed) {
+                os << "null";
+            } else {
+                std::ostringstream vos;
+                printValue(vos, md);
+                Util::writeJsonString(os, vos.str());
+            }
+            sep = ",";
+        }
+        if (printItems & Params::prTrans) {
+            os << sep << "\"interpreted\":";
+            if (suppressed) {
+                os << "null";
+            } else {
+                std::ostringstream vos;
+                printInterpreted(vos, md, pImage);
+                Util::writeJsonString(os, vos.str());
+            }
+            sep = ",";
+        }
+        if (printItems & Params::prHex) {
+            os << sep << "\"hex\":";
+            if (suppressed) {
+                os << "null";
+            } else {
+                static const char hexdigits[] = "0123456789abcdef";
+                Exiv2::DataBuf buf(md.size());
+                md.copy(buf.pData_, pImage->byteOrder());
+                std::string hex;
+                hex.reserve(2 * buf.size_);
+                for (long i = 0; i < buf.size_; ++i) {
+                    hex += hexdigits[buf.pData_[i] >> 4];
+                    hex += hexdigits[buf.pData_[i] & 0x0f];
+                }
+                os << '"' << hex << '"';
+            }
+            sep = ",";
+        }
+        if (*sep == '{')
+            os << sep;
+        os << "}\n";
+    } // Print::printJsonMetadatum
+
     int Print::printComment()
     {
         if (!Exiv2::fileExists(path_, true)) {
-            std::cerr << path_
+            taskErr() << path_
                       << ": " << _("Failed to open the file\n");
             return -1;
         }
@@ -774,38 +890,38 @@ namespace Action {
         assert(image.get() != 0);
         image->readMetadata();
         if (Params::instance().verbose_) {
-            std::cout << _("JPEG comment") << ": ";
+            taskOut() << _("JPEG comment") << ": ";
         }
-        std::cout << image->comment() << std::endl;
+        taskOut() << image->comment() << std::endl;
         return 0;
     } // Print::printComment
 
     int Print::printPreviewList()
     {
         if (!Exiv2::fileExists(path_, true)) {
-            std::cerr << path_
+            taskErr() << path_
                       << ": " << _("Failed to open the file\n");
             return -1;
         }
         Exiv2::Image::UniquePtr image = Exiv2::ImageFactory::open(path_);
         assert(image.get() != 0);
         image->readMetadata();
-        bool const manyFiles = Params::instance().files_.size() > 1;
+        bool const manyFiles = Params::instance().manyFiles();
         int cnt = 0;
         Exiv2::PreviewManager pm(*image);
         Exiv2::PreviewPropertiesList list = pm.getPreviewProperties();
         for (Exiv2::PreviewPropertiesList::const_iterator pos = list.begin(); pos != list.end(); ++pos) {
             if (manyFiles) {
-                std::cout << std::setfill(' ') << std::left << std::setw(20)
+                taskOut() << std::setfill(' ') << std::left << std::setw(20)
                           << path_ << "  ";
             }
-            std::cout << _("Preview") << " " << ++cnt << ": "
+            taskOut() << _("Preview") << " " << ++cnt << ": "
                       << pos->mimeType_ << ", ";
             if (pos->width_ != 0 && pos->height_ != 0) {
-                std::cout << pos->width_ << "x" << pos->height_ << " "
+                taskOut() << pos->width_ << "x" << pos->height_ << " "
                           << _("pixels") << ", ";
             }
-            std::cout << pos->size_ << " " << _("bytes") << "\n";
+            taskOut() << pos->size_ << " " << _("bytes") << "\n";
         }
         return 0;
     } // Print::printPreviewList
@@ -828,7 +944,7 @@ namespace Action {
     {
     try {
         if (!Exiv2::fileExists(path, true)) {
-            std::cerr << path
+            taskErr() << path
                       << ": " << _("Failed to open the file\n");
             return -1;
         }
@@ -837,10 +953,14 @@ namespace Action {
 
         Exiv2::Image::UniquePtr image = Exiv2::ImageFactory::open(path);
         assert(image.get() != 0);
+        // Only the timestamps are needed, the image is not written
+        Exiv2::DecodeFilter filter;
+        filter.addKey("Exif.Photo.DateTimeOriginal").addKey("Exif.Image.DateTime");
+        image->setDecodeFilter(filter);
         image->readMetadata();
         Exiv2::ExifData& exifData = image->exifData();
         if (exifData.empty()) {
-            std::cerr << path
+            taskErr() << path
                       << ": " << _("No Exif data found in the file\n");
             return -3;
         }
@@ -851,20 +971,20 @@ namespace Action {
             md = exifData.findKey(key);
         }
         if (md == exifData.end()) {
-            std::cerr << _("Neither tag") << " `Exif.Photo.DateTimeOriginal' "
+            taskErr() << _("Neither tag") << " `Exif.Photo.DateTimeOriginal' "
                       << _("nor") << " `Exif.Image.DateTime' "
                       << _("found in the file") << " " << path << "\n";
             return 1;
         }
         std::string v = md->toString();
         if (v.length() == 0 || v[0] == ' ') {
-            std::cerr << _("Image file creation timestamp not set in the file")
+            taskErr() << _("Image file creation timestamp not set in the file")
                       << " " << path << "\n";
             return 1;
         }
         struct tm tm;
         if (str2Tm(v, &tm) != 0) {
-            std::cerr << _("Failed to parse timestamp") << " `" << v
+            taskErr() << _("Failed to parse timestamp") << " `" << v
                       << "' " << _("in the file") << " " << path << "\n";
             return 1;
         }
@@ -876,7 +996,7 @@ namespace Action {
         std::string newPath = path;
         if (Params::instance().timestampOnly_) {
             if (Params::instance().verbose_) {
-                std::cout << _("Updating timestamp to") << " " << v << std::endl;
+                taskOut() << _("Updating timestamp to") << " " << v << std::endl;
             }
         }
         else {
@@ -893,7 +1013,7 @@ namespace Action {
     }
     catch(const Exiv2::AnyError& e)
     {
-        std::cerr << "Exiv2 exception in rename action for file " << path
+        taskErr() << "Exiv2 exception in rename action for file " << path
                   << ":\n" << e << "\n";
         return 1;
     }} // Rename::run
@@ -917,7 +1037,7 @@ namespace Action {
         path_ = path;
 
         if (!Exiv2::fileExists(path_, true)) {
-            std::cerr << path_
+            taskErr() << path_
                       << ": " << _("Failed to open the file\n");
             return -1;
         }
@@ -948,7 +1068,7 @@ namespace Action {
             rc = eraseIccProfile(image.get());
         }
         if (0 == rc && Params::instance().target_ & Params::ctIptcRaw) {
-            rc = printStructure(std::cout,Exiv2::kpsIptcErase,path_);
+            rc = printStructure(taskOut(),Exiv2::kpsIptcErase,path_);
         }
 
         if (0 == rc) {
@@ -960,7 +1080,7 @@ namespace Action {
     }
     catch(const Exiv2::AnyError& e)
     {
-        std::cerr << "Exiv2 exception in erase action for file " << path
+        taskErr() << "Exiv2 exception in erase action for file " << path
                   << ":\n" << e << "\n";
         return 1;
     } // Erase::run
@@ -974,7 +1094,7 @@ namespace Action {
         }
         exifThumb.erase();
         if (Params::instance().verbose_) {
-            std::cout << _("Erasing thumbnail data") << std::endl;
+            taskOut() << _("Erasing thumbnail data") << std::endl;
         }
         return 0;
     }
@@ -982,7 +1102,7 @@ namespace Action {
     int Erase::eraseExifData(Exiv2::Image* image) const
     {
         if (Params::instance().verbose_ && image->exifData().count() > 0) {
-            std::cout << _("Erasing Exif data from the file") << std::endl;
+            taskOut() << _("Erasing Exif data from the file") << std::endl;
         }
         image->clearExifData();
         return 0;
@@ -991,7 +1111,7 @@ namespace Action {
     int Erase::eraseIptcData(Exiv2::Image* image) const
     {
         if (Params::instance().verbose_ && image->iptcData().count() > 0) {
-            std::cout << _("Erasing IPTC data from the file") << std::endl;
+            taskOut() << _("Erasing IPTC data from the file") << std::endl;
         }
         image->clearIptcData();
         return 0;
@@ -1000,7 +1120,7 @@ namespace Action {
     int Erase::eraseComment(Exiv2::Image* image) const
     {
         if (Params::instance().verbose_ && image->comment().size() > 0) {
-            std::cout << _("Erasing JPEG comment from the file") << std::endl;
+            taskOut() << _("Erasing JPEG comment from the file") << std::endl;
         }
         image->clearComment();
         return 0;
@@ -1009,7 +1129,7 @@ namespace Action {
     int Erase::eraseXmpData(Exiv2::Image* image) const
     {
         if (Params::instance().verbose_ && image->xmpData().count() > 0) {
-            std::cout << _("Erasing XMP data from the file") << std::endl;
+            taskOut() << _("Erasing XMP data from the file") << std::endl;
         }
         image->clearXmpData();                  // Quick fix for bug #612
         image->clearXmpPacket();
@@ -1018,7 +1138,7 @@ namespace Action {
     int Erase::eraseIccProfile(Exiv2::Image* image) const
     {
         if (Params::instance().verbose_ && image->iccProfileDefined() ) {
-            std::cout << _("Erasing ICC Profile data from the file") << std::endl;
+            taskOut() << _("Erasing ICC Profile data from the file") << std::endl;
         }
         image->clearIccProfile();
         return 0;
@@ -1077,7 +1197,7 @@ namespace Action {
             }
             return rc;
         } catch (const Exiv2::AnyError& e) {
-            std::cerr << "Exiv2 exception in extract action for file " << path << ":\n" << e << "\n";
+            taskErr() << "Exiv2 exception in extract action for file " << path << ":\n" << e << "\n";
             return 1;
         }
     }
@@ -1085,7 +1205,7 @@ namespace Action {
     int Extract::writeThumbnail() const
     {
         if (!Exiv2::fileExists(path_, true)) {
-            std::cerr << path_
+            taskErr() << path_
                       << ": " << _("Failed to open the file\n");
             return -1;
         }
@@ -1094,7 +1214,7 @@ namespace Action {
         image->readMetadata();
         Exiv2::ExifData& exifData = image->exifData();
         if (exifData.empty()) {
-            std::cerr << path_
+            taskErr() << path_
                       << ": " << _("No Exif data found in the file\n");
             return -3;
         }
@@ -1102,7 +1222,7 @@ namespace Action {
         Exiv2::ExifThumb exifThumb(exifData);
         std::string thumbExt = exifThumb.extension();
         if (thumbExt.empty()) {
-            std::cerr << path_ << ": " << _("Image does not contain an Exif thumbnail\n");
+            taskErr() << path_ << ": " << _("Image does not contain an Exif thumbnail\n");
         }
         else {
             std::string thumb = newFilePath(path_, "-thumb");
@@ -1111,14 +1231,14 @@ namespace Action {
             if (Params::instance().verbose_) {
                 Exiv2::DataBuf buf = exifThumb.copy();
                 if (buf.size_ != 0) {
-                    std::cout << _("Writing thumbnail") << " (" << exifThumb.mimeType() << ", "
+                    taskOut() << _("Writing thumbnail") << " (" << exifThumb.mimeType() << ", "
                               << buf.size_ << " " << _("Bytes") << ") " << _("to file") << " "
                               << thumbPath << std::endl;
                 }
             }
             rc = exifThumb.writeFile(thumb);
             if (rc == 0) {
-                std::cerr << path_ << ": " << _("Exif data doesn't contain a thumbnail\n");
+                taskErr() << path_ << ": " << _("Exif data doesn't contain a thumbnail\n");
             }
         }
         return rc;
@@ -1127,7 +1247,7 @@ namespace Action {
     int Extract::writePreviews() const
     {
         if (!Exiv2::fileExists(path_, true)) {
-            std::cerr << path_
+            taskErr() << path_
                       << ": " << _("Failed to open the file\n");
             return -1;
         }
@@ -1138,21 +1258,47 @@ namespace Action {
         Exiv2::PreviewManager pvMgr(*image);
         Exiv2::PreviewPropertiesList pvList = pvMgr.getPreviewProperties();
 
+        // Select the previews to write
+        Exiv2::PreviewPropertiesList selected;
+        std::vector<int> nums;
         const Params::PreviewNumbers& numbers = Params::instance().previewNumbers_;
         for (Params::PreviewNumbers::const_iterator n = numbers.begin(); n != numbers.end(); ++n) {
             if (*n == 0) {
                 // Write all previews
+                selected = pvList;
+                nums.clear();
                 for (int num = 0; num < static_cast<int>(pvList.size()); ++num) {
-                    writePreviewFile(pvMgr.getPreviewImage(pvList[num]), num + 1);
+                    nums.push_back(num + 1);
                 }
                 break;
             }
             if (*n > static_cast<int>(pvList.size())) {
-                std::cerr << path_ << ": " << _("Image does not have preview")
+                taskErr() << path_ << ": " << _("Image does not have preview")
                           << " " << *n << "\n";
                 continue;
             }
-            writePreviewFile(pvMgr.getPreviewImage(pvList[*n - 1]), *n);
+            if (std::find(nums.begin(), nums.end(), *n) != nums.end()) continue;
+            selected.push_back(pvList[*n - 1]);
+            nums.push_back(*n);
+        }
+        std::vector<Exiv2::PreviewImage> previews = pvMgr.getPreviewImages(selected);
+
+        // Check the files in order, then write them concurrently
+        std::vector<std::future<long> > pending(previews.size());
+        for (size_t i = 0; i < previews.size(); ++i) {
+            std::string pvFile = previewFile(previews[i], nums[i]);
+            if (pvFile.empty()) continue;
+            const Exiv2::PreviewImage* pvImg = &previews[i];
+            pending[i] = std::async(std::launch::async, [pvImg, pvFile]() {
+                return pvImg->writeFile(pvFile);
+            });
+        }
+        for (size_t i = 0; i < pending.size(); ++i) {
+            if (!pending[i].valid()) continue;
+            if (pending[i].get() == 0) {
+                taskErr() << path_ << ": " << _("Image does not have preview")
+                          << " " << nums[i] << "\n";
+            }
         }
         return 0;
     } // Extract::writePreviews
@@ -1161,7 +1307,7 @@ namespace Action {
     {
         int rc = 0;
         if (!Exiv2::fileExists(path_, true)) {
-            std::cerr << path_
+            taskErr() << path_
                       << ": " << _("Failed to open the file\n");
             rc = -1;
         }
@@ -1173,15 +1319,15 @@ namespace Action {
             assert(image.get() != 0);
             image->readMetadata();
             if ( !image->iccProfileDefined() ) {
-                std::cerr << _("No embedded iccProfile: ") << path_ << std::endl;
+                taskErr() << _("No embedded iccProfile: ") << path_ << std::endl;
                 rc = -2;
             } else {
 
                 if ( bStdout ) { // -eC-
-                    std::cout.write((const char*)image->iccProfile()->pData_,image->iccProfile()->size_);
+                    taskOut().write((const char*)image->iccProfile()->pData_,image->iccProfile()->size_);
                 } else {
                     if (Params::instance().verbose_) {
-                        std::cout << _("Writing iccProfile: ") << target << std::endl;
+                        taskOut() << _("Writing iccProfile: ") << target << std::endl;
                     }
                     Exiv2::FileIo iccFile(target);
                     iccFile.open("wb") ;
@@ -1194,27 +1340,23 @@ namespace Action {
     } // Extract::writeIccProfile
 
 
-    void Extract::writePreviewFile(const Exiv2::PreviewImage& pvImg, int num) const
+    std::string Extract::previewFile(const Exiv2::PreviewImage& pvImg, int num) const
     {
         std::string pvFile = newFilePath(path_, "-preview") + Exiv2::toString(num);
         std::string pvPath = pvFile + pvImg.extension();
-        if (dontOverwrite(pvPath)) return;
+        if (dontOverwrite(pvPath)) return std::string();
         if (Params::instance().verbose_) {
-            std::cout << _("Writing preview") << " " << num << " ("
+            taskOut() << _("Writing preview") << " " << num << " ("
                       << pvImg.mimeType() << ", ";
             if (pvImg.width() != 0 && pvImg.height() != 0) {
-                std::cout << pvImg.width() << "x" << pvImg.height() << " "
+                taskOut() << pvImg.width() << "x" << pvImg.height() << " "
                           << _("pixels") << ", ";
             }
-            std::cout << pvImg.size() << " " << _("bytes") << ") "
+            taskOut() << pvImg.size() << " " << _("bytes") << ") "
                       << _("to file") << " " << pvPath << std::endl;
         }
-        long rc = pvImg.writeFile(pvFile);
-        if (rc == 0) {
-            std::cerr << path_ << ": " << _("Image does not have preview")
-                      << " " << num << "\n";
-        }
-    } // Extract::writePreviewFile
+        return pvFile;
+    } // Extract::previewFile
 
     Extract::UniquePtr Extract::clone() const
     {
@@ -1236,7 +1378,7 @@ namespace Action {
         bool          bStdin = (Params::instance().target_ & Params::ctStdInOut)?true:false;
 
         if (!Exiv2::fileExists(path, true)) {
-            std::cerr << path
+            taskErr() << path
                       << ": " << _("Failed to open the file\n");
             return -1;
         }
@@ -1278,7 +1420,7 @@ namespace Action {
     }
     catch(const Exiv2::AnyError& e)
     {
-        std::cerr << "Exiv2 exception in insert action for file " << path
+        taskErr() << "Exiv2 exception in insert action for file " << path
                   << ":\n" << e << "\n";
         return 1;
     } // Insert::run
@@ -1293,12 +1435,12 @@ namespace Action {
             rc   = insertXmpPacket(path,xmpBlob,true);
         } else {
             if (!Exiv2::fileExists(xmpPath, true)) {
-                std::cerr << xmpPath
+                taskErr() << xmpPath
                           << ": " << _("Failed to open the file\n");
                 rc = -1;
             }
             if (rc == 0 && !Exiv2::fileExists(path, true)) {
-                std::cerr << path
+                taskErr() << path
                           << ": " << _("Failed to open the file\n");
                 rc = -1;
             }
@@ -1339,7 +1481,7 @@ namespace Action {
             rc =  insertIccProfile(path,iccProfile);
         } else {
             if (!Exiv2::fileExists(iccProfilePath, true)) {
-                std::cerr << iccProfilePath
+                taskErr() << iccProfilePath
                           << ": " << _("Failed to open the file\n");
                 rc = -1;
             } else {
@@ -1355,7 +1497,7 @@ namespace Action {
         int rc = 0;
         // test path exists
         if (!Exiv2::fileExists(path, true)) {
-            std::cerr << path << ": " << _("Failed to open the file\n");
+            taskErr() << path << ": " << _("Failed to open the file\n");
             rc=-1;
         }
 
@@ -1379,12 +1521,12 @@ namespace Action {
     {
         std::string thumbPath = newFilePath(path, "-thumb.jpg");
         if (!Exiv2::fileExists(thumbPath, true)) {
-            std::cerr << thumbPath
+            taskErr() << thumbPath
                       << ": " << _("Failed to open the file\n");
             return -1;
         }
         if (!Exiv2::fileExists(path, true)) {
-            std::cerr << path
+            taskErr() << path
                       << ": " << _("Failed to open the file\n");
             return -1;
         }
@@ -1414,9 +1556,10 @@ namespace Action {
 
     int Modify::run(const std::string& path)
     {
+    if (path == "-") return runOnStdin();
     try {
         if (!Exiv2::fileExists(path, true)) {
-            std::cerr << path
+            taskErr() << path
                       << ": " << _("Failed to open the file\n");
             return -1;
         }
@@ -1427,7 +1570,24 @@ namespace Action {
         assert(image.get() != 0);
         image->readMetadata();
 
+        // Commands for this file from batch files
+        const Params::FileCmds& fileCmds = Params::instance().fileCmds_;
+        Params::FileCmds::const_iterator pos = fileCmds.find(path);
+        const bool exifOnly =    Params::instance().jpegComment_.empty()
+                              && exifSetsOnly(Params::instance().modifyCmds_)
+                              && (pos == fileCmds.end() || exifSetsOnly(pos->second));
+        Exiv2::ExifData original;
+        if (exifOnly) original = image->exifData();
+
         int rc = applyCommands(image.get());
+        if (pos != fileCmds.end()) {
+            int ret = applyCommands(image.get(), pos->second);
+            if (rc == 0) rc = ret;
+        }
+
+        // Values which were only replaced by values of the same size are
+        // patched in place instead of rewriting the image
+        image->writeInPlace(exifOnly && sameLayout(original, image->exifData()));
 
         // Save both exif and iptc metadata
         image->writeMetadata();
@@ -1438,17 +1598,69 @@ namespace Action {
     }
     catch(const Exiv2::AnyError& e)
     {
-        std::cerr << "Exiv2 exception in modify action for file " << path
+        taskErr() << "Exiv2 exception in modify action for file " << path
                   << ":\n" << e << "\n";
         return 1;
     }
     } // Modify::run
 
+    int Modify::runOnStdin()
+    {
+    try {
+        _setmode(_fileno(stdin), O_BINARY);
+        _setmode(_fileno(stdout), O_BINARY);
+        // Only the head of a JPEG image is read before writing, other images are read as a whole
+        Exiv2::Blob head;
+        const bool streaming = Exiv2::readJpegHead(std::cin, head);
+        char buf[64 * 1024];
+        while (!streaming && std::cin.read(buf, sizeof(buf)).gcount() > 0) {
+            head.insert(head.end(), buf, buf + std::cin.gcount());
+        }
+        if (head.empty()) {
+            taskErr() << "-: " << _("No image data on standard input\n");
+            return 1;
+        }
+
+        // The image goes to standard output, verbose messages to standard error
+        std::ostream& os = taskOut();
+        TaskOutput output(taskErr(), taskErr());
+
+        Exiv2::Image::UniquePtr image = Exiv2::ImageFactory::open(&head[0], static_cast<long>(head.size()));
+        assert(image.get() != 0);
+        image->readMetadata();
+        int rc = applyCommands(image.get());
+        const Params::FileCmds& fileCmds = Params::instance().fileCmds_;
+        Params::FileCmds::const_iterator pos = fileCmds.find("-");
+        if (pos != fileCmds.end()) {
+            int ret = applyCommands(image.get(), pos->second);
+            if (rc == 0) rc = ret;
+        }
+
+        Exiv2::MemIo out;
+        image->writeMetadataTo(out);
+        os.write(reinterpret_cast<const char*>(out.mmap()), out.size());
+        while (streaming && std::cin.read(buf, sizeof(buf)).gcount() > 0) {
+            os.write(buf, std::cin.gcount());
+        }
+        os.flush();
+        if (!os) {
+            taskErr() << "-: " << _("Failed to write to standard output\n");
+            return 1;
+        }
+        return rc;
+    }
+    catch(const Exiv2::AnyError& e)
+    {
+        taskErr() << "Exiv2 exception in modify action for standard input:\n" << e << "\n";
+        return 1;
+    }
+    } // Modify::runOnStdin
+
     int Modify::applyCommands(Exiv2::Image* pImage)
     {
         if (!Params::instance().jpegComment_.empty()) {
             if (Params::instance().verbose_) {
-                std::cout << _("Setting JPEG comment") << " '"
+                taskOut() << _("Setting JPEG comment") << " '"
                           << Params::instance().jpegComment_
                           << "'"
                           << std::endl;
@@ -1456,8 +1668,12 @@ namespace Action {
             pImage->setComment(Params::instance().jpegComment_);
         }
 
+        return applyCommands(pImage, Params::instance().modifyCmds_);
+    } // Modify::applyCommands
+
+    int Modify::applyCommands(Exiv2::Image* pImage, const ModifyCmds& modifyCmds)
+    {
         // loop through command table and apply each command
-        ModifyCmds& modifyCmds = Params::instance().modifyCmds_;
         ModifyCmds::const_iterator i = modifyCmds.begin();
         ModifyCmds::const_iterator end = modifyCmds.end();
         int rc = 0;
@@ -1489,7 +1705,7 @@ namespace Action {
     int Modify::addMetadatum(Exiv2::Image* pImage, const ModifyCmd& modifyCmd)
     {
         if (Params::instance().verbose_) {
-            std::cout << _("Add") << " " << modifyCmd.key_ << " \""
+            taskOut() << _("Add") << " " << modifyCmd.key_ << " \""
                       << modifyCmd.value_ << "\" ("
                       << Exiv2::TypeInfo::typeName(modifyCmd.typeId_)
                       << ")" << std::endl;
@@ -1511,7 +1727,7 @@ namespace Action {
             }
         }
         else {
-            std::cerr << _("Warning") << ": " << modifyCmd.key_ << ": "
+            taskErr() << _("Warning") << ": " << modifyCmd.key_ << ": "
                       << _("Failed to read") << " "
                       << Exiv2::TypeInfo::typeName(value->typeId())
                       << " " << _("value")
@@ -1525,7 +1741,7 @@ namespace Action {
     int Modify::setMetadatum(Exiv2::Image* pImage, const ModifyCmd& modifyCmd)
     {
         if (Params::instance().verbose_) {
-            std::cout << _("Set") << " " << modifyCmd.key_ << " \""
+            taskOut() << _("Set") << " " << modifyCmd.key_ << " \""
                       << modifyCmd.value_ << "\" ("
                       << Exiv2::TypeInfo::typeName(modifyCmd.typeId_)
                       << ")" << std::endl;
@@ -1585,7 +1801,7 @@ namespace Action {
             }
         }
         else {
-            std::cerr << _("Warning") << ": " << modifyCmd.key_ << ": "
+            taskErr() << _("Warning") << ": " << modifyCmd.key_ << ": "
                       << _("Failed to read") << " "
                       << Exiv2::TypeInfo::typeName(value->typeId())
                       << " " << _("value")
@@ -1597,7 +1813,7 @@ namespace Action {
     void Modify::delMetadatum(Exiv2::Image* pImage, const ModifyCmd& modifyCmd)
     {
         if (Params::instance().verbose_) {
-            std::cout << _("Del") << " " << modifyCmd.key_ << std::endl;
+            taskOut() << _("Del") << " " << modifyCmd.key_ << std::endl;
         }
 
         Exiv2::ExifData& exifData = pImage->exifData();
@@ -1629,7 +1845,7 @@ namespace Action {
     void Modify::regNamespace(const ModifyCmd& modifyCmd)
     {
         if (Params::instance().verbose_) {
-            std::cout << _("Reg ") << modifyCmd.key_ << "=\""
+            taskOut() << _("Reg ") << modifyCmd.key_ << "=\""
                       << modifyCmd.value_ << "\"" << std::endl;
         }
         Exiv2::XmpProperties::registerNs(modifyCmd.value_, modifyCmd.key_);
@@ -1657,7 +1873,7 @@ namespace Action {
         dayAdjustment_   = Params::instance().yodAdjust_[Params::yodDay].adjustment_;
 
         if (!Exiv2::fileExists(path, true)) {
-            std::cerr << path
+            taskErr() << path
                       << ": " << _("Failed to open the file\n");
             return -1;
         }
@@ -1669,16 +1885,19 @@ namespace Action {
         image->readMetadata();
         Exiv2::ExifData& exifData = image->exifData();
         if (exifData.empty()) {
-            std::cerr << path
+            taskErr() << path
                       << ": " << _("No Exif data found in the file\n");
             return -3;
         }
+        const Exiv2::ExifData original = exifData;
         int rc = adjustDateTime(exifData, "Exif.Image.DateTime", path);
         rc += adjustDateTime(exifData, "Exif.Photo.DateTimeOriginal", path);
         rc += adjustDateTime(exifData, "Exif.Image.DateTimeOriginal", path);
         rc += adjustDateTime(exifData, "Exif.Photo.DateTimeDigitized", path);
 
         if (rc == 0 ) {
+            // Adjusted timestamps usually keep their size, patch them in place
+            image->writeInPlace(sameLayout(original, exifData));
             image->writeMetadata();
             if (Params::instance().preserve_) ts.touch(path);
         }
@@ -1686,7 +1905,7 @@ namespace Action {
     }
     catch(const Exiv2::AnyError& e)
     {
-        std::cerr << "Exiv2 exception in adjust action for file " << path
+        taskErr() << "Exiv2 exception in adjust action for file " << path
                   << ":\n" << e << "\n";
         return 1;
     } // Adjust::run
@@ -1713,54 +1932,54 @@ namespace Action {
         }
         std::string timeStr = md->toString();
         if (timeStr == "" || timeStr[0] == ' ') {
-            std::cerr << path << ": " << _("Timestamp of metadatum with key") << " `"
+            taskErr() << path << ": " << _("Timestamp of metadatum with key") << " `"
                       << ek << "' " << _("not set\n");
             return 1;
         }
         if (Params::instance().verbose_) {
             bool comma = false;
-            std::cout << _("Adjusting") << " `" << ek << "' " << _("by");
+            taskOut() << _("Adjusting") << " `" << ek << "' " << _("by");
             if (yearAdjustment_ != 0) {
-                std::cout << (yearAdjustment_ < 0 ? " " : " +") << yearAdjustment_ << " ";
+                taskOut() << (yearAdjustment_ < 0 ? " " : " +") << yearAdjustment_ << " ";
                 if (yearAdjustment_ < -1 || yearAdjustment_ > 1) {
-                    std::cout << _("years");
+                    taskOut() << _("years");
                 }
                 else {
-                    std::cout << _("year");
+                    taskOut() << _("year");
                 }
                 comma = true;
             }
             if (monthAdjustment_ != 0) {
-                if (comma) std::cout << ",";
-                std::cout << (monthAdjustment_ < 0 ? " " : " +") << monthAdjustment_ << " ";
+                if (comma) taskOut() << ",";
+                taskOut() << (monthAdjustment_ < 0 ? " " : " +") << monthAdjustment_ << " ";
                 if (monthAdjustment_ < -1 || monthAdjustment_ > 1) {
-                    std::cout << _("months");
+                    taskOut() << _("months");
                 }
                 else {
-                    std::cout << _("month");
+                    taskOut() << _("month");
                 }
                 comma = true;
             }
             if (dayAdjustment_ != 0) {
-                if (comma) std::cout << ",";
-                std::cout << (dayAdjustment_ < 0 ? " " : " +") << dayAdjustment_ << " ";
+                if (comma) taskOut() << ",";
+                taskOut() << (dayAdjustment_ < 0 ? " " : " +") << dayAdjustment_ << " ";
                 if (dayAdjustment_ < -1 || dayAdjustment_ > 1) {
-                    std::cout << _("days");
+                    taskOut() << _("days");
                 }
                 else {
-                    std::cout << _("day");
+                    taskOut() << _("day");
                 }
                 comma = true;
             }
             if (adjustment_ != 0) {
-                if (comma) std::cout << ",";
-                std::cout << " " << adjustment_ << _("s");
+                if (comma) taskOut() << ",";
+                taskOut() << " " << adjustment_ << _("s");
             }
         }
         struct tm tm;
         if (str2Tm(timeStr, &tm) != 0) {
-            if (Params::instance().verbose_) std::cout << std::endl;
-            std::cerr << path << ": " << _("Failed to parse timestamp") << " `"
+            if (Params::instance().verbose_) taskOut() << std::endl;
+            taskErr() << path << ": " << _("Failed to parse timestamp") << " `"
                       << timeStr << "'\n";
             return 1;
         }
@@ -1769,8 +1988,8 @@ namespace Action {
         tm.tm_year += yearAdjustment_ + monOverflow;
         // Let's not create files with non-4-digit years, we can't read them.
         if (tm.tm_year > 9999 - 1900 || tm.tm_year < 1000 - 1900) {
-            if (Params::instance().verbose_) std::cout << std::endl;
-            std::cerr << path << ": " << _("Can't adjust timestamp by") << " "
+            if (Params::instance().verbose_) taskOut() << std::endl;
+            taskErr() << path << ": " << _("Can't adjust timestamp by") << " "
                       << yearAdjustment_ + monOverflow
                       << " " << _("years") << "\n";
             return 1;
@@ -1779,7 +1998,7 @@ namespace Action {
         time += adjustment_ + dayAdjustment_ * 86400;
         timeStr = time2Str(time);
         if (Params::instance().verbose_) {
-            std::cout << " " << _("to") << " " << timeStr << std::endl;
+            taskOut() << " " << _("to") << " " << timeStr << std::endl;
         }
         md->setValue(timeStr);
         return 0;
@@ -1793,7 +2012,7 @@ namespace Action {
     {
     try {
         if (!Exiv2::fileExists(path, true)) {
-            std::cerr << path
+            taskErr() << path
                       << ": " <<_("Failed to open the file\n");
             return -1;
         }
@@ -1802,10 +2021,15 @@ namespace Action {
 
         Exiv2::Image::UniquePtr image = Exiv2::ImageFactory::open(path);
         assert(image.get() != 0);
+        // The standard ISO tag is usually there, the makernote is decoded
+        // only if isoSpeed() has to look into it or the image is written,
+        // the IPTC and XMP embedded in TIFF tags only if it is written
+        image->exifData().setLazyMakernote(true);
+        image->exifData().setLazyEmbedded(true);
         image->readMetadata();
         Exiv2::ExifData& exifData = image->exifData();
         if (exifData.empty()) {
-            std::cerr << path
+            taskErr() << path
                       << ": " << _("No Exif data found in the file\n");
             return -3;
         }
@@ -1813,7 +2037,7 @@ namespace Action {
         if (md != exifData.end()) {
             if (strcmp(md->key().c_str(), "Exif.Photo.ISOSpeedRatings") == 0) {
                 if (Params::instance().verbose_) {
-                    std::cout << _("Standard Exif ISO tag exists; not modified\n");
+                    taskOut() << _("Standard Exif ISO tag exists; not modified\n");
                 }
                 return 0;
             }
@@ -1821,7 +2045,7 @@ namespace Action {
             std::ostringstream os;
             md->write(os, &exifData);
             if (Params::instance().verbose_) {
-                std::cout << _("Setting Exif ISO value to") << " " << os.str() << "\n";
+                taskOut() << _("Setting Exif ISO value to") << " " << os.str() << "\n";
             }
             exifData["Exif.Photo.ISOSpeedRatings"] = os.str();
         }
@@ -1832,7 +2056,7 @@ namespace Action {
     }
     catch(const Exiv2::AnyError& e)
     {
-        std::cerr << "Exiv2 exception in fixiso action for file " << path
+        taskErr() << "Exiv2 exception in fixiso action for file " << path
                   << ":\n" << e << "\n";
         return 1;
     }
@@ -1856,7 +2080,7 @@ namespace Action {
     {
     try {
         if (!Exiv2::fileExists(path, true)) {
-            std::cerr << path
+            taskErr() << path
                       << ": " <<_("Failed to open the file\n");
             return -1;
         }
@@ -1868,14 +2092,14 @@ namespace Action {
         image->readMetadata();
         Exiv2::ExifData& exifData = image->exifData();
         if (exifData.empty()) {
-            std::cerr << path
+            taskErr() << path
                       << ": " << _("No Exif data found in the file\n");
             return -3;
         }
         Exiv2::ExifData::iterator pos = exifData.findKey(Exiv2::ExifKey("Exif.Photo.UserComment"));
         if (pos == exifData.end()) {
             if (Params::instance().verbose_) {
-                std::cout << _("No Exif user comment found") << "\n";
+                taskOut() << _("No Exif user comment found") << "\n";
             }
             return 0;
         }
@@ -1883,20 +2107,20 @@ namespace Action {
         const Exiv2::CommentValue* pcv = dynamic_cast<const Exiv2::CommentValue*>(v.get());
         if (!pcv) {
             if (Params::instance().verbose_) {
-                std::cout << _("Found Exif user comment with unexpected value type") << "\n";
+                taskOut() << _("Found Exif user comment with unexpected value type") << "\n";
             }
             return 0;
         }
         Exiv2::CommentValue::CharsetId csId = pcv->charsetId();
         if (csId != Exiv2::CommentValue::unicode) {
             if (Params::instance().verbose_) {
-                std::cout << _("No Exif UNICODE user comment found") << "\n";
+                taskOut() << _("No Exif UNICODE user comment found") << "\n";
             }
             return 0;
         }
         std::string comment = pcv->comment(Params::instance().charset_.c_str());
         if (Params::instance().verbose_) {
-            std::cout << _("Setting Exif UNICODE user comment to") << " \"" << comment << "\"\n";
+            taskOut() << _("Setting Exif UNICODE user comment to") << " \"" << comment << "\"\n";
         }
         comment = std::string("charset=\"") + Exiv2::CommentValue::CharsetInfo::name(csId) + "\" " + comment;
         // Remove BOM and convert value from source charset to UCS-2, but keep byte order
@@ -1908,7 +2132,7 @@ namespace Action {
     }
     catch(const Exiv2::AnyError& e)
     {
-        std::cerr << "Exiv2 exception in fixcom action for file " << path
+        taskErr() << "Exiv2 exception in fixcom action for file " << path
                   << ":\n" << e << "\n";
         return 1;
     }
@@ -1930,6 +2154,71 @@ namespace Action {
 // local definitions
 namespace {
 
+    bool sameLayout(const Exiv2::ExifData& before, const Exiv2::ExifData& after)
+    {
+        if (before.count() != after.count()) return false;
+        Exiv2::ExifData::const_iterator b = before.begin();
+        for (Exiv2::ExifData::const_iterator a = after.begin(); a != after.end(); ++a, ++b) {
+            if (   a->ifdId() != b->ifdId()
+                || a->tag() != b->tag()
+                || a->typeId() != b->typeId()
+                || a->size() != b->size()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool exifSetsOnly(const ModifyCmds& modifyCmds)
+    {
+        for (ModifyCmds::const_iterator i = modifyCmds.begin(); i != modifyCmds.end(); ++i) {
+            if (i->cmdId_ != set || i->metadataId_ != exif) return false;
+        }
+        return true;
+    }
+
+    bool isSuppressedBinary(const Exiv2::Metadatum& md)
+    {
+        return    Params::instance().binary_
+               && (   md.typeId() == Exiv2::undefined || md.typeId() == Exiv2::unsignedByte
+                   || md.typeId() == Exiv2::signedByte)
+               && md.size() > 128;
+    }
+
+    void printValue(std::ostream& os, const Exiv2::Metadatum& md)
+    {
+        if (0 == strcmp(md.key().c_str(), "Exif.Photo.UserComment")) {
+            const Exiv2::CommentValue* pcv = dynamic_cast<const Exiv2::CommentValue*>(&md.value());
+            if (pcv) {
+                Exiv2::CommentValue::CharsetId csId = pcv->charsetId();
+                if (csId != Exiv2::CommentValue::undefined) {
+                    os << "charset=\"" << Exiv2::CommentValue::CharsetInfo::name(csId) << "\" ";
+                }
+                os << pcv->comment(Params::instance().charset_.c_str());
+                return;
+            }
+        }
+        // #1114 - show negative values for SByte
+        if (md.typeId() != Exiv2::signedByte) {
+            os << std::dec << md.value();
+        } else {
+            int value = md.value().toLong();
+            os << std::dec << (value < 128 ? value : value - 256);
+        }
+    }
+
+    void printInterpreted(std::ostream& os, const Exiv2::Metadatum& md, const Exiv2::Image* pImage)
+    {
+        if (0 == strcmp(md.key().c_str(), "Exif.Photo.UserComment")) {
+            const Exiv2::CommentValue* pcv = dynamic_cast<const Exiv2::CommentValue*>(&md.value());
+            if (pcv) {
+                os << pcv->comment(Params::instance().charset_.c_str());
+                return;
+            }
+        }
+        os << std::dec << md.print(&pImage->exifData());
+    }
+
     //! @cond IGNORE
     int Timestamp::read(const std::string& path)
     {
@@ -2017,73 +2306,19 @@ namespace {
         return os.str();
     } // tm2Str
 
-// use static CS/MUTEX to make temporaryPath() thread safe
-#if defined(_MSC_VER) || defined(__MINGW__)
- static CRITICAL_SECTION cs;
-#else
- /* Unix/Linux/Cygwin/MacOSX */
- #include <pthread.h>
- /* This is the critical section object (statically allocated). */
- #if defined(__APPLE__)
-  #if defined(PTHREAD_RECURSIVE_MUTEX_INITIALIZER)
-    static pthread_mutex_t cs =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER;
-   #else
-    static pthread_mutex_t cs =  PTHREAD_MUTEX_INITIALIZER;
-  #endif
- #else
-  #if defined(PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP)
-    static pthread_mutex_t cs =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-   #else
-    static pthread_mutex_t cs =  PTHREAD_MUTEX_INITIALIZER;
-  #endif
- #endif
-#endif
-
-    static std::string temporaryPath()
-    {
-        static int  count = 0 ;
-
-#if defined(_MSC_VER) || defined(__MINGW__)
-        EnterCriticalSection(&cs);
-        char lpTempPathBuffer[MAX_PATH];
-        GetTempPath(MAX_PATH,lpTempPathBuffer);
-        std::string tmp(lpTempPathBuffer);
-        tmp += "\\";
-        HANDLE process=0;
-        DWORD  pid = ::GetProcessId(process);
-#else
-        pid_t  pid = ::getpid();
-        pthread_mutex_lock( &cs );
-        std::string tmp = "/tmp/";
-#endif
-        char        sCount[12];
-        sprintf(sCount,"_%d",++count);
-
-        std::string result = tmp + Exiv2::toString(pid) + sCount ;
-        if ( Exiv2::fileExists(result) ) std::remove(result.c_str());
-
-#if defined(_MSC_VER) || defined(__MINGW__)
-        LeaveCriticalSection(&cs);
-#else
-        pthread_mutex_unlock( &cs );
-#endif
-
-        return result;
-    }
-
     int metacopy(const std::string& source,
                  const std::string& tgt,
                  int targetType,
                  bool preserve)
     {
 #ifdef DEBUG
-        std::cerr << "actions.cpp::metacopy" << " source = " << source << " target = " << tgt << std::endl;
+        Action::taskErr() << "actions.cpp::metacopy" << " source = " << source << " target = " << tgt << std::endl;
 #endif
 
         // read the source metadata
         int  rc    = -1   ;
         if (!Exiv2::fileExists(source, true)) {
-            std::cerr << source
+            Action::taskErr() << source
                       << ": " << _("Failed to open the file\n");
             return rc;
         }
@@ -2103,11 +2338,14 @@ namespace {
         // Apply any modification commands to the source image on-the-fly
         Action::Modify::applyCommands(sourceImage.get());
 
-        // Open or create the target file
-        std::string target(bStdout ? temporaryPath() : tgt);
+        // Open or create the target file, a target on stdout is built in memory
+        std::string target(tgt);
 
         Exiv2::Image::UniquePtr targetImage;
-        if (Exiv2::fileExists(target)) {
+        if (bStdout) {
+            targetImage = Exiv2::ImageFactory::create(targetType);
+            assert(targetImage.get() != 0);
+        } else if (Exiv2::fileExists(target)) {
             targetImage = Exiv2::ImageFactory::open(target);
             assert(targetImage.get() != 0);
             targetImage->readMetadata();
@@ -2120,7 +2358,7 @@ namespace {
         if (   Params::instance().target_ & Params::ctExif
             && !sourceImage->exifData().empty()) {
             if (Params::instance().verbose_) {
-                std::cout << _("Writing Exif data from") << " " << source
+                Action::taskOut() << _("Writing Exif data from") << " " << source
                           << " " << _("to") << " " << target << std::endl;
             }
             if ( preserve ) {
@@ -2135,7 +2373,7 @@ namespace {
         if (   Params::instance().target_ & Params::ctIptc
             && !sourceImage->iptcData().empty()) {
             if (Params::instance().verbose_) {
-                std::cout << _("Writing IPTC data from") << " " << source
+                Action::taskOut() << _("Writing IPTC data from") << " " << source
                           << " " << _("to") << " " << target << std::endl;
             }
             if ( preserve ) {
@@ -2150,7 +2388,7 @@ namespace {
         if (    Params::instance().target_ & (Params::ctXmp|Params::ctXmpRaw)
             && !sourceImage->xmpData().empty()) {
             if (Params::instance().verbose_) {
-                std::cout << _("Writing XMP data from") << " " << source
+                Action::taskOut() << _("Writing XMP data from") << " " << source
                           << " " << _("to") << " " << target << std::endl;
             }
 
@@ -2160,12 +2398,17 @@ namespace {
             if( Params::instance().modifyCmds_.size() == 0
             && (Params::instance().target_ & tRawSidecar) == tRawSidecar
             ){
-                // std::cout << "short cut" << std::endl;
+                // Action::taskOut() << "short cut" << std::endl;
                 // http://www.cplusplus.com/doc/tutorial/files/
-                std::ofstream os;
-                os.open(target.c_str());
-                sourceImage->printStructure(os,Exiv2::kpsXMP);
-                os.close();
+                if ( bStdout ) {
+                    _setmode(_fileno(stdout),O_BINARY);
+                    sourceImage->printStructure(Action::taskOut(),Exiv2::kpsXMP);
+                } else {
+                    std::ofstream os;
+                    os.open(target.c_str());
+                    sourceImage->printStructure(os,Exiv2::kpsXMP);
+                    os.close();
+                }
                 rc = 0;
             } else if ( preserve ) {
                 Exiv2::XmpData::const_iterator end = sourceImage->xmpData().end();
@@ -2173,47 +2416,36 @@ namespace {
                     targetImage->xmpData()[i->key()] = i->value();
                 }
             } else {
-                // std::cout << "long cut" << std::endl;
+                // Action::taskOut() << "long cut" << std::endl;
                 targetImage->setXmpData(sourceImage->xmpData());
             }
         }
         if (   Params::instance().target_ & Params::ctComment
             && !sourceImage->comment().empty()) {
             if (Params::instance().verbose_) {
-                std::cout << _("Writing JPEG comment from") << " " << source
+                Action::taskOut() << _("Writing JPEG comment from") << " " << source
                           << " " << _("to") << " " << tgt << std::endl;
             }
             targetImage->setComment(sourceImage->comment());
         }
         if ( rc < 0 ) try {
-            targetImage->writeMetadata();
+            if ( bStdout ) {
+                // stream the new image straight to stdout, no temporary file
+                Exiv2::MemIo out;
+                targetImage->writeMetadataTo(out);
+                _setmode(_fileno(stdout),O_BINARY);
+                Action::taskOut().write(reinterpret_cast<const char*>(out.mmap()), out.size());
+            } else {
+                targetImage->writeMetadata();
+            }
             rc=0;
         }
         catch (const Exiv2::AnyError& e) {
-            std::cerr << tgt <<
+            Action::taskErr() << tgt <<
                 ": " << _("Could not write metadata to file") << ": " << e << "\n";
             rc=1;
         }
 
-        // if we used a temporary target, copy it to stdout
-        if ( rc == 0 && bStdout ) {
-            FILE* f = ::fopen(target.c_str(),"rb") ;
-            _setmode(_fileno(stdout),O_BINARY);
-
-            if (  f ) {
-                char buffer[8*1024];
-                size_t n = 1 ;
-                while ( !feof(f) && n > 0) {
-                    n=fread(buffer,1,sizeof buffer,f);
-                    fwrite(buffer,1,n,stdout);
-                }
-                fclose(f);
-            }
-        }
-
-        // delete temporary target
-        if ( bStdout ) std::remove(target.c_str());
-
         return rc;
     } // metacopy
 
@@ -2237,7 +2469,7 @@ namespace {
         char basename[max];
         std::memset(basename, 0x0, max);
         if (strftime(basename, max, format.c_str(), tm) == 0) {
-            std::cerr << _("Filename format yields empty filename for the file") << " "
+            Action::taskErr() << _("Filename format yields empty filename for the file") << " "
                       << path << "\n";
             return 1;
         }
@@ -2246,7 +2478,7 @@ namespace {
         if (   Util::dirname(newPath)  == Util::dirname(path)
             && Util::basename(newPath) == Util::basename(path)) {
             if (Params::instance().verbose_) {
-                std::cout << _("This file already has the correct name") << std::endl;
+                Action::taskOut() << _("This file already has the correct name") << std::endl;
             }
             return -1;
         }
@@ -2269,7 +2501,7 @@ namespace {
                         + Util::suffix(path);
                     break;
                 case Params::askPolicy:
-                    std::cout << Params::instance().progname()
+                    Action::taskOut() << Params::instance().progname()
                               << ": " << _("File") << " `" << newPath
                               << "' " << _("exists. [O]verwrite, [r]ename or [s]kip?")
                               << " ";
@@ -2299,17 +2531,17 @@ namespace {
         }
 
         if (Params::instance().verbose_) {
-            std::cout << _("Renaming file to") << " " << newPath;
+            Action::taskOut() << _("Renaming file to") << " " << newPath;
             if (Params::instance().timestamp_) {
-                std::cout << ", " << _("updating timestamp");
+                Action::taskOut() << ", " << _("updating timestamp");
             }
-            std::cout << std::endl;
+            Action::taskOut() << std::endl;
         }
 
         // Workaround for MinGW rename which does not overwrite existing files
         remove(newPath.c_str());
         if (std::rename(path.c_str(), newPath.c_str()) == -1) {
-            std::cerr << Params::instance().progname()
+            Action::taskErr() << Params::instance().progname()
                       << ": " << _("Failed to rename") << " "
                       << path << " " << _("to") << " " << newPath << ": "
                       << Exiv2::strError() << "\n";
@@ -2335,7 +2567,7 @@ namespace {
         if ( path == "-" ) return 0;
 
         if (!Params::instance().force_ && Exiv2::fileExists(path)) {
-            std::cout << Params::instance().progname()
+            Action::taskOut() << Params::instance().progname()
                       << ": " << _("Overwrite") << " `" << path << "'? ";
             std::string s;
             std::cin >> s;
@@ -2359,7 +2591,7 @@ namespace {
     int printStructure(std::ostream& out, Exiv2::PrintStructureOption option, const std::string &path)
     {
         if (!Exiv2::fileExists(path, true)) {
-            std::cerr << path << ": "
+            Action::taskErr() << path << ": "
                       << _("Failed to open the file\n");
             return -1;
         }
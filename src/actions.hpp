@@ -49,9 +49,12 @@ namespace Exiv2 {
  */
 namespace Action {
 
-    //! Enumerates all tasks
+    /*!
+      @brief Enumerates all tasks. The index and query actions work on all
+             files at once and have no task class.
+     */
     enum TaskType { none, adjust, print, rename, erase, extract, insert,
-                    modify, fixiso, fixcom };
+                    modify, fixiso, fixcom, index, query };
 
 // *****************************************************************************
 // class definitions
@@ -149,6 +152,39 @@ namespace Action {
 
     }; // class TaskFactory
 
+    /*!
+      @brief Return the stream for the output of tasks run in the current
+             thread. This is std::cout unless it is redirected with a
+             TaskOutput object.
+     */
+    std::ostream& taskOut();
+    /*!
+      @brief Return the stream for the error messages of tasks run in the
+             current thread. This is std::cerr unless it is redirected with a
+             TaskOutput object.
+     */
+    std::ostream& taskErr();
+
+    /*!
+      @brief Redirects the output and error messages of tasks run in the
+             current thread for the lifetime of the object.
+     */
+    class TaskOutput {
+    public:
+        //! Redirect the output to \em out and the error messages to \em err.
+        TaskOutput(std::ostream& out, std::ostream& err);
+        //! Restore the previous streams.
+        ~TaskOutput();
+
+        TaskOutput& operator=(const TaskOutput& rhs) = delete;
+        TaskOutput(const TaskOutput& rhs) = delete;
+
+    private:
+        std::ostream* out_;             //!< Previous output stream
+        std::ostream* err_;             //!< Previous error stream
+
+    }; // class TaskOutput
+
     //! %Print the Exif (or other metadata) of a file to stdout
     class Print : public Task {
     public:
@@ -173,6 +209,8 @@ namespace Action {
         int printMetadata(const Exiv2::Image* image);
         //! Print a metadatum in a user defined format, return true if something was printed
         bool printMetadatum(const Exiv2::Metadatum& md, const Exiv2::Image* image);
+        //! Print the requested items of a metadatum as a JSON object on one line
+        void printJsonMetadatum(const Exiv2::Metadatum& md, const Exiv2::Image* image);
         //! Print the label for a summary line
         void printLabel(const std::string& label) const;
         /*!
@@ -297,16 +335,18 @@ namespace Action {
          */
         int writeThumbnail() const;
         /*!
-          @brief Write preview images to files.
+          @brief Write preview images to files. The preview images are read
+                 and written concurrently.
          */
         int writePreviews() const;
         /*!
-          @brief Write one preview image to a file. The filename is composed by
-                 removing the suffix from the image filename and appending
-                 "-preview<num>" and the appropriate suffix (".jpg" or ".tif"),
-                 depending on the format of the Exif thumbnail image.
+          @brief Return the path of the file for one preview image, without
+                 extension, or an empty string if the file should not be
+                 written. The filename is composed by removing the suffix
+                 from the image filename and appending "-preview<num>".
+                 Report the file in verbose mode.
          */
-        void writePreviewFile(const Exiv2::PreviewImage& pvImg, int num) const;
+        std::string previewFile(const Exiv2::PreviewImage& pvImg, int num) const;
         /*!
           @brief Write embedded iccProfile files.
          */
@@ -377,6 +417,16 @@ namespace Action {
         //! Copy constructor needed because of UniquePtr member
         Modify(const Modify& /*src*/) : Task() {}
 
+        /*!
+          @brief Modify the image read from standard input and write it to
+                 standard output. The image data of a JPEG image is copied
+                 through as it is read, only its segments are buffered.
+         */
+        int runOnStdin();
+
+        //! Apply \em modifyCmds to the \em pImage, return 0 if successful.
+        static int applyCommands(Exiv2::Image* pImage, const ModifyCmds& modifyCmds);
+
         //! Add a metadatum to \em pImage according to \em modifyCmd
         static int addMetadatum(Exiv2::Image* pImage,
                                 const ModifyCmd& modifyCmd);
@@ -30,6 +30,8 @@
 #include "error.hpp"
 #include "http.hpp"
 #include "properties.hpp"
+#include "stats_int.hpp"
+#include "trace.hpp"
 
 // + standard includes
 #include <string>
@@ -37,13 +39,24 @@
 #include <iostream>
 #include <cstring>                      // std::memcpy
 #include <cassert>
+#include <cctype>                       // for tolower
+#include <cerrno>                       // for errno
 #include <fstream>                      // write the temporary file
 #include <fcntl.h>                      // _O_BINARY in FileIo::FileIo
 #include <cstdio>                       // for remove, rename
 #include <cstdlib>                      // for alloc, realloc, free
 #include <ctime>                        // timestamp for the name of temporary file
+#include <iomanip>                      // for the block cache file names
 #include <sys/types.h>                  // for stat, chmod
 #include <sys/stat.h>                   // for stat, chmod
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <mutex>
 
 #ifdef EXV_HAVE_SYS_MMAN_H
 # include <sys/mman.h>                  // for mmap and munmap
@@ -64,7 +77,7 @@
 #endif
 
 // Platform specific headers for handling extended attributes (xattr)
-#if defined(__APPLE__)
+#if defined(__APPLE__) || defined(__linux__)
 # include <sys/xattr.h>
 #endif
 
@@ -79,10 +92,140 @@ typedef short nlink_t;
 // class member definitions
 namespace Exiv2 {
 
+    namespace {
+        //! Count a read of \em rcount bytes in \em stats, return \em rcount
+        long countRead(IoStats& stats, long rcount)
+        {
+            ++stats.reads_;
+            if (rcount > 0) stats.bytesRead_ += rcount;
+            return rcount;
+        }
+
+        //! Count a write of \em wcount bytes in \em stats, return \em wcount
+        long countWrite(IoStats& stats, long wcount)
+        {
+            ++stats.writes_;
+            if (wcount > 0) stats.bytesWritten_ += wcount;
+            return wcount;
+        }
+
+        //! Move the write counters of \em src, whose data are transferred, to \em stats
+        void takeWrites(IoStats& stats, BasicIo& src)
+        {
+            stats.writes_ += src.stats().writes_;
+            stats.bytesWritten_ += src.stats().bytesWritten_;
+            src.stats().writes_ = 0;
+            src.stats().bytesWritten_ = 0;
+        }
+    }
+
+    IoStats::IoStats()
+        : reads_(0), bytesRead_(0), writes_(0), bytesWritten_(0), seeks_(0), mmaps_(0),
+          remoteRequests_(0), allocations_(0), bytesAllocated_(0),
+          tiffDecodeTime_(0), xmpDecodeTime_(0), writeMetadataTime_(0)
+    {
+    }
+
+    IoStats& IoStats::operator+=(const IoStats& rhs)
+    {
+        reads_             += rhs.reads_;
+        bytesRead_         += rhs.bytesRead_;
+        writes_            += rhs.writes_;
+        bytesWritten_      += rhs.bytesWritten_;
+        seeks_             += rhs.seeks_;
+        mmaps_             += rhs.mmaps_;
+        remoteRequests_    += rhs.remoteRequests_;
+        allocations_       += rhs.allocations_;
+        bytesAllocated_    += rhs.bytesAllocated_;
+        tiffDecodeTime_    += rhs.tiffDecodeTime_;
+        xmpDecodeTime_     += rhs.xmpDecodeTime_;
+        writeMetadataTime_ += rhs.writeMetadataTime_;
+        metadataMemory_    += rhs.metadataMemory_;
+        return *this;
+    }
+
+    ParseLimits::ParseLimits()
+        : maxIfdEntries_(0), maxDepth_(0), maxAllocation_(0), maxInflatedSize_(0), timeoutMs_(0)
+    {
+    }
+
+    bool ParseLimits::limited() const
+    {
+        return maxIfdEntries_ || maxDepth_ || maxAllocation_ || maxInflatedSize_ || timeoutMs_;
+    }
+
     BasicIo::~BasicIo()
+    {
+        IoStats* collected = Internal::collectedStats();
+        if (collected) *collected += stats_;
+    }
+
+    const byte* BasicIo::readView(DataBuf& buf, long rcount)
+    {
+        if (rcount < 0) return 0;
+        // Allocate at least one byte to return a valid pointer for empty reads
+        buf.alloc(EXV_MAX(rcount, 1));
+        if (read(buf.pData_, rcount) != rcount) return 0;
+        return buf.pData_;
+    }
+
+    long BasicIo::readAt(long offset, byte* buf, long rcount)
+    {
+        if (offset < 0 || rcount < 0) return 0;
+        const long restore = tell();
+        if (restore < 0 || seek(offset, BasicIo::beg) != 0) return 0;
+        const long rc = read(buf, rcount);
+        seek(restore, BasicIo::beg);
+        return rc;
+    }
+
+    long BasicIo::writev(const std::pair<const byte*, long>* pieces, size_t count)
+    {
+        long total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const long wcount = write(pieces[i].first, pieces[i].second);
+            total += wcount;
+            if (wcount != pieces[i].second) break;
+        }
+        return total;
+    }
+
+    void BasicIo::prefetch(const std::vector<std::pair<long, long> >& /*ranges*/)
     {
     }
 
+    void BasicIo::advise(AccessPattern /*pattern*/)
+    {
+    }
+
+    bool BasicIo::prefetches() const
+    {
+        return false;
+    }
+
+    IoCloser::IoCloser(BasicIo& bio)
+        : bio_(bio), previous_(Internal::setCurrentStats(&bio.stats()))
+    {
+        if (bio.parseLimits().limited()) budget_.reset(new Internal::ParseBudget(bio.parseLimits()));
+    }
+
+    IoCloser::~IoCloser()
+    {
+        close();
+        budget_.reset();
+        Internal::setCurrentStats(previous_);
+    }
+
+    IoStatsCollector::IoStatsCollector(IoStats& stats)
+        : previous_(Internal::setCollectedStats(&stats))
+    {
+    }
+
+    IoStatsCollector::~IoStatsCollector()
+    {
+        Internal::setCollectedStats(previous_);
+    }
+
     //! Internal Pimpl structure of class FileIo.
     class FileIo::Impl {
     public:
@@ -117,6 +260,8 @@ namespace Exiv2 {
         size_t mappedLength_;           //!< Size of the memory-mapped area
         bool   isMalloced_;             //!< Is the mapped area allocated?
         bool   isWriteable_;            //!< Can the mapped area be written to?
+        bool   atomicTransfer_;         //!< Does transfer() rename a new file over the file?
+        bool   readAhead_;              //!< Does prefetch() ask the kernel to read ahead?
         // TYPES
         //! Simple struct stat wrapper for internal use
         struct StructStat {
@@ -138,6 +283,14 @@ namespace Exiv2 {
         int stat(StructStat& buf) const;
         //! copy extended attributes (xattr) from another file
         void copyXattrFrom(const FileIo& src);
+        /*!
+          @brief Write the data of \em src to a new file next to the file
+              \em self, with the owner and the extended attributes of \em self.
+          @return The new file, 0 if \em self cannot be replaced by renaming
+              a new file over it.
+          @throw Error if the data cannot be written, the new file is removed.
+         */
+        std::unique_ptr<FileIo> writeReplacement(const FileIo& self, BasicIo& src);
 #if defined WIN32 && !defined __CYGWIN__
         // Windows function to determine the number of hardlinks (on NTFS)
         DWORD winNumberOfLinks() const;
@@ -158,7 +311,8 @@ namespace Exiv2 {
 #if defined WIN32 && !defined __CYGWIN__
         hFile_(0), hMap_(0),
 #endif
-        pMappedArea_(0), mappedLength_(0), isMalloced_(false), isWriteable_(false)
+        pMappedArea_(0), mappedLength_(0), isMalloced_(false), isWriteable_(false),
+          atomicTransfer_(false), readAhead_(false)
     {
     }
 
@@ -170,7 +324,8 @@ namespace Exiv2 {
 #if defined WIN32 && !defined __CYGWIN__
           hFile_(0), hMap_(0),
 #endif
-          pMappedArea_(0), mappedLength_(0), isMalloced_(false), isWriteable_(false)
+          pMappedArea_(0), mappedLength_(0), isMalloced_(false), isWriteable_(false),
+          atomicTransfer_(false), readAhead_(false)
     {
     }
 
@@ -271,7 +426,7 @@ namespace Exiv2 {
         return ret;
     } // FileIo::Impl::stat
 
-#if defined(__APPLE__)
+#if defined(__APPLE__) || defined(__linux__)
     void FileIo::Impl::copyXattrFrom(const FileIo& src)
 #else
     void FileIo::Impl::copyXattrFrom(const FileIo&)
@@ -316,11 +471,70 @@ namespace Exiv2 {
 #endif
         }
         delete [] namebuf;
+#elif defined(__linux__)
+        // Attributes which cannot be read or set, e.g., for lack of privileges, are skipped
+        const ssize_t namebufSize = ::listxattr(src.p_->path_.c_str(), 0, 0);
+        if (namebufSize <= 0) return;
+        std::vector<char> namebuf(namebufSize);
+        if (::listxattr(src.p_->path_.c_str(), &namebuf[0], namebuf.size()) != namebufSize) return;
+        std::vector<char> value;
+        for (ssize_t namebufPos = 0; namebufPos < namebufSize;) {
+            const char *name = &namebuf[namebufPos];
+            namebufPos += strlen(name) + 1;
+            const ssize_t valueSize = ::getxattr(src.p_->path_.c_str(), name, 0, 0);
+            if (valueSize < 0) continue;
+            value.resize(valueSize + 1);
+            if (::getxattr(src.p_->path_.c_str(), name, &value[0], valueSize) != valueSize) continue;
+            if (::setxattr(path_.c_str(), name, &value[0], valueSize, 0) != 0) {
+#ifdef  DEBUG
+                EXV_DEBUG << "Failed to copy xattr \"" << name << "\"\n";
+#endif
+            }
+        }
 #else
         // No xattr support for this platform.
 #endif
     } // FileIo::Impl::copyXattrFrom
 
+    std::unique_ptr<FileIo> FileIo::Impl::writeReplacement(const FileIo& self, BasicIo& src)
+    {
+        std::unique_ptr<FileIo> replacement;
+#ifdef EXV_UNICODE_PATH
+        if (wpMode_ == wpUnicode) return replacement;
+#endif
+        bool exists = true;
+#if !defined(_WIN32)
+        // Renaming would replace a symbolic link and detach the file from its other names
+        struct stat buf;
+        exists = ::lstat(path_.c_str(), &buf) == 0;
+        if (exists && (S_ISLNK(buf.st_mode) || buf.st_nlink > 1)) return replacement;
+#endif
+        const std::string tempPath = createTempFile(path_);
+        if (tempPath.empty()) return replacement;
+        replacement.reset(new FileIo(tempPath));
+        if (replacement->open("w+b") != 0) {
+            ::remove(tempPath.c_str());
+            replacement.reset();
+            return replacement;
+        }
+        const bool srcOk = src.open() == 0;
+        const long count = srcOk ? replacement->write(src) : 0;
+        const bool ok = srcOk && count == static_cast<long>(src.size()) && !src.error() && !replacement->error();
+        if (srcOk) src.close();
+        if (replacement->close() != 0 || !ok) {
+            ::remove(replacement->path().c_str());
+            if (!srcOk) throw Error(kerDataSourceOpenFailed, src.path(), strError());
+            throw Error(kerTransferFailed, self.path(), strError());
+        }
+#if !defined(_WIN32)
+        if (exists && ::chown(replacement->path().c_str(), buf.st_uid, buf.st_gid) != 0) {
+            // Only privileged processes may give a file to another user
+        }
+#endif
+        if (exists) replacement->p_->copyXattrFrom(self);
+        return replacement;
+    } // FileIo::Impl::writeReplacement
+
 #if defined WIN32 && !defined __CYGWIN__
     DWORD FileIo::Impl::winNumberOfLinks() const
     {
@@ -412,6 +626,7 @@ namespace Exiv2 {
     byte* FileIo::mmap(bool isWriteable)
     {
         assert(p_->fp_ != 0);
+        ++stats_.mmaps_;
         if (munmap() != 0) {
 #ifdef EXV_UNICODE_PATH
             if (p_->wpMode_ == Impl::wpUnicode) {
@@ -576,11 +791,48 @@ namespace Exiv2 {
     }
 #endif
 
+    void FileIo::setAtomicTransfer(bool flag)
+    {
+        p_->atomicTransfer_ = flag;
+    }
+
+    void FileIo::setReadAhead(bool flag)
+    {
+        p_->readAhead_ = flag;
+    }
+
+    bool FileIo::atomicTransfer() const
+    {
+        return p_->atomicTransfer_;
+    }
+
+    bool FileIo::prefetches() const
+    {
+#if defined(POSIX_FADV_WILLNEED)
+        return p_->readAhead_;
+#else
+        return false;
+#endif
+    }
+
     long FileIo::write(const byte* data, long wcount)
     {
         assert(p_->fp_ != 0);
         if (p_->switchMode(Impl::opWrite) != 0) return 0;
-        return (long)std::fwrite(data, 1, wcount, p_->fp_);
+        return countWrite(stats_, (long)std::fwrite(data, 1, wcount, p_->fp_));
+    }
+
+    long FileIo::writev(const std::pair<const byte*, long>* pieces, size_t count)
+    {
+        assert(p_->fp_ != 0);
+        if (p_->switchMode(Impl::opWrite) != 0) return 0;
+        long total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const long wcount = (long)std::fwrite(pieces[i].first, 1, pieces[i].second, p_->fp_);
+            total += wcount;
+            if (wcount != pieces[i].second) break;
+        }
+        return countWrite(stats_, total);
     }
 
     long FileIo::write(BasicIo& src)
@@ -590,11 +842,51 @@ namespace Exiv2 {
         if (!src.isopen()) return 0;
         if (p_->switchMode(Impl::opWrite) != 0) return 0;
 
-        byte buf[4096];
-        long readCount = 0;
         long writeTotal = 0;
-        while ((readCount = src.read(buf, sizeof(buf)))) {
-            const long writeCount = static_cast<long>(std::fwrite(buf, 1, static_cast<size_t>(readCount), p_->fp_));
+#if defined EXV_HAVE_COPY_FILE_RANGE
+        // Let the kernel copy the data between two files
+        FileIo* fileIo = dynamic_cast<FileIo*>(&src);
+        if (fileIo && fileIo->p_->switchMode(Impl::opRead) == 0 && std::fflush(p_->fp_) == 0) {
+            const long start = src.tell();
+            const long end = static_cast<long>(src.size());
+            loff_t offIn = start;
+            loff_t offOut = std::ftell(p_->fp_);
+            if (start >= 0 && offOut >= 0) {
+                while (offIn < end) {
+                    const ssize_t rc = ::copy_file_range(fileno(fileIo->p_->fp_), &offIn,
+                                                         fileno(p_->fp_), &offOut,
+                                                         static_cast<size_t>(end - offIn), 0);
+                    if (rc < 0 && errno == EINTR) continue;
+                    if (rc <= 0) break;
+                }
+                // The file positions are not changed by copy_file_range
+                src.seek(static_cast<long>(offIn), BasicIo::beg);
+                std::fseek(p_->fp_, static_cast<long>(offOut), SEEK_SET);
+                writeTotal = static_cast<long>(offIn) - start;
+                // Copy what is left, e.g., if the files are on different file systems
+                if (offIn >= end || p_->switchMode(Impl::opWrite) != 0) return countWrite(stats_, writeTotal);
+            }
+        }
+#endif
+        // Write directly from the memory of the source if possible
+        MemIo* memIo = dynamic_cast<MemIo*>(&src);
+        const long remaining = memIo ? static_cast<long>(memIo->size()) - memIo->tell() : 0;
+        DataBuf buf;
+        const byte* data = remaining > 0 ? memIo->readView(buf, remaining) : 0;
+        if (data) {
+            const long writeCount = static_cast<long>(std::fwrite(data, 1, static_cast<size_t>(remaining), p_->fp_));
+            if (writeCount != remaining) {
+                // try to reset back to where write stopped
+                src.seek(writeCount-remaining, BasicIo::cur);
+            }
+            return countWrite(stats_, writeTotal + writeCount);
+        }
+
+        buf.alloc(64*1024);
+        long readCount = 0;
+        src.advise(sequentialAccess);
+        while ((readCount = src.read(buf.pData_, buf.size_))) {
+            const long writeCount = static_cast<long>(std::fwrite(buf.pData_, 1, static_cast<size_t>(readCount), p_->fp_));
             writeTotal += writeCount;
             if (writeCount != readCount) {
                 // try to reset back to where write stopped
@@ -603,11 +895,20 @@ namespace Exiv2 {
             }
         }
 
-        return writeTotal;
+        return countWrite(stats_, writeTotal);
     }
 
     void FileIo::transfer(BasicIo& src)
     {
+        Trace trace("io", "transfer");
+        takeWrites(stats_, src);
+        if (p_->atomicTransfer_ && dynamic_cast<FileIo*>(&src) == 0) {
+            std::unique_ptr<FileIo> replacement = p_->writeReplacement(*this, src);
+            if (replacement.get() != 0) {
+                transfer(*replacement);
+                return;
+            }
+        }
         const bool wasOpen = (p_->fp_ != 0);
         const std::string lastMode(p_->openMode_);
 
@@ -798,9 +1099,12 @@ namespace Exiv2 {
                     }
                 }
 #else
+#if defined(_WIN32)
+                // ::rename replaces an existing file in one step only on POSIX systems
                 if (fileExists(pf) && ::remove(pf) != 0) {
                     throw Error(kerCallFailed, pf, strError(), "::remove");
                 }
+#endif
                 if (::rename(fileIo->path().c_str(), pf) == -1) {
                     throw Error(kerFileRenameFailed, fileIo->path(), pf, strError());
                 }
@@ -884,6 +1188,7 @@ namespace Exiv2 {
     {
         assert(p_->fp_ != 0);
         if (p_->switchMode(Impl::opWrite) != 0) return EOF;
+        countWrite(stats_, 1);
         return putc(data, p_->fp_);
     }
 
@@ -891,6 +1196,7 @@ namespace Exiv2 {
     int FileIo::seek( int64_t offset, Position pos )
     {
         assert(p_->fp_ != 0);
+        ++stats_.seeks_;
 
         int fileSeek = 0;
         switch (pos) {
@@ -910,6 +1216,7 @@ namespace Exiv2 {
     int FileIo::seek(long offset, Position pos)
     {
         assert(p_->fp_ != 0);
+        ++stats_.seeks_;
 
         int fileSeek = 0;
         switch (pos) {
@@ -973,6 +1280,35 @@ namespace Exiv2 {
         return 0;
     }
 
+    void FileIo::prefetch(const std::vector<std::pair<long, long> >& ranges)
+    {
+#if defined(POSIX_FADV_WILLNEED)
+        if (!p_->readAhead_ || p_->fp_ == 0) return;
+        const int fd = fileno(p_->fp_);
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            if (ranges[i].first < 0 || ranges[i].second <= 0) continue;
+            // only a hint, failures are ignored
+            ::posix_fadvise(fd, ranges[i].first, ranges[i].second, POSIX_FADV_WILLNEED);
+        }
+#else
+        (void)ranges;
+#endif
+    }
+
+    void FileIo::advise(AccessPattern pattern)
+    {
+#if defined(POSIX_FADV_WILLNEED)
+        if (!p_->readAhead_ || p_->fp_ == 0) return;
+        const int advice =   pattern == randomAccess     ? POSIX_FADV_RANDOM
+                           : pattern == sequentialAccess ? POSIX_FADV_SEQUENTIAL
+                           : POSIX_FADV_NORMAL;
+        // only a hint, failures are ignored
+        ::posix_fadvise(fileno(p_->fp_), 0, 0, advice);
+#else
+        (void)pattern;
+#endif
+    }
+
     bool FileIo::isopen() const
     {
         return p_->fp_ != 0;
@@ -1005,14 +1341,69 @@ namespace Exiv2 {
         if (p_->switchMode(Impl::opRead) != 0) {
             return 0;
         }
-        return (long)std::fread(buf, 1, rcount, p_->fp_);
+        return countRead(stats_, (long)std::fread(buf, 1, rcount, p_->fp_));
+    }
+
+    const byte* FileIo::readView(DataBuf& buf, long rcount)
+    {
+        assert(p_->fp_ != 0);
+#if defined EXV_HAVE_MMAP && defined EXV_HAVE_MUNMAP
+        if (p_->pMappedArea_ == 0 && p_->openMode_ == "rb" && size() > 0) {
+            try {
+                mmap();
+            }
+            catch (const AnyError&) {
+                // Fall back to buffered reads
+            }
+        }
+        if (p_->pMappedArea_ != 0 && rcount >= 0) {
+            const long pos = tell();
+            if (   pos >= 0 && static_cast<size_t>(pos) <= p_->mappedLength_
+                && static_cast<size_t>(rcount) <= p_->mappedLength_ - pos
+                && seek(rcount, BasicIo::cur) == 0) {
+                countRead(stats_, rcount);
+                return p_->pMappedArea_ + pos;
+            }
+        }
+#endif
+        return BasicIo::readView(buf, rcount);
+    }
+
+    long FileIo::readAt(long offset, byte* buf, long rcount)
+    {
+        assert(p_->fp_ != 0);
+        if (offset < 0 || rcount < 0) return 0;
+        if (p_->switchMode(Impl::opRead) != 0) {
+            return 0;
+        }
+        if (   p_->pMappedArea_ != 0
+            && static_cast<size_t>(offset) <= p_->mappedLength_
+            && static_cast<size_t>(rcount) <= p_->mappedLength_ - offset) {
+            std::memcpy(buf, p_->pMappedArea_ + offset, rcount);
+            return countRead(stats_, rcount);
+        }
+#if defined EXV_HAVE_PREAD
+        // Data written through the stream has been flushed by switchMode()
+        long total = 0;
+        while (total < rcount) {
+            const ssize_t rc = ::pread(fileno(p_->fp_), buf + total, rcount - total, offset + total);
+            if (rc < 0 && errno == EINTR) continue;
+            if (rc <= 0) break;
+            total += static_cast<long>(rc);
+        }
+        return countRead(stats_, total);
+#else
+        return BasicIo::readAt(offset, buf, rcount);
+#endif
     }
 
     int FileIo::getb()
     {
         assert(p_->fp_ != 0);
         if (p_->switchMode(Impl::opRead) != 0) return EOF;
-        return getc(p_->fp_);
+        const int c = getc(p_->fp_);
+        countRead(stats_, c != EOF ? 1 : 0);
+        return c;
     }
 
     int FileIo::error() const
@@ -1067,6 +1458,7 @@ namespace Exiv2 {
 
         // METHODS
         void reserve(long wcount);         //!< Reserve memory
+        void allocate(long capacity);      //!< Allocate a buffer of at least \em capacity bytes
 
         Impl& operator=(const Impl& rhs) = delete;
         Impl& operator=(const Impl&& rhs) = delete;
@@ -1171,39 +1563,36 @@ namespace Exiv2 {
     void MemIo::Impl::reserve(long wcount)
     {
         const long need = wcount + idx_;
-        long    blockSize =     32*1024;   // 32768           `
-        const long maxBlockSize = 4*1024*1024;
+        if (!isMalloced_ || need > sizeAlloced_) {
+            // Grow by at least half the allocated size, so that the number of
+            // copies stays logarithmic in the final size and at most a third
+            // of the buffer is unused
+            allocate(EXV_MAX(need, sizeAlloced_ + sizeAlloced_ / 2));
+        }
+        if (need > size_) size_ = need;
+    }
 
-        if (!isMalloced_) {
-            // Minimum size for 1st block
-            long size  = EXV_MAX(blockSize * (1 + need / blockSize), size_);
-            byte* data = (byte*)std::malloc(size);
-            if (  data == nullptr ) {
-                throw Error(kerMallocFailed);
-            }
-            if (data_ != nullptr) {
+    void MemIo::Impl::allocate(long capacity)
+    {
+        const long blockSize = 32*1024;
+        // Allocate in blocks, the buffer must hold the current data
+        capacity = EXV_MAX(blockSize * (1 + (capacity - 1) / blockSize), size_);
+        byte* data = 0;
+        if (isMalloced_) {
+            data = static_cast<byte*>(std::realloc(data_, capacity));
+        }
+        else {
+            data = static_cast<byte*>(std::malloc(capacity));
+            if (data != nullptr && data_ != nullptr) {
                 std::memcpy(data, data_, size_);
             }
-            data_ = data;
-            sizeAlloced_ = size;
-            isMalloced_ = true;
         }
-
-        if (need > size_) {
-            if (need > sizeAlloced_) {
-                blockSize = 2*sizeAlloced_ ;
-                if ( blockSize > maxBlockSize ) blockSize = maxBlockSize ;
-                // Allocate in blocks
-                long want      = blockSize * (1 + need / blockSize );
-                data_ = (byte*)std::realloc(data_, want);
-                if ( data_ == nullptr ) {
-                    throw Error(kerMallocFailed);
-                }
-                sizeAlloced_ = want;
-                isMalloced_ = true;
-            }
-            size_ = need;
+        if (data == nullptr) {
+            throw Error(kerMallocFailed);
         }
+        data_ = data;
+        sizeAlloced_ = capacity;
+        isMalloced_ = true;
     }
 
     MemIo::MemIo()
@@ -1231,11 +1620,27 @@ namespace Exiv2 {
             std::memcpy(&p_->data_[p_->idx_], data, wcount);
         }
         p_->idx_ += wcount;
-        return wcount;
+        return countWrite(stats_, wcount);
+    }
+
+    long MemIo::writev(const std::pair<const byte*, long>* pieces, size_t count)
+    {
+        long total = 0;
+        for (size_t i = 0; i < count; ++i) total += pieces[i].second;
+        p_->reserve(total);
+        assert(p_->isMalloced_);
+        for (size_t i = 0; i < count; ++i) {
+            if (pieces[i].first != nullptr) {
+                std::memcpy(&p_->data_[p_->idx_], pieces[i].first, pieces[i].second);
+            }
+            p_->idx_ += pieces[i].second;
+        }
+        return countWrite(stats_, total);
     }
 
     void MemIo::transfer(BasicIo& src)
     {
+        takeWrites(stats_, src);
         MemIo *memIo = dynamic_cast<MemIo*>(&src);
         if (memIo) {
             // Optimization if src is another instance of MemIo
@@ -1245,10 +1650,12 @@ namespace Exiv2 {
             p_->idx_ = 0;
             p_->data_ = memIo->p_->data_;
             p_->size_ = memIo->p_->size_;
+            p_->sizeAlloced_ = memIo->p_->sizeAlloced_;
             p_->isMalloced_ = memIo->p_->isMalloced_;
             memIo->p_->idx_ = 0;
             memIo->p_->data_ = 0;
             memIo->p_->size_ = 0;
+            memIo->p_->sizeAlloced_ = 0;
             memIo->p_->isMalloced_ = false;
         }
         else {
@@ -1268,6 +1675,19 @@ namespace Exiv2 {
         if (static_cast<BasicIo*>(this) == &src) return 0;
         if (!src.isopen()) return 0;
 
+        // Read the rest of the source directly into the memory block
+        src.advise(sequentialAccess);
+        const long start = src.tell();
+        const long end = static_cast<long>(src.size());
+        if (start >= 0 && end > start) {
+            const long size = p_->size_;
+            p_->reserve(end - start);
+            const long readCount = src.read(&p_->data_[p_->idx_], end - start);
+            p_->size_ = EXV_MAX(size, p_->idx_ + readCount);
+            p_->idx_ += readCount;
+            return countWrite(stats_, readCount);
+        }
+
         byte buf[4096];
         long readCount = 0;
         long writeTotal = 0;
@@ -1281,6 +1701,7 @@ namespace Exiv2 {
 
     int MemIo::putb(byte data)
     {
+        countWrite(stats_, 1);
         p_->reserve(1);
         assert(p_->isMalloced_);
         p_->data_[p_->idx_++] = data;
@@ -1290,6 +1711,7 @@ namespace Exiv2 {
 #if defined(_MSC_VER)
     int MemIo::seek( int64_t offset, Position pos )
     {
+        ++stats_.seeks_;
         uint64_t newIdx = 0;
 
         switch (pos) {
@@ -1305,6 +1727,7 @@ namespace Exiv2 {
 #else
     int MemIo::seek(long offset, Position pos)
     {
+        ++stats_.seeks_;
         long newIdx = 0;
 
         switch (pos) {
@@ -1320,8 +1743,16 @@ namespace Exiv2 {
     }
 #endif
 
+    void MemIo::reserve(long capacity)
+    {
+        if (!p_->isMalloced_ || capacity > p_->sizeAlloced_) {
+            p_->allocate(capacity);
+        }
+    }
+
     byte* MemIo::mmap(bool /*isWriteable*/)
     {
+        ++stats_.mmaps_;
         return p_->data_;
     }
 
@@ -1372,11 +1803,31 @@ namespace Exiv2 {
         std::memcpy(buf, &p_->data_[p_->idx_], allow);
         p_->idx_ += allow;
         if (rcount > avail) p_->eof_ = true;
-        return allow;
+        return countRead(stats_, allow);
+    }
+
+    const byte* MemIo::readView(DataBuf& buf, long rcount)
+    {
+        if (rcount >= 0 && p_->idx_ >= 0 && rcount <= p_->size_ - p_->idx_) {
+            const byte* data = &p_->data_[p_->idx_];
+            p_->idx_ += rcount;
+            countRead(stats_, rcount);
+            return data;
+        }
+        return BasicIo::readView(buf, rcount);
+    }
+
+    long MemIo::readAt(long offset, byte* buf, long rcount)
+    {
+        if (offset < 0 || rcount < 0 || offset >= p_->size_) return 0;
+        const long allow = EXV_MIN(rcount, p_->size_ - offset);
+        std::memcpy(buf, &p_->data_[offset], allow);
+        return countRead(stats_, allow);
     }
 
     int MemIo::getb()
     {
+        countRead(stats_, p_->idx_ < p_->size_ ? 1 : 0);
         if (p_->idx_ >= p_->size_) {
             p_->eof_ = true;
             return EOF;
@@ -1560,9 +2011,191 @@ namespace Exiv2 {
 
 #endif
 
+    //! Internal Pimpl structure of class MemoryBlockCache.
+    class MemoryBlockCache::Impl {
+    public:
+        //! Constructor
+        explicit Impl(size_t capacity) : capacity_(capacity), size_(0) {}
+
+        //! File revision and block index
+        typedef std::pair<std::string, size_t> Key;
+        //! Cached blocks, the most recently used first
+        typedef std::list<std::pair<Key, std::string> > BlockList;
+
+        // DATA
+        size_t capacity_;                                //!< Maximum number of bytes to keep
+        size_t size_;                                    //!< Number of bytes kept
+        BlockList blocks_;                               //!< The blocks in LRU order
+        std::map<Key, BlockList::iterator> index_;       //!< Position of each block in blocks_
+        mutable std::mutex mutex_;                       //!< Serializes access from several RemoteIo
+    }; // class MemoryBlockCache::Impl
+
+    MemoryBlockCache::MemoryBlockCache(size_t capacity)
+        : p_(new Impl(capacity))
+    {
+    }
+
+    MemoryBlockCache::~MemoryBlockCache()
+    {
+        delete p_;
+    }
+
+    bool MemoryBlockCache::get(const std::string& key, size_t block, std::string& data)
+    {
+        std::lock_guard<std::mutex> lock(p_->mutex_);
+        auto pos = p_->index_.find(Impl::Key(key, block));
+        if (pos == p_->index_.end()) return false;
+        p_->blocks_.splice(p_->blocks_.begin(), p_->blocks_, pos->second);
+        data = pos->second->second;
+        return true;
+    }
+
+    void MemoryBlockCache::put(const std::string& key, size_t block, const std::string& data)
+    {
+        if (data.size() > p_->capacity_) return;
+        std::lock_guard<std::mutex> lock(p_->mutex_);
+        const Impl::Key k(key, block);
+        auto pos = p_->index_.find(k);
+        if (pos != p_->index_.end()) {
+            p_->size_ -= pos->second->second.size();
+            p_->blocks_.erase(pos->second);
+            p_->index_.erase(pos);
+        }
+        p_->blocks_.push_front(std::make_pair(k, data));
+        p_->index_[k] = p_->blocks_.begin();
+        p_->size_ += data.size();
+        while (p_->size_ > p_->capacity_) {
+            p_->size_ -= p_->blocks_.back().second.size();
+            p_->index_.erase(p_->blocks_.back().first);
+            p_->blocks_.pop_back();
+        }
+    }
+
+    size_t MemoryBlockCache::size() const
+    {
+        std::lock_guard<std::mutex> lock(p_->mutex_);
+        return p_->size_;
+    }
+
+    FileBlockCache::FileBlockCache(const std::string& directory)
+        : directory_(directory)
+    {
+    }
+
+    std::string FileBlockCache::blockPath(const std::string& key, size_t block) const
+    {
+        // FNV-1a, the file names must not change between runs
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < key.size(); ++i) {
+            hash ^= static_cast<unsigned char>(key[i]);
+            hash *= 1099511628211ULL;
+        }
+        std::ostringstream os;
+        os << directory_ << "/" << std::hex << std::setw(16) << std::setfill('0') << hash
+           << "-" << std::dec << block << ".blk";
+        return os.str();
+    }
+
+    bool FileBlockCache::get(const std::string& key, size_t block, std::string& data)
+    {
+        // The file starts with the key and the length of the block, a
+        // different key with the same hash or a partly written file is a miss.
+        std::ifstream file(blockPath(key, block).c_str(), std::ios::binary);
+        if (!file) return false;
+        std::string storedKey;
+        size_t length = 0;
+        if (!std::getline(file, storedKey, '\0') || storedKey != key) return false;
+        if (!(file >> length) || file.get() != '\n') return false;
+        data.resize(length);
+        if (length > 0 && !file.read(&data[0], length)) return false;
+        return file.peek() == std::ifstream::traits_type::eof();
+    }
+
+    void FileBlockCache::put(const std::string& key, size_t block, const std::string& data)
+    {
+        const std::string path = blockPath(key, block);
+        const std::string tempPath = createTempFile(path);
+        if (tempPath.empty()) return;
+        {
+            std::ofstream file(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+            if (!file) {
+                std::remove(tempPath.c_str());
+                return;
+            }
+            file.write(key.data(), key.size());
+            file.put('\0');
+            file << data.size() << '\n';
+            file.write(data.data(), data.size());
+            if (!file) {
+                file.close();
+                std::remove(tempPath.c_str());
+                return;
+            }
+        }
+#if defined(_WIN32)
+        std::remove(path.c_str());
+#endif
+        if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+            std::remove(tempPath.c_str());
+        }
+    }
+
+    namespace {
+        //! The cache set with RemoteIo::setBlockCache()
+        std::atomic<RemoteBlockCache*> remoteBlockCache(nullptr);
+
+        //! Initial number of bytes fetched beyond a missing range, the next read usually follows on
+        const size_t readAheadBytes = 4096;
+        //! Upper limit of the read-ahead, however fast the link
+        const size_t maxReadAheadBytes = 1024 * 1024;
+        //! Upper limit of the range requests RemoteIo::prefetch() sends at a time
+        const size_t maxConcurrentRequests = 4;
+        //! Changed ranges of a remote write closer than this are sent as one, a request costs more
+        const size_t minWriteGapBytes = 1024;
+        //! Upper limit of the write requests of protocols which patch the remote file
+        const size_t maxWriteRequests = 16;
+
+        /*!
+          @brief Return the ETag, or if there is none the Last-Modified value
+              from the response headers of a server.
+         */
+        std::string responseVersion(const Exiv2::Dictionary& response)
+        {
+            const char* names[] = { "etag", "last-modified" };
+            for (size_t n = 0; n < EXV_COUNTOF(names); ++n) {
+                for (Exiv2::Dictionary::const_iterator i = response.begin(); i != response.end(); ++i) {
+                    std::string key = i->first;
+                    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+                    if (key != names[n]) continue;
+                    const std::string& value = i->second;
+                    const size_t first = value.find_first_not_of(" \t\r\n");
+                    if (first == std::string::npos) continue;
+                    const size_t last = value.find_last_not_of(" \t\r\n");
+                    return value.substr(first, last - first + 1);
+                }
+            }
+            return std::string();
+        }
+    }
+
+    void RemoteIo::setBlockCache(RemoteBlockCache* cache)
+    {
+        remoteBlockCache.store(cache);
+    }
+
+    RemoteBlockCache* RemoteIo::blockCache()
+    {
+        return remoteBlockCache.load();
+    }
+
     //! Internal Pimpl abstract structure of class RemoteIo.
     class RemoteIo::Impl {
     public:
+        //! Inclusive ranges of block indexes
+        typedef std::vector<std::pair<size_t, size_t> > BlockRanges;
+        //! Half-open ranges of byte positions
+        typedef std::vector<std::pair<size_t, size_t> > ByteRanges;
+
         //! Constructor
         Impl(const std::string& path, size_t blockSize);
 #ifdef EXV_UNICODE_PATH
@@ -1585,10 +2218,27 @@ namespace Exiv2 {
         bool            eof_;           //!< EOF indicator
         Protocol        protocol_;      //!< the protocol of url
         uint32_t        totalRead_;     //!< bytes requested from host
+        std::string     version_;       //!< ETag or modification time of the remote file, empty if unknown
+        std::string     cacheKey_;      //!< Key of the file in the block cache, empty if not cached
+        size_t          readAhead_;     //!< Bytes fetched beyond a missing range
+        double          latency_;       //!< Shortest time of a range request so far, in seconds
+        double          throughput_;    //!< Estimated transfer rate in bytes per second, 0 if unknown
+        size_t          nextBlock_;     //!< Block which follows the range fetched last
+        IoStats*        stats_;         //!< Stats of the RemoteIo, which counts the requests
+        std::shared_ptr<CancelToken> cancel_; //!< Token which cancels the requests, may be empty
+        bool            hasDeadline_;   //!< Is there a deadline for the requests?
+        std::chrono::steady_clock::time_point deadline_; //!< Deadline of the requests
 
         // METHODS
+        //! Return true if the requests are cancelled or have reached their deadline
+        bool stopRequested() const;
+        //! Throw kerRemoteRequestStopped if stopRequested()
+        void checkStop() const;
+        //! Return the milliseconds to the deadline, at least 1, or 0 if there is none
+        long remainingMs() const;
         /*!
-          @brief Get the length (in bytes) of the remote file.
+          @brief Get the length (in bytes) of the remote file. Also sets
+              version_ if the remote machine reports it.
           @return Return -1 if the size is unknown. Otherwise it returns the length of remote file (in bytes).
           @throw Error if the server returns the error code.
          */
@@ -1602,6 +2252,14 @@ namespace Exiv2 {
           @note Set lowBlock = -1 and highBlock = -1 to get the whole file content.
          */
         virtual void getDataByRange(long lowBlock, long highBlock, std::string& response) = 0;
+        /*!
+          @brief Get the data of several block ranges. The default implementation
+              requests them one after the other.
+          @param ranges Pairs of (lowBlock, highBlock).
+          @param responses Set to the data of each range, in the same order. The
+              response of a range which failed is left empty.
+         */
+        virtual void getDataByRanges(const BlockRanges& ranges, std::vector<std::string>& responses);
         /*!
           @brief Submit the data to the remote machine. The data replace a part of the remote file.
                 The replaced part of remote file is indicated by from and to parameters.
@@ -1614,6 +2272,20 @@ namespace Exiv2 {
           @throw Error if it fails.
          */
         virtual void writeRemote(const byte* data, size_t size, long from, long to) = 0;
+        /*!
+          @brief Return the number of changed ranges of a file which keeps its size
+              that are submitted with one writeRemote() call each, at most. The
+              default is 1 for protocols which rewrite the remote file per call.
+         */
+        virtual size_t maxWriteRanges() const { return 1; }
+        /*!
+          @brief Find the byte ranges in which \em src differs from the blocks.
+              Blocks which are not in memory are compared to zeros, as in mmap().
+          @param src The new content of the file, of the size of the remote file.
+          @param ranges Set to the changed ranges, sorted. Ranges which are less
+              than minWriteGapBytes apart are merged.
+         */
+        void changedRanges(BasicIo& src, ByteRanges& ranges);
         /*!
           @brief Get the data from the remote machine and write them to the memory blocks.
           @param lowBlock The start block index.
@@ -1622,25 +2294,127 @@ namespace Exiv2 {
           @throw Error if it fails.
          */
         virtual size_t populateBlocks(size_t lowBlock, size_t highBlock);
+        /*!
+          @brief Populate the blocks covering the byte ranges, see RemoteIo::prefetch().
+         */
+        void prefetchBlocks(const std::vector<std::pair<long, long> >& ranges);
+        //! Return the number of blocks of the remote file.
+        size_t blockCount() const { return (size_ + blockSize_ - 1) / blockSize_; }
+        //! Populate the blocks from \em lowBlock to \em highBlock which are in the block cache.
+        void fillFromCache(size_t lowBlock, size_t highBlock);
+        /*!
+          @brief Write \em data received for a range starting at \em lowBlock to
+              the memory blocks and the block cache.
+         */
+        void storeBlocks(size_t lowBlock, const std::string& data);
+        /*!
+          @brief Adapt readAhead_ after a range request of \em bytes which took
+              \em seconds. The read-ahead grows while the reads are sequential,
+              up to the data one round trip can carry, and shrinks on jumps.
+         */
+        void adaptReadAhead(size_t bytes, double seconds, bool sequential);
+        /*!
+          @brief Copy data from the memory blocks, populating them as needed.
+          @param pos The position of the first byte to copy.
+          @param buf The buffer to copy the data into.
+          @param rcount Maximum number of bytes to copy.
+          @return Number of bytes copied.
+          @throw Error if it fails to populate the blocks.
+         */
+        size_t readBlocks(size_t pos, byte* buf, size_t rcount);
 
     }; // class RemoteIo::Impl
 
     RemoteIo::Impl::Impl(const std::string& url, size_t blockSize)
         : path_(url), blockSize_(blockSize), blocksMap_(0), size_(0),
-          idx_(0), isMalloced_(false), eof_(false), protocol_(fileProtocol(url)),totalRead_(0)
+          idx_(0), isMalloced_(false), eof_(false), protocol_(fileProtocol(url)),totalRead_(0),
+          readAhead_(readAheadBytes), latency_(0), throughput_(0), nextBlock_(0), stats_(nullptr),
+          hasDeadline_(false)
     {
     }
 #ifdef EXV_UNICODE_PATH
     RemoteIo::Impl::Impl(const std::wstring& wurl, size_t blockSize)
         : wpath_(wurl), blockSize_(blockSize), blocksMap_(0), size_(0),
-          idx_(0), isMalloced_(false), eof_(false), protocol_(fileProtocol(wurl))
+          idx_(0), isMalloced_(false), eof_(false), protocol_(fileProtocol(wurl)),
+          readAhead_(readAheadBytes), latency_(0), throughput_(0), nextBlock_(0), stats_(nullptr),
+          hasDeadline_(false)
     {
     }
 #endif
 
+    bool RemoteIo::Impl::stopRequested() const
+    {
+        return    (cancel_ && cancel_->cancelled())
+               || (hasDeadline_ && std::chrono::steady_clock::now() >= deadline_);
+    }
+
+    void RemoteIo::Impl::checkStop() const
+    {
+        if (cancel_ && cancel_->cancelled()) {
+            throw Error(kerRemoteRequestStopped, path_, "cancelled");
+        }
+        if (hasDeadline_ && std::chrono::steady_clock::now() >= deadline_) {
+            throw Error(kerRemoteRequestStopped, path_, "deadline exceeded");
+        }
+    }
+
+    long RemoteIo::Impl::remainingMs() const
+    {
+        if (!hasDeadline_) return 0;
+        const long remaining = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline_ - std::chrono::steady_clock::now()).count());
+        return EXV_MAX(remaining, 1L);
+    }
+
+    void RemoteIo::Impl::fillFromCache(size_t lowBlock, size_t highBlock)
+    {
+        RemoteBlockCache* cache = cacheKey_.empty() ? nullptr : RemoteIo::blockCache();
+        if (!cache) return;
+        const size_t nBlocks = blockCount();
+        std::string data;
+        for (size_t iBlock = lowBlock; iBlock <= highBlock && iBlock < nBlocks; ++iBlock) {
+            if (!blocksMap_[iBlock].isNone()) continue;
+            const size_t expected = EXV_MIN(blockSize_, size_ - iBlock * blockSize_);
+            if (cache->get(cacheKey_, iBlock, data) && data.size() == expected) {
+                blocksMap_[iBlock].populate(reinterpret_cast<byte*>(&data[0]), data.size());
+            }
+        }
+    }
+
+    void RemoteIo::Impl::storeBlocks(size_t lowBlock, const std::string& data)
+    {
+        RemoteBlockCache* cache = cacheKey_.empty() ? nullptr : RemoteIo::blockCache();
+        const size_t nBlocks = blockCount();
+        byte* source = (byte*)data.c_str();
+        size_t remain = data.length(), totalRead = 0;
+        // servers which ignore the range return the whole file
+        size_t iBlock = (remain == size_) ? 0 : lowBlock;
+
+        while (remain && iBlock < nBlocks) {
+            size_t allow = EXV_MIN(remain, blockSize_);
+            if (!blocksMap_[iBlock].isInMem()) {
+                blocksMap_[iBlock].populate(&source[totalRead], allow);
+                if (cache && allow == EXV_MIN(blockSize_, size_ - iBlock * blockSize_)) {
+                    cache->put(cacheKey_, iBlock, std::string(data, totalRead, allow));
+                }
+            }
+            remain -= allow;
+            totalRead += allow;
+            iBlock++;
+        }
+    }
+
     size_t RemoteIo::Impl::populateBlocks(size_t lowBlock, size_t highBlock)
     {
         assert(isMalloced_);
+        const size_t nBlocks = blockCount();
+        if (nBlocks == 0) return 0;
+        if (highBlock >= nBlocks) highBlock = nBlocks - 1;
+        if (lowBlock > highBlock) return 0;
+
+        // take what we can from the block cache before asking the remote machine.
+        const size_t readAhead = readAhead_ / blockSize_;
+        fillFromCache(lowBlock, highBlock + readAhead);
 
         // optimize: ignore all true blocks on left & right sides.
         while(!blocksMap_[lowBlock].isNone()  && lowBlock  < highBlock) lowBlock++;
@@ -1649,32 +2423,175 @@ namespace Exiv2 {
         size_t rcount = 0;
         if (blocksMap_[highBlock].isNone())
         {
+            // read ahead the missing blocks which follow, in the same request.
+            for (size_t n = 0; n < readAhead && highBlock + 1 < nBlocks && blocksMap_[highBlock + 1].isNone(); ++n) {
+                highBlock++;
+            }
+            const bool sequential = lowBlock == nextBlock_;
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
             std::string data;
+            Trace trace("io", "range request");
+            checkStop();
+            ++stats_->remoteRequests_;
             getDataByRange( (long) lowBlock, (long) highBlock, data);
             rcount = data.length();
             if (rcount == 0) {
                 throw Error(kerErrorMessage, "Data By Range is empty. Please check the permission.");
             }
-            byte* source = (byte*)data.c_str();
-            size_t remain = rcount, totalRead = 0;
-            size_t iBlock = (rcount == size_) ? 0 : lowBlock;
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            adaptReadAhead(rcount, elapsed.count(), sequential);
+            nextBlock_ = highBlock + 1;
+            storeBlocks(lowBlock, data);
+        }
 
-            while (remain) {
-                size_t allow = EXV_MIN(remain, blockSize_);
-                blocksMap_[iBlock].populate(&source[totalRead], allow);
-                remain -= allow;
-                totalRead += allow;
-                iBlock++;
+        return rcount;
+    }
+
+    void RemoteIo::Impl::adaptReadAhead(size_t bytes, double seconds, bool sequential)
+    {
+        // the fastest request is mostly round trip, the time beyond it is transfer.
+        if (latency_ == 0 || seconds < latency_) latency_ = seconds;
+        const double transfer = seconds - latency_;
+        if (transfer > 0 && bytes > blockSize_) {
+            const double rate = bytes / transfer;
+            throughput_ = throughput_ == 0 ? rate : 0.75 * throughput_ + 0.25 * rate;
+        }
+
+        // more than one round trip worth of data costs more than the round trip it may save.
+        size_t limit = maxReadAheadBytes;
+        if (throughput_ > 0) {
+            limit = static_cast<size_t>(EXV_MIN(throughput_ * latency_, static_cast<double>(maxReadAheadBytes)));
+            limit = EXV_MAX(limit, blockSize_);
+        }
+        if (sequential) {
+            readAhead_ = EXV_MIN(EXV_MAX(2 * readAhead_, blockSize_), limit);
+        } else {
+            readAhead_ = EXV_MIN(readAhead_ / 2, limit);
+        }
+    }
+
+    void RemoteIo::Impl::prefetchBlocks(const std::vector<std::pair<long, long> >& ranges)
+    {
+        assert(isMalloced_);
+        // collect the runs of missing blocks.
+        BlockRanges runs;
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            const long offset = ranges[i].first;
+            const long count = ranges[i].second;
+            if (offset < 0 || count <= 0 || static_cast<size_t>(offset) >= size_) continue;
+            const size_t lowBlock = offset / blockSize_;
+            const size_t highBlock = (EXV_MIN(size_, static_cast<size_t>(offset) + count) - 1) / blockSize_;
+            fillFromCache(lowBlock, highBlock);
+            for (size_t iBlock = lowBlock; iBlock <= highBlock; ++iBlock) {
+                if (!blocksMap_[iBlock].isNone()) continue;
+                if (!runs.empty() && runs.back().second + 1 == iBlock) {
+                    runs.back().second = iBlock;
+                } else {
+                    runs.push_back(std::make_pair(iBlock, iBlock));
+                }
             }
         }
+        if (runs.empty()) return;
 
-        return rcount;
+        // coalesce overlapping and adjacent runs.
+        std::sort(runs.begin(), runs.end());
+        BlockRanges merged(1, runs.front());
+        for (size_t i = 1; i < runs.size(); ++i) {
+            if (runs[i].first <= merged.back().second + 1) {
+                merged.back().second = EXV_MAX(merged.back().second, runs[i].second);
+            } else {
+                merged.push_back(runs[i]);
+            }
+        }
+
+        std::vector<std::string> responses;
+        Trace trace("io", "prefetch");
+        checkStop();
+        stats_->remoteRequests_ += merged.size();
+        getDataByRanges(merged, responses);
+        for (size_t i = 0; i < merged.size(); ++i) {
+            if (!responses[i].empty()) storeBlocks(merged[i].first, responses[i]);
+        }
+    }
+
+    void RemoteIo::Impl::getDataByRanges(const BlockRanges& ranges, std::vector<std::string>& responses)
+    {
+        responses.assign(ranges.size(), std::string());
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            try {
+                getDataByRange((long) ranges[i].first, (long) ranges[i].second, responses[i]);
+            } catch (const std::exception&) {
+                responses[i].clear();
+            }
+        }
+    }
+
+    void RemoteIo::Impl::changedRanges(BasicIo& src, ByteRanges& ranges)
+    {
+        ranges.clear();
+        std::vector<byte> buf(blockSize_);
+        src.seek(0, BasicIo::beg);
+        for (size_t iBlock = 0; iBlock < blockCount(); ++iBlock) {
+            const size_t start = iBlock * blockSize_;
+            const size_t count = EXV_MIN(blockSize_, size_ - start);
+            if (static_cast<size_t>(src.read(&buf[0], (long) count)) != count) {
+                throw Error(kerErrorMessage, "unable to read src when comparing");
+            }
+            const byte* blockData = blocksMap_[iBlock].isInMem() ? blocksMap_[iBlock].getData() : nullptr;
+            for (size_t i = 0; i < count; ++i) {
+                if (blockData ? buf[i] == blockData[i] : buf[i] == 0) continue;
+                const size_t pos = start + i;
+                if (!ranges.empty() && pos - ranges.back().second < minWriteGapBytes) {
+                    ranges.back().second = pos + 1;
+                } else {
+                    ranges.push_back(std::make_pair(pos, pos + 1));
+                }
+            }
+        }
+    }
+
+    size_t RemoteIo::Impl::readBlocks(size_t pos, byte* buf, size_t rcount)
+    {
+        if (pos >= size_) return 0;
+        size_t allow     = EXV_MIN(rcount, size_ - pos);
+        size_t lowBlock  =  pos         /blockSize_;
+        size_t highBlock = (pos + allow)/blockSize_;
+
+        // connect to the remote machine & populate the blocks just in time.
+        populateBlocks(lowBlock, highBlock);
+        byte* fakeData = (byte*) std::calloc(blockSize_, sizeof(byte));
+        if (!fakeData) {
+            throw Error(kerErrorMessage, "Unable to allocate data");
+        }
+
+        size_t iBlock = lowBlock;
+        size_t startPos = pos - lowBlock*blockSize_;
+        size_t totalRead = 0;
+        do {
+            byte* data = blocksMap_[iBlock++].getData();
+            if (data == nullptr) data = fakeData;
+            size_t blockR = EXV_MIN(allow, blockSize_ - startPos);
+            std::memcpy(&buf[totalRead], &data[startPos], blockR);
+            totalRead += blockR;
+            startPos = 0;
+            allow -= blockR;
+        } while(allow);
+
+        std::free(fakeData);
+        return totalRead;
     }
 
     RemoteIo::Impl::~Impl() {
         if (blocksMap_) delete[] blocksMap_;
     }
 
+    void RemoteIo::setRemoteOptions(const RemoteOptions& options)
+    {
+        p_->cancel_ = options.cancel_;
+        p_->hasDeadline_ = options.timeoutMs_ > 0;
+        p_->deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeoutMs_);
+    }
+
     RemoteIo::~RemoteIo()
     {
         if (p_) {
@@ -1687,10 +2604,15 @@ namespace Exiv2 {
     {
         close(); // reset the IO position
         bigBlock_ = nullptr;
+        p_->stats_ = &stats_;
         if (p_->isMalloced_ == false) {
+            Trace trace("io", "remote open");
+            p_->checkStop();
+            ++stats_.remoteRequests_;
             long length = p_->getFileLength();
             if (length < 0) { // unable to get the length of remote file, get the whole file content.
                 std::string data;
+                ++stats_.remoteRequests_;
                 p_->getDataByRange(-1, -1, data);
                 p_->size_ = data.length();
                 size_t nBlocks = (p_->size_ + p_->blockSize_ - 1) / p_->blockSize_;
@@ -1712,6 +2634,12 @@ namespace Exiv2 {
                 size_t nBlocks = (p_->size_ + p_->blockSize_ - 1) / p_->blockSize_;
                 p_->blocksMap_  = new BlockMap[nBlocks];
                 p_->isMalloced_ = true;
+                // Without a version the cache can't tell a changed file from the one it has seen.
+                if (!p_->version_.empty()) {
+                    std::ostringstream key;
+                    key << p_->path_ << '\n' << p_->size_ << '\n' << p_->blockSize_ << '\n' << p_->version_;
+                    p_->cacheKey_ = key.str();
+                }
             }
         }
         return 0; // means OK
@@ -1743,6 +2671,34 @@ namespace Exiv2 {
         assert(p_->isMalloced_);
         if (!src.isopen()) return 0;
 
+        // a file which keeps its size is patched where it changed, if the protocol allows it
+        if (p_->maxWriteRanges() > 1 && static_cast<size_t>(src.size()) == p_->size_) {
+            Impl::ByteRanges ranges;
+            p_->changedRanges(src, ranges);
+            // merge the ranges which are closest until few enough remain
+            while (ranges.size() > p_->maxWriteRanges()) {
+                size_t closest = 0;
+                for (size_t i = 1; i + 1 < ranges.size(); ++i) {
+                    if (   ranges[i + 1].first - ranges[i].second
+                        < ranges[closest + 1].first - ranges[closest].second) closest = i;
+                }
+                ranges[closest].second = ranges[closest + 1].second;
+                ranges.erase(ranges.begin() + closest + 1);
+            }
+            std::vector<byte> data;
+            for (size_t i = 0; i < ranges.size(); ++i) {
+                data.resize(ranges[i].second - ranges[i].first);
+                src.seek((long) ranges[i].first, BasicIo::beg);
+                src.read(&data[0], (long) data.size());
+                countWrite(stats_, (long) data.size());
+                Trace trace("io", "remote write");
+                p_->checkStop();
+                ++stats_.remoteRequests_;
+                p_->writeRemote(&data[0], data.size(), (long) ranges[i].first, (long) ranges[i].second);
+            }
+            return (long) src.size();
+        }
+
         /*
          * The idea is to compare the file content, find the different bytes and submit them to the remote machine.
          * To simplify it, it:
@@ -1806,9 +2762,13 @@ namespace Exiv2 {
         // submit to the remote machine.
         long dataSize = (long) (src.size() - left - right);
         if (dataSize > 0) {
+            p_->checkStop();
             byte* data = (byte*) std::malloc(dataSize);
             src.seek(left, BasicIo::beg);
             src.read(data, dataSize);
+            countWrite(stats_, dataSize);
+            Trace trace("io", "remote write");
+            ++stats_.remoteRequests_;
             p_->writeRemote(data, (size_t)dataSize, (long)left, (long) (p_->size_ - right));
             if (data) std::free(data);
         }
@@ -1834,36 +2794,26 @@ namespace Exiv2 {
         if (p_->eof_) return 0;
         p_->totalRead_ += rcount;
 
-        size_t allow     = EXV_MIN(rcount, (long)( p_->size_ - p_->idx_));
-        size_t lowBlock  =  p_->idx_         /p_->blockSize_;
-        size_t highBlock = (p_->idx_ + allow)/p_->blockSize_;
-
-        // connect to the remote machine & populate the blocks just in time.
-        p_->populateBlocks(lowBlock, highBlock);
-        byte* fakeData = (byte*) std::calloc(p_->blockSize_, sizeof(byte));
-        if (!fakeData) {
-            throw Error(kerErrorMessage, "Unable to allocate data");
-        }
-
-        size_t iBlock = lowBlock;
-        size_t startPos = p_->idx_ - lowBlock*p_->blockSize_;
-        size_t totalRead = 0;
-        do {
-            byte* data = p_->blocksMap_[iBlock++].getData();
-            if (data == nullptr) data = fakeData;
-            size_t blockR = EXV_MIN(allow, p_->blockSize_ - startPos);
-            std::memcpy(&buf[totalRead], &data[startPos], blockR);
-            totalRead += blockR;
-            startPos = 0;
-            allow -= blockR;
-        } while(allow);
-
-        if (fakeData) std::free(fakeData);
+        size_t totalRead = p_->readBlocks(p_->idx_, buf, rcount);
 
         p_->idx_ += (long) totalRead;
         p_->eof_ = (p_->idx_ == (long) p_->size_);
 
-        return (long) totalRead;
+        return countRead(stats_, (long) totalRead);
+    }
+
+    long RemoteIo::readAt(long offset, byte* buf, long rcount)
+    {
+        assert(p_->isMalloced_);
+        if (offset < 0 || rcount < 0 || static_cast<size_t>(offset) >= p_->size_) return 0;
+        p_->totalRead_ += rcount;
+        return countRead(stats_, (long) p_->readBlocks(offset, buf, rcount));
+    }
+
+    void RemoteIo::prefetch(const std::vector<std::pair<long, long> >& ranges)
+    {
+        if (!p_->isMalloced_) return;
+        p_->prefetchBlocks(ranges);
     }
 
     int RemoteIo::getb()
@@ -1879,6 +2829,7 @@ namespace Exiv2 {
         p_->populateBlocks(expectedBlock, expectedBlock);
 
         byte* data = p_->blocksMap_[expectedBlock].getData();
+        countRead(stats_, 1);
         return data[p_->idx_++ - expectedBlock*p_->blockSize_];
     }
 
@@ -1895,6 +2846,7 @@ namespace Exiv2 {
     int RemoteIo::seek( int64_t offset, Position pos )
     {
         assert(p_->isMalloced_);
+        ++stats_.seeks_;
         uint64_t newIdx = 0;
 
         switch (pos) {
@@ -1912,6 +2864,7 @@ namespace Exiv2 {
     int RemoteIo::seek(long offset, Position pos)
     {
         assert(p_->isMalloced_);
+        ++stats_.seeks_;
         long newIdx = 0;
 
         switch (pos) {
@@ -1931,6 +2884,7 @@ namespace Exiv2 {
 
     byte* RemoteIo::mmap(bool /*isWriteable*/)
     {
+        ++stats_.mmaps_;
         if ( !bigBlock_ ) {
             size_t nRealData = 0 ;
             size_t blockSize = p_->blockSize_;
@@ -1971,6 +2925,11 @@ namespace Exiv2 {
         return p_->isMalloced_;
     }
 
+    bool RemoteIo::prefetches() const
+    {
+        return true;
+    }
+
     int RemoteIo::error() const
     {
         return 0;
@@ -2031,6 +2990,13 @@ namespace Exiv2 {
           @note Set lowBlock = -1 and highBlock = -1 to get the whole file content.
          */
         void getDataByRange(long lowBlock, long highBlock, std::string& response);
+        /*!
+          @brief Get the data of several block ranges. Each request uses its own
+              connection, so up to maxConcurrentRequests of them are sent at a time.
+         */
+        void getDataByRanges(const BlockRanges& ranges, std::vector<std::string>& responses);
+        //! Return the function which tells http() to give up, empty if there is nothing to check
+        std::function<bool()> stopFunction() const;
         /*!
           @brief Submit the data to the remote machine. The data replace a part of the remote file.
                 The replaced part of remote file is indicated by from and to parameters.
@@ -2045,6 +3011,8 @@ namespace Exiv2 {
           @throw Error if it fails.
          */
         void writeRemote(const byte* data, size_t size, long from, long to);
+        //! Each range is posted to the script on the server, which patches the remote file
+        size_t maxWriteRanges() const { return maxWriteRequests; }
 
         HttpImpl& operator=(const HttpImpl& rhs) = delete;
         HttpImpl& operator=(const HttpImpl&& rhs) = delete;
@@ -2070,6 +3038,12 @@ namespace Exiv2 {
     }
 #endif
 
+    std::function<bool()> HttpIo::HttpImpl::stopFunction() const
+    {
+        if (!cancel_ && !hasDeadline_) return std::function<bool()>();
+        return [this]() { return stopRequested(); };
+    }
+
     long HttpIo::HttpImpl::getFileLength()
     {
         Exiv2::Dictionary response;
@@ -2079,35 +3053,86 @@ namespace Exiv2 {
         request["page"  ] = hostInfo_.Path;
         if (hostInfo_.Port != "") request["port"] = hostInfo_.Port;
         request["verb"]   = "HEAD";
-        long serverCode = (long)http(request, response, errors);
+        long serverCode = (long)http(request, response, errors, stopFunction());
         if (serverCode < 0 || serverCode >= 400 || errors.compare("") != 0) {
+            checkStop();
             throw Error(kerTiffDirectoryTooLarge, "Server", serverCode);
         }
 
+        version_ = responseVersion(response);
         Exiv2::Dictionary_i lengthIter = response.find("Content-Length");
         return (lengthIter == response.end()) ? -1 : atol((lengthIter->second).c_str());
     }
 
+    namespace {
+        /*!
+          @brief Send a GET request for the blocks \em lowBlock to \em highBlock
+              of the file at \em host, all of it if both are -1, and return the
+              status code. The request has a connection of its own and uses
+              nothing but the arguments, so several of them may run at a time.
+         */
+        long httpGetBlocks(const Exiv2::Uri& host, size_t blockSize, long lowBlock, long highBlock,
+                           const std::function<bool()>& stop, std::string& body, std::string& errors)
+        {
+            Exiv2::Dictionary responseDic;
+            Exiv2::Dictionary request;
+            request["server"] = host.Host;
+            request["page"  ] = host.Path;
+            if (host.Port != "") request["port"] = host.Port;
+            request["verb"]   = "GET";
+            if (lowBlock > -1 && highBlock > -1) {
+                std::stringstream ss;
+                ss << "Range: bytes=" << lowBlock * blockSize  << "-" << ((highBlock + 1) * blockSize - 1) << "\r\n";
+                request["header"] = ss.str();
+            }
+
+            const long serverCode = (long)http(request, responseDic, errors, stop);
+            body = responseDic["body"];
+            return serverCode;
+        }
+    }
+
     void HttpIo::HttpImpl::getDataByRange(long lowBlock, long highBlock, std::string& response)
     {
-        Exiv2::Dictionary responseDic;
-        Exiv2::Dictionary request;
-        request["server"] = hostInfo_.Host;
-        request["page"  ] = hostInfo_.Path;
-        if (hostInfo_.Port != "") request["port"] = hostInfo_.Port;
-        request["verb"]   = "GET";
+        std::string body;
         std::string errors;
-        if (lowBlock > -1 && highBlock > -1) {
-            std::stringstream ss;
-            ss << "Range: bytes=" << lowBlock * blockSize_  << "-" << ((highBlock + 1) * blockSize_ - 1) << "\r\n";
-            request["header"] = ss.str();
-        }
-
-        long serverCode = (long)http(request, responseDic, errors);
+        long serverCode = httpGetBlocks(hostInfo_, blockSize_, lowBlock, highBlock, stopFunction(), body, errors);
         if (serverCode < 0 || serverCode >= 400 || errors.compare("") != 0) {
+            checkStop();
             throw Error(kerTiffDirectoryTooLarge, "Server", serverCode);
         }
-        response = responseDic["body"];
+        response.swap(body);
+    }
+
+    void HttpIo::HttpImpl::getDataByRanges(const BlockRanges& ranges, std::vector<std::string>& responses)
+    {
+        responses.assign(ranges.size(), std::string());
+        // The requests get copies of what they need instead of sharing this object
+        const Exiv2::Uri host = hostInfo_;
+        const size_t blockSize = blockSize_;
+        const std::function<bool()> stop = stopFunction();
+        for (size_t first = 0; first < ranges.size(); first += maxConcurrentRequests) {
+            const size_t last = EXV_MIN(ranges.size(), first + maxConcurrentRequests);
+            std::vector<std::future<std::string> > pending;
+            for (size_t i = first; i < last; ++i) {
+                const long lowBlock = (long) ranges[i].first;
+                const long highBlock = (long) ranges[i].second;
+                pending.push_back(std::async(std::launch::async, [host, blockSize, stop, lowBlock, highBlock]() {
+                    std::string body;
+                    std::string errors;
+                    const long serverCode = httpGetBlocks(host, blockSize, lowBlock, highBlock, stop, body, errors);
+                    if (serverCode < 0 || serverCode >= 400 || errors.compare("") != 0) body.clear();
+                    return body;
+                }));
+            }
+            for (size_t i = first; i < last; ++i) {
+                try {
+                    responses[i] = pending[i - first].get();
+                } catch (const std::exception&) {
+                    responses[i].clear();
+                }
+            }
+        }
     }
 
     void HttpIo::HttpImpl::writeRemote(const byte* data, size_t size, long from, long to)
@@ -2155,8 +3180,9 @@ namespace Exiv2 {
            << "\n" << postData << "\r\n";
         request["header"] = ss.str();
 
-        int serverCode = http(request, response, errors);
+        int serverCode = http(request, response, errors, stopFunction());
         if (serverCode < 0 || serverCode >= 400 || errors.compare("") != 0) {
+            checkStop();
             throw Error(kerTiffDirectoryTooLarge, "Server", serverCode);
         }
     }
@@ -2172,6 +3198,97 @@ namespace Exiv2 {
 #endif
 
 #ifdef EXV_USE_CURL
+    namespace {
+        /*!
+          @brief Easy handles and the caches they share, used by all CurlIo
+              instances. The share holds the DNS cache, the TLS sessions and,
+              with libcurl 7.57 and newer, the connection cache.
+         */
+        class CurlPool {
+        public:
+            //! Return the pool of the process
+            static CurlPool& instance()
+            {
+                static CurlPool pool;
+                return pool;
+            }
+            //! Return an easy handle which uses the share, 0 if libcurl fails. Give it back with release().
+            CURL* acquire()
+            {
+                CURL* curl = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!idle_.empty()) {
+                        curl = idle_.back();
+                        idle_.pop_back();
+                    }
+                }
+                if (!curl) curl = curl_easy_init();
+                if (curl) reset(curl);
+                return curl;
+            }
+            //! Keep \em curl for the next acquire(), or clean it up if there are enough.
+            void release(CURL* curl)
+            {
+                if (!curl) return;
+                curl_easy_reset(curl);
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (idle_.size() < maxIdle) {
+                    idle_.push_back(curl);
+                } else {
+                    curl_easy_cleanup(curl);
+                }
+            }
+            //! Reset all options of \em curl except the share.
+            void reset(CURL* curl)
+            {
+                curl_easy_reset(curl);
+                if (share_) curl_easy_setopt(curl, CURLOPT_SHARE, share_);
+            }
+
+        private:
+            //! Upper limit of idle easy handles kept
+            static const size_t maxIdle = 8;
+
+            CurlPool() : share_(curl_share_init())
+            {
+                if (!share_) return;
+                curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, lockShare);
+                curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, unlockShare);
+                curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+                curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+                curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+                curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+            }
+            ~CurlPool()
+            {
+                for (size_t i = 0; i < idle_.size(); ++i) curl_easy_cleanup(idle_[i]);
+                if (share_) curl_share_cleanup(share_);
+            }
+            CurlPool(const CurlPool&) = delete;
+            CurlPool& operator=(const CurlPool&) = delete;
+
+            static void lockShare(CURL*, curl_lock_data data, curl_lock_access, void* userptr)
+            {
+                static_cast<CurlPool*>(userptr)->locks_[data].lock();
+            }
+            static void unlockShare(CURL*, curl_lock_data data, void* userptr)
+            {
+                static_cast<CurlPool*>(userptr)->locks_[data].unlock();
+            }
+
+            CURLSH*             share_;                         //!< DNS, TLS session and connection caches
+            std::mutex          locks_[CURL_LOCK_DATA_LAST];    //!< One lock per kind of shared data
+            std::mutex          mutex_;                         //!< Guards idle_
+            std::vector<CURL*>  idle_;                          //!< Easy handles not in use
+        }; // class CurlPool
+
+        //! Set with CurlIo::setParallelFetch()
+        std::atomic<bool> curlParallelFetch(false);
+    }
+
     //! Internal Pimpl structure of class RemoteIo.
     class CurlIo::CurlImpl : public Impl  {
     public:
@@ -2181,10 +3298,10 @@ namespace Exiv2 {
         //! Constructor accepting a unicode path in an std::wstring
         CurlImpl(const std::wstring& wpath, size_t blockSize);
 #endif
-        //! Destructor. Cleans up the curl pointer and releases all managed memory.
+        //! Destructor. Returns the curl pointer to the pool and releases all managed memory.
         ~CurlImpl();
 
-        CURL*        curl_;             //!< libcurl pointer
+        CURL*        curl_;             //!< libcurl pointer, from the CurlPool
 
         // METHODS
         /*!
@@ -2202,6 +3319,24 @@ namespace Exiv2 {
           @note Set lowBlock = -1 and highBlock = -1 to get the whole file content.
          */
         void getDataByRange(long lowBlock, long highBlock, std::string& response);
+        /*!
+          @brief Get the data of several block ranges. With CurlIo::setParallelFetch()
+              enabled, the ranges are fetched concurrently with curl multi.
+         */
+        void getDataByRanges(const BlockRanges& ranges, std::vector<std::string>& responses);
+        /*!
+          @brief Set the options of a range request on \em curl.
+         */
+        void setRangeOptions(CURL* curl, long lowBlock, long highBlock, std::string& response) const;
+        /*!
+          @brief Set the options which make \em curl give up when the requests
+              are cancelled or reach their deadline, if there is anything to check.
+         */
+        void setStopOptions(CURL* curl) const;
+        //! Progress callback of libcurl, aborts the transfer if stopRequested()
+        static int progress(void* impl, curl_off_t, curl_off_t, curl_off_t, curl_off_t);
+        //! Progress callback of libcurl before 7.32
+        static int progressDouble(void* impl, double, double, double, double);
         /*!
           @brief Submit the data to the remote machine. The data replace a part of the remote file.
                 The replaced part of remote file is indicated by from and to parameters.
@@ -2217,6 +3352,8 @@ namespace Exiv2 {
                 http://dev.exiv2.org/wiki/exiv2
          */
         void writeRemote(const byte* data, size_t size, long from, long to);
+        //! Each range is posted to the script on the server, which patches the remote file
+        size_t maxWriteRanges() const { return maxWriteRequests; }
 
         CurlImpl& operator=(const CurlImpl& rhs) = delete;
         CurlImpl& operator=(const CurlImpl&& rhs) = delete;
@@ -2230,7 +3367,7 @@ namespace Exiv2 {
     CurlIo::CurlImpl::CurlImpl(const std::string& url, size_t blockSize):Impl(url, blockSize)
     {
         // init curl pointer
-        curl_ = curl_easy_init();
+        curl_ = CurlPool::instance().acquire();
         if(!curl_) {
             throw Error(kerErrorMessage, "Uable to init libcurl.");
         }
@@ -2256,7 +3393,7 @@ namespace Exiv2 {
         path_ = url;
 
         // init curl pointer
-        curl_ = curl_easy_init();
+        curl_ = CurlPool::instance().acquire();
         if(!curl_) {
             throw Error(kerErrorMessage, "Uable to init libcurl.");
         }
@@ -2272,20 +3409,25 @@ namespace Exiv2 {
 
     long CurlIo::CurlImpl::getFileLength()
     {
-        curl_easy_reset(curl_); // reset all options
+        CurlPool::instance().reset(curl_); // reset all options
         std::string response;
+        std::string headers;
         curl_easy_setopt(curl_, CURLOPT_URL, path_.c_str());
         curl_easy_setopt(curl_, CURLOPT_NOBODY, 1); // HEAD
         curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, curlWriter);
         curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &response);
+        curl_easy_setopt(curl_, CURLOPT_HEADERFUNCTION, curlWriter);
+        curl_easy_setopt(curl_, CURLOPT_HEADERDATA, &headers);
         curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYPEER, 0L);
         curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYHOST, 0L);
         curl_easy_setopt(curl_, CURLOPT_CONNECTTIMEOUT, timeout_);
+        setStopOptions(curl_);
         //curl_easy_setopt(curl_, CURLOPT_VERBOSE, 1); // debugging mode
 
         /* Perform the request, res will get the return code */
         CURLcode res = curl_easy_perform(curl_);
         if(res != CURLE_OK) { // error happends
+            checkStop();
             throw Error(kerErrorMessage, curl_easy_strerror(res));
         }
         // get return code
@@ -2294,36 +3436,77 @@ namespace Exiv2 {
         if (returnCode >= 400 || returnCode < 0) {
             throw Error(kerTiffDirectoryTooLarge, "Server", returnCode);
         }
+        // get the version from the headers of the last response
+        Exiv2::Dictionary headerDic;
+        std::istringstream headerLines(headers);
+        std::string line;
+        while (std::getline(headerLines, line)) {
+            if (line.compare(0, 5, "HTTP/") == 0) headerDic.clear(); // a redirect or 100 Continue
+            const size_t colon = line.find(':');
+            if (colon != std::string::npos) headerDic[line.substr(0, colon)] = line.substr(colon + 1);
+        }
+        version_ = responseVersion(headerDic);
         // get length
         double temp;
         curl_easy_getinfo(curl_, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &temp); // return -1 if unknown
         return (long) temp;
     }
 
-    void CurlIo::CurlImpl::getDataByRange(long lowBlock, long highBlock, std::string& response)
+    void CurlIo::CurlImpl::setRangeOptions(CURL* curl, long lowBlock, long highBlock, std::string& response) const
     {
-        curl_easy_reset(curl_); // reset all options
-        curl_easy_setopt(curl_, CURLOPT_URL, path_.c_str());
-        curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, 1L); // no progress meter please
-        curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, curlWriter);
-        curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &response);
-        curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYPEER, 0L);
-        curl_easy_setopt(curl_, CURLOPT_CONNECTTIMEOUT, timeout_);
-        curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYHOST, 0L);
+        curl_easy_setopt(curl, CURLOPT_URL, path_.c_str());
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L); // no progress meter please
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curlWriter);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, timeout_);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+        setStopOptions(curl);
 
-        //curl_easy_setopt(curl_, CURLOPT_VERBOSE, 1); // debugging mode
+        //curl_easy_setopt(curl, CURLOPT_VERBOSE, 1); // debugging mode
 
         if (lowBlock > -1 && highBlock> -1) {
             std::stringstream ss;
             ss << lowBlock * blockSize_  << "-" << ((highBlock + 1) * blockSize_ - 1);
             std::string range = ss.str();
-            curl_easy_setopt(curl_, CURLOPT_RANGE, range.c_str());
+            curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
         }
+    }
+
+    void CurlIo::CurlImpl::setStopOptions(CURL* curl) const
+    {
+        if (!cancel_ && !hasDeadline_) return;
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+#if LIBCURL_VERSION_NUM >= 0x072000
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progress);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+#else
+        curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, progressDouble);
+        curl_easy_setopt(curl, CURLOPT_PROGRESSDATA, this);
+#endif
+        if (hasDeadline_) curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, remainingMs());
+    }
+
+    int CurlIo::CurlImpl::progress(void* impl, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+    {
+        return static_cast<const CurlImpl*>(impl)->stopRequested() ? 1 : 0;
+    }
+
+    int CurlIo::CurlImpl::progressDouble(void* impl, double, double, double, double)
+    {
+        return static_cast<const CurlImpl*>(impl)->stopRequested() ? 1 : 0;
+    }
+
+    void CurlIo::CurlImpl::getDataByRange(long lowBlock, long highBlock, std::string& response)
+    {
+        CurlPool::instance().reset(curl_); // reset all options
+        setRangeOptions(curl_, lowBlock, highBlock, response);
 
         /* Perform the request, res will get the return code */
         CURLcode res = curl_easy_perform(curl_);
 
         if(res != CURLE_OK) {
+            checkStop();
             throw Error(kerErrorMessage, curl_easy_strerror(res));
         } else {
             long serverCode;
@@ -2334,6 +3517,52 @@ namespace Exiv2 {
         }
     }
 
+    void CurlIo::CurlImpl::getDataByRanges(const BlockRanges& ranges, std::vector<std::string>& responses)
+    {
+        CURLM* multi = (curlParallelFetch.load() && ranges.size() > 1) ? curl_multi_init() : nullptr;
+        if (!multi) {
+            Impl::getDataByRanges(ranges, responses);
+            return;
+        }
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long) maxConcurrentRequests);
+
+        responses.assign(ranges.size(), std::string());
+        std::vector<CURL*> handles;
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            CURL* curl = CurlPool::instance().acquire();
+            if (!curl) break;
+            setRangeOptions(curl, (long) ranges[i].first, (long) ranges[i].second, responses[i]);
+            curl_multi_add_handle(multi, curl);
+            handles.push_back(curl);
+        }
+
+        int running = 0;
+        do {
+            if (stopRequested() || curl_multi_perform(multi, &running) != CURLM_OK) break;
+            if (running) curl_multi_wait(multi, nullptr, 0, 1000, nullptr);
+        } while (running);
+
+        // keep only the responses of the requests which succeeded
+        std::vector<bool> succeeded(ranges.size(), false);
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+            if (msg->msg != CURLMSG_DONE || msg->data.result != CURLE_OK) continue;
+            const size_t i = std::find(handles.begin(), handles.end(), msg->easy_handle) - handles.begin();
+            long serverCode = 0;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &serverCode);
+            if (i < handles.size() && serverCode > 0 && serverCode < 400) succeeded[i] = true;
+        }
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            if (!succeeded[i]) responses[i].clear();
+        }
+
+        for (size_t i = 0; i < handles.size(); ++i) {
+            curl_multi_remove_handle(multi, handles[i]);
+            CurlPool::instance().release(handles[i]);
+        }
+        curl_multi_cleanup(multi);
+    }
+
     void CurlIo::CurlImpl::writeRemote(const byte* data, size_t size, long from, long to)
     {
         std::string scriptPath(getEnv(envHTTPPOST));
@@ -2350,11 +3579,12 @@ namespace Exiv2 {
             scriptPath = hostInfo.Protocol + "://" + hostInfo.Host + scriptPath;
         }
 
-        curl_easy_reset(curl_); // reset all options
+        CurlPool::instance().reset(curl_); // reset all options
         curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, 1L); // no progress meter please
         //curl_easy_setopt(curl_, CURLOPT_VERBOSE, 1); // debugging mode
         curl_easy_setopt(curl_, CURLOPT_URL, scriptPath.c_str());
         curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYPEER, 0L);
+        setStopOptions(curl_);
 
 
         // encode base64
@@ -2376,6 +3606,7 @@ namespace Exiv2 {
         CURLcode res = curl_easy_perform(curl_);
 
         if(res != CURLE_OK) {
+            checkStop();
             throw Error(kerErrorMessage, curl_easy_strerror(res));
         } else {
             long serverCode;
@@ -2387,7 +3618,7 @@ namespace Exiv2 {
     }
 
     CurlIo::CurlImpl::~CurlImpl() {
-        curl_easy_cleanup(curl_);
+        CurlPool::instance().release(curl_);
     }
 
     long CurlIo::write(const byte* data, long wcount)
@@ -2412,6 +3643,11 @@ namespace Exiv2 {
     {
         p_ = new CurlImpl(url, blockSize);
     }
+
+    void CurlIo::setParallelFetch(bool enable)
+    {
+        curlParallelFetch.store(enable);
+    }
 #ifdef EXV_UNICODE_PATH
     CurlIo::CurlIo(const std::wstring& wurl, size_t blockSize)
     {
@@ -2522,14 +3758,21 @@ namespace Exiv2 {
         if (protocol_ == pSftp) { // sftp
             sftp_attributes attributes = sftp_fstat(fileHandler_);
             length = (long)attributes->size;
+            version_ = toString(attributes->mtime);
         } else { // ssh
             std::string response;
             //std::string cmd = "stat -c %s " + hostInfo_.Path;
-            std::string cmd = "declare -a x=($(ls -alt " + hostInfo_.Path + ")); echo ${x[4]}";
+            std::string cmd = "declare -a x=($(ls -alt " + hostInfo_.Path + ")); echo ${x[4]} ${x[5]} ${x[6]} ${x[7]}";
             if (ssh_->runCommand(cmd, &response) != 0) {
                 throw Error(kerErrorMessage, "Unable to get file length.");
             } else {
                 length = atol(response.c_str());
+                // the modification time as listed by ls
+                const size_t space = response.find(' ');
+                const size_t end = response.find_last_not_of(" \r\n");
+                if (space != std::string::npos && end != std::string::npos && end > space) {
+                    version_ = response.substr(space + 1, end - space);
+                }
                 if (length == 0) {
                     throw Error(kerErrorMessage, "File is empty or not found.");
                 }
@@ -0,0 +1,253 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+  File:      batch.cpp
+ */
+// *****************************************************************************
+// included header files
+#include "config.h"
+
+#include "batch.hpp"
+#include "image.hpp"
+#include "xmp_exiv2.hpp"
+
+// + standard includes
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+// *****************************************************************************
+// local declarations
+namespace {
+
+    using namespace Exiv2;
+
+    //! An opened image, or the error which occurred when it was opened
+    struct Item {
+        size_t index_;                          //!< Index of the file
+        Image::UniquePtr image_;                //!< Opened image
+        ErrorCode code_;                        //!< Error code if the image is not opened
+        std::string message_;                   //!< Error message if the image is not opened
+        LogMsg::Messages messages_;             //!< Log messages of the image
+    };
+
+    //! Queue of the images of a worker
+    struct Queue {
+        std::mutex mutex_;
+        std::deque<Item> items_;
+    };
+
+    //! Set \em code and \em message from the exception being handled
+    void currentError(ErrorCode& code, std::string& message)
+    {
+        try {
+            throw;
+        }
+        catch (const AnyError& error) {
+            code = static_cast<ErrorCode>(error.code());
+            message = error.what();
+        }
+        catch (const std::exception& error) {
+            code = kerErrorMessage;
+            message = error.what();
+        }
+        catch (...) {
+            code = kerGeneralError;
+            message = "Unknown exception";
+        }
+    }
+
+}
+
+// *****************************************************************************
+// class member definitions
+namespace Exiv2 {
+
+    struct BatchProcessor::Impl {
+        unsigned int threads_;                  //!< Number of workers
+        size_t prefetch_;                       //!< Images opened ahead, 0 for the default
+        DecodeFilter filter_;                   //!< Decode filter of the images
+    };
+
+    BatchProcessor::BatchProcessor(unsigned int threads)
+        : p_(new Impl)
+    {
+        p_->threads_ = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+        p_->prefetch_ = 0;
+    }
+
+    BatchProcessor::~BatchProcessor() = default;
+
+    void BatchProcessor::setDecodeFilter(const DecodeFilter& filter)
+    {
+        p_->filter_ = filter;
+    }
+
+    void BatchProcessor::setPrefetch(size_t count)
+    {
+        p_->prefetch_ = count;
+    }
+
+    unsigned int BatchProcessor::threads() const
+    {
+        return p_->threads_;
+    }
+
+    size_t BatchProcessor::prefetch() const
+    {
+        return p_->prefetch_ > 0 ? p_->prefetch_ : 2 * static_cast<size_t>(p_->threads_);
+    }
+
+    BatchProcessor::Results BatchProcessor::run(const std::vector<std::string>& paths, const Callback& callback)
+    {
+        size_t next = 0;
+        return run([&](std::string& path) {
+            if (next == paths.size()) return false;
+            path = paths[next++];
+            return true;
+        }, callback);
+    }
+
+    BatchProcessor::Results BatchProcessor::run(const PathSource& source, const Callback& callback)
+    {
+        XmpParser::initialize();
+
+        const size_t window = prefetch();
+        std::vector<std::unique_ptr<Queue> > queues;
+        for (unsigned int i = 0; i < p_->threads_; ++i) queues.push_back(std::unique_ptr<Queue>(new Queue));
+
+        std::mutex mutex;
+        std::condition_variable cvWork;         // signalled when an image is queued or the source is exhausted
+        std::condition_variable cvSpace;        // signalled when an image is done
+        Results results;
+        size_t queued = 0;                      // images in the queues
+        size_t inFlight = 0;                    // images opened and not done
+        bool exhausted = false;
+
+        // Take the oldest image of the own queue, else the newest of another one
+        auto take = [&](size_t self, Item& item) {
+            for (size_t n = 0; ; ++n) {
+                Queue& q = *queues[(self + n) % queues.size()];
+                std::lock_guard<std::mutex> lock(q.mutex_);
+                if (q.items_.empty()) continue;
+                if (n == 0) {
+                    item = std::move(q.items_.front());
+                    q.items_.pop_front();
+                } else {
+                    item = std::move(q.items_.back());
+                    q.items_.pop_back();
+                }
+                return;
+            }
+        };
+
+        auto worker = [&](size_t self) {
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cvWork.wait(lock, [&]() { return queued > 0 || exhausted; });
+                    if (queued == 0) return;
+                    --queued;                   // reserves one of the queued images
+                }
+                Item item;
+                take(self, item);
+                if (item.image_) {
+                    LogMsg::Scope scope;
+                    try {
+                        item.image_->readMetadata();
+                        callback(*item.image_);
+                    } catch (...) {
+                        currentError(item.code_, item.message_);
+                    }
+                    item.image_.reset();        // closes the file
+                    LogMsg::Messages messages = scope.release();
+                    item.messages_.insert(item.messages_.end(),
+                                          std::make_move_iterator(messages.begin()),
+                                          std::make_move_iterator(messages.end()));
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    results[item.index_].code_ = item.code_;
+                    results[item.index_].message_ = item.message_;
+                    results[item.index_].messages_ = std::move(item.messages_);
+                    --inFlight;
+                }
+                cvSpace.notify_one();
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < queues.size(); ++i) workers.push_back(std::thread(worker, i));
+
+        std::exception_ptr exception;
+        try {
+            std::string path;
+            for (size_t index = 0; source(path); ++index) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cvSpace.wait(lock, [&]() { return inFlight < window; });
+                    Result result = { path, kerSuccess, std::string(), LogMsg::Messages() };
+                    results.push_back(result);
+                    ++inFlight;
+                }
+                Item item;
+                item.index_ = index;
+                item.code_ = kerSuccess;
+                {
+                    LogMsg::Scope scope;
+                    try {
+                        item.image_ = ImageFactory::open(path);
+                        item.image_->setDecodeFilter(p_->filter_);
+                    } catch (...) {
+                        item.image_.reset();
+                        currentError(item.code_, item.message_);
+                    }
+                    item.messages_ = scope.release();
+                }
+                {
+                    Queue& q = *queues[index % queues.size()];
+                    std::lock_guard<std::mutex> lock(q.mutex_);
+                    q.items_.push_back(std::move(item));
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++queued;
+                }
+                cvWork.notify_one();
+            }
+        } catch (...) {
+            exception = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            exhausted = true;
+        }
+        cvWork.notify_all();
+        for (auto&& w : workers) w.join();
+        if (exception) std::rethrow_exception(exception);
+        return results;
+    }
+
+}                                       // namespace Exiv2
@@ -3,10 +3,16 @@
 #include "safe_op.hpp"
 #include "exif.hpp"
 #include "error.hpp"
+#include "futils.hpp"
 #include "image_int.hpp"
 #include "enforce.hpp"
+#include "tiffimage_int.hpp"
+#include "tiffcomposite_int.hpp"
+#include "value.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <limits>
 #include <iostream>
 
@@ -130,10 +136,6 @@ namespace Exiv2
                         throw Exiv2::Error(kerCorruptedMetadata);
 
                     const uint64_t offset = getULongLong(buffer, byteOrder);
-
-                    if (offset >= io.size())
-                        throw Exiv2::Error(kerCorruptedMetadata);
-
                     result = Header(byteOrder, magic, size, offset);
                 }
                 else
@@ -147,17 +149,10 @@ namespace Exiv2
         {
             public:
                 BigTiffImage(BasicIo::UniquePtr io):
-                    Image(ImageType::bigtiff, mdExif, std::move(io)),
-                    header_(readHeader(Image::io())),
+                    Image(ImageType::bigtiff, mdExif | mdIptc | mdXmp, std::move(io)),
                     dataSize_(0),
                     doSwap_(false)
                 {
-                    assert(header_.isValid());
-
-                    doSwap_ =  (isLittleEndianPlatform() && header_.byteOrder() == bigEndian)
-                          ||   (isBigEndianPlatform()    && header_.byteOrder() == littleEndian);
-
-                    dataSize_ = header_.format() == Header::StandardTiff? 4 : 8;
                 }
 
                 virtual ~BigTiffImage() {}
@@ -165,21 +160,107 @@ namespace Exiv2
                 // overrides
                 void readMetadata()
                 {
-
+                    if (io_->open() != 0) {
+                        throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+                    }
+                    IoCloser closer(*io_);
+                    if (!isBigTiffType(*io_, false)) {
+                        if (io_->error() || io_->eof())
+                            throw Error(kerFailedToReadImageData);
+                        throw Error(kerNotAnImage, "BigTIFF");
+                    }
+                    clearMetadata();
+
+                    // The whole file is mapped, the parser reads each IFD from memory
+                    Internal::BigTiffHeader header;
+                    const ByteOrder bo = Internal::TiffParserWorker::decode(exifData_,
+                                                                           iptcData_,
+                                                                           xmpData_,
+                                                                           io_->mmap(),
+                                                                           io_->size(),
+                                                                           Internal::Tag::root,
+                                                                           Internal::TiffMapping::findDecoder,
+                                                                           &header);
+                    setByteOrder(bo);
+
+                    // A const lookup, mutable iterators would stop copies from sharing the metadata
+                    const ExifData& exifData = exifData_;
+                    ExifData::const_iterator pos = exifData.findKey(ExifKey("Exif.Image.InterColorProfile"));
+                    if (pos != exifData.end()) {
+                        const long size = pos->count() * pos->typeSize();
+                        if (size == 0) {
+                            throw Error(kerFailedToReadImageData);
+                        }
+                        iccProfile_.alloc(size);
+                        pos->copy(iccProfile_.pData_, bo);
+                    }
+                    pos = exifData.findKey(ExifKey("Exif.Image.ImageWidth"));
+                    if (pos != exifData.end() && pos->count() > 0) pixelWidth_ = pos->toLong();
+                    pos = exifData.findKey(ExifKey("Exif.Image.ImageLength"));
+                    if (pos != exifData.end() && pos->count() > 0) pixelHeight_ = pos->toLong();
                 }
 
                 void writeMetadata()
                 {
-
+                    checkUnfiltered();
+                    if (io_->open() != 0) {
+                        throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+                    }
+                    IoCloser closer(*io_);
+                    if (!isBigTiffType(*io_, false)) {
+                        throw Error(kerNotAnImage, "BigTIFF");
+                    }
+                    byte* pData = io_->mmap(true);
+                    const size_t size = io_->size();
+                    Internal::BigTiffHeader header;
+                    if (!header.read(pData, static_cast<uint32_t>(std::min<size_t>(size, 16)))) {
+                        throw Error(kerNotAnImage, "BigTIFF");
+                    }
+                    setByteOrder(header.byteOrder());
+
+                    if (iccProfileDefined()) {
+                        const ExifKey key("Exif.Image.InterColorProfile");
+                        const DataValue value(iccProfile_.pData_, iccProfile_.size_);
+                        ExifData::iterator pos = exifData_.findKey(key);
+                        if (pos != exifData_.end()) pos->setValue(&value);
+                        else exifData_.add(key, &value);
+                    }
+                    xmpData().usePacket(writeXmpFromPacket());
+
+                    // Only updates in place are supported, the image is left unchanged if the metadata does not fit
+                    Internal::TiffParserWorker::encode(*io_,
+                                                       pData,
+                                                       size,
+                                                       exifData_,
+                                                       iptcData(),
+                                                       xmpData(),
+                                                       Internal::Tag::root,
+                                                       Internal::TiffMapping::findEncoder,
+                                                       &header,
+                                                       0);
                 }
 
                 std::string mimeType() const
                 {
-                    return std::string();
+                    return "image/tiff";
                 }
 
                 void printStructure(std::ostream& os, PrintStructureOption option, int depth)
                 {
+                    if (io_->open() != 0) {
+                        throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+                    }
+                    IoCloser closer(*io_);
+                    header_ = readHeader(*io_);
+                    if (!header_.isValid()) {
+                        throw Error(kerNotAnImage, "BigTIFF");
+                    }
+                    // The type check only sees the start of the file, the offset is checked here
+                    enforce(header_.dirOffset() < io_->size(), kerCorruptedMetadata);
+                    doSwap_ =  (isLittleEndianPlatform() && header_.byteOrder() == bigEndian)
+                          ||   (isBigEndianPlatform()    && header_.byteOrder() == littleEndian);
+                    dataSize_ = header_.format() == Header::StandardTiff? 4 : 8;
+
                     printIFD(os, option, header_.dirOffset(), depth - 1);
                 }
 
@@ -198,12 +279,15 @@ namespace Exiv2
                     // buffer
                     bool bPrint = true;
 
+                    const size_t countSize = header_.format() == Header::StandardTiff? 2: 8;
+                    const size_t entrySize = header_.format() == Header::StandardTiff? 12: 20;
+
                     do
                     {
                         // Read top of directory
                         io.seek(dir_offset, BasicIo::beg);
 
-                        const uint64_t entries = readData(header_.format() == Header::StandardTiff? 2: 8);
+                        const uint64_t entries = readData(static_cast<int>(countSize));
                         const bool tooBig = entries > 500;
 
                         if ( bFirst && bPrint )
@@ -216,6 +300,12 @@ namespace Exiv2
                         if (tooBig)
                             break;
 
+                        // Read the entries and the pointer to the next directory at once
+                        const uint64_t dirSize = entries * entrySize + dataSize_;
+                        enforce(dirSize <= io.size() - io.tell(), kerCorruptedMetadata);
+                        const DataBuf dir = io.read(static_cast<long>(dirSize));
+                        enforce(static_cast<uint64_t>(dir.size_) == dirSize, kerCorruptedMetadata);
+
                         // Read the dictionary
                         for ( uint64_t i = 0; i < entries; i ++ )
                         {
@@ -226,10 +316,13 @@ namespace Exiv2
 
                             bFirst = false;
 
-                            const uint16_t tag   = (uint16_t) readData(2);
-                            const uint16_t type  = (uint16_t) readData(2);
-                            const uint64_t count = readData(dataSize_);
-                            const DataBuf  data  = io.read(dataSize_);        // Read data as raw value. what should be done about it will be decided depending on type
+                            const size_t   pos   = static_cast<size_t>(i * entrySize);
+                            const uint16_t tag   = byteSwap2(dir, pos, doSwap_);
+                            const uint16_t type  = byteSwap2(dir, pos + 2, doSwap_);
+                            const uint64_t count = dataSize_ == 4 ? byteSwap4(dir, pos + 4, doSwap_)
+                                                                  : byteSwap8(dir, pos + 4, doSwap_);
+                            // The raw value, what should be done about it will be decided depending on type
+                            const byte*    data  = dir.pData_ + pos + 4 + dataSize_;
 
                             std::string sp = "" ; // output spacer
 
@@ -270,31 +363,28 @@ namespace Exiv2
                             DataBuf buf(static_cast<long>(allocate));
 
                             const uint64_t offset = header_.format() == Header::StandardTiff?
-                                    byteSwap4(data, 0, doSwap_):
-                                    byteSwap8(data, 0, doSwap_);
+                                    byteSwap4(dir, pos + 4 + dataSize_, doSwap_):
+                                    byteSwap8(dir, pos + 4 + dataSize_, doSwap_);
 
                             // big data? Use 'data' as pointer to real data
                             const bool usePointer = (size_t) count*size > (size_t) dataSize_;
 
                             if ( usePointer )                          // read into buffer
                             {
-                                size_t   restore = io.tell();          // save
-                                io.seek(offset, BasicIo::beg);         // position
-                                io.read(buf.pData_, (long) count * size);     // read
-                                io.seek(restore, BasicIo::beg);        // restore
+                                io.readAt((long) offset, buf.pData_, (long) count * size);
                             }
                             else  // use 'data' as data :)
-                                std::memcpy(buf.pData_, data.pData_, (size_t) count * size);     // copy data
+                                std::memcpy(buf.pData_, data, (size_t) count * size);     // copy data
 
                             if ( bPrint )
                             {
-                                const uint64_t entrySize = header_.format() == Header::StandardTiff? 12: 20;
-                                const uint64_t address = dir_offset + 2 + i * entrySize;
+                                const uint64_t address = dir_offset + countSize + i * entrySize;
 
                                 out << Internal::indent(depth)
-                                    << Internal::stringFormat("%8u | %#06x %-25s |%10s |%9u |",
-                                        static_cast<size_t>(address), tag, tagName(tag).c_str(), typeName(type), count)
-                                    <<(usePointer ? Internal::stringFormat("%10u | ",(size_t)offset)
+                                    << Internal::stringFormat("%8llu | %#06x %-25s |%10s |%9llu |",
+                                        static_cast<unsigned long long>(address), tag, tagName(tag).c_str(),
+                                        typeName(type), static_cast<unsigned long long>(count))
+                                    <<(usePointer ? Internal::stringFormat("%10llu | ", static_cast<unsigned long long>(offset))
                                                   : Internal::stringFormat("%10s | ",""))
                                     ;
                                 if ( isShortType(type) )
@@ -305,7 +395,7 @@ namespace Exiv2
                                         sp = " ";
                                     }
                                 }
-                                else if ( isLongType(type) )
+                                else if ( isLongType(type) || type == tiffIfd )
                                 {
                                     for ( size_t k = 0 ; k < kount ; k++ )
                                     {
@@ -313,7 +403,7 @@ namespace Exiv2
                                         sp = " ";
                                     }
                                 }
-                                else if ( isLongLongType(type) )
+                                else if ( isLongLongType(type) || type == tiffIfd8 )
                                 {
                                     for ( size_t k = 0 ; k < kount ; k++ )
                                     {
@@ -342,13 +432,11 @@ namespace Exiv2
                                 {
                                     for ( size_t k = 0 ; k < count ; k++ )
                                     {
-                                        const size_t restore = io.tell();
-                                        const uint64_t ifdOffset = type == tiffIfd8?
+                                        const uint64_t ifdOffset = size == 8 ?
                                             byteSwap8(buf, k*size, doSwap_):
                                             byteSwap4(buf, k*size, doSwap_);
 
                                         printIFD(out, option, ifdOffset, depth);
-                                        io.seek(restore, BasicIo::beg);
                                     }
                                 }
                                 else if ( option == kpsRecursive && tag == 0x83bb /* IPTCNAA */ )
@@ -357,20 +445,15 @@ namespace Exiv2
                                         throw Error(kerCorruptedMetadata);
                                     }
 
-                                    const size_t restore = io.tell();
-                                    io.seek(offset, BasicIo::beg);  // position
                                     std::vector<byte> bytes(static_cast<size_t>(count)) ;  // allocate memory
                                     // TODO: once we have C++11 use bytes.data()
-                                    const long read_bytes = io.read(&bytes[0], static_cast<long>(count));
-                                    io.seek(restore, BasicIo::beg);
+                                    const long read_bytes = io.readAt(static_cast<long>(offset), &bytes[0], static_cast<long>(count));
                                     // TODO: once we have C++11 use bytes.data()
                                     IptcData::printStructure(out, makeSliceUntil(&bytes[0], read_bytes), depth);
 
                                 }
                                 else if ( option == kpsRecursive && tag == 0x927c /* MakerNote */ && count > 10)
                                 {
-                                    size_t   restore = io.tell();  // save
-
                                     long jump= 10           ;
                                     byte     bytes[20]          ;
                                     const char* chars = (const char*) &bytes[0] ;
@@ -395,13 +478,13 @@ namespace Exiv2
                                         std::cerr << "makernote" << std::endl;
                                         printIFD(out,option,offset,depth);
                                     }
-
-                                    io.seek(restore,BasicIo::beg); // restore
                                 }
                             }
                         }
 
-                        const uint64_t nextDirOffset = readData(dataSize_);
+                        const uint64_t nextDirOffset = dataSize_ == 4 ?
+                            byteSwap4(dir, static_cast<size_t>(entries * entrySize), doSwap_):
+                            byteSwap8(dir, static_cast<size_t>(entries * entrySize), doSwap_);
 
                         dir_offset = tooBig ? 0 : nextDirOffset;
                         out.flush();
@@ -437,15 +520,20 @@ namespace Exiv2
 
     Image::UniquePtr newBigTiffInstance(BasicIo::UniquePtr io, bool)
     {
-        return Image::UniquePtr(new BigTiffImage(std::move(io)));
+        Image::UniquePtr image(new BigTiffImage(std::move(io)));
+        if (!image->good()) {
+            image.reset();
+        }
+        return image;
     }
 
 
     bool isBigTiffType(BasicIo& io, bool advance)
     {
         const long pos = io.tell();
+        // Regular TIFF images are handled by TiffImage
         const Header header = readHeader(io);
-        const bool valid = header.isValid();
+        const bool valid = header.isValid() && header.format() == Header::BigTiff;
 
         if (valid == false || advance == false)
             io.seek(pos, BasicIo::beg);
@@ -0,0 +1,740 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+  File:      bmffimage.cpp
+ */
+// *****************************************************************************
+// included header files
+#include "config.h"
+
+#include "bmffimage.hpp"
+#include "image.hpp"
+#include "image_int.hpp"
+#include "tiffimage_int.hpp"
+#include "tiffcomposite_int.hpp"
+#include "basicio.hpp"
+#include "error.hpp"
+#include "futils.hpp"
+#include "stats_int.hpp"
+
+// + standard includes
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// *****************************************************************************
+// local declarations
+namespace {
+
+    using namespace Exiv2;
+
+    //! Return the box type with the four characters \em s
+    constexpr uint32_t boxType(const char (&s)[5])
+    {
+        return   static_cast<uint32_t>(static_cast<byte>(s[0])) << 24
+               | static_cast<uint32_t>(static_cast<byte>(s[1])) << 16
+               | static_cast<uint32_t>(static_cast<byte>(s[2])) << 8
+               | static_cast<uint32_t>(static_cast<byte>(s[3]));
+    }
+
+    //! Return the four characters of the box type \em type
+    std::string typeName(uint32_t type)
+    {
+        std::string name(4, '.');
+        for (int i = 0; i < 4; ++i) {
+            const char c = static_cast<char>(type >> (24 - 8 * i));
+            if (std::isprint(static_cast<unsigned char>(c))) name[i] = c;
+        }
+        return name;
+    }
+
+    //! User type of the Canon box in the moov box of CR3 images
+    const byte canonUuid[] = { 0x85, 0xc0, 0xb6, 0x87, 0x82, 0x0f, 0x11, 0xe0,
+                               0x81, 0x11, 0xf4, 0xce, 0x46, 0x2b, 0x6a, 0x48 };
+    //! User type of the XMP box of CR3 images
+    const byte xmpUuid[]   = { 0xbe, 0x7a, 0xcf, 0xcb, 0x97, 0xa9, 0x42, 0xe8,
+                               0x9c, 0x71, 0x99, 0x94, 0x91, 0xe3, 0xaf, 0xac };
+
+    //! Maximum nesting of the boxes which are walked
+    const int maxDepth = 16;
+
+    //! Header of a box
+    struct Box {
+        uint32_t type_;                         //!< Box type
+        long     offset_;                       //!< Offset of the box
+        long     data_;                         //!< Offset of the payload, after the header
+        long     end_;                          //!< Offset of the end of the box
+        byte     uuid_[16];                     //!< User type of a uuid box
+
+        //! Return the size of the payload
+        long size() const { return end_ - data_; }
+        //! Return true if this is a uuid box with the user type \em uuid
+        bool isUuid(const byte* uuid) const
+        {
+            return type_ == boxType("uuid") && std::memcmp(uuid_, uuid, sizeof(uuid_)) == 0;
+        }
+    };
+
+    /*!
+      @brief Read the header of the box at \em offset, which must end at
+             \em end at the latest. Return false if there is no box left
+             before \em end.
+      @throw Error if the header cannot be read or the box exceeds \em end.
+     */
+    bool readBox(BasicIo& io, long offset, long end, Box& box)
+    {
+        if (offset >= end) return false;
+        Internal::ParseBudget::checkDeadline();
+        byte buf[8];
+        if (end - offset < 8) throw Error(kerCorruptedMetadata);
+        if (io.readAt(offset, buf, 8) != 8) throw Error(kerFailedToReadImageData);
+        uint64_t size = getULong(buf, bigEndian);
+        box.type_ = getULong(buf + 4, bigEndian);
+        long header = 8;
+        if (size == 1) {
+            if (end - offset < 16) throw Error(kerCorruptedMetadata);
+            if (io.readAt(offset + 8, buf, 8) != 8) throw Error(kerFailedToReadImageData);
+            size = getULongLong(buf, bigEndian);
+            header = 16;
+        }
+        else if (size == 0) {
+            // The box extends to the end of its parent
+            size = end - offset;
+        }
+        if (box.type_ == boxType("uuid")) {
+            if (end - offset < header + 16) throw Error(kerCorruptedMetadata);
+            if (io.readAt(offset + header, box.uuid_, 16) != 16) throw Error(kerFailedToReadImageData);
+            header += 16;
+        }
+        if (size < static_cast<uint64_t>(header) || size > static_cast<uint64_t>(end - offset)) {
+            throw Error(kerCorruptedMetadata);
+        }
+        box.offset_ = offset;
+        box.data_ = offset + header;
+        box.end_ = offset + static_cast<long>(size);
+        return true;
+    }
+
+    //! Read \em size bytes at \em offset
+    DataBuf readData(BasicIo& io, long offset, long size)
+    {
+        DataBuf buf(size);
+        if (size > 0 && io.readAt(offset, buf.pData_, size) != size) throw Error(kerFailedToReadImageData);
+        return buf;
+    }
+
+    //! Cursor over the payload of a box, which throws if it runs out of data
+    class Cursor {
+    public:
+        //! Constructor, the cursor starts at the beginning of \em buf
+        explicit Cursor(const DataBuf& buf) : buf_(buf), pos_(0) {}
+        //! Read a big-endian number of \em n bytes, 0 to 8
+        uint64_t read(uint64_t n)
+        {
+            if (n > 8 || static_cast<long>(n) > buf_.size_ - pos_) throw Error(kerCorruptedMetadata);
+            uint64_t value = 0;
+            for (uint64_t i = 0; i < n; ++i) value = value << 8 | buf_.pData_[pos_++];
+            return value;
+        }
+        //! Read a null-terminated string, which may also end with the payload
+        std::string readString()
+        {
+            const long start = pos_;
+            while (pos_ < buf_.size_ && buf_.pData_[pos_] != 0) ++pos_;
+            const std::string s(reinterpret_cast<const char*>(buf_.pData_) + start, pos_ - start);
+            if (pos_ < buf_.size_) ++pos_;
+            return s;
+        }
+
+    private:
+        const DataBuf& buf_;
+        long pos_;
+    };
+
+    //! A range of the file, its offset and size
+    typedef std::pair<long, long> Range;
+
+    //! An item of the meta box of a HEIF image
+    struct Item {
+        Item() : type_(0), method_(0) {}
+
+        uint32_t    type_;                      //!< Item type, e.g., Exif or mime
+        std::string contentType_;               //!< Content type of a mime item
+        uint64_t    method_;                    //!< Construction method of the item
+        std::vector<std::pair<uint64_t, uint64_t> > extents_; //!< Offsets and lengths of the extents
+    };
+    typedef std::map<uint64_t, Item> Items;
+
+    //! The locations of the metadata of a BMFF file, found by walking its boxes
+    struct Layout {
+        Layout() : brand_(0), icc_(0, 0), width_(0), height_(0) {}
+
+        uint32_t           brand_;              //!< Major brand
+        std::vector<Range> exif_;               //!< Extents of the Exif item
+        std::vector<Range> xmp_;                //!< Extents of the XMP item or box
+        //! Root tags and ranges of the TIFF structures of CR3 images
+        std::vector<std::pair<uint32_t, Range> > tiffs_;
+        Range              icc_;                //!< ICC profile of the primary item
+        uint32_t           width_;              //!< Width of the primary item
+        uint32_t           height_;             //!< Height of the primary item
+    };
+
+    //! Return the version of the full box \em box
+    uint64_t fullBoxVersion(BasicIo& io, const Box& box)
+    {
+        if (box.size() < 4) throw Error(kerCorruptedMetadata);
+        byte version = 0;
+        if (io.readAt(box.data_, &version, 1) != 1) throw Error(kerFailedToReadImageData);
+        return version;
+    }
+
+    //! Read the item types of the iinf box \em iinf
+    void readIinf(BasicIo& io, const Box& iinf, Items& items)
+    {
+        const long countSize = fullBoxVersion(io, iinf) == 0 ? 2 : 4;
+        Box infe;
+        for (long pos = iinf.data_ + 4 + countSize; readBox(io, pos, iinf.end_, infe); pos = infe.end_) {
+            if (infe.type_ != boxType("infe")) continue;
+            const DataBuf data = readData(io, infe.data_, infe.size());
+            Cursor c(data);
+            const uint64_t version = c.read(1);
+            c.read(3);
+            if (version < 2) {
+                // Items of the first versions are described by their content type only
+                Item& item = items[c.read(2)];
+                c.read(2);
+                c.readString();
+                item.type_ = boxType("mime");
+                item.contentType_ = c.readString();
+            }
+            else {
+                Item& item = items[c.read(version == 2 ? 2 : 4)];
+                c.read(2);
+                item.type_ = static_cast<uint32_t>(c.read(4));
+                c.readString();
+                if (item.type_ == boxType("mime")) item.contentType_ = c.readString();
+            }
+        }
+    }
+
+    //! Read the extents of the items from the iloc box \em iloc
+    void readIloc(BasicIo& io, const Box& iloc, Items& items)
+    {
+        const DataBuf data = readData(io, iloc.data_, iloc.size());
+        Cursor c(data);
+        const uint64_t version = c.read(1);
+        c.read(3);
+        if (version > 2) return;
+        uint64_t sizes = c.read(1);
+        const uint64_t offsetSize = sizes >> 4;
+        const uint64_t lengthSize = sizes & 0xf;
+        sizes = c.read(1);
+        const uint64_t baseOffsetSize = sizes >> 4;
+        const uint64_t indexSize = version > 0 ? sizes & 0xf : 0;
+        const uint64_t count = c.read(version < 2 ? 2 : 4);
+        for (uint64_t i = 0; i < count; ++i) {
+            const uint64_t id = c.read(version < 2 ? 2 : 4);
+            const uint64_t method = version > 0 ? c.read(2) & 0xf : 0;
+            c.read(2);
+            const uint64_t base = c.read(baseOffsetSize);
+            const uint64_t extents = c.read(2);
+            Items::iterator item = items.find(id);
+            if (item != items.end()) {
+                item->second.method_ = method;
+                item->second.extents_.clear();
+            }
+            for (uint64_t e = 0; e < extents; ++e) {
+                c.read(indexSize);
+                const uint64_t offset = c.read(offsetSize);
+                const uint64_t length = c.read(lengthSize);
+                if (item != items.end()) item->second.extents_.push_back(std::make_pair(base + offset, length));
+            }
+        }
+    }
+
+    /*!
+      @brief Return the ranges of the file which hold the data of \em item,
+             none if its construction method is not supported. Items which
+             are constructed from the idat box \em idat are located in it.
+      @throw Error if an extent is out of bounds.
+     */
+    std::vector<Range> itemRanges(const Item& item, const Box& idat, long fileSize)
+    {
+        std::vector<Range> ranges;
+        long start = 0;
+        long end = fileSize;
+        if (item.method_ == 1) {
+            if (idat.type_ != boxType("idat")) throw Error(kerCorruptedMetadata);
+            start = idat.data_;
+            end = idat.end_;
+        }
+        else if (item.method_ != 0) {
+            return ranges;
+        }
+        for (size_t i = 0; i < item.extents_.size(); ++i) {
+            const uint64_t offset = item.extents_[i].first;
+            const uint64_t length = item.extents_[i].second;
+            // A length of 0, i.e., the rest of the file, is not used for metadata
+            if (   length == 0
+                || offset > static_cast<uint64_t>(end - start)
+                || length > static_cast<uint64_t>(end - start) - offset) {
+                throw Error(kerCorruptedMetadata);
+            }
+            ranges.push_back(Range(start + static_cast<long>(offset), static_cast<long>(length)));
+        }
+        return ranges;
+    }
+
+    //! Read the pixel size and the ICC profile of the primary item from the iprp box \em iprp
+    void readIprp(BasicIo& io, const Box& iprp, bool hasPrimary, uint64_t primary, Layout& layout)
+    {
+        std::vector<Box> properties;
+        DataBuf ipma;
+        Box box;
+        for (long pos = iprp.data_; readBox(io, pos, iprp.end_, box); pos = box.end_) {
+            if (box.type_ == boxType("ipco") && properties.empty()) {
+                Box property;
+                for (long p = box.data_; readBox(io, p, box.end_, property); p = property.end_) {
+                    properties.push_back(property);
+                }
+            }
+            else if (box.type_ == boxType("ipma") && ipma.size_ == 0) {
+                ipma = readData(io, box.data_, box.size());
+            }
+        }
+        // The properties associated with the primary item, all if there are no associations
+        std::vector<uint64_t> indices;
+        if (hasPrimary && ipma.size_ > 0) {
+            Cursor c(ipma);
+            const uint64_t version = c.read(1);
+            const uint64_t flags = c.read(3);
+            const uint64_t count = c.read(4);
+            for (uint64_t i = 0; i < count; ++i) {
+                const uint64_t id = c.read(version < 1 ? 2 : 4);
+                const uint64_t associations = c.read(1);
+                for (uint64_t a = 0; a < associations; ++a) {
+                    // The highest bit flags essential properties, indices start at 1
+                    const uint64_t index = flags & 1 ? c.read(2) & 0x7fff : c.read(1) & 0x7f;
+                    if (id == primary && index > 0) indices.push_back(index - 1);
+                }
+            }
+        }
+        else {
+            for (uint64_t i = 0; i < properties.size(); ++i) indices.push_back(i);
+        }
+        for (size_t i = 0; i < indices.size(); ++i) {
+            if (indices[i] >= properties.size()) continue;
+            const Box& property = properties[static_cast<size_t>(indices[i])];
+            if (property.type_ == boxType("ispe") && layout.width_ == 0 && property.size() >= 12) {
+                const DataBuf data = readData(io, property.data_, 12);
+                layout.width_ = getULong(data.pData_ + 4, bigEndian);
+                layout.height_ = getULong(data.pData_ + 8, bigEndian);
+            }
+            else if (property.type_ == boxType("colr") && layout.icc_.second == 0 && property.size() > 4) {
+                const DataBuf data = readData(io, property.data_, 4);
+                const uint32_t colourType = getULong(data.pData_, bigEndian);
+                if (colourType == boxType("prof") || colourType == boxType("rICC")) {
+                    layout.icc_ = Range(property.data_ + 4, property.size() - 4);
+                }
+            }
+        }
+    }
+
+    //! Locate the Exif and XMP items and the properties of the primary item in the meta box \em meta
+    void readMeta(BasicIo& io, const Box& meta, Layout& layout)
+    {
+        fullBoxVersion(io, meta);
+        Items items;
+        bool hasPrimary = false;
+        uint64_t primary = 0;
+        Box iloc = Box();
+        Box idat = Box();
+        Box iprp = Box();
+        Box box;
+        for (long pos = meta.data_ + 4; readBox(io, pos, meta.end_, box); pos = box.end_) {
+            switch (box.type_) {
+            case boxType("pitm"): {
+                const DataBuf data = readData(io, box.data_, box.size());
+                Cursor c(data);
+                const uint64_t version = c.read(1);
+                c.read(3);
+                primary = c.read(version == 0 ? 2 : 4);
+                hasPrimary = true;
+                break;
+            }
+            case boxType("iinf"): readIinf(io, box, items); break;
+            case boxType("iloc"): iloc = box; break;
+            case boxType("idat"): idat = box; break;
+            case boxType("iprp"): iprp = box; break;
+            default: break;
+            }
+        }
+        // The locations are read after the item types, the boxes may come in any order
+        if (iloc.type_ == boxType("iloc")) readIloc(io, iloc, items);
+        if (iprp.type_ == boxType("iprp")) readIprp(io, iprp, hasPrimary, primary, layout);
+
+        const long fileSize = static_cast<long>(io.size());
+        for (Items::const_iterator i = items.begin(); i != items.end(); ++i) {
+            if (i->second.type_ == boxType("Exif") && layout.exif_.empty()) {
+                layout.exif_ = itemRanges(i->second, idat, fileSize);
+            }
+            else if (   i->second.type_ == boxType("mime")
+                     && i->second.contentType_ == "application/rdf+xml" && layout.xmp_.empty()) {
+                layout.xmp_ = itemRanges(i->second, idat, fileSize);
+            }
+        }
+    }
+
+    //! Locate the TIFF structures in the Canon box of the moov box \em moov of a CR3 image
+    void readMoov(BasicIo& io, const Box& moov, Layout& layout)
+    {
+        Box box;
+        for (long pos = moov.data_; readBox(io, pos, moov.end_, box); pos = box.end_) {
+            if (!box.isUuid(canonUuid)) continue;
+            Box cmt;
+            for (long p = box.data_; readBox(io, p, box.end_, cmt); p = cmt.end_) {
+                uint32_t root = 0;
+                switch (cmt.type_) {
+                case boxType("CMT1"): root = Internal::Tag::root; break;
+                case boxType("CMT2"): root = Internal::Tag::cmt2; break;
+                case boxType("CMT3"): root = Internal::Tag::cmt3; break;
+                case boxType("CMT4"): root = Internal::Tag::cmt4; break;
+                default: break;
+                }
+                if (root != 0) layout.tiffs_.push_back(std::make_pair(root, Range(cmt.data_, cmt.size())));
+            }
+        }
+    }
+
+    //! Walk the top-level boxes of the file \em io and locate its metadata
+    Layout readLayout(BasicIo& io)
+    {
+        Layout layout;
+        const long fileSize = static_cast<long>(io.size());
+        Box box;
+        for (long pos = 0; readBox(io, pos, fileSize, box); pos = box.end_) {
+            switch (box.type_) {
+            case boxType("ftyp"):
+                if (box.size() < 4) throw Error(kerCorruptedMetadata);
+                layout.brand_ = getULong(readData(io, box.data_, 4).pData_, bigEndian);
+                break;
+            case boxType("meta"): readMeta(io, box, layout); break;
+            case boxType("moov"): readMoov(io, box, layout); break;
+            case boxType("uuid"):
+                if (box.isUuid(xmpUuid) && layout.xmp_.empty()) layout.xmp_.push_back(Range(box.data_, box.size()));
+                break;
+            default: break;
+            }
+        }
+        return layout;
+    }
+
+    //! Read the ranges \em ranges of the file into one buffer
+    DataBuf readRanges(BasicIo& io, const std::vector<Range>& ranges)
+    {
+        long size = 0;
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            if (ranges[i].second > static_cast<long>(io.size()) - size) throw Error(kerCorruptedMetadata);
+            size += ranges[i].second;
+        }
+        DataBuf buf(size);
+        long pos = 0;
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            if (io.readAt(ranges[i].first, buf.pData_ + pos, ranges[i].second) != ranges[i].second) {
+                throw Error(kerFailedToReadImageData);
+            }
+            pos += ranges[i].second;
+        }
+        return buf;
+    }
+
+    /*!
+      @brief Return the offset of the TIFF header in the Exif item \em exif,
+             after the offset which precedes the item data
+      @throw Error if the offset is out of bounds.
+     */
+    long tiffHeaderOffset(const DataBuf& exif)
+    {
+        if (exif.size_ < 4) throw Error(kerCorruptedMetadata);
+        const uint32_t offset = getULong(exif.pData_, bigEndian);
+        if (offset > static_cast<uint32_t>(exif.size_ - 4)) throw Error(kerCorruptedMetadata);
+        return 4 + static_cast<long>(offset);
+    }
+
+    //! Return the first child of \em box which is a box, -1 if its children are not walked
+    long firstChild(BasicIo& io, const Box& box)
+    {
+        switch (box.type_) {
+        case boxType("meta"): return box.data_ + 4;
+        case boxType("iinf"): return box.data_ + 4 + (fullBoxVersion(io, box) == 0 ? 2 : 4);
+        case boxType("moov"):
+        case boxType("trak"):
+        case boxType("mdia"):
+        case boxType("minf"):
+        case boxType("stbl"):
+        case boxType("dinf"):
+        case boxType("iprp"):
+        case boxType("ipco"): return box.data_;
+        default: return box.isUuid(canonUuid) ? box.data_ : -1;
+        }
+    }
+
+    //! Print the boxes from \em offset to \em end and their children
+    void printBoxes(std::ostream& out, BasicIo& io, long offset, long end, int depth)
+    {
+        if (depth > maxDepth) throw Error(kerCorruptedMetadata);
+        Box box;
+        for (long pos = offset; readBox(io, pos, end, box); pos = box.end_) {
+            out << Internal::stringFormat("%8ld | %8ld | ", box.offset_, box.end_ - box.offset_)
+                << std::string(2 * depth, ' ') << typeName(box.type_);
+            if (box.type_ == boxType("ftyp") && box.size() >= 4) {
+                out << " | " << typeName(getULong(readData(io, box.data_, 4).pData_, bigEndian));
+            }
+            else if (box.isUuid(canonUuid)) {
+                out << " | Canon";
+            }
+            else if (box.isUuid(xmpUuid)) {
+                out << " | XMP";
+            }
+            out << std::endl;
+            const long child = firstChild(io, box);
+            if (child >= 0) printBoxes(out, io, child, box.end_, depth + 1);
+        }
+    }
+
+}
+
+// *****************************************************************************
+// class member definitions
+namespace Exiv2 {
+
+    BmffImage::BmffImage(BasicIo::UniquePtr io, bool /*create*/)
+        : Image(ImageType::bmff, mdExif | mdXmp | mdIccProfile, std::move(io)), brand_(0)
+    {
+    } // BmffImage::BmffImage
+
+    std::string BmffImage::mimeType() const
+    {
+        switch (brand_) {
+        case boxType("avif"):
+        case boxType("avis"): return "image/avif";
+        case boxType("crx "): return "image/x-canon-cr3";
+        case boxType("heic"):
+        case boxType("heix"):
+        case boxType("heim"):
+        case boxType("heis"): return "image/heic";
+        case boxType("hevc"):
+        case boxType("hevx"): return "image/heic-sequence";
+        case boxType("msf1"): return "image/heif-sequence";
+        default: return "image/heif";
+        }
+    }
+
+    void BmffImage::setExifData(const ExifData& /*exifData*/)
+    {
+        throw(Error(kerInvalidSettingForImage, "Exif metadata", "BMFF"));
+    }
+
+    void BmffImage::setIptcData(const IptcData& /*iptcData*/)
+    {
+        throw(Error(kerInvalidSettingForImage, "IPTC metadata", "BMFF"));
+    }
+
+    void BmffImage::setComment(const std::string& /*comment*/)
+    {
+        throw(Error(kerInvalidSettingForImage, "Image comment", "BMFF"));
+    }
+
+    void BmffImage::printStructure(std::ostream& out, PrintStructureOption option, int depth)
+    {
+        if (io_->open() != 0) throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        IoCloser closer(*io_);
+        // Ensure that this is the correct image type
+        if (!isBmffType(*io_, false)) {
+            if (io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
+            throw Error(kerNotAnImage, "BMFF");
+        }
+
+        if (option == kpsBasic || option == kpsRecursive) {
+            out << Internal::indent(depth) << "STRUCTURE OF BMFF FILE: " << io_->path() << std::endl;
+            out << Internal::indent(depth) << " address |   length | box" << std::endl;
+            printBoxes(out, *io_, 0, static_cast<long>(io_->size()), 0);
+        }
+        if (option != kpsRecursive && option != kpsXMP && option != kpsIccProfile) return;
+
+        const Layout layout = readLayout(*io_);
+        if (option == kpsRecursive) {
+            if (!layout.exif_.empty()) {
+                const DataBuf exif = readRanges(*io_, layout.exif_);
+                const long start = tiffHeaderOffset(exif);
+                MemIo tiff(exif.pData_ + start, exif.size_ - start);
+                printTiffStructure(tiff, out, option, depth + 1);
+            }
+            for (size_t i = 0; i < layout.tiffs_.size(); ++i) {
+                const DataBuf data = readRanges(*io_, std::vector<Range>(1, layout.tiffs_[i].second));
+                MemIo tiff(data.pData_, data.size_);
+                printTiffStructure(tiff, out, option, depth + 1);
+            }
+        }
+        else if (option == kpsXMP && !layout.xmp_.empty()) {
+            const DataBuf xmp = readRanges(*io_, layout.xmp_);
+            out.write(reinterpret_cast<const char*>(xmp.pData_), xmp.size_);
+        }
+        else if (option == kpsIccProfile && layout.icc_.second > 0) {
+            const DataBuf icc = readRanges(*io_, std::vector<Range>(1, layout.icc_));
+            out.write(reinterpret_cast<const char*>(icc.pData_), icc.size_);
+        }
+    } // BmffImage::printStructure
+
+    void BmffImage::readMetadata()
+    {
+#ifdef DEBUG
+        std::cerr << "Reading BMFF file " << io_->path() << "\n";
+#endif
+        if (io_->open() != 0) throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        IoCloser closer(*io_);
+        // Ensure that this is the correct image type
+        if (!isBmffType(*io_, false)) {
+            if (io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
+            throw Error(kerNotAnImage, "BMFF");
+        }
+
+        clearMetadata();
+        const Layout layout = readLayout(*io_);
+        brand_ = layout.brand_;
+        pixelWidth_ = static_cast<int>(layout.width_);
+        pixelHeight_ = static_cast<int>(layout.height_);
+
+        // Announce the ranges of the metadata, so that remote sources fetch them together
+        std::vector<Range> ranges(layout.exif_);
+        ranges.insert(ranges.end(), layout.xmp_.begin(), layout.xmp_.end());
+        for (size_t i = 0; i < layout.tiffs_.size(); ++i) ranges.push_back(layout.tiffs_[i].second);
+        if (layout.icc_.second > 0) ranges.push_back(layout.icc_);
+        if (!ranges.empty()) io_->prefetch(ranges);
+
+        if (!layout.exif_.empty()) {
+            const DataBuf exif = readRanges(*io_, layout.exif_);
+            const long start = tiffHeaderOffset(exif);
+            setByteOrder(ExifParser::decode(exifData_, exif.pData_ + start, exif.size_ - start));
+            if (byteOrder() == invalidByteOrder) {
+#ifndef SUPPRESS_WARNINGS
+                EXV_WARNING << "Failed to decode Exif metadata.\n";
+#endif
+                exifData_.clear();
+            }
+        }
+        for (size_t i = 0; i < layout.tiffs_.size(); ++i) {
+            // The decoder clears its containers, each TIFF structure is decoded on its own and added
+            ExifData exifData;
+            exifData.setDecodeFilter(exifData_.decodeFilter());
+            IptcData iptcData;
+            XmpData xmpData;
+            const DataBuf tiff = readRanges(*io_, std::vector<Range>(1, layout.tiffs_[i].second));
+            const ByteOrder bo = Internal::TiffParserWorker::decode(exifData, iptcData, xmpData,
+                                                                   tiff.pData_, tiff.size_,
+                                                                   layout.tiffs_[i].first,
+                                                                   Internal::TiffMapping::findDecoder);
+            if (layout.tiffs_[i].first == Internal::Tag::root) setByteOrder(bo);
+            for (ExifData::const_iterator e = exifData.begin(); e != exifData.end(); ++e) exifData_.add(*e);
+            for (XmpData::const_iterator x = xmpData.begin(); x != xmpData.end(); ++x) xmpData_.add(*x);
+        }
+        if (!layout.xmp_.empty()) {
+            const DataBuf xmp = readRanges(*io_, layout.xmp_);
+            xmpPacket_.assign(reinterpret_cast<const char*>(xmp.pData_), xmp.size_);
+            if (XmpParser::decode(xmpData_, xmpPacket_)) {
+#ifndef SUPPRESS_WARNINGS
+                EXV_WARNING << "Failed to decode XMP metadata.\n";
+#endif
+            }
+        }
+        if (layout.icc_.second > 0) {
+            DataBuf icc = readRanges(*io_, std::vector<Range>(1, layout.icc_));
+            if (icc.size_ >= 4 && getULong(icc.pData_, bigEndian) == static_cast<uint32_t>(icc.size_)) {
+                setIccProfile(icc);
+            }
+            else {
+#ifndef SUPPRESS_WARNINGS
+                EXV_WARNING << "Ignoring an invalid ICC profile.\n";
+#endif
+            }
+        }
+
+        // CR3 images have no ispe box, their size is in the Exif IFD
+        if (pixelWidth_ == 0) {
+            ExifData::const_iterator width = exifData_.findKey(ExifKey("Exif.Photo.PixelXDimension"));
+            ExifData::const_iterator height = exifData_.findKey(ExifKey("Exif.Photo.PixelYDimension"));
+            if (width != exifData_.end() && width->count() > 0) pixelWidth_ = width->toLong();
+            if (height != exifData_.end() && height->count() > 0) pixelHeight_ = height->toLong();
+        }
+        releasePackets();
+    } // BmffImage::readMetadata
+
+    void BmffImage::writeMetadata()
+    {
+        throw(Error(kerWritingImageFormatUnsupported, "BMFF"));
+    } // BmffImage::writeMetadata
+
+    // *************************************************************************
+    // free functions
+    Image::UniquePtr newBmffInstance(BasicIo::UniquePtr io, bool create)
+    {
+        Image::UniquePtr image(new BmffImage(std::move(io), create));
+        if (create || !image->good()) {
+            image.reset();
+        }
+        return image;
+    }
+
+    bool isBmffType(BasicIo& iIo, bool advance)
+    {
+        const int32_t len = 12;
+        byte buf[len];
+        iIo.read(buf, len);
+        if (iIo.error() || iIo.eof()) {
+            return false;
+        }
+        bool rc = false;
+        if (getULong(buf + 4, bigEndian) == boxType("ftyp")) {
+            switch (getULong(buf + 8, bigEndian)) {
+            case boxType("avif"):
+            case boxType("avis"):
+            case boxType("crx "):
+            case boxType("heic"):
+            case boxType("heix"):
+            case boxType("heim"):
+            case boxType("heis"):
+            case boxType("hevc"):
+            case boxType("hevx"):
+            case boxType("mif1"):
+            case boxType("msf1"): rc = true; break;
+            default: break;
+            }
+        }
+        if (!advance || !rc) {
+            iIo.seek(-len, BasicIo::cur);
+        }
+        return rc;
+    }
+
+}                                       // namespace Exiv2
@@ -1721,11 +1721,10 @@ namespace Exiv2 {
             float fu = pos->value().toFloat(2);
             if (fu != 0.0) {
                 float fl = value.toFloat(1) / fu;
-                std::ostringstream oss;
-                oss.copyfmt(os);
+                FormatState fmt(os);
                 os << std::fixed << std::setprecision(1);
                 os << fl << " mm";
-                os.copyfmt(oss);
+                fmt.restore();
                 os.flags(f);
                 return os;
             }
@@ -1805,11 +1804,16 @@ namespace Exiv2 {
         std::string maxAperture_;               //!< Aperture
     };
 
-    //! Compare tag details with a lens entry
-    bool operator==(const TagDetails& td, const LensTypeAndFocalLengthAndMaxAperture& ltfl) {
-        return (   td.val_ == ltfl.lensType_
-                && std::string(td.label_).find(ltfl.focalLength_) != std::string::npos
-                && std::string(td.label_).find(ltfl.maxAperture_) != std::string::npos);
+    //! Return the first lens of the lens type whose label contains the focal length and aperture, 0 if there is none
+    const TagDetails* findLens(const LensTypeAndFocalLengthAndMaxAperture& ltfl)
+    {
+        const TagDetails* td = findTagDetails<EXV_COUNTOF(canonCsLensType), canonCsLensType>(ltfl.lensType_);
+        const TagDetails* const end = canonCsLensType + EXV_COUNTOF(canonCsLensType);
+        for (; td && td != end && td->val_ == ltfl.lensType_; ++td) {
+            if (   std::strstr(td->label_, ltfl.focalLength_.c_str())
+                && std::strstr(td->label_, ltfl.maxAperture_.c_str())) return td;
+        }
+        return nullptr;
     }
 
     //! extractLensFocalLength from metadata
@@ -1879,7 +1883,7 @@ namespace Exiv2 {
         }
         if (ltfl.maxAperture_.empty()) return os << value;
 
-        const TagDetails* td = find(canonCsLensType, ltfl);
+        const TagDetails* td = findLens(ltfl);
         if (!td) return os << value;
         return os << td->label_;
     }
@@ -1901,7 +1905,7 @@ namespace Exiv2 {
 
         if (ltfl.focalLength_.empty()) return os << value;
 
-        const TagDetails* td = find(canonCsLensType, ltfl);
+        const TagDetails* td = findLens(ltfl);
         if (!td) return os << value;
         return os << td->label_;
     }
@@ -1920,13 +1924,13 @@ namespace Exiv2 {
         extractLensFocalLength(ltfl, metadata);
         if (ltfl.focalLengthMax_ == 0.0) return os << value;
         convertFocalLength(ltfl, 1.0); // just lens
-        const TagDetails* td = find(canonCsLensType, ltfl);
+        const TagDetails* td = findLens(ltfl);
         if (!td) {
             convertFocalLength(ltfl, 1.4); // lens + 1.4x TC
-            td = find(canonCsLensType, ltfl);
+            td = findLens(ltfl);
             if (!td) {
                 convertFocalLength(ltfl, 2.0); // lens + 2x TC
-                td = find(canonCsLensType, ltfl);
+                td = findLens(ltfl);
                 if (!td) return os << value;
             }
         }
@@ -1944,8 +1948,9 @@ namespace Exiv2 {
         // #1034
         const std::string undefined("undefined") ;
         const std::string section  ("canon");
-        if ( Internal::readExiv2Config(section,value.toString(),undefined) != undefined ) {
-            return os << Internal::readExiv2Config(section,value.toString(),undefined);
+        const std::string configLens = Internal::readExiv2Config(section,value.toString(),undefined);
+        if ( configLens != undefined ) {
+            return os << configLens;
         }
 
         const LensIdFct* lif = find(lensIdFct, value.toLong());
@@ -1975,15 +1980,14 @@ namespace Exiv2 {
         if (fu == 0.0) return os << value;
         float len1 = value.toLong(0) / fu;
         float len2 = value.toLong(1) / fu;
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(1);
         if (len1 == len2) {
             os << len1 << " mm";
         } else {
             os << len2 << " - " << len1 << " mm";
         }
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
@@ -2012,11 +2016,10 @@ namespace Exiv2 {
             // It might be explained by the fakt, that most Canons have a longest
             // exposure of 30s which is 5 EV below 1s
             // see also printSi0x0017
-            std::ostringstream oss;
-            oss.copyfmt(os);
+            FormatState fmt(os);
             int res = static_cast<int>(100.0 * (static_cast<short>(value.toLong()) / 32.0 + 5.0) + 0.5);
             os << std::fixed << std::setprecision(2) << res / 100.0;
-            os.copyfmt(oss);
+            fmt.restore();
         }
         return os;
     }
@@ -2081,13 +2084,12 @@ namespace Exiv2 {
         if (   value.typeId() != unsignedShort
             || value.count() == 0) return os << value;
 
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         long val = static_cast<int16_t>(value.toLong());
         if (val < 0) return os << value;
         os << std::setprecision(2)
            << "F" << fnumber(canonEv(val));
-        os.copyfmt(oss);
+        fmt.restore();
         return os;
     }
 
@@ -2115,11 +2117,10 @@ namespace Exiv2 {
         if (   value.typeId() != unsignedShort
             || value.count() == 0) return os << value;
 
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(2)
            << value.toLong() / 8.0 - 6.0;
-        os.copyfmt(oss);
+        fmt.restore();
         return os;
     }
 
@@ -2131,8 +2132,7 @@ namespace Exiv2 {
        if (   value.typeId() != signedShort
          || value.count() == 0) return os << value;
 
-      std::ostringstream oss;
-      oss.copyfmt(os);
+      FormatState fmt(os);
       os << std::fixed << std::setprecision(2);
 
       long l = value.toLong();
@@ -2143,7 +2143,7 @@ namespace Exiv2 {
         os << value.toLong()/100.0 << " m";
       }
 
-      os.copyfmt(oss);
+      fmt.restore();
       os.flags(f);
       return os;
     }
@@ -2172,4 +2172,18 @@ namespace Exiv2 {
         return sign * (val + frac) / 32.0f;
     }
 
+    //! Tag lists of the groups of the Canon makernote module
+    extern const MnTagListEntry canonMnTagLists[] = {
+        { canonId,   CanonMakerNote::tagList },
+        { canonCsId, CanonMakerNote::tagListCs },
+        { canonSiId, CanonMakerNote::tagListSi },
+        { canonCfId, CanonMakerNote::tagListCf },
+        { canonPiId, CanonMakerNote::tagListPi },
+        { canonTiId, CanonMakerNote::tagListTi },
+        { canonFiId, CanonMakerNote::tagListFi },
+        { canonPaId, CanonMakerNote::tagListPa },
+        { canonPrId, CanonMakerNote::tagListPr },
+        { ifdIdNotSet, 0 }
+    };
+
 }}                                      // namespace Internal, Exiv2
@@ -213,10 +213,9 @@ namespace Exiv2 {
     std::ostream& CasioMakerNote::print0x0006(std::ostream& os, const Value& value, const ExifData*)
     {
         std::ios::fmtflags f( os.flags() );
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(2) << value.toLong() / 1000.0 << _(" m");
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
@@ -584,12 +583,18 @@ namespace Exiv2 {
             os.flags(f);
             return os;
         };
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(2) << value.toLong() / 1000.0 << _(" m");
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
 
+    //! Tag lists of the groups of the Casio makernote module
+    extern const MnTagListEntry casioMnTagLists[] = {
+        { casioId,  CasioMakerNote::tagList },
+        { casio2Id, Casio2MakerNote::tagList },
+        { ifdIdNotSet, 0 }
+    };
+
 }}                                      // namespace Internal, Exiv2
@@ -33,11 +33,16 @@
 #include "iptc.hpp"
 #include "xmp_exiv2.hpp"
 #include "futils.hpp"
+#include "helper_functions.hpp"
 #include "convert.hpp"
+#include "trace.hpp"
 #include "unused.h"
 
 // + standard includes
+#include <algorithm>
+#include <map>
 #include <utility>
+#include <vector>
 #include <iostream>
 #include <iomanip>
 #include <ios>
@@ -47,6 +52,7 @@
 # define snprintf _snprintf
 #endif
 #include <cstring>
+#include <cctype>
 
 #if defined WIN32 && !defined __CYGWIN__
 # include <windows.h>
@@ -78,7 +84,17 @@ namespace {
 #if defined EXV_HAVE_ICONV
     // Convert string charset with iconv.
     bool convertStringCharsetIconv(std::string& str, const char* from, const char* to);
+    /*!
+      @brief Return a conversion descriptor for \em from to \em to, (iconv_t)(-1)
+             if there is none. The descriptors are opened once per thread and
+             kept open, iconv_open() loads the conversion modules.
+     */
+    iconv_t iconvDescriptor(const char* from, const char* to);
 #endif
+    //! Return true if the charset \em name encodes 7-bit characters like ASCII
+    bool asciiCompatible(const char* name);
+    //! Return true if \em str contains only 7-bit characters
+    bool isAscii(const std::string& str);
     /*!
       @brief Get the text value of an XmpDatum \em pos.
 
@@ -140,6 +156,11 @@ namespace Exiv2 {
           This flag indicates whether existing target records are overwritten.
          */
         void setOverwrite(bool onoff =true) { overwrite_ = onoff; }
+        /*!
+          @brief Restrict the conversion to the rules flagged in \em rules,
+                 which must outlive the converter. 0 selects all rules.
+         */
+        void setRules(const std::vector<bool>* rules) { rules_ = rules; }
         //@}
 
         //! @name Conversion functions (manipulators)
@@ -291,16 +312,36 @@ namespace Exiv2 {
         bool overwrite() const { return overwrite_; }
         //@}
 
+        //! Return the flags of the rules that have one of \em keys, for setRules().
+        static std::vector<bool> selectRules(const std::vector<std::string>& keys);
+
     private:
         bool prepareExifTarget(const char* to, bool force =false);
         bool prepareIptcTarget(const char* to, bool force =false);
         bool prepareXmpTarget(const char* to, bool force =false);
         std::string computeExifDigest(bool tiff);
 
+        //! Keys of the conversion rules, computed once.
+        struct RuleIndex {
+            std::vector<std::string> keys1_;    //!< First key of each rule, as returned by key()
+            std::vector<uint16_t> tags1_;       //!< Exif tag of the first key of each Exif rule
+            std::vector<bool> image1_;          //!< True if the first key of an Exif rule is in the Image group
+            //! Indexes of the rules for each first and second key
+            std::map<std::string, std::vector<size_t> > rules_;
+        };
+        //! Return the index of the conversion rules.
+        static const RuleIndex& ruleIndex();
+        /*!
+          @brief Return the indexes of the conversion rules which have their
+                 first or second key in the metadata, in table order.
+         */
+        std::vector<size_t> activeRules() const;
+
         // DATA
         static const Conversion conversion_[];  //<! Conversion rules
         bool erase_;
         bool overwrite_;
+        const std::vector<bool>* rules_;
         ExifData *exifData_;
         IptcData *iptcData_;
         XmpData  *xmpData_;
@@ -441,19 +482,105 @@ namespace Exiv2 {
     };
 
     Converter::Converter(ExifData& exifData, XmpData& xmpData)
-        : erase_(false), overwrite_(true), exifData_(&exifData), iptcData_(0), xmpData_(&xmpData), iptcCharset_(0)
+        : erase_(false), overwrite_(true), rules_(0), exifData_(&exifData), iptcData_(0), xmpData_(&xmpData), iptcCharset_(0)
     {
     }
 
     Converter::Converter(IptcData& iptcData, XmpData& xmpData, const char *iptcCharset)
-        : erase_(false), overwrite_(true), exifData_(0), iptcData_(&iptcData), xmpData_(&xmpData), iptcCharset_(iptcCharset)
+        : erase_(false), overwrite_(true), rules_(0), exifData_(0), iptcData_(&iptcData), xmpData_(&xmpData), iptcCharset_(iptcCharset)
+    {
+    }
+
+    const Converter::RuleIndex& Converter::ruleIndex()
+    {
+        static const RuleIndex index = [] {
+            RuleIndex index;
+            for (size_t i = 0; i < EXV_COUNTOF(conversion_); ++i) {
+                const Conversion& c = conversion_[i];
+                std::string key1 = c.key1_;
+                uint16_t tag1 = 0;
+                bool image1 = false;
+                if (c.metadataId_ == mdExif) {
+                    ExifKey key(c.key1_);
+                    key1 = key.key();
+                    tag1 = key.tag();
+                    image1 = key.groupName() == "Image";
+                }
+                else if (c.metadataId_ == mdIptc) {
+                    key1 = IptcKey(c.key1_).key();
+                }
+                index.keys1_.push_back(key1);
+                index.tags1_.push_back(tag1);
+                index.image1_.push_back(image1);
+                index.rules_[key1].push_back(i);
+                index.rules_[XmpKey(c.key2_).key()].push_back(i);
+            }
+            return index;
+        }();
+        return index;
+    }
+
+    std::vector<size_t> Converter::activeRules() const
+    {
+        const RuleIndex& index = ruleIndex();
+        std::vector<size_t> rules;
+        std::vector<std::string> keys;
+        if (exifData_) {
+            for (ExifData::const_iterator i = exifData_->begin(); i != exifData_->end(); ++i) {
+                keys.push_back(i->key());
+            }
+        }
+        if (iptcData_) {
+            for (IptcData::const_iterator i = iptcData_->begin(); i != iptcData_->end(); ++i) {
+                keys.push_back(i->key());
+            }
+        }
+        // Struct fields and array items match the rules of the property they belong to
+        for (XmpData::const_iterator i = xmpData_->begin(); i != xmpData_->end(); ++i) {
+            std::string key = i->key();
+            keys.push_back(key.substr(0, key.find_first_of("/[")));
+        }
+        for (std::vector<std::string>::const_iterator k = keys.begin(); k != keys.end(); ++k) {
+            std::map<std::string, std::vector<size_t> >::const_iterator pos = index.rules_.find(*k);
+            if (pos == index.rules_.end()) continue;
+            rules.insert(rules.end(), pos->second.begin(), pos->second.end());
+        }
+        std::sort(rules.begin(), rules.end());
+        rules.erase(std::unique(rules.begin(), rules.end()), rules.end());
+        if (rules_) {
+            std::vector<size_t> selected;
+            for (std::vector<size_t>::const_iterator i = rules.begin(); i != rules.end(); ++i) {
+                if ((*rules_)[*i]) selected.push_back(*i);
+            }
+            rules.swap(selected);
+        }
+        return rules;
+    }
+
+    std::vector<bool> Converter::selectRules(const std::vector<std::string>& keys)
     {
+        const RuleIndex& index = ruleIndex();
+        std::vector<bool> rules(EXV_COUNTOF(conversion_), false);
+        for (std::vector<std::string>::const_iterator k = keys.begin(); k != keys.end(); ++k) {
+            std::string key;
+            if      (k->compare(0, 5, "Exif.") == 0) key = ExifKey(*k).key();
+            else if (k->compare(0, 5, "Iptc.") == 0) key = IptcKey(*k).key();
+            else                                     key = XmpKey(*k).key();
+            std::map<std::string, std::vector<size_t> >::const_iterator pos = index.rules_.find(key);
+            if (pos == index.rules_.end()) continue;
+            for (std::vector<size_t>::const_iterator i = pos->second.begin(); i != pos->second.end(); ++i) {
+                rules[*i] = true;
+            }
+        }
+        return rules;
     }
 
     void Converter::cnvToXmp()
     {
-        for (unsigned int i = 0; i < EXV_COUNTOF(conversion_); ++i) {
-            const Conversion& c = conversion_[i];
+        Trace trace("convert", "to XMP");
+        const std::vector<size_t> rules = activeRules();
+        for (std::vector<size_t>::const_iterator i = rules.begin(); i != rules.end(); ++i) {
+            const Conversion& c = conversion_[*i];
             if (   (c.metadataId_ == mdExif && exifData_)
                 || (c.metadataId_ == mdIptc && iptcData_)) {
                 EXV_CALL_MEMBER_FN(*this, c.key1ToKey2_)(c.key1_, c.key2_);
@@ -463,8 +590,10 @@ namespace Exiv2 {
 
     void Converter::cnvFromXmp()
     {
-        for (unsigned int i = 0; i < EXV_COUNTOF(conversion_); ++i) {
-            const Conversion& c = conversion_[i];
+        Trace trace("convert", "from XMP");
+        const std::vector<size_t> rules = activeRules();
+        for (std::vector<size_t>::const_iterator i = rules.begin(); i != rules.end(); ++i) {
+            const Conversion& c = conversion_[*i];
             if (   (c.metadataId_ == mdExif && exifData_)
                 || (c.metadataId_ == mdIptc && iptcData_)) {
                 EXV_CALL_MEMBER_FN(*this, c.key2ToKey1_)(c.key2_, c.key1_);
@@ -562,7 +691,14 @@ namespace Exiv2 {
         Exiv2::ExifData::iterator pos = exifData_->findKey(ExifKey(from));
         if (pos == exifData_->end()) return;
         if (!prepareXmpTarget(to)) return;
-        int year, month, day, hour, min, sec;
+        // Year, month, day, hour, minute and second
+        int f[6];
+        int& year = f[0];
+        int& month = f[1];
+        int& day = f[2];
+        int& hour = f[3];
+        int& min = f[4];
+        int& sec = f[5];
         std::string subsec;
         char buf[30];
 
@@ -574,7 +710,8 @@ namespace Exiv2 {
 #endif
                 return;
             }
-            if (sscanf(value.c_str(), "%d:%d:%d %d:%d:%d", &year, &month, &day, &hour, &min, &sec) != 6) {
+            if (   !parse_date_time(value.c_str(), ':', ' ', f)
+                && sscanf(value.c_str(), "%d:%d:%d %d:%d:%d", &year, &month, &day, &hour, &min, &sec) != 6) {
 #ifndef SUPPRESS_WARNINGS
                 EXV_WARNING << "Failed to convert " << from << " to " << to
                             << ", unable to parse '" << value << "'\n";
@@ -603,9 +740,7 @@ namespace Exiv2 {
 
             double dhour = pos->toFloat(0);
             double dmin = pos->toFloat(1);
-            // Hack: Need Value::toDouble
-            Rational r = pos->toRational(2);
-            double dsec = static_cast<double>(r.first)/r.second;
+            double dsec = pos->value().toDouble(2);
 
             if (!pos->value().ok()) {
 #ifndef SUPPRESS_WARNINGS
@@ -677,9 +812,14 @@ namespace Exiv2 {
         }
 
         if (subsec.size() > 10) subsec = subsec.substr(0, 10);
-        snprintf(buf, sizeof(buf), "%4d-%02d-%02dT%02d:%02d:%02d%s",
-                 year, month, day, hour, min, sec, subsec.c_str());
-        buf[sizeof(buf) - 1] = 0;
+        if (format_date_time(buf, '-', 'T', f)) {
+            std::memcpy(buf + 19, subsec.c_str(), subsec.size() + 1);
+        }
+        else {
+            snprintf(buf, sizeof(buf), "%4d-%02d-%02dT%02d:%02d:%02d%s",
+                     year, month, day, hour, min, sec, subsec.c_str());
+            buf[sizeof(buf) - 1] = 0;
+        }
 
         (*xmpData_)[to] = buf;
         if (erase_) exifData_->erase(pos);
@@ -754,16 +894,13 @@ namespace Exiv2 {
         }
         double deg[3];
         for (int i = 0; i < 3; ++i) {
-            const int32_t z = pos->toRational(i).first;
-            const int32_t d = pos->toRational(i).second;
-            if (d == 0) {
+            deg[i] = pos->value().toDouble(i);
+            if (!pos->value().ok()) {
 #ifndef SUPPRESS_WARNINGS
                 EXV_WARNING << "Failed to convert " << from << " to " << to << "\n";
 #endif
                 return;
             }
-            // Hack: Need Value::toDouble
-            deg[i] = static_cast<double>(z)/d;
         }
         double min = deg[0] * 60.0 + deg[1] + deg[2] / 60.0;
         int ideg = static_cast<int>(min / 60.0);
@@ -869,14 +1006,19 @@ namespace Exiv2 {
 
             SXMPUtils::ConvertToLocalTime(&datetime);
 
-            snprintf(buf, sizeof(buf), "%4d:%02d:%02d %02d:%02d:%02d",
-                     static_cast<int>(datetime.year),
-                     static_cast<int>(datetime.month),
-                     static_cast<int>(datetime.day),
-                     static_cast<int>(datetime.hour),
-                     static_cast<int>(datetime.minute),
-                     static_cast<int>(datetime.second));
-            buf[sizeof(buf) - 1] = 0;
+            const int f[6] = {
+                static_cast<int>(datetime.year),
+                static_cast<int>(datetime.month),
+                static_cast<int>(datetime.day),
+                static_cast<int>(datetime.hour),
+                static_cast<int>(datetime.minute),
+                static_cast<int>(datetime.second)
+            };
+            if (!format_date_time(buf, ':', ' ', f)) {
+                snprintf(buf, sizeof(buf), "%4d:%02d:%02d %02d:%02d:%02d",
+                         f[0], f[1], f[2], f[3], f[4], f[5]);
+                buf[sizeof(buf) - 1] = 0;
+            }
             (*exifData_)[to] = buf;
 
             if (datetime.nanoSecond) {
@@ -1177,18 +1319,26 @@ namespace Exiv2 {
         MD5_CTX    context;
         unsigned char digest[16];
 
+        // The first datum of each key, which is the one findKey() returns
+        const RuleIndex& index = ruleIndex();
+        std::map<std::string, ExifData::const_iterator> first;
+        for (ExifData::const_iterator i = exifData_->begin(); i != exifData_->end(); ++i) {
+            if (index.rules_.find(i->key()) == index.rules_.end()) continue;
+            first.insert(std::make_pair(i->key(), i));
+        }
+
         MD5Init ( &context );
         for (unsigned int i = 0; i < EXV_COUNTOF(conversion_); ++i) {
             const Conversion& c = conversion_[i];
             if (c.metadataId_ == mdExif) {
-                Exiv2::ExifKey key(c.key1_);
-                if (tiff && key.groupName() != "Image") continue;
-                if (!tiff && key.groupName() == "Image") continue;
+                if (tiff && !index.image1_[i]) continue;
+                if (!tiff && index.image1_[i]) continue;
 
                 if (!res.str().empty()) res << ',';
-                res << key.tag();
-                Exiv2::ExifData::iterator pos = exifData_->findKey(key);
-                if (pos == exifData_->end()) continue;
+                res << index.tags1_[i];
+                std::map<std::string, ExifData::const_iterator>::const_iterator f = first.find(index.keys1_[i]);
+                if (f == first.end()) continue;
+                ExifData::const_iterator pos = f->second;
                 DataBuf data(pos->size());
                 pos->copy(data.pData_, littleEndian /* FIXME ? */);
                 MD5Update ( &context, data.pData_, data.size_);
@@ -1220,6 +1370,7 @@ namespace Exiv2 {
 
     void Converter::syncExifWithXmp()
     {
+        Trace trace("convert", "sync Exif with XMP");
         Exiv2::XmpData::iterator td = xmpData_->findKey(XmpKey("Xmp.tiff.NativeDigest"));
         Exiv2::XmpData::iterator ed = xmpData_->findKey(XmpKey("Xmp.exif.NativeDigest"));
         if (td != xmpData_->end() && ed != xmpData_->end()) {
@@ -1256,6 +1407,89 @@ namespace Exiv2 {
         }
     }
 
+    MetadataConverter::MetadataConverter()
+        : iptcCharset_(0)
+    {
+    }
+
+    MetadataConverter::MetadataConverter(const std::vector<std::string>& keys)
+        : rules_(Converter::selectRules(keys)), iptcCharset_(0)
+    {
+    }
+
+    void MetadataConverter::setIptcCharset(const char* iptcCharset)
+    {
+        iptcCharset_ = iptcCharset;
+    }
+
+    void MetadataConverter::copyExifToXmp(const ExifData& exifData, XmpData& xmpData) const
+    {
+        Converter converter(const_cast<ExifData&>(exifData), xmpData);
+        if (!rules_.empty()) converter.setRules(&rules_);
+        converter.cnvToXmp();
+    }
+
+    void MetadataConverter::moveExifToXmp(ExifData& exifData, XmpData& xmpData) const
+    {
+        Converter converter(exifData, xmpData);
+        if (!rules_.empty()) converter.setRules(&rules_);
+        converter.setErase();
+        converter.cnvToXmp();
+    }
+
+    void MetadataConverter::copyXmpToExif(const XmpData& xmpData, ExifData& exifData) const
+    {
+        Converter converter(exifData, const_cast<XmpData&>(xmpData));
+        if (!rules_.empty()) converter.setRules(&rules_);
+        converter.cnvFromXmp();
+    }
+
+    void MetadataConverter::moveXmpToExif(XmpData& xmpData, ExifData& exifData) const
+    {
+        Converter converter(exifData, xmpData);
+        if (!rules_.empty()) converter.setRules(&rules_);
+        converter.setErase();
+        converter.cnvFromXmp();
+    }
+
+    void MetadataConverter::copyIptcToXmp(const IptcData& iptcData, XmpData& xmpData) const
+    {
+        const char* iptcCharset = iptcCharset_;
+        if (!iptcCharset) iptcCharset = iptcData.detectCharset();
+        if (!iptcCharset) iptcCharset = "ISO-8859-1";
+
+        Converter converter(const_cast<IptcData&>(iptcData), xmpData, iptcCharset);
+        if (!rules_.empty()) converter.setRules(&rules_);
+        converter.cnvToXmp();
+    }
+
+    void MetadataConverter::moveIptcToXmp(IptcData& iptcData, XmpData& xmpData) const
+    {
+        const char* iptcCharset = iptcCharset_;
+        if (!iptcCharset) iptcCharset = iptcData.detectCharset();
+        if (!iptcCharset) iptcCharset = "ISO-8859-1";
+
+        Converter converter(iptcData, xmpData, iptcCharset);
+        if (!rules_.empty()) converter.setRules(&rules_);
+        converter.setErase();
+        converter.cnvToXmp();
+    }
+
+    void MetadataConverter::copyXmpToIptc(const XmpData& xmpData, IptcData& iptcData) const
+    {
+        Converter converter(iptcData, const_cast<XmpData&>(xmpData));
+        if (!rules_.empty()) converter.setRules(&rules_);
+        converter.cnvFromXmp();
+    }
+
+    void MetadataConverter::moveXmpToIptc(XmpData& xmpData, IptcData& iptcData) const
+    {
+        Converter converter(iptcData, xmpData);
+        if (!rules_.empty()) converter.setRules(&rules_);
+        converter.setErase();
+        converter.cnvFromXmp();
+    }
+
     // *************************************************************************
     // free functions
     void copyExifToXmp(const ExifData& exifData, XmpData& xmpData)
@@ -1324,6 +1558,8 @@ namespace Exiv2 {
     bool convertStringCharset(std::string &str, const char* from, const char* to)
     {
         if (0 == strcmp(from, to)) return true; // nothing to do
+        // 7-bit text is the same in all ASCII compatible charsets
+        if (asciiCompatible(from) && asciiCompatible(to) && isAscii(str)) return true;
         bool ret = false;
 #if defined EXV_HAVE_ICONV
         ret = convertStringCharsetIconv(str, from, to);
@@ -1503,13 +1739,48 @@ namespace {
 
 #endif // defined WIN32 && !defined __CYGWIN__
 #if defined EXV_HAVE_ICONV
+    //! Conversion descriptors of a thread, by source and target charset
+    struct IconvCache {
+        ~IconvCache();
+        struct Entry {
+            std::string from_;
+            std::string to_;
+            iconv_t cd_;
+        };
+        std::vector<Entry> entries_;
+    };
+
+    IconvCache::~IconvCache()
+    {
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            if (entries_[i].cd_ != (iconv_t)(-1)) iconv_close(entries_[i].cd_);
+        }
+    }
+
+    iconv_t iconvDescriptor(const char* from, const char* to)
+    {
+        // Programs use a handful of charsets, a linear search is fine
+        thread_local IconvCache cache;
+        for (size_t i = 0; i < cache.entries_.size(); ++i) {
+            const IconvCache::Entry& e = cache.entries_[i];
+            if (e.from_ == from && e.to_ == to) {
+                // Reset the shift state left by the previous conversion
+                if (e.cd_ != (iconv_t)(-1)) iconv(e.cd_, 0, 0, 0, 0);
+                return e.cd_;
+            }
+        }
+        // Failures are cached as well, they are not going to succeed later
+        const IconvCache::Entry e = { from, to, iconv_open(to, from) };
+        cache.entries_.push_back(e);
+        return e.cd_;
+    }
+
     bool convertStringCharsetIconv(std::string& str, const char* from, const char* to)
     {
         if (0 == strcmp(from, to)) return true; // nothing to do
 
         bool ret = true;
-        iconv_t cd;
-        cd = iconv_open(to, from);
+        iconv_t cd = iconvDescriptor(from, to);
         if (cd == (iconv_t)(-1)) {
 #ifndef SUPPRESS_WARNINGS
             EXV_WARNING << "iconv_open: " << strError() << "\n";
@@ -1539,15 +1810,41 @@ namespace {
             }
             outstr.append(std::string(outbuf, outbytesProduced));
         }
-        if (cd != (iconv_t)(-1)) {
-            iconv_close(cd);
-        }
 
         if (ret) str = outstr;
         return ret;
     }
 
 #endif // EXV_HAVE_ICONV
+    bool asciiCompatible(const char* name)
+    {
+        // Charsets named in full and families which need a suffix (ISO-8859-1, CP1252, ...)
+        static const char* const names[] = {
+            "UTF-8", "UTF8", "ASCII", "US-ASCII", "ANSI_X3.4-1968", "MACINTOSH"
+        };
+        static const char* const families[] = {
+            "ISO-8859-", "ISO8859-", "ISO_8859-", "LATIN", "CP125", "WINDOWS-125"
+        };
+        std::string upper(name);
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        for (unsigned int i = 0; i < EXV_COUNTOF(names); ++i) {
+            if (upper == names[i]) return true;
+        }
+        for (unsigned int i = 0; i < EXV_COUNTOF(families); ++i) {
+            const size_t n = strlen(families[i]);
+            if (upper.size() > n && upper.compare(0, n, families[i]) == 0) return true;
+        }
+        return false;
+    }
+
+    bool isAscii(const std::string& str)
+    {
+        for (std::string::const_iterator i = str.begin(); i != str.end(); ++i) {
+            if (static_cast<unsigned char>(*i) > 0x7f) return false;
+        }
+        return true;
+    }
+
     bool getTextValue(std::string& value, const XmpData::iterator& pos)
     {
         if (pos->typeId() == langAlt) {
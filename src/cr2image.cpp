@@ -33,6 +33,7 @@
 #include "error.hpp"
 #include "futils.hpp"
 #include "i18n.h"                // NLS support.
+#include "stats_int.hpp"
 
 // + standard includes
 #include <iostream>
@@ -102,16 +103,23 @@ namespace Exiv2 {
             throw Error(kerNotAnImage, "CR2");
         }
         clearMetadata();
+        // fetch the directories together, remote files only map the blocks fetched before
+        if (io_->prefetches()) {
+            TiffParserWorker::prefetch(*io_);
+        }
         ByteOrder bo = Cr2Parser::decode(exifData_,
                                          iptcData_,
                                          xmpData_,
                                          io_->mmap(),
                                          (uint32_t) io_->size());
         setByteOrder(bo);
+        releasePackets();
     } // Cr2Image::readMetadata
 
     void Cr2Image::writeMetadata()
     {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
 #ifdef DEBUG
         std::cerr << "Writing CR2 file " << io_->path() << "\n";
 #endif
@@ -134,7 +142,7 @@ namespace Exiv2 {
             bo = littleEndian;
         }
         setByteOrder(bo);
-        Cr2Parser::encode(*io_, pData, size, bo, exifData_, iptcData_, xmpData_); // may throw
+        Cr2Parser::encode(*io_, pData, size, bo, exifData_, iptcData(), xmpData()); // may throw
     } // Cr2Image::writeMetadata
 
     ByteOrder Cr2Parser::decode(
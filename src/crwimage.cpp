@@ -29,11 +29,13 @@
 
 #include "crwimage.hpp"
 #include "crwimage_int.hpp"
+#include "tiffimage_int.hpp"
 #include "error.hpp"
 #include "futils.hpp"
 #include "value.hpp"
 #include "tags.hpp"
 #include "tags_int.hpp"
+#include "stats_int.hpp"
 
 // + standard includes
 #include <iostream>
@@ -101,40 +103,38 @@ namespace Exiv2 {
             throw Error(kerNotACrwImage);
         }
         clearMetadata();
-        DataBuf file( (long) io().size());
-        io_->read(file.pData_,file.size_);
-
         CrwParser::decode(this, io_->mmap(), (uint32_t) io_->size());
 
     } // CrwImage::readMetadata
 
     void CrwImage::writeMetadata()
     {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
 #ifdef DEBUG
         std::cerr << "Writing CRW file " << io_->path() << "\n";
 #endif
-        // Read existing image
-        DataBuf buf;
+        BasicIo::UniquePtr tempIo;
         if (io_->open() == 0) {
             IoCloser closer(*io_);
-            // Ensure that this is the correct image type
+            // Ensure that this is the correct image type. The existing image
+            // is mapped, the entries refer to it until they are written
+            const byte* pData = 0;
+            uint32_t size = 0;
             if (isCrwType(*io_, false)) {
-                // Read the image into a memory buffer
-                buf.alloc((long) io_->size());
-                io_->read(buf.pData_, buf.size_);
-                if (io_->error() || io_->eof()) {
-                    buf.reset();
-                }
+                pData = io_->mmap();
+                size = static_cast<uint32_t>(io_->size());
             }
+            // the new image has about the same size
+            tempIo = Internal::TiffParserWorker::createTempIo(*io_, size);
+            CrwParser::encode(*tempIo, pData, size, this);
+        }
+        else {
+            tempIo.reset(new MemIo);
+            CrwParser::encode(*tempIo, 0, 0, this);
         }
 
-        Blob blob;
-        CrwParser::encode(blob, buf.pData_, buf.size_, this);
-
-        // Write new buffer to file
-        MemIo::UniquePtr tempIo(new MemIo);
-        assert(tempIo.get() != 0);
-        tempIo->write((blob.size() > 0 ? &blob[0] : 0), static_cast<long>(blob.size()));
+        // Write new image to file
         io_->close();
         io_->transfer(*tempIo); // may throw
 
@@ -167,6 +167,21 @@ namespace Exiv2 {
               uint32_t  size,
         const CrwImage* pCrwImage
     )
+    {
+        MemIo io;
+        encode(io, pData, size, pCrwImage);
+        if (io.size() > 0) {
+            append(blob, io.mmap(), static_cast<uint32_t>(io.size()));
+        }
+
+    } // CrwParser::encode
+
+    void CrwParser::encode(
+              BasicIo&  io,
+        const byte*     pData,
+              uint32_t  size,
+        const CrwImage* pCrwImage
+    )
     {
         // Parse image, starting with a CIFF header component
         CiffHeader::UniquePtr head(new CiffHeader);
@@ -175,9 +190,9 @@ namespace Exiv2 {
         }
 
         // Encode Exif tags from image into the CRW parse tree and write the
-        // structure to the binary image blob
+        // structure to the binary image
         CrwMap::encode(head.get(), *pCrwImage);
-        head->write(blob);
+        head->write(io);
 
     } // CrwParser::encode
 
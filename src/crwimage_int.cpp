@@ -4,9 +4,12 @@
 #include "timegm.h"
 #include "unused.h"
 #include "error.hpp"
+#include "basicio.hpp"
 
 #include <cassert>
+#include <cstring>
 #include <ctime>
+#include <map>
 
 // *****************************************************************************
 // local declarations
@@ -27,6 +30,9 @@ namespace {
         // DATA
         static const OmList omList_[];
     }; // class RotationMap
+
+    //! Write \em size bytes from \em pData to \em io, throw if that fails
+    void writeData(Exiv2::BasicIo& io, const Exiv2::byte* pData, uint32_t size);
 }
 
 // *****************************************************************************
@@ -68,6 +74,14 @@ namespace {
         }
         return d;
     }
+
+    void writeData(Exiv2::BasicIo& io, const Exiv2::byte* pData, uint32_t size)
+    {
+        if (size == 0) return;
+        if (io.write(pData, static_cast<long>(size)) != static_cast<long>(size)) {
+            throw Exiv2::Error(Exiv2::kerImageWriteFailed);
+        }
+    }
     //! @endcond
 }
 
@@ -135,8 +149,8 @@ namespace Exiv2 {
             |
            3004
 
-      The array is arranged bottom-up so that starting with a directory at the
-      bottom, the (unique) path to root can be determined in a single loop.
+      Each directory has a unique parent, CrwMap::loadStack() follows them
+      from a directory at the bottom up to root.
     */
     const CrwSubDir CrwMap::crwSubDir_[] = {
         // dir,   parent
@@ -331,56 +345,56 @@ namespace Exiv2 {
         }
     } // CiffDirectory::doDecode
 
-    void CiffHeader::write(Blob& blob) const
+    void CiffHeader::write(BasicIo& io) const
     {
         assert(   byteOrder_ == littleEndian
                || byteOrder_ == bigEndian);
+        byte buf[14];
         if (byteOrder_ == littleEndian) {
-            blob.push_back('I');
-            blob.push_back('I');
+            buf[0] = 'I';
+            buf[1] = 'I';
         }
         else {
-            blob.push_back('M');
-            blob.push_back('M');
+            buf[0] = 'M';
+            buf[1] = 'M';
         }
         uint32_t o = 2;
-        byte buf[4];
-        ul2Data(buf, offset_, byteOrder_);
-        append(blob, buf, 4);
+        ul2Data(buf + o, offset_, byteOrder_);
         o += 4;
-        append(blob, reinterpret_cast<const byte*>(signature_), 8);
+        std::memcpy(buf + o, signature_, 8);
         o += 8;
+        writeData(io, buf, o);
         // Pad as needed
         if (pPadding_) {
             assert(padded_ == offset_ - o);
-            append(blob, pPadding_, padded_);
+            writeData(io, pPadding_, padded_);
         }
         else {
-            for (uint32_t i = o; i < offset_; ++i) {
-                blob.push_back(0);
-                ++o;
+            std::memset(buf, 0x0, sizeof(buf));
+            for (; o < offset_; ++o) {
+                writeData(io, buf, 1);
             }
         }
         if (pRootDir_) {
-            pRootDir_->write(blob, byteOrder_, offset_);
+            pRootDir_->write(io, byteOrder_, offset_);
         }
     }
 
-    uint32_t CiffComponent::write(Blob&     blob,
+    uint32_t CiffComponent::write(BasicIo&  io,
                                   ByteOrder byteOrder,
                                   uint32_t  offset)
     {
-        return doWrite(blob, byteOrder, offset);
+        return doWrite(io, byteOrder, offset);
     }
 
-    uint32_t CiffEntry::doWrite(Blob&     blob,
+    uint32_t CiffEntry::doWrite(BasicIo&  io,
                                 ByteOrder /*byteOrder*/,
                                 uint32_t  offset)
     {
-        return writeValueData(blob, offset);
+        return writeValueData(io, offset);
     } // CiffEntry::doWrite
 
-    uint32_t CiffComponent::writeValueData(Blob& blob, uint32_t offset)
+    uint32_t CiffComponent::writeValueData(BasicIo& io, uint32_t offset)
     {
         if (dataLocation() == valueData) {
 #ifdef DEBUG
@@ -388,18 +402,20 @@ namespace Exiv2 {
                       << ", " << std::dec << size_ << " Bytes\n";
 #endif
             offset_ = offset;
-            append(blob, pData_, size_);
+            // The data is written straight from the source, also for the image data
+            writeData(io, pData_, size_);
             offset += size_;
             // Pad the value to an even number of bytes
             if (size_ % 2 == 1) {
-                blob.push_back(0);
+                const byte pad = 0;
+                writeData(io, &pad, 1);
                 ++offset;
             }
         }
         return offset;
     } // CiffComponent::writeValueData
 
-    uint32_t CiffDirectory::doWrite(Blob&     blob,
+    uint32_t CiffDirectory::doWrite(BasicIo&  io,
                                     ByteOrder byteOrder,
                                     uint32_t  offset)
     {
@@ -413,25 +429,25 @@ namespace Exiv2 {
         const Components::iterator b = components_.begin();
         const Components::iterator e = components_.end();
         for (Components::iterator i = b; i != e; ++i) {
-            dirOffset = (*i)->write(blob, byteOrder, dirOffset);
+            dirOffset = (*i)->write(io, byteOrder, dirOffset);
         }
         const uint32_t dirStart = dirOffset;
 
         // Number of directory entries
         byte buf[4];
         us2Data(buf, static_cast<uint16_t>(components_.size()), byteOrder);
-        append(blob, buf, 2);
+        writeData(io, buf, 2);
         dirOffset += 2;
 
         // Directory entries
         for (Components::iterator i = b; i != e; ++i) {
-            (*i)->writeDirEntry(blob, byteOrder);
+            (*i)->writeDirEntry(io, byteOrder);
             dirOffset += 10;
         }
 
         // Offset of directory
         ul2Data(buf, dirStart, byteOrder);
-        append(blob, buf, 4);
+        writeData(io, buf, 4);
         dirOffset += 4;
 
         // Update directory entry
@@ -446,7 +462,7 @@ namespace Exiv2 {
         return offset + dirOffset;
     } // CiffDirectory::doWrite
 
-    void CiffComponent::writeDirEntry(Blob& blob, ByteOrder byteOrder) const
+    void CiffComponent::writeDirEntry(BasicIo& io, ByteOrder byteOrder) const
     {
 #ifdef DEBUG
         std::cout << "  Directory entry for tag 0x"
@@ -454,20 +470,15 @@ namespace Exiv2 {
                   << "), " << std::dec << size_
                   << " Bytes, Offset is " << offset_ << "\n";
 #endif
-        byte buf[4];
+        byte buf[10];
 
         DataLocId dl = dataLocation();
         assert(dl == directoryData || dl == valueData);
 
         if (dl == valueData) {
             us2Data(buf, tag_, byteOrder);
-            append(blob, buf, 2);
-
-            ul2Data(buf, size_, byteOrder);
-            append(blob, buf, 4);
-
-            ul2Data(buf, offset_, byteOrder);
-            append(blob, buf, 4);
+            ul2Data(buf + 2, size_, byteOrder);
+            ul2Data(buf + 6, offset_, byteOrder);
         }
 
         if (dl == directoryData) {
@@ -475,14 +486,11 @@ namespace Exiv2 {
             assert(size_ <= 8);
 
             us2Data(buf, tag_, byteOrder);
-            append(blob, buf, 2);
-            // Copy value instead of size and offset
-            append(blob, pData_, size_);
-            // Pad with 0s
-            for (uint32_t i = size_; i < 8; ++i) {
-                blob.push_back(0);
-            }
+            // Copy value instead of size and offset and pad with 0s
+            std::memset(buf + 2, 0x0, 8);
+            std::memcpy(buf + 2, pData_, size_);
         }
+        writeData(io, buf, 10);
     } // CiffComponent::writeDirEntry
 
     void CiffHeader::print(std::ostream& os, const std::string& prefix) const
@@ -659,6 +667,7 @@ namespace Exiv2 {
         */
         const Components::iterator b = components_.begin();
         const Components::iterator e = components_.end();
+        CiffComponent* cc = nullptr;
 
         if (!crwDirs.empty()) {
             CrwSubDir csd = crwDirs.top();
@@ -666,35 +675,35 @@ namespace Exiv2 {
             // Find the directory
             for (Components::iterator i = b; i != e; ++i) {
                 if ((*i)->tag() == csd.crwDir_) {
-                    cc_ = *i;
+                    cc = *i;
                     break;
                 }
             }
-            if (cc_ == 0) {
+            if (cc == 0) {
                 // Directory doesn't exist yet, add it
-                m_ = UniquePtr(new CiffDirectory(csd.crwDir_, csd.parent_));
-                cc_ = m_.get();
-                add(std::move(m_));
+                UniquePtr m(new CiffDirectory(csd.crwDir_, csd.parent_));
+                cc = m.get();
+                add(std::move(m));
             }
             // Recursive call to next lower level directory
-            cc_ = cc_->add(crwDirs, crwTagId);
+            cc = cc->add(crwDirs, crwTagId);
         }
         else {
             // Find the tag
             for (Components::iterator i = b; i != e; ++i) {
                 if ((*i)->tagId() == crwTagId) {
-                    cc_ = *i;
+                    cc = *i;
                     break;
                 }
             }
-            if (cc_ == 0) {
+            if (cc == 0) {
                 // Tag doesn't exist yet, add it
-                m_ = UniquePtr(new CiffEntry(crwTagId, tag()));
-                cc_ = m_.get();
-                add(std::move(m_));
+                UniquePtr m(new CiffEntry(crwTagId, tag()));
+                cc = m.get();
+                add(std::move(m));
             }
         }
-        return cc_;
+        return cc;
     }
 
     void CiffHeader::remove(uint16_t crwTagId, uint16_t crwDir)
@@ -780,13 +789,17 @@ namespace Exiv2 {
 
     const CrwMapping* CrwMap::crwMapping(uint16_t crwDir, uint16_t crwTagId)
     {
-        for (int i = 0; crwMapping_[i].ifdId_ != ifdIdNotSet; ++i) {
-            if (   crwMapping_[i].crwDir_ == crwDir
-                && crwMapping_[i].crwTagId_ == crwTagId) {
-                return &(crwMapping_[i]);
+        // The first entry in table order for each directory and tag
+        typedef std::map<uint32_t, const CrwMapping*> Index;
+        static const Index index = [] {
+            Index idx;
+            for (const CrwMapping* cmi = crwMapping_; cmi->ifdId_ != ifdIdNotSet; ++cmi) {
+                idx.insert(std::make_pair(static_cast<uint32_t>(cmi->crwDir_) << 16 | cmi->crwTagId_, cmi));
             }
-        }
-        return 0;
+            return idx;
+        }();
+        Index::const_iterator pos = index.find(static_cast<uint32_t>(crwDir) << 16 | crwTagId);
+        return pos == index.end() ? 0 : pos->second;
     } // CrwMap::crwMapping
 
     void CrwMap::decode0x0805(const CiffComponent& ciffComponent,
@@ -982,11 +995,19 @@ namespace Exiv2 {
 
     void CrwMap::loadStack(CrwDirs& crwDirs, uint16_t crwDir)
     {
-        for (int i = 0; crwSubDir_[i].crwDir_ != 0xffff; ++i) {
-            if (crwSubDir_[i].crwDir_ == crwDir) {
-                crwDirs.push(crwSubDir_[i]);
-                crwDir = crwSubDir_[i].parent_;
+        // The first entry in table order for each directory
+        typedef std::map<uint16_t, const CrwSubDir*> Index;
+        static const Index index = [] {
+            Index idx;
+            for (const CrwSubDir* csd = crwSubDir_; csd->crwDir_ != 0xffff; ++csd) {
+                idx.insert(std::make_pair(csd->crwDir_, csd));
             }
+            return idx;
+        }();
+        // The hierarchy has no cycles, the walk ends at the parent of root
+        for (Index::const_iterator pos = index.find(crwDir); pos != index.end(); pos = index.find(crwDir)) {
+            crwDirs.push(*pos->second);
+            crwDir = pos->second->parent_;
         }
     } // CrwMap::loadStack
 
@@ -155,27 +155,28 @@ namespace Exiv2 {
                   uint32_t    start,
                   ByteOrder   byteOrder);
         /*!
-          @brief Write the metadata from the raw metadata component to the
-                 binary image \em blob. This method may append to the blob.
+          @brief Write the metadata from the raw metadata component to
+                 \em io. This method may append to the output.
 
-          @param blob      Binary image to add metadata to
+          @param io        IO instance to write the binary image to
           @param byteOrder Byte order
           @param offset    Current offset
 
           @return New offset
          */
-        uint32_t write(Blob& blob, ByteOrder byteOrder, uint32_t offset);
+        uint32_t write(BasicIo& io, ByteOrder byteOrder, uint32_t offset);
         /*!
           @brief Writes the entry's value if size is larger than eight bytes. If
                  needed, the value is padded with one 0 byte to make the number
-                 of bytes written to the blob even. The offset of the component
-                 is set to the offset passed in.
-          @param blob The binary image to write to.
+                 of bytes written to \em io even. The offset of the component
+                 is set to the offset passed in. The value is written straight
+                 from the data the component refers to, without a copy.
+          @param io The IO instance to write the binary image to.
           @param offset Offset from the start of the directory for this entry.
 
           @return New offset.
          */
-        uint32_t writeValueData(Blob& blob, uint32_t offset);
+        uint32_t writeValueData(BasicIo& io, uint32_t offset);
         //! Set the directory tag for this component.
         void setDir(uint16_t dir)       { dir_ = dir; }
         //! Set the data value of the entry.
@@ -208,11 +209,11 @@ namespace Exiv2 {
                    ByteOrder byteOrder,
                    const std::string& prefix ="") const;
         /*!
-          @brief Write a directory entry for the component to the \em blob.
+          @brief Write a directory entry for the component to \em io.
                  If the size of the data is not larger than 8 bytes, the
                  data is written to the directory entry.
          */
-        void writeDirEntry(Blob& blob, ByteOrder byteOrder) const;
+        void writeDirEntry(BasicIo& io, ByteOrder byteOrder) const;
         //! Return the tag of the directory containing this component
         uint16_t dir()           const { return dir_; }
 
@@ -269,7 +270,7 @@ namespace Exiv2 {
                             uint32_t    start,
                             ByteOrder   byteOrder);
         //! Implements write()
-        virtual uint32_t doWrite(Blob&     blob,
+        virtual uint32_t doWrite(BasicIo&  io,
                                  ByteOrder byteOrder,
                                  uint32_t  offset) =0;
         //! Set the size of the data area.
@@ -333,7 +334,7 @@ namespace Exiv2 {
           @brief Implements write(). Writes only the value data of the entry,
                  using writeValueData().
          */
-        uint32_t doWrite(Blob& blob, ByteOrder byteOrder, uint32_t offset) override;
+        uint32_t doWrite(BasicIo& io, ByteOrder byteOrder, uint32_t offset) override;
         //@}
 
         //! @name Accessors
@@ -350,9 +351,9 @@ namespace Exiv2 {
         //! @name Creators
         //@{
         //! Default constructor
-        CiffDirectory() : cc_(nullptr) {}
+        CiffDirectory() {}
         //! Constructor taking a tag and directory
-        CiffDirectory(uint16_t tag, uint16_t dir) : CiffComponent(tag, dir), cc_(nullptr) {}
+        CiffDirectory(uint16_t tag, uint16_t dir) : CiffComponent(tag, dir) {}
 
         //! Virtual destructor
         ~CiffDirectory() override;
@@ -385,9 +386,9 @@ namespace Exiv2 {
         void doRemove(CrwDirs& crwDirs, uint16_t crwTagId) override;
         /*!
           @brief Implements write(). Writes the complete Ciff directory to
-                 the blob.
+                 \em io.
          */
-        uint32_t doWrite(Blob& blob, ByteOrder byteOrder, uint32_t offset) override;
+        uint32_t doWrite(BasicIo& io, ByteOrder byteOrder, uint32_t offset) override;
         // See base class comment
         void doRead(const byte* pData, uint32_t size, uint32_t start, ByteOrder byteOrder) override;
         //@}
@@ -410,8 +411,6 @@ namespace Exiv2 {
     private:
         // DATA
         Components components_; //!< List of components in this dir
-        UniquePtr    m_; // used by recursive doAdd
-        CiffComponent* cc_;
 
     }; // class CiffDirectory
 
@@ -479,14 +478,14 @@ namespace Exiv2 {
         //! @name Accessors
         //@{
         /*!
-          @brief Write the CRW image to the binary image \em blob, starting with
-                 the Ciff header. This method appends to the blob.
+          @brief Write the CRW image to \em io, starting with the Ciff header.
+                 This method appends to the output.
 
-          @param blob Binary image to add to.
+          @param io IO instance to write the binary image to.
 
           @throw Error If the image cannot be written.
          */
-        void write(Blob& blob) const;
+        void write(BasicIo& io) const;
         /*!
           @brief Decode the CRW image and add it to \em image.
 
@@ -602,13 +601,13 @@ namespace Exiv2 {
         /*!
           @brief Load the stack: loop through the CRW subdirs hierarchy and push
                  all directories on the path from \em crwDir to root onto the
-                 stack \em crwDirs. Requires the subdirs array to be arranged in
-                 bottom-up order to be able to finish in only one pass.
+                 stack \em crwDirs. The directories are looked up in an index
+                 of the subdirs array, which is built on first use.
          */
         static void loadStack(CrwDirs& crwDirs, uint16_t crwDir);
 
     private:
-        //! Return conversion information for one \em crwDir and \em crwTagId
+        //! Return conversion information for one \em crwDir and \em crwTagId, from an index of the mapping table
         static const CrwMapping* crwMapping(uint16_t crwDir, uint16_t crwTagId);
 
         /*!
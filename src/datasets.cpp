@@ -35,6 +35,7 @@
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <unordered_map>
 
 // *****************************************************************************
 // class member definitions
@@ -451,28 +452,78 @@ namespace Exiv2 {
         0
     };
 
+    namespace {
+        /*!
+          @brief Lookup tables for the datasets of the envelope and application
+                 records. They are built once, on first use, and replace linear
+                 scans of the dataset lists. The first entry always wins.
+         */
+        class DataSetLookup {
+        public:
+            //! Return the lookup tables, building them on the first call
+            static const DataSetLookup& instance()
+            {
+                static const DataSetLookup dataSetLookup;
+                return dataSetLookup;
+            }
+
+            //! Return the index of dataset \em number in record \em recordId, -1 if there is none
+            int index(uint16_t number, uint16_t recordId) const
+            {
+                if (number >= numbers_) return -1;
+                return byNumber_[recordId][number];
+            }
+            //! Return the index of dataset \em dataSetName in record \em recordId, -1 if there is none
+            int index(const std::string& dataSetName, uint16_t recordId) const
+            {
+                Names::const_iterator i = byName_[recordId].find(dataSetName);
+                return i == byName_[recordId].end() ? -1 : i->second;
+            }
+
+        private:
+            typedef std::unordered_map<std::string, int> Names;
+            //! Dataset numbers are a single byte in the IIM
+            static const uint16_t numbers_ = 256;
+            //! Number of records, the record id is used as the index
+            static const uint16_t records_ = IptcDataSets::application2 + 1;
+
+            //! Constructor, builds the lookup tables
+            DataSetLookup()
+            {
+                for (uint16_t r = 0; r < records_; ++r) {
+                    for (uint16_t n = 0; n < numbers_; ++n) byNumber_[r][n] = -1;
+                }
+                add(IptcDataSets::envelope, IptcDataSets::envelopeRecordList());
+                add(IptcDataSets::application2, IptcDataSets::application2RecordList());
+            }
+            //! Add the datasets of \em dataSet, a 0xffff-terminated list, for record \em recordId
+            void add(uint16_t recordId, const DataSet* dataSet)
+            {
+                for (int idx = 0; dataSet[idx].number_ != 0xffff; ++idx) {
+                    const uint16_t number = dataSet[idx].number_;
+                    if (number < numbers_ && byNumber_[recordId][number] == -1) {
+                        byNumber_[recordId][number] = idx;
+                    }
+                    byName_[recordId].insert(std::make_pair(std::string(dataSet[idx].name_), idx));
+                }
+            }
+
+            // DATA
+            int byNumber_[records_][numbers_];  //!< Dataset indexes by record id and number
+            Names byName_[records_];            //!< Dataset indexes by record id and name
+        };
+    }
+
     int IptcDataSets::dataSetIdx(uint16_t number, uint16_t recordId)
     {
         if( recordId != envelope && recordId != application2 ) return -1;
-        const DataSet* dataSet = records_[recordId];
-        if (dataSet == 0) return -1;
-        int idx;
-        for (idx = 0; dataSet[idx].number_ != number; ++idx) {
-            if (dataSet[idx].number_ == 0xffff) return -1;
-        }
-        return idx;
+        return DataSetLookup::instance().index(number, recordId);
     }
 
     int IptcDataSets::dataSetIdx(const std::string& dataSetName, uint16_t recordId)
     {
         if( recordId != envelope && recordId != application2 ) return -1;
-        const DataSet* dataSet = records_[recordId];
-        if (dataSet == 0) return -1;
-        int idx;
-        for (idx = 0; dataSet[idx].name_ != dataSetName; ++idx) {
-            if (dataSet[idx].number_ == 0xffff) return -1;
-        }
-        return idx;
+        return DataSetLookup::instance().index(dataSetName, recordId);
     }
 
     TypeId IptcDataSets::dataSetType(uint16_t number, uint16_t recordId)
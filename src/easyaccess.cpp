@@ -23,27 +23,502 @@
 // *****************************************************************************
 // included header files
 #include "easyaccess.hpp"
+#include "image.hpp"
+
+// + standard includes
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 // *****************************************************************************
 namespace {
 
     using namespace Exiv2;
 
+    //! Keys searched by orientation(), in order of preference
+    const char* orientationKeys[] = {
+        "Exif.Image.Orientation",
+        "Exif.Panasonic.Rotation",
+        "Exif.MinoltaCs5D.Rotation",
+        "Exif.MinoltaCs5D.Rotation2",
+        "Exif.MinoltaCs7D.Rotation",
+        "Exif.Sony1MltCsA100.Rotation",
+        "Exif.Sony1Cs.Rotation",
+        "Exif.Sony2Cs.Rotation",
+        "Exif.Sony1Cs2.Rotation",
+        "Exif.Sony2Cs2.Rotation",
+        "Exif.Sony1MltCsA100.Rotation"
+    };
+
+    //! Keys searched by isoSpeed(), in order of preference
+    const char* isoSpeedKeys[] = {
+        "Exif.Photo.ISOSpeedRatings",
+        "Exif.Image.ISOSpeedRatings",
+        "Exif.CanonSi.ISOSpeed",
+        "Exif.CanonCs.ISOSpeed",
+        "Exif.Nikon1.ISOSpeed",
+        "Exif.Nikon2.ISOSpeed",
+        "Exif.Nikon3.ISOSpeed",
+        "Exif.NikonIi.ISO",
+        "Exif.NikonIi.ISO2",
+        "Exif.MinoltaCsNew.ISOSetting",
+        "Exif.MinoltaCsOld.ISOSetting",
+        "Exif.MinoltaCs5D.ISOSpeed",
+        "Exif.MinoltaCs7D.ISOSpeed",
+        "Exif.Sony1Cs.ISOSetting",
+        "Exif.Sony2Cs.ISOSetting",
+        "Exif.Sony1Cs2.ISOSetting",
+        "Exif.Sony2Cs2.ISOSetting",
+        "Exif.Sony1MltCsA100.ISOSetting",
+        "Exif.Pentax.ISO",
+        "Exif.PentaxDng.ISO",
+        "Exif.Olympus.ISOSpeed",
+        "Exif.Samsung2.ISO",
+        "Exif.Casio.ISO",
+        "Exif.Casio2.ISO",
+        "Exif.Casio2.ISOSpeed"
+    };
+
+    //! Keys searched by flashBias(), in order of preference
+    const char* flashBiasKeys[] = {
+        "Exif.CanonSi.FlashBias",
+        "Exif.Panasonic.FlashBias",
+        "Exif.Olympus.FlashBias",
+        "Exif.OlympusCs.FlashExposureComp",
+        "Exif.Minolta.FlashExposureComp",
+        "Exif.SonyMinolta.FlashExposureComp",
+        "Exif.Sony1.FlashExposureComp",
+        "Exif.Sony2.FlashExposureComp"
+    };
+
+    //! Keys searched by exposureMode(), in order of preference
+    const char* exposureModeKeys[] = {
+        "Exif.Photo.ExposureProgram",
+        "Exif.Image.ExposureProgram",
+        "Exif.CanonCs.ExposureProgram",
+        "Exif.MinoltaCs7D.ExposureMode",
+        "Exif.MinoltaCs5D.ExposureMode",
+        "Exif.MinoltaCsNew.ExposureMode",
+        "Exif.MinoltaCsOld.ExposureMode",
+        "Exif.Sony1MltCsA100.ExposureMode",
+        "Exif.Sony1Cs.ExposureProgram",
+        "Exif.Sony2Cs.ExposureProgram",
+        "Exif.Sigma.ExposureMode"
+    };
+
+    //! Keys searched by sceneMode(), in order of preference
+    const char* sceneModeKeys[] = {
+        "Exif.CanonCs.EasyMode",
+        "Exif.Fujifilm.PictureMode",
+        "Exif.MinoltaCsNew.SubjectProgram",
+        "Exif.MinoltaCsOld.SubjectProgram",
+        "Exif.Minolta.SceneMode",
+        "Exif.SonyMinolta.SceneMode",
+        "Exif.Sony1.SceneMode",
+        "Exif.Sony2.SceneMode",
+        "Exif.OlympusCs.SceneMode",
+        "Exif.Panasonic.ShootingMode",
+        "Exif.Panasonic.SceneMode",
+        "Exif.Pentax.PictureMode",
+        "Exif.PentaxDng.PictureMode",
+        "Exif.Photo.SceneCaptureType"
+    };
+
+    //! Keys searched by macroMode(), in order of preference
+    const char* macroModeKeys[] = {
+        "Exif.CanonCs.Macro",
+        "Exif.Fujifilm.Macro",
+        "Exif.Olympus.Macro",
+        "Exif.OlympusCs.MacroMode",
+        "Exif.Panasonic.Macro",
+        "Exif.MinoltaCsNew.MacroMode",
+        "Exif.MinoltaCsOld.MacroMode",
+        "Exif.Sony1.Macro",
+        "Exif.Sony2.Macro"
+    };
+
+    //! Keys searched by imageQuality(), in order of preference
+    const char* imageQualityKeys[] = {
+        "Exif.CanonCs.Quality",
+        "Exif.Fujifilm.Quality",
+        "Exif.Sigma.Quality",
+        "Exif.Nikon1.Quality",
+        "Exif.Nikon2.Quality",
+        "Exif.Nikon3.Quality",
+        "Exif.Olympus.Quality",
+        "Exif.OlympusCs.Quality",
+        "Exif.Panasonic.Quality",
+        "Exif.Minolta.Quality",
+        "Exif.MinoltaCsNew.Quality",
+        "Exif.MinoltaCsOld.Quality",
+        "Exif.MinoltaCs5D.Quality",
+        "Exif.MinoltaCs7D.Quality",
+        "Exif.Sony1MltCsA100.Quality",
+        "Exif.Sony1.JPEGQuality",
+        "Exif.Sony1.Quality",
+        "Exif.Sony1Cs.Quality",
+        "Exif.Sony2.JPEGQuality",
+        "Exif.Sony2.Quality",
+        "Exif.Sony2Cs.Quality",
+        "Exif.Casio.Quality",
+        "Exif.Casio2.QualityMode",
+        "Exif.Casio2.Quality"
+    };
+
+    //! Keys searched by whiteBalance(), in order of preference
+    const char* whiteBalanceKeys[] = {
+        "Exif.CanonSi.WhiteBalance",
+        "Exif.Fujifilm.WhiteBalance",
+        "Exif.Sigma.WhiteBalance",
+        "Exif.Nikon1.WhiteBalance",
+        "Exif.Nikon2.WhiteBalance",
+        "Exif.Nikon3.WhiteBalance",
+        "Exif.Olympus.WhiteBalance",
+        "Exif.OlympusCs.WhiteBalance",
+        "Exif.Panasonic.WhiteBalance",
+        "Exif.MinoltaCs5D.WhiteBalance",
+        "Exif.MinoltaCs7D.WhiteBalance",
+        "Exif.MinoltaCsNew.WhiteBalance",
+        "Exif.MinoltaCsOld.WhiteBalance",
+        "Exif.Minolta.WhiteBalance",
+        "Exif.Sony1MltCsA100.WhiteBalance",
+        "Exif.SonyMinolta.WhiteBalance",
+        "Exif.Sony1.WhiteBalance",
+        "Exif.Sony2.WhiteBalance",
+        "Exif.Sony1.WhiteBalance2",
+        "Exif.Sony2.WhiteBalance2",
+        "Exif.Casio.WhiteBalance",
+        "Exif.Casio2.WhiteBalance",
+        "Exif.Casio2.WhiteBalance2",
+        "Exif.Photo.WhiteBalance"
+    };
+
+    //! Keys searched by lensName(), in order of preference
+    const char* lensNameKeys[] = {
+        // Exif.Canon.LensModel only reports focal length.
+        // Try Exif.CanonCs.LensType first.
+        "Exif.CanonCs.LensType",
+        "Exif.Photo.LensModel",
+        "Exif.NikonLd1.LensIDNumber",
+        "Exif.NikonLd2.LensIDNumber",
+        "Exif.NikonLd3.LensIDNumber",
+        "Exif.Pentax.LensType",
+        "Exif.PentaxDng.LensType",
+        "Exif.Minolta.LensID",
+        "Exif.SonyMinolta.LensID",
+        "Exif.Sony1.LensID",
+        "Exif.Sony2.LensID",
+        "Exif.OlympusEq.LensType",
+        "Exif.Panasonic.LensType",
+        "Exif.Samsung2.LensType"
+    };
+
+    //! Keys searched by saturation(), in order of preference
+    const char* saturationKeys[] = {
+        "Exif.Photo.Saturation",
+        "Exif.CanonCs.Saturation",
+        "Exif.MinoltaCsNew.Saturation",
+        "Exif.MinoltaCsOld.Saturation",
+        "Exif.MinoltaCs7D.Saturation",
+        "Exif.MinoltaCs5D.Saturation",
+        "Exif.Fujifilm.Color",
+        "Exif.Nikon3.Saturation",
+        "Exif.Panasonic.Saturation",
+        "Exif.Pentax.Saturation",
+        "Exif.PentaxDng.Saturation",
+        "Exif.Sigma.Saturation",
+        "Exif.Casio.Saturation",
+        "Exif.Casio2.Saturation",
+        "Exif.Casio2.Saturation2"
+    };
+
+    //! Keys searched by sharpness(), in order of preference
+    const char* sharpnessKeys[] = {
+        "Exif.Photo.Sharpness",
+        "Exif.CanonCs.Sharpness",
+        "Exif.Fujifilm.Sharpness",
+        "Exif.MinoltaCsNew.Sharpness",
+        "Exif.MinoltaCsOld.Sharpness",
+        "Exif.MinoltaCs7D.Sharpness",
+        "Exif.MinoltaCs5D.Sharpness",
+        "Exif.Olympus.SharpnessFactor",
+        "Exif.Panasonic.Sharpness",
+        "Exif.Pentax.Sharpness",
+        "Exif.PentaxDng.Sharpness",
+        "Exif.Sigma.Sharpness",
+        "Exif.Casio.Sharpness",
+        "Exif.Casio2.Sharpness",
+        "Exif.Casio2.Sharpness2"
+    };
+
+    //! Keys searched by contrast(), in order of preference
+    const char* contrastKeys[] = {
+        "Exif.Photo.Contrast",
+        "Exif.CanonCs.Contrast",
+        "Exif.Fujifilm.Tone",
+        "Exif.MinoltaCsNew.Contrast",
+        "Exif.MinoltaCsOld.Contrast",
+        "Exif.MinoltaCs7D.Contrast",
+        "Exif.MinoltaCs5D.Contrast",
+        "Exif.Olympus.Contrast",
+        "Exif.Panasonic.Contrast",
+        "Exif.Pentax.Contrast",
+        "Exif.PentaxDng.Contrast",
+        "Exif.Sigma.Contrast",
+        "Exif.Casio.Contrast",
+        "Exif.Casio2.Contrast",
+        "Exif.Casio2.Contrast2"
+    };
+
+    //! Keys searched by sceneCaptureType(), in order of preference
+    const char* sceneCaptureTypeKeys[] = {
+        "Exif.Photo.SceneCaptureType",
+        "Exif.Olympus.SpecialMode"
+    };
+
+    //! Keys searched by meteringMode(), in order of preference
+    const char* meteringModeKeys[] = {
+        "Exif.Photo.MeteringMode",
+        "Exif.Image.MeteringMode",
+        "Exif.CanonCs.MeteringMode",
+        "Exif.Sony1MltCsA100.MeteringMode"
+    };
+
+    //! Keys searched by make(), in order of preference
+    const char* makeKeys[] = {
+        "Exif.Image.Make"
+    };
+
+    //! Keys searched by model(), in order of preference
+    const char* modelKeys[] = {
+        "Exif.Image.Model"
+    };
+
+    //! Keys searched by exposureTime(), in order of preference
+    const char* exposureTimeKeys[] = {
+        "Exif.Photo.ExposureTime",
+        "Exif.Image.ExposureTime",
+        "Exif.Samsung2.ExposureTime"
+    };
+
+    //! Keys searched by fNumber(), in order of preference
+    const char* fNumberKeys[] = {
+        "Exif.Photo.FNumber",
+        "Exif.Image.FNumber",
+        "Exif.Samsung2.FNumber"
+    };
+
+    //! Keys searched by subjectDistance(), in order of preference
+    const char* subjectDistanceKeys[] = {
+        "Exif.Photo.SubjectDistance",
+        "Exif.Image.SubjectDistance",
+        "Exif.CanonSi.SubjectDistance",
+        "Exif.CanonFi.FocusDistanceUpper",
+        "Exif.CanonFi.FocusDistanceLower",
+        "Exif.MinoltaCsNew.FocusDistance",
+        "Exif.Nikon1.FocusDistance",
+        "Exif.Nikon3.FocusDistance",
+        "Exif.NikonLd2.FocusDistance",
+        "Exif.NikonLd3.FocusDistance",
+        "Exif.Olympus.FocusDistance",
+        "Exif.OlympusFi.FocusDistance",
+        "Exif.Casio.ObjectDistance",
+        "Exif.Casio2.ObjectDistance"
+    };
+
+    //! Keys searched by serialNumber(), in order of preference
+    const char* serialNumberKeys[] = {
+        "Exif.Image.CameraSerialNumber",
+        "Exif.Canon.SerialNumber",
+        "Exif.Nikon3.SerialNumber",
+        "Exif.Nikon3.SerialNO",
+        "Exif.Fujifilm.SerialNumber",
+        "Exif.Olympus.SerialNumber2",
+        "Exif.Sigma.SerialNumber"
+    };
+
+    //! Keys searched by focalLength(), in order of preference
+    const char* focalLengthKeys[] = {
+        "Exif.Photo.FocalLength",
+        "Exif.Image.FocalLength",
+        "Exif.Canon.FocalLength",
+        "Exif.NikonLd2.FocalLength",
+        "Exif.NikonLd3.FocalLength",
+        "Exif.MinoltaCsNew.FocalLength",
+        "Exif.Pentax.FocalLength",
+        "Exif.PentaxDng.FocalLength",
+        "Exif.Casio2.FocalLength"
+    };
+
+    //! Keys searched by afPoint(), in order of preference
+    const char* afPointKeys[] = {
+        "Exif.CanonPi.AFPointsUsed",
+        "Exif.CanonPi.AFPointsUsed20D",
+        "Exif.CanonSi.AFPointUsed",
+        "Exif.CanonCs.AFPoint",
+        "Exif.MinoltaCs7D.AFPoints",
+        "Exif.Nikon1.AFFocusPos",
+        "Exif.NikonAf.AFPoint",
+        "Exif.NikonAf.AFPointsInFocus",
+        "Exif.NikonAf2.AFPointsUsed",
+        "Exif.NikonAf2.PrimaryAFPoint",
+        "Exif.OlympusFi.AFPoint",
+        "Exif.Pentax.AFPoint",
+        "Exif.Pentax.AFPointInFocus",
+        "Exif.PentaxDng.AFPoint",
+        "Exif.PentaxDng.AFPointInFocus",
+        "Exif.Sony1Cs.LocalAFAreaPoint",
+        "Exif.Sony2Cs.LocalAFAreaPoint",
+        "Exif.Sony1Cs2.LocalAFAreaPoint",
+        "Exif.Sony2Cs2.LocalAFAreaPoint",
+        "Exif.Sony1MltCsA100.LocalAFAreaPoint",
+        "Exif.Casio.AFPoint",
+        "Exif.Casio2.AFPointPosition"
+    };
+
+    //! Position of an easy access function in easyAccessFields
+    enum EasyAccessField {
+        efOrientation,
+        efIsoSpeed,
+        efFlashBias,
+        efExposureMode,
+        efSceneMode,
+        efMacroMode,
+        efImageQuality,
+        efWhiteBalance,
+        efLensName,
+        efSaturation,
+        efSharpness,
+        efContrast,
+        efSceneCaptureType,
+        efMeteringMode,
+        efMake,
+        efModel,
+        efExposureTime,
+        efFNumber,
+        efSubjectDistance,
+        efSerialNumber,
+        efFocalLength,
+        efAfPoint
+    };
+
+    //! An easy access function: its member of EasyAccessResult and the keys it searches
+    struct EasyAccessFieldInfo {
+        ExifData::const_iterator EasyAccessResult::* result_; //!< Member of the result
+        const char* const* keys_;               //!< Keys, in order of preference
+        size_t count_;                          //!< Number of keys
+    };
+
+    //! The easy access functions, in the order of EasyAccessField
+    const EasyAccessFieldInfo easyAccessFields[] = {
+        { &EasyAccessResult::orientation_, orientationKeys, EXV_COUNTOF(orientationKeys) },
+        { &EasyAccessResult::isoSpeed_, isoSpeedKeys, EXV_COUNTOF(isoSpeedKeys) },
+        { &EasyAccessResult::flashBias_, flashBiasKeys, EXV_COUNTOF(flashBiasKeys) },
+        { &EasyAccessResult::exposureMode_, exposureModeKeys, EXV_COUNTOF(exposureModeKeys) },
+        { &EasyAccessResult::sceneMode_, sceneModeKeys, EXV_COUNTOF(sceneModeKeys) },
+        { &EasyAccessResult::macroMode_, macroModeKeys, EXV_COUNTOF(macroModeKeys) },
+        { &EasyAccessResult::imageQuality_, imageQualityKeys, EXV_COUNTOF(imageQualityKeys) },
+        { &EasyAccessResult::whiteBalance_, whiteBalanceKeys, EXV_COUNTOF(whiteBalanceKeys) },
+        { &EasyAccessResult::lensName_, lensNameKeys, EXV_COUNTOF(lensNameKeys) },
+        { &EasyAccessResult::saturation_, saturationKeys, EXV_COUNTOF(saturationKeys) },
+        { &EasyAccessResult::sharpness_, sharpnessKeys, EXV_COUNTOF(sharpnessKeys) },
+        { &EasyAccessResult::contrast_, contrastKeys, EXV_COUNTOF(contrastKeys) },
+        { &EasyAccessResult::sceneCaptureType_, sceneCaptureTypeKeys, EXV_COUNTOF(sceneCaptureTypeKeys) },
+        { &EasyAccessResult::meteringMode_, meteringModeKeys, EXV_COUNTOF(meteringModeKeys) },
+        { &EasyAccessResult::make_, makeKeys, EXV_COUNTOF(makeKeys) },
+        { &EasyAccessResult::model_, modelKeys, EXV_COUNTOF(modelKeys) },
+        { &EasyAccessResult::exposureTime_, exposureTimeKeys, EXV_COUNTOF(exposureTimeKeys) },
+        { &EasyAccessResult::fNumber_, fNumberKeys, EXV_COUNTOF(fNumberKeys) },
+        { &EasyAccessResult::subjectDistance_, subjectDistanceKeys, EXV_COUNTOF(subjectDistanceKeys) },
+        { &EasyAccessResult::serialNumber_, serialNumberKeys, EXV_COUNTOF(serialNumberKeys) },
+        { &EasyAccessResult::focalLength_, focalLengthKeys, EXV_COUNTOF(focalLengthKeys) },
+        { &EasyAccessResult::afPoint_, afPointKeys, EXV_COUNTOF(afPointKeys) }
+    };
+
+    //! A list of keys, each resolved to its IFD id and tag
+    typedef std::vector<ExifKey> KeyList;
+
+    //! Resolve the first \em count \em keys to a KeyList
+    KeyList compileKeys(const char* const keys[], size_t count)
+    {
+        KeyList keyList;
+        keyList.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            keyList.emplace_back(keys[i]);
+        }
+        return keyList;
+    }
+
     /*!
-      @brief Search \em ed for a Metadatum specified by the \em keys.
-             The \em keys are searched in the order of their appearance, the
-             first available Metadatum is returned.
+      @brief The key lists of the easy access functions, compiled once, and
+             a map from the IFD id and tag of each key to the functions which
+             search it.
+     */
+    class EasyAccessPlan {
+    public:
+        //! A key of a function and its position in the key list of the function
+        struct Use {
+            EasyAccessField field_;             //!< The function
+            size_t          rank_;              //!< Position of the key
+        };
+
+        //! Return the plan, it is built on first use
+        static const EasyAccessPlan& instance()
+        {
+            static const EasyAccessPlan plan;
+            return plan;
+        }
+        //! Return the key list of the function \em field
+        const KeyList& keys(EasyAccessField field) const { return keys_[field]; }
+        //! Return the uses of the key of \em md, 0 if no function searches it
+        const std::vector<Use>* uses(const Exifdatum& md) const
+        {
+            Uses::const_iterator i = uses_.find(id(md.ifdId(), md.tag()));
+            return i == uses_.end() ? 0 : &i->second;
+        }
 
-      @param ed The %Exif metadata container to search
-      @param keys Array of keys to look for
-      @param count Number of elements in the array
+    private:
+        //! Map from the IFD id and tag of a key to its uses
+        typedef std::unordered_map<uint32_t, std::vector<Use> > Uses;
+
+        EasyAccessPlan()
+        {
+            for (size_t f = 0; f < EXV_COUNTOF(easyAccessFields); ++f) {
+                keys_[f] = compileKeys(easyAccessFields[f].keys_, easyAccessFields[f].count_);
+                for (size_t r = 0; r < keys_[f].size(); ++r) {
+                    const Use use = { static_cast<EasyAccessField>(f), r };
+                    uses_[id(keys_[f][r].ifdId(), keys_[f][r].tag())].push_back(use);
+                }
+            }
+        }
+        static uint32_t id(int ifdId, uint16_t tag)
+        {
+            return static_cast<uint32_t>(ifdId) << 16 | tag;
+        }
+
+        KeyList keys_[EXV_COUNTOF(easyAccessFields)];
+        Uses    uses_;
+    };
+
+    //! Return true if \em md has the IFD id and tag of \em key
+    bool matches(const ExifKey& key, const Exifdatum& md)
+    {
+        return key.ifdId() == md.ifdId() && key.tag() == md.tag();
+    }
+
+    /*!
+      @brief Search \em ed for a Metadatum specified by the \em keys.
+             The \em keys are searched in the order of their appearance,
+             starting at position \em first, the first available Metadatum
+             is returned.
      */
     ExifData::const_iterator findMetadatum(const ExifData& ed,
-                                           const char* keys[],
-                                           int count)
+                                           const KeyList& keys,
+                                           size_t first =0)
     {
-        for (int i = 0; i < count; ++i) {
-            ExifData::const_iterator pos = ed.findKey(ExifKey(keys[i]));
+        for (size_t i = first; i < keys.size(); ++i) {
+            ExifData::const_iterator pos = ed.findKey(keys[i]);
             if (pos != ed.end()) return pos;
         }
         return ed.end();
@@ -57,52 +532,11 @@ namespace Exiv2 {
 
     ExifData::const_iterator orientation(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Image.Orientation",
-            "Exif.Panasonic.Rotation",
-            "Exif.MinoltaCs5D.Rotation",
-            "Exif.MinoltaCs5D.Rotation2",
-            "Exif.MinoltaCs7D.Rotation",
-            "Exif.Sony1MltCsA100.Rotation",
-            "Exif.Sony1Cs.Rotation",
-            "Exif.Sony2Cs.Rotation",
-            "Exif.Sony1Cs2.Rotation",
-            "Exif.Sony2Cs2.Rotation",
-            "Exif.Sony1MltCsA100.Rotation"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efOrientation));
     }
 
     ExifData::const_iterator isoSpeed(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Photo.ISOSpeedRatings",
-            "Exif.Image.ISOSpeedRatings",
-            "Exif.CanonSi.ISOSpeed",
-            "Exif.CanonCs.ISOSpeed",
-            "Exif.Nikon1.ISOSpeed",
-            "Exif.Nikon2.ISOSpeed",
-            "Exif.Nikon3.ISOSpeed",
-            "Exif.NikonIi.ISO",
-            "Exif.NikonIi.ISO2",
-            "Exif.MinoltaCsNew.ISOSetting",
-            "Exif.MinoltaCsOld.ISOSetting",
-            "Exif.MinoltaCs5D.ISOSpeed",
-            "Exif.MinoltaCs7D.ISOSpeed",
-            "Exif.Sony1Cs.ISOSetting",
-            "Exif.Sony2Cs.ISOSetting",
-            "Exif.Sony1Cs2.ISOSetting",
-            "Exif.Sony2Cs2.ISOSetting",
-            "Exif.Sony1MltCsA100.ISOSetting",
-            "Exif.Pentax.ISO",
-            "Exif.PentaxDng.ISO",
-            "Exif.Olympus.ISOSpeed",
-            "Exif.Samsung2.ISO",
-            "Exif.Casio.ISO",
-            "Exif.Casio2.ISO",
-            "Exif.Casio2.ISOSpeed"
-        };
-
         struct SensKeyNameList {
             int count;
             const char* keys[3];
@@ -120,24 +554,30 @@ namespace Exiv2 {
             { 2, { "Exif.Photo.ISOSpeed", "Exif.Photo.RecommendedExposureIndex" }},
             { 3, { "Exif.Photo.ISOSpeed", "Exif.Photo.RecommendedExposureIndex", "Exif.Photo.StandardOutputSensitivity" }}
         };
+        static const std::vector<KeyList> sensitivityKeys = [] {
+            std::vector<KeyList> lists;
+            for (size_t i = 0; i < EXV_COUNTOF(sensitivityKey); ++i) {
+                lists.push_back(compileKeys(sensitivityKey[i].keys, sensitivityKey[i].count));
+            }
+            return lists;
+        }();
 
-        static const char* sensitivityType[] = {
-            "Exif.Photo.SensitivityType"
-        };
+        static const ExifKey sensitivityType("Exif.Photo.SensitivityType");
 
         // Find the first ISO value which is not "0"
-        const int cnt = EXV_COUNTOF(keys);
+        const KeyList& keys = EasyAccessPlan::instance().keys(efIsoSpeed);
+        const size_t cnt = keys.size();
         ExifData::const_iterator md = ed.end();
         long iso_val = -1;
-        for (int idx = 0; idx < cnt; ) {
-            md = findMetadatum(ed, keys + idx, cnt - idx);
+        for (size_t idx = 0; idx < cnt; ) {
+            md = findMetadatum(ed, keys, idx);
             if (md == ed.end()) break;
             std::ostringstream os;
             md->write(os, &ed);
             bool ok = false;
             iso_val = parseLong(os.str(), ok);
             if (ok && iso_val > 0) break;
-            while (strcmp(keys[idx++], md->key().c_str()) != 0 && idx < cnt) {}
+            while (!matches(keys[idx++], *md) && idx < cnt) {}
             md = ed.end();
         }
 
@@ -146,7 +586,7 @@ namespace Exiv2 {
         // ISO value (see EXIF 2.3 Annex G)
         long iso_tmp_val = -1;
         while (iso_tmp_val == -1 && (iso_val == 65535 || md == ed.end())) {
-            ExifData::const_iterator md_st = findMetadatum(ed, sensitivityType, 1);
+            ExifData::const_iterator md_st = ed.findKey(sensitivityType);
             // no SensitivityType? exit with existing data
             if (md_st == ed.end())
                 break;
@@ -160,9 +600,9 @@ namespace Exiv2 {
                 break;
             // pick up list of ISO tags, and check for at least one of
             // them available.
-            const SensKeyNameList *sensKeys = &sensitivityKey[st_val - 1];
-            for (int idx = 0; idx < sensKeys->count; md_st = ed.end()) {
-                md_st = findMetadatum(ed, const_cast<const char**>(sensKeys->keys), sensKeys->count);
+            const KeyList& sensKeys = sensitivityKeys[st_val - 1];
+            for (size_t idx = 0; idx < sensKeys.size(); md_st = ed.end()) {
+                md_st = findMetadatum(ed, sensKeys);
                 if (md_st == ed.end())
                     break;
                 std::ostringstream os_iso;
@@ -174,7 +614,7 @@ namespace Exiv2 {
                     md = md_st;
                     break;
                 }
-                while (strcmp(sensKeys->keys[idx++], md_st->key().c_str()) != 0 && idx < sensKeys->count) {}
+                while (!matches(sensKeys[idx++], *md_st) && idx < sensKeys.size()) {}
             }
             break;
         }
@@ -184,360 +624,323 @@ namespace Exiv2 {
 
     ExifData::const_iterator flashBias(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.CanonSi.FlashBias",
-            "Exif.Panasonic.FlashBias",
-            "Exif.Olympus.FlashBias",
-            "Exif.OlympusCs.FlashExposureComp",
-            "Exif.Minolta.FlashExposureComp",
-            "Exif.SonyMinolta.FlashExposureComp",
-            "Exif.Sony1.FlashExposureComp",
-            "Exif.Sony2.FlashExposureComp"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efFlashBias));
     }
 
     ExifData::const_iterator exposureMode(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Photo.ExposureProgram",
-            "Exif.Image.ExposureProgram",
-            "Exif.CanonCs.ExposureProgram",
-            "Exif.MinoltaCs7D.ExposureMode",
-            "Exif.MinoltaCs5D.ExposureMode",
-            "Exif.MinoltaCsNew.ExposureMode",
-            "Exif.MinoltaCsOld.ExposureMode",
-            "Exif.Sony1MltCsA100.ExposureMode",
-            "Exif.Sony1Cs.ExposureProgram",
-            "Exif.Sony2Cs.ExposureProgram",
-            "Exif.Sigma.ExposureMode"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efExposureMode));
     }
 
     ExifData::const_iterator sceneMode(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.CanonCs.EasyMode",
-            "Exif.Fujifilm.PictureMode",
-            "Exif.MinoltaCsNew.SubjectProgram",
-            "Exif.MinoltaCsOld.SubjectProgram",
-            "Exif.Minolta.SceneMode",
-            "Exif.SonyMinolta.SceneMode",
-            "Exif.Sony1.SceneMode",
-            "Exif.Sony2.SceneMode",
-            "Exif.OlympusCs.SceneMode",
-            "Exif.Panasonic.ShootingMode",
-            "Exif.Panasonic.SceneMode",
-            "Exif.Pentax.PictureMode",
-            "Exif.PentaxDng.PictureMode",
-            "Exif.Photo.SceneCaptureType"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efSceneMode));
     }
 
     ExifData::const_iterator macroMode(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.CanonCs.Macro",
-            "Exif.Fujifilm.Macro",
-            "Exif.Olympus.Macro",
-            "Exif.OlympusCs.MacroMode",
-            "Exif.Panasonic.Macro",
-            "Exif.MinoltaCsNew.MacroMode",
-            "Exif.MinoltaCsOld.MacroMode",
-            "Exif.Sony1.Macro",
-            "Exif.Sony2.Macro"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efMacroMode));
     }
 
     ExifData::const_iterator imageQuality(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.CanonCs.Quality",
-            "Exif.Fujifilm.Quality",
-            "Exif.Sigma.Quality",
-            "Exif.Nikon1.Quality",
-            "Exif.Nikon2.Quality",
-            "Exif.Nikon3.Quality",
-            "Exif.Olympus.Quality",
-            "Exif.OlympusCs.Quality",
-            "Exif.Panasonic.Quality",
-            "Exif.Minolta.Quality",
-            "Exif.MinoltaCsNew.Quality",
-            "Exif.MinoltaCsOld.Quality",
-            "Exif.MinoltaCs5D.Quality",
-            "Exif.MinoltaCs7D.Quality",
-            "Exif.Sony1MltCsA100.Quality",
-            "Exif.Sony1.JPEGQuality",
-            "Exif.Sony1.Quality",
-            "Exif.Sony1Cs.Quality",
-            "Exif.Sony2.JPEGQuality",
-            "Exif.Sony2.Quality",
-            "Exif.Sony2Cs.Quality",
-            "Exif.Casio.Quality",
-            "Exif.Casio2.QualityMode",
-            "Exif.Casio2.Quality"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efImageQuality));
     }
 
     ExifData::const_iterator whiteBalance(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.CanonSi.WhiteBalance",
-            "Exif.Fujifilm.WhiteBalance",
-            "Exif.Sigma.WhiteBalance",
-            "Exif.Nikon1.WhiteBalance",
-            "Exif.Nikon2.WhiteBalance",
-            "Exif.Nikon3.WhiteBalance",
-            "Exif.Olympus.WhiteBalance",
-            "Exif.OlympusCs.WhiteBalance",
-            "Exif.Panasonic.WhiteBalance",
-            "Exif.MinoltaCs5D.WhiteBalance",
-            "Exif.MinoltaCs7D.WhiteBalance",
-            "Exif.MinoltaCsNew.WhiteBalance",
-            "Exif.MinoltaCsOld.WhiteBalance",
-            "Exif.Minolta.WhiteBalance",
-            "Exif.Sony1MltCsA100.WhiteBalance",
-            "Exif.SonyMinolta.WhiteBalance",
-            "Exif.Sony1.WhiteBalance",
-            "Exif.Sony2.WhiteBalance",
-            "Exif.Sony1.WhiteBalance2",
-            "Exif.Sony2.WhiteBalance2",
-            "Exif.Casio.WhiteBalance",
-            "Exif.Casio2.WhiteBalance",
-            "Exif.Casio2.WhiteBalance2",
-            "Exif.Photo.WhiteBalance"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efWhiteBalance));
     }
 
     ExifData::const_iterator lensName(const ExifData& ed)
     {
-        static const char* keys[] = {
-            // Exif.Canon.LensModel only reports focal length.
-            // Try Exif.CanonCs.LensType first.
-            "Exif.CanonCs.LensType",
-            "Exif.Photo.LensModel",
-            "Exif.NikonLd1.LensIDNumber",
-            "Exif.NikonLd2.LensIDNumber",
-            "Exif.NikonLd3.LensIDNumber",
-            "Exif.Pentax.LensType",
-            "Exif.PentaxDng.LensType",
-            "Exif.Minolta.LensID",
-            "Exif.SonyMinolta.LensID",
-            "Exif.Sony1.LensID",
-            "Exif.Sony2.LensID",
-            "Exif.OlympusEq.LensType",
-            "Exif.Panasonic.LensType",
-            "Exif.Samsung2.LensType"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efLensName));
     }
 
     ExifData::const_iterator saturation(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Photo.Saturation",
-            "Exif.CanonCs.Saturation",
-            "Exif.MinoltaCsNew.Saturation",
-            "Exif.MinoltaCsOld.Saturation",
-            "Exif.MinoltaCs7D.Saturation",
-            "Exif.MinoltaCs5D.Saturation",
-            "Exif.Fujifilm.Color",
-            "Exif.Nikon3.Saturation",
-            "Exif.Panasonic.Saturation",
-            "Exif.Pentax.Saturation",
-            "Exif.PentaxDng.Saturation",
-            "Exif.Sigma.Saturation",
-            "Exif.Casio.Saturation",
-            "Exif.Casio2.Saturation",
-            "Exif.Casio2.Saturation2"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efSaturation));
     }
 
     ExifData::const_iterator sharpness(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Photo.Sharpness",
-            "Exif.CanonCs.Sharpness",
-            "Exif.Fujifilm.Sharpness",
-            "Exif.MinoltaCsNew.Sharpness",
-            "Exif.MinoltaCsOld.Sharpness",
-            "Exif.MinoltaCs7D.Sharpness",
-            "Exif.MinoltaCs5D.Sharpness",
-            "Exif.Olympus.SharpnessFactor",
-            "Exif.Panasonic.Sharpness",
-            "Exif.Pentax.Sharpness",
-            "Exif.PentaxDng.Sharpness",
-            "Exif.Sigma.Sharpness",
-            "Exif.Casio.Sharpness",
-            "Exif.Casio2.Sharpness",
-            "Exif.Casio2.Sharpness2"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efSharpness));
     }
 
     ExifData::const_iterator contrast(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Photo.Contrast",
-            "Exif.CanonCs.Contrast",
-            "Exif.Fujifilm.Tone",
-            "Exif.MinoltaCsNew.Contrast",
-            "Exif.MinoltaCsOld.Contrast",
-            "Exif.MinoltaCs7D.Contrast",
-            "Exif.MinoltaCs5D.Contrast",
-            "Exif.Olympus.Contrast",
-            "Exif.Panasonic.Contrast",
-            "Exif.Pentax.Contrast",
-            "Exif.PentaxDng.Contrast",
-            "Exif.Sigma.Contrast",
-            "Exif.Casio.Contrast",
-            "Exif.Casio2.Contrast",
-            "Exif.Casio2.Contrast2"
-
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efContrast));
     }
 
     ExifData::const_iterator sceneCaptureType(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Photo.SceneCaptureType",
-            "Exif.Olympus.SpecialMode"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efSceneCaptureType));
     }
 
     ExifData::const_iterator meteringMode(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Photo.MeteringMode",
-            "Exif.Image.MeteringMode",
-            "Exif.CanonCs.MeteringMode",
-            "Exif.Sony1MltCsA100.MeteringMode"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efMeteringMode));
     }
 
     ExifData::const_iterator make(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Image.Make"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efMake));
     }
 
     ExifData::const_iterator model(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Image.Model"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efModel));
     }
 
     ExifData::const_iterator exposureTime(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Photo.ExposureTime",
-            "Exif.Image.ExposureTime",
-            "Exif.Samsung2.ExposureTime"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efExposureTime));
     }
 
     ExifData::const_iterator fNumber(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Photo.FNumber",
-            "Exif.Image.FNumber",
-            "Exif.Samsung2.FNumber"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efFNumber));
     }
 
     ExifData::const_iterator subjectDistance(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Photo.SubjectDistance",
-            "Exif.Image.SubjectDistance",
-            "Exif.CanonSi.SubjectDistance",
-            "Exif.CanonFi.FocusDistanceUpper",
-            "Exif.CanonFi.FocusDistanceLower",
-            "Exif.MinoltaCsNew.FocusDistance",
-            "Exif.Nikon1.FocusDistance",
-            "Exif.Nikon3.FocusDistance",
-            "Exif.NikonLd2.FocusDistance",
-            "Exif.NikonLd3.FocusDistance",
-            "Exif.Olympus.FocusDistance",
-            "Exif.OlympusFi.FocusDistance",
-            "Exif.Casio.ObjectDistance",
-            "Exif.Casio2.ObjectDistance"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efSubjectDistance));
     }
 
     ExifData::const_iterator serialNumber(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Image.CameraSerialNumber",
-            "Exif.Canon.SerialNumber",
-            "Exif.Nikon3.SerialNumber",
-            "Exif.Nikon3.SerialNO",
-            "Exif.Fujifilm.SerialNumber",
-            "Exif.Olympus.SerialNumber2",
-            "Exif.Sigma.SerialNumber"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efSerialNumber));
     }
 
     ExifData::const_iterator focalLength(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.Photo.FocalLength",
-            "Exif.Image.FocalLength",
-            "Exif.Canon.FocalLength",
-            "Exif.NikonLd2.FocalLength",
-            "Exif.NikonLd3.FocalLength",
-            "Exif.MinoltaCsNew.FocalLength",
-            "Exif.Pentax.FocalLength",
-            "Exif.PentaxDng.FocalLength",
-            "Exif.Casio2.FocalLength"
-        };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efFocalLength));
     }
 
     ExifData::const_iterator afPoint(const ExifData& ed)
     {
-        static const char* keys[] = {
-            "Exif.CanonPi.AFPointsUsed",
-            "Exif.CanonPi.AFPointsUsed20D",
-            "Exif.CanonSi.AFPointUsed",
-            "Exif.CanonCs.AFPoint",
-            "Exif.MinoltaCs7D.AFPoints",
-            "Exif.Nikon1.AFFocusPos",
-            "Exif.NikonAf.AFPoint",
-            "Exif.NikonAf.AFPointsInFocus",
-            "Exif.NikonAf2.AFPointsUsed",
-            "Exif.NikonAf2.PrimaryAFPoint",
-            "Exif.OlympusFi.AFPoint",
-            "Exif.Pentax.AFPoint",
-            "Exif.Pentax.AFPointInFocus",
-            "Exif.PentaxDng.AFPoint",
-            "Exif.PentaxDng.AFPointInFocus",
-            "Exif.Sony1Cs.LocalAFAreaPoint",
-            "Exif.Sony2Cs.LocalAFAreaPoint",
-            "Exif.Sony1Cs2.LocalAFAreaPoint",
-            "Exif.Sony2Cs2.LocalAFAreaPoint",
-            "Exif.Sony1MltCsA100.LocalAFAreaPoint",
-            "Exif.Casio.AFPoint",
-            "Exif.Casio2.AFPointPosition"
+        return findMetadatum(ed, EasyAccessPlan::instance().keys(efAfPoint));
+    }
+
+    EasyAccessResult easyAccess(const ExifData& ed)
+    {
+        const EasyAccessPlan& plan = EasyAccessPlan::instance();
+        const ExifData::const_iterator end = ed.end();
+        EasyAccessResult result;
+        // Position of the key of each result in the key list of its function
+        size_t rank[EXV_COUNTOF(easyAccessFields)];
+        for (size_t f = 0; f < EXV_COUNTOF(easyAccessFields); ++f) {
+            result.*easyAccessFields[f].result_ = end;
+            rank[f] = easyAccessFields[f].count_;
+        }
+        // Keep the first metadatum with the most preferred key of each function,
+        // which is what the function finds
+        for (ExifData::const_iterator md = ed.begin(); md != end; ++md) {
+            const std::vector<EasyAccessPlan::Use>* uses = plan.uses(*md);
+            if (uses == 0) continue;
+            for (size_t i = 0; i < uses->size(); ++i) {
+                const EasyAccessPlan::Use& use = (*uses)[i];
+                if (use.rank_ < rank[use.field_]) {
+                    rank[use.field_] = use.rank_;
+                    result.*easyAccessFields[use.field_].result_ = md;
+                }
+            }
+        }
+        // The ISO speed depends on the values of the metadata, not just their keys
+        result.isoSpeed_ = isoSpeed(ed);
+        return result;
+    }
+
+    CanonInfo::CanonInfo()
+        : modelId_(0), serialNumber_(0), fileNumber_(0), lensType_(0),
+          longFocal_(0), shortFocal_(0), focalUnits_(0)
+    {
+    }
+
+    namespace {
+        //! The keys read by canonInfo()
+        const char* canonInfoKeys[] = {
+            "Exif.Image.Model",
+            "Exif.Canon.ModelID",
+            "Exif.Canon.SerialNumber",
+            "Exif.Canon.InternalSerialNumber",
+            "Exif.Canon.FirmwareVersion",
+            "Exif.Canon.FileNumber",
+            "Exif.CanonFi.FileNumber",
+            "Exif.Canon.LensModel",
+            "Exif.CanonCs.LensType",
+            "Exif.CanonCs.Lens"
         };
-        return findMetadatum(ed, keys, EXV_COUNTOF(keys));
+
+        //! Return the metadatum with \em key or 0 if there is none or it is empty
+        const Exifdatum* findDatum(const ExifData& ed, const char* key)
+        {
+            ExifData::const_iterator pos = ed.findKey(ExifKey(key));
+            return pos != ed.end() && pos->count() > 0 ? &*pos : 0;
+        }
+    }
+
+    DecodeFilter canonInfoFilter()
+    {
+        DecodeFilter filter;
+        for (size_t i = 0; i < EXV_COUNTOF(canonInfoKeys); ++i) {
+            filter.addKey(canonInfoKeys[i]);
+        }
+        return filter;
+    }
+
+    CanonInfo canonInfo(const ExifData& ed)
+    {
+        CanonInfo info;
+        const Exifdatum* md = findDatum(ed, "Exif.Image.Model");
+        if (md) info.model_ = md->toString();
+        if ((md = findDatum(ed, "Exif.Canon.ModelID")) != 0) {
+            info.modelId_ = static_cast<uint32_t>(md->toLong());
+        }
+        if ((md = findDatum(ed, "Exif.Canon.SerialNumber")) != 0) {
+            info.serialNumber_ = static_cast<uint32_t>(md->toLong());
+        }
+        if ((md = findDatum(ed, "Exif.Canon.InternalSerialNumber")) != 0) {
+            info.internalSerialNumber_ = md->toString();
+        }
+        if ((md = findDatum(ed, "Exif.Canon.FirmwareVersion")) != 0) {
+            info.firmwareVersion_ = md->toString();
+        }
+        if (   (md = findDatum(ed, "Exif.Canon.FileNumber")) != 0
+            || (md = findDatum(ed, "Exif.CanonFi.FileNumber")) != 0) {
+            info.fileNumber_ = static_cast<uint32_t>(md->toLong());
+        }
+        if ((md = findDatum(ed, "Exif.Canon.LensModel")) != 0) {
+            info.lensModel_ = md->toString();
+        }
+        if ((md = findDatum(ed, "Exif.CanonCs.LensType")) != 0) {
+            info.lensType_ = static_cast<int32_t>(md->toLong());
+        }
+        if ((md = findDatum(ed, "Exif.CanonCs.Lens")) != 0 && md->count() >= 3) {
+            info.longFocal_ = static_cast<uint16_t>(md->toLong(0));
+            info.shortFocal_ = static_cast<uint16_t>(md->toLong(1));
+            info.focalUnits_ = static_cast<uint16_t>(md->toLong(2));
+        }
+        return info;
+    }
+
+    GpsInfo::GpsInfo()
+        : hasPosition_(false), latitude_(0.0), longitude_(0.0),
+          hasAltitude_(false), altitude_(0.0),
+          hasTimestamp_(false), timestamp_(0.0)
+    {
+    }
+
+    namespace {
+        //! The keys read by gpsInfo()
+        const char* gpsInfoKeys[] = {
+            "Exif.GPSInfo.GPSLatitudeRef",
+            "Exif.GPSInfo.GPSLatitude",
+            "Exif.GPSInfo.GPSLongitudeRef",
+            "Exif.GPSInfo.GPSLongitude",
+            "Exif.GPSInfo.GPSAltitudeRef",
+            "Exif.GPSInfo.GPSAltitude",
+            "Exif.GPSInfo.GPSTimeStamp",
+            "Exif.GPSInfo.GPSDateStamp"
+        };
+
+        //! Set \em value to the sum of the \em n rationals of \em md, each divided by 60 more than the previous one
+        bool sexagesimal(const Exifdatum* md, long n, double& value)
+        {
+            if (!md || md->count() < n) return false;
+            value = 0.0;
+            double unit = 1.0;
+            for (long i = 0; i < n; ++i) {
+                const Rational r = md->toRational(i);
+                if (r.second <= 0 || r.first < 0) return false;
+                value += unit * r.first / r.second;
+                unit /= 60.0;
+            }
+            return true;
+        }
+
+        //! Return the number of days from 1970-01-01 to the date of the proleptic Gregorian calendar
+        long daysFromCivil(long y, long m, long d)
+        {
+            y -= m <= 2;
+            const long era = (y >= 0 ? y : y - 399) / 400;
+            const long yoe = y - era * 400;
+            const long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+            const long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+            return era * 146097 + doe - 719468;
+        }
+    }
+
+    DecodeFilter gpsInfoFilter()
+    {
+        DecodeFilter filter;
+        for (size_t i = 0; i < EXV_COUNTOF(gpsInfoKeys); ++i) {
+            filter.addKey(gpsInfoKeys[i]);
+        }
+        return filter;
+    }
+
+    GpsInfo gpsInfo(const ExifData& ed)
+    {
+        GpsInfo info;
+        double latitude = 0.0;
+        double longitude = 0.0;
+        const Exifdatum* latRef = findDatum(ed, "Exif.GPSInfo.GPSLatitudeRef");
+        const Exifdatum* lonRef = findDatum(ed, "Exif.GPSInfo.GPSLongitudeRef");
+        if (   latRef && lonRef
+            && sexagesimal(findDatum(ed, "Exif.GPSInfo.GPSLatitude"), 3, latitude)
+            && sexagesimal(findDatum(ed, "Exif.GPSInfo.GPSLongitude"), 3, longitude)
+            && latitude <= 90.0 && longitude <= 180.0) {
+            const std::string ns = latRef->toString();
+            const std::string ew = lonRef->toString();
+            if (   (ns == "N" || ns == "S")
+                && (ew == "E" || ew == "W")) {
+                info.hasPosition_ = true;
+                info.latitude_ = ns == "S" ? -latitude : latitude;
+                info.longitude_ = ew == "W" ? -longitude : longitude;
+            }
+        }
+        double altitude = 0.0;
+        if (sexagesimal(findDatum(ed, "Exif.GPSInfo.GPSAltitude"), 1, altitude)) {
+            // A missing reference means above sea level
+            const Exifdatum* md = findDatum(ed, "Exif.GPSInfo.GPSAltitudeRef");
+            info.hasAltitude_ = true;
+            info.altitude_ = md && md->toLong() == 1 ? -altitude : altitude;
+        }
+        const Exifdatum* date = findDatum(ed, "Exif.GPSInfo.GPSDateStamp");
+        double hours = 0.0;
+        int year = 0, month = 0, day = 0;
+        if (   date
+            && std::sscanf(date->toString().c_str(), "%4d:%2d:%2d", &year, &month, &day) == 3
+            && month >= 1 && month <= 12 && day >= 1 && day <= 31
+            && sexagesimal(findDatum(ed, "Exif.GPSInfo.GPSTimeStamp"), 3, hours)
+            && hours < 24.0) {
+            info.hasTimestamp_ = true;
+            info.timestamp_ = daysFromCivil(year, month, day) * 86400.0 + hours * 3600.0;
+        }
+        return info;
+    }
+
+    std::vector<GpsInfo> gpsInfo(BatchProcessor& batch,
+                                 const std::vector<std::string>& paths,
+                                 BatchProcessor::Results& results)
+    {
+        // The callback only knows the path of an image, the same path gives the same result
+        std::unordered_map<std::string, GpsInfo> infos;
+        std::mutex mutex;
+        batch.setDecodeFilter(gpsInfoFilter());
+        results = batch.run(paths, [&infos, &mutex](Image& image) {
+            const GpsInfo info = gpsInfo(image.exifData());
+            std::lock_guard<std::mutex> lock(mutex);
+            infos[image.io().path()] = info;
+        });
+        std::vector<GpsInfo> gps(paths.size());
+        for (size_t i = 0; i < results.size() && i < gps.size(); ++i) {
+            if (results[i].code_ != kerSuccess) continue;
+            std::unordered_map<std::string, GpsInfo>::const_iterator pos = infos.find(paths[i]);
+            if (pos != infos.end()) gps[i] = pos->second;
+        }
+        return gps;
     }
 
 }                                       // namespace Exiv2
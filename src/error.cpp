@@ -28,6 +28,8 @@
 // + standard includes
 #include <iostream>
 #include <string>
+#include <utility>
+#include <vector>
 #include <cassert>
 
 // *****************************************************************************
@@ -167,7 +169,13 @@ namespace {
         { Exiv2::kerArithmeticOverflow,
           N_("Arithmetic operation overflow") },
         { Exiv2::kerMallocFailed,
-          N_("Memory allocation failed")}
+          N_("Memory allocation failed")},
+        { Exiv2::kerResourceLimitExceeded,
+          N_("Parse limit exceeded: %1 (limit %2)") }, // %1=limit name, %2=limit
+        { Exiv2::kerRemoteRequestStopped,
+          N_("Request to %1 stopped: %2") }, // %1=URL, %2=reason
+        { Exiv2::kerFilteredMetadata,
+          N_("Metadata read with a decode filter cannot be written") },
     };
 
 }
@@ -178,25 +186,158 @@ namespace Exiv2 {
 
     LogMsg::Level LogMsg::level_ = LogMsg::warn; // Default output level
     LogMsg::Handler LogMsg::handler_ = LogMsg::defaultHandler;
+    LogMsg::HandlerOptions LogMsg::options_;
+
+    namespace {
+        //! Messages of a thread held back by the LogMsg::HandlerOptions
+        class ThreadLog {
+        public:
+            ThreadLog() : lastLevel_(LogMsg::mute), repeats_(0), suppressed_(0) {}
+            ~ThreadLog() { flush(LogMsg::handler()); }
+            //! Pass \em msg to \em handler, subject to \em options
+            void post(LogMsg::Handler handler, const LogMsg::HandlerOptions& options,
+                      LogMsg::Level level, const std::string& msg);
+            //! Pass everything held back to \em handler
+            void flush(LogMsg::Handler handler);
+
+        private:
+            //! Pending messages are passed to the handler when there are this many
+            static const size_t batchSize_ = 64;
+            void deliver(LogMsg::Handler handler, bool buffered, LogMsg::Level level, const std::string& msg);
+            void reportSuppressed(LogMsg::Handler handler, bool buffered);
+
+            std::vector<std::pair<LogMsg::Level, std::string> > pending_;
+            std::string last_;
+            LogMsg::Level lastLevel_;
+            unsigned int repeats_;
+            unsigned long suppressed_;
+        };
+
+        void ThreadLog::post(LogMsg::Handler handler, const LogMsg::HandlerOptions& options,
+                             LogMsg::Level level, const std::string& msg)
+        {
+            if (options.maxRepeats > 0) {
+                if (level == lastLevel_ && msg == last_) {
+                    if (repeats_ >= options.maxRepeats) {
+                        ++suppressed_;
+                        return;
+                    }
+                    ++repeats_;
+                }
+                else {
+                    reportSuppressed(handler, options.buffered);
+                    last_ = msg;
+                    lastLevel_ = level;
+                    repeats_ = 1;
+                }
+            }
+            deliver(handler, options.buffered, level, msg);
+        }
+
+        void ThreadLog::flush(LogMsg::Handler handler)
+        {
+            reportSuppressed(handler, false);
+            if (handler) {
+                for (size_t i = 0; i < pending_.size(); ++i) {
+                    handler(pending_[i].first, pending_[i].second.c_str());
+                }
+            }
+            pending_.clear();
+            last_.clear();
+            lastLevel_ = LogMsg::mute;
+            repeats_ = 0;
+        }
+
+        void ThreadLog::deliver(LogMsg::Handler handler, bool buffered, LogMsg::Level level, const std::string& msg)
+        {
+            if (!buffered) {
+                if (handler) handler(level, msg.c_str());
+                return;
+            }
+            pending_.push_back(std::make_pair(level, msg));
+            if (pending_.size() >= batchSize_) {
+                for (size_t i = 0; i < pending_.size(); ++i) {
+                    if (handler) handler(pending_[i].first, pending_[i].second.c_str());
+                }
+                pending_.clear();
+            }
+        }
+
+        void ThreadLog::reportSuppressed(LogMsg::Handler handler, bool buffered)
+        {
+            if (suppressed_ == 0) return;
+            std::ostringstream os;
+            os << "Last message repeated " << suppressed_ << " more times\n";
+            suppressed_ = 0;
+            deliver(handler, buffered, lastLevel_, os.str());
+        }
+
+        ThreadLog& threadLog()
+        {
+            thread_local ThreadLog log;
+            return log;
+        }
+
+        //! The innermost LogMsg::Scope of the thread
+        thread_local LogMsg::Scope* threadScope = 0;
+    }
+
+    LogMsg::Scope::Scope() : previous_(threadScope)
+    {
+        threadScope = this;
+    }
+
+    LogMsg::Scope::~Scope()
+    {
+        threadScope = previous_;
+    }
+
+    LogMsg::Messages LogMsg::Scope::release()
+    {
+        Messages messages;
+        messages.swap(messages_);
+        return messages;
+    }
 
     LogMsg::LogMsg(LogMsg::Level msgType) : msgType_(msgType)
     {}
 
     LogMsg::~LogMsg()
     {
-        if (msgType_ >= level_ && handler_)
-            handler_(msgType_, os_.str().c_str());
+        if (msgType_ < level_) return;
+        if (threadScope) {
+            Message message = { msgType_, os_.str() };
+            threadScope->messages_.push_back(std::move(message));
+        }
+        else if (handler_) {
+            if (options_.maxRepeats == 0 && !options_.buffered) {
+                handler_(msgType_, os_.str().c_str());
+            }
+            else {
+                threadLog().post(handler_, options_, msgType_, os_.str());
+            }
+        }
     }
 
     std::ostringstream &LogMsg::os() { return os_; }
 
     void LogMsg::setLevel(LogMsg::Level level) { level_ = level; }
 
-    void LogMsg::setHandler(LogMsg::Handler handler) { handler_ = handler; }
+    void LogMsg::setHandler(LogMsg::Handler handler) { setHandler(handler, HandlerOptions()); }
 
-    LogMsg::Level LogMsg::level() { return level_; }
+    void LogMsg::setHandler(LogMsg::Handler handler, const HandlerOptions& options)
+    {
+        flush();
+        handler_ = handler;
+        options_ = options;
+    }
+
+    void LogMsg::flush() { threadLog().flush(handler_); }
 
-    LogMsg::Handler LogMsg::handler() { return handler_; }
+    bool LogMsg::enabled(LogMsg::Level msgType)
+    {
+        return msgType >= level_ && (handler_ != 0 || threadScope != 0);
+    }
 
     void LogMsg::defaultHandler(int level, const char* s)
     {
@@ -225,7 +366,7 @@ namespace Exiv2 {
     }
 
     template<>
-    void BasicError<char>::setMsg()
+    void BasicError<char>::setMsg() const
     {
         std::string msg = _(errMsg(code_));
         std::string::size_type pos;
@@ -255,6 +396,7 @@ namespace Exiv2 {
 #ifdef EXV_UNICODE_PATH
         wmsg_ = s2ws(msg);
 #endif
+        hasMsg_ = true;
     }
 #ifdef __APPLE__
     template class EXIV2API BasicError<char>;
@@ -262,7 +404,7 @@ namespace Exiv2 {
 
 #ifdef EXV_UNICODE_PATH
     template<>
-    void BasicError<wchar_t>::setMsg()
+    void BasicError<wchar_t>::setMsg() const
     {
         std::string s = _(errMsg(code_));
         std::wstring wmsg(s.begin(), s.end());
@@ -291,6 +433,7 @@ namespace Exiv2 {
         }
         wmsg_ = wmsg;
         msg_ = ws2s(wmsg);
+        hasMsg_ = true;
     }
     template class EXIV2API BasicError<wchar_t>;
 #endif
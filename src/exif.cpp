@@ -34,19 +34,26 @@
 #include "value.hpp"
 #include "types.hpp"
 #include "error.hpp"
+#include "iptc.hpp"
+#include "xmp_exiv2.hpp"
 #include "basicio.hpp"
 #include "tiffimage.hpp"
 #include "tiffimage_int.hpp"
 #include "tiffcomposite_int.hpp" // for Tag::root
+#include "tiffvisitor_int.hpp"
+#include "metadatum_int.hpp"
 
 // + standard includes
 #include <iostream>
 #include <sstream>
 #include <utility>
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <cassert>
 #include <cstdio>
+#include <iterator>
+#include <mutex>
 
 // *****************************************************************************
 namespace {
@@ -55,20 +62,22 @@ namespace {
     class FindExifdatumByKey {
     public:
         //! Constructor, initializes the object with the key to look for
-        explicit FindExifdatumByKey(const std::string& key) : key_(key)
+        explicit FindExifdatumByKey(const Exiv2::ExifKey& key)
+            : ifdId_(key.ifdId()), tag_(key.tag())
         {
         }
         /*!
-          @brief Returns true if the key of \em exifdatum is equal
-                 to that of the object.
+          @brief Returns true if the IFD id and tag of \em exifdatum are
+                 equal to those of the key of the object.
         */
         bool operator()(const Exiv2::Exifdatum& exifdatum) const
         {
-            return key_ == exifdatum.key();
+            return ifdId_ == exifdatum.ifdId() && tag_ == exifdatum.tag();
         }
 
     private:
-        const std::string& key_;
+        int ifdId_;
+        uint16_t tag_;
 
     }; // class FindExifdatumByKey
 
@@ -175,6 +184,126 @@ namespace {
     //! Helper function to delete all tags of a specific IFD from the metadata.
     void eraseIfd(Exiv2::ExifData& ed, Exiv2::Internal::IfdId ifdId);
 
+    //! Helper function to combine the IFD id and tag of a key into an index id.
+    uint32_t indexId(int ifdId, uint16_t tag)
+    {
+        return static_cast<uint32_t>(ifdId) << 16 | tag;
+    }
+
+    //! Values larger than this are not printed from the cache nor recorded as lookups
+    const long maxPrintCacheValueSize = 256;
+
+    /*!
+      @brief Append the type, count and bytes of \em value to \em key.
+             Return false if the value is too large to be cached.
+     */
+    bool appendValue(std::string& key, const Exiv2::Value& value)
+    {
+        const long size = value.size();
+        if (size < 0 || size > maxPrintCacheValueSize) return false;
+        const uint32_t head[] = { static_cast<uint32_t>(value.typeId()), static_cast<uint32_t>(value.count()) };
+        key.append(reinterpret_cast<const char*>(head), sizeof(head));
+        const size_t pos = key.size();
+        key.resize(pos + size);
+        if (size > 0) value.copy(reinterpret_cast<Exiv2::byte*>(&key[pos]), Exiv2::bigEndian);
+        return true;
+    }
+
+    //! A lookup of a print function in the metadata and the value it found
+    struct PrintLookup {
+        //! Constructor
+        explicit PrintLookup(const Exiv2::ExifKey& key) : key_(key), found_(false) {}
+
+        Exiv2::ExifKey key_;                    //!< Key looked up
+        bool found_;                            //!< True if an %Exifdatum was found
+        std::string value_;                     //!< Type, count and bytes of the value found
+    };
+    typedef std::vector<PrintLookup> PrintLookups;
+
+    //! Result of a print function, with the lookups it depends on
+    struct PrintMemo {
+        PrintLookups lookups_;                  //!< Lookups of the print function
+        std::string result_;                    //!< The printed value
+    };
+
+    //! Records the lookups of a print function while it runs, see ExifData::findKey()
+    struct PrintRecorder {
+        //! Constructor
+        PrintRecorder() : cacheable_(true) {}
+
+        PrintLookups lookups_;                  //!< The lookups so far
+        bool cacheable_;                        //!< False if the result depends on more than the lookups
+    };
+
+    //! Recorder of the print function running on this thread, 0 if there is none
+    thread_local PrintRecorder* printRecorder = 0;
+
+    //! The state of class PrintCache
+    struct PrintCacheState {
+        //! Cached results, the most recently used first
+        typedef std::list<std::pair<std::string, std::shared_ptr<const PrintMemo> > > MemoList;
+
+        PrintCacheState() : capacity_(0), hits_(0), misses_(0) {}
+
+        std::atomic<size_t> capacity_;          //!< Maximum number of results, 0 if disabled
+        MemoList memos_;                        //!< The results in LRU order
+        std::unordered_map<std::string, MemoList::iterator> index_; //!< Position of each result in memos_
+        std::atomic<uint64_t> hits_;            //!< Prints answered from the cache
+        std::atomic<uint64_t> misses_;          //!< Prints computed
+        std::mutex mutex_;                      //!< Serializes access from several threads
+    };
+
+    PrintCacheState& printCache()
+    {
+        static PrintCacheState state;
+        return state;
+    }
+
+    //! Return the cached result of \em key or an empty pointer
+    std::shared_ptr<const PrintMemo> findPrintMemo(const std::string& key)
+    {
+        PrintCacheState& cache = printCache();
+        std::lock_guard<std::mutex> lock(cache.mutex_);
+        auto pos = cache.index_.find(key);
+        if (pos == cache.index_.end()) return std::shared_ptr<const PrintMemo>();
+        cache.memos_.splice(cache.memos_.begin(), cache.memos_, pos->second);
+        return pos->second->second;
+    }
+
+    //! Keep \em memo as the result of \em key, replacing an older one
+    void putPrintMemo(const std::string& key, const std::shared_ptr<const PrintMemo>& memo)
+    {
+        PrintCacheState& cache = printCache();
+        std::lock_guard<std::mutex> lock(cache.mutex_);
+        auto pos = cache.index_.find(key);
+        if (pos != cache.index_.end()) {
+            cache.memos_.erase(pos->second);
+            cache.index_.erase(pos);
+        }
+        cache.memos_.push_front(std::make_pair(key, memo));
+        cache.index_[key] = cache.memos_.begin();
+        while (cache.memos_.size() > cache.capacity_) {
+            cache.index_.erase(cache.memos_.back().first);
+            cache.memos_.pop_back();
+        }
+    }
+
+    //! Return true if the lookups of \em memo find the same values in \em pMetadata
+    bool printMemoValid(const PrintMemo& memo, const Exiv2::ExifData* pMetadata)
+    {
+        for (PrintLookups::const_iterator i = memo.lookups_.begin(); i != memo.lookups_.end(); ++i) {
+            if (pMetadata == 0) return false;
+            Exiv2::ExifData::const_iterator pos = pMetadata->findKey(i->key_);
+            if (pos == pMetadata->end()) {
+                if (i->found_) return false;
+                continue;
+            }
+            std::string value;
+            if (!i->found_ || !appendValue(value, pos->value()) || value != i->value_) return false;
+        }
+        return true;
+    }
+
 }
 
 // *****************************************************************************
@@ -207,12 +336,17 @@ namespace Exiv2 {
         if (pValue) value_ = pValue->clone();
     }
 
+    Exifdatum::Exifdatum(const ExifKey& key, Value::UniquePtr value)
+        : key_(key.clone()), value_(std::move(value))
+    {
+    }
+
     Exifdatum::~Exifdatum()
     {
     }
 
     Exifdatum::Exifdatum(const Exifdatum& rhs)
-        : Metadatum(rhs)
+        : Metadatum(rhs), origin_(rhs.origin_)
     {
         if (rhs.key_.get() != 0) key_ = rhs.key_->clone(); // deep copy
         if (rhs.value_.get() != 0) value_ = rhs.value_->clone(); // deep copy
@@ -224,7 +358,91 @@ namespace Exiv2 {
         PrintFct fct = printValue;
         const TagInfo* ti = Internal::tagInfo(tag(), static_cast<IfdId>(ifdId()));
         if (ti != 0) fct = ti->printFct_;
-        return fct(os, value(), pMetadata);
+        // Nested prints are recorded by the outer one, a field width would apply to the first output only
+        if (printCache().capacity_ == 0 || printRecorder != 0 || os.width() != 0) {
+            return fct(os, value(), pMetadata);
+        }
+
+        std::string key(reinterpret_cast<const char*>(&fct), sizeof(fct));
+        const uint32_t context[] = {
+            static_cast<uint32_t>(ifdId()) << 16 | tag(),
+            static_cast<uint32_t>(os.flags()),
+            static_cast<uint32_t>(os.precision()),
+            static_cast<uint32_t>(static_cast<unsigned char>(os.fill())),
+            pMetadata == 0
+        };
+        key.append(reinterpret_cast<const char*>(context), sizeof(context));
+        if (!appendValue(key, value())) return fct(os, value(), pMetadata);
+
+        std::shared_ptr<const PrintMemo> memo = findPrintMemo(key);
+        if (memo && printMemoValid(*memo, pMetadata)) {
+            ++printCache().hits_;
+            return os << memo->result_;
+        }
+
+        std::ostringstream result;
+        result.copyfmt(os);
+        PrintRecorder recorder;
+        printRecorder = &recorder;
+        try {
+            fct(result, value(), pMetadata);
+        }
+        catch (...) {
+            printRecorder = 0;
+            throw;
+        }
+        printRecorder = 0;
+        std::shared_ptr<PrintMemo> computed = std::make_shared<PrintMemo>();
+        computed->result_ = result.str();
+        ++printCache().misses_;
+        if (recorder.cacheable_) {
+            computed->lookups_.swap(recorder.lookups_);
+            putPrintMemo(key, computed);
+        }
+        return os << computed->result_;
+    }
+
+    void PrintCache::setCapacity(size_t capacity)
+    {
+        PrintCacheState& cache = printCache();
+        std::lock_guard<std::mutex> lock(cache.mutex_);
+        cache.capacity_ = capacity;
+        while (cache.memos_.size() > capacity) {
+            cache.index_.erase(cache.memos_.back().first);
+            cache.memos_.pop_back();
+        }
+    }
+
+    void PrintCache::clear()
+    {
+        PrintCacheState& cache = printCache();
+        std::lock_guard<std::mutex> lock(cache.mutex_);
+        cache.memos_.clear();
+        cache.index_.clear();
+        cache.hits_ = 0;
+        cache.misses_ = 0;
+    }
+
+    size_t PrintCache::capacity()
+    {
+        return printCache().capacity_;
+    }
+
+    size_t PrintCache::size()
+    {
+        PrintCacheState& cache = printCache();
+        std::lock_guard<std::mutex> lock(cache.mutex_);
+        return cache.memos_.size();
+    }
+
+    uint64_t PrintCache::hits()
+    {
+        return printCache().hits_;
+    }
+
+    uint64_t PrintCache::misses()
+    {
+        return printCache().misses_;
     }
 
     const Value& Exifdatum::value() const
@@ -233,6 +451,19 @@ namespace Exiv2 {
         return *value_;
     }
 
+    Exifdatum::Exifdatum(Exifdatum&& rhs) noexcept
+        : Metadatum(rhs), key_(std::move(rhs.key_)), value_(std::move(rhs.value_)), origin_(rhs.origin_)
+    {
+    }
+
+    Exifdatum& Exifdatum::operator=(Exifdatum&& rhs) noexcept
+    {
+        key_ = std::move(rhs.key_);
+        value_ = std::move(rhs.value_);
+        origin_ = rhs.origin_;
+        return *this;
+    }
+
     Exifdatum& Exifdatum::operator=(const Exifdatum& rhs)
     {
         if (this == &rhs) return *this;
@@ -244,6 +475,7 @@ namespace Exiv2 {
         value_.reset();
         if (rhs.value_.get() != 0) value_ = rhs.value_->clone(); // deep copy
 
+        origin_ = rhs.origin_;
         return *this;
     } // Exifdatum::operator=
 
@@ -436,6 +668,11 @@ namespace Exiv2 {
         return thumbnail->copy(exifData_);
     }
 
+    SharedBuf ExifThumbC::buffer() const
+    {
+        return SharedBuf(copy());
+    }
+
     long ExifThumbC::writeFile(const std::string& path) const
     {
         Thumbnail::UniquePtr thumbnail = Thumbnail::create(exifData_);
@@ -552,63 +789,353 @@ namespace Exiv2 {
         eraseIfd(exifData_, ifd1Id);
     }
 
+    ExifData::ExifData()
+        : storage_(std::make_shared<Storage>()), lazyMakernote_(false), parallelDecode_(false),
+          lazyEmbedded_(false), tiffOffset_(-1)
+    {
+    }
+
+    ExifData::ExifData(const ExifData& rhs)
+        : decodeFilter_(rhs.decodeFilter_), lazyMakernote_(rhs.lazyMakernote_),
+          parallelDecode_(rhs.parallelDecode_), lazyEmbedded_(rhs.lazyEmbedded_), tiffOffset_(rhs.tiffOffset_)
+    {
+        // Another thread may be decoding the makernote of rhs or handing out its iterators
+        std::lock_guard<std::mutex> lock(rhs.mutex_);
+        makernote_ = rhs.makernote_;
+        if (rhs.storage_->shareable_) {
+            storage_ = rhs.storage_;
+        }
+        else {
+            storage_ = std::make_shared<Storage>();
+            storage_->metadata_ = rhs.storage_->metadata_;
+            storage_->indexRebuild();
+        }
+    }
+
+    ExifData& ExifData::operator=(const ExifData& rhs)
+    {
+        if (this == &rhs) return *this;
+        ExifData copy(rhs);
+        storage_.swap(copy.storage_);
+        decodeFilter_ = rhs.decodeFilter_;
+        lazyMakernote_ = rhs.lazyMakernote_;
+        parallelDecode_ = rhs.parallelDecode_;
+        lazyEmbedded_ = rhs.lazyEmbedded_;
+        tiffOffset_ = rhs.tiffOffset_;
+        makernote_ = copy.makernote_;
+        return *this;
+    }
+
+    ExifData::Storage& ExifData::mutableStorage(bool leak) const
+    {
+        if (storage_.use_count() > 1) {
+            std::shared_ptr<Storage> storage = std::make_shared<Storage>();
+            storage->metadata_ = storage_->metadata_;
+            storage->indexRebuild();
+            storage_.swap(storage);
+        }
+        if (leak) storage_->shareable_ = false;
+        return *storage_;
+    }
+
+    const ExifData::Storage& ExifData::iterableStorage() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return mutableStorage(true);
+    }
+
     Exifdatum& ExifData::operator[](const std::string& key)
     {
-        ExifKey exifKey(key);
-        iterator pos = findKey(exifKey);
-        if (pos == end()) {
-            add(Exifdatum(exifKey));
-            pos = findKey(exifKey);
+        return operator[](ExifKeyHandle(key));
+    }
+
+    Exifdatum& ExifData::operator[](const ExifKeyHandle& key)
+    {
+        iterator pos = findKey(key.key());
+        if (pos == storage_->metadata_.end()) {
+            add(Exifdatum(key.key()));
+            pos = --storage_->metadata_.end();
         }
         return *pos;
     }
 
     void ExifData::add(const ExifKey& key, const Value* pValue)
     {
-        add(Exifdatum(key, pValue));
+        Storage& storage = mutableStorage(false);
+        // Construct in place, copying a temporary would clone key and value again
+        storage.metadata_.emplace_back(key, pValue);
+        storage.indexAdd(--storage.metadata_.end());
+    }
+
+    void ExifData::add(const ExifKey& key, Value::UniquePtr value)
+    {
+        Storage& storage = mutableStorage(false);
+        storage.metadata_.emplace_back(key, std::move(value));
+        storage.indexAdd(--storage.metadata_.end());
     }
 
     void ExifData::add(const Exifdatum& exifdatum)
     {
+        Storage& storage = mutableStorage(false);
+        // allow duplicates
+        storage.metadata_.push_back(exifdatum);
+        storage.indexAdd(--storage.metadata_.end());
+    }
+
+    ExifData::iterator ExifData::begin()
+    {
+        decodeMakernote();
+        Storage& storage = mutableStorage(true);
+        storage.index_.invalidate();
+        return storage.metadata_.begin();
+    }
+
+    ExifData::iterator ExifData::end()
+    {
+        return mutableStorage(true).metadata_.end();
+    }
+
+    ExifData::const_iterator ExifData::begin() const
+    {
+        // A print function which iterates over the metadata may depend on any of them
+        if (printRecorder != 0) printRecorder->cacheable_ = false;
+        decodeMakernote();
+        return iterableStorage().metadata_.begin();
+    }
+
+    ExifData::const_iterator ExifData::end() const
+    {
+        // Decoding a makernote may replace the storage, do it before taking the end
+        decodeMakernote();
+        return iterableStorage().metadata_.end();
+    }
+
+    void ExifData::add(Exifdatum&& exifdatum)
+    {
+        Storage& storage = mutableStorage(false);
         // allow duplicates
-        exifMetadata_.push_back(exifdatum);
+        storage.metadata_.push_back(std::move(exifdatum));
+        storage.indexAdd(--storage.metadata_.end());
     }
 
     ExifData::const_iterator ExifData::findKey(const ExifKey& key) const
     {
-        return std::find_if(exifMetadata_.begin(), exifMetadata_.end(),
-                            FindExifdatumByKey(key.key()));
+        if (Internal::isMakerIfd(static_cast<IfdId>(key.ifdId()))) decodeMakernote();
+        const ExifMetadata& metadata = iterableStorage().metadata_;
+        const_iterator pos = findDecoded(key);
+        // The result of a print function depends on what it looks up, see PrintCache
+        if (printRecorder != 0) {
+            PrintLookup lookup(key);
+            lookup.found_ = pos != metadata.end();
+            if (lookup.found_ && !appendValue(lookup.value_, pos->value())) printRecorder->cacheable_ = false;
+            printRecorder->lookups_.push_back(lookup);
+        }
+        return pos;
+    }
+
+    ExifData::const_iterator ExifData::findDecoded(const ExifKey& key) const
+    {
+        const Storage& storage = *storage_;
+        const Index::Entry* entry = storage.index_.valid() ? storage.indexFind(key) : 0;
+        if (   entry != 0
+            && entry->pos_->ifdId() == key.ifdId()
+            && entry->pos_->tag() == key.tag()) {
+            return entry->pos_;
+        }
+        if (!storage.index_.valid() || entry != 0) {
+            // No usable index, fall back to a linear search
+            return std::find_if(storage.metadata_.begin(), storage.metadata_.end(),
+                                FindExifdatumByKey(key));
+        }
+        return storage.metadata_.end();
     }
 
     ExifData::iterator ExifData::findKey(const ExifKey& key)
     {
-        return std::find_if(exifMetadata_.begin(), exifMetadata_.end(),
-                            FindExifdatumByKey(key.key()));
+        if (Internal::isMakerIfd(static_cast<IfdId>(key.ifdId()))) decodeMakernote();
+        Storage& storage = mutableStorage(true);
+        if (!storage.index_.valid()) storage.indexRebuild();
+        const Index::Entry* entry = storage.indexFind(key);
+        if (entry == 0) return storage.metadata_.end();
+        if (   entry->pos_->ifdId() != key.ifdId()
+            || entry->pos_->tag() != key.tag()) {
+            // The key of the indexed Exifdatum was changed, rebuild the index
+            storage.indexRebuild();
+            entry = storage.indexFind(key);
+            if (entry == 0) return storage.metadata_.end();
+        }
+        return entry->pos_;
     }
 
     void ExifData::clear()
     {
-        exifMetadata_.clear();
+        // Start from new storage, copies which share the old one keep it
+        storage_ = std::make_shared<Storage>();
+        makernote_.reset();
+        tiffOffset_ = -1;
+    }
+
+    bool ExifData::makernotePending() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return makernote_ != nullptr;
+    }
+
+    MemoryUsage ExifData::memoryUsage() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        MemoryUsage usage;
+        const ExifMetadata& metadata = decodedMetadata();
+        for (ExifMetadata::const_iterator i = metadata.begin(); i != metadata.end(); ++i) {
+            // The nodes of the list link to the previous and the next node
+            usage.datums_ += sizeof(Exifdatum) + 2 * sizeof(void*);
+            Internal::addDatumMemory(usage, *i, sizeof(ExifKey));
+            usage.values_ += i->sizeDataArea();
+        }
+        usage.datums_ += Internal::hashMapMemory(storage_->index_.map());
+        if (makernote_) usage.buffers_ += makernote_->memoryUsage();
+        if (embedded_) {
+            for (ExifMetadata::const_iterator i = embedded_->begin(); i != embedded_->end(); ++i) {
+                usage.buffers_ += i->size();
+            }
+        }
+        return usage;
+    }
+
+    void ExifData::decodeMakernote() const
+    {
+        // Readers in other threads wait until the metadata are complete
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!makernote_) return;
+        // Release the makernote first, lookups while decoding must not recurse
+        std::shared_ptr<const Internal::DeferredMakernote> makernote;
+        makernote.swap(makernote_);
+
+        ExifData decoded;
+        decoded.setDecodeFilter(decodeFilter_);
+        try {
+            makernote->decode(decoded);
+        }
+        catch (const AnyError& error) {
+#ifndef SUPPRESS_WARNINGS
+            EXV_WARNING << "Failed to decode the makernote: " << error << "\n";
+#endif
+            return;
+        }
+        // Insert the makernote after its binary tag, as a decoder would
+        Storage& storage = mutableStorage(false);
+        const ExifKey key(makernote->tag(), Internal::groupName(makernote->group()));
+        ExifMetadata::iterator pos = std::find_if(storage.metadata_.begin(), storage.metadata_.end(),
+                                                  FindExifdatumByKey(key));
+        if (pos != storage.metadata_.end()) ++pos;
+        storage.metadata_.splice(pos, decoded.storage_->metadata_);
+        storage.index_.invalidate();
+    }
+
+    void ExifData::decodeEmbedded(IptcData& iptcData, XmpData& xmpData, ByteOrder byteOrder)
+    {
+        if (!embedded_) return;
+        std::shared_ptr<const ExifMetadata> embedded;
+        embedded.swap(embedded_);
+
+        // The decoders read the tags from the TIFF structure, here they are copies of the values
+        DataBuf iptc;
+        DataBuf irb;
+        DataBuf xmp;
+        for (ExifMetadata::const_iterator i = embedded->begin(); i != embedded->end(); ++i) {
+            DataBuf& buf = i->tag() == 0x83bb ? iptc : i->tag() == 0x8649 ? irb : xmp;
+            buf.alloc(i->size());
+            i->copy(buf.pData_, byteOrder);
+        }
+        if (iptc.size_ > 0 || irb.size_ > 0) {
+            iptcData.clear();
+            Internal::decodeIptcTags(iptcData, iptc.pData_, iptc.size_, irb.pData_, irb.size_);
+        }
+        if (xmp.size_ > 0) {
+            xmpData.clear();
+            Internal::decodeXmpTag(xmpData, xmp.pData_, xmp.size_);
+        }
+    }
+
+    void ExifData::keepEmbedded()
+    {
+        embedded_.reset();
+        if (!lazyEmbedded_) return;
+        // IPTCNAA, ImageResources and XMLPacket
+        const uint16_t tags[] = { 0x83bb, 0x8649, 0x02bc };
+        std::shared_ptr<ExifMetadata> embedded = std::make_shared<ExifMetadata>();
+        for (unsigned int i = 0; i < EXV_COUNTOF(tags); ++i) {
+            const_iterator pos = findDecoded(ExifKey(tags[i], "Image"));
+            if (pos != decodedMetadata().end() && pos->size() > 0) embedded->push_back(*pos);
+        }
+        if (!embedded->empty()) embedded_ = embedded;
+    }
+
+    bool ExifData::hasImageTag(uint16_t tag) const
+    {
+        return findDecoded(ExifKey(tag, "Image")) != decodedMetadata().end();
     }
 
     void ExifData::sortByKey()
     {
-        exifMetadata_.sort(cmpMetadataByKey);
+        decodeMakernote();
+        Storage& storage = mutableStorage(false);
+        Internal::sortMetadata(storage.metadata_, [](const Exifdatum& md) { return md.key(); });
+        storage.index_.invalidate();
     }
 
     void ExifData::sortByTag()
     {
-        exifMetadata_.sort(cmpMetadataByTag);
+        decodeMakernote();
+        Storage& storage = mutableStorage(false);
+        Internal::sortMetadata(storage.metadata_, [](const Exifdatum& md) { return md.tag(); });
+        storage.index_.invalidate();
     }
 
     ExifData::iterator ExifData::erase(ExifData::iterator beg, ExifData::iterator end)
     {
-        return exifMetadata_.erase(beg, end);
+        // The iterators were handed out by a mutable accessor, the storage is not shared
+        Storage& storage = mutableStorage(true);
+        // Updating the index for each of many metadata could take quadratic time
+        if (beg != end && std::next(beg) != end) storage.index_.invalidate();
+        else if (beg != end) storage.indexErase(beg);
+        return storage.metadata_.erase(beg, end);
     }
 
     ExifData::iterator ExifData::erase(ExifData::iterator pos)
     {
-        return exifMetadata_.erase(pos);
+        Storage& storage = mutableStorage(true);
+        storage.indexErase(pos);
+        return storage.metadata_.erase(pos);
+    }
+
+    void ExifData::Storage::indexAdd(iterator pos)
+    {
+        index_.add(indexId(pos->ifdId(), pos->tag()), pos);
+    }
+
+    void ExifData::Storage::indexErase(iterator pos)
+    {
+        const int ifdId = pos->ifdId();
+        const uint16_t tag = pos->tag();
+        const iterator end = metadata_.end();
+        index_.erase(indexId(ifdId, tag), pos, [pos, end, ifdId, tag](iterator& next) {
+            next = std::find_if(std::next(pos), end, [ifdId, tag](const Exifdatum& md) {
+                return md.ifdId() == ifdId && md.tag() == tag;
+            });
+            return next != end;
+        });
+    }
+
+    void ExifData::Storage::indexRebuild()
+    {
+        index_.rebuild(metadata_.begin(), metadata_.end(),
+                       [](iterator pos) { return indexId(pos->ifdId(), pos->tag()); });
+    }
+
+    const ExifData::Index::Entry* ExifData::Storage::indexFind(const ExifKey& key) const
+    {
+        return index_.find(indexId(key.ifdId(), key.tag()));
     }
 
     ByteOrder ExifParser::decode(
@@ -617,18 +1144,30 @@ namespace Exiv2 {
               uint32_t  size
     )
     {
+        // Embedded IPTC and XMP would be discarded, the decoder only keeps the raw tags
         IptcData iptcData;
         XmpData  xmpData;
-        ByteOrder bo = TiffParser::decode(exifData,
-                                          iptcData,
-                                          xmpData,
-                                          pData,
-                                          size);
+        const bool lazyEmbedded = exifData.lazyEmbedded();
+        exifData.setLazyEmbedded(true);
+        ByteOrder bo;
+        try {
+            bo = TiffParser::decode(exifData,
+                                    iptcData,
+                                    xmpData,
+                                    pData,
+                                    size);
+        }
+        catch (...) {
+            exifData.setLazyEmbedded(lazyEmbedded);
+            throw;
+        }
+        exifData.setLazyEmbedded(lazyEmbedded);
+        exifData.embedded_.reset();
 #ifndef SUPPRESS_WARNINGS
-        if (!iptcData.empty()) {
+        if (exifData.hasImageTag(0x83bb) || exifData.hasImageTag(0x8649)) {
             EXV_WARNING << "Ignoring IPTC information encoded in the Exif data.\n";
         }
-        if (!xmpData.empty()) {
+        if (exifData.hasImageTag(0x02bc)) {
             EXV_WARNING << "Ignoring XMP information encoded in the Exif data.\n";
         }
 #endif
@@ -651,7 +1190,9 @@ namespace Exiv2 {
         const ExifData& exifData
     )
     {
+        // The copy shares the metadata until a tag is erased, lookups are const to keep it so
         ExifData ed = exifData;
+        const ExifData& ced = ed;
 
         // Delete IFD0 tags that are "not recorded" in compressed images
         // Reference: Exif 2.2 specs, 4.6.8 Tag Support Levels, section A
@@ -665,12 +1206,13 @@ namespace Exiv2 {
             "Exif.Image.SubIFDs"
         };
         for (unsigned int i = 0; i < EXV_COUNTOF(filteredIfd0Tags); ++i) {
-            ExifData::iterator pos = ed.findKey(ExifKey(filteredIfd0Tags[i]));
-            if (pos != ed.end()) {
+            const ExifKey key(filteredIfd0Tags[i]);
+            // Neither these tags nor the IFDs below are in a makernote, leave a pending one as it is
+            if (ced.findDecoded(key) != ced.decodedMetadata().end()) {
 #ifdef DEBUG
-                std::cerr << "Warning: Exif tag " << pos->key() << " not encoded\n";
+                std::cerr << "Warning: Exif tag " << key << " not encoded\n";
 #endif
-                ed.erase(pos);
+                ed.erase(ed.findKey(key));
             }
         }
 
@@ -694,14 +1236,19 @@ namespace Exiv2 {
 #ifdef DEBUG
             std::cerr << "Warning: Exif IFD " << filteredIfds[i] << " not encoded\n";
 #endif
-            eraseIfd(ed, filteredIfds[i]);
+            const ExifMetadata& md = ced.decodedMetadata();
+            if (std::find_if(md.begin(), md.end(), FindExifdatum(filteredIfds[i])) != md.end()) {
+                eraseIfd(ed, filteredIfds[i]);
+            }
         }
 
         // IPTC and XMP are stored elsewhere, not in the Exif APP1 segment.
         IptcData emptyIptc;
         XmpData  emptyXmp;
 
-        // Encode and check if the result fits into a JPEG Exif APP1 segment
+        // Encode if the result fits into a JPEG Exif APP1 segment, the size
+        // of a new structure is known from the composite before it is written
+        const uint32_t sizeLimit = 65527;
         MemIo mio1;
         std::unique_ptr<TiffHeaderBase> header(new TiffHeader(byteOrder, 0x00000008, false));
         WriteMethod wm = TiffParserWorker::encode(mio1,
@@ -713,8 +1260,10 @@ namespace Exiv2 {
                                                   Tag::root,
                                                   TiffMapping::findEncoder,
                                                   header.get(),
-                                                  0);
-        if (mio1.size() <= 65527) {
+                                                  0,
+                                                  false,
+                                                  sizeLimit);
+        if (wm == wmNonIntrusive || mio1.size() > 0) {
             append(blob, mio1.mmap(), (uint32_t) mio1.size());
             return wm;
         }
@@ -756,17 +1305,18 @@ namespace Exiv2 {
         };
         bool delTags = false;
         ExifData::iterator pos;
+        ExifData::const_iterator cpos;
         for (unsigned int i = 0; i < EXV_COUNTOF(filteredPvTags); ++i) {
             switch (filteredPvTags[i].ptt_) {
             case pttLen:
                 delTags = false;
-                pos = ed.findKey(ExifKey(filteredPvTags[i].key_));
-                if (pos != ed.end() && sumToLong(*pos) > 32768) {
+                cpos = ced.findKey(ExifKey(filteredPvTags[i].key_));
+                if (cpos != ced.end() && sumToLong(*cpos) > 32768) {
                     delTags = true;
 #ifndef SUPPRESS_WARNINGS
-                    EXV_WARNING << "Exif tag " << pos->key() << " not encoded\n";
+                    EXV_WARNING << "Exif tag " << cpos->key() << " not encoded\n";
 #endif
-                    ed.erase(pos);
+                    ed.erase(ed.findKey(ExifKey(filteredPvTags[i].key_)));
                 }
                 break;
             case pttTag:
@@ -792,9 +1342,12 @@ namespace Exiv2 {
         }
 
         // Delete unknown tags larger than 4kB and known tags larger than 20kB.
-        for (ExifData::iterator tag_iter = ed.begin(); tag_iter != ed.end(); ) {
-            if ( (tag_iter->size() > 4096 && tag_iter->tagName().substr(0, 2) == "0x") ||
-                  tag_iter->size() > 20480) {
+        auto tooLarge = [](const Exifdatum& md) {
+            return (md.size() > 4096 && md.tagName().substr(0, 2) == "0x") || md.size() > 20480;
+        };
+        const bool hasLargeTags = std::find_if(ced.begin(), ced.end(), tooLarge) != ced.end();
+        for (ExifData::iterator tag_iter = ed.begin(); hasLargeTags && tag_iter != ed.end(); ) {
+            if (tooLarge(*tag_iter)) {
 #ifndef SUPPRESS_WARNINGS
                 EXV_WARNING << "Exif tag " << tag_iter->key() << " not encoded\n";
 #endif
@@ -805,7 +1358,7 @@ namespace Exiv2 {
             }
         }
 
-        // Encode the remaining Exif tags again, don't care if it fits this time
+        // Encode the remaining Exif tags, don't care if it fits this time
         MemIo mio2;
         wm = TiffParserWorker::encode(mio2,
                                       pData,
@@ -933,6 +1486,9 @@ namespace {
 
     void eraseIfd(Exiv2::ExifData& ed, Exiv2::IfdId ifdId)
     {
+        // Look first, mutable iterators would stop the container from sharing its metadata
+        const Exiv2::ExifData& ced = ed;
+        if (std::find_if(ced.begin(), ced.end(), Exiv2::FindExifdatum(ifdId)) == ced.end()) return;
         ed.erase(std::remove_if(ed.begin(),
                                 ed.end(),
                                 Exiv2::FindExifdatum(ifdId)),
@@ -44,6 +44,15 @@
 #include <cstring>
 #include <cassert>
 #include <cctype>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 #if defined(EXV_HAVE_REGEX_H)
 #include <regex.h>
@@ -51,6 +60,10 @@
 
 #if defined(_MSC_VER)
 #include <Windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #endif
 
 // *****************************************************************************
@@ -109,6 +122,18 @@ namespace {
     bool parseCmdLines(ModifyCmds& modifyCmds,
                        const Params::CmdLines& cmdLines);
 
+    /*!
+      @brief Parse metadata modification commands for individual files from
+             batch files
+      @param fileCmds Reference to a structure to store the parsed commands
+      @param files Container to which the files named in the batch files are
+             added, unless they are already in it
+      @param batchFiles Container with the names of the batch files
+     */
+    bool parseBatchFiles(Params::FileCmds& fileCmds,
+                         Params::Files& files,
+                         const Params::CmdFiles& batchFiles);
+
     /*!
       @brief Parse one line of the command file
       @param modifyCmd Reference to a command structure to store the parsed
@@ -124,6 +149,127 @@ namespace {
       @param input Input string, assumed to be UTF-8
      */
     std::string parseEscapes(const std::string& input);
+
+    //! Print the number of the file being processed (verbose mode), \em s is 0 if unknown
+    void printFileNumber(std::ostream& os, int n, int s, const std::string& path);
+
+    /*!
+      @brief Return the stream for the verbose messages about \em path. This is
+             standard error if the image itself is written to standard output.
+     */
+    std::ostream& verboseOut(const Params& params, const std::string& path);
+
+    //! Print the stats of the IO sources used to process \em path (option -I)
+    void printStats(std::ostream& os, const std::string& path, const Exiv2::IoStats& stats);
+
+    //! Run \em task on \em path and print the stats of the file if requested
+    int runTask(Action::Task& task, const std::string& path);
+
+    //! Start recording the events of Exiv2::Trace for option -Z
+    void startTrace();
+
+    /*!
+      @brief Stop recording the trace events and write them to \em path in
+             the Chrome trace event format. Return false if that fails.
+     */
+    bool writeTrace(const std::string& path);
+
+    //! Kinds of directory entries
+    enum FileKind { fkFile, fkDirectory, fkOther };
+
+    /*!
+      @brief Return the kind of \em path. Symbolic links to directories are
+             not followed and count as fkOther, paths which cannot be
+             accessed as fkFile, so that the task reports the error.
+     */
+    FileKind fileKind(const std::string& path);
+
+    /*!
+      @brief Produces the files to process from the file arguments. With
+             option -R, directories are walked recursively, reading each
+             directory only when its files are needed.
+     */
+    class FileSource {
+    public:
+        //! Constructor, takes the file arguments and options from \em params.
+        explicit FileSource(const Params& params);
+        /*!
+          @brief Set \em path to the next file to process.
+          @return false if there are no more files
+         */
+        bool next(std::string& path);
+        //! Return the number of files if known in advance, else 0.
+        int size() const;
+        //! Return true if a directory could not be read.
+        bool failed() const { return failed_; }
+
+    private:
+        //! A file or directory in a directory being walked
+        struct Entry {
+            std::string path_;              //!< Path of the entry
+            unsigned long long inode_;      //!< Inode number, 0 if not available
+        };
+        //! Entries of a directory, in reverse order of processing
+        typedef std::vector<Entry> Entries;
+
+        //! Read the entries of directory \em dir and push them on the stack.
+        void readDir(const std::string& dir);
+
+        const Params::Files& files_;        //!< File arguments
+        size_t arg_;                        //!< Next file argument
+        bool recursive_;                    //!< Walk directories (-R)
+        bool inodeOrder_;                   //!< Sort directory entries by inode (-N)
+        bool failed_;                       //!< Set if a directory could not be read
+        std::vector<Entries> dirs_;         //!< Stack of directories being walked
+    };
+
+    /*!
+      @brief Run a task on all files, one file per job at a time.
+      @param task Prototype of the task, each job runs a clone of it
+      @param files Source of the files to process
+      @param jobs Number of jobs (threads) to use
+      @return The first non-zero return code of a task, 0 if all succeeded
+      @throw Any exception thrown by a task, after the output of the preceding
+             files has been written
+
+      The output and error messages of each file are buffered and written
+      in the order of the files.
+     */
+    int runInParallel(const Action::Task& task, FileSource& files, unsigned int jobs);
+
+    //! Log message handler which writes to the error stream of the current task
+    void taskLogHandler(int level, const char* s);
+
+    /*!
+      @brief Run the index action: update the index file of option -x with
+             the files, with -j jobs, and write it.
+      @return 0 if all files were indexed
+     */
+    int updateIndex(const Params& params);
+
+    /*!
+      @brief Run the query action: print the files in the index file of
+             option -x which match all conditions, and with -K the values
+             of the keys in these files.
+      @return 0 if the query succeeded, also if no file matches
+     */
+    int queryIndex(const Params& params);
+
+    /*!
+      @brief Run as a server: read commands from \em in, one JSON object
+             per line, and write one JSON object per command to \em out.
+      @param progname Program name, used as the first command line argument
+      @param in Input stream with the commands
+      @param out Output stream for the results
+      @return 0 when the end of the input is reached
+
+      A command is an object with an array "args" of command line arguments
+      and an optional "id", e.g., {"id":1,"args":["-pa","image.jpg"]}. The
+      result has the same "id", the return code "rc" and the buffered output
+      and error messages of the command in "out" and "err". The XMP toolkit
+      is initialized once for all commands.
+     */
+    int serve(const char* progname, std::istream& in, std::ostream& out);
 }
 
 // *****************************************************************************
@@ -137,6 +283,10 @@ int main(int argc, char* const argv[])
     textdomain(EXV_PACKAGE_NAME);
 #endif
 
+    if (argc == 2 && std::strcmp(argv[1], "--serve") == 0) {
+        return serve(argv[0], std::cin, std::cout);
+    }
+
     // Handle command line arguments
     Params& params = Params::instance();
     if (params.getopt(argc, argv)) {
@@ -152,27 +302,54 @@ int main(int argc, char* const argv[])
         return 0;
     }
 
+    if (!params.traceFile_.empty()) {
+        startTrace();
+    }
+
     int rc = 0;
 
     try {
-        // Create the required action class
         Action::TaskFactory& taskFactory = Action::TaskFactory::instance();
-        Action::Task::UniquePtr task = taskFactory.create(Action::TaskType(params.action_));
-        assert(task.get());
-
-        // Process all files
-        int n = 1;
-        int s = static_cast<int>(params.files_.size());
-        int w = s > 9 ? s > 99 ? 3 : 2 : 1;
-        for (Params::Files::const_iterator i = params.files_.begin(); i != params.files_.end(); ++i) {
-            if (params.verbose_) {
-                std::cout << _("File") << " " << std::setw(w) << std::right << n++ << "/" << s << ": " << *i
-                          << std::endl;
+        if (params.action_ == Action::index || params.action_ == Action::query) {
+            // These actions work on all files at once
+            rc = params.action_ == Action::index ? updateIndex(params) : queryIndex(params);
+        } else {
+            // Create the required action class
+            Action::Task::UniquePtr task = taskFactory.create(Action::TaskType(params.action_));
+            assert(task.get());
+
+            // Renaming may prompt the user and checks for existing files, so
+            // it is always done sequentially. So is reading an image from stdin.
+            const bool parallel =    params.jobs_ > 1 && params.manyFiles()
+                                  && params.action_ != Action::rename
+                                  && std::find(params.files_.begin(), params.files_.end(), "-") == params.files_.end();
+            // Images from the same camera print the same lens and setting strings
+            if (params.action_ == Action::print && params.manyFiles()) {
+                Exiv2::PrintCache::setCapacity(4096);
             }
-            int ret = task->run(*i);
-            if (rc == 0)
-                rc = ret;
+            FileSource files(params);
+            if (parallel) {
+                Exiv2::LogMsg::setHandler(taskLogHandler);
+                rc = runInParallel(*task, files, params.jobs_);
+            } else {
+                // Process all files
+                int n = 1;
+                int s = files.size();
+                std::string path;
+                while (files.next(path)) {
+                    if (params.verbose_) {
+                        printFileNumber(verboseOut(params, path), n++, s, path);
+                    }
+                    int ret = runTask(*task, path);
+                    if (rc == 0)
+                        rc = ret;
+                }
+            }
+            if (rc == 0 && files.failed())
+                rc = 1;
         }
+        if (!params.traceFile_.empty() && !writeTrace(params.traceFile_) && rc == 0)
+            rc = 1;
 
         taskFactory.cleanup();
         params.cleanup();
@@ -271,6 +448,11 @@ void Params::help(std::ostream& os) const
             "                Exif tag.\n")
        << _("  fc | fixcom   Convert the UNICODE Exif user comment to UCS-2. Its current\n"
             "                character encoding can be specified with the -n option.\n")
+       << _("  ix | index    Add the files to the index file of option -x, reading only\n"
+            "                new and changed files. The keys to index are set with -K.\n")
+       << _("  qu | query    Print the files in the index file of option -x which match\n"
+            "                all conditions key=value or key (has the key) given as\n"
+            "                arguments. With -K, print the values of these keys.\n")
        << _("\nOptions:\n")
        << _("   -h      Display this help and exit.\n")
        << _("   -V      Show the program version and exit.\n")
@@ -302,6 +484,7 @@ void Params::help(std::ostream& os) const
        << _("             h : hexdump of the Exif data (-PExgnycsh)\n")
        << _("             i : IPTC data values (-PIkyct)\n")
        << _("             x : XMP properties (-PXkyct)\n")
+       << _("             j : Exif, IPTC and XMP metadata as JSON lines (-Pkycvtj)\n")
        << _("             c : JPEG comment\n")
        << _("             p : list available previews\n")
        << _("             C : print ICC profile embedded in image\n")
@@ -323,6 +506,7 @@ void Params::help(std::ostream& os) const
        << _("             v : plain data value\n")
        << _("             t : interpreted (translated) data\n")
        << _("             h : hexdump of the data\n")
+       << _("             j : print the items as one JSON object per line\n")
        << _("   -d tgt  Delete target(s) for the 'delete' action. Possible targets are:\n")
        << _("             a : all supported metadata (the default)\n")
        << _("             e : Exif section\n")
@@ -352,8 +536,30 @@ void Params::help(std::ostream& os) const
             "           set|add|del <key> [[<type>] <value>].\n")
        << _("   -M cmd  Command line for the modify action. The format for the\n"
             "           commands is the same as that of the lines of a command file.\n")
+       << _("   -B file Batch file for the modify action. A line [file] names an image,\n"
+            "           the following lines are the commands for it, in the format of a\n"
+            "           command file. The images are added to the files to process and\n"
+            "           each is written once, after all its commands are applied.\n")
        << _("   -l dir  Location (directory) for files to be inserted from or extracted to.\n")
-       << _("   -S .suf Use suffix .suf for source files for insert command.\n\n");
+       << _("   -S .suf Use suffix .suf for source files for insert command.\n")
+       << _("   -j num  Number of files to process in parallel, 0 for one per processor.\n"
+            "           Output is written in the order of the files. The 'rename' action\n"
+            "           always processes one file at a time.\n")
+       << _("   -R      Process the files in directories and their subdirectories.\n"
+            "           Each directory is read when its files are needed, and its files\n"
+            "           are processed in the order of their names.\n")
+       << _("   -N      With -R, process the files of each directory in the order of\n"
+            "           their inodes (inode-order), which reduces seeks on hard disks.\n")
+       << _("   -I      Print the reads, writes, seeks and allocations of each file, the\n"
+            "           time spent decoding and writing metadata and the memory held by\n"
+            "           the metadata (stats).\n")
+       << _("   -Z file Write a trace of the time spent in each phase of processing the\n"
+            "           files to file, in the Chrome trace event format (JSON).\n")
+       << _("   -x file Index file for the 'index' and 'query' actions.\n")
+       << _("   --serve Read commands from standard input, one JSON object per line\n"
+            "           like {\"id\":1,\"args\":[\"-pa\",\"image.jpg\"]}, and write one JSON\n"
+            "           object with \"id\", \"rc\", \"out\" and \"err\" per command to standard\n"
+            "           output. Must be the only argument.\n\n");
 } // Params::help
 
 int Params::option(int opt, const std::string& optarg, int optopt)
@@ -389,8 +595,15 @@ int Params::option(int opt, const std::string& optarg, int optopt)
     case 'c': rc = evalModify(opt, optarg); break;
     case 'm': rc = evalModify(opt, optarg); break;
     case 'M': rc = evalModify(opt, optarg); break;
+    case 'B': rc = evalModify(opt, optarg); break;
     case 'l': directory_ = optarg; break;
     case 'S': suffix_ = optarg; break;
+    case 'j': rc = evalJobs(optarg); break;
+    case 'R': recursive_ = true; break;
+    case 'N': inodeOrder_ = true; break;
+    case 'I': stats_ = true; break;
+    case 'Z': traceFile_ = optarg; break;
+    case 'x': indexFile_ = optarg; break;
     case ':':
         std::cerr << progname() << ": " << _("Option") << " -" << static_cast<char>(optopt)
                    << " " << _("requires an argument\n");
@@ -606,6 +819,9 @@ int Params::evalPrint(const std::string& optarg)
                 case 'x':
                     rc = evalPrintFlags("Xkyct");
                     break;
+                case 'j':
+                    rc = evalPrintFlags("kycvtj");
+                    break;
                 case 'c':
                     action_ = Action::print;
                     printMode_ = pmComment;
@@ -677,6 +893,7 @@ int Params::evalPrintFlags(const std::string& optarg)
             case 't': printItems_ |= prTrans; break;
             case 'h': printItems_ |= prHex;   break;
             case 'V': printItems_ |= prSet|prValue;break;
+            case 'j': printItems_ |= prJson;  break;
             default:
                 std::cerr << progname() << ": " << _("Unrecognized print item") << " `"
                           << optarg[i] << "'\n";
@@ -794,6 +1011,7 @@ int Params::evalModify(int opt, const std::string& optarg)
         if (opt == 'c') jpegComment_ = parseEscapes(optarg);
         if (opt == 'm') cmdFiles_.push_back(optarg);  // parse the files later
         if (opt == 'M') cmdLines_.push_back(optarg);  // parse the commands later
+        if (opt == 'B') batchFiles_.push_back(optarg); // parse the files later
         break;
     default:
         std::cerr << progname() << ": "
@@ -805,6 +1023,21 @@ int Params::evalModify(int opt, const std::string& optarg)
     return rc;
 } // Params::evalModify
 
+int Params::evalJobs(const std::string& optarg)
+{
+    long jobs = 0;
+    if (!Util::strtol(optarg.c_str(), jobs) || jobs < 0) {
+        std::cerr << progname() << ": " << _("Error parsing -j option argument") << " `"
+                  << optarg << "'\n";
+        return 1;
+    }
+    if (jobs == 0) {
+        jobs = std::thread::hardware_concurrency();
+    }
+    jobs_ = jobs > 0 ? static_cast<unsigned int>(jobs) : 1;
+    return 0;
+} // Params::evalJobs
+
 int Params::nonoption(const std::string& argv)
 {
     int rc = 0;
@@ -897,6 +1130,24 @@ int Params::nonoption(const std::string& argv)
             action = true;
             action_ = Action::fixcom;
         }
+        if (argv == "ix" || argv == "index") {
+            if (action_ != Action::none && action_ != Action::index) {
+                std::cerr << progname() << ": "
+                          << _("Action index is not compatible with the given options\n");
+                rc = 1;
+            }
+            action = true;
+            action_ = Action::index;
+        }
+        if (argv == "qu" || argv == "query") {
+            if (action_ != Action::none && action_ != Action::query) {
+                std::cerr << progname() << ": "
+                          << _("Action query is not compatible with the given options\n");
+                rc = 1;
+            }
+            action = true;
+            action_ = Action::query;
+        }
         if (action_ == Action::none) {
             // if everything else fails, assume print as the default action
             action_ = Action::print;
@@ -936,6 +1187,10 @@ static int readFileToBuf(FILE* f,Exiv2::DataBuf& buf)
 //#define DEBUG
 void Params::getStdin(Exiv2::DataBuf& buf)
 {
+    // Tasks run in parallel (option -j) may read stdin concurrently
+    static std::mutex stdinMutex;
+    std::lock_guard<std::mutex> lock(stdinMutex);
+
     // copy stdin to stdinBuf
     if ( stdinBuf.size_ == 0 ) {
 #if defined(_WIN32) || defined(__CYGWIN__) || defined(__MINGW__) || defined(_MSC_VER)
@@ -1006,16 +1261,23 @@ int Params::getopt(int argc, char* const Argv[])
     longs["--grep"     ] = "-g";
     longs["--help"     ] = "-h";
     longs["--insert"   ] = "-i";
+    longs["--jobs"     ] = "-j";
     longs["--keep"     ] = "-k";
     longs["--key"      ] = "-K";
     longs["--location" ] = "-l";
     longs["--modify"   ] = "-m";
     longs["--Modify"   ] = "-M";
+    longs["--batch"    ] = "-B";
     longs["--encode"   ] = "-n";
     longs["--months"   ] = "-O";
     longs["--print"    ] = "-p";
     longs["--Print"    ] = "-P";
     longs["--quiet"    ] = "-q";
+    longs["--recursive"] = "-R";
+    longs["--inode-order"] = "-N";
+    longs["--index"    ] = "-x";
+    longs["--stats"    ] = "-I";
+    longs["--trace"    ] = "-Z";
     longs["--log"      ] = "-Q";
     longs["--rename"   ] = "-r";
     longs["--suffix"   ] = "-S";
@@ -1057,15 +1319,38 @@ int Params::getopt(int argc, char* const Argv[])
         rc = 1;
     }
     if (   action_ == Action::modify
-        && cmdFiles_.empty() && cmdLines_.empty() && jpegComment_.empty()) {
+        && cmdFiles_.empty() && cmdLines_.empty() && jpegComment_.empty() && batchFiles_.empty()) {
         std::cerr << progname() << ": "
-                  << _("Modify action requires at least one -c, -m or -M option\n");
+                  << _("Modify action requires at least one -c, -m, -M or -B option\n");
         rc = 1;
     }
-    if (0 == files_.size()) {
+    if (!batchFiles_.empty() && action_ != Action::modify) {
+        std::cerr << progname() << ": "
+                  << _("-B option can only be used with modify action\n");
+        rc = 1;
+    }
+    if (rc == 0 && !batchFiles_.empty()) {
+        // Parse batch files, the images they name are added to the files
+        if (!parseBatchFiles(fileCmds_, files_, batchFiles_)) {
+            std::cerr << progname() << ": " << _("Error parsing -B option arguments\n");
+            rc = 1;
+        }
+    }
+    // The arguments of the query action are its conditions, it may have none
+    if (0 == files_.size() && action_ != Action::query) {
         std::cerr << progname() << ": " << _("At least one file is required\n");
         rc = 1;
     }
+    if ((action_ == Action::index || action_ == Action::query) && indexFile_.empty()) {
+        std::cerr << progname() << ": "
+                  << _("The index and query actions require option -x\n");
+        rc = 1;
+    }
+    if (!indexFile_.empty() && !(action_ == Action::index || action_ == Action::query)) {
+        std::cerr << progname() << ": "
+                  << _("-x option can only be used with index or query actions\n");
+        rc = 1;
+    }
     if (rc == 0 && !cmdFiles_.empty()) {
         // Parse command files
         if (!parseCmdFiles(modifyCmds_, cmdFiles_)) {
@@ -1080,7 +1365,7 @@ int Params::getopt(int argc, char* const Argv[])
             rc = 1;
         }
     }
-    if (rc == 0 && (!cmdFiles_.empty() || !cmdLines_.empty())) {
+    if (rc == 0 && (!cmdFiles_.empty() || !cmdLines_.empty() || !batchFiles_.empty())) {
         // We'll set them again, after reading the file
         Exiv2::XmpProperties::unregisterNs();
     }
@@ -1105,6 +1390,15 @@ int Params::getopt(int argc, char* const Argv[])
                   << _("-T option can only be used with rename action\n");
         rc = 1;
     }
+    if (printMode_ == pmList) {
+        // Set defaults for metadata types and data columns
+        if (printTags_ == Exiv2::mdNone) {
+            printTags_ = Exiv2::mdExif | Exiv2::mdIptc | Exiv2::mdXmp;
+        }
+        if ((printItems_ & ~prJson) == 0) {
+            printItems_ |= prKey | prType | prCount | prTrans;
+        }
+    }
 
  cleanup:
     // cleanup the argument vector
@@ -1318,6 +1612,60 @@ namespace {
         }
     } // parseCmdLines
 
+    bool parseBatchFiles(Params::FileCmds& fileCmds,
+                         Params::Files& files,
+                         const Params::CmdFiles& batchFiles)
+    {
+        Params::CmdFiles::const_iterator end = batchFiles.end();
+        Params::CmdFiles::const_iterator filename = batchFiles.begin();
+        for ( ; filename != end; ++filename) {
+            try {
+                std::ifstream file(filename->c_str());
+                bool bStdin = filename->compare("-")== 0;
+                if (!file && !bStdin) {
+                    std::cerr << *filename << ": "
+                              << _("Failed to open batch file for reading\n");
+                    return false;
+                }
+                int num = 0;
+                std::string line;
+                ModifyCmds* modifyCmds = nullptr;
+                while (bStdin?std::getline(std::cin, line):std::getline(file, line)) {
+                    ++num;
+                    // A line [file] starts the commands for that file
+                    std::string::size_type first = line.find_first_not_of(" \t");
+                    std::string::size_type last = line.find_last_not_of(" \t\r");
+                    if (first != std::string::npos && line[first] == '[' && line[last] == ']' && last > first + 1) {
+                        const std::string path = line.substr(first + 1, last - first - 1);
+                        Params::FileCmds::iterator pos = fileCmds.find(path);
+                        if (pos == fileCmds.end()) {
+                            pos = fileCmds.insert(std::make_pair(path, ModifyCmds())).first;
+                            if (std::find(files.begin(), files.end(), path) == files.end()) {
+                                files.push_back(path);
+                            }
+                        }
+                        modifyCmds = &pos->second;
+                        continue;
+                    }
+                    ModifyCmd modifyCmd;
+                    if (parseLine(modifyCmd, line, num)) {
+                        if (modifyCmds == nullptr) {
+                            std::cerr << *filename << ", " << _("line") << " " << num << ": "
+                                      << _("Command before the first [file] line\n");
+                            return false;
+                        }
+                        modifyCmds->push_back(modifyCmd);
+                    }
+                }
+            }
+            catch (const Exiv2::AnyError& error) {
+                std::cerr << *filename << ", " << _("line") << " " << error << "\n";
+                return false;
+            }
+        }
+        return true;
+    } // parseBatchFiles
+
 #if defined(_MSC_VER) || defined(__MINGW__)
     static std::string formatArg(const char* arg)
     {
@@ -1548,5 +1896,787 @@ namespace {
         return result;
     }
 
-}
+    void printFileNumber(std::ostream& os, int n, int s, const std::string& path)
+    {
+        if (s == 0) {
+            os << _("File") << " " << n << ": " << path << std::endl;
+            return;
+        }
+        int w = s > 9 ? s > 99 ? 3 : 2 : 1;
+        os << _("File") << " " << std::setw(w) << std::right << n << "/" << s << ": " << path
+           << std::endl;
+    }
+
+    std::ostream& verboseOut(const Params& params, const std::string& path)
+    {
+        return params.action_ == Action::modify && path == "-" ? std::cerr : std::cout;
+    }
+
+    void printStats(std::ostream& os, const std::string& path, const Exiv2::IoStats& stats)
+    {
+        const int w = 18;
+        std::ostringstream out;
+        out << _("Stats of") << " " << path << ":\n" << std::left
+           << "  " << std::setw(w) << _("Reads") << ": " << stats.reads_
+           << " (" << stats.bytesRead_ << " " << _("bytes") << ")\n"
+           << "  " << std::setw(w) << _("Writes") << ": " << stats.writes_
+           << " (" << stats.bytesWritten_ << " " << _("bytes") << ")\n"
+           << "  " << std::setw(w) << _("Seeks") << ": " << stats.seeks_ << "\n"
+           << "  " << std::setw(w) << _("Memory maps") << ": " << stats.mmaps_ << "\n"
+           << "  " << std::setw(w) << _("Remote requests") << ": " << stats.remoteRequests_ << "\n"
+           << "  " << std::setw(w) << _("Allocations") << ": " << stats.allocations_
+           << " (" << stats.bytesAllocated_ << " " << _("bytes") << ")\n"
+           << std::fixed << std::setprecision(3)
+           << "  " << std::setw(w) << _("TIFF decoding") << ": " << stats.tiffDecodeTime_ * 1000 << " ms\n"
+           << "  " << std::setw(w) << _("XMP decoding") << ": " << stats.xmpDecodeTime_ * 1000 << " ms\n"
+           << "  " << std::setw(w) << _("Writing metadata") << ": " << stats.writeMetadataTime_ * 1000
+           << " ms\n"
+           << "  " << std::setw(w) << _("Metadata memory") << ": " << stats.metadataMemory_.total()
+           << " " << _("bytes") << " (" << _("datums") << " " << stats.metadataMemory_.datums_
+           << ", " << _("keys") << " " << stats.metadataMemory_.keys_
+           << ", " << _("values") << " " << stats.metadataMemory_.values_
+           << ", " << _("buffers") << " " << stats.metadataMemory_.buffers_ << ")\n";
+        os << out.str() << std::flush;
+    }
+
+    int runTask(Action::Task& task, const std::string& path)
+    {
+        Exiv2::Trace trace("file", path.c_str());
+        if (!Params::instance().stats_)
+            return task.run(path);
+        // The stats of each BasicIo are collected when it is destroyed, with the image
+        Exiv2::IoStats stats;
+        int rc = 0;
+        {
+            Exiv2::IoStatsCollector collector(stats);
+            rc = task.run(path);
+        }
+        printStats(Action::taskErr(), path, stats);
+        return rc;
+    }
+
+    //! An event of the trace of option -Z
+    struct TraceEvent {
+        char phase_;                    //!< 'B' for begin, 'E' for end
+        std::string category_;
+        std::string name_;
+        long long time_;                //!< Microseconds since the start of the trace
+        int thread_;                    //!< Number of the thread, in the order of their first event
+    };
+
+    std::mutex traceMutex;
+    std::vector<TraceEvent> traceEvents;
+    std::map<std::thread::id, int> traceThreads;
+    std::chrono::steady_clock::time_point traceStart;
+
+    void traceHandler(Exiv2::Trace::Event event, const char* category, const char* name)
+    {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        TraceEvent e;
+        e.phase_ = event == Exiv2::Trace::begin ? 'B' : 'E';
+        e.category_ = category;
+        e.name_ = name;
+        std::lock_guard<std::mutex> lock(traceMutex);
+        e.time_ = std::chrono::duration_cast<std::chrono::microseconds>(now - traceStart).count();
+        std::map<std::thread::id, int>::iterator t = traceThreads.find(std::this_thread::get_id());
+        if (t == traceThreads.end()) {
+            const int n = static_cast<int>(traceThreads.size()) + 1;
+            t = traceThreads.insert(std::make_pair(std::this_thread::get_id(), n)).first;
+        }
+        e.thread_ = t->second;
+        traceEvents.push_back(e);
+    }
+
+    void startTrace()
+    {
+        {
+            std::lock_guard<std::mutex> lock(traceMutex);
+            traceEvents.clear();
+            traceThreads.clear();
+            traceStart = std::chrono::steady_clock::now();
+        }
+        Exiv2::Trace::setHandler(traceHandler);
+    }
+
+    bool writeTrace(const std::string& path)
+    {
+        Exiv2::Trace::setHandler(nullptr);
+        std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+        if (!file) {
+            std::cerr << path << ": " << _("Failed to open the trace file") << "\n";
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(traceMutex);
+        file << "{\"traceEvents\":[";
+        for (std::vector<TraceEvent>::const_iterator e = traceEvents.begin(); e != traceEvents.end(); ++e) {
+            file << (e == traceEvents.begin() ? "\n" : ",\n") << "{\"name\":";
+            Util::writeJsonString(file, e->name_);
+            file << ",\"cat\":";
+            Util::writeJsonString(file, e->category_);
+            file << ",\"ph\":\"" << e->phase_ << "\",\"ts\":" << e->time_
+                 << ",\"pid\":1,\"tid\":" << e->thread_ << "}";
+        }
+        file << "\n]}\n";
+        traceEvents.clear();
+        file.close();
+        if (!file) {
+            std::cerr << path << ": " << _("Failed to write the trace file") << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    FileSource::FileSource(const Params& params)
+        : files_(params.files_),
+          arg_(0),
+          recursive_(params.recursive_),
+          inodeOrder_(params.inodeOrder_),
+          failed_(false)
+    {
+    }
+
+    int FileSource::size() const
+    {
+        return recursive_ ? 0 : static_cast<int>(files_.size());
+    }
+
+    FileKind fileKind(const std::string& path)
+    {
+#if defined(_MSC_VER)
+        const DWORD attrs = ::GetFileAttributesA(path.c_str());
+        if (attrs == INVALID_FILE_ATTRIBUTES)
+            return fkFile;  // Let the task report the error
+        if (attrs & FILE_ATTRIBUTE_DIRECTORY)
+            return (attrs & FILE_ATTRIBUTE_REPARSE_POINT) ? fkOther : fkDirectory;
+        return fkFile;
+#else
+        struct stat buf;
+        if (::lstat(path.c_str(), &buf) != 0)
+            return fkFile;  // Let the task report the error
+        const bool link = S_ISLNK(buf.st_mode);
+        if (link && ::stat(path.c_str(), &buf) != 0)
+            return fkOther;
+        if (S_ISDIR(buf.st_mode))
+            return link ? fkOther : fkDirectory;
+        return S_ISREG(buf.st_mode) ? fkFile : fkOther;
+#endif
+    }
+
+    void FileSource::readDir(const std::string& dir)
+    {
+        std::string prefix = dir;
+        if (prefix.empty() || (prefix[prefix.size() - 1] != '/' && prefix[prefix.size() - 1] != '\\'))
+            prefix += '/';
+        Entries entries;
+#if defined(_MSC_VER)
+        WIN32_FIND_DATAA data;
+        HANDLE handle = ::FindFirstFileA((prefix + "*").c_str(), &data);
+        bool ok = handle != INVALID_HANDLE_VALUE;
+        if (ok) {
+            do {
+                const std::string name(data.cFileName);
+                if (name == "." || name == "..")
+                    continue;
+                Entry entry = { prefix + name, 0 };
+                entries.push_back(entry);
+            } while (::FindNextFileA(handle, &data));
+            ::FindClose(handle);
+        }
+#else
+        DIR* d = ::opendir(dir.c_str());
+        bool ok = d != nullptr;
+        if (ok) {
+            while (struct dirent* e = ::readdir(d)) {
+                const std::string name(e->d_name);
+                if (name == "." || name == "..")
+                    continue;
+                Entry entry = { prefix + name, static_cast<unsigned long long>(e->d_ino) };
+                entries.push_back(entry);
+            }
+            ::closedir(d);
+        }
+#endif
+        if (!ok) {
+            std::cerr << dir << ": " << _("Failed to read the directory\n");
+            failed_ = true;
+            return;
+        }
+        // Sort in reverse, the entries are taken from the back
+        if (inodeOrder_) {
+            std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+                return lhs.inode_ != rhs.inode_ ? lhs.inode_ > rhs.inode_ : lhs.path_ > rhs.path_;
+            });
+        } else {
+            std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+                return lhs.path_ > rhs.path_;
+            });
+        }
+        dirs_.push_back(std::move(entries));
+    }
+
+    bool FileSource::next(std::string& path)
+    {
+        for (;;) {
+            while (!dirs_.empty()) {
+                Entries& entries = dirs_.back();
+                if (entries.empty()) {
+                    dirs_.pop_back();
+                    continue;
+                }
+                Entry entry = std::move(entries.back());
+                entries.pop_back();
+                switch (fileKind(entry.path_)) {
+                case fkFile:
+                    path = entry.path_;
+                    return true;
+                case fkDirectory:
+                    readDir(entry.path_);
+                    break;
+                case fkOther:
+                    break;
+                }
+            }
+            if (arg_ >= files_.size())
+                return false;
+            const std::string& file = files_[arg_++];
+            if (recursive_ && file != "-" && fileKind(file) == fkDirectory) {
+                readDir(file);
+                continue;
+            }
+            path = file;
+            return true;
+        }
+    }
+
+    //! Output and result of running a task on one file
+    struct TaskResult {
+        TaskResult() : rc_(0), done_(false) {}
+
+        std::ostringstream out_;            //!< Buffered output
+        std::ostringstream err_;            //!< Buffered error messages
+        int rc_;                            //!< Return code of the task
+        std::exception_ptr exception_;      //!< Exception thrown by the task, if any
+        bool done_;                         //!< Set when the task has finished
+    };
+
+    int runInParallel(const Action::Task& task, FileSource& files, unsigned int jobs)
+    {
+        const Params& params = Params::instance();
+        const int s = files.size();
+        // Limit how far the jobs may get ahead of the output
+        const size_t window = 4 * jobs;
+
+        std::mutex mutex;
+        std::condition_variable cvDone;
+        std::condition_variable cvWindow;
+        // Results which are not written yet, by index of the file
+        std::map<size_t, std::unique_ptr<TaskResult> > results;
+        size_t next = 0;
+        size_t written = 0;
+        bool exhausted = false;
+        bool stop = false;
+
+        auto job = [&]() {
+            Action::Task::UniquePtr myTask = task.clone();
+            for (;;) {
+                TaskResult* result = nullptr;
+                size_t i = 0;
+                std::string path;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cvWindow.wait(lock, [&]() { return stop || exhausted || next < written + window; });
+                    if (stop || exhausted)
+                        return;
+                    // Directories are read here, one at a time
+                    if (!files.next(path)) {
+                        exhausted = true;
+                        cvDone.notify_one();
+                        return;
+                    }
+                    i = next++;
+                    result = new TaskResult;
+                    results[i].reset(result);
+                }
+                {
+                    Action::TaskOutput output(result->out_, result->err_);
+                    try {
+                        if (params.verbose_) {
+                            printFileNumber(result->out_, static_cast<int>(i + 1), s, path);
+                        }
+                        result->rc_ = runTask(*myTask, path);
+                    } catch (...) {
+                        result->exception_ = std::current_exception();
+                    }
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    result->done_ = true;
+                }
+                cvDone.notify_one();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned int j = 0; j < jobs && (s == 0 || j < static_cast<unsigned int>(s)); ++j) {
+            threads.push_back(std::thread(job));
+        }
+
+        // Write the output in the order of the files
+        int rc = 0;
+        std::exception_ptr exception;
+        for (size_t i = 0; ; ++i) {
+            std::unique_ptr<TaskResult> result;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cvDone.wait(lock, [&]() {
+                    return (results.count(i) > 0 && results[i]->done_) || (exhausted && i >= next);
+                });
+                if (results.count(i) == 0)
+                    break;
+                result = std::move(results[i]);
+                results.erase(i);
+                written = i + 1;
+            }
+            cvWindow.notify_all();
+            std::cout << result->out_.str() << std::flush;
+            std::cerr << result->err_.str();
+            if (result->exception_) {
+                exception = result->exception_;
+                break;
+            }
+            if (rc == 0)
+                rc = result->rc_;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cvWindow.notify_all();
+        for (std::vector<std::thread>::iterator t = threads.begin(); t != threads.end(); ++t) {
+            t->join();
+        }
+        if (exception)
+            std::rethrow_exception(exception);
+        return rc;
+    }
+
+    void taskLogHandler(int level, const char* s)
+    {
+        std::ostream& os = Action::taskErr();
+        switch (static_cast<Exiv2::LogMsg::Level>(level)) {
+        case Exiv2::LogMsg::debug: os << "Debug: "; break;
+        case Exiv2::LogMsg::info:  os << "Info: "; break;
+        case Exiv2::LogMsg::warn:  os << "Warning: "; break;
+        case Exiv2::LogMsg::error: os << "Error: "; break;
+        case Exiv2::LogMsg::mute:  assert(false);
+        }
+        os << s;
+    }
+
+    //! Redirects std::cout and std::cerr for the lifetime of the object
+    class StreamRedirect {
+    public:
+        StreamRedirect(std::ostream& out, std::ostream& err)
+            : out_(std::cout.rdbuf(out.rdbuf())), err_(std::cerr.rdbuf(err.rdbuf())) {}
+        ~StreamRedirect()
+        {
+            std::cout.rdbuf(out_);
+            std::cerr.rdbuf(err_);
+        }
+
+        StreamRedirect& operator=(const StreamRedirect& rhs) = delete;
+        StreamRedirect(const StreamRedirect& rhs) = delete;
+
+    private:
+        std::streambuf* out_;           //!< Previous buffer of std::cout
+        std::streambuf* err_;           //!< Previous buffer of std::cerr
+    };
+
+    void skipJsonSpace(const std::string& json, size_t& pos)
+    {
+        while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\r' || json[pos] == '\n')) {
+            ++pos;
+        }
+    }
+
+    // Read the four hex digits of a \u escape at pos
+    bool readJsonHex(const std::string& json, size_t& pos, unsigned long& cp)
+    {
+        if (pos + 4 > json.size())
+            return false;
+        cp = 0;
+        for (size_t end = pos + 4; pos < end; ++pos) {
+            const char c = json[pos];
+            if (!std::isxdigit(static_cast<unsigned char>(c)))
+                return false;
+            cp = cp * 16 + (std::isdigit(static_cast<unsigned char>(c)) ? c - '0' : (std::tolower(c) - 'a' + 10));
+        }
+        return true;
+    }
+
+    // Read the JSON string at pos, which must be at the opening quote
+    bool readJsonString(const std::string& json, size_t& pos, std::string& value)
+    {
+        if (pos >= json.size() || json[pos] != '"')
+            return false;
+        value.clear();
+        for (++pos; pos < json.size(); ) {
+            const char c = json[pos++];
+            if (c == '"')
+                return true;
+            if (c != '\\') {
+                value += c;
+                continue;
+            }
+            if (pos >= json.size())
+                return false;
+            const char e = json[pos++];
+            switch (e) {
+            case '"':
+            case '\\':
+            case '/': value += e; break;
+            case 'b': value += '\b'; break;
+            case 'f': value += '\f'; break;
+            case 'n': value += '\n'; break;
+            case 'r': value += '\r'; break;
+            case 't': value += '\t'; break;
+            case 'u': {
+                unsigned long cp = 0;
+                if (!readJsonHex(json, pos, cp))
+                    return false;
+                if (cp >= 0xd800 && cp < 0xdc00) {
+                    unsigned long low = 0;
+                    if (   json.compare(pos, 2, "\\u") != 0
+                        || !readJsonHex(json, pos += 2, low)
+                        || low < 0xdc00 || low >= 0xe000)
+                        return false;
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                }
+                Exiv2::appendUtf8(value, static_cast<uint32_t>(cp));
+                break;
+            }
+            default: return false;
+            }
+        }
+        return false;
+    }
+
+    // Skip the JSON value at pos
+    bool skipJsonValue(const std::string& json, size_t& pos)
+    {
+        skipJsonSpace(json, pos);
+        if (pos >= json.size())
+            return false;
+        std::string str;
+        const char c = json[pos];
+        if (c == '"')
+            return readJsonString(json, pos, str);
+        if (c == '[' || c == '{') {
+            const char close = c == '[' ? ']' : '}';
+            ++pos;
+            skipJsonSpace(json, pos);
+            if (pos < json.size() && json[pos] == close) {
+                ++pos;
+                return true;
+            }
+            for (;;) {
+                if (c == '{') {
+                    skipJsonSpace(json, pos);
+                    if (!readJsonString(json, pos, str))
+                        return false;
+                    skipJsonSpace(json, pos);
+                    if (pos >= json.size() || json[pos++] != ':')
+                        return false;
+                }
+                if (!skipJsonValue(json, pos))
+                    return false;
+                skipJsonSpace(json, pos);
+                if (pos >= json.size())
+                    return false;
+                if (json[pos] == close) {
+                    ++pos;
+                    return true;
+                }
+                if (json[pos++] != ',')
+                    return false;
+            }
+        }
+        // Number, true, false or null
+        const size_t start = pos;
+        while (   pos < json.size()
+               && (   std::isalnum(static_cast<unsigned char>(json[pos]))
+                   || json[pos] == '+' || json[pos] == '-' || json[pos] == '.')) {
+            ++pos;
+        }
+        return pos > start;
+    }
+
+    // Parse a command of the serve mode, id is the JSON text of the "id" member
+    bool parseServeCommand(const std::string& json, std::string& id, std::vector<std::string>& args)
+    {
+        size_t pos = 0;
+        bool hasArgs = false;
+        skipJsonSpace(json, pos);
+        if (pos >= json.size() || json[pos++] != '{')
+            return false;
+        skipJsonSpace(json, pos);
+        if (pos < json.size() && json[pos] == '}') {
+            ++pos;
+        } else {
+            for (;;) {
+                std::string name;
+                skipJsonSpace(json, pos);
+                if (!readJsonString(json, pos, name))
+                    return false;
+                skipJsonSpace(json, pos);
+                if (pos >= json.size() || json[pos++] != ':')
+                    return false;
+                skipJsonSpace(json, pos);
+                if (name == "args") {
+                    if (pos >= json.size() || json[pos++] != '[')
+                        return false;
+                    args.clear();
+                    skipJsonSpace(json, pos);
+                    if (pos < json.size() && json[pos] == ']') {
+                        ++pos;
+                    } else {
+                        for (;;) {
+                            std::string arg;
+                            skipJsonSpace(json, pos);
+                            if (!readJsonString(json, pos, arg))
+                                return false;
+                            args.push_back(arg);
+                            skipJsonSpace(json, pos);
+                            if (pos >= json.size())
+                                return false;
+                            if (json[pos] == ']') {
+                                ++pos;
+                                break;
+                            }
+                            if (json[pos++] != ',')
+                                return false;
+                        }
+                    }
+                    hasArgs = true;
+                } else {
+                    const size_t start = pos;
+                    if (!skipJsonValue(json, pos))
+                        return false;
+                    if (name == "id")
+                        id = json.substr(start, pos - start);
+                }
+                skipJsonSpace(json, pos);
+                if (pos >= json.size())
+                    return false;
+                if (json[pos] == '}') {
+                    ++pos;
+                    break;
+                }
+                if (json[pos++] != ',')
+                    return false;
+            }
+        }
+        skipJsonSpace(json, pos);
+        return hasArgs && pos == json.size();
+    }
+
+    int updateIndex(const Params& params)
+    {
+        try {
+            Exiv2::MetadataIndex index(params.indexFile_);
+            if (!params.keys_.empty()) {
+                index.setKeys(params.keys_);
+            }
+            if (index.keys().empty()) {
+                std::cerr << params.progname() << ": " << _("A new index requires at least one -K option\n");
+                return 1;
+            }
+            // The source is only called by this thread
+            FileSource files(params);
+            const Exiv2::BatchProcessor::Results results =
+                index.update([&files](std::string& path) { return files.next(path); }, params.jobs_);
+            int rc = 0;
+            for (Exiv2::BatchProcessor::Results::const_iterator i = results.begin(); i != results.end(); ++i) {
+                for (size_t j = 0; j < i->messages_.size(); ++j) {
+                    Exiv2::LogMsg(i->messages_[j].level_).os() << i->messages_[j].text_;
+                }
+                if (i->code_ != Exiv2::kerSuccess) {
+                    std::cerr << i->path_ << ": " << i->message_ << "\n";
+                    rc = 1;
+                }
+            }
+            index.write();
+            if (params.verbose_) {
+                std::cout << params.indexFile_ << ": " << index.size() << " " << _("files") << ", "
+                          << index.read() << " " << _("read") << ", "
+                          << index.unchanged() << " " << _("unchanged") << ", "
+                          << index.removed() << " " << _("removed") << "\n";
+            }
+            if (rc == 0 && files.failed())
+                rc = 1;
+            return rc;
+        } catch (const Exiv2::AnyError& e) {
+            std::cerr << params.indexFile_ << ": " << e << "\n";
+            return 1;
+        }
+    }
+
+    int queryIndex(const Params& params)
+    {
+        try {
+            const Exiv2::MetadataIndex index(params.indexFile_);
+            std::vector<bool> match(index.size(), true);
+            for (Params::Files::const_iterator c = params.files_.begin(); c != params.files_.end(); ++c) {
+                const std::string::size_type pos = c->find('=');
+                const std::string key = c->substr(0, pos);
+                std::vector<bool> matchKey(index.size(), false);
+                if (pos == std::string::npos) {
+                    for (size_t row = 0; row < index.size(); ++row) {
+                        matchKey[row] = !index.values(row, key).empty();
+                    }
+                } else {
+                    const std::vector<size_t> rows = index.find(key, c->substr(pos + 1));
+                    for (size_t i = 0; i < rows.size(); ++i) {
+                        matchKey[rows[i]] = true;
+                    }
+                }
+                for (size_t row = 0; row < index.size(); ++row) {
+                    match[row] = match[row] && matchKey[row];
+                }
+            }
+            for (size_t row = 0; row < index.size(); ++row) {
+                if (!match[row])
+                    continue;
+                if (params.keys_.empty()) {
+                    std::cout << index.path(row) << "\n";
+                    continue;
+                }
+                for (Params::Keys::const_iterator k = params.keys_.begin(); k != params.keys_.end(); ++k) {
+                    const std::vector<std::string> values = index.values(row, *k);
+                    for (size_t i = 0; i < values.size(); ++i) {
+                        std::cout << index.path(row) << "  " << *k << "  " << values[i] << "\n";
+                    }
+                }
+            }
+            return 0;
+        } catch (const Exiv2::AnyError& e) {
+            std::cerr << params.indexFile_ << ": " << e << "\n";
+            return 1;
+        }
+    }
+
+    // Run one command of the serve mode, output goes to std::cout and std::cerr
+    int serveCommand(const char* progname, const std::vector<std::string>& args)
+    {
+        Params::instance().cleanup();
+        Params& params = Params::instance();
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>(progname));
+        for (std::vector<std::string>::const_iterator i = args.begin(); i != args.end(); ++i) {
+            argv.push_back(const_cast<char*>(i->c_str()));
+        }
+        argv.push_back(nullptr);
+        if (params.getopt(static_cast<int>(args.size() + 1), &argv[0])) {
+            return 1;
+        }
+        if (params.help_) {
+            params.help();
+            return 0;
+        }
+        if (params.version_) {
+            params.version(params.verbose_);
+            return 0;
+        }
+        // Renaming may prompt the user, and standard input and output are
+        // used for the commands and their results
+        if (params.action_ == Action::rename) {
+            std::cerr << params.progname() << ": " << _("The rename action cannot be used with --serve\n");
+            return 1;
+        }
+        if (   (params.target_ & Params::ctStdInOut)
+            || std::find(params.files_.begin(), params.files_.end(), "-") != params.files_.end()
+            || std::find(params.cmdFiles_.begin(), params.cmdFiles_.end(), "-") != params.cmdFiles_.end()
+            || std::find(params.batchFiles_.begin(), params.batchFiles_.end(), "-") != params.batchFiles_.end()) {
+            std::cerr << params.progname() << ": " << _("Standard input and output cannot be used with --serve\n");
+            return 1;
+        }
+
+        if (!params.traceFile_.empty()) {
+            startTrace();
+        }
+        if (params.action_ == Action::index || params.action_ == Action::query) {
+            int rc = params.action_ == Action::index ? updateIndex(params) : queryIndex(params);
+            if (!params.traceFile_.empty() && !writeTrace(params.traceFile_) && rc == 0)
+                rc = 1;
+            return rc;
+        }
+        Action::Task::UniquePtr task = Action::TaskFactory::instance().create(Action::TaskType(params.action_));
+        assert(task.get());
+        int rc = 0;
+        int n = 1;
+        FileSource files(params);
+        int s = files.size();
+        std::string path;
+        while (files.next(path)) {
+            if (params.verbose_) {
+                printFileNumber(verboseOut(params, path), n++, s, path);
+            }
+            int ret = runTask(*task, path);
+            if (rc == 0)
+                rc = ret;
+        }
+        if (rc == 0 && files.failed())
+            rc = 1;
+        if (!params.traceFile_.empty() && !writeTrace(params.traceFile_) && rc == 0)
+            rc = 1;
+        return rc;
+    }
 
+    int serve(const char* progname, std::istream& in, std::ostream& out)
+    {
+        // The results are written to the original stream while std::cout is redirected
+        std::ostream reply(out.rdbuf());
+        const Exiv2::LogMsg::Level logLevel = Exiv2::LogMsg::level();
+        Exiv2::XmpParser::initialize();
+
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            std::string id = "null";
+            std::vector<std::string> args;
+            std::ostringstream cmdOut;
+            std::ostringstream cmdErr;
+            int rc = 1;
+            {
+                StreamRedirect redirect(cmdOut, cmdErr);
+                // Options like -q and namespaces registered by modify commands
+                // must not carry over to the next command
+                Exiv2::LogMsg::setLevel(logLevel);
+                Exiv2::XmpProperties::unregisterNs();
+                try {
+                    if (parseServeCommand(line, id, args)) {
+                        rc = serveCommand(progname, args);
+                    } else {
+                        std::cerr << Util::basename(progname) << ": " << _("Invalid command") << ": " << line << "\n";
+                    }
+                } catch (const std::exception& exc) {
+                    std::cerr << "Uncaught exception: " << exc.what() << std::endl;
+                    rc = 1;
+                }
+            }
+            reply << "{\"id\":" << id << ",\"rc\":" << static_cast<unsigned int>(rc) % 256 << ",\"out\":";
+            Util::writeJsonString(reply, cmdOut.str());
+            reply << ",\"err\":";
+            Util::writeJsonString(reply, cmdErr.str());
+            reply << "}" << std::endl;
+        }
+
+        Action::TaskFactory::instance().cleanup();
+        Params::instance().cleanup();
+        Exiv2::XmpParser::terminate();
+        return 0;
+    }
+
+}
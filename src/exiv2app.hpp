@@ -36,6 +36,7 @@
 #include "getopt.hpp"
 
 // + standard includes
+#include <map>
 #include <string>
 #include <vector>
 #include <set>
@@ -144,6 +145,8 @@ public:
     typedef std::vector<std::string> CmdFiles;
     //! Container for commands from the command line
     typedef std::vector<std::string> CmdLines;
+    //! Container for the modification commands of individual files
+    typedef std::map<std::string, ModifyCmds> FileCmds;
     //! Container to store filenames.
     typedef std::vector<std::string> Files;
     //! Container for preview image numbers
@@ -186,7 +189,8 @@ public:
         prValue =  256,
         prTrans =  512,
         prHex   = 1024,
-        prSet   = 2048
+        prSet   = 2048,
+        prJson  = 4096
     };
 
     //! Enumerates common targets, bitmap
@@ -242,6 +246,8 @@ public:
     CmdFiles cmdFiles_;                 //!< Names of the modification command files
     CmdLines cmdLines_;                 //!< Commands from the command line
     ModifyCmds modifyCmds_;             //!< Parsed modification commands
+    CmdFiles batchFiles_;               //!< Names of the batch files
+    FileCmds fileCmds_;                 //!< Parsed modification commands for individual files
     std::string jpegComment_;           //!< Jpeg comment to set in the image
     std::string directory_;             //!< Location for files to extract/insert
     std::string suffix_;                //!< File extension of the file to insert
@@ -250,6 +256,12 @@ public:
     Greps greps_;                       //!< List of keys to 'grep' from the metadata
     Keys  keys_;                        //!< List of keys to match from the metadata
     std::string charset_;               //!< Charset to use for UNICODE Exif user comment
+    unsigned int jobs_;                 //!< Number of files to process in parallel
+    bool recursive_;                    //!< Process the files in directories recursively
+    bool inodeOrder_;                   //!< Process the files of a directory in inode order
+    bool stats_;                        //!< Print the I/O and allocation stats of each file
+    std::string traceFile_;             //!< File to write the Chrome trace of the run to
+    std::string indexFile_;             //!< Index file of the index and query actions
 
     Exiv2::DataBuf  stdinBuf;           //!< DataBuf with the binary bytes from stdin
 
@@ -266,7 +278,7 @@ private:
       @brief Default constructor. Note that optstring_ is initialized here.
              The c'tor is private to force instantiation through instance().
      */
-    Params() : optstring_(":hVvqfbuktTFa:Y:O:D:r:p:P:d:e:i:c:m:M:l:S:g:K:n:Q:"),
+    Params() : optstring_(":hVvqfbuktTFa:Y:O:D:r:p:P:d:e:i:c:m:M:B:l:S:g:K:n:Q:j:RNIZ:x:"),
                help_(false),
                version_(false),
                verbose_(false),
@@ -286,6 +298,10 @@ private:
                adjustment_(0),
                format_("%Y%m%d_%H%M%S"),
                formatSet_(false),
+               jobs_(1),
+               recursive_(false),
+               inodeOrder_(false),
+               stats_(false),
                first_(true)
     {
         yodAdjust_[yodYear]  = emptyYodAdjust_[yodYear];
@@ -317,6 +333,7 @@ private:
     int evalExtract(const std::string& optarg);
     int evalInsert(const std::string& optarg);
     int evalModify(int opt, const std::string& optarg);
+    int evalJobs(const std::string& optarg);
     //@}
 
 public:
@@ -347,6 +364,9 @@ public:
     //! Print version information to an output stream.
     void version(bool verbose =false, std::ostream& os =std::cout) const;
 
+    //! Return true if more than one file may be processed.
+    bool manyFiles() const { return files_.size() > 1 || recursive_; }
+
     //! getStdin binary data read from stdin to DataBuf
     /*
         stdin can be used by multiple images in the exiv2 command line:
@@ -293,4 +293,10 @@ namespace Exiv2 {
         return tagInfo_;
     }
 
+    //! Tag lists of the groups of the Fujifilm makernote module
+    extern const MnTagListEntry fujiMnTagLists[] = {
+        { fujiId, FujiMakerNote::tagList },
+        { ifdIdNotSet, 0 }
+    };
+
 }}                                      // namespace Internal, Exiv2
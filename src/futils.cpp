@@ -30,8 +30,10 @@
 #include <cstdio>
 #include <cerrno>
 #include <sstream>
+#include <cstdlib>                      // for mkstemp
 #include <cstring>
 #include <algorithm>
+#include <limits>
 #include <stdexcept>
 #ifdef   EXV_HAVE_UNISTD_H
 #include <unistd.h>                     // for stat()
@@ -42,6 +44,13 @@
 #include <psapi.h>  // For access to GetModuleFileNameEx
 #endif
 
+#if defined(_WIN32)
+#include <io.h>     // For _sopen_s in createTempFile
+#include <fcntl.h>
+#include <share.h>
+#include <atomic>
+#endif
+
 #if defined(_MSC_VER)
 #define S_ISREG(m)      (((m) & S_IFMT) == S_IFREG)
 #elif defined(__APPLE__)
@@ -124,72 +133,32 @@ namespace Exiv2 {
     int base64encode(const void* data_buf, size_t dataLength, char* result, size_t resultSize) {
         const char base64chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
         const uint8_t* data = (const uint8_t*)data_buf;
-        size_t resultIndex = 0;
-        size_t x;
-        size_t padCount = dataLength % 3;
-
-        /* increment over the length of the string, three characters at a time */
-        for (x = 0; x < dataLength; x += 3)
-        {
-            /* these three 8-bit (ASCII) characters become one 24-bit number */
-            uint32_t n = data[x] << 16;
-
-            if((x+1) < dataLength)
-                n += data[x+1] << 8;
-
-            if((x+2) < dataLength)
-                n += data[x+2];
-
-            /* this 24-bit number gets separated into four 6-bit numbers */
-            uint8_t n0 = (uint8_t)(n >> 18) & 63;
-            uint8_t n1 = (uint8_t)(n >> 12) & 63;
-            uint8_t n2 = (uint8_t)(n >> 6) & 63;
-            uint8_t n3 = (uint8_t)n & 63;
-
-            /*
-            * if we have one byte available, then its encoding is spread
-            * out over two characters
-            */
-            if(resultIndex >= resultSize) return 0;   /* indicate failure: buffer too small */
-            result[resultIndex++] = base64chars[n0];
-            if(resultIndex >= resultSize) return 0;   /* indicate failure: buffer too small */
-            result[resultIndex++] = base64chars[n1];
-
-            /*
-            * if we have only two bytes available, then their encoding is
-            * spread out over three chars
-            */
-            if((x+1) < dataLength)
-            {
-                if(resultIndex >= resultSize) return 0;   /* indicate failure: buffer too small */
-                result[resultIndex++] = base64chars[n2];
-            }
-
-            /*
-            * if we have all three bytes available, then their encoding is spread
-            * out over four characters
-            */
-            if((x+2) < dataLength)
-            {
-                if(resultIndex >= resultSize) return 0;   /* indicate failure: buffer too small */
-                result[resultIndex++] = base64chars[n3];
-            }
+        // Check the size once, the loops below then write without checks
+        if (resultSize <= (dataLength + 2) / 3 * 4) return 0;   /* indicate failure: buffer too small */
+
+        /* three 8-bit bytes become four 6-bit characters */
+        const size_t full = dataLength - dataLength % 3;
+        char* out = result;
+        for (size_t x = 0; x < full; x += 3) {
+            const uint32_t n = data[x] << 16 | data[x+1] << 8 | data[x+2];
+            out[0] = base64chars[(n >> 18) & 63];
+            out[1] = base64chars[(n >> 12) & 63];
+            out[2] = base64chars[(n >> 6) & 63];
+            out[3] = base64chars[n & 63];
+            out += 4;
         }
 
-        /*
-        * create and add padding that is required if we did not have a multiple of 3
-        * number of characters available
-        */
-        if (padCount > 0)
-        {
-            for (; padCount < 3; padCount++)
-            {
-                if(resultIndex >= resultSize) return 0;   /* indicate failure: buffer too small */
-                result[resultIndex++] = '=';
-            }
+        /* one or two remaining bytes are spread over two or three characters and padded */
+        if (full < dataLength) {
+            uint32_t n = data[full] << 16;
+            if (full + 1 < dataLength) n |= data[full+1] << 8;
+            out[0] = base64chars[(n >> 18) & 63];
+            out[1] = base64chars[(n >> 12) & 63];
+            out[2] = full + 1 < dataLength ? base64chars[(n >> 6) & 63] : '=';
+            out[3] = '=';
+            out += 4;
         }
-        if(resultIndex >= resultSize) return 0;   /* indicate failure: buffer too small */
-        result[resultIndex] = 0;
+        *out = 0;
         return 1;   /* indicate success */
     } // base64encode
 
@@ -237,6 +206,118 @@ namespace Exiv2 {
         return done;
     } // base64decode
 
+    namespace {
+        //! Value of each base64 character, 0x80 for the characters outside the alphabet
+        struct Base64Table {
+            Base64Table()
+            {
+                const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+                std::memset(value_, 0x80, sizeof(value_));
+                for (uint8_t i = 0; i < 64; ++i) value_[static_cast<uint8_t>(chars[i])] = i;
+            }
+            uint8_t value_[256];
+        };
+
+        const uint8_t* base64Values()
+        {
+            static const Base64Table table;
+            return table.value_;
+        }
+    }
+
+    size_t Base64Decoder::decode(const char* in, size_t size, byte* out)
+    {
+        const uint8_t* values = base64Values();
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(in);
+        const uint8_t* end = p + size;
+        byte* o = out;
+        while (p < end) {
+            if (count_ == 0) {
+                // Whole groups of valid characters, the common case
+                while (end - p >= 4) {
+                    const uint32_t a = values[p[0]];
+                    const uint32_t b = values[p[1]];
+                    const uint32_t c = values[p[2]];
+                    const uint32_t d = values[p[3]];
+                    if ((a | b | c | d) & 0x80) break;
+                    const uint32_t n = a << 18 | b << 12 | c << 6 | d;
+                    o[0] = static_cast<byte>(n >> 16);
+                    o[1] = static_cast<byte>(n >> 8);
+                    o[2] = static_cast<byte>(n);
+                    o += 3;
+                    p += 4;
+                }
+                if (p == end) break;
+            }
+            // One character at a time until the next group boundary
+            const uint32_t v = values[*p++];
+            if (v & 0x80) continue;
+            bits_ = bits_ << 6 | v;
+            if (++count_ == 4) {
+                o[0] = static_cast<byte>(bits_ >> 16);
+                o[1] = static_cast<byte>(bits_ >> 8);
+                o[2] = static_cast<byte>(bits_);
+                o += 3;
+                bits_ = 0;
+                count_ = 0;
+            }
+        }
+        return o - out;
+    }
+
+    size_t Base64Decoder::finish(byte* out)
+    {
+        size_t n = 0;
+        if (count_ == 2) {
+            out[0] = static_cast<byte>(bits_ >> 4);
+            n = 1;
+        }
+        else if (count_ == 3) {
+            out[0] = static_cast<byte>(bits_ >> 10);
+            out[1] = static_cast<byte>(bits_ >> 2);
+            n = 2;
+        }
+        bits_ = 0;
+        count_ = 0;
+        return n;
+    }
+
+    DataBuf base64decode(const char* in, size_t size)
+    {
+        const size_t maxSize = Base64Decoder::maxDecodedSize(size) + 2;
+        if (size == 0 || maxSize > static_cast<size_t>(std::numeric_limits<long>::max())) return DataBuf();
+        DataBuf dest = DataBuf::pooled(static_cast<long>(maxSize));
+        Base64Decoder decoder;
+        size_t n = decoder.decode(in, size, dest.pData_);
+        n += decoder.finish(dest.pData_ + n);
+        if (n == 0) return DataBuf();
+        // Only the size shrinks, the buffer is freed as a whole
+        dest.size_ = static_cast<long>(n);
+        return dest;
+    }
+
+    void appendUtf8(std::string& s, uint32_t cp)
+    {
+        if (cp < 0x80) {
+            s += static_cast<char>(cp);
+        }
+        else if (cp < 0x800) {
+            s += static_cast<char>(0xc0 | (cp >> 6));
+            s += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+        else if (cp < 0x10000) {
+            s += static_cast<char>(0xe0 | (cp >> 12));
+            s += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            s += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+        else {
+            s += static_cast<char>(0xf0 | (cp >> 18));
+            s += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+            s += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            s += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+    }
+
     Protocol fileProtocol(const std::string& path) {
         Protocol result = pFile ;
         struct {
@@ -356,6 +437,32 @@ namespace Exiv2 {
         return os.str();
     } // strError
 
+    std::string createTempFile(const std::string& path)
+    {
+#if defined(_WIN32)
+        static std::atomic<unsigned int> counter(0);
+        for (int attempt = 0; attempt < 100; ++attempt) {
+            std::ostringstream os;
+            os << path << "." << ::GetCurrentProcessId() << "-" << counter++;
+            const std::string name = os.str();
+            int fd = -1;
+            if (::_sopen_s(&fd, name.c_str(), _O_CREAT | _O_EXCL | _O_RDWR | _O_BINARY,
+                           _SH_DENYNO, _S_IREAD | _S_IWRITE) == 0) {
+                ::_close(fd);
+                return name;
+            }
+            if (errno != EEXIST) break;
+        }
+        return std::string();
+#else
+        std::string name = path + ".XXXXXX";
+        const int fd = ::mkstemp(&name[0]);
+        if (fd == -1) return std::string();
+        ::close(fd);
+        return name;
+#endif
+    } // createTempFile
+
     void Uri::Decode(Uri& uri)
     {
         urldecode(uri.QueryString);
@@ -36,3 +36,54 @@ std::string string_from_unterminated(const char* data, size_t data_length)
 
     return std::string(data, StringLength);
 }
+
+bool parse_fixed_digits(const char* buf, size_t count, int& value)
+{
+    int v = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (buf[i] < '0' || buf[i] > '9') return false;
+        v = v * 10 + (buf[i] - '0');
+    }
+    value = v;
+    return true;
+}
+
+bool format_fixed_digits(char* buf, size_t count, int value)
+{
+    char digits[9];
+    if (value < 0 || count > sizeof(digits)) return false;
+    for (size_t i = count; i > 0; --i) {
+        digits[i - 1] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    if (value != 0) return false;
+    memcpy(buf, digits, count);
+    return true;
+}
+
+bool parse_date_time(const char* str, char date_sep, char separator, int fields[6])
+{
+    // Offsets of the separators after YYYY, MM, DD, HH and MM
+    const char seps[] = { date_sep, date_sep, separator, ':', ':' };
+    int f[6];
+    if (!parse_fixed_digits(str, 4, f[0])) return false;
+    for (int i = 0; i < 5; ++i) {
+        const char* p = str + 4 + 3 * i;
+        if (p[0] != seps[i] || !parse_fixed_digits(p + 1, 2, f[i + 1])) return false;
+    }
+    memcpy(fields, f, sizeof(f));
+    return true;
+}
+
+bool format_date_time(char* buf, char date_sep, char separator, const int fields[6])
+{
+    const char seps[] = { date_sep, date_sep, separator, ':', ':' };
+    if (fields[0] < 1000 || !format_fixed_digits(buf, 4, fields[0])) return false;
+    for (int i = 0; i < 5; ++i) {
+        char* p = buf + 4 + 3 * i;
+        p[0] = seps[i];
+        if (!format_fixed_digits(p + 1, 2, fields[i + 1])) return false;
+    }
+    buf[19] = 0;
+    return true;
+}
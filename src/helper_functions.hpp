@@ -46,4 +46,46 @@
  */
 std::string string_from_unterminated(const char* data, size_t data_length);
 
+/*!
+  @brief Parse exactly \em count decimal digits at \em buf into \em value.
+
+  @return true if all \em count characters are digits, else \em value is
+      left unchanged.
+ */
+bool parse_fixed_digits(const char* buf, size_t count, int& value);
+
+/*!
+  @brief Write \em value zero padded to exactly \em count digits at \em buf,
+      without a terminating null.
+
+  @return false, writing nothing, if \em value is negative or has more than
+      \em count digits.
+ */
+bool format_fixed_digits(char* buf, size_t count, int value);
+
+/*!
+  @brief Parse a date and time laid out as "YYYY-MM-DD HH:MM:SS".
+
+  This is the fixed layout of Exif dates (\em date_sep ':', \em separator
+  ' ') and of ISO 8601 dates in XMP (\em date_sep '-', \em separator 'T').
+  Characters after the seconds are ignored. Callers fall back to a lenient
+  parser for anything else.
+
+  @param[in] str  A null terminated string.
+  @param[out] fields  Year, month, day, hour, minute and second, only set on
+      success.
+  @return true if \em str starts with the layout.
+ */
+bool parse_date_time(const char* str, char date_sep, char separator, int fields[6]);
+
+/*!
+  @brief Write \em fields (year, month, day, hour, minute and second) to
+      \em buf in the layout of parse_date_time() and terminate it with a null.
+
+  @param[out] buf  A buffer of at least 20 characters.
+  @return false, leaving \em buf unspecified, if the year is not between 1000
+      and 9999 or another field has more than two digits.
+ */
+bool format_date_time(char* buf, char date_sep, char separator, const int fields[6]);
+
 #endif  // HELPER_FUNCTIONS_HPP
@@ -40,6 +40,8 @@
 #include <sys/types.h>
 #include <time.h>
 #include <cstdlib>
+#include <map>
+#include <mutex>
 
 #define SLEEP 1000
 #define SNOOZE 0
@@ -60,6 +62,7 @@
 #define read _read
 #define close _close
 #define strdup _strdup
+#define strcasecmp _stricmp
 #define stat _stat
 #define fopen_S(f, n, a) fopen_s(&f, n, a)
 #endif
@@ -75,6 +78,7 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <strings.h>
+#include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
 #include <sys/un.h>
@@ -93,13 +97,11 @@ static int WSAGetLastError()
     return errno;
 }
 
-static void Sleep(int millisecs)
-{
-    const struct timespec rqtp = {0, millisecs * 1000000};
-    struct timespec rmtp;
-    nanosleep(&rqtp, &rmtp);
-}
+#endif
 
+// writing to a connection the server has closed must not raise SIGPIPE
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
 #endif
 
 ////////////////////////////////////////
@@ -109,6 +111,7 @@ static const char* httpTemplate =
     "User-Agent: exiv2http/1.0.0\r\n"
     "Accept: */*\r\n"
     "Host: %s\r\n"  // $servername
+    "Connection: keep-alive\r\n"
     "%s"            // $header
     "\r\n";
 
@@ -188,6 +191,26 @@ static Exiv2::Dictionary stringToDict(const std::string& s)
     return result;
 }
 
+//! Time between the checks for cancellation while a request waits for the socket
+static const int pollMillis = 100;
+
+//! Wait up to \em millis for \em sockfd to be writable or readable, returns > 0 if it is, 0 on time-out.
+static int waitSocket(int sockfd, bool forWrite, int millis)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sockfd, &fds);
+    struct timeval tv;
+    tv.tv_sec = millis / 1000;
+    tv.tv_usec = (millis % 1000) * 1000;
+    return select(sockfd + 1, forWrite ? nullptr : &fds, forWrite ? &fds : nullptr, nullptr, &tv);
+}
+
+static bool isCancelled(const std::function<bool()>& cancelled)
+{
+    return cancelled && cancelled();
+}
+
 static int makeNonBlocking(int sockfd)
 {
 #ifdef WIN32
@@ -199,7 +222,119 @@ static int makeNonBlocking(int sockfd)
 #endif
 }
 
+//! Open a socket and start connecting it to the server, returns -1 and sets errors if it fails.
+static int openSocket(const char* servername_p, const char* port_p, std::string& errors)
+{
+    ////////////////////////////////////
+    // open the socket
+    int sockfd = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sockfd < 0)
+        return error(errors, "unable to create socket\n", nullptr, nullptr, 0);
+
+    // fill in the address
+    struct sockaddr_in serv_addr;
+    int serv_len = sizeof(serv_addr);
+    memset((char*)&serv_addr, 0, serv_len);
+
+    serv_addr.sin_addr.s_addr = inet_addr(servername_p);
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(atoi(port_p));
+
+    // convert unknown servername into IP address
+    // http://publib.boulder.ibm.com/infocenter/iseries/v5r3/index.jsp?topic=/rzab6/rzab6uafinet.htm
+    if (serv_addr.sin_addr.s_addr == (unsigned long)INADDR_NONE) {
+        // gethostbyname() returns static data, RemoteIo sends requests from several threads
+        static std::mutex hostMutex;
+        std::lock_guard<std::mutex> lock(hostMutex);
+        struct hostent* host = gethostbyname(servername_p);
+        if (!host) {
+            closesocket(sockfd);
+            return error(errors, "no such host", servername_p);
+        }
+        memcpy(&serv_addr.sin_addr, host->h_addr, sizeof(serv_addr.sin_addr));
+    }
+
+#ifdef SO_NOSIGPIPE
+    int noSigPipe = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+    makeNonBlocking(sockfd);
+
+    ////////////////////////////////////
+    // connect the socket to the server
+    auto server = connect(sockfd, (const struct sockaddr*)&serv_addr, serv_len);
+    if (server == SOCKET_ERROR && WSAGetLastError() != WSAEWOULDBLOCK) {
+        auto errorCode = WSAGetLastError();
+        closesocket(sockfd);
+        return error(errors, "error - unable to connect to server = %s port = %s wsa_error = %d", servername_p, port_p,
+                     errorCode);
+    }
+    return sockfd;
+}
+
+////////////////////////////////////////
+// connections kept alive, by "server:port"
+static std::mutex poolMutex;
+static std::multimap<std::string, int> idleSockets;
+static const size_t maxIdleSockets = 4;  // per server
+
+//! Return an idle connection to the server, or -1 if there is none.
+static int takeIdleSocket(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    std::multimap<std::string, int>::iterator pos = idleSockets.find(key);
+    if (pos == idleSockets.end())
+        return -1;
+    int sockfd = pos->second;
+    idleSockets.erase(pos);
+    return sockfd;
+}
+
+//! Keep a connection for the next request to the server, or close it if there are enough.
+static void keepIdleSocket(const std::string& key, int sockfd)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (idleSockets.count(key) >= maxIdleSockets) {
+        closesocket(sockfd);
+    } else {
+        idleSockets.insert(std::make_pair(key, sockfd));
+    }
+}
+
+//! Return the trimmed value of a response header, the name is compared without case.
+static std::string findHeader(const Exiv2::Dictionary& response, const char* name)
+{
+    for (Exiv2::Dictionary_i it = response.begin(); it != response.end(); ++it) {
+        if (strcasecmp(it->first.c_str(), name) != 0)
+            continue;
+        const std::string& value = it->second;
+        size_t first = value.find_first_not_of(" \t\r\n");
+        size_t last = value.find_last_not_of(" \t\r\n");
+        return first == std::string::npos ? std::string() : value.substr(first, last - first + 1);
+    }
+    return std::string();
+}
+
+//! Does the server keep the connection open after the response?
+static bool isKeepAlive(const Exiv2::Dictionary& response)
+{
+    const std::string connection = findHeader(response, "connection");
+    if (strcasecmp(connection.c_str(), "close") == 0)
+        return false;
+    if (strcasecmp(connection.c_str(), "keep-alive") == 0)
+        return true;
+    // HTTP/1.1 connections are persistent by default
+    Exiv2::Dictionary_i status = response.find("");
+    return status != response.end() && status->second.compare(0, 8, "HTTP/1.1") == 0;
+}
+
 int Exiv2::http(Exiv2::Dictionary& request, Exiv2::Dictionary& response, std::string& errors)
+{
+    return http(request, response, errors, std::function<bool()>());
+}
+
+int Exiv2::http(Exiv2::Dictionary& request, Exiv2::Dictionary& response, std::string& errors,
+                const std::function<bool()>& cancelled)
 {
     if (!request.count("verb"))
         request["verb"] = "GET";
@@ -267,132 +402,165 @@ int Exiv2::http(Exiv2::Dictionary& request, Exiv2::Dictionary& response, std::st
         port_p = "80";
 
     ////////////////////////////////////
-    // open the socket
-    int sockfd = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (sockfd < 0)
-        return error(errors, "unable to create socket\n", nullptr, nullptr, 0);
-
-    // fill in the address
-    struct sockaddr_in serv_addr;
-    int serv_len = sizeof(serv_addr);
-    memset((char*)&serv_addr, 0, serv_len);
-
-    serv_addr.sin_addr.s_addr = inet_addr(servername_p);
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(atoi(port_p));
-
-    // convert unknown servername into IP address
-    // http://publib.boulder.ibm.com/infocenter/iseries/v5r3/index.jsp?topic=/rzab6/rzab6uafinet.htm
-    if (serv_addr.sin_addr.s_addr == (unsigned long)INADDR_NONE) {
-        struct hostent* host = gethostbyname(servername_p);
-        if (!host) {
-            closesocket(sockfd);
-            return error(errors, "no such host", servername_p);
-        }
-        memcpy(&serv_addr.sin_addr, host->h_addr, sizeof(serv_addr.sin_addr));
-    }
-
-    makeNonBlocking(sockfd);
-
-    ////////////////////////////////////
-    // connect the socket to the server
-    auto server = connect(sockfd, (const struct sockaddr*)&serv_addr, serv_len);
-    if (server == SOCKET_ERROR && WSAGetLastError() != WSAEWOULDBLOCK) {
-        auto errorCode = WSAGetLastError();
-        closesocket(sockfd);
-        return error(errors, "error - unable to connect to server = %s port = %s wsa_error = %d", servername_p, port_p,
-                     errorCode);
-    }
-
+    // format the request
     char buffer[32 * 1024 + 1];
     size_t buff_l = sizeof buffer - 1;
+    const int requestLength = snprintf(buffer, buff_l, httpTemplate, verb, page, version, servername, header);
+    buffer[requestLength] = 0;
+    const std::string requestText(buffer, requestLength);
+    response["requestheaders"] = requestText;
 
-    ////////////////////////////////////
-    // format the request
-    int n = snprintf(buffer, buff_l, httpTemplate, verb, page, version, servername, header);
-    buffer[n] = 0;
-    response["requestheaders"] = std::string(buffer, n);
-
-    ////////////////////////////////////
-    // send the header (we'll have to wait for the connection by the non-blocking socket)
-    while (sleep_ >= 0 && send(sockfd, buffer, n, 0) == SOCKET_ERROR /* && WSAGetLastError() == WSAENOTCONN */) {
-        Sleep(snooze);
-        sleep_ -= snooze;
-    }
-
-    if (sleep_ < 0) {
-        auto errorCode = WSAGetLastError();
-        closesocket(server);
-        closesocket(sockfd);
-        return error(errors, "error - timeout connecting to server = %s port = %s wsa_error = %d", servername, port,
-                     errorCode);
-    }
+    const std::string poolKey = std::string(servername_p) + ":" + port_p;
+    const bool bHead = request["verb"] == "HEAD";
 
+    int sockfd = takeIdleSocket(poolKey);
+    bool bReused = sockfd >= 0;
     int end = 0;             // write position in buffer
     bool bSearching = true;  // looking for headers in the response
     int status = 200;        // assume happiness
+    long bodyLength = -1;    // length of the body, -1 if unknown
+    bool bKeepAlive = false; // can the connection be reused?
+    bool bComplete = false;  // has the whole body been read?
+    bool bCancelled = false; // has the request been cancelled while waiting for the response?
+    int n = 0;
+    for (;;) {
+        if (sockfd < 0) {
+            bReused = false;
+            sockfd = openSocket(servername_p, port_p, errors);
+            if (sockfd < 0)
+                return -1;
+        }
 
-    ////////////////////////////////////
-    // read and process the response
-    int err;
-    n = forgive(recv(sockfd, buffer, (int)buff_l, 0), err);
-    while (n >= 0 && OK(status)) {
-        if (n) {
-            end += n;
-            buffer[end] = 0;
-
-            size_t body = 0;  // start of body
-            if (bSearching) {
-                // search for the body
-                for (size_t b = 0; bSearching && b < lengthof(blankLines); b++) {
-                    if (strstr(buffer, blankLines[b])) {
-                        bSearching = false;
-                        body = (int)(strstr(buffer, blankLines[b]) - buffer) + strlen(blankLines[b]);
-                        status = atoi(strchr(buffer, ' '));
+        ////////////////////////////////////
+        // send the header (we'll have to wait for the connection by the non-blocking socket)
+        if (bReused) {
+            if (send(sockfd, requestText.data(), requestLength, MSG_NOSIGNAL) != requestLength) {
+                // the server has dropped the idle connection
+                closesocket(sockfd);
+                sockfd = -1;
+                continue;
+            }
+        } else {
+            // wait for the non-blocking connect, up to the time-out of EXIV2_TIMEOUT seconds
+            const long timeout = atol(Exiv2::getEnv(Exiv2::envTIMEOUT).c_str()) * 1000;
+            long waited = 0;
+            int ready = 0;
+            while (!isCancelled(cancelled) && waited < timeout &&
+                   (ready = waitSocket(sockfd, true, pollMillis)) == 0) {
+                waited += pollMillis;
+            }
+            if (isCancelled(cancelled)) {
+                closesocket(sockfd);
+                return error(errors, "error - request to server = %s port = %s cancelled", servername, port);
+            }
+            if (ready <= 0 || send(sockfd, requestText.data(), requestLength, MSG_NOSIGNAL) == SOCKET_ERROR) {
+                auto errorCode = WSAGetLastError();
+                closesocket(sockfd);
+                return error(errors, "error - timeout connecting to server = %s port = %s wsa_error = %d", servername,
+                             port, errorCode);
+            }
+        }
+
+        end = 0;
+        bSearching = true;
+        status = 200;
+        bodyLength = -1;
+        bKeepAlive = false;
+        bComplete = false;
+        file.clear();
+
+        ////////////////////////////////////
+        // read and process the response
+        int err;
+        n = forgive(recv(sockfd, buffer, (int)buff_l, 0), err);
+        while (n >= 0 && OK(status)) {
+            if (n) {
+                end += n;
+                buffer[end] = 0;
+
+                size_t body = 0;  // start of body
+                if (bSearching) {
+                    // search for the body
+                    for (size_t b = 0; bSearching && b < lengthof(blankLines); b++) {
+                        if (strstr(buffer, blankLines[b])) {
+                            bSearching = false;
+                            body = (int)(strstr(buffer, blankLines[b]) - buffer) + strlen(blankLines[b]);
+                            status = atoi(strchr(buffer, ' '));
+                        }
                     }
-                }
 
-                // parse response headers
-                char* h = buffer;
-                char C = ':';
-                char N = '\n';
-                int i = 0;  // initial byte in buffer
-                while (buffer[i] == N)
-                    i++;
-                h = strchr(h + i, N) + 1;
-                response[""] = std::string(buffer + i).substr(0, h - buffer - 2);
-                result = atoi(strchr(buffer, ' '));
-                char* c = strchr(h, C);
-                char* first_newline = strchr(h, N);
-                while (c && first_newline && c < first_newline && h < buffer + body) {
-                    std::string key(h);
-                    std::string value(c + 1);
-                    key = key.substr(0, c - h);
-                    value = value.substr(0, first_newline - c - 1);
-                    response[key] = value;
-                    h = first_newline + 1;
-                    c = strchr(h, C);
-                    first_newline = strchr(h, N);
+                    // parse response headers
+                    char* h = buffer;
+                    char C = ':';
+                    char N = '\n';
+                    int i = 0;  // initial byte in buffer
+                    while (buffer[i] == N)
+                        i++;
+                    h = strchr(h + i, N) + 1;
+                    response[""] = std::string(buffer + i).substr(0, h - buffer - 2);
+                    result = atoi(strchr(buffer, ' '));
+                    char* c = strchr(h, C);
+                    char* first_newline = strchr(h, N);
+                    while (c && first_newline && c < first_newline && h < buffer + body) {
+                        std::string key(h);
+                        std::string value(c + 1);
+                        key = key.substr(0, c - h);
+                        value = value.substr(0, first_newline - c - 1);
+                        response[key] = value;
+                        h = first_newline + 1;
+                        c = strchr(h, C);
+                        first_newline = strchr(h, N);
+                    }
+
+                    if (!bSearching) {
+                        // the length of the body tells where the response ends on a kept-alive connection
+                        const std::string length = findHeader(response, "content-length");
+                        bodyLength = bHead ? 0 : (length.empty() ? -1 : atol(length.c_str()));
+                        bKeepAlive = isKeepAlive(response);
+                    }
                 }
-            }
 
-            // if the buffer's full and we're still searching - give up!
-            // this handles the possibility that there are no headers
-            if (bSearching && buff_l - end < 10) {
-                bSearching = false;
-                body = 0;
+                // if the buffer's full and we're still searching - give up!
+                // this handles the possibility that there are no headers
+                if (bSearching && buff_l - end < 10) {
+                    bSearching = false;
+                    body = 0;
+                }
+                if (!bSearching && OK(status)) {
+                    flushBuffer(buffer, body, end, file);
+                    if (bodyLength >= 0 && file.size() >= (size_t)bodyLength) {
+                        bComplete = file.size() == (size_t)bodyLength;
+                        n = FINISH;
+                        break;
+                    }
+                }
             }
-            if (!bSearching && OK(status)) {
-                flushBuffer(buffer, body, end, file);
+            n = forgive(recv(sockfd, buffer + end, (int)(buff_l - end), 0), err);
+            if (!n) {
+                if (isCancelled(cancelled)) {
+                    bCancelled = true;
+                    break;
+                }
+                // wait for the server instead of polling the socket
+                waitSocket(sockfd, false, pollMillis);
+                sleep_ -= snooze;
+                if (sleep_ < 0)
+                    n = FINISH;
             }
         }
-        n = forgive(recv(sockfd, buffer + end, (int)(buff_l - end), 0), err);
-        if (!n) {
-            Sleep(snooze);
-            sleep_ -= snooze;
-            if (sleep_ < 0)
-                n = FINISH;
+
+        if (bCancelled) {
+            closesocket(sockfd);
+            return error(errors, "error - request to server = %s port = %s cancelled", servername, port);
         }
+
+        // the server has closed the idle connection before answering, try a new one
+        if (bReused && n == FINISH && bSearching && end == 0) {
+            closesocket(sockfd);
+            sockfd = -1;
+            continue;
+        }
+        break;
     }
 
     if (n != FINISH || !OK(status)) {
@@ -405,7 +573,6 @@ int Exiv2::http(Exiv2::Dictionary& request, Exiv2::Dictionary& response, std::st
             flushBuffer(buffer, 0, end, file);
         } else {
             auto errorCode = WSAGetLastError();
-            closesocket(server);
             closesocket(sockfd);
             return error(errors, "error - no response from server = %s port = %s wsa_error = %d", servername, port,
                          errorCode);
@@ -413,9 +580,12 @@ int Exiv2::http(Exiv2::Dictionary& request, Exiv2::Dictionary& response, std::st
     }
 
     ////////////////////////////////////
-    // close sockets
-    closesocket(server);
-    closesocket(sockfd);
+    // keep the connection for the next request or close it
+    if (bComplete && bKeepAlive && OK(status)) {
+        keepIdleSocket(poolKey, sockfd);
+    } else {
+        closesocket(sockfd);
+    }
     response["body"] = file;
     return result;
 }
@@ -28,8 +28,13 @@
 #include "image_int.hpp"
 #include "error.hpp"
 #include "futils.hpp"
+#include "metadiff.hpp"
 #include "safe_op.hpp"
 #include "slice.hpp"
+#include "snapshot.hpp"
+#include "stats_int.hpp"
+#include "subio_int.hpp"
+#include "trace.hpp"
 
 #include "cr2image.hpp"
 #include "crwimage.hpp"
@@ -50,20 +55,24 @@
 #include "psdimage.hpp"
 #include "tgaimage.hpp"
 #include "bmpimage.hpp"
+#include "bmffimage.hpp"
 #include "jp2image.hpp"
-#include "nikonmn_int.hpp"
+#include "tags_int.hpp"
 
 #include "rw2image.hpp"
 #include "pgfimage.hpp"
 #include "xmpsidecar.hpp"
 
 // + standard includes
+#include <algorithm>
 #include <cerrno>
 #include <cstdio>
 #include <cstring>
 #include <cassert>
 #include <iostream>
 #include <limits>
+#include <new>
+#include <vector>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -103,7 +112,7 @@ namespace {
         { ImageType::crw,  newCrwInstance,  isCrwType,  amReadWrite, amNone,      amNone,      amReadWrite },
         { ImageType::mrw,  newMrwInstance,  isMrwType,  amRead,      amRead,      amRead,      amNone      },
         { ImageType::tiff, newTiffInstance, isTiffType, amReadWrite, amReadWrite, amReadWrite, amNone      },
-        { ImageType::bigtiff, newBigTiffInstance, isBigTiffType, amRead, amRead,  amRead,      amNone      },
+        { ImageType::bigtiff, newBigTiffInstance, isBigTiffType, amReadWrite, amReadWrite, amReadWrite, amNone      },
         { ImageType::webp, newWebPInstance, isWebPType, amReadWrite, amNone,      amReadWrite, amNone      },
         { ImageType::dng,  newTiffInstance, isTiffType, amReadWrite, amReadWrite, amReadWrite, amNone      },
         { ImageType::nef,  newTiffInstance, isTiffType, amReadWrite, amReadWrite, amReadWrite, amNone      },
@@ -124,10 +133,132 @@ namespace {
         { ImageType::tga,  newTgaInstance,  isTgaType,  amNone,      amNone,      amNone,      amNone      },
         { ImageType::bmp,  newBmpInstance,  isBmpType,  amNone,      amNone,      amNone,      amNone      },
         { ImageType::jp2,  newJp2Instance,  isJp2Type,  amReadWrite, amReadWrite, amReadWrite, amNone      },
+        { ImageType::bmff, newBmffInstance, isBmffType, amRead,      amNone,      amRead,      amNone      },
         // End of list marker
         { ImageType::none, 0,               0,          amNone,      amNone,      amNone,      amNone      }
     };
 
+    //! Magic bytes at the start of a metadata snapshot, the last one is the version of the format
+    const byte snapshotMagic[] = { 'E', 'x', 'v', 'M', 'S', 'n', 'p', 0x01 };
+
+    //! Append \em size bytes at \em pData to \em blob, preceded by their size
+    void appendBlock(Blob& blob, const byte* pData, size_t size)
+    {
+        byte buf[4];
+        ul2Data(buf, static_cast<uint32_t>(size), littleEndian);
+        blob.insert(blob.end(), buf, buf + sizeof(buf));
+        if (size > 0) blob.insert(blob.end(), pData, pData + size);
+    }
+
+    //! Return the block at \em pos of the \em size bytes at \em pData and advance \em pos past it
+    std::pair<const byte*, uint32_t> nextBlock(const byte* pData, long size, long& pos)
+    {
+        if (size - pos < 4) throw Error(kerCorruptedMetadata);
+        const uint32_t blockSize = getULong(pData + pos, littleEndian);
+        pos += 4;
+        if (static_cast<unsigned long>(size - pos) < blockSize) throw Error(kerCorruptedMetadata);
+        const std::pair<const byte*, uint32_t> block(pData + pos, blockSize);
+        pos += static_cast<long>(blockSize);
+        return block;
+    }
+
+    /*!
+      @brief Return true if the image in \em io, which starts with the \em size
+          bytes of \em header, is of the type of entry \em i of registry[].
+          Only the TGA check, which looks at the file name and the end of the
+          file, uses \em io itself.
+     */
+    bool matchesRegistryEntry(int i, BasicIo& io, const byte* header, long size)
+    {
+        if (registry[i].imageType_ == ImageType::tga) return registry[i].isThisType_(io, false);
+        MemIo headerIo(header, size);
+        return registry[i].isThisType_(headerIo, false);
+    }
+
+    /*!
+      @brief Return the index of the entry in registry[] which matches the image
+          in \em io, -1 if there is none. \em io must be open.
+
+      The header is read once and the type checks run on a copy of it in
+      memory. If \em typeHint is a registered image type, its check runs
+      first and the others only if it fails, otherwise they run in the order
+      of the registry. The IO position of \em io is not changed.
+     */
+    int findRegistryEntry(BasicIo& io, int typeHint = ImageType::none)
+    {
+        // more than any of the type checks reads
+        const long headerSize = 128;
+        byte header[headerSize];
+        const long size = io.readAt(io.tell(), header, headerSize);
+        const Registry* hint = typeHint == ImageType::none ? 0 : find(registry, typeHint);
+        if (hint) {
+            const int i = static_cast<int>(hint - registry);
+            if (matchesRegistryEntry(i, io, header, size)) return i;
+        }
+        for (int i = 0; registry[i].imageType_ != ImageType::none; ++i) {
+            if (registry + i != hint && matchesRegistryEntry(i, io, header, size)) return i;
+        }
+        return -1;
+    }
+
+    /*!
+      @brief Return the size of the leading part of an image of type \em imageType
+          which usually holds all of its metadata, 0 if the metadata may be
+          anywhere in the file.
+     */
+    long metadataPrefixSize(int imageType)
+    {
+        switch (imageType) {
+        case ImageType::jpeg:
+        case ImageType::exv:
+        case ImageType::png:
+        case ImageType::webp:
+        case ImageType::psd:
+        case ImageType::jp2:
+            return 64 * 1024;
+        default:
+            // TIFF based images prefetch their directories in readMetadata()
+            return 0;
+        }
+    }
+
+    //! Open a copy in memory of the image in \em io
+    Image::UniquePtr openCopy(BasicIo& io)
+    {
+        if (io.open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io.path(), strError());
+        }
+        std::unique_ptr<MemIo> copy(new MemIo);
+        {
+            IoCloser closer(io);
+            copy->reserve(static_cast<long>(io.size()));
+            if (copy->write(io) != static_cast<long>(io.size())) throw Error(kerFailedToReadImageData);
+        }
+        Image::UniquePtr image = ImageFactory::open(BasicIo::UniquePtr(copy.release()));
+        if (image.get() == 0) throw Error(kerMemoryContainsUnknownImageType);
+        return image;
+    }
+
+    //! Write the image in \em io to \em dst
+    void copyImage(BasicIo& io, BasicIo& dst)
+    {
+        if (io.open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io.path(), strError());
+        }
+        IoCloser closer(io);
+        if (dst.write(io) != static_cast<long>(io.size())) throw Error(kerImageWriteFailed);
+    }
+
+    //! Run \em fct in a thread of the Internal::AsyncPool and return a future for its result
+    template <typename R>
+    std::future<R> runAsync(std::function<R()> fct)
+    {
+        std::shared_ptr<std::packaged_task<R()> > task(new std::packaged_task<R()>(std::move(fct)));
+        std::future<R> result = task->get_future();
+        Internal::AsyncPool::instance().post([task]() { (*task)(); });
+        return result;
+    }
+
 }
 
 // *****************************************************************************
@@ -140,6 +271,8 @@ namespace Exiv2 {
         : io_(std::move(io)),
           pixelWidth_(0),
           pixelHeight_(0),
+          payloadHash_(0),
+          payloadHashDefined_(false),
           imageType_(imageType),
           supportedMetadata_(supportedMetadata),
 #ifdef EXV_HAVE_XMP_TOOLKIT
@@ -147,7 +280,14 @@ namespace Exiv2 {
 #else
           writeXmpFromPacket_(true),
 #endif
+          writeInPlace_(false),
+          writePadding_(0),
+          hashPayload_(false),
+          leanMode_(false),
+          parallelDecode_(false),
+          xmpPacketReleased_(false),
           byteOrder_(invalidByteOrder),
+          iccSharedFrom_(0),
           tags_(),
           init_(true)
     {
@@ -155,6 +295,8 @@ namespace Exiv2 {
 
     Image::~Image()
     {
+        IoStats* collected = Internal::collectedStats();
+        if (collected) collected->metadataMemory_ += memoryUsage();
     }
 
     void Image::printStructure(std::ostream&, PrintStructureOption,int /*depth*/)
@@ -162,6 +304,47 @@ namespace Exiv2 {
         throw Error(kerUnsupportedImageType, io_->path());
     }
 
+    std::future<void> Image::readMetadataAsync()
+    {
+        return runAsync<void>([this]() { readMetadata(); });
+    }
+
+    void Image::readMetadataAsync(const std::function<void(std::exception_ptr)>& handler)
+    {
+        Internal::AsyncPool::instance().post([this, handler]() {
+            std::exception_ptr error;
+            try {
+                readMetadata();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            handler(error);
+        });
+    }
+
+    ErrorCode Image::tryReadMetadata()
+    {
+        try {
+            const Registry* r = find(registry, imageType_);
+            if (r) {
+                // The check readMetadata() starts with, minus the exception
+                if (io_->open() != 0) return kerDataSourceOpenFailed;
+                IoCloser closer(*io_);
+                if (!r->isThisType_(*io_, false)) {
+                    return io_->error() || io_->eof() ? kerFailedToReadImageData : kerNotAnImage;
+                }
+            }
+            readMetadata();
+        }
+        catch (const AnyError& error) {
+            return static_cast<ErrorCode>(error.code());
+        }
+        catch (const std::bad_alloc&) {
+            return kerMallocFailed;
+        }
+        return kerSuccess;
+    }
+
     bool Image::isStringType(uint16_t type)
     {
         return type == Exiv2::asciiString
@@ -308,6 +491,9 @@ namespace Exiv2 {
             case Exiv2::tiffFloat        : result = "FLOAT"     ; break;
             case Exiv2::tiffDouble       : result = "DOUBLE"    ; break;
             case Exiv2::tiffIfd          : result = "IFD"       ; break;
+            case Exiv2::unsignedLongLong : result = "LONG8"     ; break;
+            case Exiv2::signedLongLong   : result = "SLONG8"    ; break;
+            case Exiv2::tiffIfd8         : result = "IFD8"      ; break;
             default                      : result = "unknown"   ; break;
         }
         return result;
@@ -319,6 +505,12 @@ namespace Exiv2 {
     }
 
     void Image::printIFDStructure(BasicIo& io, std::ostream& out, Exiv2::PrintStructureOption option,uint32_t start,bool bSwap,char c,int depth)
+    {
+        DataBuf scratch;
+        printIFDStructure(io, out, option, start, bSwap, c, depth, scratch);
+    }
+
+    void Image::printIFDStructure(BasicIo& io, std::ostream& out, Exiv2::PrintStructureOption option,uint32_t start,bool bSwap,char c,int depth,DataBuf& scratch)
     {
         depth++;
         bool bFirst  = true  ;
@@ -328,6 +520,32 @@ namespace Exiv2 {
         DataBuf  dir(dirSize);
         bool bPrint = option == kpsBasic || option == kpsRecursive;
 
+        // Size of the elements of a value
+        auto elementSize = [this](uint16_t type) -> uint32_t {
+            return isStringType(type) ? 1
+                 : is2ByteType(type)  ? 2
+                 : is4ByteType(type)  ? 4
+                 : is8ByteType(type)  ? 8
+                 : 1
+                 ;
+        };
+        // Number of elements of a value which are printed
+        auto printCount = [this, option](uint16_t tag, uint16_t type, uint32_t count) -> uint32_t {
+            return isPrintXMP(tag,option) ? count // haul in all the data
+                 : isPrintICC(tag,option) ? count // ditto
+                 : isStringType(type)     ? (count > 32 ? 32 : count) // restrict long arrays
+                 : count > 5              ? 5
+                 : count
+                 ;
+        };
+        // Number of elements of a value which are needed: the printed ones and the offsets of sub-IFDs
+        auto readCount = [&](uint16_t tag, uint16_t type, uint32_t count) -> uint32_t {
+            if ( option == kpsRecursive && (tag == 0x8769 /* ExifTag */ || tag == 0x014a/*SubIFDs*/  || type == tiffIfd) ) {
+                return count;
+            }
+            return bPrint || isPrintXMP(tag,option) || isPrintICC(tag,option) ? printCount(tag,type,count) : 0;
+        };
+
         do {
             // Read top of directory
             const int seekSuccess = !io.seek(start,BasicIo::beg);
@@ -347,7 +565,27 @@ namespace Exiv2 {
                 out << Internal::indent(depth) << Internal::stringFormat("STRUCTURE OF TIFF FILE (%c%c): ",c,c) << io.path() << std::endl;
             }
 
-            // Read the dictionary
+            // Read the dictionary and the offset of the next directory at once
+            DataBuf entries(12 * dirLength + 4);
+            std::memset(entries.pData_, 0, entries.size_);
+            io.read(entries.pData_, entries.size_);
+
+            // Fetch the values which are not in the dictionary together, in the order of their offsets
+            std::vector<std::pair<long, long> > ranges;
+            for ( int i = 0 ; i < dirLength ; i ++ ) {
+                uint16_t tag    = byteSwap2(entries,i*12+0,bSwap);
+                uint16_t type   = byteSwap2(entries,i*12+2,bSwap);
+                uint32_t count  = byteSwap4(entries,i*12+4,bSwap);
+                uint32_t offset = byteSwap4(entries,i*12+8,bSwap);
+                if ( !typeValid(type) ) break;
+                const long long length = (long long) elementSize(type) * count;
+                if ( length > 4 && length < (long long) io.size() ) {
+                    ranges.push_back(std::make_pair((long) offset, (long) (elementSize(type) * readCount(tag,type,count))));
+                }
+            }
+            std::sort(ranges.begin(), ranges.end());
+            io.prefetch(ranges);
+
             for ( int i = 0 ; i < dirLength ; i ++ ) {
                 if ( bFirst && bPrint ) {
                     out << Internal::indent(depth)
@@ -356,11 +594,10 @@ namespace Exiv2 {
                 }
                 bFirst = false;
 
-                io.read(dir.pData_, 12);
-                uint16_t tag    = byteSwap2(dir,0,bSwap);
-                uint16_t type   = byteSwap2(dir,2,bSwap);
-                uint32_t count  = byteSwap4(dir,4,bSwap);
-                uint32_t offset = byteSwap4(dir,8,bSwap);
+                uint16_t tag    = byteSwap2(entries,i*12+0,bSwap);
+                uint16_t type   = byteSwap2(entries,i*12+2,bSwap);
+                uint32_t count  = byteSwap4(entries,i*12+4,bSwap);
+                uint32_t offset = byteSwap4(entries,i*12+8,bSwap);
 
                 // Break for unknown tag types else we may segfault.
                 if ( !typeValid(type) ) {
@@ -372,19 +609,9 @@ namespace Exiv2 {
                 std::string sp  = "" ; // output spacer
 
                 //prepare to print the value
-                uint32_t kount  = isPrintXMP(tag,option) ? count // haul in all the data
-                                : isPrintICC(tag,option) ? count // ditto
-                                : isStringType(type)     ? (count > 32 ? 32 : count) // restrict long arrays
-                                : count > 5              ? 5
-                                : count
-                                ;
+                uint32_t kount  = printCount(tag,type,count);
                 uint32_t pad    = isStringType(type) ? 1 : 0;
-                uint32_t size   = isStringType(type) ? 1
-                                : is2ByteType(type)  ? 2
-                                : is4ByteType(type)  ? 4
-                                : is8ByteType(type)  ? 8
-                                : 1
-                                ;
+                uint32_t size   = elementSize(type);
 
                 // if ( offset > io.size() ) offset = 0; // Denial of service?
 
@@ -393,16 +620,17 @@ namespace Exiv2 {
                 if ( allocate > (long long) io.size() ) {
                     throw Error(kerInvalidMalloc);
                 }
-                DataBuf  buf((long)allocate);  // allocate a buffer
-                std::memset(buf.pData_, 0, buf.size_);
-                std::memcpy(buf.pData_,dir.pData_+8,4);  // copy dir[8:11] into buffer (short strings)
+                // Only the elements which are needed are read into the scratch buffer
                 const bool bOffsetIsPointer = count*size > 4;
+                const uint32_t length = bOffsetIsPointer ? readCount(tag,type,count)*size : 4;
+                if ( scratch.size_ < (long) (length + pad + 20) ) {
+                    scratch.alloc(length + pad + 20);
+                }
+                std::memset(scratch.pData_, 0, length + pad + 20);
+                std::memcpy(scratch.pData_,entries.pData_+i*12+8,4);  // copy dir[8:11] into buffer (short strings)
 
                 if ( bOffsetIsPointer ) {         // read into buffer
-                    size_t   restore = io.tell();  // save
-                    io.seek(offset,BasicIo::beg);  // position
-                    io.read(buf.pData_,count*size);// read
-                    io.seek(restore,BasicIo::beg); // restore
+                    io.readAt(offset,scratch.pData_,length);
                 }
 
                 if ( bPrint ) {
@@ -416,35 +644,37 @@ namespace Exiv2 {
                                               ,address,tag,tagName(tag).c_str(),typeName(type),count,offsetString.c_str());
                     if ( isShortType(type) ){
                         for ( size_t k = 0 ; k < kount ; k++ ) {
-                            out << sp << byteSwap2(buf,k*size,bSwap);
+                            out << sp << byteSwap2(scratch,k*size,bSwap);
                             sp = " ";
                         }
                     } else if ( isLongType(type) ){
                         for ( size_t k = 0 ; k < kount ; k++ ) {
-                            out << sp << byteSwap4(buf,k*size,bSwap);
+                            out << sp << byteSwap4(scratch,k*size,bSwap);
                             sp = " ";
                         }
 
                     } else if ( isRationalType(type) ){
                         for ( size_t k = 0 ; k < kount ; k++ ) {
-                            uint32_t a = byteSwap4(buf,k*size+0,bSwap);
-                            uint32_t b = byteSwap4(buf,k*size+4,bSwap);
+                            uint32_t a = byteSwap4(scratch,k*size+0,bSwap);
+                            uint32_t b = byteSwap4(scratch,k*size+4,bSwap);
                             out << sp << a << "/" << b;
                             sp = " ";
                         }
                     } else if ( isStringType(type) ) {
-                        out << sp << Internal::binaryToString(makeSlice(buf, 0, kount));
+                        out << sp << Internal::binaryToString(makeSlice(scratch, 0, kount));
                     }
 
                     sp = kount == count ? "" : " ...";
                     out << sp << std::endl;
 
                     if ( option == kpsRecursive && (tag == 0x8769 /* ExifTag */ || tag == 0x014a/*SubIFDs*/  || type == tiffIfd) ) {
+                        // The recursion reuses the scratch buffer
+                        std::vector<uint32_t> offsets(count);
+                        for ( size_t k = 0 ; k < count ; k++ ) {
+                            offsets[k] = byteSwap4(scratch,k*size,bSwap);
+                        }
                         for ( size_t k = 0 ; k < count ; k++ ) {
-                            size_t   restore = io.tell();
-                            uint32_t offset2 = byteSwap4(buf,k*size,bSwap);
-                            printIFDStructure(io,out,option,offset2,bSwap,c,depth);
-                            io.seek(restore,BasicIo::beg);
+                            printIFDStructure(io,out,option,offsets[k],bSwap,c,depth,scratch);
                         }
                     } else if ( option == kpsRecursive && tag == 0x83bb /* IPTCNAA */ ) {
 
@@ -452,52 +682,43 @@ namespace Exiv2 {
                             throw Error(kerCorruptedMetadata);
                         }
 
-                        const size_t restore = io.tell();
-                        io.seek(offset, BasicIo::beg);  // position
                         std::vector<byte> bytes(count) ;  // allocate memory
                         // TODO: once we have C++11 use bytes.data()
-                        const long read_bytes = io.read(&bytes[0], count);
-                        io.seek(restore, BasicIo::beg);
+                        const long read_bytes = io.readAt(offset, &bytes[0], count);
                         // TODO: once we have C++11 use bytes.data()
                         IptcData::printStructure(out, makeSliceUntil(&bytes[0], read_bytes), depth);
 
                     }  else if ( option == kpsRecursive && tag == 0x927c /* MakerNote */ && count > 10) {
-                        size_t   restore = io.tell();  // save
-
                         uint32_t jump= 10           ;
                         byte     bytes[20]          ;
                         const char* chars = (const char*) &bytes[0] ;
-                        io.seek(offset,BasicIo::beg);  // position
-                        io.read(bytes,jump    )     ;  // read
+                        std::memset(bytes,0,jump)   ;
+                        io.readAt(offset,bytes,jump);  // read
                         bytes[jump]=0               ;
                         if ( ::strcmp("Nikon",chars) == 0 ) {
                             // tag is an embedded tiff
                             byte* bytes2=new byte[count-jump] ;  // allocate memory
-                            io.read(bytes2,count-jump)        ;  // read
+                            io.readAt(offset+jump,bytes2,count-jump); // read
                             MemIo memIo(bytes2,count-jump)    ;  // create a file
                             printTiffStructure(memIo,out,option,depth);
                             delete[] bytes2                   ;  // free
                         } else {
                             // tag is an IFD
-                            io.seek(0,BasicIo::beg);  // position
-                            printIFDStructure(io,out,option,offset,bSwap,c,depth);
+                            printIFDStructure(io,out,option,offset,bSwap,c,depth,scratch);
                         }
-
-                        io.seek(restore,BasicIo::beg); // restore
                     }
                 }
 
                 if ( isPrintXMP(tag,option) ) {
-                    buf.pData_[count]=0;
-                    out << (char*) buf.pData_;
+                    scratch.pData_[count]=0;
+                    out << (char*) scratch.pData_;
                 }
                 if ( isPrintICC(tag,option) ) {
-                    out.write((const char*)buf.pData_,count);
+                    out.write((const char*)scratch.pData_,count);
                 }
             }
             if ( start ) {
-                io.read(dir.pData_, 4);
-                start = tooBig ? 0 : byteSwap4(dir,0,bSwap);
+                start = tooBig ? 0 : byteSwap4(entries,12*dirLength,bSwap);
             }
         } while (start) ;
 
@@ -526,6 +747,11 @@ namespace Exiv2 {
         }
     }
 
+    void Image::readBasicInfo()
+    {
+        readMetadata();
+    }
+
     void Image::clearMetadata()
     {
         clearExifData();
@@ -536,6 +762,18 @@ namespace Exiv2 {
         clearIccProfile();
     }
 
+    void Image::setDecodeFilter(const DecodeFilter& filter)
+    {
+        exifData_.setDecodeFilter(filter);
+        iptcData_.setDecodeFilter(filter);
+        xmpData_.setDecodeFilter(filter);
+    }
+
+    std::shared_ptr<const ImageSnapshot> Image::snapshot()
+    {
+        return std::make_shared<const ImageSnapshot>(*this);
+    }
+
     ExifData& Image::exifData()
     {
         return exifData_;
@@ -543,25 +781,80 @@ namespace Exiv2 {
 
     IptcData& Image::iptcData()
     {
+        decodeEmbedded();
         return iptcData_;
     }
 
     XmpData& Image::xmpData()
     {
+        decodeEmbedded();
         return xmpData_;
     }
 
     std::string& Image::xmpPacket()
     {
         // Serialize the current XMP
+        decodeEmbedded();
         if (xmpData_.count() > 0 && !writeXmpFromPacket()) {
             XmpParser::encode(xmpPacket_, xmpData_,
                               XmpParser::useCompactFormat |
                               XmpParser::omitAllFormatting);
         }
+        else {
+            restoreXmpPacket();
+        }
         return xmpPacket_;
     }
 
+    void Image::checkUnfiltered() const
+    {
+        if (   !exifData_.decodeFilter().empty()
+            || !iptcData_.decodeFilter().empty()
+            || !xmpData_.decodeFilter().empty()) {
+            throw Error(kerFilteredMetadata);
+        }
+    }
+
+    void Image::releasePackets()
+    {
+        if (!leanMode_) return;
+        if (!xmpData_.usePacket()) xmpData_.releasePacket();
+        if (!writeXmpFromPacket_ && !xmpPacket_.empty()) {
+            std::string().swap(xmpPacket_);
+            xmpPacketReleased_ = true;
+        }
+    }
+
+    void Image::restoreXmpPacket() const
+    {
+        if (!xmpPacketReleased_ || !xmpPacket_.empty()) {
+            xmpPacketReleased_ = false;
+            return;
+        }
+        // Read the image again through a view of io_, which may be in use
+        const bool isOpen = io_->isopen();
+        const long pos = isOpen ? io_->tell() : 0;
+        {
+            Image::UniquePtr image = ImageFactory::open(
+                BasicIo::UniquePtr(new Internal::SubIo(*io_, 0, io_->size())));
+            if (image.get() != 0) {
+                image->setDecodeFilter(DecodeFilter().addFamily("Xmp"));
+                image->readMetadata();
+                xmpPacket_ = static_cast<const Image&>(*image).xmpPacket();
+            }
+        }
+        if (isOpen) io_->seek(pos, BasicIo::beg);
+        xmpPacketReleased_ = false;
+    }
+
+    void Image::decodeEmbedded() const
+    {
+        if (!exifData_.embeddedPending()) return;
+        // Deferred like a lazy makernote, the const accessors decode on first access
+        Image* self = const_cast<Image*>(this);
+        self->exifData_.decodeEmbedded(self->iptcData_, self->xmpData_, byteOrder());
+    }
+
     void Image::setMetadata(const Image& image)
     {
         if (checkMode(mdExif) & amWrite) {
@@ -582,8 +875,126 @@ namespace Exiv2 {
         }
     }
 
+    void Image::writeMetadataTo(BasicIo& dst)
+    {
+        checkUnfiltered();
+        // Write the metadata to a copy of the image in memory
+        Image::UniquePtr image = openCopy(*io_);
+        image->setMetadata(*this);
+        image->setByteOrder(byteOrder());
+        image->writeXmpFromPacket(writeXmpFromPacket());
+        image->writePadding(writePadding());
+        image->writeMetadata();
+        copyImage(image->io(), dst);
+    }
+
+    void Image::stripMetadataTo(BasicIo& dst, int keep)
+    {
+        // Strip the metadata from a copy of the image in memory
+        Image::UniquePtr image = openCopy(*io_);
+        image->readMetadata();
+        if (!(keep & mdExif)) image->clearExifData();
+        if (!(keep & mdIptc)) image->clearIptcData();
+        if (!(keep & mdXmp)) {
+            image->clearXmpPacket();
+            image->clearXmpData();
+        }
+        if (!(keep & mdComment)) image->clearComment();
+        if (!(keep & mdIccProfile)) image->clearIccProfile();
+        image->writeMetadata();
+        copyImage(image->io(), dst);
+    }
+
+    void Image::importMetadata(const byte* pData, long size)
+    {
+        if (   size < static_cast<long>(sizeof(snapshotMagic))
+            || memcmp(pData, snapshotMagic, sizeof(snapshotMagic)) != 0) {
+            throw Error(kerNotAnImage, "metadata snapshot");
+        }
+        long pos = sizeof(snapshotMagic);
+        const std::pair<const byte*, uint32_t> exif = nextBlock(pData, size, pos);
+        const std::pair<const byte*, uint32_t> iptc = nextBlock(pData, size, pos);
+        const std::pair<const byte*, uint32_t> xmp = nextBlock(pData, size, pos);
+        const std::pair<const byte*, uint32_t> comment = nextBlock(pData, size, pos);
+
+        if (checkMode(mdExif) & amWrite) {
+            exifData_.clear();
+            if (exif.second > 0) {
+                setByteOrder(ExifParser::decode(exifData_, exif.first, exif.second));
+            }
+        }
+        if (checkMode(mdIptc) & amWrite) {
+            iptcData_.clear();
+            if (iptc.second > 0 && IptcParser::decode(iptcData_, iptc.first, iptc.second)) {
+#ifndef SUPPRESS_WARNINGS
+                EXV_WARNING << "Failed to decode IPTC metadata.\n";
+#endif
+                iptcData_.clear();
+            }
+        }
+        if (checkMode(mdXmp) & amWrite) {
+            xmpPacketReleased_ = false;
+            xmpPacket_.assign(reinterpret_cast<const char*>(xmp.first), xmp.second);
+            xmpData_.clear();
+            if (!xmpPacket_.empty() && XmpParser::decode(xmpData_, xmpPacket_)) {
+#ifndef SUPPRESS_WARNINGS
+                EXV_WARNING << "Failed to decode XMP metadata.\n";
+#endif
+            }
+            writeXmpFromPacket(false);
+        }
+        if (checkMode(mdComment) & amWrite) {
+            comment_.assign(reinterpret_cast<const char*>(comment.first), comment.second);
+        }
+    }
+
+    DataBuf Image::exportMetadata() const
+    {
+        Blob blob(snapshotMagic, snapshotMagic + sizeof(snapshotMagic));
+
+        Blob exif;
+        if (!exifData_.empty()) {
+            ExifParser::encode(exif, byteOrder() == invalidByteOrder ? littleEndian : byteOrder(), exifData_);
+        }
+        appendBlock(blob, exif.empty() ? 0 : &exif[0], exif.size());
+
+        decodeEmbedded();
+        const DataBuf iptc = IptcParser::encode(iptcData_);
+        appendBlock(blob, iptc.pData_, iptc.size_);
+
+        std::string xmpPacket = xmpPacket_;
+        if (!writeXmpFromPacket()) {
+            xmpPacket.clear();
+            if (   !xmpData_.empty()
+                && XmpParser::encode(xmpPacket, xmpData_,
+                                     XmpParser::useCompactFormat | XmpParser::omitAllFormatting) > 1) {
+#ifndef SUPPRESS_WARNINGS
+                EXV_ERROR << "Failed to encode XMP metadata.\n";
+#endif
+            }
+        }
+        appendBlock(blob, reinterpret_cast<const byte*>(xmpPacket.data()), xmpPacket.size());
+        appendBlock(blob, reinterpret_cast<const byte*>(comment_.data()), comment_.size());
+
+        return DataBuf(&blob[0], static_cast<long>(blob.size()));
+    }
+
+    MemoryUsage Image::memoryUsage() const
+    {
+        MemoryUsage usage = exifData_.memoryUsage();
+        usage += iptcData_.memoryUsage();
+        usage += xmpData_.memoryUsage();
+        usage.buffers_ += xmpPacket_.capacity() + iccProfile_.size_ + iccShared_.size() + comment_.capacity();
+        usage.buffers_ += nativePreviews_.capacity() * sizeof(NativePreview);
+        for (NativePreviewList::const_iterator i = nativePreviews_.begin(); i != nativePreviews_.end(); ++i) {
+            usage.buffers_ += i->filter_.capacity() + i->mimeType_.capacity();
+        }
+        return usage;
+    }
+
     void Image::clearExifData()
     {
+        // A pending decode of embedded IPTC and XMP outlives the tags, see ExifData::embeddedPending()
         exifData_.clear();
     }
 
@@ -594,22 +1005,27 @@ namespace Exiv2 {
 
     void Image::clearIptcData()
     {
+        decodeEmbedded();
         iptcData_.clear();
     }
 
     void Image::setIptcData(const IptcData& iptcData)
     {
+        decodeEmbedded();
         iptcData_ = iptcData;
     }
 
     void Image::clearXmpPacket()
     {
+        xmpPacketReleased_ = false;
         xmpPacket_.clear();
         writeXmpFromPacket(true);
     }
 
     void Image::setXmpPacket(const std::string& xmpPacket)
     {
+        decodeEmbedded();
+        xmpPacketReleased_ = false;
         xmpPacket_ = xmpPacket;
         if ( XmpParser::decode(xmpData_, xmpPacket) ) {
             throw Error(kerInvalidXMP);
@@ -619,12 +1035,14 @@ namespace Exiv2 {
 
     void Image::clearXmpData()
     {
+        decodeEmbedded();
         xmpData_.clear();
         writeXmpFromPacket(false);
     }
 
     void Image::setXmpData(const XmpData& xmpData)
     {
+        decodeEmbedded();
         xmpData_ = xmpData;
         writeXmpFromPacket(false);
     }
@@ -632,12 +1050,53 @@ namespace Exiv2 {
 #ifdef EXV_HAVE_XMP_TOOLKIT
     void Image::writeXmpFromPacket(bool flag)
     {
+        if (flag) restoreXmpPacket();
         writeXmpFromPacket_ = flag;
     }
 #else
     void Image::writeXmpFromPacket(bool) {}
 #endif
 
+    void Image::writeChangedMetadata(const MetadataDiff& diff)
+    {
+        if (diff.empty()) return;
+        const bool inPlace = writeInPlace_;
+        writeInPlace_ = inPlace || diff.fixedSize();
+        try {
+            writeMetadata();
+        }
+        catch (...) {
+            writeInPlace_ = inPlace;
+            throw;
+        }
+        writeInPlace_ = inPlace;
+    }
+
+    void Image::writeInPlace(bool flag)
+    {
+        writeInPlace_ = flag;
+    }
+
+    void Image::writePadding(uint32_t size)
+    {
+        writePadding_ = size;
+    }
+
+    void Image::hashPayload(bool flag)
+    {
+        hashPayload_ = flag;
+    }
+
+    void Image::leanMode(bool flag)
+    {
+        leanMode_ = flag;
+    }
+
+    void Image::parallelDecode(bool flag)
+    {
+        parallelDecode_ = flag;
+    }
+
     void Image::clearComment()
     {
         comment_.erase();
@@ -656,11 +1115,25 @@ namespace Exiv2 {
             if ( size!= iccProfile.size_ ) throw Error(kerInvalidIccProfile);
         }
         iccProfile_ = iccProfile;
+        iccShared_ = SharedBuf();
     }
 
     void Image::clearIccProfile()
     {
         iccProfile_.free();
+        iccShared_ = SharedBuf();
+    }
+
+    SharedBuf Image::sharedIccProfile()
+    {
+        const DataBuf* iccProfile = this->iccProfile();
+        if (iccProfile->size_ <= 0) return SharedBuf();
+        if (   iccSharedFrom_ != iccProfile->pData_
+            || iccShared_.size() != static_cast<size_t>(iccProfile->size_)) {
+            iccShared_ = SharedBuf(iccProfile->pData_, static_cast<size_t>(iccProfile->size_));
+            iccSharedFrom_ = iccProfile->pData_;
+        }
+        return iccShared_;
     }
 
     void Image::setByteOrder(ByteOrder byteOrder)
@@ -690,11 +1163,13 @@ namespace Exiv2 {
 
     const IptcData& Image::iptcData() const
     {
+        decodeEmbedded();
         return iptcData_;
     }
 
     const XmpData& Image::xmpData() const
     {
+        decodeEmbedded();
         return xmpData_;
     }
 
@@ -705,6 +1180,7 @@ namespace Exiv2 {
 
     const std::string& Image::xmpPacket() const
     {
+        restoreXmpPacket();
         return xmpPacket_;
     }
 
@@ -713,11 +1189,51 @@ namespace Exiv2 {
         return *io_;
     }
 
+    const IoStats& Image::stats() const
+    {
+        return io_->stats();
+    }
+
     bool Image::writeXmpFromPacket() const
     {
         return writeXmpFromPacket_;
     }
 
+    bool Image::writeInPlace() const
+    {
+        return writeInPlace_;
+    }
+
+    uint32_t Image::writePadding() const
+    {
+        return writePadding_;
+    }
+
+    bool Image::hashPayload() const
+    {
+        return hashPayload_;
+    }
+
+    bool Image::leanMode() const
+    {
+        return leanMode_;
+    }
+
+    bool Image::parallelDecode() const
+    {
+        return parallelDecode_;
+    }
+
+    bool Image::payloadHashDefined() const
+    {
+        return payloadHashDefined_;
+    }
+
+    uint64_t Image::payloadHash() const
+    {
+        return payloadHashDefined_ ? payloadHash_ : 0;
+    }
+
     const NativePreviewList& Image::nativePreviews() const
     {
         return nativePreviews_;
@@ -751,8 +1267,8 @@ namespace Exiv2 {
             for (ti = Internal:: ifdTagList(), idx = 0; ti[idx].tag_ != 0xffff; ++idx) tags_[ti[idx].tag_] = ti[idx].name_;
             for (ti = Internal::exifTagList(), idx = 0; ti[idx].tag_ != 0xffff; ++idx) tags_[ti[idx].tag_] = ti[idx].name_;
             for (ti = Internal:: mpfTagList(), idx = 0; ti[idx].tag_ != 0xffff; ++idx) tags_[ti[idx].tag_] = ti[idx].name_;
-            for (ti = Internal::Nikon1MakerNote::tagList(), idx = 0
-                                                    ; ti[idx].tag_ != 0xffff; ++idx) tags_[ti[idx].tag_] = ti[idx].name_;
+            ti = Internal::mnGroupTagList(Internal::nikon1Id);
+            for (idx = 0; ti && ti[idx].tag_ != 0xffff; ++idx) tags_[ti[idx].tag_] = ti[idx].name_;
         }
         init_ = false;
 
@@ -819,12 +1335,8 @@ namespace Exiv2 {
     {
         if (io.open() != 0) return ImageType::none;
         IoCloser closer(io);
-        for (unsigned int i = 0; registry[i].imageType_ != ImageType::none; ++i) {
-            if (registry[i].isThisType_(io, false)) {
-                return registry[i].imageType_;
-            }
-        }
-        return ImageType::none;
+        const int i = findRegistryEntry(io);
+        return i < 0 ? ImageType::none : registry[i].imageType_;
     } // ImageFactory::getType
 
     BasicIo::UniquePtr ImageFactory::createIo(const std::string& path, bool useCurl)
@@ -885,6 +1397,44 @@ namespace Exiv2 {
         return image;
     }
 
+    Image::UniquePtr ImageFactory::open(const std::string& path, const RemoteOptions& options, bool useCurl)
+    {
+        BasicIo::UniquePtr io = ImageFactory::createIo(path, useCurl); // may throw
+        RemoteIo* remoteIo = dynamic_cast<RemoteIo*>(io.get());
+        if (remoteIo) remoteIo->setRemoteOptions(options);
+        Image::UniquePtr image = open(std::move(io)); // may throw
+        if (image.get() == 0) throw Error(kerFileContainsUnknownImageType, path);
+        return image;
+    }
+
+    std::future<Image::UniquePtr> ImageFactory::openAsync(const std::string& path, const RemoteOptions& options,
+                                                          bool useCurl)
+    {
+        return runAsync<Image::UniquePtr>([path, options, useCurl]() { return open(path, options, useCurl); });
+    }
+
+    void ImageFactory::openAsync(const std::string& path, const OpenHandler& handler, const RemoteOptions& options,
+                                 bool useCurl)
+    {
+        Internal::AsyncPool::instance().post([path, handler, options, useCurl]() {
+            Image::UniquePtr image;
+            std::exception_ptr error;
+            try {
+                image = open(path, options, useCurl);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            handler(std::move(image), error);
+        });
+    }
+
+    Image::UniquePtr ImageFactory::open(const std::string& path, int typeHint, bool useCurl)
+    {
+        Image::UniquePtr image = open(ImageFactory::createIo(path, useCurl), typeHint); // may throw
+        if (image.get() == 0) throw Error(kerFileContainsUnknownImageType, path);
+        return image;
+    }
+
 #ifdef EXV_UNICODE_PATH
     Image::UniquePtr ImageFactory::open(const std::wstring& wpath, bool useCurl)
     {
@@ -904,16 +1454,66 @@ namespace Exiv2 {
 
     Image::UniquePtr ImageFactory::open(BasicIo::UniquePtr io)
     {
-        if (io->open() != 0) {
-            throw Error(kerDataSourceOpenFailed, io->path(), strError());
+        return open(std::move(io), ImageType::none);
+    }
+
+    Image::UniquePtr ImageFactory::open(BasicIo::UniquePtr io, int typeHint)
+    {
+        Trace trace("io", "open");
+        const std::string path = io->path();
+        Image::UniquePtr image;
+        const ErrorCode code = tryOpen(image, std::move(io), typeHint);
+        if (code == kerDataSourceOpenFailed) throw Error(kerDataSourceOpenFailed, path, strError());
+        if (code != kerSuccess && code != kerFileContainsUnknownImageType) throw Error(code);
+        return image;
+    } // ImageFactory::open
+
+    ErrorCode ImageFactory::tryOpen(Image::UniquePtr& image, const std::string& path, bool useCurl)
+    {
+        BasicIo::UniquePtr io;
+        try {
+            io = createIo(path, useCurl);
         }
-        for (unsigned int i = 0; registry[i].imageType_ != ImageType::none; ++i) {
-            if (registry[i].isThisType_(*io, false)) {
-                return registry[i].newInstance_(std::move(io), false);
+        catch (const AnyError& error) {
+            return static_cast<ErrorCode>(error.code());
+        }
+        return tryOpen(image, std::move(io));
+    }
+
+    ErrorCode ImageFactory::tryOpen(Image::UniquePtr& image, const byte* data, long size)
+    {
+        const ErrorCode code = tryOpen(image, BasicIo::UniquePtr(new MemIo(data, size)));
+        return code == kerFileContainsUnknownImageType ? kerMemoryContainsUnknownImageType : code;
+    }
+
+    ErrorCode ImageFactory::tryOpen(Image::UniquePtr& image, BasicIo::UniquePtr io)
+    {
+        return tryOpen(image, std::move(io), ImageType::none);
+    }
+
+    ErrorCode ImageFactory::tryOpen(Image::UniquePtr& image, BasicIo::UniquePtr io, int typeHint)
+    {
+        try {
+            if (io->open() != 0) return kerDataSourceOpenFailed;
+            const int i = findRegistryEntry(*io, typeHint);
+            if (i < 0) return kerFileContainsUnknownImageType;
+            // remote IO sources fetch the part with the metadata in one request
+            const long prefixSize = metadataPrefixSize(registry[i].imageType_);
+            if (prefixSize > 0) {
+                io->prefetch(std::vector<std::pair<long, long> >(1, std::make_pair(0L, prefixSize)));
             }
+            Image::UniquePtr opened = registry[i].newInstance_(std::move(io), false);
+            if (!opened) return kerFileContainsUnknownImageType;
+            image = std::move(opened);
         }
-        return Image::UniquePtr();
-    } // ImageFactory::open
+        catch (const AnyError& error) {
+            return static_cast<ErrorCode>(error.code());
+        }
+        catch (const std::bad_alloc&) {
+            return kerMallocFailed;
+        }
+        return kerSuccess;
+    }
 
     Image::UniquePtr ImageFactory::create(int type,
                                         const std::string& path)
@@ -18,13 +18,21 @@
  */
 
 #include "image_int.hpp"
+#include "basicio.hpp"
+#include "error.hpp"
+#include "stats_int.hpp"
 
+#include <algorithm>
 #include <cstdarg>
 #include <cstddef>
 #include <cstring>
+#include <memory>
 #include <vector>
 #include <cstdio>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
 namespace Exiv2
 {
     namespace Internal
@@ -59,50 +67,360 @@ namespace Exiv2
             return result;
         }
 
-        std::string binaryToHex(const byte* data, size_t size)
+        namespace
         {
-            std::stringstream hexOutput;
+            const char hexDigits[] = "0123456789abcdef";
+
+            //! Value of each lowercase hex digit, 0xff for all other characters
+            struct HexTable
+            {
+                HexTable()
+                {
+                    std::memset(value_, 0xff, sizeof(value_));
+                    for (int i = 0; i < 16; ++i) {
+                        value_[static_cast<unsigned char>(hexDigits[i])] = static_cast<byte>(i);
+                    }
+                }
+                byte value_[256];
+            };
 
-            unsigned long tl = (unsigned long)((size / 16) * 16);
-            unsigned long tl_offset = (unsigned long)(size - tl);
+            const HexTable hexTable;
 
-            for (unsigned long loop = 0; loop < (unsigned long)size; loop++) {
-                if (data[loop] < 16) {
-                    hexOutput << "0";
+            //! Append the printable characters of [data, data + size) to \em out, split in two groups of 8
+            void appendPrintable(std::string& out, const byte* data, int size)
+            {
+                for (int i = 0; i < size; ++i) {
+                    if (i == 8) {
+                        out.append(2, ' ');
+                    }
+                    out += data[i] >= 0x20 && data[i] <= 0x7E ? static_cast<char>(data[i]) : '.';
                 }
-                hexOutput << std::hex << (int)data[loop];
-                if ((loop % 8) == 7) {
-                    hexOutput << "  ";
+            }
+        }
+
+        std::string binaryToHex(const byte* data, size_t size)
+        {
+            // Each line holds at most 16 * 3 + 5 + 16 + 2 characters
+            std::string hexOutput;
+            hexOutput.reserve((size / 16 + 1) * 72 + 3);
+
+            for (size_t line = 0; line < size; line += 16) {
+                const int count = static_cast<int>(size - line < 16 ? size - line : 16);
+                char digits[2];
+                for (int i = 0; i < count; ++i) {
+                    hexEncode(data + line + i, 1, digits);
+                    hexOutput.append(digits, 2);
+                    if (i % 8 == 7) {
+                        hexOutput.append(2, ' ');
+                    }
+                }
+                for (int offset = 0; offset < 16 - count; ++offset) {
+                    if (offset % 8 == 7) {
+                        hexOutput.append(2, ' ');
+                    }
+                    hexOutput.append(3, ' ');
                 }
-                if ((loop % 16) == 15 || loop == (tl + tl_offset - 1)) {
-                    int max = 15;
-                    if (loop >= tl) {
-                        max = tl_offset - 1;
-                        for (int offset = 0; offset < (int)(16 - tl_offset); offset++) {
-                            if ((offset % 8) == 7) {
-                                hexOutput << "  ";
-                            }
-                            hexOutput << "   ";
-                        }
+                hexOutput += ' ';
+                appendPrintable(hexOutput, data + line, count);
+                hexOutput += '\n';
+            }
+
+            hexOutput.append(3, '\n');
+            return hexOutput;
+        }
+
+        void hexEncode(const byte* data, size_t size, char* out)
+        {
+            for (size_t i = 0; i < size; ++i) {
+                *out++ = hexDigits[data[i] >> 4];
+                *out++ = hexDigits[data[i] & 0x0f];
+            }
+        }
+
+        const char* hexDecode(const char* first, const char* last, byte* out, size_t size)
+        {
+            const byte* value = hexTable.value_;
+            byte* const end = out + size;
+            while (out != end) {
+                // Fast path: two adjacent digits
+                if (last - first >= 2) {
+                    const byte hi = value[static_cast<unsigned char>(first[0])];
+                    const byte lo = value[static_cast<unsigned char>(first[1])];
+                    if ((hi | lo) < 16) {
+                        *out++ = static_cast<byte>(hi << 4 | lo);
+                        first += 2;
+                        continue;
                     }
-                    hexOutput << " ";
-                    for (int offset = max; offset >= 0; offset--) {
-                        if (offset == (max - 8)) {
-                            hexOutput << "  ";
-                        }
-                        byte c = '.';
-                        if (data[loop - offset] >= 0x20 && data[loop - offset] <= 0x7E) {
-                            c = data[loop - offset];
-                        }
-                        hexOutput << (char)c;
+                }
+                // Slow path: skip other characters between the two digits
+                byte nibble[2];
+                for (int n = 0; n < 2; ++n) {
+                    while (first != last && value[static_cast<unsigned char>(*first)] == 0xff) {
+                        if (*first == '\0')
+                            return 0;
+                        ++first;
                     }
-                    hexOutput << std::endl;
+                    if (first == last)
+                        return 0;
+                    nibble[n] = value[static_cast<unsigned char>(*first++)];
+                }
+                *out++ = static_cast<byte>(nibble[0] << 4 | nibble[1]);
+            }
+            return first;
+        }
+
+        bool skipToByte(BasicIo& io, byte c)
+        {
+            byte block[512];
+            long n;
+            while ((n = io.read(block, sizeof(block))) > 0) {
+                const byte* p = findByte(block, block + n, c);
+                if (p != block + n) {
+                    return io.seek(p - (block + n), BasicIo::cur) == 0;
+                }
+            }
+            return false;
+        }
+
+        void copyData(BasicIo& src, BasicIo& dest, long count, PayloadHash* hash)
+        {
+            DataBuf buf;
+            while (count > 0) {
+                const long blockSize = count < 64 * 1024 ? count : 64 * 1024;
+                const byte* data = src.readView(buf, blockSize);
+                if (src.error()) throw Error(kerFailedToReadImageData);
+                if (data == 0) throw Error(kerInputDataReadFailed);
+                if (hash) hash->update(data, blockSize);
+                if (dest.write(data, blockSize) != blockSize) throw Error(kerImageWriteFailed);
+                count -= blockSize;
+            }
+        }
+
+        void hashData(BasicIo& src, long count, PayloadHash& hash)
+        {
+            DataBuf buf;
+            while (count > 0) {
+                const long blockSize = count < 64 * 1024 ? count : 64 * 1024;
+                const byte* data = src.readView(buf, blockSize);
+                if (src.error()) throw Error(kerFailedToReadImageData);
+                if (data == 0) throw Error(kerInputDataReadFailed);
+                hash.update(data, blockSize);
+                count -= blockSize;
+            }
+        }
+
+        struct FamilyDecoder::Outcome {
+            IoStats stats_;
+            LogMsg::Messages messages_;
+            std::exception_ptr exception_;
+        };
+
+        FamilyDecoder::FamilyDecoder(BasicIo& io) : io_(io)
+        {
+        }
+
+        FamilyDecoder::~FamilyDecoder()
+        {
+            for (size_t i = 0; i < tasks_.size(); ++i) {
+                if (tasks_[i].valid()) delete tasks_[i].get();
+            }
+        }
+
+        void FamilyDecoder::start(const std::function<void()>& task)
+        {
+            const ParseLimits limits = io_.parseLimits();
+            tasks_.push_back(std::async(std::launch::async, [task, limits]() {
+                std::unique_ptr<Outcome> outcome(new Outcome);
+                IoStats* previous = setCurrentStats(&outcome->stats_);
+                {
+                    LogMsg::Scope scope;
+                    try {
+                        std::unique_ptr<ParseBudget> budget;
+                        if (limits.limited()) budget.reset(new ParseBudget(limits));
+                        task();
+                    } catch (...) {
+                        outcome->exception_ = std::current_exception();
+                    }
+                    outcome->messages_ = scope.release();
+                }
+                setCurrentStats(previous);
+                return outcome.release();
+            }));
+        }
+
+        void FamilyDecoder::wait()
+        {
+            std::exception_ptr exception;
+            for (size_t i = 0; i < tasks_.size(); ++i) {
+                std::unique_ptr<Outcome> outcome(tasks_[i].get());
+                io_.stats() += outcome->stats_;
+                for (size_t j = 0; j < outcome->messages_.size(); ++j) {
+                    LogMsg(outcome->messages_[j].level_).os() << outcome->messages_[j].text_;
+                }
+                if (!exception) exception = outcome->exception_;
+            }
+            tasks_.clear();
+            if (exception) std::rethrow_exception(exception);
+        }
+
+        AsyncPool& AsyncPool::instance()
+        {
+            static AsyncPool pool;
+            return pool;
+        }
+
+        void AsyncPool::post(std::function<void()> job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                jobs_.push_back(std::move(job));
+            }
+            cv_.notify_one();
+        }
+
+        AsyncPool::AsyncPool() : stop_(false)
+        {
+            const unsigned int n = std::max(4u, std::thread::hardware_concurrency());
+            for (unsigned int i = 0; i < n; ++i) threads_.push_back(std::thread([this]() { run(); }));
+        }
+
+        AsyncPool::~AsyncPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            for (auto&& t : threads_) t.join();
+        }
+
+        void AsyncPool::run()
+        {
+            for (;;) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+                    if (jobs_.empty()) return;
+                    job = std::move(jobs_.front());
+                    jobs_.pop_front();
                 }
+                job();
+            }
+        }
+
+        namespace {
+            //! Nanoseconds since the epoch of \em seconds and \em nanoseconds
+            uint64_t nanoseconds(time_t seconds, long nanoseconds)
+            {
+                return static_cast<uint64_t>(seconds) * 1000000000 + static_cast<uint64_t>(nanoseconds);
             }
+        }
 
-            hexOutput << std::endl << std::endl << std::endl;
+        bool fileIdentity(const std::string& path, FileIdentity& identity)
+        {
+            struct stat buf;
+            if (::stat(path.c_str(), &buf) != 0) return false;
+            identity.size_ = static_cast<uint64_t>(buf.st_size);
+#if defined(__APPLE__)
+            identity.mtime_ = nanoseconds(buf.st_mtimespec.tv_sec, buf.st_mtimespec.tv_nsec);
+            identity.ctime_ = nanoseconds(buf.st_ctimespec.tv_sec, buf.st_ctimespec.tv_nsec);
+#elif defined(_WIN32)
+            // Windows stat() has no fractions of a second
+            identity.mtime_ = nanoseconds(buf.st_mtime, 0);
+            identity.ctime_ = nanoseconds(buf.st_ctime, 0);
+#else
+            identity.mtime_ = nanoseconds(buf.st_mtim.tv_sec, buf.st_mtim.tv_nsec);
+            identity.ctime_ = nanoseconds(buf.st_ctim.tv_sec, buf.st_ctim.tv_nsec);
+#endif
+            identity.inode_ = static_cast<uint64_t>(buf.st_ino);
+            return true;
+        }
 
-            return hexOutput.str();
+        void BlobWriter::put16(uint16_t v)
+        {
+            byte buf[2];
+            us2Data(buf, v, littleEndian);
+            blob_.insert(blob_.end(), buf, buf + 2);
+        }
+
+        void BlobWriter::put32(uint32_t v)
+        {
+            byte buf[4];
+            ul2Data(buf, v, littleEndian);
+            blob_.insert(blob_.end(), buf, buf + 4);
+        }
+
+        void BlobWriter::put64(uint64_t v)
+        {
+            put32(static_cast<uint32_t>(v));
+            put32(static_cast<uint32_t>(v >> 32));
+        }
+
+        void BlobWriter::putBytes(const byte* data, size_t size)
+        {
+            put32(static_cast<uint32_t>(size));
+            if (size > 0) blob_.insert(blob_.end(), data, data + size);
+        }
+
+        void BlobWriter::putString(const std::string& s)
+        {
+            putBytes(reinterpret_cast<const byte*>(s.data()), s.size());
+        }
+
+        void BlobWriter::putIdentity(const FileIdentity& identity)
+        {
+            put64(identity.size_);
+            put64(identity.mtime_);
+            put64(identity.ctime_);
+            put64(identity.inode_);
+        }
+
+        uint16_t BlobReader::get16()
+        {
+            return getUShort(take(2), littleEndian);
+        }
+
+        uint32_t BlobReader::get32()
+        {
+            return getULong(take(4), littleEndian);
+        }
+
+        uint64_t BlobReader::get64()
+        {
+            const uint64_t low = get32();
+            return low | (static_cast<uint64_t>(get32()) << 32);
+        }
+
+        const byte* BlobReader::getBytes(uint32_t& size)
+        {
+            size = get32();
+            return take(size);
+        }
+
+        std::string BlobReader::getString()
+        {
+            uint32_t size = 0;
+            const byte* data = getBytes(size);
+            return std::string(reinterpret_cast<const char*>(data), size);
+        }
+
+        FileIdentity BlobReader::getIdentity()
+        {
+            FileIdentity identity;
+            identity.size_ = get64();
+            identity.mtime_ = get64();
+            identity.ctime_ = get64();
+            identity.inode_ = get64();
+            return identity;
+        }
+
+        const byte* BlobReader::take(size_t n)
+        {
+            if (static_cast<size_t>(end_ - p_) < n) throw Error(kerCorruptedMetadata);
+            const byte* p = p_;
+            p_ += n;
+            return p;
         }
 
         std::string indent(int32_t d)
@@ -32,7 +32,16 @@
 #include "types.hpp"
 
 // + standard includes
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #if (defined(__GNUG__) || defined(__GNUC__)) || defined(__clang__)
 #define ATTRIBUTE_FORMAT_PRINTF __attribute__((format(printf, 1, 0)))
@@ -43,6 +52,8 @@
 // *****************************************************************************
 // namespace extensions
 namespace Exiv2 {
+    class BasicIo;
+
     namespace Internal {
 
 // *****************************************************************************
@@ -72,15 +83,19 @@ namespace Exiv2 {
     template <typename T>
     std::ostream& operator<<(std::ostream& stream, const binaryToStringHelper<T>& binToStr)
     {
-        for (size_t i = 0; i < binToStr.buf_.size(); ++i) {
-            int c = static_cast<int>(binToStr.buf_.at(i));
-            const bool bTrailingNull = c == 0 && i == binToStr.buf_.size() - 1;
-            if (!bTrailingNull) {
-                if (c < ' ' || c >= 127) {
-                    c = '.';
-                }
-                stream.put(static_cast<char>(c));
+        size_t size = binToStr.buf_.size();
+        if (size > 0 && static_cast<int>(binToStr.buf_.at(size - 1)) == 0) {
+            --size;  // trailing null
+        }
+        // Rendered in blocks, each written with a single call
+        char block[64];
+        for (size_t i = 0; i < size; i += sizeof(block)) {
+            const size_t count = size - i < sizeof(block) ? size - i : sizeof(block);
+            for (size_t j = 0; j < count; ++j) {
+                const int c = static_cast<int>(binToStr.buf_.at(i + j));
+                block[j] = c < ' ' || c >= 127 ? '.' : static_cast<char>(c);
             }
+            stream.write(block, static_cast<std::streamsize>(count));
         }
         return stream;
     }
@@ -132,6 +147,224 @@ namespace Exiv2 {
      */
     std::string binaryToHex(const byte *data, size_t size);
 
+    /*!
+      @brief Encode \em size bytes of \em data as lowercase hex digits.
+
+      Writes exactly 2 * \em size characters to \em out, which is not
+      null-terminated.
+     */
+    void hexEncode(const byte* data, size_t size, char* out);
+
+    /*!
+      @brief Decode \em size bytes from the lowercase hex digits in the range
+             [\em first, \em last). Characters other than lowercase hex digits
+             are skipped, so a byte may be split by white space.
+
+      @return Pointer to the character after the last digit decoded, or 0 if
+              the text ends or a null character occurs before \em size bytes
+              have been decoded.
+     */
+    const char* hexDecode(const char* first, const char* last, byte* out, size_t size);
+
+    /*!
+      @brief Return a pointer to the first byte \em c in [\em first, \em last),
+             \em last if there is none. A typed memchr(), which C libraries
+             implement with vector instructions.
+     */
+    inline const byte* findByte(const byte* first, const byte* last, byte c)
+    {
+        if (first >= last) return last;
+        const void* p = std::memchr(first, c, last - first);
+        return p ? static_cast<const byte*>(p) : last;
+    }
+
+    /*!
+      @brief Advance \em io to the next byte \em c at or after its current
+             position. The data is read and searched in blocks.
+
+      @return true if \em io is positioned at a byte \em c; false, with \em io
+              at the end of the data, if there is none or reading fails.
+     */
+    bool skipToByte(BasicIo& io, byte c);
+
+    /*!
+      @brief Incremental 64-bit FNV-1a hash of the image data, see
+             Image::payloadHash(). It is not a cryptographic hash.
+     */
+    class PayloadHash {
+    public:
+        //! Default constructor, the hash of no data
+        PayloadHash() : hash_(14695981039346656037ULL) {}
+        //! Add \em size bytes at \em data to the hash
+        void update(const byte* data, size_t size)
+        {
+            uint64_t hash = hash_;
+            for (size_t i = 0; i < size; ++i) {
+                hash ^= data[i];
+                hash *= 1099511628211ULL;
+            }
+            hash_ = hash;
+        }
+        //! Return the hash of the data so far
+        uint64_t value() const { return hash_; }
+
+    private:
+        uint64_t hash_;
+    };
+
+    /*!
+      @brief Copy \em count bytes from the current position of \em src to
+             \em dest, in blocks of at most 64 KiB, and add them to \em hash
+             unless it is 0.
+
+      @throw Error if the data cannot be read or written
+     */
+    void copyData(BasicIo& src, BasicIo& dest, long count, PayloadHash* hash =0);
+
+    /*!
+      @brief Add \em count bytes from the current position of \em src to
+             \em hash, in blocks of at most 64 KiB.
+
+      @throw Error if the data cannot be read
+     */
+    void hashData(BasicIo& src, long count, PayloadHash& hash);
+
+    /*!
+      @brief Decodes metadata families of an image in threads of their own,
+             see Image::parallelDecode().
+
+      Each task runs with the parse limits of the BasicIo, in a budget of
+      its own. Its stats are added to those of the BasicIo and its log
+      messages are logged by the calling thread when wait() returns. A task
+      must only change the container of its family, and the data it decodes
+      must not change until wait() returns.
+     */
+    class FamilyDecoder {
+    public:
+        //! Constructor, for the tasks of an image with the BasicIo \em io
+        explicit FamilyDecoder(BasicIo& io);
+        //! Destructor, waits for the tasks which are still running
+        ~FamilyDecoder();
+
+        //! Start \em task in a thread of its own
+        void start(const std::function<void()>& task);
+        /*!
+          @brief Wait for the tasks, add their stats and log their messages.
+          @throw The first exception of a task, in the order they were started
+         */
+        void wait();
+
+    private:
+        // NOT IMPLEMENTED
+        FamilyDecoder(const FamilyDecoder&);
+        FamilyDecoder& operator=(const FamilyDecoder&);
+
+        //! What a task leaves to the calling thread
+        struct Outcome;
+
+        // DATA
+        BasicIo& io_;
+        std::vector<std::future<Outcome*> > tasks_;
+    }; // class FamilyDecoder
+
+    /*!
+      @brief Threads which run the asynchronous opens and reads of images and
+             help with the parallel decode of TIFF IFDs. There are at least 4
+             of them, they are started on first use. A job which waits for
+             other jobs must be able to do their work itself, as all threads
+             of the pool may be busy.
+     */
+    class AsyncPool {
+    public:
+        //! Return the pool of the process
+        static AsyncPool& instance();
+        //! Run \em job in a thread of the pool
+        void post(std::function<void()> job);
+
+    private:
+        //! Constructor, starts the threads
+        AsyncPool();
+        //! Destructor, runs the queued jobs and joins the threads
+        ~AsyncPool();
+        // NOT IMPLEMENTED
+        AsyncPool(const AsyncPool&);
+        AsyncPool& operator=(const AsyncPool&);
+
+        //! Run the jobs of the queue until the pool is destroyed
+        void run();
+
+        // DATA
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<std::function<void()> > jobs_;
+        bool stop_;                             //!< Set when the pool is destroyed, the queued jobs are still run
+        std::vector<std::thread> threads_;
+    }; // class AsyncPool
+
+    /*!
+      @brief Identity of a file, it changes when the file is modified or replaced.
+             The times are in nanoseconds where the platform provides them, so
+             that two writes within the same second are told apart. The change
+             time also catches writes which restore the modification time.
+     */
+    struct FileIdentity {
+        uint64_t size_;                         //!< File size
+        uint64_t mtime_;                        //!< Modification time
+        uint64_t ctime_;                        //!< Status change time
+        uint64_t inode_;                        //!< Inode number
+        bool operator==(const FileIdentity& rhs) const
+        {
+            return    size_ == rhs.size_ && mtime_ == rhs.mtime_ && ctime_ == rhs.ctime_
+                   && inode_ == rhs.inode_;
+        }
+    };
+
+    //! Set \em identity to the identity of the file \em path, return false if it cannot be determined
+    bool fileIdentity(const std::string& path, FileIdentity& identity);
+
+    //! Appends little endian values to a blob
+    class BlobWriter {
+    public:
+        explicit BlobWriter(Blob& blob) : blob_(blob) {}
+        void put8(byte b) { blob_.push_back(b); }
+        void put16(uint16_t v);
+        void put32(uint32_t v);
+        void put64(uint64_t v);
+        //! Append the size of the bytes and the bytes
+        void putBytes(const byte* data, size_t size);
+        //! Append the size of the string and its characters
+        void putString(const std::string& s);
+        //! Append the fields of \em identity
+        void putIdentity(const FileIdentity& identity);
+    private:
+        Blob& blob_;
+    };
+
+    //! Reads little endian values, throws if the data is too short
+    class BlobReader {
+    public:
+        BlobReader(const byte* data, size_t size) : p_(data), end_(data + size) {}
+        bool atEnd() const { return p_ == end_; }
+        //! Return the position of the next value
+        const byte* pos() const { return p_; }
+        //! Return the number of bytes which are left
+        size_t left() const { return static_cast<size_t>(end_ - p_); }
+        byte get8() { return *take(1); }
+        uint16_t get16();
+        uint32_t get32();
+        uint64_t get64();
+        //! Read bytes written with BlobWriter::putBytes()
+        const byte* getBytes(uint32_t& size);
+        //! Read a string written with BlobWriter::putString()
+        std::string getString();
+        //! Read a file identity written with BlobWriter::putIdentity()
+        FileIdentity getIdentity();
+    private:
+        const byte* take(size_t n);
+        const byte* p_;
+        const byte* end_;
+    };
+
     /*!
       @brief indent output for kpsRecursive in \em printStructure() \em .
      */
@@ -31,6 +31,7 @@
 #include "datasets.hpp"
 #include "jpgimage.hpp"
 #include "image_int.hpp"
+#include "metadatum_int.hpp"
 
 // + standard includes
 #include <iostream>
@@ -79,6 +80,12 @@ namespace {
         uint16_t record_;
 
     }; // class FindIptcdatum
+
+    //! Helper function to combine the record and dataset number of an id into an index id.
+    uint32_t indexId(uint16_t dataset, uint16_t record)
+    {
+        return static_cast<uint32_t>(record) << 16 | dataset;
+    }
 }
 
 // *****************************************************************************
@@ -99,6 +106,16 @@ namespace Exiv2 {
         if (rhs.value_.get() != 0) value_ = rhs.value_->clone(); // deep copy
     }
 
+    Iptcdatum::Iptcdatum(const IptcKey& key, Value::UniquePtr value)
+        : key_(key.clone()), value_(std::move(value))
+    {
+    }
+
+    Iptcdatum::Iptcdatum(Iptcdatum&& rhs) noexcept
+        : Metadatum(rhs), key_(std::move(rhs.key_)), value_(std::move(rhs.value_))
+    {
+    }
+
     Iptcdatum::~Iptcdatum()
     {
     }
@@ -228,6 +245,13 @@ namespace Exiv2 {
         return *this;
     } // Iptcdatum::operator=
 
+    Iptcdatum& Iptcdatum::operator=(Iptcdatum&& rhs) noexcept
+    {
+        key_ = std::move(rhs.key_);
+        value_ = std::move(rhs.value_);
+        return *this;
+    }
+
     Iptcdatum& Iptcdatum::operator=(const uint16_t& value)
     {
         UShortValue::UniquePtr v(new UShortValue);
@@ -265,15 +289,29 @@ namespace Exiv2 {
 
     Iptcdatum& IptcData::operator[](const std::string& key)
     {
-        IptcKey iptcKey(key);
-        iterator pos = findKey(iptcKey);
-        if (pos == end()) {
-            add(Iptcdatum(iptcKey));
-            pos = findKey(iptcKey);
+        return operator[](IptcKeyHandle(key));
+    }
+
+    Iptcdatum& IptcData::operator[](const IptcKeyHandle& key)
+    {
+        iterator pos = findKey(key.key());
+        if (pos == iptcMetadata_.end()) {
+            add(Iptcdatum(key.key()));
+            pos = findKey(key.key());
         }
         return *pos;
     }
 
+    MemoryUsage IptcData::memoryUsage() const
+    {
+        MemoryUsage usage;
+        usage.datums_ += iptcMetadata_.capacity() * sizeof(Iptcdatum) + Internal::hashMapMemory(index_.map());
+        for (const_iterator i = iptcMetadata_.begin(); i != iptcMetadata_.end(); ++i) {
+            Internal::addDatumMemory(usage, *i, sizeof(IptcKey));
+        }
+        return usage;
+    }
+
     long IptcData::size() const
     {
         long newSize = 0;
@@ -297,62 +335,103 @@ namespace Exiv2 {
         return add(Iptcdatum(key, value));
     }
 
+    int IptcData::add(const IptcKey& key, Value::UniquePtr value)
+    {
+        return add(Iptcdatum(key, std::move(value)));
+    }
+
     int IptcData::add(const Iptcdatum& iptcDatum)
+    {
+        return add(Iptcdatum(iptcDatum));
+    }
+
+    int IptcData::add(Iptcdatum&& iptcDatum)
     {
         if (!IptcDataSets::dataSetRepeatable(
                iptcDatum.tag(), iptcDatum.record()) &&
-               findId(iptcDatum.tag(), iptcDatum.record()) != end()) {
+               findId(iptcDatum.tag(), iptcDatum.record()) != iptcMetadata_.end()) {
              return 6;
         }
         // allow duplicates
-        iptcMetadata_.push_back(iptcDatum);
+        iptcMetadata_.push_back(std::move(iptcDatum));
+        index_.add(indexId(iptcMetadata_.back().tag(), iptcMetadata_.back().record()), iptcMetadata_.size() - 1);
         return 0;
     }
 
     IptcData::const_iterator IptcData::findKey(const IptcKey& key) const
     {
-        return std::find_if(iptcMetadata_.begin(), iptcMetadata_.end(),
-                            FindIptcdatum(key.tag(), key.record()));
+        return findId(key.tag(), key.record());
     }
 
     IptcData::iterator IptcData::findKey(const IptcKey& key)
     {
-        return std::find_if(iptcMetadata_.begin(), iptcMetadata_.end(),
-                            FindIptcdatum(key.tag(), key.record()));
+        return findId(key.tag(), key.record());
     }
 
     IptcData::const_iterator IptcData::findId(uint16_t dataset, uint16_t record) const
     {
+        if (index_.valid()) {
+            const Index::Entry* entry = index_.find(indexId(dataset, record));
+            if (entry == 0) return iptcMetadata_.end();
+            const_iterator pos = iptcMetadata_.begin() + entry->pos_;
+            if (pos->tag() == dataset && pos->record() == record) return pos;
+        }
+        // No usable index, fall back to a linear search
         return std::find_if(iptcMetadata_.begin(), iptcMetadata_.end(),
                             FindIptcdatum(dataset, record));
     }
 
     IptcData::iterator IptcData::findId(uint16_t dataset, uint16_t record)
     {
-        return std::find_if(iptcMetadata_.begin(), iptcMetadata_.end(),
-                            FindIptcdatum(dataset, record));
+        if (!index_.valid()) indexRebuild();
+        const uint32_t id = indexId(dataset, record);
+        const Index::Entry* entry = index_.find(id);
+        if (entry == 0) return iptcMetadata_.end();
+        if (   iptcMetadata_[entry->pos_].tag() != dataset
+            || iptcMetadata_[entry->pos_].record() != record) {
+            // The id of the indexed Iptcdatum was changed, rebuild the index
+            indexRebuild();
+            entry = index_.find(id);
+            if (entry == 0) return iptcMetadata_.end();
+        }
+        return iptcMetadata_.begin() + entry->pos_;
     }
 
     void IptcData::sortByKey()
     {
-        std::sort(iptcMetadata_.begin(), iptcMetadata_.end(), cmpMetadataByKey);
+        Internal::sortMetadata(iptcMetadata_, [](const Iptcdatum& md) { return md.key(); });
+        index_.invalidate();
     }
 
     void IptcData::sortByTag()
     {
-        std::sort(iptcMetadata_.begin(), iptcMetadata_.end(), cmpMetadataByTag);
+        Internal::sortMetadata(iptcMetadata_, [](const Iptcdatum& md) { return md.tag(); });
+        index_.invalidate();
     }
 
     IptcData::iterator IptcData::erase(IptcData::iterator pos)
     {
+        // The metadata after pos move, updating their positions would take quadratic time for many erasures
+        if (pos + 1 != iptcMetadata_.end()) index_.invalidate();
+        else index_.erase(indexId(pos->tag(), pos->record()), pos - iptcMetadata_.begin(),
+                          [](IptcMetadata::size_type&) { return false; });
         return iptcMetadata_.erase(pos);
     }
 
+    void IptcData::indexRebuild()
+    {
+        index_.rebuild(0, iptcMetadata_.size(), [this](IptcMetadata::size_type pos) {
+            return indexId(iptcMetadata_[pos].tag(), iptcMetadata_[pos].record());
+        });
+    }
+
     void IptcData::printStructure(std::ostream& out, const Slice<byte*>& bytes, uint32_t depth)
     {
         uint32_t i = 0;
-        while (i < bytes.size() - 3 && bytes.at(i) != 0x1c)
-            i++;
+        if (bytes.size() > 3) {
+            const byte* first = &bytes.at(0);
+            i = static_cast<uint32_t>(Internal::findByte(first, first + bytes.size() - 3, 0x1c) - first);
+        }
         depth++;
         out << Internal::indent(depth) << "Record | DataSet | Name                     | Length | Data" << std::endl;
         while (i < bytes.size() - 3) {
@@ -450,7 +529,11 @@ namespace Exiv2 {
             // First byte should be a marker. If it isn't, scan forward and skip
             // the chunk bytes present in some images. This deviates from the
             // standard, which advises to treat such cases as errors.
-            if (*pRead++ != marker_) continue;
+            if (*pRead != marker_) {
+                pRead = Internal::findByte(pRead, pData + size - 3, marker_);
+                continue;
+            }
+            ++pRead;
             record = *pRead++;
             dataSet = *pRead++;
 
@@ -498,9 +581,9 @@ namespace Exiv2 {
 
       This is a helper function for IptcParser::encode().
      */
-    bool cmpIptcdataByRecord(const Iptcdatum& lhs, const Iptcdatum& rhs)
+    bool cmpIptcdataByRecord(const Iptcdatum* lhs, const Iptcdatum* rhs)
     {
-        return lhs.record() < rhs.record();
+        return lhs->record() < rhs->record();
     }
 
     DataBuf IptcParser::encode(const IptcData& iptcData)
@@ -508,14 +591,23 @@ namespace Exiv2 {
         DataBuf buf(iptcData.size());
         byte *pWrite = buf.pData_;
 
-        // Copy the iptc data sets and sort them by record but preserve the order of datasets
-        IptcMetadata sortedIptcData;
-        std::copy(iptcData.begin(), iptcData.end(), std::back_inserter(sortedIptcData));
-        std::stable_sort(sortedIptcData.begin(), sortedIptcData.end(), cmpIptcdataByRecord);
+        // Sort the iptc data sets by record but preserve the order of datasets.
+        // Only pointers are sorted, and only if the records are out of order.
+        std::vector<const Iptcdatum*> sortedIptcData;
+        sortedIptcData.reserve(iptcData.count());
+        bool sorted = true;
+        for (IptcData::const_iterator i = iptcData.begin(); i != iptcData.end(); ++i) {
+            if (!sortedIptcData.empty() && i->record() < sortedIptcData.back()->record()) sorted = false;
+            sortedIptcData.push_back(&*i);
+        }
+        if (!sorted) {
+            std::stable_sort(sortedIptcData.begin(), sortedIptcData.end(), cmpIptcdataByRecord);
+        }
 
-        IptcData::const_iterator iter = sortedIptcData.begin();
-        IptcData::const_iterator end = sortedIptcData.end();
-        for ( ; iter != end; ++iter) {
+        std::vector<const Iptcdatum*>::const_iterator it = sortedIptcData.begin();
+        std::vector<const Iptcdatum*>::const_iterator end = sortedIptcData.end();
+        for ( ; it != end; ++it) {
+            const Iptcdatum* iter = *it;
             // marker, record Id, dataset num
             *pWrite++ = marker_;
             *pWrite++ = static_cast<byte>(iter->record());
@@ -555,13 +647,16 @@ namespace {
               uint32_t         sizeData
     )
     {
+        const Exiv2::DecodeFilter& filter = iptcData.decodeFilter();
+        if (!filter.empty() && !filter.accepts(Exiv2::IptcKey(dataSet, record))) return 0;
+
         Exiv2::Value::UniquePtr value;
         Exiv2::TypeId type = Exiv2::IptcDataSets::dataSetType(dataSet, record);
         value = Exiv2::Value::create(type);
         int rc = value->read(data, sizeData, Exiv2::bigEndian);
         if (0 == rc) {
             Exiv2::IptcKey key(dataSet, record);
-            iptcData.add(key, value.get());
+            iptcData.add(key, std::move(value));
         }
         else if (1 == rc) {
             // If the first attempt failed, try with a string value
@@ -569,7 +664,7 @@ namespace {
             rc = value->read(data, sizeData, Exiv2::bigEndian);
             if (0 == rc) {
                 Exiv2::IptcKey key(dataSet, record);
-                iptcData.add(key, value.get());
+                iptcData.add(key, std::move(value));
             }
         }
         return rc;
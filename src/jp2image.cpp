@@ -31,11 +31,14 @@
 #include "tiffimage.hpp"
 #include "image.hpp"
 #include "image_int.hpp"
+#include "tiffimage_int.hpp"
 #include "basicio.hpp"
 #include "error.hpp"
 #include "futils.hpp"
 #include "types.hpp"
 #include "safe_op.hpp"
+#include "stats_int.hpp"
+#include "subio_int.hpp"
 
 // + standard includes
 #include <string>
@@ -43,6 +46,7 @@
 #include <iostream>
 #include <cassert>
 #include <cstdio>
+#include <vector>
 
 // JPEG-2000 box types
 const uint32_t kJp2BoxTypeJp2Header   = 0x6a703268; // 'jp2h'
@@ -50,6 +54,7 @@ const uint32_t kJp2BoxTypeImageHeader = 0x69686472; // 'ihdr'
 const uint32_t kJp2BoxTypeColorHeader = 0x636f6c72; // 'colr'
 const uint32_t kJp2BoxTypeUuid        = 0x75756964; // 'uuid'
 const uint32_t kJp2BoxTypeClose       = 0x6a703263; // 'jp2c'
+const uint32_t kJp2BoxTypeXml         = 0x786d6c20; // 'xml '
 
 // from openjpeg-2.1.2/src/lib/openjp2/jp2.h
 /*#define JPIP_JPIP 0x6a706970*/
@@ -128,6 +133,16 @@ struct Jp2UuidBox
 {
     uint8_t  uuid[16];
 };
+
+//! Position of a top-level box in the file
+struct Jp2BoxInfo
+{
+    uint32_t           type;
+    long               offset;      //!< Offset of the box header
+    long               dataOffset;  //!< Offset of the box contents
+    uint64_t           length;      //!< Length of the box including the header
+    Exiv2::MetadataId  metadataId;  //!< Metadata in a UUID box, mdNone for all other boxes
+};
 //! @endcond
 
 // *****************************************************************************
@@ -186,6 +201,85 @@ namespace Exiv2
         return e.c[0]?true:false;
     }
 
+    /*!
+      @brief Read the headers of the top-level boxes from the current position
+             of \em io to the end of the file. Of the contents, only the UUIDs
+             of UUID boxes are read.
+     */
+    static std::vector<Jp2BoxInfo> readJp2Boxes(BasicIo& io)
+    {
+        std::vector<Jp2BoxInfo> boxes;
+        const long size   = static_cast<long>(io.size());
+        long       offset = io.tell();
+        byte       header[16];
+
+        while (offset >= 0 && offset + 8 <= size)
+        {
+            io.seek(offset, BasicIo::beg);
+            if (io.read(header, 8) != 8) throw Error(kerFailedToReadImageData);
+
+            Jp2BoxInfo box;
+            box.type       = getULong(header + 4, bigEndian);
+            box.offset     = offset;
+            box.dataOffset = offset + 8;
+            box.length     = getULong(header, bigEndian);
+            box.metadataId = mdNone;
+            if (box.length == 1)
+            {
+                // The real box length follows the box type as a 64-bit integer
+                if (io.read(header + 8, 8) != 8) throw Error(kerCorruptedMetadata);
+                box.length     = static_cast<uint64_t>(getULong(header + 8, bigEndian)) << 32 | getULong(header + 12, bigEndian);
+                box.dataOffset = offset + 16;
+            }
+            else if (box.length == 0)
+            {
+                // The last box extends to the end of the file
+                box.length = size - offset;
+            }
+            if (box.length < static_cast<uint64_t>(box.dataOffset - offset)) throw Error(kerCorruptedMetadata);
+
+            Jp2UuidBox uuid;
+            if (   box.type == kJp2BoxTypeUuid
+                && box.length >= box.dataOffset - offset + sizeof(uuid)
+                && io.read(uuid.uuid, sizeof(uuid)) == sizeof(uuid))
+            {
+                if      (memcmp(uuid.uuid, kJp2UuidExif, sizeof(uuid)) == 0) box.metadataId = mdExif;
+                else if (memcmp(uuid.uuid, kJp2UuidIptc, sizeof(uuid)) == 0) box.metadataId = mdIptc;
+                else if (memcmp(uuid.uuid, kJp2UuidXmp,  sizeof(uuid)) == 0) box.metadataId = mdXmp;
+            }
+            boxes.push_back(box);
+
+            if (box.length > static_cast<uint64_t>(size - offset)) break;
+            offset += static_cast<long>(box.length);
+        }
+        return boxes;
+    }
+
+    /*!
+      @brief Return a pointer to the contents of \em box, without the first
+             \em skip bytes, and set \em size to their size. The data is only
+             copied to \em buf if \em io cannot provide a view of it.
+     */
+    static const byte* readJp2BoxData(BasicIo& io, const Jp2BoxInfo& box, long skip, DataBuf& buf, long& size)
+    {
+        const long offset = box.dataOffset + skip;
+        if (box.length > static_cast<uint64_t>(io.size() - box.offset)) throw Error(kerInputDataReadFailed);
+        size = static_cast<long>(box.offset + box.length) - offset;
+        io.seek(offset, BasicIo::beg);
+        const byte* data = io.readView(buf, size);
+        if (io.error()) throw Error(kerFailedToReadImageData);
+        if (data == 0) throw Error(kerInputDataReadFailed);
+        return data;
+    }
+
+    //! Copy \em count bytes at \em offset in \em src to \em dest
+    static void copyJp2Range(BasicIo& src, BasicIo& dest, long offset, long count)
+    {
+        if (count <= 0) return;
+        if (src.seek(offset, BasicIo::beg) != 0) throw Error(kerFailedToReadImageData);
+        Internal::copyData(src, dest, count);
+    }
+
     static std::string toAscii(long n)
     {
         const char* p = (const char*) &n;
@@ -214,41 +308,37 @@ namespace Exiv2
             throw Error(kerNotAnImage, "JPEG-2000");
         }
 
-        Jp2BoxHeader      box       = {0,0};
         Jp2BoxHeader      subBox    = {0,0};
         Jp2ImageHeaderBox ihdr      = {0,0,0,0,0,0,0,0};
-        Jp2UuidBox        uuid      = {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}};
+        bool              bXmpFound = false;
+
+        // Only the headers of the boxes are read here, the payloads are read when they are decoded
+        const std::vector<Jp2BoxInfo> boxes = readJp2Boxes(*io_);
+        std::vector<Jp2BoxInfo>::const_iterator xmlBox = boxes.end();
 
-        while (io_->read((byte*)&box, sizeof(box)) == sizeof(box))
+        for (std::vector<Jp2BoxInfo>::const_iterator box = boxes.begin(); box != boxes.end(); ++box)
         {
-            long position = io_->tell();
-            box.length = getLong((byte*)&box.length, bigEndian);
-            box.type   = getLong((byte*)&box.type, bigEndian);
 #ifdef DEBUG
             std::cout << "Exiv2::Jp2Image::readMetadata: "
-                      << "Position: " << position
-                      << " box type: " << toAscii(box.type)
-                      << " length: " << box.length
+                      << "Position: " << box->dataOffset
+                      << " box type: " << toAscii(box->type)
+                      << " length: " << box->length
                       << std::endl;
 #endif
 
-            if (box.length == 0) return ;
-
-            if (box.length == 1)
-            {
-                // FIXME. Special case. the real box size is given in another place.
-            }
-
-            switch(box.type)
+            switch(box->type)
             {
                 case kJp2BoxTypeJp2Header:
                 {
 #ifdef DEBUG
                     std::cout << "Exiv2::Jp2Image::readMetadata: JP2Header box found" << std::endl;
 #endif
+                    const long boxEnd = static_cast<long>(box->offset + box->length);
+                    io_->seek(box->dataOffset, BasicIo::beg);
                     long restore = io_->tell();
 
-                    while (io_->read((byte*)&subBox, sizeof(subBox)) == sizeof(subBox) && subBox.length )
+                    while (   restore + static_cast<long>(sizeof(subBox)) <= boxEnd
+                           && io_->read((byte*)&subBox, sizeof(subBox)) == sizeof(subBox) && subBox.length )
                     {
                         subBox.length = getLong((byte*)&subBox.length, bigEndian);
                         subBox.type   = getLong((byte*)&subBox.type, bigEndian);
@@ -318,133 +408,140 @@ namespace Exiv2
 #ifdef DEBUG
                     std::cout << "Exiv2::Jp2Image::readMetadata: UUID box found" << std::endl;
 #endif
+                    if (box->metadataId == mdNone) break;
 
-                    if (io_->read((byte*)&uuid, sizeof(uuid)) == sizeof(uuid))
-                    {
-                        DataBuf rawData;
-                        long    bufRead;
-                        bool    bIsExif = memcmp(uuid.uuid, kJp2UuidExif, sizeof(uuid))==0;
-                        bool    bIsIPTC = memcmp(uuid.uuid, kJp2UuidIptc, sizeof(uuid))==0;
-                        bool    bIsXMP  = memcmp(uuid.uuid, kJp2UuidXmp , sizeof(uuid))==0;
+                    DataBuf buf;
+                    long    size = 0;
+                    const byte* data = readJp2BoxData(*io_, *box, sizeof(Jp2UuidBox), buf, size);
 
-                        if(bIsExif)
-                        {
+                    if(box->metadataId == mdExif)
+                    {
 #ifdef DEBUG
-                           std::cout << "Exiv2::Jp2Image::readMetadata: Exif data found" << std::endl ;
+                       std::cout << "Exiv2::Jp2Image::readMetadata: Exif data found" << std::endl ;
 #endif
-                            rawData.alloc(box.length - (sizeof(box) + sizeof(uuid)));
-                            bufRead = io_->read(rawData.pData_, rawData.size_);
-                            if (io_->error()) throw Error(kerFailedToReadImageData);
-                            if (bufRead != rawData.size_) throw Error(kerInputDataReadFailed);
-
-                            if (rawData.size_ > 0)
+                        if (size > 0)
+                        {
+                            // Find the position of Exif header in bytes array.
+                            long pos = (     (data[0]      == data[1])
+                                       &&    (data[0]=='I' || data[0]=='M')
+                                       )  ? 0 : -1;
+
+                            // #1242  Forgive having Exif\0\0 in the box data
+                            const byte exifHeader[] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
+                            for (long i=0 ; pos < 0 && i < size-(long)sizeof(exifHeader) ; i++)
                             {
-                                // Find the position of Exif header in bytes array.
-                                long pos = (     (rawData.pData_[0]      == rawData.pData_[1])
-                                           &&    (rawData.pData_[0]=='I' || rawData.pData_[0]=='M')
-                                           )  ? 0 : -1;
-
-                                // #1242  Forgive having Exif\0\0 in rawData.pData_
-                                const byte exifHeader[] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
-                                for (long i=0 ; pos < 0 && i < rawData.size_-(long)sizeof(exifHeader) ; i++)
+                                if (memcmp(exifHeader, &data[i], sizeof(exifHeader)) == 0)
                                 {
-                                    if (memcmp(exifHeader, &rawData.pData_[i], sizeof(exifHeader)) == 0)
-                                    {
-                                        pos = i+sizeof(exifHeader);
+                                    pos = i+sizeof(exifHeader);
 #ifndef SUPPRESS_WARNINGS
-                                        EXV_WARNING << "Reading non-standard UUID-EXIF_bad box in " << io_->path() << std::endl;
+                                    EXV_WARNING << "Reading non-standard UUID-EXIF_bad box in " << io_->path() << std::endl;
 #endif
 
-                                    }
-                                }
-
-                                // If found it, store only these data at from this place.
-                                if (pos >= 0 )
-                                {
-#ifdef DEBUG
-                                    std::cout << "Exiv2::Jp2Image::readMetadata: Exif header found at position " << pos << std::endl;
-#endif
-                                    ByteOrder bo = TiffParser::decode(exifData(),
-                                                                      iptcData(),
-                                                                      xmpData(),
-                                                                      rawData.pData_ + pos,
-                                                                      rawData.size_ - pos);
-                                    setByteOrder(bo);
                                 }
                             }
-                            else
+
+                            // If found it, store only these data at from this place.
+                            if (pos >= 0 )
                             {
-#ifndef SUPPRESS_WARNINGS
-                                EXV_WARNING << "Failed to decode Exif metadata." << std::endl;
-#endif
-                                exifData_.clear();
+#ifdef DEBUG
+                                std::cout << "Exiv2::Jp2Image::readMetadata: Exif header found at position " << pos << std::endl;
+#endif
+                                ByteOrder bo = TiffParser::decode(exifData(),
+                                                                  iptcData(),
+                                                                  xmpData(),
+                                                                  data + pos,
+                                                                  size - pos);
+                                setByteOrder(bo);
                             }
                         }
-
-                        if(bIsIPTC)
+                        else
                         {
-#ifdef DEBUG
-                           std::cout << "Exiv2::Jp2Image::readMetadata: Iptc data found" << std::endl;
-#endif
-                            rawData.alloc(box.length - (sizeof(box) + sizeof(uuid)));
-                            bufRead = io_->read(rawData.pData_, rawData.size_);
-                            if (io_->error()) throw Error(kerFailedToReadImageData);
-                            if (bufRead != rawData.size_) throw Error(kerInputDataReadFailed);
-
-                            if (IptcParser::decode(iptcData_, rawData.pData_, rawData.size_))
-                            {
 #ifndef SUPPRESS_WARNINGS
-                                EXV_WARNING << "Failed to decode IPTC metadata." << std::endl;
+                            EXV_WARNING << "Failed to decode Exif metadata." << std::endl;
 #endif
-                                iptcData_.clear();
-                            }
+                            exifData_.clear();
                         }
+                    }
 
-                        if(bIsXMP)
-                        {
+                    if(box->metadataId == mdIptc)
+                    {
 #ifdef DEBUG
-                           std::cout << "Exiv2::Jp2Image::readMetadata: Xmp data found" << std::endl;
+                       std::cout << "Exiv2::Jp2Image::readMetadata: Iptc data found" << std::endl;
 #endif
-                            rawData.alloc(box.length - (uint32_t)(sizeof(box) + sizeof(uuid)));
-                            bufRead = io_->read(rawData.pData_, rawData.size_);
-                            if (io_->error()) throw Error(kerFailedToReadImageData);
-                            if (bufRead != rawData.size_) throw Error(kerInputDataReadFailed);
-                            xmpPacket_.assign(reinterpret_cast<char *>(rawData.pData_), rawData.size_);
-
-                            std::string::size_type idx = xmpPacket_.find_first_of('<');
-                            if (idx != std::string::npos && idx > 0)
-                            {
+                        if (IptcParser::decode(iptcData(), data, size))
+                        {
 #ifndef SUPPRESS_WARNINGS
-                                EXV_WARNING << "Removing " << static_cast<uint32_t>(idx)
-                                            << " characters from the beginning of the XMP packet" << std::endl;
+                            EXV_WARNING << "Failed to decode IPTC metadata." << std::endl;
 #endif
-                                xmpPacket_ = xmpPacket_.substr(idx);
-                            }
+                            iptcData().clear();
+                        }
+                    }
 
-                            if (xmpPacket_.size() > 0 && XmpParser::decode(xmpData_, xmpPacket_))
-                            {
-#ifndef SUPPRESS_WARNINGS
-                                EXV_WARNING << "Failed to decode XMP metadata." << std::endl;
+                    if(box->metadataId == mdXmp)
+                    {
+#ifdef DEBUG
+                       std::cout << "Exiv2::Jp2Image::readMetadata: Xmp data found" << std::endl;
 #endif
-                            }
-                        }
+                        decodeXmpPacket(data, size);
+                        bXmpFound = true;
                     }
                     break;
                 }
 
+                case kJp2BoxTypeXml:
+                {
+                    // Only needed if there is no XMP UUID box, see below
+                    if (xmlBox == boxes.end()) xmlBox = box;
+                    break;
+                }
+
                 default:
                 {
                     break;
                 }
             }
-
-            // Move to the next box.
-            io_->seek(static_cast<long>(position - sizeof(box) + box.length), BasicIo::beg);
-            if (io_->error()) throw Error(kerFailedToReadImageData);
         }
 
+        // Some writers store the XMP packet in an XML box instead of the XMP UUID box
+        if (!bXmpFound && xmlBox != boxes.end())
+        {
+            DataBuf buf;
+            long    size = 0;
+            const byte* data = readJp2BoxData(*io_, *xmlBox, 0, buf, size);
+            const std::string xml(reinterpret_cast<const char*>(data), size);
+            if (xml.find("<x:xmpmeta") != std::string::npos || xml.find("<?xpacket") != std::string::npos)
+            {
+#ifdef DEBUG
+                std::cout << "Exiv2::Jp2Image::readMetadata: Xmp data found in XML box" << std::endl;
+#endif
+                decodeXmpPacket(data, size);
+            }
+        }
+        releasePackets();
     } // Jp2Image::readMetadata
 
+    void Jp2Image::decodeXmpPacket(const byte* data, long size)
+    {
+        xmpPacket_.assign(reinterpret_cast<const char *>(data), size);
+
+        std::string::size_type idx = xmpPacket_.find_first_of('<');
+        if (idx != std::string::npos && idx > 0)
+        {
+#ifndef SUPPRESS_WARNINGS
+            EXV_WARNING << "Removing " << static_cast<uint32_t>(idx)
+                        << " characters from the beginning of the XMP packet" << std::endl;
+#endif
+            xmpPacket_ = xmpPacket_.substr(idx);
+        }
+
+        if (xmpPacket_.size() > 0 && XmpParser::decode(xmpData(), xmpPacket_))
+        {
+#ifndef SUPPRESS_WARNINGS
+            EXV_WARNING << "Failed to decode XMP metadata." << std::endl;
+#endif
+        }
+    } // Jp2Image::decodeXmpPacket
+
     void Jp2Image::printStructure(std::ostream& out, PrintStructureOption option,int depth)
     {
         if (io_->open() != 0) throw Error(kerDataSourceOpenFailed, io_->path(), strError());
@@ -549,8 +646,14 @@ namespace Exiv2
                                 if ( bUnknown) out << "????: " ;
                             }
 
+                            const long dataOffset = io_->tell();
+                            const long dataSize   = box.length-sizeof(uuid)-sizeof(box);
+                            if (bIsExif && (dataSize < 0 || dataSize > static_cast<long>(io_->size()) - dataOffset)) {
+                                throw Error(kerInputDataReadFailed);
+                            }
+                            // The Exif structure is printed from a view of the box, only its start is read here
                             DataBuf rawData;
-                            rawData.alloc(box.length-sizeof(uuid)-sizeof(box));
+                            rawData.alloc(bIsExif ? EXV_MIN(dataSize, 40L) : dataSize);
                             long    bufRead = io_->read(rawData.pData_, rawData.size_);
                             if (io_->error()) throw Error(kerFailedToReadImageData);
                             if (bufRead != rawData.size_) throw Error(kerInputDataReadFailed);
@@ -566,8 +669,8 @@ namespace Exiv2
                                 if ( (rawData.pData_[0]      == rawData.pData_[1])
                                     &&   (rawData.pData_[0]=='I' || rawData.pData_[0]=='M' )
                                     ) {
-                                    BasicIo::UniquePtr p = BasicIo::UniquePtr(new MemIo(rawData.pData_,rawData.size_));
-                                    printTiffStructure(*p,out,option,depth);
+                                    Internal::SubIo exifIo(*io_, dataOffset, dataSize);
+                                    printTiffStructure(exifIo,out,option,depth);
                                 }
                             }
 
@@ -596,13 +699,15 @@ namespace Exiv2
 
     void Jp2Image::writeMetadata()
     {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
         if (io_->open() != 0)
         {
             throw Error(kerDataSourceOpenFailed, io_->path(), strError());
         }
         IoCloser closer(*io_);
-        BasicIo::UniquePtr tempIo(new MemIo);
-        assert (tempIo.get() != 0);
+        // the new image has about the same size
+        BasicIo::UniquePtr tempIo = Internal::TiffParserWorker::createTempIo(*io_, static_cast<uint32_t>(io_->size()));
 
         doWriteMetadata(*tempIo); // may throw
         io_->close();
@@ -610,6 +715,17 @@ namespace Exiv2
 
     } // Jp2Image::writeMetadata
 
+    void Jp2Image::writeMetadataTo(BasicIo& dst)
+    {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
+        if (io_->open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+        IoCloser closer(*io_);
+        doWriteMetadata(dst); // may throw
+    } // Jp2Image::writeMetadataTo
+
 #ifdef __clang__
 // ignore cast align errors.  dataBuf.pData_ is allocated by malloc() and 4 (or 8 byte aligned).
 #pragma clang diagnostic push
@@ -709,210 +825,138 @@ namespace Exiv2
         // Write JPEG2000 Signature.
         if (outIo.write(Jp2Signature, 12) != 12) throw Error(kerImageWriteFailed);
 
-        Jp2BoxHeader box = {0,0};
-
         byte    boxDataSize[4];
         byte    boxUUIDtype[4];
-        DataBuf bheaderBuf(8);     // Box header : 4 bytes (data size) + 4 bytes (box type).
 
-        // FIXME: Andreas, why the loop do not stop when EOF is taken from _io. The loop go out by an exception
-        // generated by a zero size data read.
+        // Boxes which are not changed, the codestream in particular, are copied in runs
+        long copyStart = io_->tell();
+        const std::vector<Jp2BoxInfo> boxes = readJp2Boxes(*io_);
 
-        while(io_->tell() < (long) io_->size())
+        for (std::vector<Jp2BoxInfo>::const_iterator box = boxes.begin(); box != boxes.end(); ++box)
         {
 #ifdef DEBUG
-            std::cout << "Exiv2::Jp2Image::doWriteMetadata: Position: " << io_->tell() << " / " << io_->size() << std::endl;
+            std::cout << "Exiv2::Jp2Image::doWriteMetadata: box type: " << toAscii(box->type)
+                      << " length: " << box->length << std::endl;
 #endif
-
-            // Read chunk header.
-
-            std::memset(bheaderBuf.pData_, 0x00, bheaderBuf.size_);
-            long bufRead = io_->read(bheaderBuf.pData_, bheaderBuf.size_);
-            if (io_->error()) throw Error(kerFailedToReadImageData);
-            if (bufRead != bheaderBuf.size_) throw Error(kerInputDataReadFailed);
-
-            // Decode box header.
-
-            box.length = getLong(bheaderBuf.pData_,     bigEndian);
-            box.type   = getLong(bheaderBuf.pData_ + 4, bigEndian);
-
-#ifdef DEBUG
-            std::cout << "Exiv2::Jp2Image::doWriteMetadata: box type: " << toAscii(box.type)
-                      << " length: " << box.length << std::endl;
-#endif
-
-            if (box.length == 0)
+            if (box->type != kJp2BoxTypeJp2Header && box->metadataId == mdNone)
             {
 #ifdef DEBUG
-                std::cout << "Exiv2::Jp2Image::doWriteMetadata: Null Box size has been found. "
-                             "This is the last box of file." << std::endl;
+                std::cout << "Exiv2::Jp2Image::doWriteMetadata: copy box (length: " << box->length << ")" << std::endl;
 #endif
-                box.length = (uint32_t) (io_->size() - io_->tell() + 8);
-            }
-            if (box.length == 1)
-            {
-                // FIXME. Special case. the real box size is given in another place.
+                continue;
             }
 
-            // Read whole box : Box header + Box data (not fixed size - can be null).
+            if (box->length > static_cast<uint64_t>(io_->size() - box->offset)) throw Error(kerInputDataReadFailed);
+            copyJp2Range(*io_, outIo, copyStart, box->offset - copyStart);
+            copyStart = static_cast<long>(box->offset + box->length);
 
-            DataBuf boxBuf(box.length);                             // Box header (8 bytes) + box data.
-            memcpy(boxBuf.pData_, bheaderBuf.pData_, 8);               // Copy header.
-            bufRead = io_->read(boxBuf.pData_ + 8, box.length - 8); // Extract box data.
-            if (io_->error())
+            if (box->metadataId != mdNone)
             {
 #ifdef DEBUG
-                std::cout << "Exiv2::Jp2Image::doWriteMetadata: Error reading source file" << std::endl;
+                std::cout << "Exiv2::Jp2Image::doWriteMetadata: strip Uuid box with metadata" << std::endl;
 #endif
-
-                throw Error(kerFailedToReadImageData);
+                continue;
             }
 
-            if (bufRead != (long)(box.length - 8))
-            {
-#ifdef DEBUG
-                std::cout << "Exiv2::Jp2Image::doWriteMetadata: Cannot read source file data" << std::endl;
-#endif
-                throw Error(kerInputDataReadFailed);
-            }
+            // Read whole box : Box header + Box data.
+            DataBuf boxBuf(static_cast<long>(box->length));
+            io_->seek(box->offset, BasicIo::beg);
+            long bufRead = io_->read(boxBuf.pData_, boxBuf.size_);
+            if (io_->error()) throw Error(kerFailedToReadImageData);
+            if (bufRead != boxBuf.size_) throw Error(kerInputDataReadFailed);
 
-            switch(box.type)
-            {
-                case kJp2BoxTypeJp2Header:
-                {
-                    DataBuf newBuf;
-                    encodeJp2Header(boxBuf,newBuf);
+            DataBuf newBuf;
+            encodeJp2Header(boxBuf,newBuf);
 #ifdef DEBUG
-                    std::cout << "Exiv2::Jp2Image::doWriteMetadata: Write JP2Header box (length: " << box.length << ")" << std::endl;
+            std::cout << "Exiv2::Jp2Image::doWriteMetadata: Write JP2Header box (length: " << box->length << ")" << std::endl;
 #endif
-                    if (outIo.write(newBuf.pData_, newBuf.size_) != newBuf.size_) throw Error(kerImageWriteFailed);
-
-                    // Write all updated metadata here, just after JP2Header.
-
-                    if (exifData_.count() > 0)
-                    {
-                        // Update Exif data to a new UUID box
-
-                        Blob blob;
-                        ExifParser::encode(blob, littleEndian, exifData_);
-                        if (blob.size())
-                        {
-                            DataBuf rawExif(static_cast<long>(blob.size()));
-                            memcpy(rawExif.pData_, &blob[0], blob.size());
+            if (outIo.write(newBuf.pData_, newBuf.size_) != newBuf.size_) throw Error(kerImageWriteFailed);
 
-                            DataBuf boxData(8 + 16 + rawExif.size_);
-                            ul2Data(boxDataSize, boxData.size_, Exiv2::bigEndian);
-                            ul2Data(boxUUIDtype, kJp2BoxTypeUuid, Exiv2::bigEndian);
-                            memcpy(boxData.pData_,          boxDataSize,    4);
-                            memcpy(boxData.pData_ + 4,      boxUUIDtype,    4);
-                            memcpy(boxData.pData_ + 8,      kJp2UuidExif,   16);
-                            memcpy(boxData.pData_ + 8 + 16, rawExif.pData_, rawExif.size_);
+            // Write all updated metadata here, just after JP2Header.
 
-#ifdef DEBUG
-                            std::cout << "Exiv2::Jp2Image::doWriteMetadata: Write box with Exif metadata (length: "
-                                      << boxData.size_ << std::endl;
-#endif
-                            if (outIo.write(boxData.pData_, boxData.size_) != boxData.size_) throw Error(kerImageWriteFailed);
-                        }
-                    }
+            if (exifData_.count() > 0)
+            {
+                // Update Exif data to a new UUID box
 
-                    if (iptcData_.count() > 0)
-                    {
-                        // Update Iptc data to a new UUID box
+                Blob blob;
+                ExifParser::encode(blob, littleEndian, exifData_);
+                if (blob.size())
+                {
+                    DataBuf rawExif(static_cast<long>(blob.size()));
+                    memcpy(rawExif.pData_, &blob[0], blob.size());
 
-                        DataBuf rawIptc = IptcParser::encode(iptcData_);
-                        if (rawIptc.size_ > 0)
-                        {
-                            DataBuf boxData(8 + 16 + rawIptc.size_);
-                            ul2Data(boxDataSize, boxData.size_, Exiv2::bigEndian);
-                            ul2Data(boxUUIDtype, kJp2BoxTypeUuid, Exiv2::bigEndian);
-                            memcpy(boxData.pData_,          boxDataSize,    4);
-                            memcpy(boxData.pData_ + 4,      boxUUIDtype,    4);
-                            memcpy(boxData.pData_ + 8,      kJp2UuidIptc,   16);
-                            memcpy(boxData.pData_ + 8 + 16, rawIptc.pData_, rawIptc.size_);
+                    DataBuf boxData(8 + 16 + rawExif.size_);
+                    ul2Data(boxDataSize, boxData.size_, Exiv2::bigEndian);
+                    ul2Data(boxUUIDtype, kJp2BoxTypeUuid, Exiv2::bigEndian);
+                    memcpy(boxData.pData_,          boxDataSize,    4);
+                    memcpy(boxData.pData_ + 4,      boxUUIDtype,    4);
+                    memcpy(boxData.pData_ + 8,      kJp2UuidExif,   16);
+                    memcpy(boxData.pData_ + 8 + 16, rawExif.pData_, rawExif.size_);
 
 #ifdef DEBUG
-                            std::cout << "Exiv2::Jp2Image::doWriteMetadata: Write box with Iptc metadata (length: "
-                                      << boxData.size_ << std::endl;
+                    std::cout << "Exiv2::Jp2Image::doWriteMetadata: Write box with Exif metadata (length: "
+                              << boxData.size_ << std::endl;
 #endif
-                            if (outIo.write(boxData.pData_, boxData.size_) != boxData.size_) throw Error(kerImageWriteFailed);
-                        }
-                    }
+                    if (outIo.write(boxData.pData_, boxData.size_) != boxData.size_) throw Error(kerImageWriteFailed);
+                }
+            }
 
-                    if (writeXmpFromPacket() == false)
-                    {
-                        if (XmpParser::encode(xmpPacket_, xmpData_) > 1)
-                        {
-#ifndef SUPPRESS_WARNINGS
-                            EXV_ERROR << "Failed to encode XMP metadata." << std::endl;
-#endif
-                        }
-                    }
-                    if (xmpPacket_.size() > 0)
-                    {
-                        // Update Xmp data to a new UUID box
+            if (iptcData().count() > 0)
+            {
+                // Update Iptc data to a new UUID box
 
-                        DataBuf xmp(reinterpret_cast<const byte*>(xmpPacket_.data()), static_cast<long>(xmpPacket_.size()));
-                        DataBuf boxData(8 + 16 + xmp.size_);
-                        ul2Data(boxDataSize, boxData.size_, Exiv2::bigEndian);
-                        ul2Data(boxUUIDtype, kJp2BoxTypeUuid, Exiv2::bigEndian);
-                        memcpy(boxData.pData_,          boxDataSize,  4);
-                        memcpy(boxData.pData_ + 4,      boxUUIDtype,  4);
-                        memcpy(boxData.pData_ + 8,      kJp2UuidXmp,  16);
-                        memcpy(boxData.pData_ + 8 + 16, xmp.pData_,   xmp.size_);
+                DataBuf rawIptc = IptcParser::encode(iptcData());
+                if (rawIptc.size_ > 0)
+                {
+                    DataBuf boxData(8 + 16 + rawIptc.size_);
+                    ul2Data(boxDataSize, boxData.size_, Exiv2::bigEndian);
+                    ul2Data(boxUUIDtype, kJp2BoxTypeUuid, Exiv2::bigEndian);
+                    memcpy(boxData.pData_,          boxDataSize,    4);
+                    memcpy(boxData.pData_ + 4,      boxUUIDtype,    4);
+                    memcpy(boxData.pData_ + 8,      kJp2UuidIptc,   16);
+                    memcpy(boxData.pData_ + 8 + 16, rawIptc.pData_, rawIptc.size_);
 
 #ifdef DEBUG
-                        std::cout << "Exiv2::Jp2Image::doWriteMetadata: Write box with XMP metadata (length: "
-                                  << boxData.size_ << ")" << std::endl;
+                    std::cout << "Exiv2::Jp2Image::doWriteMetadata: Write box with Iptc metadata (length: "
+                              << boxData.size_ << std::endl;
 #endif
-                        if (outIo.write(boxData.pData_, boxData.size_) != boxData.size_) throw Error(kerImageWriteFailed);
-                    }
-
-                    break;
+                    if (outIo.write(boxData.pData_, boxData.size_) != boxData.size_) throw Error(kerImageWriteFailed);
                 }
+            }
 
-                case kJp2BoxTypeUuid:
+            if (writeXmpFromPacket() == false)
+            {
+                if (XmpParser::encode(xmpPacket_, xmpData()) > 1)
                 {
-                    if(memcmp(boxBuf.pData_ + 8, kJp2UuidExif, 16) == 0)
-                    {
-#ifdef DEBUG
-                        std::cout << "Exiv2::Jp2Image::doWriteMetadata: strip Exif Uuid box" << std::endl;
-#endif
-                    }
-                    else if(memcmp(boxBuf.pData_ + 8, kJp2UuidIptc, 16) == 0)
-                    {
-#ifdef DEBUG
-                        std::cout << "Exiv2::Jp2Image::doWriteMetadata: strip Iptc Uuid box" << std::endl;
-#endif
-                    }
-                    else if(memcmp(boxBuf.pData_ + 8, kJp2UuidXmp,  16) == 0)
-                    {
-#ifdef DEBUG
-                        std::cout << "Exiv2::Jp2Image::doWriteMetadata: strip Xmp Uuid box" << std::endl;
-#endif
-                    }
-                    else
-                    {
-#ifdef DEBUG
-                        std::cout << "Exiv2::Jp2Image::doWriteMetadata: write Uuid box (length: " << box.length << ")" << std::endl;
+#ifndef SUPPRESS_WARNINGS
+                    EXV_ERROR << "Failed to encode XMP metadata." << std::endl;
 #endif
-                        if (outIo.write(boxBuf.pData_, boxBuf.size_) != boxBuf.size_) throw Error(kerImageWriteFailed);
-                    }
-                    break;
                 }
+            }
+            if (xmpPacket_.size() > 0)
+            {
+                // Update Xmp data to a new UUID box
+
+                DataBuf xmp(reinterpret_cast<const byte*>(xmpPacket_.data()), static_cast<long>(xmpPacket_.size()));
+                DataBuf boxData(8 + 16 + xmp.size_);
+                ul2Data(boxDataSize, boxData.size_, Exiv2::bigEndian);
+                ul2Data(boxUUIDtype, kJp2BoxTypeUuid, Exiv2::bigEndian);
+                memcpy(boxData.pData_,          boxDataSize,  4);
+                memcpy(boxData.pData_ + 4,      boxUUIDtype,  4);
+                memcpy(boxData.pData_ + 8,      kJp2UuidXmp,  16);
+                memcpy(boxData.pData_ + 8 + 16, xmp.pData_,   xmp.size_);
 
-                default:
-                {
 #ifdef DEBUG
-                    std::cout << "Exiv2::Jp2Image::doWriteMetadata: write box (length: " << box.length << ")" << std::endl;
+                std::cout << "Exiv2::Jp2Image::doWriteMetadata: Write box with XMP metadata (length: "
+                          << boxData.size_ << ")" << std::endl;
 #endif
-                    if (outIo.write(boxBuf.pData_, boxBuf.size_) != boxBuf.size_) throw Error(kerImageWriteFailed);
-
-                    break;
-                }
+                if (outIo.write(boxData.pData_, boxData.size_) != boxData.size_) throw Error(kerImageWriteFailed);
             }
         }
 
+        // Copy the remaining boxes and anything trailing them
+        copyJp2Range(*io_, outIo, copyStart, static_cast<long>(io_->size()) - copyStart);
+
 #ifdef DEBUG
         std::cout << "Exiv2::Jp2Image::doWriteMetadata: EOF" << std::endl;
 #endif
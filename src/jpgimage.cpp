@@ -26,11 +26,13 @@
 
 #include "jpgimage.hpp"
 #include "tiffimage.hpp"
+#include "tiffimage_int.hpp"
 #include "image_int.hpp"
 #include "error.hpp"
 #include "futils.hpp"
 #include "helper_functions.hpp"
 #include "enforce.hpp"
+#include "stats_int.hpp"
 
 #ifdef WIN32
 #include <windows.h>
@@ -43,9 +45,11 @@
 #include "fff.h"
 
 // + standard includes
+#include <algorithm>
 #include <cstdio>                               // for EOF
 #include <cstring>
 #include <cassert>
+#include <memory>
 #include <stdexcept>
 #include <iostream>
 
@@ -107,6 +111,49 @@ namespace Exiv2 {
         return inRange(lo1,value,hi1) || inRange(lo2,value,hi2);
     }
 
+    //! Return the position of the entry of \em tag in the IFD at \em offset of \em tiff, 0 if there is none
+    static long findIfdEntry(const byte* tiff, long size, ByteOrder bo, uint32_t offset, uint16_t tag)
+    {
+        if (offset < 8 || offset > static_cast<uint32_t>(size - 2)) return 0;
+        const uint16_t count = getUShort(tiff + offset, bo);
+        for (uint16_t i = 0; i < count; ++i) {
+            const long pos = static_cast<long>(offset) + 2 + 12L * i;
+            if (pos + 12 > size) return 0;
+            if (getUShort(tiff + pos, bo) == tag) return pos;
+        }
+        return 0;
+    }
+
+    //! Set the value of the IFD entry at \em pos of \em tiff if it is a single SHORT or LONG
+    static void setIfdEntry(byte* tiff, ByteOrder bo, long pos, uint32_t value)
+    {
+        if (pos == 0 || value == 0 || getULong(tiff + pos + 4, bo) != 1) return;
+        const uint16_t type = getUShort(tiff + pos + 2, bo);
+        if (type == unsignedShort && value <= 0xffff) {
+            us2Data(tiff + pos + 8, static_cast<uint16_t>(value), bo);
+        }
+        else if (type == unsignedLong) {
+            ul2Data(tiff + pos + 8, value, bo);
+        }
+    }
+
+    //! Set the tags of \em patch in the TIFF structure of \em size bytes at \em tiff
+    static void patchExif(byte* tiff, long size, const JpegBase::ExifPatch& patch)
+    {
+        if (size < 8) return;
+        ByteOrder bo = invalidByteOrder;
+        if (tiff[0] == 'I' && tiff[1] == 'I') bo = littleEndian;
+        else if (tiff[0] == 'M' && tiff[1] == 'M') bo = bigEndian;
+        else return;
+        const uint32_t ifd0 = getULong(tiff + 4, bo);
+        setIfdEntry(tiff, bo, findIfdEntry(tiff, size, bo, ifd0, 0x0112), patch.orientation_);
+        const long exifIfdPos = findIfdEntry(tiff, size, bo, ifd0, 0x8769);
+        if (exifIfdPos == 0) return;
+        const uint32_t exifIfd = getULong(tiff + exifIfdPos + 8, bo);
+        setIfdEntry(tiff, bo, findIfdEntry(tiff, size, bo, exifIfd, 0xa002), patch.pixelWidth_);
+        setIfdEntry(tiff, bo, findIfdEntry(tiff, size, bo, exifIfd, 0xa003), patch.pixelHeight_);
+    }
+
     bool Photoshop::isIrb(const byte* pPsData,
                           long        sizePsData)
     {
@@ -121,18 +168,81 @@ namespace Exiv2 {
     bool Photoshop::valid(const byte* pPsData,
                           long        sizePsData)
     {
-        const byte *record = 0;
-        uint32_t sizeIptc = 0;
-        uint32_t sizeHdr = 0;
-        const byte* pCur = pPsData;
-        const byte* pEnd = pPsData + sizePsData;
-        int ret = 0;
-        while (pCur < pEnd
-               && 0 == (ret = Photoshop::locateIptcIrb(pCur, static_cast<long>(pEnd - pCur),
-                                                       &record, &sizeHdr, &sizeIptc))) {
-            pCur = record + sizeHdr + sizeIptc + (sizeIptc & 1);
+        IrbIndex index;
+        return indexIrbs(pPsData, sizePsData, index) >= 0;
+    }
+
+    /*!
+      @brief Read the header of the IRB at \em position of \em pPsData.
+      @return 0 if the IRB was read into \em irb;<BR>
+              3 if there is no further data;<BR>
+             -2 if the data at \em position is not a valid IRB.
+     */
+    static int readIrb(const byte*      pPsData,
+                       long             sizePsData,
+                       long             position,
+                       Photoshop::Irb&  irb)
+    {
+        // Data should follow Photoshop format, if not exit
+        if (position > sizePsData - 12 || !Photoshop::isIrb(pPsData + position, 4)) {
+#ifdef DEBUG
+            std::cerr << "pPsData doesn't start with '8BIM'\n";
+#endif
+            if (position < sizePsData) {
+#ifdef DEBUG
+                std::cerr << "Warning: "
+                          << "Invalid or extended Photoshop IRB\n";
+#endif
+                return -2;
+            }
+            return 3;
+        }
+        const long start = position;
+        position += 4;
+        uint16_t type = getUShort(pPsData + position, bigEndian);
+        position += 2;
+#ifdef DEBUG
+        std::cerr << "0x" << std::hex << type << std::dec << " ";
+#endif
+        // Pascal string is padded to have an even size (including size byte)
+        byte psSize = pPsData[position] + 1;
+        psSize += (psSize & 1);
+        position += psSize;
+        if (position + 4 > sizePsData) {
+#ifdef DEBUG
+            std::cerr << "Warning: "
+                      << "Invalid or extended Photoshop IRB\n";
+#endif
+            return -2;
+        }
+        uint32_t dataSize = getULong(pPsData + position, bigEndian);
+        position += 4;
+        if (dataSize > static_cast<uint32_t>(sizePsData - position)) {
+#ifdef DEBUG
+            std::cerr << "Warning: "
+                      << "Invalid Photoshop IRB data size "
+                      << dataSize << " or extended Photoshop IRB\n";
+#endif
+            return -2;
+        }
+#ifndef DEBUG
+        if (   (dataSize & 1)
+            && position + dataSize == static_cast<uint32_t>(sizePsData)) {
+            std::cerr << "Warning: "
+                      << "Photoshop IRB data is not padded to even size\n";
         }
-        return ret >= 0;
+#endif
+        irb.psTag_ = type;
+        irb.offset_ = start;
+        irb.sizeHdr_ = psSize + 10;
+        irb.sizeData_ = dataSize;
+        return 0;
+    }
+
+    //! Return the offset of the IRB following \em irb, data size is padded to be even
+    static long nextIrb(const Photoshop::Irb& irb)
+    {
+        return irb.offset_ + irb.sizeHdr_ + irb.sizeData_ + (irb.sizeData_ & 1);
     }
 
     // Todo: Generalised from JpegBase::locateIptcData without really understanding
@@ -148,71 +258,25 @@ namespace Exiv2 {
         assert(record);
         assert(sizeHdr);
         assert(sizeData);
-        // Used for error checking
-        long position = 0;
 #ifdef DEBUG
         std::cerr << "Photoshop::locateIrb: ";
 #endif
-        // Data should follow Photoshop format, if not exit
-        while (position <= sizePsData - 12 && isIrb(pPsData + position, 4)) {
-            const byte *hrd = pPsData + position;
-            position += 4;
-            uint16_t type = getUShort(pPsData + position, bigEndian);
-            position += 2;
-#ifdef DEBUG
-            std::cerr << "0x" << std::hex << type << std::dec << " ";
-#endif
-            // Pascal string is padded to have an even size (including size byte)
-            byte psSize = pPsData[position] + 1;
-            psSize += (psSize & 1);
-            position += psSize;
-            if (position + 4 > sizePsData) {
-#ifdef DEBUG
-                std::cerr << "Warning: "
-                          << "Invalid or extended Photoshop IRB\n";
-#endif
-                return -2;
-            }
-            uint32_t dataSize = getULong(pPsData + position, bigEndian);
-            position += 4;
-            if (dataSize > static_cast<uint32_t>(sizePsData - position)) {
-#ifdef DEBUG
-                std::cerr << "Warning: "
-                          << "Invalid Photoshop IRB data size "
-                          << dataSize << " or extended Photoshop IRB\n";
-#endif
-                return -2;
-            }
-#ifndef DEBUG
-            if (   (dataSize & 1)
-                && position + dataSize == static_cast<uint32_t>(sizePsData)) {
-                std::cerr << "Warning: "
-                          << "Photoshop IRB data is not padded to even size\n";
-            }
-#endif
-            if (type == psTag) {
+        Irb irb;
+        int rc = 0;
+        for (long position = 0;
+             0 == (rc = readIrb(pPsData, sizePsData, position, irb));
+             position = nextIrb(irb)) {
+            if (irb.psTag_ == psTag) {
 #ifdef DEBUG
                 std::cerr << "ok\n";
 #endif
-                *sizeData = dataSize;
-                *sizeHdr = psSize + 10;
-                *record = hrd;
+                *sizeData = irb.sizeData_;
+                *sizeHdr = irb.sizeHdr_;
+                *record = pPsData + irb.offset_;
                 return 0;
             }
-            // Data size is also padded to be even
-            position += dataSize + (dataSize & 1);
-        }
-#ifdef DEBUG
-        std::cerr << "pPsData doesn't start with '8BIM'\n";
-#endif
-        if (position < sizePsData) {
-#ifdef DEBUG
-            std::cerr << "Warning: "
-                      << "Invalid or extended Photoshop IRB\n";
-#endif
-            return -2;
         }
-        return 3;
+        return rc;
     } // Photoshop::locateIrb
 
     int Photoshop::locateIptcIrb(const byte*     pPsData,
@@ -235,6 +299,29 @@ namespace Exiv2 {
                          record, sizeHdr, sizeData);
     }
 
+    int Photoshop::indexIrbs(const byte* pPsData,
+                             long        sizePsData,
+                             IrbIndex&   index)
+    {
+        index.clear();
+        Irb irb;
+        int rc = 0;
+        for (long position = 0;
+             0 == (rc = readIrb(pPsData, sizePsData, position, irb));
+             position = nextIrb(irb)) {
+            index.push_back(irb);
+        }
+        return rc;
+    }
+
+    const Photoshop::Irb* Photoshop::findIrb(const IrbIndex& index, uint16_t psTag)
+    {
+        for (IrbIndex::const_iterator i = index.begin(); i != index.end(); ++i) {
+            if (i->psTag_ == psTag) return &*i;
+        }
+        return 0;
+    }
+
     DataBuf Photoshop::setIptcIrb(const byte*     pPsData,
                                   long            sizePsData,
                                   const IptcData& iptcData)
@@ -245,53 +332,59 @@ namespace Exiv2 {
         if (sizePsData == 0) std::cerr << "  None.\n";
         else hexdump(std::cerr, pPsData, sizePsData);
 #endif
-        const byte* record    = pPsData;
-        uint32_t    sizeIptc  = 0;
-        uint32_t    sizeHdr   = 0;
-        DataBuf rc;
+        IrbIndex index;
         // Safe to call with zero psData.size_
-        if (0 > Photoshop::locateIptcIrb(pPsData, sizePsData,
-                                         &record, &sizeHdr, &sizeIptc)) {
-            return rc;
+        const int status = indexIrbs(pPsData, sizePsData, index);
+        const Irb* first = findIrb(index, iptc_);
+        if (first == 0 && status < 0) {
+            return DataBuf();
         }
-        Blob psBlob;
-        const uint32_t sizeFront = static_cast<uint32_t>(record - pPsData);
-        // Write data before old record.
-        if (sizePsData > 0 && sizeFront > 0) {
-            append(psBlob, pPsData, sizeFront);
+        // Ranges of pPsData to keep: all but the IPTC IRBs
+        std::vector<std::pair<long, long> > kept;
+        long pos = 0;
+        for (IrbIndex::const_iterator i = index.begin(); i != index.end(); ++i) {
+            if (i->psTag_ != iptc_) continue;
+            if (i->offset_ > pos) kept.push_back(std::make_pair(pos, i->offset_));
+            pos = nextIrb(*i);
         }
-        // Write new iptc record if we have it
+        if (pos < sizePsData) kept.push_back(std::make_pair(pos, sizePsData));
+
         DataBuf rawIptc = IptcParser::encode(iptcData);
-        if (rawIptc.size_ > 0) {
-            byte tmpBuf[12];
-            std::memcpy(tmpBuf, Photoshop::irbId_[0], 4);
-            us2Data(tmpBuf + 4, iptc_, bigEndian);
-            tmpBuf[6] = 0;
-            tmpBuf[7] = 0;
-            ul2Data(tmpBuf + 8, rawIptc.size_, bigEndian);
-            append(psBlob, tmpBuf, 12);
-            append(psBlob, rawIptc.pData_, rawIptc.size_);
-            // Data is padded to be even (but not included in size)
-            if (rawIptc.size_ & 1) psBlob.push_back(0x00);
+        // Data is padded to be even (but not included in size)
+        const long sizeIptcIrb = rawIptc.size_ > 0 ? 12 + rawIptc.size_ + (rawIptc.size_ & 1) : 0;
+        long size = sizeIptcIrb;
+        for (size_t k = 0; k < kept.size(); ++k) {
+            size += kept[k].second - kept[k].first;
         }
-        // Write existing stuff after record,
-        // skip the current and all remaining IPTC blocks
-        long pos = sizeFront;
-        while (0 == Photoshop::locateIptcIrb(pPsData + pos, sizePsData - pos,
-                                             &record, &sizeHdr, &sizeIptc)) {
-            const long newPos = static_cast<long>(record - pPsData);
-            // Copy data up to the IPTC IRB
-            if (newPos > pos) {
-                append(psBlob, pPsData + pos, newPos - pos);
-            }
-            // Skip the IPTC IRB
-            pos = newPos + sizeHdr + sizeIptc + (sizeIptc & 1);
+        if (size == 0) return DataBuf();
+
+        DataBuf rc(size);
+        byte* pWrite = rc.pData_;
+        size_t k = 0;
+        // Write data before old record.
+        const long sizeFront = first == 0 ? 0 : first->offset_;
+        if (!kept.empty() && kept[0].second <= sizeFront) {
+            std::memcpy(pWrite, pPsData, sizeFront);
+            pWrite += sizeFront;
+            ++k;
         }
-        if (pos < sizePsData) {
-            append(psBlob, pPsData + pos, sizePsData - pos);
+        // Write new iptc record if we have it
+        if (sizeIptcIrb > 0) {
+            std::memcpy(pWrite, Photoshop::irbId_[0], 4);
+            us2Data(pWrite + 4, iptc_, bigEndian);
+            pWrite[6] = 0;
+            pWrite[7] = 0;
+            ul2Data(pWrite + 8, rawIptc.size_, bigEndian);
+            std::memcpy(pWrite + 12, rawIptc.pData_, rawIptc.size_);
+            if (rawIptc.size_ & 1) pWrite[12 + rawIptc.size_] = 0x00;
+            pWrite += sizeIptcIrb;
+        }
+        // Write existing stuff after record, without the other IPTC blocks
+        for ( ; k < kept.size(); ++k) {
+            std::memcpy(pWrite, pPsData + kept[k].first, kept[k].second - kept[k].first);
+            pWrite += kept[k].second - kept[k].first;
         }
-        // Data is rounded to be even
-        if (psBlob.size() > 0) rc = DataBuf(&psBlob[0], static_cast<long>(psBlob.size()));
+        assert(pWrite == rc.pData_ + rc.size_);
 #ifdef DEBUG
         std::cerr << "IRB block at the end of Photoshop::setIptcIrb\n";
         if (rc.size_ == 0) std::cerr << "  None.\n";
@@ -324,18 +417,20 @@ namespace Exiv2 {
 
     int JpegBase::advanceToMarker() const
     {
-        int c = -1;
-        // Skips potential padding between markers
-        while ((c=io_->getb()) != 0xff) {
-            if (c == EOF)
-                return -1;
+        // Usually the marker follows the segment immediately; read it in one go
+        byte head[2];
+        const long n = io_->read(head, 2);
+        if (n == 2 && head[0] == 0xff && head[1] != 0xff) {
+            return head[1];
         }
+        if (n > 0 && io_->seek(-n, BasicIo::cur) != 0) return -1;
+
+        // Skips potential padding between markers
+        if (!Internal::skipToByte(*io_, 0xff)) return -1;
 
         // Markers can start with any number of 0xff
-        while ((c=io_->getb()) == 0xff) {
-            if (c == EOF)
-                return -2;
-        }
+        int c = -1;
+        while ((c=io_->getb()) == 0xff) {}
         return c;
     }
 
@@ -351,20 +446,48 @@ namespace Exiv2 {
             throw Error(kerNotAJpeg);
         }
         clearMetadata();
+        payloadHashDefined_ = false;
         int search = 6 ; // Exif, ICC, XMP, Comment, IPTC, SOF
         const long bufMinSize = 36;
         DataBuf buf(bufMinSize);
+        // Used for segment data that can't be accessed in place
+        DataBuf segment = DataBuf::pooled();
         Blob psBlob;
         bool foundCompletePsData = false;
         bool foundExifData = false;
         bool foundXmpData = false;
         bool foundIccData = false;
+        uint32_t iccProfileSize = 0;
+        long iccChunksSize = 0;
+        Internal::FamilyDecoder families(*io_);
+
+        auto decodeExif = [this](const byte* pData, long size, long tiffOffset) {
+            ByteOrder bo = ExifParser::decode(exifData_, pData, size);
+            exifData_.setTiffOffset(tiffOffset);
+            setByteOrder(bo);
+            if (size > 0 && byteOrder() == invalidByteOrder) {
+#ifndef SUPPRESS_WARNINGS
+                EXV_WARNING << "Failed to decode Exif metadata.\n";
+#endif
+                exifData_.clear();
+            }
+        };
+        auto decodeXmp = [this]() {
+            if (   !xmpPacket_.empty()
+                && XmpParser::decode(xmpData_, reinterpret_cast<const byte*>(xmpPacket_.data()),
+                                     static_cast<long>(xmpPacket_.size()))) {
+#ifndef SUPPRESS_WARNINGS
+                EXV_WARNING << "Failed to decode XMP metadata.\n";
+#endif
+            }
+        };
 
         // Read section marker
         int marker = advanceToMarker();
         if (marker < 0) throw Error(kerNotAJpeg);
 
         while (marker != sos_ && marker != eoi_ && search > 0) {
+            Internal::ParseBudget::checkDeadline();
             // Read size and signature (ok if this hits EOF)
             std::memset(buf.pData_, 0x0, buf.size_);
             long bufRead = io_->read(buf.pData_, bufMinSize);
@@ -380,16 +503,19 @@ namespace Exiv2 {
                 }
                 // Seek to beginning and read the Exif data
                 io_->seek(8 - bufRead, BasicIo::cur);
-                DataBuf rawExif(size - 8);
-                io_->read(rawExif.pData_, rawExif.size_);
-                if (io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
-                ByteOrder bo = ExifParser::decode(exifData_, rawExif.pData_, rawExif.size_);
-                setByteOrder(bo);
-                if (rawExif.size_ > 0 && byteOrder() == invalidByteOrder) {
-#ifndef SUPPRESS_WARNINGS
-                    EXV_WARNING << "Failed to decode Exif metadata.\n";
-#endif
-                    exifData_.clear();
+                const long tiffOffset = io_->tell();
+                const long sizeExif = size - 8;
+                const byte* rawExif = io_->readView(segment, sizeExif);
+                if (rawExif == 0 || io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
+                if (parallelDecode()) {
+                    // The view is only valid until the next read
+                    std::shared_ptr<DataBuf> exif(new DataBuf(rawExif, sizeExif));
+                    families.start([decodeExif, exif, tiffOffset]() {
+                        decodeExif(exif->pData_, exif->size_, tiffOffset);
+                    });
+                }
+                else {
+                    decodeExif(rawExif, sizeExif, tiffOffset);
                 }
                 --search;
                 foundExifData = true;
@@ -402,14 +528,15 @@ namespace Exiv2 {
                 }
                 // Seek to beginning and read the XMP packet
                 io_->seek(31 - bufRead, BasicIo::cur);
-                DataBuf xmpPacket(size - 31);
-                io_->read(xmpPacket.pData_, xmpPacket.size_);
-                if (io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
-                xmpPacket_.assign(reinterpret_cast<char*>(xmpPacket.pData_), xmpPacket.size_);
-                if (xmpPacket_.size() > 0 && XmpParser::decode(xmpData_, xmpPacket_)) {
-#ifndef SUPPRESS_WARNINGS
-                    EXV_WARNING << "Failed to decode XMP metadata.\n";
-#endif
+                const long sizeXmp = size - 31;
+                const byte* xmpPacket = io_->readView(segment, sizeXmp);
+                if (xmpPacket == 0 || io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
+                xmpPacket_.assign(reinterpret_cast<const char*>(xmpPacket), sizeXmp);
+                if (parallelDecode()) {
+                    families.start(decodeXmp);
+                }
+                else {
+                    decodeXmp();
                 }
                 --search;
                 foundXmpData = true;
@@ -422,15 +549,15 @@ namespace Exiv2 {
                 }
                 // Read the rest of the APP13 segment
                 io_->seek(16 - bufRead, BasicIo::cur);
-                DataBuf psData(size - 16);
-                io_->read(psData.pData_, psData.size_);
-                if (io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
+                const long sizePsData = size - 16;
+                const byte* psData = io_->readView(segment, sizePsData);
+                if (psData == 0 || io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
 #ifdef DEBUG
                 std::cerr << "Found app13 segment, size = " << size << "\n";
-                //hexdump(std::cerr, psData.pData_, psData.size_);
+                //hexdump(std::cerr, psData, sizePsData);
 #endif
                 // Append to psBlob
-                append(psBlob, psData.pData_, psData.size_);
+                append(psBlob, psData, sizePsData);
                 // Check whether psBlob is complete
                 if (psBlob.size() > 0 && Photoshop::valid(&psBlob[0], (long) psBlob.size())) {
                     --search;
@@ -447,10 +574,10 @@ namespace Exiv2 {
                 // the first one (most jpegs only have one anyway). Comments
                 // are simple single byte ISO-8859-1 strings.
                 io_->seek(2 - bufRead, BasicIo::cur);
-                DataBuf comment(size - 2);
-                io_->read(comment.pData_, comment.size_);
-                if (io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
-                comment_.assign(reinterpret_cast<char*>(comment.pData_), comment.size_);
+                const long sizeComment = size - 2;
+                const byte* comment = io_->readView(segment, sizeComment);
+                if (comment == 0 || io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
+                comment_.assign(reinterpret_cast<const char*>(comment), sizeComment);
                 while (   comment_.length()
                        && comment_.at(comment_.length()-1) == '\0') {
                     comment_.erase(comment_.length()-1);
@@ -478,21 +605,19 @@ namespace Exiv2 {
 #endif
                 io_->seek(-bufRead, BasicIo::cur); // back up to start of buffer (after marker)
                 io_->seek(    14+2, BasicIo::cur); // step header
-                // read in profile
+                // Only record where the chunk is, the profile is read on demand
                 // #1286 profile can be padded
-                DataBuf    icc((chunk==1&&chunks==1)?s:size-2-14);
-                if ( icc.size_ > size-2-14) throw Error(kerInvalidIccProfile);
-                io_->read( icc.pData_,icc.size_);
-
-                if ( !iccProfileDefined() ) { // first block of profile
-                    setIccProfile(icc,chunk==chunks);
-                } else {                       // extend existing profile
-                    DataBuf profile(iccProfile_.size_+icc.size_);
-                    if ( iccProfile_.size_ ) {
-                        ::memcpy(profile.pData_,iccProfile_.pData_,iccProfile_.size_);
-                    }
-                    ::memcpy(profile.pData_+iccProfile_.size_,icc.pData_,icc.size_);
-                    setIccProfile(profile,chunk==chunks);
+                const long iccSize = (chunk==1&&chunks==1) ? static_cast<long>(s) : size-2-14;
+                if ( iccSize < 0 || iccSize > size-2-14) throw Error(kerInvalidIccProfile);
+                if ( iccChunks_.empty() ) iccProfileSize = s; // the profile starts with its size
+                iccChunks_.push_back(std::make_pair(io_->tell(), iccSize));
+                iccChunksSize += iccSize;
+                io_->seek(iccSize, BasicIo::cur);
+
+                if ( chunk == chunks ) {
+                    // The complete profile must be as large as it says
+                    if (   iccChunksSize < static_cast<long>(sizeof(long))
+                        || static_cast<long>(iccProfileSize) != iccChunksSize) throw Error(kerInvalidIccProfile);
                 }
             }
             else if (  pixelHeight_ == 0 && inRange2(marker,sof0_,sof3_,sof5_,sof15_) ) {
@@ -526,21 +651,16 @@ namespace Exiv2 {
         if (psBlob.size() > 0) {
             // Find actual IPTC data within the psBlob
             Blob iptcBlob;
-            const byte *record = 0;
-            uint32_t sizeIptc = 0;
-            uint32_t sizeHdr = 0;
-            const byte* pCur = &psBlob[0];
-            const byte* pEnd = pCur + psBlob.size();
-            while (   pCur < pEnd
-                   && 0 == Photoshop::locateIptcIrb(pCur, static_cast<long>(pEnd - pCur),
-                                                    &record, &sizeHdr, &sizeIptc)) {
+            Photoshop::IrbIndex index;
+            Photoshop::indexIrbs(&psBlob[0], static_cast<long>(psBlob.size()), index);
+            for (Photoshop::IrbIndex::const_iterator irb = index.begin(); irb != index.end(); ++irb) {
+                if (irb->psTag_ != Photoshop::iptc_) continue;
 #ifdef DEBUG
-                std::cerr << "Found IPTC IRB, size = " << sizeIptc << "\n";
+                std::cerr << "Found IPTC IRB, size = " << irb->sizeData_ << "\n";
 #endif
-                if (sizeIptc) {
-                    append(iptcBlob, record + sizeHdr, sizeIptc);
+                if (irb->sizeData_) {
+                    append(iptcBlob, &psBlob[0] + irb->offset_ + irb->sizeHdr_, irb->sizeData_);
                 }
-                pCur = record + sizeHdr + sizeIptc + (sizeIptc & 1);
             }
             if (   iptcBlob.size() > 0
                 && IptcParser::decode(iptcData_,
@@ -552,14 +672,123 @@ namespace Exiv2 {
                 iptcData_.clear();
             }
         } // psBlob.size() > 0
+        families.wait();
+
+        if (rc == 0 && hashPayload()) {
+            // The loop stops when it has all metadata, skip to the image data
+            while (marker >= 0 && marker != sos_ && marker != eoi_) {
+                byte sizeBuf[2];
+                if (io_->read(sizeBuf, 2) != 2) break;
+                const uint16_t size = getUShort(sizeBuf, bigEndian);
+                if (size < 2 || io_->seek(size - 2, BasicIo::cur) != 0) break;
+                marker = advanceToMarker();
+            }
+            if (marker == sos_ || marker == eoi_) {
+                Internal::PayloadHash hash;
+                Internal::hashData(*io_, static_cast<long>(io_->size() - io_->tell()), hash);
+                payloadHash_ = hash.value();
+                payloadHashDefined_ = true;
+            }
+        }
 
         if (rc != 0) {
 #ifndef SUPPRESS_WARNINGS
             EXV_WARNING << "JPEG format error, rc = " << rc << "\n";
 #endif
         }
+        releasePackets();
     } // JpegBase::readMetadata
 
+    void JpegBase::setIccProfile(DataBuf& iccProfile, bool bTestValid)
+    {
+        Image::setIccProfile(iccProfile, bTestValid);
+        iccChunks_.clear();
+    }
+
+    void JpegBase::clearIccProfile()
+    {
+        Image::clearIccProfile();
+        iccChunks_.clear();
+    }
+
+    bool JpegBase::iccProfileDefined()
+    {
+        return !iccChunks_.empty() || Image::iccProfileDefined();
+    }
+
+    DataBuf* JpegBase::iccProfile()
+    {
+        readIccProfile();
+        return Image::iccProfile();
+    }
+
+    void JpegBase::readIccProfile()
+    {
+        if (iccChunks_.empty()) return;
+        long size = 0;
+        for (auto&& chunk : iccChunks_) size += chunk.second;
+        // Assemble the profile once, in a buffer of the final size
+        DataBuf profile(size);
+        const bool wasOpen = io_->isopen();
+        if (!wasOpen && io_->open() != 0) throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        long offset = 0;
+        for (auto&& chunk : iccChunks_) {
+            const long rc = io_->readAt(chunk.first, profile.pData_ + offset, chunk.second);
+            // Like a short read of a truncated image, leave the rest empty
+            if (rc < chunk.second) std::memset(profile.pData_ + offset + rc, 0, chunk.second - rc);
+            offset += chunk.second;
+        }
+        if (!wasOpen) io_->close();
+        iccChunks_.clear();
+        Image::setIccProfile(profile, false);
+    }
+
+    void JpegBase::readBasicInfo()
+    {
+        if (io_->open() != 0) throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        IoCloser closer(*io_);
+        if (!isThisType(*io_, true)) {
+            if (io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
+            throw Error(kerNotAJpeg);
+        }
+        clearMetadata();
+        const long bufMinSize = 36;
+        DataBuf buf(bufMinSize);
+        bool foundExifData = false;
+
+        int marker = advanceToMarker();
+        if (marker < 0) throw Error(kerNotAJpeg);
+
+        while (marker != sos_ && marker != eoi_) {
+            std::memset(buf.pData_, 0x0, buf.size_);
+            long bufRead = io_->read(buf.pData_, bufMinSize);
+            if (io_->error()) throw Error(kerFailedToReadImageData);
+            if (bufRead < 2) throw Error(kerNotAJpeg);
+            uint16_t size = getUShort(buf.pData_, bigEndian);
+            if (size < 2) break;
+
+            if (   !foundExifData
+                && marker == app1_ && memcmp(buf.pData_ + 2, exifId_, 6) == 0 && size >= 8) {
+                // Only the orientation is taken from IFD0, nothing else of the segment is read
+                static const uint16_t tags[] = { 0x0112 };
+                const long start = io_->tell() - bufRead + 8;
+                setByteOrder(Internal::TiffParserWorker::decodeIfd0(
+                    exifData_, *io_, start, size - 8, tags, EXV_COUNTOF(tags)));
+                foundExifData = true;
+            }
+            else if (inRange2(marker, sof0_, sof3_, sof5_, sof15_)) {
+                if (size >= 8) {
+                    pixelHeight_ = getUShort(buf.pData_ + 3, bigEndian);
+                    pixelWidth_ = getUShort(buf.pData_ + 5, bigEndian);
+                }
+                break;
+            }
+            if (io_->seek(size - bufRead, BasicIo::cur)) throw Error(kerFailedToReadImageData);
+            marker = advanceToMarker();
+            if (marker < 0) break;
+        }
+    } // JpegBase::readBasicInfo
+
 #define REPORT_MARKER if ( (option == kpsBasic||option == kpsRecursive) ) \
      out << Internal::stringFormat("%8ld | 0xff%02x %-5s", \
                              io_->tell()-2,marker,nm[marker].c_str())
@@ -889,24 +1118,369 @@ namespace Exiv2 {
 
     void JpegBase::writeMetadata()
     {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
         if (io_->open() != 0) {
             throw Error(kerDataSourceOpenFailed, io_->path(), strError());
         }
         IoCloser closer(*io_);
-        BasicIo::UniquePtr tempIo(new MemIo);
+        if (writeInPlace() && writeMetadataInPlace()) return; // may throw
+        // The image is rewritten, the profile must be read before
+        readIccProfile();
+        io_->seek(0, BasicIo::beg);
+        std::unique_ptr<MemIo> tempIo(new MemIo);
         assert (tempIo.get() != 0);
+        tempIo->reserve(static_cast<long>(io_->size())); // the new image has about the same size
 
         doWriteMetadata(*tempIo); // may throw
         io_->close();
         io_->transfer(*tempIo); // may throw
     } // JpegBase::writeMetadata
 
+    void JpegBase::writeMetadataTo(BasicIo& dst)
+    {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
+        if (io_->open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+        IoCloser closer(*io_);
+        // The image is rewritten, the profile must be read before
+        readIccProfile();
+        io_->seek(0, BasicIo::beg);
+        doWriteMetadata(dst); // may throw
+    } // JpegBase::writeMetadataTo
+
+    void JpegBase::stripMetadataTo(BasicIo& dst, int keep)
+    {
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
+        if (io_->open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+        IoCloser closer(*io_);
+        if (!dst.isopen()) throw Error(kerImageWriteFailed);
+        io_->advise(BasicIo::sequentialAccess);
+        if (!isThisType(*io_, true)) {
+            if (io_->error() || io_->eof()) throw Error(kerInputDataReadFailed);
+            throw Error(kerNoImageInInputData);
+        }
+        if (writeHeader(dst)) throw Error(kerImageWriteFailed);
+
+        DataBuf segment(0xffff + 2); // marker and the largest segment
+        int marker = advanceToMarker();
+        if (marker < 0) throw Error(kerNoImageInInputData);
+        while (marker != sos_ && marker != eoi_) {
+            segment.pData_[0] = 0xff;
+            segment.pData_[1] = static_cast<byte>(marker);
+            if (io_->read(segment.pData_ + 2, 2) != 2) throw Error(kerInputDataReadFailed);
+            const long size = getUShort(segment.pData_ + 2, bigEndian);
+            if (size < 2) throw Error(kerNoImageInInputData);
+            if (io_->read(segment.pData_ + 4, size - 2) != size - 2) throw Error(kerInputDataReadFailed);
+
+            // APP1 and APP13 segments of other applications are always stripped
+            const int id = metadataId(marker, segment.pData_ + 4, size);
+            if (id < 0 || (keep & id) != 0) {
+                if (dst.write(segment.pData_, size + 2) != size + 2) throw Error(kerImageWriteFailed);
+            }
+            marker = advanceToMarker();
+            if (marker < 0) throw Error(kerNoImageInInputData);
+        }
+
+        // Copy the image data and anything after it
+        const byte head[] = { 0xff, static_cast<byte>(marker) };
+        if (dst.write(head, 2) != 2) throw Error(kerImageWriteFailed);
+        Internal::PayloadHash hash;
+        Internal::copyData(*io_, dst, static_cast<long>(io_->size() - io_->tell()), hashPayload() ? &hash : 0);
+        if (hashPayload()) {
+            payloadHash_ = hash.value();
+            payloadHashDefined_ = true;
+        }
+    } // JpegBase::stripMetadataTo
+
+    int JpegBase::metadataId(int marker, const byte* data, long size)
+    {
+        static const char xmpExtId[] = "http://ns.adobe.com/xmp/extension/\0";
+        if (marker == app1_) {
+            if (size >= 8 && memcmp(data, exifId_, 6) == 0) return mdExif;
+            if (size >= 31 && memcmp(data, xmpId_, 29) == 0) return mdXmp;
+            if (size >= 37 && memcmp(data, xmpExtId, 35) == 0) return mdXmp;
+            return mdNone;
+        }
+        if (marker == app13_) {
+            if (size >= 16 && memcmp(data, Photoshop::ps3Id_, 14) == 0) return mdIptc;
+            return mdNone;
+        }
+        if (marker == com_) return mdComment;
+        if (marker == app2_ && size >= 14 && memcmp(data, iccId_, 12) == 0) return mdIccProfile;
+        return -1;
+    }
+
+    void JpegBase::readMetadataSegments(int metadataIds, std::vector<Blob>& segments)
+    {
+        if (io_->open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+        IoCloser closer(*io_);
+        if (!isThisType(*io_, true)) {
+            if (io_->error() || io_->eof()) throw Error(kerInputDataReadFailed);
+            throw Error(kerNoImageInInputData);
+        }
+        byte buf[4];
+        int marker = advanceToMarker();
+        if (marker < 0) throw Error(kerNoImageInInputData);
+        while (marker != sos_ && marker != eoi_) {
+            if (io_->read(buf + 2, 2) != 2) throw Error(kerInputDataReadFailed);
+            const long size = getUShort(buf + 2, bigEndian);
+            if (size < 2) throw Error(kerNoImageInInputData);
+            // Peek at the identifier of the segment, the longest one is that of extended XMP
+            byte id[35];
+            const long idSize = std::min(size - 2, static_cast<long>(sizeof(id)));
+            if (io_->readAt(io_->tell(), id, idSize) != idSize) throw Error(kerInputDataReadFailed);
+            const int md = metadataId(marker, id, size);
+            if (md > 0 && (metadataIds & md) != 0) {
+                buf[0] = 0xff;
+                buf[1] = static_cast<byte>(marker);
+                segments.push_back(Blob(buf, buf + 4));
+                Blob& segment = segments.back();
+                segment.resize(size + 2);
+                if (io_->read(&segment[4], size - 2) != size - 2) throw Error(kerInputDataReadFailed);
+            }
+            else if (io_->seek(size - 2, BasicIo::cur) != 0) {
+                throw Error(kerInputDataReadFailed);
+            }
+            marker = advanceToMarker();
+            if (marker < 0) throw Error(kerNoImageInInputData);
+        }
+    } // JpegBase::readMetadataSegments
+
+    void JpegBase::transplantMetadata(JpegBase& source, int metadataIds, const ExifPatch& patch)
+    {
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
+        std::vector<Blob> segments;
+        source.readMetadataSegments(metadataIds, segments);
+        long total = 0;
+        for (std::vector<Blob>::iterator i = segments.begin(); i != segments.end(); ++i) {
+            total += static_cast<long>(i->size());
+        }
+        for (std::vector<Blob>::iterator i = segments.begin(); i != segments.end(); ++i) {
+            if ((*i)[1] == app1_ && metadataId(app1_, &(*i)[4], static_cast<long>(i->size()) - 2) == mdExif) {
+                patchExif(&(*i)[10], static_cast<long>(i->size()) - 10, patch);
+                break;
+            }
+        }
+
+        if (io_->open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+        IoCloser closer(*io_);
+        io_->advise(BasicIo::sequentialAccess);
+        if (!isThisType(*io_, true)) {
+            if (io_->error() || io_->eof()) throw Error(kerInputDataReadFailed);
+            throw Error(kerNoImageInInputData);
+        }
+        std::unique_ptr<MemIo> tempIo(new MemIo);
+        tempIo->reserve(static_cast<long>(io_->size()) + total);
+        if (writeHeader(*tempIo)) throw Error(kerImageWriteFailed);
+
+        DataBuf segment(0xffff + 2); // marker and the largest segment
+        bool inserted = false;
+        int marker = advanceToMarker();
+        if (marker < 0) throw Error(kerNoImageInInputData);
+        for (;;) {
+            // The segments of the source follow the JFIF segment
+            if (!inserted && marker != app0_) {
+                for (std::vector<Blob>::iterator i = segments.begin(); i != segments.end(); ++i) {
+                    const long size = static_cast<long>(i->size());
+                    if (tempIo->write(&(*i)[0], size) != size) throw Error(kerImageWriteFailed);
+                }
+                inserted = true;
+            }
+            if (marker == sos_ || marker == eoi_) break;
+            segment.pData_[0] = 0xff;
+            segment.pData_[1] = static_cast<byte>(marker);
+            if (io_->read(segment.pData_ + 2, 2) != 2) throw Error(kerInputDataReadFailed);
+            const long size = getUShort(segment.pData_ + 2, bigEndian);
+            if (size < 2) throw Error(kerNoImageInInputData);
+            if (io_->read(segment.pData_ + 4, size - 2) != size - 2) throw Error(kerInputDataReadFailed);
+            const int id = metadataId(marker, segment.pData_ + 4, size);
+            if (id <= 0 || (metadataIds & id) == 0) {
+                if (tempIo->write(segment.pData_, size + 2) != size + 2) throw Error(kerImageWriteFailed);
+            }
+            marker = advanceToMarker();
+            if (marker < 0) throw Error(kerNoImageInInputData);
+        }
+
+        // Copy the image data and anything after it
+        const byte head[] = { 0xff, static_cast<byte>(marker) };
+        if (tempIo->write(head, 2) != 2) throw Error(kerImageWriteFailed);
+        Internal::copyData(*io_, *tempIo, static_cast<long>(io_->size() - io_->tell()));
+        io_->close();
+        io_->transfer(*tempIo); // may throw
+    } // JpegBase::transplantMetadata
+
+    bool JpegBase::writeMetadataInPlace()
+    {
+        // Only local files and memory blocks can be patched
+        FileIo* fileIo = dynamic_cast<FileIo*>(io_.get());
+        if (fileIo == 0 && dynamic_cast<MemIo*>(io_.get()) == 0) return false;
+        if (!isThisType(*io_, true)) return false;
+
+        // Locate the segments of interest. The positions are those of the
+        // segment length, i.e., one byte past the marker.
+        const long bufMinSize = 36;
+        DataBuf buf(bufMinSize);
+        long exifPos = -1;
+        long xmpPos = -1;
+        long psPos = -1;
+        long comPos = -1;
+        uint16_t exifSize = 0;
+        uint16_t xmpSize = 0;
+        uint16_t psSize = 0;
+        uint16_t comSize = 0;
+        int psSegments = 0;
+        bool foundIccData = false;
+        Blob iccBlob;
+
+        int marker = advanceToMarker();
+        if (marker < 0) return false;
+        while (marker != sos_ && marker != eoi_) {
+            const long start = io_->tell();
+            std::memset(buf.pData_, 0x0, buf.size_);
+            const long bufRead = io_->read(buf.pData_, bufMinSize);
+            if (io_->error() || bufRead < 2) return false;
+            const uint16_t size = getUShort(buf.pData_, bigEndian);
+            if (size < 2) return false;
+
+            if (exifPos == -1 && marker == app1_ && size >= 8 && memcmp(buf.pData_ + 2, exifId_, 6) == 0) {
+                exifPos = start;
+                exifSize = size;
+            } else if (xmpPos == -1 && marker == app1_ && size >= 31 && memcmp(buf.pData_ + 2, xmpId_, 29) == 0) {
+                xmpPos = start;
+                xmpSize = size;
+            } else if (marker == app13_ && size >= 16 && memcmp(buf.pData_ + 2, Photoshop::ps3Id_, 14) == 0) {
+                ++psSegments;
+                psPos = start;
+                psSize = size;
+            } else if (comPos == -1 && marker == com_) {
+                comPos = start;
+                comSize = size;
+            } else if (marker == app2_ && size >= 16 && memcmp(buf.pData_ + 2, iccId_, 11) == 0) {
+                // Collect the profile the same way readMetadata() does
+                foundIccData = true;
+                const int chunk  = buf.pData_[2+12];
+                const int chunks = buf.pData_[2+13];
+                const long iccSize = (chunk == 1 && chunks == 1) ? getULong(buf.pData_ + (2+14), bigEndian) : size - 2 - 14;
+                if (iccSize < 0 || iccSize > size - 2 - 14) return false;
+                const size_t iccPos = iccBlob.size();
+                iccBlob.resize(iccPos + iccSize);
+                if (iccSize > 0 && io_->readAt(start + 2 + 14, &iccBlob[iccPos], iccSize) != iccSize) return false;
+            }
+            if (io_->seek(start + size, BasicIo::beg)) return false;
+            marker = advanceToMarker();
+            if (marker < 0) return false;
+        }
+
+        // Encode the metadata into patches of the existing segments
+        typedef std::vector<std::pair<long, Blob> > Patches;
+        Patches patches;
+
+        if (exifData_.count() > 0) {
+            if (exifPos == -1) return false;
+            DataBuf rawExif(exifSize - 8);
+            if (io_->readAt(exifPos + 8, rawExif.pData_, rawExif.size_) != rawExif.size_) return false;
+            ByteOrder bo = byteOrder();
+            if (bo == invalidByteOrder) {
+                bo = littleEndian;
+                setByteOrder(bo);
+            }
+            Blob blob;
+            WriteMethod wm = ExifParser::encode(blob, rawExif.pData_, rawExif.size_, bo, exifData_);
+            if (wm == wmIntrusive) {
+                // The Exif parser ignores any bytes past the encoded data
+                if (blob.empty() || blob.size() > static_cast<size_t>(rawExif.size_)) return false;
+                blob.resize(rawExif.size_, 0);
+            } else {
+                blob.assign(rawExif.pData_, rawExif.pData_ + rawExif.size_);
+            }
+            patches.push_back(std::make_pair(exifPos + 8, blob));
+        } else if (exifPos != -1) {
+            return false;
+        }
+
+        xmpData().usePacket(writeXmpFromPacket());
+        if (writeXmpFromPacket() == false) {
+            const uint16_t formatFlags = XmpParser::useCompactFormat | XmpParser::omitAllFormatting;
+            if (XmpParser::encode(xmpPacket_, xmpData_, formatFlags) > 1) return false;
+            // Pad the packet to the size of the existing segment
+            if (   xmpPos != -1 && !xmpPacket_.empty()
+                && xmpPacket_.size() < static_cast<size_t>(xmpSize - 31)
+                && XmpParser::encode(xmpPacket_, xmpData_, formatFlags | XmpParser::exactPacketLength,
+                                     xmpSize - 31) > 1) {
+                return false;
+            }
+        }
+        if (!xmpPacket_.empty()) {
+            if (xmpPos == -1 || xmpPacket_.size() != static_cast<size_t>(xmpSize - 31)) return false;
+            patches.push_back(std::make_pair(xmpPos + 31, Blob(xmpPacket_.begin(), xmpPacket_.end())));
+        } else if (xmpPos != -1) {
+            return false;
+        }
+
+        if (psSegments > 1) return false;
+        if (psSegments == 1) {
+            DataBuf psData(psSize - 16);
+            if (io_->readAt(psPos + 16, psData.pData_, psData.size_) != psData.size_) return false;
+            if (!Photoshop::valid(psData.pData_, psData.size_)) return false;
+            DataBuf newPsData = Photoshop::setIptcIrb(psData.pData_, psData.size_, iptcData_);
+            if (newPsData.size_ != psData.size_) return false;
+            patches.push_back(std::make_pair(psPos + 16, Blob(newPsData.pData_, newPsData.pData_ + newPsData.size_)));
+        } else if (iptcData_.count() > 0) {
+            return false;
+        }
+
+        if (!comment_.empty()) {
+            // Comments are read up to the first trailing NUL byte
+            if (comPos == -1 || comment_.length() + 1 > static_cast<size_t>(comSize - 2)) return false;
+            Blob blob(comSize - 2, 0);
+            std::copy(comment_.begin(), comment_.end(), blob.begin());
+            patches.push_back(std::make_pair(comPos + 2, blob));
+        } else if (comPos != -1) {
+            return false;
+        }
+
+        // The ICC profile is not rewritten, it must be unchanged. A profile
+        // which was not read yet is the one in the image.
+        if (iccProfileDefined() != foundIccData) return false;
+        if (   foundIccData && iccChunks_.empty()
+            && (   iccBlob.size() != static_cast<size_t>(iccProfile_.size_)
+                || (!iccBlob.empty() && memcmp(&iccBlob[0], iccProfile_.pData_, iccBlob.size()) != 0))) {
+            return false;
+        }
+
+        if (fileIo != 0 && fileIo->open("r+b") != 0) {
+            fileIo->open();
+            return false;
+        }
+        for (Patches::const_iterator i = patches.begin(); i != patches.end(); ++i) {
+            const long size = static_cast<long>(i->second.size());
+            if (size == 0) continue;
+            if (   io_->seek(i->first, BasicIo::beg) != 0
+                || io_->write(&i->second[0], size) != size
+                || io_->error()) {
+                throw Error(kerImageWriteFailed);
+            }
+        }
+        return true;
+    } // JpegBase::writeMetadataInPlace
+
     void JpegBase::doWriteMetadata(BasicIo& outIo)
     {
         if (!io_->isopen())
             throw Error(kerInputDataReadFailed);
         if (!outIo.isopen())
             throw Error(kerImageWriteFailed);
+        // The image is copied from start to end
+        io_->advise(BasicIo::sequentialAccess);
 
         // Ensure that this is the correct image type
         if (!isThisType(*io_, true)) {
@@ -1092,6 +1666,11 @@ namespace Exiv2 {
                     const byte* pExifData = rawExif.pData_;
                     uint32_t exifSize = rawExif.size_;
                     if (wm == wmIntrusive) {
+                        // Reserve slack for later updates in place, the Exif
+                        // parser ignores any bytes past the encoded data
+                        if (blob.size() > 0 && blob.size() + 8 < 0xffff) {
+                            blob.resize(blob.size() + EXV_MIN(writePadding(), 0xffff - 8 - blob.size()), 0);
+                        }
                         pExifData = blob.size() > 0 ? &blob[0] : 0;
                         exifSize = static_cast<uint32_t>(blob.size());
                     }
@@ -1104,11 +1683,11 @@ namespace Exiv2 {
                             throw Error(kerTooLargeJpegSegment, "Exif");
                         us2Data(tmpBuf + 2, static_cast<uint16_t>(exifSize + 8), bigEndian);
                         std::memcpy(tmpBuf + 4, exifId_, 6);
-                        if (outIo.write(tmpBuf, 10) != 10)
-                            throw Error(kerImageWriteFailed);
-
-                        // Write new Exif data buffer
-                        if (outIo.write(pExifData, exifSize) != static_cast<long>(exifSize))
+                        const std::pair<const byte*, long> pieces[] = {
+                            std::make_pair(static_cast<const byte*>(tmpBuf), 10L),
+                            std::make_pair(pExifData, static_cast<long>(exifSize))
+                        };
+                        if (outIo.writev(pieces, EXV_COUNTOF(pieces)) != static_cast<long>(exifSize) + 10)
                             throw Error(kerImageWriteFailed);
                         if (outIo.error())
                             throw Error(kerImageWriteFailed);
@@ -1116,8 +1695,13 @@ namespace Exiv2 {
                     }
                 }
                 if (writeXmpFromPacket() == false) {
-                    if (XmpParser::encode(xmpPacket_, xmpData_,
-                                          XmpParser::useCompactFormat | XmpParser::omitAllFormatting) > 1) {
+                    const uint16_t formatFlags = XmpParser::useCompactFormat | XmpParser::omitAllFormatting;
+                    int rc = XmpParser::encode(xmpPacket_, xmpData_, formatFlags, writePadding());
+                    if (rc == 0 && writePadding() > 0 && xmpPacket_.size() + 31 > 0xffff) {
+                        // Drop the padding rather than fail to write the segment
+                        rc = XmpParser::encode(xmpPacket_, xmpData_, formatFlags);
+                    }
+                    if (rc > 1) {
 #ifndef SUPPRESS_WARNINGS
                         EXV_ERROR << "Failed to encode XMP metadata.\n";
 #endif
@@ -1132,12 +1716,12 @@ namespace Exiv2 {
                         throw Error(kerTooLargeJpegSegment, "XMP");
                     us2Data(tmpBuf + 2, static_cast<uint16_t>(xmpPacket_.size() + 31), bigEndian);
                     std::memcpy(tmpBuf + 4, xmpId_, 29);
-                    if (outIo.write(tmpBuf, 33) != 33)
-                        throw Error(kerImageWriteFailed);
-
-                    // Write new XMP packet
-                    if (outIo.write(reinterpret_cast<const byte*>(xmpPacket_.data()),
-                                    static_cast<long>(xmpPacket_.size())) != static_cast<long>(xmpPacket_.size()))
+                    const std::pair<const byte*, long> pieces[] = {
+                        std::make_pair(static_cast<const byte*>(tmpBuf), 33L),
+                        std::make_pair(reinterpret_cast<const byte*>(xmpPacket_.data()),
+                                       static_cast<long>(xmpPacket_.size()))
+                    };
+                    if (outIo.writev(pieces, EXV_COUNTOF(pieces)) != static_cast<long>(xmpPacket_.size()) + 33)
                         throw Error(kerImageWriteFailed);
                     if (outIo.error())
                         throw Error(kerImageWriteFailed);
@@ -1159,21 +1743,18 @@ namespace Exiv2 {
                         int bytes = profileSize > chunk_size ? chunk_size : profileSize;  // bytes to write
                         profileSize -= bytes;
 
-                        // write JPEG marker (2 bytes)
-                        if (outIo.write(tmpBuf, 2) != 2)
-                            throw Error(kerImageWriteFailed);  // JPEG Marker
-                        // write length (2 bytes).  length includes the 2 bytes for the length
+                        // JPEG marker and length (2 bytes each), the length includes
+                        // the 2 bytes for the length, then the ICC_PROFILE header (14 bytes)
                         us2Data(tmpBuf + 2, 2 + 14 + bytes, bigEndian);
-                        if (outIo.write(tmpBuf + 2, 2) != 2)
-                            throw Error(kerImageWriteFailed);  // JPEG Length
-
-                        // write the ICC_PROFILE header (14 bytes)
-                        char pad[2];
-                        pad[0] = chunk + 1;
-                        pad[1] = chunks;
-                        outIo.write((const byte*)iccId_, 12);
-                        outIo.write((const byte*)pad, 2);
-                        if (outIo.write(iccProfile_.pData_ + (chunk * chunk_size), bytes) != bytes)
+                        std::memcpy(tmpBuf + 4, iccId_, 12);
+                        tmpBuf[16] = static_cast<byte>(chunk + 1);
+                        tmpBuf[17] = static_cast<byte>(chunks);
+                        const std::pair<const byte*, long> pieces[] = {
+                            std::make_pair(static_cast<const byte*>(tmpBuf), 18L),
+                            std::make_pair(static_cast<const byte*>(iccProfile_.pData_ + (chunk * chunk_size)),
+                                           static_cast<long>(bytes))
+                        };
+                        if (outIo.writev(pieces, EXV_COUNTOF(pieces)) != bytes + 18)
                             throw Error(kerImageWriteFailed);
                         if (outIo.error())
                             throw Error(kerImageWriteFailed);
@@ -1208,13 +1789,12 @@ namespace Exiv2 {
                         tmpBuf[1] = app13_;
                         us2Data(tmpBuf + 2, static_cast<uint16_t>(chunkSize + 16), bigEndian);
                         std::memcpy(tmpBuf + 4, Photoshop::ps3Id_, 14);
-                        if (outIo.write(tmpBuf, 18) != 18)
-                            throw Error(kerImageWriteFailed);
-                        if (outIo.error())
-                            throw Error(kerImageWriteFailed);
-
-                        // Write next chunk of the Photoshop IRB data buffer
-                        if (outIo.write(chunkStart, chunkSize) != chunkSize)
+                        // and the next chunk of the Photoshop IRB data buffer
+                        const std::pair<const byte*, long> pieces[] = {
+                            std::make_pair(static_cast<const byte*>(tmpBuf), 18L),
+                            std::make_pair(chunkStart, chunkSize)
+                        };
+                        if (outIo.writev(pieces, EXV_COUNTOF(pieces)) != chunkSize + 18)
                             throw Error(kerImageWriteFailed);
                         if (outIo.error())
                             throw Error(kerImageWriteFailed);
@@ -1235,11 +1815,14 @@ namespace Exiv2 {
                         throw Error(kerTooLargeJpegSegment, "JPEG comment");
                     us2Data(tmpBuf + 2, static_cast<uint16_t>(comment_.length() + 3), bigEndian);
 
-                    if (outIo.write(tmpBuf, 4) != 4)
-                        throw Error(kerImageWriteFailed);
-                    if (outIo.write((byte*)comment_.data(), (long)comment_.length()) != (long)comment_.length())
-                        throw Error(kerImageWriteFailed);
-                    if (outIo.putb(0) == EOF)
+                    const byte nul = 0;
+                    const std::pair<const byte*, long> pieces[] = {
+                        std::make_pair(static_cast<const byte*>(tmpBuf), 4L),
+                        std::make_pair(reinterpret_cast<const byte*>(comment_.data()),
+                                       static_cast<long>(comment_.length())),
+                        std::make_pair(&nul, 1L)
+                    };
+                    if (outIo.writev(pieces, EXV_COUNTOF(pieces)) != static_cast<long>(comment_.length()) + 5)
                         throw Error(kerImageWriteFailed);
                     if (outIo.error())
                         throw Error(kerImageWriteFailed);
@@ -1280,14 +1863,12 @@ namespace Exiv2 {
         // it avoids allocating memory for parts of the file that contain image-date.
         io_->populateFakeData();
 
-        // Copy rest of the Io
+        // Copy rest of the Io in one go, the IO classes copy in bulk
         io_->seek(-2, BasicIo::cur);
-        buf.alloc(4096);
-        long readSize = 0;
-        while ((readSize = io_->read(buf.pData_, buf.size_))) {
-            if (outIo.write(buf.pData_, readSize) != readSize)
-                throw Error(kerImageWriteFailed);
-        }
+        const long rest = static_cast<long>(io_->size()) - io_->tell();
+        const long written = outIo.write(*io_);
+        if (rest > 0 && written != rest)
+            throw Error(kerImageWriteFailed);
         if (outIo.error())
             throw Error(kerImageWriteFailed);
 
@@ -1361,6 +1942,40 @@ namespace Exiv2 {
         return result;
     }
 
+    bool readJpegHead(std::istream& is, Blob& head)
+    {
+        const int soi = 0xd8, sos = 0xda, eoi = 0xd9;
+        head.clear();
+        const auto get = [&is, &head]() {
+            const int c = is.get();
+            if (c != std::char_traits<char>::eof()) head.push_back(static_cast<byte>(c));
+            return c;
+        };
+        if (get() != 0xff || get() != soi) return false;
+        for (;;) {
+            // markers may be preceded by fill bytes
+            int marker = get();
+            if (marker != 0xff) return false;
+            while (marker == 0xff) marker = get();
+            if (marker < 0) return false;
+            if (marker == sos || marker == eoi) return true;
+            // standalone markers have no segment
+            if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) continue;
+            const int high = get();
+            const int low = get();
+            if (high < 0 || low < 0) return false;
+            const size_t size = static_cast<size_t>(high << 8 | low);
+            if (size < 2) return false;
+            const size_t start = head.size();
+            head.resize(start + size - 2);
+            is.read(reinterpret_cast<char*>(&head[start]), static_cast<std::streamsize>(size - 2));
+            if (static_cast<size_t>(is.gcount()) != size - 2) {
+                head.resize(start + static_cast<size_t>(is.gcount()));
+                return false;
+            }
+        }
+    }
+
     const char ExvImage::exiv2Id_[] = "Exiv2";
     const byte ExvImage::blank_[] = { 0xff,0x01,'E','x','i','v','2',0xff,0xd9 };
 
@@ -36,6 +36,11 @@
 // + standard includes
 #include <string>
 #include <cstring>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sys/stat.h>
 
 #if defined(__MINGW32__) || defined(__MINGW64__)
 #ifndef __MINGW__
@@ -79,11 +84,8 @@
 
 // *****************************************************************************
 namespace {
-    // Todo: Can be generalized further - get any tag as a string/long/...
-    //! Get the model name from tag Exif.Image.Model
-    std::string getExifModel(Exiv2::Internal::TiffComponent* const pRoot);
-    //! Nikon en/decryption function
-    void ncrypt(Exiv2::byte* pData, uint32_t size, uint32_t count, uint32_t serial);
+    //! Nikon en/decryption function, writes \em size bytes from \em pSrc to \em pDst
+    void ncrypt(Exiv2::byte* pDst, const Exiv2::byte* pSrc, uint32_t size, uint32_t count, uint32_t serial);
 }
 
 // *****************************************************************************
@@ -110,52 +112,110 @@ namespace Exiv2 {
         }
 
 
+        namespace {
+            //! Snapshot of the Exiv2 configuration file, immutable once published
+            struct Exiv2Config {
+                Exiv2Config(bool exists, time_t mtime, off_t size)
+                    : exists_(exists), mtime_(mtime), size_(size) {}
+                const bool exists_;                //!< True if the file existed when it was read
+                const time_t mtime_;               //!< Modification time of the file when read
+                const off_t size_;                 //!< Size of the file when read
+                std::unique_ptr<INIReader> reader_;  //!< The parsed file, 0 if it could not be parsed
+            };
+
+            //! The configuration file currently in use, shared by all threads
+            std::shared_ptr<const Exiv2Config> exiv2Config;
+            //! Serialises reloading the configuration file
+            std::mutex exiv2ConfigMutex;
+        }
+
         std::string readExiv2Config(const std::string& section,const std::string& value,const std::string& def)
         {
-            std::string result = def;
-            Exiv2::INIReader reader(Exiv2::Internal::getExiv2ConfigPath());
-
-            if (reader.ParseError() == 0) {
-                result = reader.Get(section,value,def);
+            // getpwuid() is not reentrant, look up the path only once
+            static const std::string path = getExiv2ConfigPath();
+            struct stat st;
+            const bool exists = ::stat(path.c_str(), &st) == 0;
+            const time_t mtime = exists ? st.st_mtime : 0;
+            const off_t size = exists ? st.st_size : 0;
+            // The printers call this for every lens, only take the lock if the file
+            // appeared, disappeared or changed
+            std::shared_ptr<const Exiv2Config> config = std::atomic_load(&exiv2Config);
+            if (!config || config->exists_ != exists || config->mtime_ != mtime || config->size_ != size) {
+                std::lock_guard<std::mutex> lock(exiv2ConfigMutex);
+                config = std::atomic_load(&exiv2Config);
+                if (!config || config->exists_ != exists || config->mtime_ != mtime || config->size_ != size) {
+                    std::shared_ptr<Exiv2Config> reloaded = std::make_shared<Exiv2Config>(exists, mtime, size);
+                    if (exists) {
+                        std::unique_ptr<INIReader> reader(new INIReader(path));
+                        if (reader->ParseError() == 0) reloaded->reader_ = std::move(reader);
+                    }
+                    config = reloaded;
+                    std::atomic_store(&exiv2Config, config);
+                }
             }
-            return result;
+            // Get() looks the key up before it reads it and never inserts into the parsed file
+            return config->reader_ ? config->reader_->Get(section,value,def) : def;
         }
 
 
+    // Entries with make "-" are only used for lookup by group. Makernotes of
+    // vendors whose module is not built are not decoded, see EXIV2_MAKERNOTES.
     const TiffMnRegistry TiffMnCreator::registry_[] = {
+#ifdef EXV_HAVE_CANON_MAKERNOTE
         { "Canon",          canonId,     newIfdMn,       newIfdMn2       },
+#endif
+#ifdef EXV_HAVE_SIGMA_MAKERNOTE
         { "FOVEON",         sigmaId,     newSigmaMn,     newSigmaMn2     },
+        { "SIGMA",          sigmaId,     newSigmaMn,     newSigmaMn2     },
+#endif
+#ifdef EXV_HAVE_FUJI_MAKERNOTE
         { "FUJI",           fujiId,      newFujiMn,      newFujiMn2      },
+#endif
+#ifdef EXV_HAVE_MINOLTA_MAKERNOTE
         { "KONICA MINOLTA", minoltaId,   newIfdMn,       newIfdMn2       },
         { "Minolta",        minoltaId,   newIfdMn,       newIfdMn2       },
+#endif
+#ifdef EXV_HAVE_NIKON_MAKERNOTE
         { "NIKON",          ifdIdNotSet, newNikonMn,     0               }, // mnGroup_ is not used
+        { "-",              nikon1Id,    0,              newIfdMn2       },
+        { "-",              nikon2Id,    0,              newNikon2Mn2    },
+        { "-",              nikon3Id,    0,              newNikon3Mn2    },
+#endif
+#ifdef EXV_HAVE_OLYMPUS_MAKERNOTE
         { "OLYMPUS",        ifdIdNotSet, newOlympusMn,   0               }, // mnGroup_ is not used
+        { "-",              olympusId,   0,              newOlympusMn2   },
+        { "-",              olympus2Id,  0,              newOlympus2Mn2  },
+#endif
+#ifdef EXV_HAVE_PANASONIC_MAKERNOTE
         { "Panasonic",      panasonicId, newPanasonicMn, newPanasonicMn2 },
+#endif
+#ifdef EXV_HAVE_PENTAX_MAKERNOTE
         { "PENTAX",         ifdIdNotSet, newPentaxMn,    0               }, // mnGroup_ is not used
         { "RICOH",          ifdIdNotSet, newPentaxMn,    0               }, // mnGroup_ is not used
+        { "-",              pentaxId,    0,              newPentaxMn2    },
+        { "-",              pentaxDngId, 0,              newPentaxDngMn2 },
+#endif
+#ifdef EXV_HAVE_SAMSUNG_MAKERNOTE
         { "SAMSUNG",        samsung2Id,  newSamsungMn,   newSamsungMn2   },
-        { "SIGMA",          sigmaId,     newSigmaMn,     newSigmaMn2     },
+#endif
+#ifdef EXV_HAVE_SONY_MAKERNOTE
         { "SONY",           ifdIdNotSet, newSonyMn,      0               }, // mnGroup_ is not used
-        { "CASIO",          ifdIdNotSet, newCasioMn,     0               }, // mnGroup_ is not used
-        // Entries below are only used for lookup by group
-        { "-",              nikon1Id,    0,              newIfdMn2       },
-        { "-",              nikon2Id,    0,              newNikon2Mn2    },
-        { "-",              nikon3Id,    0,              newNikon3Mn2    },
         { "-",              sony1Id,     0,              newSony1Mn2     },
         { "-",              sony2Id,     0,              newSony2Mn2     },
-        { "-",              olympusId,   0,              newOlympusMn2   },
-        { "-",              olympus2Id,  0,              newOlympus2Mn2  },
-        { "-",              pentaxId,    0,              newPentaxMn2    },
-        { "-",              pentaxDngId, 0,              newPentaxDngMn2 },
+#endif
+#ifdef EXV_HAVE_CASIO_MAKERNOTE
+        { "CASIO",          ifdIdNotSet, newCasioMn,     0               }, // mnGroup_ is not used
         { "-",              casioId,     0,              newIfdMn2       },
-        { "-",              casio2Id,    0,              newCasio2Mn2    }
+        { "-",              casio2Id,    0,              newCasio2Mn2    },
+#endif
+        // End of list marker
+        { "-",              ifdIdNotSet, 0,              0               }
     };
 
     bool TiffMnRegistry::operator==(const std::string& key) const
     {
-        std::string make(make_);
         if (key.size() > 0 && key[0] == '-') return false;
-        return make == key.substr(0, make.length());
+        return key.compare(0, std::strlen(make_), make_) == 0;
     }
 
     bool TiffMnRegistry::operator==(IfdId key) const
@@ -163,6 +223,38 @@ namespace Exiv2 {
         return mnGroup_ == key;
     }
 
+    const TiffMnRegistry* TiffMnCreator::findMake(const std::string& make)
+    {
+        // The entries by the first character of their make, in table order
+        typedef std::vector<const TiffMnRegistry*> Bucket;
+        static const std::vector<Bucket> index = [] {
+            std::vector<Bucket> idx(256);
+            for (const TiffMnRegistry& tmr : registry_) {
+                if (tmr.make_[0] != '-') idx[static_cast<unsigned char>(tmr.make_[0])].push_back(&tmr);
+            }
+            return idx;
+        }();
+        if (make.empty()) return 0;
+        const Bucket& bucket = index[static_cast<unsigned char>(make[0])];
+        for (Bucket::const_iterator i = bucket.begin(); i != bucket.end(); ++i) {
+            if (**i == make) return *i;
+        }
+        return 0;
+    }
+
+    const TiffMnRegistry* TiffMnCreator::findGroup(IfdId mnGroup)
+    {
+        // The first entry in table order for each group
+        typedef std::map<IfdId, const TiffMnRegistry*> Index;
+        static const Index index = [] {
+            Index idx;
+            for (const TiffMnRegistry& tmr : registry_) idx.insert(std::make_pair(tmr.mnGroup_, &tmr));
+            return idx;
+        }();
+        Index::const_iterator pos = index.find(mnGroup);
+        return pos == index.end() ? 0 : pos->second;
+    }
+
     TiffComponent* TiffMnCreator::create(uint16_t           tag,
                                          IfdId              group,
                                          const std::string& make,
@@ -171,7 +263,7 @@ namespace Exiv2 {
                                          ByteOrder          byteOrder)
     {
         TiffComponent* tc = 0;
-        const TiffMnRegistry* tmr = find(registry_, make);
+        const TiffMnRegistry* tmr = findMake(make);
         if (tmr) {
             assert(tmr->newMnFct_);
             tc = tmr->newMnFct_(tag,
@@ -189,7 +281,7 @@ namespace Exiv2 {
                                          IfdId              mnGroup)
     {
         TiffComponent* tc = 0;
-        const TiffMnRegistry* tmr = find(registry_, mnGroup);
+        const TiffMnRegistry* tmr = findGroup(mnGroup);
         if (tmr) {
 
             if (tmr->newMnFct2_ == 0) {
@@ -1194,21 +1286,17 @@ namespace Exiv2 {
         if (nci == 0 || nci->start_ == NA || size <= nci->start_) return buf;
 
         // Find Exif.Nikon3.ShutterCount
-        TiffFinder finder(0x00a7, nikon3Id);
-        pRoot->accept(finder);
-        TiffEntryBase* te = dynamic_cast<TiffEntryBase*>(finder.result());
+        TiffEntryBase* te = dynamic_cast<TiffEntryBase*>(TiffIndex::findIn(pRoot, 0x00a7, nikon3Id));
         if (!te || !te->pValue() || te->pValue()->count() == 0) return buf;
         uint32_t count = static_cast<uint32_t>(te->pValue()->toLong());
 
         // Find Exif.Nikon3.SerialNumber
-        finder.init(0x001d, nikon3Id);
-        pRoot->accept(finder);
-        te = dynamic_cast<TiffEntryBase*>(finder.result());
+        te = dynamic_cast<TiffEntryBase*>(TiffIndex::findIn(pRoot, 0x001d, nikon3Id));
         if (!te || !te->pValue() || te->pValue()->count() == 0) return buf;
         bool ok(false);
         uint32_t serial = stringTo<uint32_t>(te->pValue()->toString(), ok);
         if (!ok) {
-            std::string model = getExifModel(pRoot);
+            std::string model = TiffIndex::modelOf(pRoot);
             if (model.empty()) return buf;
             if (model.find("D50") != std::string::npos) {
                 serial = 0x22;
@@ -1218,14 +1306,14 @@ namespace Exiv2 {
             }
         }
         buf.alloc(size);
-        memcpy(buf.pData_, pData, buf.size_);
-        ncrypt(buf.pData_ + nci->start_, buf.size_ - nci->start_, count, serial);
+        memcpy(buf.pData_, pData, nci->start_);
+        ncrypt(buf.pData_ + nci->start_, pData + nci->start_, buf.size_ - nci->start_, count, serial);
         return buf;
     }
 
     int sonyCsSelector(uint16_t /*tag*/, const byte* /*pData*/, uint32_t /*size*/, TiffComponent* const pRoot)
     {
-        std::string model = getExifModel(pRoot);
+        std::string model = TiffIndex::modelOf(pRoot);
         if (model.empty()) return -1;
         int idx = 0;
         if (   model.find("DSLR-A330") != std::string::npos
@@ -1239,16 +1327,7 @@ namespace Exiv2 {
 // *****************************************************************************
 // local definitions
 namespace {
-    std::string getExifModel(Exiv2::Internal::TiffComponent* const pRoot)
-    {
-        Exiv2::Internal::TiffFinder finder(0x0110, Exiv2::Internal::ifd0Id); // Exif.Image.Model
-        pRoot->accept(finder);
-        Exiv2::Internal::TiffEntryBase* te = dynamic_cast<Exiv2::Internal::TiffEntryBase*>(finder.result());
-        if (!te || !te->pValue() || te->pValue()->count() == 0) return std::string();
-        return te->pValue()->toString();
-    }
-
-    void ncrypt(Exiv2::byte* pData, uint32_t size, uint32_t count, uint32_t serial)
+    void ncrypt(Exiv2::byte* pDst, const Exiv2::byte* pSrc, uint32_t size, uint32_t count, uint32_t serial)
     {
         static const Exiv2::byte xlat[2][256] = {
             { 0xc1,0xbf,0x6d,0x0d,0x59,0xc5,0x13,0x9d,0x83,0x61,0x6b,0x4f,0xc7,0x7f,0x3d,0x3d,
@@ -1291,9 +1370,20 @@ namespace {
         Exiv2::byte ci = xlat[0][serial & 0xff];
         Exiv2::byte cj = xlat[1][key];
         Exiv2::byte ck = 0x60;
-        for (uint32_t i = 0; i < size; ++i) {
+        // The keystream does not depend on the data and repeats after 512
+        // bytes, when ck has wrapped twice and cj has advanced by 256 * ci.
+        // Generate it once, the XOR loop below is then vectorized.
+        Exiv2::byte stream[512];
+        const uint32_t streamSize = size < sizeof(stream) ? size : sizeof(stream);
+        for (uint32_t i = 0; i < streamSize; ++i) {
             cj += ci * ck++;
-            pData[i] ^= cj;
+            stream[i] = cj;
+        }
+        for (uint32_t i = 0; i < size; i += streamSize) {
+            const uint32_t n = size - i < streamSize ? size - i : streamSize;
+            for (uint32_t j = 0; j < n; ++j) {
+                pDst[i + j] = pSrc[i + j] ^ stream[j];
+            }
         }
     }
 }
@@ -53,6 +53,10 @@ namespace Exiv2 {
 
         /*!
           @brief Read value from Exiv2 configuration file
+
+          The file is parsed once and parsed again only when its modification
+          time or size changes. Returns \em def if the file or the value does
+          not exist.
          */
         std::string readExiv2Config(const std::string& section,const std::string& value,const std::string& def);
 
@@ -129,6 +133,15 @@ namespace Exiv2 {
         //! Prevent destruction (needed if used as a policy class)
         ~TiffMnCreator() {}
     private:
+        /*!
+          @brief Return the first registry entry whose make is a prefix of
+                 \em make, or 0. Only the entries starting with the first
+                 character of \em make are compared.
+         */
+        static const TiffMnRegistry* findMake(const std::string& make);
+        //! Return the first registry entry for makernote group \em mnGroup, or 0
+        static const TiffMnRegistry* findGroup(IfdId mnGroup);
+
         static const TiffMnRegistry registry_[]; //<! List of makernotes
     }; // class TiffMnCreator
 
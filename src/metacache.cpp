@@ -0,0 +1,493 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+  File:      metacache.cpp
+ */
+// *****************************************************************************
+// included header files
+#include "config.h"
+
+#include "metacache.hpp"
+#include "basicio.hpp"
+#include "error.hpp"
+#include "exif.hpp"
+#include "futils.hpp"
+#include "image.hpp"
+#include "image_int.hpp"
+#include "iptc.hpp"
+#include "properties.hpp"
+#include "value.hpp"
+#include "version.hpp"
+#include "xmp_exiv2.hpp"
+
+// + standard includes
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+
+// *****************************************************************************
+// local declarations
+namespace {
+
+    using namespace Exiv2;
+    using Exiv2::Internal::BlobReader;
+    using Exiv2::Internal::BlobWriter;
+    using Exiv2::Internal::FileIdentity;
+    using Exiv2::Internal::fileIdentity;
+
+    //! Magic bytes at the start of a cache file, the digit is the revision of the format
+    const byte cacheMagic[] = { 'E', 'x', 'v', 'M', 'C', 'a', 'c', 'h', 'e', '2', '\n' };
+
+    //! Kinds of XMP values
+    enum XmpValueKind { xvText, xvArray, xvLangAlt, xvOther };
+
+    void encodeExif(BlobWriter& w, const ExifData& exifData, ByteOrder byteOrder)
+    {
+        w.put32(static_cast<uint32_t>(exifData.count()));
+        Blob buf;
+        for (ExifData::const_iterator md = exifData.begin(); md != exifData.end(); ++md) {
+            w.put16(md->tag());
+            w.putString(md->groupName());
+            w.put32(static_cast<uint32_t>(md->idx()));
+            // A CommentValue reports the type of its data, re-create it from its own type
+            TypeId typeId = md->typeId();
+            if (typeId != invalidTypeId && dynamic_cast<const CommentValue*>(&md->value())) typeId = comment;
+            w.put32(static_cast<uint32_t>(typeId));
+            buf.resize(md->size());
+            const long size = buf.empty() ? 0 : md->copy(&buf[0], byteOrder);
+            w.putBytes(buf.empty() ? 0 : &buf[0], size);
+            const DataBuf dataArea = md->dataArea();
+            w.putBytes(dataArea.pData_, dataArea.size_);
+        }
+    }
+
+    void decodeExif(BlobReader& r, ExifData& exifData, ByteOrder byteOrder)
+    {
+        for (uint32_t n = r.get32(); n > 0; --n) {
+            const uint16_t tag = r.get16();
+            ExifKey key(tag, r.getString());
+            key.setIdx(static_cast<int>(r.get32()));
+            const TypeId typeId = static_cast<TypeId>(r.get32());
+            uint32_t size = 0;
+            const byte* data = r.getBytes(size);
+            uint32_t dataAreaSize = 0;
+            const byte* dataArea = r.getBytes(dataAreaSize);
+            if (typeId == invalidTypeId) {
+                exifData.add(Exifdatum(key));
+                continue;
+            }
+            Value::UniquePtr value = Value::create(typeId);
+            value->read(data, size, byteOrder);
+            if (dataAreaSize > 0) value->setDataArea(dataArea, dataAreaSize);
+            exifData.add(key, std::move(value));
+        }
+    }
+
+    void encodeIptc(BlobWriter& w, const IptcData& iptcData)
+    {
+        w.put32(static_cast<uint32_t>(iptcData.count()));
+        Blob buf;
+        for (IptcData::const_iterator md = iptcData.begin(); md != iptcData.end(); ++md) {
+            w.put16(md->record());
+            w.put16(md->tag());
+            w.put32(static_cast<uint32_t>(md->typeId()));
+            buf.resize(md->size());
+            const long size = buf.empty() ? 0 : md->copy(&buf[0], bigEndian);
+            w.putBytes(buf.empty() ? 0 : &buf[0], size);
+        }
+    }
+
+    void decodeIptc(BlobReader& r, IptcData& iptcData)
+    {
+        for (uint32_t n = r.get32(); n > 0; --n) {
+            const uint16_t record = r.get16();
+            const uint16_t dataset = r.get16();
+            const TypeId typeId = static_cast<TypeId>(r.get32());
+            uint32_t size = 0;
+            const byte* data = r.getBytes(size);
+            Value::UniquePtr value = Value::create(typeId);
+            value->read(data, size, bigEndian);
+            iptcData.add(IptcKey(dataset, record), std::move(value));
+        }
+    }
+
+    void encodeXmp(BlobWriter& w, const XmpData& xmpData)
+    {
+        w.put32(static_cast<uint32_t>(xmpData.count()));
+        for (XmpData::const_iterator md = xmpData.begin(); md != xmpData.end(); ++md) {
+            const std::string prefix = md->groupName();
+            w.putString(prefix);
+            w.putString(XmpProperties::ns(prefix));
+            w.putString(md->tagName());
+            w.put32(static_cast<uint32_t>(md->typeId()));
+            const Value& value = md->value();
+            const XmpValue* xmpValue = dynamic_cast<const XmpValue*>(&value);
+            if (const XmpTextValue* text = dynamic_cast<const XmpTextValue*>(&value)) {
+                w.put8(xvText);
+                w.putString(text->value_);
+            }
+            else if (const XmpArrayValue* array = dynamic_cast<const XmpArrayValue*>(&value)) {
+                w.put8(xvArray);
+                w.put32(static_cast<uint32_t>(array->count()));
+                for (long i = 0; i < array->count(); ++i) w.putString(array->toString(i));
+            }
+            else if (const LangAltValue* langAlt = dynamic_cast<const LangAltValue*>(&value)) {
+                w.put8(xvLangAlt);
+                w.put32(static_cast<uint32_t>(langAlt->value_.size()));
+                for (LangAltValue::ValueType::const_iterator i = langAlt->value_.begin();
+                     i != langAlt->value_.end(); ++i) {
+                    w.putString(i->first);
+                    w.putString(i->second);
+                }
+            }
+            else {
+                w.put8(xvOther);
+                w.putString(value.toString());
+            }
+            w.put8(static_cast<byte>(xmpValue ? xmpValue->xmpArrayType() : XmpValue::xaNone));
+            w.put8(static_cast<byte>(xmpValue ? xmpValue->xmpStruct() : XmpValue::xsNone));
+        }
+    }
+
+    void decodeXmp(BlobReader& r, XmpData& xmpData)
+    {
+        for (uint32_t n = r.get32(); n > 0; --n) {
+            const std::string prefix = r.getString();
+            const std::string ns = r.getString();
+            const std::string property = r.getString();
+            const TypeId typeId = static_cast<TypeId>(r.get32());
+            // Namespaces which the parser registered are not known to a new process
+            if (XmpProperties::prefix(ns).empty()) XmpProperties::registerNs(ns, prefix);
+
+            Value::UniquePtr value;
+            switch (r.get8()) {
+            case xvText: {
+                XmpTextValue::UniquePtr text(new XmpTextValue);
+                text->value_ = r.getString();
+                value = std::move(text);
+                break;
+            }
+            case xvArray: {
+                XmpArrayValue::UniquePtr array(new XmpArrayValue(typeId));
+                for (uint32_t i = r.get32(); i > 0; --i) array->read(r.getString());
+                value = std::move(array);
+                break;
+            }
+            case xvLangAlt: {
+                LangAltValue::UniquePtr langAlt(new LangAltValue);
+                for (uint32_t i = r.get32(); i > 0; --i) {
+                    const std::string lang = r.getString();
+                    langAlt->value_[lang] = r.getString();
+                }
+                value = std::move(langAlt);
+                break;
+            }
+            case xvOther:
+                value = Value::create(typeId);
+                value->read(r.getString());
+                break;
+            default:
+                throw Error(kerCorruptedMetadata);
+            }
+            const XmpValue::XmpArrayType arrayType = static_cast<XmpValue::XmpArrayType>(r.get8());
+            const XmpValue::XmpStruct xmpStruct = static_cast<XmpValue::XmpStruct>(r.get8());
+            if (XmpValue* xmpValue = dynamic_cast<XmpValue*>(value.get())) {
+                xmpValue->setXmpArrayType(arrayType);
+                xmpValue->setXmpStruct(xmpStruct);
+            }
+            xmpData.add(XmpKey(prefix, property), std::move(value));
+        }
+    }
+
+    //! Write the header of a cache file: the magic bytes and the version of the library
+    void writeHeader(BasicIo& io)
+    {
+        Blob header(cacheMagic, cacheMagic + sizeof(cacheMagic));
+        BlobWriter w(header);
+        w.putString(versionString());
+        if (io.write(&header[0], static_cast<long>(header.size())) != static_cast<long>(header.size())) {
+            throw Error(kerImageWriteFailed);
+        }
+    }
+
+}
+
+// *****************************************************************************
+// class member definitions
+namespace Exiv2 {
+
+    //! Internal Pimpl structure of class MetadataCache.
+    struct MetadataCache::Impl {
+        //! An entry of the cache, its data is in the mapped cache file or in appended_
+        struct Entry {
+            FileIdentity identity_;             //!< Identity of the file when it was read
+            const byte*  data_;                 //!< Serialized metadata
+            size_t       size_;                 //!< Size of the serialized metadata
+        };
+
+        explicit Impl(const std::string& path);
+        /*!
+          @brief Read the entries of the mapped cache file, return false if it
+                 is not a valid cache file. \em valid is set to the size of the
+                 file up to the end of the last complete record.
+         */
+        bool load(size_t& valid);
+        //! Cut the cache file to its first \em size bytes and map it again
+        void truncate(size_t size);
+        //! Append an entry for \em path to the cache file and to the entries
+        void append(const std::string& path, const FileIdentity& identity, Blob& metadata);
+
+        std::string                            path_;      //!< Path of the cache file
+        FileIo                                 io_;        //!< Cache file, mapped to memory
+        const byte*                            mapped_;    //!< Mapped cache file, 0 if empty
+        std::unordered_map<std::string, Entry> entries_;   //!< Entries by image path
+        std::deque<Blob>                       appended_;  //!< Metadata appended since opening
+        long                                   hits_;      //!< Images read from the cache
+        long                                   misses_;    //!< Images read with readMetadata()
+    };
+
+    MetadataCache::Impl::Impl(const std::string& path)
+        : path_(path), io_(path), mapped_(0), hits_(0), misses_(0)
+    {
+        if (fileExists(path, true) && io_.open("rb") == 0) {
+            if (io_.size() > 0) mapped_ = io_.mmap();
+            size_t valid = 0;
+            if (load(valid)) {
+                // New records must not be appended after a damaged one
+                if (valid < io_.size()) truncate(valid);
+                return;
+            }
+            if (mapped_) io_.munmap();
+            mapped_ = 0;
+            io_.close();
+            entries_.clear();
+        }
+        // Start a new cache file
+        FileIo file(path);
+        if (file.open("wb") != 0) {
+            throw Error(kerFileOpenFailed, path, "wb", strError());
+        }
+        writeHeader(file);
+    }
+
+    bool MetadataCache::Impl::load(size_t& valid)
+    {
+        if (!mapped_) return false;
+        const size_t size = io_.size();
+        try {
+            if (size < sizeof(cacheMagic) || std::memcmp(mapped_, cacheMagic, sizeof(cacheMagic)) != 0) {
+                return false;
+            }
+            BlobReader r(mapped_ + sizeof(cacheMagic), size - sizeof(cacheMagic));
+            if (r.getString() != versionString()) return false;
+            valid = static_cast<size_t>(r.pos() - mapped_);
+            while (!r.atEnd()) {
+                uint32_t recordSize = 0;
+                const byte* record = r.getBytes(recordSize);
+                BlobReader rr(record, recordSize);
+                const std::string path = rr.getString();
+                Entry entry;
+                entry.identity_ = rr.getIdentity();
+                entry.data_ = rr.pos();
+                entry.size_ = rr.left();
+                entries_[path] = entry;
+                valid = static_cast<size_t>(r.pos() - mapped_);
+            }
+        }
+        catch (const AnyError&) {
+            // A truncated last record, e.g., after a crash while appending, is dropped
+        }
+        return valid >= sizeof(cacheMagic);
+    }
+
+    void MetadataCache::Impl::truncate(size_t size)
+    {
+        // The entries point into the mapping, keep them in appended_
+        Blob head(mapped_, mapped_ + size);
+        for (std::unordered_map<std::string, Entry>::iterator i = entries_.begin(); i != entries_.end(); ++i) {
+            appended_.push_back(Blob(i->second.data_, i->second.data_ + i->second.size_));
+            i->second.data_ = appended_.back().empty() ? 0 : &appended_.back()[0];
+        }
+        io_.munmap();
+        mapped_ = 0;
+        io_.close();
+        FileIo file(path_);
+        if (file.open("wb") != 0) {
+            throw Error(kerFileOpenFailed, path_, "wb", strError());
+        }
+        if (file.write(&head[0], static_cast<long>(head.size())) != static_cast<long>(head.size())) {
+            throw Error(kerImageWriteFailed);
+        }
+    }
+
+    void MetadataCache::Impl::append(const std::string& path, const FileIdentity& identity, Blob& metadata)
+    {
+        Blob record;
+        BlobWriter w(record);
+        w.putString(path);
+        w.putIdentity(identity);
+        record.insert(record.end(), metadata.begin(), metadata.end());
+
+        Blob data;
+        BlobWriter(data).putBytes(&record[0], record.size());
+        FileIo file(path_);
+        if (file.open("ab") != 0) {
+            throw Error(kerFileOpenFailed, path_, "ab", strError());
+        }
+        if (file.write(&data[0], static_cast<long>(data.size())) != static_cast<long>(data.size())) {
+            throw Error(kerImageWriteFailed);
+        }
+        appended_.push_back(Blob());
+        appended_.back().swap(metadata);
+        Entry entry;
+        entry.identity_ = identity;
+        entry.data_ = appended_.back().empty() ? 0 : &appended_.back()[0];
+        entry.size_ = appended_.back().size();
+        entries_[path] = entry;
+    }
+
+    MetadataCache::MetadataCache(const std::string& path)
+        : p_(new Impl(path))
+    {
+    }
+
+    MetadataCache::~MetadataCache()
+    {
+        if (p_->mapped_) {
+            try {
+                p_->io_.munmap();
+            }
+            catch (const AnyError&) {
+                // Nothing to do, the mapping is released with the file
+            }
+        }
+    }
+
+    bool MetadataCache::readMetadata(Image& image)
+    {
+        const std::string path = image.io().path();
+        FileIdentity identity;
+        if (   dynamic_cast<FileIo*>(&image.io()) == 0
+            || !image.exifData().decodeFilter().empty()
+            || !image.iptcData().decodeFilter().empty()
+            || !image.xmpData().decodeFilter().empty()
+            || !fileIdentity(path, identity)) {
+            image.readMetadata();
+            ++p_->misses_;
+            return false;
+        }
+
+        std::unordered_map<std::string, Impl::Entry>::const_iterator entry = p_->entries_.find(path);
+        if (entry != p_->entries_.end() && entry->second.identity_ == identity) {
+            try {
+                BlobReader r(entry->second.data_, entry->second.size_);
+                ExifData exifData;
+                IptcData iptcData;
+                XmpData xmpData;
+                const int pixelWidth = static_cast<int>(r.get32());
+                const int pixelHeight = static_cast<int>(r.get32());
+                const ByteOrder byteOrder = static_cast<ByteOrder>(r.get16());
+                std::string comment = r.getString();
+                std::string xmpPacket = r.getString();
+                uint32_t iccSize = 0;
+                const byte* icc = r.getBytes(iccSize);
+                decodeExif(r, exifData, byteOrder == invalidByteOrder ? littleEndian : byteOrder);
+                decodeIptc(r, iptcData);
+                decodeXmp(r, xmpData);
+                NativePreviewList previews;
+                for (uint32_t n = r.get32(); n > 0; --n) {
+                    NativePreview preview;
+                    preview.position_ = static_cast<long>(r.get64());
+                    preview.size_ = r.get32();
+                    preview.width_ = r.get32();
+                    preview.height_ = r.get32();
+                    preview.filter_ = r.getString();
+                    preview.mimeType_ = r.getString();
+                    previews.push_back(preview);
+                }
+
+                image.clearMetadata();
+                image.exifData_ = exifData;
+                image.iptcData_ = iptcData;
+                image.xmpData_ = xmpData;
+                image.comment_.swap(comment);
+                image.xmpPacket_.swap(xmpPacket);
+                image.iccProfile_.alloc(iccSize);
+                if (iccSize > 0) std::memcpy(image.iccProfile_.pData_, icc, iccSize);
+                image.pixelWidth_ = pixelWidth;
+                image.pixelHeight_ = pixelHeight;
+                image.setByteOrder(byteOrder);
+                image.nativePreviews_.swap(previews);
+                ++p_->hits_;
+                return true;
+            }
+            catch (const AnyError&) {
+                // A damaged entry, read the image and replace it
+            }
+        }
+
+        image.readMetadata();
+        ++p_->misses_;
+
+        Blob metadata;
+        BlobWriter w(metadata);
+        const Image& constImage = image;
+        w.put32(static_cast<uint32_t>(constImage.pixelWidth()));
+        w.put32(static_cast<uint32_t>(constImage.pixelHeight()));
+        w.put16(static_cast<uint16_t>(constImage.byteOrder()));
+        w.putString(constImage.comment());
+        w.putString(constImage.xmpPacket());
+        // Some images load the profile on first access
+        const DataBuf* iccProfile = image.iccProfile();
+        w.putBytes(iccProfile->pData_, iccProfile->size_);
+        const ByteOrder byteOrder = constImage.byteOrder();
+        encodeExif(w, constImage.exifData(), byteOrder == invalidByteOrder ? littleEndian : byteOrder);
+        encodeIptc(w, constImage.iptcData());
+        encodeXmp(w, constImage.xmpData());
+        const NativePreviewList& previews = constImage.nativePreviews();
+        w.put32(static_cast<uint32_t>(previews.size()));
+        for (NativePreviewList::const_iterator preview = previews.begin(); preview != previews.end(); ++preview) {
+            w.put64(static_cast<uint64_t>(preview->position_));
+            w.put32(preview->size_);
+            w.put32(preview->width_);
+            w.put32(preview->height_);
+            w.putString(preview->filter_);
+            w.putString(preview->mimeType_);
+        }
+        p_->append(path, identity, metadata);
+        return false;
+    }
+
+    long MetadataCache::size() const
+    {
+        return static_cast<long>(p_->entries_.size());
+    }
+
+    long MetadataCache::hits() const
+    {
+        return p_->hits_;
+    }
+
+    long MetadataCache::misses() const
+    {
+        return p_->misses_;
+    }
+
+}                                       // namespace Exiv2
@@ -27,6 +27,7 @@
 // *****************************************************************************
 // included header files
 #include "metadatum.hpp"
+#include "error.hpp"
 
 // + standard includes
 #include <iostream>
@@ -51,6 +52,87 @@ namespace Exiv2 {
         return *this;
     }
 
+    DecodeFilter& DecodeFilter::addFamily(const std::string& familyName)
+    {
+        families_.insert(familyName);
+        return *this;
+    }
+
+    DecodeFilter& DecodeFilter::addGroup(const std::string& familyName, const std::string& groupName)
+    {
+        groups_.insert(familyName + "." + groupName);
+        return *this;
+    }
+
+    DecodeFilter& DecodeFilter::addKey(const std::string& key)
+    {
+        // Family and group are the first two dot-separated parts of the key
+        const std::string::size_type p1 = key.find('.');
+        const std::string::size_type p2 = p1 == std::string::npos ? p1 : key.find('.', p1 + 1);
+        if (p1 == 0 || p2 == std::string::npos || p2 == p1 + 1 || p2 + 1 == key.size()) {
+            throw Error(kerInvalidKey, key);
+        }
+        keyGroups_.insert(key.substr(0, p2));
+        keys_.insert(key);
+        return *this;
+    }
+
+    void DecodeFilter::clear()
+    {
+        families_.clear();
+        groups_.clear();
+        keyGroups_.clear();
+        keys_.clear();
+    }
+
+    bool DecodeFilter::empty() const
+    {
+        return families_.empty() && groups_.empty() && keys_.empty();
+    }
+
+    bool DecodeFilter::hasKeysOnly() const
+    {
+        return families_.empty() && groups_.empty() && !keys_.empty();
+    }
+
+    const std::set<std::string>& DecodeFilter::keys() const
+    {
+        return keys_;
+    }
+
+    bool DecodeFilter::acceptsGroup(const std::string& familyName, const std::string& groupName) const
+    {
+        if (empty() || families_.count(familyName) > 0) return true;
+        const std::string group = familyName + "." + groupName;
+        return groups_.count(group) > 0 || keyGroups_.count(group) > 0;
+    }
+
+    bool DecodeFilter::accepts(const Key& key) const
+    {
+        if (empty()) return true;
+        const std::string familyName = key.familyName();
+        if (families_.count(familyName) > 0) return true;
+        const std::string group = familyName + "." + key.groupName();
+        if (groups_.count(group) > 0) return true;
+        if (keyGroups_.count(group) == 0) return false;
+
+        const std::string k = key.key();
+        if (keys_.count(k) > 0) return true;
+        // Structure and array fields: accept the children of an accepted key
+        // and the parents which lead to one
+        const std::string prefix = group + ".";
+        for (std::set<std::string>::const_iterator i = keys_.lower_bound(prefix);
+             i != keys_.end() && i->compare(0, prefix.size(), prefix) == 0; ++i) {
+            const std::string& shorter = i->size() < k.size() ? *i : k;
+            const std::string& longer  = i->size() < k.size() ? k : *i;
+            if (   longer.compare(0, shorter.size(), shorter) == 0
+                && (longer[shorter.size()] == '[' || longer[shorter.size()] == '/')) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     Metadatum::Metadatum()
     {
     }
@@ -70,9 +152,10 @@ namespace Exiv2 {
 
     std::string Metadatum::print(const ExifData* pMetadata) const
     {
-        std::ostringstream os;
-        write(os, pMetadata);
-        return os.str();
+        std::string str;
+        StringWriter writer(str);
+        write(writer.stream(), pMetadata);
+        return str;
     }
 
     bool cmpMetadataByTag(const Metadatum& lhs, const Metadatum& rhs)
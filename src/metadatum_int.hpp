@@ -0,0 +1,129 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    metadatum_int.hpp
+  @brief   Internal helpers for the metadata containers
+ */
+#ifndef METADATUM_INT_HPP_
+#define METADATUM_INT_HPP_
+
+// *****************************************************************************
+// included header files
+#include "types.hpp"
+#include "value.hpp"
+
+// + standard includes
+#include <algorithm>
+#include <list>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+    namespace Internal {
+
+// *****************************************************************************
+// template, inline and free functions
+
+    /*!
+      @brief Return the positions of the metadata in [\em begin, \em end)
+             stably sorted by the key which \em sortKey returns for each of
+             them. The keys are computed once per metadatum rather than for
+             each comparison, and the metadata themselves are not moved.
+     */
+    template<typename Iterator, typename SortKey>
+    std::vector<Iterator> sortedPositions(Iterator begin, Iterator end, SortKey sortKey)
+    {
+        typedef typename std::decay<decltype(sortKey(*begin))>::type Key;
+        typedef std::pair<Key, Iterator> Entry;
+        std::vector<Entry> entries;
+        entries.reserve(std::distance(begin, end));
+        for (Iterator i = begin; i != end; ++i) {
+            entries.push_back(Entry(sortKey(*i), i));
+        }
+        std::stable_sort(entries.begin(), entries.end(),
+                         [](const Entry& lhs, const Entry& rhs) { return lhs.first < rhs.first; });
+        std::vector<Iterator> positions;
+        positions.reserve(entries.size());
+        for (typename std::vector<Entry>::const_iterator e = entries.begin(); e != entries.end(); ++e) {
+            positions.push_back(e->second);
+        }
+        return positions;
+    }
+
+    /*!
+      @brief Sort the metadata of the vector \em metadata by the key which
+             \em sortKey returns for each of them, see sortedPositions().
+     */
+    template<typename Metadata, typename SortKey>
+    void sortMetadata(Metadata& metadata, SortKey sortKey)
+    {
+        const std::vector<typename Metadata::iterator> positions =
+            sortedPositions(metadata.begin(), metadata.end(), sortKey);
+        Metadata sorted;
+        sorted.reserve(positions.size());
+        for (size_t i = 0; i < positions.size(); ++i) {
+            sorted.push_back(std::move(*positions[i]));
+        }
+        metadata.swap(sorted);
+    }
+
+    /*!
+      @brief Sort the metadata of the list \em metadata by the key which
+             \em sortKey returns for each of them, see sortedPositions().
+             The list nodes are relinked, iterators remain valid.
+     */
+    template<typename T, typename Allocator, typename SortKey>
+    void sortMetadata(std::list<T, Allocator>& metadata, SortKey sortKey)
+    {
+        const std::vector<typename std::list<T, Allocator>::iterator> positions =
+            sortedPositions(metadata.begin(), metadata.end(), sortKey);
+        for (size_t i = 0; i < positions.size(); ++i) {
+            metadata.splice(metadata.end(), metadata, positions[i]);
+        }
+    }
+
+    //! Return an estimate of the heap memory of the nodes and buckets of the hash map \em map
+    template<typename Map>
+    uint64_t hashMapMemory(const Map& map)
+    {
+        return map.size() * (sizeof(typename Map::value_type) + sizeof(void*))
+             + map.bucket_count() * sizeof(void*);
+    }
+
+    /*!
+      @brief Add an estimate of the heap memory of the key and the value of
+             \em datum to \em usage, for a key object of \em keySize bytes.
+             The datum object itself is not added.
+     */
+    template<typename Datum>
+    void addDatumMemory(MemoryUsage& usage, const Datum& datum, size_t keySize)
+    {
+        usage.keys_ += keySize + datum.key().size();
+        if (datum.typeId() != invalidTypeId) {
+            usage.values_ += sizeof(Value) + datum.size();
+        }
+    }
+
+}}                                      // namespace Internal, Exiv2
+
+#endif                                  // #ifndef METADATUM_INT_HPP_
@@ -0,0 +1,144 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+  File:      metadiff.cpp
+ */
+// *****************************************************************************
+// included header files
+#include "config.h"
+
+#include "metadiff.hpp"
+#include "exif.hpp"
+#include "iptc.hpp"
+#include "xmp_exiv2.hpp"
+
+// + standard includes
+#include <map>
+#include <utility>
+
+// *****************************************************************************
+// local declarations
+namespace {
+
+    using namespace Exiv2;
+
+    //! Return the numeric key of an Exif datum, its IFD and tag
+    uint32_t datumKey(const Exifdatum& md)
+    {
+        return static_cast<uint32_t>(md.ifdId()) << 16 | md.tag();
+    }
+
+    //! Return the numeric key of an IPTC datum, its record and dataset
+    uint32_t datumKey(const Iptcdatum& md)
+    {
+        return static_cast<uint32_t>(md.record()) << 16 | md.tag();
+    }
+
+    //! Return the key of an XMP datum, which has no numeric key
+    std::string datumKey(const Xmpdatum& md)
+    {
+        return md.key();
+    }
+
+    //! Return true if the Exif or IPTC values of \em a and \em b are equal
+    bool sameValue(const Metadatum& a, const Metadatum& b)
+    {
+        if (a.typeId() != b.typeId() || a.count() != b.count() || a.size() != b.size()) return false;
+        if (a.size() == 0) return true;
+        Blob va(a.size());
+        Blob vb(b.size());
+        a.value().copy(&va[0], littleEndian);
+        b.value().copy(&vb[0], littleEndian);
+        return va == vb;
+    }
+
+    //! Return true if the XMP values of \em a and \em b are equal
+    bool sameValue(const Xmpdatum& a, const Xmpdatum& b)
+    {
+        return a.typeId() == b.typeId() && a.count() == b.count() && a.toString() == b.toString();
+    }
+
+    //! Add the changes from \em before to \em after to \em changes
+    template <typename Data>
+    void compareData(const Data& before, const Data& after, MetadataId metadataId, MetadataDiff::Changes& changes)
+    {
+        typedef typename Data::const_iterator Iterator;
+        typedef decltype(datumKey(*before.begin())) Key;
+        typedef std::pair<Key, int> Occurrence;
+
+        // Datums of before by key and occurrence of the key
+        std::map<Occurrence, Iterator> index;
+        std::map<Key, int> count;
+        for (Iterator i = before.begin(); i != before.end(); ++i) {
+            const Key key = datumKey(*i);
+            index.insert(std::make_pair(Occurrence(key, count[key]++), i));
+        }
+        count.clear();
+        for (Iterator i = after.begin(); i != after.end(); ++i) {
+            const Key key = datumKey(*i);
+            typename std::map<Occurrence, Iterator>::iterator pos = index.find(Occurrence(key, count[key]++));
+            if (pos == index.end()) {
+                MetadataDiff::Change change = { metadataId, MetadataDiff::added, i->key(), false };
+                changes.push_back(change);
+                continue;
+            }
+            const Iterator old = pos->second;
+            index.erase(pos);
+            if (sameValue(*old, *i)) continue;
+            const bool sameSize = old->typeId() == i->typeId() && old->size() == i->size();
+            MetadataDiff::Change change = { metadataId, MetadataDiff::modified, i->key(), sameSize };
+            changes.push_back(change);
+        }
+        for (typename std::map<Occurrence, Iterator>::const_iterator i = index.begin(); i != index.end(); ++i) {
+            MetadataDiff::Change change = { metadataId, MetadataDiff::removed, i->second->key(), false };
+            changes.push_back(change);
+        }
+    }
+
+}
+
+// *****************************************************************************
+// class member definitions
+namespace Exiv2 {
+
+    void MetadataDiff::compare(const ExifData& before, const ExifData& after)
+    {
+        compareData(before, after, mdExif, changes_);
+    }
+
+    void MetadataDiff::compare(const IptcData& before, const IptcData& after)
+    {
+        compareData(before, after, mdIptc, changes_);
+    }
+
+    void MetadataDiff::compare(const XmpData& before, const XmpData& after)
+    {
+        compareData(before, after, mdXmp, changes_);
+    }
+
+    bool MetadataDiff::fixedSize() const
+    {
+        for (Changes::const_iterator i = changes_.begin(); i != changes_.end(); ++i) {
+            if (i->type_ != modified || !i->sameSize_) return false;
+        }
+        return true;
+    }
+
+}                                       // namespace Exiv2
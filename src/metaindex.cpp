@@ -0,0 +1,492 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+  File:      metaindex.cpp
+ */
+// *****************************************************************************
+// included header files
+#include "config.h"
+
+#include "metaindex.hpp"
+#include "basicio.hpp"
+#include "error.hpp"
+#include "exif.hpp"
+#include "futils.hpp"
+#include "image.hpp"
+#include "image_int.hpp"
+#include "iptc.hpp"
+#include "version.hpp"
+#include "xmp_exiv2.hpp"
+
+// + standard includes
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+// *****************************************************************************
+// local declarations
+namespace {
+
+    using namespace Exiv2;
+    using Exiv2::Internal::BlobReader;
+    using Exiv2::Internal::BlobWriter;
+    using Exiv2::Internal::FileIdentity;
+    using Exiv2::Internal::fileIdentity;
+
+    //! Magic bytes at the start of an index file, the digit is the revision of the format
+    const byte indexMagic[] = { 'E', 'x', 'v', 'M', 'I', 'n', 'd', 'e', 'x', '2', '\n' };
+
+    //! Return \em key in the form of Key::key(), throw if it is not a valid key
+    std::string normalizedKey(const std::string& key)
+    {
+        const std::string family = key.substr(0, key.find('.'));
+        if (family == "Exif") return ExifKey(key).key();
+        if (family == "Iptc") return IptcKey(key).key();
+        if (family == "Xmp") return XmpKey(key).key();
+        throw Error(kerInvalidKey, key);
+    }
+
+    //! Append the interpreted values of the datums with key \em key in \em container to \em values
+    template<typename Container>
+    void datumValues(std::vector<std::string>& values,
+                     const Container& container,
+                     const std::string& key,
+                     const ExifData* exifData)
+    {
+        for (typename Container::const_iterator md = container.begin(); md != container.end(); ++md) {
+            if (md->key() == key) values.push_back(md->print(exifData));
+        }
+    }
+
+}
+
+// *****************************************************************************
+// class member definitions
+namespace Exiv2 {
+
+    //! Internal Pimpl structure of class MetadataIndex.
+    struct MetadataIndex::Impl {
+        //! A row of the index
+        struct Row {
+            std::string path_;                  //!< Path of the file
+            FileIdentity identity_;             //!< Identity of the file when it was read
+        };
+        //! The values of a key, the values of row i are values_[start_[i]] to values_[start_[i + 1]]
+        struct Column {
+            std::string key_;                   //!< Key of the column
+            const byte* data_;                  //!< Values in the mapped index file, 0 once loaded
+            size_t size_;                       //!< Size of the values in the mapped index file
+            std::vector<uint32_t> start_;       //!< First value of each row, and the end
+            std::vector<std::string> values_;   //!< Values of all rows
+        };
+
+        explicit Impl(const std::string& path);
+        //! Read the rows and the column directory of the mapped index file, false if it is not valid
+        bool load();
+        //! Release the mapped index file
+        void unmap();
+        //! Return the column of \em key, loaded, throw if there is none
+        Column& column(const std::string& key);
+        //! Read the values of column \em col from the mapped index file
+        void loadColumn(Column& col);
+
+        std::string path_;                      //!< Path of the index file
+        FileIo io_;                             //!< Index file, mapped to memory
+        const byte* mapped_;                    //!< Mapped index file, 0 if not mapped
+        std::vector<std::string> keys_;         //!< Keys of the columns
+        std::vector<Row> rows_;                 //!< Rows, sorted by path
+        std::vector<Column> columns_;           //!< Columns, in the order of the keys
+        long read_;                             //!< Files read by the last update
+        long unchanged_;                        //!< Rows kept by the last update
+        long removed_;                          //!< Rows removed by the last update
+    };
+
+    MetadataIndex::Impl::Impl(const std::string& path)
+        : path_(path), io_(path), mapped_(0), read_(0), unchanged_(0), removed_(0)
+    {
+        if (fileExists(path, true) && io_.open("rb") == 0) {
+            if (io_.size() > 0) mapped_ = io_.mmap();
+            if (load()) return;
+            unmap();
+            keys_.clear();
+            rows_.clear();
+            columns_.clear();
+        }
+    }
+
+    bool MetadataIndex::Impl::load()
+    {
+        if (!mapped_) return false;
+        const size_t size = io_.size();
+        try {
+            if (size < sizeof(indexMagic) || std::memcmp(mapped_, indexMagic, sizeof(indexMagic)) != 0) {
+                return false;
+            }
+            BlobReader r(mapped_ + sizeof(indexMagic), size - sizeof(indexMagic));
+            if (r.getString() != versionString()) return false;
+            const uint32_t rowCount = r.get32();
+            const uint32_t columnCount = r.get32();
+            for (uint32_t i = 0; i < columnCount; ++i) {
+                Column col;
+                col.key_ = r.getString();
+                const uint64_t offset = r.get64();
+                col.size_ = static_cast<size_t>(r.get64());
+                if (offset > size || col.size_ > size - offset) return false;
+                col.data_ = mapped_ + offset;
+                keys_.push_back(col.key_);
+                columns_.push_back(col);
+            }
+            rows_.resize(rowCount);
+            for (uint32_t i = 0; i < rowCount; ++i) {
+                rows_[i].path_ = r.getString();
+                rows_[i].identity_ = r.getIdentity();
+            }
+        }
+        catch (const AnyError&) {
+            return false;
+        }
+        return true;
+    }
+
+    void MetadataIndex::Impl::unmap()
+    {
+        if (mapped_) {
+            try {
+                io_.munmap();
+            }
+            catch (const AnyError&) {
+                // Nothing to do, the mapping is released with the file
+            }
+        }
+        mapped_ = 0;
+        io_.close();
+    }
+
+    MetadataIndex::Impl::Column& MetadataIndex::Impl::column(const std::string& key)
+    {
+        const std::string normalized = normalizedKey(key);
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            if (columns_[i].key_ == normalized) {
+                if (columns_[i].data_) loadColumn(columns_[i]);
+                return columns_[i];
+            }
+        }
+        throw Error(kerErrorMessage, "Key " + normalized + " is not in the index");
+    }
+
+    void MetadataIndex::Impl::loadColumn(Column& col)
+    {
+        BlobReader r(col.data_, col.size_);
+        col.start_.reserve(rows_.size() + 1);
+        for (size_t i = 0; i < rows_.size(); ++i) {
+            col.start_.push_back(static_cast<uint32_t>(col.values_.size()));
+            for (uint32_t n = r.get32(); n > 0; --n) col.values_.push_back(r.getString());
+        }
+        col.start_.push_back(static_cast<uint32_t>(col.values_.size()));
+        col.data_ = 0;
+        col.size_ = 0;
+    }
+
+    MetadataIndex::MetadataIndex(const std::string& path)
+        : p_(new Impl(path))
+    {
+    }
+
+    MetadataIndex::~MetadataIndex()
+    {
+        p_->unmap();
+    }
+
+    void MetadataIndex::setKeys(const std::vector<std::string>& keys)
+    {
+        std::vector<std::string> normalized;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            const std::string key = normalizedKey(keys[i]);
+            if (std::find(normalized.begin(), normalized.end(), key) == normalized.end()) {
+                normalized.push_back(key);
+            }
+        }
+        if (normalized == p_->keys_) return;
+        p_->keys_ = normalized;
+        p_->rows_.clear();
+        p_->columns_.clear();
+        for (size_t i = 0; i < normalized.size(); ++i) {
+            Impl::Column col;
+            col.key_ = normalized[i];
+            col.data_ = 0;
+            col.size_ = 0;
+            col.start_.push_back(0);
+            p_->columns_.push_back(col);
+        }
+    }
+
+    BatchProcessor::Results MetadataIndex::update(const BatchProcessor::PathSource& source, unsigned int threads)
+    {
+        for (size_t c = 0; c < p_->columns_.size(); ++c) {
+            if (p_->columns_[c].data_) p_->loadColumn(p_->columns_[c]);
+        }
+        std::unordered_map<std::string, size_t> rowByPath;
+        for (size_t i = 0; i < p_->rows_.size(); ++i) rowByPath[p_->rows_[i].path_] = i;
+        std::vector<bool> visited(p_->rows_.size(), false);
+        std::vector<bool> keep(p_->rows_.size(), false);
+        p_->read_ = 0;
+        p_->unchanged_ = 0;
+        p_->removed_ = 0;
+
+        // Unchanged files are not passed on to the batch. The identity of a
+        // changed file is taken before it is read, so that a write during the
+        // read leaves an identity which no longer matches.
+        std::unordered_map<std::string, FileIdentity> identities;
+        std::mutex mutex;
+        const BatchProcessor::PathSource changed = [&](std::string& path) {
+            while (source(path)) {
+                std::unordered_map<std::string, size_t>::const_iterator row = rowByPath.find(path);
+                if (row != rowByPath.end()) {
+                    if (visited[row->second]) continue;
+                    visited[row->second] = true;
+                }
+                FileIdentity identity;
+                if (!fileIdentity(path, identity)) return true;
+                if (row != rowByPath.end() && identity == p_->rows_[row->second].identity_) {
+                    keep[row->second] = true;
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                identities[path] = identity;
+                return true;
+            }
+            return false;
+        };
+
+        struct ReadRow {
+            FileIdentity identity_;
+            std::vector<std::vector<std::string> > values_;
+        };
+        std::unordered_map<std::string, ReadRow> readRows;
+        const std::vector<std::string>& keys = p_->keys_;
+        const BatchProcessor::Callback callback = [&](Image& image) {
+            ReadRow row;
+            const std::string path = image.io().path();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::unordered_map<std::string, FileIdentity>::const_iterator i = identities.find(path);
+                if (i == identities.end()) throw Error(kerDataSourceOpenFailed, path, strError());
+                row.identity_ = i->second;
+            }
+            const Image& constImage = image;
+            const ExifData& exifData = constImage.exifData();
+            row.values_.resize(keys.size());
+            for (size_t k = 0; k < keys.size(); ++k) {
+                const std::string& key = keys[k];
+                if (key.compare(0, 5, "Exif.") == 0) datumValues(row.values_[k], exifData, key, &exifData);
+                else if (key.compare(0, 5, "Iptc.") == 0) datumValues(row.values_[k], constImage.iptcData(), key, &exifData);
+                else datumValues(row.values_[k], constImage.xmpData(), key, &exifData);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            readRows[path] = std::move(row);
+        };
+
+        BatchProcessor batch(threads);
+        DecodeFilter filter;
+        for (size_t k = 0; k < keys.size(); ++k) filter.addKey(keys[k]);
+        batch.setDecodeFilter(filter);
+        const BatchProcessor::Results results = batch.run(changed, callback);
+
+        // Rows of files which were not visited are kept while their file does not change
+        for (size_t i = 0; i < p_->rows_.size(); ++i) {
+            if (visited[i]) continue;
+            FileIdentity identity;
+            keep[i] = fileIdentity(p_->rows_[i].path_, identity) && identity == p_->rows_[i].identity_;
+        }
+
+        // Merge the kept rows and the rows read, sorted by path
+        std::vector<std::pair<std::string, long> > order;
+        for (size_t i = 0; i < p_->rows_.size(); ++i) {
+            if (keep[i]) {
+                order.push_back(std::make_pair(p_->rows_[i].path_, static_cast<long>(i)));
+                ++p_->unchanged_;
+            }
+            else if (readRows.find(p_->rows_[i].path_) == readRows.end()) {
+                ++p_->removed_;
+            }
+        }
+        for (std::unordered_map<std::string, ReadRow>::const_iterator i = readRows.begin(); i != readRows.end(); ++i) {
+            order.push_back(std::make_pair(i->first, -1L));
+        }
+        std::sort(order.begin(), order.end());
+        p_->read_ = static_cast<long>(readRows.size());
+
+        std::vector<Impl::Row> rows;
+        rows.reserve(order.size());
+        std::vector<Impl::Column> columns(p_->columns_.size());
+        for (size_t c = 0; c < columns.size(); ++c) {
+            columns[c].key_ = p_->columns_[c].key_;
+            columns[c].data_ = 0;
+            columns[c].size_ = 0;
+        }
+        for (size_t i = 0; i < order.size(); ++i) {
+            Impl::Row row;
+            row.path_ = order[i].first;
+            const ReadRow* readRow = order[i].second < 0 ? &readRows[row.path_] : 0;
+            row.identity_ = readRow ? readRow->identity_ : p_->rows_[order[i].second].identity_;
+            rows.push_back(row);
+            for (size_t c = 0; c < columns.size(); ++c) {
+                Impl::Column& col = columns[c];
+                col.start_.push_back(static_cast<uint32_t>(col.values_.size()));
+                if (readRow) {
+                    col.values_.insert(col.values_.end(), readRow->values_[c].begin(), readRow->values_[c].end());
+                    continue;
+                }
+                const Impl::Column& old = p_->columns_[c];
+                col.values_.insert(col.values_.end(),
+                                   old.values_.begin() + old.start_[order[i].second],
+                                   old.values_.begin() + old.start_[order[i].second + 1]);
+            }
+        }
+        for (size_t c = 0; c < columns.size(); ++c) {
+            columns[c].start_.push_back(static_cast<uint32_t>(columns[c].values_.size()));
+        }
+        p_->rows_.swap(rows);
+        p_->columns_.swap(columns);
+        return results;
+    }
+
+    void MetadataIndex::write()
+    {
+        for (size_t c = 0; c < p_->columns_.size(); ++c) {
+            if (p_->columns_[c].data_) p_->loadColumn(p_->columns_[c]);
+        }
+        p_->unmap();
+
+        Blob rows;
+        BlobWriter rw(rows);
+        for (size_t i = 0; i < p_->rows_.size(); ++i) {
+            const Impl::Row& row = p_->rows_[i];
+            rw.putString(row.path_);
+            rw.putIdentity(row.identity_);
+        }
+        std::vector<Blob> columns(p_->columns_.size());
+        for (size_t c = 0; c < columns.size(); ++c) {
+            const Impl::Column& col = p_->columns_[c];
+            BlobWriter cw(columns[c]);
+            for (size_t i = 0; i < p_->rows_.size(); ++i) {
+                cw.put32(col.start_[i + 1] - col.start_[i]);
+                for (uint32_t v = col.start_[i]; v < col.start_[i + 1]; ++v) cw.putString(col.values_[v]);
+            }
+        }
+
+        Blob header(indexMagic, indexMagic + sizeof(indexMagic));
+        BlobWriter w(header);
+        w.putString(versionString());
+        w.put32(static_cast<uint32_t>(p_->rows_.size()));
+        w.put32(static_cast<uint32_t>(columns.size()));
+        // The columns follow the directory and the rows
+        uint64_t offset = header.size() + rows.size();
+        for (size_t c = 0; c < columns.size(); ++c) offset += 4 + p_->columns_[c].key_.size() + 16;
+        for (size_t c = 0; c < columns.size(); ++c) {
+            w.putString(p_->columns_[c].key_);
+            w.put64(offset);
+            w.put64(columns[c].size());
+            offset += columns[c].size();
+        }
+
+        // The new index replaces the old one with a rename, a reader never sees half of it
+        const std::string tempPath = createTempFile(p_->path_);
+        if (tempPath.empty()) {
+            throw Error(kerFileOpenFailed, p_->path_ + ".XXXXXX", "wb", strError());
+        }
+        FileIo file(tempPath);
+        bool ok = file.open("wb") == 0;
+        if (ok) {
+            ok = file.write(&header[0], static_cast<long>(header.size())) == static_cast<long>(header.size());
+        }
+        if (ok && !rows.empty()) {
+            ok = file.write(&rows[0], static_cast<long>(rows.size())) == static_cast<long>(rows.size());
+        }
+        for (size_t c = 0; ok && c < columns.size(); ++c) {
+            if (columns[c].empty()) continue;
+            ok = file.write(&columns[c][0], static_cast<long>(columns[c].size())) == static_cast<long>(columns[c].size());
+        }
+        if (file.close() != 0) ok = false;
+#if defined(_WIN32)
+        if (ok) std::remove(p_->path_.c_str());
+#endif
+        if (!ok || std::rename(tempPath.c_str(), p_->path_.c_str()) != 0) {
+            std::remove(tempPath.c_str());
+            throw Error(kerImageWriteFailed);
+        }
+    }
+
+    const std::vector<std::string>& MetadataIndex::keys() const
+    {
+        return p_->keys_;
+    }
+
+    size_t MetadataIndex::size() const
+    {
+        return p_->rows_.size();
+    }
+
+    const std::string& MetadataIndex::path(size_t row) const
+    {
+        return p_->rows_.at(row).path_;
+    }
+
+    std::vector<std::string> MetadataIndex::values(size_t row, const std::string& key) const
+    {
+        const Impl::Column& col = p_->column(key);
+        if (row >= p_->rows_.size()) throw Error(kerErrorMessage, "Row out of range");
+        return std::vector<std::string>(col.values_.begin() + col.start_[row],
+                                        col.values_.begin() + col.start_[row + 1]);
+    }
+
+    std::vector<size_t> MetadataIndex::find(const std::string& key, const std::string& value) const
+    {
+        const Impl::Column& col = p_->column(key);
+        std::vector<size_t> rows;
+        for (size_t i = 0; i < p_->rows_.size(); ++i) {
+            for (uint32_t v = col.start_[i]; v < col.start_[i + 1]; ++v) {
+                if (col.values_[v] == value) {
+                    rows.push_back(i);
+                    break;
+                }
+            }
+        }
+        return rows;
+    }
+
+    long MetadataIndex::read() const
+    {
+        return p_->read_;
+    }
+
+    long MetadataIndex::unchanged() const
+    {
+        return p_->unchanged_;
+    }
+
+    long MetadataIndex::removed() const
+    {
+        return p_->removed_;
+    }
+
+}                                       // namespace Exiv2
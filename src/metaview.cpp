@@ -0,0 +1,440 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+  File:      metaview.cpp
+ */
+// *****************************************************************************
+// included header files
+#include "config.h"
+
+#include "metaview.hpp"
+#include "error.hpp"
+#include "exif.hpp"
+#include "iptc.hpp"
+#include "xmp_exiv2.hpp"
+
+// + standard includes
+#include <cstring>
+#include <map>
+#include <vector>
+
+// *****************************************************************************
+// local declarations
+namespace {
+
+    using namespace Exiv2;
+
+    //! Magic bytes at the start of a view
+    const byte viewMagic[] = { 'E', 'x', 'v', 'M', 'V', 'i', 'e', 'w' };
+    //! Version of the layout
+    const uint32_t viewVersion = 1;
+
+    /*
+      Header: magic, version, number of entries, number of keys, offsets of
+      the entry table, the key table, the entry indices and the blob, size
+      of the blob. Offsets are from the start of the view.
+     */
+    const size_t headerSize = sizeof(viewMagic) + 8 * 4;
+    /*
+      Entry: key id (4), family (1), XMP value kind (1), XMP array type (1),
+      XMP struct (1), type id (4), count (4), value offset (4) and size (4)
+      in the blob.
+     */
+    const size_t entryRecordSize = 24;
+    /*
+      Key: name offset (4) and size (4) in the blob, the name is followed
+      by a NUL; first (4) and number (4) of its entry indices.
+     */
+    const size_t keyRecordSize = 16;
+
+    //! Kinds of XMP values
+    enum XmpValueKind { xvNone, xvText, xvArray, xvLangAlt, xvOther };
+
+    //! An entry which is being encoded
+    struct PendingEntry {
+        std::string key_;                       //!< Key of the datum
+        MetadataId family_;                     //!< Family of the datum
+        byte kind_;                             //!< Kind of an XMP value
+        byte arrayType_;                        //!< XMP array type
+        byte xmpStruct_;                        //!< XMP struct
+        uint32_t typeId_;                       //!< Type of the value
+        uint32_t count_;                        //!< Number of components
+        uint32_t offset_;                       //!< Offset of the value in the blob
+        uint32_t size_;                         //!< Size of the value
+    };
+
+    //! Return \em size as an offset of the view, throw if it does not fit
+    uint32_t toOffset(size_t size)
+    {
+        if (size > 0xffffffff) throw Error(kerArithmeticOverflow);
+        return static_cast<uint32_t>(size);
+    }
+
+    //! Append the little endian \em v to \em blob
+    void put32(Blob& blob, uint32_t v)
+    {
+        byte buf[4];
+        ul2Data(buf, v, littleEndian);
+        blob.insert(blob.end(), buf, buf + 4);
+    }
+
+    //! Append \em s and a NUL to \em blob
+    void putString(Blob& blob, const std::string& s)
+    {
+        blob.insert(blob.end(), s.begin(), s.end());
+        blob.push_back(0);
+    }
+
+    //! Start an entry for an Exif or IPTC datum and append its binary value to \em blob
+    template<typename T>
+    PendingEntry binaryEntry(Blob& blob, MetadataId family, const T& md)
+    {
+        PendingEntry entry = { md.key(), family, xvNone, 0, 0, 0, 0, 0, 0 };
+        TypeId typeId = md.typeId();
+        // A CommentValue reports the type of its data, re-create it from its own type
+        if (typeId != invalidTypeId && dynamic_cast<const CommentValue*>(&md.value())) typeId = comment;
+        entry.typeId_ = static_cast<uint32_t>(typeId);
+        entry.count_ = static_cast<uint32_t>(md.count());
+        entry.offset_ = toOffset(blob.size());
+        const size_t size = md.size();
+        if (size > 0) {
+            blob.resize(blob.size() + size);
+            const long copied = md.copy(&blob[entry.offset_], littleEndian);
+            blob.resize(entry.offset_ + static_cast<size_t>(copied));
+        }
+        entry.size_ = toOffset(blob.size() - entry.offset_);
+        return entry;
+    }
+
+    //! Start an entry for an XMP datum and append its value to \em blob
+    PendingEntry xmpEntry(Blob& blob, const Xmpdatum& md)
+    {
+        PendingEntry entry = { md.key(), mdXmp, xvOther, 0, 0, 0, 0, 0, 0 };
+        entry.typeId_ = static_cast<uint32_t>(md.typeId());
+        entry.count_ = static_cast<uint32_t>(md.count());
+        entry.offset_ = toOffset(blob.size());
+        const Value& value = md.value();
+        if (const XmpValue* xmpValue = dynamic_cast<const XmpValue*>(&value)) {
+            entry.arrayType_ = static_cast<byte>(xmpValue->xmpArrayType());
+            entry.xmpStruct_ = static_cast<byte>(xmpValue->xmpStruct());
+        }
+        if (const XmpTextValue* text = dynamic_cast<const XmpTextValue*>(&value)) {
+            entry.kind_ = xvText;
+            blob.insert(blob.end(), text->value_.begin(), text->value_.end());
+        }
+        else if (const XmpArrayValue* array = dynamic_cast<const XmpArrayValue*>(&value)) {
+            entry.kind_ = xvArray;
+            for (long i = 0; i < array->count(); ++i) putString(blob, array->toString(i));
+        }
+        else if (const LangAltValue* langAlt = dynamic_cast<const LangAltValue*>(&value)) {
+            entry.kind_ = xvLangAlt;
+            for (LangAltValue::ValueType::const_iterator i = langAlt->value_.begin();
+                 i != langAlt->value_.end(); ++i) {
+                putString(blob, i->first);
+                putString(blob, i->second);
+            }
+        }
+        else {
+            const std::string s = value.toString();
+            blob.insert(blob.end(), s.begin(), s.end());
+        }
+        entry.size_ = toOffset(blob.size() - entry.offset_);
+        return entry;
+    }
+
+    //! Return the NUL terminated strings in the \em size bytes at \em data
+    std::vector<std::string> splitStrings(const byte* data, size_t size)
+    {
+        std::vector<std::string> strings;
+        const char* p = reinterpret_cast<const char*>(data);
+        const char* end = p + size;
+        while (p < end) {
+            const char* nul = static_cast<const char*>(std::memchr(p, 0, end - p));
+            if (nul == 0) throw Error(kerCorruptedMetadata);
+            strings.push_back(std::string(p, nul));
+            p = nul + 1;
+        }
+        return strings;
+    }
+
+}
+
+// *****************************************************************************
+// class member definitions
+namespace Exiv2 {
+
+    MetadataId MetadataView::Entry::family() const
+    {
+        return static_cast<MetadataId>(record_[4]);
+    }
+
+    const char* MetadataView::Entry::key() const
+    {
+        const uint32_t keyId = getULong(record_, littleEndian);
+        if (keyId >= view_->keyCount_) throw Error(kerCorruptedMetadata);
+        const byte* key = view_->keys_ + keyId * keyRecordSize;
+        const uint32_t size = getULong(key + 4, littleEndian);
+        const byte* name = view_->blobData(getULong(key, littleEndian), uint64_t(size) + 1);
+        if (name[size] != 0) throw Error(kerCorruptedMetadata);
+        return reinterpret_cast<const char*>(name);
+    }
+
+    size_t MetadataView::Entry::keySize() const
+    {
+        const uint32_t keyId = getULong(record_, littleEndian);
+        if (keyId >= view_->keyCount_) throw Error(kerCorruptedMetadata);
+        return getULong(view_->keys_ + keyId * keyRecordSize + 4, littleEndian);
+    }
+
+    TypeId MetadataView::Entry::typeId() const
+    {
+        return static_cast<TypeId>(getULong(record_ + 8, littleEndian));
+    }
+
+    long MetadataView::Entry::count() const
+    {
+        return static_cast<long>(getULong(record_ + 12, littleEndian));
+    }
+
+    const byte* MetadataView::Entry::data() const
+    {
+        return view_->blobData(getULong(record_ + 16, littleEndian), getULong(record_ + 20, littleEndian));
+    }
+
+    size_t MetadataView::Entry::size() const
+    {
+        return getULong(record_ + 20, littleEndian);
+    }
+
+    Value::UniquePtr MetadataView::Entry::value() const
+    {
+        const TypeId type = typeId();
+        const byte* bytes = data();
+        const size_t bytesSize = size();
+        if (family() != mdXmp) {
+            if (type == invalidTypeId) return Value::UniquePtr();
+            Value::UniquePtr value = Value::create(type);
+            value->read(bytes, static_cast<long>(bytesSize), littleEndian);
+            return value;
+        }
+
+        Value::UniquePtr value;
+        switch (record_[5]) {
+        case xvText: {
+            XmpTextValue::UniquePtr text(new XmpTextValue);
+            text->value_.assign(reinterpret_cast<const char*>(bytes), bytesSize);
+            value = std::move(text);
+            break;
+        }
+        case xvArray: {
+            XmpArrayValue::UniquePtr array(new XmpArrayValue(type));
+            const std::vector<std::string> items = splitStrings(bytes, bytesSize);
+            for (size_t i = 0; i < items.size(); ++i) array->read(items[i]);
+            value = std::move(array);
+            break;
+        }
+        case xvLangAlt: {
+            LangAltValue::UniquePtr langAlt(new LangAltValue);
+            const std::vector<std::string> items = splitStrings(bytes, bytesSize);
+            if (items.size() % 2 != 0) throw Error(kerCorruptedMetadata);
+            for (size_t i = 0; i < items.size(); i += 2) langAlt->value_[items[i]] = items[i + 1];
+            value = std::move(langAlt);
+            break;
+        }
+        case xvOther:
+            value = Value::create(type);
+            value->read(std::string(reinterpret_cast<const char*>(bytes), bytesSize));
+            break;
+        default:
+            throw Error(kerCorruptedMetadata);
+        }
+        if (XmpValue* xmpValue = dynamic_cast<XmpValue*>(value.get())) {
+            xmpValue->setXmpArrayType(static_cast<XmpValue::XmpArrayType>(record_[6]));
+            xmpValue->setXmpStruct(static_cast<XmpValue::XmpStruct>(record_[7]));
+        }
+        return value;
+    }
+
+    std::string MetadataView::Entry::toString() const
+    {
+        if (family() == mdXmp && record_[5] == xvText) {
+            return std::string(reinterpret_cast<const char*>(data()), size());
+        }
+        const Value::UniquePtr v = value();
+        return v.get() == 0 ? std::string() : v->toString();
+    }
+
+    MetadataView::MetadataView(const byte* data, size_t size)
+        : data_(data), size_(size)
+    {
+        init();
+    }
+
+    MetadataView::MetadataView(const SharedBuf& buf)
+        : buf_(buf), data_(buf.data()), size_(buf.size())
+    {
+        init();
+    }
+
+    void MetadataView::init()
+    {
+        if (   data_ == 0 || size_ < headerSize
+            || std::memcmp(data_, viewMagic, sizeof(viewMagic)) != 0) {
+            throw Error(kerNotAnImage, "metadata view");
+        }
+        const byte* header = data_ + sizeof(viewMagic);
+        if (getULong(header, littleEndian) != viewVersion) throw Error(kerCorruptedMetadata);
+        entryCount_ = getULong(header + 4, littleEndian);
+        keyCount_ = getULong(header + 8, littleEndian);
+        const uint64_t entriesOffset = getULong(header + 12, littleEndian);
+        const uint64_t keysOffset = getULong(header + 16, littleEndian);
+        const uint64_t indexOffset = getULong(header + 20, littleEndian);
+        const uint64_t blobOffset = getULong(header + 24, littleEndian);
+        blobSize_ = getULong(header + 28, littleEndian);
+        if (   entriesOffset + uint64_t(entryCount_) * entryRecordSize > size_
+            || keysOffset + uint64_t(keyCount_) * keyRecordSize > size_
+            || indexOffset + uint64_t(entryCount_) * 4 > size_
+            || blobOffset + blobSize_ > size_) {
+            throw Error(kerCorruptedMetadata);
+        }
+        entries_ = data_ + entriesOffset;
+        keys_ = data_ + keysOffset;
+        index_ = data_ + indexOffset;
+        blob_ = data_ + blobOffset;
+    }
+
+    MetadataView::Entry MetadataView::operator[](size_t n) const
+    {
+        if (n >= entryCount_) return Entry();
+        return Entry(this, entries_ + n * entryRecordSize);
+    }
+
+    size_t MetadataView::count(const std::string& key) const
+    {
+        const byte* record = findRecord(key);
+        return record == 0 ? 0 : getULong(record + 12, littleEndian);
+    }
+
+    MetadataView::Entry MetadataView::findKey(const std::string& key, size_t n) const
+    {
+        const byte* record = findRecord(key);
+        if (record == 0 || n >= getULong(record + 12, littleEndian)) return Entry();
+        const uint64_t i = uint64_t(getULong(record + 8, littleEndian)) + n;
+        if (i >= entryCount_) throw Error(kerCorruptedMetadata);
+        return (*this)[getULong(index_ + i * 4, littleEndian)];
+    }
+
+    const byte* MetadataView::findRecord(const std::string& key) const
+    {
+        // The keys are sorted by name
+        uint32_t first = 0;
+        uint32_t last = keyCount_;
+        while (first < last) {
+            const uint32_t mid = first + (last - first) / 2;
+            const byte* record = keys_ + mid * keyRecordSize;
+            const uint32_t size = getULong(record + 4, littleEndian);
+            const char* name = reinterpret_cast<const char*>(blobData(getULong(record, littleEndian), size));
+            const int cmp = key.compare(0, std::string::npos, name, size);
+            if (cmp == 0) return record;
+            if (cmp < 0) last = mid;
+            else first = mid + 1;
+        }
+        return 0;
+    }
+
+    const byte* MetadataView::blobData(uint32_t offset, uint64_t size) const
+    {
+        if (uint64_t(offset) + size > blobSize_) throw Error(kerCorruptedMetadata);
+        return blob_ + offset;
+    }
+
+    void MetadataView::encode(Blob& blob,
+                              const ExifData& exifData,
+                              const IptcData& iptcData,
+                              const XmpData& xmpData)
+    {
+        std::vector<PendingEntry> entries;
+        Blob data;
+        for (ExifData::const_iterator md = exifData.begin(); md != exifData.end(); ++md) {
+            entries.push_back(binaryEntry(data, mdExif, *md));
+        }
+        for (IptcData::const_iterator md = iptcData.begin(); md != iptcData.end(); ++md) {
+            entries.push_back(binaryEntry(data, mdIptc, *md));
+        }
+        for (XmpData::const_iterator md = xmpData.begin(); md != xmpData.end(); ++md) {
+            entries.push_back(xmpEntry(data, *md));
+        }
+
+        // Intern the keys, sorted by name, with the indices of their entries
+        typedef std::map<std::string, std::vector<uint32_t> > KeyMap;
+        KeyMap keys;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            keys[entries[i].key_].push_back(static_cast<uint32_t>(i));
+        }
+        std::vector<uint32_t> keyIds(entries.size());
+        Blob keyTable;
+        Blob index;
+        uint32_t keyId = 0;
+        for (KeyMap::const_iterator k = keys.begin(); k != keys.end(); ++k, ++keyId) {
+            put32(keyTable, toOffset(data.size()));
+            put32(keyTable, toOffset(k->first.size()));
+            put32(keyTable, toOffset(index.size() / 4));
+            put32(keyTable, static_cast<uint32_t>(k->second.size()));
+            putString(data, k->first);
+            for (size_t i = 0; i < k->second.size(); ++i) {
+                put32(index, k->second[i]);
+                keyIds[k->second[i]] = keyId;
+            }
+        }
+
+        const size_t entriesOffset = headerSize;
+        const size_t keysOffset = entriesOffset + entries.size() * entryRecordSize;
+        const size_t indexOffset = keysOffset + keyTable.size();
+        const size_t blobOffset = indexOffset + index.size();
+        toOffset(blobOffset + data.size());
+
+        blob.reserve(blob.size() + blobOffset + data.size());
+        blob.insert(blob.end(), viewMagic, viewMagic + sizeof(viewMagic));
+        put32(blob, viewVersion);
+        put32(blob, static_cast<uint32_t>(entries.size()));
+        put32(blob, static_cast<uint32_t>(keys.size()));
+        put32(blob, static_cast<uint32_t>(entriesOffset));
+        put32(blob, static_cast<uint32_t>(keysOffset));
+        put32(blob, static_cast<uint32_t>(indexOffset));
+        put32(blob, static_cast<uint32_t>(blobOffset));
+        put32(blob, static_cast<uint32_t>(data.size()));
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const PendingEntry& entry = entries[i];
+            put32(blob, keyIds[i]);
+            blob.push_back(static_cast<byte>(entry.family_));
+            blob.push_back(entry.kind_);
+            blob.push_back(entry.arrayType_);
+            blob.push_back(entry.xmpStruct_);
+            put32(blob, entry.typeId_);
+            put32(blob, entry.count_);
+            put32(blob, entry.offset_);
+            put32(blob, entry.size_);
+        }
+        blob.insert(blob.end(), keyTable.begin(), keyTable.end());
+        blob.insert(blob.end(), index.begin(), index.end());
+        blob.insert(blob.end(), data.begin(), data.end());
+    }
+
+}                                       // namespace Exiv2
@@ -961,11 +961,10 @@ namespace Exiv2 {
         // From Xavier Raynaud: the value is converted from 0:256 to -5.33:5.33
 
         std::ios::fmtflags f( os.flags() );
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(2)
            << (float (value.toLong()-128)/24);
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
@@ -974,11 +973,10 @@ namespace Exiv2 {
     std::ostream& MinoltaMakerNote::printMinoltaExposureCompensation5D(std::ostream& os, const Value& value, const ExifData*)
     {
         std::ios::fmtflags f( os.flags() );
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(2)
            << (float (value.toLong()-300)/100);
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
@@ -2035,7 +2033,7 @@ namespace Exiv2 {
 
     static std::ostream& resolvedLens(std::ostream& os,long lensID,long index)
     {
-        const TagDetails* td = find(minoltaSonyLensID, lensID);
+        const TagDetails* td = findTagDetails<EXV_COUNTOF(minoltaSonyLensID), minoltaSonyLensID>(lensID);
         std::vector<std::string> tokens = split(td[0].label_,"|");
         return os << exvGettext(trim(tokens[index-1]).c_str());
     }
@@ -2226,11 +2224,13 @@ namespace Exiv2 {
         const std::string undefined("undefined") ;
         const std::string minolta  ("minolta");
         const std::string sony     ("sony");
-        if ( Internal::readExiv2Config(minolta,value.toString(),undefined) != undefined ) {
-            return os << Internal::readExiv2Config(minolta,value.toString(),undefined);
+        const std::string minoltaLens = Internal::readExiv2Config(minolta,value.toString(),undefined);
+        if ( minoltaLens != undefined ) {
+            return os << minoltaLens;
         }
-        if ( Internal::readExiv2Config(sony,value.toString(),undefined) != undefined ) {
-            return os << Internal::readExiv2Config(sony,value.toString(),undefined);
+        const std::string sonyLens = Internal::readExiv2Config(sony,value.toString(),undefined);
+        if ( sonyLens != undefined ) {
+            return os << sonyLens;
         }
 
         // #1145 - respect lenses with shared LensID
@@ -2499,4 +2499,14 @@ namespace Exiv2 {
         return os;
     }
 
+    //! Tag lists of the groups of the Minolta makernote module
+    extern const MnTagListEntry minoltaMnTagLists[] = {
+        { minoltaId,      MinoltaMakerNote::tagList },
+        { minoltaCs5DId,  MinoltaMakerNote::tagListCs5D },
+        { minoltaCs7DId,  MinoltaMakerNote::tagListCs7D },
+        { minoltaCsOldId, MinoltaMakerNote::tagListCsStd },
+        { minoltaCsNewId, MinoltaMakerNote::tagListCsStd },
+        { ifdIdNotSet,    0 }
+    };
+
 }}                                      // namespace Internal, Exiv2
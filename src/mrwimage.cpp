@@ -141,6 +141,7 @@ namespace Exiv2 {
                                           buf.pData_,
                                           buf.size_);
         setByteOrder(bo);
+        releasePackets();
     } // MrwImage::readMetadata
 
     void MrwImage::writeMetadata()
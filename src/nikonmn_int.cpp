@@ -45,6 +45,8 @@
 #include <iomanip>
 #include <cassert>
 #include <cstring>
+#include <algorithm>
+#include <vector>
 #include <math.h> //for log, pow, abs
 
 // *****************************************************************************
@@ -327,12 +329,11 @@ namespace Exiv2 {
             os << _("Unknown");
         }
         else if (distance.second != 0) {
-            std::ostringstream oss;
-            oss.copyfmt(os);
+            FormatState fmt(os);
             os << std::fixed << std::setprecision(2)
                << (float)distance.first / distance.second
                << " m";
-            os.copyfmt(oss);
+            fmt.restore();
         }
         else {
             os << "(" << value << ")";
@@ -351,12 +352,11 @@ namespace Exiv2 {
             os << _("Not used");
         }
         else if (zoom.second != 0) {
-            std::ostringstream oss;
-            oss.copyfmt(os);
+            FormatState fmt(os);
             os << std::fixed << std::setprecision(1)
                << (float)zoom.first / zoom.second
                << "x";
-            os.copyfmt(oss);
+            fmt.restore();
         }
         else {
             os << "(" << value << ")";
@@ -534,12 +534,11 @@ namespace Exiv2 {
             os << _("Not used");
         }
         else if (zoom.second != 0) {
-            std::ostringstream oss;
-            oss.copyfmt(os);
+            FormatState fmt(os);
             os << std::fixed << std::setprecision(1)
                << (float)zoom.first / zoom.second
                << "x";
-            os.copyfmt(oss);
+            fmt.restore();
         }
         else {
             os << "(" << value << ")";
@@ -1523,15 +1522,14 @@ namespace Exiv2 {
             os << "-" << len2;
         }
         os << "mm ";
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << "F" << std::setprecision(2)
            << static_cast<float>(fno1.first) / fno1.second;
         if (fno2 != fno1) {
             os << "-" << std::setprecision(2)
                << static_cast<float>(fno2.first) / fno2.second;
         }
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
@@ -1546,12 +1544,11 @@ namespace Exiv2 {
             os << _("Unknown");
         }
         else if (distance.second != 0) {
-            std::ostringstream oss;
-            oss.copyfmt(os);
+            FormatState fmt(os);
             os << std::fixed << std::setprecision(2)
                << (float)distance.first / distance.second
                << " m";
-            os.copyfmt(oss);
+            fmt.restore();
         }
         else {
             os << "(" << value << ")";
@@ -1570,12 +1567,11 @@ namespace Exiv2 {
             os << _("Not used");
         }
         else if (zoom.second != 0) {
-            std::ostringstream oss;
-            oss.copyfmt(os);
+            FormatState fmt(os);
             os << std::fixed << std::setprecision(1)
                << (float)zoom.first / zoom.second
                << "x";
-            os.copyfmt(oss);
+            fmt.restore();
         }
         else {
             os << "(" << value << ")";
@@ -1732,8 +1728,9 @@ namespace Exiv2 {
         bool result = false;
         const std::string undefined("undefined") ;
         const std::string section  ("nikon");
-        if ( Internal::readExiv2Config(section,value.toString(),undefined) != undefined ) {
-            os << Internal::readExiv2Config(section,value.toString(),undefined);
+        const std::string configLens = Internal::readExiv2Config(section,value.toString(),undefined);
+        if ( configLens != undefined ) {
+            os << configLens;
             result = true;
         }
         return result;
@@ -2508,13 +2505,6 @@ fmountlens[] = {
 #endif
 // 8< - - - 8< do not remove this line >8 - - - >8
 
-    /* if no meta obj is provided, try to use the value param that *may*
-     * be the pre-parsed lensid
-     */
-        if (metadata == 0)
-        {
-            const unsigned char  vid = (unsigned)value.toLong(0);
-
         /* the 'FMntLens' name is added to the annonymous struct for
          * fmountlens[]
          *
@@ -2523,12 +2513,38 @@ fmountlens[] = {
          *
          * www.rottmerhusen.com/objektives/lensid/files/c-header/fmountlens4.h
          */
-            const struct FMntLens*  pf = fmountlens;
-            while (pf->lid && pf->lensname) {
-                if (pf->lid == vid) {
-                    break;
-                }
-                ++pf;
+        // The lenses sorted by lens id, in table order for the same id, so that
+        // the lenses of one id are found in O(log n). Built on first use.
+        static const std::vector<const FMntLens*> lensesByLid = [] {
+            std::vector<const FMntLens*> lenses;
+            for (const FMntLens* pf = fmountlens; pf->lensname != nullptr; ++pf) lenses.push_back(pf);
+            std::stable_sort(lenses.begin(), lenses.end(),
+                             [](const FMntLens* lhs, const FMntLens* rhs) { return lhs->lid < rhs->lid; });
+            return lenses;
+        }();
+        // Return the first lens with lens id lid in lensesByLid
+        auto firstLens = [](unsigned char lid) {
+            return std::lower_bound(lensesByLid.begin(), lensesByLid.end(), lid,
+                                    [](const FMntLens* pf, unsigned char id) { return pf->lid < id; });
+        };
+
+    /* if no meta obj is provided, try to use the value param that *may*
+     * be the pre-parsed lensid
+     */
+        if (metadata == 0)
+        {
+            const unsigned char  vid = (unsigned)value.toLong(0);
+
+            // The first lens in table order with lens id vid or without a lens id
+            static const FMntLens* const firstWithoutLid = [] {
+                const FMntLens* pf = fmountlens;
+                while (pf->lid && pf->lensname) ++pf;
+                return pf;
+            }();
+            const FMntLens* pf = firstWithoutLid;
+            const auto pos = firstLens(vid);
+            if (pos != lensesByLid.end() && (*pos)->lid == vid && *pos < pf) {
+                pf = *pos;
             }
 
             if (pf->lensname == nullptr) {
@@ -2568,29 +2584,31 @@ fmountlens[] = {
         }
         raw[7] = static_cast<byte>(md->toLong());
 
-        for (int i = 0; fmountlens[i].lensname != nullptr; ++i) {
-            if (   raw[0] == fmountlens[i].lid ) {
-                // #1034
-                const std::string  undefined("undefined") ;
-                const std::string  section  ("nikon");
-                std::ostringstream lensIDStream;
-                lensIDStream  << (int) raw[7];
-                if ( Internal::readExiv2Config(section,lensIDStream.str(),undefined) != undefined ) {
-                    return os << Internal::readExiv2Config(section,lensIDStream.str(),undefined);
-                }
+        auto pos = firstLens(raw[0]);
+        if (pos != lensesByLid.end() && (*pos)->lid == raw[0]) {
+            // #1034
+            const std::string  undefined("undefined") ;
+            const std::string  section  ("nikon");
+            std::ostringstream lensIDStream;
+            lensIDStream  << (int) raw[7];
+            const std::string configLens = Internal::readExiv2Config(section,lensIDStream.str(),undefined);
+            if ( configLens != undefined ) {
+                return os << configLens;
             }
-
-            if (   raw[0] == fmountlens[i].lid
+        }
+        for (; pos != lensesByLid.end() && (*pos)->lid == raw[0]; ++pos) {
+            const FMntLens& lens = **pos;
+            if (
                 // stps varies with focal length for some Sigma zoom lenses.
-                &&(raw[1] == fmountlens[i].stps || strcmp(fmountlens[i].manuf, "Sigma") == 0)
-                && raw[2] == fmountlens[i].focs
-                && raw[3] == fmountlens[i].focl
-                && raw[4] == fmountlens[i].aps
-                && raw[5] == fmountlens[i].apl
-                && raw[6] == fmountlens[i].lfw
-                && raw[7] == fmountlens[i].ltype) {
+                   (raw[1] == lens.stps || strcmp(lens.manuf, "Sigma") == 0)
+                && raw[2] == lens.focs
+                && raw[3] == lens.focl
+                && raw[4] == lens.aps
+                && raw[5] == lens.apl
+                && raw[6] == lens.lfw
+                && raw[7] == lens.ltype) {
                 // Lens found in database
-                return os << fmountlens[i].manuf << " " << fmountlens[i].lensname;
+                return os << lens.manuf << " " << lens.lensname;
             }
         }
         // Lens not found in database
@@ -2611,10 +2629,9 @@ fmountlens[] = {
             return os;
         }
         double dist = 0.01 * pow(10.0, value.toLong()/40.0);
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(2) << dist << " m";
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
@@ -2630,10 +2647,9 @@ fmountlens[] = {
             return os;
         }
         double aperture = pow(2.0, value.toLong()/24.0);
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(1) << "F" << aperture;
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
@@ -2646,10 +2662,9 @@ fmountlens[] = {
             return os << "(" << value << ")";
         }
         double focal = 5.0 * pow(2.0, value.toLong()/24.0);
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(1) << focal << " mm";
-        os.copyfmt(oss);
+        fmt.restore();
         return os;
     }
 
@@ -2664,10 +2679,9 @@ fmountlens[] = {
             return os;
         }
         double fstops = value.toLong()/12.0;
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(1) << "F" << fstops;
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
@@ -2683,10 +2697,9 @@ fmountlens[] = {
             return os;
         }
         double epp = 2048.0/value.toLong();
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(1) << epp << " mm";
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
@@ -2701,10 +2714,9 @@ fmountlens[] = {
             os.flags(f);
             return os;
         }
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(1) << value.toLong() << " mm";
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
@@ -2717,10 +2729,9 @@ fmountlens[] = {
         if (value.count() != 1 || value.typeId() != unsignedByte || value.toLong() == 0 || value.toLong() == 255) {
             return os << "(" << value << ")";
         }
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(2) << value.toLong() << " Hz";
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
@@ -2733,10 +2744,9 @@ fmountlens[] = {
         if (value.count() != 1 || value.typeId() != unsignedByte || value.toLong() == 0 || value.toLong() == 255) {
             return os << "(" << value << ")";
         }
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(2) << value.toLong();
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
@@ -2751,14 +2761,13 @@ fmountlens[] = {
             os.flags(f);
             return os;
         }
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         char sign = value.toLong() < 0 ? '-' : '+';
         long h    = long(std::abs( (int) (value.toFloat()/60.0)  ))%24;
         long min  = long(std::abs( (int) (value.toFloat()-h*60)  ))%60;
         os << std::fixed << "UTC " << sign << std::setw(2) << std::setfill('0') << h << ":"
            << std::setw(2) << std::setfill('0') << min;
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(f);
         return os;
     }
@@ -2771,8 +2780,7 @@ fmountlens[] = {
             return os << "(" << value << ")";
         }
         long pcval = value.toLong() - 0x80;
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         switch(pcval)
         {
         case 0:
@@ -2791,7 +2799,7 @@ fmountlens[] = {
             os << pcval;
             break;
         }
-        os.copyfmt(oss);
+        fmt.restore();
         return os;
     }
 
@@ -2832,4 +2840,39 @@ fmountlens[] = {
         return os << s;
     }
 
+    //! Tag lists of the groups of the Nikon makernote module
+    extern const MnTagListEntry nikonMnTagLists[] = {
+        { nikon1Id,    Nikon1MakerNote::tagList },
+        { nikon2Id,    Nikon2MakerNote::tagList },
+        { nikon3Id,    Nikon3MakerNote::tagList },
+        { nikonVrId,   Nikon3MakerNote::tagListVr },
+        { nikonPcId,   Nikon3MakerNote::tagListPc },
+        { nikonWtId,   Nikon3MakerNote::tagListWt },
+        { nikonIiId,   Nikon3MakerNote::tagListIi },
+        { nikonAfId,   Nikon3MakerNote::tagListAf },
+        { nikonAf2Id,  Nikon3MakerNote::tagListAf2 },
+        { nikonAFTId,  Nikon3MakerNote::tagListAFT },
+        { nikonFiId,   Nikon3MakerNote::tagListFi },
+        { nikonMeId,   Nikon3MakerNote::tagListMe },
+        { nikonFl1Id,  Nikon3MakerNote::tagListFl1 },
+        { nikonFl2Id,  Nikon3MakerNote::tagListFl2 },
+        { nikonFl3Id,  Nikon3MakerNote::tagListFl3 },
+        { nikonSi1Id,  Nikon3MakerNote::tagListSi1 },
+        { nikonSi2Id,  Nikon3MakerNote::tagListSi2 },
+        { nikonSi3Id,  Nikon3MakerNote::tagListSi3 },
+        { nikonSi4Id,  Nikon3MakerNote::tagListSi4 },
+        { nikonSi5Id,  Nikon3MakerNote::tagListSi5 },
+        { nikonSi6Id,  Nikon3MakerNote::tagListSi5 },
+        { nikonCb1Id,  Nikon3MakerNote::tagListCb1 },
+        { nikonCb2Id,  Nikon3MakerNote::tagListCb2 },
+        { nikonCb2aId, Nikon3MakerNote::tagListCb2a },
+        { nikonCb2bId, Nikon3MakerNote::tagListCb2b },
+        { nikonCb3Id,  Nikon3MakerNote::tagListCb3 },
+        { nikonCb4Id,  Nikon3MakerNote::tagListCb4 },
+        { nikonLd1Id,  Nikon3MakerNote::tagListLd1 },
+        { nikonLd2Id,  Nikon3MakerNote::tagListLd2 },
+        { nikonLd3Id,  Nikon3MakerNote::tagListLd3 },
+        { ifdIdNotSet, 0 }
+    };
+
 }}                                      // namespace Internal, Exiv2
@@ -1193,10 +1193,9 @@ namespace Exiv2 {
         }
         float f = value.toFloat();
         if (f == 0.0 || f == 1.0) return os << _("None");
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(1) << f << "x";
-        os.copyfmt(oss);
+        fmt.restore();
         os.flags(of);
         return os;
     } // OlympusMakerNote::print0x0204
@@ -1258,8 +1257,9 @@ namespace Exiv2 {
         // #1034
         const std::string undefined("undefined") ;
         const std::string section  ("olympus");
-        if ( Internal::readExiv2Config(section,value.toString(),undefined) != undefined ) {
-            return os << Internal::readExiv2Config(section,value.toString(),undefined);
+        const std::string configLens = Internal::readExiv2Config(section,value.toString(),undefined);
+        if ( configLens != undefined ) {
+            return os << configLens;
         }
 
         // 6 numbers: 0. Make, 1. Unknown, 2. Model, 3. Sub-model, 4-5. Unknown.
@@ -1609,11 +1609,10 @@ namespace Exiv2 {
             os << _("Infinity");
         }
         else {
-            std::ostringstream oss;
-            oss.copyfmt(os);
+            FormatState fmt(os);
             os << std::fixed << std::setprecision(2);
             os << (float)distance.first/1000 << " m";
-            os.copyfmt(oss);
+            fmt.restore();
         }
         os.flags(f);
         return os;
@@ -1708,4 +1707,27 @@ value, const ExifData* metadata)
         return os << v;
     } // OlympusMakerNote::print0x0308
 
+    //! Tag lists of the groups of the Olympus makernote module
+    extern const MnTagListEntry olympusMnTagLists[] = {
+        { olympusId,    OlympusMakerNote::tagList },
+        { olympus2Id,   OlympusMakerNote::tagList },
+        { olympusCsId,  OlympusMakerNote::tagListCs },
+        { olympusEqId,  OlympusMakerNote::tagListEq },
+        { olympusRdId,  OlympusMakerNote::tagListRd },
+        { olympusRd2Id, OlympusMakerNote::tagListRd2 },
+        { olympusIpId,  OlympusMakerNote::tagListIp },
+        { olympusFiId,  OlympusMakerNote::tagListFi },
+        { olympusFe1Id, OlympusMakerNote::tagListFe },
+        { olympusFe2Id, OlympusMakerNote::tagListFe },
+        { olympusFe3Id, OlympusMakerNote::tagListFe },
+        { olympusFe4Id, OlympusMakerNote::tagListFe },
+        { olympusFe5Id, OlympusMakerNote::tagListFe },
+        { olympusFe6Id, OlympusMakerNote::tagListFe },
+        { olympusFe7Id, OlympusMakerNote::tagListFe },
+        { olympusFe8Id, OlympusMakerNote::tagListFe },
+        { olympusFe9Id, OlympusMakerNote::tagListFe },
+        { olympusRiId,  OlympusMakerNote::tagListRi },
+        { ifdIdNotSet,  0 }
+    };
+
 }}                                      // namespace Internal, Exiv2
@@ -36,6 +36,7 @@
 #include "basicio.hpp"
 #include "error.hpp"
 #include "futils.hpp"
+#include "stats_int.hpp"
 
 // + standard includes
 #include <string>
@@ -114,16 +115,24 @@ namespace Exiv2 {
             throw Error(kerNotAnImage, "ORF");
         }
         clearMetadata();
+        // fetch the directories together, remote files only map the blocks fetched before
+        if (io_->prefetches()) {
+            OrfHeader orfHeader;
+            TiffParserWorker::prefetch(*io_, &orfHeader);
+        }
         ByteOrder bo = OrfParser::decode(exifData_,
                                          iptcData_,
                                          xmpData_,
                                          io_->mmap(),
                                          (uint32_t) io_->size());
         setByteOrder(bo);
+        releasePackets();
     } // OrfImage::readMetadata
 
     void OrfImage::writeMetadata()
     {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
 #ifdef DEBUG
         std::cerr << "Writing ORF file " << io_->path() << "\n";
 #endif
@@ -146,7 +155,7 @@ namespace Exiv2 {
             bo = littleEndian;
         }
         setByteOrder(bo);
-        OrfParser::encode(*io_, pData, size, bo, exifData_, iptcData_, xmpData_); // may throw
+        OrfParser::encode(*io_, pData, size, bo, exifData_, iptcData(), xmpData()); // may throw
     } // OrfImage::writeMetadata
 
     ByteOrder OrfParser::decode(
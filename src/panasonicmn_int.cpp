@@ -576,11 +576,10 @@ namespace Exiv2 {
                                                   const ExifData*)
     {
         std::ios::fmtflags f( os.flags() );
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(1)
            << value.toLong() / 3 << _(" EV");
-        os.copyfmt(oss);
+        fmt.restore();
 
         os.flags(f);
         return os;
@@ -592,14 +591,13 @@ namespace Exiv2 {
                                                   const Value& value,
                                                   const ExifData*)
     {
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         long time=value.toLong();
         os << std::setw(2) << std::setfill('0') << time / 360000 << ":"
            << std::setw(2) << std::setfill('0') << (time % 360000) / 6000 << ":"
            << std::setw(2) << std::setfill('0') << (time % 6000) / 100 << "."
            << std::setw(2) << std::setfill('0') << time % 100;
-        os.copyfmt(oss);
+        fmt.restore();
 
         return os;
 
@@ -707,10 +705,9 @@ namespace Exiv2 {
         // roll angle is stored as signed int, but tag states to be unsigned int
         int i = value.toLong();
         i = i - ((i & 0x8000) >> 15) * 0xffff;
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(1) << i / 10.0;
-        os.copyfmt(oss);
+        fmt.restore();
 
         return os;
     }  // PanasonicMakerNote::printRollAngle
@@ -721,10 +718,9 @@ namespace Exiv2 {
         // change sign to be compatible with ExifTool: positive is upwards
         int i = value.toLong();
         i = i - ((i & 0x8000) >> 15) * 0xffff;
-        std::ostringstream oss;
-        oss.copyfmt(os);
+        FormatState fmt(os);
         os << std::fixed << std::setprecision(1) << -i / 10.0;
-        os.copyfmt(oss);
+        fmt.restore();
 
         return os;
     }  // PanasonicMakerNote::printPitchAngle
@@ -763,4 +759,11 @@ namespace Exiv2 {
         return tagInfoRaw_;
     }
 
+    //! Tag lists of the groups of the Panasonic makernote module
+    extern const MnTagListEntry panasonicMnTagLists[] = {
+        { panaRawId,   PanasonicMakerNote::tagListRaw },
+        { panasonicId, PanasonicMakerNote::tagList },
+        { ifdIdNotSet, 0 }
+    };
+
 }}                                      // namespace Internal, Exiv2
@@ -1697,4 +1697,11 @@ namespace Exiv2 {
         return tagInfo_;
     }
 
+    //! Tag lists of the groups of the Pentax makernote module
+    extern const MnTagListEntry pentaxMnTagLists[] = {
+        { pentaxDngId, PentaxMakerNote::tagList },
+        { pentaxId,    PentaxMakerNote::tagList },
+        { ifdIdNotSet, 0 }
+    };
+
 }}                                       // namespace Internal, Exiv2
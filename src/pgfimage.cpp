@@ -33,6 +33,7 @@
 #include "basicio.hpp"
 #include "error.hpp"
 #include "futils.hpp"
+#include "stats_int.hpp"
 
 // + standard includes
 #include <cstdio>                               // for EOF
@@ -148,18 +149,21 @@ namespace Exiv2 {
         exifData() = image->exifData();
         iptcData() = image->iptcData();
         xmpData()  = image->xmpData();
-
+        releasePackets();
     } // PgfImage::readMetadata
 
     void PgfImage::writeMetadata()
     {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
         if (io_->open() != 0)
         {
             throw Error(kerDataSourceOpenFailed, io_->path(), strError());
         }
         IoCloser closer(*io_);
-        BasicIo::UniquePtr tempIo(new MemIo);
+        std::unique_ptr<MemIo> tempIo(new MemIo);
         assert (tempIo.get() != 0);
+        tempIo->reserve(static_cast<long>(io_->size())); // the new image has about the same size
 
         doWriteMetadata(*tempIo); // may throw
         io_->close();
@@ -167,6 +171,17 @@ namespace Exiv2 {
 
     } // PgfImage::writeMetadata
 
+    void PgfImage::writeMetadataTo(BasicIo& dst)
+    {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
+        if (io_->open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+        IoCloser closer(*io_);
+        doWriteMetadata(dst); // may throw
+    } // PgfImage::writeMetadataTo
+
     void PgfImage::doWriteMetadata(BasicIo& outIo)
     {
         if (!io_->isopen()) throw Error(kerInputDataReadFailed);
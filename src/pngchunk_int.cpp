@@ -34,7 +34,9 @@
 #include "error.hpp"
 #include "enforce.hpp"
 #include "helper_functions.hpp"
+#include "image_int.hpp"
 #include "safe_op.hpp"
+#include "stats_int.hpp"
 
 // + standard includes
 #include <sstream>
@@ -76,12 +78,43 @@ namespace Exiv2 {
 
     } // PngChunk::decodeIHDRChunk
 
+    void PngChunk::decodeExifChunk(Image* pImage, const DataBuf& data)
+    {
+        // Some writers prefix the TIFF structure with the header of a JPEG APP1 segment
+        static const byte exifHeader[] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
+        long pos = 0;
+        if (data.size_ >= static_cast<long>(sizeof(exifHeader))
+            && memcmp(data.pData_, exifHeader, sizeof(exifHeader)) == 0) {
+            pos = sizeof(exifHeader);
+        }
+        pImage->exifData().clear();
+        try {
+            ByteOrder bo = TiffParser::decode(pImage->exifData(),
+                                              pImage->iptcData(),
+                                              pImage->xmpData(),
+                                              data.pData_ + pos,
+                                              static_cast<uint32_t>(data.size_ - pos));
+            pImage->setByteOrder(bo);
+        }
+        catch (const AnyError& error) {
+            if (error.code() == kerResourceLimitExceeded) throw;
+#ifndef SUPPRESS_WARNINGS
+            EXV_WARNING << "Failed to decode Exif metadata.\n";
+#endif
+            pImage->exifData().clear();
+        }
+
+    } // PngChunk::decodeExifChunk
+
     void PngChunk::decodeTXTChunk(Image*         pImage,
                                   const DataBuf& data,
                                   TxtChunkType   type)
     {
         DataBuf key = keyTXTChunk(data);
-        DataBuf arr = parseTXTChunk(data, key.size_, type);
+        // Check all chunks, but extract only those which are used
+        const bool used = isChunkContentUsed(pImage, key.pData_, key.size_);
+        DataBuf arr = parseTXTChunk(data, key.size_, type, used);
+        if (!used) return;
 
 #ifdef DEBUG
         std::cout << "Exiv2::PngChunk::decodeTXTChunk: TXT chunk data: "
@@ -128,7 +161,8 @@ namespace Exiv2 {
 
     DataBuf PngChunk::parseTXTChunk(const DataBuf& data,
                                     int            keysize,
-                                    TxtChunkType   type)
+                                    TxtChunkType   type,
+                                    bool           extract)
     {
         DataBuf arr;
 
@@ -154,7 +188,7 @@ namespace Exiv2 {
             long compressedTextSize = data.size_  - keysize - 2;
             enforce(compressedTextSize < data.size_, kerCorruptedMetadata);
 
-            zlibUncompress(compressedText, compressedTextSize, arr);
+            if (extract) zlibUncompress(compressedText, compressedTextSize, arr);
         }
         else if(type == tEXt_Chunk)
         {
@@ -165,7 +199,7 @@ namespace Exiv2 {
             const byte* text = data.pData_ + keysize + 1;
             long textsize    = data.size_  - keysize - 1;
 
-            arr = DataBuf(text, textsize);
+            if (extract) arr = DataBuf(text, textsize);
         }
         else if(type == iTXt_Chunk)
         {
@@ -212,8 +246,7 @@ namespace Exiv2 {
                     std::cout << "Exiv2::PngChunk::parseTXTChunk: We found an uncompressed iTXt field\n";
 #endif
 
-                    arr.alloc(textsize);
-                    arr = DataBuf(text, textsize);
+                    if (extract) arr = DataBuf(text, textsize);
                 } else if (compressionFlag == 0x01 && compressionMethod == 0x00) {
                     // then it's a zlib compressed iTXt chunk
 #ifdef DEBUG
@@ -221,7 +254,7 @@ namespace Exiv2 {
 #endif
 
                     // the compressed text comes after the translated keyword, but isn't null terminated
-                    zlibUncompress(text, textsize, arr);
+                    if (extract) zlibUncompress(text, textsize, arr);
                 }
             } else {
                 // then it isn't zlib compressed and we are sunk
@@ -243,6 +276,28 @@ namespace Exiv2 {
 
     } // PngChunk::parsePngChunk
 
+    bool PngChunk::isChunkContentUsed(      Image* pImage,
+                                      const byte*  key,
+                                            long   keySize)
+    {
+        return (   keySize >= 21
+                && (   memcmp("Raw profile type exif", key, 21) == 0
+                    || memcmp("Raw profile type APP1", key, 21) == 0)
+                && pImage->exifData().empty())
+            || (   keySize >= 21
+                && memcmp("Raw profile type iptc", key, 21) == 0
+                && pImage->iptcData().empty())
+            || (   keySize >= 20
+                && memcmp("Raw profile type xmp", key, 20) == 0
+                && pImage->xmpData().empty())
+            || (   keySize >= 17
+                && memcmp("XML:com.adobe.xmp", key, 17) == 0
+                && pImage->xmpData().empty())
+            || (   keySize >= 11
+                && memcmp("Description", key, 11) == 0
+                && pImage->comment().empty());
+    } // PngChunk::isChunkContentUsed
+
     void PngChunk::parseChunkContent(      Image*  pImage,
                                      const byte*   key,
                                            long    keySize,
@@ -307,26 +362,14 @@ namespace Exiv2 {
             DataBuf psData = readRawProfile(arr,false);
             if (psData.size_ > 0) {
                 Blob iptcBlob;
-                const byte *record = 0;
-                uint32_t sizeIptc = 0;
-                uint32_t sizeHdr = 0;
-
-                const byte* pEnd = psData.pData_ + psData.size_;
-                const byte* pCur = psData.pData_;
-                while (   pCur < pEnd
-                       && 0 == Photoshop::locateIptcIrb(pCur,
-                                                        static_cast<long>(pEnd - pCur),
-                                                        &record,
-                                                        &sizeHdr,
-                                                        &sizeIptc)) {
-                    if (sizeIptc) {
+                Photoshop::IrbIndex index;
+                Photoshop::indexIrbs(psData.pData_, psData.size_, index);
+                for (Photoshop::IrbIndex::const_iterator irb = index.begin(); irb != index.end(); ++irb) {
+                    if (irb->psTag_ != Photoshop::iptc_ || irb->sizeData_ == 0) continue;
 #ifdef DEBUG
-                        std::cerr << "Found IPTC IRB, size = " << sizeIptc << "\n";
+                    std::cerr << "Found IPTC IRB, size = " << irb->sizeData_ << "\n";
 #endif
-                        append(iptcBlob, record + sizeHdr, sizeIptc);
-                    }
-                    pCur = record + sizeHdr + sizeIptc;
-                    pCur += (sizeIptc & 1);
+                    append(iptcBlob, psData.pData_ + irb->offset_ + irb->sizeHdr_, irb->sizeData_);
                 }
                 if (   iptcBlob.size() > 0
                     && IptcParser::decode(pImage->iptcData(),
@@ -370,7 +413,7 @@ namespace Exiv2 {
                     EXV_WARNING << "Removing " << idx
                                 << " characters from the beginning of the XMP packet\n";
 #endif
-                    xmpPacket = xmpPacket.substr(idx);
+                    xmpPacket.erase(0, idx);
                 }
                 if (XmpParser::decode(pImage->xmpData(), xmpPacket))
                 {
@@ -398,7 +441,7 @@ namespace Exiv2 {
                     EXV_WARNING << "Removing " << idx << " characters "
                                 << "from the beginning of the XMP packet\n";
 #endif
-                    xmpPacket = xmpPacket.substr(idx);
+                    xmpPacket.erase(0, idx);
                 }
                 if (XmpParser::decode(pImage->xmpData(), xmpPacket))
                 {
@@ -456,39 +499,53 @@ namespace Exiv2 {
                                   unsigned int compressedTextSize,
                                   DataBuf&     arr)
     {
-        uLongf uncompressedLen = compressedTextSize * 2; // just a starting point
-        int zlibResult;
-        int dos = 0;
-
-        do {
-            arr.alloc(uncompressedLen);
-            zlibResult = uncompress((Bytef*)arr.pData_,
-                                    &uncompressedLen,
-                                    compressedText,
-                                    compressedTextSize);
-            if (zlibResult == Z_OK) {
-                assert((uLongf)arr.size_ >= uncompressedLen);
-                arr.size_ = uncompressedLen;
+        // DoS protection. can't be bigger than twice the compressed size or 128k
+        const long maxSize = EXV_MAX(2 * static_cast<long>(compressedTextSize), 131072L);
+        z_stream zs;
+        std::memset(&zs, 0, sizeof(zs));
+        zs.next_in = const_cast<Bytef*>(compressedText);
+        zs.avail_in = compressedTextSize;
+        if (inflateInit(&zs) != Z_OK) {
+            throw Error(kerFailedToReadImageData);
+        }
+        // Text compresses well, start with four times the compressed size
+        DataBuf buf(EXV_MIN(EXV_MAX(4 * static_cast<long>(compressedTextSize), 1024L), maxSize));
+        zs.next_out = buf.pData_;
+        zs.avail_out = static_cast<uInt>(buf.size_);
+        int zlibResult = Z_OK;
+        for (;;) {
+            zlibResult = inflate(&zs, Z_NO_FLUSH);
+            try {
+                ParseBudget::checkInflatedSize(zs.total_out);
+            } catch (const Error&) {
+                inflateEnd(&zs);
+                throw;
             }
-            else if (zlibResult == Z_BUF_ERROR) {
-                // the uncompressedArray needs to be larger
-                uncompressedLen *= 2;
-                // DoS protection. can't be bigger than 64k
-                if (uncompressedLen > 131072) {
-                    if (++dos > 1) break;
-                    uncompressedLen = 131072;
-                }
+            if (zlibResult == Z_STREAM_END) break;
+            if (zlibResult != Z_OK && zlibResult != Z_BUF_ERROR) break;
+            if (zs.avail_out > 0) {
+                // No progress is possible, the compressed text is truncated
+                if (zlibResult == Z_BUF_ERROR) break;
+                continue;
             }
-            else {
-                // something bad happened
-                throw Error(kerFailedToReadImageData);
+            if (buf.size_ >= maxSize) {
+                zlibResult = Z_BUF_ERROR;
+                break;
             }
+            // Continue in a larger buffer
+            DataBuf larger(EXV_MIN(2 * buf.size_, maxSize));
+            std::memcpy(larger.pData_, buf.pData_, zs.total_out);
+            buf = larger;
+            zs.next_out = buf.pData_ + zs.total_out;
+            zs.avail_out = static_cast<uInt>(buf.size_ - zs.total_out);
         }
-        while (zlibResult == Z_BUF_ERROR);
-
-        if (zlibResult != Z_OK) {
+        const long size = static_cast<long>(zs.total_out);
+        inflateEnd(&zs);
+        if (zlibResult != Z_STREAM_END) {
             throw Error(kerFailedToReadImageData);
         }
+        buf.size_ = size;
+        arr = buf;
     } // PngChunk::zlibUncompress
 
     std::string PngChunk::zlibCompress(const std::string& text)
@@ -543,7 +600,7 @@ namespace Exiv2 {
 
         // Build chunk data, determine chunk type
         std::string chunkData = keyword + '\0';
-        std::string chunkType;
+        const char* chunkType;
         if (compress) {
             chunkData += '\0' + zlibCompress(text);
             chunkType = "zTXt";
@@ -552,17 +609,7 @@ namespace Exiv2 {
             chunkData += text;
             chunkType = "tEXt";
         }
-        // Determine length of the chunk data
-        byte length[4];
-        ul2Data(length, static_cast<uint32_t>(chunkData.size()), bigEndian);
-        // Calculate CRC on chunk type and chunk data
-        std::string crcData = chunkType + chunkData;
-        uLong tmp = crc32(0L, Z_NULL, 0);
-        tmp       = crc32(tmp, (const Bytef*)crcData.data(), static_cast<uInt>(crcData.size()));
-        byte crc[4];
-        ul2Data(crc, tmp, bigEndian);
-        // Assemble the chunk
-        return std::string((const char*)length, 4) + chunkType + chunkData + std::string((const char*)crc, 4);
+        return makeChunk(chunkType, chunkData);
 
     } // PngChunk::makeAsciiTxtChunk
 
@@ -588,30 +635,35 @@ namespace Exiv2 {
             static const char flags[] = { 0x00, 0x00, 0x00, 0x00, 0x00 };
             chunkData += std::string(flags, 5) + text;
         }
-        // Determine length of the chunk data
-        byte length[4];
-        ul2Data(length, static_cast<uint32_t>(chunkData.size()), bigEndian);
-        // Calculate CRC on chunk type and chunk data
-        std::string chunkType = "iTXt";
-        std::string crcData = chunkType + chunkData;
-        uLong tmp = crc32(0L, Z_NULL, 0);
-        tmp       = crc32(tmp, (const Bytef*)crcData.data(), static_cast<uInt>(crcData.size()));
-        byte crc[4];
-        ul2Data(crc, tmp, bigEndian);
-        // Assemble the chunk
-        return std::string((const char*)length, 4) + chunkType + chunkData + std::string((const char*)crc, 4);
+        return makeChunk("iTXt", chunkData);
 
     } // PngChunk::makeUtf8TxtChunk
 
+    std::string PngChunk::makeChunk(const char* chunkType, const std::string& chunkData)
+    {
+        // Chunk structure: length (4 bytes) + chunk type + chunk data + CRC (4 bytes)
+        // Length is the size of the chunk data
+        // CRC is calculated on chunk type + chunk data
+        const uint32_t size = static_cast<uint32_t>(chunkData.size());
+        byte buf[4];
+        std::string chunk;
+        chunk.reserve(12 + chunkData.size());
+        ul2Data(buf, size, bigEndian);
+        chunk.append(reinterpret_cast<const char*>(buf), 4);
+        chunk.append(chunkType, 4);
+        chunk.append(chunkData);
+
+        uLong crc = crc32(0L, Z_NULL, 0);
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(chunk.data()) + 4, static_cast<uInt>(4 + size));
+        ul2Data(buf, static_cast<uint32_t>(crc), bigEndian);
+        chunk.append(reinterpret_cast<const char*>(buf), 4);
+        return chunk;
+
+    } // PngChunk::makeChunk
+
     DataBuf PngChunk::readRawProfile(const DataBuf& text,bool iTXt)
     {
         DataBuf                 info;
-        unsigned char           unhex[103]={0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,
-            0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,
-            0,0,0,0,0,0,0,0,0,1, 2,3,4,5,6,7,8,9,0,0,
-            0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,
-            0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,10,11,12,
-            13,14,15};
         if (text.size_ == 0) {
             return DataBuf();
         }
@@ -676,29 +728,12 @@ namespace Exiv2 {
         }
 
         // Copy profile, skipping white space and column 1 "=" signs
-
-        unsigned char *dp = (unsigned char*)info.pData_; // decode pointer
-        unsigned int nibbles = length * 2;
-
-        for (long i = 0; i < (long) nibbles; i++)
+        if (hexDecode(sp, eot, info.pData_, length) == 0)
         {
-            while (*sp < '0' || (*sp > '9' && *sp < 'a') || *sp > 'f')
-            {
-                if (*sp == '\0')
-                {
 #ifdef DEBUG
-                    std::cerr << "Exiv2::PngChunk::readRawProfile: Unable To Copy Raw Profile: ran out of data\n";
+            std::cerr << "Exiv2::PngChunk::readRawProfile: Unable To Copy Raw Profile: ran out of data\n";
 #endif
-                    return DataBuf();
-                }
-
-                sp++;
-            }
-
-            if (i%2 == 0)
-                *dp = (unsigned char) (16*unhex[(int) *sp++]);
-            else
-                (*dp++) += unhex[(int) *sp++];
+            return DataBuf();
         }
 
         return info;
@@ -708,18 +743,24 @@ namespace Exiv2 {
     std::string PngChunk::writeRawProfile(const std::string& profileData,
                                           const char*        profileType)
     {
-        static byte hex[16] = {'0','1','2','3','4','5','6','7','8','9','a','b','c','d','e','f'};
-
         std::ostringstream oss;
         oss << '\n' << profileType << '\n' << std::setw(8) << profileData.size();
-        const char* sp = profileData.data();
-        for (std::string::size_type i = 0; i < profileData.size(); ++i) {
-            if (i % 36 == 0) oss << '\n';
-            oss << hex[((*sp >> 4) & 0x0f)];
-            oss << hex[((*sp++) & 0x0f)];
+        std::string rawProfile = oss.str();
+
+        // Lines of 36 bytes, each encoded as two hex digits
+        const std::string::size_type size = profileData.size();
+        const std::string::size_type offset = rawProfile.size();
+        rawProfile.resize(offset + 2 * size + (size + 35) / 36 + 1);
+        char* dp = &rawProfile[offset];
+        const byte* sp = reinterpret_cast<const byte*>(profileData.data());
+        for (std::string::size_type i = 0; i < size; i += 36) {
+            const std::string::size_type count = size - i < 36 ? size - i : 36;
+            *dp++ = '\n';
+            hexEncode(sp + i, count, dp);
+            dp += 2 * count;
         }
-        oss << '\n';
-        return oss.str();
+        *dp = '\n';
+        return rawProfile;
 
     } // PngChunk::writeRawProfile
 
@@ -84,6 +84,16 @@ namespace Exiv2 {
                                     int*           outWidth,
                                     int*           outHeight);
 
+        /*!
+          @brief Decode the Exif metadata of a PNG eXIf chunk, a TIFF structure
+                 in \em data, into \em pImage. It replaces Exif metadata which
+                 was decoded from a raw text profile before.
+
+          @param pImage    Pointer to the image to hold the metadata
+          @param data      PNG Chunk data buffer.
+        */
+        static void decodeExifChunk(Image* pImage, const DataBuf& data);
+
         /*!
           @brief Decode PNG tEXt, zTXt, or iTXt chunk data from \em pImage passed by data buffer
                  \em data and extract Comment, Exif, Iptc, Xmp metadata accordingly.
@@ -130,10 +140,14 @@ namespace Exiv2 {
         /*!
           @brief Parse PNG Text chunk to determine type and extract content.
                  Supported Chunk types are tTXt, zTXt, and iTXt.
+
+                 If \em extract is false, the chunk is only checked and an
+                 empty buffer is returned.
          */
         static DataBuf parseTXTChunk(const DataBuf& data,
                                      int            keysize,
-                                     TxtChunkType   type);
+                                     TxtChunkType   type,
+                                     bool           extract=true);
 
         /*!
           @brief Parse PNG chunk contents to extract metadata container and assign it to image.
@@ -149,6 +163,16 @@ namespace Exiv2 {
                                             long    keySize,
                                       const DataBuf arr);
 
+        /*!
+          @brief Return true if parseChunkContent() would use the content of a
+                 chunk with this key, i.e., if it has a supported key and the
+                 image has no metadata of that kind yet. Chunks which are not
+                 used are not uncompressed.
+         */
+        static bool isChunkContentUsed(      Image* pImage,
+                                       const byte*  key,
+                                             long   keySize);
+
         /*!
           @brief Return a compressed (zTXt) or uncompressed (tEXt) PNG ASCII text chunk
                  (length + chunk type + chunk data + CRC) as a string.
@@ -175,8 +199,22 @@ namespace Exiv2 {
                                             const std::string& text,
                                             bool               compress);
 
+        /*!
+          @brief Assemble a PNG chunk (length + chunk type + chunk data + CRC)
+                 in a single string.
+
+          The CRC is calculated on the chunk type and the chunk data in place,
+          without concatenating them first.
+        */
+        static std::string makeChunk(const char* chunkType, const std::string& chunkData);
+
         /*!
           @brief Wrapper around zlib to uncompress a PNG chunk content.
+
+          The content is inflated in one pass into a buffer which grows as
+          needed. For DoS protection, it may not be larger than twice the
+          compressed size or 128 KiB, whichever is larger.
+          @throw Error if the content is not valid or too large
          */
         static void zlibUncompress(const byte*  compressedText,
                                    unsigned int compressedTextSize,
@@ -35,6 +35,7 @@
 #include "error.hpp"
 #include "futils.hpp"
 #include "types.hpp"
+#include "stats_int.hpp"
 
 // + standard includes
 #include <string>
@@ -42,6 +43,7 @@
 #include <cstring>
 #include <iostream>
 #include <cassert>
+#include <algorithm>
 
 #include <zlib.h>     // To uncompress IccProfiles
 // Signature from front of PNG file
@@ -64,6 +66,29 @@ namespace
         assert(strlen(str) <= length);
         return memcmp(str, buf.pData_, std::min(static_cast<long>(length), buf.size_)) == 0;
     }
+
+    //! Return the type of the metadata in a text chunk with the keyword \em key
+    int textChunkMetadata(const std::string& key)
+    {
+        static const struct {
+            const char* key_;
+            int id_;
+        } keys[] = {
+            { "Raw profile type exif", Exiv2::mdExif },
+            { "Raw profile type APP1", Exiv2::mdExif },
+            { "Raw profile type iptc", Exiv2::mdIptc },
+            { "Raw profile type xmp",  Exiv2::mdXmp },
+            { "XML:com.adobe.xmp",     Exiv2::mdXmp },
+            { "Raw profile type icc",  Exiv2::mdIccProfile },
+            { "icc",                   Exiv2::mdIccProfile },
+            { "ICC",                   Exiv2::mdIccProfile }
+        };
+        for (auto&& k : keys) {
+            if (key.compare(0, strlen(k.key_), k.key_) == 0) return k.id_;
+        }
+        // Descriptions, authors and any other text
+        return Exiv2::mdComment;
+    }
 }  // namespace
 
 // *****************************************************************************
@@ -73,7 +98,10 @@ namespace Exiv2 {
     using namespace Internal;
 
     PngImage::PngImage(BasicIo::UniquePtr io, bool create)
-            : Image(ImageType::png, mdExif | mdIptc | mdXmp | mdComment, std::move(io))
+            : Image(ImageType::png, mdExif | mdIptc | mdXmp | mdComment, std::move(io)),
+              iccChunk_(-1, 0),
+              iccPending_(false),
+              writeExifRawProfile_(false)
     {
         if (create)
         {
@@ -98,6 +126,41 @@ namespace Exiv2 {
         return "image/png";
     }
 
+    void PngImage::writeExifRawProfile(bool flag)
+    {
+        writeExifRawProfile_ = flag;
+    }
+
+    bool PngImage::writeExifRawProfile() const
+    {
+        return writeExifRawProfile_;
+    }
+
+    void PngImage::setIccProfile(DataBuf& iccProfile, bool bTestValid)
+    {
+        Image::setIccProfile(iccProfile, bTestValid);
+        iccChunk_ = std::make_pair(-1L, 0U);
+        iccPending_ = false;
+    }
+
+    void PngImage::clearIccProfile()
+    {
+        Image::clearIccProfile();
+        iccChunk_ = std::make_pair(-1L, 0U);
+        iccPending_ = false;
+    }
+
+    bool PngImage::iccProfileDefined()
+    {
+        return iccPending_ || Image::iccProfileDefined();
+    }
+
+    DataBuf* PngImage::iccProfile()
+    {
+        readIccProfile();
+        return Image::iccProfile();
+    }
+
     static bool zlibToDataBuf(const byte* bytes,long length, DataBuf& result)
     {
         uLongf uncompressedLen = length * 2; // just a starting point
@@ -106,6 +169,7 @@ namespace Exiv2 {
         do {
             result.alloc(uncompressedLen);
             zlibResult = uncompress((Bytef*)result.pData_,&uncompressedLen,bytes,length);
+            Internal::ParseBudget::checkInflatedSize(uncompressedLen);
             // if result buffer is large than necessary, redo to fit perfectly.
             if (zlibResult == Z_OK && (long) uncompressedLen < result.size_ ) {
                 result.free();
@@ -126,6 +190,29 @@ namespace Exiv2 {
         return zlibResult == Z_OK ;
     }
 
+    void PngImage::readIccProfile()
+    {
+        if (!iccPending_) return;
+        const long iccOffset = static_cast<long>(profileName_.size()) + 2;  // nul + 'compressed' flag
+        const long length = static_cast<long>(iccChunk_.second) - iccOffset;
+        DataBuf compressed(length);
+        // The IoCloser also installs the parse limits of the image for the inflation
+        std::unique_ptr<IoCloser> closer;
+        if (!io_->isopen()) {
+            if (io_->open() != 0) throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+            closer.reset(new IoCloser(*io_));
+        }
+        if (io_->readAt(iccChunk_.first + 8 + iccOffset, compressed.pData_, length) != length) {
+            throw Error(kerFailedToReadImageData);
+        }
+        iccPending_ = false;
+        zlibToDataBuf(compressed.pData_, compressed.size_, iccProfile_);
+#ifdef DEBUG
+        std::cout << "Exiv2::PngImage::readIccProfile: iccProfile.size_ (uncompressed) : " << iccProfile_.size_
+                  << std::endl;
+#endif
+    }
+
     static bool zlibToCompressed(const byte* bytes,long length, DataBuf& result)
     {
         uLongf compressedLen = length; // just a starting point
@@ -267,8 +354,7 @@ namespace Exiv2 {
                 }
 
                 DataBuf   buff(dataOffset);
-                io_->read(buff.pData_,dataOffset);
-                io_->seek(restore, BasicIo::beg);
+                io_->readAt(restore, buff.pData_, dataOffset);
 
                 // format output
                 const int    iMax = 30 ;
@@ -284,10 +370,8 @@ namespace Exiv2 {
                 dataString = dataString.substr(0,iMax);
 
                 if ( bPrint ) {
-                    io_->seek(dataOffset, BasicIo::cur);// jump to checksum
-                    byte checksum[4];
-                    io_->read(checksum,4);
-                    io_->seek(restore, BasicIo::beg)   ;// restore file pointer
+                    byte checksum[4] = { 0, 0, 0, 0 };
+                    io_->readAt(restore + dataOffset, checksum, 4);
 
                     out << Internal::stringFormat("%8d | %-5s |%8d | "
                                                   ,(uint32_t)address, chType,dataOffset)
@@ -303,6 +387,12 @@ namespace Exiv2 {
                 bool iCCP  = std::strcmp(chType,"iCCP")== 0;
                 bool iTXt  = std::strcmp(chType,"iTXt")== 0;
 
+                // the eXIf chunk holds the TIFF structure itself
+                if ( option == kpsRecursive && std::strcmp(chType,"eXIf") == 0 && dataOffset > 0 ) {
+                    MemIo exif(buff.pData_, dataOffset);
+                    printTiffStructure(exif,out,option,depth);
+                }
+
                 // for XMP, ICC etc: read and format data
                 bool bXMP  = option == kpsXMP        && findi(dataString,xmpKey)==0;
                 bool bICC  = option == kpsIccProfile && findi(dataString,iccKey)==0;
@@ -317,8 +407,7 @@ namespace Exiv2 {
                     DataBuf   dataBuf;
                     byte*     data   = new byte[dataOffset+1];
                     data[dataOffset] = 0;
-                    io_->read(data,dataOffset);
-                    io_->seek(restore, BasicIo::beg);
+                    std::memcpy(data, buff.pData_, dataOffset);
                     uint32_t  name_l = (uint32_t) std::strlen((const char*)data)+1; // leading string length
                     uint32_t  start  = name_l;
 
@@ -417,12 +506,15 @@ namespace Exiv2 {
             throw Error(kerNotAnImage, "PNG");
         }
         clearMetadata();
+        payloadHashDefined_ = false;
+        PayloadHash hash;
 
         const long imgSize = (long) io_->size();
         DataBuf cheaderBuf(8);       // Chunk header: 4 bytes (data size) + 4 bytes (chunk type).
 
         while(!io_->eof())
         {
+            Internal::ParseBudget::checkDeadline();
             std::memset(cheaderBuf.pData_, 0x0, cheaderBuf.size_);
             readChunk(cheaderBuf, *io_); // Read chunk header.
 
@@ -444,11 +536,16 @@ namespace Exiv2 {
             /// \todo analyse remaining chunks of the standard
             // Perform a chunk triage for item that we need.
             if (chunkType == "IEND" || chunkType == "IHDR" || chunkType == "tEXt" || chunkType == "zTXt" ||
-                chunkType == "iTXt" || chunkType == "iCCP") {
-                DataBuf chunkData(chunkLength);
+                chunkType == "iTXt" || chunkType == "eXIf") {
+                DataBuf chunkData = DataBuf::pooled(chunkLength);
                 readChunk(chunkData, *io_);  // Extract chunk data.
 
                 if (chunkType == "IEND") {
+                    if (hashPayload()) {
+                        payloadHash_ = hash.value();
+                        payloadHashDefined_ = true;
+                    }
+                    releasePackets();
                     return;  // Last chunk found: we stop parsing.
                 } else if (chunkType == "IHDR" && chunkData.size_ >= 8) {
                     PngChunk::decodeIHDRChunk(chunkData, &pixelWidth_, &pixelHeight_);
@@ -458,28 +555,36 @@ namespace Exiv2 {
                     PngChunk::decodeTXTChunk(this, chunkData, PngChunk::zTXt_Chunk);
                 } else if (chunkType == "iTXt") {
                     PngChunk::decodeTXTChunk(this, chunkData, PngChunk::iTXt_Chunk);
-                } else if (chunkType == "iCCP") {
-                    // The ICC profile name can vary from 1-79 characters.
-                    uint32_t iccOffset = 0;
-                    while (iccOffset < 80 && iccOffset < chunkLength) {
-                         if (chunkData.pData_[iccOffset++] ==  0x00) {
-                            break;
-                         }
-                    }
-                    profileName_ = std::string(reinterpret_cast<char *>(chunkData.pData_), iccOffset-1);
-                    ++iccOffset; // +1 = 'compressed' flag
-
-                    zlibToDataBuf(chunkData.pData_ + iccOffset, chunkLength - iccOffset, iccProfile_);
-#ifdef DEBUG
-                    std::cout << "Exiv2::PngImage::readMetadata: profile name: " << profileName_ << std::endl;
-                    std::cout << "Exiv2::PngImage::readMetadata: iccProfile.size_ (uncompressed) : "
-                              << iccProfile_.size_ << std::endl;
-#endif
+                } else if (chunkType == "eXIf") {
+                    PngChunk::decodeExifChunk(this, chunkData);
                 }
 
                 // Set chunkLength to 0 in case we have read a supported chunk type. Otherwise, we need to seek the
                 // file to the next chunk position.
                 chunkLength = 0;
+            } else if (chunkType == "iCCP") {
+                // The ICC profile name can vary from 1-79 characters. Only the name is read here,
+                // readIccProfile() inflates the profile when it is accessed.
+                DataBuf nameBuf(static_cast<long>(std::min(chunkLength, uint32_t(80))));
+                readChunk(nameBuf, *io_);
+                uint32_t iccOffset = 0;
+                while (iccOffset < static_cast<uint32_t>(nameBuf.size_)) {
+                    if (nameBuf.pData_[iccOffset++] == 0x00) {
+                        break;
+                    }
+                }
+                profileName_ = std::string(reinterpret_cast<char*>(nameBuf.pData_), iccOffset - 1);
+                if (iccOffset + 1 <= chunkLength) {  // +1 = 'compressed' flag
+                    iccChunk_ = std::make_pair(pos - 8, chunkLength);
+                    iccPending_ = true;
+                }
+#ifdef DEBUG
+                std::cout << "Exiv2::PngImage::readMetadata: profile name: " << profileName_ << std::endl;
+#endif
+                io_->seek(pos, BasicIo::beg);
+            } else if (chunkType == "IDAT" && hashPayload()) {
+                hashData(*io_, static_cast<long>(chunkLength), hash);
+                chunkLength = 0;
             }
 
 
@@ -492,28 +597,129 @@ namespace Exiv2 {
                 throw Error(kerFailedToReadImageData);
             }
         }
+        releasePackets();
     } // PngImage::readMetadata
 
+    void PngImage::readBasicInfo()
+    {
+        if (io_->open() != 0)
+        {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+        IoCloser closer(*io_);
+        if (!isPngType(*io_, true)) {
+            throw Error(kerNotAnImage, "PNG");
+        }
+        clearMetadata();
+
+        // IHDR is required to be the first chunk of the stream.
+        DataBuf cheaderBuf(8);
+        readChunk(cheaderBuf, *io_);
+        const uint32_t chunkLength = Exiv2::getULong(cheaderBuf.pData_, Exiv2::bigEndian);
+        if (std::memcmp(cheaderBuf.pData_ + 4, "IHDR", 4) != 0 || chunkLength < 8 ||
+            chunkLength > uint32_t(0x7FFFFFFF) || static_cast<long>(chunkLength) > (long)io_->size() - io_->tell()) {
+            throw Error(kerFailedToReadImageData);
+        }
+        DataBuf chunkData(chunkLength);
+        readChunk(chunkData, *io_);
+        PngChunk::decodeIHDRChunk(chunkData, &pixelWidth_, &pixelHeight_);
+    } // PngImage::readBasicInfo
+
     void PngImage::writeMetadata()
     {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
         if (io_->open() != 0)
         {
             throw Error(kerDataSourceOpenFailed, io_->path(), strError());
         }
         IoCloser closer(*io_);
-        BasicIo::UniquePtr tempIo(new MemIo);
+        std::unique_ptr<MemIo> tempIo(new MemIo);
         assert (tempIo.get() != 0);
+        tempIo->reserve(static_cast<long>(io_->size())); // the new image has about the same size
 
-        doWriteMetadata(*tempIo); // may throw
+        const long iccOut = doWriteMetadata(*tempIo); // may throw
         io_->close();
         io_->transfer(*tempIo); // may throw
+        if (iccOut >= 0) iccChunk_.first = iccOut;
 
     } // PngImage::writeMetadata
 
-    void PngImage::doWriteMetadata(BasicIo& outIo)
+    void PngImage::writeMetadataTo(BasicIo& dst)
+    {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
+        if (io_->open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+        IoCloser closer(*io_);
+        doWriteMetadata(dst); // may throw
+    } // PngImage::writeMetadataTo
+
+    void PngImage::stripMetadataTo(BasicIo& dst, int keep)
+    {
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
+        if (io_->open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+        IoCloser closer(*io_);
+        if (!dst.isopen()) throw Error(kerImageWriteFailed);
+        io_->advise(BasicIo::sequentialAccess);
+        if (!isPngType(*io_, true)) throw Error(kerNoImageInInputData);
+        if (dst.write(pngSignature, 8) != 8) throw Error(kerImageWriteFailed);
+
+        byte chunk[8 + 80]; // chunk header and the keyword of text chunks
+        PayloadHash hash;
+        bool end = false;
+        while (!end) {
+            if (io_->read(chunk, 8) != 8) throw Error(kerInputDataReadFailed);
+            const uint32_t dataSize = getULong(chunk, bigEndian);
+            if (dataSize > 0x7FFFFFFF) throw Error(kerFailedToReadImageData);
+            const byte* type = chunk + 4;
+            long head = 8;
+            bool isMetadata = true;
+            int id = mdNone;
+            if (!memcmp(type, "tEXt", 4) || !memcmp(type, "zTXt", 4) || !memcmp(type, "iTXt", 4)) {
+                head += std::min(static_cast<long>(dataSize), 80L);
+                if (io_->read(chunk + 8, head - 8) != head - 8) throw Error(kerInputDataReadFailed);
+                const byte* key = chunk + 8;
+                const byte* keyEnd = std::find(key, static_cast<const byte*>(chunk + head), 0);
+                id = textChunkMetadata(std::string(reinterpret_cast<const char*>(key), keyEnd - key));
+            } else if (!memcmp(type, "eXIf", 4)) {
+                id = mdExif;
+            } else if (!memcmp(type, "iCCP", 4)) {
+                id = mdIccProfile;
+            } else {
+                isMetadata = false;
+                end = !memcmp(type, "IEND", 4);
+            }
+
+            // The rest of the chunk data and the CRC
+            const long rest = static_cast<long>(dataSize) + 12 - head;
+            if (!isMetadata || (keep & id) != 0) {
+                if (dst.write(chunk, head) != head) throw Error(kerImageWriteFailed);
+                if (hashPayload() && !memcmp(type, "IDAT", 4)) {
+                    copyData(*io_, dst, rest - 4, &hash);
+                    copyData(*io_, dst, 4);
+                } else {
+                    copyData(*io_, dst, rest);
+                }
+            } else if (io_->seek(rest, BasicIo::cur) != 0) {
+                throw Error(kerInputDataReadFailed);
+            }
+        }
+        if (hashPayload()) {
+            payloadHash_ = hash.value();
+            payloadHashDefined_ = true;
+        }
+    } // PngImage::stripMetadataTo
+
+    long PngImage::doWriteMetadata(BasicIo& outIo)
     {
         if (!io_->isopen()) throw Error(kerInputDataReadFailed);
         if (!outIo.isopen()) throw Error(kerImageWriteFailed);
+        // The image is copied from start to end
+        io_->advise(BasicIo::sequentialAccess);
 
 #ifdef DEBUG
         std::cout << "Exiv2::PngImage::doWriteMetadata: Writing PNG file " << io_->path() << "\n";
@@ -528,6 +734,7 @@ namespace Exiv2 {
         if (outIo.write(pngSignature, 8) != 8) throw Error(kerImageWriteFailed);
 
         DataBuf cheaderBuf(8);       // Chunk header : 4 bytes (data size) + 4 bytes (chunk type).
+        long iccOut = -1;
 
         while(!io_->eof())
         {
@@ -543,6 +750,31 @@ namespace Exiv2 {
             uint32_t dataOffset = getULong(cheaderBuf.pData_, bigEndian);
             if (dataOffset > 0x7FFFFFFF) throw Exiv2::Error(kerFailedToReadImageData);
 
+            const bool isTextChunk = !memcmp(cheaderBuf.pData_ + 4, "tEXt", 4) ||
+                                     !memcmp(cheaderBuf.pData_ + 4, "zTXt", 4) ||
+                                     !memcmp(cheaderBuf.pData_ + 4, "iTXt", 4) ||
+                                     !memcmp(cheaderBuf.pData_ + 4, "iCCP", 4);
+            if (!memcmp(cheaderBuf.pData_ + 4, "eXIf", 4)) {
+                // The Exif metadata is written after IHDR
+                if (io_->seek(static_cast<long>(dataOffset) + 4, BasicIo::cur) != 0) {
+                    throw Error(kerFailedToReadImageData);
+                }
+                continue;
+            }
+            if (!isTextChunk &&
+                memcmp(cheaderBuf.pData_ + 4, "IEND", 4) &&
+                memcmp(cheaderBuf.pData_ + 4, "IHDR", 4))
+            {
+                // Stream all other chunks (in particular IDAT) without reading them into memory.
+#ifdef DEBUG
+                std::cout << "Exiv2::PngImage::doWriteMetadata:  copy " << std::string((const char*)cheaderBuf.pData_ + 4, 4)
+                          << " chunk (length: " << dataOffset << ")" << std::endl;
+#endif
+                if (outIo.write(cheaderBuf.pData_, cheaderBuf.size_) != cheaderBuf.size_) throw Error(kerImageWriteFailed);
+                copyData(*io_, outIo, static_cast<long>(dataOffset) + 4);
+                continue;
+            }
+
             // Read whole chunk : Chunk header + Chunk data (not fixed size - can be null) + CRC (4 bytes).
 
             DataBuf chunkBuf(8 + dataOffset + 4);                     // Chunk header (8 bytes) + Chunk data + CRC (4 bytes).
@@ -562,7 +794,7 @@ namespace Exiv2 {
                 std::cout << "Exiv2::PngImage::doWriteMetadata: Write IEND chunk (length: " << dataOffset << ")\n";
 #endif
                 if (outIo.write(chunkBuf.pData_, chunkBuf.size_) != chunkBuf.size_) throw Error(kerImageWriteFailed);
-                return;
+                return iccOut;
             }
             else if (!memcmp(cheaderBuf.pData_ + 4, "IHDR", 4))
             {
@@ -589,10 +821,15 @@ namespace Exiv2 {
                     ExifParser::encode(blob, littleEndian, exifData_);
                     if (blob.size() > 0)
                     {
-                        static const char exifHeader[] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
-                        std::string rawExif =   std::string(exifHeader, 6)
-                                              + std::string((const char*)&blob[0], blob.size());
-                        std::string chunk = PngChunk::makeMetadataChunk(rawExif, mdExif);
+                        std::string chunk;
+                        if (writeExifRawProfile_) {
+                            static const char exifHeader[] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
+                            std::string rawExif =   std::string(exifHeader, 6)
+                                                  + std::string((const char*)&blob[0], blob.size());
+                            chunk = PngChunk::makeMetadataChunk(rawExif, mdExif);
+                        } else {
+                            chunk = PngChunk::makeChunk("eXIf", std::string((const char*)&blob[0], blob.size()));
+                        }
                         if (outIo.write((const byte*)chunk.data(), static_cast<long>(chunk.size())) != (long)chunk.size())
                         {
                             throw Error(kerImageWriteFailed);
@@ -600,10 +837,10 @@ namespace Exiv2 {
                     }
                 }
 
-                if (iptcData_.count() > 0)
+                if (iptcData().count() > 0)
                 {
                     // Update IPTC data to a new PNG chunk
-                    DataBuf newPsData = Photoshop::setIptcIrb(0, 0, iptcData_);
+                    DataBuf newPsData = Photoshop::setIptcIrb(0, 0, iptcData());
                     if (newPsData.size_ > 0)
                     {
                         std::string rawIptc((const char*)newPsData.pData_, newPsData.size_);
@@ -615,7 +852,19 @@ namespace Exiv2 {
                     }
                 }
 
-                if ( iccProfileDefined() ) {
+                if (iccPending_) {
+                    // The profile was not accessed, copy the compressed chunk of the image
+                    DataBuf iccChunk(static_cast<long>(iccChunk_.second) + 12);
+                    if (io_->readAt(iccChunk_.first, iccChunk.pData_, iccChunk.size_) != iccChunk.size_) {
+                        throw Error(kerFailedToReadImageData);
+                    }
+                    iccOut = outIo.tell();
+                    if (outIo.write(iccChunk.pData_, iccChunk.size_) != iccChunk.size_) throw Error(kerImageWriteFailed);
+#ifdef DEBUG
+                    std::cout << "Exiv2::PngImage::doWriteMetadata: copy iCCP"
+                              << " chunk (length: " << iccChunk_.second << ")" << std::endl;
+#endif
+                } else if ( iccProfileDefined() ) {
                     DataBuf compressed;
                     if ( zlibToCompressed(iccProfile_.pData_,iccProfile_.size_,compressed) ) {
 
@@ -635,13 +884,15 @@ namespace Exiv2 {
                         byte    crc[4];
                         ul2Data(crc, tmp, bigEndian);
 
-                        if( outIo.write(length, 4) != 4
-                        ||  outIo.write(type, 4) != 4
-                        ||  outIo.write(reinterpret_cast<const byte*>(profileName_.data()), nameLength) != nameLength
-                        ||  outIo.write(nullComp,2) != 2
-                        ||  outIo.write (compressed.pData_,compressed.size_) != compressed.size_
-                        ||  outIo.write(crc,4)            != 4
-                        ){
+                        const std::pair<const byte*, long> pieces[] = {
+                            std::make_pair(static_cast<const byte*>(length), 4L),
+                            std::make_pair(type, 4L),
+                            std::make_pair(reinterpret_cast<const byte*>(profileName_.data()), static_cast<long>(nameLength)),
+                            std::make_pair(nullComp, 2L),
+                            std::make_pair(static_cast<const byte*>(compressed.pData_), compressed.size_),
+                            std::make_pair(static_cast<const byte*>(crc), 4L)
+                        };
+                        if (outIo.writev(pieces, EXV_COUNTOF(pieces)) != static_cast<long>(chunkLength) + 12) {
                             throw Error(kerImageWriteFailed);
                         }
 #ifdef DEBUG
@@ -652,7 +903,7 @@ namespace Exiv2 {
                 }
 
                 if (writeXmpFromPacket() == false) {
-                    if (XmpParser::encode(xmpPacket_, xmpData_) > 1) {
+                    if (XmpParser::encode(xmpPacket_, xmpData()) > 1) {
 #ifndef SUPPRESS_WARNINGS
                         EXV_ERROR << "Failed to encode XMP metadata.\n";
 #endif
@@ -666,13 +917,12 @@ namespace Exiv2 {
                     }
                 }
             }
-            else if (!memcmp(cheaderBuf.pData_ + 4, "tEXt", 4) ||
-                     !memcmp(cheaderBuf.pData_ + 4, "zTXt", 4) ||
-                     !memcmp(cheaderBuf.pData_ + 4, "iTXt", 4) ||
-                     !memcmp(cheaderBuf.pData_ + 4, "iCCP", 4))
+            else
             {
+                assert(isTextChunk);
                 DataBuf key = PngChunk::keyTXTChunk(chunkBuf, true);
-                if (compare("Raw profile type exif", key, 21) ||
+                if (!memcmp(cheaderBuf.pData_ + 4, "iCCP", 4) ||
+                    compare("Raw profile type exif", key, 21) ||
                     compare("Raw profile type APP1", key, 21) ||
                     compare("Raw profile type iptc", key, 21) ||
                     compare("Raw profile type xmp",  key, 20) ||
@@ -695,18 +945,8 @@ namespace Exiv2 {
                     if (outIo.write(chunkBuf.pData_, chunkBuf.size_) != chunkBuf.size_) throw Error(kerImageWriteFailed);
                 }
             }
-            else
-            {
-                // Write all others chunk as well.
-#ifdef DEBUG
-                std::cout << "Exiv2::PngImage::doWriteMetadata:  copy " << szChunk
-                          << " chunk (length: " << dataOffset << ")" << std::endl;
-#endif
-                if (outIo.write(chunkBuf.pData_, chunkBuf.size_) != chunkBuf.size_) throw Error(kerImageWriteFailed);
-
-            }
         }
-
+        return iccOut;
     } // PngImage::doWriteMetadata
 
     // *************************************************************************
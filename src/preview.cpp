@@ -26,7 +26,9 @@
 // included header files
 #include "config.h"
 
+#include <algorithm>
 #include <climits>
+#include <future>
 #include <string>
 
 #include "preview.hpp"
@@ -39,7 +41,8 @@
 #include "jpgimage.hpp"
 #include "tiffimage.hpp"
 #include "tiffimage_int.hpp"
-#include "unused.h"
+#include "image_int.hpp"
+#include "subio_int.hpp"
 
 // *****************************************************************************
 namespace {
@@ -68,11 +71,6 @@ namespace {
      */
     DataBuf decodeHex(const byte *src, long srcSize);
 
-    /*!
-      @brief Decode a Base64 string.
-     */
-    DataBuf decodeBase64(const std::string &src);
-
     /*!
       @brief Decode an Illustrator thumbnail that follows after %AI7_Thumbnail.
      */
@@ -83,6 +81,34 @@ namespace {
      */
     DataBuf makePnm(uint32_t width, uint32_t height, const DataBuf &rgb);
 
+    /*!
+      @brief Read the dimensions of a JPEG image from its frame header. Only
+             the marker segments before the first SOFn marker are looked at,
+             the image itself is not decoded.
+
+      @return false if \em pData does not start with a JPEG SOI marker;
+              otherwise true, with \em width and \em height left unchanged
+              if there is no valid frame header.
+     */
+    bool readJpegDimensions(const byte* pData, uint32_t size, uint32_t& width, uint32_t& height);
+
+    /*!
+      @brief Read the dimensions of the JPEG image of \em size bytes at
+             \em offset in \em io, like the function above. Only the marker
+             segment headers are read, with positional reads.
+     */
+    bool readJpegDimensions(BasicIo& io, long offset, uint32_t size, uint32_t& width, uint32_t& height);
+
+    /*!
+      @brief Read \em size bytes at \em offset in \em io with a positional
+             read, which fetches only this range from remote IO sources.
+      @throw Error if the data cannot be read
+     */
+    DataBuf readRange(BasicIo& io, long offset, long size);
+
+    //! Ranges of preview image data in the source image, an offset < 0 denotes zero bytes
+    typedef std::vector<std::pair<long, uint32_t> > DataRanges;
+
     /*!
       Base class for image loaders. Provides virtual methods for reading properties
       and DataBuf.
@@ -110,6 +136,20 @@ namespace {
         //! Read preview image dimensions when they are not available directly
         virtual bool readDimensions() { return true; }
 
+        /*!
+          @brief Get the layout of the preview image, if its data can be
+                 taken from the source image: the generated data \em head,
+                 followed by the \em ranges of the source image. Return
+                 false otherwise.
+         */
+        virtual bool getDataLayout(Blob& /*head*/, DataRanges& /*ranges*/) const { return false; }
+
+        //! Preview image width in pixels or 0 if not known yet
+        uint32_t width() const { return width_; }
+
+        //! Preview image height in pixels or 0 if not known yet
+        uint32_t height() const { return height_; }
+
         //! A number of image loaders configured in the loaderList_ table
         static PreviewId getNumLoaders();
 
@@ -164,6 +204,9 @@ namespace {
         //! Read preview image dimensions
         bool readDimensions() override;
 
+        //! Get the layout of the preview image in the source image
+        bool getDataLayout(Blob& head, DataRanges& ranges) const override;
+
     protected:
         //! Native preview information
         NativePreview nativePreview_;
@@ -188,6 +231,9 @@ namespace {
         //! Read preview image dimensions
         bool readDimensions() override;
 
+        //! Get the layout of the preview image in the source image
+        bool getDataLayout(Blob& head, DataRanges& ranges) const override;
+
     protected:
         //! Structure that lists offset/size tag pairs
         struct Param {
@@ -251,7 +297,13 @@ namespace {
         //! Get a buffer that contains the preview image
         DataBuf getData() const override;
 
+        //! Get the layout of the preview image: the TIFF structure followed by the strips
+        bool getDataLayout(Blob& head, DataRanges& ranges) const override;
+
     protected:
+        //! Copy the TIFF image tags of the preview image to \em preview
+        void copyTags(ExifData& preview) const;
+
         //! Name of the group that contains the preview image
         const char *group_;
 
@@ -292,8 +344,15 @@ namespace {
         bool readDimensions() override;
 
     protected:
+        //! Return the decoded preview image, decoding it on first use
+        const DataBuf& preview() const;
+
+        //! Xmp datum with the base64 encoded preview image
+        XmpData::const_iterator imageDatum_;
+        //! True if preview_ holds the decoded image
+        mutable bool decoded_;
         //! Preview image data
-        DataBuf preview_;
+        mutable DataBuf preview_;
     };
 
     //! Function to create new LoaderXmpJpeg
@@ -468,21 +527,21 @@ namespace {
             throw Error(kerDataSourceOpenFailed, io.path(), strError());
         }
         IoCloser closer(io);
-        const byte* data = io.mmap();
         if ((long)io.size() < nativePreview_.position_ + static_cast<long>(nativePreview_.size_)) {
 #ifndef SUPPRESS_WARNINGS
             EXV_WARNING << "Invalid native preview position or size.\n";
 #endif
             return DataBuf();
         }
+        DataBuf data = readRange(io, nativePreview_.position_, static_cast<long>(nativePreview_.size_));
         if (nativePreview_.filter_ == "") {
-            return DataBuf(data + nativePreview_.position_, static_cast<long>(nativePreview_.size_));
+            return data;
         } else if (nativePreview_.filter_ == "hex-ai7thumbnail-pnm") {
-            const DataBuf ai7thumbnail = decodeHex(data + nativePreview_.position_, static_cast<long>(nativePreview_.size_));
+            const DataBuf ai7thumbnail = decodeHex(data.pData_, data.size_);
             const DataBuf rgb = decodeAi7Thumbnail(ai7thumbnail);
             return makePnm(width_, height_, rgb);
         } else if (nativePreview_.filter_ == "hex-irb") {
-            const DataBuf psData = decodeHex(data + nativePreview_.position_, static_cast<long>(nativePreview_.size_));
+            const DataBuf psData = decodeHex(data.pData_, data.size_);
             const byte *record;
             uint32_t sizeHdr;
             uint32_t sizeData;
@@ -498,15 +557,46 @@ namespace {
         }
     }
 
+    bool LoaderNative::getDataLayout(Blob& /*head*/, DataRanges& ranges) const
+    {
+        if (!valid() || nativePreview_.filter_ != "") return false;
+        if ((long)image_.io().size() < nativePreview_.position_ + static_cast<long>(nativePreview_.size_)) return false;
+        ranges.push_back(std::make_pair(nativePreview_.position_, static_cast<uint32_t>(nativePreview_.size_)));
+        return true;
+    }
+
     bool LoaderNative::readDimensions()
     {
         if (!valid()) return false;
         if (width_ != 0 || height_ != 0) return true;
 
-        const DataBuf data = getData();
-        if (data.size_ == 0) return false;
+        BasicIo &io = image_.io();
+        if (nativePreview_.filter_ == "") {
+            if (io.open() != 0) {
+                throw Error(kerDataSourceOpenFailed, io.path(), strError());
+            }
+            IoCloser closer(io);
+            if (static_cast<long>(io.size()) < nativePreview_.position_ + static_cast<long>(nativePreview_.size_)) {
+#ifndef SUPPRESS_WARNINGS
+                EXV_WARNING << "Invalid native preview position or size.\n";
+#endif
+                return false;
+            }
+            if (readJpegDimensions(io, nativePreview_.position_, nativePreview_.size_, width_, height_)) {
+                return true;
+            }
+        }
+
+        // an unfiltered preview is parsed in place, only filtered ones are decoded to memory
+        DataBuf data;
+        if (nativePreview_.filter_ != "") {
+            data = getData();
+            if (data.size_ == 0) return false;
+        }
         try {
-            Image::UniquePtr image = ImageFactory::open(data.pData_, data.size_);
+            Image::UniquePtr image = nativePreview_.filter_ == ""
+                ? ImageFactory::open(BasicIo::UniquePtr(new Internal::SubIo(io, nativePreview_.position_, nativePreview_.size_)))
+                : ImageFactory::open(data.pData_, data.size_);
             if (image.get() == 0) return false;
             image->readMetadata();
 
@@ -578,9 +668,14 @@ namespace {
         }
         IoCloser closer(io);
 
-        const Exiv2::byte* base = io.mmap();
+        return readRange(io, offset_, size_);
+    }
 
-        return DataBuf(base + offset_, size_);
+    bool LoaderExifJpeg::getDataLayout(Blob& /*head*/, DataRanges& ranges) const
+    {
+        if (!valid()) return false;
+        ranges.push_back(std::make_pair(static_cast<long>(offset_), size_));
+        return true;
     }
 
     bool LoaderExifJpeg::readDimensions()
@@ -589,15 +684,17 @@ namespace {
         if (width_ || height_) return true;
 
         BasicIo &io = image_.io();
-
-        if (io.open() != 0) {
-            throw Error(kerDataSourceOpenFailed, io.path(), strError());
+        {
+            if (io.open() != 0) {
+                throw Error(kerDataSourceOpenFailed, io.path(), strError());
+            }
+            IoCloser closer(io);
+            if (readJpegDimensions(io, offset_, size_, width_, height_)) return true;
         }
-        IoCloser closer(io);
-        const Exiv2::byte* base = io.mmap();
 
+        // the preview is parsed in place, like an unfiltered native preview
         try {
-            Image::UniquePtr image = ImageFactory::open(base + offset_, size_);
+            Image::UniquePtr image = ImageFactory::open(BasicIo::UniquePtr(new Internal::SubIo(io, offset_, size_)));
             if (image.get() == 0) return false;
             image->readMetadata();
 
@@ -673,6 +770,8 @@ namespace {
         DataBuf buf = getData();
         if (buf.size_ == 0) return false;
 
+        if (readJpegDimensions(buf.pData_, buf.size_, width_, height_)) return true;
+
         try {
             Image::UniquePtr image = ImageFactory::open(buf.pData_, buf.size_);
             if (image.get() == 0) return false;
@@ -755,15 +854,52 @@ namespace {
 #ifdef EXV_UNICODE_PATH
         prop.wextension_ = EXV_WIDEN(".tif");
 #endif
+        // The preview is a new TIFF image. Its size is that of the structure,
+        // which is encoded with a 2 byte placeholder for the image data here,
+        // plus the size of the image data which getData() adds.
+        ExifData preview;
+        copyTags(preview);
+        Value &dataValue = const_cast<Value&>(preview["Exif.Image." + offsetTag_].value());
+        Value &sizes = const_cast<Value&>(preview["Exif.Image." + sizeTag_].value());
+        uint32_t dataSize = dataValue.sizeDataArea();
+        if (dataSize == 0 && sizes.count() == dataValue.count()) {
+            if (sizes.count() == 1) {
+                uint32_t offset = dataValue.toLong(0);
+                uint32_t size = sizes.toLong(0);
+                if (Safe::add(offset, size) <= static_cast<uint32_t>(image_.io().size()))
+                    dataSize = size;
+            }
+            else {
+                dataSize = size_;
+            }
+        }
+        uint32_t placeholderSize = 0;
+        if (dataSize > 0) {
+            // The sizes must add up to the size of the data area
+            std::string placeholderSizes = "2";
+            for (long i = 1; i < sizes.count(); ++i) placeholderSizes += " 0";
+            if (sizes.read(placeholderSizes) != 0 || sizes.toLong(0) != 2) {
+                // Unusual size tag, create the preview to find its size
+                prop.size_ = getData().size_;
+                return prop;
+            }
+            const byte placeholder[2] = { 0, 0 };
+            dataValue.setDataArea(placeholder, 2);
+            placeholderSize = 2;
+        }
+
+        MemIo mio;
+        IptcData emptyIptc;
+        XmpData  emptyXmp;
+        TiffParser::encode(mio, 0, 0, Exiv2::littleEndian, preview, emptyIptc, emptyXmp);
+        prop.size_ = static_cast<uint32_t>(mio.size()) - placeholderSize + dataSize + (dataSize & 1);
         return prop;
     }
 
-    DataBuf LoaderTiff::getData() const
+    void LoaderTiff::copyTags(ExifData& preview) const
     {
         const ExifData &exifData = image_.exifData();
 
-        ExifData preview;
-
         // copy tags
         for (ExifData::const_iterator pos = exifData.begin(); pos != exifData.end(); ++pos) {
             if (pos->groupName() == group_) {
@@ -781,6 +917,17 @@ namespace {
             }
         }
 
+        // Fix compression value in the CR2 IFD2 image
+        if (0 == strcmp(group_, "Image2") && image_.mimeType() == "image/x-canon-cr2") {
+            preview["Exif.Image.Compression"] = uint16_t(1);
+        }
+    }
+
+    DataBuf LoaderTiff::getData() const
+    {
+        ExifData preview;
+        copyTags(preview);
+
         Value &dataValue = const_cast<Value&>(preview["Exif.Image." + offsetTag_].value());
 
         if (dataValue.sizeDataArea() == 0) {
@@ -811,7 +958,7 @@ namespace {
                     for (int i = 0; i < sizes.count(); i++) {
                         uint32_t offset = dataValue.toLong(i);
                         uint32_t size = sizes.toLong(i);
-                        enforce(Safe::add(idxBuf, size) < size_, kerCorruptedMetadata);
+                        enforce(Safe::add(idxBuf, size) <= size_, kerCorruptedMetadata);
                         if (size!=0 && Safe::add(offset, size) <= static_cast<uint32_t>(io.size()))
                             memcpy(&buf.pData_[idxBuf], base + offset, size);
                         idxBuf += size;
@@ -821,11 +968,6 @@ namespace {
             }
         }
 
-        // Fix compression value in the CR2 IFD2 image
-        if (0 == strcmp(group_, "Image2") && image_.mimeType() == "image/x-canon-cr2") {
-            preview["Exif.Image.Compression"] = uint16_t(1);
-        }
-
         // write new image
         MemIo mio;
         IptcData emptyIptc;
@@ -834,8 +976,94 @@ namespace {
         return DataBuf(mio.mmap(), (long) mio.size());
     }
 
+    bool LoaderTiff::getDataLayout(Blob& head, DataRanges& ranges) const
+    {
+        if (!valid()) return false;
+
+        ExifData preview;
+        copyTags(preview);
+        Value &dataValue = const_cast<Value&>(preview["Exif.Image." + offsetTag_].value());
+        Value &sizes = const_cast<Value&>(preview["Exif.Image." + sizeTag_].value());
+        if (dataValue.sizeDataArea() != 0 || sizes.count() != dataValue.count()) return false;
+
+        // Locate the strips in the source image like getData() does
+        const uint32_t ioSize = static_cast<uint32_t>(image_.io().size());
+        std::vector<uint32_t> stripSizes;
+        DataRanges strips;
+        uint32_t dataSize = 0;
+        for (long i = 0; i < sizes.count(); ++i) {
+            uint32_t offset = dataValue.toLong(i);
+            uint32_t size = sizes.toLong(i);
+            long start = static_cast<long>(offset);
+            if (sizes.count() == 1) {
+                if (Safe::add(offset, size) > ioSize) return false;
+            }
+            else {
+                enforce(Safe::add(dataSize, size) <= size_, kerCorruptedMetadata);
+                // Strips outside of the source image are filled with zeros
+                if (size == 0 || Safe::add(offset, size) > ioSize) start = -1;
+            }
+            stripSizes.push_back(size);
+            strips.push_back(std::make_pair(start, size));
+            dataSize += size;
+        }
+        if (dataSize == 0) return false;
+
+        // Encode the TIFF structure with a 2 byte placeholder for the image data
+        std::string placeholderSizes = "2";
+        for (long i = 1; i < sizes.count(); ++i) placeholderSizes += " 0";
+        if (sizes.read(placeholderSizes) != 0 || sizes.toLong(0) != 2) return false;
+        const byte placeholder[2] = { 0, 0 };
+        dataValue.setDataArea(placeholder, 2);
+
+        MemIo mio;
+        IptcData emptyIptc;
+        XmpData  emptyXmp;
+        TiffParser::encode(mio, 0, 0, Exiv2::littleEndian, preview, emptyIptc, emptyXmp);
+        if (mio.size() < 10) return false;
+        const byte* pData = mio.mmap();
+        const uint32_t headSize = static_cast<uint32_t>(mio.size()) - 2;
+        head.assign(pData, pData + headSize);
+
+        // Replace the placeholder values of the offset and size tags with the real ones
+        const uint16_t offsetTag = offsetTag_ == "StripOffsets" ? 0x0111 : 0x0144;
+        const uint16_t sizeTag = offsetTag_ == "StripOffsets" ? 0x0117 : 0x0145;
+        const uint32_t ifdOffset = getULong(&head[4], littleEndian);
+        if (ifdOffset > headSize - 2) return false;
+        const uint16_t count = getUShort(&head[ifdOffset], littleEndian);
+        if (ifdOffset + 2 + 12 * count > headSize) return false;
+        int patched = 0;
+        for (uint16_t i = 0; i < count; ++i) {
+            byte* entry = &head[ifdOffset + 2 + 12 * i];
+            uint16_t tag = getUShort(entry, littleEndian);
+            if (tag != offsetTag && tag != sizeTag) continue;
+            uint16_t type = getUShort(entry + 2, littleEndian);
+            if (type != unsignedShort && type != unsignedLong) return false;
+            if (getULong(entry + 4, littleEndian) != stripSizes.size()) return false;
+            uint32_t typeSize = type == unsignedShort ? 2 : 4;
+            uint32_t valueSize = typeSize * static_cast<uint32_t>(stripSizes.size());
+            uint32_t valueOffset = valueSize <= 4 ? ifdOffset + 2 + 12 * i + 8 : getULong(entry + 8, littleEndian);
+            if (valueOffset > headSize || valueSize > headSize - valueOffset) return false;
+            byte* value = &head[valueOffset];
+            // The encoder places the strips one after the other, each aligned to a word boundary
+            uint32_t stripOffset = type == unsignedShort ? getUShort(value, littleEndian) : getULong(value, littleEndian);
+            for (size_t j = 0; j < stripSizes.size(); ++j) {
+                uint32_t v = tag == sizeTag ? stripSizes[j] : stripOffset;
+                if (type == unsignedShort) us2Data(value + typeSize * j, static_cast<uint16_t>(v), littleEndian);
+                else ul2Data(value + typeSize * j, v, littleEndian);
+                stripOffset += stripSizes[j] + (stripSizes[j] & 1);
+            }
+            ++patched;
+        }
+        if (patched != 2) return false;
+
+        ranges = strips;
+        if (dataSize & 1) ranges.push_back(std::make_pair(-1L, 1U));
+        return true;
+    }
+
     LoaderXmpJpeg::LoaderXmpJpeg(PreviewId id, const Image &image, int parIdx)
-        : Loader(id, image)
+        : Loader(id, image), decoded_(false)
     {
         (void)parIdx;
 
@@ -859,8 +1087,7 @@ namespace {
 
         width_ = widthDatum->toLong();
         height_ = heightDatum->toLong();
-        preview_ = decodeBase64(imageDatum->toString());
-        size_ = static_cast<uint32_t>(preview_.size_);
+        imageDatum_ = imageDatum;
         valid_ = true;
     }
 
@@ -869,9 +1096,20 @@ namespace {
         return Loader::UniquePtr(new LoaderXmpJpeg(id, image, parIdx));
     }
 
+    const DataBuf& LoaderXmpJpeg::preview() const
+    {
+        if (!decoded_) {
+            const std::string text = imageDatum_->toString();
+            preview_ = base64decode(text.data(), text.size());
+            decoded_ = true;
+        }
+        return preview_;
+    }
+
     PreviewProperties LoaderXmpJpeg::getProperties() const
     {
         PreviewProperties prop = Loader::getProperties();
+        prop.size_ = static_cast<uint32_t>(preview().size_);
         prop.mimeType_ = "image/jpeg";
         prop.extension_ = ".jpg";
 #ifdef EXV_UNICODE_PATH
@@ -883,7 +1121,8 @@ namespace {
     DataBuf LoaderXmpJpeg::getData() const
     {
         if (!valid()) return DataBuf();
-        return DataBuf(preview_.pData_, preview_.size_);
+        const DataBuf& buf = preview();
+        return DataBuf(buf.pData_, buf.size_);
     }
 
     bool LoaderXmpJpeg::readDimensions()
@@ -925,48 +1164,6 @@ namespace {
         return dest;
     }
 
-    static const char encodeBase64Table[64 + 1] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-    DataBuf decodeBase64(const std::string& src)
-    {
-        const size_t srcSize = src.size();
-
-        // create decoding table
-        unsigned long invalid = 64;
-        unsigned long decodeBase64Table[256] = {};
-        for (unsigned long i = 0; i < 256; i++)
-            decodeBase64Table[i] = invalid;
-        for (unsigned long i = 0; i < 64; i++)
-            decodeBase64Table[(unsigned char)encodeBase64Table[i]] = i;
-
-        // calculate dest size
-        unsigned long validSrcSize = 0;
-        for (unsigned long srcPos = 0; srcPos < srcSize; srcPos++) {
-            if (decodeBase64Table[(unsigned char)src[srcPos]] != invalid) validSrcSize++;
-        }
-        if (validSrcSize > ULONG_MAX / 3) return DataBuf(); // avoid integer overflow
-        const unsigned long destSize = (validSrcSize * 3) / 4;
-
-        // allocate dest buffer
-        if (destSize > LONG_MAX) return DataBuf(); // avoid integer overflow
-        DataBuf dest(static_cast<long>(destSize));
-
-        // decode
-        for (unsigned long srcPos = 0, destPos = 0; destPos < destSize;) {
-            unsigned long buffer = 0;
-            for (int bufferPos = 3; bufferPos >= 0 && srcPos < srcSize; srcPos++) {
-                unsigned long srcValue = decodeBase64Table[(unsigned char)src[srcPos]];
-                if (srcValue == invalid) continue;
-                buffer |= srcValue << (bufferPos * 6);
-                bufferPos--;
-            }
-            for (int bufferPos = 2; bufferPos >= 0 && destPos < destSize; bufferPos--, destPos++) {
-                dest.pData_[destPos] = static_cast<byte>((buffer >> (bufferPos * 8)) & 0xFF);
-            }
-        }
-        return dest;
-    }
-
     DataBuf decodeAi7Thumbnail(const DataBuf &src)
     {
         const byte *colorTable = src.pData_;
@@ -1029,6 +1226,119 @@ namespace {
         return dest;
     }
 
+    bool readJpegDimensions(const byte* pData, uint32_t size, uint32_t& width, uint32_t& height)
+    {
+        if (size < 2 || pData[0] != 0xff || pData[1] != 0xd8) return false;
+
+        uint32_t pos = 2;
+        while (pos < size) {
+            // Skip padding between markers and fill bytes
+            while (pos < size && pData[pos] != 0xff) ++pos;
+            while (pos < size && pData[pos] == 0xff) ++pos;
+            if (pos + 3 > size) break;
+            const byte marker = pData[pos++];
+            // No frame header before the scan data
+            if (marker == 0xda || marker == 0xd9) break;
+            // Markers without a segment
+            if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) continue;
+
+            const uint32_t length = getUShort(pData + pos, bigEndian);
+            if (length < 2 || length > size - pos) break;
+            // SOFn, n != 4 (DHT)
+            if (   ((marker >= 0xc0 && marker <= 0xc3) || (marker >= 0xc5 && marker <= 0xcf))
+                && length >= 8) {
+                height = getUShort(pData + pos + 3, bigEndian);
+                width = getUShort(pData + pos + 5, bigEndian);
+                if (height != 0) break;
+            }
+            pos += length;
+        }
+        return true;
+    }
+
+    bool readJpegDimensions(BasicIo& io, long offset, uint32_t size, uint32_t& width, uint32_t& height)
+    {
+        byte buf[9];
+        if (size < 2 || io.readAt(offset, buf, 2) != 2 || buf[0] != 0xff || buf[1] != 0xd8) return false;
+
+        uint32_t pos = 2;
+        while (pos < size) {
+            // Marker, segment length and, for a frame header, precision and dimensions
+            const uint32_t count = std::min(static_cast<uint32_t>(sizeof(buf)), size - pos);
+            if (io.readAt(offset + pos, buf, count) != static_cast<long>(count)) break;
+            // Skip padding between markers and fill bytes
+            if (buf[0] != 0xff || (count > 1 && buf[1] == 0xff)) {
+                ++pos;
+                continue;
+            }
+            if (pos + 4 > size) break;
+            const byte marker = buf[1];
+            pos += 2;
+            // No frame header before the scan data
+            if (marker == 0xda || marker == 0xd9) break;
+            // Markers without a segment
+            if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) continue;
+
+            const uint32_t length = getUShort(buf + 2, bigEndian);
+            if (length < 2 || length > size - pos) break;
+            // SOFn, n != 4 (DHT)
+            if (   ((marker >= 0xc0 && marker <= 0xc3) || (marker >= 0xc5 && marker <= 0xcf))
+                && length >= 8) {
+                height = getUShort(buf + 5, bigEndian);
+                width = getUShort(buf + 7, bigEndian);
+                if (height != 0) break;
+            }
+            pos += length;
+        }
+        return true;
+    }
+
+    DataBuf readRange(BasicIo& io, long offset, long size)
+    {
+        DataBuf buf(size);
+        if (io.readAt(offset, buf.pData_, size) != size) {
+            throw Error(kerFailedToReadImageData);
+        }
+        return buf;
+    }
+
+    /*!
+      @brief Return the path of the file of \em io, from which a preview image
+             can read with an IO of its own, or an empty string if the source
+             cannot be opened again.
+     */
+    std::string sourcePath(BasicIo& io)
+    {
+        // An XPathIo removes its temporary file when it is destroyed
+        if (dynamic_cast<XPathIo*>(&io) != 0) return std::string();
+        FileIo* file = dynamic_cast<FileIo*>(&io);
+        return file != 0 ? file->path() : std::string();
+    }
+
+    //! Open an IO unless it is open, and restore its open state and position when destroyed
+    class SourceGuard {
+    public:
+        explicit SourceGuard(BasicIo& io)
+            : io_(io), wasOpen_(io.isopen()), pos_(wasOpen_ ? io.tell() : 0)
+        {
+            if (!wasOpen_ && io_.open() != 0) {
+                throw Error(kerDataSourceOpenFailed, io_.path(), strError());
+            }
+        }
+        ~SourceGuard()
+        {
+            if (wasOpen_) io_.seek(pos_, BasicIo::beg);
+            else io_.close();
+        }
+        SourceGuard(const SourceGuard& rhs) = delete;
+        SourceGuard& operator=(const SourceGuard& rhs) = delete;
+
+    private:
+        BasicIo& io_;
+        const bool wasOpen_;
+        const long pos_;
+    };
+
 }                                       // namespace
 
 // *****************************************************************************
@@ -1036,66 +1346,164 @@ namespace {
 namespace Exiv2 {
 
     PreviewImage::PreviewImage(const PreviewProperties& properties, DataBuf data)
-        : properties_(properties)
+        : properties_(properties), size_(static_cast<uint32_t>(data.size_))
     {
-        pData_ = data.pData_;
-        size_ = data.size_;
-        std::pair<byte*, long> ret = data.release();
-        UNUSED(ret);
+        data_ = SharedBuf(std::move(data));
+    }
+
+    PreviewImage::PreviewImage(const PreviewProperties& properties, BasicIo& io, const Blob& head, const Ranges& ranges)
+        : properties_(properties), size_(static_cast<uint32_t>(head.size())), path_(sourcePath(io)),
+          head_(head), ranges_(ranges)
+    {
+        for (Ranges::const_iterator i = ranges_.begin(); i != ranges_.end(); ++i) {
+            size_ = Safe::add(size_, i->second);
+        }
+        if (path_.empty()) {
+            // The source cannot be opened again, copy the data while it exists
+            DataBuf buf(static_cast<long>(size_));
+            readData(io, buf.pData_);
+            data_ = SharedBuf(std::move(buf));
+            head_.clear();
+            ranges_.clear();
+        }
     }
 
     PreviewImage::~PreviewImage()
     {
-        delete[] pData_;
     }
 
+    // Copies share the data
     PreviewImage::PreviewImage(const PreviewImage& rhs)
+        : properties_(rhs.properties_), data_(rhs.data_), size_(rhs.size_), path_(rhs.path_),
+          head_(rhs.head_), ranges_(rhs.ranges_)
     {
-        properties_ = rhs.properties_;
-        pData_ = new byte[rhs.size_];
-        memcpy(pData_, rhs.pData_, rhs.size_);
-        size_ = rhs.size_;
     }
 
     PreviewImage& PreviewImage::operator=(const PreviewImage& rhs)
     {
         if (this == &rhs) return *this;
-        if (rhs.size_ > size_) {
-            delete[] pData_;
-            pData_ = new byte[rhs.size_];
-        }
+        data_ = rhs.data_;
         properties_ = rhs.properties_;
-        memcpy(pData_, rhs.pData_, rhs.size_);
         size_ = rhs.size_;
+        path_ = rhs.path_;
+        head_ = rhs.head_;
+        ranges_ = rhs.ranges_;
         return *this;
     }
 
     long PreviewImage::writeFile(const std::string& path) const
     {
         std::string name = path + extension();
-        // Todo: Creating a DataBuf here unnecessarily copies the memory
-        DataBuf buf(pData_, size_);
-        return Exiv2::writeFile(buf, name);
+        FileIo file(name);
+        if (file.open("wb") != 0) {
+            throw Error(kerFileOpenFailed, name, "wb", strError());
+        }
+        return writeTo(file);
     }
 
 #ifdef EXV_UNICODE_PATH
     long PreviewImage::writeFile(const std::wstring& wpath) const
     {
         std::wstring name = wpath + wextension();
-        // Todo: Creating a DataBuf here unnecessarily copies the memory
-        DataBuf buf(pData_, size_);
-        return Exiv2::writeFile(buf, name);
+        FileIo file(name);
+        if (file.open("wb") != 0) {
+            throw WError(kerFileOpenFailed, name, "wb", strError().c_str());
+        }
+        return writeTo(file);
     }
 
 #endif
+    long PreviewImage::writeTo(BasicIo& io) const
+    {
+        if (!data_.empty() || path_.empty()) {
+            return io.write(data_.data(), static_cast<long>(size_));
+        }
+        if (!head_.empty() && io.write(&head_[0], static_cast<long>(head_.size())) != static_cast<long>(head_.size())) {
+            throw Error(kerImageWriteFailed);
+        }
+        FileIo source(path_);
+        SourceGuard guard(source);
+        const byte zeros[512] = { 0 };
+        for (Ranges::const_iterator i = ranges_.begin(); i != ranges_.end(); ++i) {
+            if (i->first >= 0) {
+                if (source.seek(i->first, BasicIo::beg) != 0) throw Error(kerFailedToReadImageData);
+                Internal::copyData(source, io, static_cast<long>(i->second));
+                continue;
+            }
+            for (uint32_t left = i->second; left > 0; ) {
+                long n = static_cast<long>(std::min(left, static_cast<uint32_t>(sizeof(zeros))));
+                if (io.write(zeros, n) != n) throw Error(kerImageWriteFailed);
+                left -= static_cast<uint32_t>(n);
+            }
+        }
+        return static_cast<long>(size_);
+    }
+
+    void PreviewImage::readData(BasicIo& io, byte* buf) const
+    {
+        if (!head_.empty()) memcpy(buf, &head_[0], head_.size());
+        buf += head_.size();
+        SourceGuard guard(io);
+        for (Ranges::const_iterator i = ranges_.begin(); i != ranges_.end(); ++i) {
+            if (i->first < 0) {
+                memset(buf, 0x0, i->second);
+            }
+            else {
+                if (io.seek(i->first, BasicIo::beg) != 0) throw Error(kerFailedToReadImageData);
+                if (io.read(buf, static_cast<long>(i->second)) != static_cast<long>(i->second)) {
+                    throw Error(kerInputDataReadFailed);
+                }
+            }
+            buf += i->second;
+        }
+    }
+
+    void PreviewImage::load(const byte* base, long size)
+    {
+        DataBuf data(static_cast<long>(size_));
+        byte* buf = data.pData_;
+        if (!head_.empty()) memcpy(buf, &head_[0], head_.size());
+        buf += head_.size();
+        for (Ranges::const_iterator i = ranges_.begin(); i != ranges_.end(); ++i) {
+            if (i->first < 0) {
+                memset(buf, 0x0, i->second);
+            }
+            else if (i->first > size || static_cast<long>(i->second) > size - i->first) {
+                throw Error(kerFailedToReadImageData);
+            }
+            else {
+                memcpy(buf, base + i->first, i->second);
+            }
+            buf += i->second;
+        }
+        data_ = SharedBuf(std::move(data));
+        path_.clear();
+        head_.clear();
+        ranges_.clear();
+    }
+
     DataBuf PreviewImage::copy() const
     {
-        return DataBuf(pData_, size_);
+        if (!data_.empty() || path_.empty()) {
+            return data_.copy();
+        }
+        DataBuf buf(static_cast<long>(size_));
+        FileIo source(path_);
+        readData(source, buf.pData_);
+        return buf;
     }
 
     const byte* PreviewImage::pData() const
     {
-        return pData_;
+        return buffer().data();
+    }
+
+    SharedBuf PreviewImage::buffer() const
+    {
+        if (data_.empty() && !path_.empty() && size_ > 0) {
+            data_ = SharedBuf(copy());
+        }
+        return data_;
     }
 
     uint32_t PreviewImage::size() const
@@ -1140,6 +1548,13 @@ namespace Exiv2 {
     {
     }
 
+    PreviewManager::PreviewManager(const PreviewManager& rhs)
+        : image_(rhs.image_)
+    {
+        std::lock_guard<std::mutex> lock(rhs.mutex_);
+        views_ = rhs.views_;
+    }
+
     PreviewPropertiesList PreviewManager::getPreviewProperties() const
     {
         PreviewPropertiesList list;
@@ -1147,10 +1562,7 @@ namespace Exiv2 {
         for (PreviewId id = 0; id < Loader::getNumLoaders(); ++id) {
             Loader::UniquePtr loader = Loader::create(id, image_);
             if (loader.get() && loader->readDimensions()) {
-                PreviewProperties props = loader->getProperties();
-                DataBuf buf             = loader->getData(); // #16 getPreviewImage()
-                props.size_             = buf.size_;         //     update the size
-                list.push_back(props) ;
+                list.push_back(loader->getProperties());
             }
         }
         std::sort(list.begin(), list.end(), cmpPreviewProperties);
@@ -1159,12 +1571,96 @@ namespace Exiv2 {
 
     PreviewImage PreviewManager::getPreviewImage(const PreviewProperties &properties) const
     {
+        PreviewImage preview = getPreviewImageView(properties);
+        if (preview.path_.empty()) return preview;
+
+        return PreviewImage(properties, preview.copy());
+    }
+
+    PreviewImage PreviewManager::getPreviewImageView(const PreviewProperties &properties) const
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::map<PreviewId, PreviewImage>::const_iterator pos = views_.find(properties.id_);
+            if (pos != views_.end()) {
+                PreviewImage view = pos->second;
+                view.properties_ = properties;
+                return view;
+            }
+        }
+        // The view is created without the lock, if two threads create the
+        // same view, the first one is kept
         Loader::UniquePtr loader = Loader::create(properties.id_, image_);
         DataBuf buf;
         if (loader.get()) {
+            Blob head;
+            DataRanges ranges;
+            if (loader->getDataLayout(head, ranges)) {
+                PreviewImage view(properties, image_.io(), head, ranges);
+                std::lock_guard<std::mutex> lock(mutex_);
+                views_.insert(std::make_pair(properties.id_, view));
+                return view;
+            }
             buf = loader->getData();
         }
-
         return PreviewImage(properties, buf);
     }
+
+    std::vector<PreviewImage> PreviewManager::getPreviewImages(const PreviewPropertiesList& list) const
+    {
+        std::vector<PreviewImage> previews;
+        std::string path;
+        for (PreviewPropertiesList::const_iterator i = list.begin(); i != list.end(); ++i) {
+            previews.push_back(getPreviewImageView(*i));
+            if (!previews.back().path_.empty()) path = previews.back().path_;
+        }
+        if (path.empty()) return previews;
+
+        // All views refer to the file of the image, which is mapped once
+        FileIo io(path);
+        if (io.open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io.path(), strError());
+        }
+        IoCloser closer(io);
+        const byte* base = io.mmap();
+        const long size = static_cast<long>(io.size());
+        std::vector<std::future<void> > pending;
+        for (std::vector<PreviewImage>::iterator i = previews.begin(); i != previews.end(); ++i) {
+            if (i->path_.empty()) continue;
+            PreviewImage* preview = &*i;
+            pending.push_back(std::async(std::launch::async, [preview, base, size]() {
+                preview->load(base, size);
+            }));
+        }
+        for (size_t i = 0; i < pending.size(); ++i) {
+            pending[i].get();
+        }
+        return previews;
+    }
+
+    PreviewImage PreviewManager::selectPreview(uint32_t minWidth, uint32_t minHeight) const
+    {
+        // Only the dimensions of the candidates are evaluated here, the data
+        // and the remaining properties are read for the selected preview only
+        Loader::UniquePtr best;
+        bool bestFits = false;
+        for (PreviewId id = 0; id < Loader::getNumLoaders(); ++id) {
+            Loader::UniquePtr loader = Loader::create(id, image_);
+            if (!loader.get() || !loader->readDimensions()) continue;
+            bool fits = loader->width() >= minWidth && loader->height() >= minHeight;
+            uint64_t area = static_cast<uint64_t>(loader->width()) * loader->height();
+            if (best.get()) {
+                uint64_t bestArea = static_cast<uint64_t>(best->width()) * best->height();
+                if (bestFits && (!fits || area >= bestArea)) continue;
+                if (!bestFits && !fits && area <= bestArea) continue;
+            }
+            best = std::move(loader);
+            bestFits = fits;
+            // Stop early if no other preview can fit any better
+            if (fits && best->width() == minWidth && best->height() == minHeight) break;
+        }
+        if (!best.get()) return PreviewImage(PreviewProperties(), DataBuf());
+
+        return getPreviewImage(best->getProperties());
+    }
 }                                       // namespace Exiv2
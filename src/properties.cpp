@@ -34,9 +34,14 @@
 #include "i18n.h"                // NLS support.
 #include "xmp_exiv2.hpp"
 
+#include <atomic>
 #include <iostream>
 #include <iomanip>
+#include <map>
+#include <memory>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 #include <cstring>
 #include <cstdlib>
 #include <cctype>
@@ -2483,6 +2488,122 @@ namespace Exiv2 {
     XmpProperties::NsRegistry XmpProperties::nsRegistry_;
     std::mutex XmpProperties::mutex_;
 
+    namespace {
+        //! A custom namespace, shared by all snapshots which contain it
+        struct NsEntry {
+            NsEntry(const std::string& ns, const std::string& prefix)
+                : ns_(ns), prefix_(prefix)
+            {
+                info_.ns_ = ns_.c_str();
+                info_.prefix_ = prefix_.c_str();
+                info_.xmpPropertyInfo_ = 0;
+                info_.desc_ = "";
+            }
+            std::string ns_;                    //!< Namespace URI
+            std::string prefix_;                //!< Prefix
+            XmpNsInfo info_;                    //!< Namespace info referring to the strings above
+        };
+
+        //! Custom namespaces by URI, guarded by XmpProperties::mutex_
+        typedef std::map<std::string, std::shared_ptr<const NsEntry> > NsEntries;
+
+        /*!
+          @brief Immutable lookup tables of all namespaces. Lookups use the
+                 current snapshot without locking, changes to the registry
+                 publish a new one.
+         */
+        struct NsSnapshot {
+            std::vector<std::shared_ptr<const NsEntry> > entries_; //!< Custom namespaces
+            std::unordered_map<std::string, const XmpNsInfo*> byPrefix_; //!< Namespaces by prefix
+            std::unordered_map<std::string, const XmpNsInfo*> byNs_; //!< Namespaces by URI
+        };
+
+        NsEntries& customNs()
+        {
+            static NsEntries entries;
+            return entries;
+        }
+
+        //! Build a snapshot of the custom namespaces \em entries and the built-in ones
+        std::shared_ptr<const NsSnapshot> makeNsSnapshot(const NsEntries& entries)
+        {
+            std::shared_ptr<NsSnapshot> snapshot = std::make_shared<NsSnapshot>();
+            for (NsEntries::const_iterator i = entries.begin(); i != entries.end(); ++i) {
+                snapshot->entries_.push_back(i->second);
+                snapshot->byPrefix_[i->second->prefix_] = &i->second->info_;
+                snapshot->byNs_[i->second->ns_] = &i->second->info_;
+            }
+            // Custom namespaces take precedence, as does the first of duplicate built-in entries
+            for (unsigned int i = 0; i < EXV_COUNTOF(xmpNsInfo); ++i) {
+                snapshot->byPrefix_.insert(std::make_pair(std::string(xmpNsInfo[i].prefix_), &xmpNsInfo[i]));
+                snapshot->byNs_.insert(std::make_pair(std::string(xmpNsInfo[i].ns_), &xmpNsInfo[i]));
+            }
+            return snapshot;
+        }
+
+        //! The current snapshot, read and replaced with std::atomic_load() and std::atomic_store()
+        std::shared_ptr<const NsSnapshot>& currentNsSnapshot()
+        {
+            static std::shared_ptr<const NsSnapshot> snapshot = makeNsSnapshot(NsEntries());
+            return snapshot;
+        }
+
+        //! Incremented after each new snapshot
+        std::atomic<unsigned long> nsVersion(0);
+
+        //! Return the current snapshot, normally from a per-thread cache without any locking.
+        const NsSnapshot& nsSnapshot()
+        {
+            thread_local std::shared_ptr<const NsSnapshot> cached;
+            thread_local unsigned long cachedVersion = 0;
+            const unsigned long version = nsVersion.load(std::memory_order_acquire);
+            if (!cached || version != cachedVersion) {
+                cached = std::atomic_load(&currentNsSnapshot());
+                cachedVersion = version;
+            }
+            return *cached;
+        }
+
+        //! Publish a snapshot of the current custom namespaces. The caller must hold XmpProperties::mutex_.
+        void publishNsSnapshot()
+        {
+            std::atomic_store(&currentNsSnapshot(), makeNsSnapshot(customNs()));
+            nsVersion.fetch_add(1, std::memory_order_release);
+        }
+
+        //! Properties by name, for each built-in property list
+        typedef std::unordered_map<const XmpPropertyInfo*,
+                                   std::unordered_map<std::string, const XmpPropertyInfo*> > PropertyIndex;
+
+        //! Return the index of the built-in property lists, built on first use
+        const PropertyIndex& propertyIndex()
+        {
+            static const PropertyIndex index = [] {
+                PropertyIndex idx;
+                for (unsigned int i = 0; i < EXV_COUNTOF(xmpNsInfo); ++i) {
+                    const XmpPropertyInfo* pl = xmpNsInfo[i].xmpPropertyInfo_;
+                    if (!pl || idx.count(pl)) continue;
+                    std::unordered_map<std::string, const XmpPropertyInfo*>& names = idx[pl];
+                    // The first of duplicate names wins, as with a linear search
+                    for (int j = 0; pl[j].name_ != 0; ++j) {
+                        names.insert(std::make_pair(std::string(pl[j].name_), pl + j));
+                    }
+                }
+                return idx;
+            }();
+            return index;
+        }
+
+        //! Append a slash to namespace \em ns unless it ends with a slash or hash.
+        std::string normalizedNs(const std::string& ns)
+        {
+            std::string ns2 = ns;
+            if (   ns2.substr(ns2.size() - 1, 1) != "/"
+                && ns2.substr(ns2.size() - 1, 1) != "#") ns2 += "/";
+            return ns2;
+        }
+    }
+
     const XmpNsInfo* XmpProperties::lookupNsRegistry(const XmpNsInfo::Prefix& prefix)
     {
         std::lock_guard<std::mutex> scoped_read_lock(mutex_);
@@ -2502,9 +2623,7 @@ namespace Exiv2 {
                                    const std::string& prefix)
     {
         std::lock_guard<std::mutex> scoped_write_lock(mutex_);
-        std::string ns2 = ns;
-        if (   ns2.substr(ns2.size() - 1, 1) != "/"
-            && ns2.substr(ns2.size() - 1, 1) != "#") ns2 += "/";
+        std::string ns2 = normalizedNs(ns);
         // Check if there is already a registered namespace with this prefix
         const XmpNsInfo* xnp = lookupNsRegistryUnsafe(XmpNsInfo::Prefix(prefix));
         if (xnp) {
@@ -2529,18 +2648,22 @@ namespace Exiv2 {
         xn.xmpPropertyInfo_ = 0;
         xn.desc_ = "";
         nsRegistry_[ns2] = xn;
+        customNs()[ns2] = std::make_shared<const NsEntry>(ns2, prefix);
+        publishNsSnapshot();
     }
 
     void XmpProperties::unregisterNs(const std::string& ns)
     {
         std::lock_guard<std::mutex> scoped_write_lock(mutex_);
         unregisterNsUnsafe(ns);
+        publishNsSnapshot();
     }
 
     void XmpProperties::unregisterNsUnsafe(const std::string& ns)
     {
         NsRegistry::iterator i = nsRegistry_.find(ns);
         if (i != nsRegistry_.end()) {
+            customNs().erase(ns);
             std::free(const_cast<char*>(i->second.prefix_));
             std::free(const_cast<char*>(i->second.ns_));
             nsRegistry_.erase(i);
@@ -2555,32 +2678,20 @@ namespace Exiv2 {
             NsRegistry::iterator kill = i++;
             unregisterNsUnsafe(kill->first);
         }
+        publishNsSnapshot();
     }
 
     std::string XmpProperties::prefix(const std::string& ns)
     {
-        std::lock_guard<std::mutex> scoped_read_lock(mutex_);
-        std::string ns2 = ns;
-        if (   ns2.substr(ns2.size() - 1, 1) != "/"
-            && ns2.substr(ns2.size() - 1, 1) != "#") ns2 += "/";
-        NsRegistry::const_iterator i = nsRegistry_.find(ns2);
-        std::string p;
-        if (i != nsRegistry_.end()) {
-            p = i->second.prefix_;
-        }
-        else {
-            const XmpNsInfo* xn = find(xmpNsInfo, XmpNsInfo::Ns(ns2));
-            if (xn) p = std::string(xn->prefix_);
-        }
-        return p;
+        const NsSnapshot& snapshot = nsSnapshot();
+        std::unordered_map<std::string, const XmpNsInfo*>::const_iterator i = snapshot.byNs_.find(normalizedNs(ns));
+        if (i == snapshot.byNs_.end()) return std::string();
+        return i->second->prefix_;
     }
 
     std::string XmpProperties::ns(const std::string& prefix)
     {
-        std::lock_guard<std::mutex> scoped_read_lock(mutex_);
-        const XmpNsInfo* xn = lookupNsRegistryUnsafe(XmpNsInfo::Prefix(prefix));
-        if (xn != 0) return xn->ns_;
-        return nsInfoUnsafe(prefix)->ns_;
+        return nsInfo(prefix)->ns_;
     }
 
     const char* XmpProperties::propertyTitle(const XmpKey& key)
@@ -2622,14 +2733,11 @@ namespace Exiv2 {
         }
         const XmpPropertyInfo* pl = propertyList(prefix);
         if (!pl) return 0;
-        const XmpPropertyInfo* pi = 0;
-        for (int j = 0; pl[j].name_ != 0; ++j) {
-            if (0 == strcmp(pl[j].name_, property.c_str())) {
-                pi = pl + j;
-                break;
-            }
-        }
-        return pi;
+        const PropertyIndex& index = propertyIndex();
+        PropertyIndex::const_iterator names = index.find(pl);
+        if (names == index.end()) return 0;
+        std::unordered_map<std::string, const XmpPropertyInfo*>::const_iterator pi = names->second.find(property);
+        return pi == names->second.end() ? 0 : pi->second;
     }
 
     const char* XmpProperties::nsDesc(const std::string& prefix)
@@ -2644,17 +2752,10 @@ namespace Exiv2 {
 
     const XmpNsInfo* XmpProperties::nsInfo(const std::string& prefix)
     {
-        std::lock_guard<std::mutex> scoped_read_lock(mutex_);
-        return nsInfoUnsafe(prefix);
-    }
-
-    const XmpNsInfo* XmpProperties::nsInfoUnsafe(const std::string& prefix)
-    {
-        const XmpNsInfo::Prefix pf(prefix);
-        const XmpNsInfo* xn = lookupNsRegistryUnsafe(pf);
-        if (!xn) xn = find(xmpNsInfo, pf);
-        if (!xn) throw Error(kerNoNamespaceInfoForXmpPrefix, prefix);
-        return xn;
+        const NsSnapshot& snapshot = nsSnapshot();
+        std::unordered_map<std::string, const XmpNsInfo*>::const_iterator i = snapshot.byPrefix_.find(prefix);
+        if (i == snapshot.byPrefix_.end()) throw Error(kerNoNamespaceInfoForXmpPrefix, prefix);
+        return i->second;
     }
 
     void XmpProperties::registeredNamespaces(Exiv2::Dictionary& nsDict)
@@ -33,9 +33,12 @@
 #include "basicio.hpp"
 #include "error.hpp"
 #include "futils.hpp"
+#include "image_int.hpp"
+#include "tiffimage_int.hpp"
 
 #include "safe_op.hpp"
 #include "enforce.hpp"
+#include "stats_int.hpp"
 
 // + standard includes
 #include <string>
@@ -119,6 +122,19 @@ enum {
     kPhotoshopResourceID_MorePrintFlags            = 0x2710  // [Photoshop 6.0 and later] Print flags information. 2 bytes version (=1), 1 byte center crop  marks, 1 byte (=0), 4 bytes bleed width value, 2 bytes bleed width  scale.
 };
 
+namespace
+{
+    //! Copy \em count bytes at \em offset in \em src to \em dest and restore the position of \em src
+    void copyRange(Exiv2::BasicIo& src, Exiv2::BasicIo& dest, long offset, uint32_t count)
+    {
+        const long restore = src.tell();
+        if (src.seek(offset, Exiv2::BasicIo::beg) != 0)
+            throw Exiv2::Error(Exiv2::kerNotAnImage, "Photoshop");
+        Exiv2::Internal::copyData(src, dest, static_cast<long>(count));
+        src.seek(restore, Exiv2::BasicIo::beg);
+    }
+}  // namespace
+
 // *****************************************************************************
 // class member definitions
 namespace Exiv2 {
@@ -228,7 +244,7 @@ namespace Exiv2 {
             io_->seek(curOffset + resourceSize, BasicIo::beg);
             resourcesLength -= Safe::add(Safe::add(static_cast<uint32_t>(12), resourceNameLength), resourceSize);
         }
-
+        releasePackets();
     }  // PsdImage::readMetadata
 
     void PsdImage::readResourceBlock(uint16_t resourceId, uint32_t resourceSize)
@@ -333,12 +349,14 @@ namespace Exiv2 {
 
     void PsdImage::writeMetadata()
     {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
         if (io_->open() != 0) {
             throw Error(kerDataSourceOpenFailed, io_->path(), strError());
         }
         IoCloser closer(*io_);
-        BasicIo::UniquePtr tempIo(new MemIo);
-        assert (tempIo.get() != 0);
+        // the new image has about the same size
+        BasicIo::UniquePtr tempIo = Internal::TiffParserWorker::createTempIo(*io_, static_cast<uint32_t>(io_->size()));
 
         doWriteMetadata(*tempIo);  // may throw
         io_->close();
@@ -346,6 +364,17 @@ namespace Exiv2 {
 
     }  // PsdImage::writeMetadata
 
+    void PsdImage::writeMetadataTo(BasicIo& dst)
+    {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
+        if (io_->open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+        IoCloser closer(*io_);
+        doWriteMetadata(dst);  // may throw
+    }  // PsdImage::writeMetadataTo
+
     void PsdImage::doWriteMetadata(BasicIo& outIo)
     {
         if (!io_->isopen())
@@ -367,7 +396,6 @@ namespace Exiv2 {
 
         io_->seek(0, BasicIo::beg);  // rewind
 
-        DataBuf lbuf(4096);
         byte buf[8];
 
         // Get Photoshop header from original file
@@ -393,20 +421,7 @@ namespace Exiv2 {
         std::cerr << std::dec << "colorDataLength: " << colorDataLength << "\n";
 #endif
         // Copy colorData
-        uint32_t readTotal = 0;
-        long toRead = 0;
-        while (readTotal < colorDataLength) {
-            toRead = static_cast<long>(colorDataLength - readTotal) < lbuf.size_
-                         ? static_cast<long>(colorDataLength - readTotal)
-                         : lbuf.size_;
-            if (io_->read(lbuf.pData_, toRead) != toRead)
-                throw Error(kerNotAnImage, "Photoshop");
-            readTotal += toRead;
-            if (outIo.write(lbuf.pData_, toRead) != toRead)
-                throw Error(kerImageWriteFailed);
-        }
-        if (outIo.error())
-            throw Error(kerImageWriteFailed);
+        Internal::copyData(*io_, outIo, static_cast<long>(colorDataLength));
 
         uint32_t resLenOffset = io_->tell();  // remember for later update
 
@@ -433,20 +448,21 @@ namespace Exiv2 {
         bool iptcDone = false;
         bool exifDone = false;
         bool xmpDone = false;
+        // Consecutive resource blocks which are not replaced are copied in one go
+        long copyStart = 0;
+        uint32_t copyLength = 0;
         while (oldResLength > 0) {
+            const long blockStart = io_->tell();
             if (io_->read(buf, 8) != 8)
                 throw Error(kerNotAnImage, "Photoshop");
 
             // read resource type and ID
-            uint32_t resourceType = getULong(buf, bigEndian);
-
             if (!Photoshop::isIrb(buf, 4)) {
                 throw Error(kerNotAnImage, "Photoshop");  // bad resource type
             }
             uint16_t resourceId = getUShort(buf + 4, bigEndian);
             uint32_t resourceNameLength = buf[6];
             uint32_t adjResourceNameLen = resourceNameLength & ~1;
-            unsigned char resourceNameFirstChar = buf[7];
 
             // read rest of resource name, plus any padding
             DataBuf resName(256);
@@ -461,6 +477,17 @@ namespace Exiv2 {
             uint32_t pResourceSize = (resourceSize + 1) & ~1;  // padded resource size
             uint32_t curOffset = io_->tell();
 
+            const bool copyBlock = resourceId != kPhotoshopResourceID_IPTC_NAA &&
+                                   resourceId != kPhotoshopResourceID_ExifInfo &&
+                                   resourceId != kPhotoshopResourceID_XMPPacket;
+            const bool insertBlock = (resourceId >= kPhotoshopResourceID_IPTC_NAA && !iptcDone) ||
+                                     (resourceId >= kPhotoshopResourceID_ExifInfo && !exifDone) ||
+                                     (resourceId >= kPhotoshopResourceID_XMPPacket && !xmpDone);
+            if ((!copyBlock || insertBlock) && copyLength > 0) {
+                copyRange(*io_, outIo, copyStart, copyLength);
+                copyLength = 0;
+            }
+
             // Write IPTC_NAA resource block
             if ((resourceId == kPhotoshopResourceID_IPTC_NAA || resourceId > kPhotoshopResourceID_IPTC_NAA) &&
                 iptcDone == false) {
@@ -483,54 +510,22 @@ namespace Exiv2 {
             }
 
             // Copy all other resource blocks
-            if (resourceId != kPhotoshopResourceID_IPTC_NAA && resourceId != kPhotoshopResourceID_ExifInfo &&
-                resourceId != kPhotoshopResourceID_XMPPacket) {
+            if (copyBlock) {
 #ifdef DEBUG
-                std::cerr << std::hex << "copy : resourceType: " << resourceType << "\n";
                 std::cerr << std::hex << "copy : resourceId: " << resourceId << "\n";
                 std::cerr << std::dec;
 #endif
-                // Copy resource block to new PSD file
-                ul2Data(buf, resourceType, bigEndian);
-                if (outIo.write(buf, 4) != 4)
-                    throw Error(kerImageWriteFailed);
-                us2Data(buf, resourceId, bigEndian);
-                if (outIo.write(buf, 2) != 2)
-                    throw Error(kerImageWriteFailed);
-                // Write resource name as Pascal string
-                buf[0] = resourceNameLength & 0x00ff;
-                if (outIo.write(buf, 1) != 1)
-                    throw Error(kerImageWriteFailed);
-                buf[0] = resourceNameFirstChar;
-                if (outIo.write(buf, 1) != 1)
-                    throw Error(kerImageWriteFailed);
-                if (outIo.write(resName.pData_, adjResourceNameLen) != static_cast<long>(adjResourceNameLen))
-                    throw Error(kerImageWriteFailed);
-                ul2Data(buf, resourceSize, bigEndian);
-                if (outIo.write(buf, 4) != 4)
-                    throw Error(kerImageWriteFailed);
-
-                readTotal = 0;
-                toRead = 0;
-                while (readTotal < pResourceSize) {
-                    toRead = static_cast<long>(pResourceSize - readTotal) < lbuf.size_
-                                 ? static_cast<long>(pResourceSize - readTotal)
-                                 : lbuf.size_;
-                    if (io_->read(lbuf.pData_, toRead) != toRead) {
-                        throw Error(kerNotAnImage, "Photoshop");
-                    }
-                    readTotal += toRead;
-                    if (outIo.write(lbuf.pData_, toRead) != toRead)
-                        throw Error(kerImageWriteFailed);
-                }
-                if (outIo.error())
-                    throw Error(kerImageWriteFailed);
+                if (copyLength == 0) copyStart = blockStart;
+                copyLength += pResourceSize + adjResourceNameLen + 12;
                 newResLength += pResourceSize + adjResourceNameLen + 12;
             }
 
             io_->seek(curOffset + pResourceSize, BasicIo::beg);
             oldResLength -= (12 + adjResourceNameLen + pResourceSize);
         }
+        if (copyLength > 0) {
+            copyRange(*io_, outIo, copyStart, copyLength);
+        }
 
         // Append IPTC_NAA resource block, if not yet written
         if (iptcDone == false) {
@@ -551,12 +546,10 @@ namespace Exiv2 {
         // it avoids allocating memory for parts of the file that contain image-date.
         io_->populateFakeData();
 
-        // Copy remaining data
-        long readSize = 0;
-        while ((readSize = io_->read(lbuf.pData_, lbuf.size_))) {
-            if (outIo.write(lbuf.pData_, readSize) != readSize)
-                throw Error(kerImageWriteFailed);
-        }
+        // Copy remaining data (layers and image data) in bulk
+        const long remaining = static_cast<long>(io_->size()) - io_->tell();
+        if (remaining > 0 && outIo.write(*io_) != remaining)
+            throw Error(kerImageWriteFailed);
         if (outIo.error())
             throw Error(kerImageWriteFailed);
 
@@ -28,8 +28,9 @@
 #include "config.h"
 
 #include "rafimage.hpp"
-#include "tiffimage.hpp"
+#include "jpgimage.hpp"
 #include "image_int.hpp"
+#include "subio_int.hpp"
 #include "image.hpp"
 #include "basicio.hpp"
 #include "error.hpp"
@@ -294,26 +295,26 @@ namespace Exiv2 {
         io_->read(jpg_img_offset, 4);
         byte jpg_img_length [4];
         io_->read(jpg_img_length, 4);
-        long jpg_img_off = Exiv2::getULong((const byte *) jpg_img_offset, bigEndian);
-        long jpg_img_len = Exiv2::getULong((const byte *) jpg_img_length, bigEndian);
-
-        DataBuf buf(jpg_img_len - 12);
-        io_->seek(jpg_img_off + 12,BasicIo::beg);
-        io_->read(buf.pData_, buf.size_ - 12);
-        if (io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
-
-        io_->seek(0,BasicIo::beg); // rewind
+        const uint32_t jpg_img_off = getULong(jpg_img_offset, bigEndian);
+        const uint32_t jpg_img_len = getULong(jpg_img_length, bigEndian);
+        if (   io_->error() || io_->eof()
+            || jpg_img_off > io_->size() || jpg_img_len > io_->size() - jpg_img_off) {
+            throw Error(kerFailedToReadImageData);
+        }
 
-        ByteOrder bo = TiffParser::decode(exifData_,
-                                          iptcData_,
-                                          xmpData_,
-                                          buf.pData_,
-                                          buf.size_);
+        // Read only the metadata segments of the embedded JPEG image, not its image data
+        JpegImage jpeg(BasicIo::UniquePtr(new Internal::SubIo(*io_, jpg_img_off, jpg_img_len)), false);
+        jpeg.readMetadata();
+        exifData_ = jpeg.exifData();
+        iptcData_ = jpeg.iptcData();
+        xmpData_ = jpeg.xmpData();
+        xmpPacket_ = jpeg.xmpPacket();
 
-        exifData_["Exif.Image2.JPEGInterchangeFormat"] = getULong(jpg_img_offset, bigEndian);
-        exifData_["Exif.Image2.JPEGInterchangeFormatLength"] = getULong(jpg_img_length, bigEndian);
+        exifData_["Exif.Image2.JPEGInterchangeFormat"] = jpg_img_off;
+        exifData_["Exif.Image2.JPEGInterchangeFormatLength"] = jpg_img_len;
 
-        setByteOrder(bo);
+        setByteOrder(jpeg.byteOrder());
+        releasePackets();
     } // RafImage::readMetadata
 
     void RafImage::writeMetadata()
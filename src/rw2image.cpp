@@ -125,6 +125,12 @@ namespace Exiv2 {
             throw Error(kerNotAnImage, "RW2");
         }
         clearMetadata();
+        // fetch the directories together, remote files only map the blocks fetched before
+        if (io_->prefetches()) {
+            // the embedded preview image holds more metadata, see below
+            Rw2Header rw2Header;
+            TiffParserWorker::prefetch(*io_, &rw2Header, 0x002e);
+        }
         ByteOrder bo = Rw2Parser::decode(exifData_,
                                          iptcData_,
                                          xmpData_,
@@ -214,7 +220,7 @@ namespace Exiv2 {
         for (ExifData::const_iterator pos = prevData.begin(); pos != prevData.end(); ++pos) {
             exifData_.add(*pos);
         }
-
+        releasePackets();
     } // Rw2Image::readMetadata
 
     void Rw2Image::writeMetadata()
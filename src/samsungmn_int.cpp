@@ -97,10 +97,9 @@ namespace Exiv2 {
             os << _("Unknown");
         }
         else {
-            std::ostringstream oss;
-            oss.copyfmt(os);
+            FormatState fmt(os);
             os << std::fixed << std::setprecision(1) << length / 10.0 << " mm";
-            os.copyfmt(oss);
+            fmt.restore();
         }
         os.flags(f);
         return os;
@@ -202,4 +201,11 @@ namespace Exiv2 {
         return tagInfoPw_;
     }
 
+    //! Tag lists of the groups of the Samsung makernote module
+    extern const MnTagListEntry samsungMnTagLists[] = {
+        { samsung2Id,  Samsung2MakerNote::tagList },
+        { samsungPwId, Samsung2MakerNote::tagListPw },
+        { ifdIdNotSet, 0 }
+    };
+
 }}                                      // namespace Internal, Exiv2
@@ -167,4 +167,10 @@ namespace Exiv2 {
         return os;
     }
 
+    //! Tag lists of the groups of the Sigma makernote module
+    extern const MnTagListEntry sigmaMnTagLists[] = {
+        { sigmaId, SigmaMakerNote::tagList },
+        { ifdIdNotSet, 0 }
+    };
+
 }}                                      // namespace Internal, Exiv2
@@ -0,0 +1,103 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+  File:      snapshot.cpp
+ */
+// *****************************************************************************
+// included header files
+#include "config.h"
+
+#include "snapshot.hpp"
+#include "image.hpp"
+#include "error.hpp"
+#include "futils.hpp"
+
+// + standard includes
+#include <cstring>
+
+// *****************************************************************************
+// class member definitions
+namespace Exiv2 {
+
+    ImageSnapshot::ImageSnapshot(Image& image)
+        : exifData_(image.exifData()),
+          iptcData_(image.iptcData()),
+          xmpData_(image.xmpData()),
+          xmpPacket_(image.xmpPacket()),
+          comment_(static_cast<const Image&>(image).comment()),
+          mimeType_(image.mimeType()),
+          pixelWidth_(image.pixelWidth()),
+          pixelHeight_(image.pixelHeight()),
+          data_(0),
+          size_(0)
+    {
+        // Do the work which const accessors would otherwise do on first use
+        exifData_.decodeMakernote();
+        exifData_.findKey(ExifKey("Exif.Image.Make"));
+        iptcData_.findKey(IptcKey("Iptc.Envelope.ModelVersion"));
+        xmpData_.findKey(XmpKey("Xmp.dc.format"));
+
+        iccProfile_ = image.sharedIccProfile();
+
+        PreviewManager previews(image);
+        previewProperties_ = previews.getPreviewProperties();
+
+        BasicIo& io = image.io();
+        if (dynamic_cast<MemIo*>(&io) != 0) {
+            const long size = static_cast<long>(io.size());
+            if (size > 0) {
+                copy_.alloc(size);
+                std::memcpy(copy_.pData_, io.mmap(), size);
+                io.munmap();
+                data_ = copy_.pData_;
+                size_ = size;
+            }
+        }
+        else {
+            io_ = ImageFactory::createIo(io.path());
+            if (io_->open() != 0) {
+                throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+            }
+            size_ = static_cast<long>(io_->size());
+            if (size_ > 0) data_ = io_->mmap();
+        }
+    }
+
+    ImageSnapshot::~ImageSnapshot()
+    {
+        if (io_.get() != 0 && data_ != 0) {
+            try {
+                io_->munmap();
+            }
+            catch (const AnyError&) {
+                // Nothing to do, the IO instance is destroyed anyway
+            }
+        }
+    }
+
+    long ImageSnapshot::readAt(long offset, byte* buf, long rcount) const
+    {
+        if (offset < 0 || offset >= size_ || rcount <= 0) return 0;
+        const long n = rcount < size_ - offset ? rcount : size_ - offset;
+        std::memcpy(buf, data_ + offset, n);
+        return n;
+    }
+
+}                                       // namespace Exiv2
@@ -796,4 +796,20 @@ namespace Exiv2 {
         return tagInfoCs2_;
     }
 
+    //! Tag lists of the groups of the Sony makernote module
+    extern const MnTagListEntry sonyMnTagLists[] = {
+        { sony1Id,          SonyMakerNote::tagList },
+        { sony2Id,          SonyMakerNote::tagList },
+        { sonyMltId,        MinoltaMakerNote::tagList },
+        { sony1CsId,        SonyMakerNote::tagListCs },
+        { sony1Cs2Id,       SonyMakerNote::tagListCs2 },
+        { sony1MltCs7DId,   MinoltaMakerNote::tagListCs7D },
+        { sony1MltCsOldId,  MinoltaMakerNote::tagListCsStd },
+        { sony1MltCsNewId,  MinoltaMakerNote::tagListCsStd },
+        { sony1MltCsA100Id, MinoltaMakerNote::tagListCsA100 },
+        { sony2CsId,        SonyMakerNote::tagListCs },
+        { sony2Cs2Id,       SonyMakerNote::tagListCs2 },
+        { ifdIdNotSet,      0 }
+    };
+
 }}                                      // namespace Internal, Exiv2
@@ -0,0 +1,131 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+// *****************************************************************************
+// included header files
+#include "config.h"
+
+#include "stats_int.hpp"
+#include "error.hpp"
+
+// *****************************************************************************
+// local declarations
+namespace {
+
+    thread_local Exiv2::IoStats* current = nullptr;
+    thread_local Exiv2::IoStats* collected = nullptr;
+    thread_local Exiv2::Internal::ParseBudget* budget = nullptr;
+
+}
+
+// *****************************************************************************
+// class member definitions
+namespace Exiv2 {
+    namespace Internal {
+
+    IoStats* currentStats()
+    {
+        return current;
+    }
+
+    IoStats* setCurrentStats(IoStats* stats)
+    {
+        IoStats* previous = current;
+        current = stats;
+        return previous;
+    }
+
+    IoStats* collectedStats()
+    {
+        return collected;
+    }
+
+    IoStats* setCollectedStats(IoStats* stats)
+    {
+        IoStats* previous = collected;
+        collected = stats;
+        return previous;
+    }
+
+    PhaseTimer::PhaseTimer(double IoStats::* phase, IoStats* stats)
+        : phase_(phase), stats_(stats)
+    {
+        if (stats_) start_ = std::chrono::steady_clock::now();
+    }
+
+    PhaseTimer::~PhaseTimer()
+    {
+        if (stats_) {
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_;
+            stats_->*phase_ += elapsed.count();
+        }
+    }
+
+    ParseBudget::ParseBudget(const ParseLimits& limits)
+        : limits_(limits), allocated_(0),
+          deadline_(std::chrono::steady_clock::now() + std::chrono::milliseconds(limits.timeoutMs_)),
+          previous_(budget)
+    {
+        budget = this;
+    }
+
+    ParseBudget::~ParseBudget()
+    {
+        budget = previous_;
+    }
+
+    void ParseBudget::chargeAllocation(size_t size)
+    {
+        if (!budget || !budget->limits_.maxAllocation_) return;
+        if (size > budget->limits_.maxAllocation_ - budget->allocated_) {
+            throw Error(kerResourceLimitExceeded, "allocated bytes", budget->limits_.maxAllocation_);
+        }
+        budget->allocated_ += size;
+    }
+
+    void ParseBudget::checkIfdEntries(uint64_t count)
+    {
+        if (budget && budget->limits_.maxIfdEntries_ && count > budget->limits_.maxIfdEntries_) {
+            throw Error(kerResourceLimitExceeded, "IFD entries", budget->limits_.maxIfdEntries_);
+        }
+    }
+
+    void ParseBudget::checkDepth(uint64_t depth)
+    {
+        if (budget && budget->limits_.maxDepth_ && depth > budget->limits_.maxDepth_) {
+            throw Error(kerResourceLimitExceeded, "nesting depth", budget->limits_.maxDepth_);
+        }
+    }
+
+    void ParseBudget::checkInflatedSize(uint64_t size)
+    {
+        if (budget && budget->limits_.maxInflatedSize_ && size > budget->limits_.maxInflatedSize_) {
+            throw Error(kerResourceLimitExceeded, "inflated size", budget->limits_.maxInflatedSize_);
+        }
+    }
+
+    void ParseBudget::checkDeadline()
+    {
+        if (   budget && budget->limits_.timeoutMs_
+            && std::chrono::steady_clock::now() > budget->deadline_) {
+            throw Error(kerResourceLimitExceeded, "milliseconds", budget->limits_.timeoutMs_);
+        }
+    }
+
+}}                                      // namespace Internal, Exiv2
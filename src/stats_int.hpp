@@ -0,0 +1,138 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    stats_int.hpp
+  @brief   Attribution of allocations and phase times to IoStats, budgets
+           of the ParseLimits
+ */
+#ifndef STATS_INT_HPP_
+#define STATS_INT_HPP_
+
+// *****************************************************************************
+// included header files
+#include "basicio.hpp"
+
+// + standard includes
+#include <chrono>
+#include <cstddef>
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+    namespace Internal {
+
+// *****************************************************************************
+// free functions
+
+    /*!
+      @brief Return the stats which DataBuf allocations and phase times of
+             the current thread are added to, 0 if there are none. These
+             are the stats of the BasicIo held by the innermost IoCloser.
+     */
+    IoStats* currentStats();
+
+    /*!
+      @brief Make \em stats the current stats of the thread.
+      @return The stats which were current before.
+     */
+    IoStats* setCurrentStats(IoStats* stats);
+
+    /*!
+      @brief Return the stats which the stats of a BasicIo are added to
+             when it is destroyed, 0 if no IoStatsCollector is active in
+             the current thread.
+     */
+    IoStats* collectedStats();
+
+    /*!
+      @brief Make \em stats the collected stats of the thread.
+      @return The stats which were collected to before.
+     */
+    IoStats* setCollectedStats(IoStats* stats);
+
+// *****************************************************************************
+// class definitions
+
+    /*!
+      @brief Adds the time from its construction to its destruction to a
+             phase time of an IoStats object. Does nothing if there are no
+             stats.
+     */
+    class PhaseTimer {
+    public:
+        //! Constructor, takes the phase time to add to, of \em stats
+        explicit PhaseTimer(double IoStats::* phase, IoStats* stats = currentStats());
+        //! Destructor, adds the elapsed time
+        ~PhaseTimer();
+
+    private:
+        // NOT IMPLEMENTED
+        PhaseTimer(const PhaseTimer&);
+        PhaseTimer& operator=(const PhaseTimer&);
+
+        // DATA
+        double IoStats::* phase_;
+        IoStats* stats_;
+        std::chrono::steady_clock::time_point start_;
+    }; // class PhaseTimer
+
+    /*!
+      @brief The work done by the parsers of the current thread against the
+             ParseLimits of a BasicIo. IoCloser installs one for its lifetime
+             if the BasicIo has limits, the one which was installed before is
+             restored on destruction.
+
+      The static functions check the budget of the thread and throw an Error
+      with the code kerResourceLimitExceeded if a limit is exceeded. They do
+      nothing if no budget is installed.
+     */
+    class ParseBudget {
+    public:
+        //! Constructor, installs a budget with \em limits in the thread
+        explicit ParseBudget(const ParseLimits& limits);
+        //! Destructor, restores the budget which was installed before
+        ~ParseBudget();
+
+        //! Add \em size bytes to the allocated bytes
+        static void chargeAllocation(size_t size);
+        //! Check the number of entries of an IFD
+        static void checkIfdEntries(uint64_t count);
+        //! Check the nesting depth of an IFD
+        static void checkDepth(uint64_t depth);
+        //! Check the size of a zlib inflated buffer
+        static void checkInflatedSize(uint64_t size);
+        //! Check the deadline
+        static void checkDeadline();
+
+    private:
+        // NOT IMPLEMENTED
+        ParseBudget(const ParseBudget&);
+        ParseBudget& operator=(const ParseBudget&);
+
+        // DATA
+        ParseLimits limits_;
+        uint64_t allocated_;
+        std::chrono::steady_clock::time_point deadline_;
+        ParseBudget* previous_;
+    }; // class ParseBudget
+
+}}                                      // namespace Internal, Exiv2
+
+#endif                                  // #ifndef STATS_INT_HPP_
@@ -0,0 +1,230 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+// *****************************************************************************
+// included header files
+#include "config.h"
+
+#include "subio_int.hpp"
+#include "error.hpp"
+
+// + standard includes
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+// *****************************************************************************
+// class member definitions
+namespace Exiv2 {
+    namespace Internal {
+
+    SubIo::SubIo(BasicIo& io, size_t start, size_t size)
+        : io_(io), start_(start), size_(size), idx_(0), eof_(false), opened_(false)
+    {
+    }
+
+    SubIo::~SubIo()
+    {
+        // Only allocations and phase times are counted here, the IO is counted by io_
+        io_.stats() += stats_;
+        stats_ = IoStats();
+        if (opened_) io_.close();
+    }
+
+    int SubIo::open()
+    {
+        idx_ = 0;
+        eof_ = false;
+        if (io_.isopen()) return 0;
+        const int rc = io_.open();
+        opened_ = rc == 0;
+        return rc;
+    }
+
+    int SubIo::close()
+    {
+        idx_ = 0;
+        eof_ = false;
+        if (!opened_) return 0;
+        opened_ = false;
+        return io_.close();
+    }
+
+    long SubIo::write(const byte* /*data*/, long /*wcount*/)
+    {
+        return 0;
+    }
+
+    long SubIo::write(BasicIo& /*src*/)
+    {
+        return 0;
+    }
+
+    int SubIo::putb(byte /*data*/)
+    {
+        return EOF;
+    }
+
+    void SubIo::prefetch(const std::vector<std::pair<long, long> >& ranges)
+    {
+        std::vector<std::pair<long, long> > parentRanges;
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            const long offset = ranges[i].first;
+            if (offset < 0 || ranges[i].second <= 0 || static_cast<size_t>(offset) >= size_) continue;
+            const long count = static_cast<long>(std::min(static_cast<size_t>(ranges[i].second), size_ - offset));
+            parentRanges.push_back(std::make_pair(static_cast<long>(start_ + offset), count));
+        }
+        if (!parentRanges.empty()) io_.prefetch(parentRanges);
+    }
+
+    void SubIo::advise(AccessPattern pattern)
+    {
+        io_.advise(pattern);
+    }
+
+    long SubIo::prepareRead(long rcount)
+    {
+        if (rcount < 0) return 0;
+        const size_t avail = idx_ < size_ ? size_ - idx_ : 0;
+        if (static_cast<size_t>(rcount) > avail) {
+            eof_ = true;
+            rcount = static_cast<long>(avail);
+        }
+        if (rcount > 0 && io_.seek(static_cast<long>(start_ + idx_), BasicIo::beg) != 0) return 0;
+        return rcount;
+    }
+
+    DataBuf SubIo::read(long rcount)
+    {
+        DataBuf buf(rcount);
+        buf.size_ = read(buf.pData_, buf.size_);
+        return buf;
+    }
+
+    long SubIo::read(byte* buf, long rcount)
+    {
+        const long n = prepareRead(rcount);
+        if (n == 0) return 0;
+        const long rc = io_.read(buf, n);
+        if (rc < n) eof_ = true;
+        idx_ += rc;
+        return rc;
+    }
+
+    const byte* SubIo::readView(DataBuf& buf, long rcount)
+    {
+        const long n = prepareRead(rcount);
+        if (n != rcount) return 0;
+        const byte* pData = io_.readView(buf, n);
+        if (pData) idx_ += n;
+        return pData;
+    }
+
+    long SubIo::readAt(long offset, byte* buf, long rcount)
+    {
+        if (offset < 0 || rcount < 0 || static_cast<size_t>(offset) >= size_) return 0;
+        rcount = static_cast<long>(std::min(static_cast<size_t>(rcount), size_ - offset));
+        return io_.readAt(static_cast<long>(start_ + offset), buf, rcount);
+    }
+
+    int SubIo::getb()
+    {
+        byte data = 0;
+        return read(&data, 1) == 1 ? data : EOF;
+    }
+
+    void SubIo::transfer(BasicIo& /*src*/)
+    {
+        throw Error(kerFunctionNotSupported, "SubIo::transfer");
+    }
+
+#if defined(_MSC_VER)
+    int SubIo::seek(int64_t offset, Position pos)
+#else
+    int SubIo::seek(long offset, Position pos)
+#endif
+    {
+        int64_t newIdx = 0;
+        switch (pos) {
+        case BasicIo::cur: newIdx = static_cast<int64_t>(idx_) + offset; break;
+        case BasicIo::beg: newIdx = offset; break;
+        case BasicIo::end: newIdx = static_cast<int64_t>(size_) + offset; break;
+        }
+        if (newIdx < 0) return 1;
+        idx_ = static_cast<size_t>(newIdx);
+        eof_ = false;
+        return 0;
+    }
+
+    byte* SubIo::mmap(bool isWriteable)
+    {
+        if (isWriteable) throw Error(kerFunctionNotSupported, "SubIo::mmap");
+        if (start_ > io_.size() || size_ > io_.size() - start_) throw Error(kerCorruptedMetadata);
+        return io_.mmap(false) + start_;
+    }
+
+    int SubIo::munmap()
+    {
+        return io_.munmap();
+    }
+
+    long SubIo::tell() const
+    {
+        return static_cast<long>(idx_);
+    }
+
+    size_t SubIo::size() const
+    {
+        return size_;
+    }
+
+    bool SubIo::isopen() const
+    {
+        return io_.isopen();
+    }
+
+    int SubIo::error() const
+    {
+        return io_.error();
+    }
+
+    bool SubIo::eof() const
+    {
+        return eof_;
+    }
+
+    bool SubIo::prefetches() const
+    {
+        return io_.prefetches();
+    }
+
+    std::string SubIo::path() const
+    {
+        return io_.path();
+    }
+
+#ifdef EXV_UNICODE_PATH
+    std::wstring SubIo::wpath() const
+    {
+        return io_.wpath();
+    }
+
+#endif
+}}                                      // namespace Internal, Exiv2
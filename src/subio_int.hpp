@@ -0,0 +1,136 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    subio_int.hpp
+  @brief   A read-only view of a range of another BasicIo
+ */
+#ifndef SUBIO_INT_HPP_
+#define SUBIO_INT_HPP_
+
+// *****************************************************************************
+// included header files
+#include "basicio.hpp"
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+    namespace Internal {
+
+// *****************************************************************************
+// class definitions
+
+    /*!
+      @brief Read-only view of the bytes from \em start to \em start + \em size
+             of another BasicIo, e.g., to parse an image which is embedded in
+             another one without copying it to memory first. Positions are
+             relative to the start of the range, reads beyond its end behave
+             like reads beyond the end of a file.
+
+      The view does not own the other BasicIo, which must outlive it. Reads
+      are forwarded to it and counted in its stats, allocations and phase
+      times are added to its stats when the view is destroyed. Writing is
+      not supported.
+     */
+    class SubIo : public BasicIo {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor, taking the BasicIo and the range to view
+        SubIo(BasicIo& io, size_t start, size_t size);
+        //! Destructor, adds the stats of the view to those of the BasicIo
+        ~SubIo() override;
+        //@}
+
+        //! @name Manipulators
+        //@{
+        /*!
+          @brief Open the view, and the BasicIo if it is not open yet.
+          @return 0 if successful, the result of opening the BasicIo otherwise.
+         */
+        int open() override;
+        //! Close the view, and the BasicIo if open() opened it
+        int close() override;
+        //! Not supported, returns 0
+        long write(const byte* data, long wcount) override;
+        //! Not supported, returns 0
+        long write(BasicIo& src) override;
+        //! Not supported, returns EOF
+        int putb(byte data) override;
+        //! Forward the ranges which overlap the view to the BasicIo
+        void prefetch(const std::vector<std::pair<long, long> >& ranges) override;
+        void advise(AccessPattern pattern) override;
+        DataBuf read(long rcount) override;
+        long read(byte* buf, long rcount) override;
+        const byte* readView(DataBuf& buf, long rcount) override;
+        long readAt(long offset, byte* buf, long rcount) override;
+        int getb() override;
+        //! Not supported, throws Error(kerFunctionNotSupported)
+        void transfer(BasicIo& src) override;
+#if defined(_MSC_VER)
+        int seek(int64_t offset, Position pos) override;
+#else
+        int seek(long offset, Position pos) override;
+#endif
+        /*!
+          @brief Map the BasicIo and return a pointer to the start of the range.
+          @throw Error if \em isWriteable is true or the range is not within
+                 the BasicIo.
+         */
+        byte* mmap(bool isWriteable =false) override;
+        int munmap() override;
+        //@}
+
+        //! @name Accessors
+        //@{
+        long tell() const override;
+        size_t size() const override;
+        bool isopen() const override;
+        int error() const override;
+        bool eof() const override;
+        bool prefetches() const override;
+        //! Return the path of the BasicIo
+        std::string path() const override;
+#ifdef EXV_UNICODE_PATH
+        //! Return the unicode path of the BasicIo
+        std::wstring wpath() const override;
+#endif
+        //@}
+
+    private:
+        // NOT IMPLEMENTED
+        SubIo(const SubIo&);
+        SubIo& operator=(const SubIo&);
+
+        //! Position the BasicIo at the current position and return the number of bytes which may be read
+        long prepareRead(long rcount);
+
+        // DATA
+        BasicIo& io_;        //!< The BasicIo which contains the range
+        const size_t start_; //!< Start of the range in io_
+        const size_t size_;  //!< Size of the range
+        size_t idx_;         //!< Position in the range
+        bool eof_;           //!< True if a read went beyond the end of the range
+        bool opened_;        //!< True if open() opened io_
+
+    }; // class SubIo
+
+}}                                      // namespace Internal, Exiv2
+
+#endif                                  // #ifndef SUBIO_INT_HPP_
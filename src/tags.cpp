@@ -242,6 +242,8 @@ namespace Exiv2 {
         //@{
         //! Return the name of the tag
         std::string tagName() const;
+        //! Return the key string, built from the IFD id and tag on demand
+        std::string key() const;
         //@}
 
         // DATA
@@ -251,8 +253,6 @@ namespace Exiv2 {
         uint16_t tag_;                  //!< Tag value
         IfdId ifdId_;                   //!< The IFD associated with this tag
         int idx_;                       //!< Unique id of the Exif key in the image
-        std::string groupName_;         //!< The group name
-        std::string key_;               //!< %Key
     };
 
     const char* ExifKey::Impl::familyName_ = "Exif";
@@ -267,10 +267,22 @@ namespace Exiv2 {
         if (tagInfo_ != 0 && tagInfo_->tag_ != 0xffff) {
             return tagInfo_->name_;
         }
-        std::ostringstream os;
-        os << "0x" << std::setw(4) << std::setfill('0') << std::right
-           << std::hex << tag_;
-        return os.str();
+        static const char hexDigits[] = "0123456789abcdef";
+        char hex[] = "0x0000";
+        for (int i = 0; i < 4; ++i) {
+            hex[5 - i] = hexDigits[(tag_ >> (4 * i)) & 0xf];
+        }
+        return hex;
+    }
+
+    std::string ExifKey::Impl::key() const
+    {
+        const char* groupName = Internal::groupName(ifdId_);
+        const std::string tn = tagName();
+        std::string key;
+        key.reserve(strlen(familyName_) + strlen(groupName) + tn.size() + 2);
+        key.append(familyName_).append(1, '.').append(groupName).append(1, '.').append(tn);
+        return key;
     }
 
     void ExifKey::Impl::decomposeKey(const std::string& key)
@@ -304,9 +316,6 @@ namespace Exiv2 {
 
         tag_ = tag;
         ifdId_ = ifdId;
-        groupName_ = groupName;
-        // tagName() translates hex tag name (0xabcd) to a real tag name if there is one
-        key_ = familyName + "." + groupName + "." + tagName();
     }
 
     void ExifKey::Impl::makeKey(uint16_t tag, IfdId ifdId, const TagInfo* tagInfo)
@@ -316,7 +325,6 @@ namespace Exiv2 {
         tagInfo_ = tagInfo;
         tag_ = tag;
         ifdId_ = ifdId;
-        key_ = std::string(familyName_) + "." + groupName_ + "." + tagName();
     }
 
     ExifKey::ExifKey(uint16_t tag, const std::string& groupName)
@@ -331,7 +339,6 @@ namespace Exiv2 {
         if (ti == 0) {
             throw Error(kerInvalidIfdId, ifdId);
         }
-        p_->groupName_ = groupName;
         p_->makeKey(tag, ifdId, ti);
     }
 
@@ -342,7 +349,6 @@ namespace Exiv2 {
         if (!Internal::isExifIfd(ifdId) && !Internal::isMakerIfd(ifdId)) {
             throw Error(kerInvalidIfdId, ifdId);
         }
-        p_->groupName_ = Exiv2::groupName(ifdId);
         p_->makeKey(ti.tag_, ifdId, &ti);
     }
 
@@ -374,7 +380,7 @@ namespace Exiv2 {
 
     std::string ExifKey::key() const
     {
-        return p_->key_;
+        return p_->key();
     }
 
     const char* ExifKey::familyName() const
@@ -384,7 +390,7 @@ namespace Exiv2 {
 
     std::string ExifKey::groupName() const
     {
-        return p_->groupName_;
+        return Internal::groupName(p_->ifdId_);
     }
 
     std::string ExifKey::tagName() const
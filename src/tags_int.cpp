@@ -26,19 +26,9 @@
 #include "error.hpp"
 #include "i18n.h"                // NLS support.
 
-#include "canonmn_int.hpp"
-#include "casiomn_int.hpp"
-#include "fujimn_int.hpp"
-#include "minoltamn_int.hpp"
-#include "nikonmn_int.hpp"
-#include "olympusmn_int.hpp"
-#include "panasonicmn_int.hpp"
-#include "pentaxmn_int.hpp"
-#include "samsungmn_int.hpp"
-#include "sigmamn_int.hpp"
-#include "sonymn_int.hpp"
-
 #include <cmath>
+#include <unordered_map>
+#include <vector>
 
 // *****************************************************************************
 // local declarations
@@ -78,95 +68,133 @@ namespace Exiv2 {
         { subImage8Id,     "SubImage8", "SubImage8",    ifdTagList                     },
         { subImage9Id,     "SubImage9", "SubImage9",    ifdTagList                     },
         { subThumb1Id,     "SubThumb1", "SubThumb1",    ifdTagList                     },
-        { panaRawId,       "PanaRaw",   "PanasonicRaw", PanasonicMakerNote::tagListRaw },
+        { panaRawId,       "PanaRaw",   "PanasonicRaw", mnGroupTagList<panaRawId>      },
         { mnId,            "Makernote", "MakerNote",    mnTagList                      },
-        { canonId,         "Makernote", "Canon",        CanonMakerNote::tagList        },
-        { canonCsId,       "Makernote", "CanonCs",      CanonMakerNote::tagListCs      },
-        { canonSiId,       "Makernote", "CanonSi",      CanonMakerNote::tagListSi      },
-        { canonCfId,       "Makernote", "CanonCf",      CanonMakerNote::tagListCf      },
-        { canonPiId,       "Makernote", "CanonPi",      CanonMakerNote::tagListPi      },
-        { canonTiId,       "Makernote", "CanonTi",      CanonMakerNote::tagListTi      },
-        { canonFiId,       "Makernote", "CanonFi",      CanonMakerNote::tagListFi      },
-        { canonPaId,       "Makernote", "CanonPa",      CanonMakerNote::tagListPa      },
-        { canonPrId,       "Makernote", "CanonPr",      CanonMakerNote::tagListPr      },
-        { casioId,         "Makernote", "Casio",        CasioMakerNote::tagList        },
-        { casio2Id,        "Makernote", "Casio2",       Casio2MakerNote::tagList       },
-        { fujiId,          "Makernote", "Fujifilm",     FujiMakerNote::tagList         },
-        { minoltaId,       "Makernote", "Minolta",      MinoltaMakerNote::tagList      },
-        { minoltaCs5DId,   "Makernote", "MinoltaCs5D",  MinoltaMakerNote::tagListCs5D  },
-        { minoltaCs7DId,   "Makernote", "MinoltaCs7D",  MinoltaMakerNote::tagListCs7D  },
-        { minoltaCsOldId,  "Makernote", "MinoltaCsOld", MinoltaMakerNote::tagListCsStd },
-        { minoltaCsNewId,  "Makernote", "MinoltaCsNew", MinoltaMakerNote::tagListCsStd },
-        { nikon1Id,        "Makernote", "Nikon1",       Nikon1MakerNote::tagList       },
-        { nikon2Id,        "Makernote", "Nikon2",       Nikon2MakerNote::tagList       },
-        { nikon3Id,        "Makernote", "Nikon3",       Nikon3MakerNote::tagList       },
+        { canonId,         "Makernote", "Canon",        mnGroupTagList<canonId>        },
+        { canonCsId,       "Makernote", "CanonCs",      mnGroupTagList<canonCsId>      },
+        { canonSiId,       "Makernote", "CanonSi",      mnGroupTagList<canonSiId>      },
+        { canonCfId,       "Makernote", "CanonCf",      mnGroupTagList<canonCfId>      },
+        { canonPiId,       "Makernote", "CanonPi",      mnGroupTagList<canonPiId>      },
+        { canonTiId,       "Makernote", "CanonTi",      mnGroupTagList<canonTiId>      },
+        { canonFiId,       "Makernote", "CanonFi",      mnGroupTagList<canonFiId>      },
+        { canonPaId,       "Makernote", "CanonPa",      mnGroupTagList<canonPaId>      },
+        { canonPrId,       "Makernote", "CanonPr",      mnGroupTagList<canonPrId>      },
+        { casioId,         "Makernote", "Casio",        mnGroupTagList<casioId>        },
+        { casio2Id,        "Makernote", "Casio2",       mnGroupTagList<casio2Id>       },
+        { fujiId,          "Makernote", "Fujifilm",     mnGroupTagList<fujiId>         },
+        { minoltaId,       "Makernote", "Minolta",      mnGroupTagList<minoltaId>      },
+        { minoltaCs5DId,   "Makernote", "MinoltaCs5D",  mnGroupTagList<minoltaCs5DId>  },
+        { minoltaCs7DId,   "Makernote", "MinoltaCs7D",  mnGroupTagList<minoltaCs7DId>  },
+        { minoltaCsOldId,  "Makernote", "MinoltaCsOld", mnGroupTagList<minoltaCsOldId> },
+        { minoltaCsNewId,  "Makernote", "MinoltaCsNew", mnGroupTagList<minoltaCsNewId> },
+        { nikon1Id,        "Makernote", "Nikon1",       mnGroupTagList<nikon1Id>       },
+        { nikon2Id,        "Makernote", "Nikon2",       mnGroupTagList<nikon2Id>       },
+        { nikon3Id,        "Makernote", "Nikon3",       mnGroupTagList<nikon3Id>       },
         { nikonPvId,       "Makernote", "NikonPreview", ifdTagList                     },
-        { nikonVrId,       "Makernote", "NikonVr",      Nikon3MakerNote::tagListVr     },
-        { nikonPcId,       "Makernote", "NikonPc",      Nikon3MakerNote::tagListPc     },
-        { nikonWtId,       "Makernote", "NikonWt",      Nikon3MakerNote::tagListWt     },
-        { nikonIiId,       "Makernote", "NikonIi",      Nikon3MakerNote::tagListIi     },
-        { nikonAfId,       "Makernote", "NikonAf",      Nikon3MakerNote::tagListAf     },
-        { nikonAf2Id,      "Makernote", "NikonAf2",     Nikon3MakerNote::tagListAf2    },
-        { nikonAFTId,      "Makernote", "NikonAFT",     Nikon3MakerNote::tagListAFT    },
-        { nikonFiId,       "Makernote", "NikonFi",      Nikon3MakerNote::tagListFi     },
-        { nikonMeId,       "Makernote", "NikonMe",      Nikon3MakerNote::tagListMe     },
-        { nikonFl1Id,      "Makernote", "NikonFl1",     Nikon3MakerNote::tagListFl1    },
-        { nikonFl2Id,      "Makernote", "NikonFl2",     Nikon3MakerNote::tagListFl2    },
-        { nikonFl3Id,      "Makernote", "NikonFl3",     Nikon3MakerNote::tagListFl3    },
-        { nikonSi1Id,      "Makernote", "NikonSiD80",   Nikon3MakerNote::tagListSi1    },
-        { nikonSi2Id,      "Makernote", "NikonSiD40",   Nikon3MakerNote::tagListSi2    },
-        { nikonSi3Id,      "Makernote", "NikonSiD300a", Nikon3MakerNote::tagListSi3    },
-        { nikonSi4Id,      "Makernote", "NikonSiD300b", Nikon3MakerNote::tagListSi4    },
-        { nikonSi5Id,      "Makernote", "NikonSi02xx",  Nikon3MakerNote::tagListSi5    },
-        { nikonSi6Id,      "Makernote", "NikonSi01xx",  Nikon3MakerNote::tagListSi5    },
-        { nikonCb1Id,      "Makernote", "NikonCb1",     Nikon3MakerNote::tagListCb1    },
-        { nikonCb2Id,      "Makernote", "NikonCb2",     Nikon3MakerNote::tagListCb2    },
-        { nikonCb2aId,     "Makernote", "NikonCb2a",    Nikon3MakerNote::tagListCb2a   },
-        { nikonCb2bId,     "Makernote", "NikonCb2b",    Nikon3MakerNote::tagListCb2b   },
-        { nikonCb3Id,      "Makernote", "NikonCb3",     Nikon3MakerNote::tagListCb3    },
-        { nikonCb4Id,      "Makernote", "NikonCb4",     Nikon3MakerNote::tagListCb4    },
-        { nikonLd1Id,      "Makernote", "NikonLd1",     Nikon3MakerNote::tagListLd1    },
-        { nikonLd2Id,      "Makernote", "NikonLd2",     Nikon3MakerNote::tagListLd2    },
-        { nikonLd3Id,      "Makernote", "NikonLd3",     Nikon3MakerNote::tagListLd3    },
-        { olympusId,       "Makernote", "Olympus",      OlympusMakerNote::tagList      },
-        { olympus2Id,      "Makernote", "Olympus2",     OlympusMakerNote::tagList      },
-        { olympusCsId,     "Makernote", "OlympusCs",    OlympusMakerNote::tagListCs    },
-        { olympusEqId,     "Makernote", "OlympusEq",    OlympusMakerNote::tagListEq    },
-        { olympusRdId,     "Makernote", "OlympusRd",    OlympusMakerNote::tagListRd    },
-        { olympusRd2Id,    "Makernote", "OlympusRd2",   OlympusMakerNote::tagListRd2   },
-        { olympusIpId,     "Makernote", "OlympusIp",    OlympusMakerNote::tagListIp    },
-        { olympusFiId,     "Makernote", "OlympusFi",    OlympusMakerNote::tagListFi    },
-        { olympusFe1Id,    "Makernote", "OlympusFe1",   OlympusMakerNote::tagListFe    },
-        { olympusFe2Id,    "Makernote", "OlympusFe2",   OlympusMakerNote::tagListFe    },
-        { olympusFe3Id,    "Makernote", "OlympusFe3",   OlympusMakerNote::tagListFe    },
-        { olympusFe4Id,    "Makernote", "OlympusFe4",   OlympusMakerNote::tagListFe    },
-        { olympusFe5Id,    "Makernote", "OlympusFe5",   OlympusMakerNote::tagListFe    },
-        { olympusFe6Id,    "Makernote", "OlympusFe6",   OlympusMakerNote::tagListFe    },
-        { olympusFe7Id,    "Makernote", "OlympusFe7",   OlympusMakerNote::tagListFe    },
-        { olympusFe8Id,    "Makernote", "OlympusFe8",   OlympusMakerNote::tagListFe    },
-        { olympusFe9Id,    "Makernote", "OlympusFe9",   OlympusMakerNote::tagListFe    },
-        { olympusRiId,     "Makernote", "OlympusRi",    OlympusMakerNote::tagListRi    },
-        { panasonicId,     "Makernote", "Panasonic",    PanasonicMakerNote::tagList    },
-        { pentaxDngId,     "Makernote", "PentaxDng",    PentaxMakerNote::tagList       },
-        { pentaxId,        "Makernote", "Pentax",       PentaxMakerNote::tagList       },
-        { samsung2Id,      "Makernote", "Samsung2",     Samsung2MakerNote::tagList     },
+        { nikonVrId,       "Makernote", "NikonVr",      mnGroupTagList<nikonVrId>      },
+        { nikonPcId,       "Makernote", "NikonPc",      mnGroupTagList<nikonPcId>      },
+        { nikonWtId,       "Makernote", "NikonWt",      mnGroupTagList<nikonWtId>      },
+        { nikonIiId,       "Makernote", "NikonIi",      mnGroupTagList<nikonIiId>      },
+        { nikonAfId,       "Makernote", "NikonAf",      mnGroupTagList<nikonAfId>      },
+        { nikonAf2Id,      "Makernote", "NikonAf2",     mnGroupTagList<nikonAf2Id>     },
+        { nikonAFTId,      "Makernote", "NikonAFT",     mnGroupTagList<nikonAFTId>     },
+        { nikonFiId,       "Makernote", "NikonFi",      mnGroupTagList<nikonFiId>      },
+        { nikonMeId,       "Makernote", "NikonMe",      mnGroupTagList<nikonMeId>      },
+        { nikonFl1Id,      "Makernote", "NikonFl1",     mnGroupTagList<nikonFl1Id>     },
+        { nikonFl2Id,      "Makernote", "NikonFl2",     mnGroupTagList<nikonFl2Id>     },
+        { nikonFl3Id,      "Makernote", "NikonFl3",     mnGroupTagList<nikonFl3Id>     },
+        { nikonSi1Id,      "Makernote", "NikonSiD80",   mnGroupTagList<nikonSi1Id>     },
+        { nikonSi2Id,      "Makernote", "NikonSiD40",   mnGroupTagList<nikonSi2Id>     },
+        { nikonSi3Id,      "Makernote", "NikonSiD300a", mnGroupTagList<nikonSi3Id>     },
+        { nikonSi4Id,      "Makernote", "NikonSiD300b", mnGroupTagList<nikonSi4Id>     },
+        { nikonSi5Id,      "Makernote", "NikonSi02xx",  mnGroupTagList<nikonSi5Id>     },
+        { nikonSi6Id,      "Makernote", "NikonSi01xx",  mnGroupTagList<nikonSi6Id>     },
+        { nikonCb1Id,      "Makernote", "NikonCb1",     mnGroupTagList<nikonCb1Id>     },
+        { nikonCb2Id,      "Makernote", "NikonCb2",     mnGroupTagList<nikonCb2Id>     },
+        { nikonCb2aId,     "Makernote", "NikonCb2a",    mnGroupTagList<nikonCb2aId>    },
+        { nikonCb2bId,     "Makernote", "NikonCb2b",    mnGroupTagList<nikonCb2bId>    },
+        { nikonCb3Id,      "Makernote", "NikonCb3",     mnGroupTagList<nikonCb3Id>     },
+        { nikonCb4Id,      "Makernote", "NikonCb4",     mnGroupTagList<nikonCb4Id>     },
+        { nikonLd1Id,      "Makernote", "NikonLd1",     mnGroupTagList<nikonLd1Id>     },
+        { nikonLd2Id,      "Makernote", "NikonLd2",     mnGroupTagList<nikonLd2Id>     },
+        { nikonLd3Id,      "Makernote", "NikonLd3",     mnGroupTagList<nikonLd3Id>     },
+        { olympusId,       "Makernote", "Olympus",      mnGroupTagList<olympusId>      },
+        { olympus2Id,      "Makernote", "Olympus2",     mnGroupTagList<olympus2Id>     },
+        { olympusCsId,     "Makernote", "OlympusCs",    mnGroupTagList<olympusCsId>    },
+        { olympusEqId,     "Makernote", "OlympusEq",    mnGroupTagList<olympusEqId>    },
+        { olympusRdId,     "Makernote", "OlympusRd",    mnGroupTagList<olympusRdId>    },
+        { olympusRd2Id,    "Makernote", "OlympusRd2",   mnGroupTagList<olympusRd2Id>   },
+        { olympusIpId,     "Makernote", "OlympusIp",    mnGroupTagList<olympusIpId>    },
+        { olympusFiId,     "Makernote", "OlympusFi",    mnGroupTagList<olympusFiId>    },
+        { olympusFe1Id,    "Makernote", "OlympusFe1",   mnGroupTagList<olympusFe1Id>   },
+        { olympusFe2Id,    "Makernote", "OlympusFe2",   mnGroupTagList<olympusFe2Id>   },
+        { olympusFe3Id,    "Makernote", "OlympusFe3",   mnGroupTagList<olympusFe3Id>   },
+        { olympusFe4Id,    "Makernote", "OlympusFe4",   mnGroupTagList<olympusFe4Id>   },
+        { olympusFe5Id,    "Makernote", "OlympusFe5",   mnGroupTagList<olympusFe5Id>   },
+        { olympusFe6Id,    "Makernote", "OlympusFe6",   mnGroupTagList<olympusFe6Id>   },
+        { olympusFe7Id,    "Makernote", "OlympusFe7",   mnGroupTagList<olympusFe7Id>   },
+        { olympusFe8Id,    "Makernote", "OlympusFe8",   mnGroupTagList<olympusFe8Id>   },
+        { olympusFe9Id,    "Makernote", "OlympusFe9",   mnGroupTagList<olympusFe9Id>   },
+        { olympusRiId,     "Makernote", "OlympusRi",    mnGroupTagList<olympusRiId>    },
+        { panasonicId,     "Makernote", "Panasonic",    mnGroupTagList<panasonicId>    },
+        { pentaxDngId,     "Makernote", "PentaxDng",    mnGroupTagList<pentaxDngId>    },
+        { pentaxId,        "Makernote", "Pentax",       mnGroupTagList<pentaxId>       },
+        { samsung2Id,      "Makernote", "Samsung2",     mnGroupTagList<samsung2Id>     },
         { samsungPvId,     "Makernote", "SamsungPreview", ifdTagList                   },
-        { samsungPwId,     "Makernote", "SamsungPictureWizard", Samsung2MakerNote::tagListPw },
-        { sigmaId,         "Makernote", "Sigma",        SigmaMakerNote::tagList        },
-        { sony1Id,         "Makernote", "Sony1",        SonyMakerNote::tagList         },
-        { sony2Id,         "Makernote", "Sony2",        SonyMakerNote::tagList         },
-        { sonyMltId,       "Makernote", "SonyMinolta",  MinoltaMakerNote::tagList      },
-        { sony1CsId,       "Makernote", "Sony1Cs",      SonyMakerNote::tagListCs       },
-        { sony1Cs2Id,      "Makernote", "Sony1Cs2",     SonyMakerNote::tagListCs2      },
-        { sony1MltCs7DId,  "Makernote", "Sony1MltCs7D", MinoltaMakerNote::tagListCs7D  },
-        { sony1MltCsOldId, "Makernote", "Sony1MltCsOld",MinoltaMakerNote::tagListCsStd },
-        { sony1MltCsNewId, "Makernote", "Sony1MltCsNew",MinoltaMakerNote::tagListCsStd },
-        { sony1MltCsA100Id,"Makernote","Sony1MltCsA100",MinoltaMakerNote::tagListCsA100},
-        { sony2CsId,       "Makernote", "Sony2Cs",      SonyMakerNote::tagListCs       },
-        { sony2Cs2Id,      "Makernote", "Sony2Cs2",     SonyMakerNote::tagListCs2      },
+        { samsungPwId,     "Makernote", "SamsungPictureWizard", mnGroupTagList<samsungPwId>  },
+        { sigmaId,         "Makernote", "Sigma",        mnGroupTagList<sigmaId>        },
+        { sony1Id,         "Makernote", "Sony1",        mnGroupTagList<sony1Id>        },
+        { sony2Id,         "Makernote", "Sony2",        mnGroupTagList<sony2Id>        },
+        { sonyMltId,       "Makernote", "SonyMinolta",  mnGroupTagList<sonyMltId>      },
+        { sony1CsId,       "Makernote", "Sony1Cs",      mnGroupTagList<sony1CsId>      },
+        { sony1Cs2Id,      "Makernote", "Sony1Cs2",     mnGroupTagList<sony1Cs2Id>     },
+        { sony1MltCs7DId,  "Makernote", "Sony1MltCs7D", mnGroupTagList<sony1MltCs7DId> },
+        { sony1MltCsOldId, "Makernote", "Sony1MltCsOld",mnGroupTagList<sony1MltCsOldId> },
+        { sony1MltCsNewId, "Makernote", "Sony1MltCsNew",mnGroupTagList<sony1MltCsNewId> },
+        { sony1MltCsA100Id,"Makernote","Sony1MltCsA100",mnGroupTagList<sony1MltCsA100Id> },
+        { sony2CsId,       "Makernote", "Sony2Cs",      mnGroupTagList<sony2CsId>      },
+        { sony2Cs2Id,      "Makernote", "Sony2Cs2",     mnGroupTagList<sony2Cs2Id>     },
         { lastId,          "(Last IFD info)", "(Last IFD item)", 0 }
     };
 
+    //! Tag lists of the vendor makernote modules which are built, see EXIV2_MAKERNOTES
+    const MnTagListEntry* const mnModules[] = {
+#ifdef EXV_HAVE_CANON_MAKERNOTE
+        canonMnTagLists,
+#endif
+#ifdef EXV_HAVE_CASIO_MAKERNOTE
+        casioMnTagLists,
+#endif
+#ifdef EXV_HAVE_FUJI_MAKERNOTE
+        fujiMnTagLists,
+#endif
+#ifdef EXV_HAVE_MINOLTA_MAKERNOTE
+        minoltaMnTagLists,
+#endif
+#ifdef EXV_HAVE_NIKON_MAKERNOTE
+        nikonMnTagLists,
+#endif
+#ifdef EXV_HAVE_OLYMPUS_MAKERNOTE
+        olympusMnTagLists,
+#endif
+#ifdef EXV_HAVE_PANASONIC_MAKERNOTE
+        panasonicMnTagLists,
+#endif
+#ifdef EXV_HAVE_PENTAX_MAKERNOTE
+        pentaxMnTagLists,
+#endif
+#ifdef EXV_HAVE_SAMSUNG_MAKERNOTE
+        samsungMnTagLists,
+#endif
+#ifdef EXV_HAVE_SIGMA_MAKERNOTE
+        sigmaMnTagLists,
+#endif
+#ifdef EXV_HAVE_SONY_MAKERNOTE
+        sonyMnTagLists,
+#endif
+        0
+    };
+
     //! Units for measuring X and Y resolution, tags 0x0128, 0xa210
     extern const TagDetails exifUnit[] = {
         { 1, N_("none") },
@@ -2055,10 +2083,98 @@ namespace Exiv2 {
 
 
 
+    /*!
+      @brief Lookup tables for the group and tag information in groupInfo[]
+             and the tag lists. They are built once, on first use, and
+             replace linear scans of these tables with hash lookups.
+     */
+    class TagLookup {
+    public:
+        //! Return the lookup tables, building them on the first call
+        static const TagLookup& instance()
+        {
+            static const TagLookup tagLookup;
+            return tagLookup;
+        }
+
+        //! Return the group info for \em ifdId, 0 if there is none
+        const GroupInfo* groupInfo(IfdId ifdId) const
+        {
+            if (ifdId < 0 || ifdId >= static_cast<int>(groupsById_.size())) return 0;
+            return groupsById_[ifdId];
+        }
+        //! Return the group info for \em groupName, 0 if there is none
+        const GroupInfo* groupInfo(const std::string& groupName) const
+        {
+            GroupsByName::const_iterator i = groupsByName_.find(groupName);
+            return i == groupsByName_.end() ? 0 : i->second;
+        }
+        /*!
+          @brief Return the first entry for \em tag in \em tagList, or the end
+                 of list marker if the tag is not in the list.
+         */
+        const TagInfo* tagInfo(const TagInfo* tagList, uint16_t tag) const
+        {
+            TagTables::const_iterator t = tagTables_.find(tagList);
+            if (t == tagTables_.end()) return 0;
+            TagTable::Tags::const_iterator i = t->second.tags_.find(tag);
+            return i == t->second.tags_.end() ? t->second.end_ : i->second;
+        }
+        //! Return the first entry with name \em tagName in \em tagList, 0 if there is none
+        const TagInfo* tagInfo(const TagInfo* tagList, const std::string& tagName) const
+        {
+            TagTables::const_iterator t = tagTables_.find(tagList);
+            if (t == tagTables_.end()) return 0;
+            TagTable::Names::const_iterator i = t->second.names_.find(tagName);
+            return i == t->second.names_.end() ? 0 : i->second;
+        }
+
+    private:
+        //! Lookup tables for one tag list
+        struct TagTable {
+            typedef std::unordered_map<uint16_t, const TagInfo*> Tags;
+            typedef std::unordered_map<std::string, const TagInfo*> Names;
+            Tags tags_;                         //!< Tag infos by tag
+            Names names_;                       //!< Tag infos by tag name
+            const TagInfo* end_;                //!< End of list marker
+        };
+        typedef std::unordered_map<std::string, const GroupInfo*> GroupsByName;
+        typedef std::unordered_map<const TagInfo*, TagTable> TagTables;
+
+        //! Constructor, builds the lookup tables. The first entry always wins.
+        TagLookup()
+        {
+            groupsById_.resize(lastId + 1, 0);
+            for (size_t g = 0; g < EXV_COUNTOF(Internal::groupInfo); ++g) {
+                const GroupInfo* gi = &Internal::groupInfo[g];
+                if (   gi->ifdId_ >= 0 && gi->ifdId_ <= lastId
+                    && groupsById_[gi->ifdId_] == 0) {
+                    groupsById_[gi->ifdId_] = gi;
+                }
+                groupsByName_.insert(std::make_pair(std::string(gi->groupName_), gi));
+                if (gi->tagList_ == 0) continue;
+                const TagInfo* ti = gi->tagList_();
+                if (ti == 0 || tagTables_.find(ti) != tagTables_.end()) continue;
+                TagTable& table = tagTables_[ti];
+                int idx = 0;
+                for (idx = 0; ti[idx].tag_ != 0xffff; ++idx) {
+                    table.tags_.insert(std::make_pair(ti[idx].tag_, &ti[idx]));
+                    table.names_.insert(std::make_pair(std::string(ti[idx].name_), &ti[idx]));
+                }
+                table.end_ = &ti[idx];
+            }
+        }
+
+        // DATA
+        std::vector<const GroupInfo*> groupsById_; //!< Group infos indexed by IfdId
+        GroupsByName groupsByName_;                //!< Group infos by group name
+        TagTables tagTables_;                      //!< Tag lookup tables by tag list
+    };
+
     bool isMakerIfd(IfdId ifdId)
     {
         bool rc = false;
-        const GroupInfo* ii = find(groupInfo, ifdId);
+        const GroupInfo* ii = TagLookup::instance().groupInfo(ifdId);
         if (ii != 0 && 0 == strcmp(ii->ifdName_, "Makernote")) {
             rc = true;
         }
@@ -2103,9 +2219,25 @@ namespace Exiv2 {
         }
     } // taglist
 
+    const TagInfo* mnGroupTagList(IfdId group)
+    {
+        // The tag list function of each group, registered on first use
+        static const std::vector<TagListFct> tagLists = [] {
+            std::vector<TagListFct> lists(lastId + 1, 0);
+            for (const MnTagListEntry* const* module = mnModules; *module != 0; ++module) {
+                for (const MnTagListEntry* entry = *module; entry->group_ != ifdIdNotSet; ++entry) {
+                    lists[entry->group_] = entry->tagList_;
+                }
+            }
+            return lists;
+        }();
+        if (group < 0 || group > lastId || tagLists[group] == 0) return 0;
+        return tagLists[group]();
+    } // mnGroupTagList
+
     const TagInfo* tagList(IfdId ifdId)
     {
-        const GroupInfo* ii = find(groupInfo, ifdId);
+        const GroupInfo* ii = TagLookup::instance().groupInfo(ifdId);
         if (ii == 0 || ii->tagList_ == 0) return 0;
         return ii->tagList_();
     } // tagList
@@ -2114,45 +2246,34 @@ namespace Exiv2 {
     {
         const TagInfo* ti = tagList(ifdId);
         if (ti == 0) return 0;
-        int idx = 0;
-        for (idx = 0; ti[idx].tag_ != 0xffff; ++idx) {
-            if (ti[idx].tag_ == tag) break;
-        }
-        return &ti[idx];
+        return TagLookup::instance().tagInfo(ti, tag);
     } // tagInfo
 
     const TagInfo* tagInfo(const std::string& tagName, IfdId ifdId)
     {
         const TagInfo* ti = tagList(ifdId);
         if (ti == 0) return 0;
-        const char* tn = tagName.c_str();
-        if (tn == 0) return 0;
-        for (int idx = 0; ti[idx].tag_ != 0xffff; ++idx) {
-            if (0 == strcmp(ti[idx].name_, tn)) {
-                return &ti[idx];
-            }
-        }
-        return 0;
+        return TagLookup::instance().tagInfo(ti, tagName);
     } // tagInfo
 
     IfdId groupId(const std::string& groupName)
     {
         IfdId ifdId = ifdIdNotSet;
-        const GroupInfo* ii = find(groupInfo, GroupInfo::GroupName(groupName));
+        const GroupInfo* ii = TagLookup::instance().groupInfo(groupName);
         if (ii != 0) ifdId = static_cast<IfdId>(ii->ifdId_);
         return ifdId;
     }
 
     const char* ifdName(IfdId ifdId)
     {
-        const GroupInfo* ii = find(groupInfo, ifdId);
+        const GroupInfo* ii = TagLookup::instance().groupInfo(ifdId);
         if (ii == 0) return groupInfo[0].ifdName_;
         return ii->ifdName_;
     }
 
     const char* groupName(IfdId ifdId)
     {
-        const GroupInfo* ii = find(groupInfo, ifdId);
+        const GroupInfo* ii = TagLookup::instance().groupInfo(ifdId);
         if (ii == 0) return groupInfo[0].groupName_;
         return ii->groupName_;
     }
@@ -2201,16 +2322,13 @@ namespace Exiv2 {
     std::ostream& printFloat(std::ostream& os, const Value& value, const ExifData*)
     {
         Rational r = value.toRational();
-        if (r.second != 0) return os << static_cast<float>(r.first) / r.second;
+        if (r.second != 0) return os << Number(static_cast<float>(r.first) / r.second);
         return os << "(" << value << ")";
     } // printFloat
 
     std::ostream& printDegrees(std::ostream& os, const Value& value, const ExifData*)
     {
-        std::ios::fmtflags f( os.flags() );
         if (value.count() == 3) {
-            std::ostringstream oss;
-            oss.copyfmt(os);
             static const char* unit[] = { "deg", "'", "\"" };
             static const int prec[] = { 7, 5, 3 };
             int n;
@@ -2223,21 +2341,17 @@ namespace Exiv2 {
                 if (d == 0)
                 {
                     os << "(" << value << ")";
-                    os.flags(f);
                     return os;
                 }
                 // Hack: Need Value::toDouble
                 double b = static_cast<double>(z)/d;
                 const int p = z % d == 0 ? 0 : prec[i];
-                os << std::fixed << std::setprecision(p) << b
-                   << unit[i] << " ";
+                os << Number::fixed(b, p) << unit[i] << " ";
             }
-            os.copyfmt(oss);
         }
         else {
             os << value;
         }
-        os.flags(f);
         return os;
     } // printDegrees
 
@@ -2294,17 +2408,10 @@ namespace Exiv2 {
 
     std::ostream& print0x0006(std::ostream& os, const Value& value, const ExifData*)
     {
-        std::ios::fmtflags f( os.flags() );
-        std::ostringstream oss;
-        oss.copyfmt(os);
         const int32_t d = value.toRational().second;
         if (d == 0) return os << "(" << value << ")";
         const int p = d > 1 ? 1 : 0;
-        os << std::fixed << std::setprecision(p) << value.toFloat() << " m";
-        os.copyfmt(oss);
-
-        os.flags(f);
-        return os;
+        return os << Number::fixed(value.toFloat(), p) << " m";
     }
 
     std::ostream& print0x0007(std::ostream& os, const Value& value, const ExifData*)
@@ -2316,8 +2423,7 @@ namespace Exiv2 {
                     return os << "(" << value << ")";
                 }
             }
-            std::ostringstream oss;
-            oss.copyfmt(os);
+            FormatState fmt(os);
             const float sec = 3600 * value.toFloat(0)
                               + 60 * value.toFloat(1)
                               + value.toFloat(2);
@@ -2331,9 +2437,9 @@ namespace Exiv2 {
             os << std::setw(2) << std::setfill('0') << std::right << hh << ":"
                << std::setw(2) << std::setfill('0') << std::right << mm << ":"
                << std::setw(2 + p * 2) << std::setfill('0') << std::right
-               << std::fixed << std::setprecision(p) << ss;
+               << Number::fixed(ss, p);
 
-            os.copyfmt(oss);
+            fmt.restore();
         }
         else {
             os << value;
@@ -2421,26 +2527,20 @@ namespace Exiv2 {
             os << t << " s";
         }
         else {
-            os << static_cast<float>(t.first) / t.second << " s";
+            os << Number(static_cast<float>(t.first) / t.second) << " s";
         }
         return os;
     }
 
     std::ostream& print0x829d(std::ostream& os, const Value& value, const ExifData*)
     {
-        std::ios::fmtflags f( os.flags() );
         Rational rational = value.toRational();
         if (rational.second != 0) {
-            std::ostringstream oss;
-            oss.copyfmt(os);
-            os << "F" << std::setprecision(2)
-               << static_cast<float>(rational.first) / rational.second;
-            os.copyfmt(oss);
+            os << "F" << Number::general(static_cast<float>(rational.first) / rational.second, 2);
         }
         else {
             os << "(" << value << ")";
         }
-        os.flags(f);
         return os;
     }
 
@@ -2500,17 +2600,11 @@ namespace Exiv2 {
 
     std::ostream& print0x9202(std::ostream& os, const Value& value, const ExifData*)
     {
-        std::ios::fmtflags f( os.flags() );
         if (   value.count() == 0
             || value.toRational().second == 0) {
             return os << "(" << value << ")";
         }
-        std::ostringstream oss;
-        oss.copyfmt(os);
-        os << "F" << std::setprecision(2) << fnumber(value.toFloat());
-        os.copyfmt(oss);
-        os.flags(f);
-        return os;
+        return os << "F" << Number::general(fnumber(value.toFloat()), 2);
     }
 
     std::ostream& print0x9204(std::ostream& os, const Value& value, const ExifData*)
@@ -2536,7 +2630,6 @@ namespace Exiv2 {
 
     std::ostream& print0x9206(std::ostream& os, const Value& value, const ExifData*)
     {
-        std::ios::fmtflags f( os.flags() );
         Rational distance = value.toRational();
         if (distance.first == 0) {
             os << _("Unknown");
@@ -2545,17 +2638,11 @@ namespace Exiv2 {
             os << _("Infinity");
         }
         else if (distance.second != 0) {
-            std::ostringstream oss;
-            oss.copyfmt(os);
-            os << std::fixed << std::setprecision(2)
-               << (float)distance.first / distance.second
-               << " m";
-            os.copyfmt(oss);
+            os << Number::fixed((float)distance.first / distance.second, 2) << " m";
         }
         else {
             os << "(" << value << ")";
         }
-        os.flags(f);
         return os;
     }
 
@@ -2609,20 +2696,13 @@ namespace Exiv2 {
 
     std::ostream& print0x920a(std::ostream& os, const Value& value, const ExifData*)
     {
-        std::ios::fmtflags f( os.flags() );
         Rational length = value.toRational();
         if (length.second != 0) {
-            std::ostringstream oss;
-            oss.copyfmt(os);
-            os << std::fixed << std::setprecision(1)
-               << (float)length.first / length.second
-               << " mm";
-            os.copyfmt(oss);
+            os << Number::fixed((float)length.first / length.second, 1) << " mm";
         }
         else {
             os << "(" << value << ")";
         }
-        os.flags(f);
         return os;
     }
 
@@ -2724,19 +2804,13 @@ namespace Exiv2 {
 
     std::ostream& print0xa404(std::ostream& os, const Value& value, const ExifData*)
     {
-        std::ios::fmtflags f( os.flags() );
         Rational zoom = value.toRational();
         if (zoom.second == 0) {
             os << _("Digital zoom not used");
         }
         else {
-            std::ostringstream oss;
-            oss.copyfmt(os);
-            os << std::fixed << std::setprecision(1)
-               << (float)zoom.first / zoom.second;
-            os.copyfmt(oss);
+            os << Number::fixed((float)zoom.first / zoom.second, 1);
         }
-        os.flags(f);
         return os;
     }
 
@@ -2878,7 +2952,7 @@ namespace Exiv2 {
 
     const TagInfo* tagList(const std::string& groupName)
     {
-        const GroupInfo* ii = find(groupInfo, GroupInfo::GroupName(groupName));
+        const GroupInfo* ii = TagLookup::instance().groupInfo(groupName);
         if (ii == 0 || ii->tagList_ == 0) {
             return 0;
         }
@@ -35,6 +35,7 @@
 #include "value.hpp"
 
 // + standard includes
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <memory>
@@ -218,6 +219,91 @@ namespace Exiv2 {
         bool operator==(const std::string& key) const;
     }; // struct TagDetails
 
+    /*!
+      @brief Tag list of a makernote group. A vendor makernote module provides
+             a table of these for its groups, terminated by an entry with
+             group ifdIdNotSet.
+     */
+    struct MnTagListEntry {
+        IfdId      group_;                      //!< Makernote group
+        TagListFct tagList_;                    //!< Tag list of the group
+    }; // struct MnTagListEntry
+
+    /*!
+      @brief Save the format state of a stream, for print functions which
+             change it temporarily. Unlike copyfmt() to a scratch stream, this
+             does not construct a stream for every value printed.
+     */
+    class FormatState {
+    public:
+        //! Constructor, saves the format state of \em os
+        explicit FormatState(std::ostream& os)
+            : os_(os), flags_(os.flags()), precision_(os.precision()), width_(os.width()), fill_(os.fill()) {}
+        //! Restore the saved format state of the stream
+        void restore()
+        {
+            os_.flags(flags_);
+            os_.precision(precision_);
+            os_.width(width_);
+            os_.fill(fill_);
+        }
+
+    private:
+        // DATA
+        std::ostream& os_;
+        std::ios_base::fmtflags flags_;
+        std::streamsize precision_;
+        std::streamsize width_;
+        char fill_;
+    }; // class FormatState
+
+    //! Compare tag details by value, for the sorted search of findTagDetails
+    inline bool tagDetailsLess(const TagDetails& lhs, const TagDetails& rhs) { return lhs.val_ < rhs.val_; }
+    //! Compare tag details with a value, for the sorted search of findTagDetails
+    inline bool tagDetailsLessVal(const TagDetails& td, long val) { return td.val_ < val; }
+
+    //! Layout of a reference table, determines how findTagDetails() searches it
+    enum TagDetailsShape {
+        tdsUnsorted,                            //!< Values in no particular order, linear search
+        tdsSorted,                              //!< Values in ascending order, binary search
+        tdsDense                                //!< Consecutive values, direct indexing
+    };
+
+    //! Return the layout of the reference table \em array with \em n entries
+    inline TagDetailsShape tagDetailsShape(const TagDetails* array, int n)
+    {
+        if (!std::is_sorted(array, array + n, tagDetailsLess)) return tdsUnsorted;
+        for (int i = 1; i < n; ++i) {
+            if (array[i].val_ != array[0].val_ + i) return tdsSorted;
+        }
+        return tdsDense;
+    }
+
+    /*!
+      @brief Return the first entry of the reference table with value \em val,
+             0 if there is none.
+
+      Tables with consecutive values, like most small enumerations, are
+      indexed directly. Other tables sorted by value, like most of the lens
+      tables, are searched in O(log n). The layout of the table is
+      determined on the first call.
+     */
+    template <int N, const TagDetails (&array)[N]>
+    const TagDetails* findTagDetails(long val)
+    {
+        static const TagDetailsShape shape = tagDetailsShape(array, N);
+        switch (shape) {
+        case tdsDense:
+            return N > 0 && val >= array[0].val_ && val - array[0].val_ < N ? array + (val - array[0].val_) : nullptr;
+        case tdsSorted: {
+            const TagDetails* td = std::lower_bound(array, array + N, val, tagDetailsLessVal);
+            return td != array + N && td->val_ == val ? td : nullptr;
+        }
+        default:
+            return find(array, val);
+        }
+    }
+
     /*!
       @brief Generic pretty-print function to translate a long value to a description
              by looking up a reference table.
@@ -225,7 +311,7 @@ namespace Exiv2 {
     template <int N, const TagDetails (&array)[N]>
     std::ostream& printTag(std::ostream& os, const Value& value, const ExifData*)
     {
-        const TagDetails* td = find(array, value.toLong());
+        const TagDetails* td = findTagDetails<N, array>(value.toLong());
         if (td) {
             os << exvGettext(td->label_);
         }
@@ -250,12 +336,23 @@ namespace Exiv2 {
             const TagDetailsBitmask* td = *(&array);
             if (td->mask_ == 0) return os << exvGettext(td->label_);
         }
+        // If no two masks overlap, the search can stop once all bits of the value are found
+        static const bool disjoint = [] {
+            uint32_t seen = 0;
+            for (int i = 0; i < N; ++i) {
+                if (seen & array[i].mask_) return false;
+                seen |= array[i].mask_;
+            }
+            return true;
+        }();
+        uint32_t remaining = val;
         bool sep = false;
-        for (int i = 0; i < N; ++i) {
+        for (int i = 0; i < N && (remaining != 0 || !disjoint); ++i) {
             // *& acrobatics is a workaround for a MSVC 7.1 bug
             const TagDetailsBitmask* td = *(&array) + i;
 
             if (val & td->mask_) {
+                remaining &= ~td->mask_;
                 if (sep) {
                     os << ", " << exvGettext(td->label_);
                 }
@@ -307,6 +404,32 @@ namespace Exiv2 {
     //! Return read-only list of built-in mfp Tags http://www.sno.phy.queensu.ca/~phil/exiftool/TagNames/MPF.html
     const TagInfo* mpfTagList();
 
+    /*!
+      @brief Return the tag list of the vendor makernote group \em group, 0 if
+             the makernote module of the vendor is not built (see the CMake
+             variable EXIV2_MAKERNOTES). The tag lists of all modules which
+             are built are registered on the first call.
+     */
+    const TagInfo* mnGroupTagList(IfdId group);
+    //! Tag list function of the vendor makernote group \em group, for the list of groups
+    template<IfdId group>
+    const TagInfo* mnGroupTagList() { return mnGroupTagList(group); }
+
+    //! @name Tag lists of the groups of the vendor makernote modules
+    //@{
+    extern const MnTagListEntry canonMnTagLists[];
+    extern const MnTagListEntry casioMnTagLists[];
+    extern const MnTagListEntry fujiMnTagLists[];
+    extern const MnTagListEntry minoltaMnTagLists[];
+    extern const MnTagListEntry nikonMnTagLists[];
+    extern const MnTagListEntry olympusMnTagLists[];
+    extern const MnTagListEntry panasonicMnTagLists[];
+    extern const MnTagListEntry pentaxMnTagLists[];
+    extern const MnTagListEntry samsungMnTagLists[];
+    extern const MnTagListEntry sigmaMnTagLists[];
+    extern const MnTagListEntry sonyMnTagLists[];
+    //@}
+
     const GroupInfo* groupList();
     const TagInfo* tagList(const std::string& groupName);
 
@@ -33,6 +33,7 @@
 #include "value.hpp"
 #include "error.hpp"
 #include "enforce.hpp"
+#include "trace.hpp"
 
 // + standard includes
 #include <string>
@@ -61,7 +62,8 @@ namespace Exiv2 {
     }
 
     IoWrapper::IoWrapper(BasicIo& io, const byte* pHeader, long size, OffsetWriter* pow)
-        : io_(io), pHeader_(pHeader), size_(size), wroteHeader_(false), pow_(pow)
+        : io_(io), pHeader_(pHeader), size_(size), wroteHeader_(false), pow_(pow),
+          pImage_(0), sizeImage_(0)
     {
         if (pHeader_ == 0 || size_ == 0) wroteHeader_ = true;
     }
@@ -89,6 +91,112 @@ namespace Exiv2 {
         if (pow_) pow_->setTarget(OffsetWriter::OffsetId(id), target);
     }
 
+    void IoWrapper::keepImage(const byte* pData, uint32_t size)
+    {
+        pImage_ = pData;
+        sizeImage_ = size;
+    }
+
+    bool IoWrapper::keptImage(const byte* pImage, uint32_t size, uint32_t& offset) const
+    {
+        if (   pImage_ == 0 || pImage < pImage_ || pImage >= pImage_ + sizeImage_
+            || size > sizeImage_ - static_cast<uint32_t>(pImage - pImage_)) return false;
+        offset = static_cast<uint32_t>(pImage - pImage_);
+        return true;
+    }
+
+    namespace {
+        //! Current arena of each thread
+        thread_local TiffArena* currentArena = 0;
+        //! Size of an arena block
+        const std::size_t arenaBlockSize = 64 * 1024;
+        //! Alignment of all memory handed out for components
+        const std::size_t arenaAlignment = alignof(std::max_align_t);
+        //! Each component is preceded by the arena it was allocated from, or 0
+        const std::size_t componentHeaderSize = (sizeof(TiffArena*) + arenaAlignment - 1)
+                                              / arenaAlignment * arenaAlignment;
+    }
+
+    TiffArena::TiffArena()
+        : next_(0), left_(0), previous_(currentArena)
+    {
+        currentArena = this;
+    }
+
+    TiffArena::~TiffArena()
+    {
+        currentArena = previous_;
+        for (std::vector<byte*>::iterator i = blocks_.begin(); i != blocks_.end(); ++i) {
+            ::operator delete(*i);
+        }
+    }
+
+    void* TiffArena::allocate(std::size_t size)
+    {
+        size = (size + arenaAlignment - 1) / arenaAlignment * arenaAlignment;
+        if (size > arenaBlockSize / 4) {
+            // Large requests get a block of their own, keep the current block
+            byte* block = static_cast<byte*>(::operator new(size));
+            blocks_.insert(blocks_.end() - (blocks_.empty() ? 0 : 1), block);
+            return block;
+        }
+        if (size > left_) {
+            blocks_.push_back(static_cast<byte*>(::operator new(arenaBlockSize)));
+            next_ = blocks_.back();
+            left_ = arenaBlockSize;
+        }
+        void* p = next_;
+        next_ += size;
+        left_ -= size;
+        return p;
+    }
+
+    TiffArena* TiffArena::current()
+    {
+        return currentArena;
+    }
+
+    namespace {
+        //! Current layout of each thread
+        thread_local TiffLayout* currentLayout = 0;
+        //! Last layout id handed out in each thread
+        thread_local uint32_t lastLayoutId = 0;
+    }
+
+    TiffLayout::TiffLayout()
+        : id_(++lastLayoutId), previous_(currentLayout)
+    {
+        // Id 0 means that nothing is cached, skip it when the counter wraps around
+        if (id_ == 0) id_ = ++lastLayoutId;
+        currentLayout = this;
+    }
+
+    TiffLayout::~TiffLayout()
+    {
+        currentLayout = previous_;
+    }
+
+    const TiffLayout* TiffLayout::current()
+    {
+        return currentLayout;
+    }
+
+    void* TiffComponent::operator new(std::size_t size)
+    {
+        TiffArena* arena = currentArena;
+        byte* p = static_cast<byte*>(arena ? arena->allocate(componentHeaderSize + size)
+                                           : ::operator new(componentHeaderSize + size));
+        *reinterpret_cast<TiffArena**>(p) = arena;
+        return p + componentHeaderSize;
+    }
+
+    void TiffComponent::operator delete(void* p)
+    {
+        if (p == 0) return;
+        byte* base = static_cast<byte*>(p) - componentHeaderSize;
+        if (*reinterpret_cast<TiffArena**>(base) == 0) ::operator delete(base);
+    }
+
     TiffComponent::TiffComponent(uint16_t tag, IfdId group)
         : tag_(tag), group_(group), pStart_(0)
     {
@@ -389,6 +497,13 @@ namespace Exiv2 {
         setValue(std::move(value));
     } // TiffEntryBase::updateValue
 
+    Value::UniquePtr TiffEntryBase::releaseValue()
+    {
+        Value::UniquePtr value(pValue_);
+        pValue_ = 0;
+        return value;
+    }
+
     void TiffEntryBase::setValue(Value::UniquePtr value)
     {
         if (value.get() == 0) return;
@@ -537,6 +652,12 @@ namespace Exiv2 {
         return pHeader_->baseOffset(mnOffset_);
     }
 
+    bool TiffIfdMakernote::relocatable() const
+    {
+        if (!pHeader_) return false;
+        return pHeader_->baseOffset(1) != pHeader_->baseOffset(0);
+    }
+
     bool TiffIfdMakernote::readHeader(const byte* pData,
                                       uint32_t    size,
                                       ByteOrder   byteOrder)
@@ -934,7 +1055,10 @@ namespace Exiv2 {
     void TiffMnEntry::doAccept(TiffVisitor& visitor)
     {
         visitor.visitMnEntry(this);
-        if (mn_) mn_->accept(visitor);
+        if (mn_) {
+            Trace trace("makernote", groupName(mnGroup_));
+            mn_->accept(visitor);
+        }
         if (!visitor.go(TiffVisitor::geKnownMakernote)) {
             delete mn_;
             mn_ = 0;
@@ -1325,6 +1449,11 @@ namespace Exiv2 {
         memset(buf.pData_, 0x0, buf.size_);
         uint32_t idx = 0;
         for (Strips::const_iterator i = strips_.begin(); i != strips_.end(); ++i) {
+            uint32_t kept = 0;
+            if (!(group() > mnId) && ioWrapper.keptImage(i->first, i->second, kept)) {
+                idx += writeOffset(buf.pData_ + idx, kept, tiffType(), byteOrder);
+                continue;
+            }
             idx += writeOffset(buf.pData_ + idx, o2, tiffType(), byteOrder);
             o2 += i->second;
             o2 += i->second & 1;                // Align strip data to word boundary
@@ -1635,6 +1764,8 @@ namespace Exiv2 {
 #endif
             len = 0;
             for (Strips::const_iterator i = strips_.begin(); i != strips_.end(); ++i) {
+                uint32_t kept = 0;
+                if (!(group() > mnId) && ioWrapper.keptImage(i->first, i->second, kept)) continue;
                 ioWrapper.write(i->first, i->second);
                 len += i->second;
                 uint32_t align = i->second & 1; // Align strip data to word boundary
@@ -1648,9 +1779,25 @@ namespace Exiv2 {
         return len;
     } // TiffImageEntry::doWriteImage
 
+    uint32_t TiffComponent::cachedSize(SizeCache::Kind kind, uint32_t (TiffComponent::*fct)() const) const
+    {
+        const TiffLayout* layout = currentLayout;
+        if (layout == 0) return (this->*fct)();
+        if (sizeCache_.layoutId_ != layout->id()) {
+            sizeCache_.layoutId_ = layout->id();
+            sizeCache_.cached_ = 0;
+        }
+        const uint32_t bit = 1u << kind;
+        if (!(sizeCache_.cached_ & bit)) {
+            sizeCache_.sizes_[kind] = (this->*fct)();
+            sizeCache_.cached_ |= bit;
+        }
+        return sizeCache_.sizes_[kind];
+    } // TiffComponent::cachedSize
+
     uint32_t TiffComponent::size() const
     {
-        return doSize();
+        return cachedSize(SizeCache::value, &TiffComponent::doSize);
     } // TiffComponent::size
 
     uint32_t TiffDirectory::doSize() const
@@ -1744,7 +1891,7 @@ namespace Exiv2 {
 
     uint32_t TiffComponent::sizeData() const
     {
-        return doSizeData();
+        return cachedSize(SizeCache::data, &TiffComponent::doSizeData);
     } // TiffComponent::sizeData
 
     uint32_t TiffDirectory::doSizeData() const
@@ -1791,7 +1938,7 @@ namespace Exiv2 {
 
     uint32_t TiffComponent::sizeImage() const
     {
-        return doSizeImage();
+        return cachedSize(SizeCache::image, &TiffComponent::doSizeImage);
     } // TiffComponent::sizeImage
 
     uint32_t TiffDirectory::doSizeImage() const
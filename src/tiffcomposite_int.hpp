@@ -38,6 +38,7 @@
 #include <vector>
 #include <string>
 #include <cassert>
+#include <cstddef>
 
 // *****************************************************************************
 // namespace extensions
@@ -66,6 +67,9 @@ namespace Exiv2 {
     const TiffType ttTiffFloat        =11; //!< TIFF FLOAT type
     const TiffType ttTiffDouble       =12; //!< TIFF DOUBLE type
     const TiffType ttTiffIfd          =13; //!< TIFF IFD type
+    const TiffType ttUnsignedLong8    =16; //!< BigTIFF LONG8 type
+    const TiffType ttSignedLong8      =17; //!< BigTIFF SLONG8 type
+    const TiffType ttTiffIfd8         =18; //!< BigTIFF IFD8 type
 
     //! Convert the \em tiffType of a \em tag and \em group to an Exiv2 \em typeId.
     TypeId toTypeId(TiffType tiffType, uint16_t tag, IfdId group);
@@ -81,6 +85,9 @@ namespace Exiv2 {
         const uint32_t next = 0x30000; //!< Special tag: next IFD
         const uint32_t all  = 0x40000; //!< Special tag: all tags in a group
         const uint32_t pana = 0x80000; //!< Special tag: root IFD of Panasonic RAW images
+        const uint32_t cmt2 = 0x90000; //!< Special tag: root IFD of the CMT2 box (Exif IFD) of CR3 images
+        const uint32_t cmt3 = 0xa0000; //!< Special tag: root IFD of the CMT3 box (Canon makernote) of CR3 images
+        const uint32_t cmt4 = 0xb0000; //!< Special tag: root IFD of the CMT4 box (GPS IFD) of CR3 images
     }
 
     /*!
@@ -152,6 +159,22 @@ namespace Exiv2 {
         int putb(byte data);
         //! Wrapper for OffsetWriter::setTarget(), using an int instead of the enum to reduce include deps
         void setTarget(int id, uint32_t target);
+        /*!
+          @brief Keep image data which is located in the original image
+                 \em pData, \em size at its offset instead of writing it.
+
+          Used when the TIFF structure is appended to the original image.
+         */
+        void keepImage(const byte* pData, uint32_t size);
+        //@}
+
+        //! @name Accessors
+        //@{
+        /*!
+          @brief Return true if the image data \em pImage, \em size is kept
+                 in the original image and set \em offset to its offset.
+         */
+        bool keptImage(const byte* pImage, uint32_t size, uint32_t& offset) const;
         //@}
 
     private:
@@ -161,8 +184,90 @@ namespace Exiv2 {
         long size_;                //! Size of the header data.
         bool wroteHeader_;         //! Indicates if the header has been written.
         OffsetWriter* pow_;        //! Pointer to an offset-writer, if any, or 0
+        const byte* pImage_;       //! Original image with the image data to keep, or 0
+        uint32_t sizeImage_;       //! Size of the original image
     }; // class IoWrapper
 
+    /*!
+      @brief Monotonic memory arena for the components of TIFF composites.
+
+      While an arena exists, it is the current arena of the thread which
+      created it and all TiffComponents allocated on that thread are carved
+      out of its blocks. Deleting such a component runs its destructor but
+      releases no memory; all blocks are released together when the arena is
+      destroyed. Components allocated from an arena must not outlive it.
+      Arenas nest, the previous arena becomes current again when an arena is
+      destroyed.
+     */
+    class TiffArena {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor, makes the new arena the current arena of the thread
+        TiffArena();
+        //! Destructor, restores the previous arena and releases all memory
+        ~TiffArena();
+        TiffArena(const TiffArena& rhs) = delete;
+        TiffArena& operator=(const TiffArena& rhs) = delete;
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Return \em size bytes of suitably aligned memory
+        void* allocate(std::size_t size);
+        //@}
+
+        //! Return the current arena of the thread or 0 if there is none
+        static TiffArena* current();
+
+    private:
+        // DATA
+        std::vector<byte*> blocks_;             //!< Memory blocks owned by the arena
+        byte*              next_;               //!< Next free byte in the last block
+        std::size_t        left_;               //!< Bytes left in the last block
+        TiffArena*         previous_;           //!< Arena which was current before this one
+
+    }; // class TiffArena
+
+    /*!
+      @brief Memoized layout of TIFF composites while they are written.
+
+      While a layout exists, it is the current layout of the thread which
+      created it and TiffComponent::size(), sizeData() and sizeImage() compute
+      the size of each component only once. Later calls, e.g., for the offsets
+      of the values and sub-IFDs of each directory, return the cached size
+      instead of recursing into the subtree again. Composites must not be
+      modified while a layout is current. Sizes cached for a layout are not
+      used after it is destroyed, layouts nest like arenas.
+     */
+    class TiffLayout {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor, makes the new layout the current layout of the thread
+        TiffLayout();
+        //! Destructor, restores the previous layout
+        ~TiffLayout();
+        TiffLayout(const TiffLayout& rhs) = delete;
+        TiffLayout& operator=(const TiffLayout& rhs) = delete;
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the id of the layout, unique in the thread
+        uint32_t id() const { return id_; }
+        //@}
+
+        //! Return the current layout of the thread or 0 if there is none
+        static const TiffLayout* current();
+
+    private:
+        // DATA
+        uint32_t    id_;                        //!< Id of the layout
+        TiffLayout* previous_;                  //!< Layout which was current before this one
+
+    }; // class TiffLayout
+
     /*!
       @brief Interface class for components of a TIFF directory hierarchy
              (Composite pattern).  Both TIFF directories as well as entries
@@ -186,6 +291,14 @@ namespace Exiv2 {
         virtual ~TiffComponent();
         //@}
 
+        //! @name Allocation
+        //@{
+        //! Allocate a component from the current TiffArena, if there is one
+        static void* operator new(std::size_t size);
+        //! Release the memory of a component unless it is owned by an arena
+        static void operator delete(void* p);
+        //@}
+
         //! @name Manipulators
         //@{
         /*!
@@ -361,9 +474,25 @@ namespace Exiv2 {
         //@}
 
     private:
+        //! Sizes of a component cached for a TiffLayout, copies start empty
+        struct SizeCache {
+            //! Kinds of sizes
+            enum Kind { value, data, image };
+            SizeCache() : layoutId_(0), cached_(0) {}
+            SizeCache(const SizeCache& /*rhs*/) : SizeCache() {}
+            SizeCache& operator=(const SizeCache& /*rhs*/) { layoutId_ = 0; cached_ = 0; return *this; }
+            uint32_t layoutId_;                 //!< Layout of the cached sizes, 0 if none
+            uint32_t cached_;                   //!< Bit set of the cached kinds
+            uint32_t sizes_[3];                 //!< Cached sizes, by kind
+        };
+
+        //! Return the size \em kind computed by \em fct, cached for the current layout
+        uint32_t cachedSize(SizeCache::Kind kind, uint32_t (TiffComponent::*fct)() const) const;
+
         // DATA
         uint16_t tag_;      //!< Tag that identifies the component
         IfdId    group_;    //!< Group id for this component
+        mutable SizeCache sizeCache_; //!< Sizes cached for the current layout
         /*!
           Pointer to the start of the binary representation of the component in
           a memory buffer. The buffer is allocated and freed outside of this class.
@@ -452,6 +581,11 @@ namespace Exiv2 {
           Update type, count and the pointer to the value.
         */
         void setValue(Value::UniquePtr value);
+        /*!
+          @brief Release the value to the caller, who takes ownership. The
+                 entry keeps its data but has no value afterwards.
+        */
+        Value::UniquePtr releaseValue();
         //@}
 
         //! @name Accessors
@@ -642,6 +776,8 @@ namespace Exiv2 {
      */
     class TiffDataEntry : public TiffDataEntryBase {
         friend class TiffEncoder;
+        friend class TiffBackup;
+        friend class TiffExtent;
     public:
         //! @name Creators
         //@{
@@ -722,6 +858,7 @@ namespace Exiv2 {
      */
     class TiffImageEntry : public TiffDataEntryBase {
         friend class TiffEncoder;
+        friend class TiffExtent;
     public:
         //! @name Creators
         //@{
@@ -1185,6 +1322,12 @@ namespace Exiv2 {
                  Returns 0 if there is no header.
          */
         uint32_t baseOffset() const;
+        /*!
+          @brief Return true if the offsets of the makernote IFD entries are
+                 relative to the makernote, i.e., if the makernote can be
+                 moved as it is. False if there is no header.
+         */
+        bool relocatable() const;
         //@}
 
     protected:
@@ -62,6 +62,7 @@ namespace Exiv2 {
 
     class TiffVisitor;
     class TiffFinder;
+    class TiffBackup;
     class TiffDecoder;
     class TiffEncoder;
     class TiffReader;
@@ -80,7 +81,7 @@ namespace Exiv2 {
       @brief Function pointer type for a TiffDecoder member function
              to decode a TIFF component.
      */
-    typedef void (TiffDecoder::*DecoderFct)(const TiffEntryBase*);
+    typedef void (TiffDecoder::*DecoderFct)(TiffEntryBase*);
     /*!
       @brief Function pointer type for a TiffDecoder member function
              to decode a TIFF component.
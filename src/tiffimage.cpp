@@ -38,6 +38,7 @@
 #include "types.hpp"
 #include "basicio.hpp"
 #include "i18n.h"                // NLS support.
+#include "stats_int.hpp"
 
 // + standard includes
 #include <string>
@@ -64,6 +65,43 @@
 
    -------------------------------------------------------------------------- */
 
+// *****************************************************************************
+// local declarations
+namespace {
+
+    using namespace Exiv2;
+
+    //! Add the strips and tiles of the images in \em exifData, not of the thumbnail, to \em hash
+    void hashImageData(BasicIo& io, const ExifData& exifData, Internal::PayloadHash& hash)
+    {
+        static const char* const groups[] = {
+            "Image", "Image2", "Image3", "SubImage1", "SubImage2", "SubImage3",
+            "SubImage4", "SubImage5", "SubImage6", "SubImage7", "SubImage8", "SubImage9"
+        };
+        static const char* const tags[][2] = {
+            { "StripOffsets", "StripByteCounts" },
+            { "TileOffsets",  "TileByteCounts"  }
+        };
+        for (auto&& group : groups) {
+            for (auto&& tag : tags) {
+                const std::string prefix = std::string("Exif.") + group + ".";
+                ExifData::const_iterator offsets = exifData.findKey(ExifKey(prefix + tag[0]));
+                if (offsets == exifData.end()) continue;
+                ExifData::const_iterator sizes = exifData.findKey(ExifKey(prefix + tag[1]));
+                if (sizes == exifData.end()) continue;
+                for (long i = 0; i < offsets->count() && i < sizes->count(); ++i) {
+                    const uint64_t offset = static_cast<uint32_t>(offsets->toLong(i));
+                    const uint64_t size = static_cast<uint32_t>(sizes->toLong(i));
+                    if (offset + size > io.size()) throw Error(kerCorruptedMetadata);
+                    io.seek(static_cast<long>(offset), BasicIo::beg);
+                    Internal::hashData(io, static_cast<long>(size), hash);
+                }
+            }
+        }
+    }
+
+}
+
 // *****************************************************************************
 // class member definitions
 namespace Exiv2 {
@@ -72,10 +110,29 @@ namespace Exiv2 {
 
     TiffImage::TiffImage(BasicIo::UniquePtr io, bool /*create*/)
         : Image(ImageType::tiff, mdExif | mdIptc | mdXmp, std::move(io)),
-          pixelWidth_(0), pixelHeight_(0)
+          pixelWidth_(0), pixelHeight_(0), pagesRead_(false)
     {
     } // TiffImage::TiffImage
 
+    TiffPage::TiffPage(BasicIo& io, size_t index, uint32_t offset)
+        : io_(&io), index_(index), offset_(offset)
+    {
+    }
+
+    const ExifData& TiffPage::exifData() const
+    {
+        if (!exifData_) {
+            if (io_->open() != 0) {
+                throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+            }
+            IoCloser closer(*io_);
+            std::shared_ptr<ExifData> exifData(new ExifData);
+            TiffParserWorker::decodePage(*exifData, io_->mmap(), io_->size(), offset_);
+            exifData_ = exifData;
+        }
+        return *exifData_;
+    } // TiffPage::exifData
+
     //! Structure for TIFF compression to MIME type mappings
     struct MimeTypeList {
         //! Comparison operator for compression
@@ -183,18 +240,28 @@ namespace Exiv2 {
             throw Error(kerNotAnImage, "TIFF");
         }
         clearMetadata();
+        pages_.clear();
+        pagesRead_ = false;
+        payloadHashDefined_ = false;
 
+        // fetch the directories together, remote files only map the blocks fetched before
+        if (io_->prefetches()) {
+            TiffParserWorker::prefetch(*io_);
+        }
         ByteOrder bo = TiffParser::decode(exifData_,
                                           iptcData_,
                                           xmpData_,
                                           io_->mmap(),
                                           (uint32_t) io_->size());
+        exifData_.setTiffOffset(0);
         setByteOrder(bo);
 
         // read profile from the metadata
-        Exiv2::ExifKey            key("Exif.Image.InterColorProfile");
-        Exiv2::ExifData::iterator pos   = exifData_.findKey(key);
-        if ( pos != exifData_.end() ) {
+        // A const lookup, mutable iterators would stop copies from sharing the metadata
+        const ExifData& exifData = exifData_;
+        Exiv2::ExifKey                  key("Exif.Image.InterColorProfile");
+        Exiv2::ExifData::const_iterator pos   = exifData.findKey(key);
+        if ( pos != exifData.end() ) {
             long size = pos->count() * pos->typeSize();
             if (size == 0) {
                 throw Error(kerFailedToReadImageData);
@@ -203,10 +270,46 @@ namespace Exiv2 {
             pos->copy(iccProfile_.pData_,bo);
         }
 
+        if (hashPayload()) {
+            Internal::PayloadHash hash;
+            hashImageData(*io_, exifData, hash);
+            payloadHash_ = hash.value();
+            payloadHashDefined_ = true;
+        }
+        releasePackets();
+    }
+
+    void TiffImage::readBasicInfo()
+    {
+        if (io_->open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+
+        IoCloser closer(*io_);
+        // Ensure that this is the correct image type
+        if (!isTiffType(*io_, false)) {
+            if (io_->error() || io_->eof())
+                throw Error(kerFailedToReadImageData);
+            throw Error(kerNotAnImage, "TIFF");
+        }
+        clearMetadata();
+        pages_.clear();
+        pagesRead_ = false;
+        primaryGroup_.clear();
+        mimeType_.clear();
+        pixelWidth_ = 0;
+        pixelHeight_ = 0;
+
+        // NewSubfileType, ImageWidth, ImageLength, Orientation
+        const uint16_t tags[] = { 0x00fe, 0x0100, 0x0101, 0x0112 };
+        setByteOrder(TiffParserWorker::decodeIfd0(exifData_, *io_, 0, static_cast<long>(io_->size()),
+                                                  tags, EXV_COUNTOF(tags)));
     }
 
     void TiffImage::writeMetadata()
     {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
 #ifdef DEBUG
         std::cerr << "Writing TIFF file " << io_->path() << "\n";
 #endif
@@ -245,9 +348,33 @@ namespace Exiv2 {
         // set usePacket to influence TiffEncoder::encodeXmp() called by TiffVisitor.encode()
         xmpData().usePacket(writeXmpFromPacket());
 
-        TiffParser::encode(*io_, pData, size, bo, exifData_, iptcData_, xmpData_); // may throw
+        pages_.clear();
+        pagesRead_ = false;
+        TiffParser::encode(*io_, pData, size, bo, exifData_, iptcData(), xmpData(), writeInPlace()); // may throw
     } // TiffImage::writeMetadata
 
+    const std::vector<TiffPage>& TiffImage::pages()
+    {
+        if (pagesRead_) return pages_;
+        if (io_->open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+        IoCloser closer(*io_);
+        if (!isTiffType(*io_, false)) {
+            if (io_->error() || io_->eof())
+                throw Error(kerFailedToReadImageData);
+            throw Error(kerNotAnImage, "TIFF");
+        }
+        const std::vector<uint32_t> offsets = TiffParserWorker::pageOffsets(io_->mmap(), io_->size());
+        pages_.clear();
+        pages_.reserve(offsets.size());
+        for (size_t i = 0; i < offsets.size(); ++i) {
+            pages_.push_back(TiffPage(*io_, i, offsets[i]));
+        }
+        pagesRead_ = true;
+        return pages_;
+    } // TiffImage::pages
+
     ByteOrder TiffParser::decode(
               ExifData& exifData,
               IptcData& iptcData,
@@ -272,7 +399,8 @@ namespace Exiv2 {
               ByteOrder byteOrder,
         const ExifData& exifData,
         const IptcData& iptcData,
-        const XmpData&  xmpData
+        const XmpData&  xmpData,
+              bool      append
     )
     {
         // Copy to be able to modify the Exif data
@@ -302,7 +430,8 @@ namespace Exiv2 {
                                         Tag::root,
                                         TiffMapping::findEncoder,
                                         header.get(),
-                                        0);
+                                        0,
+                                        append);
     } // TiffParser::encode
 
     // *************************************************************************
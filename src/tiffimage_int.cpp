@@ -1,10 +1,28 @@
 #include "tiffimage_int.hpp"
 
 #include "error.hpp"
+#include "futils.hpp"
+#include "image_int.hpp"
 #include "makernote_int.hpp"
+#include "stats_int.hpp"
+#include "trace.hpp"
 #include "tiffvisitor_int.hpp"
 #include "i18n.h"                // NLS support.
 
+// + standard includes
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
 // Shortcuts for the newTiffBinaryArray templates.
 #define EXV_BINARY_ARRAY(arrayCfg, arrayDef) (newTiffBinaryArray0<&arrayCfg, EXV_COUNTOF(arrayDef), arrayDef>)
 #define EXV_SIMPLE_BINARY_ARRAY(arrayCfg) (newTiffBinaryArray1<&arrayCfg>)
@@ -968,7 +986,15 @@ namespace Exiv2 {
         { Tag::pana, ifdIdNotSet,      ifdIdNotSet,      Tag::pana },
         { Tag::pana, panaRawId,        ifdIdNotSet,      Tag::pana },
         { Tag::pana, exifId,           panaRawId,        0x8769    },
-        { Tag::pana, gpsId,            panaRawId,        0x8825    }
+        { Tag::pana, gpsId,            panaRawId,        0x8825    },
+        // ---------------------------------------------------------
+        // CMT2 to CMT4 boxes of Canon CR3 images
+        { Tag::cmt2, ifdIdNotSet,      ifdIdNotSet,      Tag::cmt2 },
+        { Tag::cmt2, exifId,           ifdIdNotSet,      Tag::cmt2 },
+        { Tag::cmt3, ifdIdNotSet,      ifdIdNotSet,      Tag::cmt3 },
+        { Tag::cmt3, canonId,          ifdIdNotSet,      Tag::cmt3 },
+        { Tag::cmt4, ifdIdNotSet,      ifdIdNotSet,      Tag::cmt4 },
+        { Tag::cmt4, gpsId,            ifdIdNotSet,      Tag::cmt4 }
     };
 
     /*
@@ -1428,6 +1454,11 @@ namespace Exiv2 {
         // Root directory of Panasonic RAW images
         { Tag::pana, ifdIdNotSet,      newTiffDirectory<panaRawId>               },
 
+        // Root directories of the CMT2 to CMT4 boxes of Canon CR3 images
+        { Tag::cmt2, ifdIdNotSet,      newTiffDirectory<exifId>                  },
+        { Tag::cmt3, ifdIdNotSet,      newTiffDirectory<canonId>                 },
+        { Tag::cmt4, ifdIdNotSet,      newTiffDirectory<gpsId>                   },
+
         // IFD0 of Panasonic RAW images
         {    0x8769, panaRawId,        newTiffSubIfd<exifId>                     },
         {    0x8825, panaRawId,        newTiffSubIfd<gpsId>                      },
@@ -1493,13 +1524,57 @@ namespace Exiv2 {
         return key.r_ == root_ && key.g_ == group_;
     }
 
+    const TiffGroupStruct* TiffCreator::findGroupStruct(uint32_t extendedTag, IfdId group)
+    {
+        // The entries sorted by group and tag, in table order for the same key
+        typedef std::vector<const TiffGroupStruct*> Index;
+        static const Index index = [] {
+            Index idx;
+            for (const TiffGroupStruct& ts : tiffGroupStruct_) idx.push_back(&ts);
+            std::stable_sort(idx.begin(), idx.end(), [](const TiffGroupStruct* lhs, const TiffGroupStruct* rhs) {
+                return lhs->group_ < rhs->group_ || (lhs->group_ == rhs->group_ && lhs->extendedTag_ < rhs->extendedTag_);
+            });
+            return idx;
+        }();
+        auto first = [](IfdId g, uint32_t e) -> const TiffGroupStruct* {
+            const Index::const_iterator pos = std::lower_bound(index.begin(), index.end(), e,
+                [g](const TiffGroupStruct* ts, uint32_t key) {
+                    return ts->group_ < g || (ts->group_ == g && ts->extendedTag_ < key);
+                });
+            return pos != index.end() && (*pos)->group_ == g && (*pos)->extendedTag_ == e ? *pos : 0;
+        };
+        // The first entry in table order which matches the tag or all tags of the group
+        const TiffGroupStruct* ts = first(group, extendedTag);
+        const TiffGroupStruct* all = first(group, Tag::all);
+        if (!ts || (all && all < ts)) ts = all;
+        return ts;
+    }
+
+    const TiffTreeStruct* TiffCreator::findTreeStruct(uint32_t root, IfdId group)
+    {
+        // The entries sorted by root and group, in table order for the same key
+        typedef std::vector<const TiffTreeStruct*> Index;
+        static const Index index = [] {
+            Index idx;
+            for (const TiffTreeStruct& ts : tiffTreeStruct_) idx.push_back(&ts);
+            std::stable_sort(idx.begin(), idx.end(), [](const TiffTreeStruct* lhs, const TiffTreeStruct* rhs) {
+                return lhs->root_ < rhs->root_ || (lhs->root_ == rhs->root_ && lhs->group_ < rhs->group_);
+            });
+            return idx;
+        }();
+        const Index::const_iterator pos = std::lower_bound(index.begin(), index.end(), TiffTreeStruct::Key(root, group),
+            [](const TiffTreeStruct* ts, const TiffTreeStruct::Key& key) {
+                return ts->root_ < key.r_ || (ts->root_ == key.r_ && ts->group_ < key.g_);
+            });
+        return pos != index.end() && **pos == TiffTreeStruct::Key(root, group) ? *pos : 0;
+    }
+
     TiffComponent::UniquePtr TiffCreator::create(uint32_t extendedTag,
                                                IfdId    group)
     {
         TiffComponent::UniquePtr tc;
         uint16_t tag = static_cast<uint16_t>(extendedTag & 0xffff);
-        const TiffGroupStruct* ts = find(tiffGroupStruct_,
-                                         TiffGroupStruct::Key(extendedTag, group));
+        const TiffGroupStruct* ts = findGroupStruct(extendedTag, group);
         if (ts && ts->newTiffCompFct_) {
             tc = ts->newTiffCompFct_(tag, group);
         }
@@ -1527,7 +1602,7 @@ namespace Exiv2 {
         const TiffTreeStruct* ts = 0;
         do {
             tiffPath.push(TiffPathItem(extendedTag, group));
-            ts = find(tiffTreeStruct_, TiffTreeStruct::Key(root, group));
+            ts = findTreeStruct(root, group);
             assert(ts != 0);
             extendedTag = ts->parentExtTag_;
             group = ts->parentGroup_;
@@ -1540,42 +1615,164 @@ namespace Exiv2 {
               IptcData&          iptcData,
               XmpData&           xmpData,
         const byte*              pData,
-              uint32_t           size,
+              size_t             size,
               uint32_t           root,
               FindDecoderFct     findDecoderFct,
               TiffHeaderBase*    pHeader
     )
     {
+        PhaseTimer timer(&IoStats::tiffDecodeTime_);
+        Trace trace("tiff-decode", "TIFF");
         // Create standard TIFF header if necessary
         std::unique_ptr<TiffHeaderBase> ph;
         if (!pHeader) {
             ph = std::unique_ptr<TiffHeaderBase>(new TiffHeader);
             pHeader = ph.get();
         }
-        TiffComponent::UniquePtr rootDir = parse(pData, size, root, pHeader);
+        const bool readMakernote = acceptsMakernote(exifData.decodeFilter());
+        const bool emptyExifData = exifData.empty();
+        exifData.embedded_.reset();
+        // The composite is released in bulk with the arena, it must be declared first
+        TiffArena arena;
+        TiffComponent::UniquePtr rootDir = parse(pData, size, root, pHeader,
+                                                 readMakernote && !exifData.lazyMakernote(),
+                                                 &exifData.decodeFilter());
         if (0 != rootDir.get()) {
-            TiffDecoder decoder(exifData,
-                                iptcData,
-                                xmpData,
-                                rootDir.get(),
-                                findDecoderFct);
-            rootDir->accept(decoder);
+            // Capture a lazy makernote first, the decoder takes the values out of the composite
+            std::shared_ptr<const DeferredMakernote> makernote;
+            if (readMakernote && exifData.lazyMakernote()) {
+                makernote = DeferredMakernote::create(rootDir.get(), pData,
+                                                      static_cast<uint32_t>(std::min<size_t>(size, 0xffffffff)),
+                                                      pHeader->byteOrder());
+            }
+            if (exifData.parallelDecode()) {
+                decodeParallel(exifData, iptcData, xmpData, rootDir.get(), findDecoderFct, pData, size);
+            } else {
+                TiffDecoder decoder(exifData,
+                                    iptcData,
+                                    xmpData,
+                                    rootDir.get(),
+                                    findDecoderFct,
+                                    pData,
+                                    size);
+                rootDir->accept(decoder);
+            }
+            exifData.makernote_ = makernote;
+            exifData.keepEmbedded();
         }
+        // Only the decoder used iterators into metadata decoded into an empty container,
+        // later copies may share them
+        if (emptyExifData) exifData.storage_->shareable_ = true;
         return pHeader->byteOrder();
 
     } // TiffParserWorker::decode
 
+    void TiffParserWorker::decodeParallel(
+              ExifData&          exifData,
+              IptcData&          iptcData,
+              XmpData&           xmpData,
+              TiffComponent*     pRoot,
+              FindDecoderFct     findDecoderFct,
+        const byte*              pData,
+              size_t             size
+    )
+    {
+        // Task 0 decodes the root into the containers, the others a sub-tree each
+        std::vector<TiffComponent*> roots(1, pRoot);
+        TiffSubtreeFinder finder(roots);
+        pRoot->accept(finder);
+        const TiffDecoder::Subtrees subtrees(roots.begin() + 1, roots.end());
+        const size_t n = roots.size();
+
+        std::vector<ExifData> exif(n);
+        std::vector<IptcData> iptc(n);
+        std::vector<XmpData> xmp(n);
+        // The decoders look up the camera make in the composite, before it is decoded
+        std::vector<std::unique_ptr<TiffDecoder> > decoders;
+        for (size_t i = 0; i < n; ++i) {
+            exif[i].setDecodeFilter(exifData.decodeFilter());
+            decoders.emplace_back(new TiffDecoder(i == 0 ? exifData : exif[i],
+                                                  i == 0 ? iptcData : iptc[i],
+                                                  i == 0 ? xmpData : xmp[i],
+                                                  pRoot,
+                                                  findDecoderFct,
+                                                  pData,
+                                                  size));
+            decoders[i]->skipSubtrees(&subtrees, roots[i]);
+        }
+
+        // Threads of the AsyncPool help with the tasks. They may only start
+        // after this thread ran all of them, such a helper finds none left
+        // and must not touch the tasks, which are gone by then.
+        struct Tasks {
+            std::atomic<size_t> next_;          //!< Next task to run
+            size_t done_;                       //!< Number of tasks which ran
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            std::function<void(size_t)> run_;   //!< Runs a task
+        };
+        std::vector<std::exception_ptr> errors(n);
+        std::shared_ptr<Tasks> tasks = std::make_shared<Tasks>();
+        tasks->next_ = 0;
+        tasks->done_ = 0;
+        tasks->run_ = [&roots, &decoders, &errors](size_t i) {
+            try {
+                Trace trace("tiff-decode", i == 0 ? "root IFD" : "sub-tree");
+                roots[i]->accept(*decoders[i]);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        };
+        auto work = [n](const std::shared_ptr<Tasks>& tasks) {
+            for (size_t i = tasks->next_++; i < n; i = tasks->next_++) {
+                tasks->run_(i);
+                std::lock_guard<std::mutex> lock(tasks->mutex_);
+                if (++tasks->done_ == n) tasks->cv_.notify_all();
+            }
+        };
+        const size_t threads = std::min<size_t>(n, std::max(1u, std::thread::hardware_concurrency()));
+        for (size_t t = 1; t < threads; ++t) {
+            AsyncPool::instance().post([work, tasks]() { work(tasks); });
+        }
+        work(tasks);
+        {
+            std::unique_lock<std::mutex> lock(tasks->mutex_);
+            tasks->cv_.wait(lock, [&tasks, n]() { return tasks->done_ == n; });
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (errors[i]) std::rethrow_exception(errors[i]);
+        }
+
+        // Insert each sub-tree where its decoder skipped it. Nested sub-trees
+        // come after those which contain them and are inserted first.
+        std::map<const TiffComponent*, size_t> task;
+        for (size_t i = 1; i < n; ++i) task[roots[i]] = i;
+        for (size_t i = n; i-- > 0;) {
+            ExifMetadata& metadata = (i == 0 ? exifData : exif[i]).mutableStorage(false).metadata_;
+            const TiffDecoder::SubtreePositions& positions = decoders[i]->subtreePositions();
+            for (TiffDecoder::SubtreePositions::const_reverse_iterator p = positions.rbegin(); p != positions.rend(); ++p) {
+                ExifMetadata::iterator pos = metadata.begin();
+                std::advance(pos, p->second);
+                metadata.splice(pos, exif[task[p->first]].mutableStorage(false).metadata_);
+            }
+        }
+        exifData.mutableStorage(false).index_.invalidate();
+
+    } // TiffParserWorker::decodeParallel
+
     WriteMethod TiffParserWorker::encode(
               BasicIo&           io,
         const byte*              pData,
-              uint32_t           size,
+              size_t             size,
         const ExifData&          exifData,
         const IptcData&          iptcData,
         const XmpData&           xmpData,
               uint32_t           root,
               FindEncoderFct     findEncoderFct,
               TiffHeaderBase*    pHeader,
-              OffsetWriter*      pOffsetWriter
+              OffsetWriter*      pOffsetWriter,
+              bool               append,
+              uint32_t           sizeLimit
     )
     {
         /*
@@ -1585,15 +1782,39 @@ namespace Exiv2 {
               writing"). If there is a parsed tree, it is only used to access the
               image data in this case.
          */
+        Trace trace("encode", "TIFF");
         assert(pHeader);
         assert(pHeader->byteOrder() != invalidByteOrder);
+        // A makernote which is still pending was not accessed, it is unchanged.
+        // If it can be moved as it is, it is written back from the binary tag,
+        // else the encoder needs the makernote metadata to write the makernote.
+        // The encoders see the binary tag of a kept makernote only
+        ExifData undecoded;
+        bool keepMakernote = false;
+        if (exifData.makernotePending()) {
+            // Decide on a copy, another thread may decode the makernote meanwhile
+            undecoded = exifData;
+            keepMakernote = undecoded.makernote_ && undecoded.makernote_->relocatable();
+            undecoded.makernote_.reset();
+        }
+        if (!keepMakernote) exifData.decodeMakernote();
+        const ExifData& encoded = keepMakernote ? undecoded : exifData;
         WriteMethod writeMethod = wmIntrusive;
-        TiffComponent::UniquePtr parsedTree = parse(pData, size, root, pHeader);
+        // Both composites are released in bulk with the arena, it must be declared first
+        TiffArena arena;
+        TiffComponent::UniquePtr parsedTree = parse(pData, size, root, pHeader, !keepMakernote);
         PrimaryGroups primaryGroups;
         findPrimaryGroups(primaryGroups, parsedTree.get());
         if (0 != parsedTree.get()) {
+            // BigTIFF images can only be updated in place, keep the original
+            // metadata to undo a partial update if it doesn't fit
+            TiffBackup backup(pData, size, pHeader->isBigTiff());
+            if (pHeader->isBigTiff()) parsedTree->accept(backup);
+            // Data areas which grew can be moved to the unused space at the end
+            TiffExtent extent(pData, size, pHeader->isBigTiff());
+            parsedTree->accept(extent);
             // Attempt to update existing TIFF components based on metadata entries
-            TiffEncoder encoder(exifData,
+            TiffEncoder encoder(encoded,
                                 iptcData,
                                 xmpData,
                                 parsedTree.get(),
@@ -1601,10 +1822,14 @@ namespace Exiv2 {
                                 &primaryGroups,
                                 pHeader,
                                 findEncoderFct);
+            encoder.setFreeSpace(const_cast<byte*>(extent.end()), const_cast<byte*>(pData) + size);
             parsedTree->accept(encoder);
             if (!encoder.dirty()) writeMethod = wmNonIntrusive;
+            else if (pHeader->isBigTiff()) backup.restore();
         }
         if (writeMethod == wmIntrusive) {
+            // The writer creates TIFF structures with 32 bit offsets only
+            if (pHeader->isBigTiff()) throw Error(kerWritingImageFormatUnsupported, "BigTIFF");
             TiffComponent::UniquePtr createdTree = TiffCreator::create(root, ifdIdNotSet);
             if (0 != parsedTree.get()) {
                 // Copy image tags from the original image to the composite
@@ -1612,7 +1837,7 @@ namespace Exiv2 {
                 parsedTree->accept(copier);
             }
             // Add entries from metadata to composite
-            TiffEncoder encoder(exifData,
+            TiffEncoder encoder(encoded,
                                 iptcData,
                                 xmpData,
                                 createdTree.get(),
@@ -1621,22 +1846,42 @@ namespace Exiv2 {
                                 pHeader,
                                 findEncoderFct);
             encoder.add(createdTree.get(), parsedTree.get(), root);
-            // Write binary representation from the composite tree
+            // Write binary representation from the composite tree, the sizes of
+            // its components are computed once for all the offsets
+            TiffLayout layout;
             DataBuf header = pHeader->write();
-            BasicIo::UniquePtr tempIo(new MemIo);
+            // The size of the IFDs is known before they are written, image data is aligned while writing
+            if (sizeLimit != 0 && header.size_ + createdTree->size() > sizeLimit) return writeMethod;
+            // Appending needs the complete original image in io and a plain TIFF header
+            const bool appending =    append && parsedTree.get() != 0 && pOffsetWriter == 0
+                                   && header.size_ == 8 && static_cast<size_t>(size) == io.size();
+            BasicIo::UniquePtr tempIo = appending ? BasicIo::UniquePtr(new MemIo) : createTempIo(io, size);
             assert(tempIo.get() != 0);
-            IoWrapper ioWrapper(*tempIo, header.pData_, header.size_, pOffsetWriter);
+            const uint32_t offset = appending ? size + (size & 1) : header.size_;
+            IoWrapper ioWrapper(*tempIo,
+                                appending ? 0 : header.pData_,
+                                appending ? 0 : header.size_,
+                                pOffsetWriter);
+            if (appending) ioWrapper.keepImage(pData, size);
             uint32_t imageIdx(uint32_t(-1));
             createdTree->write(ioWrapper,
                                pHeader->byteOrder(),
-                               header.size_,
+                               offset,
                                uint32_t(-1),
                                uint32_t(-1),
                                imageIdx);
             if (pOffsetWriter) pOffsetWriter->writeOffsets(*tempIo);
-            io.transfer(*tempIo); // may throw
+            if (appending) {
+                // The strips are not needed anymore, release the mapping before writing
+                io.munmap();
+                ul2Data(header.pData_ + 4, offset, pHeader->byteOrder());
+                appendTiff(io, size, *tempIo, header);
+            }
+            else if (sizeLimit == 0 || tempIo->size() <= sizeLimit) {
+                io.transfer(*tempIo); // may throw
+            }
 #ifndef SUPPRESS_WARNINGS
-            EXV_INFO << "Write strategy: Intrusive\n";
+            EXV_INFO << "Write strategy: " << (appending ? "Append" : "Intrusive") << "\n";
 #endif
         }
 #ifndef SUPPRESS_WARNINGS
@@ -1649,21 +1894,24 @@ namespace Exiv2 {
 
     TiffComponent::UniquePtr TiffParserWorker::parse(
         const byte*              pData,
-              uint32_t           size,
+              size_t             size,
               uint32_t           root,
-              TiffHeaderBase*    pHeader
+              TiffHeaderBase*    pHeader,
+              bool               readMakernote,
+        const DecodeFilter*      filter
     )
     {
         if (pData == 0 || size == 0)
             return nullptr;
-        if (!pHeader->read(pData, size) || pHeader->offset() >= size) {
+        if (   !pHeader->read(pData, static_cast<uint32_t>(std::min<size_t>(size, 0xffffffff)))
+            || pHeader->offset() >= size) {
             throw Error(kerNotAnImage, "TIFF");
         }
         TiffComponent::UniquePtr rootDir = TiffCreator::create(root, ifdIdNotSet);
         if (0 != rootDir.get()) {
             rootDir->setStart(pData + pHeader->offset());
-            TiffRwState state(pHeader->byteOrder(), 0);
-            TiffReader reader(pData, size, rootDir.get(), state);
+            TiffRwState state(pHeader->byteOrder(), 0, pHeader->isBigTiff());
+            TiffReader reader(pData, size, rootDir.get(), state, readMakernote, filter);
             rootDir->accept(reader);
             reader.postProcess();
         }
@@ -1671,6 +1919,53 @@ namespace Exiv2 {
 
     } // TiffParserWorker::parse
 
+    bool TiffParserWorker::acceptsMakernote(const DecodeFilter& filter)
+    {
+        if (filter.empty()) return true;
+        for (const GroupInfo* gi = groupList(); gi->ifdId_ != lastId; ++gi) {
+            if (   isMakerIfd(static_cast<IfdId>(gi->ifdId_))
+                && filter.acceptsGroup("Exif", gi->groupName_)) return true;
+        }
+        return false;
+
+    } // TiffParserWorker::acceptsMakernote
+
+    void TiffParserWorker::appendTiff(BasicIo& io, uint32_t size, BasicIo& tiff, const DataBuf& header)
+    {
+        // The appended IFDs must start on a word boundary
+        io.seek(size, BasicIo::beg);
+        if ((size & 1) && io.putb(0x0) == EOF) throw Error(kerImageWriteFailed);
+        tiff.seek(0, BasicIo::beg);
+        if (io.write(tiff) != static_cast<long>(tiff.size())) throw Error(kerImageWriteFailed);
+        // Only switch to the new IFDs once they are completely written
+        io.seek(0, BasicIo::beg);
+        if (io.write(header.pData_, header.size_) != header.size_) throw Error(kerImageWriteFailed);
+        if (io.error()) throw Error(kerImageWriteFailed);
+    } // TiffParserWorker::appendTiff
+
+    BasicIo::UniquePtr TiffParserWorker::createTempIo(BasicIo& io, uint32_t size)
+    {
+        // Images up to this size are written to memory
+        const uint32_t maxMemorySize = 16 * 1024 * 1024;
+
+        FileIo* fileIo = dynamic_cast<FileIo*>(&io);
+        if (fileIo && size > maxMemorySize && !fileIo->path().empty()) {
+            const std::string tempPath = createTempFile(fileIo->path());
+            if (!tempPath.empty()) {
+                std::unique_ptr<TempFileIo> tempIo(new TempFileIo(tempPath));
+                if (tempIo->open("w+b") == 0) return BasicIo::UniquePtr(tempIo.release());
+            }
+#ifndef SUPPRESS_WARNINGS
+            EXV_WARNING << Error(kerFileOpenFailed, tempPath.empty() ? fileIo->path() + ".XXXXXX" : tempPath,
+                                 "w+b", strError())
+                        << ", writing to memory.\n";
+#endif
+        }
+        std::unique_ptr<MemIo> memIo(new MemIo);
+        memIo->reserve(static_cast<long>(size));
+        return BasicIo::UniquePtr(memIo.release());
+    } // TiffParserWorker::createTempIo
+
     void TiffParserWorker::findPrimaryGroups(PrimaryGroups& primaryGroups, TiffComponent* pSourceDir)
     {
         if (0 == pSourceDir)
@@ -1704,10 +1999,352 @@ namespace Exiv2 {
 
     } // TiffParserWorker::findPrimaryGroups
 
+    void TiffParserWorker::prefetch(BasicIo& io, TiffHeaderBase* pHeader, uint16_t dataTag)
+    {
+        // Tags whose value is the offset of another IFD
+        const uint16_t ifdTags[] = { 0x014a, 0x8769, 0x8825, 0xa005 };
+        // Tag data larger than this is image data rather than metadata
+        const uint32_t maxDataSize = 1024 * 1024;
+        // Bytes prefetched for an IFD before its entry count is known
+        const long ifdGuess = 2 + 32 * 12 + 4;
+
+        // The directories are read in small reads all over the file, which are prefetched here
+        io.advise(BasicIo::randomAccess);
+        TiffHeader tiffHeader;
+        if (pHeader == 0) pHeader = &tiffHeader;
+        byte buf[8];
+        DataBuf headerBuf(pHeader->size());
+        if (   io.readAt(0, headerBuf.pData_, headerBuf.size_) != headerBuf.size_
+            || !pHeader->read(headerBuf.pData_, headerBuf.size_)) return;
+        const ByteOrder bo = pHeader->byteOrder();
+        const uint32_t ioSize = static_cast<uint32_t>(io.size());
+
+        std::set<uint32_t> visited;
+        visited.insert(pHeader->offset());
+        std::vector<uint32_t> level(1, pHeader->offset());
+        bool isRoot = true;
+        std::vector<std::pair<long, long> > ranges;
+        while (!level.empty()) {
+            for (size_t i = 0; i < level.size(); ++i) {
+                ranges.push_back(std::make_pair(static_cast<long>(level[i]), ifdGuess));
+            }
+            io.prefetch(ranges);
+            ranges.clear();
+
+            std::vector<uint32_t> next;
+            for (size_t i = 0; i < level.size(); ++i) {
+                const uint32_t offset = level[i];
+                if (io.readAt(offset, buf, 2) != 2) continue;
+                const uint32_t count = getUShort(buf, bo);
+                const uint32_t size = 12 * count + 4;
+                if (count == 0 || size > ioSize - offset - 2) continue;
+                DataBuf dir(size);
+                if (io.readAt(offset + 2, dir.pData_, size) != static_cast<long>(size)) continue;
+
+                for (uint32_t n = 0; n < count; ++n) {
+                    const byte* entry = dir.pData_ + 12 * n;
+                    const uint16_t tag = getUShort(entry, bo);
+                    const long typeSize = TypeInfo::typeSize(static_cast<TypeId>(getUShort(entry + 2, bo)));
+                    const uint32_t valueCount = getULong(entry + 4, bo);
+                    const uint32_t value = getULong(entry + 8, bo);
+                    if (isRoot && dataTag != 0 && tag == dataTag) {
+                        if (typeSize != 0 && valueCount <= ioSize / typeSize && valueCount * typeSize > 4) {
+                            ranges.push_back(std::make_pair(static_cast<long>(value),
+                                                            static_cast<long>(valueCount * typeSize)));
+                        }
+                        continue;
+                    }
+                    if (typeSize == 0 || valueCount > maxDataSize / typeSize) continue;
+                    const uint32_t dataSize = valueCount * static_cast<uint32_t>(typeSize);
+                    const bool isIfd = std::find(ifdTags, ifdTags + EXV_COUNTOF(ifdTags), tag)
+                                       != ifdTags + EXV_COUNTOF(ifdTags);
+                    if (isIfd && dataSize == 4) {
+                        next.push_back(value);
+                    }
+                    else if (isIfd && typeSize == 4 && dataSize > 4 && dataSize <= ioSize - EXV_MIN(value, ioSize)) {
+                        // several SubIFDs, read their offsets right away
+                        DataBuf offsets(dataSize);
+                        if (io.readAt(value, offsets.pData_, dataSize) != static_cast<long>(dataSize)) continue;
+                        for (uint32_t k = 0; k < valueCount; ++k) {
+                            next.push_back(getULong(offsets.pData_ + 4 * k, bo));
+                        }
+                    }
+                    else if (dataSize > 4) {
+                        ranges.push_back(std::make_pair(static_cast<long>(value), static_cast<long>(dataSize)));
+                    }
+                }
+                next.push_back(getULong(dir.pData_ + 12 * count, bo));
+            }
+
+            level.clear();
+            isRoot = false;
+            for (size_t i = 0; i < next.size(); ++i) {
+                const uint32_t offset = next[i];
+                if (offset == 0 || offset >= ioSize || !visited.insert(offset).second) continue;
+                level.push_back(offset);
+            }
+        }
+        io.prefetch(ranges);
+
+    } // TiffParserWorker::prefetch
+
+    ByteOrder TiffParserWorker::decodeIfd0(ExifData& exifData, BasicIo& io, long start, long size,
+                                           const uint16_t* tags, size_t tagCount)
+    {
+        byte buf[8];
+        TiffHeader header;
+        if (size < 8 || io.readAt(start, buf, 8) != 8 || !header.read(buf, 8)) return invalidByteOrder;
+        const ByteOrder bo = header.byteOrder();
+
+        const uint32_t offset = header.offset();
+        if (offset > static_cast<uint32_t>(size) - 2 || io.readAt(start + offset, buf, 2) != 2) return bo;
+        const uint32_t count = getUShort(buf, bo);
+        const uint32_t dirSize = 12 * count;
+        if (dirSize > static_cast<uint32_t>(size) - offset - 2) return bo;
+        DataBuf dir(dirSize);
+        if (io.readAt(start + offset + 2, dir.pData_, dirSize) != static_cast<long>(dirSize)) return bo;
+
+        for (uint32_t n = 0; n < count; ++n) {
+            const byte* entry = dir.pData_ + 12 * n;
+            const uint16_t tag = getUShort(entry, bo);
+            if (std::find(tags, tags + tagCount, tag) == tags + tagCount) continue;
+            if (getULong(entry + 4, bo) != 1) continue;
+            const ExifKey key(tag, groupName(ifd0Id));
+            switch (getUShort(entry + 2, bo)) {
+            case unsignedShort: {
+                UShortValue value;
+                value.value_.push_back(getUShort(entry + 8, bo));
+                exifData.add(key, &value);
+                break;
+            }
+            case unsignedLong: {
+                ULongValue value;
+                value.value_.push_back(getULong(entry + 8, bo));
+                exifData.add(key, &value);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+        return bo;
+
+    } // TiffParserWorker::decodeIfd0
+
+    std::vector<uint32_t> TiffParserWorker::pageOffsets(const byte* pData, size_t size)
+    {
+        std::vector<uint32_t> offsets;
+        TiffHeader header;
+        if (pData == 0 || size < 8 || !header.read(pData, 8)) return offsets;
+        const ByteOrder bo = header.byteOrder();
+        std::set<uint32_t> seen;
+        uint32_t offset = header.offset();
+        while (offset != 0 && offset <= size - 2 && seen.insert(offset).second) {
+            const uint32_t count = getUShort(pData + offset, bo);
+            offsets.push_back(offset);
+            const size_t next = offset + 2 + 12 * static_cast<size_t>(count);
+            if (next > size - 4) break;
+            offset = getULong(pData + next, bo);
+        }
+        return offsets;
+
+    } // TiffParserWorker::pageOffsets
+
+    void TiffParserWorker::decodePage(ExifData& exifData, const byte* pData, size_t size, uint32_t offset)
+    {
+        TiffHeader header;
+        if (   pData == 0
+            || !header.read(pData, static_cast<uint32_t>(std::min<size_t>(size, 0xffffffff)))
+            || offset >= size) {
+            throw Error(kerNotAnImage, "TIFF");
+        }
+        // The composite is released in bulk with the arena, it must be declared first
+        TiffArena arena;
+        // Like the IFD0 of TiffCreator::create(Tag::root, ifdIdNotSet), but
+        // without the next pointer, which leads to the following page
+        const uint16_t tag = static_cast<uint16_t>(Tag::root & 0xffff);
+        TiffComponent::UniquePtr dir(new TiffDirectory(tag, ifd0Id, false));
+        dir->setStart(pData + offset);
+        TiffReader reader(pData, size, dir.get(), TiffRwState(header.byteOrder(), 0));
+        dir->accept(reader);
+        reader.postProcess();
+
+        IptcData iptcData;
+        XmpData xmpData;
+        TiffDecoder decoder(exifData, iptcData, xmpData, dir.get(), TiffMapping::findDecoder, pData, size);
+        dir->accept(decoder);
+
+    } // TiffParserWorker::decodePage
+
+    DeferredMakernote::DeferredMakernote(uint16_t tag, IfdId group, ByteOrder byteOrder,
+                                         const std::string& make, const std::string& model,
+                                         const byte* pData, uint32_t size, uint32_t offset, uint32_t mnSize)
+        : tag_(tag),
+          group_(group),
+          byteOrder_(byteOrder),
+          make_(make),
+          model_(model),
+          offset_(offset),
+          mnSize_(mnSize),
+          data_(pData, pData + size)
+    {
+    }
+
+    std::shared_ptr<const DeferredMakernote> DeferredMakernote::create(TiffComponent* pRoot,
+                                                                       const byte*    pData,
+                                                                       uint32_t       size,
+                                                                       ByteOrder      byteOrder)
+    {
+        assert(pRoot != 0);
+        // The makernote entries of the TIFF tree structure
+        static const std::pair<uint16_t, IfdId> mnEntries[] = {
+            std::make_pair(uint16_t(0x927c), exifId),
+            std::make_pair(uint16_t(0xc634), ifd0Id)
+        };
+        for (unsigned int i = 0; i < EXV_COUNTOF(mnEntries); ++i) {
+            TiffFinder finder(mnEntries[i].first, mnEntries[i].second);
+            pRoot->accept(finder);
+            const TiffEntryBase* mn = dynamic_cast<const TiffEntryBase*>(finder.result());
+            if (!mn || !mn->pData() || mn->pData() < pData + 8 || mn->size() == 0) continue;
+            const uint32_t offset = static_cast<uint32_t>(mn->pData() - pData);
+            if (offset > size || mn->size() > size - offset) continue;
+
+            std::string make, model;
+            TiffFinder makeFinder(0x010f, ifd0Id);
+            pRoot->accept(makeFinder);
+            const TiffEntryBase* te = dynamic_cast<const TiffEntryBase*>(makeFinder.result());
+            if (te && te->pValue()) make = te->pValue()->toString();
+            // Without a make, an eager decode does not create a makernote either
+            if (make.empty()) return nullptr;
+            TiffFinder modelFinder(0x0110, ifd0Id);
+            pRoot->accept(modelFinder);
+            te = dynamic_cast<const TiffEntryBase*>(modelFinder.result());
+            if (te && te->pValue()) model = te->pValue()->toString();
+
+            // Some makernote tags point past the makernote, keep all of the data
+            // unless it is large, e.g., a whole TIFF-based RAW image
+            const uint32_t keep = size <= maxCopySize ? size : offset + mn->size();
+            return std::shared_ptr<const DeferredMakernote>(
+                new DeferredMakernote(mnEntries[i].first, mnEntries[i].second, byteOrder,
+                                      make, model, pData, keep, offset, mn->size()));
+        }
+        return nullptr;
+
+    } // DeferredMakernote::create
+
+    bool DeferredMakernote::relocatable() const
+    {
+        if (mnSize_ == 0 || offset_ > data_.size() || mnSize_ > data_.size() - offset_) return false;
+        const byte* pMn = &data_[0] + offset_;
+        std::unique_ptr<TiffComponent> mn(TiffMnCreator::create(tag_, group_, make_, pMn, mnSize_, byteOrder_));
+        TiffIfdMakernote* ifdMn = dynamic_cast<TiffIfdMakernote*>(mn.get());
+        if (   !ifdMn
+            || !ifdMn->readHeader(pMn, mnSize_, byteOrder_)
+            || !ifdMn->relocatable()) return false;
+        ifdMn->setImageByteOrder(byteOrder_);
+        const ByteOrder bo = ifdMn->byteOrder();
+
+        // Values which move with the makernote must be in it. The base offset
+        // is relative to the makernote as it is not placed in the TIFF data.
+        const uint64_t base = ifdMn->baseOffset();
+        const uint32_t ifd = ifdMn->ifdOffset();
+        if (ifd > mnSize_ || mnSize_ - ifd < 2) return false;
+        const uint32_t count = getUShort(pMn + ifd, bo);
+        if ((mnSize_ - ifd - 2) / 12 < count) return false;
+        for (uint32_t i = 0; i < count; ++i) {
+            const byte* entry = pMn + ifd + 2 + 12 * i;
+            const uint64_t size =   static_cast<uint64_t>(TypeInfo::typeSize(static_cast<TypeId>(getUShort(entry + 2, bo))))
+                                  * getULong(entry + 4, bo);
+            if (size <= 4) continue;
+            if (base + getULong(entry + 8, bo) + size > mnSize_) return false;
+        }
+        return true;
+
+    } // DeferredMakernote::relocatable
+
+    void DeferredMakernote::decode(ExifData& exifData) const
+    {
+        Trace trace("makernote", "deferred");
+        // Append IFD0 with the make, the model and either the makernote or a
+        // pointer to an Exif IFD with the makernote, then point the header to it
+        Blob tiff(data_);
+        if (tiff.size() % 2) tiff.push_back(0);
+        const bool inIfd0 = group_ == ifd0Id;
+        const uint32_t ifd0 = static_cast<uint32_t>(tiff.size());
+        const uint32_t exifIfd = ifd0 + 2 + 3 * 12 + 4;
+        uint32_t strings = inIfd0 ? exifIfd : exifIfd + 2 + 12 + 4;
+
+        Blob ifds;
+        byte buf[12];
+        const auto addEntry = [&](uint16_t tag, uint16_t type, uint32_t count, const std::string* value,
+                                  uint32_t offset) {
+            us2Data(buf, tag, byteOrder_);
+            us2Data(buf + 2, type, byteOrder_);
+            ul2Data(buf + 4, count, byteOrder_);
+            std::memset(buf + 8, 0x0, 4);
+            if (value && count <= 4) {
+                std::memcpy(buf + 8, value->c_str(), count);
+            }
+            else if (value) {
+                ul2Data(buf + 8, strings, byteOrder_);
+                strings += count;
+            }
+            else {
+                ul2Data(buf + 8, offset, byteOrder_);
+            }
+            ifds.insert(ifds.end(), buf, buf + 12);
+        };
+        const auto addCount = [&](uint16_t count) {
+            us2Data(buf, count, byteOrder_);
+            ifds.insert(ifds.end(), buf, buf + 2);
+        };
+        const auto addNext = [&]() {
+            ifds.insert(ifds.end(), 4, 0);
+        };
+        addCount(3);
+        addEntry(0x010f, asciiString, static_cast<uint32_t>(make_.size() + 1), &make_, 0);
+        addEntry(0x0110, asciiString, static_cast<uint32_t>(model_.size() + 1), &model_, 0);
+        if (inIfd0) {
+            addEntry(tag_, unsignedByte, mnSize_, 0, offset_);
+            addNext();
+        }
+        else {
+            addEntry(0x8769, unsignedLong, 1, 0, exifIfd);
+            addNext();
+            addCount(1);
+            addEntry(tag_, undefined, mnSize_, 0, offset_);
+            addNext();
+        }
+        tiff.insert(tiff.end(), ifds.begin(), ifds.end());
+        if (make_.size() + 1 > 4) tiff.insert(tiff.end(), make_.c_str(), make_.c_str() + make_.size() + 1);
+        if (model_.size() + 1 > 4) tiff.insert(tiff.end(), model_.c_str(), model_.c_str() + model_.size() + 1);
+
+        // TiffHeader::write() always points to offset 8, set the offset here
+        TiffHeader header(byteOrder_);
+        DataBuf hdr = header.write();
+        ul2Data(hdr.pData_ + 4, ifd0, byteOrder_);
+        std::memcpy(&tiff[0], hdr.pData_, 8);
+
+        IptcData iptcData;
+        XmpData xmpData;
+        TiffParserWorker::decode(exifData, iptcData, xmpData, &tiff[0], static_cast<uint32_t>(tiff.size()),
+                                 Tag::root, TiffMapping::findDecoder);
+        // Keep the makernote, everything else was synthesized
+        for (ExifData::iterator i = exifData.begin(); i != exifData.end();) {
+            if (isMakerIfd(static_cast<IfdId>(i->ifdId()))) {
+                ++i;
+            }
+            else {
+                i = exifData.erase(i);
+            }
+        }
+
+    } // DeferredMakernote::decode
+
     TiffHeaderBase::TiffHeaderBase(uint16_t  tag,
                                    uint32_t  size,
                                    ByteOrder byteOrder,
-                                   uint32_t  offset)
+                                   uint64_t  offset)
         : tag_(tag),
           size_(size),
           byteOrder_(byteOrder),
@@ -1785,12 +2422,12 @@ namespace Exiv2 {
         byteOrder_ = byteOrder;
     }
 
-    uint32_t TiffHeaderBase::offset() const
+    uint64_t TiffHeaderBase::offset() const
     {
         return offset_;
     }
 
-    void TiffHeaderBase::setOffset(uint32_t offset)
+    void TiffHeaderBase::setOffset(uint64_t offset)
     {
         offset_ = offset;
     }
@@ -1805,6 +2442,11 @@ namespace Exiv2 {
         return tag_;
     }
 
+    bool TiffHeaderBase::isBigTiff() const
+    {
+        return false;
+    }
+
     bool TiffHeaderBase::isImageTag(      uint16_t       /*tag*/,
                                           IfdId          /*group*/,
                                     const PrimaryGroups* /*primaryGroups*/) const
@@ -1904,6 +2546,12 @@ namespace Exiv2 {
     {
     }
 
+    TiffHeader::TiffHeader(uint16_t tag, uint32_t size, ByteOrder byteOrder, uint64_t offset, bool hasImageTags)
+        : TiffHeaderBase(tag, size, byteOrder, offset),
+          hasImageTags_(hasImageTags)
+    {
+    }
+
     TiffHeader::~TiffHeader()
     {
     }
@@ -1946,6 +2594,54 @@ namespace Exiv2 {
         return isTiffImageTag(tag, group);
     } // TiffHeader::isImageTag
 
+    BigTiffHeader::BigTiffHeader(ByteOrder byteOrder, uint64_t offset)
+        : TiffHeader(43, 16, byteOrder, offset, true)
+    {
+    }
+
+    BigTiffHeader::~BigTiffHeader()
+    {
+    }
+
+    bool BigTiffHeader::read(const byte* pData, uint32_t size)
+    {
+        if (!pData || size < 16) return false;
+
+        ByteOrder byteOrder = invalidByteOrder;
+        if (pData[0] == 'I' && pData[0] == pData[1]) {
+            byteOrder = littleEndian;
+        }
+        else if (pData[0] == 'M' && pData[0] == pData[1]) {
+            byteOrder = bigEndian;
+        }
+        if (   byteOrder == invalidByteOrder
+            || getUShort(pData + 2, byteOrder) != tag()
+            || getUShort(pData + 4, byteOrder) != 8
+            || getUShort(pData + 6, byteOrder) != 0) return false;
+        setByteOrder(byteOrder);
+        setOffset(getULongLong(pData + 8, byteOrder));
+
+        return true;
+    } // BigTiffHeader::read
+
+    DataBuf BigTiffHeader::write() const
+    {
+        assert(byteOrder() != invalidByteOrder);
+        DataBuf buf(16);
+        buf.pData_[0] = byteOrder() == bigEndian ? 'M' : 'I';
+        buf.pData_[1] = buf.pData_[0];
+        us2Data(buf.pData_ + 2, tag(), byteOrder());
+        us2Data(buf.pData_ + 4, 8, byteOrder());
+        us2Data(buf.pData_ + 6, 0, byteOrder());
+        ull2Data(buf.pData_ + 8, 0x00000010, byteOrder());
+        return buf;
+    }
+
+    bool BigTiffHeader::isBigTiff() const
+    {
+        return true;
+    }
+
     void OffsetWriter::setOrigin(OffsetId id, uint32_t origin, ByteOrder byteOrder)
     {
         offsetList_[id] = OffsetData(origin, byteOrder);
@@ -1967,4 +2663,15 @@ namespace Exiv2 {
         }
     }
 
+    TempFileIo::TempFileIo(const std::string& path)
+        : FileIo(path)
+    {
+    }
+
+    TempFileIo::~TempFileIo()
+    {
+        close();
+        std::remove(path().c_str());
+    }
+
 }}                                       // namespace Internal, Exiv2
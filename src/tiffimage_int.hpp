@@ -37,7 +37,9 @@
 
 // + standard includes
 #include <map>
+#include <memory>
 #include <utility>
+#include <vector>
 
 // *****************************************************************************
 // namespace extensions
@@ -64,7 +66,7 @@ namespace Exiv2 {
         TiffHeaderBase(uint16_t  tag,
                        uint32_t  size,
                        ByteOrder byteOrder,
-                       uint32_t  offset);
+                       uint64_t  offset);
         //! Virtual destructor.
         virtual ~TiffHeaderBase() =0;
         //@}
@@ -85,7 +87,7 @@ namespace Exiv2 {
         //! Set the byte order.
         virtual void setByteOrder(ByteOrder byteOrder);
         //! Set the offset to the start of the root directory.
-        virtual void setOffset(uint32_t offset);
+        virtual void setOffset(uint64_t offset);
         //@}
 
         //! @name Accessors
@@ -107,11 +109,16 @@ namespace Exiv2 {
         //! Return the byte order (little or big endian).
         virtual ByteOrder byteOrder() const;
         //! Return the offset to the start of the root directory.
-        virtual uint32_t offset() const;
+        virtual uint64_t offset() const;
         //! Return the size (in bytes) of the image header.
         virtual uint32_t size() const;
         //! Return the tag value (magic number) which identifies the buffer as TIFF data.
         virtual uint16_t tag() const;
+        /*!
+          @brief Return \c true if the IFDs use the BigTIFF layout, with 8 byte
+                 counts and offsets. The default implementation returns \c false.
+         */
+        virtual bool isBigTiff() const;
         /*!
           @brief Return \c true if the %Exif \em tag from \em group is an image tag.
 
@@ -136,7 +143,7 @@ namespace Exiv2 {
         const uint16_t tag_;       //!< Tag to identify the buffer as TIFF data
         const uint32_t size_;      //!< Size of the header
         ByteOrder      byteOrder_; //!< Applicable byte order
-        uint32_t       offset_;    //!< Offset to the start of the root dir
+        uint64_t       offset_;    //!< Offset to the start of the root dir
 
     }; // class TiffHeaderBase
 
@@ -162,11 +169,46 @@ namespace Exiv2 {
         bool isImageTag(uint16_t tag, IfdId group, const PrimaryGroups* pPrimaryGroups) const override;
         //@}
 
+    protected:
+        //! Constructor for variants of the TIFF header with another \em tag and \em size.
+        TiffHeader(uint16_t  tag,
+                   uint32_t  size,
+                   ByteOrder byteOrder,
+                   uint64_t  offset,
+                   bool      hasImageTags);
+
     private:
         // DATA
         bool           hasImageTags_;   //!< Indicates if image tags are supported
     }; // class TiffHeader
 
+    /*!
+      @brief BigTIFF header structure. The header is followed by IFDs with
+             8 byte entry counts, 20 byte entries and 8 byte offsets.
+     */
+    class BigTiffHeader : public TiffHeader {
+    public:
+        //! @name Creators
+        //@{
+        //! Default constructor
+        BigTiffHeader(ByteOrder byteOrder =littleEndian,
+                      uint64_t  offset    =0x00000010);
+        //! Destructor
+        ~BigTiffHeader();
+        //@}
+
+        //! @name Manipulators
+        //@{
+        bool read(const byte* pData, uint32_t size) override;
+        //@}
+
+        //! @name Accessors
+        //@{
+        DataBuf write() const override;
+        bool isBigTiff() const override;
+        //@}
+    }; // class BigTiffHeader
+
     /*!
       @brief Data structure used to list image tags for TIFF and TIFF-like images.
      */
@@ -267,6 +309,19 @@ namespace Exiv2 {
                             uint32_t  root);
 
     private:
+        /*!
+          @brief Return the first entry of the TIFF group structure for
+                 \em extendedTag and \em group, 0 if there is none. Uses an
+                 index of the table, which is built on first use.
+        */
+        static const TiffGroupStruct* findGroupStruct(uint32_t extendedTag, IfdId group);
+        /*!
+          @brief Return the first entry of the TIFF tree structure for
+                 \em root and \em group, 0 if there is none. Uses an index of
+                 the table, which is built on first use.
+        */
+        static const TiffTreeStruct* findTreeStruct(uint32_t root, IfdId group);
+
         static const TiffTreeStruct  tiffTreeStruct_[];  //<! TIFF tree structure
         static const TiffGroupStruct tiffGroupStruct_[]; //<! TIFF group structure
 
@@ -305,7 +360,7 @@ namespace Exiv2 {
                   IptcData&          iptcData,
                   XmpData&           xmpData,
             const byte*              pData,
-                  uint32_t           size,
+                  size_t             size,
                   uint32_t           root,
                   FindDecoderFct     findDecoderFct,
                   TiffHeaderBase*    pHeader =0
@@ -319,19 +374,117 @@ namespace Exiv2 {
           3) else, create a new tree and write a new TIFF structure ("intrusive
              writing"). If there is a parsed tree, it is only used to access the
              image data in this case.
+
+          If \em append is true, \em pData, \em size is the complete image in
+          \em io and the image has a standard TIFF header, the new TIFF
+          structure is appended to \em io instead, referring to the image
+          data at its original offsets, and the header is updated to point to
+          it. The image data is not copied and the old structure is left
+          behind as unused space.
+
+          New TIFF structures always have 32 bit offsets, the metadata of
+          images with a BigTIFF header can only be updated in place.
+
+          If \em sizeLimit is not 0 and a new TIFF structure, including the
+          header, is larger, nothing is written to \em io. The size of the
+          IFDs is computed from the composite, a structure whose IFDs exceed
+          the limit is not serialized at all.
+
+          @throw Error if the metadata of a BigTIFF image does not fit in place.
          */
         static WriteMethod encode(
                   BasicIo&           io,
             const byte*              pData,
-                  uint32_t           size,
+                  size_t             size,
             const ExifData&          exifData,
             const IptcData&          iptcData,
             const XmpData&           xmpData,
                   uint32_t           root,
                   FindEncoderFct     findEncoderFct,
                   TiffHeaderBase*    pHeader,
-                  OffsetWriter*      pOffsetWriter
+                  OffsetWriter*      pOffsetWriter,
+                  bool               append =false,
+                  uint32_t           sizeLimit =0
+        );
+
+        /*!
+          @brief Prefetch the IFDs of the TIFF data in \em io and the tag
+                 data they point to, one level of directories at a time.
+
+          Each level is passed to BasicIo::prefetch() in one call, so a remote
+          IO source fetches it with concurrent range requests instead of one
+          round trip per directory. Offsets and sizes are checked against the
+          size of \em io. Image data is not prefetched, except for the data
+          of \em dataTag in the root directory.
+
+          @param io IO source with data in TIFF format, must be open.
+          @param pHeader Header of the TIFF variant in \em io, the standard
+                 TIFF header if 0.
+          @param dataTag Tag of the root directory whose data is prefetched
+                 regardless of its size, e.g., an embedded preview image which
+                 holds more metadata, 0 if there is none.
+         */
+        static void prefetch(BasicIo& io, TiffHeaderBase* pHeader =0, uint16_t dataTag =0);
+        /*!
+          @brief Decode the tags \em tags of IFD0 into \em exifData, without
+                 parsing the rest of the TIFF structure. Only tags with a
+                 single unsigned short or long value are decoded.
+
+          @param exifData Exif metadata container, the tags are added to group
+                          "Image".
+          @param io       IO source with the TIFF data, must be open. Its
+                          position is not changed.
+          @param start    Position of the TIFF header in \em io.
+          @param size     Length of the TIFF data.
+          @param tags     Tags to decode.
+          @param tagCount Number of entries in \em tags.
+          @return Byte order of the TIFF data, invalidByteOrder if the header
+                  is not valid.
+         */
+        static ByteOrder decodeIfd0(
+                  ExifData&          exifData,
+                  BasicIo&           io,
+                  long               start,
+                  long               size,
+            const uint16_t*          tags,
+                  size_t             tagCount
         );
+        /*!
+          @brief Return the offsets of the IFDs in the chain which starts with
+                 IFD0 of the TIFF data \em pData, \em size, i.e., of the pages
+                 of a multi-page image. Only the entry counts and next pointers
+                 are read. The chain ends at the first IFD which is out of
+                 bounds or was seen before.
+         */
+        static std::vector<uint32_t> pageOffsets(const byte* pData, size_t size);
+        /*!
+          @brief Decode the IFD at \em offset of the TIFF data \em pData,
+                 \em size and its sub-IFDs into \em exifData. The tags of the
+                 IFD are added to group "Image", as if it was IFD0, its next
+                 pointer is not followed.
+          @throw Error if the data does not have a valid TIFF header.
+         */
+        static void decodePage(ExifData& exifData, const byte* pData, size_t size, uint32_t offset);
+
+        /*!
+          @brief Create the IO instance to write a new TIFF structure, or
+                 another new image, for the image in \em io to.
+
+          New structures of large files are streamed to a temporary file next
+          to the image, which then replaces the image. This keeps the memory
+          use independent of the size of the image data which is copied.
+          Otherwise, and if the temporary file cannot be created, the new
+          structure is written to memory.
+
+          @param io   IO instance with the original image
+          @param size Size of the original image
+         */
+        static BasicIo::UniquePtr createTempIo(BasicIo& io, uint32_t size);
+        /*!
+          @brief Return true if \em filter accepts the metadata of at least
+                 one makernote group.
+         */
+        static bool acceptsMakernote(const DecodeFilter& filter);
 
     private:
         /*!
@@ -343,15 +496,37 @@ namespace Exiv2 {
           @param size      Length of the data buffer.
           @param root      Root tag of the TIFF tree.
           @param pHeader   Pointer to a TIFF header.
+          @param readMakernote If false, the contents of makernotes are not
+                           parsed.
+          @param filter    Optional decode filter, makernote and standard
+                           sub-IFDs of groups it rejects and data areas of
+                           entries it rejects are not read.
           @return          An auto pointer with the root element of the TIFF
                            composite structure. If \em pData is 0 or \em size
                            is 0, the return value is a 0 pointer.
          */
         static std::unique_ptr<TiffComponent> parse(
             const byte*              pData,
-                  uint32_t           size,
+                  size_t             size,
                   uint32_t           root,
-                  TiffHeaderBase*    pHeader
+                  TiffHeaderBase*    pHeader,
+                  bool               readMakernote =true,
+            const DecodeFilter*      filter =0
+        );
+        /*!
+          @brief Decode the composite \em pRoot with one decoder per independent
+                 sub-tree, see TiffSubtreeFinder, on as many threads as there
+                 are processors. The metadata of the sub-trees are then
+                 inserted where a sequential decoder would have added them.
+         */
+        static void decodeParallel(
+            ExifData&          exifData,
+            IptcData&          iptcData,
+            XmpData&           xmpData,
+            TiffComponent*     pRoot,
+            FindDecoderFct     findDecoderFct,
+            const byte*        pData,
+            size_t             size
         );
         /*!
           @brief Find primary groups in the source tree provided and populate
@@ -364,9 +539,87 @@ namespace Exiv2 {
             PrimaryGroups& primaryGroups,
             TiffComponent* pSourceDir
         );
+        /*!
+          @brief Append the TIFF structure in \em tiff to the image in \em io
+                 and overwrite the header of the image with \em header.
+
+          @param io     IO instance with the original image
+          @param size   Size of the original image
+          @param tiff   TIFF structure to append, without a header
+          @param header New TIFF header which points to the appended structure
+         */
+        static void appendTiff(
+                  BasicIo& io,
+                  uint32_t size,
+                  BasicIo& tiff,
+            const DataBuf& header
+        );
 
     }; // class TiffParserWorker
 
+    /*!
+      @brief Makernote which is decoded on first access instead of with the
+             rest of the Exif data, see ExifData::setLazyMakernote().
+
+      It keeps a copy of the TIFF data, or only the data up to the end of the
+      makernote if the TIFF data is larger than maxCopySize, together with the
+      camera make and model which select and configure the makernote. Decoding
+      rebuilds a minimal TIFF structure around these bytes so that offsets
+      into the TIFF data remain valid.
+     */
+    class DeferredMakernote {
+    public:
+        //! Largest TIFF data which is kept completely
+        static const uint32_t maxCopySize = 1024 * 1024;
+
+        /*!
+          @brief Capture the makernote of the TIFF composite \em pRoot, which
+                 was read from \em pData and \em size without parsing
+                 makernotes. Return 0 if there is no makernote.
+         */
+        static std::shared_ptr<const DeferredMakernote> create(TiffComponent* pRoot,
+                                                               const byte*    pData,
+                                                               uint32_t       size,
+                                                               ByteOrder      byteOrder);
+        /*!
+          @brief Decode the makernote into \em exifData. Only the metadata of
+                 the makernote groups is added.
+         */
+        void decode(ExifData& exifData) const;
+        /*!
+          @brief Return true if the makernote can be written back as it is
+                 at another offset: its offsets are relative to the makernote
+                 and the values of its IFD are within the makernote.
+         */
+        bool relocatable() const;
+        //! Tag of the binary makernote entry
+        uint16_t tag() const { return tag_; }
+        //! Group of the binary makernote entry
+        IfdId group() const { return group_; }
+        //! Return the heap memory held by the object, mostly the copy of the TIFF data
+        size_t memoryUsage() const
+        {
+            return sizeof(*this) + make_.capacity() + model_.capacity() + data_.capacity();
+        }
+
+    private:
+        //! Constructor, used by create()
+        DeferredMakernote(uint16_t tag, IfdId group, ByteOrder byteOrder,
+                          const std::string& make, const std::string& model,
+                          const byte* pData, uint32_t size, uint32_t offset, uint32_t mnSize);
+
+        // DATA
+        uint16_t    tag_;                       //!< Tag of the makernote entry
+        IfdId       group_;                     //!< Group of the makernote entry
+        ByteOrder   byteOrder_;                 //!< Byte order of the TIFF data
+        std::string make_;                      //!< Exif.Image.Make
+        std::string model_;                     //!< Exif.Image.Model
+        uint32_t    offset_;                    //!< Offset of the makernote in data_
+        uint32_t    mnSize_;                    //!< Size of the makernote
+        Blob        data_;                      //!< Copy of the TIFF data
+
+    }; // class DeferredMakernote
+
     /*!
       @brief Table of TIFF decoding and encoding functions and find functions.
              This class is separated from the metadata decoder and encoder
@@ -469,6 +722,22 @@ namespace Exiv2 {
 
     }; // class OffsetWriter
 
+    /*!
+      @brief Temporary file next to an image, to write a new version of the
+             image to. The file is removed when the object is destroyed, unless
+             it replaced the image with BasicIo::transfer() before.
+     */
+    class TempFileIo : public FileIo {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor, creates the file \em path
+        explicit TempFileIo(const std::string& path);
+        //! Destructor, removes the file if it still exists
+        ~TempFileIo() override;
+        //@}
+    }; // class TempFileIo
+
     // Todo: Move this class to metadatum_int.hpp or tags_int.hpp
     //! Unary predicate that matches an Exifdatum with a given IfdId.
     class FindExifdatum {
@@ -37,34 +37,18 @@
 #include "image.hpp"
 #include "jpgimage.hpp"
 #include "i18n.h"             // NLS support.
+#include "stats_int.hpp"
 
 // + standard includes
 #include <string>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <cassert>
 #include <limits>
 
 // *****************************************************************************
 namespace {
-    //! Unary predicate that matches an Exifdatum with a given group and index.
-    class FindExifdatum2 {
-    public:
-        //! Constructor, initializes the object with the group and index to look for.
-        FindExifdatum2(Exiv2::Internal::IfdId group, int idx)
-            : groupName_(Exiv2::Internal::groupName(group)), idx_(idx) {}
-        //! Returns true if group and index match.
-        bool operator()(const Exiv2::Exifdatum& md) const
-        {
-            return idx_ == md.idx() && 0 == strcmp(md.groupName().c_str(), groupName_);
-        }
-
-    private:
-        const char* groupName_;
-        int idx_;
-
-    }; // class FindExifdatum2
-
     Exiv2::ByteOrder stringToByteOrder(const std::string& val)
     {
         Exiv2::ByteOrder bo = Exiv2::invalidByteOrder;
@@ -91,18 +75,6 @@ namespace Exiv2 {
     {
     }
 
-    void TiffVisitor::setGo(GoEvent event, bool go)
-    {
-        assert(event >= 0 && static_cast<int>(event) < events_);
-        go_[event] = go;
-    }
-
-    bool TiffVisitor::go(GoEvent event) const
-    {
-        assert(event >= 0 && static_cast<int>(event) < events_);
-        return go_[event];
-    }
-
     void TiffVisitor::visitDirectoryNext(TiffDirectory* /*object*/)
     {
     }
@@ -189,6 +161,290 @@ namespace Exiv2 {
         findObject(object);
     }
 
+    namespace {
+        //! Current index of each thread
+        thread_local const TiffIndex* currentIndex = 0;
+
+        //! Make an index the current index for the lifetime of the object
+        class CurrentIndex {
+        public:
+            explicit CurrentIndex(const TiffIndex* index) : previous_(TiffIndex::setCurrent(index)) {}
+            ~CurrentIndex() { TiffIndex::setCurrent(previous_); }
+        private:
+            const TiffIndex* previous_;
+        };
+    }
+
+    TiffIndex::TiffIndex(TiffComponent* pRoot)
+        : pRoot_(pRoot), hasModel_(false)
+    {
+    }
+
+    void TiffIndex::add(TiffComponent* object)
+    {
+        components_.insert(std::make_pair(std::make_pair(object->tag(), object->group()), object));
+    }
+
+    TiffComponent* TiffIndex::find(uint16_t tag, IfdId group) const
+    {
+        Components::const_iterator pos = components_.find(std::make_pair(tag, group));
+        return pos == components_.end() ? 0 : pos->second;
+    }
+
+    const std::string& TiffIndex::model() const
+    {
+        if (!hasModel_) {
+            TiffEntryBase* te = dynamic_cast<TiffEntryBase*>(find(0x0110, ifd0Id));
+            model_ = te && te->pValue() && te->pValue()->count() > 0 ? te->pValue()->toString() : std::string();
+            hasModel_ = true;
+        }
+        return model_;
+    }
+
+    TiffComponent* TiffIndex::findIn(TiffComponent* pRoot, uint16_t tag, IfdId group)
+    {
+        if (currentIndex != 0 && currentIndex->pRoot_ == pRoot) {
+            return currentIndex->find(tag, group);
+        }
+        TiffFinder finder(tag, group);
+        pRoot->accept(finder);
+        return finder.result();
+    }
+
+    std::string TiffIndex::modelOf(TiffComponent* pRoot)
+    {
+        if (currentIndex != 0 && currentIndex->pRoot_ == pRoot) {
+            return currentIndex->model();
+        }
+        TiffEntryBase* te = dynamic_cast<TiffEntryBase*>(findIn(pRoot, 0x0110, ifd0Id)); // Exif.Image.Model
+        if (!te || !te->pValue() || te->pValue()->count() == 0) return std::string();
+        return te->pValue()->toString();
+    }
+
+    const TiffIndex* TiffIndex::setCurrent(const TiffIndex* index)
+    {
+        const TiffIndex* previous = currentIndex;
+        currentIndex = index;
+        return previous;
+    }
+
+    TiffBackup::TiffBackup(const byte* pData, size_t size, bool bigTiff)
+        : pData_(pData), size_(size), bigTiff_(bigTiff), mnLayout_(false)
+    {
+    }
+
+    TiffBackup::~TiffBackup()
+    {
+    }
+
+    void TiffBackup::save(const byte* pData, size_t size)
+    {
+        if (pData == 0 || pData < pData_ || pData >= pData_ + size_) return;
+        size = std::min(size, static_cast<size_t>(pData_ + size_ - pData));
+        saved_.push_back(std::make_pair(const_cast<byte*>(pData), std::vector<byte>(pData, pData + size)));
+    }
+
+    void TiffBackup::saveEntry(TiffEntryBase* object)
+    {
+        save(object->pData(), object->size());
+    }
+
+    void TiffBackup::restore()
+    {
+        for (size_t i = 0; i < saved_.size(); ++i) {
+            std::memcpy(saved_[i].first, &saved_[i].second[0], saved_[i].second.size());
+        }
+    }
+
+    void TiffBackup::visitEntry(TiffEntry* object)
+    {
+        saveEntry(object);
+    }
+
+    void TiffBackup::visitDataEntry(TiffDataEntry* object)
+    {
+        saveEntry(object);
+        save(object->pDataArea_, object->sizeDataArea_);
+    }
+
+    void TiffBackup::visitImageEntry(TiffImageEntry* object)
+    {
+        saveEntry(object);
+    }
+
+    void TiffBackup::visitSizeEntry(TiffSizeEntry* object)
+    {
+        saveEntry(object);
+    }
+
+    void TiffBackup::visitDirectory(TiffDirectory* object)
+    {
+        // Entry count, entries and the pointer to the next IFD
+        const bool bigTiff = bigTiff_ && !mnLayout_;
+        save(object->start(), bigTiff ? 8 + 20 * object->count() + 8 : 2 + 12 * object->count() + 4);
+    }
+
+    void TiffBackup::visitSubIfd(TiffSubIfd* object)
+    {
+        saveEntry(object);
+    }
+
+    void TiffBackup::visitMnEntry(TiffMnEntry* object)
+    {
+        saveEntry(object);
+    }
+
+    void TiffBackup::visitIfdMakernote(TiffIfdMakernote* /*object*/)
+    {
+        mnLayout_ = true;
+    }
+
+    void TiffBackup::visitIfdMakernoteEnd(TiffIfdMakernote* /*object*/)
+    {
+        mnLayout_ = false;
+    }
+
+    void TiffBackup::visitBinaryArray(TiffBinaryArray* object)
+    {
+        saveEntry(object);
+    }
+
+    void TiffBackup::visitBinaryElement(TiffBinaryElement* object)
+    {
+        saveEntry(object);
+    }
+
+    TiffExtent::TiffExtent(const byte* pData, size_t size, bool bigTiff)
+        : pData_(pData), size_(size), bigTiff_(bigTiff), mnLayout_(false), end_(pData)
+    {
+    }
+
+    TiffExtent::~TiffExtent()
+    {
+    }
+
+    void TiffExtent::extend(const byte* pData, size_t size)
+    {
+        if (pData == 0 || pData < pData_ || pData >= pData_ + size_) return;
+        size = std::min(size, static_cast<size_t>(pData_ + size_ - pData));
+        end_ = std::max(end_, pData + size);
+    }
+
+    void TiffExtent::visitEntry(TiffEntry* object)
+    {
+        extend(object->pData(), object->size());
+    }
+
+    void TiffExtent::visitDataEntry(TiffDataEntry* object)
+    {
+        extend(object->pData(), object->size());
+        extend(object->pDataArea_, object->sizeDataArea_);
+    }
+
+    void TiffExtent::visitImageEntry(TiffImageEntry* object)
+    {
+        extend(object->pData(), object->size());
+        for (TiffImageEntry::Strips::const_iterator i = object->strips_.begin(); i != object->strips_.end(); ++i) {
+            extend(i->first, i->second);
+        }
+    }
+
+    void TiffExtent::visitSizeEntry(TiffSizeEntry* object)
+    {
+        extend(object->pData(), object->size());
+    }
+
+    void TiffExtent::visitDirectory(TiffDirectory* object)
+    {
+        // Entry count, entries and the pointer to the next IFD
+        const bool bigTiff = bigTiff_ && !mnLayout_;
+        extend(object->start(), bigTiff ? 8 + 20 * object->count() + 8 : 2 + 12 * object->count() + 4);
+    }
+
+    void TiffExtent::visitSubIfd(TiffSubIfd* object)
+    {
+        extend(object->pData(), object->size());
+    }
+
+    void TiffExtent::visitMnEntry(TiffMnEntry* object)
+    {
+        extend(object->pData(), object->size());
+    }
+
+    void TiffExtent::visitIfdMakernote(TiffIfdMakernote* /*object*/)
+    {
+        mnLayout_ = true;
+    }
+
+    void TiffExtent::visitIfdMakernoteEnd(TiffIfdMakernote* /*object*/)
+    {
+        mnLayout_ = false;
+    }
+
+    void TiffExtent::visitBinaryArray(TiffBinaryArray* object)
+    {
+        extend(object->pData(), object->size());
+    }
+
+    void TiffExtent::visitBinaryElement(TiffBinaryElement* object)
+    {
+        extend(object->pData(), object->size());
+    }
+
+    TiffSubtreeFinder::TiffSubtreeFinder(std::vector<TiffComponent*>& subtrees)
+        : subtrees_(subtrees), root_(true), makernote_(false)
+    {
+    }
+
+    TiffSubtreeFinder::~TiffSubtreeFinder()
+    {
+    }
+
+    void TiffSubtreeFinder::visitEntry(TiffEntry* /*object*/)
+    {
+    }
+
+    void TiffSubtreeFinder::visitDataEntry(TiffDataEntry* /*object*/)
+    {
+    }
+
+    void TiffSubtreeFinder::visitImageEntry(TiffImageEntry* /*object*/)
+    {
+    }
+
+    void TiffSubtreeFinder::visitSizeEntry(TiffSizeEntry* /*object*/)
+    {
+    }
+
+    void TiffSubtreeFinder::visitDirectory(TiffDirectory* object)
+    {
+        if (!root_ && !makernote_) subtrees_.push_back(object);
+        root_ = false;
+        makernote_ = false;
+    }
+
+    void TiffSubtreeFinder::visitSubIfd(TiffSubIfd* /*object*/)
+    {
+    }
+
+    void TiffSubtreeFinder::visitMnEntry(TiffMnEntry* /*object*/)
+    {
+    }
+
+    void TiffSubtreeFinder::visitIfdMakernote(TiffIfdMakernote* object)
+    {
+        subtrees_.push_back(object);
+        makernote_ = true;
+    }
+
+    void TiffSubtreeFinder::visitBinaryArray(TiffBinaryArray* /*object*/)
+    {
+    }
+
+    void TiffSubtreeFinder::visitBinaryElement(TiffBinaryElement* /*object*/)
+    {
+    }
+
     TiffCopier::TiffCopier(      TiffComponent*  pRoot,
                                  uint32_t        root,
                            const TiffHeaderBase* pHeader,
@@ -279,14 +535,21 @@ namespace Exiv2 {
         IptcData&            iptcData,
         XmpData&             xmpData,
         TiffComponent* const pRoot,
-        FindDecoderFct       findDecoderFct
+        FindDecoderFct       findDecoderFct,
+        const byte*          pData,
+        size_t               size
     )
         : exifData_(exifData),
           iptcData_(iptcData),
           xmpData_(xmpData),
           pRoot_(pRoot),
           findDecoderFct_(findDecoderFct),
-          decodedIptc_(false)
+          decodedIptc_(false),
+          subtrees_(0),
+          ownSubtree_(0),
+          skipDepth_(0),
+          pData_(pData),
+          size_(size)
     {
         assert(pRoot != 0);
 
@@ -327,9 +590,14 @@ namespace Exiv2 {
         decodeTiffEntry(object);
     }
 
-    void TiffDecoder::visitDirectory(TiffDirectory* /*object*/)
+    void TiffDecoder::visitDirectory(TiffDirectory* object)
     {
-        // Nothing to do
+        beginSkip(object);
+    }
+
+    void TiffDecoder::visitDirectoryEnd(TiffDirectory* object)
+    {
+        endSkip(object);
     }
 
     void TiffDecoder::visitSubIfd(TiffSubIfd* object)
@@ -347,6 +615,8 @@ namespace Exiv2 {
     {
         assert(object != 0);
 
+        if (beginSkip(object) || skipDepth_ > 0) return;
+        if (!exifData_.decodeFilter().acceptsGroup("Exif", "MakerNote")) return;
         exifData_["Exif.MakerNote.Offset"] = object->mnOffset();
         switch (object->byteOrder()) {
         case littleEndian:
@@ -361,6 +631,33 @@ namespace Exiv2 {
         }
     }
 
+    void TiffDecoder::visitIfdMakernoteEnd(TiffIfdMakernote* object)
+    {
+        endSkip(object);
+    }
+
+    void TiffDecoder::skipSubtrees(const Subtrees* subtrees, const TiffComponent* own)
+    {
+        subtrees_ = subtrees;
+        ownSubtree_ = own;
+    }
+
+    bool TiffDecoder::beginSkip(const TiffComponent* object)
+    {
+        if (!subtrees_ || object == ownSubtree_ || subtrees_->count(object) == 0) return false;
+        // Only the outermost skipped sub-tree is inserted here, it contains the others
+        if (skipDepth_++ == 0) {
+            subtreePositions_.push_back(std::make_pair(object, exifData_.count()));
+        }
+        return true;
+    }
+
+    void TiffDecoder::endSkip(const TiffComponent* object)
+    {
+        if (!subtrees_ || object == ownSubtree_ || subtrees_->count(object) == 0) return;
+        --skipDepth_;
+    }
+
     void TiffDecoder::getObjData(byte const*& pData,
                                  long& size,
                                  uint16_t tag,
@@ -382,37 +679,26 @@ namespace Exiv2 {
         }
     }
 
-    void TiffDecoder::decodeXmp(const TiffEntryBase* object)
+    void TiffDecoder::decodeXmp(TiffEntryBase* object)
     {
         // add Exif tag anyway
         decodeStdTiffEntry(object);
+        // A lazy decode keeps the raw tag, see ExifData::setLazyEmbedded()
+        if (exifData_.lazyEmbedded()) return;
 
         byte const* pData = 0;
         long size = 0;
         getObjData(pData, size, 0x02bc, ifd0Id, object);
         if (pData) {
-            std::string xmpPacket;
-            xmpPacket.assign(reinterpret_cast<const char*>(pData), size);
-            std::string::size_type idx = xmpPacket.find_first_of('<');
-            if (idx != std::string::npos && idx > 0) {
-#ifndef SUPPRESS_WARNINGS
-                EXV_WARNING << "Removing " << static_cast<unsigned long>(idx)
-                            << " characters from the beginning of the XMP packet\n";
-#endif
-                xmpPacket = xmpPacket.substr(idx);
-            }
-            if (XmpParser::decode(xmpData_, xmpPacket)) {
-#ifndef SUPPRESS_WARNINGS
-                EXV_WARNING << "Failed to decode XMP metadata.\n";
-#endif
-            }
+            decodeXmpTag(xmpData_, pData, size);
         }
     } // TiffDecoder::decodeXmp
 
-    void TiffDecoder::decodeIptc(const TiffEntryBase* object)
+    void TiffDecoder::decodeIptc(TiffEntryBase* object)
     {
         // add Exif tag anyway
         decodeStdTiffEntry(object);
+        if (exifData_.lazyEmbedded()) return;
 
         // All tags are read at this point, so the first time we come here,
         // find the relevant IPTC tag and decode IPTC if found
@@ -420,53 +706,21 @@ namespace Exiv2 {
             return;
         }
         decodedIptc_ = true;
-        // 1st choice: IPTCNAA
-        byte const* pData = 0;
-        long size = 0;
-        getObjData(pData, size, 0x83bb, ifd0Id, object);
-        if (pData) {
-            if (0 == IptcParser::decode(iptcData_, pData, size)) {
-                return;
-            }
-#ifndef SUPPRESS_WARNINGS
-            else {
-                EXV_WARNING << "Failed to decode IPTC block found in "
-                            << "Directory Image, entry 0x83bb\n";
-            }
-#endif
-        }
-
-        // 2nd choice if no IPTCNAA record found or failed to decode it:
-        // ImageResources
-        pData = 0;
-        size = 0;
-        getObjData(pData, size, 0x8649, ifd0Id, object);
-        if (pData) {
-            byte const* record = 0;
-            uint32_t sizeHdr = 0;
-            uint32_t sizeData = 0;
-            if (0 != Photoshop::locateIptcIrb(pData, size,
-                                              &record, &sizeHdr, &sizeData)) {
-                return;
-            }
-            if (0 == IptcParser::decode(iptcData_, record + sizeHdr, sizeData)) {
-                return;
-            }
-#ifndef SUPPRESS_WARNINGS
-            else {
-                EXV_WARNING << "Failed to decode IPTC block found in "
-                            << "Directory Image, entry 0x8649\n";
-            }
-#endif
-        }
+        byte const* pIptc = 0;
+        long sizeIptc = 0;
+        getObjData(pIptc, sizeIptc, 0x83bb, ifd0Id, object);
+        byte const* pIrb = 0;
+        long sizeIrb = 0;
+        getObjData(pIrb, sizeIrb, 0x8649, ifd0Id, object);
+        decodeIptcTags(iptcData_, pIptc, sizeIptc, pIrb, sizeIrb);
     } // TiffMetadataDecoder::decodeIptc
 
-    void TiffDecoder::decodeTiffEntry(const TiffEntryBase* object)
+    void TiffDecoder::decodeTiffEntry(TiffEntryBase* object)
     {
         assert(object != 0);
 
-        // Don't decode the entry if value is not set
-        if (!object->pValue()) return;
+        // Don't decode the entry if value is not set or it is decoded by another decoder
+        if (!object->pValue() || skipDepth_ > 0) return;
 
         const DecoderFct decoderFct = findDecoderFct_(make_,
                                                       object->tag(),
@@ -477,15 +731,51 @@ namespace Exiv2 {
         }
     } // TiffDecoder::decodeTiffEntry
 
-    void TiffDecoder::decodeStdTiffEntry(const TiffEntryBase* object)
+    void TiffDecoder::decodeStdTiffEntry(TiffEntryBase* object)
     {
         assert(object != 0);
-        ExifKey key(object->tag(), groupName(object->group()));
+        // Skip filtered groups before the key is looked up
+        const DecodeFilter& filter = exifData_.decodeFilter();
+        const char* group = groupName(object->group());
+        if (!filter.empty() && !filter.acceptsGroup("Exif", group)) return;
+        ExifKey key(object->tag(), group);
+        if (!filter.empty() && !filter.accepts(key)) return;
         key.setIdx(object->idx());
-        exifData_.add(key, object->pValue());
+        // The composite is discarded after decoding, hand the value over
+        Value::UniquePtr value = object->releaseValue();
+        if (pData_ == 0 || value.get() == 0) {
+            exifData_.add(key, std::move(value));
+            return;
+        }
+        const ExifOrigin o = origin(object, *value);
+        Exifdatum md(key, std::move(value));
+        md.setOrigin(o);
+        exifData_.add(std::move(md));
 
     } // TiffDecoder::decodeTiffEntry
 
+    ExifOrigin TiffDecoder::origin(const TiffEntryBase* object, const Value& value) const
+    {
+        ExifOrigin origin;
+        const byte* pLast = pData_ + size_;
+        const byte* pValue = object->pData();
+        if (pValue == 0 && dynamic_cast<const TiffBinaryElement*>(object) != 0) {
+            // Elements of binary arrays have no entry, their value is at the start
+            pValue = object->start();
+        }
+        else if (object->start() >= pData_ && object->start() < pLast) {
+            origin.entryOffset_ = object->start() - pData_;
+        }
+        // Values which were copied, e.g., decrypted arrays, have no origin
+        const uint32_t size = static_cast<uint32_t>(value.size());
+        if (pValue >= pData_ && pValue < pLast && size > 0 && size <= static_cast<size_t>(pLast - pValue)) {
+            origin.valueOffset_ = pValue - pData_;
+            origin.valueSize_ = size;
+        }
+        return origin;
+
+    } // TiffDecoder::origin
+
     void TiffDecoder::visitBinaryArray(TiffBinaryArray* object)
     {
         if (object->cfg() == 0 || !object->decoded()) {
@@ -519,7 +809,10 @@ namespace Exiv2 {
           pSourceTree_(0),
           findEncoderFct_(findEncoderFct),
           dirty_(false),
-          writeMethod_(wmNonIntrusive)
+          writeMethod_(wmNonIntrusive),
+          pFree_(0),
+          pFreeEnd_(0),
+          indexed_(false)
     {
         assert(pRoot != 0);
         assert(pPrimaryGroups != 0);
@@ -527,6 +820,7 @@ namespace Exiv2 {
 
         byteOrder_ = pHeader->byteOrder();
         origByteOrder_ = byteOrder_;
+        bigTiff_ = pHeader->isBigTiff();
 
         encodeIptc();
         encodeXmp();
@@ -584,8 +878,7 @@ namespace Exiv2 {
                 buf = rawIptc; // Note: This resets rawIptc
             }
             value->read(buf.pData_, buf.size_, byteOrder_);
-            Exifdatum iptcDatum(iptcNaaKey, value.get());
-            exifData_.add(iptcDatum);
+            exifData_.add(iptcNaaKey, std::move(value));
             pos = exifData_.findKey(irbKey); // needed after add()
         }
         // Also update IPTC IRB in Exif.Image.ImageResources if it exists,
@@ -598,8 +891,7 @@ namespace Exiv2 {
             if (irbBuf.size_ != 0) {
                 Value::UniquePtr value = Value::create(unsignedByte);
                 value->read(irbBuf.pData_, irbBuf.size_, invalidByteOrder);
-                Exifdatum iptcDatum(irbKey, value.get());
-                exifData_.add(iptcDatum);
+                exifData_.add(irbKey, std::move(value));
             }
         }
     } // TiffEncoder::encodeIptc
@@ -630,8 +922,7 @@ namespace Exiv2 {
             value->read(reinterpret_cast<const byte*>(&xmpPacket[0]),
                         static_cast<long>(xmpPacket.size()),
                         invalidByteOrder);
-            Exifdatum xmpDatum(xmpKey, value.get());
-            exifData_.add(xmpDatum);
+            exifData_.add(xmpKey, std::move(value));
         }
 #endif
     } // TiffEncoder::encodeXmp
@@ -642,6 +933,12 @@ namespace Exiv2 {
         setGo(geTraverse, !flag);
     }
 
+    void TiffEncoder::setFreeSpace(byte* pBegin, byte* pEnd)
+    {
+        pFree_ = pBegin;
+        pFreeEnd_ = pEnd;
+    }
+
     bool TiffEncoder::dirty() const
     {
         if (dirty_ || exifData_.count() > 0) return true;
@@ -678,11 +975,43 @@ namespace Exiv2 {
         // Update type and count in IFD entries, in case they changed
         assert(object != 0);
 
-        byte* p = object->start() + 2;
+        byte* p = object->start() + (bigTiff_ ? 8 : 2);
         for (TiffDirectory::Components::iterator i = object->components_.begin();
              i != object->components_.end(); ++i) {
             p += updateDirEntry(p, byteOrder(), *i);
         }
+
+        // An erased thumbnail IFD, which is the last IFD, is unlinked in place
+        TiffDirectory* next = dynamic_cast<TiffDirectory*>(object->pNext_);
+        if (   writeMethod() != wmNonIntrusive || dirty_ || bigTiff_ || next == 0
+            || next->group() != ifd1Id || next->pNext_ != 0) return;
+        for (ExifData::const_iterator i = exifData_.begin(); i != exifData_.end(); ++i) {
+            if (i->ifdId() == ifd1Id) return;
+        }
+        // Clear the IFD and the data of its entries, the thumbnail must not remain readable
+        std::vector<std::pair<byte*, size_t> > areas;
+        areas.push_back(std::make_pair(next->start(), size_t(2 + 12 * next->count() + 4)));
+        for (TiffDirectory::Components::const_iterator i = next->components_.begin();
+             i != next->components_.end(); ++i) {
+            TiffEntryBase* entry = dynamic_cast<TiffEntryBase*>(*i);
+            if (entry == 0 || dynamic_cast<TiffSubIfd*>(*i) != 0) return;
+            if (entry->size() > 4) areas.push_back(std::make_pair(const_cast<byte*>(entry->pData()), size_t(entry->size())));
+            TiffDataEntry* dataEntry = dynamic_cast<TiffDataEntry*>(*i);
+            if (dataEntry) areas.push_back(std::make_pair(dataEntry->pDataArea_, size_t(dataEntry->sizeDataArea_)));
+            TiffImageEntry* imageEntry = dynamic_cast<TiffImageEntry*>(*i);
+            if (imageEntry) {
+                for (TiffImageEntry::Strips::const_iterator s = imageEntry->strips_.begin();
+                     s != imageEntry->strips_.end(); ++s) {
+                    areas.push_back(std::make_pair(const_cast<byte*>(s->first), size_t(s->second)));
+                }
+            }
+        }
+        for (size_t i = 0; i < areas.size(); ++i) {
+            if (areas[i].first) std::memset(areas[i].first, 0x0, areas[i].second);
+        }
+        ul2Data(p, 0, byteOrder());
+        object->pNext_ = 0;
+        delete next;
     }
 
     uint32_t TiffEncoder::updateDirEntry(byte* buf,
@@ -693,19 +1022,27 @@ namespace Exiv2 {
         assert(pTiffComponent);
         TiffEntryBase* pTiffEntry = dynamic_cast<TiffEntryBase*>(pTiffComponent);
         assert(pTiffEntry);
+        // BigTIFF entries have 64 bit count and offset fields
+        const uint32_t fieldSize = bigTiff_ ? 8 : 4;
         us2Data(buf + 2, pTiffEntry->tiffType(), byteOrder);
-        ul2Data(buf + 4, pTiffEntry->count(),    byteOrder);
+        if (bigTiff_) {
+            ull2Data(buf + 4, pTiffEntry->count(), byteOrder);
+        }
+        else {
+            ul2Data(buf + 4, pTiffEntry->count(), byteOrder);
+        }
+        byte* const field = buf + 4 + fieldSize;
         // Move data to offset field, if it fits and is not yet there.
-        if (pTiffEntry->size() <= 4 && buf + 8 != pTiffEntry->pData()) {
+        if (pTiffEntry->size() <= fieldSize && field != pTiffEntry->pData()) {
 #ifdef DEBUG
             std::cerr << "Copying data for tag " << pTiffEntry->tag()
                       << " to offset area.\n";
 #endif
-            memset(buf + 8, 0x0, 4);
-            memcpy(buf + 8, pTiffEntry->pData(), pTiffEntry->size());
+            memset(field, 0x0, fieldSize);
+            memcpy(field, pTiffEntry->pData(), pTiffEntry->size());
             memset(const_cast<byte*>(pTiffEntry->pData()), 0x0, pTiffEntry->size());
         }
-        return 12;
+        return 4 + 2 * fieldSize;
     }
 
     void TiffEncoder::visitSubIfd(TiffSubIfd* object)
@@ -723,7 +1060,7 @@ namespace Exiv2 {
             // The makernote is made up of decoded tags, delete binary tag
             ExifKey key(object->tag(), groupName(object->group()));
             ExifData::iterator pos = exifData_.findKey(key);
-            if (pos != exifData_.end()) exifData_.erase(pos);
+            if (pos != exifData_.end()) eraseDatum(pos);
         }
     }
 
@@ -740,7 +1077,7 @@ namespace Exiv2 {
                 setDirty();
             }
             if (del_)
-                exifData_.erase(pos);
+                eraseDatum(pos);
         }
         if (del_) {
             // Remove remaining synthesized tags
@@ -750,18 +1087,21 @@ namespace Exiv2 {
             for (unsigned int i = 0; i < EXV_COUNTOF(synthesizedTags); ++i) {
                 pos = exifData_.findKey(ExifKey(synthesizedTags[i]));
                 if (pos != exifData_.end())
-                    exifData_.erase(pos);
+                    eraseDatum(pos);
             }
         }
         // Modify encoder for Makernote peculiarities, byte order
         byteOrder_ = object->byteOrder();
+        // Makernote IFDs use the regular TIFF layout, also in BigTIFF images
+        bigTiff_ = false;
 
     } // TiffEncoder::visitIfdMakernote
 
     void TiffEncoder::visitIfdMakernoteEnd(TiffIfdMakernote* /*object*/)
     {
-        // Reset byte order back to that from the c'tor
+        // Reset byte order and layout back to that from the c'tor
         byteOrder_ = origByteOrder_;
+        bigTiff_ = pHeader_->isBigTiff();
 
     } // TiffEncoder::visitIfdMakernoteEnd
 
@@ -824,25 +1164,15 @@ namespace Exiv2 {
         const Exifdatum* ed = datum;
         if (ed == 0) {
             // Non-intrusive writing: find matching tag
-            ExifKey key(object->tag(), groupName(object->group()));
-            pos = exifData_.findKey(key);
+            pos = findDatum(object);
             if (pos != exifData_.end()) {
                 ed = &(*pos);
-                if (object->idx() != pos->idx()) {
-                    // Try to find exact match (in case of duplicate tags)
-                    ExifData::iterator pos2 =
-                        std::find_if(exifData_.begin(), exifData_.end(),
-                                     FindExifdatum2(object->group(), object->idx()));
-                    if (pos2 != exifData_.end() && pos2->key() == key.key()) {
-                        ed = &(*pos2);
-                        pos = pos2; // make sure we delete the correct tag below
-                    }
-                }
             }
             else {
                 setDirty();
 #ifdef DEBUG
-                std::cerr << "DELETING          " << key << ", idx = " << object->idx() << "\n";
+                std::cerr << "DELETING          " << ExifKey(object->tag(), groupName(object->group()))
+                          << ", idx = " << object->idx() << "\n";
 #endif
             }
         }
@@ -866,13 +1196,42 @@ namespace Exiv2 {
             }
         }
         if (del_ && pos != exifData_.end()) {
-            exifData_.erase(pos);
+            eraseDatum(pos);
         }
 #ifdef DEBUG
         std::cerr << "\n";
 #endif
     } // TiffEncoder::encodeTiffComponent
 
+    ExifData::iterator TiffEncoder::findDatum(const TiffEntryBase* object)
+    {
+        if (!indexed_) {
+            for (ExifData::iterator i = exifData_.begin(); i != exifData_.end(); ++i) {
+                datumIndex_[static_cast<uint32_t>(i->ifdId()) << 16 | i->tag()].push_back(i);
+            }
+            indexed_ = true;
+        }
+        auto entry = datumIndex_.find(static_cast<uint32_t>(object->group()) << 16 | object->tag());
+        if (entry == datumIndex_.end() || entry->second.empty()) return exifData_.end();
+        // Prefer the exact match in case of duplicate tags
+        for (auto&& pos : entry->second) {
+            if (pos->idx() == object->idx()) return pos;
+        }
+        return entry->second.front();
+    }
+
+    void TiffEncoder::eraseDatum(ExifData::iterator pos)
+    {
+        if (indexed_) {
+            auto entry = datumIndex_.find(static_cast<uint32_t>(pos->ifdId()) << 16 | pos->tag());
+            if (entry != datumIndex_.end()) {
+                std::vector<ExifData::iterator>& v = entry->second;
+                v.erase(std::remove(v.begin(), v.end(), pos), v.end());
+            }
+        }
+        exifData_.erase(pos);
+    }
+
     void TiffEncoder::encodeBinaryArray(TiffBinaryArray* object, const Exifdatum* datum)
     {
         encodeOffsetEntry(object, datum);
@@ -890,13 +1249,29 @@ namespace Exiv2 {
         if (!dirty_ && writeMethod() == wmNonIntrusive) {
             assert(object);
             assert(object->pValue());
-            if (  object->sizeDataArea_
-                < static_cast<uint32_t>(object->pValue()->sizeDataArea())) {
+            const uint32_t sizeDataArea = object->pValue()->sizeDataArea();
+            if (object->sizeDataArea_ < sizeDataArea) {
 #ifdef DEBUG
                 ExifKey key(object->tag(), groupName(object->group()));
                 std::cerr << "DATAAREA GREW     " << key << "\n";
 #endif
-                setDirty();
+                byte* pDataArea = growDataArea(object, sizeDataArea);
+                if (pDataArea == 0) {
+                    setDirty();
+                    return;
+                }
+                // Move the data area and point the entry to it
+                if (pDataArea != object->pDataArea_) {
+                    std::memset(object->pDataArea_, 0x0, object->sizeDataArea_);
+                    const uint32_t offset = getULong(object->pData(), byteOrder());
+                    ul2Data(const_cast<byte*>(object->pData()),
+                            offset + static_cast<uint32_t>(pDataArea - object->pDataArea_), byteOrder());
+                }
+                DataBuf buf = object->pValue()->dataArea();
+                memcpy(pDataArea, buf.pData_, buf.size_);
+                object->pDataArea_ = pDataArea;
+                object->sizeDataArea_ = sizeDataArea;
+                pFree_ = pDataArea + sizeDataArea;
             }
             else {
                 // Write the new dataarea, fill with 0x0
@@ -915,6 +1290,24 @@ namespace Exiv2 {
 
     } // TiffEncoder::encodeDataEntry
 
+    byte* TiffEncoder::growDataArea(const TiffDataEntry* object, uint32_t size) const
+    {
+        // Only single 32 bit offsets can be moved
+        if (   pFree_ == 0 || bigTiff_ || object->pDataArea_ == 0 || object->count() != 1
+            || object->size() != 4 || object->pData() == 0) return 0;
+        byte* pDataArea = object->pDataArea_;
+        if (pDataArea + object->sizeDataArea_ != pFree_) {
+            // Keep the offset word aligned
+            pDataArea = pFree_ + ((pFree_ - object->pDataArea_) & 1);
+        }
+        if (pDataArea > pFreeEnd_ || static_cast<size_t>(pFreeEnd_ - pDataArea) < size) return 0;
+        // The free space must not contain any data unknown to the parser
+        const byte* p = std::max(pDataArea, pFree_);
+        const byte* pEnd = pDataArea + size;
+        if (std::find_if(p, pEnd, [](byte b) { return b != 0; }) != pEnd) return 0;
+        return pDataArea;
+    }
+
     void TiffEncoder::encodeTiffEntry(TiffEntry* object, const Exifdatum* datum)
     {
         encodeTiffEntryBase(object, datum);
@@ -1132,17 +1525,48 @@ namespace Exiv2 {
 
     } // TiffEncoder::add
 
+    namespace {
+        /*!
+          @brief Return true if \em filter accepts any group of the tree of
+                 the standard sub-IFD \em group. Sub-IFDs of other groups are
+                 always accepted.
+         */
+        bool acceptsSubIfd(const DecodeFilter& filter, IfdId group)
+        {
+            if (filter.empty() || filter.acceptsGroup("Exif", groupName(group))) return true;
+            switch (group) {
+            case exifId:
+                return    filter.acceptsGroup("Exif", groupName(iopId))
+                       || TiffParserWorker::acceptsMakernote(filter);
+            case gpsId:
+            case iopId:
+            case subImage1Id: case subImage2Id: case subImage3Id:
+            case subImage4Id: case subImage5Id: case subImage6Id:
+            case subImage7Id: case subImage8Id: case subImage9Id:
+                return false;
+            default:
+                return true;
+            }
+        }
+    }
+
     TiffReader::TiffReader(const byte*    pData,
-                           uint32_t       size,
+                           size_t         size,
                            TiffComponent* pRoot,
-                           TiffRwState    state)
+                           TiffRwState    state,
+                           bool           readMakernote,
+                           const DecodeFilter* filter)
         : pData_(pData),
           size_(size),
           pLast_(pData + size),
           pRoot_(pRoot),
           origState_(state),
           mnState_(state),
-          postProc_(false)
+          postProc_(false),
+          readMakernote_(readMakernote),
+          filter_(filter),
+          index_(pRoot),
+          depth_(0)
     {
         pState_ = &origState_;
         assert(pData_);
@@ -1185,16 +1609,31 @@ namespace Exiv2 {
         return pState_->baseOffset();
     }
 
+    bool TiffReader::bigTiff() const
+    {
+        assert(pState_);
+        return pState_->bigTiff();
+    }
+
+    uint32_t TiffReader::sizeData() const
+    {
+        // Data areas and strips are only supported in the first 4 GB
+        return static_cast<uint32_t>(std::min<size_t>(size_, std::numeric_limits<uint32_t>::max()));
+    }
+
     void TiffReader::readDataEntryBase(TiffDataEntryBase* object)
     {
         assert(object != 0);
 
         readTiffEntry(object);
+        // Don't copy data areas, e.g. the thumbnail, which the decoder drops anyway
+        if (   filter_ && !filter_->empty()
+            && !filter_->accepts(ExifKey(object->tag(), groupName(object->group())))) return;
         TiffFinder finder(object->szTag(), object->szGroup());
         pRoot_->accept(finder);
         TiffEntryBase* te = dynamic_cast<TiffEntryBase*>(finder.result());
         if (te && te->pValue()) {
-            object->setStrips(te->pValue(), pData_, size_, baseOffset());
+            object->setStrips(te->pValue(), pData_, sizeData(), baseOffset());
         }
     }
 
@@ -1222,7 +1661,7 @@ namespace Exiv2 {
         pRoot_->accept(finder);
         TiffDataEntryBase* te = dynamic_cast<TiffDataEntryBase*>(finder.result());
         if (te && te->pValue()) {
-            te->setStrips(object->pValue(), pData_, size_, baseOffset());
+            te->setStrips(object->pValue(), pData_, sizeData(), baseOffset());
         }
     }
 
@@ -1249,6 +1688,8 @@ namespace Exiv2 {
     {
         setMnState(); // All components to be post-processed must be from the Makernote
         postProc_ = true;
+        // All entries are read, selector and crypt functions look them up in the index
+        CurrentIndex current(&index_);
         for (PostList::const_iterator pos = postList_.begin(); pos != postList_.end(); ++pos) {
             (*pos)->accept(*this);
         }
@@ -1263,17 +1704,26 @@ namespace Exiv2 {
         const byte* p = object->start();
         assert(p >= pData_);
 
+        // Counted before any return, visitDirectoryEnd() decrements it
+        ParseBudget::checkDepth(++depth_);
+        ParseBudget::checkDeadline();
+
         if (circularReference(object->start(), object->group())) return;
 
-        if (p + 2 > pLast_) {
+        // BigTIFF IFDs have 8 byte entry counts and offsets and 20 byte entries
+        const uint32_t countSize = bigTiff() ? 8 : 2;
+        const uint32_t entrySize = bigTiff() ? 20 : 12;
+        const uint32_t offsetSize = bigTiff() ? 8 : 4;
+        if (countSize > static_cast<size_t>(pLast_ - p)) {
 #ifndef SUPPRESS_WARNINGS
             EXV_ERROR << "Directory " << groupName(object->group())
                       << ": IFD exceeds data buffer, cannot read entry count.\n";
 #endif
             return;
         }
-        const uint16_t n = getUShort(p, byteOrder());
-        p += 2;
+        const uint64_t n = bigTiff() ? getULongLong(p, byteOrder()) : getUShort(p, byteOrder());
+        p += countSize;
+        ParseBudget::checkIfdEntries(n);
         // Sanity check with an "unreasonably" large number
         if (n > 256) {
 #ifndef SUPPRESS_WARNINGS
@@ -1283,7 +1733,7 @@ namespace Exiv2 {
             return;
         }
         for (uint16_t i = 0; i < n; ++i) {
-            if (p + 12 > pLast_) {
+            if (entrySize > static_cast<size_t>(pLast_ - p)) {
 #ifndef SUPPRESS_WARNINGS
                 EXV_ERROR << "Directory " << groupName(object->group())
                           << ": IFD entry " << i
@@ -1299,11 +1749,11 @@ namespace Exiv2 {
             } else {
                EXV_WARNING << "Unable to handle tag " << tag << ".\n";
             }
-            p += 12;
+            p += entrySize;
         }
 
         if (object->hasNext()) {
-            if (p + 4 > pLast_) {
+            if (offsetSize > static_cast<size_t>(pLast_ - p)) {
 #ifndef SUPPRESS_WARNINGS
                 EXV_ERROR << "Directory " << groupName(object->group())
                           << ": IFD exceeds data buffer, cannot read next pointer.\n";
@@ -1311,7 +1761,7 @@ namespace Exiv2 {
                 return;
             }
             TiffComponent::UniquePtr tc;
-            uint32_t next = getLong(p, byteOrder());
+            const uint64_t next = bigTiff() ? getULongLong(p, byteOrder()) : getULong(p, byteOrder());
             if (next) {
                 tc = TiffCreator::create(Tag::next, object->group());
 #ifndef SUPPRESS_WARNINGS
@@ -1322,7 +1772,7 @@ namespace Exiv2 {
 #endif
             }
             if (tc.get()) {
-                if (baseOffset() + next > size_) {
+                if (baseOffset() > size_ || next > size_ - baseOffset()) {
 #ifndef SUPPRESS_WARNINGS
                     EXV_ERROR << "Directory " << groupName(object->group())
                               << ": Next pointer is out of bounds; ignored.\n";
@@ -1336,20 +1786,32 @@ namespace Exiv2 {
 
     } // TiffReader::visitDirectory
 
+    void TiffReader::visitDirectoryEnd(TiffDirectory* /*object*/)
+    {
+        --depth_;
+    }
+
     void TiffReader::visitSubIfd(TiffSubIfd* object)
     {
         assert(object != 0);
 
         readTiffEntry(object);
+        const bool isLong8 =    object->tiffType() == ttUnsignedLong8 || object->tiffType() == ttSignedLong8
+                             || object->tiffType() == ttTiffIfd8;
         if (   (object->tiffType() == ttUnsignedLong || object->tiffType() == ttSignedLong
-                || object->tiffType() == ttTiffIfd)
+                || object->tiffType() == ttTiffIfd || isLong8)
             && object->count() >= 1) {
+            // Rejected makernote and standard sub-IFDs are not read, the pointer entry remains
+            if (   filter_ && !filter_->empty() && isMakerIfd(object->newGroup_)
+                && !filter_->acceptsGroup("Exif", groupName(object->newGroup_))) return;
+            if (filter_ && !acceptsSubIfd(*filter_, object->newGroup_)) return;
             // Todo: Fix hack
             uint32_t maxi = 9;
             if (object->group() == ifd1Id) maxi = 1;
             for (uint32_t i = 0; i < object->count(); ++i) {
-                uint32_t offset = getLong(object->pData() + 4*i, byteOrder());
-                if (   baseOffset() + offset > size_ ) {
+                const uint64_t offset = isLong8 ? getULongLong(object->pData() + 8*i, byteOrder())
+                                                : getULong(object->pData() + 4*i, byteOrder());
+                if (baseOffset() > size_ || offset > size_ - baseOffset()) {
 #ifndef SUPPRESS_WARNINGS
                     EXV_ERROR << "Directory " << groupName(object->group())
                               << ", entry 0x" << std::setw(4)
@@ -1391,6 +1853,7 @@ namespace Exiv2 {
         assert(object != 0);
 
         readTiffEntry(object);
+        if (!readMakernote_) return;
         // Find camera make
         TiffFinder finder(0x010f, ifd0Id);
         pRoot_->accept(finder);
@@ -1451,11 +1914,15 @@ namespace Exiv2 {
     void TiffReader::readTiffEntry(TiffEntryBase* object)
     {
         assert(object != 0);
+        index_.add(object);
 
         byte* p = object->start();
         assert(p >= pData_);
 
-        if (p + 12 > pLast_) {
+        // BigTIFF entries have an 8 byte count and an 8 byte value or offset field
+        const uint32_t entrySize = bigTiff() ? 20 : 12;
+        const uint32_t fieldSize = bigTiff() ? 8 : 4;
+        if (entrySize > static_cast<size_t>(pLast_ - p)) {
 #ifndef SUPPRESS_WARNINGS
             EXV_ERROR << "Entry in directory " << groupName(object->group())
                       << "requests access to memory beyond the data buffer. "
@@ -1468,7 +1935,13 @@ namespace Exiv2 {
         TiffType tiffType = getUShort(p, byteOrder());
         TypeId typeId = toTypeId(tiffType, object->tag(), object->group());
         long typeSize = TypeInfo::typeSize(typeId);
-        if (0 == typeSize) {
+        // LONG8, SLONG8 and IFD8 are only defined for BigTIFF IFDs
+        if (   !bigTiff()
+            && (typeId == unsignedLongLong || typeId == signedLongLong || typeId == tiffIfd8)) {
+            typeSize = 0;
+        }
+        const bool unknownType = 0 == typeSize;
+        if (unknownType) {
 #ifndef SUPPRESS_WARNINGS
             EXV_WARNING << "Directory " << groupName(object->group())
                         << ", entry 0x" << std::setw(4)
@@ -1479,7 +1952,7 @@ namespace Exiv2 {
             typeSize = 1;
         }
         p += 2;
-        uint32_t count = getULong(p, byteOrder());
+        const uint64_t count = bigTiff() ? getULongLong(p, byteOrder()) : getULong(p, byteOrder());
         if (count >= 0x10000000) {
 #ifndef SUPPRESS_WARNINGS
             EXV_ERROR << "Directory " << groupName(object->group())
@@ -1491,18 +1964,22 @@ namespace Exiv2 {
 #endif
             return;
         }
-        p += 4;
+        p += fieldSize;
         uint32_t isize= 0; // size of Exif.Sony1.PreviewImage
 
-        if (count > std::numeric_limits<uint32_t>::max() / typeSize) {
+        if (count > std::numeric_limits<uint32_t>::max() / static_cast<uint64_t>(typeSize)) {
             throw Error(kerArithmeticOverflow);
         }
-        uint32_t size = typeSize * count;
-        uint32_t offset = getLong(p, byteOrder());
+        uint32_t size = static_cast<uint32_t>(typeSize * count);
+        const uint64_t offset = bigTiff() ? getULongLong(p, byteOrder()) : getULong(p, byteOrder());
         byte* pData = p;
-        if (   size > 4
-            && (   baseOffset() + offset >= size_
-                || static_cast<int32_t>(baseOffset()) + offset <= 0)) {
+        // Regular TIFF offsets wrap around in 32 bits, such offsets are rejected below
+        const uint64_t dataOffset = bigTiff() ? baseOffset() + offset
+                                              : static_cast<uint32_t>(baseOffset() + offset);
+        if (   size > fieldSize
+            && (   (bigTiff() && (baseOffset() >= size_ || offset >= size_ - baseOffset()))
+                || dataOffset >= size_
+                || dataOffset == 0)) {
                 // #1143
                 if ( object->tag() == 0x2001 && std::string(groupName(object->group())) == "Sony1" ) {
                     isize=size;
@@ -1519,7 +1996,7 @@ namespace Exiv2 {
                 }
                 size = 0;
         }
-        if (size > 4) {
+        if (size > fieldSize) {
             // setting pData to pData_ + baseOffset() + offset can result in pData pointing to invalid memory,
             // as offset can be arbitrarily large
             if ((static_cast<uintptr_t>(baseOffset()) > std::numeric_limits<uintptr_t>::max() - static_cast<uintptr_t>(offset))
@@ -1551,23 +2028,29 @@ namespace Exiv2 {
                 size = 0;
             }
         }
-        Value::UniquePtr v = Value::create(typeId);
-        enforce(v.get() != nullptr, kerCorruptedMetadata);
-        if ( !isize ) {
+        ParseBudget::chargeAllocation(isize ? isize : size);
+        Value::UniquePtr v;
+        if (unknownType) {
+            // Keep the bytes of an entry with an unknown type, as Value::create does
+            v = Value::UniquePtr(new DataValue(typeId));
             v->read(pData, size, byteOrder());
+        } else if ( !isize ) {
+            v = Value::create(typeId, pData, size, byteOrder());
         } else {
             // #1143 Write a "hollow" buffer for the preview image
             //       Sadly: we don't know the exact location of the image in the source (it's near offset)
             //       And neither TiffReader nor TiffEntryBase have access to the BasicIo object being processed
             byte* buffer = (byte*) ::malloc(isize);
             ::memset(buffer,0,isize);
-            v->read(buffer,isize, byteOrder());
+            v = Value::create(typeId, buffer, isize, byteOrder());
             ::free(buffer);
         }
+        enforce(v.get() != nullptr, kerCorruptedMetadata);
 
         object->setValue(std::move(v));
         object->setData(pData, size);
-        object->setOffset(offset);
+        // Offsets beyond 4 GB are not needed after reading, they are only rewritten intrusively
+        object->setOffset(static_cast<int32_t>(offset));
         object->setIdx(nextIdx(object->group()));
 
     } // TiffReader::readTiffEntry
@@ -1586,9 +2069,7 @@ namespace Exiv2 {
         }
 
         // Check duplicates
-        TiffFinder finder(object->tag(), object->group());
-        pRoot_->accept(finder);
-        TiffEntryBase* te = dynamic_cast<TiffEntryBase*>(finder.result());
+        TiffEntryBase* te = dynamic_cast<TiffEntryBase*>(index_.find(object->tag(), object->group()));
         if (te && te->idx() != object->idx()) {
 #ifndef SUPPRESS_WARNINGS
             EXV_WARNING << "Not decoding duplicate binary array tag 0x"
@@ -1618,18 +2099,20 @@ namespace Exiv2 {
         const ArrayDef* defsEnd = defs + object->defSize();
         const ArrayDef* def = &cfg->elDefaultDef_;
         ArrayDef gap = *def;
+        // The definitions are sorted by idx and idx only grows, so the next
+        // definition is found by moving forward, not by searching them all
+        const ArrayDef* next = defs;
 
         for (uint32_t idx = 0; idx < object->TiffEntryBase::doSize(); ) {
             if (defs) {
-                def = std::find(defs, defsEnd, idx);
+                while (next != defsEnd && next->idx_ < idx) ++next;
+                def = next != defsEnd && next->idx_ == idx ? next : defsEnd;
                 if (def == defsEnd) {
                     if (cfg->concat_) {
                         // Determine gap-size
-                        const ArrayDef* xdef = defs;
-                        for (; xdef != defsEnd && xdef->idx_ <= idx; ++xdef) {}
                         uint32_t gapSize = 0;
-                        if (xdef != defsEnd && xdef->idx_ > idx) {
-                            gapSize = xdef->idx_ - idx;
+                        if (next != defsEnd) {
+                            gapSize = next->idx_ - idx;
                         }
                         else {
                             gapSize = object->TiffEntryBase::doSize() - idx;
@@ -1660,9 +2143,8 @@ namespace Exiv2 {
         ByteOrder bo = object->elByteOrder();
         if (bo == invalidByteOrder) bo = byteOrder();
         TypeId typeId = toTypeId(object->elDef()->tiffType_, object->tag(), object->group());
-        Value::UniquePtr v = Value::create(typeId);
+        Value::UniquePtr v = Value::create(typeId, pData, size, bo);
         enforce(v.get() != nullptr, kerCorruptedMetadata);
-        v->read(pData, size, bo);
 
         object->setValue(std::move(v));
         object->setOffset(0);
@@ -1670,4 +2152,65 @@ namespace Exiv2 {
 
     } // TiffReader::visitBinaryElement
 
+    // *************************************************************************
+    // free functions
+
+    void decodeXmpTag(XmpData& xmpData, const byte* pData, long size)
+    {
+        // The packet is decoded from the data of the tag, without a copy
+        const byte* begin = std::find(pData, pData + size, '<');
+        if (begin != pData && begin != pData + size) {
+#ifndef SUPPRESS_WARNINGS
+            EXV_WARNING << "Removing " << static_cast<unsigned long>(begin - pData)
+                        << " characters from the beginning of the XMP packet\n";
+#endif
+            size -= static_cast<long>(begin - pData);
+            pData = begin;
+        }
+        if (XmpParser::decode(xmpData, pData, size)) {
+#ifndef SUPPRESS_WARNINGS
+            EXV_WARNING << "Failed to decode XMP metadata.\n";
+#endif
+        }
+    }
+
+    void decodeIptcTags(IptcData& iptcData,
+                        const byte* pIptc, long sizeIptc,
+                        const byte* pIrb, long sizeIrb)
+    {
+        // 1st choice: IPTCNAA
+        if (pIptc) {
+            if (0 == IptcParser::decode(iptcData, pIptc, sizeIptc)) {
+                return;
+            }
+#ifndef SUPPRESS_WARNINGS
+            else {
+                EXV_WARNING << "Failed to decode IPTC block found in "
+                            << "Directory Image, entry 0x83bb\n";
+            }
+#endif
+        }
+
+        // 2nd choice if no IPTCNAA record found or failed to decode it:
+        // ImageResources
+        if (pIrb) {
+            byte const* record = 0;
+            uint32_t sizeHdr = 0;
+            uint32_t sizeData = 0;
+            if (0 != Photoshop::locateIptcIrb(pIrb, sizeIrb,
+                                              &record, &sizeHdr, &sizeData)) {
+                return;
+            }
+            if (0 == IptcParser::decode(iptcData, record + sizeHdr, sizeData)) {
+                return;
+            }
+#ifndef SUPPRESS_WARNINGS
+            else {
+                EXV_WARNING << "Failed to decode IPTC block found in "
+                            << "Directory Image, entry 0x8649\n";
+            }
+#endif
+        }
+    }
+
 }}                                      // namespace Internal, Exiv2
@@ -107,7 +107,11 @@ namespace Exiv2 {
           of flags, one for each defined \em event, so different signals can be
           used independent of each other.
          */
-        void setGo(GoEvent event, bool go);
+        void setGo(GoEvent event, bool go)
+        {
+            assert(event >= 0 && static_cast<int>(event) < events_);
+            go_[event] = go;
+        }
         //! Operation to perform for a TIFF entry
         virtual void visitEntry(TiffEntry* object) =0;
         //! Operation to perform for a TIFF data entry
@@ -150,7 +154,11 @@ namespace Exiv2 {
         //! @name Accessors
         //@{
         //! Check if stop flag for \em event is clear, return true if it's clear.
-        bool go(GoEvent event) const;
+        bool go(GoEvent event) const
+        {
+            assert(event >= 0 && static_cast<int>(event) < events_);
+            return go_[event];
+        }
         //@}
 
     }; // class TiffVisitor
@@ -216,6 +224,190 @@ namespace Exiv2 {
         TiffComponent* tiffComponent_;
     }; // class TiffFinder
 
+    /*!
+      @brief Index of the components of a composite by tag and group.
+
+      TiffReader adds each entry to its index as it reads it and makes the
+      index current while it reads the deferred components. The selector
+      and crypt functions of binary arrays then look up the entries they
+      need, e.g. the shutter count and serial number of Nikon images, with
+      findIn() rather than searching the whole composite for each array.
+     */
+    class TiffIndex {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor, taking the root element of the composite
+        explicit TiffIndex(TiffComponent* pRoot);
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Add \em object, unless a component with the same tag and group was added before
+        void add(TiffComponent* object);
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the first component added with \em tag and \em group or 0
+        TiffComponent* find(uint16_t tag, IfdId group) const;
+        //! Return the camera model, Exif.Image.Model, or an empty string
+        const std::string& model() const;
+        //@}
+
+        /*!
+          @brief Return the first component with \em tag and \em group in the
+                 composite with root element \em pRoot, or 0. Uses the current
+                 index of the thread if it belongs to \em pRoot and searches
+                 the composite with a TiffFinder otherwise.
+         */
+        static TiffComponent* findIn(TiffComponent* pRoot, uint16_t tag, IfdId group);
+        //! Return the camera model of the composite with root element \em pRoot, see findIn()
+        static std::string modelOf(TiffComponent* pRoot);
+        /*!
+          @brief Make \em index the current index of the thread.
+          @return The index which was current before
+         */
+        static const TiffIndex* setCurrent(const TiffIndex* index);
+
+    private:
+        typedef std::map<std::pair<uint16_t, IfdId>, TiffComponent*> Components;
+
+        // DATA
+        TiffComponent* const pRoot_;          //!< Root element of the composite
+        Components           components_;     //!< Components by tag and group
+        mutable bool         hasModel_;       //!< True once model_ is set
+        mutable std::string  model_;          //!< Cached camera model
+    }; // class TiffIndex
+
+    /*!
+      @brief Save the IFDs and the data of all entries of a composite, to be
+             able to undo changes which non-intrusive writing made to the
+             binary image.
+     */
+    class TiffBackup : public TiffVisitor {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor
+
+          @param pData   Pointer to the binary image the composite was read from.
+          @param size    Size of the binary image.
+          @param bigTiff True if the IFDs of the image use the BigTIFF layout.
+         */
+        TiffBackup(const byte* pData, size_t size, bool bigTiff);
+        //! Virtual destructor
+        ~TiffBackup() override;
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Save the data of a TIFF entry
+        void visitEntry(TiffEntry* object) override;
+        //! Save the data and the data area of a TIFF data entry
+        void visitDataEntry(TiffDataEntry* object) override;
+        //! Save the data of a TIFF image entry
+        void visitImageEntry(TiffImageEntry* object) override;
+        //! Save the data of a TIFF size entry
+        void visitSizeEntry(TiffSizeEntry* object) override;
+        //! Save the entries of a TIFF directory
+        void visitDirectory(TiffDirectory* object) override;
+        //! Save the data of a TIFF sub-IFD
+        void visitSubIfd(TiffSubIfd* object) override;
+        //! Save the data of a TIFF makernote
+        void visitMnEntry(TiffMnEntry* object) override;
+        //! Switch to the regular IFD layout for an IFD makernote
+        void visitIfdMakernote(TiffIfdMakernote* object) override;
+        //! Reset the IFD layout after an IFD makernote
+        void visitIfdMakernoteEnd(TiffIfdMakernote* object) override;
+        //! Save the data of a binary array
+        void visitBinaryArray(TiffBinaryArray* object) override;
+        //! Save the data of an element of a binary array
+        void visitBinaryElement(TiffBinaryElement* object) override;
+
+        //! Write the saved data back to the binary image
+        void restore();
+        //@}
+
+    private:
+        //! Save \em size bytes at \em pData, as far as they are within the image
+        void save(const byte* pData, size_t size);
+        //! Save the data of a TIFF entry
+        void saveEntry(TiffEntryBase* object);
+
+        const byte* pData_;   //!< Pointer to the binary image
+        const size_t size_;   //!< Size of the binary image
+        const bool bigTiff_;  //!< True if the image uses the BigTIFF layout
+        bool mnLayout_;       //!< True in IFD makernotes, which use the regular layout
+        std::vector<std::pair<byte*, std::vector<byte> > > saved_; //!< The saved data
+    }; // class TiffBackup
+
+    /*!
+      @brief Find the end of the IFDs and the data of all entries of a
+             composite within the binary image it was read from. Bytes past
+             it are not referenced by the composite, unless the image has data
+             which is unknown to the parser.
+     */
+    class TiffExtent : public TiffVisitor {
+    public:
+        //! @name Creators
+        //@{
+        /*!
+          @brief Constructor
+
+          @param pData   Pointer to the binary image the composite was read from.
+          @param size    Size of the binary image.
+          @param bigTiff True if the IFDs of the image use the BigTIFF layout.
+         */
+        TiffExtent(const byte* pData, size_t size, bool bigTiff);
+        //! Virtual destructor
+        ~TiffExtent() override;
+        //@}
+
+        //! @name Manipulators
+        //@{
+        //! Extend to the data of a TIFF entry
+        void visitEntry(TiffEntry* object) override;
+        //! Extend to the data and the data area of a TIFF data entry
+        void visitDataEntry(TiffDataEntry* object) override;
+        //! Extend to the data and the strips of a TIFF image entry
+        void visitImageEntry(TiffImageEntry* object) override;
+        //! Extend to the data of a TIFF size entry
+        void visitSizeEntry(TiffSizeEntry* object) override;
+        //! Extend to the entries of a TIFF directory
+        void visitDirectory(TiffDirectory* object) override;
+        //! Extend to the data of a TIFF sub-IFD
+        void visitSubIfd(TiffSubIfd* object) override;
+        //! Extend to the data of a TIFF makernote
+        void visitMnEntry(TiffMnEntry* object) override;
+        //! Switch to the regular IFD layout for an IFD makernote
+        void visitIfdMakernote(TiffIfdMakernote* object) override;
+        //! Reset the IFD layout after an IFD makernote
+        void visitIfdMakernoteEnd(TiffIfdMakernote* object) override;
+        //! Extend to the data of a binary array
+        void visitBinaryArray(TiffBinaryArray* object) override;
+        //! Extend to the data of an element of a binary array
+        void visitBinaryElement(TiffBinaryElement* object) override;
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return a pointer past the last byte of the image which the composite references
+        const byte* end() const { return end_; }
+        //@}
+
+    private:
+        //! Extend to \em size bytes at \em pData, as far as they are within the image
+        void extend(const byte* pData, size_t size);
+
+        const byte* pData_;   //!< Pointer to the binary image
+        const size_t size_;   //!< Size of the binary image
+        const bool bigTiff_;  //!< True if the image uses the BigTIFF layout
+        bool mnLayout_;       //!< True in IFD makernotes, which use the regular layout
+        const byte* end_;     //!< Pointer past the last referenced byte
+    }; // class TiffExtent
+
     /*!
       @brief Copy all image tags from the source tree (the tree that is traversed) to a
              target tree, which is empty except for the root element provided in the
@@ -283,19 +475,28 @@ namespace Exiv2 {
      */
     class TiffDecoder : public TiffVisitor {
     public:
+        //! Sub-trees of the composite which are decoded by separate decoders
+        typedef std::set<const TiffComponent*> Subtrees;
+        //! Skipped sub-trees and the number of metadata decoded before each, in the order of the traversal
+        typedef std::vector<std::pair<const TiffComponent*, long> > SubtreePositions;
+
         //! @name Creators
         //@{
         /*!
           @brief Constructor, taking metadata containers to add the metadata to,
                  the root element of the composite to decode and a FindDecoderFct
-                 function to get the decoder function for each tag.
+                 function to get the decoder function for each tag. The origin
+                 of the metadata is recorded relative to \em pData, the start
+                 of the TIFF data of \em size bytes, if provided.
          */
         TiffDecoder(
             ExifData&            exifData,
             IptcData&            iptcData,
             XmpData&             xmpData,
             TiffComponent* const pRoot,
-            FindDecoderFct       findDecoderFct
+            FindDecoderFct       findDecoderFct,
+            const byte*          pData =0,
+            size_t               size =0
         );
         //! Virtual destructor
         ~TiffDecoder() override;
@@ -313,30 +514,53 @@ namespace Exiv2 {
         void visitSizeEntry(TiffSizeEntry* object) override;
         //! Decode a TIFF directory
         void visitDirectory(TiffDirectory* object) override;
+        //! End of a TIFF directory
+        void visitDirectoryEnd(TiffDirectory* object) override;
         //! Decode a TIFF sub-IFD
         void visitSubIfd(TiffSubIfd* object) override;
         //! Decode a TIFF makernote
         void visitMnEntry(TiffMnEntry* object) override;
         //! Decode an IFD makernote
         void visitIfdMakernote(TiffIfdMakernote* object) override;
+        //! End of an IFD makernote
+        void visitIfdMakernoteEnd(TiffIfdMakernote* object) override;
         //! Decode a binary array
         void visitBinaryArray(TiffBinaryArray* object) override;
         //! Decode an element of a binary array
         void visitBinaryElement(TiffBinaryElement* object) override;
 
+        /*!
+          @brief Skip the sub-trees in \em subtrees other than \em own, which
+                 are decoded by other decoders, and record where their
+                 metadata belong, see subtreePositions().
+         */
+        void skipSubtrees(const Subtrees* subtrees, const TiffComponent* own);
+
         //! Entry function, determines how to decode each tag
-        void decodeTiffEntry(const TiffEntryBase* object);
+        void decodeTiffEntry(TiffEntryBase* object);
         //! Decode a standard TIFF entry
-        void decodeStdTiffEntry(const TiffEntryBase* object);
+        void decodeStdTiffEntry(TiffEntryBase* object);
         //! Decode IPTC data from an IPTCNAA tag or Photoshop ImageResources
-        void decodeIptc(const TiffEntryBase* object);
+        void decodeIptc(TiffEntryBase* object);
         //! Decode XMP packet from an XMLPacket tag
-        void decodeXmp(const TiffEntryBase* object);
+        void decodeXmp(TiffEntryBase* object);
+        //@}
+
+        //! @name Accessors
+        //@{
+        //! Return the positions of the sub-trees which were skipped
+        const SubtreePositions& subtreePositions() const { return subtreePositions_; }
         //@}
 
     private:
         //! @name Manipulators
         //@{
+        //! Start skipping the sub-tree \em object if it is decoded by another decoder
+        bool beginSkip(const TiffComponent* object);
+        //! Stop skipping the sub-tree \em object
+        void endSkip(const TiffComponent* object);
+        //! Return the location of \em object and its \em value in the TIFF data
+        ExifOrigin origin(const TiffEntryBase* object, const Value& value) const;
         /*!
           @brief Get the data for a \em tag and \em group, either from the
                  \em object provided, if it matches or from the matching element
@@ -361,9 +585,54 @@ namespace Exiv2 {
         const FindDecoderFct findDecoderFct_; //!< Ptr to the function to find special decoding functions
         std::string make_;           //!< Camera make, determined from the tags to decode
         bool decodedIptc_;           //!< Indicates if IPTC has been decoded yet
+        const Subtrees* subtrees_;   //!< Sub-trees decoded by other decoders, or 0
+        const TiffComponent* ownSubtree_; //!< Sub-tree decoded by this decoder
+        int skipDepth_;              //!< Nesting level of skipped sub-trees
+        SubtreePositions subtreePositions_; //!< Skipped sub-trees and their positions
+        const byte* pData_;          //!< Start of the TIFF data, or 0
+        size_t size_;                //!< Size of the TIFF data
 
     }; // class TiffDecoder
 
+    /*!
+      @brief TIFF composite visitor to find the sub-trees which can be decoded
+             independently of each other: all directories except the root
+             and those of makernotes, and the IFD makernotes. Nested
+             sub-trees are found after the sub-trees which contain them.
+     */
+    class TiffSubtreeFinder : public TiffVisitor {
+    public:
+        //! @name Creators
+        //@{
+        //! Constructor, the sub-trees are added to \em subtrees
+        explicit TiffSubtreeFinder(std::vector<TiffComponent*>& subtrees);
+        //! Virtual destructor
+        ~TiffSubtreeFinder() override;
+        //@}
+
+        //! @name Manipulators
+        //@{
+        void visitEntry(TiffEntry* object) override;
+        void visitDataEntry(TiffDataEntry* object) override;
+        void visitImageEntry(TiffImageEntry* object) override;
+        void visitSizeEntry(TiffSizeEntry* object) override;
+        //! Add the directory, unless it is the root or the directory of a makernote
+        void visitDirectory(TiffDirectory* object) override;
+        void visitSubIfd(TiffSubIfd* object) override;
+        void visitMnEntry(TiffMnEntry* object) override;
+        //! Add the makernote
+        void visitIfdMakernote(TiffIfdMakernote* object) override;
+        void visitBinaryArray(TiffBinaryArray* object) override;
+        void visitBinaryElement(TiffBinaryElement* object) override;
+        //@}
+
+    private:
+        // DATA
+        std::vector<TiffComponent*>& subtrees_; //!< Sub-trees found
+        bool root_;                  //!< True until the root directory is visited
+        bool makernote_;             //!< True if the next directory is that of a makernote
+    }; // class TiffSubtreeFinder
+
     /*!
       @brief TIFF composite visitor to encode metadata from an image to the TIFF
              tree. The metadata containers and root element of the tree are
@@ -414,7 +683,7 @@ namespace Exiv2 {
         void visitSizeEntry(TiffSizeEntry* object) override;
         //! Encode a TIFF directory
         void visitDirectory(TiffDirectory* object) override;
-        //! Update directory entries
+        //! Update directory entries, unlink a following IFD1 whose metadata were all erased
         void visitDirectoryNext(TiffDirectory* object) override;
         //! Encode a TIFF sub-IFD
         void visitSubIfd(TiffSubIfd* object) override;
@@ -501,6 +770,12 @@ namespace Exiv2 {
         );
         //! Set the dirty flag and end of traversing signal.
         void setDirty(bool flag =true);
+        /*!
+          @brief Set the unused space at the end of the binary image, from
+                 \em pBegin to \em pEnd. Non-intrusive writing moves data
+                 areas which grew there, if its bytes are zero.
+         */
+        void setFreeSpace(byte* pBegin, byte* pEnd);
         //@}
 
         //! @name Accessors
@@ -533,6 +808,16 @@ namespace Exiv2 {
           This method is called from the constructor.
          */
         void encodeXmp();
+        /*!
+          @brief Return the datum to encode in \em object for non-intrusive
+                 writing, end() if there is none. This is the datum with the
+                 tag, group and index of the object, else the first one with
+                 its tag and group. The lookup uses an index of the Exif data,
+                 which is built on the first call.
+         */
+        ExifData::iterator findDatum(const TiffEntryBase* object);
+        //! Erase the datum at \em pos from the Exif data and from its index
+        void eraseDatum(ExifData::iterator pos);
         //@}
 
         //! @name Accessors
@@ -545,6 +830,13 @@ namespace Exiv2 {
         uint32_t updateDirEntry(byte* buf,
                                 ByteOrder byteOrder,
                                 TiffComponent* pTiffComponent) const;
+        /*!
+          @brief Return where non-intrusive writing can move the data area of
+                 \em object if it grows to \em size bytes, 0 if it doesn't fit.
+                 This is the old place if the data area is the last data of
+                 the image, else the start of the free space.
+         */
+        byte* growDataArea(const TiffDataEntry* object, uint32_t size) const;
         /*!
           @brief Check if the tag is an image tag of an existing image. Such
                  tags are copied from the original image and can't be modifed.
@@ -570,10 +862,16 @@ namespace Exiv2 {
         TiffComponent* pSourceTree_; //!< Parsed source tree for reference
         ByteOrder byteOrder_;        //!< Byteorder for encoding
         ByteOrder origByteOrder_;    //!< Byteorder as set in the c'tor
+        bool bigTiff_;               //!< True if IFD entries use the BigTIFF layout
         const FindEncoderFct findEncoderFct_; //!< Ptr to the function to find special encoding functions
         std::string make_;           //!< Camera make, determined from the tags to encode
         bool dirty_;                 //!< Signals if any tag is deleted or allocated
         WriteMethod writeMethod_;    //!< Write method used.
+        byte* pFree_;                //!< Start of the unused space at the end of the image, may be 0
+        byte* pFreeEnd_;             //!< End of the unused space
+        //! Datums by group and tag, in the order of the Exif data
+        std::map<uint32_t, std::vector<ExifData::iterator> > datumIndex_;
+        bool indexed_;               //!< True if datumIndex_ was built
 
     }; // class TiffEncoder
 
@@ -589,9 +887,11 @@ namespace Exiv2 {
         //@{
         //! Constructor.
         TiffRwState(ByteOrder byteOrder,
-                    uint32_t  baseOffset)
+                    uint32_t  baseOffset,
+                    bool      bigTiff =false)
             : byteOrder_(byteOrder),
-              baseOffset_(baseOffset) {}
+              baseOffset_(baseOffset),
+              bigTiff_(bigTiff) {}
         //@}
 
         //! @name Accessors
@@ -613,11 +913,17 @@ namespace Exiv2 {
           to the basis for such makernote offsets.
          */
         uint32_t           baseOffset() const { return baseOffset_; }
+        /*!
+          @brief Return \c true if the IFDs have the BigTIFF layout. Makernotes
+                 always have the layout of regular TIFF IFDs.
+         */
+        bool               bigTiff()    const { return bigTiff_; }
         //@}
 
     private:
         ByteOrder byteOrder_;
         uint32_t  baseOffset_;
+        bool      bigTiff_;
     }; // TiffRwState
 
     /*!
@@ -637,11 +943,18 @@ namespace Exiv2 {
           @param pRoot     Root element of the TIFF composite.
           @param state     State object for creation function, byte order and
                            base offset.
+          @param readMakernote If false, makernotes are kept as plain entries
+                           and their contents are not parsed.
+          @param filter    Optional decode filter. The directories of makernote
+                           sub-IFDs whose group it rejects are not read, nor
+                           are the data areas of entries it rejects.
          */
         TiffReader(const byte*          pData,
-                   uint32_t             size,
+                   size_t               size,
                    TiffComponent*       pRoot,
-                   TiffRwState          state);
+                   TiffRwState          state,
+                   bool                 readMakernote =true,
+                   const DecodeFilter*  filter =0);
 
         //! Virtual destructor
         ~TiffReader() override;
@@ -659,6 +972,8 @@ namespace Exiv2 {
         void visitSizeEntry(TiffSizeEntry* object) override;
         //! Read a TIFF directory from the data buffer
         void visitDirectory(TiffDirectory* object) override;
+        //! Leave a TIFF directory, for the nesting depth
+        void visitDirectoryEnd(TiffDirectory* object) override;
         //! Read a TIFF sub-IFD from the data buffer
         void visitSubIfd(TiffSubIfd* object) override;
         //! Read a TIFF makernote entry from the data buffer
@@ -708,6 +1023,10 @@ namespace Exiv2 {
         ByteOrder byteOrder() const;
         //! Return the base offset. See class TiffRwState for details
         uint32_t baseOffset() const;
+        //! Return true if the IFDs have the BigTIFF layout. See class TiffRwState for details
+        bool bigTiff() const;
+        //! Return the size of the buffer, limited to the range of 32 bit offsets
+        uint32_t sizeData() const;
         //@}
 
     private:
@@ -717,7 +1036,7 @@ namespace Exiv2 {
 
         // DATA
         const byte*          pData_;      //!< Pointer to the memory buffer
-        const uint32_t       size_;       //!< Size of the buffer
+        const size_t         size_;       //!< Size of the buffer
         const byte*          pLast_;      //!< Pointer to the last byte
         TiffComponent* const pRoot_;      //!< Root element of the composite
         TiffRwState*         pState_;     //!< Pointer to the state in effect (origState_ or mnState_)
@@ -727,8 +1046,31 @@ namespace Exiv2 {
         IdxSeq               idxSeq_;     //!< Sequences for group, used for the entry's idx
         PostList             postList_;   //!< List of components with deferred reading
         bool                 postProc_;   //!< True in postProcessList()
+        const bool           readMakernote_; //!< False if makernotes are not parsed
+        const DecodeFilter*  filter_;     //!< Decode filter for sub-IFDs and data areas, may be 0
+        TiffIndex            index_;      //!< Index of the entries read
+        uint64_t             depth_;      //!< Nesting depth of the directory being read
     }; // class TiffReader
 
+// *****************************************************************************
+// free functions
+
+    /*!
+      @brief Decode the XMP packet in the data of an Exif.Image.XMLPacket tag
+             to \em xmpData, without a copy. Leading characters before the
+             packet are skipped.
+     */
+    void decodeXmpTag(XmpData& xmpData, const byte* pData, long size);
+
+    /*!
+      @brief Decode the IPTC in the data of an Exif.Image.IPTCNAA tag or, if
+             there is none or it fails to decode, in the Photoshop IRB of an
+             Exif.Image.ImageResources tag to \em iptcData. Either may be 0.
+     */
+    void decodeIptcTags(IptcData& iptcData,
+                        const byte* pIptc, long sizeIptc,
+                        const byte* pIrb, long sizeIrb);
+
 }}                                      // namespace Internal, Exiv2
 
 #endif                                  // #ifndef TIFFVISITOR_INT_HPP_
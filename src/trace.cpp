@@ -0,0 +1,66 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+  File:      trace.cpp
+ */
+// *****************************************************************************
+// included header files
+#include "config.h"
+
+#include "trace.hpp"
+
+// + standard includes
+#include <atomic>
+
+// *****************************************************************************
+// local declarations
+namespace {
+
+    //! The handler set with Trace::setHandler()
+    std::atomic<Exiv2::Trace::Handler> traceHandler(nullptr);
+
+}
+
+// *****************************************************************************
+// class member definitions
+namespace Exiv2 {
+
+    Trace::Trace(const char* category, const char* name)
+        : handler_(traceHandler.load(std::memory_order_relaxed)), category_(category), name_(name)
+    {
+        if (handler_) handler_(begin, category_, name_);
+    }
+
+    Trace::~Trace()
+    {
+        if (handler_) handler_(end, category_, name_);
+    }
+
+    void Trace::setHandler(Handler handler)
+    {
+        traceHandler.store(handler);
+    }
+
+    Trace::Handler Trace::handler()
+    {
+        return traceHandler.load();
+    }
+
+}                                       // namespace Exiv2
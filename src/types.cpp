@@ -28,19 +28,25 @@
 #include "types.hpp"
 #include "enforce.hpp"
 #include "futils.hpp"
+#include "helper_functions.hpp"
 #include "i18n.h"  // for _exvGettext
 #include "safe_op.hpp"
+#include "stats_int.hpp"
 #include "unused.h"
 
 // + standard includes
 #ifdef EXV_UNICODE_PATH
 # include <windows.h> // for MultiByteToWideChar etc
 #endif
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <memory>
+#include <stdexcept>
 #include <utility>
+#include <vector>
 #include <cctype>
 #include <ctime>
 #include <cstdio>
@@ -86,6 +92,9 @@ namespace {
         { Exiv2::tiffFloat,        "Float",       4 },
         { Exiv2::tiffDouble,       "Double",      8 },
         { Exiv2::tiffIfd,          "Ifd",         4 },
+        { Exiv2::unsignedLongLong, "LongLong",    8 },
+        { Exiv2::signedLongLong,   "SLongLong",   8 },
+        { Exiv2::tiffIfd8,         "Ifd8",        8 },
         { Exiv2::string,           "String",      1 },
         { Exiv2::date,             "Date",        8 },
         { Exiv2::time,             "Time",       11 },
@@ -118,53 +127,201 @@ namespace Exiv2 {
         return tit->typeId_;
     }
 
+    MemoryUsage::MemoryUsage()
+        : datums_(0), keys_(0), values_(0), buffers_(0)
+    {
+    }
+
+    MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& rhs)
+    {
+        datums_  += rhs.datums_;
+        keys_    += rhs.keys_;
+        values_  += rhs.values_;
+        buffers_ += rhs.buffers_;
+        return *this;
+    }
+
+    uint64_t MemoryUsage::total() const
+    {
+        return datums_ + keys_ + values_ + buffers_;
+    }
+
     long TypeInfo::typeSize(TypeId typeId)
     {
+        // The TIFF types are at the index of their id, values ask for their size often
+        if (typeId >= invalidTypeId && typeId <= tiffIfd) return typeInfoTable[typeId].size_;
         const TypeInfoTable* tit = find(typeInfoTable, typeId);
         if (!tit) return 0;
         return tit->size_;
     }
 
+    namespace {
+        //! Sizes of the smallest and the largest buffers in the pool
+        const long minPooledSize = 256;
+        const long maxPooledSize = 64 * 1024;
+        //! Number of size classes of the pool, each twice the size of the previous one
+        const int poolClasses = 9;
+        //! Number of free buffers the pool keeps per size class
+        const size_t maxFreeBuffers = 16;
+
+        //! Free buffers of a thread, by size class
+        struct BufferPool {
+            ~BufferPool();
+            std::vector<byte*> free_[poolClasses];
+        };
+
+        thread_local BufferPool bufferPool;
+        //! Set when the pool of the thread is gone, buffers freed later are deleted
+        thread_local bool bufferPoolDestroyed = false;
+
+        BufferPool::~BufferPool()
+        {
+            for (int c = 0; c < poolClasses; ++c) {
+                for (size_t i = 0; i < free_[c].size(); ++i) delete[] free_[c][i];
+            }
+            bufferPoolDestroyed = true;
+        }
+
+        //! Return the size class for buffers of \em size bytes
+        int poolClass(long size)
+        {
+            int c = 0;
+            for (long s = minPooledSize; s < size; s *= 2) ++c;
+            return c;
+        }
+
+        /*!
+          Count an allocation of \em size bytes in the current stats of the
+          thread and charge it to its parse budget, before it is made.
+         */
+        void countAllocation(long size)
+        {
+            if (size > 0) Internal::ParseBudget::chargeAllocation(static_cast<size_t>(size));
+            IoStats* stats = Internal::currentStats();
+            if (stats) {
+                ++stats->allocations_;
+                stats->bytesAllocated_ += size;
+            }
+        }
+
+        //! Get a buffer of \em capacity bytes, a class size, from the pool
+        byte* poolGet(long capacity)
+        {
+            if (!bufferPoolDestroyed) {
+                std::vector<byte*>& freeList = bufferPool.free_[poolClass(capacity)];
+                if (!freeList.empty()) {
+                    // The budget counts the buffers handed out, not only the new ones
+                    Internal::ParseBudget::chargeAllocation(static_cast<size_t>(capacity));
+                    byte* p = freeList.back();
+                    freeList.pop_back();
+                    return p;
+                }
+            }
+            countAllocation(capacity);
+            return new byte[capacity];
+        }
+
+        //! Return a buffer of \em capacity bytes to the pool
+        void poolPut(byte* p, long capacity)
+        {
+            if (!bufferPoolDestroyed) {
+                std::vector<byte*>& freeList = bufferPool.free_[poolClass(capacity)];
+                if (freeList.size() < maxFreeBuffers) {
+                    freeList.push_back(p);
+                    return;
+                }
+            }
+            delete[] p;
+        }
+    }
+
     DataBuf::DataBuf(DataBuf& rhs)
-        : pData_(rhs.pData_), size_(rhs.size_)
+        : pData_(0), size_(0), capacity_(0), pooled_(false)
+    {
+        take(rhs);
+    }
+
+    DataBuf::DataBuf(DataBuf&& rhs)
+        : pData_(0), size_(0), capacity_(0), pooled_(false)
     {
-        std::pair<byte*, long> ret = rhs.release();
-        UNUSED(ret);
+        take(rhs);
     }
 
     DataBuf::~DataBuf()
-    { delete[] pData_; }
+    { free(); }
 
-    DataBuf::DataBuf() : pData_(0), size_(0)
+    DataBuf::DataBuf() : pData_(0), size_(0), capacity_(0), pooled_(false)
     {}
 
-    DataBuf::DataBuf(long size) : pData_(new byte[size]()), size_(size)
-    {}
+    DataBuf::DataBuf(long size) : pData_(0), size_(0), capacity_(0), pooled_(false)
+    {
+        countAllocation(size);
+        pData_ = new byte[size]();
+        size_ = size;
+    }
 
     DataBuf::DataBuf(const byte* pData, long size)
-        : pData_(0), size_(0)
+        : pData_(0), size_(0), capacity_(0), pooled_(false)
     {
         if (size > 0) {
+            countAllocation(size);
             pData_ = new byte[size];
             std::memcpy(pData_, pData, size);
             size_ = size;
         }
     }
 
+    DataBuf DataBuf::pooled(long size)
+    {
+        DataBuf buf;
+        buf.pooled_ = true;
+        if (size > 0) buf.alloc(size);
+        return buf;
+    }
+
     DataBuf& DataBuf::operator=(DataBuf& rhs)
     {
         if (this == &rhs) return *this;
-        reset(rhs.release());
+        free();
+        take(rhs);
+        return *this;
+    }
+
+    DataBuf& DataBuf::operator=(DataBuf&& rhs)
+    {
+        if (this == &rhs) return *this;
+        free();
+        take(rhs);
         return *this;
     }
 
+    void DataBuf::take(DataBuf& rhs)
+    {
+        pData_ = rhs.pData_;
+        size_ = rhs.size_;
+        capacity_ = rhs.capacity_;
+        pooled_ = rhs.pooled_;
+        rhs.pData_ = 0;
+        rhs.size_ = 0;
+        rhs.capacity_ = 0;
+    }
+
     void DataBuf::alloc(long size)
     {
         if (size > size_) {
-            delete[] pData_;
-            pData_ = 0;
-            size_ = 0;
-            pData_ = new byte[size];
+            if (size <= capacity_) {
+                size_ = size;
+                return;
+            }
+            free();
+            if (pooled_ && size <= maxPooledSize) {
+                capacity_ = minPooledSize << poolClass(size);
+                pData_ = poolGet(capacity_);
+            }
+            else {
+                countAllocation(size);
+                pData_ = new byte[size];
+            }
             size_ = size;
         }
     }
@@ -174,31 +331,194 @@ namespace Exiv2 {
         std::pair<byte*, long> p = std::make_pair(pData_, size_);
         pData_ = 0;
         size_ = 0;
+        capacity_ = 0;
         return p;
     }
 
     void DataBuf::free()
     {
-        delete[] pData_;
+        if (capacity_ > 0) {
+            poolPut(pData_, capacity_);
+        }
+        else {
+            delete[] pData_;
+        }
         pData_ = 0;
         size_ = 0;
+        capacity_ = 0;
     }
 
     void DataBuf::reset(std::pair<byte*, long> p)
     {
         if (pData_ != p.first) {
-            delete[] pData_;
+            free();
             pData_ = p.first;
         }
         size_ = p.second;
     }
 
-    DataBuf::DataBuf(const DataBufRef &rhs) : pData_(rhs.p.first), size_(rhs.p.second) {}
+    SharedBuf::SharedBuf(const byte* pData, size_t size)
+        : SharedBuf(DataBuf(pData, static_cast<long>(size)))
+    {
+    }
+
+    SharedBuf::SharedBuf(DataBuf&& buf)
+        : pData_(0), size_(0)
+    {
+        if (buf.size_ <= 0) return;
+        std::shared_ptr<DataBuf> owner = std::make_shared<DataBuf>(std::move(buf));
+        pData_ = owner->pData_;
+        size_ = static_cast<size_t>(owner->size_);
+        owner_ = owner;
+    }
+
+    SharedBuf::SharedBuf(Blob&& blob)
+        : pData_(0), size_(0)
+    {
+        if (blob.empty()) return;
+        std::shared_ptr<Blob> owner = std::make_shared<Blob>(std::move(blob));
+        pData_ = &(*owner)[0];
+        size_ = owner->size();
+        owner_ = owner;
+    }
+
+    SharedBuf SharedBuf::slice(size_t offset, size_t size) const
+    {
+        if (offset > size_ || size > size_ - offset) {
+            throw std::out_of_range("Slice of a SharedBuf out of range");
+        }
+        SharedBuf result;
+        if (size == 0) return result;
+        result.owner_ = owner_;
+        result.pData_ = pData_ + offset;
+        result.size_ = size;
+        return result;
+    }
+
+    DataBuf SharedBuf::copy() const
+    {
+        return DataBuf(pData_, static_cast<long>(size_));
+    }
+
+    DataBuf::DataBuf(const DataBufRef &rhs)
+        : pData_(rhs.p.first), size_(rhs.p.second), capacity_(0), pooled_(false) {}
 
     DataBuf &DataBuf::operator=(DataBufRef rhs) { reset(rhs.p); return *this; }
 
     Exiv2::DataBuf::operator DataBufRef() { return DataBufRef(release()); }
 
+    namespace {
+        //! Stream buffer which appends to a string
+        class AppendBuf : public std::streambuf {
+        public:
+            AppendBuf() : str_(0) {}
+            void setTarget(std::string* str) { str_ = str; }
+
+        protected:
+            int_type overflow(int_type c) override
+            {
+                if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+                str_->push_back(traits_type::to_char_type(c));
+                return c;
+            }
+            std::streamsize xsputn(const char* s, std::streamsize n) override
+            {
+                str_->append(s, static_cast<size_t>(n));
+                return n;
+            }
+
+        private:
+            std::string* str_;
+        };
+
+        //! Output stream of a StringWriter
+        struct AppendStream {
+            //! Constructor, the stream uses the classic locale, whatever the global locale
+            AppendStream() : os_(&buf_), flags_(os_.flags()) { os_.imbue(std::locale::classic()); }
+            AppendBuf buf_;
+            std::ostream os_;
+            std::ios_base::fmtflags flags_;  //!< Initial format flags
+        };
+
+        //! Streams of the StringWriters of a thread, by nesting level
+        thread_local std::vector<std::unique_ptr<AppendStream> > appendStreams;
+        //! Number of StringWriters of the thread in use
+        thread_local size_t appendStreamsInUse = 0;
+    }
+
+    StringWriter::StringWriter(std::string& buf)
+    {
+        if (appendStreamsInUse == appendStreams.size()) {
+            appendStreams.push_back(std::unique_ptr<AppendStream>(new AppendStream));
+        }
+        AppendStream& as = *appendStreams[appendStreamsInUse++];
+        as.buf_.setTarget(&buf);
+        as.os_.clear();
+        as.os_.flags(as.flags_);
+        as.os_.precision(6);
+        as.os_.width(0);
+        as.os_.fill(' ');
+        os_ = &as.os_;
+    }
+
+    StringWriter::~StringWriter()
+    {
+        appendStreams[--appendStreamsInUse]->buf_.setTarget(0);
+    }
+
+    Number::Number(const Rational& value)
+        : kind_(kRational), denominator_(value.second), size_(sizeof(value.first)), precision_(-1), fixed_(false)
+    {
+        value_.s_ = value.first;
+    }
+
+    Number::Number(const URational& value)
+        : kind_(kURational), denominator_(value.second), size_(sizeof(value.first)), precision_(-1), fixed_(false)
+    {
+        value_.u_ = value.first;
+    }
+
+    Number Number::general(double value, int precision)
+    {
+        Number number(value);
+        number.precision_ = precision;
+        return number;
+    }
+
+    Number Number::fixed(double value, int precision)
+    {
+        Number number(value);
+        number.precision_ = precision;
+        number.fixed_ = true;
+        return number;
+    }
+
+    std::ostream& Number::writeStream(std::ostream& os) const
+    {
+        const std::locale locale = os.imbue(std::locale::classic());
+        const std::streamsize precision = os.precision();
+        const std::ios_base::fmtflags flags = os.flags();
+        if (precision_ >= 0) os.precision(precision_);
+        if (fixed_) os.setf(std::ios_base::fixed, std::ios_base::floatfield);
+        // Like the output operators of int and short, print negative numbers as unsigned in hex and octal
+        const bool asUnsigned = (flags & (std::ios_base::oct | std::ios_base::hex)) != 0 && size_ < sizeof(long long);
+        const unsigned long long mask = asUnsigned ? (1ULL << 8 * size_) - 1 : ~0ULL;
+        switch (kind_) {
+        case kSigned:    if (asUnsigned) os << (value_.s_ & mask); else os << value_.s_; break;
+        case kUnsigned:  os << value_.u_; break;
+        case kFloat:     os << value_.f_; break;
+        case kRational:
+            if (asUnsigned) os << (value_.s_ & mask) << "/" << (denominator_ & mask);
+            else os << value_.s_ << "/" << denominator_;
+            break;
+        case kURational: os << value_.u_ << "/" << denominator_; break;
+        }
+        os.flags(flags);
+        os.precision(precision);
+        os.imbue(locale);
+        return os;
+    }
+
     // *************************************************************************
     // free functions
 
@@ -220,9 +540,165 @@ namespace Exiv2 {
         return Slice<const byte*>(buf.pData_, begin, end);
     }
 
+    namespace {
+        //! Write the digits of \em value to the buffer which ends at \em end, return the first digit
+        char* formatDigits(char* end, unsigned long long value)
+        {
+            do {
+                *--end = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value != 0);
+            return end;
+        }
+
+        //! Write the \em n characters at \em s to the buffer of \em os, set badbit if it fails
+        void put(std::ostream& os, const char* s, std::streamsize n)
+        {
+            if (os.rdbuf()->sputn(s, n) != n) os.setstate(std::ios_base::badbit);
+        }
+
+        //! Write the \em n characters at \em s to the buffer of \em os, padded to the width of the stream
+        void putPadded(std::ostream& os, const char* s, std::streamsize n)
+        {
+            const std::streamsize width = os.width();
+            os.width(0);
+            if (width <= n) return put(os, s, n);
+            const std::string fill(static_cast<size_t>(width - n), os.fill());
+            const std::ios_base::fmtflags adjust = os.flags() & std::ios_base::adjustfield;
+            if (adjust == std::ios_base::left) {
+                put(os, s, n);
+                put(os, fill.data(), fill.size());
+            }
+            else if (adjust == std::ios_base::internal && (*s == '-' || *s == '+')) {
+                put(os, s, 1);
+                put(os, fill.data(), fill.size());
+                put(os, s + 1, n - 1);
+            }
+            else {
+                put(os, fill.data(), fill.size());
+                put(os, s, n);
+            }
+        }
+
+        //! Write the integer \em value to \em os, padded to the width of the stream
+        void putInteger(std::ostream& os, unsigned long long value, bool negative)
+        {
+            char buf[24];
+            char* end = buf + sizeof(buf);
+            char* begin = formatDigits(end, value);
+            if (negative) *--begin = '-';
+            putPadded(os, begin, end - begin);
+        }
+
+        //! Return the magnitude of \em value
+        unsigned long long magnitude(long long value)
+        {
+            // The magnitude of the smallest value does not fit in a long long
+            return value < 0 ? 0 - static_cast<unsigned long long>(value) : static_cast<unsigned long long>(value);
+        }
+
+        /*!
+          @brief Format the floating point number \em value without a fraction
+                 into \em buf, like printf with "%.*f" or "%.*g" and
+                 \em precision. Return the end of the number, 0 if the
+                 number needs the exponent notation.
+         */
+        char* formatIntegral(char* buf, double value, int precision, bool fixed)
+        {
+            char digits[24];
+            char* end = digits + sizeof(digits);
+            const char* begin = formatDigits(end, static_cast<unsigned long long>(std::fabs(value)));
+            if (!fixed && end - begin > std::max(precision, 1)) return 0;
+            char* p = buf;
+            if (std::signbit(value)) *p++ = '-';
+            p = std::copy(begin, static_cast<const char*>(end), p);
+            if (fixed && precision > 0) {
+                *p++ = '.';
+                p = std::fill_n(p, precision, '0');
+            }
+            return p;
+        }
+
+        //! Replace the decimal point of the C locale in the number \em s of \em n characters by a '.'
+        int fixDecimalPoint(char* s, int n)
+        {
+            int i = s[0] == '-' ? 1 : 0;
+            const int digits = i;
+            while (i < n && s[i] >= '0' && s[i] <= '9') ++i;
+            // No decimal point, or inf and nan
+            if (i == n || i == digits || s[i] == '.' || s[i] == 'e') return n;
+            int j = i;
+            while (j < n && (s[j] < '0' || s[j] > '9')) ++j;
+            s[i] = '.';
+            std::memmove(s + i + 1, s + j, n - j);
+            return n - (j - i - 1);
+        }
+
+        //! Write the floating point number \em value to \em os, return false if it is not supported
+        bool putFloat(std::ostream& os, double value, int precision, bool fixed)
+        {
+            // Numbers without a fraction are common and exact, they are formatted without printf
+            if (std::fabs(value) < 1e18 && value == std::floor(value) && precision <= 64) {
+                char buf[96];
+                const char* end = formatIntegral(buf, value, precision, fixed);
+                if (end) {
+                    putPadded(os, buf, end - buf);
+                    return true;
+                }
+            }
+            const char* format = fixed ? "%.*f" : "%.*g";
+            char buf[64];
+            int n = std::snprintf(buf, sizeof(buf), format, precision, value);
+            if (n < 0) return false;
+            if (n < static_cast<int>(sizeof(buf))) {
+                putPadded(os, buf, fixDecimalPoint(buf, n));
+                return true;
+            }
+            // Large numbers in fixed point notation
+            std::vector<char> large(n + 1);
+            n = std::snprintf(&large[0], large.size(), format, precision, value);
+            putPadded(os, &large[0], fixDecimalPoint(&large[0], n));
+            return true;
+        }
+    }
+
+    std::ostream& operator<<(std::ostream& os, const Number& number)
+    {
+        const std::ios_base::fmtflags unsupported =   std::ios_base::oct | std::ios_base::hex
+                                                    | std::ios_base::scientific | std::ios_base::showbase
+                                                    | std::ios_base::showpoint | std::ios_base::showpos
+                                                    | std::ios_base::uppercase;
+        if (os.flags() & unsupported) return number.writeStream(os);
+
+        const std::ostream::sentry sentry(os);
+        if (!sentry) return os;
+        switch (number.kind_) {
+        case Number::kSigned:
+        case Number::kRational:
+            putInteger(os, magnitude(number.value_.s_), number.value_.s_ < 0);
+            break;
+        case Number::kUnsigned:
+        case Number::kURational:
+            putInteger(os, number.value_.u_, false);
+            break;
+        case Number::kFloat: {
+            const int precision = static_cast<int>(number.precision_ >= 0 ? number.precision_ : os.precision());
+            const bool fixed = number.fixed_ || (os.flags() & std::ios_base::floatfield) == std::ios_base::fixed;
+            if (!putFloat(os, number.value_.f_, precision, fixed)) return number.writeStream(os);
+            break;
+        }
+        }
+        if (number.kind_ == Number::kRational || number.kind_ == Number::kURational) {
+            // Only the numerator is padded, like with os << r.first << "/" << r.second
+            put(os, "/", 1);
+            putInteger(os, magnitude(number.denominator_), number.denominator_ < 0);
+        }
+        return os;
+    }
+
     std::ostream& operator<<(std::ostream& os, const Rational& r)
     {
-        return os << r.first << "/" << r.second;
+        return os << Number(r);
     }
 
     std::istream& operator>>(std::istream& is, Rational& r)
@@ -249,7 +725,7 @@ namespace Exiv2 {
 
     std::ostream& operator<<(std::ostream& os, const URational& r)
     {
-        return os << r.first << "/" << r.second;
+        return os << Number(r);
     }
 
     std::istream& operator>>(std::istream& is, URational& r)
@@ -292,6 +768,40 @@ namespace Exiv2 {
         }
     }
 
+    // The array conversions are plain loops without calls, which compilers
+    // turn into vectorized byte swaps or copies.
+    void getUShortArray(uint16_t* s, const byte* buf, size_t count, ByteOrder byteOrder)
+    {
+        if (byteOrder == littleEndian) {
+            for (size_t i = 0; i < count; ++i) {
+                s[i] = static_cast<uint16_t>(buf[2 * i + 1] << 8 | buf[2 * i]);
+            }
+        }
+        else {
+            for (size_t i = 0; i < count; ++i) {
+                s[i] = static_cast<uint16_t>(buf[2 * i] << 8 | buf[2 * i + 1]);
+            }
+        }
+    }
+
+    void getULongArray(uint32_t* l, const byte* buf, size_t count, ByteOrder byteOrder)
+    {
+        if (byteOrder == littleEndian) {
+            for (size_t i = 0; i < count; ++i) {
+                const byte* p = buf + 4 * i;
+                l[i] =   static_cast<uint32_t>(p[3]) << 24 | static_cast<uint32_t>(p[2]) << 16
+                       | static_cast<uint32_t>(p[1]) <<  8 | static_cast<uint32_t>(p[0]);
+            }
+        }
+        else {
+            for (size_t i = 0; i < count; ++i) {
+                const byte* p = buf + 4 * i;
+                l[i] =   static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16
+                       | static_cast<uint32_t>(p[2]) <<  8 | static_cast<uint32_t>(p[3]);
+            }
+        }
+    }
+
     uint64_t getULongLong(const byte* buf, ByteOrder byteOrder)
     {
         if (byteOrder == littleEndian) {
@@ -422,6 +932,54 @@ namespace Exiv2 {
         return 4;
     }
 
+    long ull2Data(byte* buf, uint64_t l, ByteOrder byteOrder)
+    {
+        for (int i = 0; i < 8; ++i) {
+            buf[byteOrder == littleEndian ? i : 7 - i] = static_cast<byte>(l >> (8 * i));
+        }
+        return 8;
+    }
+
+    long us2DataArray(byte* buf, const uint16_t* s, size_t count, ByteOrder byteOrder)
+    {
+        if (byteOrder == littleEndian) {
+            for (size_t i = 0; i < count; ++i) {
+                buf[2 * i]     = static_cast<byte>(s[i]);
+                buf[2 * i + 1] = static_cast<byte>(s[i] >> 8);
+            }
+        }
+        else {
+            for (size_t i = 0; i < count; ++i) {
+                buf[2 * i]     = static_cast<byte>(s[i] >> 8);
+                buf[2 * i + 1] = static_cast<byte>(s[i]);
+            }
+        }
+        return static_cast<long>(2 * count);
+    }
+
+    long ul2DataArray(byte* buf, const uint32_t* l, size_t count, ByteOrder byteOrder)
+    {
+        if (byteOrder == littleEndian) {
+            for (size_t i = 0; i < count; ++i) {
+                byte* p = buf + 4 * i;
+                p[0] = static_cast<byte>(l[i]);
+                p[1] = static_cast<byte>(l[i] >> 8);
+                p[2] = static_cast<byte>(l[i] >> 16);
+                p[3] = static_cast<byte>(l[i] >> 24);
+            }
+        }
+        else {
+            for (size_t i = 0; i < count; ++i) {
+                byte* p = buf + 4 * i;
+                p[0] = static_cast<byte>(l[i] >> 24);
+                p[1] = static_cast<byte>(l[i] >> 16);
+                p[2] = static_cast<byte>(l[i] >> 8);
+                p[3] = static_cast<byte>(l[i]);
+            }
+        }
+        return static_cast<long>(4 * count);
+    }
+
     long ur2Data(byte* buf, URational l, ByteOrder byteOrder)
     {
         long o = ul2Data(buf, l.first, byteOrder);
@@ -517,27 +1075,35 @@ namespace Exiv2 {
 
     void hexdump(std::ostream& os, const byte* buf, long len, long offset)
     {
-        const std::string::size_type pos = 8 + 16 * 3 + 2;
-        const std::string align(pos, ' ');
-        std::ios::fmtflags f( os.flags() );
-
-        long i = 0;
-        while (i < len) {
-            os << "  "
-               << std::setw(4) << std::setfill('0') << std::hex
-               << i + offset << "  ";
-            std::ostringstream ss;
-            do {
-                byte c = buf[i];
-                os << std::setw(2) << std::setfill('0') << std::right
-                   << std::hex << (int)c << " ";
-                ss << ((int)c >= 31 && (int)c < 127 ? char(buf[i]) : '.');
-            } while (++i < len && i%16 != 0);
-            std::string::size_type width = 9 + ((i-1)%16 + 1) * 3;
-            os << (width > pos ? "" : align.substr(width)) << ss.str() << "\n";
-        }
-        os << std::dec << std::setfill(' ');
-        os.flags(f);
+        static const char hexDigits[] = "0123456789abcdef";
+        // Each line is rendered in a buffer: the offset with at least 4 digits,
+        // up to 16 bytes in hex and as characters, padded to align the latter
+        char line[2 + 16 + 2 + 16 * 3 + 1 + 16 + 1];
+
+        for (long i = 0; i < len; i += 16) {
+            char* p = line;
+            *p++ = ' ';
+            *p++ = ' ';
+            const unsigned long o = static_cast<unsigned long>(i + offset);
+            int digits = 4;
+            while (digits < 2 * static_cast<int>(sizeof(o)) && (o >> (4 * digits)) != 0) ++digits;
+            while (digits-- > 0) *p++ = hexDigits[(o >> (4 * digits)) & 0xf];
+            *p++ = ' ';
+            *p++ = ' ';
+            const long count = len - i < 16 ? len - i : 16;
+            for (long j = 0; j < count; ++j) {
+                *p++ = hexDigits[buf[i + j] >> 4];
+                *p++ = hexDigits[buf[i + j] & 0xf];
+                *p++ = ' ';
+            }
+            p = std::fill_n(p, (16 - count) * 3 + 1, ' ');
+            for (long j = 0; j < count; ++j) {
+                const byte c = buf[i + j];
+                *p++ = c >= 31 && c < 127 ? static_cast<char>(c) : '.';
+            }
+            *p++ = '\n';
+            os.write(line, p - line);
+        }
     } // hexdump
 
     bool isHex(const std::string& str, size_t size, const std::string& prefix)
@@ -558,16 +1124,16 @@ namespace Exiv2 {
         assert(buf != 0);
         assert(tm != 0);
         int rc = 1;
-        int year, mon, mday, hour, min, sec;
-        int scanned = std::sscanf(buf, "%4d:%2d:%2d %2d:%2d:%2d",
-                                  &year, &mon, &mday, &hour, &min, &sec);
-        if (scanned == 6) {
-            tm->tm_year = year - 1900;
-            tm->tm_mon  = mon - 1;
-            tm->tm_mday = mday;
-            tm->tm_hour = hour;
-            tm->tm_min  = min;
-            tm->tm_sec  = sec;
+        int f[6];
+        if (   parse_date_time(buf, ':', ' ', f)
+            || std::sscanf(buf, "%4d:%2d:%2d %2d:%2d:%2d",
+                           &f[0], &f[1], &f[2], &f[3], &f[4], &f[5]) == 6) {
+            tm->tm_year = f[0] - 1900;
+            tm->tm_mon  = f[1] - 1;
+            tm->tm_mday = f[2];
+            tm->tm_hour = f[3];
+            tm->tm_min  = f[4];
+            tm->tm_sec  = f[5];
             rc = 0;
         }
         return rc;
@@ -700,23 +1266,46 @@ namespace Exiv2 {
 #endif
             return Rational(f > 0 ? 1 : -1, 0);
         }
-        // Beware: primitive conversion algorithm
-        int32_t den = 1000000;
-        const long f_as_long = static_cast<long>(f);
-        if (Safe::abs(f_as_long) > 2147) {
-            den = 10000;
+        const double x = std::fabs(static_cast<double>(f));
+        if (x > 21474836.0) {
+            // No room for a fraction, round to an integer
+            const double r = std::floor(x + 0.5);
+            const int32_t nom = r < 2147483647.0 ? static_cast<int32_t>(r) : 2147483647;
+            return Rational(f < 0 ? -nom : nom, 1);
         }
-        if (Safe::abs(f_as_long) > 214748) {
-            den = 100;
+        // Prefer the shortest decimal fraction which converts back to f, this
+        // is exactly the value of a float that was read from a decimal string
+        const float fx = static_cast<float>(x);
+        int32_t den = 1;
+        for (int d = 0; d <= 9; ++d) {
+            if (d > 0) den *= 10;
+            const double n = std::floor(x * den + 0.5);
+            if (n > 2147483647.0) break;
+            if (static_cast<float>(n / den) == fx) {
+                const int32_t nom = static_cast<int32_t>(n);
+                const int32_t g = gcd(nom, den);
+                return Rational(f < 0 ? -nom / g : nom / g, den / g);
+            }
         }
-        if (Safe::abs(f_as_long) > 21474836) {
-            den = 1;
+        // Otherwise use the first convergent of the continued fraction of f
+        // which converts back to f, or the last one which fits into a Rational
+        uint32_t h1 = 1, h2 = 0; // numerators of the last two convergents
+        uint32_t k1 = 0, k2 = 1; // denominators of the last two convergents
+        double y = x;
+        for (int i = 0; i < 64; ++i) {
+            const double a = std::floor(y);
+            const double h = a * h1 + h2;
+            const double k = a * k1 + k2;
+            if (h > 2147483647.0 || k > 2147483647.0) break;
+            h2 = h1; h1 = static_cast<uint32_t>(h);
+            k2 = k1; k1 = static_cast<uint32_t>(k);
+            if (static_cast<float>(static_cast<double>(h1) / k1) == fx) break;
+            const double frac = y - a;
+            if (frac <= 0) break;
+            y = 1 / frac;
         }
-        const float rnd = f >= 0 ? 0.5f : -0.5f;
-        const int32_t nom = static_cast<int32_t>(f * den + rnd);
-        const int32_t g = gcd(nom, den);
-
-        return Rational(nom / g, den / g);
+        const int32_t nom = static_cast<int32_t>(h1);
+        return Rational(f < 0 ? -nom : nom, static_cast<int32_t>(k1));
     }
 
 }                                       // namespace Exiv2
@@ -725,17 +1314,17 @@ namespace Exiv2 {
 // Declaration is in i18n.h
 const char* _exvGettext(const char* str)
 {
-    static bool exvGettextInitialized = false;
-
-    if (!exvGettextInitialized) {
+    // Bind the text domain once, the initialization of a static is thread-safe
+    static const bool exvGettextInitialized = []() {
         //bindtextdomain(EXV_PACKAGE_NAME, EXV_LOCALEDIR);
         const std::string localeDir = Exiv2::getProcessPath() + EXV_LOCALEDIR;
         bindtextdomain(EXV_PACKAGE_NAME, localeDir.c_str());
 # ifdef EXV_HAVE_BIND_TEXTDOMAIN_CODESET
         bind_textdomain_codeset (EXV_PACKAGE_NAME, "UTF-8");
 # endif
-        exvGettextInitialized = true;
-    }
+        return true;
+    }();
+    (void)exvGettextInitialized;
 
     return dgettext(EXV_PACKAGE_NAME, str);
 }
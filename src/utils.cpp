@@ -122,4 +122,30 @@ namespace Util {
         }
     }
 
+    void writeJsonString(std::ostream& os, const std::string& s)
+    {
+        static const char hexdigits[] = "0123456789abcdef";
+        os << '"';
+        std::string::size_type start = 0;
+        for (std::string::size_type i = 0; i < s.size(); ++i) {
+            const unsigned char c = static_cast<unsigned char>(s[i]);
+            if (c >= 0x20 && c != '"' && c != '\\' && c != 0x7f)
+                continue;
+            os.write(s.data() + start, i - start);
+            start = i + 1;
+            switch (c) {
+            case '"':  os << "\\\""; break;
+            case '\\': os << "\\\\"; break;
+            case '\n': os << "\\n"; break;
+            case '\r': os << "\\r"; break;
+            case '\t': os << "\\t"; break;
+            default:
+                os << "\\u00" << hexdigits[c >> 4] << hexdigits[c & 0x0f];
+                break;
+            }
+        }
+        os.write(s.data() + start, s.size() - start);
+        os << '"';
+    }
+
 }                                       // namespace Util
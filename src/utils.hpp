@@ -31,6 +31,7 @@
 // included header files
 
 // + standard includes
+#include <iosfwd>
 #include <string>
 
 // *********************************************************************
@@ -84,6 +85,13 @@ namespace Util {
      */
     void replace(std::string& text, const std::string& searchText, const std::string& replaceText);
 
+    /*!
+      @brief Write \em s to \em os as a quoted JSON string. Quotes, backslashes
+             and control characters are escaped, all other bytes are written
+             as they are.
+     */
+    void writeJsonString(std::ostream& os, const std::string& s);
+
 }                                       // namespace Util
 
 #endif                                  // #ifndef UTILS_HPP_
@@ -30,6 +30,7 @@
 #include "types.hpp"
 #include "enforce.hpp"
 #include "error.hpp"
+#include "helper_functions.hpp"
 #include "convert.hpp"
 #include "unused.h"
 
@@ -85,6 +86,11 @@ namespace Exiv2 {
     {
     }
 
+    Value::Value(const Value& rhs)
+        : ok_(rhs.ok_.load()), type_(rhs.type_)
+    {
+    }
+
     Value::~Value()
     {
     }
@@ -93,7 +99,7 @@ namespace Exiv2 {
     {
         if (this == &rhs) return *this;
         type_ = rhs.type_;
-        ok_ = rhs.ok_;
+        ok_ = rhs.ok_.load();
         return *this;
     }
 
@@ -137,6 +143,13 @@ namespace Exiv2 {
         case tiffDouble:
             value = UniquePtr(new ValueType<double>);
             break;
+        case unsignedLongLong:
+        case tiffIfd8:
+            value = UniquePtr(new ValueType<uint64_t>(typeId));
+            break;
+        case signedLongLong:
+            value = UniquePtr(new ValueType<int64_t>);
+            break;
         case string:
             value = UniquePtr(new StringValue);
             break;
@@ -167,6 +180,38 @@ namespace Exiv2 {
         return value;
     } // Value::create
 
+    Value::UniquePtr Value::create(TypeId typeId, const byte* buf, long len, ByteOrder byteOrder)
+    {
+        switch (typeId) {
+        case signedByte:
+        case unsignedByte:
+        case undefined:
+            return UniquePtr(new DataValue(buf, len, byteOrder, typeId));
+        case unsignedShort:
+            return UniquePtr(new ValueType<uint16_t>(buf, len, byteOrder));
+        case unsignedLong:
+        case tiffIfd:
+            return UniquePtr(new ValueType<uint32_t>(buf, len, byteOrder, typeId));
+        case unsignedRational:
+            return UniquePtr(new ValueType<URational>(buf, len, byteOrder));
+        case signedShort:
+            return UniquePtr(new ValueType<int16_t>(buf, len, byteOrder));
+        case signedLong:
+            return UniquePtr(new ValueType<int32_t>(buf, len, byteOrder));
+        case signedRational:
+            return UniquePtr(new ValueType<Rational>(buf, len, byteOrder));
+        case tiffFloat:
+            return UniquePtr(new ValueType<float>(buf, len, byteOrder));
+        case tiffDouble:
+            return UniquePtr(new ValueType<double>(buf, len, byteOrder));
+        default:
+            break;
+        }
+        UniquePtr value = create(typeId);
+        value->read(buf, len, byteOrder);
+        return value;
+    } // Value::create
+
     int Value::setDataArea(const byte* /*buf*/, long /*len*/)
     {
         return -1;
@@ -174,10 +219,11 @@ namespace Exiv2 {
 
     std::string Value::toString() const
     {
-        std::ostringstream os;
-        write(os);
-        ok_ = !os.fail();
-        return os.str();
+        std::string str;
+        StringWriter writer(str);
+        write(writer.stream());
+        ok_ = !writer.stream().fail();
+        return str;
     }
 
     std::string Value::toString(long /*n*/) const
@@ -185,6 +231,11 @@ namespace Exiv2 {
         return toString();
     }
 
+    double Value::toDouble(long n) const
+    {
+        return toFloat(n);
+    }
+
     long Value::sizeDataArea() const
     {
         return 0;
@@ -258,18 +309,16 @@ namespace Exiv2 {
     {
         std::vector<byte>::size_type end = value_.size();
         for (std::vector<byte>::size_type i = 0; i != end; ++i) {
-            os << static_cast<int>(value_[i]);
-            if (i < end - 1) os << " ";
+            os << Number(value_[i]);
+            if (i < end - 1) os.write(" ", 1);
         }
         return os;
     }
 
     std::string DataValue::toString(long n) const
     {
-        std::ostringstream os;
-        os << static_cast<int>(value_[n]);
-        ok_ = !os.fail();
-        return os.str();
+        ok_ = true;
+        return Exiv2::toString(Number(value_[n]));
     }
 
     long DataValue::toLong(long n) const
@@ -763,17 +812,26 @@ namespace Exiv2 {
 
     long XmpTextValue::toLong(long /*n*/) const
     {
-        return parseLong(value_, ok_);
+        bool ok = false;
+        const long result = parseLong(value_, ok);
+        ok_ = ok;
+        return result;
     }
 
     float XmpTextValue::toFloat(long /*n*/) const
     {
-        return parseFloat(value_, ok_);
+        bool ok = false;
+        const float result = parseFloat(value_, ok);
+        ok_ = ok;
+        return result;
     }
 
     Rational XmpTextValue::toRational(long /*n*/) const
     {
-        return parseRational(value_, ok_);
+        bool ok = false;
+        const Rational result = parseRational(value_, ok);
+        ok_ = ok;
+        return result;
     }
 
     XmpTextValue* XmpTextValue::clone_() const
@@ -789,7 +847,10 @@ namespace Exiv2 {
 
     int XmpArrayValue::read(const std::string& buf)
     {
-        if (!buf.empty()) value_.push_back(buf);
+        if (!buf.empty()) {
+            items_ += buf;
+            ends_.push_back(items_.size());
+        }
         return 0;
     }
 
@@ -800,38 +861,54 @@ namespace Exiv2 {
 
     long XmpArrayValue::count() const
     {
-        return static_cast<long>(value_.size());
+        return static_cast<long>(ends_.size());
     }
 
     std::ostream& XmpArrayValue::write(std::ostream& os) const
     {
-        for (std::vector<std::string>::const_iterator i = value_.begin();
-             i != value_.end(); ++i) {
-            if (i != value_.begin()) os << ", ";
-            os << *i;
+        size_t begin = 0;
+        for (size_t i = 0; i < ends_.size(); ++i) {
+            if (i != 0) os << ", ";
+            os.write(items_.data() + begin, ends_[i] - begin);
+            begin = ends_[i];
         }
         return os;
     }
 
+    std::string XmpArrayValue::item(long n) const
+    {
+        const size_t begin = n == 0 ? 0 : ends_[n - 1];
+        return items_.substr(begin, ends_[n] - begin);
+    }
+
     std::string XmpArrayValue::toString(long n) const
     {
         ok_ = true;
-        return value_[n];
+        return item(n);
     }
 
     long XmpArrayValue::toLong(long n) const
     {
-        return parseLong(value_[n], ok_);
+        bool ok = false;
+        const long result = parseLong(item(n), ok);
+        ok_ = ok;
+        return result;
     }
 
     float XmpArrayValue::toFloat(long n) const
     {
-        return parseFloat(value_[n], ok_);
+        bool ok = false;
+        const float result = parseFloat(item(n), ok);
+        ok_ = ok;
+        return result;
     }
 
     Rational XmpArrayValue::toRational(long n) const
     {
-        return parseRational(value_[n], ok_);
+        bool ok = false;
+        const Rational result = parseRational(item(n), ok);
+        ok_ = ok;
+        return result;
     }
 
     XmpArrayValue* XmpArrayValue::clone_() const
@@ -839,6 +916,51 @@ namespace Exiv2 {
         return new XmpArrayValue(*this);
     }
 
+    LangAltValueMap::iterator LangAltValueMap::lower_bound(const key_type& key)
+    {
+        return std::lower_bound(values_.begin(), values_.end(), key,
+                                [](const value_type& v, const key_type& k) { return key_compare()(v.first, k); });
+    }
+
+    LangAltValueMap::const_iterator LangAltValueMap::lower_bound(const key_type& key) const
+    {
+        return const_cast<LangAltValueMap*>(this)->lower_bound(key);
+    }
+
+    LangAltValueMap::iterator LangAltValueMap::find(const key_type& key)
+    {
+        iterator i = lower_bound(key);
+        if (i != values_.end() && key_compare()(key, i->first)) i = values_.end();
+        return i;
+    }
+
+    LangAltValueMap::const_iterator LangAltValueMap::find(const key_type& key) const
+    {
+        return const_cast<LangAltValueMap*>(this)->find(key);
+    }
+
+    LangAltValueMap::mapped_type& LangAltValueMap::operator[](const key_type& key)
+    {
+        return insert(value_type(key, mapped_type())).first->second;
+    }
+
+    std::pair<LangAltValueMap::iterator, bool> LangAltValueMap::insert(const value_type& value)
+    {
+        iterator i = lower_bound(value.first);
+        if (i != values_.end() && !key_compare()(value.first, i->first)) {
+            return std::make_pair(i, false);
+        }
+        return std::make_pair(values_.insert(i, value), true);
+    }
+
+    LangAltValueMap::size_type LangAltValueMap::erase(const key_type& key)
+    {
+        iterator i = find(key);
+        if (i == values_.end()) return 0;
+        values_.erase(i);
+        return 1;
+    }
+
     LangAltValue::LangAltValue()
         : XmpValue(langAlt)
     {
@@ -966,10 +1088,18 @@ namespace Exiv2 {
 #endif
             return 1;
         }
+        const char* b = reinterpret_cast<const char*>(buf);
+        Date d;
+        if (   parse_fixed_digits(b, 4, d.year)
+            && parse_fixed_digits(b + 4, 2, d.month)
+            && parse_fixed_digits(b + 6, 2, d.day)) {
+            date_ = d;
+            return 0;
+        }
         // Make the buffer a 0 terminated C-string for sscanf
-        char b[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-        std::memcpy(b, reinterpret_cast<const char*>(buf), 8);
-        int scanned = sscanf(b, "%4d%2d%2d",
+        char t[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+        std::memcpy(t, b, 8);
+        int scanned = sscanf(t, "%4d%2d%2d",
                              &date_.year, &date_.month, &date_.day);
         if (scanned != 3) {
 #ifndef SUPPRESS_WARNINGS
@@ -989,7 +1119,17 @@ namespace Exiv2 {
 #endif
             return 1;
         }
-        int scanned = sscanf(buf.c_str(), "%4d-%d-%d",
+        // Try the fixed YYYY-MM-DD layout before the lenient one
+        const char* b = buf.c_str();
+        Date d;
+        if (   parse_fixed_digits(b, 4, d.year) && b[4] == '-'
+            && parse_fixed_digits(b + 5, 2, d.month) && b[7] == '-'
+            && parse_fixed_digits(b + 8, 2, d.day)
+            && (b[10] < '0' || b[10] > '9')) {
+            date_ = d;
+            return 0;
+        }
+        int scanned = sscanf(b, "%4d-%d-%d",
                              &date_.year, &date_.month, &date_.day);
         if (scanned != 3) {
 #ifndef SUPPRESS_WARNINGS
@@ -1009,6 +1149,12 @@ namespace Exiv2 {
 
     long DateValue::copy(byte* buf, ByteOrder /*byteOrder*/) const
     {
+        char* b = reinterpret_cast<char*>(buf);
+        if (   format_fixed_digits(b, 4, date_.year)
+            && format_fixed_digits(b + 4, 2, date_.month)
+            && format_fixed_digits(b + 6, 2, date_.day)) {
+            return 8;
+        }
         // sprintf wants to add the null terminator, so use oversized buffer
         char temp[9];
 
@@ -1040,6 +1186,15 @@ namespace Exiv2 {
 
     std::ostream& DateValue::write(std::ostream& os) const
     {
+        char buf[11];
+        if (   date_.year >= 1000
+            && format_fixed_digits(buf, 4, date_.year)
+            && format_fixed_digits(buf + 5, 2, date_.month)
+            && format_fixed_digits(buf + 8, 2, date_.day)) {
+            buf[4] = buf[7] = '-';
+            buf[10] = 0;
+            return os << buf;
+        }
         std::ios::fmtflags f( os.flags() );
         os << date_.year << '-' << std::right
            << std::setw(2) << std::setfill('0') << date_.month << '-'
@@ -1072,6 +1227,43 @@ namespace Exiv2 {
         return Rational(toLong(n), 1);
     }
 
+    namespace {
+        /*!
+          @brief Parse a time with two digits for each field, HHMMSS[+HHMM] or
+                 HH:MM:SS[+HH:MM] if \em colons is set, with the same range
+                 checks as TimeValue::scanTime6(). Return false if \em buf has
+                 another layout.
+         */
+        bool parseFixedTime(const char* buf, bool colons, bool zone, TimeValue::Time& time)
+        {
+            int f[5] = { 0, 0, 0, 0, 0 };
+            int sign = 1;
+            const char* p = buf;
+            for (int i = 0; i < (zone ? 5 : 3); ++i) {
+                if (i == 3) {
+                    if (*p != '+' && *p != '-') return false;
+                    if (*p == '-') sign = -1;
+                    ++p;
+                }
+                else if (colons && i != 0) {
+                    if (*p != ':') return false;
+                    ++p;
+                }
+                if (!parse_fixed_digits(p, 2, f[i])) return false;
+                p += 2;
+            }
+            if (*p >= '0' && *p <= '9') return false;
+            if (   f[0] >= 24 || f[1] >= 60 || f[2] >= 60
+                || f[3] >= 24 || f[4] >= 60) return false;
+            time.hour = f[0];
+            time.minute = f[1];
+            time.second = f[2];
+            time.tzHour = sign * f[3];
+            time.tzMinute = sign * f[4];
+            return true;
+        }
+    }
+
     TimeValue::TimeValue()
         : Value(time)
     {
@@ -1100,11 +1292,14 @@ namespace Exiv2 {
         std::memcpy(b, reinterpret_cast<const char*>(buf), (len < 12 ? len : 11));
         // Hard coded to read HHMMSS or Iptc style times
         int rc = 1;
-        if (len == 6) {
+        if ((len == 6 || len == 11) && parseFixedTime(b, false, len == 11, time_)) {
+            rc = 0;
+        }
+        else if (len == 6) {
             // Try to read (non-standard) HHMMSS format
             rc = scanTime3(b, "%2d%2d%2d");
         }
-        if (len == 11) {
+        else if (len == 11) {
             rc = scanTime6(b, "%2d%2d%2d%1c%2d%2d");
         }
         if (rc) {
@@ -1120,7 +1315,10 @@ namespace Exiv2 {
     {
         // Hard coded to read H:M:S or Iptc style times
         int rc = 1;
-        if (buf.length() < 9) {
+        if (parseFixedTime(buf.c_str(), true, buf.length() >= 9, time_)) {
+            rc = 0;
+        }
+        else if (buf.length() < 9) {
             // Try to read (non-standard) H:M:S format
             rc = scanTime3(buf.c_str(), "%d:%d:%d");
         }
@@ -1181,11 +1379,21 @@ namespace Exiv2 {
 
     long TimeValue::copy(byte* buf, ByteOrder /*byteOrder*/) const
     {
-        char temp[12];
         char plusMinus = '+';
         if (time_.tzHour < 0 || time_.tzMinute < 0)
             plusMinus = '-';
 
+        char* b = reinterpret_cast<char*>(buf);
+        if (   format_fixed_digits(b, 2, time_.hour)
+            && format_fixed_digits(b + 2, 2, time_.minute)
+            && format_fixed_digits(b + 4, 2, time_.second)
+            && format_fixed_digits(b + 7, 2, abs(time_.tzHour))
+            && format_fixed_digits(b + 9, 2, abs(time_.tzMinute))) {
+            b[6] = plusMinus;
+            return 11;
+        }
+        char temp[12];
+
         const int wrote = snprintf(temp, sizeof(temp), // 11 bytes are written + \0
                    "%02d%02d%02d%1c%02d%02d",
                    time_.hour, time_.minute, time_.second,
@@ -1221,6 +1429,17 @@ namespace Exiv2 {
         char plusMinus = '+';
         if (time_.tzHour < 0 || time_.tzMinute < 0) plusMinus = '-';
 
+        char buf[15];
+        if (   format_fixed_digits(buf, 2, time_.hour)
+            && format_fixed_digits(buf + 3, 2, time_.minute)
+            && format_fixed_digits(buf + 6, 2, time_.second)
+            && format_fixed_digits(buf + 9, 2, abs(time_.tzHour))
+            && format_fixed_digits(buf + 12, 2, abs(time_.tzMinute))) {
+            buf[2] = buf[5] = buf[11] = ':';
+            buf[8] = plusMinus;
+            buf[14] = 0;
+            return os << buf;
+        }
         std::ios::fmtflags f( os.flags() );
         os << std::right
            << std::setw(2) << std::setfill('0') << time_.hour << ':'
@@ -467,6 +467,7 @@ void Exiv2::dumpLibraryInfo(std::ostream& os,const exv_grep_keys_t& keys)
     output(os,keys,"enable_nls"        ,enable_nls       );
     output(os,keys,"use_curl"          ,use_curl         );
     output(os,keys,"have_regex"        ,have_regex       );
+    output(os,keys,"makernotes"        ,EXV_MAKERNOTES   );
 
     output(os,keys,"config_path"       ,Exiv2::Internal::getExiv2ConfigPath());
 
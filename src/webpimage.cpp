@@ -40,6 +40,7 @@
 #include "tiffimage.hpp"
 #include "tiffimage_int.hpp"
 #include "convert.hpp"
+#include "stats_int.hpp"
 
 #include <cmath>
 #include <iomanip>
@@ -49,6 +50,8 @@
 #include <sstream>
 #include <cassert>
 #include <cstdio>
+#include <memory>
+#include <vector>
 
 #define CHECK_BIT(var,pos) ((var) & (1<<(pos)))
 
@@ -57,6 +60,22 @@
 namespace Exiv2 {
     namespace Internal {
 
+    /*!
+      @brief Write the 4 byte id, the 4 byte size and the payload of a chunk
+          in one call to the IO.
+      @return 0 if successful;<BR>
+              1 if the chunk was not written completely
+     */
+    static int writeChunk(BasicIo& io, const byte* id, const byte* size, const byte* payload, long payloadSize)
+    {
+        const std::pair<const byte*, long> pieces[] = {
+            std::make_pair(id, 4L),
+            std::make_pair(size, 4L),
+            std::make_pair(payload, payloadSize)
+        };
+        return io.writev(pieces, EXV_COUNTOF(pieces)) == payloadSize + 8 ? 0 : 1;
+    }
+
     }}                                      // namespace Internal, Exiv2
 
 namespace Exiv2 {
@@ -90,6 +109,7 @@ namespace Exiv2 {
     const char* WebPImage::WEBP_CHUNK_HEADER_VP8  = "VP8 ";
     const char* WebPImage::WEBP_CHUNK_HEADER_ANMF = "ANMF";
     const char* WebPImage::WEBP_CHUNK_HEADER_ANIM = "ANIM";
+    const char* WebPImage::WEBP_CHUNK_HEADER_ALPH = "ALPH";
     const char* WebPImage::WEBP_CHUNK_HEADER_ICCP = "ICCP";
     const char* WebPImage::WEBP_CHUNK_HEADER_EXIF = "EXIF";
     const char* WebPImage::WEBP_CHUNK_HEADER_XMP  = "XMP ";
@@ -113,18 +133,109 @@ namespace Exiv2 {
 
     void WebPImage::writeMetadata()
     {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
         if (io_->open() != 0) {
             throw Error(kerDataSourceOpenFailed, io_->path(), strError());
         }
         IoCloser closer(*io_);
-        BasicIo::UniquePtr tempIo(new MemIo);
-        assert (tempIo.get() != 0);
+        // the new image has about the same size
+        BasicIo::UniquePtr tempIo = TiffParserWorker::createTempIo(*io_, static_cast<uint32_t>(io_->size()));
 
         doWriteMetadata(*tempIo); // may throw
         io_->close();
         io_->transfer(*tempIo); // may throw
     } // WebPImage::writeMetadata
 
+    void WebPImage::writeMetadataTo(BasicIo& dst)
+    {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
+        if (io_->open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+        IoCloser closer(*io_);
+        doWriteMetadata(dst); // may throw
+    } // WebPImage::writeMetadataTo
+
+    void WebPImage::stripMetadataTo(BasicIo& dst, int keep)
+    {
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
+        if (io_->open() != 0) {
+            throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        }
+        IoCloser closer(*io_);
+        if (!dst.isopen()) throw Error(kerImageWriteFailed);
+        if (!isWebPType(*io_, true)) {
+            if (io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
+            throw Error(kerNotAnImage, "WEBP");
+        }
+
+        byte header[WEBP_TAG_SIZE * 3];
+        if (io_->read(header, sizeof(header)) != sizeof(header)) throw Error(kerFailedToReadImageData);
+        const uint64_t filesize = Exiv2::getULong(header + WEBP_TAG_SIZE, littleEndian) + 8;
+        enforce(filesize <= io_->size(), Exiv2::kerCorruptedMetadata);
+
+        // Find the chunks to keep from their headers, the new size goes first
+        std::vector<std::pair<uint64_t, uint64_t> > chunks; // offset and size with the padding
+        uint64_t newSize = WEBP_TAG_SIZE;
+        byte chunkHeader[WEBP_TAG_SIZE * 2];
+        uint64_t offset = sizeof(header);
+        while (offset + sizeof(chunkHeader) <= filesize) {
+            io_->seek(static_cast<long>(offset), BasicIo::beg);
+            if (io_->read(chunkHeader, sizeof(chunkHeader)) != sizeof(chunkHeader)) throw Error(kerFailedToReadImageData);
+            const uint32_t size = Exiv2::getULong(chunkHeader + WEBP_TAG_SIZE, littleEndian);
+            const uint64_t chunkSize = sizeof(chunkHeader) + static_cast<uint64_t>(size) + (size % 2);
+            enforce(chunkSize <= filesize - offset, Exiv2::kerCorruptedMetadata);
+
+            int id = mdNone;
+            if (!memcmp(chunkHeader, WEBP_CHUNK_HEADER_EXIF, WEBP_TAG_SIZE)) id = mdExif;
+            else if (!memcmp(chunkHeader, WEBP_CHUNK_HEADER_XMP, WEBP_TAG_SIZE)) id = mdXmp;
+            else if (!memcmp(chunkHeader, WEBP_CHUNK_HEADER_ICCP, WEBP_TAG_SIZE)) id = mdIccProfile;
+            if (id == mdNone || (keep & id) != 0) {
+                chunks.push_back(std::make_pair(offset, chunkSize));
+                newSize += chunkSize;
+            }
+            offset += chunkSize;
+        }
+        enforce(newSize <= 0xffffffff, Exiv2::kerCorruptedMetadata);
+
+        // The VP8X features of the stripped chunks are cleared
+        byte strippedFeatures = 0;
+        if (!(keep & mdExif)) strippedFeatures |= WEBP_VP8X_EXIF_BIT;
+        if (!(keep & mdXmp)) strippedFeatures |= WEBP_VP8X_XMP_BIT;
+        if (!(keep & mdIccProfile)) strippedFeatures |= WEBP_VP8X_ICC_BIT;
+
+        ul2Data(header + WEBP_TAG_SIZE, static_cast<uint32_t>(newSize), littleEndian);
+        if (dst.write(header, sizeof(header)) != sizeof(header)) throw Error(kerImageWriteFailed);
+        PayloadHash hash;
+        for (auto&& chunk : chunks) {
+            io_->seek(static_cast<long>(chunk.first), BasicIo::beg);
+            if (io_->read(chunkHeader, sizeof(chunkHeader)) != sizeof(chunkHeader)) throw Error(kerFailedToReadImageData);
+            if (dst.write(chunkHeader, sizeof(chunkHeader)) != sizeof(chunkHeader)) throw Error(kerImageWriteFailed);
+            const long size = static_cast<long>(Exiv2::getULong(chunkHeader + WEBP_TAG_SIZE, littleEndian));
+            const long padding = static_cast<long>(chunk.second - sizeof(chunkHeader)) - size;
+            if (size > 0 && !memcmp(chunkHeader, WEBP_CHUNK_HEADER_VP8X, WEBP_TAG_SIZE)) {
+                byte flags = 0;
+                if (io_->read(&flags, 1) != 1) throw Error(kerFailedToReadImageData);
+                flags &= ~strippedFeatures;
+                if (dst.write(&flags, 1) != 1) throw Error(kerImageWriteFailed);
+                copyData(*io_, dst, size - 1 + padding);
+                continue;
+            }
+            const bool isImageData = !memcmp(chunkHeader, WEBP_CHUNK_HEADER_VP8, WEBP_TAG_SIZE)
+                                  || !memcmp(chunkHeader, WEBP_CHUNK_HEADER_VP8L, WEBP_TAG_SIZE)
+                                  || !memcmp(chunkHeader, WEBP_CHUNK_HEADER_ALPH, WEBP_TAG_SIZE)
+                                  || !memcmp(chunkHeader, WEBP_CHUNK_HEADER_ANMF, WEBP_TAG_SIZE);
+            copyData(*io_, dst, size, hashPayload() && isImageData ? &hash : 0);
+            copyData(*io_, dst, padding);
+        }
+        if (hashPayload()) {
+            payloadHash_ = hash.value();
+            payloadHashDefined_ = true;
+        }
+    } // WebPImage::stripMetadataTo
+
 
     void WebPImage::doWriteMetadata(BasicIo& outIo)
     {
@@ -182,10 +293,12 @@ namespace Exiv2 {
             io_->read(chunkId.pData_, WEBP_TAG_SIZE);
             io_->read(size_buff, WEBP_TAG_SIZE);
             long size = Exiv2::getULong(size_buff, littleEndian);
-            DataBuf payload(size);
-            io_->read(payload.pData_, payload.size_);
-            byte c;
-            if ( payload.size_ % 2 ) io_->read(&c,1);
+
+            // The features and the canvas size are in the first bytes of the chunks, skip the rest
+            byte payload[16] = {0};
+            const long readSize = EXV_MIN(size, static_cast<long>(sizeof(payload)));
+            if (io_->read(payload, readSize) != readSize) break;
+            io_->seek(size - readSize + size % 2, BasicIo::cur);
 
             /* Chunk with information about features
              used in the file. */
@@ -197,12 +310,12 @@ namespace Exiv2 {
                 byte size_buf[WEBP_TAG_SIZE];
 
                 // Fetch width - stored in 24bits
-                memcpy(&size_buf, &payload.pData_[4], 3);
+                memcpy(&size_buf, &payload[4], 3);
                 size_buf[3] = 0;
                 width = Exiv2::getULong(size_buf, littleEndian) + 1;
 
                 // Fetch height - stored in 24bits
-                memcpy(&size_buf, &payload.pData_[7], 3);
+                memcpy(&size_buf, &payload[7], 3);
                 size_buf[3] = 0;
                 height = Exiv2::getULong(size_buf, littleEndian) + 1;
             }
@@ -228,17 +341,17 @@ namespace Exiv2 {
                    for height and width reference for VP8 chunks */
 
                 // Fetch width - stored in 16bits
-                memcpy(&size_buf, &payload.pData_[6], 2);
+                memcpy(&size_buf, &payload[6], 2);
                 width = Exiv2::getUShort(size_buf, littleEndian) & 0x3fff;
 
                 // Fetch height - stored in 16bits
-                memcpy(&size_buf, &payload.pData_[8], 2);
+                memcpy(&size_buf, &payload[8], 2);
                 height = Exiv2::getUShort(size_buf, littleEndian) & 0x3fff;
             }
 
             /* Chunk with with lossless image data. */
             if (equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_VP8L) && !has_alpha) {
-                if ((payload.pData_[4] & WEBP_VP8X_ALPHA_BIT) == WEBP_VP8X_ALPHA_BIT) {
+                if ((payload[4] & WEBP_VP8X_ALPHA_BIT) == WEBP_VP8X_ALPHA_BIT) {
                     has_alpha = true;
                 }
             }
@@ -253,12 +366,12 @@ namespace Exiv2 {
                    each. Refer to this https://goo.gl/bpgMJf */
 
                 // Fetch width - 14 bits wide
-                memcpy(&size_buf_w, &payload.pData_[1], 2);
+                memcpy(&size_buf_w, &payload[1], 2);
                 size_buf_w[1] &= 0x3F;
                 width = Exiv2::getUShort(size_buf_w, littleEndian) + 1;
 
                 // Fetch height - 14 bits wide
-                memcpy(&size_buf_h, &payload.pData_[2], 3);
+                memcpy(&size_buf_h, &payload[2], 3);
                 size_buf_h[0] =
                   ((size_buf_h[0] >> 6) & 0x3) |
                     ((size_buf_h[1] & 0x3F) << 0x2);
@@ -270,7 +383,7 @@ namespace Exiv2 {
 
             /* Chunk with animation frame. */
             if (equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_ANMF) && !has_alpha) {
-                if ((payload.pData_[5] & 0x2) == 0x2) {
+                if ((payload[5] & 0x2) == 0x2) {
                     has_alpha = true;
                 }
             }
@@ -279,12 +392,12 @@ namespace Exiv2 {
                 byte size_buf[WEBP_TAG_SIZE];
 
                 // Fetch width - stored in 24bits
-                memcpy(&size_buf, &payload.pData_[6], 3);
+                memcpy(&size_buf, &payload[6], 3);
                 size_buf[3] = 0;
                 width = Exiv2::getULong(size_buf, littleEndian) + 1;
 
                 // Fetch height - stored in 24bits
-                memcpy(&size_buf, &payload.pData_[9], 3);
+                memcpy(&size_buf, &payload[9], 3);
                 size_buf[3] = 0;
                 height = Exiv2::getULong(size_buf, littleEndian) + 1;
             }
@@ -308,11 +421,11 @@ namespace Exiv2 {
 
             long size = Exiv2::getULong(size_buff, littleEndian);
 
-            DataBuf payload(size);
-            io_->read(payload.pData_, size);
-            if ( io_->tell() % 2 ) io_->seek(+1,BasicIo::cur); // skip pad
-
             if (equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_VP8X)) {
+                DataBuf payload(size);
+                io_->read(payload.pData_, size);
+                if ( io_->tell() % 2 ) io_->seek(+1,BasicIo::cur); // skip pad
+
                 if (has_icc){
                     payload.pData_[0] |= WEBP_VP8X_ICC_BIT;
                 } else {
@@ -331,38 +444,34 @@ namespace Exiv2 {
                     payload.pData_[0] &= ~WEBP_VP8X_EXIF_BIT;
                 }
 
-                if (outIo.write(chunkId.pData_, WEBP_TAG_SIZE) != WEBP_TAG_SIZE)
-                    throw Error(kerImageWriteFailed);
-                if (outIo.write(size_buff, WEBP_TAG_SIZE) != WEBP_TAG_SIZE)
-                    throw Error(kerImageWriteFailed);
-                if (outIo.write(payload.pData_, payload.size_) != payload.size_)
+                if (writeChunk(outIo, chunkId.pData_, size_buff, payload.pData_, payload.size_) != 0)
                     throw Error(kerImageWriteFailed);
                 if (outIo.tell() % 2) {
                     if (outIo.write(&WEBP_PAD_ODD, 1) != 1) throw Error(kerImageWriteFailed);
                 }
 
                 if (has_icc) {
-                    if (outIo.write((const byte*)WEBP_CHUNK_HEADER_ICCP, WEBP_TAG_SIZE) != WEBP_TAG_SIZE) throw Error(kerImageWriteFailed);
                     ul2Data(data, (uint32_t) iccProfile_.size_, littleEndian);
-                    if (outIo.write(data, WEBP_TAG_SIZE) != WEBP_TAG_SIZE) throw Error(kerImageWriteFailed);
-                    if (outIo.write(iccProfile_.pData_, iccProfile_.size_) != iccProfile_.size_) {
+                    if (writeChunk(outIo, (const byte*)WEBP_CHUNK_HEADER_ICCP, data,
+                                   iccProfile_.pData_, iccProfile_.size_) != 0) {
                         throw Error(kerImageWriteFailed);
                     }
                     has_icc = false;
                 }
-            } else if (equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_ICCP)) {
-                // Skip it altogether handle it prior to here :)
-            } else if (equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_EXIF)) {
-                // Skip and add new data afterwards
-            } else if (equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_XMP)) {
-                // Skip and add new data afterwards
+            } else if (equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_ICCP) ||
+                       equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_EXIF) ||
+                       equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_XMP)) {
+                // Skip it, the ICC profile is handled prior to here and new Exif and XMP data is added afterwards
+                io_->seek(size, BasicIo::cur);
+                if ( io_->tell() % 2 ) io_->seek(+1,BasicIo::cur); // skip pad
             } else {
+                // Stream all other chunks (image data, animation frames) without reading them into memory
                 if (outIo.write(chunkId.pData_, WEBP_TAG_SIZE) != WEBP_TAG_SIZE)
                     throw Error(kerImageWriteFailed);
                 if (outIo.write(size_buff, WEBP_TAG_SIZE) != WEBP_TAG_SIZE)
                     throw Error(kerImageWriteFailed);
-                if (outIo.write(payload.pData_, payload.size_) != payload.size_)
-                    throw Error(kerImageWriteFailed);
+                copyData(*io_, outIo, size);
+                if ( io_->tell() % 2 ) io_->seek(+1,BasicIo::cur); // skip pad
             }
 
             // Encoder required to pad odd sized data with a null byte
@@ -372,12 +481,9 @@ namespace Exiv2 {
         }
 
         if (has_exif) {
-            if (outIo.write((const byte*)WEBP_CHUNK_HEADER_EXIF, WEBP_TAG_SIZE) != WEBP_TAG_SIZE) throw Error(kerImageWriteFailed);
-            us2Data(data, (uint16_t) blob.size()+8, bigEndian);
             ul2Data(data, (uint32_t) blob.size(), littleEndian);
-            if (outIo.write(data, WEBP_TAG_SIZE) != WEBP_TAG_SIZE) throw Error(kerImageWriteFailed);
-            if (outIo.write((const byte*)&blob[0], static_cast<long>(blob.size())) != (long)blob.size())
-            {
+            if (writeChunk(outIo, (const byte*)WEBP_CHUNK_HEADER_EXIF, data,
+                           &blob[0], static_cast<long>(blob.size())) != 0) {
                 throw Error(kerImageWriteFailed);
             }
             if (outIo.tell() % 2) {
@@ -386,10 +492,9 @@ namespace Exiv2 {
         }
 
         if (has_xmp) {
-            if (outIo.write((const byte*)WEBP_CHUNK_HEADER_XMP, WEBP_TAG_SIZE) != WEBP_TAG_SIZE) throw Error(kerImageWriteFailed);
             ul2Data(data, (uint32_t) xmpPacket().size(), littleEndian);
-            if (outIo.write(data, WEBP_TAG_SIZE) != WEBP_TAG_SIZE) throw Error(kerImageWriteFailed);
-            if (outIo.write((const byte*)xmp.data(), static_cast<long>(xmp.size())) != (long)xmp.size()) {
+            if (writeChunk(outIo, (const byte*)WEBP_CHUNK_HEADER_XMP, data,
+                           (const byte*)xmp.data(), static_cast<long>(xmp.size())) != 0) {
                 throw Error(kerImageWriteFailed);
             }
             if (outIo.tell() % 2) {
@@ -493,15 +598,39 @@ namespace Exiv2 {
 
         const uint32_t filesize = Exiv2::getULong(data + WEBP_TAG_SIZE, littleEndian) + 8;
         enforce(filesize <= io_->size(), Exiv2::kerCorruptedMetadata);
+        payloadHashDefined_ = false;
         WebPImage::decodeChunks(filesize);
-
+        releasePackets();
     } // WebPImage::readMetadata
 
-    void WebPImage::decodeChunks(uint64_t filesize)
+    void WebPImage::readBasicInfo()
+    {
+        if (io_->open() != 0) throw Error(kerDataSourceOpenFailed, io_->path(), strError());
+        IoCloser closer(*io_);
+        // Ensure that this is the correct image type
+        if (!isWebPType(*io_, true)) {
+            if (io_->error() || io_->eof()) throw Error(kerFailedToReadImageData);
+            throw Error(kerNotAJpeg);
+        }
+        clearMetadata();
+
+        byte data[12];
+        io_->read(data, WEBP_TAG_SIZE * 3);
+
+        const uint32_t filesize = Exiv2::getULong(data + WEBP_TAG_SIZE, littleEndian) + 8;
+        enforce(filesize <= io_->size(), Exiv2::kerCorruptedMetadata);
+        WebPImage::decodeChunks(filesize, true);
+
+    } // WebPImage::readBasicInfo
+
+    void WebPImage::decodeChunks(uint64_t filesize, bool canvasOnly)
     {
         DataBuf   chunkId(5);
         byte      size_buff[WEBP_TAG_SIZE];
         bool      has_canvas_data = false;
+        const bool hashing = !canvasOnly && hashPayload();
+        PayloadHash hash;
+        FamilyDecoder families(*io_);
 
 #ifdef DEBUG
         std::cout << "Reading metadata" << std::endl;
@@ -538,6 +667,7 @@ namespace Exiv2 {
 
                 has_canvas_data = true;
                 io_->read(payload.pData_, payload.size_);
+                if (hashing) hash.update(payload.pData_, payload.size_);
                 byte size_buf[WEBP_TAG_SIZE];
 
                 // Fetch width""
@@ -559,6 +689,7 @@ namespace Exiv2 {
                 byte size_buf_h[3];
 
                 io_->read(payload.pData_, payload.size_);
+                if (hashing) hash.update(payload.pData_, payload.size_);
 
                 // Fetch width
                 memcpy(&size_buf_w, &payload.pData_[1], 2);
@@ -577,6 +708,7 @@ namespace Exiv2 {
                 byte size_buf[WEBP_TAG_SIZE];
 
                 io_->read(payload.pData_, payload.size_);
+                if (hashing) hash.update(payload.pData_, payload.size_);
 
                 // Fetch width
                 memcpy(&size_buf, &payload.pData_[6], 3);
@@ -587,10 +719,10 @@ namespace Exiv2 {
                 memcpy(&size_buf, &payload.pData_[9], 3);
                 size_buf[3] = 0;
                 pixelHeight_ = Exiv2::getULong(size_buf, littleEndian) + 1;
-            } else if (equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_ICCP)) {
+            } else if (!canvasOnly && equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_ICCP)) {
                 io_->read(payload.pData_, payload.size_);
                 this->setIccProfile(payload);
-            } else if (equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_EXIF)) {
+            } else if (!canvasOnly && equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_EXIF)) {
                 io_->read(payload.pData_, payload.size_);
 
                 // 4 meaningful bytes + 2 padding bytes
@@ -655,8 +787,13 @@ namespace Exiv2 {
                 std::cout << Internal::binaryToHex(rawExifData, sizePayload);
 #endif
 
-                if (pos != -1) {
-                    XmpData  xmpData;
+                if (pos != -1 && parallelDecode()) {
+                    std::shared_ptr<DataBuf> exif(new DataBuf(std::move(payload)));
+                    families.start([this, exif, pos]() {
+                        setByteOrder(ExifParser::decode(exifData_, exif->pData_ + pos, exif->size_ - pos));
+                    });
+                }
+                else if (pos != -1) {
                     ByteOrder bo = ExifParser::decode(exifData_,
                                                       payload.pData_ + pos,
                                                       payload.size_ - pos);
@@ -672,25 +809,42 @@ namespace Exiv2 {
 
                 if (rawExifData)
                     free(rawExifData);
-            } else if (equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_XMP)) {
+            } else if (!canvasOnly && equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_XMP)) {
                 io_->read(payload.pData_, payload.size_);
                 xmpPacket_.assign(reinterpret_cast<char*>(payload.pData_), payload.size_);
-                if (xmpPacket_.size() > 0 && XmpParser::decode(xmpData_, xmpPacket_)) {
+                auto decodeXmp = [this]() {
+                    if (xmpPacket_.size() > 0 && XmpParser::decode(xmpData_, xmpPacket_)) {
 #ifndef SUPPRESS_WARNINGS
-                    EXV_WARNING << "Failed to decode XMP metadata." << std::endl;
+                        EXV_WARNING << "Failed to decode XMP metadata." << std::endl;
 #endif
+                    }
+                };
+                if (parallelDecode()) {
+                    families.start(decodeXmp);
                 } else {
+                    decodeXmp();
 #ifdef DEBUG
                     std::cout << "Display Hex Dump [size:" << (unsigned long)payload.size_ << "]" << std::endl;
                     std::cout << Internal::binaryToHex(payload.pData_, payload.size_);
 #endif
                 }
+            } else if (hashing && (   equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_VP8)
+                                   || equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_VP8L)
+                                   || equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_ALPH)
+                                   || equalsWebPTag(chunkId, WEBP_CHUNK_HEADER_ANMF))) {
+                hashData(*io_, static_cast<long>(size), hash);
             } else {
                 io_->seek(size, BasicIo::cur);
             }
+            if (canvasOnly && has_canvas_data) return;
 
             if ( io_->tell() % 2 ) io_->seek(+1, BasicIo::cur);
         }
+        families.wait();
+        if (hashing) {
+            payloadHash_ = hash.value();
+            payloadHashDefined_ = true;
+        }
     }
 
     /* =========================================== */
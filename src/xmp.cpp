@@ -29,11 +29,17 @@
 #include "error.hpp"
 #include "value.hpp"
 #include "properties.hpp"
+#include "metadatum_int.hpp"
+#include "stats_int.hpp"
+#include "trace.hpp"
+#include "xmpscanner_int.hpp"
 
 // + standard includes
 #include <iostream>
 #include <algorithm>
 #include <cassert>
+#include <deque>
+#include <mutex>
 #include <string>
 
 // Adobe XMP Toolkit
@@ -57,6 +63,10 @@ namespace {
         explicit FindXmpdatum(const Exiv2::XmpKey& key) : key_(key.key())
         {
         }
+        //! Constructor, initializes the object with the key string
+        explicit FindXmpdatum(const std::string& key) : key_(key)
+        {
+        }
         /*!
           @brief Returns true if prefix and property of the argument
                  Xmpdatum are equal to that of the object.
@@ -70,6 +80,20 @@ namespace {
     }; // class FindXmpdatum
 
 #ifdef EXV_HAVE_XMP_TOOLKIT
+    //! An XMP node as returned by the XMP Toolkit iterator
+    struct XmpNode {
+        //! Constructor
+        XmpNode(const std::string& schemaNs,
+                const std::string& propPath,
+                const std::string& propValue,
+                XMP_OptionBits opt)
+            : schemaNs_(schemaNs), propPath_(propPath), propValue_(propValue), opt_(opt) {}
+        std::string schemaNs_;                  //!< Schema namespace
+        std::string propPath_;                  //!< Property path
+        std::string propValue_;                 //!< Property value
+        XMP_OptionBits opt_;                    //!< Option bits
+    };
+
     //! Convert XMP Toolkit struct option bit to Value::XmpStruct
     Exiv2::XmpValue::XmpStruct xmpStruct(const XMP_OptionBits& opt);
 
@@ -97,6 +121,15 @@ namespace {
     //! Make an XMP key from a schema namespace and property path
     Exiv2::XmpKey::UniquePtr makeXmpKey(const std::string& schemaNs,
                                       const std::string& propPath);
+
+    //! Return true if property \em name of namespace \em ns is an alias
+    bool isXmpAlias(const std::string& ns, const std::string& name);
+
+    /*!
+      @brief Return true if \em filter only accepts top-level XMP
+             properties, which the packet scanner can decode.
+     */
+    bool isScannable(const Exiv2::DecodeFilter& filter);
 #endif // EXV_HAVE_XMP_TOOLKIT
 
     //! Helper class used to serialize critical sections
@@ -125,6 +158,7 @@ namespace Exiv2 {
     //! Internal Pimpl structure of class Xmpdatum.
     struct Xmpdatum::Impl {
         Impl(const XmpKey& key, const Value* pValue);  //!< Constructor
+        Impl(const XmpKey& key, Value::UniquePtr value); //!< Constructor taking ownership of the value
         Impl(const Impl& rhs);                         //!< Copy constructor
         Impl& operator=(const Impl& rhs);              //!< Assignment
 
@@ -139,6 +173,11 @@ namespace Exiv2 {
         if (pValue) value_ = pValue->clone();
     }
 
+    Xmpdatum::Impl::Impl(const XmpKey& key, Value::UniquePtr value)
+        : key_(key.clone()), value_(std::move(value))
+    {
+    }
+
     Xmpdatum::Impl::Impl(const Impl& rhs)
     {
         if (rhs.key_.get() != 0) key_ = rhs.key_->clone(); // deep copy
@@ -165,11 +204,29 @@ namespace Exiv2 {
     {
     }
 
+    Xmpdatum::Xmpdatum(const XmpKey& key, Value::UniquePtr value)
+        : p_(new Impl(key, std::move(value)))
+    {
+    }
+
+    Xmpdatum::Xmpdatum(Xmpdatum&& rhs) noexcept
+        : Metadatum(rhs), p_(std::move(rhs.p_))
+    {
+    }
+
     Xmpdatum& Xmpdatum::operator=(const Xmpdatum& rhs)
     {
         if (this == &rhs) return *this;
         Metadatum::operator=(rhs);
-        *p_ = *rhs.p_;
+        // A moved-from %Xmpdatum has no Impl
+        if (p_.get() == 0) p_.reset(new Impl(*rhs.p_));
+        else *p_ = *rhs.p_;
+        return *this;
+    }
+
+    Xmpdatum& Xmpdatum::operator=(Xmpdatum&& rhs) noexcept
+    {
+        p_ = std::move(rhs.p_);
         return *this;
     }
 
@@ -309,13 +366,64 @@ namespace Exiv2 {
         return p_->value_->read(value);
     }
 
+    XmpData::XmpData()
+        : storage_(std::make_shared<Storage>()), usePacket_(false)
+    {
+    }
+
+    XmpData::XmpData(const XmpData& rhs)
+        : xmpPacket_(rhs.xmpPacket_), usePacket_(rhs.usePacket_), decodeFilter_(rhs.decodeFilter_)
+    {
+        // Another thread may hand out iterators of rhs, which stops the sharing
+        std::lock_guard<std::mutex> lock(rhs.mutex_);
+        if (rhs.storage_->shareable_) {
+            storage_ = rhs.storage_;
+        }
+        else {
+            storage_ = std::make_shared<Storage>(*rhs.storage_);
+            storage_->shareable_ = true;
+        }
+    }
+
+    XmpData& XmpData::operator=(const XmpData& rhs)
+    {
+        if (this == &rhs) return *this;
+        XmpData copy(rhs);
+        storage_.swap(copy.storage_);
+        xmpPacket_ = rhs.xmpPacket_;
+        usePacket_ = rhs.usePacket_;
+        decodeFilter_ = rhs.decodeFilter_;
+        return *this;
+    }
+
+    XmpData::Storage& XmpData::mutableStorage(bool leak) const
+    {
+        if (storage_.use_count() > 1) {
+            std::shared_ptr<Storage> storage = std::make_shared<Storage>(*storage_);
+            storage->shareable_ = true;
+            storage_.swap(storage);
+        }
+        if (leak) storage_->shareable_ = false;
+        return *storage_;
+    }
+
+    const XmpData::Storage& XmpData::iterableStorage() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return mutableStorage(true);
+    }
+
     Xmpdatum& XmpData::operator[](const std::string& key)
     {
-        XmpKey xmpKey(key);
-        iterator pos = findKey(xmpKey);
-        if (pos == end()) {
-            add(Xmpdatum(xmpKey));
-            pos = findKey(xmpKey);
+        return operator[](XmpKeyHandle(key));
+    }
+
+    Xmpdatum& XmpData::operator[](const XmpKeyHandle& key)
+    {
+        iterator pos = findKey(key);
+        if (pos == storage_->metadata_.end()) {
+            add(Xmpdatum(key.key()));
+            pos = storage_->metadata_.end() - 1;
         }
         return *pos;
     }
@@ -325,42 +433,104 @@ namespace Exiv2 {
         return add(Xmpdatum(key, value));
     }
 
+    int XmpData::add(const XmpKey& key, Value::UniquePtr value)
+    {
+        return add(Xmpdatum(key, std::move(value)));
+    }
+
     int XmpData::add(const Xmpdatum& xmpDatum)
     {
-        xmpMetadata_.push_back(xmpDatum);
+        return add(Xmpdatum(xmpDatum));
+    }
+
+    int XmpData::add(Xmpdatum&& xmpDatum)
+    {
+        Storage& storage = mutableStorage(false);
+        storage.metadata_.push_back(std::move(xmpDatum));
+        storage.index_.add(storage.metadata_.back().key(), storage.metadata_.size() - 1);
         return 0;
     }
 
     XmpData::const_iterator XmpData::findKey(const XmpKey& key) const
     {
-        return std::find_if(xmpMetadata_.begin(), xmpMetadata_.end(),
-                            FindXmpdatum(key));
+        iterableStorage();
+        return find(key.key());
     }
 
     XmpData::iterator XmpData::findKey(const XmpKey& key)
     {
-        return std::find_if(xmpMetadata_.begin(), xmpMetadata_.end(),
-                            FindXmpdatum(key));
+        return find(key.key());
+    }
+
+    XmpData::const_iterator XmpData::find(const std::string& k) const
+    {
+        const Storage& storage = *storage_;
+        if (storage.index_.valid()) {
+            const Index::Entry* entry = storage.index_.find(k);
+            if (entry == 0) return storage.metadata_.end();
+            const_iterator pos = storage.metadata_.begin() + entry->pos_;
+            if (pos->key() == k) return pos;
+        }
+        // No usable index, fall back to a linear search
+        return std::find_if(storage.metadata_.begin(), storage.metadata_.end(),
+                            FindXmpdatum(k));
+    }
+
+    XmpData::iterator XmpData::find(const std::string& k)
+    {
+        Storage& storage = mutableStorage(true);
+        if (!storage.index_.valid()) storage.indexRebuild();
+        const Index::Entry* entry = storage.index_.find(k);
+        if (entry == 0) return storage.metadata_.end();
+        if (storage.metadata_[entry->pos_].key() != k) {
+            // The key of the indexed Xmpdatum was changed, rebuild the index
+            storage.indexRebuild();
+            entry = storage.index_.find(k);
+            if (entry == 0) return storage.metadata_.end();
+        }
+        return storage.metadata_.begin() + entry->pos_;
     }
 
     void XmpData::clear()
     {
-        xmpMetadata_.clear();
+        // Start from new storage, copies which share the old one keep it.
+        // Decoders only add metadata, the index is built by the first lookup
+        storage_ = std::make_shared<Storage>();
     }
 
     void XmpData::sortByKey()
     {
-        std::sort(xmpMetadata_.begin(), xmpMetadata_.end(), cmpMetadataByKey);
+        Storage& storage = mutableStorage(false);
+        Internal::sortMetadata(storage.metadata_, [](const Xmpdatum& md) { return md.key(); });
+        storage.index_.invalidate();
     }
 
     XmpData::const_iterator XmpData::begin() const
     {
-        return xmpMetadata_.begin();
+        return iterableStorage().metadata_.begin();
     }
 
     XmpData::const_iterator XmpData::end() const
     {
-        return xmpMetadata_.end();
+        return iterableStorage().metadata_.end();
+    }
+
+    MemoryUsage XmpData::memoryUsage() const
+    {
+        MemoryUsage usage;
+        const XmpMetadata& metadata = storage_->metadata_;
+        // Each Xmpdatum holds an implementation with the pointers to its key and value
+        usage.datums_ += metadata.capacity() * sizeof(Xmpdatum) + metadata.size() * 2 * sizeof(void*);
+        const Index::Map& index = storage_->index_.map();
+        usage.datums_ += Internal::hashMapMemory(index);
+        for (Index::Map::const_iterator i = index.begin(); i != index.end(); ++i) {
+            usage.datums_ += i->first.capacity();
+        }
+        for (const_iterator i = metadata.begin(); i != metadata.end(); ++i) {
+            Internal::addDatumMemory(usage, *i, sizeof(XmpKey));
+        }
+        usage.buffers_ += xmpPacket_.capacity();
+        return usage;
     }
 
     bool XmpData::empty() const
@@ -370,21 +540,29 @@ namespace Exiv2 {
 
     long XmpData::count() const
     {
-        return static_cast<long>(xmpMetadata_.size());
+        return static_cast<long>(storage_->metadata_.size());
     }
 
     XmpData::iterator XmpData::begin()
     {
-        return xmpMetadata_.begin();
+        Storage& storage = mutableStorage(true);
+        storage.index_.invalidate();
+        return storage.metadata_.begin();
     }
 
     XmpData::iterator XmpData::end()
     {
-        return xmpMetadata_.end();
+        return mutableStorage(true).metadata_.end();
     }
 
     XmpData::iterator XmpData::erase(XmpData::iterator pos) {
-        return xmpMetadata_.erase(pos);
+        // The iterator was handed out by a mutable accessor, the storage is not shared
+        Storage& storage = mutableStorage(true);
+        // The metadata after pos move, updating their positions would take quadratic time for many erasures
+        if (pos + 1 != storage.metadata_.end()) storage.index_.invalidate();
+        else storage.index_.erase(pos->key(), pos - storage.metadata_.begin(),
+                                  [](XmpMetadata::size_type&) { return false; });
+        return storage.metadata_.erase(pos);
     }
 
     void XmpData::eraseFamily(XmpData::iterator& pos)
@@ -399,7 +577,7 @@ namespace Exiv2 {
         // https://github.com/Exiv2/exiv2/issues/560
         std::string         key(pos->key());
         Exiv2::StringVector keys;
-        while ( pos != xmpMetadata_.end() ) {
+        while ( pos != storage_->metadata_.end() ) {
             if ( pos->key().find(key)==0 ) {
                 keys.push_back(pos->key());
                 pos++;
@@ -413,14 +591,22 @@ namespace Exiv2 {
         }
     }
 
+    void XmpData::Storage::indexRebuild()
+    {
+        index_.rebuild(0, metadata_.size(), [this](XmpMetadata::size_type pos) { return metadata_[pos].key(); });
+    }
+
 
     bool XmpParser::initialized_ = false;
     XmpParser::XmpLockFct XmpParser::xmpLockFct_ = 0;
     void* XmpParser::pLockData_ = 0;
+    //! Serializes initialize() and terminate(), decoders initialize the toolkit on first use
+    static std::mutex initMutex;
 
 #ifdef EXV_HAVE_XMP_TOOLKIT
     bool XmpParser::initialize(XmpParser::XmpLockFct xmpLockFct, void* pLockData)
     {
+        std::lock_guard<std::mutex> lock(initMutex);
         if (!initialized_) {
             xmpLockFct_ = xmpLockFct;
             pLockData_ = pLockData;
@@ -478,6 +664,7 @@ namespace Exiv2 {
 #else
     bool XmpParser::initialize(XmpParser::XmpLockFct, void* )
     {
+        std::lock_guard<std::mutex> lock(initMutex);
         initialized_ = true;
         return initialized_;
     }
@@ -541,6 +728,7 @@ namespace Exiv2 {
     void XmpParser::terminate()
     {
         XmpProperties::unregisterNs();
+        std::lock_guard<std::mutex> lock(initMutex);
         if (initialized_) {
 #ifdef EXV_HAVE_XMP_TOOLKIT
             SXMPMeta::Terminate();
@@ -556,6 +744,16 @@ namespace Exiv2 {
         try {
             initialize();
             AutoLock autoLock(xmpLockFct_, pLockData_);
+            // Leave a namespace that is already registered with this prefix
+            // alone, other threads may be using it while it is replaced.
+            std::string registeredPrefix;
+            std::string registeredNs;
+            if (   SXMPMeta::GetNamespacePrefix(ns.c_str(), &registeredPrefix)
+                && registeredPrefix == prefix + ":"
+                && SXMPMeta::GetNamespaceURI(prefix.c_str(), &registeredNs)
+                && registeredNs == ns) {
+                return;
+            }
             SXMPMeta::DeleteNamespace(ns.c_str());
 #ifdef EXV_ADOBE_XMPSDK
             SXMPMeta::RegisterNamespace(ns.c_str(), prefix.c_str(),nullptr);
@@ -591,10 +789,20 @@ namespace Exiv2 {
 #ifdef EXV_HAVE_XMP_TOOLKIT
     int XmpParser::decode(      XmpData&     xmpData,
                           const std::string& xmpPacket)
-    { try {
+    {
+        return decode(xmpData, reinterpret_cast<const byte*>(xmpPacket.data()), static_cast<long>(xmpPacket.size()));
+    } // XmpParser::decode
+
+    int XmpParser::decode(XmpData& xmpData, const byte* pData, long size)
+    {
+        Internal::PhaseTimer timer(&IoStats::xmpDecodeTime_);
+        Trace trace("xmp-parse", "XMP packet");
+        try {
         xmpData.clear();
-        xmpData.setPacket(xmpPacket);
-        if (xmpPacket.empty()) return 0;
+        Internal::ParseBudget::chargeAllocation(size);
+        xmpData.setPacket(std::string(reinterpret_cast<const char*>(pData), size));
+        if (size == 0) return 0;
+        const std::string& xmpPacket = xmpData.xmpPacket();
 
         if (!initialize()) {
 #ifndef SUPPRESS_WARNINGS
@@ -603,12 +811,36 @@ namespace Exiv2 {
             return 2;
         }
 
-        SXMPMeta meta(xmpPacket.data(), static_cast<XMP_StringLen>(xmpPacket.size()));
+        // Queries for a few top-level properties don't need the XMP Toolkit
+        const DecodeFilter& filter = xmpData.decodeFilter();
+        if (   isScannable(filter)
+            && Internal::scanXmpPacket(xmpData, xmpPacket, filter.keys(), isXmpAlias)) {
+            return 0;
+        }
+
+        // Expat parses the slice itself, ParseFromBuffer passes a single final buffer through
+        SXMPMeta meta(reinterpret_cast<const char*>(pData), static_cast<XMP_StringLen>(size));
         SXMPIterator iter(meta);
         std::string schemaNs, propPath, propValue;
         XMP_OptionBits opt;
-        while (iter.Next(&schemaNs, &propPath, &propValue, &opt)) {
-            printNode(schemaNs, propPath, propValue, opt);
+        // Nodes already taken from the iterator, to be processed before the next one
+        std::deque<XmpNode> pending;
+        for (;;) {
+            Internal::ParseBudget::checkDeadline();
+            if (!pending.empty()) {
+                schemaNs.swap(pending.front().schemaNs_);
+                propPath.swap(pending.front().propPath_);
+                propValue.swap(pending.front().propValue_);
+                opt = pending.front().opt_;
+                pending.pop_front();
+            }
+            else if (iter.Next(&schemaNs, &propPath, &propValue, &opt)) {
+                printNode(schemaNs, propPath, propValue, opt);
+                Internal::ParseBudget::chargeAllocation(propPath.size() + propValue.size());
+            }
+            else {
+                break;
+            }
             if (XMP_PropIsAlias(opt)) {
                 throw Error(kerAliasesNotSupported, schemaNs, propPath, propValue);
                 continue;
@@ -626,6 +858,13 @@ namespace Exiv2 {
                 continue;
             }
             XmpKey::UniquePtr key = makeXmpKey(schemaNs, propPath);
+            if (!filter.empty() && !filter.accepts(*key)) {
+                // Skip the node together with its fields and qualifiers. Pending
+                // nodes are simple, only the last one can have a subtree, and it
+                // is the one the iterator stopped at.
+                if (pending.empty()) iter.Skip(kXMP_IterSkipSubtree);
+                continue;
+            }
             if (XMP_ArrayIsAltText(opt)) {
                 // Read Lang Alt property
                 LangAltValue::UniquePtr val(new LangAltValue);
@@ -651,40 +890,35 @@ namespace Exiv2 {
                     }
                     val->value_[propValue] = text;
                 }
-                xmpData.add(*key.get(), val.get());
+                xmpData.add(*key.get(), std::move(val));
                 continue;
             }
             if (    XMP_PropIsArray(opt)
                 && !XMP_PropHasQualifiers(opt)
                 && !XMP_ArrayIsAltText(opt)) {
-                // Check if all elements are simple
-                bool simpleArray = true;
-                SXMPIterator aIter(meta, schemaNs.c_str(), propPath.c_str());
-                std::string aSchemaNs, aPropPath, aPropValue;
-                XMP_OptionBits aOpt;
-                while (aIter.Next(&aSchemaNs, &aPropPath, &aPropValue, &aOpt)) {
-                    if (propPath == aPropPath) continue;
-                    if (   !XMP_PropIsSimple(aOpt)
-                        ||  XMP_PropHasQualifiers(aOpt)
-                        ||  XMP_PropIsQualifier(aOpt)
-                        ||  XMP_NodeIsSchema(aOpt)
-                        ||  XMP_PropIsAlias(aOpt)) {
-                        simpleArray = false;
+                // Read the items into an XmpArrayValue as long as they are simple.
+                // The items are kept until the end of the array, if one of them
+                // is not simple, the array is decoded node by node after all.
+                const XMP_OptionBits arrayOpt = opt;
+                XmpArrayValue::UniquePtr val(new XmpArrayValue(arrayValueTypeId(arrayOpt)));
+                XMP_Index count = meta.CountArrayItems(schemaNs.c_str(), propPath.c_str());
+                while (count-- > 0 && iter.Next(&schemaNs, &propPath, &propValue, &opt)) {
+                    printNode(schemaNs, propPath, propValue, opt);
+                    pending.push_back(XmpNode(schemaNs, propPath, propValue, opt));
+                    if (   !XMP_PropIsSimple(opt)
+                        ||  XMP_PropHasQualifiers(opt)) {
                         break;
                     }
+                    val->read(propValue);
                 }
-                if (simpleArray) {
-                    // Read the array into an XmpArrayValue
-                    XmpArrayValue::UniquePtr val(new XmpArrayValue(arrayValueTypeId(opt)));
-                    XMP_Index count = meta.CountArrayItems(schemaNs.c_str(), propPath.c_str());
-                    while (count-- > 0) {
-                        iter.Next(&schemaNs, &propPath, &propValue, &opt);
-                        printNode(schemaNs, propPath, propValue, opt);
-                        val->read(propValue);
-                    }
-                    xmpData.add(*key.get(), val.get());
+                if (   pending.empty()
+                    || (   XMP_PropIsSimple(pending.back().opt_)
+                        && !XMP_PropHasQualifiers(pending.back().opt_))) {
+                    pending.clear();
+                    xmpData.add(*key.get(), std::move(val));
                     continue;
                 }
+                opt = arrayOpt;
             }
             XmpTextValue::UniquePtr val(new XmpTextValue);
             if (   XMP_PropIsStruct(opt)
@@ -692,13 +926,13 @@ namespace Exiv2 {
                 // Create a metadatum with only XMP options
                 val->setXmpArrayType(xmpArrayType(opt));
                 val->setXmpStruct(xmpStruct(opt));
-                xmpData.add(*key.get(), val.get());
+                xmpData.add(*key.get(), std::move(val));
                 continue;
             }
             if (   XMP_PropIsSimple(opt)
                 || XMP_PropIsQualifier(opt)) {
                 val->read(propValue);
-                xmpData.add(*key.get(), val.get());
+                xmpData.add(*key.get(), std::move(val));
                 continue;
             }
             // Don't let any node go by unnoticed
@@ -732,6 +966,11 @@ namespace Exiv2 {
         }
         return 1;
     } // XmpParser::decode
+
+    int XmpParser::decode(XmpData& xmpData, const byte* pData, long size)
+    {
+        return decode(xmpData, std::string(reinterpret_cast<const char*>(pData), size));
+    } // XmpParser::decode
 #endif // !EXV_HAVE_XMP_TOOLKIT
 
 #ifdef EXV_HAVE_XMP_TOOLKIT
@@ -739,7 +978,9 @@ namespace Exiv2 {
                           const XmpData&     xmpData,
                                 uint16_t     formatFlags,
                                 uint32_t     padding)
-    { try {
+    {
+        Trace trace("encode", "XMP packet");
+        try {
         if (xmpData.empty()) {
             xmpPacket.clear();
             return 0;
@@ -752,16 +993,20 @@ namespace Exiv2 {
             return 2;
         }
         // Register custom namespaces with XMP-SDK
-        for (XmpProperties::NsRegistry::iterator i = XmpProperties::nsRegistry_.begin();
-             i != XmpProperties::nsRegistry_.end(); ++i) {
+        {
+            std::lock_guard<std::mutex> scoped_read_lock(XmpProperties::mutex_);
+            for (XmpProperties::NsRegistry::iterator i = XmpProperties::nsRegistry_.begin();
+                 i != XmpProperties::nsRegistry_.end(); ++i) {
 #ifdef DEBUG
-            std::cerr << "Registering " << i->second.prefix_ << " : " << i->first << "\n";
+                std::cerr << "Registering " << i->second.prefix_ << " : " << i->first << "\n";
 #endif
-            registerNs(i->first, i->second.prefix_);
+                registerNs(i->first, i->second.prefix_);
+            }
         }
         SXMPMeta meta;
         for (XmpData::const_iterator i = xmpData.begin(); i != xmpData.end(); ++i) {
             const std::string ns = XmpProperties::ns(i->groupName());
+            const std::string tagName = i->tagName();
             XMP_OptionBits options = 0;
 
             if (i->typeId() == langAlt) {
@@ -776,9 +1021,9 @@ namespace Exiv2 {
                     ; ++k
                 ) {
                     if ( k->second.size() ) { // remove lang specs with no value
-                        printNode(ns, i->tagName(), k->second, 0);
-                        meta.AppendArrayItem(ns.c_str(), i->tagName().c_str(), kXMP_PropArrayIsAlternate, k->second.c_str());
-                        const std::string item = i->tagName() + "[" + toString(idx++) + "]";
+                        printNode(ns, tagName, k->second, 0);
+                        meta.AppendArrayItem(ns.c_str(), tagName.c_str(), kXMP_PropArrayIsAlternate, k->second.c_str());
+                        const std::string item = tagName + "[" + toString(idx++) + "]";
                         meta.SetQualifier(ns.c_str(), item.c_str(), kXMP_NS_XML, "lang", k->first.c_str());
                     }
                 }
@@ -793,23 +1038,28 @@ namespace Exiv2 {
             if (   i->typeId() == xmpBag
                 || i->typeId() == xmpSeq
                 || i->typeId() == xmpAlt) {
-                printNode(ns, i->tagName(), "", options);
-                meta.SetProperty(ns.c_str(), i->tagName().c_str(), 0, options);
-                for (int idx = 0; idx < i->count(); ++idx) {
-                    const std::string item = i->tagName() + "[" + toString(idx + 1) + "]";
-                    printNode(ns, item, i->toString(idx), 0);
-                    meta.SetProperty(ns.c_str(), item.c_str(), i->toString(idx).c_str());
+                printNode(ns, tagName, "", options);
+                meta.SetProperty(ns.c_str(), tagName.c_str(), 0, options);
+                // Set the items by index, which saves composing and parsing an item path for each
+                const long count = i->count();
+                for (long idx = 0; idx < count; ++idx) {
+                    const std::string item = i->toString(idx);
+#ifdef DEBUG
+                    printNode(ns, tagName + "[" + toString(idx + 1) + "]", item, 0);
+#endif
+                    meta.SetArrayItem(ns.c_str(), tagName.c_str(), static_cast<XMP_Index>(idx + 1), item.c_str());
                 }
                 continue;
             }
             if (i->typeId() == xmpText) {
                 if (i->count() == 0) {
-                    printNode(ns, i->tagName(), "", options);
-                    meta.SetProperty(ns.c_str(), i->tagName().c_str(), 0, options);
+                    printNode(ns, tagName, "", options);
+                    meta.SetProperty(ns.c_str(), tagName.c_str(), 0, options);
                 }
                 else {
-                    printNode(ns, i->tagName(), i->toString(0), options);
-                    meta.SetProperty(ns.c_str(), i->tagName().c_str(), i->toString(0).c_str(), options);
+                    const std::string value = i->toString(0);
+                    printNode(ns, tagName, value, options);
+                    meta.SetProperty(ns.c_str(), tagName.c_str(), value.c_str(), options);
                 }
                 continue;
             }
@@ -818,7 +1068,7 @@ namespace Exiv2 {
         }
         std::string tmpPacket;
         meta.SerializeToBuffer(&tmpPacket, xmpFormatOptionBits(static_cast<XmpFormatFlags>(formatFlags)), padding); // throws
-        xmpPacket = tmpPacket;
+        xmpPacket.swap(tmpPacket);
 
         return 0;
     }
@@ -992,6 +1242,29 @@ namespace {
         }
         return Exiv2::XmpKey::UniquePtr(new Exiv2::XmpKey(prefix, property));
     } // makeXmpKey
+
+    bool isXmpAlias(const std::string& ns, const std::string& name)
+    {
+        try {
+            XMP_OptionBits arrayForm = 0;
+            return SXMPMeta::ResolveAlias(ns.c_str(), name.c_str(), 0, 0, &arrayForm);
+        }
+        catch (const XMP_Error&) {
+            // Let the XMP Toolkit decide while parsing the packet
+            return true;
+        }
+    }
+
+    bool isScannable(const Exiv2::DecodeFilter& filter)
+    {
+        if (!filter.hasKeysOnly()) return false;
+        const std::set<std::string>& keys = filter.keys();
+        for (std::set<std::string>::const_iterator k = keys.begin(); k != keys.end(); ++k) {
+            if (   k->compare(0, 4, "Xmp.") != 0
+                || k->find_first_of("/[", 4) != std::string::npos) return false;
+        }
+        return true;
+    }
 #endif // EXV_HAVE_XMP_TOOLKIT
 
 }
@@ -0,0 +1,655 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+// *****************************************************************************
+// included header files
+#include "config.h"
+
+#include "xmpscanner_int.hpp"
+#include "futils.hpp"
+#include "xmp_exiv2.hpp"
+#include "properties.hpp"
+#include "value.hpp"
+
+// + standard includes
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+// *****************************************************************************
+// local declarations
+namespace {
+
+    const char rdfNs[]    = "http://www.w3.org/1999/02/22-rdf-syntax-ns#";
+    const char xmlNs[]    = "http://www.w3.org/XML/1998/namespace";
+    const char dcNs[]     = "http://purl.org/dc/elements/1.1/";
+    const char exifNs[]   = "http://ns.adobe.com/exif/1.0/";
+    const char rightsNs[] = "http://ns.adobe.com/xap/1.0/rights/";
+    const char dmNs[]     = "http://ns.adobe.com/xmp/1.0/DynamicMedia/";
+
+    //! Thrown when the packet uses something the scanner does not handle
+    struct Unsupported {};
+
+    //! The value of a requested property
+    struct Property {
+        //! Form of the value
+        enum Form { simple, array, langAlt };
+        //! An array item, with its xml:lang qualifier for language alternatives
+        typedef std::pair<std::string, std::string> Item;
+
+        std::string prefix_;                    //!< Exiv2 prefix of the schema
+        std::string name_;                      //!< Property name
+        size_t schema_;                         //!< Position of the schema in the XMP tree
+        Form form_;                             //!< Form of the value
+        Exiv2::TypeId arrayType_;               //!< xmpBag, xmpSeq or xmpAlt for arrays
+        std::string value_;                     //!< Value of a simple property
+        std::vector<Item> items_;               //!< Items of an array or language alternative
+    };
+
+    //! Return true if \em c is XML whitespace
+    bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    //! Return true if \em s consists of XML whitespace only
+    bool isSpace(const std::string& s)
+    {
+        for (std::string::const_iterator i = s.begin(); i != s.end(); ++i) {
+            if (!isSpace(*i)) return false;
+        }
+        return true;
+    }
+
+    /*!
+      @brief Return true if \em packet is valid UTF-8 without the control
+             characters the XMP Toolkit replaces while parsing.
+     */
+    bool isPlainUtf8(const std::string& packet)
+    {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(packet.data());
+        const unsigned char* end = p + packet.size();
+        while (p < end) {
+            const unsigned char c = *p++;
+            if (c < 0x80) {
+                if ((c < 0x20 && c != '\t' && c != '\n' && c != '\r') || c == 0x7f) return false;
+                continue;
+            }
+            int n = 0;
+            uint32_t cp = 0;
+            if      ((c & 0xe0) == 0xc0) { n = 1; cp = c & 0x1f; }
+            else if ((c & 0xf0) == 0xe0) { n = 2; cp = c & 0x0f; }
+            else if ((c & 0xf8) == 0xf0) { n = 3; cp = c & 0x07; }
+            else return false;
+            if (end - p < n) return false;
+            for (int i = 0; i < n; ++i, ++p) {
+                if ((*p & 0xc0) != 0x80) return false;
+                cp = (cp << 6) | (*p & 0x3f);
+            }
+            // Overlong forms, surrogates and values beyond Unicode
+            if (   (n == 1 && cp < 0x80) || (n == 2 && cp < 0x800) || (n == 3 && cp < 0x10000)
+                || (cp >= 0xd800 && cp <= 0xdfff) || cp > 0x10ffff) return false;
+        }
+        return true;
+    }
+
+    //! Normalize an xml:lang value the way the XMP Toolkit does
+    void normalizeLang(std::string& lang)
+    {
+        std::string::size_type start = 0;
+        for (int subtag = 0; start <= lang.size(); ++subtag) {
+            std::string::size_type end = lang.find('-', start);
+            if (end == std::string::npos) end = lang.size();
+            // 2-letter secondary subtags are upper case, everything else lower case
+            const bool upper = subtag == 1 && end - start == 2;
+            for (std::string::size_type i = start; i < end; ++i) {
+                if (upper && lang[i] >= 'a' && lang[i] <= 'z') lang[i] -= 0x20;
+                if (!upper && lang[i] >= 'A' && lang[i] <= 'Z') lang[i] += 0x20;
+            }
+            start = end + 1;
+        }
+    }
+
+    /*!
+      @brief Scanner for the top-level properties of an XMP packet. Throws
+             Unsupported for anything it does not handle.
+     */
+    class Scanner {
+    public:
+        //! Constructor
+        Scanner(const std::string& packet,
+                const std::set<std::string>& keys,
+                Exiv2::Internal::XmpAliasFct isAlias);
+        //! Scan the packet, collecting the requested properties in properties_
+        void scan();
+
+        std::vector<Property> properties_;      //!< Requested properties in packet order
+
+    private:
+        //! An attribute, other than a namespace declaration
+        struct Attribute {
+            std::string ns_;                    //!< Namespace URI, empty for none
+            std::string name_;                  //!< Local name
+            std::string value_;                 //!< Value with references replaced
+        };
+        //! XML tokens
+        enum Token { tkStart, tkEnd, tkText, tkEof };
+
+        //! Read the next token, resolving namespaces and matching end tags
+        Token read();
+        //! Read the next token from the packet
+        Token lex();
+        //! Read a name at the current position
+        std::string lexName();
+        //! Replace references and normalize line ends of the text [\em first, \em last)
+        void decodeText(const char* first, const char* last, bool attribute, std::string& out);
+        //! Return the namespace URI of the qualified name \em qname, setting \em local
+        std::string resolve(const std::string& qname, std::string& local, bool element) const;
+
+        void parseRdf();
+        void parseDescription();
+        void parsePropertyElement();
+        void parseValue(Property& property, const std::string& ns);
+        void parseArray(Property& property);
+        void skipElement();
+        //! Register a top-level property, return the entry to fill if it is requested
+        Property* addProperty(const std::string& ns, const std::string& name);
+
+        // DATA
+        const char* pos_;                       //!< Current position in the packet
+        const char* end_;                       //!< End of the packet
+        const std::set<std::string>& keys_;     //!< Requested keys
+        Exiv2::Internal::XmpAliasFct isAlias_;  //!< Alias test
+
+        // Current token
+        std::string qname_;                     //!< Qualified name of a start or end tag
+        std::string ns_;                        //!< Namespace URI of a start tag
+        std::string name_;                      //!< Local name of a start tag
+        std::vector<Attribute> attributes_;     //!< Attributes of a start tag
+        std::string text_;                      //!< Text
+        bool emptyTag_;                         //!< True if the start tag closes itself
+
+        // Element and namespace scopes
+        std::vector<std::string> elements_;     //!< Qualified names of the open elements
+        std::map<std::string, std::string> prefixes_; //!< Namespace URIs by prefix
+        std::vector<std::pair<std::string, std::string> > undo_; //!< Replaced bindings, "\n" if unbound
+        std::vector<size_t> scopes_;            //!< Size of undo_ at each open element
+        bool pendingEnd_;                       //!< End tag of an empty element due
+        int roots_;                             //!< Number of root elements
+
+        // Top-level properties
+        std::set<std::string> seen_;            //!< Namespace URI and name of all properties
+        std::vector<std::string> schemas_;      //!< Namespace URIs in the order of appearance
+        std::map<std::string, std::string> exiv2Prefixes_; //!< Exiv2 prefixes by namespace URI
+        std::string about_;                     //!< Value of non-empty rdf:about attributes
+    };
+
+}
+
+// *****************************************************************************
+// class member definitions
+namespace {
+
+    Scanner::Scanner(const std::string& packet,
+                     const std::set<std::string>& keys,
+                     Exiv2::Internal::XmpAliasFct isAlias)
+        : pos_(packet.data()), end_(packet.data() + packet.size()), keys_(keys), isAlias_(isAlias),
+          emptyTag_(false), pendingEnd_(false), roots_(0)
+    {
+        prefixes_["xml"] = xmlNs;
+    }
+
+    void Scanner::scan()
+    {
+        int rdfs = 0;
+        for (Token t = read(); t != tkEof; t = read()) {
+            if (t == tkText) {
+                if (elements_.empty() && !isSpace(text_)) throw Unsupported();
+                continue;
+            }
+            if (t == tkStart && ns_ == rdfNs && name_ == "RDF") {
+                if (++rdfs > 1) throw Unsupported();
+                parseRdf();
+            }
+        }
+        if (rdfs != 1 || !elements_.empty()) throw Unsupported();
+        // An rdf:about UUID becomes xmpMM:InstanceID
+        if (!about_.empty() && keys_.count("Xmp.xmpMM.InstanceID") > 0) throw Unsupported();
+        // Properties are grouped by schema in the XMP tree
+        std::stable_sort(properties_.begin(), properties_.end(),
+                         [](const Property& lhs, const Property& rhs) { return lhs.schema_ < rhs.schema_; });
+    }
+
+    void Scanner::parseRdf()
+    {
+        if (!attributes_.empty()) throw Unsupported();
+        for (;;) {
+            Token t = read();
+            if (t == tkEnd) return;
+            if (t == tkText && isSpace(text_)) continue;
+            if (t != tkStart || ns_ != rdfNs || name_ != "Description") throw Unsupported();
+            parseDescription();
+        }
+    }
+
+    void Scanner::parseDescription()
+    {
+        for (std::vector<Attribute>::const_iterator a = attributes_.begin(); a != attributes_.end(); ++a) {
+            if (a->ns_ == rdfNs && a->name_ == "about") {
+                if (!a->value_.empty()) {
+                    // The XMP Toolkit rejects different rdf:about values
+                    if (!about_.empty() && about_ != a->value_) throw Unsupported();
+                    about_ = a->value_;
+                }
+                continue;
+            }
+            if (a->ns_.empty() || a->ns_ == rdfNs || a->ns_ == xmlNs) throw Unsupported();
+            Property* property = addProperty(a->ns_, a->name_);
+            if (property) {
+                property->form_ = Property::simple;
+                property->value_ = a->value_;
+            }
+        }
+        for (;;) {
+            Token t = read();
+            if (t == tkEnd) return;
+            if (t == tkText) {
+                if (!isSpace(text_)) throw Unsupported();
+                continue;
+            }
+            parsePropertyElement();
+        }
+    }
+
+    void Scanner::parsePropertyElement()
+    {
+        if (ns_.empty() || ns_ == rdfNs || !attributes_.empty()) throw Unsupported();
+        Property* property = addProperty(ns_, name_);
+        if (property) {
+            parseValue(*property, ns_);
+        }
+        else {
+            skipElement();
+        }
+    }
+
+    void Scanner::parseValue(Property& property, const std::string& ns)
+    {
+        std::string text;
+        bool array = false;
+        for (;;) {
+            Token t = read();
+            if (t == tkEnd) break;
+            if (t == tkText) {
+                text += text_;
+                continue;
+            }
+            // A single array element, surrounded by whitespace
+            if (array || !isSpace(text)) throw Unsupported();
+            array = true;
+            parseArray(property);
+        }
+        if (!array) {
+            property.form_ = Property::simple;
+            property.value_ = text;
+        }
+        else if (!isSpace(text)) {
+            throw Unsupported();
+        }
+
+        // Properties which the XMP Toolkit normalizes after parsing
+        const bool simple = property.form_ == Property::simple;
+        const bool plainArray = property.form_ == Property::array;
+        if (ns == dcNs) {
+            static const char* dcArrays[] = {
+                "contributor", "creator", "date", "description", "language",
+                "publisher", "relation", "rights", "subject", "title", "type"
+            };
+            const char** const last = dcArrays + sizeof(dcArrays) / sizeof(dcArrays[0]);
+            if (simple && std::find(dcArrays, last, property.name_) != last) throw Unsupported();
+            if (   property.name_ == "subject"
+                && !(plainArray && property.arrayType_ == Exiv2::xmpBag)) throw Unsupported();
+            if (   (property.name_ == "description" || property.name_ == "rights" || property.name_ == "title")
+                && plainArray) throw Unsupported();
+        }
+        if (ns == rightsNs && property.name_ == "UsageTerms" && plainArray) throw Unsupported();
+    }
+
+    void Scanner::parseArray(Property& property)
+    {
+        if (ns_ != rdfNs || !attributes_.empty()) throw Unsupported();
+        if      (name_ == "Bag") property.arrayType_ = Exiv2::xmpBag;
+        else if (name_ == "Seq") property.arrayType_ = Exiv2::xmpSeq;
+        else if (name_ == "Alt") property.arrayType_ = Exiv2::xmpAlt;
+        else throw Unsupported();
+
+        size_t langs = 0;
+        std::set<std::string> seenLangs;
+        for (;;) {
+            Token t = read();
+            if (t == tkEnd) break;
+            if (t == tkText) {
+                if (!isSpace(text_)) throw Unsupported();
+                continue;
+            }
+            if (ns_ != rdfNs || name_ != "li" || attributes_.size() > 1) throw Unsupported();
+            Property::Item item;
+            if (attributes_.size() == 1) {
+                if (attributes_[0].ns_ != xmlNs || attributes_[0].name_ != "lang") throw Unsupported();
+                item.first = attributes_[0].value_;
+                normalizeLang(item.first);
+                if (!seenLangs.insert(item.first).second) throw Unsupported();
+                ++langs;
+            }
+            for (t = read(); t == tkText; t = read()) {
+                item.second += text_;
+            }
+            if (t != tkEnd) throw Unsupported();
+            property.items_.push_back(item);
+        }
+
+        property.form_ = Property::array;
+        if (langs == 0) return;
+        // Items with a language make a language alternative, if all of them have one
+        if (property.arrayType_ != Exiv2::xmpAlt || langs != property.items_.size()) throw Unsupported();
+        property.form_ = Property::langAlt;
+    }
+
+    void Scanner::skipElement()
+    {
+        for (size_t depth = 1; depth > 0; ) {
+            Token t = read();
+            if (t == tkStart) ++depth;
+            if (t == tkEnd) --depth;
+            if (t == tkEof) throw Unsupported();
+        }
+    }
+
+    Property* Scanner::addProperty(const std::string& ns, const std::string& name)
+    {
+        // The XMP Toolkit rejects duplicate properties and moves aliases
+        if (!seen_.insert(ns + '\n' + name).second) throw Unsupported();
+        if (isAlias_(ns, name)) throw Unsupported();
+        // The audio copyright is moved to dc:rights
+        if (ns == dmNs && name == "copyright") throw Unsupported();
+
+        std::map<std::string, std::string>::const_iterator i = exiv2Prefixes_.find(ns);
+        if (i == exiv2Prefixes_.end()) {
+            // Unknown namespaces are registered while decoding
+            const std::string prefix = Exiv2::XmpProperties::prefix(ns);
+            if (prefix.empty()) throw Unsupported();
+            i = exiv2Prefixes_.insert(std::make_pair(ns, prefix)).first;
+            schemas_.push_back(ns);
+        }
+        if (keys_.count("Xmp." + i->second + "." + name) == 0) return 0;
+        if (ns == exifNs && (name == "UserComment" || name == "GPSTimeStamp")) throw Unsupported();
+
+        Property property;
+        property.prefix_ = i->second;
+        property.name_ = name;
+        property.schema_ = std::find(schemas_.begin(), schemas_.end(), ns) - schemas_.begin();
+        property.form_ = Property::simple;
+        property.arrayType_ = Exiv2::invalidTypeId;
+        properties_.push_back(property);
+        return &properties_.back();
+    }
+
+    Scanner::Token Scanner::read()
+    {
+        if (pendingEnd_) {
+            pendingEnd_ = false;
+        }
+        else {
+            const Token t = lex();
+            if (t != tkEnd) {
+                if (t != tkStart) return t;
+                // Bind the namespaces declared by the element, then resolve its names
+                scopes_.push_back(undo_.size());
+                std::vector<Attribute> attributes;
+                for (std::vector<Attribute>::iterator a = attributes_.begin(); a != attributes_.end(); ++a) {
+                    if (a->name_ == "xmlns") throw Unsupported();
+                    if (a->name_.compare(0, 6, "xmlns:") == 0) {
+                        const std::string prefix = a->name_.substr(6);
+                        if (prefix.empty() || a->value_.empty() || prefix == "xml") throw Unsupported();
+                        std::map<std::string, std::string>::iterator p = prefixes_.find(prefix);
+                        undo_.push_back(std::make_pair(prefix, p == prefixes_.end() ? std::string("\n") : p->second));
+                        prefixes_[prefix] = a->value_;
+                        continue;
+                    }
+                    attributes.push_back(*a);
+                }
+                for (std::vector<Attribute>::iterator a = attributes.begin(); a != attributes.end(); ++a) {
+                    std::string local;
+                    a->ns_ = resolve(a->name_, local, false);
+                    a->name_ = local;
+                }
+                attributes_.swap(attributes);
+                ns_ = resolve(qname_, name_, true);
+                if (elements_.empty() && ++roots_ > 1) throw Unsupported();
+                elements_.push_back(qname_);
+                pendingEnd_ = emptyTag_;
+                return tkStart;
+            }
+            if (elements_.empty() || elements_.back() != qname_) throw Unsupported();
+        }
+        elements_.pop_back();
+        for (size_t n = scopes_.back(); undo_.size() > n; undo_.pop_back()) {
+            if (undo_.back().second == "\n") prefixes_.erase(undo_.back().first);
+            else prefixes_[undo_.back().first] = undo_.back().second;
+        }
+        scopes_.pop_back();
+        return tkEnd;
+    }
+
+    Scanner::Token Scanner::lex()
+    {
+        for (;;) {
+            if (pos_ == end_) return tkEof;
+            if (*pos_ != '<') {
+                const char* first = pos_;
+                pos_ = std::find(pos_, end_, '<');
+                text_.clear();
+                decodeText(first, pos_, false, text_);
+                return tkText;
+            }
+            const std::string rest(pos_, std::min<ptrdiff_t>(end_ - pos_, 4));
+            if (rest.compare(0, 2, "<?") == 0 || rest == "<!--") {
+                // Skip processing instructions and comments
+                const std::string close = rest == "<!--" ? "-->" : "?>";
+                const char* p = std::search(pos_ + 2, end_, close.begin(), close.end());
+                if (p == end_) throw Unsupported();
+                pos_ = p + close.size();
+                continue;
+            }
+            // Document type declarations, entities and CDATA sections
+            if (rest.compare(0, 2, "<!") == 0) throw Unsupported();
+
+            if (rest.compare(0, 2, "</") == 0) {
+                pos_ += 2;
+                qname_ = lexName();
+                while (pos_ != end_ && isSpace(*pos_)) ++pos_;
+                if (pos_ == end_ || *pos_ != '>') throw Unsupported();
+                ++pos_;
+                return tkEnd;
+            }
+            ++pos_;
+            qname_ = lexName();
+            attributes_.clear();
+            std::set<std::string> names;
+            for (;;) {
+                const char* p = pos_;
+                while (pos_ != end_ && isSpace(*pos_)) ++pos_;
+                if (pos_ == end_) throw Unsupported();
+                if (*pos_ == '>' || *pos_ == '/') break;
+                if (p == pos_) throw Unsupported();
+                Attribute a;
+                a.name_ = lexName();
+                while (pos_ != end_ && isSpace(*pos_)) ++pos_;
+                if (pos_ == end_ || *pos_ != '=') throw Unsupported();
+                ++pos_;
+                while (pos_ != end_ && isSpace(*pos_)) ++pos_;
+                if (pos_ == end_ || (*pos_ != '"' && *pos_ != '\'')) throw Unsupported();
+                const char quote = *pos_++;
+                const char* first = pos_;
+                pos_ = std::find(pos_, end_, quote);
+                if (pos_ == end_ || std::find(first, pos_, '<') != pos_) throw Unsupported();
+                decodeText(first, pos_, true, a.value_);
+                ++pos_;
+                if (!names.insert(a.name_).second) throw Unsupported();
+                attributes_.push_back(a);
+            }
+            emptyTag_ = *pos_ == '/';
+            if (emptyTag_) {
+                ++pos_;
+                if (pos_ == end_ || *pos_ != '>') throw Unsupported();
+            }
+            ++pos_;
+            return tkStart;
+        }
+    }
+
+    std::string Scanner::lexName()
+    {
+        const char* first = pos_;
+        while (   pos_ != end_
+               && (   (*pos_ >= 'a' && *pos_ <= 'z') || (*pos_ >= 'A' && *pos_ <= 'Z')
+                   || (*pos_ >= '0' && *pos_ <= '9') || *pos_ == '_' || *pos_ == ':'
+                   || *pos_ == '-' || *pos_ == '.')) {
+            ++pos_;
+        }
+        if (   first == pos_
+            || (*first >= '0' && *first <= '9') || *first == '-' || *first == '.') throw Unsupported();
+        return std::string(first, pos_);
+    }
+
+    void Scanner::decodeText(const char* first, const char* last, bool attribute, std::string& out)
+    {
+        out.reserve(out.size() + (last - first));
+        for (const char* p = first; p != last; ++p) {
+            if (*p == '\r' || ((*p == '\n' || *p == '\t') && attribute)) {
+                // Line ends become a newline, attribute whitespace a space
+                if (*p == '\r' && p + 1 != last && p[1] == '\n') ++p;
+                out += attribute ? ' ' : '\n';
+                continue;
+            }
+            if (*p != '&') {
+                out += *p;
+                continue;
+            }
+            const char* semicolon = std::find(p, last, ';');
+            if (semicolon == last) throw Unsupported();
+            const std::string ref(p + 1, semicolon);
+            if      (ref == "lt")   out += '<';
+            else if (ref == "gt")   out += '>';
+            else if (ref == "amp")  out += '&';
+            else if (ref == "quot") out += '"';
+            else if (ref == "apos") out += '\'';
+            else {
+                if (ref.size() < 2 || ref[0] != '#') throw Unsupported();
+                const bool hex = ref[1] == 'x';
+                const std::string digits = ref.substr(hex ? 2 : 1);
+                if (digits.empty() || digits.size() > 6) throw Unsupported();
+                uint32_t cp = 0;
+                for (std::string::const_iterator d = digits.begin(); d != digits.end(); ++d) {
+                    uint32_t v;
+                    if      (*d >= '0' && *d <= '9') v = *d - '0';
+                    else if (hex && *d >= 'a' && *d <= 'f') v = *d - 'a' + 10;
+                    else if (hex && *d >= 'A' && *d <= 'F') v = *d - 'A' + 10;
+                    else throw Unsupported();
+                    cp = cp * (hex ? 16 : 10) + v;
+                }
+                // Control characters are replaced by the XMP Toolkit
+                if (   cp < 0x20 || (cp >= 0xd800 && cp <= 0xdfff)
+                    || cp == 0xfffe || cp == 0xffff || cp > 0x10ffff) throw Unsupported();
+                Exiv2::appendUtf8(out, cp);
+            }
+            p = semicolon;
+        }
+    }
+
+    std::string Scanner::resolve(const std::string& qname, std::string& local, bool element) const
+    {
+        const std::string::size_type colon = qname.find(':');
+        if (colon == std::string::npos) {
+            // Unprefixed attributes have no namespace, there is no default namespace
+            if (element) throw Unsupported();
+            local = qname;
+            return std::string();
+        }
+        local = qname.substr(colon + 1);
+        if (colon == 0 || local.empty() || local.find(':') != std::string::npos) throw Unsupported();
+        std::map<std::string, std::string>::const_iterator p = prefixes_.find(qname.substr(0, colon));
+        if (p == prefixes_.end()) throw Unsupported();
+        return p->second;
+    }
+
+}
+
+// *****************************************************************************
+// free functions
+namespace Exiv2 {
+    namespace Internal {
+
+    bool scanXmpPacket(XmpData& xmpData,
+                       const std::string& xmpPacket,
+                       const std::set<std::string>& keys,
+                       XmpAliasFct isAlias)
+    {
+        if (!isPlainUtf8(xmpPacket)) return false;
+        Scanner scanner(xmpPacket, keys, isAlias);
+        try {
+            scanner.scan();
+        }
+        catch (const Unsupported&) {
+            return false;
+        }
+
+        for (std::vector<Property>::const_iterator p = scanner.properties_.begin();
+             p != scanner.properties_.end(); ++p) {
+            const XmpKey key(p->prefix_, p->name_);
+            switch (p->form_) {
+            case Property::simple: {
+                XmpTextValue::UniquePtr value(new XmpTextValue);
+                value->read(p->value_);
+                xmpData.add(key, std::move(value));
+                break;
+            }
+            case Property::array: {
+                XmpArrayValue::UniquePtr value(new XmpArrayValue(p->arrayType_));
+                for (std::vector<Property::Item>::const_iterator i = p->items_.begin(); i != p->items_.end(); ++i) {
+                    value->read(i->second);
+                }
+                xmpData.add(key, std::move(value));
+                break;
+            }
+            case Property::langAlt: {
+                LangAltValue::UniquePtr value(new LangAltValue);
+                for (std::vector<Property::Item>::const_iterator i = p->items_.begin(); i != p->items_.end(); ++i) {
+                    value->value_[i->first] = i->second;
+                }
+                xmpData.add(key, std::move(value));
+                break;
+            }
+            }
+        }
+        return true;
+    }
+
+}}                                      // namespace Internal, Exiv2
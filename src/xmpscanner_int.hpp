@@ -0,0 +1,81 @@
+// ***************************************************************** -*- C++ -*-
+/*
+ * Copyright (C) 2004-2018 Exiv2 authors
+ * This program is part of the Exiv2 distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, 5th Floor, Boston, MA 02110-1301 USA.
+ */
+/*!
+  @file    xmpscanner_int.hpp
+  @brief   Decoding of selected XMP properties directly from the packet
+ */
+#ifndef XMPSCANNER_INT_HPP_
+#define XMPSCANNER_INT_HPP_
+
+// *****************************************************************************
+// included header files
+
+// + standard includes
+#include <set>
+#include <string>
+
+// *****************************************************************************
+// namespace extensions
+namespace Exiv2 {
+    class XmpData;
+
+    namespace Internal {
+
+// *****************************************************************************
+// type definitions
+
+    /*!
+      @brief Function that returns true if property \em name of namespace
+             \em ns is an alias, or if it cannot tell.
+     */
+    typedef bool (*XmpAliasFct)(const std::string& ns, const std::string& name);
+
+// *****************************************************************************
+// free functions
+
+    /*!
+      @brief Decode the top-level XMP properties \em keys, given as
+             "Xmp.prefix.Property", by scanning \em xmpPacket directly,
+             without building the XML and XMP trees of the XMP Toolkit.
+
+      The scanner handles packets with a single rdf:RDF element whose
+      rdf:Description elements contain simple properties, arrays of simple
+      items and language alternatives. Properties which are not requested
+      are skipped without being examined. For anything it does not handle,
+      like structures, qualifiers, aliases as determined by \em isAlias,
+      properties which the XMP Toolkit normalizes, entity declarations or
+      non-UTF-8 input, the scanner gives up, so that the caller can decode
+      the packet with the XMP Toolkit.
+
+      When it succeeds, the properties added to \em xmpData are the same as
+      XmpParser::decode() returns with a DecodeFilter for \em keys.
+
+      @return true if the properties were added to \em xmpData; false if
+              the packet has to be decoded with the XMP Toolkit,
+              \em xmpData is then unchanged.
+     */
+    bool scanXmpPacket(XmpData& xmpData,
+                       const std::string& xmpPacket,
+                       const std::set<std::string>& keys,
+                       XmpAliasFct isAlias);
+
+}}                                      // namespace Internal, Exiv2
+
+#endif                                  // #ifndef XMPSCANNER_INT_HPP_
@@ -34,11 +34,15 @@
 #include "xmp_exiv2.hpp"
 #include "futils.hpp"
 #include "convert.hpp"
+#include "stats_int.hpp"
 
 // + standard includes
 #include <string>
 #include <iostream>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <memory>
 
 // *****************************************************************************
 namespace {
@@ -97,6 +101,7 @@ namespace Exiv2 {
         }
         if (io_->error()) throw Error(kerFailedToReadImageData);
         clearMetadata();
+        filePacket_ = xmpPacket;
         xmpPacket_ = xmpPacket;
         if (xmpPacket_.size() > 0 && XmpParser::decode(xmpData_, xmpPacket_)) {
 #ifndef SUPPRESS_WARNINGS
@@ -115,10 +120,14 @@ namespace Exiv2 {
 
         copyXmpToIptc(xmpData_, iptcData_);
         copyXmpToExif(xmpData_, exifData_);
+        if (leanMode()) std::string().swap(filePacket_);
+        releasePackets();
     } // XmpSidecar::readMetadata
 
     void XmpSidecar::writeMetadata()
     {
+        checkUnfiltered();
+        Internal::PhaseTimer timer(&IoStats::writeMetadataTime_, &io_->stats());
         if (io_->open() != 0) {
             throw Error(kerDataSourceOpenFailed, io_->path(), strError());
         }
@@ -154,15 +163,29 @@ namespace Exiv2 {
             if (xmpPacket_.substr(0, 5)  != "<?xml") {
                 xmpPacket_ = xmlHeader + xmpPacket_ + xmlFooter;
             }
-            BasicIo::UniquePtr tempIo(new MemIo);
-            assert(tempIo.get() != 0);
+            // Leave the file alone if it does not change
+            if (xmpPacket_ == filePacket_) return;
+
+            MemIo tempIo;
             // Write XMP packet
-            if (   tempIo->write(reinterpret_cast<const byte*>(xmpPacket_.data()),
-                                 static_cast<long>(xmpPacket_.size()))
-                != static_cast<long>(xmpPacket_.size())) throw Error(kerImageWriteFailed);
-            if (tempIo->error()) throw Error(kerImageWriteFailed);
+            if (   tempIo.write(reinterpret_cast<const byte*>(xmpPacket_.data()),
+                                static_cast<long>(xmpPacket_.size()))
+                   != static_cast<long>(xmpPacket_.size())
+                || tempIo.error()) throw Error(kerImageWriteFailed);
             io_->close();
-            io_->transfer(*tempIo); // may throw
+            // A file next to the sidecar replaces it with one rename, unless the sidecar is a link
+            FileIo* fileIo = dynamic_cast<FileIo*>(io_.get());
+            const bool atomic = fileIo && fileIo->atomicTransfer();
+            if (fileIo) fileIo->setAtomicTransfer(true);
+            try {
+                io_->transfer(tempIo);
+            }
+            catch (...) {
+                if (fileIo) fileIo->setAtomicTransfer(atomic);
+                throw;
+            }
+            if (fileIo) fileIo->setAtomicTransfer(atomic);
+            filePacket_ = xmpPacket_;
         }
     } // XmpSidecar::writeMetadata
 
@@ -206,19 +229,16 @@ namespace Exiv2 {
             start = 3;
         }
         bool rc = false;
-        std::string head(reinterpret_cast<const char*>(buf + start), len - start);
-        if (head.substr(0, 5)  == "<?xml") {
+        const char* head = reinterpret_cast<const char*>(buf + start);
+        const char* const end = reinterpret_cast<const char*>(buf + len);
+        if (0 == memcmp(head, "<?xml", 5)) {
             // Forward to the next tag
-            for (unsigned i = 5; i < head.size(); ++i) {
-                if (head[i] == '<') {
-                    head = head.substr(i);
-                    break;
-                }
-            }
+            const void* tag = memchr(head + 5, '<', end - head - 5);
+            if (tag) head = static_cast<const char*>(tag);
         }
-        if (   head.size() > 9
-            && (   head.substr(0, 9)  == "<?xpacket"
-                || head.substr(0, 10) == "<x:xmpmeta")) {
+        if (   end - head > 9
+            && (   0 == memcmp(head, "<?xpacket", 9)
+                || 0 == memcmp(head, "<x:xmpmeta", 10))) {
             rc = true;
         }
         if (!advance || !rc) {
@@ -0,0 +1,48 @@
+# -*- coding: utf-8 -*-
+
+import system_tests
+
+
+@system_tests.CopyFiles("$data_path/exiv2-empty.jpg", "$data_path/exiv2-bug1108.exv")
+class BatchFile(metaclass=system_tests.CaseMeta):
+
+    jpg = system_tests.path("$data_path/exiv2-empty_copy.jpg")
+    exv = system_tests.path("$data_path/exiv2-bug1108_copy.exv")
+    commands = [
+        "$exiv2 -j 2 -M\"set Exif.Image.Copyright All\" -B - mo",
+        "$exiv2 -K Exif.Image.Artist -K Exif.Image.Copyright -K Iptc.Application2.City $jpg $exv",
+        "$exiv2 -B - ex $jpg",
+    ]
+
+    stdin = [
+        """# Commands for two files
+[$jpg]
+set Exif.Image.Artist One
+[$exv]
+set Exif.Image.Artist Two
+[$jpg]
+set Iptc.Application2.City Here
+""",
+        None,
+        "",
+    ]
+
+    stdout = [
+        "",
+        """$jpg  Exif.Image.Artist                            Ascii       4  One
+$jpg  Exif.Image.Copyright                         Ascii       4  All
+$jpg  Iptc.Application2.City                       String      4  Here
+$exv  Exif.Image.Artist                            Ascii       4  Two
+$exv  Exif.Image.Copyright                         Ascii       4  All
+""",
+        """Usage: exiv2 [ options ] [ action ] file ...
+
+Manipulate the Exif metadata of images.
+""",
+    ]
+    stderr = [
+        "",
+        "",
+        "exiv2: -B option can only be used with modify action\n",
+    ]
+    retval = [0, 0, 1]
@@ -0,0 +1,24 @@
+# -*- coding: utf-8 -*-
+
+from system_tests import CaseMeta, path
+
+
+class PrintJson(metaclass=CaseMeta):
+
+    filename = path("$data_path/exiv2-bug1108.exv")
+    commands = [
+        "$exiv2 -pj -K Exif.Image.Make -K Exif.Image.Orientation -K Exif.Photo.MakerNote $filename",
+        "$exiv2 -PExgnlsj -K Exif.Image.Orientation $filename $filename",
+    ]
+
+    stdout = [
+        """{"key":"Exif.Image.Make","type":"Ascii","count":18,"value":"NIKON CORPORATION","interpreted":"NIKON CORPORATION"}
+{"key":"Exif.Image.Orientation","type":"Short","count":1,"value":"1","interpreted":"top, left"}
+{"key":"Exif.Photo.MakerNote","type":"Undefined","count":3152,"value":null,"interpreted":null}
+""",
+        """{"file":"$filename","tag":274,"group":"Image","name":"Orientation","label":"Orientation","size":2}
+{"file":"$filename","tag":274,"group":"Image","name":"Orientation","label":"Orientation","size":2}
+""",
+    ]
+    stderr = [""] * 2
+    retval = [0] * 2
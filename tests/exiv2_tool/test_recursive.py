@@ -0,0 +1,36 @@
+# -*- coding: utf-8 -*-
+
+from system_tests import CaseMeta, path
+
+
+class Recursive(metaclass=CaseMeta):
+
+    dirname = path("$data_path/exiv2-recursive")
+    commands = [
+        "$exiv2 -R -v -PEkv -K Exif.Image.Make $dirname",
+        "$exiv2 -R -N -j 2 -Pv -K Exif.Image.Make $dirname",
+        "$exiv2 -Pv -K Exif.Image.Make $dirname",
+    ]
+
+    stdout = [
+        """File 1: $dirname/a/c.exv
+$dirname/a/c.exv  Exif.Image.Make                               C
+File 2: $dirname/a/d/e.exv
+$dirname/a/d/e.exv  Exif.Image.Make                               E
+File 3: $dirname/b.exv
+$dirname/b.exv  Exif.Image.Make                               B
+""",
+        """$dirname/a/c.exv  C
+$dirname/a/d/e.exv  E
+$dirname/b.exv  B
+""",
+        "",
+    ]
+    stderr = ["", "", "$dirname: Failed to open the file\n"]
+    retval = [0, 0, 255]
+
+    def compare_stdout(self, i, command, got_stdout, expected_stdout):
+        # With -N, the order of the files in a directory depends on their inodes
+        if i == 1:
+            got_stdout = "".join(sorted(got_stdout.splitlines(True)))
+        super().compare_stdout(i, command, got_stdout, expected_stdout)
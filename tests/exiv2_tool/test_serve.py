@@ -0,0 +1,32 @@
+# -*- coding: utf-8 -*-
+
+import system_tests
+
+
+@system_tests.CopyFiles("$data_path/exiv2-empty.jpg")
+class ServeMode(metaclass=system_tests.CaseMeta):
+
+    filename = system_tests.path("$data_path/exiv2-empty_copy.jpg")
+    commands = ["$exiv2 --serve"]
+
+    stdin = [
+        """{"id":1,"args":["-M","set Exif.Image.Artist \\"Me\\" \\u00e9","$filename"]}
+{"id":"two", "args": ["-q", "-K", "Exif.Image.Artist", "$filename"]}
+{"args":["-pa","$data_path/does-not-exist.jpg"]}
+{"id":4,"args":["rename","$filename"]}
+{"id":5,"args":["-ex-","$filename"]}
+not json
+"""
+    ]
+
+    stdout = [
+        """{"id":1,"rc":0,"out":"","err":""}
+{"id":"two","rc":0,"out":"Exif.Image.Artist                            Ascii       8  \\"Me\\" é\\n","err":""}
+{"id":null,"rc":255,"out":"","err":"$data_path/does-not-exist.jpg: Failed to open the file\\n"}
+{"id":4,"rc":1,"out":"","err":"exiv2: The rename action cannot be used with --serve\\n"}
+{"id":5,"rc":1,"out":"","err":"exiv2: Standard input and output cannot be used with --serve\\n"}
+{"id":null,"rc":1,"out":"","err":"exiv2: Invalid command: not json\\n"}
+"""
+    ]
+    stderr = [""]
+    retval = [0]
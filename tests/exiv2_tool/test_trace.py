@@ -0,0 +1,38 @@
+# -*- coding: utf-8 -*-
+
+import json
+
+import system_tests
+
+
+@system_tests.DeleteFiles("$trace")
+class Trace(metaclass=system_tests.CaseMeta):
+
+    filename = system_tests.path("$data_path/exiv2-nikon-d70.jpg")
+    trace = system_tests.path("$data_path/exiv2-trace.json")
+    commands = ["$exiv2 --trace $trace -PEv -K Exif.Image.Make $filename"]
+
+    stdout = ["NIKON CORPORATION\n"]
+    stderr = [""]
+    retval = [0]
+
+    def post_tests_hook(self):
+        with open(self.trace, "r", encoding='utf-8') as trace:
+            events = json.load(trace)["traceEvents"]
+
+        # Each end event closes the last open begin event of its thread
+        open_events = []
+        for event in events:
+            self.assertEqual(1, event["tid"])
+            if event["ph"] == "B":
+                open_events.append((event["cat"], event["name"]))
+            else:
+                self.assertEqual("E", event["ph"])
+                self.assertEqual(open_events.pop(), (event["cat"], event["name"]))
+        self.assertEqual([], open_events)
+
+        begins = [(event["cat"], event["name"]) for event in events if event["ph"] == "B"]
+        self.assertEqual(("file", self.filename), begins[0])
+        self.assertIn(("io", "open"), begins)
+        self.assertIn(("tiff-decode", "TIFF"), begins)
+        self.assertIn(("makernote", "MakerNote"), begins)
@@ -0,0 +1,167 @@
+// File under test
+#include <exiv2/metadatum.hpp>
+
+// Auxiliary headers
+#include <exiv2/error.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/iptc.hpp>
+#include <exiv2/jpgimage.hpp>
+#include <exiv2/xmp_exiv2.hpp>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+TEST(DecodeFilter, acceptsEverythingWhenEmpty)
+{
+    DecodeFilter filter;
+    ASSERT_TRUE(filter.empty());
+    ASSERT_TRUE(filter.acceptsGroup("Exif", "Canon"));
+    ASSERT_TRUE(filter.accepts(ExifKey("Exif.Photo.FNumber")));
+}
+
+TEST(DecodeFilter, acceptsFamiliesGroupsAndKeys)
+{
+    DecodeFilter filter;
+    filter.addFamily("Iptc").addGroup("Exif", "GPSInfo").addKey("Exif.Image.Orientation");
+    ASSERT_FALSE(filter.empty());
+
+    ASSERT_TRUE(filter.acceptsGroup("Iptc", "Application2"));
+    ASSERT_TRUE(filter.acceptsGroup("Exif", "GPSInfo"));
+    ASSERT_TRUE(filter.acceptsGroup("Exif", "Image"));
+    ASSERT_FALSE(filter.acceptsGroup("Exif", "Photo"));
+    ASSERT_FALSE(filter.acceptsGroup("Xmp", "dc"));
+
+    ASSERT_TRUE(filter.accepts(IptcKey("Iptc.Application2.Caption")));
+    ASSERT_TRUE(filter.accepts(ExifKey("Exif.GPSInfo.GPSLatitude")));
+    ASSERT_TRUE(filter.accepts(ExifKey("Exif.Image.Orientation")));
+    ASSERT_FALSE(filter.accepts(ExifKey("Exif.Image.Artist")));
+    ASSERT_FALSE(filter.accepts(ExifKey("Exif.Photo.FNumber")));
+
+    filter.clear();
+    ASSERT_TRUE(filter.empty());
+}
+
+TEST(DecodeFilter, acceptsTheFieldsOfXmpStructures)
+{
+    DecodeFilter filter;
+    filter.addKey("Xmp.xmpMM.History[1]/stEvt:action");
+    ASSERT_TRUE(filter.accepts(XmpKey("Xmp.xmpMM.History")));
+    ASSERT_TRUE(filter.accepts(XmpKey("Xmp.xmpMM.History[1]")));
+    ASSERT_TRUE(filter.accepts(XmpKey("Xmp.xmpMM.History[1]/stEvt:action")));
+    ASSERT_FALSE(filter.accepts(XmpKey("Xmp.xmpMM.History[1]/stEvt:when")));
+    ASSERT_FALSE(filter.accepts(XmpKey("Xmp.xmpMM.DocumentID")));
+}
+
+TEST(DecodeFilter, rejectsMalformedKeys)
+{
+    DecodeFilter filter;
+    ASSERT_THROW(filter.addKey("Exif"), Error);
+    ASSERT_THROW(filter.addKey("Exif.Image"), Error);
+    ASSERT_THROW(filter.addKey(".Image.Artist"), Error);
+    ASSERT_TRUE(filter.empty());
+}
+
+TEST(DecodeFilter, restrictsWhatReadMetadataDecodes)
+{
+    Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+    image->exifData()["Exif.Image.Artist"] = "An Artist";
+    image->exifData()["Exif.Image.Orientation"] = uint16_t(3);
+    image->exifData()["Exif.Photo.UserComment"] = "charset=Ascii A comment";
+    image->iptcData()["Iptc.Application2.Caption"] = "A caption";
+    image->iptcData()["Iptc.Application2.City"] = "A city";
+    image->xmpData()["Xmp.dc.source"] = "A source";
+    image->xmpData()["Xmp.xmp.Rating"] = "3";
+    image->writeMetadata();
+
+    DecodeFilter filter;
+    filter.addKey("Exif.Image.Orientation").addKey("Iptc.Application2.City").addGroup("Xmp", "xmp");
+    image->setDecodeFilter(filter);
+    image->readMetadata();
+
+    ASSERT_EQ(1, image->exifData().count());
+    ASSERT_EQ(3, image->exifData()["Exif.Image.Orientation"].toLong());
+    ASSERT_EQ(1, image->iptcData().count());
+    ASSERT_EQ("A city", image->iptcData()["Iptc.Application2.City"].toString());
+    ASSERT_EQ(1, image->xmpData().count());
+    ASSERT_EQ("3", image->xmpData()["Xmp.xmp.Rating"].toString());
+
+    image->setDecodeFilter(DecodeFilter());
+    image->readMetadata();
+    ASSERT_EQ(2, image->iptcData().count());
+    ASSERT_EQ(2, image->xmpData().count());
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+}
+
+TEST(DecodeFilter, skipsRejectedMakernoteSubIfds)
+{
+    Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+    image->exifData()["Exif.Image.Make"] = "OLYMPUS IMAGING CORP.";
+    image->exifData()["Exif.Olympus2.Quality"] = uint16_t(2);
+    image->exifData()["Exif.OlympusEq.SerialNumber"] = "A serial number";
+    image->exifData()["Exif.OlympusCs.PreviewImageValid"] = uint32_t(1);
+    image->writeMetadata();
+
+    DecodeFilter filter;
+    filter.addGroup("Exif", "Olympus2").addKey("Exif.OlympusEq.SerialNumber");
+    image->setDecodeFilter(filter);
+    image->readMetadata();
+
+    ASSERT_EQ(2, image->exifData()["Exif.Olympus2.Quality"].toLong());
+    ASSERT_EQ("A serial number", image->exifData()["Exif.OlympusEq.SerialNumber"].toString());
+    ASSERT_TRUE(image->exifData().findKey(ExifKey("Exif.OlympusCs.PreviewImageValid")) == image->exifData().end());
+
+    image->setDecodeFilter(DecodeFilter());
+    image->readMetadata();
+    ASSERT_EQ(1, image->exifData()["Exif.OlympusCs.PreviewImageValid"].toLong());
+}
+
+TEST(DecodeFilter, readsTheThumbnailOnlyIfAccepted)
+{
+    const byte thumbnail[] = { 0xff, 0xd8, 0xff, 0xd9 };
+    Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+    image->exifData()["Exif.Image.Artist"] = "An Artist";
+    ExifThumb(image->exifData()).setJpegThumbnail(thumbnail, sizeof(thumbnail));
+    image->writeMetadata();
+
+    DecodeFilter filter;
+    filter.addKey("Exif.Image.Artist").addKey("Exif.Thumbnail.JPEGInterchangeFormatLength");
+    image->setDecodeFilter(filter);
+    image->readMetadata();
+    ASSERT_EQ(2, image->exifData().count());
+    ASSERT_EQ(0, ExifThumbC(image->exifData()).copy().size_);
+
+    filter.addKey("Exif.Thumbnail.JPEGInterchangeFormat");
+    image->setDecodeFilter(filter);
+    image->readMetadata();
+    const DataBuf buf = ExifThumbC(image->exifData()).copy();
+    ASSERT_EQ(static_cast<long>(sizeof(thumbnail)), buf.size_);
+    ASSERT_EQ(0, memcmp(thumbnail, buf.pData_, sizeof(thumbnail)));
+}
+
+TEST(DecodeFilter, refusesToWriteFilteredMetadata)
+{
+    Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+    image->exifData()["Exif.Image.Artist"] = "An Artist";
+    image->exifData()["Exif.Image.Orientation"] = uint16_t(3);
+    image->writeMetadata();
+
+    image->setDecodeFilter(DecodeFilter().addKey("Exif.Image.Orientation"));
+    image->readMetadata();
+    image->exifData()["Exif.Image.Orientation"] = uint16_t(1);
+    try {
+        image->writeMetadata();
+        FAIL() << "Filtered metadata was written";
+    } catch (const Error& e) {
+        ASSERT_EQ(kerFilteredMetadata, e.code());
+    }
+    MemIo dst;
+    ASSERT_THROW(image->writeMetadataTo(dst), Error);
+
+    // The tags the filter skipped are still in the image
+    image->setDecodeFilter(DecodeFilter());
+    image->readMetadata();
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+    ASSERT_EQ(3, image->exifData()["Exif.Image.Orientation"].toLong());
+}
@@ -0,0 +1,520 @@
+#include <exiv2/exif.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+TEST(AnExifData, findsAddedKeys)
+{
+    ExifData exifData;
+    exifData["Exif.Image.Make"] = "Camera";
+    exifData["Exif.Image.Model"] = "Model";
+    exifData["Exif.Photo.ExposureTime"] = URational(1, 125);
+
+    ASSERT_EQ(3, exifData.count());
+    ExifData::const_iterator pos = exifData.findKey(ExifKey("Exif.Image.Model"));
+    ASSERT_NE(exifData.end(), pos);
+    ASSERT_EQ("Model", pos->toString());
+    ASSERT_EQ(exifData.end(), exifData.findKey(ExifKey("Exif.Image.Artist")));
+}
+
+TEST(AnExifData, operatorSubscriptReturnsExistingDatum)
+{
+    ExifData exifData;
+    exifData["Exif.Image.Make"] = "Camera";
+    exifData["Exif.Image.Make"] = "Other";
+
+    ASSERT_EQ(1, exifData.count());
+    ASSERT_EQ("Other", exifData["Exif.Image.Make"].toString());
+}
+
+TEST(AnExifData, findsFirstOfDuplicateKeys)
+{
+    ExifData exifData;
+    const ExifKey key("Exif.Image.Make");
+    AsciiValue first("first");
+    AsciiValue second("second");
+    exifData.add(key, &first);
+    exifData.add(key, &second);
+
+    ExifData::iterator pos = exifData.findKey(key);
+    ASSERT_EQ("first", pos->toString());
+    exifData.erase(pos);
+    pos = exifData.findKey(key);
+    ASSERT_NE(exifData.end(), pos);
+    ASSERT_EQ("second", pos->toString());
+    exifData.erase(pos);
+    ASSERT_EQ(exifData.end(), exifData.findKey(key));
+}
+
+TEST(AnExifData, findsKeysAfterSortAndMutableIteration)
+{
+    ExifData exifData;
+    exifData["Exif.Photo.ExposureTime"] = URational(1, 125);
+    exifData["Exif.Image.Model"] = "Model";
+    exifData["Exif.Image.Make"] = "Camera";
+    exifData.sortByKey();
+    ASSERT_EQ("Camera", exifData.findKey(ExifKey("Exif.Image.Make"))->toString());
+
+    exifData.erase(std::remove_if(exifData.begin(), exifData.end(),
+                                  [](const Exifdatum& md) { return md.groupName() == "Image"; }),
+                   exifData.end());
+    ASSERT_EQ(1, exifData.count());
+    ASSERT_EQ(exifData.end(), exifData.findKey(ExifKey("Exif.Image.Make")));
+    ASSERT_NE(exifData.end(), exifData.findKey(ExifKey("Exif.Photo.ExposureTime")));
+}
+
+TEST(AnExifData, sortsStablyByKeyAndByTag)
+{
+    ExifData exifData;
+    exifData["Exif.Thumbnail.ImageWidth"] = uint32_t(160);
+    exifData["Exif.Image.Model"] = "Model";
+    exifData["Exif.Image.ImageWidth"] = uint32_t(4000);
+    AsciiValue first("First");
+    AsciiValue second("Second");
+    exifData.add(ExifKey("Exif.Image.Make"), &first);
+    exifData.add(ExifKey("Exif.Image.Make"), &second);
+
+    exifData.sortByTag();
+    std::vector<std::string> keys;
+    for (const Exifdatum& md : exifData) keys.push_back(md.key());
+    const std::vector<std::string> byTag = {"Exif.Thumbnail.ImageWidth", "Exif.Image.ImageWidth",
+                                            "Exif.Image.Make", "Exif.Image.Make", "Exif.Image.Model"};
+    ASSERT_EQ(byTag, keys);
+    ASSERT_EQ("First", exifData.findKey(ExifKey("Exif.Image.Make"))->toString());
+
+    exifData.sortByKey();
+    keys.clear();
+    for (const Exifdatum& md : exifData) keys.push_back(md.key());
+    const std::vector<std::string> byKey = {"Exif.Image.ImageWidth", "Exif.Image.Make", "Exif.Image.Make",
+                                            "Exif.Image.Model", "Exif.Thumbnail.ImageWidth"};
+    ASSERT_EQ(byKey, keys);
+    ASSERT_EQ("First", exifData.findKey(ExifKey("Exif.Image.Make"))->toString());
+}
+
+TEST(AnExifData, copyHasItsOwnIndex)
+{
+    ExifData exifData;
+    exifData["Exif.Image.Make"] = "Camera";
+    ExifData copy(exifData);
+    exifData.clear();
+
+    const ExifData& constCopy = copy;
+    ExifData::const_iterator pos = constCopy.findKey(ExifKey("Exif.Image.Make"));
+    ASSERT_NE(constCopy.end(), pos);
+    ASSERT_EQ("Camera", pos->toString());
+}
+
+namespace
+{
+    Blob encodeWithCanonMakernote()
+    {
+        ExifData exifData;
+        exifData["Exif.Image.Make"] = "Canon";
+        exifData["Exif.Image.Model"] = "Canon EOS";
+        exifData["Exif.Photo.ExposureTime"] = URational(1, 125);
+        exifData["Exif.Canon.OwnerName"] = "An Owner";
+        Blob blob;
+        ExifParser::encode(blob, littleEndian, exifData);
+        return blob;
+    }
+}
+
+TEST(AnExifData, decodesALazyMakernoteOnFirstAccess)
+{
+    const Blob blob = encodeWithCanonMakernote();
+    ExifData eager;
+    ExifParser::decode(eager, &blob[0], static_cast<uint32_t>(blob.size()));
+    ASSERT_FALSE(eager.makernotePending());
+
+    ExifData lazy;
+    lazy.setLazyMakernote(true);
+    ExifParser::decode(lazy, &blob[0], static_cast<uint32_t>(blob.size()));
+    ASSERT_TRUE(lazy.makernotePending());
+    ASSERT_GT(eager.count(), lazy.count());
+    ASSERT_NE(lazy.end(), lazy.findKey(ExifKey("Exif.Photo.ExposureTime")));
+    ASSERT_TRUE(lazy.makernotePending());
+
+    ExifData::const_iterator pos = lazy.findKey(ExifKey("Exif.Canon.OwnerName"));
+    ASSERT_FALSE(lazy.makernotePending());
+    ASSERT_NE(lazy.end(), pos);
+    ASSERT_EQ("An Owner", pos->toString());
+
+    // Same metadata in the same order as an eager decode
+    ASSERT_EQ(eager.count(), lazy.count());
+    ASSERT_TRUE(std::equal(eager.begin(), eager.end(), lazy.begin(),
+                           [](const Exifdatum& lhs, const Exifdatum& rhs) {
+                               return lhs.key() == rhs.key() && lhs.toString() == rhs.toString();
+                           }));
+}
+
+TEST(AnExifData, decodesALazyMakernoteOnceForConcurrentReaders)
+{
+    const Blob blob = encodeWithCanonMakernote();
+    ExifData lazy;
+    lazy.setLazyMakernote(true);
+    ExifParser::decode(lazy, &blob[0], static_cast<uint32_t>(blob.size()));
+    const ExifData& reader = lazy;
+
+    std::vector<std::string> owners(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < owners.size(); ++i) {
+        threads.push_back(std::thread([&reader, &owners, i]() {
+            ExifData::const_iterator pos = reader.findKey(ExifKey("Exif.Canon.OwnerName"));
+            if (pos != reader.end()) owners[i] = pos->toString();
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+    ASSERT_EQ(std::vector<std::string>(owners.size(), "An Owner"), owners);
+    ASSERT_EQ(1, std::count_if(reader.begin(), reader.end(),
+                               [](const Exifdatum& md) { return md.key() == "Exif.Canon.OwnerName"; }));
+}
+
+TEST(AnExifData, encodesAPendingMakernote)
+{
+    const Blob blob = encodeWithCanonMakernote();
+    ExifData lazy;
+    lazy.setLazyMakernote(true);
+    ExifParser::decode(lazy, &blob[0], static_cast<uint32_t>(blob.size()));
+    ASSERT_TRUE(lazy.makernotePending());
+
+    Blob encoded;
+    ExifParser::encode(encoded, littleEndian, lazy);
+    ExifData reread;
+    ExifParser::decode(reread, &encoded[0], static_cast<uint32_t>(encoded.size()));
+    ASSERT_EQ("An Owner", reread["Exif.Canon.OwnerName"].toString());
+}
+
+TEST(AnExifData, writesAnUntouchedRelocatableMakernoteBackAsItIs)
+{
+    // Nikon makernote with its value before the IFD, the encoder would write it after
+    const byte mn[] = {
+        'N', 'i', 'k', 'o', 'n', 0, 0x02, 0x10, 0, 0,
+        'M', 'M', 0, 0x2a, 0, 0, 0, 0x10,
+        'F', 'I', 'N', 'E', ' ', ' ', ' ', 0,
+        0, 1,
+        0, 0x04, 0, 0x02, 0, 0, 0, 0x08, 0, 0, 0, 0x08,
+        0, 0, 0, 0
+    };
+    DataValue value(undefined);
+    value.read(mn, sizeof(mn));
+    ExifData exifData;
+    exifData["Exif.Image.Make"] = "NIKON CORPORATION";
+    exifData["Exif.Image.Model"] = "NIKON D70";
+    exifData.add(ExifKey("Exif.Photo.MakerNote"), &value);
+    Blob blob;
+    ExifParser::encode(blob, bigEndian, exifData);
+
+    ExifData lazy;
+    lazy.setLazyMakernote(true);
+    ExifParser::decode(lazy, &blob[0], static_cast<uint32_t>(blob.size()));
+    ASSERT_TRUE(lazy.makernotePending());
+
+    // The makernote moves with the new tag
+    lazy["Exif.Image.Artist"] = "Somebody with a long name";
+    Blob encoded;
+    ExifParser::encode(encoded, bigEndian, lazy);
+
+    ExifData reread;
+    ExifParser::decode(reread, &encoded[0], static_cast<uint32_t>(encoded.size()));
+    ASSERT_EQ(exifData["Exif.Photo.MakerNote"].toString(), reread["Exif.Photo.MakerNote"].toString());
+    ASSERT_EQ("FINE   ", reread["Exif.Nikon3.Quality"].toString());
+}
+
+TEST(AnExifData, keepsItsConstIteratorsWhenItIsModifiedAfterACopy)
+{
+    const Blob blob = encodeWithCanonMakernote();
+    ExifData exifData;
+    ExifParser::decode(exifData, &blob[0], static_cast<uint32_t>(blob.size()));
+    const ExifData& source = exifData;
+
+    ExifData copy(exifData);
+    const ExifData& constCopy = copy;
+    ExifData::const_iterator model = constCopy.findKey(ExifKey("Exif.Image.Model"));
+    ExifData::const_iterator end = constCopy.end();
+    ExifData later(copy);
+
+    copy["Exif.Image.Model"] = "Another";
+    ASSERT_EQ("Another", model->toString());
+    ASSERT_EQ(end, constCopy.end());
+    ASSERT_EQ("Canon EOS", source.findKey(ExifKey("Exif.Image.Model"))->toString());
+    ASSERT_EQ("Canon EOS", later.findKey(ExifKey("Exif.Image.Model"))->toString());
+    ASSERT_EQ(source.count(), constCopy.count());
+}
+
+TEST(AnExifData, isNotSharedOnceMutableIteratorsWereHandedOut)
+{
+    ExifData exifData;
+    exifData.add(ExifKey("Exif.Image.Make"), Value::create(asciiString));
+    ExifData::iterator pos = exifData.findKey(ExifKey("Exif.Image.Make"));
+
+    ExifData copy(exifData);
+    pos->setValue("Camera");
+    ASSERT_EQ("Camera", exifData["Exif.Image.Make"].toString());
+    ASSERT_EQ("", copy["Exif.Image.Make"].toString());
+}
+
+TEST(AnExifData, decodesAPendingMakernoteOfASharedCopyOnlyOnce)
+{
+    const Blob blob = encodeWithCanonMakernote();
+    ExifData lazy;
+    lazy.setLazyMakernote(true);
+    ExifParser::decode(lazy, &blob[0], static_cast<uint32_t>(blob.size()));
+    const long count = lazy.count();
+
+    ExifData copy(lazy);
+    const ExifData& constCopy = copy;
+    ASSERT_NE(constCopy.end(), constCopy.findKey(ExifKey("Exif.Canon.OwnerName")));
+    ASSERT_TRUE(lazy.makernotePending());
+    ASSERT_EQ(count, lazy.count());
+    ASSERT_EQ("An Owner", lazy["Exif.Canon.OwnerName"].toString());
+    ASSERT_EQ(copy.count(), lazy.count());
+}
+
+TEST(AnExifData, copiesOfAValueKeepTheirDataArea)
+{
+    const byte data[] = { 0xff, 0xd8, 0xff, 0xd9 };
+    ULongValue value;
+    value.value_.push_back(0);
+    value.setDataArea(data, sizeof(data));
+    ExifData exifData;
+    exifData.add(ExifKey("Exif.Thumbnail.JPEGInterchangeFormat"), &value);
+
+    ExifData copy(exifData);
+    copy["Exif.Thumbnail.JPEGInterchangeFormat"].setDataArea(data, 2);
+
+    ASSERT_EQ(4, exifData["Exif.Thumbnail.JPEGInterchangeFormat"].sizeDataArea());
+    const DataBuf buf = exifData["Exif.Thumbnail.JPEGInterchangeFormat"].dataArea();
+    ASSERT_EQ(0, memcmp(data, buf.pData_, sizeof(data)));
+    ASSERT_EQ(2, copy["Exif.Thumbnail.JPEGInterchangeFormat"].sizeDataArea());
+    ASSERT_EQ(4, value.sizeDataArea());
+}
+
+namespace
+{
+    //! Return binary Exif data with an artist and a thumbnail, followed by \em padding zero bytes
+    Blob exifWithThumbnail(const std::vector<byte>& thumbnail, size_t padding)
+    {
+        ExifData exifData;
+        exifData["Exif.Image.Artist"] = "An Artist";
+        ExifThumb(exifData).setJpegThumbnail(&thumbnail[0], static_cast<long>(thumbnail.size()));
+        Blob blob;
+        ExifParser::encode(blob, 0, 0, littleEndian, exifData);
+        blob.resize(blob.size() + padding, 0);
+        return blob;
+    }
+}
+
+TEST(ExifThumb, isErasedWithoutRewritingTheExifData)
+{
+    Blob blob = exifWithThumbnail(std::vector<byte>(64, 0x5a), 0);
+    ExifData exifData;
+    ExifParser::decode(exifData, &blob[0], static_cast<uint32_t>(blob.size()));
+    ExifThumb(exifData).erase();
+
+    Blob rewritten;
+    ASSERT_EQ(wmNonIntrusive, ExifParser::encode(rewritten, &blob[0], static_cast<uint32_t>(blob.size()),
+                                                 littleEndian, exifData));
+    ExifData decoded;
+    ExifParser::decode(decoded, &blob[0], static_cast<uint32_t>(blob.size()));
+    ASSERT_EQ(1, decoded.count());
+    ASSERT_EQ("An Artist", decoded["Exif.Image.Artist"].toString());
+    ASSERT_TRUE(std::find(blob.begin(), blob.end(), 0x5a) == blob.end());
+}
+
+TEST(ExifThumb, growsIntoTheFreeSpaceAtTheEndOfTheExifData)
+{
+    Blob blob = exifWithThumbnail(std::vector<byte>(64, 0x5a), 128);
+    ExifData exifData;
+    ExifParser::decode(exifData, &blob[0], static_cast<uint32_t>(blob.size()));
+    const std::vector<byte> thumbnail(160, 0xa5);
+    ExifThumb(exifData).setJpegThumbnail(&thumbnail[0], static_cast<long>(thumbnail.size()));
+
+    Blob rewritten;
+    ASSERT_EQ(wmNonIntrusive, ExifParser::encode(rewritten, &blob[0], static_cast<uint32_t>(blob.size()),
+                                                 littleEndian, exifData));
+    ExifData decoded;
+    ExifParser::decode(decoded, &blob[0], static_cast<uint32_t>(blob.size()));
+    const DataBuf buf = ExifThumbC(decoded).copy();
+    ASSERT_EQ(160, buf.size_);
+    ASSERT_EQ(0, memcmp(&thumbnail[0], buf.pData_, thumbnail.size()));
+    ASSERT_EQ("An Artist", decoded["Exif.Image.Artist"].toString());
+
+    // Without enough free space, the Exif data is rewritten
+    const std::vector<byte> larger(400, 0xa5);
+    ExifThumb(decoded).setJpegThumbnail(&larger[0], static_cast<long>(larger.size()));
+    ASSERT_EQ(wmIntrusive, ExifParser::encode(rewritten, &blob[0], static_cast<uint32_t>(blob.size()),
+                                              littleEndian, decoded));
+}
+
+TEST(AnExifData, findsAndAddsMetadataWithAKeyHandle)
+{
+    const ExifKeyHandle handle("Exif.Photo.DateTimeOriginal");
+    ExifData first;
+    ExifData second;
+    first[handle] = "2019:01:01 12:00:00";
+    second["Exif.Photo.DateTimeOriginal"] = "2020:02:02 13:00:00";
+
+    const ExifData& constFirst = first;
+    ASSERT_EQ("2019:01:01 12:00:00", constFirst.findKey(handle)->toString());
+    ASSERT_EQ("2020:02:02 13:00:00", second.findKey(handle)->toString());
+    ASSERT_TRUE(second[handle].key() == "Exif.Photo.DateTimeOriginal");
+    ASSERT_EQ(1, second.count());
+    const ExifData empty;
+    ASSERT_TRUE(empty.findKey(handle) == empty.end());
+}
+
+TEST(AnExifData, recordsTheOriginOfDecodedValues)
+{
+    ExifData source;
+    source["Exif.Image.Artist"] = "An Artist";
+    source["Exif.Image.Orientation"] = uint16_t(6);
+    Blob blob;
+    ExifParser::encode(blob, littleEndian, source);
+
+    ExifData exifData;
+    ExifParser::decode(exifData, &blob[0], static_cast<uint32_t>(blob.size()));
+    const ExifData& decoded = exifData;
+    ExifData::const_iterator artist = decoded.findKey(ExifKey("Exif.Image.Artist"));
+    ASSERT_NE(decoded.end(), artist);
+    const ExifOrigin& origin = artist->origin();
+    ASSERT_TRUE(origin.valid());
+    ASSERT_EQ(10, origin.valueSize_);
+    ASSERT_EQ(0, std::memcmp(&blob[origin.valueOffset_], "An Artist", 10));
+    ASSERT_EQ(0x013b, getUShort(&blob[origin.entryOffset_], littleEndian));
+
+    // Values in the IFD entry itself
+    ExifData::const_iterator orientation = decoded.findKey(ExifKey("Exif.Image.Orientation"));
+    ASSERT_NE(decoded.end(), orientation);
+    ASSERT_EQ(orientation->origin().entryOffset_ + 8, orientation->origin().valueOffset_);
+    ASSERT_EQ(6, getUShort(&blob[orientation->origin().valueOffset_], littleEndian));
+
+    // Copies keep the origin, new metadata have none
+    ExifData copy(decoded);
+    copy["Exif.Image.Artist"] = "Another Artist";
+    ASSERT_EQ(origin.valueOffset_, copy["Exif.Image.Artist"].origin().valueOffset_);
+    ASSERT_FALSE(source["Exif.Image.Artist"].origin().valid());
+}
+
+TEST(ExifParser, dropsLargeTagsWhichDoNotFitIntoAnApp1Segment)
+{
+    ExifData exifData;
+    exifData["Exif.Image.Make"] = "Camera";
+    exifData["Exif.Image.ImageDescription"] = std::string(30000, 'a');
+    exifData["Exif.Photo.UserComment"] = std::string(40000, 'b');
+
+    Blob small;
+    ExifParser::encode(small, littleEndian, exifData);
+    ASSERT_LE(small.size(), 65527u);
+
+    ExifData decoded;
+    ExifParser::decode(decoded, &small[0], static_cast<uint32_t>(small.size()));
+    ASSERT_EQ("Camera", decoded["Exif.Image.Make"].toString());
+    ASSERT_TRUE(decoded.findKey(ExifKey("Exif.Image.ImageDescription")) == decoded.end());
+    ASSERT_TRUE(decoded.findKey(ExifKey("Exif.Photo.UserComment")) == decoded.end());
+
+    // Metadata which fits is encoded unchanged
+    exifData.erase(exifData.findKey(ExifKey("Exif.Photo.UserComment")));
+    Blob fits;
+    ExifParser::encode(fits, littleEndian, exifData);
+    ASSERT_GT(fits.size(), 30000u);
+    ExifData unchanged;
+    ExifParser::decode(unchanged, &fits[0], static_cast<uint32_t>(fits.size()));
+    ASSERT_EQ(30001, unchanged["Exif.Image.ImageDescription"].size());
+}
+
+TEST(AnExifData, estimatesItsMemoryUsage)
+{
+    ExifData exifData;
+    exifData["Exif.Image.Artist"] = "An Artist";
+    const MemoryUsage usage = exifData.memoryUsage();
+    ASSERT_GT(usage.datums_, 0u);
+    ASSERT_GE(usage.keys_, std::string("Exif.Image.Artist").size());
+    ASSERT_GE(usage.values_, std::string("An Artist").size());
+    ASSERT_EQ(0u, usage.buffers_);
+    ASSERT_EQ(usage.datums_ + usage.keys_ + usage.values_, usage.total());
+
+    exifData["Exif.Image.ImageDescription"] = std::string(1000, 'a');
+    ASSERT_GE(exifData.memoryUsage().values_, usage.values_ + 1000);
+}
+
+TEST(PrintCache, isDisabledByDefault)
+{
+    ExifData exifData;
+    exifData["Exif.Photo.Flash"] = uint16_t(1);
+    exifData["Exif.Photo.Flash"].print(&exifData);
+
+    ASSERT_EQ(0u, PrintCache::capacity());
+    ASSERT_EQ(0u, PrintCache::size());
+    ASSERT_EQ(0u, PrintCache::misses());
+}
+
+TEST(PrintCache, answersRepeatedPrintsOfTheSameValue)
+{
+    PrintCache::setCapacity(16);
+    PrintCache::clear();
+    ExifData first;
+    first["Exif.Photo.Flash"] = uint16_t(1);
+    ExifData second;
+    second["Exif.Photo.Flash"] = uint16_t(1);
+    second["Exif.Photo.ExposureProgram"] = uint16_t(2);
+
+    const std::string printed = first["Exif.Photo.Flash"].print(&first);
+    ASSERT_EQ(printed, second["Exif.Photo.Flash"].print(&second));
+    ASSERT_EQ(1u, PrintCache::hits());
+    ASSERT_EQ(1u, PrintCache::misses());
+
+    second["Exif.Photo.Flash"] = uint16_t(0);
+    ASSERT_NE(printed, second["Exif.Photo.Flash"].print(&second));
+    ASSERT_EQ(2u, PrintCache::misses());
+    PrintCache::setCapacity(0);
+    ASSERT_EQ(0u, PrintCache::size());
+}
+
+TEST(PrintCache, usesAResultOnlyIfTheLookupsOfThePrintFunctionFindTheSameValues)
+{
+    PrintCache::setCapacity(16);
+    PrintCache::clear();
+    ExifData eos20d;
+    eos20d["Exif.Image.Model"] = "Canon EOS 20D";
+    eos20d["Exif.CanonFi.FileNumber"] = uint32_t(0x123456);
+    ExifData eos30d;
+    eos30d["Exif.Image.Model"] = "Canon EOS 30D";
+    eos30d["Exif.CanonFi.FileNumber"] = uint32_t(0x123456);
+
+    PrintCache::setCapacity(0);
+    const std::string expected20d = eos20d["Exif.CanonFi.FileNumber"].print(&eos20d);
+    const std::string expected30d = eos30d["Exif.CanonFi.FileNumber"].print(&eos30d);
+    ASSERT_NE(expected20d, expected30d);
+    PrintCache::setCapacity(16);
+
+    ASSERT_EQ(expected20d, eos20d["Exif.CanonFi.FileNumber"].print(&eos20d));
+    ASSERT_EQ(expected30d, eos30d["Exif.CanonFi.FileNumber"].print(&eos30d));
+    ASSERT_EQ(0u, PrintCache::hits());
+    ASSERT_EQ(expected30d, eos30d["Exif.CanonFi.FileNumber"].print(&eos30d));
+    ASSERT_EQ(1u, PrintCache::hits());
+    PrintCache::setCapacity(0);
+}
+
+TEST(PrintCache, dropsTheLeastRecentlyUsedResults)
+{
+    PrintCache::setCapacity(2);
+    PrintCache::clear();
+    ExifData exifData;
+    for (uint16_t flash = 0; flash < 3; ++flash) {
+        exifData["Exif.Photo.Flash"] = flash;
+        exifData["Exif.Photo.Flash"].print(&exifData);
+    }
+    ASSERT_EQ(2u, PrintCache::size());
+
+    exifData["Exif.Photo.Flash"] = uint16_t(0);
+    exifData["Exif.Photo.Flash"].print(&exifData);
+    ASSERT_EQ(0u, PrintCache::hits());
+    PrintCache::setCapacity(0);
+}
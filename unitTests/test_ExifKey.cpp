@@ -0,0 +1,49 @@
+#include <exiv2/error.hpp>
+#include <exiv2/tags.hpp>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+TEST(AnExifKey, correctlyInstantiateWithValidKey)
+{
+    ExifKey key("Exif.Photo.ExposureTime");
+    ASSERT_EQ("Exif.Photo.ExposureTime", key.key());
+    ASSERT_STREQ("Exif", key.familyName());
+    ASSERT_EQ("Photo", key.groupName());
+    ASSERT_EQ("ExposureTime", key.tagName());
+    ASSERT_EQ(0x829a, key.tag());
+}
+
+TEST(AnExifKey, translatesHexTagNameOfKnownTag)
+{
+    ExifKey key("Exif.Image.0x010f");
+    ASSERT_EQ("Exif.Image.Make", key.key());
+    ASSERT_EQ("Make", key.tagName());
+}
+
+TEST(AnExifKey, usesHexTagNameForUnknownTag)
+{
+    ExifKey key(0xabcd, "Image");
+    ASSERT_EQ("Exif.Image.0xabcd", key.key());
+    ASSERT_EQ("0xabcd", key.tagName());
+    ASSERT_EQ("Image", key.groupName());
+}
+
+TEST(AnExifKey, canBeCopiedAndAssigned)
+{
+    ExifKey key("Exif.GPSInfo.GPSLatitude");
+    ExifKey copiedKey(key);
+    ASSERT_EQ(key.key(), copiedKey.key());
+
+    ExifKey assignedKey("Exif.Image.Make");
+    assignedKey = key;
+    ASSERT_EQ(key.key(), assignedKey.key());
+    ASSERT_EQ(key.ifdId(), assignedKey.ifdId());
+}
+
+TEST(AnExifKey, throwsWithInvalidKey)
+{
+    ASSERT_THROW(ExifKey("Exif.NoSuchGroup.Make"), Error);
+    ASSERT_THROW(ExifKey("Iptc.Image.Make"), Error);
+}
@@ -0,0 +1,184 @@
+// File under test
+#include <exiv2/image.hpp>
+
+// Auxiliary headers
+#include <exiv2/basicio.hpp>
+#include <exiv2/cr2image.hpp>
+#include <exiv2/gifimage.hpp>
+#include <exiv2/jpgimage.hpp>
+#include <exiv2/tiffimage.hpp>
+#include <exiv2/xmpsidecar.hpp>
+
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <string>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    int typeOf(const std::string& data)
+    {
+        return ImageFactory::getType(reinterpret_cast<const byte*>(data.data()), static_cast<long>(data.size()));
+    }
+}
+
+TEST(ImageFactory_getType, recognizesSignatures)
+{
+    ASSERT_EQ(ImageType::jpeg, typeOf(std::string("\xff\xd8\xff\xe0\0\x10JFIF\0", 12)));
+    ASSERT_EQ(ImageType::gif, typeOf("GIF89a\x01\0\x01\0"));
+    ASSERT_EQ(ImageType::tiff, typeOf(std::string("II*\0\x08\0\0\0\0\0\0\0\0\0\0\0", 16)));
+}
+
+TEST(ImageFactory_getType, keepsTheOrderOfTheRegistry)
+{
+    // A CR2 file is also a valid TIFF file, the CR2 check comes first
+    ASSERT_EQ(ImageType::cr2, typeOf(std::string("II*\0\x10\0\0\0CR\x02\0\0\0\0\0", 16)));
+}
+
+TEST(ImageFactory_getType, readsHeadersLongerThanTheMagic)
+{
+    const std::string sidecar = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                                "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\" x:xmptk=\"XMP Core 4.4.0-Exiv2\">\n"
+                                "</x:xmpmeta>\n";
+    ASSERT_EQ(ImageType::xmp, typeOf(sidecar));
+}
+
+TEST(ImageFactory_getType, returnsNoneForUnknownOrShortData)
+{
+    ASSERT_EQ(ImageType::none, typeOf(std::string(200, '\0')));
+    ASSERT_EQ(ImageType::none, typeOf(std::string("\xff", 1)));
+}
+
+TEST(ImageFactory_tryOpen, reportsFailuresAsErrorCodes)
+{
+    Image::UniquePtr image;
+    const std::string text("not an image at all");
+    ASSERT_EQ(kerMemoryContainsUnknownImageType,
+              ImageFactory::tryOpen(image, reinterpret_cast<const byte*>(text.data()), static_cast<long>(text.size())));
+    ASSERT_EQ(kerDataSourceOpenFailed, ImageFactory::tryOpen(image, "this/file/does/not/exist.jpg"));
+    ASSERT_FALSE(image);
+}
+
+TEST(ImageFactory_tryOpen, opensImagesAndReadsTheirMetadata)
+{
+    const std::string data("GIF89a\x01\0\x01\0\0\0\0;", 14);
+    Image::UniquePtr image;
+    ASSERT_EQ(kerSuccess,
+              ImageFactory::tryOpen(image, reinterpret_cast<const byte*>(data.data()), static_cast<long>(data.size())));
+    ASSERT_TRUE(image);
+    ASSERT_EQ(ImageType::gif, image->imageType());
+    ASSERT_EQ(kerSuccess, image->tryReadMetadata());
+    ASSERT_EQ(1, image->pixelWidth());
+}
+
+TEST(ImageFactory_tryOpen, triesTheTypeHintFirst)
+{
+    const std::string data("GIF89a\x01\0\x01\0\0\0\0;", 14);
+    Image::UniquePtr image;
+    BasicIo::UniquePtr io(new MemIo(reinterpret_cast<const byte*>(data.data()), static_cast<long>(data.size())));
+    ASSERT_EQ(kerSuccess, ImageFactory::tryOpen(image, std::move(io), ImageType::gif));
+    ASSERT_EQ(ImageType::gif, image->imageType());
+    io.reset(new MemIo(reinterpret_cast<const byte*>(data.data()), static_cast<long>(data.size())));
+    image = ImageFactory::open(std::move(io), ImageType::jpeg);
+    ASSERT_EQ(ImageType::gif, image->imageType());
+}
+
+TEST(AnError, assemblesItsMessageOnDemand)
+{
+    const Error error(kerDataSourceOpenFailed, "file.jpg", "No such file");
+    ASSERT_EQ(kerDataSourceOpenFailed, error.code());
+    ASSERT_STREQ("file.jpg: Failed to open the data source: No such file", error.what());
+}
+
+TEST(ImageFactory_open, appliesTheRemoteOptionsToRemoteFiles)
+{
+    RemoteOptions options;
+    options.cancel_ = std::make_shared<CancelToken>();
+    options.cancel_->cancel();
+    try {
+        ImageFactory::open("http://127.0.0.1:9/image.jpg", options, false);
+        FAIL() << "The request was sent";
+    } catch (const Error& e) {
+        ASSERT_EQ(kerRemoteRequestStopped, e.code());
+    }
+}
+
+TEST(ImageFactory_open, checksTheHintedTypeFirst)
+{
+    // A CR2 file is also a valid TIFF file, the hint takes precedence over the order of the registry
+    const std::string cr2("II*\0\x10\0\0\0CR\x02\0\0\0\0\0", 16);
+    Image::UniquePtr image = ImageFactory::open(
+        BasicIo::UniquePtr(new MemIo(reinterpret_cast<const byte*>(cr2.data()), static_cast<long>(cr2.size()))),
+        ImageType::tiff);
+    ASSERT_TRUE(image);
+    ASSERT_EQ(ImageType::tiff, image->imageType());
+}
+
+TEST(ImageFactory_open, detectsTheTypeIfTheHintIsWrong)
+{
+    const std::string gif("GIF89a\x01\0\x01\0\0\0\0;", 14);
+    Image::UniquePtr image = ImageFactory::open(
+        BasicIo::UniquePtr(new MemIo(reinterpret_cast<const byte*>(gif.data()), static_cast<long>(gif.size()))),
+        ImageType::jpeg);
+    ASSERT_TRUE(image);
+    ASSERT_EQ(ImageType::gif, image->imageType());
+
+    const std::string text("not an image at all");
+    ASSERT_FALSE(ImageFactory::open(
+        BasicIo::UniquePtr(new MemIo(reinterpret_cast<const byte*>(text.data()), static_cast<long>(text.size()))),
+        ImageType::gif));
+    ASSERT_THROW(ImageFactory::open("this/file/does/not/exist.jpg", ImageType::jpeg), Error);
+}
+
+TEST(ImageFactory_openAsync, opensAndReadsTheImageInAnotherThread)
+{
+    const std::string path("tmp_openasync.gif");
+    {
+        FileIo file(path);
+        file.open("wb");
+        file.write(reinterpret_cast<const byte*>("GIF89a\x01\0\x02\0\0\0\0;"), 14);
+    }
+    std::future<Image::UniquePtr> opened = ImageFactory::openAsync(path);
+    Image::UniquePtr image = opened.get();
+    ASSERT_EQ(ImageType::gif, image->imageType());
+    image->readMetadataAsync().get();
+    ASSERT_EQ(2, image->pixelHeight());
+
+    std::promise<Image::UniquePtr> handled;
+    ImageFactory::openAsync(path, [&](Image::UniquePtr img, std::exception_ptr error) {
+        if (error) handled.set_exception(error);
+        else handled.set_value(std::move(img));
+    });
+    image = handled.get_future().get();
+    std::promise<bool> read;
+    image->readMetadataAsync([&](std::exception_ptr error) { read.set_value(!error); });
+    ASSERT_TRUE(read.get_future().get());
+    ASSERT_EQ(1, image->pixelWidth());
+    std::remove(path.c_str());
+}
+
+TEST(ImageFactory_openAsync, reportsTheErrors)
+{
+    ASSERT_THROW(ImageFactory::openAsync("this/file/does/not/exist.jpg").get(), Error);
+
+    std::promise<std::exception_ptr> handled;
+    ImageFactory::openAsync("this/file/does/not/exist.jpg", [&](Image::UniquePtr img, std::exception_ptr error) {
+        handled.set_value(img ? nullptr : error);
+    });
+    std::exception_ptr error = handled.get_future().get();
+    ASSERT_TRUE(error);
+    try {
+        std::rethrow_exception(error);
+    } catch (const Error& e) {
+        ASSERT_EQ(kerDataSourceOpenFailed, e.code());
+    }
+
+    const std::string text("not an image at all");
+    Image::UniquePtr image(new GifImage(
+        BasicIo::UniquePtr(new MemIo(reinterpret_cast<const byte*>(text.data()), static_cast<long>(text.size())))));
+    ASSERT_THROW(image->readMetadataAsync().get(), Error);
+}
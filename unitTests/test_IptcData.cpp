@@ -0,0 +1,107 @@
+#include <exiv2/iptc.hpp>
+
+#include <utility>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+TEST(AnIptcData, findsAddedKeysAndIds)
+{
+    IptcData iptcData;
+    iptcData["Iptc.Application2.Caption"] = "A caption";
+    iptcData["Iptc.Application2.City"] = "A city";
+    iptcData["Iptc.Envelope.ModelVersion"] = uint16_t(4);
+
+    ASSERT_EQ(3, iptcData.count());
+    IptcData::iterator pos = iptcData.findKey(IptcKey("Iptc.Application2.City"));
+    ASSERT_NE(iptcData.end(), pos);
+    ASSERT_EQ("A city", pos->toString());
+    ASSERT_EQ(pos, iptcData.findId(IptcDataSets::City));
+    ASSERT_EQ(iptcData.end(), iptcData.findId(IptcDataSets::Byline));
+
+    const IptcData& constData = iptcData;
+    ASSERT_EQ("4", constData.findId(IptcDataSets::ModelVersion, IptcDataSets::envelope)->toString());
+}
+
+TEST(AnIptcData, rejectsDuplicatesOfNonRepeatableDatasets)
+{
+    IptcData iptcData;
+    StringValue value("A city");
+    ASSERT_EQ(0, iptcData.add(IptcKey("Iptc.Application2.City"), &value));
+    ASSERT_EQ(6, iptcData.add(IptcKey("Iptc.Application2.City"), &value));
+    ASSERT_EQ(0, iptcData.add(IptcKey("Iptc.Application2.Keywords"), &value));
+    ASSERT_EQ(0, iptcData.add(IptcKey("Iptc.Application2.Keywords"), &value));
+    ASSERT_EQ(3, iptcData.count());
+}
+
+TEST(AnIptcData, findsFirstOfRepeatedDatasets)
+{
+    IptcData iptcData;
+    const IptcKey key("Iptc.Application2.Keywords");
+    StringValue first("first");
+    StringValue second("second");
+    iptcData["Iptc.Application2.City"] = "A city";
+    iptcData.add(key, &first);
+    iptcData.add(key, &second);
+
+    iptcData.erase(iptcData.findKey(IptcKey("Iptc.Application2.City")));
+    IptcData::iterator pos = iptcData.findKey(key);
+    ASSERT_EQ("first", pos->toString());
+    iptcData.erase(pos);
+    pos = iptcData.findKey(key);
+    ASSERT_NE(iptcData.end(), pos);
+    ASSERT_EQ("second", pos->toString());
+    iptcData.erase(pos);
+    ASSERT_EQ(iptcData.end(), iptcData.findKey(key));
+    ASSERT_TRUE(iptcData.empty());
+}
+
+TEST(AnIptcData, encodesTheRecordsInOrder)
+{
+    IptcData iptcData;
+    iptcData["Iptc.Application2.City"] = "A city";
+    iptcData["Iptc.Envelope.ModelVersion"] = uint16_t(4);
+    iptcData["Iptc.Application2.Caption"] = "A caption";
+
+    DataBuf buf = IptcParser::encode(iptcData);
+    ASSERT_EQ(iptcData.size(), buf.size_);
+    IptcData decoded;
+    ASSERT_EQ(0, IptcParser::decode(decoded, buf.pData_, static_cast<uint32_t>(buf.size_)));
+    ASSERT_EQ(3, decoded.count());
+    IptcData::const_iterator i = decoded.begin();
+    ASSERT_EQ("Iptc.Envelope.ModelVersion", (i++)->key());
+    ASSERT_EQ("Iptc.Application2.City", (i++)->key());
+    ASSERT_EQ("Iptc.Application2.Caption", (i++)->key());
+}
+
+TEST(AnIptcData, takesOverAddedValues)
+{
+    IptcData iptcData;
+    Value::UniquePtr value = Value::create(string);
+    value->read("A city");
+    const Value* pValue = value.get();
+    ASSERT_EQ(0, iptcData.add(IptcKey("Iptc.Application2.City"), std::move(value)));
+    ASSERT_EQ(6, iptcData.add(IptcKey("Iptc.Application2.City"), Value::create(string)));
+
+    IptcData::const_iterator pos = iptcData.findKey(IptcKey("Iptc.Application2.City"));
+    ASSERT_EQ(pValue, &pos->value());
+
+    Iptcdatum moved(std::move(*iptcData.begin()));
+    ASSERT_EQ(pValue, &moved.value());
+    ASSERT_EQ("Iptc.Application2.City", moved.key());
+}
+
+TEST(AnIptcData, findsAndAddsMetadataWithAKeyHandle)
+{
+    const IptcKeyHandle handle("Iptc.Application2.Caption");
+    IptcData iptcData;
+    iptcData[handle] = "A caption";
+    ASSERT_EQ(1, iptcData.count());
+    ASSERT_EQ("A caption", iptcData[handle].toString());
+    ASSERT_EQ(1, iptcData.count());
+
+    const IptcData& constData = iptcData;
+    ASSERT_TRUE(constData.findKey(handle) == constData.findId(IptcDataSets::Caption));
+    ASSERT_TRUE(iptcData.findKey(IptcKeyHandle("Iptc.Application2.Keywords")) == iptcData.end());
+}
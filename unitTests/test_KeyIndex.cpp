@@ -0,0 +1,64 @@
+#include <exiv2/metadatum.hpp>
+
+#include <string>
+#include <vector>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    typedef Internal::KeyIndex<std::string, size_t> Index;
+}
+
+TEST(AKeyIndex, findsTheFirstOfDuplicateKeys)
+{
+    Index index(true);
+    index.add("a", 0);
+    index.add("b", 1);
+    index.add("a", 2);
+
+    ASSERT_EQ(0, index.find("a")->pos_);
+    ASSERT_EQ(2, index.find("a")->count_);
+    ASSERT_EQ(1, index.find("b")->pos_);
+    ASSERT_EQ(nullptr, index.find("c"));
+}
+
+TEST(AKeyIndex, movesToTheNextMetadatumWhenTheFirstIsErased)
+{
+    Index index(true);
+    index.add("a", 0);
+    index.add("a", 2);
+    index.add("a", 3);
+
+    int calls = 0;
+    auto findNext = [&calls](size_t& next) { ++calls; next = 2; return true; };
+    index.erase("a", 2, findNext);
+    ASSERT_EQ(0, calls);
+    ASSERT_EQ(0, index.find("a")->pos_);
+    index.erase("a", 0, findNext);
+    ASSERT_EQ(1, calls);
+    ASSERT_EQ(2, index.find("a")->pos_);
+    ASSERT_EQ(1, index.find("a")->count_);
+    index.erase("a", 2, findNext);
+    ASSERT_EQ(nullptr, index.find("a"));
+}
+
+TEST(AKeyIndex, isOnlyUpdatedWhileValid)
+{
+    const std::vector<std::string> keys = {"a", "b", "a"};
+    Index index(false);
+    index.add("a", 0);
+    ASSERT_FALSE(index.valid());
+    ASSERT_EQ(nullptr, index.find("a"));
+
+    index.rebuild(0, keys.size(), [&keys](size_t pos) { return keys[pos]; });
+    ASSERT_TRUE(index.valid());
+    ASSERT_EQ(2, index.find("a")->count_);
+    ASSERT_EQ(1, index.find("b")->pos_);
+
+    index.invalidate();
+    index.add("c", 3);
+    ASSERT_EQ(nullptr, index.find("c"));
+}
@@ -0,0 +1,107 @@
+#include <exiv2/error.hpp>
+
+#include <string>
+#include <vector>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace {
+    std::vector<std::string> messages;
+
+    void collect(int /*level*/, const char* s)
+    {
+        messages.push_back(s);
+    }
+
+    class ALogMsg : public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            messages.clear();
+            level_ = LogMsg::level();
+            handler_ = LogMsg::handler();
+            LogMsg::setLevel(LogMsg::warn);
+        }
+
+        void TearDown() override
+        {
+            LogMsg::setHandler(handler_);
+            LogMsg::setLevel(level_);
+        }
+
+        LogMsg::Level level_;
+        LogMsg::Handler handler_;
+    };
+}
+
+TEST_F(ALogMsg, doesNotEvaluateFilteredMessages)
+{
+    LogMsg::setHandler(collect);
+    int evaluated = 0;
+    EXV_INFO << ++evaluated;
+    EXV_WARNING << ++evaluated;
+    ASSERT_EQ(1, evaluated);
+    ASSERT_EQ(1u, messages.size());
+    ASSERT_EQ("1", messages[0]);
+}
+
+TEST_F(ALogMsg, suppressesRepeatedMessages)
+{
+    LogMsg::HandlerOptions options;
+    options.maxRepeats = 2;
+    LogMsg::setHandler(collect, options);
+    for (int i = 0; i < 5; ++i) {
+        EXV_WARNING << "same\n";
+    }
+    EXV_WARNING << "other\n";
+
+    ASSERT_EQ(4u, messages.size());
+    ASSERT_EQ("same\n", messages[0]);
+    ASSERT_EQ("same\n", messages[1]);
+    ASSERT_EQ("Last message repeated 3 more times\n", messages[2]);
+    ASSERT_EQ("other\n", messages[3]);
+}
+
+TEST_F(ALogMsg, holdsBufferedMessagesUntilFlushed)
+{
+    LogMsg::HandlerOptions options;
+    options.buffered = true;
+    LogMsg::setHandler(collect, options);
+    EXV_WARNING << "first\n";
+    EXV_ERROR << "second\n";
+    ASSERT_TRUE(messages.empty());
+
+    LogMsg::flush();
+    ASSERT_EQ(2u, messages.size());
+    ASSERT_EQ("second\n", messages[1]);
+}
+
+TEST_F(ALogMsg, collectsTheMessagesOfTheThreadInTheInnermostScope)
+{
+    LogMsg::setHandler(0);
+    ASSERT_FALSE(LogMsg::enabled(LogMsg::warn));
+    {
+        LogMsg::Scope outer;
+        ASSERT_TRUE(LogMsg::enabled(LogMsg::warn));
+        EXV_WARNING << "outer\n";
+        {
+            LogMsg::Scope inner;
+            EXV_INFO << "filtered\n";
+            EXV_ERROR << "inner\n";
+            ASSERT_EQ(1u, inner.messages().size());
+            ASSERT_EQ(LogMsg::error, inner.messages()[0].level_);
+            ASSERT_EQ("inner\n", inner.messages()[0].text_);
+        }
+        EXV_WARNING << "again\n";
+        const LogMsg::Messages released = outer.release();
+        ASSERT_EQ(2u, released.size());
+        ASSERT_EQ("outer\n", released[0].text_);
+        ASSERT_EQ("again\n", released[1].text_);
+        ASSERT_TRUE(outer.messages().empty());
+    }
+    LogMsg::setHandler(collect);
+    EXV_WARNING << "handler\n";
+    ASSERT_EQ(1u, messages.size());
+}
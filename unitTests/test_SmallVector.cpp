@@ -0,0 +1,90 @@
+// File under test
+#include <exiv2/value.hpp>
+
+#include <stdexcept>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+TEST(SmallVector, keepsFewElementsInTheObject)
+{
+    SmallVector<uint16_t, 4> v;
+    ASSERT_TRUE(v.empty());
+    for (uint16_t i = 0; i < 4; ++i) v.push_back(i);
+    ASSERT_EQ(4u, v.size());
+    const uint16_t* data = v.data();
+    ASSERT_GE(data, reinterpret_cast<const uint16_t*>(&v));
+    ASSERT_LT(data, reinterpret_cast<const uint16_t*>(&v + 1));
+    ASSERT_EQ(3, v.back());
+}
+
+TEST(SmallVector, movesManyElementsToTheHeap)
+{
+    SmallVector<uint32_t, 2> v;
+    for (uint32_t i = 0; i < 100; ++i) v.push_back(i);
+    ASSERT_EQ(100u, v.size());
+    for (uint32_t i = 0; i < 100; ++i) ASSERT_EQ(i, v[i]);
+    v.resize(1);
+    ASSERT_EQ(1u, v.size());
+    ASSERT_EQ(0u, v.front());
+    v.clear();
+    ASSERT_TRUE(v.empty());
+    v.push_back(7);
+    ASSERT_EQ(7u, v.at(0));
+}
+
+TEST(SmallVector, copiesAndSwapsElements)
+{
+    SmallVector<Rational, 2> small;
+    small.push_back(Rational(1, 2));
+    SmallVector<Rational, 2> large;
+    for (int i = 0; i < 5; ++i) large.push_back(Rational(i, 3));
+
+    SmallVector<Rational, 2> copy(large);
+    ASSERT_TRUE(copy == large);
+    small.swap(large);
+    ASSERT_EQ(5u, small.size());
+    ASSERT_EQ(1u, large.size());
+    ASSERT_EQ(Rational(1, 2), large[0]);
+    ASSERT_TRUE(small == copy);
+    ASSERT_TRUE(small != large);
+}
+
+TEST(SmallVector, insertsAndErasesElements)
+{
+    SmallVector<int16_t, 3> v;
+    v.push_back(1);
+    v.push_back(3);
+    v.insert(v.begin() + 1, 2);
+    v.insert(v.begin(), 0);
+    ASSERT_EQ(4u, v.size());
+    for (int16_t i = 0; i < 4; ++i) ASSERT_EQ(i, v[i]);
+    v.erase(v.begin() + 1, v.begin() + 3);
+    ASSERT_EQ(2u, v.size());
+    ASSERT_EQ(0, v[0]);
+    ASSERT_EQ(3, v[1]);
+}
+
+TEST(SmallVector, checksTheRangeInAt)
+{
+    SmallVector<uint16_t, 2> v;
+    v.push_back(1);
+    ASSERT_THROW(v.at(1), std::out_of_range);
+}
+
+TEST(ValueType, readsAndCopiesValuesInTheSmallVector)
+{
+    const byte buf[] = {0x00, 0x01, 0x00, 0x02, 0x00, 0x03};
+    UShortValue value;
+    ASSERT_EQ(0, value.read(buf, sizeof(buf), bigEndian));
+    ASSERT_EQ(3, value.count());
+    ASSERT_EQ(2, value.toLong(1));
+
+    byte out[sizeof(buf)];
+    ASSERT_EQ(static_cast<long>(sizeof(buf)), value.copy(out, bigEndian));
+    ASSERT_EQ(0, std::memcmp(buf, out, sizeof(buf)));
+
+    Value::UniquePtr clone = value.clone();
+    ASSERT_EQ("1 2 3", clone->toString());
+}
@@ -0,0 +1,173 @@
+#include <exiv2/xmp_exiv2.hpp>
+
+#include <sstream>
+#include <utility>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+TEST(AnXmpData, findsAddedKeys)
+{
+    XmpData xmpData;
+    xmpData["Xmp.dc.format"] = "image/jpeg";
+    xmpData["Xmp.xmp.Rating"] = "3";
+    xmpData["Xmp.tiff.Orientation"] = "1";
+
+    ASSERT_EQ(3, xmpData.count());
+    XmpData::iterator pos = xmpData.findKey(XmpKey("Xmp.xmp.Rating"));
+    ASSERT_NE(xmpData.end(), pos);
+    ASSERT_EQ("3", pos->toString());
+    ASSERT_EQ(xmpData.end(), xmpData.findKey(XmpKey("Xmp.xmp.Label")));
+
+    const XmpData& constData = xmpData;
+    ASSERT_EQ("1", constData.findKey(XmpKey("Xmp.tiff.Orientation"))->toString());
+}
+
+TEST(AnXmpData, findsKeysAfterErasingFromTheMiddle)
+{
+    XmpData xmpData;
+    for (int i = 0; i < 100; ++i) {
+        std::ostringstream key;
+        key << "Xmp.dc.subject[" << i + 1 << "]";
+        xmpData[key.str()] = "item";
+    }
+    for (int i = 0; i < 100; i += 2) {
+        std::ostringstream key;
+        key << "Xmp.dc.subject[" << i + 1 << "]";
+        xmpData.erase(xmpData.findKey(XmpKey(key.str())));
+    }
+    ASSERT_EQ(50, xmpData.count());
+    for (int i = 0; i < 100; ++i) {
+        std::ostringstream key;
+        key << "Xmp.dc.subject[" << i + 1 << "]";
+        XmpData::iterator pos = xmpData.findKey(XmpKey(key.str()));
+        if (i % 2 == 0) {
+            ASSERT_TRUE(pos == xmpData.end());
+        }
+        else {
+            ASSERT_TRUE(pos != xmpData.end());
+            ASSERT_EQ(key.str(), pos->key());
+        }
+    }
+}
+
+TEST(AnXmpData, copyHasItsOwnIndex)
+{
+    XmpData xmpData;
+    xmpData["Xmp.xmp.Rating"] = "3";
+    XmpData copy(xmpData);
+    xmpData.clear();
+
+    ASSERT_EQ(xmpData.end(), xmpData.findKey(XmpKey("Xmp.xmp.Rating")));
+    XmpData::iterator pos = copy.findKey(XmpKey("Xmp.xmp.Rating"));
+    ASSERT_NE(copy.end(), pos);
+    ASSERT_EQ("3", pos->toString());
+}
+
+TEST(AnXmpData, keepsItsConstIteratorsWhenItIsModifiedAfterACopy)
+{
+    XmpData xmpData;
+    xmpData.add(XmpKey("Xmp.xmp.Rating"), Value::create(xmpText).get());
+    XmpData copy(xmpData);
+    const XmpData& source = xmpData;
+    const XmpData& constCopy = copy;
+    XmpData::const_iterator rating = constCopy.findKey(XmpKey("Xmp.xmp.Rating"));
+    XmpData later(copy);
+
+    copy["Xmp.xmp.Rating"] = "5";
+    ASSERT_EQ("5", rating->toString());
+    ASSERT_EQ("", source.findKey(XmpKey("Xmp.xmp.Rating"))->toString());
+    ASSERT_EQ("", later.findKey(XmpKey("Xmp.xmp.Rating"))->toString());
+}
+
+TEST(AnXmpData, isNotSharedOnceMutableIteratorsWereHandedOut)
+{
+    XmpData xmpData;
+    xmpData["Xmp.xmp.Rating"] = "3";
+    XmpData::iterator pos = xmpData.findKey(XmpKey("Xmp.xmp.Rating"));
+
+    XmpData copy(xmpData);
+    pos->setValue("4");
+    ASSERT_EQ("4", xmpData["Xmp.xmp.Rating"].toString());
+    ASSERT_EQ("3", copy["Xmp.xmp.Rating"].toString());
+}
+
+TEST(AnXmpData, movesMetadataInsteadOfCopyingThem)
+{
+    XmpData xmpData;
+    Value::UniquePtr value = Value::create(xmpText);
+    value->read("3");
+    const Value* pValue = value.get();
+    xmpData.add(XmpKey("Xmp.xmp.Rating"), std::move(value));
+    xmpData["Xmp.dc.format"] = "image/jpeg";
+
+    // Sorting moves the metadata
+    xmpData.sortByKey();
+    const XmpData& constData = xmpData;
+    ASSERT_EQ(pValue, &constData.findKey(XmpKey("Xmp.xmp.Rating"))->value());
+
+    XmpData::iterator pos = xmpData.findKey(XmpKey("Xmp.xmp.Rating"));
+    Xmpdatum moved(std::move(*pos));
+    ASSERT_EQ(pValue, &moved.value());
+    ASSERT_EQ("Xmp.xmp.Rating", moved.key());
+
+    // A moved-from Xmpdatum can be assigned to
+    *pos = moved;
+    ASSERT_EQ("3", pos->toString());
+}
+
+TEST(AnXmpArrayValue, keepsItemsInReadOrder)
+{
+    XmpArrayValue value(xmpBag);
+    value.read("first");
+    value.read("");
+    value.read("a considerably longer second keyword");
+    value.read("42");
+
+    ASSERT_EQ(3, value.count());
+    ASSERT_EQ("first", value.toString(0));
+    ASSERT_EQ("a considerably longer second keyword", value.toString(1));
+    ASSERT_EQ(42, value.toLong(2));
+    std::ostringstream os;
+    os << value;
+    ASSERT_EQ("first, a considerably longer second keyword, 42", os.str());
+}
+
+TEST(ALangAltValue, looksUpLanguagesCaseInsensitively)
+{
+    LangAltValue value;
+    value.read("lang=de-DE Hallo");
+    value.read("lang=\"x-default\" Hello");
+    value.read("lang=en-GB Hello");
+    value.read("lang=DE-de Servus");
+
+    ASSERT_EQ(3, value.count());
+    ASSERT_EQ("Servus", value.toString("de-de"));
+    ASSERT_EQ("Hello", value.toString(0));
+    std::ostringstream os;
+    os << value;
+    ASSERT_EQ("lang=\"x-default\" Hello, lang=\"en-GB\" Hello, lang=\"de-DE\" Servus", os.str());
+
+    ASSERT_EQ(1u, value.value_.erase("EN-gb"));
+    ASSERT_EQ(value.value_.end(), value.value_.find("en-GB"));
+    ASSERT_FALSE(value.value_.insert(std::make_pair("x-DEFAULT", "Hi")).second);
+    ASSERT_EQ(2u, value.value_.size());
+}
+
+TEST(AnXmpData, findsAndAddsMetadataWithAKeyHandle)
+{
+    const XmpKeyHandle handle("Xmp.dc.format");
+    ASSERT_EQ("Xmp.dc.format", handle.keyString());
+
+    XmpData xmpData;
+    xmpData["Xmp.dc.title"] = "lang=x-default A title";
+    xmpData[handle] = "image/jpeg";
+    ASSERT_EQ(2, xmpData.count());
+    ASSERT_EQ("image/jpeg", xmpData[handle].toString());
+    ASSERT_EQ(2, xmpData.count());
+
+    const XmpData& constData = xmpData;
+    ASSERT_TRUE(constData.findKey(handle) == constData.findKey(XmpKey("Xmp.dc.format")));
+    ASSERT_TRUE(xmpData.findKey(XmpKeyHandle("Xmp.dc.creator")) == xmpData.end());
+}
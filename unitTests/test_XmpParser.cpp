@@ -0,0 +1,85 @@
+// File under test
+#include <exiv2/xmp_exiv2.hpp>
+
+// Auxiliary headers
+#include <exiv2/properties.hpp>
+
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    std::string packetFor(int n)
+    {
+        std::ostringstream os;
+        os << "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\">"
+           << "<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">"
+           << "<rdf:Description rdf:about=\"\""
+           << " xmlns:dc=\"http://purl.org/dc/elements/1.1/\""
+           << " xmlns:thr" << n << "=\"http://example.com/thread/" << n << "/\""
+           << " dc:source=\"source " << n << "\""
+           << " thr" << n << ":value=\"value " << n << "\"/>"
+           << "</rdf:RDF></x:xmpmeta>";
+        return os.str();
+    }
+
+    // Decode, re-encode and decode again, returns false on any mismatch.
+    bool roundTrip(int n)
+    {
+        XmpData xmpData;
+        if (XmpParser::decode(xmpData, packetFor(n)) != 0) return false;
+
+        std::ostringstream source;
+        source << "source " << n;
+        XmpData::const_iterator pos = xmpData.findKey(XmpKey("Xmp.dc.source"));
+        if (pos == xmpData.end() || pos->toString() != source.str()) return false;
+
+        std::string packet;
+        if (XmpParser::encode(packet, xmpData) != 0) return false;
+
+        XmpData reread;
+        if (XmpParser::decode(reread, packet) != 0) return false;
+        return reread.count() == xmpData.count();
+    }
+}
+
+TEST(XmpParser, decodesAndEncodesOnSeveralThreads)
+{
+    ASSERT_TRUE(XmpParser::initialize());
+
+    const int threadCount = 4;
+    const int iterations = 50;
+    std::atomic<int> failures(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.push_back(std::thread([t, &failures]() {
+            for (int i = 0; i < iterations; ++i) {
+                if (!roundTrip(t * iterations + i)) ++failures;
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    ASSERT_EQ(0, failures.load());
+
+    // Namespaces found while parsing on the worker threads are known afterwards.
+    ASSERT_EQ("http://example.com/thread/7/", XmpProperties::ns("thr7"));
+}
+
+TEST(XmpParser, decodesASliceOfABuffer)
+{
+    const std::string packet = packetFor(1);
+    const std::string buffer = "leading bytes" + packet + "trailing bytes";
+    XmpData xmpData;
+    ASSERT_EQ(0, XmpParser::decode(xmpData, reinterpret_cast<const byte*>(buffer.data()) + 13,
+                                   static_cast<long>(packet.size())));
+    ASSERT_EQ("source 1", xmpData["Xmp.dc.source"].toString());
+    ASSERT_EQ(packet, xmpData.xmpPacket());
+}
@@ -0,0 +1,586 @@
+// File under test
+#include <exiv2/basicio.hpp>
+
+// Auxiliary headers
+#include <exiv2/error.hpp>
+#include <exiv2/futils.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    const byte testData[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9'};
+}
+
+TEST(MemIo_readView, returnsPointerIntoMemoryBlock)
+{
+    MemIo io(testData, sizeof(testData));
+    DataBuf buf;
+    io.seek(2, BasicIo::beg);
+    const byte* view = io.readView(buf, 4);
+    ASSERT_EQ(testData + 2, view);
+    ASSERT_EQ(6, io.tell());
+    ASSERT_EQ(0, buf.size_);
+}
+
+TEST(MemIo_readView, failsIfNotEnoughDataAvailable)
+{
+    MemIo io(testData, sizeof(testData));
+    DataBuf buf;
+    io.seek(8, BasicIo::beg);
+    ASSERT_EQ(nullptr, io.readView(buf, 4));
+}
+
+TEST(MemIo_reserve, keepsTheDataAndTheMemoryBlockWhileWriting)
+{
+    MemIo io(testData, sizeof(testData));
+    io.reserve(1000);
+    ASSERT_EQ(sizeof(testData), io.size());
+    ASSERT_EQ(0, io.tell());
+    const byte* block = io.mmap();
+    ASSERT_NE(testData, block);
+    ASSERT_EQ(0, std::memcmp(block, testData, sizeof(testData)));
+
+    io.seek(0, BasicIo::end);
+    for (int i = 0; i < 99; ++i) {
+        ASSERT_EQ(static_cast<long>(sizeof(testData)), io.write(testData, sizeof(testData)));
+    }
+    ASSERT_EQ(1000u, io.size());
+    ASSERT_EQ(block, io.mmap());
+    ASSERT_EQ(0, std::memcmp(io.mmap() + 990, testData, sizeof(testData)));
+}
+
+TEST(MemIo_write, growsBeyondTheReservedMemory)
+{
+    MemIo io;
+    io.reserve(4);
+    std::vector<byte> data(100000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<byte>(i);
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_EQ(static_cast<long>(data.size()), io.write(&data[0], static_cast<long>(data.size())));
+    }
+    ASSERT_EQ(20 * data.size(), io.size());
+    ASSERT_EQ(0, std::memcmp(io.mmap() + 19 * data.size(), &data[0], data.size()));
+}
+
+TEST(FileIo_readView, returnsTheFileData)
+{
+    const std::string tmpFile("tmp_readView.dat");
+    std::ofstream auxFile(tmpFile.c_str(), std::ios::binary);
+    auxFile.write(reinterpret_cast<const char*>(testData), sizeof(testData));
+    auxFile.close();
+
+    FileIo io(tmpFile);
+    ASSERT_EQ(0, io.open());
+    DataBuf buf;
+    io.seek(3, BasicIo::beg);
+    const byte* view = io.readView(buf, 5);
+    ASSERT_NE(nullptr, view);
+    ASSERT_EQ(0, memcmp(testData + 3, view, 5));
+    ASSERT_EQ(8, io.tell());
+    ASSERT_EQ(nullptr, io.readView(buf, 5));
+    io.close();
+    std::remove(tmpFile.c_str());
+}
+
+TEST(MemIo_write, copiesTheRestOfTheSource)
+{
+    MemIo src(testData, sizeof(testData));
+    src.seek(4, BasicIo::beg);
+    MemIo dst;
+    dst.write(testData, 2);
+    ASSERT_EQ(6, dst.write(src));
+    ASSERT_EQ(8, dst.size());
+    ASSERT_EQ(8, dst.tell());
+    ASSERT_EQ(0, memcmp(testData + 4, dst.mmap() + 2, 6));
+    ASSERT_EQ(0, dst.write(src));
+}
+
+TEST(FileIo_write, copiesTheRestOfTheSourceFile)
+{
+    const std::string srcFile("tmp_writeSrc.dat");
+    const std::string dstFile("tmp_writeDst.dat");
+    std::ofstream(srcFile.c_str(), std::ios::binary).write(reinterpret_cast<const char*>(testData), sizeof(testData));
+    {
+        FileIo src(srcFile);
+        ASSERT_EQ(0, src.open());
+        src.seek(3, BasicIo::beg);
+        FileIo dst(dstFile);
+        ASSERT_EQ(0, dst.open("w+b"));
+        ASSERT_EQ(1, dst.write(testData, 1));
+        ASSERT_EQ(7, dst.write(src));
+        ASSERT_EQ(10, src.tell());
+        ASSERT_EQ(8, dst.tell());
+        ASSERT_EQ(1, dst.write(testData + 9, 1));
+
+        MemIo mem(testData, sizeof(testData));
+        mem.seek(8, BasicIo::beg);
+        ASSERT_EQ(2, dst.write(mem));
+        ASSERT_EQ(11, dst.size());
+    }
+    std::ifstream file(dstFile.c_str(), std::ios::binary);
+    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    ASSERT_EQ("034567899" "89", content);
+    file.close();
+    std::remove(srcFile.c_str());
+    std::remove(dstFile.c_str());
+}
+
+#if !defined(_WIN32)
+namespace
+{
+    ino_t inodeOf(const std::string& path)
+    {
+        struct stat buf;
+        return ::stat(path.c_str(), &buf) == 0 ? buf.st_ino : 0;
+    }
+
+    std::string contentOf(const std::string& path)
+    {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+
+    //! Return true if the name of a file in the current directory starts with \em prefix
+    bool fileWithPrefixExists(const std::string& prefix)
+    {
+        bool found = false;
+        DIR* dir = ::opendir(".");
+        if (dir == 0) return found;
+        while (const struct dirent* entry = ::readdir(dir)) {
+            if (std::string(entry->d_name).compare(0, prefix.size(), prefix) == 0) found = true;
+        }
+        ::closedir(dir);
+        return found;
+    }
+}
+
+TEST(FileIo_transfer, renamesANewFileOverTheFileIfAtomic)
+{
+    const std::string path("tmp_atomicTransfer.dat");
+    std::ofstream(path.c_str(), std::ios::binary).write("old", 3);
+    ::chmod(path.c_str(), 0640);
+    const ino_t inode = inodeOf(path);
+
+    FileIo file(path);
+    ASSERT_FALSE(file.atomicTransfer());
+    file.setAtomicTransfer(true);
+    MemIo src(testData, sizeof(testData));
+    file.transfer(src);
+
+    ASSERT_NE(inode, inodeOf(path));
+    ASSERT_EQ("0123456789", contentOf(path));
+    ASSERT_FALSE(fileWithPrefixExists(path + "."));
+    struct stat buf;
+    ASSERT_EQ(0, ::stat(path.c_str(), &buf));
+    ASSERT_EQ(0640u, buf.st_mode & 0777u);
+    std::remove(path.c_str());
+}
+
+TEST(FileIo_transfer, copiesIntoAFileWithSeveralHardLinks)
+{
+    const std::string path("tmp_atomicTransferLinked.dat");
+    const std::string link("tmp_atomicTransferLink.dat");
+    std::ofstream(path.c_str(), std::ios::binary).write("old", 3);
+    ASSERT_EQ(0, ::link(path.c_str(), link.c_str()));
+    const ino_t inode = inodeOf(path);
+
+    FileIo file(path);
+    file.setAtomicTransfer(true);
+    MemIo src(testData, sizeof(testData));
+    file.transfer(src);
+
+    ASSERT_EQ(inode, inodeOf(path));
+    ASSERT_EQ("0123456789", contentOf(link));
+    std::remove(path.c_str());
+    std::remove(link.c_str());
+}
+#endif
+
+TEST(MemIo_readAt, readsWithoutMovingThePosition)
+{
+    MemIo io(testData, sizeof(testData));
+    byte buf[4];
+    io.seek(1, BasicIo::beg);
+    ASSERT_EQ(4, io.readAt(5, buf, 4));
+    ASSERT_EQ(0, memcmp(testData + 5, buf, 4));
+    ASSERT_EQ(1, io.tell());
+}
+
+TEST(MemIo_readAt, readsFewerBytesAtTheEnd)
+{
+    MemIo io(testData, sizeof(testData));
+    byte buf[4];
+    ASSERT_EQ(2, io.readAt(8, buf, 4));
+    ASSERT_EQ(0, io.readAt(10, buf, 4));
+    ASSERT_EQ(0, io.readAt(-1, buf, 4));
+}
+
+TEST(MemIo_prefetch, isIgnoredBySeekableSources)
+{
+    MemIo io(testData, sizeof(testData));
+    io.seek(3, BasicIo::beg);
+    std::vector<std::pair<long, long> > ranges;
+    ranges.push_back(std::make_pair(0L, 4L));
+    ranges.push_back(std::make_pair(100L, 4L));
+    io.prefetch(ranges);
+    ASSERT_EQ(3, io.tell());
+    ASSERT_EQ('3', io.getb());
+}
+
+TEST(MemIo_writev, writesAllPiecesInOrder)
+{
+    MemIo io;
+    const byte header[] = { 0xff, 0xe1 };
+    const std::pair<const byte*, long> pieces[] = {
+        std::make_pair(static_cast<const byte*>(header), 2L),
+        std::make_pair(testData, 0L),
+        std::make_pair(testData + 3, 4L)
+    };
+    ASSERT_EQ(6, io.writev(pieces, 3));
+    ASSERT_EQ(6, io.tell());
+    ASSERT_EQ(6u, io.size());
+    ASSERT_EQ(0, memcmp(io.mmap(), "\xff\xe1" "3456", 6));
+}
+
+TEST(FileIo_writev, writesAllPiecesInOrder)
+{
+    const std::string tmpFile("tmp_writev.dat");
+    FileIo io(tmpFile);
+    ASSERT_EQ(0, io.open("w+b"));
+    const std::pair<const byte*, long> pieces[] = {
+        std::make_pair(testData + 8, 2L),
+        std::make_pair(testData, 8L)
+    };
+    ASSERT_EQ(10, io.writev(pieces, 2));
+    ASSERT_EQ(10, io.tell());
+    byte buf[10];
+    io.seek(0, BasicIo::beg);
+    ASSERT_EQ(10, io.read(buf, 10));
+    ASSERT_EQ(0, memcmp(buf, "8901234567", 10));
+    io.close();
+    std::remove(tmpFile.c_str());
+}
+
+TEST(FileIo_readAt, readsWithoutMovingThePosition)
+{
+    const std::string tmpFile("tmp_readAt.dat");
+    std::ofstream auxFile(tmpFile.c_str(), std::ios::binary);
+    auxFile.write(reinterpret_cast<const char*>(testData), sizeof(testData));
+    auxFile.close();
+
+    FileIo io(tmpFile);
+    ASSERT_EQ(0, io.open());
+    byte buf[4];
+    io.seek(2, BasicIo::beg);
+    ASSERT_EQ(4, io.readAt(6, buf, 4));
+    ASSERT_EQ(0, memcmp(testData + 6, buf, 4));
+    ASSERT_EQ(2, io.tell());
+    ASSERT_EQ(1, io.readAt(9, buf, 4));
+    ASSERT_EQ('9', buf[0]);
+    ASSERT_EQ('2', io.getb());
+    io.close();
+    std::remove(tmpFile.c_str());
+}
+
+TEST(FileIo_prefetch, isAHintWhichLeavesThePositionAlone)
+{
+    const std::string tmpFile("tmp_prefetch.dat");
+    std::ofstream auxFile(tmpFile.c_str(), std::ios::binary);
+    auxFile.write(reinterpret_cast<const char*>(testData), sizeof(testData));
+    auxFile.close();
+
+    FileIo io(tmpFile);
+    ASSERT_FALSE(io.prefetches());
+    io.setReadAhead(true);
+#if defined(POSIX_FADV_WILLNEED)
+    ASSERT_TRUE(io.prefetches());
+#endif
+    ASSERT_EQ(0, io.open());
+    io.seek(3, BasicIo::beg);
+    std::vector<std::pair<long, long> > ranges;
+    ranges.push_back(std::make_pair(0L, 4L));
+    ranges.push_back(std::make_pair(6L, 100L));
+    ranges.push_back(std::make_pair(-1L, 4L));
+    io.prefetch(ranges);
+    ASSERT_EQ(3, io.tell());
+    ASSERT_EQ('3', io.getb());
+    io.close();
+    std::remove(tmpFile.c_str());
+}
+
+TEST(FileIo_advise, isAHintWhichLeavesTheDataAlone)
+{
+    const std::string tmpFile("tmp_advise.dat");
+    std::ofstream auxFile(tmpFile.c_str(), std::ios::binary);
+    auxFile.write(reinterpret_cast<const char*>(testData), sizeof(testData));
+    auxFile.close();
+
+    FileIo io(tmpFile);
+    io.setReadAhead(true);
+    ASSERT_EQ(0, io.open());
+    io.seek(3, BasicIo::beg);
+    io.advise(BasicIo::randomAccess);
+    ASSERT_EQ(3, io.tell());
+    ASSERT_EQ('3', io.getb());
+    io.advise(BasicIo::sequentialAccess);
+    io.seek(0, BasicIo::beg);
+    MemIo copy;
+    ASSERT_EQ(static_cast<long>(sizeof(testData)), copy.write(io));
+    ASSERT_EQ(0, std::memcmp(copy.mmap(), testData, sizeof(testData)));
+    io.advise(BasicIo::normalAccess);
+    io.close();
+    std::remove(tmpFile.c_str());
+}
+
+TEST(MemoryBlockCache, returnsStoredBlocks)
+{
+    MemoryBlockCache cache;
+    std::string data;
+    ASSERT_FALSE(cache.get("file", 0, data));
+    cache.put("file", 0, "block 0");
+    cache.put("file", 1, "block 1");
+    cache.put("other file", 0, "other block 0");
+    ASSERT_TRUE(cache.get("file", 1, data));
+    ASSERT_EQ("block 1", data);
+    ASSERT_TRUE(cache.get("other file", 0, data));
+    ASSERT_EQ("other block 0", data);
+    ASSERT_EQ(27u, cache.size());
+}
+
+TEST(MemoryBlockCache, dropsLeastRecentlyUsedBlocks)
+{
+    MemoryBlockCache cache(10);
+    std::string data;
+    cache.put("file", 0, "aaaa");
+    cache.put("file", 1, "bbbb");
+    ASSERT_TRUE(cache.get("file", 0, data));
+    cache.put("file", 2, "cccc");
+    ASSERT_EQ(8u, cache.size());
+    ASSERT_FALSE(cache.get("file", 1, data));
+    ASSERT_TRUE(cache.get("file", 0, data));
+    ASSERT_TRUE(cache.get("file", 2, data));
+    cache.put("file", 3, "a block larger than the cache");
+    ASSERT_FALSE(cache.get("file", 3, data));
+}
+
+TEST(FileBlockCache, keepsBlocksAcrossInstances)
+{
+    const std::string key("http://example.com/image.jpg\n1234\n1024\n\"etag\"");
+    std::string data;
+    {
+        FileBlockCache cache(".");
+        ASSERT_FALSE(cache.get(key, 7, data));
+        cache.put(key, 7, std::string("with\0zero", 9));
+    }
+    FileBlockCache cache(".");
+    ASSERT_TRUE(cache.get(key, 7, data));
+    ASSERT_EQ(std::string("with\0zero", 9), data);
+    ASSERT_FALSE(cache.get(key + "2", 7, data));
+    std::remove(cache.blockPath(key, 7).c_str());
+    ASSERT_FALSE(cache.get(key, 7, data));
+}
+
+TEST(IoStats, countsTheReadsWritesAndSeeksOfMemIo)
+{
+    MemIo io;
+    ASSERT_EQ(10, io.write(testData, sizeof(testData)));
+    ASSERT_EQ(0, io.seek(2, BasicIo::beg));
+    byte buf[4];
+    ASSERT_EQ(4, io.read(buf, sizeof(buf)));
+    ASSERT_EQ('6', io.getb());
+    ASSERT_EQ(3, io.readAt(7, buf, sizeof(buf)));
+
+    const IoStats& stats = io.stats();
+    ASSERT_EQ(1u, stats.writes_);
+    ASSERT_EQ(10u, stats.bytesWritten_);
+    ASSERT_EQ(1u, stats.seeks_);
+    ASSERT_EQ(3u, stats.reads_);
+    ASSERT_EQ(8u, stats.bytesRead_);
+    ASSERT_EQ(0u, stats.allocations_);
+}
+
+TEST(IoStats, countsAllocationsWhileAnIoCloserHoldsTheIo)
+{
+    MemIo io;
+    DataBuf before(100);
+    {
+        IoCloser closer(io);
+        DataBuf buf(100);
+        DataBuf copy(buf.pData_, 50);
+        MemIo other;
+        {
+            IoCloser inner(other);
+            DataBuf elsewhere(10);
+        }
+        ASSERT_EQ(1u, other.stats().allocations_);
+    }
+    DataBuf after(100);
+    ASSERT_EQ(2u, io.stats().allocations_);
+    ASSERT_EQ(150u, io.stats().bytesAllocated_);
+}
+
+TEST(IoStatsCollector, addsTheStatsOfDestroyedIos)
+{
+    IoStats stats;
+    {
+        IoStatsCollector collector(stats);
+        MemIo first;
+        first.write(testData, sizeof(testData));
+        MemIo second;
+        second.write(testData, 4);
+    }
+    MemIo notCollected;
+    notCollected.write(testData, sizeof(testData));
+    ASSERT_EQ(2u, stats.writes_);
+    ASSERT_EQ(14u, stats.bytesWritten_);
+}
+
+TEST(ParseLimits, areUnlimitedByDefault)
+{
+    MemIo io;
+    ASSERT_FALSE(io.parseLimits().limited());
+    ParseLimits limits;
+    limits.timeoutMs_ = 1000;
+    io.setParseLimits(limits);
+    ASSERT_TRUE(io.parseLimits().limited());
+}
+
+TEST(ParseLimits, limitTheAllocationsWhileAnIoCloserHoldsTheIo)
+{
+    MemIo io;
+    ParseLimits limits;
+    limits.maxAllocation_ = 100;
+    io.setParseLimits(limits);
+    {
+        IoCloser closer(io);
+        DataBuf buf(60);
+        {
+            // An IO without limits leaves the budget of the outer one in effect
+            MemIo other;
+            IoCloser inner(other);
+            ASSERT_THROW(DataBuf(50), Error);
+        }
+        DataBuf more(40);
+        try {
+            DataBuf tooMuch(1);
+            FAIL() << "The allocation exceeds the limit";
+        } catch (const Error& e) {
+            ASSERT_EQ(kerResourceLimitExceeded, e.code());
+        }
+    }
+    DataBuf unlimited(1000);
+}
+
+namespace
+{
+    //! Return an HttpIo for \em url with \em options
+    BasicIo::UniquePtr createHttpIo(const std::string& url, const RemoteOptions& options)
+    {
+        HttpIo* io = new HttpIo(url);
+        io->setRemoteOptions(options);
+        return BasicIo::UniquePtr(io);
+    }
+}
+
+TEST(HttpIo_open, failsIfTheRequestsAreCancelled)
+{
+    RemoteOptions options;
+    options.cancel_ = std::make_shared<CancelToken>();
+    options.cancel_->cancel();
+    BasicIo::UniquePtr io = createHttpIo("http://127.0.0.1:9/image.jpg", options);
+    try {
+        io->open();
+        FAIL() << "The request was sent";
+    } catch (const Error& e) {
+        ASSERT_EQ(kerRemoteRequestStopped, e.code());
+    }
+    ASSERT_EQ(0u, io->stats().remoteRequests_);
+}
+
+#if !defined(_WIN32)
+namespace
+{
+    //! A server which accepts connections in its backlog and never answers
+    class SilentServer {
+    public:
+        SilentServer() : fd_(socket(AF_INET, SOCK_STREAM, 0))
+        {
+            sockaddr_in addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t length = sizeof(addr);
+            bind(fd_, reinterpret_cast<sockaddr*>(&addr), length);
+            listen(fd_, 4);
+            getsockname(fd_, reinterpret_cast<sockaddr*>(&addr), &length);
+            port_ = ntohs(addr.sin_port);
+        }
+        ~SilentServer() { close(fd_); }
+
+        std::string url() const { return "http://127.0.0.1:" + std::to_string(port_) + "/image.jpg"; }
+
+    private:
+        int fd_;
+        int port_;
+    };
+}
+
+TEST(HttpIo_open, givesUpAtTheDeadline)
+{
+    SilentServer server;
+    RemoteOptions options;
+    options.timeoutMs_ = 200;
+    BasicIo::UniquePtr io = createHttpIo(server.url(), options);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    try {
+        io->open();
+        FAIL() << "The server answered";
+    } catch (const Error& e) {
+        ASSERT_EQ(kerRemoteRequestStopped, e.code());
+    }
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(HttpIo_open, isCancelledFromAnotherThread)
+{
+    SilentServer server;
+    RemoteOptions options;
+    options.cancel_ = std::make_shared<CancelToken>();
+    std::shared_ptr<CancelToken> token = options.cancel_;
+    std::thread canceller([token]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        token->cancel();
+    });
+    BasicIo::UniquePtr io = createHttpIo(server.url(), options);
+    try {
+        io->open();
+        ADD_FAILURE() << "The server answered";
+    } catch (const Error& e) {
+        EXPECT_EQ(kerRemoteRequestStopped, e.code());
+    }
+    canceller.join();
+}
+#endif
@@ -0,0 +1,147 @@
+// File under test
+#include <exiv2/batch.hpp>
+
+// Auxiliary headers
+#include <exiv2/basicio.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/jpgimage.hpp>
+#include <exiv2/xmp_exiv2.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    //! Write a JPEG image with the artist \em artist to \em path
+    void writeJpeg(const std::string& path, const std::string& artist)
+    {
+        Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+        image->exifData()["Exif.Image.Artist"] = artist;
+        image->xmpData()["Xmp.dc.source"] = "A source";
+        image->writeMetadata();
+
+        FileIo file(path);
+        file.open("wb");
+        file.write(image->io());
+    }
+
+    //! Files of a batch: images, an unknown file type and a missing file
+    struct BatchFiles {
+        BatchFiles()
+        {
+            for (int i = 0; i < 10; ++i) {
+                paths_.push_back("tmp_batch" + std::to_string(i) + ".jpg");
+                writeJpeg(paths_.back(), "Artist " + std::to_string(i));
+            }
+            paths_.push_back("tmp_batch.txt");
+            FileIo file(paths_.back());
+            file.open("wb");
+            file.write(reinterpret_cast<const byte*>("No image"), 8);
+            paths_.push_back("tmp_batch_missing.jpg");
+        }
+        ~BatchFiles()
+        {
+            for (auto&& path : paths_) std::remove(path.c_str());
+        }
+        std::vector<std::string> paths_;
+    };
+}
+
+TEST(BatchProcessor, readsTheImagesAndReportsTheErrorOfEachFile)
+{
+    BatchFiles files;
+    BatchProcessor batch(3);
+    ASSERT_EQ(3u, batch.threads());
+    ASSERT_EQ(6u, batch.prefetch());
+    batch.setPrefetch(2);
+
+    std::atomic<int> calls(0);
+    const BatchProcessor::Results results = batch.run(files.paths_, [&](Image& image) {
+        ++calls;
+        const std::string artist = image.exifData()["Exif.Image.Artist"].toString();
+        if (artist == "Artist 7") throw std::runtime_error("Callback failed");
+        ASSERT_EQ("Artist " + image.io().path().substr(9, 1), artist);
+    });
+
+    ASSERT_EQ(10, calls);
+    ASSERT_EQ(files.paths_.size(), results.size());
+    for (size_t i = 0; i < 10; ++i) {
+        ASSERT_EQ(files.paths_[i], results[i].path_);
+        if (i == 7) {
+            ASSERT_EQ(kerErrorMessage, results[i].code_);
+            ASSERT_EQ("Callback failed", results[i].message_);
+        } else {
+            ASSERT_EQ(kerSuccess, results[i].code_);
+            ASSERT_TRUE(results[i].message_.empty());
+        }
+    }
+    ASSERT_EQ(kerFileContainsUnknownImageType, results[10].code_);
+    ASSERT_NE(kerSuccess, results[11].code_);
+    ASSERT_FALSE(results[11].message_.empty());
+}
+
+TEST(BatchProcessor, takesThePathsFromASourceAndAppliesTheDecodeFilter)
+{
+    BatchFiles files;
+    BatchProcessor batch(2);
+    batch.setDecodeFilter(DecodeFilter().addFamily("Xmp"));
+
+    size_t next = 0;
+    std::atomic<int> exifCount(0);
+    std::atomic<int> xmpCount(0);
+    const BatchProcessor::Results results = batch.run(
+        [&](std::string& path) {
+            if (next == 10) return false;
+            path = files.paths_[next++];
+            return true;
+        },
+        [&](Image& image) {
+            exifCount += static_cast<int>(image.exifData().count());
+            xmpCount += static_cast<int>(image.xmpData().count());
+        });
+
+    ASSERT_EQ(10u, results.size());
+    ASSERT_EQ(0, exifCount);
+    ASSERT_EQ(10, xmpCount);
+}
+
+TEST(BatchProcessor, rethrowsTheErrorOfTheSourceAfterTheOpenedImages)
+{
+    BatchFiles files;
+    BatchProcessor batch(2);
+    size_t next = 0;
+    std::atomic<int> calls(0);
+    ASSERT_THROW(batch.run(
+                     [&](std::string& path) {
+                         if (next == 4) throw std::runtime_error("Source failed");
+                         path = files.paths_[next++];
+                         return true;
+                     },
+                     [&](Image&) { ++calls; }),
+                 std::runtime_error);
+    ASSERT_EQ(4, calls);
+}
+
+TEST(BatchProcessor, returnsTheLogMessagesOfEachFileWithItsResult)
+{
+    BatchFiles files;
+    BatchProcessor batch(3);
+    const BatchProcessor::Results results = batch.run(files.paths_, [&](Image& image) {
+        EXV_WARNING << image.io().path();
+    });
+
+    ASSERT_EQ(files.paths_.size(), results.size());
+    for (size_t i = 0; i < 10; ++i) {
+        ASSERT_EQ(1u, results[i].messages_.size());
+        ASSERT_EQ(LogMsg::warn, results[i].messages_[0].level_);
+        ASSERT_EQ(files.paths_[i], results[i].messages_[0].text_);
+    }
+}
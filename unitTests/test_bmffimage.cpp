@@ -0,0 +1,191 @@
+// File under test
+#include <exiv2/bmffimage.hpp>
+
+// Auxiliary headers
+#include <exiv2/basicio.hpp>
+#include <exiv2/error.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/xmp_exiv2.hpp>
+
+#include <string>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    std::string be16(uint16_t value)
+    {
+        byte buf[2];
+        us2Data(buf, value, bigEndian);
+        return std::string(reinterpret_cast<const char*>(buf), 2);
+    }
+
+    std::string be32(uint32_t value)
+    {
+        byte buf[4];
+        ul2Data(buf, value, bigEndian);
+        return std::string(reinterpret_cast<const char*>(buf), 4);
+    }
+
+    std::string box(const std::string& type, const std::string& payload)
+    {
+        return be32(static_cast<uint32_t>(8 + payload.size())) + type + payload;
+    }
+
+    std::string fullBox(const std::string& type, char version, const std::string& payload)
+    {
+        return box(type, std::string(1, version) + std::string(3, '\0') + payload);
+    }
+
+    std::string uuidBox(const std::string& uuid, const std::string& payload)
+    {
+        return be32(static_cast<uint32_t>(24 + payload.size())) + "uuid" + uuid + payload;
+    }
+
+    std::string infe(uint16_t id, const std::string& type, const std::string& contentType = "")
+    {
+        std::string payload = be16(id) + be16(0) + type + std::string(1, '\0');
+        if (!contentType.empty()) payload += contentType + std::string(1, '\0');
+        return fullBox("infe", 2, payload);
+    }
+
+    //! TIFF structure with the Exif metadata \em exifData
+    std::string tiff(const ExifData& exifData)
+    {
+        Blob blob;
+        ExifParser::encode(blob, littleEndian, exifData);
+        return std::string(reinterpret_cast<const char*>(&blob[0]), blob.size());
+    }
+
+    const std::string xmpPacket(
+        "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\">"
+        "<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">"
+        "<rdf:Description rdf:about=\"\" xmlns:dc=\"http://purl.org/dc/elements/1.1/\" dc:format=\"image/heic\"/>"
+        "</rdf:RDF></x:xmpmeta>");
+
+    //! HEIC image with an Exif and an XMP item, an ICC profile and \em imageSize bytes of image data
+    std::string heic(long imageSize)
+    {
+        ExifData exifData;
+        exifData["Exif.Image.Make"] = "Apple";
+        const std::string exif = be32(0) + tiff(exifData);
+        const std::string icc = be32(16) + std::string(12, 'i');
+
+        const std::string ftyp = box("ftyp", std::string("heic") + be32(0) + "mif1heic");
+        // The size of the meta box does not depend on the offsets of the items
+        std::string meta;
+        for (int pass = 0; pass < 2; ++pass) {
+            const uint32_t mdat = static_cast<uint32_t>(ftyp.size() + meta.size() + 8);
+            const std::string iloc = fullBox("iloc", 0, std::string("\x44\x00", 2) + be16(3)
+                + be16(1) + be16(0) + be16(1) + be32(mdat + static_cast<uint32_t>(exif.size() + xmpPacket.size()))
+                                                + be32(static_cast<uint32_t>(imageSize))
+                + be16(2) + be16(0) + be16(1) + be32(mdat) + be32(static_cast<uint32_t>(exif.size()))
+                + be16(3) + be16(0) + be16(1) + be32(mdat + static_cast<uint32_t>(exif.size()))
+                                                + be32(static_cast<uint32_t>(xmpPacket.size())));
+            const std::string iinf = fullBox("iinf", 0, be16(3) + infe(1, "hvc1") + infe(2, "Exif")
+                                             + infe(3, "mime", "application/rdf+xml"));
+            const std::string ipco = box("ipco", fullBox("ispe", 0, be32(4032) + be32(3024))
+                                                 + box("colr", "prof" + icc));
+            const std::string ipma = fullBox("ipma", 0, be32(1) + be16(1) + std::string("\x02\x81\x02", 3));
+            meta = fullBox("meta", 0, fullBox("hdlr", 0, std::string(4, '\0') + "pict" + std::string(13, '\0'))
+                                      + fullBox("pitm", 0, be16(1)) + iinf + iloc + box("iprp", ipco + ipma));
+        }
+        return ftyp + meta + box("mdat", exif + xmpPacket + std::string(imageSize, '\0'));
+    }
+
+    //! CR3 image with IFD0 in CMT1, the Exif IFD in CMT2 and an XMP box
+    std::string cr3()
+    {
+        ExifData exifData;
+        exifData["Exif.Image.Make"] = "Canon";
+        // Exif IFD with the exposure time 1/100, which is the root IFD of CMT2
+        const std::string exifIfd = std::string("II*\0\x08\0\0\0", 8)
+            + std::string("\x01\0\x9a\x82\x05\0\x01\0\0\0\x1a\0\0\0\0\0\0\0", 18)
+            + std::string("\x01\0\0\0\x64\0\0\0", 8);
+        const std::string canon("\x85\xc0\xb6\x87\x82\x0f\x11\xe0\x81\x11\xf4\xce\x46\x2b\x6a\x48", 16);
+        const std::string xmp("\xbe\x7a\xcf\xcb\x97\xa9\x42\xe8\x9c\x71\x99\x94\x91\xe3\xaf\xac", 16);
+        return box("ftyp", std::string("crx ") + be32(1) + "crx isom")
+             + box("moov", uuidBox(canon, box("CMT1", tiff(exifData)) + box("CMT2", exifIfd)))
+             + uuidBox(xmp, xmpPacket)
+             + box("mdat", std::string(1000, '\0'));
+    }
+
+    //! Open the image \em data, which must outlive the image
+    Image::UniquePtr open(const std::string& data)
+    {
+        return ImageFactory::open(reinterpret_cast<const byte*>(data.data()), static_cast<long>(data.size()));
+    }
+}
+
+TEST(BmffImage, readsTheMetadataItemsOfHeicImages)
+{
+    const long imageSize = 1024 * 1024;
+    const std::string data = heic(imageSize);
+    Image::UniquePtr image = open(data);
+    ASSERT_EQ(ImageType::bmff, image->imageType());
+    image->readMetadata();
+
+    ASSERT_EQ("image/heic", image->mimeType());
+    ASSERT_EQ(4032, image->pixelWidth());
+    ASSERT_EQ(3024, image->pixelHeight());
+    ExifData::const_iterator make = image->exifData().findKey(ExifKey("Exif.Image.Make"));
+    ASSERT_NE(image->exifData().end(), make);
+    ASSERT_EQ("Apple", make->toString());
+    XmpData::const_iterator format = image->xmpData().findKey(XmpKey("Xmp.dc.format"));
+    ASSERT_NE(image->xmpData().end(), format);
+    ASSERT_EQ("image/heic", format->toString());
+    ASSERT_EQ(16, image->iccProfile()->size_);
+    // Only the headers of the boxes and the metadata are read, not the image data
+    ASSERT_LT(image->io().stats().bytesRead_, 4096u);
+}
+
+TEST(BmffImage, readsTheTiffStructuresOfCr3Images)
+{
+    const std::string data = cr3();
+    Image::UniquePtr image = open(data);
+    ASSERT_EQ(ImageType::bmff, image->imageType());
+    image->readMetadata();
+
+    ASSERT_EQ("image/x-canon-cr3", image->mimeType());
+    ExifData::const_iterator make = image->exifData().findKey(ExifKey("Exif.Image.Make"));
+    ASSERT_NE(image->exifData().end(), make);
+    ASSERT_EQ("Canon", make->toString());
+    ExifData::const_iterator exposure = image->exifData().findKey(ExifKey("Exif.Photo.ExposureTime"));
+    ASSERT_NE(image->exifData().end(), exposure);
+    ASSERT_EQ("1/100", exposure->toString());
+    ASSERT_NE(image->xmpData().end(), image->xmpData().findKey(XmpKey("Xmp.dc.format")));
+}
+
+TEST(BmffImage, isReadOnly)
+{
+    const std::string data = cr3();
+    Image::UniquePtr image = open(data);
+    image->readMetadata();
+    ASSERT_THROW(image->writeMetadata(), Error);
+    ASSERT_THROW(image->setComment("comment"), Error);
+}
+
+TEST(BmffImage, rejectsBoxesWhichExceedTheFile)
+{
+    std::string data = heic(16);
+    // Grow the size of the meta box beyond the end of the file
+    const size_t meta = data.find("meta") - 4;
+    data.replace(meta, 4, be32(static_cast<uint32_t>(data.size())));
+    Image::UniquePtr image = open(data);
+    ASSERT_THROW(image->readMetadata(), Error);
+}
+
+TEST(BmffImage, isBmffTypeChecksTheBrand)
+{
+    const std::string heif = box("ftyp", std::string("mif1") + be32(0));
+    MemIo io(reinterpret_cast<const byte*>(heif.data()), static_cast<long>(heif.size()));
+    ASSERT_TRUE(isBmffType(io, false));
+    ASSERT_EQ(0, io.tell());
+
+    const std::string mp4 = box("ftyp", std::string("isom") + be32(0));
+    MemIo other(reinterpret_cast<const byte*>(mp4.data()), static_cast<long>(mp4.size()));
+    ASSERT_FALSE(isBmffType(other, false));
+}
@@ -0,0 +1,115 @@
+#include <exiv2/convert.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/iptc.hpp>
+#include <exiv2/xmp_exiv2.hpp>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+TEST(AMetadataConverter, convertsLikeTheFreeFunctions)
+{
+    ExifData exifData;
+    exifData["Exif.Image.Artist"] = "Somebody";
+    exifData["Exif.Photo.ExposureTime"] = URational(1, 125);
+
+    XmpData expected;
+    copyExifToXmp(exifData, expected);
+
+    const MetadataConverter converter;
+    for (int i = 0; i < 2; ++i) {
+        XmpData xmpData;
+        converter.copyExifToXmp(exifData, xmpData);
+        ASSERT_EQ(expected.count(), xmpData.count());
+        ASSERT_EQ("Somebody", xmpData["Xmp.dc.creator"].toString());
+        ASSERT_EQ("1/125", xmpData["Xmp.exif.ExposureTime"].toString());
+    }
+}
+
+TEST(AMetadataConverter, usesOnlyTheRulesOfTheGivenKeys)
+{
+    ExifData exifData;
+    exifData["Exif.Image.Artist"] = "Somebody";
+    exifData["Exif.Photo.ExposureTime"] = URational(1, 125);
+
+    std::vector<std::string> keys;
+    keys.push_back("Xmp.exif.ExposureTime");
+    const MetadataConverter converter(keys);
+
+    XmpData xmpData;
+    converter.moveExifToXmp(exifData, xmpData);
+    ASSERT_EQ(1, xmpData.count());
+    ASSERT_EQ("1/125", xmpData["Xmp.exif.ExposureTime"].toString());
+    ASSERT_EQ(1, exifData.count());
+    ASSERT_NE(exifData.end(), exifData.findKey(ExifKey("Exif.Image.Artist")));
+
+    ExifData exifData2;
+    converter.copyXmpToExif(xmpData, exifData2);
+    ASSERT_EQ(1, exifData2.count());
+    ASSERT_EQ("1/125", exifData2["Exif.Photo.ExposureTime"].toString());
+}
+
+TEST(AMetadataConverter, convertsIptcWithAFixedCharset)
+{
+    IptcData iptcData;
+    iptcData["Iptc.Application2.City"] = "Z\xfcrich";
+
+    MetadataConverter converter;
+    converter.setIptcCharset("ISO-8859-1");
+    XmpData xmpData;
+    converter.copyIptcToXmp(iptcData, xmpData);
+    ASSERT_EQ("Z\xc3\xbcrich", xmpData["Xmp.photoshop.City"].toString());
+
+    IptcData iptcData2;
+    converter.copyXmpToIptc(xmpData, iptcData2);
+    ASSERT_EQ("Z\xc3\xbcrich", iptcData2["Iptc.Application2.City"].toString());
+}
+
+TEST(convertStringCharset, leavesAsciiUnchanged)
+{
+    std::string str("plain text");
+    ASSERT_TRUE(convertStringCharset(str, "UTF-8", "ISO-8859-1"));
+    ASSERT_EQ("plain text", str);
+    ASSERT_TRUE(convertStringCharset(str, "latin1", "utf8"));
+    ASSERT_EQ("plain text", str);
+}
+
+#ifdef EXV_HAVE_ICONV
+TEST(convertStringCharset, convertsRepeatedlyWithTheSameCharsets)
+{
+    for (int i = 0; i < 3; ++i) {
+        std::string str("Z\xfcrich");
+        ASSERT_TRUE(convertStringCharset(str, "ISO-8859-1", "UTF-8"));
+        ASSERT_EQ("Z\xc3\xbcrich", str);
+    }
+    std::string str("ab");
+    ASSERT_TRUE(convertStringCharset(str, "UTF-8", "UCS-2LE"));
+    ASSERT_EQ(std::string("a\0b\0", 4), str);
+}
+#endif
+
+TEST(copyExifToXmp, convertsGpsCoordinatesWithLargeUnsignedRationals)
+{
+    ExifData exifData;
+    URationalValue coord;
+    coord.read("48/1 3000000000/100000000 0/1");
+    exifData["Exif.GPSInfo.GPSLatitude"] = coord;
+    exifData["Exif.GPSInfo.GPSLatitudeRef"] = "N";
+
+    XmpData xmpData;
+    copyExifToXmp(exifData, xmpData);
+    ASSERT_EQ("48,30.0000000N", xmpData["Xmp.exif.GPSLatitude"].toString());
+}
+
+TEST(AValue, convertsRationalsToDouble)
+{
+    URationalValue value;
+    value.read("3000000000/2 1/0");
+    ASSERT_DOUBLE_EQ(1500000000.0, value.toDouble(0));
+    ASSERT_TRUE(value.ok());
+    value.toDouble(1);
+    ASSERT_FALSE(value.ok());
+
+    const LongValue longValue(7);
+    ASSERT_DOUBLE_EQ(7.0, longValue.toDouble());
+}
@@ -0,0 +1,213 @@
+// File under test
+#include <exiv2/easyaccess.hpp>
+
+// Auxiliary headers
+#include <exiv2/basicio.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/jpgimage.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    //! Exif data with a GPS fix in the south west and tags of the other IFDs
+    ExifData gpsExifData()
+    {
+        ExifData ed;
+        ed["Exif.Image.Make"] = "Camera";
+        ed["Exif.Photo.ExposureTime"] = URational(1, 125);
+        ed["Exif.Iop.InteroperabilityIndex"] = "R98";
+        ed["Exif.GPSInfo.GPSVersionID"] = "2 3 0 0";
+        ed["Exif.GPSInfo.GPSLatitudeRef"] = "S";
+        URationalValue latitude;
+        latitude.read("33/1 51/1 3456/100");
+        ed.add(ExifKey("Exif.GPSInfo.GPSLatitude"), &latitude);
+        ed["Exif.GPSInfo.GPSLongitudeRef"] = "W";
+        URationalValue longitude;
+        longitude.read("70/1 3960/100 0/1");
+        ed.add(ExifKey("Exif.GPSInfo.GPSLongitude"), &longitude);
+        ed["Exif.GPSInfo.GPSAltitudeRef"] = uint8_t(1);
+        ed["Exif.GPSInfo.GPSAltitude"] = URational(255, 10);
+        URationalValue time;
+        time.read("12/1 30/1 91/2");
+        ed.add(ExifKey("Exif.GPSInfo.GPSTimeStamp"), &time);
+        ed["Exif.GPSInfo.GPSDateStamp"] = "2020:06:15";
+        return ed;
+    }
+
+    //! Write a JPEG image with the Exif data \em ed to \em path
+    void writeJpeg(const std::string& path, const ExifData& ed)
+    {
+        Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+        image->setExifData(ed);
+        image->writeMetadata();
+
+        FileIo file(path);
+        file.open("wb");
+        file.write(image->io());
+    }
+}
+
+TEST(canonInfo, readsTheIdentityFromTheExifData)
+{
+    ExifData ed;
+    ed["Exif.Image.Model"] = "Canon EOS 5D Mark II";
+    ed["Exif.Canon.ModelID"] = uint32_t(0x80000218);
+    ed["Exif.Canon.SerialNumber"] = uint32_t(1234567);
+    ed["Exif.Canon.FirmwareVersion"] = "Firmware Version 2.0.4";
+    ed["Exif.Canon.FileNumber"] = uint32_t(1000042);
+    ed["Exif.Canon.LensModel"] = "EF100mm f/2.8L MACRO IS USM";
+    ed["Exif.CanonCs.LensType"] = int16_t(254);
+    UShortValue lens;
+    lens.read("100 100 1");
+    ed.add(ExifKey("Exif.CanonCs.Lens"), &lens);
+
+    const CanonInfo info = canonInfo(ed);
+    ASSERT_EQ("Canon EOS 5D Mark II", info.model_);
+    ASSERT_EQ(0x80000218u, info.modelId_);
+    ASSERT_EQ(1234567u, info.serialNumber_);
+    ASSERT_EQ("", info.internalSerialNumber_);
+    ASSERT_EQ("Firmware Version 2.0.4", info.firmwareVersion_);
+    ASSERT_EQ(1000042u, info.fileNumber_);
+    ASSERT_EQ("EF100mm f/2.8L MACRO IS USM", info.lensModel_);
+    ASSERT_EQ(254, info.lensType_);
+    ASSERT_EQ(100, info.longFocal_);
+    ASSERT_EQ(100, info.shortFocal_);
+    ASSERT_EQ(1, info.focalUnits_);
+}
+
+TEST(canonInfo, leavesMissingFieldsEmpty)
+{
+    const CanonInfo info = canonInfo(ExifData());
+    ASSERT_EQ("", info.model_);
+    ASSERT_EQ(0u, info.serialNumber_);
+    ASSERT_EQ(0, info.focalUnits_);
+}
+
+TEST(canonInfoFilter, acceptsOnlyTheKeysOfCanonInfo)
+{
+    const DecodeFilter filter = canonInfoFilter();
+    ASSERT_TRUE(filter.accepts(ExifKey("Exif.CanonCs.LensType")));
+    ASSERT_TRUE(filter.accepts(ExifKey("Exif.Canon.SerialNumber")));
+    ASSERT_FALSE(filter.accepts(ExifKey("Exif.CanonCs.Macro")));
+    ASSERT_FALSE(filter.acceptsGroup("Exif", "CanonSi"));
+}
+
+TEST(easyAccess, findsWhatTheSingleFunctionsFind)
+{
+    ExifData ed;
+    ed["Exif.Image.Make"] = "Canon";
+    ed["Exif.CanonCs.Quality"] = uint16_t(3);
+    ed["Exif.Image.ExposureTime"] = URational(1, 60);
+    ed["Exif.Photo.ExposureTime"] = URational(1, 125);
+    ed["Exif.CanonSi.WhiteBalance"] = uint16_t(1);
+    ed["Exif.Photo.WhiteBalance"] = uint16_t(0);
+    ed["Exif.Photo.ISOSpeedRatings"] = uint16_t(400);
+    const URationalValue empty;
+    ed.add(ExifKey("Exif.Photo.FNumber"), &empty);
+
+    const EasyAccessResult result = easyAccess(ed);
+    ASSERT_TRUE(result.make_ == make(ed));
+    ASSERT_TRUE(result.imageQuality_ == imageQuality(ed));
+    ASSERT_TRUE(result.exposureTime_ == exposureTime(ed));
+    ASSERT_EQ("Exif.Photo.ExposureTime", result.exposureTime_->key());
+    ASSERT_TRUE(result.whiteBalance_ == whiteBalance(ed));
+    ASSERT_EQ("Exif.CanonSi.WhiteBalance", result.whiteBalance_->key());
+    ASSERT_TRUE(result.isoSpeed_ == isoSpeed(ed));
+    ASSERT_EQ(400, result.isoSpeed_->toLong());
+    ASSERT_TRUE(result.fNumber_ == fNumber(ed));
+    ASSERT_TRUE(result.model_ == ed.end());
+    ASSERT_TRUE(result.lensName_ == ed.end());
+}
+
+TEST(easyAccess, returnsTheFirstOfDuplicateKeys)
+{
+    ExifData ed;
+    const UShortValue first(1);
+    const UShortValue second(6);
+    ed.add(ExifKey("Exif.Image.Orientation"), &first);
+    ed.add(ExifKey("Exif.Image.Orientation"), &second);
+
+    const EasyAccessResult result = easyAccess(ed);
+    ASSERT_EQ(1, result.orientation_->toLong());
+    ASSERT_TRUE(result.orientation_ == orientation(ed));
+}
+
+TEST(gpsInfo, decodesThePositionAndTimeToDecimalValues)
+{
+    const GpsInfo info = gpsInfo(gpsExifData());
+    ASSERT_TRUE(info.hasPosition_);
+    ASSERT_DOUBLE_EQ(-(33 + 51 / 60.0 + 34.56 / 3600), info.latitude_);
+    ASSERT_DOUBLE_EQ(-(70 + 39.6 / 60), info.longitude_);
+    ASSERT_TRUE(info.hasAltitude_);
+    ASSERT_DOUBLE_EQ(-25.5, info.altitude_);
+    ASSERT_TRUE(info.hasTimestamp_);
+    ASSERT_DOUBLE_EQ(1592224245.5, info.timestamp_);
+}
+
+TEST(gpsInfo, leavesInvalidValuesUnset)
+{
+    ExifData ed = gpsExifData();
+    ed["Exif.GPSInfo.GPSLatitude"] = URational(91, 1);
+    ed["Exif.GPSInfo.GPSAltitude"] = URational(1, 0);
+    ed.erase(ed.findKey(ExifKey("Exif.GPSInfo.GPSDateStamp")));
+    const GpsInfo info = gpsInfo(ed);
+    ASSERT_FALSE(info.hasPosition_);
+    ASSERT_EQ(0.0, info.latitude_);
+    ASSERT_FALSE(info.hasAltitude_);
+    ASSERT_FALSE(info.hasTimestamp_);
+
+    ASSERT_FALSE(gpsInfo(ExifData()).hasPosition_);
+}
+
+TEST(gpsInfoFilter, decodesOnlyTheGpsTags)
+{
+    const std::string path("tmp_gpsinfo.jpg");
+    writeJpeg(path, gpsExifData());
+    Image::UniquePtr image = ImageFactory::open(path);
+    image->setDecodeFilter(gpsInfoFilter());
+    image->readMetadata();
+    std::remove(path.c_str());
+
+    const ExifData& ed = image->exifData();
+    ASSERT_EQ(ed.end(), ed.findKey(ExifKey("Exif.Image.Make")));
+    ASSERT_EQ(ed.end(), ed.findKey(ExifKey("Exif.Photo.ExposureTime")));
+    ASSERT_EQ(ed.end(), ed.findKey(ExifKey("Exif.Iop.InteroperabilityIndex")));
+    ASSERT_EQ(ed.end(), ed.findKey(ExifKey("Exif.GPSInfo.GPSVersionID")));
+    const GpsInfo info = gpsInfo(ed);
+    ASSERT_TRUE(info.hasPosition_);
+    ASSERT_TRUE(info.hasAltitude_);
+    ASSERT_TRUE(info.hasTimestamp_);
+}
+
+TEST(gpsInfo, readsTheFilesOfABatch)
+{
+    std::vector<std::string> paths;
+    paths.push_back("tmp_gpsinfo0.jpg");
+    writeJpeg(paths.back(), gpsExifData());
+    paths.push_back("tmp_gpsinfo1.jpg");
+    writeJpeg(paths.back(), ExifData());
+    paths.push_back("tmp_gpsinfo_missing.jpg");
+
+    BatchProcessor batch(2);
+    BatchProcessor::Results results;
+    const std::vector<GpsInfo> infos = gpsInfo(batch, paths, results);
+    for (auto&& path : paths) std::remove(path.c_str());
+
+    ASSERT_EQ(3u, infos.size());
+    ASSERT_EQ(3u, results.size());
+    ASSERT_EQ(kerSuccess, results[0].code_);
+    ASSERT_TRUE(infos[0].hasPosition_);
+    ASSERT_DOUBLE_EQ(-25.5, infos[0].altitude_);
+    ASSERT_EQ(kerSuccess, results[1].code_);
+    ASSERT_FALSE(infos[1].hasPosition_);
+    ASSERT_NE(kerSuccess, results[2].code_);
+    ASSERT_FALSE(infos[2].hasTimestamp_);
+}
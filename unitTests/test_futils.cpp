@@ -142,6 +142,58 @@ TEST(base64decode, decodesValidString)
     delete [] result;
 }
 
+TEST(base64encode, padsOneAndTwoRemainingBytes)
+{
+    char result[9];
+    ASSERT_EQ(1, base64encode("abcd", 4, result, sizeof(result)));
+    ASSERT_STREQ("YWJjZA==", result);
+    ASSERT_EQ(1, base64encode("abcde", 5, result, sizeof(result)));
+    ASSERT_STREQ("YWJjZGU=", result);
+    ASSERT_EQ(0, base64encode("abcde", 5, result, 8));
+}
+
+TEST(base64decode, decodesIntoADataBufSkippingOtherCharacters)
+{
+    const std::string text("VGhpcyBp\ncyBhIH\r\nVuaXQgdGVzdA==");
+    const DataBuf buf = base64decode(text.data(), text.size());
+    ASSERT_EQ("This is a unit test", std::string(reinterpret_cast<const char*>(buf.pData_), buf.size_));
+    ASSERT_EQ(0, base64decode("\n==", 3).size_);
+}
+
+TEST(Base64Decoder, decodesGroupsSplitAcrossCalls)
+{
+    const std::string text("VGhpcyBpcyBhIHVuaXQgdGVzdA");
+    for (size_t split = 0; split <= text.size(); ++split) {
+        byte out[32];
+        Base64Decoder decoder;
+        size_t n = decoder.decode(text.data(), split, out);
+        n += decoder.decode(text.data() + split, text.size() - split, out + n);
+        n += decoder.finish(out + n);
+        ASSERT_EQ("This is a unit test", std::string(reinterpret_cast<const char*>(out), n));
+    }
+}
+
+TEST(createTempFile, createsADifferentFileEachTime)
+{
+    const std::string path("tmp_createTempFile.dat");
+    const std::string first = createTempFile(path);
+    const std::string second = createTempFile(path);
+
+    ASSERT_EQ(path, first.substr(0, path.size()));
+    ASSERT_EQ(path, second.substr(0, path.size()));
+    ASSERT_NE(first, second);
+    ASSERT_TRUE(fileExists(first));
+    ASSERT_TRUE(fileExists(second));
+    ASSERT_FALSE(fileExists(path));
+    std::remove(first.c_str());
+    std::remove(second.c_str());
+}
+
+TEST(createTempFile, returnsAnEmptyNameIfTheDirectoryDoesNotExist)
+{
+    ASSERT_EQ("", createTempFile("nonExistingDirectory/tmp_createTempFile.dat"));
+}
+
 TEST(AUri, parsesAndDecoreUrl)
 {
     const std::string url("http://www.geekhideout.com/urlcode.shtml");
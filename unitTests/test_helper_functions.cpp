@@ -2,6 +2,8 @@
 
 #include "gtestwrapper.h"
 
+#include <algorithm>
+
 TEST(string_from_unterminated, terminatedArray)
 {
     const char data[5] = {'a', 'b', 'c', 0, 'd'};
@@ -19,3 +21,36 @@ TEST(string_from_unterminated, unterminatedArray)
     ASSERT_EQ(res.size(), 4u);
     ASSERT_STREQ(res.c_str(), "abcd");
 }
+
+TEST(parse_date_time, readsExifAndXmpLayouts)
+{
+    int fields[6];
+    ASSERT_TRUE(parse_date_time("2019:03:12 14:05:59", ':', ' ', fields));
+    const int expected[6] = {2019, 3, 12, 14, 5, 59};
+    ASSERT_TRUE(std::equal(fields, fields + 6, expected));
+    ASSERT_TRUE(parse_date_time("2019-03-12T14:05:59.25+01:00", '-', 'T', fields));
+    ASSERT_TRUE(std::equal(fields, fields + 6, expected));
+}
+
+TEST(parse_date_time, rejectsOtherLayouts)
+{
+    int fields[6] = {1, 2, 3, 4, 5, 6};
+    ASSERT_FALSE(parse_date_time("2019:3:12 14:05:59", ':', ' ', fields));
+    ASSERT_FALSE(parse_date_time("2019-03-12T14:05:59", ':', ' ', fields));
+    ASSERT_FALSE(parse_date_time("2019:03:12 14:05", ':', ' ', fields));
+    ASSERT_EQ(1, fields[0]);
+    ASSERT_EQ(6, fields[5]);
+}
+
+TEST(format_date_time, writesTheFixedLayout)
+{
+    char buf[20];
+    const int fields[6] = {2019, 3, 12, 14, 5, 59};
+    ASSERT_TRUE(format_date_time(buf, '-', 'T', fields));
+    ASSERT_STREQ("2019-03-12T14:05:59", buf);
+
+    const int wide[6] = {2019, 3, 123, 14, 5, 59};
+    ASSERT_FALSE(format_date_time(buf, ':', ' ', wide));
+    const int negative[6] = {2019, 3, 12, -1, 5, 59};
+    ASSERT_FALSE(format_date_time(buf, ':', ' ', negative));
+}
@@ -1,6 +1,12 @@
 #include "gtestwrapper.h"
 
 #include <image_int.hpp>
+#include <exiv2/basicio.hpp>
+#include <exiv2/error.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
 
 using namespace Exiv2::Internal;
 using Exiv2::makeSlice;
@@ -38,6 +44,18 @@ TEST(binaryToString, zeroStart)
     checkBinaryToString(makeSlice(buf, 0, sizeof(buf)), "abc...e..a");
 }
 
+TEST(binaryToString, longerThanOneBlock)
+{
+    std::string data(150, 'x');
+    data[70] = '\n';
+    data[149] = '\0';
+    std::string expected(149, 'x');
+    expected[70] = '.';
+    std::stringstream ss;
+    ss << binaryToString(makeSlice(data, 0, data.size()));
+    ASSERT_EQ(expected, ss.str());
+}
+
 TEST(binaryToString, nonZeroStart)
 {
     // start @ index 1, read 6 characters (until e)
@@ -53,3 +71,88 @@ TEST(stringFormat, badInitialGuessOfBufferSize)
     const char str[] = "Long string with more than 16 characters.";
     ASSERT_EQ(stringFormat(fmt, str), std::string(str));
 }
+
+TEST(binaryToHex, formatsTheDataInLinesOf16Bytes)
+{
+    const unsigned char data[18] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f', 1, 'x'};
+    ASSERT_EQ(binaryToHex(data, sizeof(data)),
+              "3031323334353637  3839616263646566   01234567  89abcdef\n"
+              "0178" + std::string(45, ' ') + ".x\n\n\n\n");
+}
+
+TEST(hexEncode, writesTwoLowercaseDigitsPerByte)
+{
+    const unsigned char data[] = {0x00, 0x9f, 0xa0, 0xff};
+    char out[8];
+    hexEncode(data, sizeof(data), out);
+    ASSERT_EQ(std::string(out, sizeof(out)), "009fa0ff");
+}
+
+TEST(hexDecode, skipsCharactersBetweenTheDigits)
+{
+    const std::string text = "009f\n a\n0ff  rest";
+    unsigned char out[4];
+    const char* end = hexDecode(text.data(), text.data() + text.size(), out, sizeof(out));
+    ASSERT_EQ(text.data() + 11, end);
+    ASSERT_EQ(0x00, out[0]);
+    ASSERT_EQ(0x9f, out[1]);
+    ASSERT_EQ(0xa0, out[2]);
+    ASSERT_EQ(0xff, out[3]);
+}
+
+TEST(hexDecode, failsIfTheTextEndsTooEarly)
+{
+    const std::string text = "009fa";
+    unsigned char out[3];
+    ASSERT_EQ(nullptr, hexDecode(text.data(), text.data() + text.size(), out, sizeof(out)));
+    const char withNull[] = "00\0" "9fa0";
+    ASSERT_EQ(nullptr, hexDecode(withNull, withNull + sizeof(withNull), out, sizeof(out)));
+}
+
+TEST(findByte, returnsTheEndIfThereIsNoMatch)
+{
+    ASSERT_EQ(buf + 3, findByte(buf, buf + 10, 1));
+    ASSERT_EQ(buf + 9, findByte(buf + 1, buf + 10, 'a'));
+    ASSERT_EQ(buf + 5, findByte(buf, buf + 5, 'e'));
+    ASSERT_EQ(buf, findByte(buf, buf, 'a'));
+}
+
+TEST(skipToByte, positionsTheIoAtTheByte)
+{
+    std::vector<Exiv2::byte> data(2000, 0);
+    data[1500] = 0xff;
+    Exiv2::MemIo io(&data[0], static_cast<long>(data.size()));
+    ASSERT_TRUE(skipToByte(io, 0xff));
+    ASSERT_EQ(1500, io.tell());
+    ASSERT_EQ(0xff, io.getb());
+    ASSERT_FALSE(skipToByte(io, 0xff));
+}
+
+TEST(PayloadHash, isTheFnv1aHashOfTheDataInAnyNumberOfPieces)
+{
+    PayloadHash empty;
+    ASSERT_EQ(0xcbf29ce484222325ULL, empty.value());
+
+    const Exiv2::byte foobar[] = { 'f', 'o', 'o', 'b', 'a', 'r' };
+    PayloadHash whole;
+    whole.update(foobar, sizeof(foobar));
+    ASSERT_EQ(0x85944171f73967e8ULL, whole.value());
+    PayloadHash pieces;
+    pieces.update(foobar, 2);
+    pieces.update(foobar + 2, 4);
+    ASSERT_EQ(whole.value(), pieces.value());
+}
+
+TEST(hashData, hashesTheDataFromTheCurrentPosition)
+{
+    std::vector<Exiv2::byte> data(200000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<Exiv2::byte>(i % 251);
+    Exiv2::MemIo io(&data[0], static_cast<long>(data.size()));
+    io.seek(10, Exiv2::BasicIo::beg);
+    PayloadHash hash;
+    hashData(io, static_cast<long>(data.size()) - 10, hash);
+    PayloadHash expected;
+    expected.update(&data[10], data.size() - 10);
+    ASSERT_EQ(expected.value(), hash.value());
+    ASSERT_THROW(hashData(io, 1, hash), Exiv2::Error);
+}
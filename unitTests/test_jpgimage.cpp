@@ -0,0 +1,697 @@
+// File under test
+#include <exiv2/jpgimage.hpp>
+
+// Auxiliary headers
+#include <exiv2/error.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/iptc.hpp>
+#include <exiv2/snapshot.hpp>
+#include <exiv2/trace.hpp>
+#include <exiv2/xmp_exiv2.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    Image::UniquePtr createJpegWithMetadata()
+    {
+        Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+        image->exifData()["Exif.Image.Artist"] = "An Artist";
+        image->iptcData()["Iptc.Application2.Caption"] = "A caption";
+        image->xmpData()["Xmp.dc.source"] = "A source";
+        image->setComment("A comment which is long enough");
+        image->writeMetadata();
+        image->readMetadata();
+        return image;
+    }
+
+    //! JpegImage which gives access to the raw XMP packet it holds
+    class RawPacketJpegImage : public JpegImage {
+    public:
+        explicit RawPacketJpegImage(const Image& source)
+            : JpegImage(BasicIo::UniquePtr(new MemIo(source.io().mmap(), static_cast<long>(source.io().size()))),
+                        false)
+        {
+        }
+        const std::string& rawXmpPacket() const { return xmpPacket_; }
+    };
+
+    std::vector<std::string> traceEvents;
+
+    void recordTraceEvent(Trace::Event event, const char* category, const char* name)
+    {
+        traceEvents.push_back((event == Trace::begin ? "B " : "E ") + std::string(category) + " " + name);
+    }
+}
+
+TEST(JpegImage_writeInPlace, isDisabledByDefault)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    ASSERT_FALSE(image->writeInPlace());
+    const long size = image->io().size();
+
+    image->setComment("Short");
+    image->writeMetadata();
+    ASSERT_GT(size, image->io().size());
+}
+
+TEST(JpegImage_writeInPlace, keepsTheLayoutIfTheMetadataFits)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    const long size = image->io().size();
+
+    image->writeInPlace(true);
+    image->setComment("Short");
+    image->exifData()["Exif.Image.Artist"] = "Another";
+    image->xmpData()["Xmp.dc.source"] = "Src";
+    image->writeMetadata();
+    ASSERT_EQ(size, image->io().size());
+
+    image->readMetadata();
+    ASSERT_EQ("Short", image->comment());
+    ASSERT_EQ("Another", image->exifData()["Exif.Image.Artist"].toString());
+    ASSERT_EQ("Src", image->xmpData()["Xmp.dc.source"].toString());
+    ASSERT_EQ("A caption", image->iptcData()["Iptc.Application2.Caption"].toString());
+}
+
+TEST(JpegImage_writeInPlace, rewritesTheImageIfTheMetadataDoesNotFit)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    const long size = image->io().size();
+
+    image->writeInPlace(true);
+    image->setComment("A comment which is much longer than the original one");
+    image->writeMetadata();
+    ASSERT_LT(size, image->io().size());
+
+    image->readMetadata();
+    ASSERT_EQ("A comment which is much longer than the original one", image->comment());
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+}
+
+TEST(JpegImage_writeInPlace, rewritesTheImageIfMetadataIsRemoved)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+
+    image->writeInPlace(true);
+    image->clearComment();
+    image->writeMetadata();
+
+    image->readMetadata();
+    ASSERT_TRUE(image->comment().empty());
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+}
+
+TEST(JpegImage_writePadding, leavesRoomForUpdatesInPlace)
+{
+    Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+    image->writePadding(4096);
+    image->exifData()["Exif.Image.Artist"] = "An Artist";
+    image->xmpData()["Xmp.dc.source"] = "A source";
+    image->writeMetadata();
+    image->readMetadata();
+    const long size = image->io().size();
+    ASSERT_LT(4096, size);
+
+    image->writeInPlace(true);
+    image->exifData()["Exif.Image.Copyright"] = "A copyright notice which did not exist before";
+    image->exifData()["Exif.Photo.UserComment"] = "charset=Ascii A user comment";
+    image->xmpData()["Xmp.dc.description"] = "A description which did not exist before";
+    image->writeMetadata();
+    ASSERT_EQ(size, image->io().size());
+
+    image->readMetadata();
+    ASSERT_EQ("A copyright notice which did not exist before",
+              image->exifData()["Exif.Image.Copyright"].toString());
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+    ASSERT_EQ("A source", image->xmpData()["Xmp.dc.source"].toString());
+}
+
+TEST(JpegImage_readBasicInfo, readsTheDimensionsAndTheOrientationOnly)
+{
+    Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+    image->exifData()["Exif.Image.Artist"] = "An Artist";
+    image->exifData()["Exif.Image.Orientation"] = uint16_t(6);
+    image->writeMetadata();
+    image->readMetadata();
+    const int width = image->pixelWidth();
+    const int height = image->pixelHeight();
+    ASSERT_LT(0, width);
+
+    image->readBasicInfo();
+    ASSERT_EQ(width, image->pixelWidth());
+    ASSERT_EQ(height, image->pixelHeight());
+    ASSERT_EQ(1, image->exifData().count());
+    ASSERT_EQ(6, image->exifData()["Exif.Image.Orientation"].toLong());
+    ASSERT_TRUE(image->iptcData().empty());
+    ASSERT_TRUE(image->xmpData().empty());
+}
+
+TEST(JpegImage_readMetadata, skipsPaddingBetweenSegments)
+{
+    // SOI, padding and a fill byte, COM "Hi", padding, EOI
+    const byte jpeg[] = {0xff, 0xd8, 0x00, 0x00, 0xff, 0xff, 0xfe, 0x00, 0x04, 'H', 'i',
+                         0x00, 0xff, 0xd9};
+    Image::UniquePtr image = ImageFactory::open(jpeg, sizeof(jpeg));
+    image->readMetadata();
+    ASSERT_EQ("Hi", image->comment());
+}
+
+namespace
+{
+    //! An ICC profile which needs three APP2 segments
+    DataBuf createIccProfile()
+    {
+        DataBuf profile(150000);
+        for (long i = 0; i < profile.size_; ++i) profile.pData_[i] = static_cast<byte>(i % 253);
+        ul2Data(profile.pData_, static_cast<uint32_t>(profile.size_), bigEndian);
+        return profile;
+    }
+}
+
+TEST(JpegImage_iccProfile, isAssembledFromAllChunks)
+{
+    DataBuf expected = createIccProfile();
+    DataBuf profile = createIccProfile();
+    Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+    image->setIccProfile(profile);
+    image->writeMetadata();
+
+    image->readMetadata();
+    ASSERT_TRUE(image->iccProfileDefined());
+    DataBuf* iccProfile = image->iccProfile();
+    ASSERT_EQ(expected.size_, iccProfile->size_);
+    ASSERT_EQ(0, std::memcmp(expected.pData_, iccProfile->pData_, expected.size_));
+}
+
+TEST(JpegImage_iccProfile, isSharedWithTheSnapshotsWithoutCopies)
+{
+    DataBuf profile = createIccProfile();
+    Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+    image->setIccProfile(profile);
+    image->writeMetadata();
+    image->readMetadata();
+
+    const SharedBuf shared = image->sharedIccProfile();
+    ASSERT_EQ(static_cast<size_t>(image->iccProfile()->size_), shared.size());
+    ASSERT_EQ(0, std::memcmp(image->iccProfile()->pData_, shared.data(), shared.size()));
+    const std::shared_ptr<const ImageSnapshot> first = image->snapshot();
+    const std::shared_ptr<const ImageSnapshot> second = image->snapshot();
+    ASSERT_EQ(shared.data(), first->iccProfile().data());
+    ASSERT_EQ(shared.data(), second->iccProfile().data());
+
+    // A new profile is copied again
+    DataBuf other = createIccProfile();
+    image->setIccProfile(other);
+    ASSERT_NE(shared.data(), image->sharedIccProfile().data());
+    image->clearIccProfile();
+    ASSERT_TRUE(image->sharedIccProfile().empty());
+}
+
+TEST(JpegImage_iccProfile, isKeptWhenTheImageIsRewrittenWithoutReadingIt)
+{
+    DataBuf expected = createIccProfile();
+    DataBuf profile = createIccProfile();
+    Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+    image->setIccProfile(profile);
+    image->writeMetadata();
+
+    image->readMetadata();
+    image->setComment("A comment which makes the image larger");
+    image->writeMetadata();
+    image->readMetadata();
+    ASSERT_EQ("A comment which makes the image larger", image->comment());
+    DataBuf* iccProfile = image->iccProfile();
+    ASSERT_EQ(expected.size_, iccProfile->size_);
+    ASSERT_EQ(0, std::memcmp(expected.pData_, iccProfile->pData_, expected.size_));
+
+    image->clearIccProfile();
+    ASSERT_FALSE(image->iccProfileDefined());
+}
+
+TEST(Photoshop_indexIrbs, indexesAllBlocksInOnePass)
+{
+    const byte psData[] = {
+        '8', 'B', 'I', 'M', 0x03, 0xed, 0, 0, 0, 0, 0, 2, 0xaa, 0xbb,
+        '8', 'B', 'I', 'M', 0x04, 0x04, 0, 0, 0, 0, 0, 1, 0xcc, 0,
+        '8', 'B', 'I', 'M', 0x04, 0x0c, 0, 0, 0, 0, 0, 0,
+    };
+    Photoshop::IrbIndex index;
+    ASSERT_EQ(3, Photoshop::indexIrbs(psData, sizeof(psData), index));
+    ASSERT_EQ(3u, index.size());
+    const Photoshop::Irb* iptc = Photoshop::findIrb(index, Photoshop::iptc_);
+    ASSERT_NE(nullptr, iptc);
+    ASSERT_EQ(14, iptc->offset_);
+    ASSERT_EQ(12u, iptc->sizeHdr_);
+    ASSERT_EQ(1u, iptc->sizeData_);
+    ASSERT_EQ(nullptr, Photoshop::findIrb(index, 0x0409));
+
+    // Invalid data after the blocks
+    const byte junk[] = {'8', 'B', 'I', 'M', 0x04, 0x04, 0, 0, 0, 0, 0, 0, 'x'};
+    ASSERT_EQ(-2, Photoshop::indexIrbs(junk, sizeof(junk), index));
+    ASSERT_EQ(1u, index.size());
+}
+
+TEST(Photoshop_setIptcIrb, replacesOnlyTheIptcBlocks)
+{
+    const byte psData[] = {
+        '8', 'B', 'I', 'M', 0x03, 0xed, 0, 0, 0, 0, 0, 2, 0xaa, 0xbb,
+        '8', 'B', 'I', 'M', 0x04, 0x04, 0, 0, 0, 0, 0, 1, 0xcc, 0,
+        '8', 'B', 'I', 'M', 0x04, 0x0c, 0, 0, 0, 0, 0, 0,
+        '8', 'B', 'I', 'M', 0x04, 0x04, 0, 0, 0, 0, 0, 2, 0xdd, 0xee,
+    };
+    IptcData iptcData;
+    iptcData["Iptc.Application2.Caption"] = "A caption";
+    const DataBuf raw = IptcParser::encode(iptcData);
+
+    DataBuf buf = Photoshop::setIptcIrb(psData, sizeof(psData), iptcData);
+    Photoshop::IrbIndex index;
+    ASSERT_EQ(3, Photoshop::indexIrbs(buf.pData_, buf.size_, index));
+    ASSERT_EQ(3u, index.size());
+    ASSERT_EQ(0x03ed, index[0].psTag_);
+    ASSERT_EQ(0, std::memcmp(buf.pData_, psData, 14));
+    ASSERT_EQ(Photoshop::iptc_, index[1].psTag_);
+    ASSERT_EQ(static_cast<uint32_t>(raw.size_), index[1].sizeData_);
+    ASSERT_EQ(0, std::memcmp(buf.pData_ + index[1].offset_ + index[1].sizeHdr_, raw.pData_, raw.size_));
+    ASSERT_EQ(Photoshop::preview_, index[2].psTag_);
+
+    // Without IPTC data, the IPTC blocks are removed
+    buf = Photoshop::setIptcIrb(psData, sizeof(psData), IptcData());
+    ASSERT_EQ(26, buf.size_);
+    ASSERT_EQ(0, std::memcmp(buf.pData_, psData, 14));
+    ASSERT_EQ(0, std::memcmp(buf.pData_ + 14, psData + 28, 12));
+}
+
+TEST(JpegImage_stats, countTheWorkOfReadingAndWriting)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    image->io().stats() = IoStats();
+    image->readMetadata();
+    const IoStats stats = image->stats();
+    ASSERT_GT(stats.reads_, 0u);
+    ASSERT_EQ(0u, stats.writes_);
+    ASSERT_GT(stats.tiffDecodeTime_, 0);
+    ASSERT_GT(stats.xmpDecodeTime_, 0);
+    ASSERT_EQ(0, stats.writeMetadataTime_);
+
+    image->writeMetadata();
+    ASSERT_GT(image->stats().writes_, 0u);
+    ASSERT_GT(image->stats().writeMetadataTime_, 0);
+}
+
+TEST(JpegImage_trace, reportsNestedPhasesOfReadingAndWriting)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    traceEvents.clear();
+    Trace::setHandler(recordTraceEvent);
+    image->readMetadata();
+    image->writeMetadata();
+    Trace::setHandler(nullptr);
+
+    // Each end event closes the last open begin event
+    std::vector<std::string> open;
+    for (const std::string& event : traceEvents) {
+        if (event[0] == 'B') {
+            open.push_back(event.substr(2));
+        } else {
+            ASSERT_FALSE(open.empty());
+            ASSERT_EQ(open.back(), event.substr(2));
+            open.pop_back();
+        }
+    }
+    ASSERT_TRUE(open.empty());
+    ASSERT_NE(traceEvents.end(), std::find(traceEvents.begin(), traceEvents.end(), "B tiff-decode TIFF"));
+    ASSERT_NE(traceEvents.end(), std::find(traceEvents.begin(), traceEvents.end(), "B xmp-parse XMP packet"));
+    ASSERT_NE(traceEvents.end(), std::find(traceEvents.begin(), traceEvents.end(), "B encode TIFF"));
+    ASSERT_NE(traceEvents.end(), std::find(traceEvents.begin(), traceEvents.end(), "B encode XMP packet"));
+
+    traceEvents.clear();
+    image->readMetadata();
+    ASSERT_TRUE(traceEvents.empty());
+}
+
+TEST(JpegImage_snapshot, canBeQueriedFromManyThreads)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    const std::shared_ptr<const ImageSnapshot> snapshot = image->snapshot();
+    const long size = image->io().size();
+    std::vector<byte> data(size);
+    image->io().seek(0, BasicIo::beg);
+    ASSERT_EQ(size, image->io().read(data.data(), size));
+
+    // The snapshot does not change with the image
+    image->exifData()["Exif.Image.Artist"] = "Another";
+    image->writeMetadata();
+    image.reset();
+
+    ASSERT_EQ(size, snapshot->size());
+    ASSERT_EQ("image/jpeg", snapshot->mimeType());
+    std::vector<int> failures(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < failures.size(); ++t) {
+        threads.emplace_back([&snapshot, &data, &failures, t]() {
+            for (int i = 0; i < 200; ++i) {
+                const ExifData& exifData = snapshot->exifData();
+                ExifData::const_iterator artist = exifData.findKey(ExifKey("Exif.Image.Artist"));
+                if (artist == exifData.end() || artist->toString() != "An Artist") ++failures[t];
+                IptcData::const_iterator caption =
+                    snapshot->iptcData().findKey(IptcKey("Iptc.Application2.Caption"));
+                if (caption == snapshot->iptcData().end() || caption->toString() != "A caption") ++failures[t];
+                XmpData::const_iterator source = snapshot->xmpData().findKey(XmpKey("Xmp.dc.source"));
+                if (source == snapshot->xmpData().end() || source->toString() != "A source") ++failures[t];
+                if (snapshot->comment() != "A comment which is long enough") ++failures[t];
+
+                const long offset = static_cast<long>((i * 37 + t * 11) % data.size());
+                byte buf[16];
+                const long n = snapshot->readAt(offset, buf, sizeof(buf));
+                if (n <= 0 || std::memcmp(buf, &data[offset], n) != 0) ++failures[t];
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    for (int f : failures) ASSERT_EQ(0, f);
+
+    byte buf[4];
+    ASSERT_EQ(0, snapshot->readAt(size, buf, sizeof(buf)));
+}
+
+TEST(JpegImage_exportMetadata, canBeImportedIntoAnotherImage)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    const DataBuf snapshot = image->exportMetadata();
+
+    Image::UniquePtr target = ImageFactory::create(ImageType::jpeg);
+    target->exifData()["Exif.Image.Make"] = "Replaced";
+    target->importMetadata(snapshot.pData_, snapshot.size_);
+    ASSERT_EQ(1, target->exifData().count());
+    ASSERT_EQ("An Artist", target->exifData()["Exif.Image.Artist"].toString());
+    ASSERT_EQ("A caption", target->iptcData()["Iptc.Application2.Caption"].toString());
+    ASSERT_EQ("A source", target->xmpData()["Xmp.dc.source"].toString());
+    ASSERT_EQ("A comment which is long enough", target->comment());
+
+    target->writeMetadata();
+    target->readMetadata();
+    ASSERT_EQ("An Artist", target->exifData()["Exif.Image.Artist"].toString());
+    ASSERT_EQ("A source", target->xmpData()["Xmp.dc.source"].toString());
+}
+
+TEST(JpegImage_importMetadata, rejectsDataWhichIsNotASnapshot)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    DataBuf snapshot = image->exportMetadata();
+
+    Image::UniquePtr target = ImageFactory::create(ImageType::jpeg);
+    ASSERT_THROW(target->importMetadata(snapshot.pData_ + 1, snapshot.size_ - 1), Error);
+    ASSERT_THROW(target->importMetadata(snapshot.pData_, snapshot.size_ - 1), Error);
+}
+
+TEST(JpegImage_writeMetadataTo, streamsTheNewImageAndLeavesTheSourceAlone)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    const long size = image->io().size();
+    image->exifData()["Exif.Image.Artist"] = "Another Artist";
+
+    MemIo out;
+    image->writeMetadataTo(out);
+    ASSERT_EQ(size, image->io().size());
+
+    Image::UniquePtr copy = ImageFactory::open(out.mmap(), out.size());
+    copy->readMetadata();
+    ASSERT_EQ("Another Artist", copy->exifData()["Exif.Image.Artist"].toString());
+    ASSERT_EQ("A caption", copy->iptcData()["Iptc.Application2.Caption"].toString());
+    ASSERT_EQ("A comment which is long enough", copy->comment());
+
+    image->readMetadata();
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+}
+
+TEST(JpegImage_readJpegHead, readsTheSegmentsAndLeavesTheImageData)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    const std::string jpeg(reinterpret_cast<const char*>(image->io().mmap()), image->io().size());
+    const size_t sos = jpeg.find("\xff\xda");
+    ASSERT_NE(std::string::npos, sos);
+
+    std::istringstream stream(jpeg);
+    Blob head;
+    ASSERT_TRUE(readJpegHead(stream, head));
+    ASSERT_EQ(sos + 2, head.size());
+    ASSERT_EQ(jpeg.substr(0, sos + 2), std::string(head.begin(), head.end()));
+
+    // A new head followed by the rest of the stream is the modified image
+    Image::UniquePtr headImage = ImageFactory::open(&head[0], static_cast<long>(head.size()));
+    headImage->readMetadata();
+    ASSERT_EQ("An Artist", headImage->exifData()["Exif.Image.Artist"].toString());
+    headImage->exifData()["Exif.Image.Artist"] = "Another Artist";
+    MemIo out;
+    headImage->writeMetadataTo(out);
+    std::string streamed(reinterpret_cast<const char*>(out.mmap()), out.size());
+    streamed.append(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+    image->exifData()["Exif.Image.Artist"] = "Another Artist";
+    image->writeMetadata();
+    ASSERT_EQ(std::string(reinterpret_cast<const char*>(image->io().mmap()), image->io().size()), streamed);
+}
+
+TEST(JpegImage_readJpegHead, rejectsOtherAndTruncatedStreams)
+{
+    std::istringstream png("\x89PNG\r\n\x1a\n");
+    Blob head;
+    ASSERT_FALSE(readJpegHead(png, head));
+
+    std::istringstream truncated(std::string("\xff\xd8\xff\xe1\x00\x10" "Exif", 10));
+    ASSERT_FALSE(readJpegHead(truncated, head));
+    ASSERT_EQ(10u, head.size());
+}
+
+TEST(JpegImage_stripMetadataTo, copiesTheImageWithoutTheMetadataSegments)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    DataBuf profile = createIccProfile();
+    image->setIccProfile(profile);
+    image->writeMetadata();
+    const std::string jpeg(reinterpret_cast<const char*>(image->io().mmap()), image->io().size());
+
+    MemIo out;
+    image->stripMetadataTo(out);
+    ASSERT_EQ(jpeg, std::string(reinterpret_cast<const char*>(image->io().mmap()), image->io().size()));
+    const std::string stripped(reinterpret_cast<const char*>(out.mmap()), out.size());
+    ASSERT_EQ(jpeg.substr(jpeg.find("\xff\xda")), stripped.substr(stripped.find("\xff\xda")));
+
+    Image::UniquePtr copy = ImageFactory::open(out.mmap(), out.size());
+    copy->readMetadata();
+    ASSERT_TRUE(copy->exifData().empty());
+    ASSERT_TRUE(copy->iptcData().empty());
+    ASSERT_TRUE(copy->xmpData().empty());
+    ASSERT_TRUE(copy->comment().empty());
+    ASSERT_FALSE(copy->iccProfileDefined());
+}
+
+TEST(JpegImage_stripMetadataTo, keepsTheRequestedMetadata)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    DataBuf profile = createIccProfile();
+    image->setIccProfile(profile);
+    image->writeMetadata();
+
+    MemIo out;
+    image->stripMetadataTo(out, mdComment | mdIccProfile);
+    Image::UniquePtr copy = ImageFactory::open(out.mmap(), out.size());
+    copy->readMetadata();
+    ASSERT_TRUE(copy->exifData().empty());
+    ASSERT_TRUE(copy->iptcData().empty());
+    ASSERT_TRUE(copy->xmpData().empty());
+    ASSERT_EQ("A comment which is long enough", copy->comment());
+    ASSERT_TRUE(copy->iccProfileDefined());
+    ASSERT_EQ(createIccProfile().size_, copy->iccProfile()->size_);
+}
+
+TEST(JpegImage_transplantMetadata, copiesTheSegmentsByteForByte)
+{
+    Image::UniquePtr source = createJpegWithMetadata();
+    Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+    image->setComment("The own comment");
+    image->exifData()["Exif.Image.Model"] = "A model";
+    image->writeMetadata();
+
+    dynamic_cast<JpegBase&>(*image).transplantMetadata(dynamic_cast<JpegBase&>(*source));
+    const std::string src(reinterpret_cast<const char*>(source->io().mmap()), source->io().size());
+    const std::string dst(reinterpret_cast<const char*>(image->io().mmap()), image->io().size());
+    const size_t exif = src.find(std::string("Exif\0\0", 6)) - 4;
+    const size_t length = (static_cast<byte>(src[exif + 2]) << 8) + static_cast<byte>(src[exif + 3]) + 2;
+    ASSERT_NE(std::string::npos, dst.find(src.substr(exif, length)));
+
+    image->readMetadata();
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+    ASSERT_TRUE(image->exifData().findKey(ExifKey("Exif.Image.Model")) == image->exifData().end());
+    ASSERT_EQ("A caption", image->iptcData()["Iptc.Application2.Caption"].toString());
+    ASSERT_EQ("A source", image->xmpData()["Xmp.dc.source"].toString());
+    ASSERT_EQ("The own comment", image->comment());
+}
+
+TEST(JpegImage_transplantMetadata, patchesTheOrientationAndTheDimensions)
+{
+    Image::UniquePtr source = createJpegWithMetadata();
+    source->exifData()["Exif.Image.Orientation"] = uint16_t(6);
+    source->exifData()["Exif.Photo.PixelXDimension"] = uint32_t(4000);
+    source->exifData()["Exif.Photo.PixelYDimension"] = uint16_t(3000);
+    source->writeMetadata();
+    Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+
+    JpegBase::ExifPatch patch;
+    patch.orientation_ = 1;
+    patch.pixelWidth_ = 400;
+    patch.pixelHeight_ = 300;
+    dynamic_cast<JpegBase&>(*image).transplantMetadata(dynamic_cast<JpegBase&>(*source), mdExif, patch);
+
+    image->readMetadata();
+    ASSERT_EQ(1, image->exifData()["Exif.Image.Orientation"].toLong());
+    ASSERT_EQ(400, image->exifData()["Exif.Photo.PixelXDimension"].toLong());
+    ASSERT_EQ(300, image->exifData()["Exif.Photo.PixelYDimension"].toLong());
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+    ASSERT_TRUE(image->iptcData().empty());
+    ASSERT_TRUE(image->xmpData().empty());
+
+    source->readMetadata();
+    ASSERT_EQ(6, source->exifData()["Exif.Image.Orientation"].toLong());
+}
+
+TEST(JpegImage_payloadHash, isStableWhenTheMetadataChanges)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    ASSERT_FALSE(image->payloadHashDefined());
+    image->hashPayload(true);
+    image->readMetadata();
+    ASSERT_TRUE(image->payloadHashDefined());
+    const uint64_t hash = image->payloadHash();
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+
+    image->exifData()["Exif.Image.Artist"] = "Another Artist with a longer name";
+    image->setComment("Another comment");
+    image->writeMetadata();
+    image->readMetadata();
+    ASSERT_EQ(hash, image->payloadHash());
+
+    MemIo out;
+    image->stripMetadataTo(out);
+    ASSERT_EQ(hash, image->payloadHash());
+
+    // A change of the image data changes the hash
+    std::string jpeg(reinterpret_cast<const char*>(image->io().mmap()), image->io().size());
+    jpeg[jpeg.find("\xff\xda") + 4] ^= 1;
+    Image::UniquePtr changed = ImageFactory::open(reinterpret_cast<const byte*>(jpeg.data()),
+                                                  static_cast<long>(jpeg.size()));
+    changed->hashPayload(true);
+    changed->readMetadata();
+    ASSERT_NE(hash, changed->payloadHash());
+}
+
+TEST(JpegImage_leanMode, releasesTheXmpPacketAndRestoresItOnDemand)
+{
+    Image::UniquePtr source = createJpegWithMetadata();
+    const std::string packet = static_cast<const Image&>(*source).xmpPacket();
+    ASSERT_FALSE(packet.empty());
+
+    RawPacketJpegImage image(*source);
+    ASSERT_FALSE(image.leanMode());
+    image.leanMode(true);
+    image.readMetadata();
+    ASSERT_EQ("A source", image.xmpData()["Xmp.dc.source"].toString());
+    ASSERT_TRUE(image.rawXmpPacket().empty());
+    ASSERT_TRUE(image.xmpData().xmpPacket().empty());
+
+    ASSERT_EQ(packet, static_cast<const Image&>(image).xmpPacket());
+    ASSERT_EQ(packet, image.rawXmpPacket());
+}
+
+TEST(JpegImage_leanMode, restoresThePacketToWriteTheXmpFromIt)
+{
+    Image::UniquePtr source = createJpegWithMetadata();
+    RawPacketJpegImage image(*source);
+    image.leanMode(true);
+    image.readMetadata();
+    ASSERT_TRUE(image.rawXmpPacket().empty());
+
+    image.writeXmpFromPacket(true);
+    ASSERT_FALSE(image.rawXmpPacket().empty());
+    image.exifData()["Exif.Image.Artist"] = "Another Artist";
+    image.writeMetadata();
+
+    image.readMetadata();
+    ASSERT_EQ("Another Artist", image.exifData()["Exif.Image.Artist"].toString());
+    ASSERT_EQ("A source", image.xmpData()["Xmp.dc.source"].toString());
+}
+
+TEST(JpegImage_memoryUsage, addsTheBuffersToTheContainers)
+{
+    Image::UniquePtr image = createJpegWithMetadata();
+    const Image& constImage = *image;
+    MemoryUsage containers = constImage.exifData().memoryUsage();
+    containers += constImage.iptcData().memoryUsage();
+    containers += constImage.xmpData().memoryUsage();
+
+    const MemoryUsage usage = image->memoryUsage();
+    ASSERT_EQ(containers.datums_, usage.datums_);
+    ASSERT_EQ(containers.keys_, usage.keys_);
+    ASSERT_EQ(containers.values_, usage.values_);
+    ASSERT_GE(usage.buffers_, containers.buffers_ + constImage.xmpPacket().size() + image->comment().size());
+}
+
+TEST(JpegImage_memoryUsage, isCollectedWhenTheImageIsDestroyed)
+{
+    IoStats stats;
+    uint64_t total = 0;
+    {
+        IoStatsCollector collector(stats);
+        Image::UniquePtr image = createJpegWithMetadata();
+        total = image->memoryUsage().total();
+    }
+    ASSERT_GT(total, 0u);
+    ASSERT_EQ(total, stats.metadataMemory_.total());
+}
+
+TEST(JpegImage_parallelDecode, readsTheSameMetadataAsTheSerialDecode)
+{
+    Image::UniquePtr source = createJpegWithMetadata();
+    RawPacketJpegImage image(*source);
+    ASSERT_FALSE(image.parallelDecode());
+    image.parallelDecode(true);
+    image.readMetadata();
+
+    ASSERT_EQ(source->exifData().count(), image.exifData().count());
+    ASSERT_EQ("An Artist", image.exifData()["Exif.Image.Artist"].toString());
+    ASSERT_EQ(source->byteOrder(), image.byteOrder());
+    ASSERT_EQ("A caption", image.iptcData()["Iptc.Application2.Caption"].toString());
+    ASSERT_EQ("A source", image.xmpData()["Xmp.dc.source"].toString());
+    ASSERT_EQ(static_cast<const Image&>(*source).xmpPacket(), image.rawXmpPacket());
+}
+
+TEST(JpegImage_parallelDecode, logsTheMessagesOfTheFamiliesInTheCallingThread)
+{
+    Image::UniquePtr source = createJpegWithMetadata();
+    std::string jpeg(reinterpret_cast<const char*>(source->io().mmap()), static_cast<size_t>(source->io().size()));
+    const size_t end = jpeg.find("</rdf:RDF>");
+    ASSERT_NE(std::string::npos, end);
+    jpeg[end + 8] = 'X'; // breaks the XML of the XMP packet
+
+    Image::UniquePtr image = ImageFactory::open(reinterpret_cast<const byte*>(jpeg.data()),
+                                                static_cast<long>(jpeg.size()));
+    image->parallelDecode(true);
+    LogMsg::Scope scope;
+    image->readMetadata();
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+    const LogMsg::Messages& messages = scope.messages();
+    ASSERT_FALSE(messages.empty());
+    ASSERT_EQ("Failed to decode XMP metadata.\n", messages.back().text_);
+}
@@ -0,0 +1,111 @@
+// File under test
+#include <makernote_int.hpp>
+
+// Auxiliary headers
+#include <nikonmn_int.hpp>
+#include <tiffcomposite_int.hpp>
+
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+using namespace Exiv2::Internal;
+
+namespace
+{
+    //! Add an entry with the value \em text to \em dir
+    void addEntry(TiffDirectory& dir, uint16_t tag, IfdId group, TypeId typeId, const char* text)
+    {
+        TiffComponent* entry = dir.addChild(TiffComponent::UniquePtr(new TiffEntry(tag, group)));
+        Value::UniquePtr value = Value::create(typeId);
+        value->read(text);
+        dynamic_cast<TiffEntryBase*>(entry)->setValue(std::move(value));
+    }
+
+    //! Root of a composite with the shutter count and the serial number of a Nikon camera
+    void addNikonIdentity(TiffDirectory& root)
+    {
+        addEntry(root, 0x00a7, nikon3Id, unsignedLong, "1234");
+        addEntry(root, 0x001d, nikon3Id, asciiString, "5678");
+    }
+}
+
+TEST(nikonCrypt, producesTheKeystreamOfTheNikonCipher)
+{
+    TiffDirectory root(0, ifd0Id);
+    addNikonIdentity(root);
+    // ShotInfo version 0208 (D80) is encrypted from byte 4 on
+    std::vector<byte> data(2000, 0);
+    std::memcpy(&data[0], "0208", 4);
+
+    DataBuf buf = nikonCrypt(0x0091, &data[0], static_cast<uint32_t>(data.size()), &root);
+    ASSERT_EQ(static_cast<long>(data.size()), buf.size_);
+    ASSERT_EQ(0, std::memcmp(buf.pData_, "0208", 4));
+    // The keystream advances by ci * ck with ck counting up from 0x60
+    const byte* ks = buf.pData_ + 4;
+    const byte ci = static_cast<byte>(ks[2] - 2 * ks[1] + ks[0]);
+    for (uint32_t i = 1; i < data.size() - 4; ++i) {
+        ASSERT_EQ(static_cast<byte>(ci * static_cast<byte>(0x60 + i)), static_cast<byte>(ks[i] - ks[i - 1])) << i;
+    }
+}
+
+TEST(nikonCrypt, decryptsWhatItEncrypts)
+{
+    TiffDirectory root(0, ifd0Id);
+    addNikonIdentity(root);
+    std::vector<byte> data(1000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<byte>(i * 7);
+    std::memcpy(&data[0], "0208", 4);
+
+    DataBuf encrypted = nikonCrypt(0x0091, &data[0], static_cast<uint32_t>(data.size()), &root);
+    ASSERT_NE(0, std::memcmp(encrypted.pData_, &data[0], data.size()));
+    DataBuf decrypted = nikonCrypt(0x0091, encrypted.pData_, encrypted.size_, &root);
+    ASSERT_EQ(0, std::memcmp(decrypted.pData_, &data[0], data.size()));
+}
+
+TEST(nikonCrypt, returnsNothingWithoutTheShutterCount)
+{
+    TiffDirectory root(0, ifd0Id);
+    std::vector<byte> data(100, 0);
+    std::memcpy(&data[0], "0208", 4);
+    ASSERT_EQ(0, nikonCrypt(0x0091, &data[0], static_cast<uint32_t>(data.size()), &root).size_);
+}
+
+TEST(TiffMnCreator, selectsTheMakernoteByThePrefixOfTheMake)
+{
+    const byte data[16] = { 0 };
+    std::unique_ptr<TiffComponent> canon(TiffMnCreator::create(0x927c, exifId, "Canon EOS", data, sizeof(data), littleEndian));
+    ASSERT_NE(nullptr, canon.get());
+    std::unique_ptr<TiffComponent> minolta(TiffMnCreator::create(0x927c, exifId, "KONICA MINOLTA", data, sizeof(data), littleEndian));
+    ASSERT_NE(nullptr, minolta.get());
+
+    ASSERT_EQ(nullptr, TiffMnCreator::create(0x927c, exifId, "Can", data, sizeof(data), littleEndian));
+    ASSERT_EQ(nullptr, TiffMnCreator::create(0x927c, exifId, "-", data, sizeof(data), littleEndian));
+    ASSERT_EQ(nullptr, TiffMnCreator::create(0x927c, exifId, "", data, sizeof(data), littleEndian));
+}
+
+TEST(TiffMnCreator, selectsTheMakernoteByGroup)
+{
+    std::unique_ptr<TiffComponent> nikon(TiffMnCreator::create(0x927c, exifId, nikon3Id));
+    ASSERT_NE(nullptr, nikon.get());
+    ASSERT_EQ(nullptr, TiffMnCreator::create(0x927c, exifId, exifId));
+}
+
+TEST(Nikon3MakerNote_printLensId, printsThePreParsedLensId)
+{
+    UShortValue value;
+    std::ostringstream os;
+    value.read("1");
+    Nikon3MakerNote::printLensId1(os, value, 0);
+    ASSERT_EQ("Nikon AF Nikkor 50mm f/1.8", os.str());
+
+    // The search stops at the first lens without a lens id
+    os.str("");
+    value.read("0");
+    Nikon3MakerNote::printLensId1(os, value, 0);
+    ASSERT_EQ("Tamron SP AF 14mm F/2.8 Aspherical (IF)", os.str());
+}
@@ -0,0 +1,172 @@
+// File under test
+#include <exiv2/metacache.hpp>
+
+// Auxiliary headers
+#include <exiv2/basicio.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/iptc.hpp>
+#include <exiv2/jpgimage.hpp>
+#include <exiv2/xmp_exiv2.hpp>
+
+#include <cstdio>
+#include <string>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    const std::string imageFile("tmp_metacache.jpg");
+    const std::string cacheFile("tmp_metacache.dat");
+
+    void writeJpegWithMetadata(const std::string& artist)
+    {
+        Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+        image->exifData()["Exif.Image.Artist"] = artist;
+        image->exifData()["Exif.Photo.UserComment"] = "charset=Ascii A user comment";
+        image->iptcData()["Iptc.Application2.Caption"] = "A caption";
+        image->xmpData()["Xmp.dc.source"] = "A source";
+        image->xmpData()["Xmp.dc.subject"] = "First";
+        image->xmpData()["Xmp.dc.title"] = "lang=de-DE Ein Titel";
+        image->setComment("A comment");
+        image->writeMetadata();
+
+        FileIo file(imageFile);
+        file.open("wb");
+        image->io().seek(0, BasicIo::beg);
+        DataBuf buf(image->io().size());
+        image->io().read(buf.pData_, buf.size_);
+        file.write(buf.pData_, buf.size_);
+    }
+
+    std::string dump(const Image& image)
+    {
+        std::string s = image.comment() + "\n" + image.xmpPacket();
+        for (auto&& md : image.exifData()) s += md.key() + "=" + md.toString() + "\n";
+        for (auto&& md : image.iptcData()) s += md.key() + "=" + md.toString() + "\n";
+        for (auto&& md : image.xmpData()) s += md.key() + "=" + md.toString() + "\n";
+        return s;
+    }
+}
+
+TEST(MetadataCache, returnsTheMetadataOfUnchangedFiles)
+{
+    std::remove(cacheFile.c_str());
+    writeJpegWithMetadata("An Artist");
+
+    Image::UniquePtr expected = ImageFactory::open(imageFile);
+    expected->readMetadata();
+    {
+        MetadataCache cache(cacheFile);
+        Image::UniquePtr image = ImageFactory::open(imageFile);
+        ASSERT_FALSE(cache.readMetadata(*image));
+        ASSERT_EQ(dump(*expected), dump(*image));
+        ASSERT_EQ(1, cache.size());
+        ASSERT_EQ(1, cache.misses());
+    }
+
+    // The entry persists in the cache file
+    MetadataCache cache(cacheFile);
+    ASSERT_EQ(1, cache.size());
+    Image::UniquePtr image = ImageFactory::open(imageFile);
+    ASSERT_TRUE(cache.readMetadata(*image));
+    ASSERT_EQ(dump(*expected), dump(*image));
+    ASSERT_EQ(expected->pixelWidth(), image->pixelWidth());
+    ASSERT_EQ(1, cache.hits());
+    ASSERT_EQ(0, cache.misses());
+
+    std::remove(imageFile.c_str());
+    std::remove(cacheFile.c_str());
+}
+
+TEST(MetadataCache, readsChangedFilesAgain)
+{
+    std::remove(cacheFile.c_str());
+    writeJpegWithMetadata("An Artist");
+    MetadataCache cache(cacheFile);
+    Image::UniquePtr image = ImageFactory::open(imageFile);
+    ASSERT_FALSE(cache.readMetadata(*image));
+
+    writeJpegWithMetadata("Another Artist with a longer name");
+    image = ImageFactory::open(imageFile);
+    ASSERT_FALSE(cache.readMetadata(*image));
+    ASSERT_EQ("Another Artist with a longer name", image->exifData()["Exif.Image.Artist"].toString());
+    ASSERT_EQ(1, cache.size());
+    ASSERT_EQ(2, cache.misses());
+
+    // The newer entry supersedes the older one
+    MetadataCache reopened(cacheFile);
+    image = ImageFactory::open(imageFile);
+    ASSERT_TRUE(reopened.readMetadata(*image));
+    ASSERT_EQ("Another Artist with a longer name", image->exifData()["Exif.Image.Artist"].toString());
+
+    std::remove(imageFile.c_str());
+    std::remove(cacheFile.c_str());
+}
+
+TEST(MetadataCache, discardsAnInvalidCacheFile)
+{
+    {
+        FileIo file(cacheFile);
+        file.open("wb");
+        file.write(reinterpret_cast<const byte*>("garbage"), 7);
+    }
+    writeJpegWithMetadata("An Artist");
+    MetadataCache cache(cacheFile);
+    ASSERT_EQ(0, cache.size());
+    Image::UniquePtr image = ImageFactory::open(imageFile);
+    ASSERT_FALSE(cache.readMetadata(*image));
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+
+    MetadataCache reopened(cacheFile);
+    ASSERT_EQ(1, reopened.size());
+
+    std::remove(imageFile.c_str());
+    std::remove(cacheFile.c_str());
+}
+
+TEST(MetadataCache, isBypassedForImagesInMemory)
+{
+    std::remove(cacheFile.c_str());
+    MetadataCache cache(cacheFile);
+    Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+    image->writeMetadata();
+    ASSERT_FALSE(cache.readMetadata(*image));
+    ASSERT_EQ(0, cache.size());
+    std::remove(cacheFile.c_str());
+}
+
+TEST(MetadataCache, dropsATruncatedLastRecord)
+{
+    std::remove(cacheFile.c_str());
+    writeJpegWithMetadata("An Artist");
+    {
+        MetadataCache cache(cacheFile);
+        Image::UniquePtr image = ImageFactory::open(imageFile);
+        ASSERT_FALSE(cache.readMetadata(*image));
+    }
+    {
+        // The start of a record, as left by a crash while appending
+        FileIo file(cacheFile);
+        file.open("ab");
+        file.write(reinterpret_cast<const byte*>("\x40\x00\x00\x00tmp_"), 8);
+    }
+    writeJpegWithMetadata("Another Artist");
+    {
+        MetadataCache cache(cacheFile);
+        ASSERT_EQ(1, cache.size());
+        Image::UniquePtr image = ImageFactory::open(imageFile);
+        ASSERT_FALSE(cache.readMetadata(*image));
+    }
+
+    // The new record was not appended after the damaged one
+    MetadataCache reopened(cacheFile);
+    Image::UniquePtr image = ImageFactory::open(imageFile);
+    ASSERT_TRUE(reopened.readMetadata(*image));
+    ASSERT_EQ("Another Artist", image->exifData()["Exif.Image.Artist"].toString());
+
+    std::remove(imageFile.c_str());
+    std::remove(cacheFile.c_str());
+}
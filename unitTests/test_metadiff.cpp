@@ -0,0 +1,107 @@
+// File under test
+#include <exiv2/metadiff.hpp>
+
+// Auxiliary headers
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/iptc.hpp>
+#include <exiv2/jpgimage.hpp>
+#include <exiv2/xmp_exiv2.hpp>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+TEST(MetadataDiff, isEmptyForEqualMetadata)
+{
+    ExifData exif;
+    exif["Exif.Image.Artist"] = "An Artist";
+    exif["Exif.Photo.ISOSpeedRatings"] = uint16_t(100);
+    IptcData iptc;
+    iptc["Iptc.Application2.Caption"] = "A caption";
+    XmpData xmp;
+    xmp["Xmp.dc.source"] = "A source";
+
+    MetadataDiff diff;
+    diff.compare(exif, ExifData(exif));
+    diff.compare(iptc, IptcData(iptc));
+    diff.compare(xmp, XmpData(xmp));
+    ASSERT_TRUE(diff.empty());
+    ASSERT_TRUE(diff.fixedSize());
+}
+
+TEST(MetadataDiff, listsAddedRemovedAndModifiedDatums)
+{
+    ExifData before;
+    before["Exif.Image.Artist"] = "An Artist";
+    before["Exif.Image.Model"] = "A model";
+    before["Exif.Photo.ISOSpeedRatings"] = uint16_t(100);
+    ExifData after(before);
+    after["Exif.Image.Artist"] = "Another";
+    after["Exif.Photo.ISOSpeedRatings"] = uint16_t(200);
+    after.erase(after.findKey(ExifKey("Exif.Image.Model")));
+    after["Exif.Image.Make"] = "A make";
+
+    MetadataDiff diff;
+    diff.compare(before, after);
+    ASSERT_EQ(4u, diff.changes().size());
+    ASSERT_FALSE(diff.fixedSize());
+    for (MetadataDiff::Changes::const_iterator i = diff.changes().begin(); i != diff.changes().end(); ++i) {
+        ASSERT_EQ(mdExif, i->metadataId_);
+        if (i->key_ == "Exif.Image.Artist") {
+            ASSERT_EQ(MetadataDiff::modified, i->type_);
+            ASSERT_FALSE(i->sameSize_);
+        } else if (i->key_ == "Exif.Photo.ISOSpeedRatings") {
+            ASSERT_EQ(MetadataDiff::modified, i->type_);
+            ASSERT_TRUE(i->sameSize_);
+        } else if (i->key_ == "Exif.Image.Model") {
+            ASSERT_EQ(MetadataDiff::removed, i->type_);
+        } else {
+            ASSERT_EQ("Exif.Image.Make", i->key_);
+            ASSERT_EQ(MetadataDiff::added, i->type_);
+        }
+    }
+}
+
+TEST(MetadataDiff, matchesRepeatedDatumsByOccurrence)
+{
+    IptcData before;
+    before.add(IptcKey("Iptc.Application2.Keywords"), Value::UniquePtr(new StringValue("one")));
+    before.add(IptcKey("Iptc.Application2.Keywords"), Value::UniquePtr(new StringValue("two")));
+    IptcData after(before);
+    after.add(IptcKey("Iptc.Application2.Keywords"), Value::UniquePtr(new StringValue("six")));
+
+    MetadataDiff diff;
+    diff.compare(before, after);
+    ASSERT_EQ(1u, diff.changes().size());
+    ASSERT_EQ(MetadataDiff::added, diff.changes()[0].type_);
+    ASSERT_EQ(mdIptc, diff.changes()[0].metadataId_);
+}
+
+TEST(Image_writeChangedMetadata, skipsEmptyAndPatchesFixedSizeChangesInPlace)
+{
+    Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+    image->exifData()["Exif.Image.Artist"] = "An Artist";
+    image->exifData()["Exif.Photo.ISOSpeedRatings"] = uint16_t(100);
+    image->writeMetadata();
+    image->readMetadata();
+    const ExifData original = image->exifData();
+    const long size = image->io().size();
+
+    MetadataDiff diff;
+    diff.compare(original, image->exifData());
+    image->writeChangedMetadata(diff);
+    ASSERT_EQ(size, image->io().size());
+
+    image->exifData()["Exif.Photo.ISOSpeedRatings"] = uint16_t(200);
+    diff.clear();
+    diff.compare(original, image->exifData());
+    ASSERT_TRUE(diff.fixedSize());
+    image->writeChangedMetadata(diff);
+    ASSERT_FALSE(image->writeInPlace());
+    ASSERT_EQ(size, image->io().size());
+
+    image->readMetadata();
+    ASSERT_EQ(200, image->exifData()["Exif.Photo.ISOSpeedRatings"].toLong());
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+}
@@ -0,0 +1,166 @@
+// File under test
+#include <exiv2/metaindex.hpp>
+
+// Auxiliary headers
+#include <exiv2/basicio.hpp>
+#include <exiv2/error.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/iptc.hpp>
+#include <exiv2/jpgimage.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    const std::string indexFile("tmp_metaindex.idx");
+    const std::string imageFiles[] = { "tmp_metaindex_a.jpg", "tmp_metaindex_b.jpg", "tmp_metaindex_c.jpg" };
+
+    void writeJpeg(const std::string& path, const std::string& make)
+    {
+        Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+        image->exifData()["Exif.Image.Make"] = make;
+        image->exifData()["Exif.Image.Model"] = "A model";
+        image->iptcData().add(IptcKey("Iptc.Application2.Keywords"), StringValue("one").clone().get());
+        image->iptcData().add(IptcKey("Iptc.Application2.Keywords"), StringValue(make).clone().get());
+        image->writeMetadata();
+
+        FileIo file(path);
+        file.open("wb");
+        image->io().seek(0, BasicIo::beg);
+        DataBuf buf(image->io().size());
+        image->io().read(buf.pData_, buf.size_);
+        file.write(buf.pData_, buf.size_);
+    }
+
+    //! Return a source of the paths
+    BatchProcessor::PathSource source(const std::vector<std::string>& paths)
+    {
+        std::shared_ptr<size_t> next(new size_t(0));
+        return [paths, next](std::string& path) {
+            if (*next == paths.size()) return false;
+            path = paths[(*next)++];
+            return true;
+        };
+    }
+
+    std::vector<std::string> allFiles()
+    {
+        return std::vector<std::string>(imageFiles, imageFiles + 3);
+    }
+}
+
+TEST(MetadataIndex, indexesTheValuesOfItsKeys)
+{
+    std::remove(indexFile.c_str());
+    writeJpeg(imageFiles[0], "Canon");
+    writeJpeg(imageFiles[1], "Nikon");
+    writeJpeg(imageFiles[2], "Canon");
+
+    {
+        MetadataIndex index(indexFile);
+        ASSERT_EQ(0u, index.size());
+        std::vector<std::string> keys;
+        keys.push_back("Exif.Image.Make");
+        keys.push_back("Iptc.Application2.Keywords");
+        index.setKeys(keys);
+        const BatchProcessor::Results results = index.update(source(allFiles()), 2);
+        ASSERT_EQ(3u, results.size());
+        ASSERT_EQ(3, index.read());
+        ASSERT_EQ(3u, index.size());
+        index.write();
+    }
+
+    // The index persists in its file
+    const MetadataIndex index(indexFile);
+    ASSERT_EQ(3u, index.size());
+    ASSERT_EQ(2u, index.keys().size());
+    ASSERT_EQ(imageFiles[1], index.path(1));
+    ASSERT_EQ(std::vector<std::string>(1, "Nikon"), index.values(1, "Exif.Image.Make"));
+    const std::vector<std::string> keywords = index.values(1, "Iptc.Application2.Keywords");
+    ASSERT_EQ(2u, keywords.size());
+    ASSERT_EQ("one", keywords[0]);
+    ASSERT_EQ("Nikon", keywords[1]);
+
+    const std::vector<size_t> canon = index.find("Exif.Image.Make", "Canon");
+    ASSERT_EQ(2u, canon.size());
+    ASSERT_EQ(0u, canon[0]);
+    ASSERT_EQ(2u, canon[1]);
+    ASSERT_EQ(1u, index.find("Iptc.Application2.Keywords", "Nikon").size());
+    ASSERT_TRUE(index.find("Exif.Image.Make", "Sony").empty());
+    // Keys which are not indexed
+    ASSERT_THROW(index.find("Exif.Image.Model", "A model"), Error);
+    ASSERT_THROW(index.values(0, "Exif.Image.Model"), Error);
+
+    for (size_t i = 0; i < 3; ++i) std::remove(imageFiles[i].c_str());
+    std::remove(indexFile.c_str());
+}
+
+TEST(MetadataIndex, readsOnlyNewAndChangedFiles)
+{
+    std::remove(indexFile.c_str());
+    writeJpeg(imageFiles[0], "Canon");
+    writeJpeg(imageFiles[1], "Nikon");
+    {
+        MetadataIndex index(indexFile);
+        index.setKeys(std::vector<std::string>(1, "Exif.Image.Make"));
+        index.update(source(std::vector<std::string>(imageFiles, imageFiles + 2)));
+        index.write();
+    }
+
+    writeJpeg(imageFiles[1], "Pentax");
+    writeJpeg(imageFiles[2], "Sony");
+    {
+        MetadataIndex index(indexFile);
+        index.update(source(allFiles()));
+        ASSERT_EQ(2, index.read());
+        ASSERT_EQ(1, index.unchanged());
+        ASSERT_EQ(0, index.removed());
+        ASSERT_EQ(1u, index.find("Exif.Image.Make", "Pentax").size());
+        ASSERT_TRUE(index.find("Exif.Image.Make", "Nikon").empty());
+        index.write();
+    }
+
+    // Files which are not visited are kept while they exist
+    std::remove(imageFiles[2].c_str());
+    MetadataIndex index(indexFile);
+    index.update(source(std::vector<std::string>()));
+    ASSERT_EQ(0, index.read());
+    ASSERT_EQ(2, index.unchanged());
+    ASSERT_EQ(1, index.removed());
+    ASSERT_EQ(2u, index.size());
+
+    // Other keys require reading the files again
+    index.setKeys(std::vector<std::string>(1, "Exif.Image.Model"));
+    ASSERT_EQ(0u, index.size());
+    index.update(source(std::vector<std::string>(imageFiles, imageFiles + 2)));
+    ASSERT_EQ(2, index.read());
+    ASSERT_EQ(2u, index.find("Exif.Image.Model", "A model").size());
+
+    for (size_t i = 0; i < 3; ++i) std::remove(imageFiles[i].c_str());
+    std::remove(indexFile.c_str());
+}
+
+TEST(MetadataIndex, reportsFilesWhichCannotBeRead)
+{
+    std::remove(indexFile.c_str());
+    MetadataIndex index(indexFile);
+    index.setKeys(std::vector<std::string>(1, "Exif.Image.Make"));
+    const BatchProcessor::Results results = index.update(source(std::vector<std::string>(1, "tmp_metaindex_none.jpg")));
+    ASSERT_EQ(1u, results.size());
+    ASSERT_NE(kerSuccess, results[0].code_);
+    ASSERT_EQ(0u, index.size());
+}
+
+TEST(MetadataIndex, rejectsInvalidKeys)
+{
+    MetadataIndex index(indexFile);
+    ASSERT_THROW(index.setKeys(std::vector<std::string>(1, "Foo.Bar.Baz")), Error);
+    ASSERT_THROW(index.setKeys(std::vector<std::string>(1, "Exif.NoSuchGroup.Make")), Error);
+}
@@ -0,0 +1,141 @@
+// File under test
+#include <exiv2/metaview.hpp>
+
+// Auxiliary headers
+#include <exiv2/error.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/iptc.hpp>
+#include <exiv2/xmp_exiv2.hpp>
+
+#include <cstring>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace {
+
+    Blob encodeSample()
+    {
+        ExifData exif;
+        exif["Exif.Image.Make"] = "A make";
+        exif["Exif.Photo.ISOSpeedRatings"] = uint16_t(200);
+        exif["Exif.Photo.UserComment"] = "charset=Ascii A comment";
+        IptcData iptc;
+        iptc.add(IptcKey("Iptc.Application2.Keywords"), StringValue("one").clone().get());
+        iptc.add(IptcKey("Iptc.Application2.Keywords"), StringValue("two").clone().get());
+        XmpData xmp;
+        xmp["Xmp.dc.source"] = "A source";
+        XmpArrayValue subjects(xmpBag);
+        subjects.read("red");
+        subjects.read("green");
+        xmp.add(XmpKey("Xmp.dc.subject"), &subjects);
+        xmp["Xmp.dc.title"] = "lang=de-DE Ein Titel";
+
+        Blob blob;
+        MetadataView::encode(blob, exif, iptc, xmp);
+        return blob;
+    }
+
+}
+
+TEST(MetadataView, iteratesTheEntriesInTheOrderOfTheContainers)
+{
+    const Blob blob = encodeSample();
+    const MetadataView view(&blob[0], blob.size());
+    ASSERT_EQ(8u, view.size());
+    ASSERT_EQ(7u, view.keyCount());
+    ASSERT_STREQ("Exif.Image.Make", view[0].key());
+    ASSERT_EQ(mdExif, view[0].family());
+    ASSERT_EQ(asciiString, view[0].typeId());
+    ASSERT_EQ("A make", view[0].toString());
+    ASSERT_EQ(mdIptc, view[3].family());
+    ASSERT_STREQ("Iptc.Application2.Keywords", view[4].key());
+    ASSERT_EQ("two", view[4].toString());
+    ASSERT_EQ(mdXmp, view[7].family());
+    ASSERT_FALSE(view[8].valid());
+}
+
+TEST(MetadataView, looksUpKeysInPlace)
+{
+    const Blob blob = encodeSample();
+    const MetadataView view(&blob[0], blob.size());
+
+    const MetadataView::Entry iso = view.findKey("Exif.Photo.ISOSpeedRatings");
+    ASSERT_TRUE(iso.valid());
+    ASSERT_EQ(unsignedShort, iso.typeId());
+    ASSERT_EQ(1, iso.count());
+    ASSERT_EQ(2u, iso.size());
+    ASSERT_EQ(200, getUShort(iso.data(), littleEndian));
+    // The key is a pointer into the bytes of the view
+    ASSERT_TRUE(iso.key() >= reinterpret_cast<const char*>(&blob[0]));
+    ASSERT_TRUE(iso.key() < reinterpret_cast<const char*>(&blob[0] + blob.size()));
+
+    ASSERT_EQ(2u, view.count("Iptc.Application2.Keywords"));
+    ASSERT_EQ("one", view.findKey("Iptc.Application2.Keywords").toString());
+    ASSERT_EQ("two", view.findKey("Iptc.Application2.Keywords", 1).toString());
+    ASSERT_FALSE(view.findKey("Iptc.Application2.Keywords", 2).valid());
+    ASSERT_EQ(0u, view.count("Exif.Image.Model"));
+    ASSERT_FALSE(view.findKey("Exif.Image.Model").valid());
+    ASSERT_FALSE(view.findKey("").valid());
+}
+
+TEST(MetadataView, recreatesTheValues)
+{
+    const Blob blob = encodeSample();
+    const MetadataView view(SharedBuf(&blob[0], blob.size()));
+
+    const Value::UniquePtr comment = view.findKey("Exif.Photo.UserComment").value();
+    const CommentValue* commentValue = dynamic_cast<const CommentValue*>(comment.get());
+    ASSERT_TRUE(commentValue != 0);
+    ASSERT_EQ("A comment", commentValue->comment());
+
+    const Value::UniquePtr subjects = view.findKey("Xmp.dc.subject").value();
+    ASSERT_EQ(xmpBag, subjects->typeId());
+    ASSERT_EQ(2, subjects->count());
+    ASSERT_EQ("green", subjects->toString(1));
+
+    const Value::UniquePtr title = view.findKey("Xmp.dc.title").value();
+    const LangAltValue* langAlt = dynamic_cast<const LangAltValue*>(title.get());
+    ASSERT_TRUE(langAlt != 0);
+    ASSERT_EQ("Ein Titel", langAlt->toString("de-DE"));
+    ASSERT_EQ("A source", view.findKey("Xmp.dc.source").toString());
+}
+
+TEST(MetadataView, readsAViewAtAnyAddress)
+{
+    const Blob blob = encodeSample();
+    Blob shifted(blob.size() + 1);
+    std::memcpy(&shifted[1], &blob[0], blob.size());
+    const MetadataView view(&shifted[1], blob.size());
+    ASSERT_EQ(200, view.findKey("Exif.Photo.ISOSpeedRatings").value()->toLong());
+}
+
+TEST(MetadataView, encodesEmptyContainers)
+{
+    Blob blob;
+    MetadataView::encode(blob, ExifData(), IptcData(), XmpData());
+    const MetadataView view(&blob[0], blob.size());
+    ASSERT_TRUE(view.empty());
+    ASSERT_FALSE(view.findKey("Exif.Image.Make").valid());
+}
+
+TEST(MetadataView, rejectsCorruptedBytes)
+{
+    const byte garbage[] = "not a metadata view, just some bytes";
+    ASSERT_THROW(MetadataView(garbage, sizeof(garbage)), Error);
+
+    Blob blob = encodeSample();
+    ASSERT_THROW(MetadataView(&blob[0], blob.size() - 1), Error);
+    // A value offset beyond the blob
+    ul2Data(&blob[40 + 16], 0xfffffff0, littleEndian);
+    const MetadataView view(&blob[0], blob.size());
+    ASSERT_THROW(view[0].data(), Error);
+
+    // A key size which wraps around with its terminating 0
+    blob = encodeSample();
+    const size_t keys = 40 + 8 * 24;
+    ul2Data(&blob[keys + getULong(&blob[40], littleEndian) * 16 + 4], 0xffffffff, littleEndian);
+    const MetadataView wrapped(&blob[0], blob.size());
+    ASSERT_THROW(wrapped[0].key(), Error);
+}
@@ -0,0 +1,209 @@
+// File under test
+#include <exiv2/pngimage.hpp>
+
+// Auxiliary headers
+#include <exiv2/basicio.hpp>
+#include <exiv2/error.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/iptc.hpp>
+#include <exiv2/xmp_exiv2.hpp>
+
+#include <string>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+#ifdef EXV_HAVE_LIBZ
+namespace
+{
+    Image::UniquePtr createPngWithMetadata()
+    {
+        Image::UniquePtr image = ImageFactory::create(ImageType::png);
+        image->exifData()["Exif.Image.Artist"] = "An Artist";
+        image->iptcData()["Iptc.Application2.Caption"] = "A caption";
+        image->xmpData()["Xmp.dc.source"] = "A source";
+        image->setComment("A comment");
+        image->writeMetadata();
+        return image;
+    }
+
+    std::string contents(BasicIo& io)
+    {
+        return std::string(reinterpret_cast<const char*>(io.mmap()), io.size());
+    }
+}
+
+TEST(PngImage_stripMetadataTo, copiesTheImageWithoutTheMetadataChunks)
+{
+    Image::UniquePtr image = createPngWithMetadata();
+    const std::string png = contents(image->io());
+
+    MemIo out;
+    image->stripMetadataTo(out);
+    ASSERT_EQ(png, contents(image->io()));
+    const std::string stripped = contents(out);
+    ASSERT_EQ(std::string::npos, stripped.find("tEXt"));
+    ASSERT_EQ(std::string::npos, stripped.find("zTXt"));
+    ASSERT_EQ(std::string::npos, stripped.find("iTXt"));
+    ASSERT_EQ(std::string::npos, stripped.find("eXIf"));
+    // The image data and the end are copied as they are
+    ASSERT_EQ(png.substr(png.find("IDAT") - 4), stripped.substr(stripped.find("IDAT") - 4));
+
+    Image::UniquePtr copy = ImageFactory::open(out.mmap(), out.size());
+    copy->readMetadata();
+    ASSERT_TRUE(copy->exifData().empty());
+    ASSERT_TRUE(copy->iptcData().empty());
+    ASSERT_TRUE(copy->xmpData().empty());
+    ASSERT_TRUE(copy->comment().empty());
+}
+
+TEST(PngImage_stripMetadataTo, keepsTheRequestedMetadata)
+{
+    Image::UniquePtr image = createPngWithMetadata();
+
+    MemIo out;
+    image->stripMetadataTo(out, mdComment | mdXmp);
+    Image::UniquePtr copy = ImageFactory::open(out.mmap(), out.size());
+    copy->readMetadata();
+    ASSERT_TRUE(copy->exifData().empty());
+    ASSERT_TRUE(copy->iptcData().empty());
+    ASSERT_EQ("A source", copy->xmpData()["Xmp.dc.source"].toString());
+    ASSERT_EQ("A comment", copy->comment());
+}
+#endif
+
+#ifdef EXV_HAVE_LIBZ
+TEST(PngImage_payloadHash, isStableWhenTheMetadataChanges)
+{
+    Image::UniquePtr image = createPngWithMetadata();
+    image->hashPayload(true);
+    image->readMetadata();
+    ASSERT_TRUE(image->payloadHashDefined());
+    const uint64_t hash = image->payloadHash();
+
+    MemIo out;
+    image->stripMetadataTo(out);
+    ASSERT_EQ(hash, image->payloadHash());
+
+    Image::UniquePtr blank = ImageFactory::open(out.mmap(), out.size());
+    blank->hashPayload(true);
+    blank->readMetadata();
+    ASSERT_EQ(hash, blank->payloadHash());
+
+    // A change of the image data changes the hash
+    std::string png = contents(image->io());
+    png[png.find("IDAT") + 4] ^= 1;
+    Image::UniquePtr changed = ImageFactory::open(reinterpret_cast<const byte*>(png.data()),
+                                                  static_cast<long>(png.size()));
+    changed->hashPayload(true);
+    changed->readMetadata();
+    ASSERT_NE(hash, changed->payloadHash());
+}
+
+TEST(PngImage_parseLimits, limitTheInflatedSizeOfTheTextChunks)
+{
+    Image::UniquePtr image = ImageFactory::create(ImageType::png);
+    image->setComment(std::string(100000, 'a'));
+    image->writeMetadata();
+    ASSERT_LT(image->io().size(), 10000u);
+
+    ParseLimits limits;
+    limits.maxInflatedSize_ = 50000;
+    image->io().setParseLimits(limits);
+    try {
+        image->readMetadata();
+        FAIL() << "The comment was inflated beyond the limit";
+    } catch (const Error& e) {
+        ASSERT_EQ(kerResourceLimitExceeded, e.code());
+    }
+
+    limits.maxInflatedSize_ = 100000;
+    image->io().setParseLimits(limits);
+    image->readMetadata();
+    ASSERT_EQ(100000u, image->comment().size());
+}
+
+TEST(PngImage_eXIf, isWrittenByDefaultAndReadBack)
+{
+    Image::UniquePtr image = createPngWithMetadata();
+    const std::string png = contents(image->io());
+    ASSERT_NE(std::string::npos, png.find("eXIf"));
+    ASSERT_EQ(std::string::npos, png.find("Raw profile type exif"));
+
+    image->readMetadata();
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+
+    // Rewriting replaces the chunk
+    image->exifData()["Exif.Image.Artist"] = "Another Artist";
+    image->writeMetadata();
+    const std::string rewritten = contents(image->io());
+    ASSERT_EQ(rewritten.find("eXIf"), rewritten.rfind("eXIf"));
+    image->readMetadata();
+    ASSERT_EQ("Another Artist", image->exifData()["Exif.Image.Artist"].toString());
+}
+
+TEST(PngImage_eXIf, canBeReplacedByARawProfile)
+{
+    Image::UniquePtr image = createPngWithMetadata();
+    PngImage& png = dynamic_cast<PngImage&>(*image);
+    ASSERT_FALSE(png.writeExifRawProfile());
+    png.writeExifRawProfile(true);
+    image->writeMetadata();
+    const std::string data = contents(image->io());
+    ASSERT_EQ(std::string::npos, data.find("eXIf"));
+    ASSERT_NE(std::string::npos, data.find("Raw profile type exif"));
+
+    image->readMetadata();
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+}
+
+TEST(PngImage_iccProfile, isInflatedOnFirstAccess)
+{
+    Image::UniquePtr image = createPngWithMetadata();
+    DataBuf profile(4096);
+    for (long i = 0; i < profile.size_; ++i) profile.pData_[i] = static_cast<byte>(i % 7);
+    image->setIccProfile(profile, false);
+    image->writeMetadata();
+
+    image->readMetadata();
+    ASSERT_TRUE(image->iccProfileDefined());
+    const size_t pending = image->memoryUsage().buffers_;
+    ASSERT_EQ(4096, image->iccProfile()->size_);
+    ASSERT_EQ(0, image->iccProfile()->pData_[0]);
+    ASSERT_EQ(4094 % 7, image->iccProfile()->pData_[4094]);
+    ASSERT_EQ(pending + 4096, image->memoryUsage().buffers_);
+
+    image->clearIccProfile();
+    ASSERT_FALSE(image->iccProfileDefined());
+    image->writeMetadata();
+    image->readMetadata();
+    ASSERT_FALSE(image->iccProfileDefined());
+    ASSERT_EQ(std::string::npos, contents(image->io()).find("iCCP"));
+}
+
+TEST(PngImage_iccProfile, isCopiedUnchangedWhenNotAccessed)
+{
+    Image::UniquePtr image = createPngWithMetadata();
+    DataBuf profile(4096);
+    image->setIccProfile(profile, false);
+    image->writeMetadata();
+    const std::string png = contents(image->io());
+    const size_t pos = png.find("iCCP") - 4;
+    const std::string chunk = png.substr(pos, 12 + getULong(reinterpret_cast<const byte*>(&png[pos]), bigEndian));
+
+    image->readMetadata();
+    image->setComment("Another comment");
+    image->writeMetadata();
+    std::string rewritten = contents(image->io());
+    ASSERT_EQ(rewritten.find("iCCP"), rewritten.rfind("iCCP"));
+    ASSERT_NE(std::string::npos, rewritten.find(chunk));
+
+    // The chunk is found again after the image was rewritten
+    image->writeMetadata();
+    rewritten = contents(image->io());
+    ASSERT_NE(std::string::npos, rewritten.find(chunk));
+    ASSERT_EQ(4096, image->iccProfile()->size_);
+}
+#endif
@@ -0,0 +1,111 @@
+// File under test
+#include <exiv2/preview.hpp>
+
+// Auxiliary headers
+#include <exiv2/basicio.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/jpgimage.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    //! JPEG thumbnail data, just the markers and a payload
+    std::string thumbnail()
+    {
+        return std::string("\xff\xd8\xff\xfe\x00\x0a", 6) + "12345678" + std::string("\xff\xd9", 2);
+    }
+
+    //! Write a JPEG image with the Exif thumbnail thumbnail() to \em path
+    void writeJpeg(const std::string& path)
+    {
+        Image::UniquePtr image = ImageFactory::create(ImageType::jpeg);
+        const std::string thumb = thumbnail();
+        ExifThumb(image->exifData()).setJpegThumbnail(reinterpret_cast<const byte*>(thumb.data()),
+                                                      static_cast<long>(thumb.size()));
+        image->writeMetadata();
+
+        FileIo file(path);
+        file.open("wb");
+        file.write(image->io());
+    }
+
+    //! Return the properties of the first preview image of \em image
+    PreviewProperties firstPreview(const Image& image)
+    {
+        const PreviewPropertiesList list = PreviewManager(image).getPreviewProperties();
+        EXPECT_FALSE(list.empty());
+        return list.empty() ? PreviewProperties() : list.front();
+    }
+}
+
+TEST(PreviewImage, viewRemainsValidAfterTheImageIsDestroyed)
+{
+    const std::string path("tmp_preview_view.jpg");
+    writeJpeg(path);
+    Image::UniquePtr image = ImageFactory::open(path);
+    image->readMetadata();
+    PreviewManager manager(*image);
+    PreviewImage view = manager.getPreviewImageView(firstPreview(*image));
+    image.reset();
+
+    const std::string thumb = thumbnail();
+    ASSERT_EQ(thumb.size(), view.size());
+    ASSERT_EQ(0, std::memcmp(thumb.data(), view.pData(), thumb.size()));
+    std::remove(path.c_str());
+}
+
+TEST(PreviewImage, keepsTheSourceIoOpenWhenItIsCopied)
+{
+    const std::string path("tmp_preview_open.jpg");
+    writeJpeg(path);
+    FileIo file(path);
+    DataBuf data(static_cast<long>(file.size()));
+    file.open();
+    file.read(data.pData_, data.size_);
+    file.close();
+    std::remove(path.c_str());
+
+    // An image in memory cannot be opened again, its preview is a copy
+    Image::UniquePtr image = ImageFactory::open(data.pData_, data.size_);
+    image->readMetadata();
+    ASSERT_EQ(0, image->io().open());
+    ASSERT_EQ(0, image->io().seek(4, BasicIo::beg));
+    PreviewImage view = PreviewManager(*image).getPreviewImageView(firstPreview(*image));
+    ASSERT_TRUE(image->io().isopen());
+    ASSERT_EQ(4, image->io().tell());
+
+    MemIo copy;
+    ASSERT_EQ(static_cast<long>(view.size()), view.writeTo(copy));
+    ASSERT_EQ(0, std::memcmp(thumbnail().data(), copy.mmap(), view.size()));
+}
+
+TEST(PreviewManager, createsViewsConcurrently)
+{
+    const std::string path("tmp_preview_threads.jpg");
+    writeJpeg(path);
+    Image::UniquePtr image = ImageFactory::open(path);
+    image->readMetadata();
+    const PreviewManager manager(*image);
+    const PreviewProperties properties = firstPreview(*image);
+
+    std::vector<std::thread> threads;
+    std::vector<uint32_t> sizes(4);
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        threads.push_back(std::thread([&manager, &properties, &sizes, i]() {
+            sizes[i] = manager.getPreviewImageView(properties).size();
+        }));
+    }
+    for (auto&& thread : threads) thread.join();
+    for (auto&& size : sizes) ASSERT_EQ(thumbnail().size(), size);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,149 @@
+// File under test
+#include <subio_int.hpp>
+
+// Auxiliary headers
+#include <exiv2/error.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/jpgimage.hpp>
+#include <exiv2/rafimage.hpp>
+
+#include <cstring>
+#include <vector>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+using Exiv2::Internal::SubIo;
+
+namespace
+{
+    const byte testData[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9'};
+
+    //! MemIo which records the ranges it is asked to prefetch
+    class PrefetchRecorder : public MemIo {
+    public:
+        PrefetchRecorder() : MemIo(testData, sizeof(testData)) {}
+        void prefetch(const std::vector<std::pair<long, long> >& ranges) override
+        {
+            ranges_.insert(ranges_.end(), ranges.begin(), ranges.end());
+        }
+        std::vector<std::pair<long, long> > ranges_;
+    };
+}
+
+TEST(SubIo_read, readsOnlyTheRange)
+{
+    MemIo io(testData, sizeof(testData));
+    SubIo sub(io, 3, 4);
+    ASSERT_EQ(0, sub.open());
+    ASSERT_EQ(4u, sub.size());
+
+    byte buf[8] = {0};
+    ASSERT_EQ(2, sub.read(buf, 2));
+    ASSERT_EQ(0, std::memcmp(buf, "34", 2));
+    ASSERT_EQ(2, sub.tell());
+    ASSERT_FALSE(sub.eof());
+
+    ASSERT_EQ(2, sub.read(buf, 8));
+    ASSERT_EQ(0, std::memcmp(buf, "56", 2));
+    ASSERT_TRUE(sub.eof());
+    ASSERT_EQ(EOF, sub.getb());
+}
+
+TEST(SubIo_seek, isRelativeToTheRange)
+{
+    MemIo io(testData, sizeof(testData));
+    SubIo sub(io, 3, 4);
+    sub.open();
+    ASSERT_EQ(0, sub.seek(-1, BasicIo::end));
+    ASSERT_EQ('6', sub.getb());
+    ASSERT_EQ(0, sub.seek(1, BasicIo::beg));
+    ASSERT_EQ('4', sub.getb());
+    ASSERT_NE(0, sub.seek(-3, BasicIo::cur));
+
+    DataBuf buf;
+    ASSERT_EQ(0, sub.seek(1, BasicIo::beg));
+    const byte* view = sub.readView(buf, 3);
+    ASSERT_TRUE(view != 0);
+    ASSERT_EQ(0, std::memcmp(view, "456", 3));
+    ASSERT_EQ(0, sub.readView(buf, 1));
+}
+
+TEST(SubIo_readAt, clampsToTheRange)
+{
+    MemIo io(testData, sizeof(testData));
+    SubIo sub(io, 3, 4);
+    sub.open();
+    byte buf[8] = {0};
+    ASSERT_EQ(2, sub.readAt(2, buf, 8));
+    ASSERT_EQ(0, std::memcmp(buf, "56", 2));
+    ASSERT_EQ(0, sub.readAt(4, buf, 1));
+    ASSERT_EQ(0, sub.tell());
+}
+
+TEST(SubIo_prefetch, forwardsTheRangesWithinTheView)
+{
+    PrefetchRecorder io;
+    SubIo sub(io, 3, 4);
+    std::vector<std::pair<long, long> > ranges;
+    ranges.push_back(std::make_pair(1L, 2L));
+    ranges.push_back(std::make_pair(2L, 10L));
+    ranges.push_back(std::make_pair(4L, 1L));
+    ranges.push_back(std::make_pair(-1L, 1L));
+    sub.prefetch(ranges);
+    ASSERT_EQ(2u, io.ranges_.size());
+    ASSERT_EQ(std::make_pair(4L, 2L), io.ranges_[0]);
+    ASSERT_EQ(std::make_pair(5L, 2L), io.ranges_[1]);
+}
+
+TEST(SubIo_write, isNotSupported)
+{
+    MemIo io(testData, sizeof(testData));
+    SubIo sub(io, 3, 4);
+    sub.open();
+    ASSERT_EQ(0, sub.write(testData, 1));
+    ASSERT_EQ(EOF, sub.putb('x'));
+    ASSERT_THROW(sub.mmap(true), Error);
+    ASSERT_EQ(0, std::memcmp(sub.mmap(), "3456", 4));
+}
+
+TEST(RafImage_readMetadata, readsTheMetadataOfTheEmbeddedJpeg)
+{
+    // A JPEG image with Exif metadata
+    Image::UniquePtr jpeg = ImageFactory::create(ImageType::jpeg);
+    jpeg->exifData()["Exif.Image.Make"] = "FUJIFILM";
+    jpeg->exifData()["Exif.Photo.DateTimeOriginal"] = "2020:01:02 03:04:05";
+    jpeg->writeMetadata();
+    BasicIo& jpegIo = jpeg->io();
+    jpegIo.seek(0, BasicIo::beg);
+    const DataBuf jpegData = jpegIo.read(static_cast<long>(jpegIo.size()));
+
+    std::vector<byte> preview(jpegData.pData_, jpegData.pData_ + jpegData.size_ - 2);
+    const byte sos[] = {0xff, 0xda, 0x00, 0x02};
+    preview.insert(preview.end(), sos, sos + sizeof(sos));
+    preview.resize(preview.size() + 0x10000, 0x55);
+    preview.push_back(0xff);
+    preview.push_back(0xd9);
+
+    std::vector<byte> raf(160, 0);
+    std::memcpy(&raf[0], "FUJIFILMCCD-RAW 0201FF383501", 28);
+    ul2Data(&raf[84], 160, bigEndian);
+    ul2Data(&raf[88], static_cast<uint32_t>(preview.size()), bigEndian);
+    raf.insert(raf.end(), preview.begin(), preview.end());
+
+    MemIo* memIo = new MemIo;
+    memIo->write(&raf[0], static_cast<long>(raf.size()));
+    Image::UniquePtr image = ImageFactory::open(BasicIo::UniquePtr(memIo));
+    ASSERT_EQ(ImageType::raf, image->imageType());
+    memIo->stats() = IoStats();
+    image->readMetadata();
+
+    ExifData& exifData = image->exifData();
+    ASSERT_EQ("FUJIFILM", exifData["Exif.Image.Make"].toString());
+    ASSERT_EQ("2020:01:02 03:04:05", exifData["Exif.Photo.DateTimeOriginal"].toString());
+    ASSERT_EQ(160, exifData["Exif.Image2.JPEGInterchangeFormat"].toLong());
+    ASSERT_EQ(static_cast<long>(preview.size()), exifData["Exif.Image2.JPEGInterchangeFormatLength"].toLong());
+    // The image data of the preview is skipped
+    ASSERT_LT(memIo->stats().bytesRead_, 0x10000u);
+}
@@ -0,0 +1,112 @@
+#include "gtestwrapper.h"
+
+#include <tags_int.hpp>
+
+using namespace Exiv2;
+using namespace Exiv2::Internal;
+
+namespace
+{
+    extern const TagDetails sortedDetails[] = {
+        {1, "one"}, {3, "three"}, {3, "three again"}, {7, "seven"}, {9, "nine"},
+    };
+
+    extern const TagDetails unsortedDetails[] = {
+        {9, "nine"}, {3, "three"}, {7, "seven"}, {3, "three again"}, {1, "one"},
+    };
+
+    extern const TagDetails denseDetails[] = {
+        {-1, "minus one"}, {0, "zero"}, {1, "one"}, {2, "two"},
+    };
+
+    extern const TagDetailsBitmask disjointBitmask[] = {
+        {0x0001, "bit 0"}, {0x0004, "bit 2"}, {0x0010, "bit 4"},
+    };
+
+    extern const TagDetailsBitmask overlappingBitmask[] = {
+        {0x0001, "bit 0"}, {0x0003, "bits 0 and 1"}, {0x0002, "bit 1"},
+    };
+}
+
+TEST(findTagDetails, findsTheFirstEntryOfASortedTable)
+{
+    const TagDetails* td = findTagDetails<EXV_COUNTOF(sortedDetails), sortedDetails>(3);
+    ASSERT_EQ(sortedDetails + 1, td);
+    td = findTagDetails<EXV_COUNTOF(sortedDetails), sortedDetails>(9);
+    ASSERT_EQ(sortedDetails + 4, td);
+    ASSERT_EQ(nullptr, (findTagDetails<EXV_COUNTOF(sortedDetails), sortedDetails>(0)));
+    ASSERT_EQ(nullptr, (findTagDetails<EXV_COUNTOF(sortedDetails), sortedDetails>(4)));
+    ASSERT_EQ(nullptr, (findTagDetails<EXV_COUNTOF(sortedDetails), sortedDetails>(10)));
+}
+
+TEST(findTagDetails, searchesAnUnsortedTableLinearly)
+{
+    const TagDetails* td = findTagDetails<EXV_COUNTOF(unsortedDetails), unsortedDetails>(3);
+    ASSERT_EQ(unsortedDetails + 1, td);
+    td = findTagDetails<EXV_COUNTOF(unsortedDetails), unsortedDetails>(1);
+    ASSERT_EQ(unsortedDetails + 4, td);
+    ASSERT_EQ(nullptr, (findTagDetails<EXV_COUNTOF(unsortedDetails), unsortedDetails>(4)));
+}
+
+TEST(findTagDetails, indexesADenseTableDirectly)
+{
+    ASSERT_EQ(tdsDense, tagDetailsShape(denseDetails, EXV_COUNTOF(denseDetails)));
+    ASSERT_EQ(tdsSorted, tagDetailsShape(sortedDetails, EXV_COUNTOF(sortedDetails)));
+    ASSERT_EQ(tdsUnsorted, tagDetailsShape(unsortedDetails, EXV_COUNTOF(unsortedDetails)));
+
+    ASSERT_EQ(denseDetails, (findTagDetails<EXV_COUNTOF(denseDetails), denseDetails>(-1)));
+    ASSERT_EQ(denseDetails + 3, (findTagDetails<EXV_COUNTOF(denseDetails), denseDetails>(2)));
+    ASSERT_EQ(nullptr, (findTagDetails<EXV_COUNTOF(denseDetails), denseDetails>(-2)));
+    ASSERT_EQ(nullptr, (findTagDetails<EXV_COUNTOF(denseDetails), denseDetails>(3)));
+}
+
+TEST(printTag, printsTheLabelOrTheValue)
+{
+    UShortValue value;
+    value.read("7");
+    std::ostringstream os;
+    printTag<EXV_COUNTOF(sortedDetails), sortedDetails>(os, value, nullptr);
+    ASSERT_EQ("seven", os.str());
+
+    value.read("5");
+    os.str("");
+    printTag<EXV_COUNTOF(sortedDetails), sortedDetails>(os, value, nullptr);
+    ASSERT_EQ("(5)", os.str());
+}
+
+TEST(printTagBitmask, printsTheLabelsOfAllMatchingMasks)
+{
+    UShortValue value;
+    value.read("21");
+    std::ostringstream os;
+    printTagBitmask<EXV_COUNTOF(disjointBitmask), disjointBitmask>(os, value, nullptr);
+    ASSERT_EQ("bit 0, bit 2, bit 4", os.str());
+
+    value.read("1");
+    os.str("");
+    printTagBitmask<EXV_COUNTOF(disjointBitmask), disjointBitmask>(os, value, nullptr);
+    ASSERT_EQ("bit 0", os.str());
+
+    os.str("");
+    printTagBitmask<EXV_COUNTOF(overlappingBitmask), overlappingBitmask>(os, value, nullptr);
+    ASSERT_EQ("bit 0, bits 0 and 1", os.str());
+}
+
+TEST(mnGroupTagList, returnsTheTagListsOfTheBuiltVendorModules)
+{
+    ASSERT_TRUE(mnGroupTagList(ifd0Id) == nullptr);
+    ASSERT_TRUE(mnGroupTagList(lastId) == nullptr);
+#ifdef EXV_HAVE_NIKON_MAKERNOTE
+    const TagInfo* nikon3 = mnGroupTagList(nikon3Id);
+    ASSERT_TRUE(nikon3 != nullptr);
+    ASSERT_EQ(nikon3, tagList(nikon3Id));
+    ASSERT_STREQ("NikonAf", groupName(nikonAfId));
+    ASSERT_EQ(mnGroupTagList(nikonAfId), tagList("NikonAf"));
+#else
+    ASSERT_TRUE(tagList(nikon3Id) == nullptr);
+#endif
+#ifdef EXV_HAVE_SONY_MAKERNOTE
+    // Sony groups use the tables of the Minolta module
+    ASSERT_EQ(tagList(minoltaCs7DId), tagList(sony1MltCs7DId));
+#endif
+}
@@ -0,0 +1,87 @@
+#include "tiffcomposite_int.hpp"
+
+#include <exiv2/value.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+using namespace Exiv2::Internal;
+
+TEST(ATiffArena, isCurrentWhileInScopeAndNests)
+{
+    ASSERT_EQ(nullptr, TiffArena::current());
+    {
+        TiffArena outer;
+        ASSERT_EQ(&outer, TiffArena::current());
+        {
+            TiffArena inner;
+            ASSERT_EQ(&inner, TiffArena::current());
+        }
+        ASSERT_EQ(&outer, TiffArena::current());
+    }
+    ASSERT_EQ(nullptr, TiffArena::current());
+}
+
+TEST(ATiffArena, returnsAlignedMemoryForSmallAndLargeRequests)
+{
+    TiffArena arena;
+    for (std::size_t size = 1; size < 100000; size = size * 3 + 1) {
+        void* p = arena.allocate(size);
+        ASSERT_NE(nullptr, p);
+        ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(p) % alignof(std::max_align_t));
+    }
+}
+
+TEST(ATiffComponent, canBeCreatedAndDeletedWithAndWithoutArena)
+{
+    std::unique_ptr<TiffComponent> heap(new TiffEntry(0x0100, ifd0Id));
+    {
+        TiffArena arena;
+        std::unique_ptr<TiffComponent> dir(new TiffDirectory(0, ifd0Id));
+        for (uint16_t tag = 0; tag < 1000; ++tag) {
+            dir->addChild(TiffComponent::UniquePtr(new TiffEntry(tag, ifd0Id)));
+        }
+        ASSERT_EQ(1000u, dir->count());
+        // A component allocated before the arena is still released normally
+        heap.reset();
+    }
+    std::unique_ptr<TiffComponent> after(new TiffEntry(0x0101, ifd0Id));
+    ASSERT_EQ(0x0101, after->tag());
+}
+
+namespace
+{
+    TiffComponent::UniquePtr entryWithText(uint16_t tag, const std::string& text)
+    {
+        std::unique_ptr<TiffEntry> entry(new TiffEntry(tag, ifd0Id));
+        entry->updateValue(Value::UniquePtr(new AsciiValue(text)), littleEndian);
+        return TiffComponent::UniquePtr(entry.release());
+    }
+}
+
+TEST(ATiffLayout, cachesTheSizesOfComponentsWhileItIsCurrent)
+{
+    TiffDirectory dir(0, ifd0Id, false);
+    dir.addChild(entryWithText(0x010e, "A long description"));
+    const uint32_t size = dir.size();
+    ASSERT_EQ(2u + 12 + 18, size);
+    {
+        TiffLayout layout;
+        ASSERT_EQ(&layout, TiffLayout::current());
+        ASSERT_EQ(size, dir.size());
+        // Composites must not be modified while a layout is current, the cached size is kept
+        dir.addChild(entryWithText(0x013b, "An artist"));
+        ASSERT_EQ(size, dir.size());
+        {
+            TiffLayout inner;
+            ASSERT_EQ(size + 12 + 10, dir.size());
+        }
+        ASSERT_EQ(&layout, TiffLayout::current());
+    }
+    ASSERT_EQ(nullptr, TiffLayout::current());
+    ASSERT_EQ(size + 12 + 10, dir.size());
+}
@@ -0,0 +1,548 @@
+// File under test
+#include <exiv2/tiffimage.hpp>
+
+// Auxiliary headers
+#include <exiv2/bigtiffimage.hpp>
+#include <exiv2/error.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/iptc.hpp>
+#include <exiv2/xmp_exiv2.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    const byte stripData[] = "The strip data of the image, 37 bytes";
+    const long stripSize = sizeof(stripData);
+
+    Image::UniquePtr createTiffWithStrip()
+    {
+        ExifData exifData;
+        exifData["Exif.Image.ImageWidth"] = uint32_t(stripSize);
+        exifData["Exif.Image.ImageLength"] = uint32_t(1);
+        exifData["Exif.Image.BitsPerSample"] = uint16_t(8);
+        exifData["Exif.Image.Artist"] = "An Artist";
+        exifData["Exif.Image.StripByteCounts"] = uint32_t(stripSize);
+        ULongValue offsets;
+        offsets.value_.push_back(0);
+        offsets.setDataArea(stripData, stripSize);
+        exifData.add(ExifKey("Exif.Image.StripOffsets"), &offsets);
+
+        BasicIo::UniquePtr io(new MemIo);
+        TiffParser::encode(*io, 0, 0, littleEndian, exifData, IptcData(), XmpData());
+        Image::UniquePtr image = ImageFactory::open(std::move(io));
+        image->readMetadata();
+        return image;
+    }
+
+    uint32_t stripOffset(Image& image)
+    {
+        return static_cast<uint32_t>(image.exifData()["Exif.Image.StripOffsets"].toLong());
+    }
+
+    bool hasStripAt(Image& image, uint32_t offset)
+    {
+        BasicIo& io = image.io();
+        if (io.open() != 0) return false;
+        DataBuf buf(stripSize);
+        io.seek(offset, BasicIo::beg);
+        const bool found = io.read(buf.pData_, buf.size_) == buf.size_
+                        && std::memcmp(buf.pData_, stripData, stripSize) == 0;
+        io.close();
+        return found;
+    }
+    //! Append a little endian BigTIFF IFD entry with an 8 byte value field
+    void addBigTiffEntry(std::vector<byte>& buf, uint16_t tag, uint16_t type, uint64_t count, uint64_t value)
+    {
+        byte entry[20];
+        us2Data(entry, tag, littleEndian);
+        us2Data(entry + 2, type, littleEndian);
+        ull2Data(entry + 4, count, littleEndian);
+        ull2Data(entry + 12, value, littleEndian);
+        buf.insert(buf.end(), entry, entry + sizeof(entry));
+    }
+
+    //! A BigTIFF image with an Exif IFD, values which do not fit in the entries are at offset 16
+    Image::UniquePtr createBigTiff()
+    {
+        const char artist[] = "A BigTIFF artist with a long name";
+        const char date[] = "2020:01:02 03:04:05";
+        std::vector<byte> buf(16 + 48 + 24);
+        const byte header[] = { 'I', 'I', 43, 0, 8, 0, 0, 0 };
+        std::memcpy(&buf[0], header, sizeof(header));
+        ull2Data(&buf[8], buf.size(), littleEndian);
+        std::memcpy(&buf[16], artist, sizeof(artist));
+        std::memcpy(&buf[64], date, sizeof(date));
+
+        const uint64_t exifIfd = buf.size() + 8 + 5 * 20 + 8;
+        byte word[8];
+        ull2Data(word, 5, littleEndian);
+        buf.insert(buf.end(), word, word + 8);
+        addBigTiffEntry(buf, 0x0100, unsignedShort, 1, 4);
+        addBigTiffEntry(buf, 0x010f, asciiString, 7, 0x6d6143676942ULL);   // "BigCam"
+        addBigTiffEntry(buf, 0x0111, unsignedLongLong, 1, 0);
+        addBigTiffEntry(buf, 0x013b, asciiString, sizeof(artist), 16);
+        addBigTiffEntry(buf, 0x8769, tiffIfd8, 1, exifIfd);
+        ull2Data(word, 0, littleEndian);
+        buf.insert(buf.end(), word, word + 8);
+
+        ull2Data(word, 1, littleEndian);
+        buf.insert(buf.end(), word, word + 8);
+        addBigTiffEntry(buf, 0x9003, asciiString, sizeof(date), 64);
+        ull2Data(word, 0, littleEndian);
+        buf.insert(buf.end(), word, word + 8);
+
+        BasicIo::UniquePtr io(new MemIo);
+        io->write(&buf[0], static_cast<long>(buf.size()));
+        Image::UniquePtr image = ImageFactory::open(std::move(io));
+        image->readMetadata();
+        return image;
+    }
+
+    //! Append a little endian IFD with the width and page number of page \em page, the last one points back to IFD0
+    void addPage(std::vector<byte>& buf, uint16_t page, uint16_t pages)
+    {
+        byte ifd[2 + 2 * 12 + 4];
+        us2Data(ifd, 2, littleEndian);
+        us2Data(ifd + 2, 0x0100, littleEndian);
+        us2Data(ifd + 4, unsignedShort, littleEndian);
+        ul2Data(ifd + 6, 1, littleEndian);
+        ul2Data(ifd + 10, 100 + page, littleEndian);
+        us2Data(ifd + 14, 0x0129, littleEndian);
+        us2Data(ifd + 16, unsignedShort, littleEndian);
+        ul2Data(ifd + 18, 2, littleEndian);
+        us2Data(ifd + 22, page, littleEndian);
+        us2Data(ifd + 24, pages, littleEndian);
+        const uint32_t next = page + 1 < pages ? static_cast<uint32_t>(buf.size() + sizeof(ifd)) : 8;
+        ul2Data(ifd + 26, next, littleEndian);
+        buf.insert(buf.end(), ifd, ifd + sizeof(ifd));
+    }
+
+    //! A TIFF image with IPTC and XMP embedded in the IPTCNAA and XMLPacket tags
+    Image::UniquePtr createTiffWithEmbedded()
+    {
+        ExifData exifData;
+        exifData["Exif.Image.Artist"] = "An Artist";
+        IptcData iptcData;
+        iptcData["Iptc.Application2.Caption"] = "A caption";
+        XmpData xmpData;
+        xmpData["Xmp.dc.source"] = "A source";
+
+        BasicIo::UniquePtr io(new MemIo);
+        TiffParser::encode(*io, 0, 0, littleEndian, exifData, iptcData, xmpData);
+        return ImageFactory::open(std::move(io));
+    }
+
+    DataBuf readAll(BasicIo& io)
+    {
+        io.open();
+        io.seek(0, BasicIo::beg);
+        DataBuf buf = io.read(static_cast<long>(io.size()));
+        io.close();
+        return buf;
+    }
+}
+
+TEST(TiffImage_writeInPlace, rewritesTheImageByDefault)
+{
+    Image::UniquePtr image = createTiffWithStrip();
+    const uint32_t offset = stripOffset(*image);
+    ASSERT_TRUE(hasStripAt(*image, offset));
+
+    image->exifData()["Exif.Image.ImageDescription"] = "A description which does not fit in place";
+    image->writeMetadata();
+    image->readMetadata();
+    ASSERT_EQ("A description which does not fit in place",
+              image->exifData()["Exif.Image.ImageDescription"].toString());
+    ASSERT_NE(offset, stripOffset(*image));
+    ASSERT_TRUE(hasStripAt(*image, stripOffset(*image)));
+}
+
+TEST(TiffImage_writeInPlace, appendsTheMetadataAndKeepsTheImageData)
+{
+    Image::UniquePtr image = createTiffWithStrip();
+    const uint32_t offset = stripOffset(*image);
+    const long size = image->io().size();
+
+    image->writeInPlace(true);
+    image->exifData()["Exif.Image.ImageDescription"] = "A description which does not fit in place";
+    image->writeMetadata();
+    ASSERT_LT(size, image->io().size());
+
+    image->readMetadata();
+    ASSERT_EQ("A description which does not fit in place",
+              image->exifData()["Exif.Image.ImageDescription"].toString());
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+    ASSERT_EQ(offset, stripOffset(*image));
+    ASSERT_TRUE(hasStripAt(*image, offset));
+
+    // The original image data is still in place after another append
+    image->exifData()["Exif.Image.Artist"] = "Another Artist who has a much longer name";
+    image->writeMetadata();
+    image->readMetadata();
+    ASSERT_EQ("Another Artist who has a much longer name", image->exifData()["Exif.Image.Artist"].toString());
+    ASSERT_EQ(offset, stripOffset(*image));
+    ASSERT_TRUE(hasStripAt(*image, offset));
+}
+
+#if !defined(_WIN32)
+namespace
+{
+    //! Return the number of files in the directory \em dir
+    int filesIn(const std::string& dir)
+    {
+        int count = 0;
+        DIR* d = ::opendir(dir.c_str());
+        if (d == 0) return count;
+        while (const struct dirent* entry = ::readdir(d)) {
+            if (std::strcmp(entry->d_name, ".") != 0 && std::strcmp(entry->d_name, "..") != 0) ++count;
+        }
+        ::closedir(d);
+        return count;
+    }
+}
+
+TEST(TiffImage_writeMetadata, streamsLargeImagesToATemporaryFile)
+{
+    // The image and the temporary file are big, keep them out of the working directory
+    const char* tmp = std::getenv("TMPDIR");
+    std::string dir = std::string(tmp && *tmp ? tmp : "/tmp") + "/exiv2-test-XXXXXX";
+    ASSERT_TRUE(::mkdtemp(&dir[0]) != 0);
+    const std::string path(dir + "/streamsLargeImages.tif");
+    std::vector<byte> strip(17 * 1024 * 1024);
+    for (size_t i = 0; i < strip.size(); ++i) strip[i] = static_cast<byte>(i % 251);
+
+    ExifData exifData;
+    exifData["Exif.Image.ImageWidth"] = uint32_t(strip.size());
+    exifData["Exif.Image.ImageLength"] = uint32_t(1);
+    exifData["Exif.Image.BitsPerSample"] = uint16_t(8);
+    exifData["Exif.Image.StripByteCounts"] = uint32_t(strip.size());
+    ULongValue offsets;
+    offsets.value_.push_back(0);
+    offsets.setDataArea(&strip[0], static_cast<long>(strip.size()));
+    exifData.add(ExifKey("Exif.Image.StripOffsets"), &offsets);
+    MemIo io;
+    TiffParser::encode(io, 0, 0, littleEndian, exifData, IptcData(), XmpData());
+    io.seek(0, BasicIo::beg);
+    DataBuf tiff = io.read(static_cast<long>(io.size()));
+    std::ofstream(path.c_str(), std::ios::binary).write(reinterpret_cast<const char*>(tiff.pData_), tiff.size_);
+
+    {
+        Image::UniquePtr image = ImageFactory::open(path);
+        image->readMetadata();
+        image->exifData()["Exif.Image.ImageDescription"] = "A description which does not fit in place";
+        image->writeMetadata();
+    }
+    ASSERT_EQ(1, filesIn(dir));
+
+    Image::UniquePtr image = ImageFactory::open(path);
+    image->readMetadata();
+    ASSERT_EQ("A description which does not fit in place",
+              image->exifData()["Exif.Image.ImageDescription"].toString());
+    const uint32_t offset = stripOffset(*image);
+    BasicIo& fileIo = image->io();
+    ASSERT_EQ(0, fileIo.open());
+    fileIo.seek(offset, BasicIo::beg);
+    DataBuf buf = fileIo.read(static_cast<long>(strip.size()));
+    fileIo.close();
+    ASSERT_EQ(static_cast<long>(strip.size()), buf.size_);
+    ASSERT_EQ(0, std::memcmp(buf.pData_, &strip[0], strip.size()));
+    image.reset();
+    std::remove(path.c_str());
+    ::rmdir(dir.c_str());
+}
+#endif
+
+TEST(TiffParser_decode, decodesTheIfdsInParallelInTheSequentialOrder)
+{
+    ExifData exifData;
+    exifData["Exif.Image.Make"] = "Canon";
+    exifData["Exif.Image.Artist"] = "An Artist";
+    exifData["Exif.Image.Copyright"] = "A Copyright";
+    exifData["Exif.Photo.ExposureTime"] = URational(1, 250);
+    exifData["Exif.Photo.UserComment"] = "charset=Ascii A comment";
+    exifData["Exif.Iop.InteroperabilityIndex"] = "R98";
+    exifData["Exif.GPSInfo.GPSLatitudeRef"] = "N";
+    exifData["Exif.Canon.OwnerName"] = "An Owner";
+    exifData["Exif.Canon.FirmwareVersion"] = "Firmware 1.0";
+    exifData["Exif.Thumbnail.ImageWidth"] = uint32_t(8);
+    exifData["Exif.SubImage1.ImageWidth"] = uint32_t(16);
+    MemIo io;
+    TiffParser::encode(io, 0, 0, littleEndian, exifData, IptcData(), XmpData());
+    const DataBuf tiff = io.read(io.size());
+
+    ExifData sequential;
+    IptcData iptcData;
+    XmpData xmpData;
+    TiffParser::decode(sequential, iptcData, xmpData, tiff.pData_, tiff.size_);
+    ExifData parallel;
+    parallel.setParallelDecode(true);
+    TiffParser::decode(parallel, iptcData, xmpData, tiff.pData_, tiff.size_);
+
+    ASSERT_NE(sequential.end(), sequential.findKey(ExifKey("Exif.Canon.OwnerName")));
+    ASSERT_EQ(sequential.count(), parallel.count());
+    ExifData::const_iterator p = parallel.begin();
+    for (ExifData::const_iterator s = sequential.begin(); s != sequential.end(); ++s, ++p) {
+        ASSERT_EQ(s->key(), p->key());
+        ASSERT_EQ(s->idx(), p->idx());
+        ASSERT_EQ(s->toString(), p->toString());
+    }
+    ASSERT_EQ("An Owner", parallel["Exif.Canon.OwnerName"].toString());
+}
+
+TEST(TiffImage_readMetadata, decodesTheIfdsInParallelWhileAllThreadsOfThePoolAreBusy)
+{
+    ExifData exifData;
+    exifData["Exif.Image.Make"] = "Canon";
+    exifData["Exif.Photo.ExposureTime"] = URational(1, 250);
+    exifData["Exif.GPSInfo.GPSLatitudeRef"] = "N";
+    exifData["Exif.Canon.OwnerName"] = "An Owner";
+    MemIo io;
+    TiffParser::encode(io, 0, 0, littleEndian, exifData, IptcData(), XmpData());
+    const DataBuf tiff = io.read(io.size());
+
+    // More asynchronous reads than threads in the pool, each waits for its sub-trees
+    std::vector<Image::UniquePtr> images;
+    std::vector<std::future<void> > reads;
+    for (int i = 0; i < 64; ++i) {
+        images.push_back(ImageFactory::open(tiff.pData_, tiff.size_));
+        images.back()->exifData().setParallelDecode(true);
+        reads.push_back(images.back()->readMetadataAsync());
+    }
+    for (size_t i = 0; i < images.size(); ++i) {
+        reads[i].get();
+        ASSERT_EQ("An Owner", images[i]->exifData()["Exif.Canon.OwnerName"].toString());
+        ASSERT_EQ("N", images[i]->exifData()["Exif.GPSInfo.GPSLatitudeRef"].toString());
+    }
+}
+
+TEST(TiffImage_readMetadata, decodesTheEmbeddedIptcAndXmpOnFirstAccess)
+{
+    Image::UniquePtr image = createTiffWithEmbedded();
+    image->exifData().setLazyEmbedded(true);
+    image->readMetadata();
+    const Image& constImage = *image;
+
+    ASSERT_TRUE(image->exifData().embeddedPending());
+    ASSERT_NE(image->exifData().end(), image->exifData().findKey(ExifKey("Exif.Image.IPTCNAA")));
+    ASSERT_NE(image->exifData().end(), image->exifData().findKey(ExifKey("Exif.Image.XMLPacket")));
+    ASSERT_EQ("A caption", constImage.iptcData().findKey(IptcKey("Iptc.Application2.Caption"))->toString());
+    ASSERT_FALSE(image->exifData().embeddedPending());
+    ASSERT_EQ("A source", image->xmpData()["Xmp.dc.source"].toString());
+}
+
+TEST(TiffImage_readMetadata, decodesTheEmbeddedIptcAndXmpEagerlyByDefault)
+{
+    Image::UniquePtr image = createTiffWithEmbedded();
+    image->readMetadata();
+
+    ASSERT_FALSE(image->exifData().embeddedPending());
+    ASSERT_EQ("A caption", image->iptcData()["Iptc.Application2.Caption"].toString());
+    ASSERT_EQ("A source", image->xmpData()["Xmp.dc.source"].toString());
+}
+
+TEST(TiffImage_writeMetadata, keepsEmbeddedIptcAndXmpWhichWereNotDecoded)
+{
+    Image::UniquePtr image = createTiffWithEmbedded();
+    image->exifData().setLazyEmbedded(true);
+    image->readMetadata();
+    image->exifData()["Exif.Image.Copyright"] = "A Copyright";
+    image->writeMetadata();
+
+    image->readMetadata();
+    ASSERT_EQ("A Copyright", image->exifData()["Exif.Image.Copyright"].toString());
+    ASSERT_EQ("A caption", image->iptcData()["Iptc.Application2.Caption"].toString());
+    ASSERT_EQ("A source", image->xmpData()["Xmp.dc.source"].toString());
+}
+
+TEST(TiffImage_clearIptcData, keepsTheEmbeddedXmpWhichWasNotDecoded)
+{
+    Image::UniquePtr image = createTiffWithEmbedded();
+    image->exifData().setLazyEmbedded(true);
+    image->readMetadata();
+    image->clearIptcData();
+
+    ASSERT_TRUE(image->iptcData().empty());
+    ASSERT_EQ("A source", image->xmpData()["Xmp.dc.source"].toString());
+}
+
+TEST(TiffImage_exifData, keepsThePendingIptcAndXmpWhenTheExifDataIsReplaced)
+{
+    Image::UniquePtr image = createTiffWithEmbedded();
+    image->exifData().setLazyEmbedded(true);
+    image->readMetadata();
+    image->exifData().clear();
+
+    ASSERT_TRUE(image->exifData().embeddedPending());
+    ASSERT_EQ("A caption", image->iptcData()["Iptc.Application2.Caption"].toString());
+
+    image->readMetadata();
+    image->exifData() = ExifData();
+    ASSERT_TRUE(image->exifData().embeddedPending());
+    ASSERT_EQ("A source", image->xmpData()["Xmp.dc.source"].toString());
+}
+
+TEST(BigTiffImage_readMetadata, decodesTheIfdsWithTheTiffParser)
+{
+    Image::UniquePtr image = createBigTiff();
+    ASSERT_EQ(ImageType::bigtiff, image->imageType());
+    ASSERT_EQ(littleEndian, image->byteOrder());
+    ASSERT_EQ(4u, image->pixelWidth());
+
+    ExifData& exifData = image->exifData();
+    ASSERT_EQ("BigCam", exifData["Exif.Image.Make"].toString());
+    ASSERT_EQ("A BigTIFF artist with a long name", exifData["Exif.Image.Artist"].toString());
+    ASSERT_EQ("2020:01:02 03:04:05", exifData["Exif.Photo.DateTimeOriginal"].toString());
+    ASSERT_EQ(unsignedLongLong, exifData["Exif.Image.StripOffsets"].typeId());
+    ASSERT_EQ(tiffIfd8, exifData["Exif.Image.ExifTag"].typeId());
+}
+
+TEST(BigTiffImage_writeMetadata, updatesValuesInPlace)
+{
+    Image::UniquePtr image = createBigTiff();
+    const long size = image->io().size();
+    image->exifData()["Exif.Image.Artist"] = "Short";
+    image->exifData()["Exif.Photo.DateTimeOriginal"] = "2021:02:03 04:05:06";
+    image->writeMetadata();
+    ASSERT_EQ(size, image->io().size());
+
+    image->readMetadata();
+    ASSERT_EQ("Short", image->exifData()["Exif.Image.Artist"].toString());
+    ASSERT_EQ("2021:02:03 04:05:06", image->exifData()["Exif.Photo.DateTimeOriginal"].toString());
+    ASSERT_EQ("BigCam", image->exifData()["Exif.Image.Make"].toString());
+}
+
+TEST(BigTiffImage_writeMetadata, leavesTheImageUnchangedIfTheMetadataDoesNotFit)
+{
+    Image::UniquePtr image = createBigTiff();
+    const DataBuf before = readAll(image->io());
+    image->exifData()["Exif.Photo.DateTimeOriginal"] = "2021:02:03 04:05:06";
+    image->exifData()["Exif.Image.Model"] = "A new tag";
+    ASSERT_THROW(image->writeMetadata(), Error);
+
+    const DataBuf after = readAll(image->io());
+    ASSERT_EQ(before.size_, after.size_);
+    ASSERT_EQ(0, std::memcmp(before.pData_, after.pData_, before.size_));
+}
+
+TEST(TiffImage_writeMetadataTo, writesAModifiedCopyOfTheImage)
+{
+    Image::UniquePtr image = createTiffWithStrip();
+    image->exifData()["Exif.Image.Artist"] = "Another Artist";
+
+    BasicIo::UniquePtr out(new MemIo);
+    image->writeMetadataTo(*out);
+    Image::UniquePtr copy = ImageFactory::open(std::move(out));
+    copy->readMetadata();
+    ASSERT_EQ("Another Artist", copy->exifData()["Exif.Image.Artist"].toString());
+    ASSERT_TRUE(hasStripAt(*copy, stripOffset(*copy)));
+
+    image->readMetadata();
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+}
+
+TEST(TiffImage_pages, decodesEachPageOnAccess)
+{
+    const uint16_t count = 6;
+    std::vector<byte> buf = { 'I', 'I', 42, 0, 8, 0, 0, 0 };
+    for (uint16_t page = 0; page < count; ++page) addPage(buf, page, count);
+    BasicIo::UniquePtr io(new MemIo);
+    io->write(&buf[0], static_cast<long>(buf.size()));
+    TiffImage image(std::move(io), false);
+
+    const std::vector<TiffPage>& pages = image.pages();
+    ASSERT_EQ(count, pages.size());
+    for (uint16_t page = 0; page < count; ++page) {
+        ASSERT_EQ(page, pages[page].index());
+        const ExifData& exifData = pages[page].exifData();
+        ASSERT_EQ(2, exifData.count());
+        ASSERT_EQ(100 + page, exifData.findKey(ExifKey("Exif.Image.ImageWidth"))->toLong());
+        ASSERT_EQ(page, exifData.findKey(ExifKey("Exif.Image.PageNumber"))->toLong(0));
+    }
+    ASSERT_EQ(&pages[3].exifData(), &pages[3].exifData());
+
+    image.readMetadata();
+    ASSERT_EQ(100, image.exifData()["Exif.Image.ImageWidth"].toLong());
+    ASSERT_EQ(count, image.pages().size());
+}
+
+TEST(TiffImage_payloadHash, hashesTheStripsAndIgnoresTheMetadata)
+{
+    Image::UniquePtr image = createTiffWithStrip();
+    ASSERT_FALSE(image->payloadHashDefined());
+    image->hashPayload(true);
+    image->readMetadata();
+    ASSERT_TRUE(image->payloadHashDefined());
+    const uint64_t hash = image->payloadHash();
+
+    // The strip moves when the image is rewritten
+    const uint32_t offset = stripOffset(*image);
+    image->exifData()["Exif.Image.ImageDescription"] = "A description which does not fit in place";
+    image->writeMetadata();
+    image->readMetadata();
+    ASSERT_NE(offset, stripOffset(*image));
+    ASSERT_EQ(hash, image->payloadHash());
+}
+
+namespace
+{
+    //! Read the metadata of \em image with \em limits, return the error code
+    int readWithLimits(Image& image, const ParseLimits& limits)
+    {
+        image.io().setParseLimits(limits);
+        try {
+            image.readMetadata();
+        } catch (const Error& e) {
+            return e.code();
+        }
+        return 0;
+    }
+}
+
+TEST(TiffImage_parseLimits, limitTheEntriesOfAnIfd)
+{
+    Image::UniquePtr image = createTiffWithStrip();
+    ParseLimits limits;
+    limits.maxIfdEntries_ = 5;
+    ASSERT_EQ(kerResourceLimitExceeded, readWithLimits(*image, limits));
+    limits.maxIfdEntries_ = 6;
+    ASSERT_EQ(0, readWithLimits(*image, limits));
+    ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+}
+
+TEST(TiffImage_parseLimits, limitTheNestingDepthOfTheIfds)
+{
+    Image::UniquePtr image = createTiffWithStrip();
+    image->exifData()["Exif.Photo.DateTimeOriginal"] = "2020:01:01 00:00:00";
+    image->writeMetadata();
+    ParseLimits limits;
+    limits.maxDepth_ = 1;
+    ASSERT_EQ(kerResourceLimitExceeded, readWithLimits(*image, limits));
+    limits.maxDepth_ = 2;
+    ASSERT_EQ(0, readWithLimits(*image, limits));
+    ASSERT_EQ("2020:01:01 00:00:00", image->exifData()["Exif.Photo.DateTimeOriginal"].toString());
+}
+
+TEST(TiffImage_parseLimits, limitTheAllocatedBytes)
+{
+    Image::UniquePtr image = createTiffWithStrip();
+    ParseLimits limits;
+    limits.maxAllocation_ = 16;
+    ASSERT_EQ(kerResourceLimitExceeded, readWithLimits(*image, limits));
+    ASSERT_EQ(0, readWithLimits(*image, ParseLimits()));
+}
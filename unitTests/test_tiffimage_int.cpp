@@ -0,0 +1,114 @@
+// File under test
+#include <tiffimage_int.hpp>
+
+// Auxiliary headers
+#include <rw2image_int.hpp>
+#include <tiffcomposite_int.hpp>
+#include <tiffvisitor_int.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+using namespace Exiv2::Internal;
+
+namespace
+{
+    //! MemIo which records the ranges it is asked to prefetch
+    class PrefetchRecorder : public MemIo {
+    public:
+        void prefetch(const std::vector<std::pair<long, long> >& ranges) override
+        {
+            ranges_.insert(ranges_.end(), ranges.begin(), ranges.end());
+        }
+        bool wasPrefetched(long offset, long size) const
+        {
+            return std::find(ranges_.begin(), ranges_.end(), std::make_pair(offset, size)) != ranges_.end();
+        }
+        std::vector<std::pair<long, long> > ranges_;
+    };
+
+    void addEntry(std::vector<byte>& buf, uint16_t tag, uint16_t type, uint32_t count, uint32_t value)
+    {
+        byte entry[12];
+        us2Data(entry, tag, littleEndian);
+        us2Data(entry + 2, type, littleEndian);
+        ul2Data(entry + 4, count, littleEndian);
+        ul2Data(entry + 8, value, littleEndian);
+        buf.insert(buf.end(), entry, entry + sizeof(entry));
+    }
+
+    //! Write an RW2 file with a Make tag and a large preview image to \em io
+    void createRw2(BasicIo& io, uint32_t previewSize)
+    {
+        const byte header[] = {'I', 'I', 0x55, 0x00, 0x18, 0x00, 0x00, 0x00};
+        std::vector<byte> buf(header, header + sizeof(header));
+        buf.resize(24);
+        byte count[2];
+        us2Data(count, 2, littleEndian);
+        buf.insert(buf.end(), count, count + 2);
+        addEntry(buf, 0x002e, undefined, previewSize, 100);
+        addEntry(buf, 0x010f, asciiString, 10, 80);
+        buf.resize(100 + previewSize);
+        io.write(&buf[0], static_cast<long>(buf.size()));
+    }
+}
+
+TEST(TiffParserWorker_prefetch, fetchesTheDataTagOfTheRootDirectoryRegardlessOfItsSize)
+{
+    const uint32_t previewSize = 2 * 1024 * 1024;
+    PrefetchRecorder io;
+    createRw2(io, previewSize);
+
+    Rw2Header rw2Header;
+    TiffParserWorker::prefetch(io, &rw2Header, 0x002e);
+    ASSERT_TRUE(io.wasPrefetched(24, 2 + 32 * 12 + 4));
+    ASSERT_TRUE(io.wasPrefetched(80, 10));
+    ASSERT_TRUE(io.wasPrefetched(100, previewSize));
+}
+
+TEST(TiffParserWorker_prefetch, skipsImageDataWithoutADataTag)
+{
+    const uint32_t previewSize = 2 * 1024 * 1024;
+    PrefetchRecorder io;
+    createRw2(io, previewSize);
+
+    Rw2Header rw2Header;
+    TiffParserWorker::prefetch(io, &rw2Header);
+    ASSERT_TRUE(io.wasPrefetched(80, 10));
+    ASSERT_FALSE(io.wasPrefetched(100, previewSize));
+}
+
+TEST(TiffIndex, findsTheFirstComponentAddedAndTheModel)
+{
+    TiffDirectory root(0, ifd0Id);
+    TiffComponent* model = root.addChild(TiffComponent::UniquePtr(new TiffEntry(0x0110, ifd0Id)));
+    TiffComponent* other = root.addChild(TiffComponent::UniquePtr(new TiffEntry(0x0110, ifd0Id)));
+    Value::UniquePtr value = Value::create(asciiString);
+    value->read("A Camera");
+    dynamic_cast<TiffEntryBase*>(model)->setValue(std::move(value));
+
+    TiffIndex index(&root);
+    index.add(model);
+    index.add(other);
+    ASSERT_EQ(model, index.find(0x0110, ifd0Id));
+    ASSERT_EQ(nullptr, index.find(0x010f, ifd0Id));
+    ASSERT_EQ("A Camera", index.model());
+}
+
+TEST(TiffIndex, isUsedOnlyForItsOwnCompositeWhileItIsCurrent)
+{
+    TiffDirectory root(0, ifd0Id);
+    TiffComponent* make = root.addChild(TiffComponent::UniquePtr(new TiffEntry(0x010f, ifd0Id)));
+    TiffIndex index(&root);
+
+    // the index is empty, so only a search of the composite finds the entry
+    ASSERT_EQ(make, TiffIndex::findIn(&root, 0x010f, ifd0Id));
+    ASSERT_EQ(nullptr, TiffIndex::setCurrent(&index));
+    ASSERT_EQ(nullptr, TiffIndex::findIn(&root, 0x010f, ifd0Id));
+    TiffDirectory otherRoot(0, ifd0Id);
+    ASSERT_EQ(nullptr, TiffIndex::findIn(&otherRoot, 0x010f, ifd0Id));
+    ASSERT_EQ(&index, TiffIndex::setCurrent(nullptr));
+}
@@ -1,7 +1,14 @@
 #include <exiv2/types.hpp>
+#include <exiv2/value.hpp>
 
 #include <cmath>
+#include <cstring>
+#include <iomanip>
 #include <limits>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <utility>
 
 #include "gtestwrapper.h"
 
@@ -41,6 +48,158 @@ TEST(DataBuf, allocatesDataWithNonEmptyConstructor)
     ASSERT_EQ(5,    instance.size_);
 }
 
+TEST(DataBuf, reusesPooledBuffersOfASimilarSize)
+{
+    byte* first = 0;
+    {
+        DataBuf buf = DataBuf::pooled(1000);
+        ASSERT_EQ(1000, buf.size_);
+        first = buf.pData_;
+    }
+    DataBuf buf = DataBuf::pooled(900);
+    ASSERT_EQ(first, buf.pData_);
+    ASSERT_EQ(900, buf.size_);
+
+    // Growing within the pooled buffer keeps the memory
+    buf.alloc(1024);
+    ASSERT_EQ(first, buf.pData_);
+    ASSERT_EQ(1024, buf.size_);
+}
+
+TEST(DataBuf, movesPooledBuffers)
+{
+    DataBuf buf = DataBuf::pooled(100);
+    byte* data = buf.pData_;
+    DataBuf moved(std::move(buf));
+    ASSERT_EQ(nullptr, buf.pData_);
+    ASSERT_EQ(0, buf.size_);
+    ASSERT_EQ(data, moved.pData_);
+    ASSERT_EQ(100, moved.size_);
+
+    DataBuf assigned;
+    assigned = std::move(moved);
+    ASSERT_EQ(data, assigned.pData_);
+    ASSERT_EQ(nullptr, moved.pData_);
+}
+
+TEST(DataBuf, releasesPooledBuffersToTheCaller)
+{
+    DataBuf buf = DataBuf::pooled(100);
+    std::pair<byte*, long> p = buf.release();
+    ASSERT_EQ(nullptr, buf.pData_);
+    ASSERT_EQ(100, p.second);
+    delete[] p.first;
+}
+
+TEST(DataBuf, allocatesLargeBuffersOutsideThePool)
+{
+    DataBuf buf = DataBuf::pooled(1024 * 1024);
+    ASSERT_EQ(1024 * 1024, buf.size_);
+    buf.pData_[buf.size_ - 1] = 1;
+}
+
+TEST(SharedBuf, isEmptyByDefault)
+{
+    SharedBuf buf;
+    ASSERT_TRUE(buf.empty());
+    ASSERT_EQ(nullptr, buf.data());
+    ASSERT_EQ(0, buf.useCount());
+}
+
+TEST(SharedBuf, takesOverADataBufWithoutACopy)
+{
+    DataBuf data(16);
+    data.pData_[15] = 7;
+    const byte* bytes = data.pData_;
+    SharedBuf buf(std::move(data));
+    ASSERT_EQ(nullptr, data.pData_);
+    ASSERT_EQ(bytes, buf.data());
+    ASSERT_EQ(16u, buf.size());
+    ASSERT_EQ(7, buf.data()[15]);
+}
+
+TEST(SharedBuf, sharesTheBytesWithCopiesAndSlices)
+{
+    const byte bytes[] = { 1, 2, 3, 4, 5 };
+    SharedBuf buf(bytes, sizeof(bytes));
+    ASSERT_NE(bytes, buf.data());
+    SharedBuf copy = buf;
+    SharedBuf slice = buf.slice(1, 3);
+    ASSERT_EQ(3, buf.useCount());
+    ASSERT_EQ(buf.data(), copy.data());
+    ASSERT_EQ(buf.data() + 1, slice.data());
+    ASSERT_EQ(3u, slice.size());
+    ASSERT_EQ(4, slice.data()[2]);
+
+    // The bytes outlive the buffer they were read into
+    buf = SharedBuf();
+    copy = SharedBuf();
+    ASSERT_EQ(1, slice.useCount());
+    const DataBuf data = slice.copy();
+    ASSERT_EQ(3, data.size_);
+    ASSERT_EQ(0, std::memcmp(bytes + 1, data.pData_, 3));
+}
+
+TEST(SharedBuf, throwsOnASliceOutOfRange)
+{
+    Blob blob(8, 0);
+    SharedBuf buf(std::move(blob));
+    ASSERT_EQ(8u, buf.size());
+    ASSERT_TRUE(buf.slice(8, 0).empty());
+    ASSERT_THROW(buf.slice(4, 5), std::out_of_range);
+    ASSERT_THROW(buf.slice(9, 0), std::out_of_range);
+}
+
+TEST(getUShortArray, readsLikeGetUShort)
+{
+    const byte buf[] = {0x01, 0x02, 0x03, 0x04, 0xfe, 0xff};
+    uint16_t values[3];
+    getUShortArray(values, buf, 3, littleEndian);
+    for (int i = 0; i < 3; ++i) ASSERT_EQ(getUShort(buf + 2 * i, littleEndian), values[i]);
+    getUShortArray(values, buf, 3, bigEndian);
+    for (int i = 0; i < 3; ++i) ASSERT_EQ(getUShort(buf + 2 * i, bigEndian), values[i]);
+    ASSERT_EQ(0xfeff, values[2]);
+}
+
+TEST(getULongArray, readsLikeGetULong)
+{
+    const byte buf[] = {0x01, 0x02, 0x03, 0x04, 0xfc, 0xfd, 0xfe, 0xff};
+    uint32_t values[2];
+    getULongArray(values, buf, 2, littleEndian);
+    for (int i = 0; i < 2; ++i) ASSERT_EQ(getULong(buf + 4 * i, littleEndian), values[i]);
+    getULongArray(values, buf, 2, bigEndian);
+    for (int i = 0; i < 2; ++i) ASSERT_EQ(getULong(buf + 4 * i, bigEndian), values[i]);
+    ASSERT_EQ(0x01020304u, values[0]);
+}
+
+TEST(us2DataArray, writesLikeUs2Data)
+{
+    const uint16_t values[] = {0x0102, 0xfeff};
+    byte buf[4];
+    byte expected[4];
+    for (int bo = 0; bo < 2; ++bo) {
+        const ByteOrder byteOrder = bo == 0 ? littleEndian : bigEndian;
+        ASSERT_EQ(4, us2DataArray(buf, values, 2, byteOrder));
+        us2Data(expected, values[0], byteOrder);
+        us2Data(expected + 2, values[1], byteOrder);
+        ASSERT_EQ(0, std::memcmp(expected, buf, sizeof(buf)));
+    }
+}
+
+TEST(ul2DataArray, writesLikeUl2Data)
+{
+    const uint32_t values[] = {0x01020304, 0xfcfdfeff};
+    byte buf[8];
+    byte expected[8];
+    for (int bo = 0; bo < 2; ++bo) {
+        const ByteOrder byteOrder = bo == 0 ? littleEndian : bigEndian;
+        ASSERT_EQ(8, ul2DataArray(buf, values, 2, byteOrder));
+        ul2Data(expected, values[0], byteOrder);
+        ul2Data(expected + 4, values[1], byteOrder);
+        ASSERT_EQ(0, std::memcmp(expected, buf, sizeof(buf)));
+    }
+}
+
 TEST(Rational, floatToRationalCast)
 {
     static const float floats[] = {0.5f, 0.015f, 0.0000625f};
@@ -59,3 +218,184 @@ TEST(Rational, floatToRationalCast)
     ASSERT_EQ(minus_inf.first, -1);
     ASSERT_EQ(minus_inf.second, 0);
 }
+
+TEST(Rational, floatToRationalCastKeepsTheDecimalValue)
+{
+    ASSERT_EQ(floatToRationalCast(0.5f), Rational(1, 2));
+    ASSERT_EQ(floatToRationalCast(-0.25f), Rational(-1, 4));
+    ASSERT_EQ(floatToRationalCast(1.49999f), Rational(149999, 100000));
+    ASSERT_EQ(floatToRationalCast(-1.49999f), Rational(-149999, 100000));
+    ASSERT_EQ(floatToRationalCast(29.734512f), Rational(1858407, 62500));
+    // Without a short decimal, a convergent of the continued fraction is used
+    ASSERT_EQ(floatToRationalCast(1.0f / 3000000.0f), Rational(1, 3000000));
+    ASSERT_EQ(floatToRationalCast(0.0f), Rational(0, 1));
+    ASSERT_EQ(floatToRationalCast(2.8f), Rational(14, 5));
+    ASSERT_EQ(floatToRationalCast(3.0e7f), Rational(30000000, 1));
+    ASSERT_EQ(floatToRationalCast(-1.0e10f), Rational(-2147483647, 1));
+}
+
+TEST(StringWriter, appendsToTheBuffer)
+{
+    std::string buf("Value: ");
+    {
+        StringWriter writer(buf);
+        writer.stream() << 42 << ' ' << "units";
+    }
+    ASSERT_EQ("Value: 42 units", buf);
+}
+
+TEST(StringWriter, canBeNested)
+{
+    std::string outer;
+    std::string inner;
+    StringWriter outerWriter(outer);
+    outerWriter.stream() << "outer";
+    {
+        StringWriter innerWriter(inner);
+        innerWriter.stream() << "inner";
+    }
+    outerWriter.stream() << " " << inner;
+    ASSERT_EQ("outer inner", outer);
+    ASSERT_EQ("inner", inner);
+}
+
+TEST(StringWriter, startsWithTheDefaultFormat)
+{
+    std::string buf;
+    {
+        StringWriter writer(buf);
+        writer.stream() << std::hex << std::setprecision(2) << std::setfill('0') << std::fixed;
+    }
+    buf.clear();
+    StringWriter writer(buf);
+    writer.stream() << 255 << " " << 1.2345678 << " " << std::setw(3) << 7;
+    ASSERT_EQ("255 1.23457   7", buf);
+    ASSERT_EQ("1.5", toString(1.5));
+}
+
+namespace
+{
+    //! Decimal comma and thousands grouping, like many locales
+    struct CommaNumpunct : std::numpunct<char> {
+        char do_decimal_point() const override { return ','; }
+        char do_thousands_sep() const override { return '.'; }
+        std::string do_grouping() const override { return "\3"; }
+    };
+
+    template<typename T>
+    std::string classic(const T& value)
+    {
+        std::ostringstream os;
+        os.imbue(std::locale::classic());
+        os << value;
+        return os.str();
+    }
+}
+
+TEST(Number, printsLikeTheClassicLocale)
+{
+    std::ostringstream os;
+    os.imbue(std::locale(std::locale::classic(), new CommaNumpunct));
+    os << Number(1234567) << " " << Number(-42) << " " << Number(std::numeric_limits<long long>::min())
+       << " " << Number(std::numeric_limits<uint64_t>::max()) << " " << Number(1234.5) << " "
+       << Number(Rational(-3, 10)) << " " << Number(URational(1, 100));
+    ASSERT_EQ("1234567 -42 " + classic(std::numeric_limits<long long>::min()) + " "
+              + classic(std::numeric_limits<uint64_t>::max()) + " 1234.5 -3/10 1/100", os.str());
+
+    const double values[] = { 0.0, -0.0, 3.0, -100.0, 1e17, 1.0 / 3, 1e-7, 123456789.125, 1e300, -2.5e-300 };
+    for (auto value : values) {
+        for (int precision = 0; precision < 18; ++precision) {
+            std::ostringstream expected;
+            expected.imbue(std::locale::classic());
+            expected << std::setprecision(precision) << value << " " << std::fixed << value;
+            std::ostringstream actual;
+            actual.imbue(std::locale(std::locale::classic(), new CommaNumpunct));
+            actual << std::setprecision(precision) << Number(value) << " " << Number::fixed(value, precision);
+            ASSERT_EQ(expected.str(), actual.str());
+        }
+    }
+}
+
+TEST(Number, honoursTheWidthFillAndAdjustmentOfTheStream)
+{
+    std::ostringstream os;
+    os << std::setw(5) << std::setfill('0') << Number(42) << "|" << Number(7) << "|"
+       << std::left << std::setw(4) << std::setfill('*') << Number(-1) << "|"
+       << std::internal << std::setw(6) << Number::fixed(-1.5, 2) << "|"
+       << std::right << std::setw(6) << Number(URational(1, 2));
+    ASSERT_EQ("00042|7|-1**|-*1.50|*****1/2", os.str());
+    // The format state of the stream is unchanged
+    ASSERT_EQ(6, os.precision());
+    ASSERT_EQ(0, os.flags() & std::ios_base::floatfield);
+}
+
+TEST(Number, printsOtherFormatsWithTheStream)
+{
+    std::ostringstream os;
+    os << std::hex << Number(255) << " " << Number(static_cast<int16_t>(-1)) << " "
+       << std::showpos << std::dec << Number(3) << " " << std::noshowpos << std::scientific << Number(1500.0);
+    ASSERT_EQ("ff ffff +3 1.500000e+03", os.str());
+}
+
+TEST(Number, formatsTheValuesOfValueTypes)
+{
+    ValueType<double> doubles;
+    doubles.value_.push_back(0.1);
+    doubles.value_.push_back(-12345.678);
+    ASSERT_EQ("0.1 -12345.678", static_cast<const Value&>(doubles).toString());
+    ValueType<float> floats(0.1f, tiffFloat);
+    ASSERT_EQ("0.100000001490116", static_cast<const Value&>(floats).toString());
+    ASSERT_EQ("0.1", floats.toString(0));
+    URationalValue rationals;
+    rationals.read("1/100 3/2");
+    ASSERT_EQ("1/100 3/2", static_cast<const Value&>(rationals).toString());
+    ASSERT_EQ("3/2", rationals.toString(1));
+    DataValue data(undefined);
+    data.read("1 255 3");
+    ASSERT_EQ("1 255 3", static_cast<const Value&>(data).toString());
+    ASSERT_EQ("255", data.toString(1));
+}
+
+TEST(TypeInfo, sizesTheTiffTypesLikeTheTable)
+{
+    ASSERT_EQ(0, TypeInfo::typeSize(invalidTypeId));
+    ASSERT_EQ(2, TypeInfo::typeSize(unsignedShort));
+    ASSERT_EQ(8, TypeInfo::typeSize(signedRational));
+    ASSERT_EQ(4, TypeInfo::typeSize(tiffIfd));
+    ASSERT_EQ(8, TypeInfo::typeSize(tiffIfd8));
+    ASSERT_EQ(11, TypeInfo::typeSize(Exiv2::time));
+    ASSERT_EQ(0, TypeInfo::typeSize(static_cast<TypeId>(0x7fff)));
+}
+
+TEST(Value, createsAndReadsLikeCreateThenRead)
+{
+    const byte buf[] = {0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03};
+    const TypeId types[] = {unsignedByte, asciiString, unsignedShort, unsignedLong, unsignedRational,
+                            undefined, signedShort, tiffIfd, tiffDouble, unsignedLongLong, comment};
+    for (auto typeId : types) {
+        Value::UniquePtr expected = Value::create(typeId);
+        expected->read(buf, sizeof(buf), bigEndian);
+        Value::UniquePtr value = Value::create(typeId, buf, sizeof(buf), bigEndian);
+        ASSERT_EQ(expected->typeId(), value->typeId());
+        ASSERT_EQ(expected->count(), value->count());
+        ASSERT_EQ(expected->toString(), value->toString());
+    }
+}
+
+TEST(hexdump, formatsLinesOfSixteenBytes)
+{
+    byte buf[20];
+    for (int i = 0; i < 20; ++i) buf[i] = static_cast<byte>(0x3e + i);
+    buf[0] = 0x00;
+    buf[1] = 0x1e;
+    std::ostringstream os;
+    os << std::setw(3) << std::setfill('*');
+    hexdump(os, buf, sizeof(buf), 0xfff8);
+    ASSERT_EQ("  fff8  00 1e 40 41 42 43 44 45 46 47 48 49 4a 4b 4c 4d  ..@ABCDEFGHIJKLM\n"
+              "  10008  4e 4f 50 51                                      NOPQ\n",
+              os.str());
+    // The format of the stream is left as is
+    os.str("");
+    os << 10;
+    ASSERT_EQ("*10", os.str());
+}
@@ -0,0 +1,126 @@
+// File under test
+#include <exiv2/webpimage.hpp>
+
+// Auxiliary headers
+#include <exiv2/basicio.hpp>
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/xmp_exiv2.hpp>
+
+#include <string>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    std::string chunk(const std::string& id, const std::string& payload)
+    {
+        byte size[4];
+        ul2Data(size, static_cast<uint32_t>(payload.size()), littleEndian);
+        std::string result = id + std::string(reinterpret_cast<const char*>(size), 4) + payload;
+        if (payload.size() % 2) result += '\0';
+        return result;
+    }
+
+    std::string riff(const std::string& chunks)
+    {
+        byte size[4];
+        ul2Data(size, static_cast<uint32_t>(chunks.size() + 4), littleEndian);
+        return "RIFF" + std::string(reinterpret_cast<const char*>(size), 4) + "WEBP" + chunks;
+    }
+
+    //! VP8X chunk with the feature flags \em flags and a 1x1 canvas
+    std::string vp8x(char flags)
+    {
+        return chunk("VP8X", std::string(1, flags) + std::string(9, '\0'));
+    }
+
+    std::string contents(BasicIo& io)
+    {
+        return std::string(reinterpret_cast<const char*>(io.mmap()), io.size());
+    }
+}
+
+TEST(WebPImage_stripMetadataTo, dropsTheMetadataChunksAndFixesTheHeaders)
+{
+    const std::string iccp = chunk("ICCP", "icc");
+    const std::string vp8l = chunk("VP8L", std::string("\x2f\0\0\0\0", 5));
+    const std::string webp = riff(vp8x(0x2c) + iccp + vp8l + chunk("EXIF", "exif") + chunk("XMP ", "<xmp>"));
+    Image::UniquePtr image = ImageFactory::open(reinterpret_cast<const byte*>(webp.data()),
+                                                static_cast<long>(webp.size()));
+    ASSERT_EQ(ImageType::webp, image->imageType());
+
+    MemIo out;
+    image->stripMetadataTo(out);
+    ASSERT_EQ(riff(vp8x(0) + vp8l), contents(out));
+    ASSERT_EQ(webp, contents(image->io()));
+
+    MemIo outWithIcc;
+    image->stripMetadataTo(outWithIcc, mdIccProfile);
+    ASSERT_EQ(riff(vp8x(0x20) + iccp + vp8l), contents(outWithIcc));
+}
+
+TEST(WebPImage_stripMetadataTo, rejectsChunksBeyondTheEndOfTheFile)
+{
+    std::string webp = riff(vp8x(0x08) + chunk("EXIF", "exif"));
+    webp[webp.size() - 8] = 0x40; // EXIF chunk size
+    Image::UniquePtr image = ImageFactory::open(reinterpret_cast<const byte*>(webp.data()),
+                                                static_cast<long>(webp.size()));
+    MemIo out;
+    ASSERT_THROW(image->stripMetadataTo(out), Error);
+}
+
+TEST(WebPImage_payloadHash, hashesTheImageChunksOnly)
+{
+    const std::string vp8l = chunk("VP8L", std::string("\x2f\0\0\0\0", 5));
+    const std::string alph = chunk("ALPH", "alpha");
+    const std::string webp = riff(vp8x(0x34) + chunk("ICCP", "icc") + alph + vp8l + chunk("XMP ", "<xmp>"));
+    Image::UniquePtr image = ImageFactory::open(reinterpret_cast<const byte*>(webp.data()),
+                                                static_cast<long>(webp.size()));
+    image->hashPayload(true);
+    MemIo out;
+    image->stripMetadataTo(out);
+    ASSERT_TRUE(image->payloadHashDefined());
+    const uint64_t hash = image->payloadHash();
+
+    const std::string plain = riff(alph + vp8l);
+    Image::UniquePtr other = ImageFactory::open(reinterpret_cast<const byte*>(plain.data()),
+                                                static_cast<long>(plain.size()));
+    other->hashPayload(true);
+    other->readMetadata();
+    ASSERT_EQ(hash, other->payloadHash());
+
+    const std::string changed = riff(chunk("ALPH", "alphb") + vp8l);
+    other = ImageFactory::open(reinterpret_cast<const byte*>(changed.data()), static_cast<long>(changed.size()));
+    other->hashPayload(true);
+    other->readMetadata();
+    ASSERT_NE(hash, other->payloadHash());
+}
+
+TEST(WebPImage_parallelDecode, readsTheSameMetadataAsTheSerialDecode)
+{
+    ExifData exifData;
+    exifData["Exif.Image.Artist"] = "An Artist";
+    Blob tiff;
+    ExifParser::encode(tiff, 0, 0, bigEndian, exifData);
+    XmpData xmpData;
+    xmpData["Xmp.dc.source"] = "A source";
+    std::string xmpPacket;
+    ASSERT_EQ(0, XmpParser::encode(xmpPacket, xmpData));
+
+    const std::string vp8l = chunk("VP8L", std::string("\x2f\0\0\0\0", 5));
+    const std::string webp = riff(vp8x(0x0c) + vp8l
+                                  + chunk("EXIF", std::string(reinterpret_cast<const char*>(&tiff[0]), tiff.size()))
+                                  + chunk("XMP ", xmpPacket));
+    for (int parallel = 0; parallel < 2; ++parallel) {
+        Image::UniquePtr image = ImageFactory::open(reinterpret_cast<const byte*>(webp.data()),
+                                                    static_cast<long>(webp.size()));
+        image->parallelDecode(parallel != 0);
+        image->readMetadata();
+        ASSERT_EQ("An Artist", image->exifData()["Exif.Image.Artist"].toString());
+        ASSERT_EQ(bigEndian, image->byteOrder());
+        ASSERT_EQ("A source", image->xmpData()["Xmp.dc.source"].toString());
+    }
+}
@@ -0,0 +1,139 @@
+#include "gtestwrapper.h"
+
+#include <xmpscanner_int.hpp>
+
+#include <exiv2/properties.hpp>
+#include <exiv2/xmp_exiv2.hpp>
+
+#include <set>
+#include <sstream>
+#include <string>
+
+using namespace Exiv2;
+using namespace Exiv2::Internal;
+
+namespace
+{
+    bool noAlias(const std::string&, const std::string&)
+    {
+        return false;
+    }
+
+    bool everythingIsAlias(const std::string&, const std::string&)
+    {
+        return true;
+    }
+
+    std::string packet(const std::string& description)
+    {
+        return "<?xpacket begin=\"\xef\xbb\xbf\" id=\"W5M0MpCehiHzreSzNTczkc9d\"?>"
+               "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\">"
+               "<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">"
+               "<rdf:Description rdf:about=\"\""
+               " xmlns:dc=\"http://purl.org/dc/elements/1.1/\""
+               " xmlns:xmp=\"http://ns.adobe.com/xap/1.0/\"" +
+               description +
+               "</rdf:Description></rdf:RDF></x:xmpmeta><?xpacket end=\"w\"?>";
+    }
+
+    std::string dump(const XmpData& xmpData)
+    {
+        std::ostringstream os;
+        for (XmpData::const_iterator i = xmpData.begin(); i != xmpData.end(); ++i) {
+            os << i->key() << " " << i->typeName() << " " << i->count() << " " << i->value() << "\n";
+        }
+        return os.str();
+    }
+
+    // Decode the properties \em keys of \em xmpPacket with the XMP Toolkit
+    std::string decodeWithToolkit(const std::string& xmpPacket, const std::set<std::string>& keys)
+    {
+        XmpData all;
+        EXPECT_EQ(0, XmpParser::decode(all, xmpPacket));
+        XmpData selected;
+        for (XmpData::const_iterator i = all.begin(); i != all.end(); ++i) {
+            if (keys.count(i->key()) > 0) selected.add(*i);
+        }
+        return dump(selected);
+    }
+
+    const std::set<std::string> keys = {"Xmp.xmp.Rating", "Xmp.dc.subject", "Xmp.dc.title", "Xmp.xmp.Identifier"};
+}
+
+TEST(scanXmpPacket, decodesSimplePropertiesArraysAndLanguageAlternatives)
+{
+    ASSERT_TRUE(XmpParser::initialize());
+    const std::string xmpPacket = packet(
+        " xmp:Rating=\"3\">"
+        "<dc:format>image/jpeg</dc:format>"
+        "<dc:subject><rdf:Bag><rdf:li>one</rdf:li><rdf:li>two &amp; three</rdf:li></rdf:Bag></dc:subject>"
+        "<dc:title><rdf:Alt>"
+        "<rdf:li xml:lang=\"x-default\">Title</rdf:li><rdf:li xml:lang=\"DE-ch\">Titel</rdf:li>"
+        "</rdf:Alt></dc:title>"
+        "<xmp:Identifier><rdf:Bag><rdf:li>id1</rdf:li></rdf:Bag></xmp:Identifier>");
+
+    XmpData xmpData;
+    ASSERT_TRUE(scanXmpPacket(xmpData, xmpPacket, keys, noAlias));
+    ASSERT_EQ(4, xmpData.count());
+    ASSERT_EQ("3", xmpData["Xmp.xmp.Rating"].toString());
+    ASSERT_EQ(2, xmpData["Xmp.dc.subject"].count());
+    ASSERT_EQ("two & three", xmpData["Xmp.dc.subject"].toString(1));
+    ASSERT_EQ(dump(xmpData), decodeWithToolkit(xmpPacket, keys));
+}
+
+TEST(scanXmpPacket, skipsPropertiesWhichAreNotRequested)
+{
+    ASSERT_TRUE(XmpParser::initialize());
+    const std::string xmpPacket = packet(
+        " xmp:Label=\"red\">"
+        "<xmp:Thumbnails><rdf:Alt><rdf:li rdf:parseType=\"Resource\">"
+        "<xmpGImg:format xmlns:xmpGImg=\"http://ns.adobe.com/xap/1.0/g/img/\">JPEG</xmpGImg:format>"
+        "</rdf:li></rdf:Alt></xmp:Thumbnails>");
+
+    XmpData xmpData;
+    ASSERT_TRUE(scanXmpPacket(xmpData, xmpPacket, keys, noAlias));
+    ASSERT_EQ(0, xmpData.count());
+}
+
+TEST(scanXmpPacket, givesUpOnWhatTheToolkitNormalizes)
+{
+    ASSERT_TRUE(XmpParser::initialize());
+    const char* descriptions[] = {
+        // Simple dc:subject becomes a bag
+        "><dc:subject>one</dc:subject>",
+        // Structures and qualifiers
+        "><dc:title rdf:parseType=\"Resource\"><xmp:Rating>1</xmp:Rating></dc:title>",
+        "><xmp:Rating><rdf:Description><rdf:value>1</rdf:value></rdf:Description></xmp:Rating>",
+        // Duplicate properties
+        " xmp:Rating=\"1\"><xmp:Rating>2</xmp:Rating>",
+        // Invalid UTF-8 and control characters
+        " xmp:Rating=\"\xe9\">",
+        " xmp:Rating=\"&#1;\">",
+    };
+    for (size_t i = 0; i < sizeof(descriptions) / sizeof(descriptions[0]); ++i) {
+        XmpData xmpData;
+        EXPECT_FALSE(scanXmpPacket(xmpData, packet(descriptions[i]), keys, noAlias)) << descriptions[i];
+        EXPECT_EQ(0, xmpData.count());
+    }
+
+    XmpData xmpData;
+    ASSERT_FALSE(scanXmpPacket(xmpData, packet(" xmp:Rating=\"1\">"), keys, everythingIsAlias));
+}
+
+TEST(scanXmpPacket, isUsedByDecodeForTopLevelKeys)
+{
+    const std::string xmpPacket = packet(
+        " xmp:Rating=\"5\">"
+        "<dc:subject><rdf:Bag><rdf:li>one</rdf:li></rdf:Bag></dc:subject>"
+        "<dc:creator><rdf:Seq><rdf:li>someone</rdf:li></rdf:Seq></dc:creator>");
+
+    DecodeFilter filter;
+    filter.addKey("Xmp.xmp.Rating").addKey("Xmp.dc.subject");
+    XmpData xmpData;
+    xmpData.setDecodeFilter(filter);
+    ASSERT_EQ(0, XmpParser::decode(xmpData, xmpPacket));
+    ASSERT_EQ(2, xmpData.count());
+    ASSERT_EQ("5", xmpData["Xmp.xmp.Rating"].toString());
+    ASSERT_EQ("one", xmpData["Xmp.dc.subject"].toString());
+    ASSERT_EQ(xmpPacket, xmpData.xmpPacket());
+}
@@ -0,0 +1,89 @@
+// File under test
+#include <exiv2/xmpsidecar.hpp>
+
+// Auxiliary headers
+#include <exiv2/basicio.hpp>
+#include <exiv2/futils.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/xmp_exiv2.hpp>
+
+#include <cstdio>
+#include <string>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "gtestwrapper.h"
+
+using namespace Exiv2;
+
+namespace
+{
+    ino_t inodeOf(const std::string& path)
+    {
+        struct stat buf;
+        return ::stat(path.c_str(), &buf) == 0 ? buf.st_ino : 0;
+    }
+
+    //! Create the sidecar \em path with one property and return it, read
+    Image::UniquePtr createSidecar(const std::string& path)
+    {
+        Image::UniquePtr image = ImageFactory::create(ImageType::xmp, path);
+        image->xmpData()["Xmp.dc.source"] = "A source";
+        image->writeMetadata();
+        image = ImageFactory::open(path);
+        image->readMetadata();
+        return image;
+    }
+}
+
+TEST(XmpSidecar_writeMetadata, leavesAnUnchangedFileAlone)
+{
+    const std::string path("tmp_unchanged.xmp");
+    Image::UniquePtr image = createSidecar(path);
+    const ino_t inode = inodeOf(path);
+
+    image->writeMetadata();
+    ASSERT_EQ(0u, image->io().stats().bytesWritten_);
+    ASSERT_EQ(inode, inodeOf(path));
+    std::remove(path.c_str());
+}
+
+TEST(XmpSidecar_writeMetadata, replacesAChangedFileWithARename)
+{
+    const std::string path("tmp_changed.xmp");
+    Image::UniquePtr image = createSidecar(path);
+    const ino_t inode = inodeOf(path);
+
+    image->xmpData()["Xmp.dc.source"] = "Another source";
+    image->writeMetadata();
+    ASSERT_NE(inode, inodeOf(path));
+
+    image = ImageFactory::open(path);
+    image->readMetadata();
+    ASSERT_EQ("Another source", image->xmpData()["Xmp.dc.source"].toString());
+    std::remove(path.c_str());
+}
+
+TEST(XmpSidecar_writeMetadata, writesThroughASymbolicLink)
+{
+    const std::string path("tmp_target.xmp");
+    const std::string link("tmp_link.xmp");
+    createSidecar(path);
+    ASSERT_EQ(0, ::symlink(path.c_str(), link.c_str()));
+
+    Image::UniquePtr image = ImageFactory::open(link);
+    image->readMetadata();
+    image->xmpData()["Xmp.dc.source"] = "Another source";
+    image->writeMetadata();
+    struct stat buf;
+    ASSERT_EQ(0, ::lstat(link.c_str(), &buf));
+    ASSERT_TRUE(S_ISLNK(buf.st_mode));
+
+    image = ImageFactory::open(path);
+    image->readMetadata();
+    ASSERT_EQ("Another source", image->xmpData()["Xmp.dc.source"].toString());
+    std::remove(link.c_str());
+    std::remove(path.c_str());
+}
@@ -313,7 +313,7 @@ static void StartElementHandler ( void * userData, XMP_StringPtr name, XMP_Strin
 	#endif
 
 	XML_Node * parentNode = thiz->parseStack.back();
-	XML_Node * elemNode   = new XML_Node ( parentNode, "", kElemNode );
+	XML_Node * elemNode   = new ( parentNode->arena ) XML_Node ( parentNode, "", kElemNode );
 	
 	SetQualName ( name, elemNode );
 	
@@ -321,7 +321,7 @@ static void StartElementHandler ( void * userData, XMP_StringPtr name, XMP_Strin
 
 		XMP_StringPtr attrName = *attr;
 		XMP_StringPtr attrValue = *(attr+1);
-		XML_Node * attrNode = new XML_Node ( elemNode, "", kAttrNode );
+		XML_Node * attrNode = new ( elemNode->arena ) XML_Node ( elemNode, "", kAttrNode );
 
 		SetQualName ( attrName, attrNode );
 		attrNode->value = attrValue;
@@ -383,7 +383,7 @@ static void CharacterDataHandler ( void * userData, XMP_StringPtr cData, int len
 	#endif
 	
 	XML_Node * parentNode = thiz->parseStack.back();
-	XML_Node * cDataNode  = new XML_Node ( parentNode, "", kCDataNode );
+	XML_Node * cDataNode  = new ( parentNode->arena ) XML_Node ( parentNode, "", kCDataNode );
 	
 	cDataNode->value.assign ( cData, len );
 	parentNode->content.push_back ( cDataNode );
@@ -448,7 +448,7 @@ static void ProcessingInstructionHandler ( void * userData, XMP_StringPtr target
 	#endif
 	
 	XML_Node * parentNode = thiz->parseStack.back();
-	XML_Node * piNode  = new XML_Node ( parentNode, target, kPINode );
+	XML_Node * piNode  = new ( parentNode->arena ) XML_Node ( parentNode, target, kPINode );
 	
 	piNode->value.assign ( data );
 	parentNode->content.push_back ( piNode );
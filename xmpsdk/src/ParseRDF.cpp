@@ -386,7 +386,8 @@ AddChildNode ( XMP_Node * xmpParent, const XML_Node & xmlNode, const XMP_StringP
 		xmpParent = schemaNode;
 		
 		// If this is an alias set the isAlias flag in the node and the hasAliases flag in the tree.
-		if ( sRegisteredAliasMap->find ( xmlNode.name ) != sRegisteredAliasMap->end() ) {
+		const XMP_AliasMap & aliases = GetNamespaceTable().aliases;
+		if ( aliases.find ( xmlNode.name ) != aliases.end() ) {
 			childOptions |= kXMP_PropIsAlias;
 			schemaNode->parent->options |= kXMP_PropHasAliases;
 		}
@@ -54,6 +54,33 @@ typedef XML_NodeVector::const_iterator	XML_cNodePos;
 	}
 #endif
 
+// -------------------------------------------------------------------------------------------------
+// The nodes of an XML tree are allocated from an arena owned by the parser adapter. The tree is
+// built and dropped once per parse, so the nodes are carved out of a few large chunks instead of
+// being allocated one by one. Deleting a node runs its destructor, the memory is released with
+// the arena.
+
+class XML_NodeArena {
+public:
+
+	XML_NodeArena() : next(0), left(0) {};
+	~XML_NodeArena();
+
+	void * Allocate ( size_t size );
+
+private:
+
+	enum { kChunkSize = 16*1024 };
+
+	std::vector<char*>	chunks;
+	char *				next;
+	size_t				left;
+
+	XML_NodeArena ( const XML_NodeArena & );	// ! Not implemented.
+	void operator= ( const XML_NodeArena & );
+
+};
+
 class XML_Node {
 public:
 
@@ -65,6 +92,7 @@ public:
 	XML_NodePtr		parent;
 	XML_NodeVector	attrs;
 	XML_NodeVector	content;
+	XML_NodeArena *	arena;	// The arena of the tree, taken from the parent.
 	
 	bool IsWhitespaceNode() const;
 	bool IsLeafContentNode() const;	// An empty element or one with a single character data child node.
@@ -87,16 +115,21 @@ public:
 	void ClearNode();
 
 	XML_Node ( XML_NodePtr _parent, XMP_StringPtr _name, XMP_Uns8 _kind )
-            : kind(_kind), name(_name), nsPrefixLen(0), parent(_parent) {};
+            : kind(_kind), name(_name), nsPrefixLen(0), parent(_parent), arena(_parent ? _parent->arena : 0) {};
 
 	XML_Node ( XML_NodePtr _parent, const std::string & _name, XMP_Uns8 _kind )
-            : kind(_kind), name(_name), nsPrefixLen(0), parent(_parent) {};
+            : kind(_kind), name(_name), nsPrefixLen(0), parent(_parent), arena(_parent ? _parent->arena : 0) {};
 
 	virtual ~XML_Node() { RemoveAttrs(); RemoveContent(); };
 
+	// Nodes can only be created in an arena, e.g. "new ( parent->arena ) XML_Node ( parent, ... )".
+	static void * operator new ( size_t size, XML_NodeArena * _arena ) { return _arena->Allocate ( size ); };
+	static void operator delete ( void * /* ptr */, XML_NodeArena * /* _arena */ ) {};
+	static void operator delete ( void * /* ptr */ ) {};
+
 private:
 
-	XML_Node() : kind(0), parent(0)	{};	// ! Hidden to make sure parent pointer is always set.
+	XML_Node() : kind(0), parent(0), arena(0)	{};	// ! Hidden to make sure parent pointer is always set.
 
 };
 
@@ -111,6 +144,7 @@ public:
 	XMLParserAdapter()
 		: tree(0,"",kRootNode), rootNode(0), rootCount(0), charEncoding(XMP_OptionBits(-1)), pendingCount(0)
 	{
+		tree.arena = &nodeArena;
 		#if XMP_DebugBuild
 			parseLog = 0;
 		#endif
@@ -120,6 +154,7 @@ public:
 	
 	virtual void ParseBuffer ( const void * buffer, size_t length, bool last ) = 0;
 
+	XML_NodeArena	nodeArena;	// ! Must precede the tree, the nodes are destroyed before the arena.
 	XML_Node		tree;
 	XML_NodeVector	parseStack;
 	XML_NodePtr		rootNode;
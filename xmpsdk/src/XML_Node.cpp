@@ -135,7 +135,7 @@ void XML_Node::SetLeafContentValue ( XMP_StringPtr newValue )
 	if ( ! this->content.empty() ) {
 		valueNode = this->content[0];
 	} else {
-		valueNode = new XML_Node ( this, "", kCDataNode );
+		valueNode = new ( this->arena ) XML_Node ( this, "", kCDataNode );
 		this->content.push_back ( valueNode );
 	}
 
@@ -419,6 +419,40 @@ void XML_Node::Serialize ( std::string * buffer )
 
 }	// XML_Node::Serialize
 
+// =================================================================================================
+// XML_NodeArena::~XML_NodeArena
+//==============================
+
+XML_NodeArena::~XML_NodeArena()
+{
+
+	for ( size_t i = 0, vLim = this->chunks.size(); i < vLim; ++i ) delete [] this->chunks[i];
+
+}	// XML_NodeArena::~XML_NodeArena
+
+// =================================================================================================
+// XML_NodeArena::Allocate
+//========================
+
+void * XML_NodeArena::Allocate ( size_t size )
+{
+
+	size = (size + 15) & ~size_t(15);	// Keep the blocks aligned for any member type.
+	if ( size > this->left ) {
+		size_t chunkSize = (size > kChunkSize) ? size : size_t(kChunkSize);
+		this->chunks.reserve ( this->chunks.size() + 1 );
+		this->next = new char [chunkSize];
+		this->chunks.push_back ( this->next );
+		this->left = chunkSize;
+	}
+
+	void * block = this->next;
+	this->next += size;
+	this->left -= size;
+	return block;
+
+}	// XML_NodeArena::Allocate
+
 // =================================================================================================
 // XML_Node::RemoveAttrs
 //======================
@@ -14,6 +14,7 @@
 #include "UnicodeInlines.incl_cpp"
 
 #include <algorithm>
+#include <atomic>
 
 using namespace std;
 
@@ -50,13 +51,15 @@ using namespace std;
 
 XMP_Int32 sXMP_InitCount = 0;
 
-XMP_StringMap *	sNamespaceURIToPrefixMap = 0;
-XMP_StringMap *	sNamespacePrefixToURIMap = 0;
+static std::atomic<const XMP_NamespaceTable *> sNamespaceTable ( 0 );
+static std::vector<const XMP_NamespaceTable *> * sRetiredNamespaceTables = 0;
+static bool sNamespaceTableShared = false;
 
-XMP_AliasMap *	sRegisteredAliasMap = 0;	// Needed by XMPIterator.
+static thread_local XMP_VarString sOutputNSBuffer;
+static thread_local XMP_VarString sOutputStrBuffer;
 
-XMP_VarString *	sOutputNS  = 0;
-XMP_VarString *	sOutputStr = 0;
+thread_local XMP_VarString *	sOutputNS  = &sOutputNSBuffer;
+thread_local XMP_VarString *	sOutputStr = &sOutputStrBuffer;
 XMP_VarString * sExceptionMessage = 0;
 
 XMP_Mutex sXMPCoreLock;
@@ -66,25 +69,24 @@ int sLockCount = 0;
 	FILE * xmpOut = stderr;
 #endif
 
-void *              voidVoidPtr    = 0;	// Used to backfill null output parameters.
-XMP_StringPtr		voidStringPtr  = 0;
-XMP_StringLen		voidStringLen  = 0;
-XMP_OptionBits		voidOptionBits = 0;
-XMP_Uns8			voidByte       = 0;
-bool				voidBool       = 0;
-XMP_Int32			voidInt32      = 0;
-XMP_Int64			voidInt64      = 0;
-double				voidDouble     = 0.0;
-XMP_DateTime		voidDateTime;
-WXMP_Result 		void_wResult;
+thread_local void *             voidVoidPtr    = 0;	// Used to backfill null output parameters.
+thread_local XMP_StringPtr		voidStringPtr  = 0;
+thread_local XMP_StringLen		voidStringLen  = 0;
+thread_local XMP_OptionBits		voidOptionBits = 0;
+thread_local XMP_Uns8			voidByte       = 0;
+thread_local bool				voidBool       = 0;
+thread_local XMP_Int32			voidInt32      = 0;
+thread_local XMP_Int64			voidInt64      = 0;
+thread_local double				voidDouble     = 0.0;
+thread_local XMP_DateTime		voidDateTime;
+thread_local WXMP_Result 		void_wResult;
 
 // =================================================================================================
 // Mutex Utilities
 // ===============
 
 // ! Note that the mutex need not be "recursive", allowing the same thread to acquire it multiple
-// ! times. There is a single XMP lock which is acquired in the wrapper classes. Internal calls
-// ! never go back out to the wrappers.
+// ! times. The single XMP lock is only acquired by XMP_NamespaceUpdate, registry updates never nest.
 
 #if XMP_WinBuild
 
@@ -132,6 +134,78 @@ WXMP_Result 		void_wResult;
 
 #endif
 
+// =================================================================================================
+// Namespace Registry
+// ==================
+
+// -------------------------------------------------------------------------------------------------
+// GetNamespaceTable
+// -----------------
+
+const XMP_NamespaceTable &
+GetNamespaceTable()
+{
+	return *sNamespaceTable.load ( std::memory_order_acquire );
+
+}	// GetNamespaceTable
+
+// -------------------------------------------------------------------------------------------------
+// XMP_NamespaceUpdate
+// -------------------
+
+XMP_NamespaceUpdate::XMP_NamespaceUpdate() : table ( new XMP_NamespaceTable ( GetNamespaceTable() ) )
+{
+}
+
+XMP_NamespaceUpdate::~XMP_NamespaceUpdate()
+{
+	delete table;
+}
+
+void
+XMP_NamespaceUpdate::Commit()
+{
+	// ! Before the registry is shared no reader can hold on to the old table, don't pile up the
+	// ! snapshots made while the standard namespaces and aliases are registered.
+
+	const XMP_NamespaceTable * oldTable = sNamespaceTable.exchange ( table, std::memory_order_acq_rel );
+	table = 0;
+	if ( sNamespaceTableShared ) {
+		sRetiredNamespaceTables->push_back ( oldTable );
+	} else {
+		delete oldTable;
+	}
+
+}	// XMP_NamespaceUpdate::Commit
+
+// -------------------------------------------------------------------------------------------------
+// XMP_InitNamespaceTable, XMP_ShareNamespaceTable, XMP_TermNamespaceTable
+// -----------------------------------------------------------------------
+
+void
+XMP_InitNamespaceTable()
+{
+	sNamespaceTable.store ( new XMP_NamespaceTable, std::memory_order_release );
+	sRetiredNamespaceTables = new std::vector<const XMP_NamespaceTable *>;
+	sNamespaceTableShared = false;
+}
+
+void
+XMP_ShareNamespaceTable()
+{
+	sNamespaceTableShared = true;
+}
+
+void
+XMP_TermNamespaceTable()
+{
+	for ( size_t i = 0; i < sRetiredNamespaceTables->size(); ++i ) delete (*sRetiredNamespaceTables)[i];
+	delete sRetiredNamespaceTables;
+	sRetiredNamespaceTables = 0;
+	delete sNamespaceTable.exchange ( 0 );
+	sNamespaceTableShared = false;
+}
+
 // =================================================================================================
 // Local Utilities
 // ===============
@@ -168,8 +242,9 @@ VerifyXPathRoot	( XMP_StringPtr			schemaURI,
 		}
 	}
 
-	XMP_StringMapPos uriPos = sNamespaceURIToPrefixMap->find ( XMP_VarString ( schemaURI ) );
-	if ( uriPos == sNamespaceURIToPrefixMap->end() ) {
+	const XMP_NamespaceTable & nsTable = GetNamespaceTable();
+	XMP_cStringMapPos uriPos = nsTable.uriToPrefix.find ( XMP_VarString ( schemaURI ) );
+	if ( uriPos == nsTable.uriToPrefix.end() ) {
 		XMP_Throw ( "Unregistered schema namespace URI", kXMPErr_BadSchema );
 	}
 
@@ -195,8 +270,8 @@ VerifyXPathRoot	( XMP_StringPtr			schemaURI,
 		VerifySimpleXMLName ( colonPos+1, colonPos+strlen(colonPos) );
 
 		XMP_VarString prefix ( propName, prefixLen );
-		XMP_StringMapPos prefixPos = sNamespacePrefixToURIMap->find ( prefix );
-		if ( prefixPos == sNamespacePrefixToURIMap->end() ) {
+		XMP_cStringMapPos prefixPos = nsTable.prefixToURI.find ( prefix );
+		if ( prefixPos == nsTable.prefixToURI.end() ) {
 			XMP_Throw ( "Unknown schema namespace prefix", kXMPErr_BadSchema );
 		}
 		if ( prefix != uriPos->second ) {
@@ -228,8 +303,9 @@ VerifyQualName ( XMP_StringPtr qualName, XMP_StringPtr nameEnd )
 
 	size_t prefixLen = colonPos - qualName + 1;	// ! Include the colon.
 	XMP_VarString prefix ( qualName, prefixLen );
-	XMP_StringMapPos prefixPos = sNamespacePrefixToURIMap->find ( prefix );
-	if ( prefixPos == sNamespacePrefixToURIMap->end() ) {
+	const XMP_NamespaceTable & nsTable = GetNamespaceTable();
+	XMP_cStringMapPos prefixPos = nsTable.prefixToURI.find ( prefix );
+	if ( prefixPos == nsTable.prefixToURI.end() ) {
 		XMP_Throw ( "Unknown namespace prefix for qualified name", kXMPErr_BadXPath );
 	}
 
@@ -688,7 +764,8 @@ ExpandXPath	( XMP_StringPtr			schemaNS,
 	VerifyXPathRoot ( schemaNS, currStep.c_str(), expandedXPath );
 
 	XMP_OptionBits stepFlags = kXMP_StructFieldStep;	
-	if ( sRegisteredAliasMap->find ( (*expandedXPath)[kRootPropStep].step ) != sRegisteredAliasMap->end() ) {
+	const XMP_AliasMap & aliases = GetNamespaceTable().aliases;
+	if ( aliases.find ( (*expandedXPath)[kRootPropStep].step ) != aliases.end() ) {
 		stepFlags |= kXMP_StepIsAlias;
 	}
 	(*expandedXPath)[kRootPropStep].options |= stepFlags;
@@ -1093,8 +1170,9 @@ FindNode ( XMP_Node *		xmpTree,
 
 		stepNum = 2;	// ! Continue processing the original path at the second level step.
 
-		XMP_AliasMapPos aliasPos = sRegisteredAliasMap->find ( expandedXPath[kRootPropStep].step );
-		XMP_Assert ( aliasPos != sRegisteredAliasMap->end() );
+		const XMP_AliasMap & aliases = GetNamespaceTable().aliases;
+		XMP_cAliasMapPos aliasPos = aliases.find ( expandedXPath[kRootPropStep].step );
+		XMP_Assert ( aliasPos != aliases.end() );
 		
 		currNode = FindSchemaNode ( xmpTree, aliasPos->second[kSchemaStep].step.c_str(), createNodes, &currPos );
 		if ( currNode == 0 ) goto EXIT;
@@ -71,25 +71,36 @@ typedef XMP_AliasMap::const_iterator	XMP_cAliasMapPos;
 
 extern XMP_Int32 sXMP_InitCount;
 
-extern XMP_AliasMap *	sRegisteredAliasMap;
-
-extern XMP_StringMap *	sNamespaceURIToPrefixMap;
-extern XMP_StringMap *	sNamespacePrefixToURIMap;
-
-extern XMP_VarString *	sOutputNS;
-extern XMP_VarString *	sOutputStr;
-
-extern void *			voidVoidPtr;	// Used to backfill null output parameters.
-extern XMP_StringPtr	voidStringPtr;
-extern XMP_StringLen	voidStringLen;
-extern XMP_OptionBits	voidOptionBits;
-extern XMP_Bool			voidByte;
-extern bool				voidBool;
-extern XMP_Int32		voidInt32;
-extern XMP_Int64		voidInt64;
-extern double			voidDouble;
-extern XMP_DateTime		voidDateTime;
-extern WXMP_Result		void_wResult;
+// The namespace and alias registry is copy-on-write so that lookups need no lock. Readers take a
+// snapshot with GetNamespaceTable, writers go through XMP_NamespaceUpdate. A replaced table is
+// retired rather than deleted, pointers into it that were handed out earlier stay valid until
+// Terminate.
+
+struct XMP_NamespaceTable {
+	XMP_StringMap	uriToPrefix;
+	XMP_StringMap	prefixToURI;
+	XMP_AliasMap	aliases;	// Alias name to actual path.
+};
+
+extern const XMP_NamespaceTable & GetNamespaceTable();
+
+// ! The output strings and the backfill targets are per thread, results of calls made on different
+// ! threads never share storage.
+
+extern thread_local XMP_VarString *	sOutputNS;
+extern thread_local XMP_VarString *	sOutputStr;
+
+extern thread_local void *			voidVoidPtr;	// Used to backfill null output parameters.
+extern thread_local XMP_StringPtr	voidStringPtr;
+extern thread_local XMP_StringLen	voidStringLen;
+extern thread_local XMP_OptionBits	voidOptionBits;
+extern thread_local XMP_Bool		voidByte;
+extern thread_local bool			voidBool;
+extern thread_local XMP_Int32		voidInt32;
+extern thread_local XMP_Int64		voidInt64;
+extern thread_local double			voidDouble;
+extern thread_local XMP_DateTime	voidDateTime;
+extern thread_local WXMP_Result		void_wResult;
 
 #define kHexDigits "0123456789ABCDEF"
 
@@ -226,23 +237,43 @@ private:
 	XMP_Mutex * mutex;
 };
 
-// *** Switch to XMPEnterObjectWrapper & XMPEnterStaticWrapper, to allow for per-object locks.
+// An update of the namespace registry. Holds sXMPCoreLock for its lifetime, Table is a private copy
+// of the current registry that becomes visible to readers on Commit. An update that is not committed,
+// e.g. because an exception was thrown, is discarded.
+
+class XMP_NamespaceUpdate {
+public:
+	XMP_NamespaceUpdate();
+	~XMP_NamespaceUpdate();
+	XMP_NamespaceTable & Table() { return *table; };
+	void Commit();
+private:
+	XMP_AutoMutex lock;
+	XMP_NamespaceTable * table;
+	XMP_NamespaceUpdate ( const XMP_NamespaceUpdate & );	// ! Not implemented.
+	XMP_NamespaceUpdate & operator= ( const XMP_NamespaceUpdate & );
+};
+
+extern void XMP_InitNamespaceTable();
+extern void XMP_ShareNamespaceTable();
+extern void XMP_TermNamespaceTable();
+
+// ! The wrappers don't lock. XMPMeta objects carry all parse and serialize state, the registry is
+// ! copy-on-write and the output strings are per thread. A single object must still not be used
+// ! from several threads at once.
 
 // ! Don't do the initialization check (sXMP_InitCount > 0) for the no-lock case. That macro is used
 // ! by WXMPMeta_Initialize_1.
 
 #define XMP_ENTER_WRAPPER_NO_LOCK(proc)						\
 	AnnounceNoLock ( proc );								\
-	XMP_Assert ( (0 <= sLockCount) && (sLockCount <= 1) );	\
 	try {													\
 		wResult->errMessage = 0;
 
 #define XMP_ENTER_WRAPPER(proc)								\
 	AnnounceEntry ( proc );									\
 	XMP_Assert ( sXMP_InitCount > 0 );	                    \
-	XMP_Assert ( (0 <= sLockCount) && (sLockCount <= 1) );	\
 	try {													\
-		XMP_AutoMutex mutex;								\
 		wResult->errMessage = 0;
 
 #define XMP_EXIT_WRAPPER	\
@@ -250,7 +281,7 @@ private:
 	AnnounceExit();
 
 #define XMP_EXIT_WRAPPER_KEEP_LOCK(keep)	\
-		if ( keep ) mutex.KeepLock();		\
+		(void) ( keep );					\
 	XMP_CATCH_EXCEPTIONS					\
 	AnnounceExit();
 
@@ -86,8 +86,9 @@ AddSchemaAliases ( IterInfo & info, IterNode & iterSchema, XMP_StringPtr schemaU
 	bool found = XMPMeta::GetNamespacePrefix ( schemaURI, &nsPrefix, &nsLen );
 	if ( ! found ) XMP_Throw ( "Unknown iteration namespace", kXMPErr_BadSchema );
 	
-	XMP_AliasMapPos currAlias = sRegisteredAliasMap->begin();
-	XMP_AliasMapPos endAlias  = sRegisteredAliasMap->end();
+	const XMP_AliasMap & aliases = GetNamespaceTable().aliases;
+	XMP_cAliasMapPos currAlias = aliases.begin();
+	XMP_cAliasMapPos endAlias  = aliases.end();
 	
 	for ( ; currAlias != endAlias; ++currAlias ) {
 		if ( XMP_LitNMatch ( currAlias->first.c_str(), nsPrefix, nsLen ) ) {
@@ -529,8 +530,9 @@ XMPIterator::XMPIterator ( const XMPMeta & xmpObj,
 			// ! here to determine if the namespace has any aliases to existing properties. We then
 			// ! strip the children if necessary.
 
-			XMP_cStringMapPos currNS = sNamespaceURIToPrefixMap->begin();
-			XMP_cStringMapPos endNS  = sNamespaceURIToPrefixMap->end();
+			const XMP_StringMap & uriToPrefix = GetNamespaceTable().uriToPrefix;
+			XMP_cStringMapPos currNS = uriToPrefix.begin();
+			XMP_cStringMapPos endNS  = uriToPrefix.end();
 			for ( ; currNS != endNS; ++currNS ) {
 				XMP_StringPtr schemaName = currNS->first.c_str();
 				if ( FindConstSchema ( &xmpObj.tree, schemaName ) != 0 ) continue;
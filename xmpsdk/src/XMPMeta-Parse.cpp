@@ -357,7 +357,7 @@ TransplantArrayItemAlias ( XMP_Node * oldParent, size_t oldNum, XMP_Node * newPa
 // --------------------
 
 static void
-TransplantNamedAlias ( XMP_Node * oldParent, size_t oldNum, XMP_Node * newParent, XMP_VarString & newName )
+TransplantNamedAlias ( XMP_Node * oldParent, size_t oldNum, XMP_Node * newParent, const XMP_VarString & newName )
 {
 	XMP_Node * childNode = oldParent->children[oldNum];
 
@@ -401,9 +401,10 @@ MoveExplicitAliases ( XMP_Node * tree, XMP_OptionBits parseOptions )
 
 			// Find the base path, look for the base schema and root node.
 
-			XMP_AliasMapPos aliasPos = sRegisteredAliasMap->find ( currProp->name );
-			XMP_Assert ( aliasPos != sRegisteredAliasMap->end() );
-			XMP_ExpandedXPath & basePath = aliasPos->second;
+			const XMP_AliasMap & aliases = GetNamespaceTable().aliases;
+			XMP_cAliasMapPos aliasPos = aliases.find ( currProp->name );
+			XMP_Assert ( aliasPos != aliases.end() );
+			const XMP_ExpandedXPath & basePath = aliasPos->second;
 			XMP_OptionBits arrayOptions = (basePath[kRootPropStep].options & kXMP_PropArrayFormMask);
 
 			XMP_Node * baseSchema = FindSchemaNode ( tree, basePath[kSchemaStep].step.c_str(), kXMP_CreateNodes );
@@ -167,8 +167,9 @@ DeclareElemNamespace ( const XMP_VarString & elemName,
 
 	if ( colonPos != XMP_VarString::npos ) {
 		XMP_VarString nsPrefix ( elemName.substr ( 0, colonPos+1 ) );
-		XMP_StringMapPos prefixPos = sNamespacePrefixToURIMap->find ( nsPrefix );
-		XMP_Enforce ( prefixPos != sNamespacePrefixToURIMap->end() );
+		const XMP_StringMap & prefixToURI = GetNamespaceTable().prefixToURI;
+		XMP_cStringMapPos prefixPos = prefixToURI.find ( nsPrefix );
+		XMP_Enforce ( prefixPos != prefixToURI.end() );
 		DeclareOneNamespace ( nsPrefix, prefixPos->second, usedNS, outputStr, newline, indentStr, indent );
 	}
 
@@ -608,8 +609,9 @@ SerializePrettyRDFSchema ( const XMP_VarString & treeName,
 	outputStr += '"';
 
 	size_t totalLen = 8;	// Start at 8 for "xml:rdf:".
-	XMP_cStringMapPos currPos = sNamespacePrefixToURIMap->begin();
-	XMP_cStringMapPos endPos  = sNamespacePrefixToURIMap->end();
+	const XMP_StringMap & prefixToURI = GetNamespaceTable().prefixToURI;
+	XMP_cStringMapPos currPos = prefixToURI.begin();
+	XMP_cStringMapPos endPos  = prefixToURI.end();
 	for ( ; currPos != endPos; ++currPos ) totalLen += currPos->first.size();
 
 	XMP_VarString usedNS;
@@ -626,8 +628,9 @@ SerializePrettyRDFSchema ( const XMP_VarString & treeName,
 
 		#if 0	// *** Buggy, disable for now.
 		
-		XMP_cAliasMapPos aliasPos = sRegisteredAliasMap->begin();
-		XMP_cAliasMapPos aliasEnd = sRegisteredAliasMap->end();
+		const XMP_AliasMap & aliases = GetNamespaceTable().aliases;
+		XMP_cAliasMapPos aliasPos = aliases.begin();
+		XMP_cAliasMapPos aliasEnd = aliases.end();
 		
 		for ( ; aliasPos != aliasEnd; ++aliasPos ) {
 
@@ -984,8 +987,9 @@ SerializeCompactRDFSchemas ( const XMP_Node & xmpTree,
 	// Write all necessary xmlns attributes.
 	
 	size_t totalLen = 8;	// Start at 8 for "xml:rdf:".
-	XMP_cStringMapPos currPos = sNamespacePrefixToURIMap->begin();
-	XMP_cStringMapPos endPos  = sNamespacePrefixToURIMap->end();
+	const XMP_StringMap & prefixToURI = GetNamespaceTable().prefixToURI;
+	XMP_cStringMapPos currPos = prefixToURI.begin();
+	XMP_cStringMapPos endPos  = prefixToURI.end();
 	for ( ; currPos != endPos; ++currPos ) totalLen += currPos->first.size();
 
 	XMP_VarString usedNS;
@@ -1054,7 +1058,8 @@ SerializeAsRDF ( const XMPMeta & xmpObj,
 				 XMP_OptionBits	 options,
 				 XMP_StringPtr	 newline,
 				 XMP_StringPtr	 indentStr,
-				 XMP_Index		 baseIndent )
+				 XMP_Index		 baseIndent,
+				 size_t			 extraLen )	// Room the caller appends to the head, e.g. padding and tail.
 {
 	const size_t treeNameLen = xmpObj.tree.name.size();
 	const size_t indentLen   = strlen ( indentStr );
@@ -1076,6 +1081,7 @@ SerializeAsRDF ( const XMPMeta & xmpObj,
 	}
 	
 	outputLen += (outputLen >> 2);	// Inflate by 1/4, an empirical fudge factor.
+	outputLen += extraLen;			// So the padding and tail do not reallocate the finished head.
 	
 	// Now generate the RDF into the head string as UTF-8.
 	
@@ -1221,7 +1227,16 @@ XMPMeta::SerializeToBuffer ( XMP_StringPtr * rdfString,
 	
 	std::string tailStr;
 
-	SerializeAsRDF ( *this, *sOutputStr, tailStr, options, newline, indentStr, baseIndent );
+	// The UTF-8 packet is assembled in place, reserve room for the padding, its newlines and the
+	// tail along with the RDF. The other encodings are converted into a new string anyway.
+
+	size_t extraLen = 0;
+	if ( charEncoding == kXMP_EncodeUTF8 ) {
+		const size_t newlineLen = strlen ( newline );
+		extraLen = padding + (padding/100 + 1) * newlineLen + strlen(kPacketTrailer) + strlen(indentStr) * baseIndent;
+	}
+
+	SerializeAsRDF ( *this, *sOutputStr, tailStr, options, newline, indentStr, baseIndent, extraLen );
 	if ( charEncoding == kXMP_EncodeUTF8 ) {
 
 		if ( options & kXMP_ExactPacketLength ) {
@@ -654,14 +654,10 @@ XMPMeta::Initialize()
 	
 	sExceptionMessage = new XMP_VarString();
 	XMP_InitMutex ( &sXMPCoreLock );
-    sOutputNS  = new XMP_VarString;
-    sOutputStr = new XMP_VarString;
 
 	xdefaultName = new XMP_VarString ( "x-default" );
 	
-	sNamespaceURIToPrefixMap	= new XMP_StringMap;
-	sNamespacePrefixToURIMap	= new XMP_StringMap;
-	sRegisteredAliasMap			= new XMP_AliasMap;
+	XMP_InitNamespaceTable();
 	
 	InitializeUnicodeConversions();
 	
@@ -731,6 +727,11 @@ XMPMeta::Initialize()
 	
 	if ( ! XMPIterator::Initialize() ) XMP_Throw ( "Failure from XMPIterator::Initialize", kXMPErr_InternalFailure );
 	if ( ! XMPUtils::Initialize() ) XMP_Throw ( "Failure from XMPUtils::Initialize", kXMPErr_InternalFailure );
+
+	// From here on other threads may look at the registry.
+
+	XMP_ShareNamespaceTable();
+
 	// Do miscelaneous semantic checks of types and arithmetic.
 
 	XMP_Assert ( sizeof(XMP_Int8) == 1 );
@@ -821,13 +822,9 @@ XMPMeta::Terminate() RELEASE_NO_THROW
 	
 	XMPIterator::Terminate();
 	XMPUtils::Terminate();
-	EliminateGlobal ( sNamespaceURIToPrefixMap );
-	EliminateGlobal ( sNamespacePrefixToURIMap );
-	EliminateGlobal ( sRegisteredAliasMap );
+	XMP_TermNamespaceTable();
     
     EliminateGlobal ( xdefaultName );
-    EliminateGlobal ( sOutputNS );
-    EliminateGlobal ( sOutputStr );
 	EliminateGlobal ( sExceptionMessage );
 
 	XMP_TermMutex ( sXMPCoreLock );
@@ -844,12 +841,8 @@ XMPMeta::Unlock ( XMP_OptionBits options )
 {
 	UNUSED(options);
 
-    #if TraceXMPLocking
-    	fprintf ( xmpOut, "  Unlocking XMP toolkit, count = %d\n", sLockCount ); fflush ( xmpOut );
-	#endif
-    --sLockCount;
-    XMP_Assert ( sLockCount == 0 );
-	XMP_ExitCriticalRegion ( sXMPCoreLock );
+	// ! Nothing to do, the wrappers no longer hold a lock when returning strings. Output strings
+	// ! are per thread and stay valid until the next call on the same thread.
 
 }	// Unlock
 
@@ -883,27 +876,28 @@ XMPMeta::DumpNamespaces ( XMP_TextOutputProc outProc,
 	XMP_Assert ( outProc != 0 );	// ! Enforced by wrapper.
 	XMP_Status status = 0;
 	
-	XMP_StringMapPos p2uEnd = sNamespacePrefixToURIMap->end();	// ! Move up to avoid gcc complaints.
-	XMP_StringMapPos u2pEnd = sNamespaceURIToPrefixMap->end();
+	const XMP_NamespaceTable & nsTable = GetNamespaceTable();
+	XMP_cStringMapPos p2uEnd = nsTable.prefixToURI.end();	// ! Move up to avoid gcc complaints.
+	XMP_cStringMapPos u2pEnd = nsTable.uriToPrefix.end();
 	
-	status = DumpStringMap ( *sNamespacePrefixToURIMap, "Dumping namespace prefix to URI map", outProc, refCon );
+	status = DumpStringMap ( nsTable.prefixToURI, "Dumping namespace prefix to URI map", outProc, refCon );
 	if ( status != 0 ) goto EXIT;
 	
-	if ( sNamespacePrefixToURIMap->size() != sNamespaceURIToPrefixMap->size() ) {
+	if ( nsTable.prefixToURI.size() != nsTable.uriToPrefix.size() ) {
 		OutProcLiteral ( "** bad namespace map sizes **" );
 		XMP_Throw ( "Fatal namespace map problem", kXMPErr_InternalFailure );
 	}
 	
-	for ( XMP_StringMapPos nsLeft = sNamespacePrefixToURIMap->begin(); nsLeft != p2uEnd; ++nsLeft ) {
+	for ( XMP_cStringMapPos nsLeft = nsTable.prefixToURI.begin(); nsLeft != p2uEnd; ++nsLeft ) {
 
-		XMP_StringMapPos nsOther = sNamespaceURIToPrefixMap->find ( nsLeft->second );
-		if ( (nsOther == u2pEnd) || (nsLeft != sNamespacePrefixToURIMap->find ( nsOther->second )) ) {
+		XMP_cStringMapPos nsOther = nsTable.uriToPrefix.find ( nsLeft->second );
+		if ( (nsOther == u2pEnd) || (nsLeft != nsTable.prefixToURI.find ( nsOther->second )) ) {
 			OutProcLiteral ( "  ** bad namespace URI **  " );
 			DumpClearString ( nsLeft->second, outProc, refCon );
 			goto FAILURE;
 		}
 		
-		for ( XMP_StringMapPos nsRight = nsLeft; nsRight != p2uEnd; ++nsRight ) {
+		for ( XMP_cStringMapPos nsRight = nsLeft; nsRight != p2uEnd; ++nsRight ) {
 			if ( nsRight == nsLeft ) continue;	// ! Can't start at nsLeft+1, no operator+!
 			if ( nsLeft->second == nsRight->second ) {
 				OutProcLiteral ( "  ** duplicate namespace URI **  " );
@@ -914,16 +908,16 @@ XMPMeta::DumpNamespaces ( XMP_TextOutputProc outProc,
 
 	}
 	
-	for ( XMP_StringMapPos nsLeft = sNamespaceURIToPrefixMap->begin(); nsLeft != u2pEnd; ++nsLeft ) {
+	for ( XMP_cStringMapPos nsLeft = nsTable.uriToPrefix.begin(); nsLeft != u2pEnd; ++nsLeft ) {
 
-		XMP_StringMapPos nsOther = sNamespacePrefixToURIMap->find ( nsLeft->second );
-		if ( (nsOther == p2uEnd) || (nsLeft != sNamespaceURIToPrefixMap->find ( nsOther->second )) ) {
+		XMP_cStringMapPos nsOther = nsTable.prefixToURI.find ( nsLeft->second );
+		if ( (nsOther == p2uEnd) || (nsLeft != nsTable.uriToPrefix.find ( nsOther->second )) ) {
 			OutProcLiteral ( "  ** bad namespace prefix **  " );
 			DumpClearString ( nsLeft->second, outProc, refCon );
 			goto FAILURE;
 		}
 
-		for ( XMP_StringMapPos nsRight = nsLeft; nsRight != u2pEnd; ++nsRight ) {
+		for ( XMP_cStringMapPos nsRight = nsLeft; nsRight != u2pEnd; ++nsRight ) {
 			if ( nsRight == nsLeft ) continue;	// ! Can't start at nsLeft+1, no operator+!
 			if ( nsLeft->second == nsRight->second ) {
 				OutProcLiteral ( "  ** duplicate namespace prefix **  " );
@@ -939,7 +933,7 @@ EXIT:
 
 FAILURE:
 	OutProcNewline();
-	(void) DumpStringMap ( *sNamespaceURIToPrefixMap, "Dumping namespace URI to prefix map", outProc, refCon );
+	(void) DumpStringMap ( nsTable.uriToPrefix, "Dumping namespace URI to prefix map", outProc, refCon );
 	XMP_Throw ( "Fatal namespace map problem", kXMPErr_InternalFailure );
 	return 0;
 	
@@ -957,13 +951,13 @@ XMPMeta::DumpAliases ( XMP_TextOutputProc outProc,
 	XMP_Assert ( outProc != 0 );	// ! Enforced by wrapper.
 	XMP_Status status = 0;
 
-	XMP_Assert ( sRegisteredAliasMap != 0 );
+	const XMP_AliasMap & aliases = GetNamespaceTable().aliases;
 
 	XMP_cAliasMapPos aliasPos;
-	XMP_cAliasMapPos aliasEnd = sRegisteredAliasMap->end();
+	XMP_cAliasMapPos aliasEnd = aliases.end();
 	
 	size_t maxLen = 0;
-	for ( aliasPos = sRegisteredAliasMap->begin(); aliasPos != aliasEnd; ++aliasPos ) {
+	for ( aliasPos = aliases.begin(); aliasPos != aliasEnd; ++aliasPos ) {
 		size_t currLen = aliasPos->first.size();
 		if ( currLen > maxLen ) maxLen = currLen;
 	}
@@ -971,7 +965,7 @@ XMPMeta::DumpAliases ( XMP_TextOutputProc outProc,
 	OutProcLiteral ( "Dumping alias name to actual path map" );
 	OutProcNewline();
 		
-	for ( aliasPos = sRegisteredAliasMap->begin(); aliasPos != aliasEnd; ++aliasPos ) {
+	for ( aliasPos = aliases.begin(); aliasPos != aliasEnd; ++aliasPos ) {
 
 		OutProcNChars ( "   ", 3 );
 		DumpClearString ( aliasPos->first, outProc, refCon );
@@ -1048,9 +1042,20 @@ XMPMeta::RegisterNamespace ( XMP_StringPtr	 namespaceURI,
 	if ( prfix[prfix.size()-1] != ':' ) prfix += ':';
 	VerifySimpleXMLName ( prefix, prefix+prfix.size()-1 );	// Exclude the colon.
 	
-        // Set the new namespace in both maps.
-        (*sNamespaceURIToPrefixMap)[nsURI] = prfix;
-        (*sNamespacePrefixToURIMap)[prfix] = nsURI;
+	// Parsing registers every namespace it comes across, don't copy the registry if nothing changes.
+
+	const XMP_NamespaceTable & nsTable = GetNamespaceTable();
+	XMP_cStringMapPos uriPos = nsTable.uriToPrefix.find ( nsURI );
+	if ( (uriPos != nsTable.uriToPrefix.end()) && (uriPos->second == prfix) ) {
+		XMP_cStringMapPos prefixPos = nsTable.prefixToURI.find ( prfix );
+		if ( (prefixPos != nsTable.prefixToURI.end()) && (prefixPos->second == nsURI) ) return;
+	}
+
+	// Set the new namespace in both maps.
+	XMP_NamespaceUpdate update;
+	update.Table().uriToPrefix[nsURI] = prfix;
+	update.Table().prefixToURI[prfix] = nsURI;
+	update.Commit();
 	
 }	// RegisterNamespace
 
@@ -1069,10 +1074,11 @@ XMPMeta::GetNamespacePrefix	( XMP_StringPtr   namespaceURI,
 	XMP_Assert ( *namespaceURI != 0 ); 	// ! Enforced by wrapper.
 	XMP_Assert ( (namespacePrefix != 0) && (prefixSize != 0) );	// ! Enforced by wrapper.
 
-	XMP_VarString    nsURI ( namespaceURI );
-	XMP_StringMapPos uriPos	= sNamespaceURIToPrefixMap->find ( nsURI );
+	const XMP_NamespaceTable & nsTable = GetNamespaceTable();
+	XMP_VarString     nsURI ( namespaceURI );
+	XMP_cStringMapPos uriPos = nsTable.uriToPrefix.find ( nsURI );
 	
-	if ( uriPos != sNamespaceURIToPrefixMap->end() ) {
+	if ( uriPos != nsTable.uriToPrefix.end() ) {
 		*namespacePrefix = uriPos->second.c_str();
 		*prefixSize = uriPos->second.size();
 		found = true;
@@ -1100,9 +1106,10 @@ XMPMeta::GetNamespaceURI ( XMP_StringPtr   namespacePrefix,
 	XMP_VarString nsPrefix ( namespacePrefix );
 	if ( nsPrefix[nsPrefix.size()-1] != ':' ) nsPrefix += ':';
 	
-	XMP_StringMapPos prefixPos = sNamespacePrefixToURIMap->find ( nsPrefix );
+	const XMP_NamespaceTable & nsTable = GetNamespaceTable();
+	XMP_cStringMapPos prefixPos = nsTable.prefixToURI.find ( nsPrefix );
 	
-	if ( prefixPos != sNamespacePrefixToURIMap->end() ) {
+	if ( prefixPos != nsTable.prefixToURI.end() ) {
 		*namespaceURI = prefixPos->second.c_str();
 		*uriSize = prefixPos->second.size();
 		found = true;
@@ -1124,14 +1131,18 @@ XMPMeta::GetNamespaceURI ( XMP_StringPtr   namespacePrefix,
 /* class-static */ void
 XMPMeta::DeleteNamespace ( XMP_StringPtr namespaceURI )
 {
-	XMP_StringMapPos uriPos = sNamespaceURIToPrefixMap->find ( namespaceURI );
-	if ( uriPos == sNamespaceURIToPrefixMap->end() ) return;
+	XMP_NamespaceUpdate update;
+	XMP_NamespaceTable & nsTable = update.Table();
 
-	XMP_StringMapPos prefixPos = sNamespacePrefixToURIMap->find ( uriPos->second );
-	XMP_Assert ( prefixPos != sNamespacePrefixToURIMap->end() );
+	XMP_StringMapPos uriPos = nsTable.uriToPrefix.find ( namespaceURI );
+	if ( uriPos == nsTable.uriToPrefix.end() ) return;
+
+	XMP_StringMapPos prefixPos = nsTable.prefixToURI.find ( uriPos->second );
+	XMP_Assert ( prefixPos != nsTable.prefixToURI.end() );
 	
-	sNamespaceURIToPrefixMap->erase ( uriPos );
-	sNamespacePrefixToURIMap->erase ( prefixPos );
+	nsTable.uriToPrefix.erase ( uriPos );
+	nsTable.prefixToURI.erase ( prefixPos );
+	update.Commit();
 
 }	// DeleteNamespace
 
@@ -1186,12 +1197,15 @@ XMPMeta::RegisterAlias ( XMP_StringPtr 	aliasNS,
 		}
 	}
 
+	XMP_NamespaceUpdate update;
+	XMP_AliasMap & aliases = update.Table().aliases;
+
 	// See if there are any conflicts with existing aliases. A couple of the checks are easy. If the
 	// alias is already aliased it is only OK to reregister an identical alias. If the actual is
 	// already aliased to something else and the new chain is legal, just swap in the old base.
 
-	mapPos = sRegisteredAliasMap->find ( expAlias[kRootPropStep].step );
-	if ( mapPos != sRegisteredAliasMap->end() ) {
+	mapPos = aliases.find ( expAlias[kRootPropStep].step );
+	if ( mapPos != aliases.end() ) {
 
 		// This alias is already registered to something, make sure it is the same something.
 
@@ -1212,8 +1226,8 @@ XMPMeta::RegisterAlias ( XMP_StringPtr 	aliasNS,
 
 	}
 
-	mapPos = sRegisteredAliasMap->find ( expActual[kRootPropStep].step );
-	if ( mapPos != sRegisteredAliasMap->end() ) {
+	mapPos = aliases.find ( expActual[kRootPropStep].step );
+	if ( mapPos != aliases.end() ) {
 	
 		// The actual is already aliased to something else.
 		
@@ -1235,7 +1249,7 @@ XMPMeta::RegisterAlias ( XMP_StringPtr 	aliasNS,
 	//	TopProp => TopArray[] => TopArray[]
 	// In the valid cases we back substitute the new base.
 	
-	for ( mapPos = sRegisteredAliasMap->begin(); mapPos != sRegisteredAliasMap->end(); ++mapPos ) {
+	for ( mapPos = aliases.begin(); mapPos != aliases.end(); ++mapPos ) {
 		regActual = &mapPos->second;
 		if ( expAlias[kRootPropStep].step == (*regActual)[kRootPropStep].step ) {
 			if ( (regActual->size() == 2) && (expAlias.size() == 2) ) {
@@ -1244,7 +1258,7 @@ XMPMeta::RegisterAlias ( XMP_StringPtr 	aliasNS,
 		}
 	}
 	
-	for ( mapPos = sRegisteredAliasMap->begin(); mapPos != sRegisteredAliasMap->end(); ++mapPos ) {
+	for ( mapPos = aliases.begin(); mapPos != aliases.end(); ++mapPos ) {
 		regActual = &mapPos->second;
 		if ( expAlias[kRootPropStep].step == (*regActual)[kRootPropStep].step ) {
 
@@ -1260,7 +1274,8 @@ XMPMeta::RegisterAlias ( XMP_StringPtr 	aliasNS,
 	
 	// Finally, all is OK to register the new alias.
 	
-	(void) sRegisteredAliasMap->insert ( XMP_AliasMap::value_type ( expAlias[kRootPropStep].step, expActual ) );
+	(void) aliases.insert ( XMP_AliasMap::value_type ( expAlias[kRootPropStep].step, expActual ) );
+	update.Commit();
 
 }	// RegisterAlias
 
@@ -1289,8 +1304,9 @@ XMPMeta::ResolveAlias ( XMP_StringPtr	 aliasNS,
 
 	minPath.push_back ( fullPath[kSchemaStep] );
 	minPath.push_back ( fullPath[kRootPropStep] );
-	XMP_AliasMapPos mapPos = sRegisteredAliasMap->find ( minPath[kRootPropStep].step );
-	if ( mapPos == sRegisteredAliasMap->end() ) return false;
+	const XMP_AliasMap & aliases = GetNamespaceTable().aliases;
+	XMP_cAliasMapPos mapPos = aliases.find ( minPath[kRootPropStep].step );
+	if ( mapPos == aliases.end() ) return false;
 	
 	// Replace the alias portion of the full expanded path. Compose the output path string.
 	
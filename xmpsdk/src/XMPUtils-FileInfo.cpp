@@ -1094,8 +1094,9 @@ XMPUtils::RemoveProperties ( XMPMeta *		xmpObj,
 			XMP_StringLen nsLen;
 			(void) XMPMeta::GetNamespacePrefix ( schemaNS, &nsPrefix, &nsLen );
 			
-			XMP_AliasMapPos currAlias = sRegisteredAliasMap->begin();
-			XMP_AliasMapPos endAlias  = sRegisteredAliasMap->end();
+			const XMP_AliasMap & aliases = GetNamespaceTable().aliases;
+			XMP_cAliasMapPos currAlias = aliases.begin();
+			XMP_cAliasMapPos endAlias  = aliases.end();
 			
 			for ( ; currAlias != endAlias; ++currAlias ) {
 				if ( strncmp ( currAlias->first.c_str(), nsPrefix, nsLen ) == 0 ) {
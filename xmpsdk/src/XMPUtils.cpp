@@ -40,13 +40,23 @@ static const char * sBase64Chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqr
 // Static Variables
 // ================
 
-XMP_VarString * sComposedPath = 0;		// *** Only really need 1 string. Shrink periodically?
-XMP_VarString * sConvertedValue = 0;
-XMP_VarString * sBase64Str = 0;
-XMP_VarString * sCatenatedItems = 0;
-XMP_VarString * sStandardXMP = 0;
-XMP_VarString * sExtendedXMP = 0;
-XMP_VarString * sExtendedDigest = 0;
+// ! The output strings are per thread, see sOutputStr.
+
+static thread_local XMP_VarString sComposedPathBuffer;
+static thread_local XMP_VarString sConvertedValueBuffer;
+static thread_local XMP_VarString sBase64StrBuffer;
+static thread_local XMP_VarString sCatenatedItemsBuffer;
+static thread_local XMP_VarString sStandardXMPBuffer;
+static thread_local XMP_VarString sExtendedXMPBuffer;
+static thread_local XMP_VarString sExtendedDigestBuffer;
+
+thread_local XMP_VarString * sComposedPath = &sComposedPathBuffer;		// *** Only really need 1 string. Shrink periodically?
+thread_local XMP_VarString * sConvertedValue = &sConvertedValueBuffer;
+thread_local XMP_VarString * sBase64Str = &sBase64StrBuffer;
+thread_local XMP_VarString * sCatenatedItems = &sCatenatedItemsBuffer;
+thread_local XMP_VarString * sStandardXMP = &sStandardXMPBuffer;
+thread_local XMP_VarString * sExtendedXMP = &sExtendedXMPBuffer;
+thread_local XMP_VarString * sExtendedDigest = &sExtendedDigestBuffer;
 
 // =================================================================================================
 // Local Utilities
@@ -623,14 +633,6 @@ static size_t MoveLargestProperty ( XMPMeta & stdXMP, XMPMeta * extXMP, PropSize
 /* class static */ bool
 XMPUtils::Initialize()
 {
-	sComposedPath	= new XMP_VarString();
-	sConvertedValue = new XMP_VarString();
-	sBase64Str		= new XMP_VarString();
-	sCatenatedItems = new XMP_VarString();
-	sStandardXMP    = new XMP_VarString();
-	sExtendedXMP    = new XMP_VarString();
-	sExtendedDigest = new XMP_VarString();
-
 	#if XMP_MacBuild && __MWERKS__
 		LookupTimeProcs();
 	#endif
@@ -644,19 +646,10 @@ XMPUtils::Initialize()
 // Terminate
 // ---------
 
-#define EliminateGlobal(g) delete ( g ); g = 0
-
 /* class static */ void
 XMPUtils::Terminate() RELEASE_NO_THROW
 {
-	EliminateGlobal ( sComposedPath );
-	EliminateGlobal ( sConvertedValue );
-	EliminateGlobal ( sBase64Str );
-	EliminateGlobal ( sCatenatedItems );
-	EliminateGlobal ( sStandardXMP );
-	EliminateGlobal ( sExtendedXMP );
-	EliminateGlobal ( sExtendedDigest );
-
+	// ! The output strings are per thread and are released when their thread exits.
 	return;
 
 }	// Terminate